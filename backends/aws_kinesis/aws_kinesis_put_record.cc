@@ -1,11 +1,15 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
 #include <aws/core/Aws.h>
 #include <aws/core/client/ClientConfiguration.h>
 #include <aws/core/auth/AWSCredentials.h>
 #include <aws/core/utils/Outcome.h>
+#include <aws/core/utils/threading/Executor.h>
 #include <aws/kinesis/KinesisClient.h>
-#include <aws/kinesis/model/PutRecordRequest.h>
+#include <aws/kinesis/model/PutRecordsRequest.h>
 #include "aws_kinesis_put_record.h"
 
 using namespace Aws;
@@ -14,12 +18,31 @@ SDKOptions options;
 
 Kinesis::KinesisClient *client;
 
-struct request_outcome {
-    Kinesis::Model::PutRecordOutcomeCallable future_outcome;
-    size_t data_len;
-};
-
-Vector<request_outcome> request_outcomes;
+/*
+ * The records are collected in a PutRecordsRequest, which is sent when it
+ * cannot take more of them, or when the caller flushes it. The requests are
+ * sent asynchronously, at most KINESIS_REQUESTS_MAX at once - the caller waits
+ * for one of them to complete before sending another one.
+ *
+ * Their completions are accumulated in the results, which the caller collects
+ * with kinesis_get_result().
+ */
+
+static Kinesis::Model::PutRecordsRequest *request;
+static size_t request_bytes = 0;
+
+static std::mutex results_mutex;
+static std::condition_variable results_cond;
+static size_t requests_in_flight = 0;
+static long requests_timeout_ms;
+
+static struct {
+    size_t requests_ok;
+    size_t requests_failed;
+    size_t sent_bytes;
+    size_t lost_bytes;
+    String error_message;
+} results;
 
 void kinesis_init(const char *region, const char *access_key_id, const char *secret_key, const long timeout) {
     InitAPI(options);
@@ -29,59 +52,137 @@ void kinesis_init(const char *region, const char *access_key_id, const char *sec
     config.region = region;
     config.requestTimeoutMs = timeout;
     config.connectTimeoutMs = timeout;
+    config.maxConnections = KINESIS_REQUESTS_MAX;
+    config.executor = MakeShared<Utils::Threading::PooledThreadExecutor>("client", KINESIS_REQUESTS_MAX);
+
+    requests_timeout_ms = timeout;
 
     if(access_key_id && *access_key_id && secret_key && *secret_key) {
         client = New<Kinesis::KinesisClient>("client", Auth::AWSCredentials(access_key_id, secret_key), config);
     } else {
         client = New<Kinesis::KinesisClient>("client", config);
     }
+
+    request = New<Kinesis::Model::PutRecordsRequest>("client");
 }
 
-void kinesis_shutdown() {
-    Delete(client);
+static void kinesis_put_records_completed(const Kinesis::KinesisClient *,
+                                          const Kinesis::Model::PutRecordsRequest &completed_request,
+                                          const Kinesis::Model::PutRecordsOutcome &outcome,
+                                          const std::shared_ptr<const Client::AsyncCallerContext> &) {
+    size_t bytes = 0, lost = 0;
+    const Vector<Kinesis::Model::PutRecordsRequestEntry> &records = completed_request.GetRecords();
 
-    ShutdownAPI(options);
+    for(auto &record : records)
+        bytes += record.GetData().GetLength();
+
+    std::lock_guard<std::mutex> lock(results_mutex);
+
+    if(outcome.IsSuccess()) {
+        const Kinesis::Model::PutRecordsResult &result = outcome.GetResult();
+
+        // some of the records may have been throttled or failed
+        if(result.GetFailedRecordCount()) {
+            const Vector<Kinesis::Model::PutRecordsResultEntry> &entries = result.GetRecords();
+
+            for(size_t i = 0; i < entries.size() && i < records.size(); i++) {
+                if(!entries[i].GetErrorCode().empty()) {
+                    lost += records[i].GetData().GetLength();
+                    results.error_message = entries[i].GetErrorCode() + ": " + entries[i].GetErrorMessage();
+                }
+            }
+        }
+    }
+    else {
+        lost = bytes;
+        results.error_message = outcome.GetError().GetMessage();
+    }
+
+    if(lost)
+        results.requests_failed++;
+    else
+        results.requests_ok++;
+
+    results.sent_bytes += bytes;
+    results.lost_bytes += lost;
+
+    requests_in_flight--;
+    results_cond.notify_all();
+}
+
+// sends the records collected so far
+// it waits for a request in flight to complete, when there are KINESIS_REQUESTS_MAX of them
+void kinesis_flush(const char *stream_name) {
+    if(request->GetRecords().empty()) return;
+
+    {
+        std::unique_lock<std::mutex> lock(results_mutex);
+
+        // the requests in flight complete or fail within their timeout
+        results_cond.wait_for(lock, std::chrono::milliseconds(requests_timeout_ms * 2 + 1000), [] {
+            return requests_in_flight < KINESIS_REQUESTS_MAX;
+        });
+
+        requests_in_flight++;
+    }
+
+    request->SetStreamName(stream_name);
+    client->PutRecordsAsync(*request, kinesis_put_records_completed);
+
+    // the request has been copied by the client
+    request->SetRecords(Vector<Kinesis::Model::PutRecordsRequestEntry>());
+    request_bytes = 0;
 }
 
 int kinesis_put_record(const char *stream_name, const char *partition_key,
                        const char *data, size_t data_len) {
-    Kinesis::Model::PutRecordRequest request;
+    size_t record_bytes = data_len + strlen(partition_key);
+
+    if(request->GetRecords().size() >= KINESIS_REQUEST_RECORDS_MAX || request_bytes + record_bytes > KINESIS_REQUEST_MAX)
+        kinesis_flush(stream_name);
 
-    request.SetStreamName(stream_name);
-    request.SetPartitionKey(partition_key);
-    request.SetData(Utils::ByteBuffer((unsigned char*) data, data_len));
+    Kinesis::Model::PutRecordsRequestEntry record;
+    record.SetPartitionKey(partition_key);
+    record.SetData(Utils::ByteBuffer((unsigned char*) data, data_len));
 
-    request_outcomes.push_back({client->PutRecordCallable(request), data_len});
+    request->AddRecords(std::move(record));
+    request_bytes += record_bytes;
 
     return 0;
 }
 
-int kinesis_get_result(char *error_message, size_t *sent_bytes, size_t *lost_bytes) {
-    Kinesis::Model::PutRecordOutcome outcome;
-    *sent_bytes = 0;
-    *lost_bytes = 0;
+int kinesis_get_result(char *error_message, size_t *sent_bytes, size_t *lost_bytes, size_t *requests_ok, size_t *requests_failed) {
+    std::lock_guard<std::mutex> lock(results_mutex);
 
-    for(auto request_outcome = request_outcomes.begin(); request_outcome != request_outcomes.end(); ) {
-        std::future_status status = request_outcome->future_outcome.wait_for(std::chrono::microseconds(100));
+    *sent_bytes = results.sent_bytes;
+    *lost_bytes = results.lost_bytes;
+    *requests_ok = results.requests_ok;
+    *requests_failed = results.requests_failed;
 
-        if(status == std::future_status::ready || status == std::future_status::deferred) {
-            outcome = request_outcome->future_outcome.get();
-            *sent_bytes += request_outcome->data_len;
+    int ret = 0;
+    if(results.lost_bytes) {
+        results.error_message.copy(error_message, ERROR_LINE_MAX);
+        ret = 1;
+    }
 
-            if(!outcome.IsSuccess()) {
-                *lost_bytes += request_outcome->data_len;
-                outcome.GetError().GetMessage().copy(error_message, ERROR_LINE_MAX);
-            }
+    results.sent_bytes = results.lost_bytes = 0;
+    results.requests_ok = results.requests_failed = 0;
+    results.error_message.clear();
 
-            request_outcomes.erase(request_outcome);
-        } else {
-            ++request_outcome;
-        }
-    }
+    return ret;
+}
 
-    if(*lost_bytes) {
-        return 1;
+void kinesis_shutdown() {
+    {
+        // give the requests in flight a chance to complete
+        std::unique_lock<std::mutex> lock(results_mutex);
+        results_cond.wait_for(lock, std::chrono::milliseconds(requests_timeout_ms + 1000), [] {
+            return requests_in_flight == 0;
+        });
     }
 
-    return 0;
-}
\ No newline at end of file
+    Delete(request);
+    Delete(client);
+
+    ShutdownAPI(options);
+}
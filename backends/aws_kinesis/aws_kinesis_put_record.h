@@ -5,6 +5,10 @@
 
 #define ERROR_LINE_MAX 1023
 
+#define KINESIS_REQUESTS_MAX 8                          // the PutRecords requests in flight at once
+#define KINESIS_REQUEST_RECORDS_MAX 500                 // the records of a PutRecords request
+#define KINESIS_REQUEST_MAX (5 * 1024 * 1024)           // the bytes of a PutRecords request
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,7 +20,9 @@ void kinesis_shutdown();
 int kinesis_put_record(const char *stream_name, const char *partition_key,
                        const char *data, size_t data_len);
 
-int kinesis_get_result(char *error_message, size_t *sent_bytes, size_t *lost_bytes);
+void kinesis_flush(const char *stream_name);
+
+int kinesis_get_result(char *error_message, size_t *sent_bytes, size_t *lost_bytes, size_t *requests_ok, size_t *requests_failed);
 
 #ifdef __cplusplus
 }
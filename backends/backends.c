@@ -46,15 +46,15 @@ size_t backend_name_copy(char *d, const char *s, size_t usable) {
     return n;
 }
 
-// calculate the SUM or AVERAGE of a dimension, for any timeframe
-// may return NAN if the database does not have any value in the give timeframe
+// sum the values of a dimension stored in any timeframe
+// returns the number of values, 0 if the database does not have any value in the give timeframe
 
-calculated_number backend_calculate_value_from_stored_data(
+size_t backend_sum_stored_data(
           RRDSET *st                // the chart
         , RRDDIM *rd                // the dimension
         , time_t after              // the start timestamp
         , time_t before             // the end timestamp
-        , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
+        , calculated_number *sum_of_values // the sum of the values
         , time_t *first_timestamp   // the first point of the database used in this response
         , time_t *last_timestamp    // the timestamp that should be reported to backend
 ) {
@@ -62,8 +62,8 @@ calculated_number backend_calculate_value_from_stored_data(
     (void)host;
 
     // find the edges of the rrd database for this chart
-    time_t first_t = rd->state->query_ops.oldest_time(rd);
-    time_t last_t  = rd->state->query_ops.latest_time(rd);
+    time_t first_t = rd->state->query_ops->oldest_time(rd);
+    time_t last_t  = rd->state->query_ops->latest_time(rd);
     time_t update_every = st->update_every;
     struct rrddim_query_handle handle;
     storage_number n;
@@ -98,7 +98,7 @@ calculated_number backend_calculate_value_from_stored_data(
               (unsigned long)after, (unsigned long)before,
               (unsigned long)first_t, (unsigned long)last_t
         );
-        return NAN;
+        return 0;
     }
 
     *first_timestamp = after;
@@ -107,6 +107,7 @@ calculated_number backend_calculate_value_from_stored_data(
     size_t counter = 0;
     calculated_number sum = 0;
 
+
 /*
     long    start_at_slot = rrdset_time2slot(st, before),
             stop_at_slot  = rrdset_time2slot(st, after),
@@ -130,8 +131,8 @@ calculated_number backend_calculate_value_from_stored_data(
         counter++;
     }
 */
-    for(rd->state->query_ops.init(rd, &handle, after, before) ; !rd->state->query_ops.is_finished(&handle) ; ) {
-        n = rd->state->query_ops.next_metric(&handle);
+    for(rd->state->query_ops->init(rd, &handle, after, before) ; !rd->state->query_ops->is_finished(&handle) ; ) {
+        n = rd->state->query_ops->next_metric(&handle);
 
         if(unlikely(!does_storage_number_exist(n))) {
             // not collected
@@ -143,15 +144,37 @@ calculated_number backend_calculate_value_from_stored_data(
 
         counter++;
     }
-    rd->state->query_ops.finalize(&handle);
+    rd->state->query_ops->finalize(&handle);
     if(unlikely(!counter)) {
         debug(D_BACKEND, "BACKEND: %s.%s.%s: no values stored in database for range %lu to %lu",
               host->hostname, st->id, rd->id,
               (unsigned long)after, (unsigned long)before
         );
-        return NAN;
+        return 0;
     }
 
+    *sum_of_values = sum;
+    return counter;
+}
+
+// calculate the SUM or AVERAGE of a dimension, for any timeframe
+// may return NAN if the database does not have any value in the give timeframe
+
+calculated_number backend_calculate_value_from_stored_data(
+          RRDSET *st                // the chart
+        , RRDDIM *rd                // the dimension
+        , time_t after              // the start timestamp
+        , time_t before             // the end timestamp
+        , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
+        , time_t *first_timestamp   // the first point of the database used in this response
+        , time_t *last_timestamp    // the timestamp that should be reported to backend
+) {
+    calculated_number sum = 0;
+    size_t counter = backend_sum_stored_data(st, rd, after, before, &sum, first_timestamp, last_timestamp);
+
+    if(unlikely(!counter))
+        return NAN;
+
     if(unlikely(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_SUM))
         return sum;
 
@@ -237,12 +260,629 @@ inline BACKEND_OPTIONS backend_parse_data_source(const char *source, BACKEND_OPT
     return backend_options;
 }
 
+// ----------------------------------------------------------------------------
+// backend instances
+//
+// The [backend] section of netdata.conf and the [backend:NAME] sections of the
+// backends listed in its `instances` are independent backends, each with its
+// own thread that connects and sends the metrics to its destination. The
+// backends thread walks the hosts, the charts and the dimensions once every
+// `update every` for all of them, formatting the metrics of every backend in
+// the same pass, and gives them to their threads.
+
+struct backend_batch {
+    BUFFER *b;
+    size_t sent;                            // the bytes of b the backend has received
+    collected_number metrics;
+    int passes;
+
+    struct backend_batch *next;
+};
+
+struct backend_instance {
+    char *name;                             // NULL for the [backend] section
+    char *section;
+
+    const char *type;
+    const char *destination;
+    const char *source;
+    const char *prefix;
+    const char *hostname;
+    BACKEND_TYPE work_type;
+    BACKEND_OPTIONS options;
+    int default_port;
+    int buffer_on_failures;
+    size_t buffer_size;                     // the bytes the thread may keep for sending, 0 for no limit
+    struct timeval timeout;
+    int only_changed;                       // send the values of the dimensions only when they change
+    time_t resend_every;                    // the seconds after which an unchanged value is sent again
+
+    int (*request_formatter)(BUFFER *, const char *, const char *, BACKEND_SNAPSHOT_CHART *, BACKEND_SNAPSHOT_DIMENSION *, BACKEND_OPTIONS);
+    int (*response_checker)(BUFFER *);
+
+    int do_kinesis;
+    int do_prometheus_remote_write;
+
+#if HAVE_KINESIS
+    char *kinesis_auth_key_id;
+    char *kinesis_secure_key;
+    char *kinesis_stream_name;
+#endif
+
+#if ENABLE_PROMETHEUS_REMOTE_WRITE
+    const char *remote_write_path;
+    BUFFER *remote_write_data;              // the packed write request, used by the backends thread
+#endif
+
+    // used by the backends thread
+    BUFFER *pass;                           // the metrics formatted during the pass
+    collected_number pass_metrics;
+
+    // given to the thread of the backend, under the mutex
+    netdata_mutex_t mutex;
+    pthread_cond_t cond;
+    BUFFER *pending;                        // the metrics of the passes the thread has not taken yet
+    collected_number pending_metrics;
+    int pending_passes;
+    collected_number discarded_metrics;     // the metrics of the passes discarded, the thread was busy sending
+    collected_number discarded_bytes;
+    int discarded_passes;
+    int stop;
+
+    // used by the thread of the backend
+    int sock;
+    struct backend_batch *batches;          // the passes to send, the first one is in flight
+    struct backend_batch *spare;            // the batches sent, to be used again
+    size_t batches_bytes;
+    int batches_passes;
+    BUFFER *response;
+#ifdef ENABLE_HTTPS
+    struct netdata_ssl opentsdb_ssl;
+#endif
+
+    size_t index;                           // the position of the backend in backend_instances
+
+    int thread_created;
+    netdata_thread_t thread;
+
+    struct backend_instance *next;
+};
+
+static struct backend_instance *backend_instances = NULL;
+
+static void backend_instance_free(struct backend_instance *inst) {
+#if HAVE_KINESIS
+    freez(inst->kinesis_auth_key_id);
+    freez(inst->kinesis_secure_key);
+    freez(inst->kinesis_stream_name);
+#endif
+
+#if ENABLE_PROMETHEUS_REMOTE_WRITE
+    buffer_free(inst->remote_write_data);
+#endif
+
+    if(inst->sock != -1)
+        close(inst->sock);
+
+#ifdef ENABLE_HTTPS
+    if(inst->opentsdb_ssl.conn)
+        SSL_free(inst->opentsdb_ssl.conn);
+#endif
+
+    buffer_free(inst->pass);
+    buffer_free(inst->pending);
+
+    struct backend_batch *batch;
+    while((batch = inst->batches)) {
+        inst->batches = batch->next;
+        buffer_free(batch->b);
+        freez(batch);
+    }
+    while((batch = inst->spare)) {
+        inst->spare = batch->next;
+        buffer_free(batch->b);
+        freez(batch);
+    }
+    buffer_free(inst->response);
+    freez(inst->name);
+    freez(inst->section);
+    freez(inst);
+}
+
+// ----------------------------------------------------------------------------
+// the snapshot of a pass
+//
+// The backends thread copies the dimensions to send into a flat array, holding
+// the lock of each chart only while it copies its dimensions. The metrics are
+// formatted for the backends from the copies, after the locks are released.
+// The strings and the charts are copied into blocks that are not moved while
+// the pass is formatted, and are reused by the next passes.
+
+#define BACKEND_SNAPSHOT_BLOCK_SIZE (64 * 1024)
+
+// the backends that can send only the changed values, with a bit for every one of them
+#define BACKEND_ONLY_CHANGED_MAX 64
+
+struct backend_snapshot_block {
+    size_t size;
+    size_t used;
+    char *data;
+    struct backend_snapshot_block *next;
+};
+
+struct backend_snapshot {
+    struct backend_snapshot_block *blocks;
+    struct backend_snapshot_block *block;       // the block being filled
+
+    BACKEND_SNAPSHOT_DIMENSION *dimensions;
+    size_t dimensions_used;
+    size_t dimensions_size;
+};
+
+static void *backend_snapshot_alloc(struct backend_snapshot *snap, size_t size) {
+
+    // keep the allocations aligned for any type
+    size = (size + 15) & ~((size_t)15);
+
+    while(!snap->block || snap->block->used + size > snap->block->size) {
+        if(snap->block && snap->block->next) {
+            snap->block = snap->block->next;
+            snap->block->used = 0;
+            continue;
+        }
+
+        struct backend_snapshot_block *b = callocz(1, sizeof(struct backend_snapshot_block));
+        b->size = (size > BACKEND_SNAPSHOT_BLOCK_SIZE) ? size : BACKEND_SNAPSHOT_BLOCK_SIZE;
+        b->data = mallocz(b->size);
+
+        if(snap->block) snap->block->next = b;
+        else snap->blocks = b;
+        snap->block = b;
+    }
+
+    void *p = &snap->block->data[snap->block->used];
+    snap->block->used += size;
+    return p;
+}
+
+static const char *backend_snapshot_strdup(struct backend_snapshot *snap, const char *s) {
+    if(!s) return NULL;
+
+    size_t len = strlen(s) + 1;
+    char *d = backend_snapshot_alloc(snap, len);
+    memcpy(d, s, len);
+    return d;
+}
+
+static void backend_snapshot_reset(struct backend_snapshot *snap) {
+    snap->block = snap->blocks;
+    if(snap->block) snap->block->used = 0;
+    snap->dimensions_used = 0;
+}
+
+static void backend_snapshot_free(struct backend_snapshot *snap) {
+    while(snap->blocks) {
+        struct backend_snapshot_block *b = snap->blocks;
+        snap->blocks = b->next;
+        freez(b->data);
+        freez(b);
+    }
+    snap->block = NULL;
+
+    freez(snap->dimensions);
+    snap->dimensions = NULL;
+    snap->dimensions_used = snap->dimensions_size = 0;
+}
+
+// copies the chart - the hostname and the tags given have been copied already
+static BACKEND_SNAPSHOT_CHART *backend_snapshot_chart(struct backend_snapshot *snap, const char *hostname, const char *host_tags, int is_localhost, RRDSET *st) {
+    BACKEND_SNAPSHOT_CHART *c = backend_snapshot_alloc(snap, sizeof(BACKEND_SNAPSHOT_CHART));
+
+    c->hostname  = hostname;
+    c->host_tags = host_tags;
+    c->localhost = is_localhost;
+    c->database  = (st->rrd_memory_mode != RRD_MEMORY_MODE_NONE);
+    c->id        = backend_snapshot_strdup(snap, st->id);
+    c->name      = backend_snapshot_strdup(snap, st->name);
+    c->family    = backend_snapshot_strdup(snap, st->family);
+    c->context   = backend_snapshot_strdup(snap, st->context);
+    c->type      = backend_snapshot_strdup(snap, st->type);
+    c->units     = backend_snapshot_strdup(snap, st->units);
+
+    return c;
+}
+
+// copies the dimension, with the values stored in the timeframe when the backends need them
+static void backend_snapshot_dimension(struct backend_snapshot *snap, BACKEND_SNAPSHOT_CHART *c, RRDSET *st, RRDDIM *rd, time_t after, time_t before, int stored) {
+    if(unlikely(snap->dimensions_used == snap->dimensions_size)) {
+        snap->dimensions_size = (snap->dimensions_size) ? snap->dimensions_size * 2 : 1024;
+        snap->dimensions = reallocz(snap->dimensions, snap->dimensions_size * sizeof(BACKEND_SNAPSHOT_DIMENSION));
+    }
+
+    BACKEND_SNAPSHOT_DIMENSION *d = &snap->dimensions[snap->dimensions_used++];
+    d->chart = c;
+    d->id = backend_snapshot_strdup(snap, rd->id);
+    d->name = backend_snapshot_strdup(snap, rd->name);
+    d->last_collected_value = rd->last_collected_value;
+    d->last_collected_time = rd->last_collected_time.tv_sec;
+    d->stored_count = 0;
+    d->stored_sum = 0;
+    d->stored_time = before;
+    d->unchanged = 0;
+
+    if(stored && c->database) {
+        time_t first_t = after;
+        d->stored_count = backend_sum_stored_data(st, rd, after, before, &d->stored_sum, &first_t, &d->stored_time);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// the workers of a pass
+//
+// The hosts of a pass are copied and formatted by `formatting threads` workers,
+// the backends thread being the first of them. Every worker takes the next host
+// not copied yet, so that the hosts with many charts do not delay the others,
+// and copies it into its own snapshot. When all the hosts are copied, and the
+// locks are released, every worker formats its snapshot into its own buffer for
+// every backend. The buffers of the workers are given to the backends in order.
+
+typedef enum backend_worker_job {
+    BACKEND_WORKER_COPY,
+    BACKEND_WORKER_FORMAT
+} BACKEND_WORKER_JOB;
+
+struct backend_worker {
+    struct backend_snapshot snapshot;
+
+    BUFFER **passes;                        // the metrics formatted for every backend, by backend index
+    collected_number *passes_metrics;
+
+    size_t charts;
+    size_t dimensions;
+    size_t dimensions_skipped;
+
+    int thread_created;
+    netdata_thread_t thread;
+};
+
+static struct backend_workers {
+    netdata_mutex_t mutex;
+    pthread_cond_t cond;                    // a new job for the workers
+    pthread_cond_t done;                    // the workers finished the job
+
+    size_t count;                           // the workers running
+    size_t workers_allocated;
+    size_t instances;                       // the buffers of every worker
+    struct backend_worker *workers;
+    size_t running;                         // the workers have not finished the job yet
+    size_t generation;                      // increased for every job
+    int stop;
+
+    // the job
+    BACKEND_WORKER_JOB job;
+    RRDHOST **hosts;
+    size_t hosts_used;
+    size_t hosts_size;
+    size_t next_host;                       // the next host to be copied
+    time_t after;
+    time_t before;
+    BACKEND_OPTIONS snapshot_options;
+    int need_stored;
+    int only_changed;                       // some backends send only the changed values
+} backend_workers = {
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .done = PTHREAD_COND_INITIALIZER,
+        .count = 0,
+        .workers_allocated = 0,
+        .instances = 0,
+        .workers = NULL,
+        .running = 0,
+        .generation = 0,
+        .stop = 0,
+        .hosts = NULL,
+        .hosts_used = 0,
+        .hosts_size = 0,
+        .next_host = 0,
+};
+
+// sets the bits of the backends that send only the changed values, when the value of the dimension
+// copied is the one they have sent last, and it is not time to send it again
+// the last values of rd are used only by the worker copying its host
+static void backend_snapshot_unchanged(BACKEND_SNAPSHOT_DIMENSION *d, RRDDIM *rd, time_t now) {
+    struct backend_workers *bw = &backend_workers;
+    struct backend_instance *inst;
+
+    if(unlikely(!rd->state->backend_values))
+        rd->state->backend_values = callocz(bw->instances, sizeof(struct rrddim_backend_value));
+
+    for(inst = backend_instances; inst ; inst = inst->next) {
+        if(likely(!inst->only_changed))
+            continue;
+
+        calculated_number value = (BACKEND_OPTIONS_DATA_SOURCE(inst->options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+                                  ? (calculated_number)d->last_collected_value
+                                  : backend_snapshot_stored_value(d, inst->options);
+
+        struct rrddim_backend_value *bv = &rd->state->backend_values[inst->index];
+
+        // NAN is never equal, but it is not sent either
+        if(bv->sent && value == bv->value && now - bv->sent < inst->resend_every)
+            d->unchanged |= (uint64_t)1 << inst->index;
+        else {
+            bv->value = value;
+            bv->sent = now;
+        }
+    }
+}
+
+static void backend_worker_copy(struct backend_worker *w) {
+    struct backend_workers *bw = &backend_workers;
+    struct backend_snapshot *snap = &w->snapshot;
+
+    backend_snapshot_reset(snap);
+    w->charts = w->dimensions = w->dimensions_skipped = 0;
+
+    size_t i;
+    while((i = __atomic_fetch_add(&bw->next_host, 1, __ATOMIC_RELAXED)) < bw->hosts_used) {
+        RRDHOST *host = bw->hosts[i];
+
+        // a single walk of the charts for all the backends, copying the dimensions they will format
+        // the charts of the host are walked without locking the host, so that
+        // the collectors that add or remove charts do not wait for the backend
+        const char *hostname = backend_snapshot_strdup(snap, host->hostname);
+        const char *host_tags = backend_snapshot_strdup(snap, host->tags);
+        int is_localhost = (host == localhost);
+
+        size_t count_charts = 0;
+        size_t count_dims = 0;
+        size_t count_dims_skipped = 0;
+
+        unsigned reader = rrdhost_charts_read_lock(host);
+        RRDSET *st;
+        rrdset_foreach_lockless(st, host) {
+            if(likely(backends_can_send_rrdset(bw->snapshot_options, st))) {
+                rrdset_rdlock(st);
+
+                BACKEND_SNAPSHOT_CHART *c = backend_snapshot_chart(snap, hostname, host_tags, is_localhost, st);
+                count_charts++;
+
+                size_t chart_dims = 0;
+                RRDDIM *rd;
+                rrddim_foreach_read(rd, st) {
+                    if (likely(rd->last_collected_time.tv_sec >= bw->after)) {
+                        backend_snapshot_dimension(snap, c, st, rd, bw->after, bw->before, bw->need_stored);
+                        if(unlikely(bw->only_changed))
+                            backend_snapshot_unchanged(&snap->dimensions[snap->dimensions_used - 1], rd, bw->before);
+                        chart_dims++;
+                    }
+                    else {
+                        debug(D_BACKEND, "BACKEND: not sending dimension '%s' of chart '%s' from host '%s', its last data collection (%lu) is not within our timeframe (%lu to %lu)", rd->id, st->id, host->hostname, (unsigned long)rd->last_collected_time.tv_sec, (unsigned long)bw->after, (unsigned long)bw->before);
+                        count_dims_skipped++;
+                    }
+                }
+
+                rrdset_unlock(st);
+
+                // the formatting is done without locks, when the chart may be gone: its cost is the metrics copied
+                __atomic_add_fetch(&st->cost.backend_metrics, chart_dims, __ATOMIC_RELAXED);
+                count_dims += chart_dims;
+            }
+        }
+        rrdhost_charts_read_unlock(host, reader);
+
+        debug(D_BACKEND, "BACKEND: sending host '%s', metrics of %zu dimensions, of %zu charts. Skipped %zu dimensions.", host->hostname, count_dims, count_charts, count_dims_skipped);
+        w->charts += count_charts;
+        w->dimensions += count_dims;
+        w->dimensions_skipped += count_dims_skipped;
+    }
+}
+
+static void backend_worker_format(struct backend_worker *w) {
+    struct backend_snapshot *snap = &w->snapshot;
+    struct backend_instance *inst;
+
+    size_t i;
+    for(i = 0; i < snap->dimensions_used ; i++) {
+        BACKEND_SNAPSHOT_DIMENSION *d = &snap->dimensions[i];
+        BACKEND_SNAPSHOT_CHART *c = d->chart;
+
+        for(inst = backend_instances; inst ; inst = inst->next) {
+            if(unlikely(inst->do_prometheus_remote_write))
+                continue;
+
+            if(unlikely(!c->database && BACKEND_OPTIONS_DATA_SOURCE(inst->options) != BACKEND_SOURCE_DATA_AS_COLLECTED))
+                continue;
+
+            if(unlikely(d->unchanged & ((uint64_t)1 << inst->index)))
+                continue;
+
+            w->passes_metrics[inst->index] += inst->request_formatter(w->passes[inst->index], inst->prefix, (c->localhost)?inst->hostname:c->hostname, c, d, inst->options);
+        }
+    }
+}
+
+static void backend_worker_run(struct backend_worker *w, BACKEND_WORKER_JOB job) {
+    if(job == BACKEND_WORKER_COPY)
+        backend_worker_copy(w);
+    else
+        backend_worker_format(w);
+}
+
+static void *backend_worker_thread(void *ptr) {
+    struct backend_workers *bw = &backend_workers;
+    struct backend_worker *w = ptr;
+    size_t generation = 0;
+
+    // the workers are stopped by the backends thread, not cancelled
+    netdata_thread_disable_cancelability();
+
+    netdata_mutex_lock(&bw->mutex);
+    while(1) {
+        while(bw->generation == generation && !bw->stop)
+            pthread_cond_wait(&bw->cond, &bw->mutex);
+
+        if(bw->stop)
+            break;
+
+        generation = bw->generation;
+        BACKEND_WORKER_JOB job = bw->job;
+        netdata_mutex_unlock(&bw->mutex);
+
+        backend_worker_run(w, job);
+
+        netdata_mutex_lock(&bw->mutex);
+        if(!--bw->running)
+            pthread_cond_signal(&bw->done);
+    }
+    netdata_mutex_unlock(&bw->mutex);
+
+    netdata_thread_enable_cancelability();
+    return NULL;
+}
+
+// runs the job on all the workers, returns when they have all finished it
+static void backend_workers_run(BACKEND_WORKER_JOB job) {
+    struct backend_workers *bw = &backend_workers;
+
+    if(bw->count > 1) {
+        netdata_mutex_lock(&bw->mutex);
+        bw->job = job;
+        bw->running = bw->count - 1;
+        bw->generation++;
+        pthread_cond_broadcast(&bw->cond);
+        netdata_mutex_unlock(&bw->mutex);
+    }
+
+    backend_worker_run(&bw->workers[0], job);
+
+    if(bw->count > 1) {
+        netdata_mutex_lock(&bw->mutex);
+        while(bw->running)
+            pthread_cond_wait(&bw->done, &bw->mutex);
+        netdata_mutex_unlock(&bw->mutex);
+    }
+}
+
+static void backend_workers_start(size_t count, size_t instances) {
+    struct backend_workers *bw = &backend_workers;
+
+    if(count < 1) count = 1;
+
+    bw->workers = callocz(count, sizeof(struct backend_worker));
+    bw->workers_allocated = count;
+    bw->instances = instances;
+    bw->count = 1;
+
+    size_t i, j;
+    for(i = 0; i < count ; i++) {
+        struct backend_worker *w = &bw->workers[i];
+
+        w->passes = callocz(instances, sizeof(BUFFER *));
+        w->passes_metrics = callocz(instances, sizeof(collected_number));
+        for(j = 0; j < instances ; j++)
+            w->passes[j] = buffer_create(1);
+
+        // the first worker is the backends thread
+        if(!i) continue;
+
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "BACKENDS_WORKER[%zu]", i);
+
+        if(netdata_thread_create(&w->thread, tag, NETDATA_THREAD_OPTION_JOINABLE, backend_worker_thread, w)) {
+            error("BACKEND: failed to create the formatting thread %zu.", i);
+            break;
+        }
+
+        w->thread_created = 1;
+        bw->count++;
+    }
+}
+
+static void backend_workers_stop(void) {
+    struct backend_workers *bw = &backend_workers;
+    size_t i, j;
+
+    netdata_mutex_lock(&bw->mutex);
+    bw->stop = 1;
+    pthread_cond_broadcast(&bw->cond);
+    netdata_mutex_unlock(&bw->mutex);
+
+    for(i = 0; i < bw->workers_allocated ; i++) {
+        struct backend_worker *w = &bw->workers[i];
+
+        if(w->thread_created) {
+            void *result;
+            netdata_thread_join(w->thread, &result);
+        }
+
+        if(w->passes) {
+            for(j = 0; j < bw->instances ; j++)
+                buffer_free(w->passes[j]);
+            freez(w->passes);
+        }
+        freez(w->passes_metrics);
+        backend_snapshot_free(&w->snapshot);
+    }
+
+    freez(bw->workers);
+    bw->workers = NULL;
+    bw->workers_allocated = bw->count = 0;
+
+    freez(bw->hosts);
+    bw->hosts = NULL;
+    bw->hosts_used = bw->hosts_size = 0;
+}
+
 static void backends_main_cleanup(void *ptr) {
     struct netdata_static_thread *static_thread = (struct netdata_static_thread *)ptr;
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITING;
 
     info("cleaning up...");
 
+    struct backend_instance *inst;
+    int do_kinesis = 0, do_prometheus_remote_write = 0;
+
+    backend_workers_stop();
+
+    // the threads of the backends wait for the passes without being cancelable
+    for(inst = backend_instances; inst ; inst = inst->next) {
+        netdata_mutex_lock(&inst->mutex);
+        inst->stop = 1;
+        pthread_cond_signal(&inst->cond);
+        netdata_mutex_unlock(&inst->mutex);
+
+        if(inst->thread_created)
+            netdata_thread_cancel(inst->thread);
+    }
+
+    while(backend_instances) {
+        inst = backend_instances;
+        backend_instances = inst->next;
+
+        if(inst->thread_created) {
+            void *result;
+            netdata_thread_join(inst->thread, &result);
+        }
+
+        do_kinesis |= inst->do_kinesis;
+        do_prometheus_remote_write |= inst->do_prometheus_remote_write;
+        backend_instance_free(inst);
+    }
+
+#if HAVE_KINESIS
+    if(do_kinesis)
+        kinesis_shutdown();
+#endif
+
+#if ENABLE_PROMETHEUS_REMOTE_WRITE
+    if(do_prometheus_remote_write)
+        protocol_buffers_shutdown();
+#endif
+
+    (void)do_kinesis;
+    (void)do_prometheus_remote_write;
+
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
 
@@ -254,21 +894,24 @@ static void backends_main_cleanup(void *ptr) {
  * @param default_port  the default port of the backend
  * @param brc function called to check the result.
  * @param brf function called to format the msessage to the backend
+ * @param backend_options the options of the backend, the data source selects the formatter
  * @param type the backend string selector.
  */
 void backend_set_kinesis_variables(int *default_port,
                                    backend_response_checker_t brc,
-                                   backend_request_formatter_t brf)
+                                   backend_request_formatter_t brf,
+                                   BACKEND_OPTIONS backend_options)
 {
     (void)default_port;
 #ifndef HAVE_KINESIS
     (void)brc;
     (void)brf;
+    (void)backend_options;
 #endif
 
 #if HAVE_KINESIS
     *brc = process_json_response;
-    if (BACKEND_OPTIONS_DATA_SOURCE(global_backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+    if (BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
         *brf = format_dimension_collected_json_plaintext;
     else
         *brf = format_dimension_stored_json_plaintext;
@@ -283,14 +926,17 @@ void backend_set_kinesis_variables(int *default_port,
  * @param default_port  the default port of the backend
  * @param brc function called to check the result.
  * @param brf function called to format the msessage to the backend
+ * @param backend_options the options of the backend, the data source selects the formatter
  * @param type the backend string selector.
  */
 void backend_set_prometheus_variables(int *default_port,
                                       backend_response_checker_t brc,
-                                      backend_request_formatter_t brf)
+                                      backend_request_formatter_t brf,
+                                      BACKEND_OPTIONS backend_options)
 {
     (void)default_port;
     (void)brf;
+    (void)backend_options;
 #ifndef ENABLE_PROMETHEUS_REMOTE_WRITE
     (void)brc;
 #endif
@@ -308,16 +954,18 @@ void backend_set_prometheus_variables(int *default_port,
  * @param default_port  the default port of the backend
  * @param brc function called to check the result.
  * @param brf function called to format the msessage to the backend
+ * @param backend_options the options of the backend, the data source selects the formatter
  * @param type the backend string selector.
  */
 void backend_set_json_variables(int *default_port,
                                 backend_response_checker_t brc,
-                                backend_request_formatter_t brf)
+                                backend_request_formatter_t brf,
+                                BACKEND_OPTIONS backend_options)
 {
     *default_port = 5448;
     *brc = process_json_response;
 
-    if (BACKEND_OPTIONS_DATA_SOURCE(global_backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+    if (BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
         *brf = format_dimension_collected_json_plaintext;
     else
         *brf = format_dimension_stored_json_plaintext;
@@ -331,16 +979,18 @@ void backend_set_json_variables(int *default_port,
  * @param default_port  the default port of the backend
  * @param brc function called to check the result.
  * @param brf function called to format the msessage to the backend
+ * @param backend_options the options of the backend, the data source selects the formatter
  * @param type the backend string selector.
  */
 void backend_set_opentsdb_http_variables(int *default_port,
                                          backend_response_checker_t brc,
-                                         backend_request_formatter_t brf)
+                                         backend_request_formatter_t brf,
+                                         BACKEND_OPTIONS backend_options)
 {
     *default_port = 4242;
     *brc = process_opentsdb_response;
 
-    if(BACKEND_OPTIONS_DATA_SOURCE(global_backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+    if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
         *brf = format_dimension_collected_opentsdb_http;
     else
         *brf = format_dimension_stored_opentsdb_http;
@@ -355,16 +1005,18 @@ void backend_set_opentsdb_http_variables(int *default_port,
  * @param default_port  the default port of the backend
  * @param brc function called to check the result.
  * @param brf function called to format the msessage to the backend
+ * @param backend_options the options of the backend, the data source selects the formatter
  * @param type the backend string selector.
  */
 void backend_set_opentsdb_telnet_variables(int *default_port,
                                            backend_response_checker_t brc,
-                                           backend_request_formatter_t brf)
+                                           backend_request_formatter_t brf,
+                                           BACKEND_OPTIONS backend_options)
 {
     *default_port = 4242;
     *brc = process_opentsdb_response;
 
-    if(BACKEND_OPTIONS_DATA_SOURCE(global_backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+    if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
         *brf = format_dimension_collected_opentsdb_telnet;
     else
         *brf = format_dimension_stored_opentsdb_telnet;
@@ -378,16 +1030,18 @@ void backend_set_opentsdb_telnet_variables(int *default_port,
  * @param default_port  the default port of the backend
  * @param brc function called to check the result.
  * @param brf function called to format the msessage to the backend
+ * @param backend_options the options of the backend, the data source selects the formatter
  * @param type the backend string selector.
  */
 void backend_set_graphite_variables(int *default_port,
                                     backend_response_checker_t brc,
-                                    backend_request_formatter_t brf)
+                                    backend_request_formatter_t brf,
+                                    BACKEND_OPTIONS backend_options)
 {
     *default_port = 2003;
     *brc = process_graphite_response;
 
-    if(BACKEND_OPTIONS_DATA_SOURCE(global_backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+    if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
         *brf = format_dimension_collected_graphite_plaintext;
     else
         *brf = format_dimension_stored_graphite_plaintext;
@@ -425,138 +1079,171 @@ BACKEND_TYPE backend_select_type(const char *type) {
     return BACKEND_TYPE_UNKNOWN;
 }
 
-/**
- * Backend main
- *
- * The main thread used to control the backedns.
- *
- * @param ptr a pointer to netdata_static_structure.
- *
- * @return It always return NULL.
- */
-void *backends_main(void *ptr) {
-    netdata_thread_cleanup_push(backends_main_cleanup, ptr);
-
-    int default_port = 0;
-    int sock = -1;
-    BUFFER *b = buffer_create(1), *response = buffer_create(1);
-    int (*backend_request_formatter)(BUFFER *, const char *, RRDHOST *, const char *, RRDSET *, RRDDIM *, time_t, time_t, BACKEND_OPTIONS) = NULL;
-    int (*backend_response_checker)(BUFFER *) = NULL;
+// reads the configuration of the backend of section [backend] (name is NULL) or [backend:name]
+// the backends of the instances get the settings of [backend] they do not have
+// returns NULL when it is not enabled
+static struct backend_instance *backend_instance_create(const char *name, struct backend_instance *defaults) {
+    char section[CONFIG_MAX_NAME + 1];
 
-#if HAVE_KINESIS
-    int do_kinesis = 0;
-    char *kinesis_auth_key_id = NULL, *kinesis_secure_key = NULL, *kinesis_stream_name = NULL;
-#endif
+    if(name)
+        snprintfz(section, CONFIG_MAX_NAME, "%s:%s", CONFIG_SECTION_BACKEND, name);
+    else
+        strncpyz(section, CONFIG_SECTION_BACKEND, CONFIG_MAX_NAME);
 
-#if ENABLE_PROMETHEUS_REMOTE_WRITE
-    int do_prometheus_remote_write = 0;
-    BUFFER *http_request_header = buffer_create(1);
-#endif
+    int enabled = config_get_boolean(section, "enabled", (name)?1:0);
 
+    struct backend_instance *inst = callocz(1, sizeof(struct backend_instance));
+    inst->name = (name)?strdupz(name):NULL;
+    inst->section = strdupz(section);
+    inst->sock = -1;
+    netdata_mutex_init(&inst->mutex);
+    pthread_cond_init(&inst->cond, NULL);
 #ifdef ENABLE_HTTPS
-            struct netdata_ssl opentsdb_ssl = {NULL , NETDATA_SSL_START};
+    inst->opentsdb_ssl.flags = NETDATA_SSL_START;
 #endif
 
-    // ------------------------------------------------------------------------
-    // collect configuration options
-
-    struct timeval timeout = {
-            .tv_sec = 0,
-            .tv_usec = 0
-    };
-    int enabled                 = config_get_boolean(CONFIG_SECTION_BACKEND, "enabled", 0);
-    const char *source          = config_get(CONFIG_SECTION_BACKEND, "data source", "average");
-    const char *type            = config_get(CONFIG_SECTION_BACKEND, "type", "graphite");
-    const char *destination     = config_get(CONFIG_SECTION_BACKEND, "destination", "localhost");
-    global_backend_prefix       = config_get(CONFIG_SECTION_BACKEND, "prefix", "netdata");
-    const char *hostname        = config_get(CONFIG_SECTION_BACKEND, "hostname", localhost->hostname);
-    global_backend_update_every = (int)config_get_number(CONFIG_SECTION_BACKEND, "update every", global_backend_update_every);
-    int buffer_on_failures      = (int)config_get_number(CONFIG_SECTION_BACKEND, "buffer on failures", 10);
-    long timeoutms              = config_get_number(CONFIG_SECTION_BACKEND, "timeout ms", global_backend_update_every * 2 * 1000);
-
-    if(config_get_boolean(CONFIG_SECTION_BACKEND, "send names instead of ids", (global_backend_options & BACKEND_OPTION_SEND_NAMES)))
-        global_backend_options |= BACKEND_OPTION_SEND_NAMES;
-    else
-        global_backend_options &= ~BACKEND_OPTION_SEND_NAMES;
-
-    charts_pattern = simple_pattern_create(config_get(CONFIG_SECTION_BACKEND, "send charts matching", "*"), NULL, SIMPLE_PATTERN_EXACT);
-    hosts_pattern  = simple_pattern_create(config_get(CONFIG_SECTION_BACKEND, "send hosts matching", "localhost *"), NULL, SIMPLE_PATTERN_EXACT);
+    long timeoutms;
+    if(!defaults) {
+        inst->source                = config_get(section, "data source", "average");
+        inst->type                  = config_get(section, "type", "graphite");
+        inst->destination           = config_get(section, "destination", "localhost");
+        global_backend_prefix       = config_get(section, "prefix", "netdata");
+        inst->prefix                = global_backend_prefix;
+        inst->hostname              = config_get(section, "hostname", localhost->hostname);
+        global_backend_update_every = (int)config_get_number(section, "update every", global_backend_update_every);
+        inst->buffer_on_failures    = (int)config_get_number(section, "buffer on failures", 10);
+        inst->buffer_size           = (size_t)config_get_number(section, "buffer size bytes", 0);
+        timeoutms                   = config_get_number(section, "timeout ms", global_backend_update_every * 2 * 1000);
+        inst->only_changed          = config_get_boolean(section, "send only changed values", 0);
+        inst->resend_every          = (time_t)config_get_number(section, "resend unchanged values every", 600);
+
+        if(config_get_boolean(section, "send names instead of ids", (global_backend_options & BACKEND_OPTION_SEND_NAMES)))
+            global_backend_options |= BACKEND_OPTION_SEND_NAMES;
+        else
+            global_backend_options &= ~BACKEND_OPTION_SEND_NAMES;
+
+        global_backend_options = backend_parse_data_source(inst->source, global_backend_options);
+        inst->options = global_backend_options;
+    }
+    else {
+        inst->source                = config_get(section, "data source", defaults->source);
+        inst->type                  = config_get(section, "type", defaults->type);
+        inst->destination           = config_get(section, "destination", defaults->destination);
+        inst->prefix                = config_get(section, "prefix", defaults->prefix);
+        inst->hostname              = config_get(section, "hostname", defaults->hostname);
+        inst->buffer_on_failures    = (int)config_get_number(section, "buffer on failures", defaults->buffer_on_failures);
+        inst->buffer_size           = (size_t)config_get_number(section, "buffer size bytes", (long long)defaults->buffer_size);
+        timeoutms                   = config_get_number(section, "timeout ms", defaults->timeout.tv_sec * 1000 + defaults->timeout.tv_usec / 1000);
+        inst->only_changed          = config_get_boolean(section, "send only changed values", defaults->only_changed);
+        inst->resend_every          = (time_t)config_get_number(section, "resend unchanged values every", (long long)defaults->resend_every);
+
+        inst->options = defaults->options;
+        if(config_get_boolean(section, "send names instead of ids", (inst->options & BACKEND_OPTION_SEND_NAMES)))
+            inst->options |= BACKEND_OPTION_SEND_NAMES;
+        else
+            inst->options &= ~BACKEND_OPTION_SEND_NAMES;
+
+        inst->options = backend_parse_data_source(inst->source, inst->options);
+    }
 
 #if ENABLE_PROMETHEUS_REMOTE_WRITE
-    const char *remote_write_path = config_get(CONFIG_SECTION_BACKEND, "remote write URL path", "/receive");
+    inst->remote_write_path = config_get(section, "remote write URL path", (defaults)?defaults->remote_write_path:"/receive");
 #endif
 
-    // ------------------------------------------------------------------------
-    // validate configuration options
-    // and prepare for sending data to our backend
-
-    global_backend_options = backend_parse_data_source(source, global_backend_options);
-
     if(timeoutms < 1) {
         error("BACKEND: invalid timeout %ld ms given. Assuming %d ms.", timeoutms, global_backend_update_every * 2 * 1000);
         timeoutms = global_backend_update_every * 2 * 1000;
     }
-    timeout.tv_sec  = (timeoutms * 1000) / 1000000;
-    timeout.tv_usec = (timeoutms * 1000) % 1000000;
+    inst->timeout.tv_sec  = (timeoutms * 1000) / 1000000;
+    inst->timeout.tv_usec = (timeoutms * 1000) % 1000000;
 
-    if(!enabled || global_backend_update_every < 1)
-        goto cleanup;
+    if(!enabled || global_backend_update_every < 1) {
+        // the [backend] section is kept, for the defaults of the instances
+        if(!defaults) return inst;
+
+        backend_instance_free(inst);
+        return NULL;
+    }
+
+    inst->pass = buffer_create(1);
+    inst->pending = buffer_create(1);
+    inst->response = buffer_create(1);
+
+    return inst;
+}
+
+// selects the formatters of the backend, returns 0 on success
+static int backend_instance_setup(struct backend_instance *inst) {
+    static int kinesis_backends = 0, prometheus_remote_write_backends = 0;
 
     // ------------------------------------------------------------------------
     // select the backend type
-    BACKEND_TYPE work_type = backend_select_type(type);
-    if (work_type == BACKEND_TYPE_UNKNOWN) {
-        error("BACKEND: Unknown backend type '%s'", type);
-        goto cleanup;
+    inst->work_type = backend_select_type(inst->type);
+    if (inst->work_type == BACKEND_TYPE_UNKNOWN) {
+        error("BACKEND: Unknown backend type '%s'", inst->type);
+        return 1;
     }
 
-    switch (work_type) {
+    switch (inst->work_type) {
         case BACKEND_TYPE_OPENTSDB_USING_HTTP: {
 #ifdef ENABLE_HTTPS
-            if (!strcmp(type, "opentsdb:https")) {
+            if (!strcmp(inst->type, "opentsdb:https") && !netdata_opentsdb_ctx) {
                 security_start_ssl(NETDATA_SSL_CONTEXT_OPENTSDB);
             }
 #endif
-            backend_set_opentsdb_http_variables(&default_port,&backend_response_checker,&backend_request_formatter);
+            backend_set_opentsdb_http_variables(&inst->default_port,&inst->response_checker,&inst->request_formatter,inst->options);
             break;
         }
         case BACKEND_TYPE_PROMETEUS: {
 #if ENABLE_PROMETHEUS_REMOTE_WRITE
-            do_prometheus_remote_write = 1;
+            // the write request is built in a single place
+            if(prometheus_remote_write_backends++) {
+                error("BACKEND: only one prometheus remote write backend is supported - disabling backend '%s'.", inst->section);
+                return 1;
+            }
+
+            inst->do_prometheus_remote_write = 1;
+            inst->remote_write_data = buffer_create(1);
 
             init_write_request();
 #else
             error("BACKEND: Prometheus remote write support isn't compiled");
 #endif // ENABLE_PROMETHEUS_REMOTE_WRITE
-            backend_set_prometheus_variables(&default_port,&backend_response_checker,&backend_request_formatter);
+            backend_set_prometheus_variables(&inst->default_port,&inst->response_checker,&inst->request_formatter,inst->options);
             break;
         }
         case BACKEND_TYPE_KINESIS: {
 #if HAVE_KINESIS
-            do_kinesis = 1;
+            // the kinesis client is a single one
+            if(kinesis_backends++) {
+                error("BACKEND: only one kinesis backend is supported - disabling backend '%s'.", inst->section);
+                return 1;
+            }
+
+            inst->do_kinesis = 1;
 
-            if(unlikely(read_kinesis_conf(netdata_configured_user_config_dir, &kinesis_auth_key_id, &kinesis_secure_key, &kinesis_stream_name))) {
+            if(unlikely(read_kinesis_conf(netdata_configured_user_config_dir, &inst->kinesis_auth_key_id, &inst->kinesis_secure_key, &inst->kinesis_stream_name))) {
                 error("BACKEND: kinesis backend type is set but cannot read its configuration from %s/aws_kinesis.conf", netdata_configured_user_config_dir);
-                goto cleanup;
+                return 1;
             }
 
-            kinesis_init(destination, kinesis_auth_key_id, kinesis_secure_key, timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+            kinesis_init(inst->destination, inst->kinesis_auth_key_id, inst->kinesis_secure_key, inst->timeout.tv_sec * 1000 + inst->timeout.tv_usec / 1000);
 #else
             error("BACKEND: AWS Kinesis support isn't compiled");
 #endif // HAVE_KINESIS
-            backend_set_kinesis_variables(&default_port,&backend_response_checker,&backend_request_formatter);
+            backend_set_kinesis_variables(&inst->default_port,&inst->response_checker,&inst->request_formatter,inst->options);
             break;
         }
         case BACKEND_TYPE_GRAPHITE: {
-            backend_set_graphite_variables(&default_port,&backend_response_checker,&backend_request_formatter);
+            backend_set_graphite_variables(&inst->default_port,&inst->response_checker,&inst->request_formatter,inst->options);
             break;
         }
         case BACKEND_TYPE_OPENTSDB_USING_TELNET: {
-            backend_set_opentsdb_telnet_variables(&default_port,&backend_response_checker,&backend_request_formatter);
+            backend_set_opentsdb_telnet_variables(&inst->default_port,&inst->response_checker,&inst->request_formatter,inst->options);
             break;
         }
         case BACKEND_TYPE_JSON: {
-            backend_set_json_variables(&default_port,&backend_response_checker,&backend_request_formatter);
+            backend_set_json_variables(&inst->default_port,&inst->response_checker,&inst->request_formatter,inst->options);
             break;
         }
         case BACKEND_TYPE_UNKNOWN: {
@@ -564,48 +1251,224 @@ void *backends_main(void *ptr) {
         }
     }
 
+    (void)kinesis_backends;
+    (void)prometheus_remote_write_backends;
+
+    if((inst->request_formatter == NULL && !inst->do_prometheus_remote_write) || inst->response_checker == NULL) {
+        error("BACKEND: backend '%s' is misconfigured - disabling it.", inst->section);
+        return 1;
+    }
+
+    return 0;
+}
+
 #if ENABLE_PROMETHEUS_REMOTE_WRITE
-    if((backend_request_formatter == NULL && !do_prometheus_remote_write) || backend_response_checker == NULL) {
-#else
-    if(backend_request_formatter == NULL || backend_response_checker == NULL) {
-#endif
-        error("BACKEND: backend is misconfigured - disabling it.");
-        goto cleanup;
+// the write request of the pass becomes an HTTP request in the pass buffer of the backend
+// returns 0 on success
+static int backend_instance_pack_write_request(struct backend_instance *inst) {
+    size_t data_size = get_write_request_size();
+
+    if(unlikely(!data_size)) {
+        error("BACKEND: write request size is out of range");
+        return 1;
     }
 
+    BUFFER *data = inst->remote_write_data;
+    buffer_flush(data);
+    buffer_need_bytes(data, data_size);
+    if(unlikely(pack_write_request(data->buffer, &data_size))) {
+        error("BACKEND: cannot pack write request");
+        return 1;
+    }
+    data->len = data_size;
+
+    buffer_sprintf(inst->pass,
+                   "POST %s HTTP/1.1\r\n"
+                   "Host: %s\r\n"
+                   "Accept: */*\r\n"
+                   "Content-Length: %zu\r\n"
+                   "Content-Type: application/x-www-form-urlencoded\r\n\r\n",
+                   inst->remote_write_path,
+                   inst->hostname,
+                   data_size
+    );
+
+    buffer_need_bytes(inst->pass, data_size);
+    memcpy(&inst->pass->buffer[inst->pass->len], data->buffer, data_size);
+    inst->pass->len += data_size;
+    return 0;
+}
+#endif
 
-// ------------------------------------------------------------------------
-// prepare the charts for monitoring the backend operation
+// gives the metrics of the pass to the thread of the backend
+static void backend_instance_pass_done(struct backend_instance *inst) {
+    BUFFER *pass = inst->pass;
 
-    struct rusage thread;
+    netdata_mutex_lock(&inst->mutex);
 
-    collected_number
-        chart_buffered_metrics = 0,
-        chart_lost_metrics = 0,
-        chart_sent_metrics = 0,
-        chart_buffered_bytes = 0,
-        chart_received_bytes = 0,
-        chart_sent_bytes = 0,
-        chart_receptions = 0,
-        chart_transmission_successes = 0,
-        chart_transmission_failures = 0,
-        chart_data_lost_events = 0,
-        chart_lost_bytes = 0,
-        chart_backend_reconnects = 0;
-        // chart_backend_latency = 0;
+    // the thread has been busy for too long, do not keep more than it would
+    if(inst->pending_passes > inst->buffer_on_failures) {
+        if(!inst->discarded_passes)
+            error("BACKEND: backend '%s' has not taken the metrics of %d passes. Discarding them.", inst->section, inst->pending_passes);
 
-    RRDSET *chart_metrics = rrdset_create_localhost("netdata", "backend_metrics", NULL, "backend", NULL, "Netdata Buffered Metrics", "metrics", "backends", NULL, 130600, global_backend_update_every, RRDSET_TYPE_LINE);
-    rrddim_add(chart_metrics, "buffered", NULL,  1, 1, RRD_ALGORITHM_ABSOLUTE);
-    rrddim_add(chart_metrics, "lost",     NULL,  1, 1, RRD_ALGORITHM_ABSOLUTE);
+        inst->discarded_metrics += inst->pending_metrics;
+        inst->discarded_bytes += (collected_number)buffer_strlen(inst->pending);
+        inst->discarded_passes += inst->pending_passes;
+        inst->pending_metrics = 0;
+        inst->pending_passes = 0;
+        buffer_flush(inst->pending);
+    }
+
+    buffer_need_bytes(inst->pending, buffer_strlen(pass));
+    memcpy(&inst->pending->buffer[inst->pending->len], pass->buffer, buffer_strlen(pass));
+    inst->pending->len += buffer_strlen(pass);
+    inst->pending_metrics += inst->pass_metrics;
+    inst->pending_passes++;
+
+    pthread_cond_signal(&inst->cond);
+    netdata_mutex_unlock(&inst->mutex);
+
+    buffer_flush(pass);
+    inst->pass_metrics = 0;
+}
+
+// ----------------------------------------------------------------------------
+// the batches of a backend
+//
+// The thread of a backend keeps the passes it has taken in a queue of batches,
+// and sends them without blocking, so that it keeps taking the passes of the
+// backends thread while the backend is slow. The first batch is the one in
+// flight. When the connection fails, the batch in flight is sent again, from its
+// beginning, on the next connection. The oldest batches not in flight are dropped
+// when the queue has more than `buffer on failures` passes, or more than
+// `buffer size bytes` bytes.
+
+// how long the thread waits for the socket to be writable, before it checks for new passes
+#define BACKEND_SEND_POLL_MS 100
+
+static void backend_batch_recycle(struct backend_instance *inst, struct backend_batch *batch) {
+    inst->batches_bytes -= buffer_strlen(batch->b);
+    inst->batches_passes -= batch->passes;
+
+    buffer_flush(batch->b);
+    batch->sent = 0;
+    batch->metrics = 0;
+    batch->passes = 0;
+    batch->next = inst->spare;
+    inst->spare = batch;
+}
+
+// takes the metrics of the passes given to the thread, the mutex has to be locked
+static void backend_batch_take_pending(struct backend_instance *inst) {
+    if(unlikely(!buffer_strlen(inst->pending)))
+        return;
+
+    struct backend_batch *batch = inst->spare;
+
+    if(batch) inst->spare = batch->next;
+    else {
+        batch = callocz(1, sizeof(struct backend_batch));
+        batch->b = buffer_create(1);
+    }
+
+    // the batch gets the buffer of the passes, the passes get the empty one of the batch
+    BUFFER *b = batch->b;
+    batch->b = inst->pending;
+    inst->pending = b;
+
+    batch->sent = 0;
+    batch->metrics = inst->pending_metrics;
+    batch->passes = inst->pending_passes;
+    batch->next = NULL;
+
+    struct backend_batch **last = &inst->batches;
+    while(*last) last = &(*last)->next;
+    *last = batch;
+
+    inst->batches_bytes += buffer_strlen(batch->b);
+    inst->batches_passes += batch->passes;
+}
+
+// drops the oldest batches not in flight, while the thread keeps more than it may
+static void backend_batch_drop_old(struct backend_instance *inst, collected_number *lost_metrics, collected_number *lost_bytes, collected_number *data_lost_events) {
+    struct backend_batch **bb = &inst->batches;
+
+    // the backend should not receive a part of the batch in flight
+    if(*bb && (*bb)->sent) bb = &(*bb)->next;
+
+    int dropped = 0;
+    while(*bb && (inst->batches_passes > inst->buffer_on_failures || (inst->buffer_size && inst->batches_bytes > inst->buffer_size))) {
+        struct backend_batch *batch = *bb;
+        *bb = batch->next;
+
+        *lost_metrics += batch->metrics;
+        *lost_bytes += (collected_number)buffer_strlen(batch->b);
+        dropped += batch->passes;
+
+        backend_batch_recycle(inst, batch);
+    }
+
+    if(unlikely(dropped)) {
+        error("BACKEND: backend '%s' on '%s' has not received the metrics of %d passes. Dropping them - this results in data loss on the backend.", inst->section, inst->destination, dropped);
+        (*data_lost_events)++;
+    }
+}
+
+/**
+ * Backend instance thread
+ *
+ * The thread of a backend, it sends the metrics of the passes of the backends thread.
+ *
+ * @param ptr a pointer to the backend_instance.
+ *
+ * @return It always return NULL.
+ */
+static void *backend_instance_thread(void *ptr) {
+    struct backend_instance *inst = ptr;
+    BUFFER *response = inst->response;
+    const char *destination = inst->destination;
+
+    // ------------------------------------------------------------------------
+    // prepare the charts for monitoring the backend operation
+
+    char id[RRD_ID_LENGTH_MAX + 1], family[RRD_ID_LENGTH_MAX + 1];
+    const char *family_name = "backend";
+    if(inst->name) {
+        snprintfz(family, RRD_ID_LENGTH_MAX, "backend %s", inst->name);
+        family_name = family;
+    }
+
+#define backend_chart_id(suffix) (inst->name ? (snprintfz(id, RRD_ID_LENGTH_MAX, "backend_%s_%s", inst->name, suffix), id) : "backend_" suffix)
+
+    struct rusage thread;
+
+    collected_number
+        chart_buffered_metrics = 0,
+        chart_lost_metrics = 0,
+        chart_sent_metrics = 0,
+        chart_buffered_bytes = 0,
+        chart_received_bytes = 0,
+        chart_sent_bytes = 0,
+        chart_receptions = 0,
+        chart_transmission_successes = 0,
+        chart_transmission_failures = 0,
+        chart_data_lost_events = 0,
+        chart_lost_bytes = 0,
+        chart_backend_reconnects = 0;
+        // chart_backend_latency = 0;
+
+    RRDSET *chart_metrics = rrdset_create_localhost("netdata", backend_chart_id("metrics"), NULL, family_name, NULL, "Netdata Buffered Metrics", "metrics", "backends", NULL, 130600, global_backend_update_every, RRDSET_TYPE_LINE);
+    rrddim_add(chart_metrics, "buffered", NULL,  1, 1, RRD_ALGORITHM_ABSOLUTE);
+    rrddim_add(chart_metrics, "lost",     NULL,  1, 1, RRD_ALGORITHM_ABSOLUTE);
     rrddim_add(chart_metrics, "sent",     NULL,  1, 1, RRD_ALGORITHM_ABSOLUTE);
 
-    RRDSET *chart_bytes = rrdset_create_localhost("netdata", "backend_bytes", NULL, "backend", NULL, "Netdata Backend Data Size", "KiB", "backends", NULL, 130610, global_backend_update_every, RRDSET_TYPE_AREA);
+    RRDSET *chart_bytes = rrdset_create_localhost("netdata", backend_chart_id("bytes"), NULL, family_name, NULL, "Netdata Backend Data Size", "KiB", "backends", NULL, 130610, global_backend_update_every, RRDSET_TYPE_AREA);
     rrddim_add(chart_bytes, "buffered", NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
     rrddim_add(chart_bytes, "lost",     NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
     rrddim_add(chart_bytes, "sent",     NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
     rrddim_add(chart_bytes, "received", NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
 
-    RRDSET *chart_ops = rrdset_create_localhost("netdata", "backend_ops", NULL, "backend", NULL, "Netdata Backend Operations", "operations", "backends", NULL, 130630, global_backend_update_every, RRDSET_TYPE_LINE);
+    RRDSET *chart_ops = rrdset_create_localhost("netdata", backend_chart_id("ops"), NULL, family_name, NULL, "Netdata Backend Operations", "operations", "backends", NULL, 130630, global_backend_update_every, RRDSET_TYPE_LINE);
     rrddim_add(chart_ops, "write",     NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
     rrddim_add(chart_ops, "discard",   NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
     rrddim_add(chart_ops, "reconnect", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
@@ -623,216 +1486,148 @@ void *backends_main(void *ptr) {
     rrddim_add(chart_latency, "latency",   NULL,  1, 1000, RRD_ALGORITHM_ABSOLUTE);
     */
 
-    RRDSET *chart_rusage = rrdset_create_localhost("netdata", "backend_thread_cpu", NULL, "backend", NULL, "NetData Backend Thread CPU usage", "milliseconds/s", "backends", NULL, 130630, global_backend_update_every, RRDSET_TYPE_STACKED);
+    RRDSET *chart_rusage = rrdset_create_localhost("netdata", backend_chart_id("thread_cpu"), NULL, family_name, NULL, "NetData Backend Thread CPU usage", "milliseconds/s", "backends", NULL, 130630, global_backend_update_every, RRDSET_TYPE_STACKED);
     rrddim_add(chart_rusage, "user",   NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
     rrddim_add(chart_rusage, "system", NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
 
+#undef backend_chart_id
 
-    // ------------------------------------------------------------------------
-    // prepare the backend main loop
+#if HAVE_KINESIS
+    unsigned long long kinesis_partition_key_seq = 0;
+    collected_number kinesis_sent_metrics = 0;           // the metrics and the bytes given to the kinesis client so far
+    size_t kinesis_sent_bytes = 0;
+#endif
 
-    info("BACKEND: configured ('%s' on '%s' sending '%s' data, every %d seconds, as host '%s', with prefix '%s')", type, destination, source, global_backend_update_every, hostname, global_backend_prefix);
+    int wait_for_pass = 1;
+    usec_t timeout_ut = inst->timeout.tv_sec * USEC_PER_SEC + inst->timeout.tv_usec, last_progress_ut = 0;
 
-    usec_t step_ut = global_backend_update_every * USEC_PER_SEC;
-    time_t after = now_realtime_sec();
-    int failures = 0;
-    heartbeat_t hb;
-    heartbeat_init(&hb);
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags += MSG_NOSIGNAL;
+#endif
 
     while(!netdata_exit) {
 
         // ------------------------------------------------------------------------
-        // Wait for the next iteration point.
-
-        heartbeat_next(&hb, step_ut);
-        time_t before = now_realtime_sec();
-        debug(D_BACKEND, "BACKEND: preparing buffer for timeframe %lu to %lu", (unsigned long)after, (unsigned long)before);
-
-        // ------------------------------------------------------------------------
-        // add to the buffer the data we need to send to the backend
+        // take the metrics of the passes given, waiting for them when there
+        // is nothing to send, or the backend cannot be connected
 
         netdata_thread_disable_cancelability();
+        netdata_mutex_lock(&inst->mutex);
 
-        size_t count_hosts = 0;
-        size_t count_charts_total = 0;
-        size_t count_dims_total = 0;
-
-#if ENABLE_PROMETHEUS_REMOTE_WRITE
-        clear_write_request();
-#endif
-        rrd_rdlock();
-        RRDHOST *host;
-        rrdhost_foreach_read(host) {
-            if(unlikely(!rrdhost_flag_check(host, RRDHOST_FLAG_BACKEND_SEND|RRDHOST_FLAG_BACKEND_DONT_SEND))) {
-                char *name = (host == localhost)?"localhost":host->hostname;
-                if (!hosts_pattern || simple_pattern_matches(hosts_pattern, name)) {
-                    rrdhost_flag_set(host, RRDHOST_FLAG_BACKEND_SEND);
-                    info("enabled backend for host '%s'", name);
-                }
-                else {
-                    rrdhost_flag_set(host, RRDHOST_FLAG_BACKEND_DONT_SEND);
-                    info("disabled backend for host '%s'", name);
-                }
-            }
-
-            if(unlikely(!rrdhost_flag_check(host, RRDHOST_FLAG_BACKEND_SEND)))
-                continue;
-
-            rrdhost_rdlock(host);
-
-            count_hosts++;
-            size_t count_charts = 0;
-            size_t count_dims = 0;
-            size_t count_dims_skipped = 0;
-
-            const char *__hostname = (host == localhost)?hostname:host->hostname;
+        if(!inst->batches || wait_for_pass) {
+            while(!inst->pending_passes && !inst->stop)
+                pthread_cond_wait(&inst->cond, &inst->mutex);
+        }
 
-#if ENABLE_PROMETHEUS_REMOTE_WRITE
-            if(do_prometheus_remote_write) {
-                rrd_stats_remote_write_allmetrics_prometheus(
-                    host
-                    , __hostname
-                    , global_backend_prefix
-                    , global_backend_options
-                    , after
-                    , before
-                    , &count_charts
-                    , &count_dims
-                    , &count_dims_skipped
-                );
-                chart_buffered_metrics += count_dims;
-            }
-            else
-#endif
-            {
-                RRDSET *st;
-                rrdset_foreach_read(st, host) {
-                    if(likely(backends_can_send_rrdset(global_backend_options, st))) {
-                        rrdset_rdlock(st);
-
-                        count_charts++;
-
-                        RRDDIM *rd;
-                        rrddim_foreach_read(rd, st) {
-                            if (likely(rd->last_collected_time.tv_sec >= after)) {
-                                chart_buffered_metrics += backend_request_formatter(b, global_backend_prefix, host, __hostname, st, rd, after, before, global_backend_options);
-                                count_dims++;
-                            }
-                            else {
-                                debug(D_BACKEND, "BACKEND: not sending dimension '%s' of chart '%s' from host '%s', its last data collection (%lu) is not within our timeframe (%lu to %lu)", rd->id, st->id, __hostname, (unsigned long)rd->last_collected_time.tv_sec, (unsigned long)after, (unsigned long)before);
-                                count_dims_skipped++;
-                            }
-                        }
+        if(unlikely(inst->stop)) {
+            netdata_mutex_unlock(&inst->mutex);
+            netdata_thread_enable_cancelability();
+            break;
+        }
 
-                        rrdset_unlock(st);
-                    }
-                }
+        int new_passes = inst->pending_passes;
+        if(new_passes) {
+            // the passes the backends thread has discarded, while we were busy
+            if(unlikely(inst->discarded_passes)) {
+                chart_lost_metrics += inst->discarded_metrics;
+                chart_lost_bytes += inst->discarded_bytes;
+                chart_data_lost_events++;
+                inst->discarded_metrics = inst->discarded_bytes = 0;
+                inst->discarded_passes = 0;
             }
 
-            debug(D_BACKEND, "BACKEND: sending host '%s', metrics of %zu dimensions, of %zu charts. Skipped %zu dimensions.", __hostname, count_dims, count_charts, count_dims_skipped);
-            count_charts_total += count_charts;
-            count_dims_total += count_dims;
+            backend_batch_take_pending(inst);
 
-            rrdhost_unlock(host);
+            inst->pending_metrics = 0;
+            inst->pending_passes = 0;
+            wait_for_pass = 0;
         }
-        rrd_unlock();
 
+        netdata_mutex_unlock(&inst->mutex);
         netdata_thread_enable_cancelability();
 
-        debug(D_BACKEND, "BACKEND: buffer has %zu bytes, added metrics for %zu dimensions, of %zu charts, from %zu hosts", buffer_strlen(b), count_dims_total, count_charts_total, count_hosts);
-
-        // ------------------------------------------------------------------------
+        if(unlikely(netdata_exit)) break;
 
-        chart_buffered_bytes = (collected_number)buffer_strlen(b);
+        if(new_passes) {
+            backend_batch_drop_old(inst, &chart_lost_metrics, &chart_lost_bytes, &chart_data_lost_events);
+        }
 
-        // reset the monitoring chart counters
-        chart_received_bytes =
-        chart_sent_bytes =
-        chart_sent_metrics =
-        chart_lost_metrics =
-        chart_receptions =
-        chart_transmission_successes =
-        chart_transmission_failures =
-        chart_data_lost_events =
-        chart_lost_bytes =
-        chart_backend_reconnects = 0;
-        // chart_backend_latency = 0;
+#if HAVE_KINESIS
+        if(inst->do_kinesis) {
+            struct backend_batch *batch;
 
-        if(unlikely(netdata_exit)) break;
+            while((batch = inst->batches)) {
+                BUFFER *b = batch->b;
 
-        //fprintf(stderr, "\nBACKEND BEGIN:\n%s\nBACKEND END\n", buffer_tostring(b));
-        //fprintf(stderr, "after = %lu, before = %lu\n", after, before);
+                size_t buffer_len = buffer_strlen(b);
+                size_t sent = 0;
 
-        // prepare for the next iteration
-        // to add incrementally data to buffer
-        after = before;
+                while(sent < buffer_len) {
+                    // the partition keys continue from pass to pass, to spread the records to all the shards
+                    char partition_key[KINESIS_PARTITION_KEY_MAX + 1];
+                    snprintf(partition_key, KINESIS_PARTITION_KEY_MAX, "netdata_%llu", kinesis_partition_key_seq++);
+                    size_t partition_key_len = strnlen(partition_key, KINESIS_PARTITION_KEY_MAX);
 
-#if HAVE_KINESIS
-        if(do_kinesis) {
-            unsigned long long partition_key_seq = 0;
+                    const char *first_char = buffer_tostring(b) + sent;
 
-            size_t buffer_len = buffer_strlen(b);
-            size_t sent = 0;
+                    size_t record_len = 0;
 
-            while(sent < buffer_len) {
-                char partition_key[KINESIS_PARTITION_KEY_MAX + 1];
-                snprintf(partition_key, KINESIS_PARTITION_KEY_MAX, "netdata_%llu", partition_key_seq++);
-                size_t partition_key_len = strnlen(partition_key, KINESIS_PARTITION_KEY_MAX);
+                    // split buffer into chunks of maximum allowed size
+                    if(buffer_len - sent < KINESIS_RECORD_MAX - partition_key_len) {
+                        record_len = buffer_len - sent;
+                    }
+                    else {
+                        record_len = KINESIS_RECORD_MAX - partition_key_len;
+                        while(*(first_char + record_len) != '\n' && record_len) record_len--;
+                    }
 
-                const char *first_char = buffer_tostring(b) + sent;
+                    debug(D_BACKEND, "BACKEND: kinesis_put_record(): dest = %s, id = %s, key = %s, stream = %s, partition_key = %s, \
+                          buffer = %zu, record = %zu", destination, inst->kinesis_auth_key_id, inst->kinesis_secure_key, inst->kinesis_stream_name,
+                          partition_key, buffer_len, record_len);
 
-                size_t record_len = 0;
+                    // the records are sent in batches, when enough of them have been collected
+                    kinesis_put_record(inst->kinesis_stream_name, partition_key, first_char, record_len);
 
-                // split buffer into chunks of maximum allowed size
-                if(buffer_len - sent < KINESIS_RECORD_MAX - partition_key_len) {
-                    record_len = buffer_len - sent;
+                    sent += record_len;
                 }
-                else {
-                    record_len = KINESIS_RECORD_MAX - partition_key_len;
-                    while(*(first_char + record_len) != '\n' && record_len) record_len--;
-                }
-
-                char error_message[ERROR_LINE_MAX + 1] = "";
 
-                debug(D_BACKEND, "BACKEND: kinesis_put_record(): dest = %s, id = %s, key = %s, stream = %s, partition_key = %s, \
-                      buffer = %zu, record = %zu", destination, kinesis_auth_key_id, kinesis_secure_key, kinesis_stream_name,
-                      partition_key, buffer_len, record_len);
+                chart_sent_bytes += sent;
+                chart_sent_metrics += batch->metrics;
+                kinesis_sent_metrics += batch->metrics;
+                kinesis_sent_bytes += sent;
 
-                kinesis_put_record(kinesis_stream_name, partition_key, first_char, record_len);
+                inst->batches = batch->next;
+                backend_batch_recycle(inst, batch);
 
-                sent += record_len;
-                chart_transmission_successes++;
+                if(unlikely(netdata_exit)) break;
+            }
 
-                size_t sent_bytes = 0, lost_bytes = 0;
+            kinesis_flush(inst->kinesis_stream_name);
 
-                if(unlikely(kinesis_get_result(error_message, &sent_bytes, &lost_bytes))) {
-                    // oops! we couldn't send (all or some of the) data
-                    error("BACKEND: %s", error_message);
-                    error("BACKEND: failed to write data to database backend '%s'. Willing to write %zu bytes, wrote %zu bytes.",
-                          destination, sent_bytes, sent_bytes - lost_bytes);
+            // the requests completed since the last pass
 
-                    chart_transmission_failures++;
-                    chart_data_lost_events++;
-                    chart_lost_bytes += lost_bytes;
+            char error_message[ERROR_LINE_MAX + 1] = "";
+            size_t sent_bytes = 0, lost_bytes = 0, requests_ok = 0, requests_failed = 0;
 
-                    // estimate the number of lost metrics
-                    chart_lost_metrics += (collected_number)(chart_buffered_metrics
-                                          * (buffer_len && (lost_bytes > buffer_len) ? (double)lost_bytes / buffer_len : 1));
+            int failed = kinesis_get_result(error_message, &sent_bytes, &lost_bytes, &requests_ok, &requests_failed);
 
-                    break;
-                }
-                else {
-                    chart_receptions++;
-                }
+            chart_transmission_successes += requests_ok + requests_failed;
+            chart_receptions += requests_ok;
 
-                if(unlikely(netdata_exit)) break;
-            }
+            if(unlikely(failed)) {
+                // oops! we couldn't send (all or some of the) data
+                error("BACKEND: %s", error_message);
+                error("BACKEND: failed to write data to database backend '%s'. Willing to write %zu bytes, wrote %zu bytes.",
+                      destination, sent_bytes, sent_bytes - lost_bytes);
 
-            chart_sent_bytes += sent;
-            if(likely(sent == buffer_len))
-                chart_sent_metrics = chart_buffered_metrics;
+                chart_transmission_failures += requests_failed;
+                chart_data_lost_events++;
+                chart_lost_bytes += lost_bytes;
 
-            buffer_flush(b);
+                // estimate the number of lost metrics, from the metrics per byte given to the client
+                chart_lost_metrics += (collected_number)((kinesis_sent_bytes) ? (double)kinesis_sent_metrics * lost_bytes / kinesis_sent_bytes : 0);
+            }
         }
         else {
 #else
@@ -842,22 +1637,22 @@ void *backends_main(void *ptr) {
             // ------------------------------------------------------------------------
             // if we are connected, receive a response, without blocking
 
-            if(likely(sock != -1)) {
+            if(likely(inst->sock != -1)) {
                 errno = 0;
 
                 // loop through to collect all data
-                while(sock != -1 && errno != EWOULDBLOCK) {
+                while(inst->sock != -1 && errno != EWOULDBLOCK) {
                     buffer_need_bytes(response, 4096);
 
                     ssize_t r;
 #ifdef ENABLE_HTTPS
-                    if(opentsdb_ssl.conn && !opentsdb_ssl.flags) {
-                        r = SSL_read(opentsdb_ssl.conn, &response->buffer[response->len], response->size - response->len);
+                    if(inst->opentsdb_ssl.conn && !inst->opentsdb_ssl.flags) {
+                        r = SSL_read(inst->opentsdb_ssl.conn, &response->buffer[response->len], response->size - response->len);
                     } else {
-                        r = recv(sock, &response->buffer[response->len], response->size - response->len, MSG_DONTWAIT);
+                        r = recv(inst->sock, &response->buffer[response->len], response->size - response->len, MSG_DONTWAIT);
                     }
 #else
-                    r = recv(sock, &response->buffer[response->len], response->size - response->len, MSG_DONTWAIT);
+                    r = recv(inst->sock, &response->buffer[response->len], response->size - response->len, MSG_DONTWAIT);
 #endif
                     if(likely(r > 0)) {
                         // we received some data
@@ -867,8 +1662,8 @@ void *backends_main(void *ptr) {
                     }
                     else if(r == 0) {
                         error("BACKEND: '%s' closed the socket", destination);
-                        close(sock);
-                        sock = -1;
+                        close(inst->sock);
+                        inst->sock = -1;
                     }
                     else {
                         // failed to receive data
@@ -880,43 +1675,46 @@ void *backends_main(void *ptr) {
 
                 // if we received data, process them
                 if(buffer_strlen(response))
-                    backend_response_checker(response);
+                    inst->response_checker(response);
             }
 
             // ------------------------------------------------------------------------
             // if we are not connected, connect to a backend server
 
-            if(unlikely(sock == -1)) {
+            if(unlikely(inst->sock == -1 && inst->batches)) {
                 // usec_t start_ut = now_monotonic_usec();
                 size_t reconnects = 0;
 
-                sock = connect_to_one_of(destination, default_port, &timeout, &reconnects, NULL, 0);
+                // the batch in flight is sent again, from its beginning
+                inst->batches->sent = 0;
+
+                inst->sock = connect_to_one_of(destination, inst->default_port, &inst->timeout, &reconnects, NULL, 0);
 #ifdef ENABLE_HTTPS
-                if(sock != -1) {
+                if(inst->sock != -1) {
                     if(netdata_opentsdb_ctx) {
-                        if(!opentsdb_ssl.conn) {
-                            opentsdb_ssl.conn = SSL_new(netdata_opentsdb_ctx);
-                            if(!opentsdb_ssl.conn) {
-                                error("Failed to allocate SSL structure %d.", sock);
-                                opentsdb_ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
+                        if(!inst->opentsdb_ssl.conn) {
+                            inst->opentsdb_ssl.conn = SSL_new(netdata_opentsdb_ctx);
+                            if(!inst->opentsdb_ssl.conn) {
+                                error("Failed to allocate SSL structure %d.", inst->sock);
+                                inst->opentsdb_ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
                             }
                         } else {
-                            SSL_clear(opentsdb_ssl.conn);
+                            SSL_clear(inst->opentsdb_ssl.conn);
                         }
                     }
 
-                    if(opentsdb_ssl.conn) {
-                        if(SSL_set_fd(opentsdb_ssl.conn, sock) != 1) {
-                            error("Failed to set the socket to the SSL on socket fd %d.", host->rrdpush_sender_socket);
-                            opentsdb_ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
+                    if(inst->opentsdb_ssl.conn) {
+                        if(SSL_set_fd(inst->opentsdb_ssl.conn, inst->sock) != 1) {
+                            error("Failed to set the socket to the SSL on socket fd %d.", inst->sock);
+                            inst->opentsdb_ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
                         } else {
-                            opentsdb_ssl.flags = NETDATA_SSL_HANDSHAKE_COMPLETE;
-                            SSL_set_connect_state(opentsdb_ssl.conn);
-                            int err = SSL_connect(opentsdb_ssl.conn);
+                            inst->opentsdb_ssl.flags = NETDATA_SSL_HANDSHAKE_COMPLETE;
+                            SSL_set_connect_state(inst->opentsdb_ssl.conn);
+                            int err = SSL_connect(inst->opentsdb_ssl.conn);
                             if (err != 1) {
-                                err = SSL_get_error(opentsdb_ssl.conn, err);
-                                error("SSL cannot connect with the server:  %s ", ERR_error_string((long)SSL_get_error(opentsdb_ssl.conn, err), NULL));
-                                opentsdb_ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
+                                err = SSL_get_error(inst->opentsdb_ssl.conn, err);
+                                error("SSL cannot connect with the server:  %s ", ERR_error_string((long)SSL_get_error(inst->opentsdb_ssl.conn, err), NULL));
+                                inst->opentsdb_ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
                             } //TODO: check certificate here
                         }
                     }
@@ -924,132 +1722,109 @@ void *backends_main(void *ptr) {
 #endif
                 chart_backend_reconnects += reconnects;
                 // chart_backend_latency += now_monotonic_usec() - start_ut;
+
+                if(inst->sock != -1) {
+                    last_progress_ut = now_monotonic_usec();
+
+#ifdef ENABLE_HTTPS
+                    // the SSL connections are written blocking, SSL_write() has to be
+                    // repeated with the same data when it cannot write them all
+                    if(!inst->opentsdb_ssl.conn || inst->opentsdb_ssl.flags)
+#endif
+                        if(sock_setnonblock(inst->sock) < 0)
+                            error("BACKEND: cannot set the socket of backend '%s' non-blocking.", destination);
+                }
+                else {
+                    error("BACKEND: failed to update database backend '%s'", destination);
+                    chart_transmission_failures++;
+
+                    // try again with the next pass
+                    wait_for_pass = 1;
+                }
             }
 
             if(unlikely(netdata_exit)) break;
 
             // ------------------------------------------------------------------------
-            // if we are connected, send our buffer to the backend server
+            // if we are connected, send the batches to the backend server,
+            // as much as the socket accepts without blocking
 
-            if(likely(sock != -1)) {
-                size_t len = buffer_strlen(b);
+            while(inst->sock != -1 && inst->batches) {
+                struct backend_batch *batch = inst->batches;
+                size_t len = buffer_strlen(batch->b) - batch->sent;
+                const char *data = &batch->b->buffer[batch->sent];
                 // usec_t start_ut = now_monotonic_usec();
-                int flags = 0;
-    #ifdef MSG_NOSIGNAL
-                flags += MSG_NOSIGNAL;
-    #endif
-
-#if ENABLE_PROMETHEUS_REMOTE_WRITE
-                if(do_prometheus_remote_write) {
-                    size_t data_size = get_write_request_size();
-
-                    if(unlikely(!data_size)) {
-                        error("BACKEND: write request size is out of range");
-                        continue;
-                    }
-
-                    buffer_flush(b);
-                    buffer_need_bytes(b, data_size);
-                    if(unlikely(pack_write_request(b->buffer, &data_size))) {
-                        error("BACKEND: cannot pack write request");
-                        continue;
-                    }
-                    b->len = data_size;
-                    chart_buffered_bytes = (collected_number)buffer_strlen(b);
-
-                    buffer_flush(http_request_header);
-                    buffer_sprintf(http_request_header,
-                                    "POST %s HTTP/1.1\r\n"
-                                    "Host: %s\r\n"
-                                    "Accept: */*\r\n"
-                                    "Content-Length: %zu\r\n"
-                                    "Content-Type: application/x-www-form-urlencoded\r\n\r\n",
-                                    remote_write_path,
-                                    hostname,
-                                    data_size
-                    );
-
-                    len = buffer_strlen(http_request_header);
-                    send(sock, buffer_tostring(http_request_header), len, flags);
-
-                    len = data_size;
-                }
-#endif
 
                 ssize_t written;
 #ifdef ENABLE_HTTPS
-                if(opentsdb_ssl.conn && !opentsdb_ssl.flags) {
-                    written = SSL_write(opentsdb_ssl.conn, buffer_tostring(b), len);
+                if(inst->opentsdb_ssl.conn && !inst->opentsdb_ssl.flags) {
+                    written = SSL_write(inst->opentsdb_ssl.conn, data, len);
                 } else {
-                    written = send(sock, buffer_tostring(b), len, flags);
+                    written = send(inst->sock, data, len, flags);
                 }
 #else
-                written = send(sock, buffer_tostring(b), len, flags);
+                written = send(inst->sock, data, len, flags);
 #endif
-
                 // chart_backend_latency += now_monotonic_usec() - start_ut;
-                if(written != -1 && (size_t)written == len) {
-                    // we sent the data successfully
-                    chart_transmission_successes++;
+
+                if(written > 0) {
                     chart_sent_bytes += written;
-                    chart_sent_metrics = chart_buffered_metrics;
+                    batch->sent += (size_t)written;
+                    last_progress_ut = now_monotonic_usec();
 
-                    // reset the failures count
-                    failures = 0;
+                    if(batch->sent == buffer_strlen(batch->b)) {
+                        // we sent the batch successfully
+                        chart_transmission_successes++;
+                        chart_sent_metrics += batch->metrics;
 
-                    // empty the buffer
-                    buffer_flush(b);
+                        inst->batches = batch->next;
+                        backend_batch_recycle(inst, batch);
+                    }
+                    continue;
                 }
-                else {
-                    // oops! we couldn't send (all or some of the) data
-                    error("BACKEND: failed to write data to database backend '%s'. Willing to write %zu bytes, wrote %zd bytes. Will re-connect.", destination, len, written);
-                    chart_transmission_failures++;
 
-                    if(written != -1)
-                        chart_sent_bytes += written;
+                if(written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    usec_t now_ut = now_monotonic_usec();
+
+                    if(now_ut - last_progress_ut < timeout_ut) {
+                        // the socket is full, wait for it to become writable, or for a new pass
+                        struct pollfd pfd = { .fd = inst->sock, .events = POLLOUT, .revents = 0 };
+                        usec_t wait_ut = timeout_ut - (now_ut - last_progress_ut);
+                        int wait_ms = (wait_ut < BACKEND_SEND_POLL_MS * USEC_PER_MS) ? (int)(wait_ut / USEC_PER_MS) + 1 : BACKEND_SEND_POLL_MS;
 
-                    // increment the counter we check for data loss
-                    failures++;
+                        if(poll(&pfd, 1, wait_ms) != -1 || errno == EINTR)
+                            break;
 
-                    // close the socket - we will re-open it next time
-                    close(sock);
-                    sock = -1;
+                        error("BACKEND: cannot poll the socket of backend '%s'. Will re-connect.", destination);
+                    }
+                    else
+                        error("BACKEND: backend '%s' did not accept data for %llu ms. Will re-connect.", destination, (unsigned long long)((now_ut - last_progress_ut) / USEC_PER_MS));
                 }
-            }
-            else {
-                error("BACKEND: failed to update database backend '%s'", destination);
+                else
+                    error("BACKEND: failed to write data to database backend '%s'. Willing to write %zu bytes, wrote %zd bytes. Will re-connect.", destination, len, written);
+
+                // oops! we couldn't send the batch
                 chart_transmission_failures++;
 
-                // increment the counter we check for data loss
-                failures++;
+                // close the socket - we will re-open it next time
+                close(inst->sock);
+                inst->sock = -1;
             }
         }
 
-
-#if ENABLE_PROMETHEUS_REMOTE_WRITE
-        if(failures) {
-            (void) buffer_on_failures;
-            failures = 0;
-            chart_lost_bytes = chart_buffered_bytes = get_write_request_size(); // estimated write request size
-            chart_data_lost_events++;
-            chart_lost_metrics = chart_buffered_metrics;
-        }
-#else
-        if(failures > buffer_on_failures) {
-            // too bad! we are going to lose data
-            chart_lost_bytes += buffer_strlen(b);
-            error("BACKEND: reached %d backend failures. Flushing buffers to protect this host - this results in data loss on back-end server '%s'", failures, destination);
-            buffer_flush(b);
-            failures = 0;
-            chart_data_lost_events++;
-            chart_lost_metrics = chart_buffered_metrics;
-        }
-#endif /* ENABLE_PROMETHEUS_REMOTE_WRITE */
-
         if(unlikely(netdata_exit)) break;
 
+        if(!new_passes)
+            continue;
+
         // ------------------------------------------------------------------------
-        // update the monitoring charts
+        // update the monitoring charts, once for every pass taken
+
+        chart_buffered_bytes = (collected_number)inst->batches_bytes;
+        chart_buffered_metrics = 0;
+        struct backend_batch *batch;
+        for(batch = inst->batches; batch ; batch = batch->next)
+            chart_buffered_metrics += batch->metrics;
 
         if(likely(chart_ops->counter_done)) rrdset_next(chart_ops);
         rrddim_set(chart_ops, "read",         chart_receptions);
@@ -1084,43 +1859,275 @@ void *backends_main(void *ptr) {
         rrddim_set(chart_rusage, "system", thread.ru_stime.tv_sec * 1000000ULL + thread.ru_stime.tv_usec);
         rrdset_done(chart_rusage);
 
-        if(likely(buffer_strlen(b) == 0))
-            chart_buffered_metrics = 0;
+        // reset the monitoring chart counters
+        chart_received_bytes =
+        chart_sent_bytes =
+        chart_sent_metrics =
+        chart_lost_metrics =
+        chart_receptions =
+        chart_transmission_successes =
+        chart_transmission_failures =
+        chart_data_lost_events =
+        chart_lost_bytes =
+        chart_backend_reconnects = 0;
+        // chart_backend_latency = 0;
+    }
 
-        if(unlikely(netdata_exit)) break;
+    return NULL;
+}
+
+/**
+ * Backend main
+ *
+ * The main thread used to control the backedns.
+ *
+ * @param ptr a pointer to netdata_static_structure.
+ *
+ * @return It always return NULL.
+ */
+void *backends_main(void *ptr) {
+    netdata_thread_cleanup_push(backends_main_cleanup, ptr);
+
+    struct backend_instance *inst, *defaults, **last = &backend_instances;
+    size_t instances_count = 0;
+
+    // ------------------------------------------------------------------------
+    // collect configuration options
+
+    defaults = backend_instance_create(NULL, NULL);
+
+    charts_pattern = simple_pattern_create(config_get(CONFIG_SECTION_BACKEND, "send charts matching", "*"), NULL, SIMPLE_PATTERN_EXACT);
+    hosts_pattern  = simple_pattern_create(config_get(CONFIG_SECTION_BACKEND, "send hosts matching", "localhost *"), NULL, SIMPLE_PATTERN_EXACT);
+
+    // the [backend] section is the first backend, when it is enabled
+    if(defaults->pass) {
+        *last = defaults;
+        last = &defaults->next;
     }
 
-cleanup:
-#if HAVE_KINESIS
-    if(do_kinesis) {
-        kinesis_shutdown();
-        freez(kinesis_auth_key_id);
-        freez(kinesis_secure_key);
-        freez(kinesis_stream_name);
+    char *names = strdupz(config_get(CONFIG_SECTION_BACKEND, "instances", "")), *s = names, *name;
+    while((name = mystrsep(&s, " \t,")) && *name) {
+        inst = backend_instance_create(name, defaults);
+        if(inst) {
+            *last = inst;
+            last = &inst->next;
+        }
+    }
+    freez(names);
+
+    if(!defaults->pass)
+        backend_instance_free(defaults);
+
+    // ------------------------------------------------------------------------
+    // validate configuration options
+    // and prepare for sending data to our backends
+
+    for(last = &backend_instances; (inst = *last) ; ) {
+        if(backend_instance_setup(inst)) {
+            *last = inst->next;
+            backend_instance_free(inst);
+            continue;
+        }
+
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "BACKEND[%s]", (inst->name)?inst->name:"backend");
+
+        if(netdata_thread_create(&inst->thread, tag, NETDATA_THREAD_OPTION_JOINABLE, backend_instance_thread, inst)) {
+            error("BACKEND: failed to create the thread of backend '%s' - disabling it.", inst->section);
+            *last = inst->next;
+            backend_instance_free(inst);
+            continue;
+        }
+        inst->thread_created = 1;
+
+        info("BACKEND: configured ('%s' on '%s' sending '%s' data, every %d seconds, as host '%s', with prefix '%s')", inst->type, inst->destination, inst->source, global_backend_update_every, inst->hostname, inst->prefix);
+        instances_count++;
+        last = &inst->next;
+    }
+
+    if(!instances_count)
+        goto cleanup;
+
+    // what the backends need to be copied from the database
+    int need_collected = 0, need_stored = 0;
+    for(inst = backend_instances; inst ; inst = inst->next) {
+        if(inst->do_prometheus_remote_write) continue;
+
+        if(BACKEND_OPTIONS_DATA_SOURCE(inst->options) == BACKEND_SOURCE_DATA_AS_COLLECTED)
+            need_collected = 1;
+        else
+            need_stored = 1;
     }
+
+    // the charts without a database are copied only for the backends sending the collected values
+    BACKEND_OPTIONS snapshot_options = (need_collected) ? BACKEND_SOURCE_DATA_AS_COLLECTED : BACKEND_SOURCE_DATA_AVERAGE;
+    int formatters = need_collected || need_stored;
+
+    size_t i = 0;
+    for(inst = backend_instances; inst ; inst = inst->next) {
+        inst->index = i++;
+
+        if(inst->only_changed) {
+            if(inst->do_prometheus_remote_write) {
+                error("BACKEND: backend '%s' cannot send only the changed values with prometheus remote write.", inst->section);
+                inst->only_changed = 0;
+            }
+            else if(inst->index >= BACKEND_ONLY_CHANGED_MAX) {
+                error("BACKEND: only the first %d backends can send only the changed values, backend '%s' will send all of them.", BACKEND_ONLY_CHANGED_MAX, inst->section);
+                inst->only_changed = 0;
+            }
+            else
+                backend_workers.only_changed = 1;
+        }
+    }
+
+    if(formatters) {
+        long threads = config_get_number(CONFIG_SECTION_BACKEND, "formatting threads", 1);
+        backend_workers_start((threads < 1) ? 1 : (size_t)threads, instances_count);
+    }
+
+    // ------------------------------------------------------------------------
+    // prepare the backend main loop
+
+    usec_t step_ut = global_backend_update_every * USEC_PER_SEC;
+    time_t after = now_realtime_sec();
+    heartbeat_t hb;
+    heartbeat_init(&hb);
+
+    while(!netdata_exit) {
+
+        // ------------------------------------------------------------------------
+        // Wait for the next iteration point.
+
+        heartbeat_next(&hb, step_ut);
+        time_t before = now_realtime_sec();
+        debug(D_BACKEND, "BACKEND: preparing buffers for timeframe %lu to %lu", (unsigned long)after, (unsigned long)before);
+
+        // ------------------------------------------------------------------------
+        // add to the buffers the data we need to send to the backends
+
+        netdata_thread_disable_cancelability();
+
+        struct backend_workers *bw = &backend_workers;
+        size_t count_charts_total = 0;
+        size_t count_dims_total = 0;
+
+#if ENABLE_PROMETHEUS_REMOTE_WRITE
+        for(inst = backend_instances; inst ; inst = inst->next)
+            if(inst->do_prometheus_remote_write) clear_write_request();
 #endif
+        bw->hosts_used = 0;
+
+        rrd_rdlock();
+        RRDHOST *host;
+        rrdhost_foreach_read(host) {
+            if(unlikely(!rrdhost_flag_check(host, RRDHOST_FLAG_BACKEND_SEND|RRDHOST_FLAG_BACKEND_DONT_SEND))) {
+                char *name = (host == localhost)?"localhost":host->hostname;
+                if (!hosts_pattern || simple_pattern_matches(hosts_pattern, name)) {
+                    rrdhost_flag_set(host, RRDHOST_FLAG_BACKEND_SEND);
+                    info("enabled backend for host '%s'", name);
+                }
+                else {
+                    rrdhost_flag_set(host, RRDHOST_FLAG_BACKEND_DONT_SEND);
+                    info("disabled backend for host '%s'", name);
+                }
+            }
+
+            if(unlikely(!rrdhost_flag_check(host, RRDHOST_FLAG_BACKEND_SEND)))
+                continue;
 
 #if ENABLE_PROMETHEUS_REMOTE_WRITE
-    if(do_prometheus_remote_write) {
-        buffer_free(http_request_header);
-        protocol_buffers_shutdown();
-    }
+            for(inst = backend_instances; inst ; inst = inst->next) {
+                if(inst->do_prometheus_remote_write) {
+                    size_t rw_charts = 0, rw_dims = 0, rw_dims_skipped = 0;
+
+                    rrd_stats_remote_write_allmetrics_prometheus(
+                        host
+                        , (host == localhost)?inst->hostname:host->hostname
+                        , inst->prefix
+                        , inst->options
+                        , after
+                        , before
+                        , &rw_charts
+                        , &rw_dims
+                        , &rw_dims_skipped
+                    );
+                    inst->pass_metrics += rw_dims;
+                }
+            }
 #endif
 
-    if(sock != -1)
-        close(sock);
+            // the other backends get the copies of the workers
+            if(formatters) {
+                if(unlikely(bw->hosts_used == bw->hosts_size)) {
+                    bw->hosts_size = (bw->hosts_size) ? bw->hosts_size * 2 : 64;
+                    bw->hosts = reallocz(bw->hosts, bw->hosts_size * sizeof(RRDHOST *));
+                }
+                bw->hosts[bw->hosts_used++] = host;
+            }
+        }
 
-    buffer_free(b);
-    buffer_free(response);
+        // copy the hosts, while the list of the hosts is locked
+        if(bw->hosts_used) {
+            bw->next_host = 0;
+            bw->after = after;
+            bw->before = before;
+            bw->snapshot_options = snapshot_options;
+            bw->need_stored = need_stored;
 
-#ifdef ENABLE_HTTPS
-    if(netdata_opentsdb_ctx) {
-        if(opentsdb_ssl.conn) {
-            SSL_free(opentsdb_ssl.conn);
+            backend_workers_run(BACKEND_WORKER_COPY);
         }
-    }
+        rrd_unlock();
+
+        // format the metrics of the pass for the backends, without any lock
+        if(bw->hosts_used) {
+            backend_workers_run(BACKEND_WORKER_FORMAT);
+
+            size_t w;
+            for(w = 0; w < bw->count ; w++) {
+                struct backend_worker *worker = &bw->workers[w];
+
+                for(inst = backend_instances; inst ; inst = inst->next) {
+                    BUFFER *b = worker->passes[inst->index];
+
+                    if(buffer_strlen(b)) {
+                        buffer_need_bytes(inst->pass, buffer_strlen(b));
+                        memcpy(&inst->pass->buffer[inst->pass->len], b->buffer, buffer_strlen(b));
+                        inst->pass->len += buffer_strlen(b);
+                        buffer_flush(b);
+                    }
+
+                    inst->pass_metrics += worker->passes_metrics[inst->index];
+                    worker->passes_metrics[inst->index] = 0;
+                }
+
+                count_charts_total += worker->charts;
+                count_dims_total += worker->dimensions;
+            }
+        }
+
+        // give the metrics of the pass to the threads of the backends
+        for(inst = backend_instances; inst ; inst = inst->next) {
+#if ENABLE_PROMETHEUS_REMOTE_WRITE
+            if(inst->do_prometheus_remote_write && backend_instance_pack_write_request(inst)) {
+                buffer_flush(inst->pass);
+                inst->pass_metrics = 0;
+                continue;
+            }
 #endif
+            backend_instance_pass_done(inst);
+        }
+
+        netdata_thread_enable_cancelability();
+
+        debug(D_BACKEND, "BACKEND: added metrics for %zu dimensions, of %zu charts, from %zu hosts, for %zu backends", count_dims_total, count_charts_total, bw->hosts_used, instances_count);
+
+        // prepare for the next iteration
+        // to add incrementally data to buffer
+        after = before;
+    }
 
+cleanup:
     netdata_thread_cleanup_pop(1);
     return NULL;
 }
@@ -26,8 +26,43 @@ typedef enum backend_types {
 } BACKEND_TYPE;
 
 
+// the charts and the dimensions the backends thread copies from the database, while each chart is
+// locked, so that the metrics are formatted and sent to the backends without locking the database
+
+typedef struct backend_snapshot_chart {
+    const char *hostname;                   // the hostname of the host of the chart
+    const char *host_tags;                  // the tags of the host, NULL when it has none
+    int localhost;                          // 1 when the chart is of localhost
+
+    int database;                           // 0 when the chart does not store its values
+
+    const char *id;
+    const char *name;
+    const char *family;
+    const char *context;
+    const char *type;
+    const char *units;
+} BACKEND_SNAPSHOT_CHART;
+
+typedef struct backend_snapshot_dimension {
+    BACKEND_SNAPSHOT_CHART *chart;
+
+    const char *id;
+    const char *name;
+
+    collected_number last_collected_value;
+    time_t last_collected_time;
+
+    size_t stored_count;                    // the values stored in the timeframe of the pass
+    calculated_number stored_sum;           // their sum
+    time_t stored_time;                     // the timestamp to report for them
+
+    uint64_t unchanged;                     // a bit by backend index, for the backends that send only the changed
+                                            // values, when the value is the one they have sent last
+} BACKEND_SNAPSHOT_DIMENSION;
+
 typedef int (**backend_response_checker_t)(BUFFER *);
-typedef int (**backend_request_formatter_t)(BUFFER *, const char *, RRDHOST *, const char *, RRDSET *, RRDDIM *, time_t, time_t, BACKEND_OPTIONS);
+typedef int (**backend_request_formatter_t)(BUFFER *, const char *, const char *, BACKEND_SNAPSHOT_CHART *, BACKEND_SNAPSHOT_DIMENSION *, BACKEND_OPTIONS);
 
 #define BACKEND_OPTIONS_SOURCE_BITS (BACKEND_SOURCE_DATA_AS_COLLECTED|BACKEND_SOURCE_DATA_AVERAGE|BACKEND_SOURCE_DATA_SUM)
 #define BACKEND_OPTIONS_DATA_SOURCE(backend_options) (backend_options & BACKEND_OPTIONS_SOURCE_BITS)
@@ -43,6 +78,15 @@ extern BACKEND_OPTIONS backend_parse_data_source(const char *source, BACKEND_OPT
 #ifdef BACKENDS_INTERNALS
 
 extern int backends_can_send_rrdset(BACKEND_OPTIONS backend_options, RRDSET *st);
+extern size_t backend_sum_stored_data(
+        RRDSET *st                  // the chart
+        , RRDDIM *rd                // the dimension
+        , time_t after              // the start timestamp
+        , time_t before             // the end timestamp
+        , calculated_number *sum    // the sum of the values
+        , time_t *first_timestamp   // the timestamp of the first point used in this response
+        , time_t *last_timestamp    // the timestamp that should be reported to backend
+);
 extern calculated_number backend_calculate_value_from_stored_data(
         RRDSET *st                  // the chart
         , RRDDIM *rd                // the dimension
@@ -53,6 +97,18 @@ extern calculated_number backend_calculate_value_from_stored_data(
         , time_t *last_timestamp    // the timestamp that should be reported to backend
 );
 
+// the value of the stored data of the dimension copied, for the data source of the backend
+// NAN when there are none
+static inline calculated_number backend_snapshot_stored_value(BACKEND_SNAPSHOT_DIMENSION *rd, BACKEND_OPTIONS backend_options) {
+    if(unlikely(!rd->stored_count))
+        return NAN;
+
+    if(unlikely(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_SUM))
+        return rd->stored_sum;
+
+    return rd->stored_sum / (calculated_number)rd->stored_count;
+}
+
 extern size_t backend_name_copy(char *d, const char *s, size_t usable);
 extern int discard_response(BUFFER *b, const char *backend);
 
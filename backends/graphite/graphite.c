@@ -9,17 +9,11 @@
 int format_dimension_collected_graphite_plaintext(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
-    (void)after;
-    (void)before;
 
     char chart_name[RRD_ID_LENGTH_MAX + 1];
     char dimension_name[RRD_ID_LENGTH_MAX + 1];
@@ -33,10 +27,10 @@ int format_dimension_collected_graphite_plaintext(
             , hostname
             , chart_name
             , dimension_name
-            , (host->tags)?";":""
-            , (host->tags)?host->tags:""
+            , (st->host_tags)?";":""
+            , (st->host_tags)?st->host_tags:""
             , rd->last_collected_value
-            , (unsigned long long)rd->last_collected_time.tv_sec
+            , (unsigned long long)rd->last_collected_time
     );
 
     return 1;
@@ -45,23 +39,19 @@ int format_dimension_collected_graphite_plaintext(
 int format_dimension_stored_graphite_plaintext(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
 
     char chart_name[RRD_ID_LENGTH_MAX + 1];
     char dimension_name[RRD_ID_LENGTH_MAX + 1];
     backend_name_copy(chart_name, (backend_options & BACKEND_OPTION_SEND_NAMES && st->name)?st->name:st->id, RRD_ID_LENGTH_MAX);
     backend_name_copy(dimension_name, (backend_options & BACKEND_OPTION_SEND_NAMES && rd->name)?rd->name:rd->id, RRD_ID_LENGTH_MAX);
 
-    time_t first_t = after, last_t = before;
-    calculated_number value = backend_calculate_value_from_stored_data(st, rd, after, before, backend_options, &first_t, &last_t);
+    time_t last_t = rd->stored_time;
+    calculated_number value = backend_snapshot_stored_value(rd, backend_options);
 
     if(!isnan(value)) {
 
@@ -72,8 +62,8 @@ int format_dimension_stored_graphite_plaintext(
                 , hostname
                 , chart_name
                 , dimension_name
-                , (host->tags)?";":""
-                , (host->tags)?host->tags:""
+                , (st->host_tags)?";":""
+                , (st->host_tags)?st->host_tags:""
                 , value
                 , (unsigned long long) last_t
         );
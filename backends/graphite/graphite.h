@@ -9,24 +9,18 @@
 extern int format_dimension_collected_graphite_plaintext(
           BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 );
 
 extern int format_dimension_stored_graphite_plaintext(
           BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 );
 
@@ -9,20 +9,14 @@
 int format_dimension_collected_json_plaintext(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
-    (void)after;
-    (void)before;
     (void)backend_options;
 
-    const char *tags_pre = "", *tags_post = "", *tags = host->tags;
+    const char *tags_pre = "", *tags_post = "", *tags = st->host_tags;
     if(!tags) tags = "";
 
     if(*tags) {
@@ -68,7 +62,7 @@ int format_dimension_collected_json_plaintext(
             rd->name,
             rd->last_collected_value,
 
-            (unsigned long long) rd->last_collected_time.tv_sec
+            (unsigned long long) rd->last_collected_time
     );
 
     return 1;
@@ -77,21 +71,17 @@ int format_dimension_collected_json_plaintext(
 int format_dimension_stored_json_plaintext(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
 
-    time_t first_t = after, last_t = before;
-    calculated_number value = backend_calculate_value_from_stored_data(st, rd, after, before, backend_options, &first_t, &last_t);
+    time_t last_t = rd->stored_time;
+    calculated_number value = backend_snapshot_stored_value(rd, backend_options);
 
     if(!isnan(value)) {
-        const char *tags_pre = "", *tags_post = "", *tags = host->tags;
+        const char *tags_pre = "", *tags_post = "", *tags = st->host_tags;
         if(!tags) tags = "";
 
         if(*tags) {
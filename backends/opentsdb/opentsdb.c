@@ -9,17 +9,11 @@
 int format_dimension_collected_opentsdb_telnet(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
-    (void)after;
-    (void)before;
 
     char chart_name[RRD_ID_LENGTH_MAX + 1];
     char dimension_name[RRD_ID_LENGTH_MAX + 1];
@@ -32,11 +26,11 @@ int format_dimension_collected_opentsdb_telnet(
             , prefix
             , chart_name
             , dimension_name
-            , (unsigned long long)rd->last_collected_time.tv_sec
+            , (unsigned long long)rd->last_collected_time
             , rd->last_collected_value
             , hostname
-            , (host->tags)?" ":""
-            , (host->tags)?host->tags:""
+            , (st->host_tags)?" ":""
+            , (st->host_tags)?st->host_tags:""
     );
 
     return 1;
@@ -45,18 +39,14 @@ int format_dimension_collected_opentsdb_telnet(
 int format_dimension_stored_opentsdb_telnet(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
 
-    time_t first_t = after, last_t = before;
-    calculated_number value = backend_calculate_value_from_stored_data(st, rd, after, before, backend_options, &first_t, &last_t);
+    time_t last_t = rd->stored_time;
+    calculated_number value = backend_snapshot_stored_value(rd, backend_options);
 
     char chart_name[RRD_ID_LENGTH_MAX + 1];
     char dimension_name[RRD_ID_LENGTH_MAX + 1];
@@ -74,8 +64,8 @@ int format_dimension_stored_opentsdb_telnet(
                 , (unsigned long long) last_t
                 , value
                 , hostname
-                , (host->tags)?" ":""
-                , (host->tags)?host->tags:""
+                , (st->host_tags)?" ":""
+                , (st->host_tags)?st->host_tags:""
         );
 
         return 1;
@@ -106,17 +96,11 @@ static inline void opentsdb_build_message(BUFFER *b, char *message, const char *
 int format_dimension_collected_opentsdb_http(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
-    (void)after;
-    (void)before;
 
     char message[1024];
     char chart_name[RRD_ID_LENGTH_MAX + 1];
@@ -137,11 +121,11 @@ int format_dimension_collected_opentsdb_http(
                            , prefix
                            , chart_name
                            , dimension_name
-                           , (unsigned long long)rd->last_collected_time.tv_sec
+                           , (unsigned long long)rd->last_collected_time
                            , rd->last_collected_value
                            , hostname
-                           , (host->tags)?" ":""
-                           , (host->tags)?host->tags:""
+                           , (st->host_tags)?" ":""
+                           , (st->host_tags)?st->host_tags:""
                     );
 
     if(length > 0) {
@@ -154,18 +138,14 @@ int format_dimension_collected_opentsdb_http(
 int format_dimension_stored_opentsdb_http(
         BUFFER *b                 // the buffer to write data to
         , const char *prefix        // the prefix to use
-        , RRDHOST *host             // the host this chart comes from
-        , const char *hostname      // the hostname (to override host->hostname)
-        , RRDSET *st                // the chart
-        , RRDDIM *rd                // the dimension
-        , time_t after              // the start timestamp
-        , time_t before             // the end timestamp
+        , const char *hostname      // the hostname (to override the hostname of the host)
+        , BACKEND_SNAPSHOT_CHART *st     // the chart
+        , BACKEND_SNAPSHOT_DIMENSION *rd // the dimension
         , BACKEND_OPTIONS backend_options // BACKEND_SOURCE_* bitmap
 ) {
-    (void)host;
 
-    time_t first_t = after, last_t = before;
-    calculated_number value = backend_calculate_value_from_stored_data(st, rd, after, before, backend_options, &first_t, &last_t);
+    time_t last_t = rd->stored_time;
+    calculated_number value = backend_snapshot_stored_value(rd, backend_options);
 
     if(!isnan(value)) {
         char chart_name[RRD_ID_LENGTH_MAX + 1];
@@ -190,8 +170,8 @@ int format_dimension_stored_opentsdb_http(
                 , (unsigned long long)last_t
                 , value
                 , hostname
-                , (host->tags)?" ":""
-                , (host->tags)?host->tags:""
+                , (st->host_tags)?" ":""
+                , (st->host_tags)?st->host_tags:""
         );
 
         if(length > 0) {
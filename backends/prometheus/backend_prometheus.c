@@ -150,11 +150,150 @@ static inline char *prometheus_units_copy(char *d, const char *s, size_t usable,
 
 
 #define PROMETHEUS_ELEMENT_MAX 256
-#define PROMETHEUS_LABELS_MAX 1024
 #define PROMETHEUS_VARIABLE_MAX 256
 
 #define PROMETHEUS_LABELS_MAX_NUMBER 128
 
+// ----------------------------------------------------------------------------
+// the names and the labels of the metrics of a chart, made once and kept with
+// the chart until its definition changes, instead of on every scrape
+
+struct prometheus_dimension_names {
+    RRDDIM *rd;
+    const char *label[2];               // the dimension label, [0] of the id and [1] of the name of the dimension
+    const char *name[2];                // the same, for a metric name
+};
+
+struct rrdset_prometheus_names {
+    size_t generation;                  // the json_generation of the chart they have been made for
+    const char *chart[2];               // the chart label, [0] of the id and [1] of the name of the chart
+    const char *family;                 // the family label
+    const char *context;                // the context, for a metric name
+    const char *units[2];               // the units, for a metric name, [0] as they are and [1] the old ones
+    size_t dimensions;
+    struct prometheus_dimension_names dimension[];
+};
+
+// appends s to wb with its terminating null, returns its offset in wb
+static inline size_t prometheus_names_append(BUFFER *wb, const char *s) {
+    size_t offset = wb->len, len = strlen(s) + 1;
+
+    buffer_need_bytes(wb, len);
+    memcpy(&wb->buffer[wb->len], s, len);
+    wb->len += len;
+
+    return offset;
+}
+
+static inline size_t prometheus_names_append_label(BUFFER *wb, const char *s) {
+    char buf[PROMETHEUS_ELEMENT_MAX + 1];
+    prometheus_label_copy(buf, s, PROMETHEUS_ELEMENT_MAX);
+    return prometheus_names_append(wb, buf);
+}
+
+static inline size_t prometheus_names_append_name(BUFFER *wb, const char *s) {
+    char buf[PROMETHEUS_ELEMENT_MAX + 1];
+    prometheus_name_copy(buf, s, PROMETHEUS_ELEMENT_MAX);
+    return prometheus_names_append(wb, buf);
+}
+
+static inline size_t prometheus_names_append_units(BUFFER *wb, const char *s, int showoldunits) {
+    char buf[PROMETHEUS_ELEMENT_MAX + 1];
+    prometheus_units_copy(buf, s, PROMETHEUS_ELEMENT_MAX, showoldunits);
+    return prometheus_names_append(wb, buf);
+}
+
+// the strings are made in a buffer and copied after the dimensions, so their
+// offsets in the buffer are kept in the pointers until then
+#define prometheus_names_offset(offset) ((const char *)(uintptr_t)(offset))
+#define prometheus_names_rebase(base, p) (p) = &(base)[(uintptr_t)(p)]
+
+static struct rrdset_prometheus_names *rrdset_prometheus_names_create(RRDSET *st, size_t generation) {
+    BUFFER *wb = buffer_create(4096);
+
+    RRDDIM *rd;
+    size_t dimensions = 0;
+    rrddim_foreach_read(rd, st) dimensions++;
+
+    struct rrdset_prometheus_names tmp = {
+            .generation = generation,
+            .chart = {
+                    prometheus_names_offset(prometheus_names_append_label(wb, st->id)),
+                    prometheus_names_offset(prometheus_names_append_label(wb, (st->name) ? st->name : st->id))
+            },
+            .family = prometheus_names_offset(prometheus_names_append_label(wb, st->family)),
+            .context = prometheus_names_offset(prometheus_names_append_name(wb, st->context)),
+            .units = {
+                    prometheus_names_offset(prometheus_names_append_units(wb, st->units, 0)),
+                    prometheus_names_offset(prometheus_names_append_units(wb, st->units, 1))
+            },
+            .dimensions = dimensions
+    };
+
+    size_t size = sizeof(struct rrdset_prometheus_names) + dimensions * sizeof(struct prometheus_dimension_names);
+    struct rrdset_prometheus_names *n = mallocz(size);
+    *n = tmp;
+
+    size_t i = 0;
+    rrddim_foreach_read(rd, st) {
+        struct prometheus_dimension_names *dn = &n->dimension[i++];
+        const char *name = (rd->name) ? rd->name : rd->id;
+
+        dn->rd = rd;
+        dn->label[0] = prometheus_names_offset(prometheus_names_append_label(wb, rd->id));
+        dn->label[1] = prometheus_names_offset(prometheus_names_append_label(wb, name));
+        dn->name[0] = prometheus_names_offset(prometheus_names_append_name(wb, rd->id));
+        dn->name[1] = prometheus_names_offset(prometheus_names_append_name(wb, name));
+    }
+
+    // the strings are appended to the dimensions, now that all of them have been made
+    n = reallocz(n, size + wb->len);
+    char *base = (char *)n + size;
+    memcpy(base, wb->buffer, wb->len);
+
+    prometheus_names_rebase(base, n->chart[0]);
+    prometheus_names_rebase(base, n->chart[1]);
+    prometheus_names_rebase(base, n->family);
+    prometheus_names_rebase(base, n->context);
+    prometheus_names_rebase(base, n->units[0]);
+    prometheus_names_rebase(base, n->units[1]);
+
+    for(i = 0; i < dimensions ; i++) {
+        struct prometheus_dimension_names *dn = &n->dimension[i];
+        prometheus_names_rebase(base, dn->label[0]);
+        prometheus_names_rebase(base, dn->label[1]);
+        prometheus_names_rebase(base, dn->name[0]);
+        prometheus_names_rebase(base, dn->name[1]);
+    }
+
+    buffer_free(wb);
+    return n;
+}
+
+// returns the names of st, made again when its definition has changed since they were made
+// the caller must hold the prometheus_names_mutex of the host of st and a read lock on st,
+// and give the json_generation of st as it was before st was locked
+static struct rrdset_prometheus_names *rrdset_prometheus_names_get(RRDSET *st, size_t generation) {
+    struct rrdset_prometheus_names *n = st->prometheus_names;
+
+    // the generation changes after a dimension is added, so the dimensions are checked too
+    if(likely(n && n->generation == generation)) {
+        size_t i = 0;
+        RRDDIM *rd;
+        rrddim_foreach_read(rd, st) {
+            if(unlikely(i >= n->dimensions || n->dimension[i].rd != rd))
+                break;
+            i++;
+        }
+
+        if(likely(!rd && i == n->dimensions))
+            return n;
+    }
+
+    freez(n);
+    return st->prometheus_names = rrdset_prometheus_names_create(st, generation);
+}
+
 struct host_variables_callback_options {
     RRDHOST *host;
     BUFFER *wb;
@@ -223,13 +362,15 @@ static int print_host_variables(RRDVAR *rv, void *data) {
     return 0;
 }
 
-static void rrd_stats_api_v1_charts_allmetrics_prometheus(RRDHOST *host, BUFFER *wb, const char *prefix, BACKEND_OPTIONS backend_options, time_t after, time_t before, int allhosts, PROMETHEUS_OUTPUT_OPTIONS output_options) {
+// adds the information and the variables of host to wb, and sets labels to the labels of its metrics
+// labels must have room for PROMETHEUS_LABELS_MAX characters
+void rrd_stats_api_v1_host_allmetrics_prometheus(RRDHOST *host, BUFFER *wb, const char *prefix, BACKEND_OPTIONS backend_options, int allhosts, PROMETHEUS_OUTPUT_OPTIONS output_options, char *labels) {
     rrdhost_rdlock(host);
 
     char hostname[PROMETHEUS_ELEMENT_MAX + 1];
     prometheus_label_copy(hostname, host->hostname, PROMETHEUS_ELEMENT_MAX);
 
-    char labels[PROMETHEUS_LABELS_MAX + 1] = "";
+    labels[0] = '\0';
     if(allhosts) {
         if(output_options & PROMETHEUS_OUTPUT_TIMESTAMPS)
             buffer_sprintf(wb, "netdata_info{instance=\"%s\",application=\"%s\",version=\"%s\"} 1 %llu\n", hostname, host->program_name, host->program_version, now_realtime_usec() / USEC_PER_MS);
@@ -291,252 +432,240 @@ static void rrd_stats_api_v1_charts_allmetrics_prometheus(RRDHOST *host, BUFFER
         foreach_host_variable_callback(host, print_host_variables, &opts);
     }
 
-    // for each chart
-    RRDSET *st;
-    rrdset_foreach_read(st, host) {
-        char chart[PROMETHEUS_ELEMENT_MAX + 1];
-        char context[PROMETHEUS_ELEMENT_MAX + 1];
-        char family[PROMETHEUS_ELEMENT_MAX + 1];
-        char units[PROMETHEUS_ELEMENT_MAX + 1] = "";
-
-        prometheus_label_copy(chart, (output_options & PROMETHEUS_OUTPUT_NAMES && st->name)?st->name:st->id, PROMETHEUS_ELEMENT_MAX);
-        prometheus_label_copy(family, st->family, PROMETHEUS_ELEMENT_MAX);
-        prometheus_name_copy(context, st->context, PROMETHEUS_ELEMENT_MAX);
+    rrdhost_unlock(host);
+}
 
-        if(likely(backends_can_send_rrdset(backend_options, st))) {
-            rrdset_rdlock(st);
+// prints the name and the labels of a sample, up to its value:
+// prefix_context[_name][units]suffix{chart="chart",family="family"[,dimension="dimension"]labels}
+static inline void prometheus_print_sample_name(BUFFER *wb, const char *prefix, const char *context, const char *name, const char *units, const char *suffix, const char *chart, const char *family, const char *dimension, const char *labels) {
+    buffer_strcat(wb, prefix);
+    buffer_fast_strcat(wb, "_", 1);
+    buffer_strcat(wb, context);
+    if(name) {
+        buffer_fast_strcat(wb, "_", 1);
+        buffer_strcat(wb, name);
+    }
+    buffer_strcat(wb, units);
+    buffer_strcat(wb, suffix);
+    buffer_fast_strcat(wb, "{chart=\"", 8);
+    buffer_strcat(wb, chart);
+    buffer_fast_strcat(wb, "\",family=\"", 10);
+    buffer_strcat(wb, family);
+    if(dimension) {
+        buffer_fast_strcat(wb, "\",dimension=\"", 13);
+        buffer_strcat(wb, dimension);
+    }
+    buffer_fast_strcat(wb, "\"", 1);
+    buffer_strcat(wb, labels);
+    buffer_fast_strcat(wb, "} ", 2);
+}
 
-            int as_collected = (BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED);
-            int homogeneous = 1;
-            if(as_collected) {
-                if(rrdset_flag_check(st, RRDSET_FLAG_HOMOGENEOUS_CHECK))
-                    rrdset_update_heterogeneous_flag(st);
+// prints the timestamp of a sample, if it is needed, and ends its line
+static inline void prometheus_print_sample_end(BUFFER *wb, PROMETHEUS_OUTPUT_OPTIONS output_options, msec_t timestamp) {
+    if(output_options & PROMETHEUS_OUTPUT_TIMESTAMPS) {
+        buffer_fast_strcat(wb, " ", 1);
+        buffer_print_uint64(wb, timestamp);
+    }
+    buffer_fast_strcat(wb, "\n", 1);
+}
 
-                if(rrdset_flag_check(st, RRDSET_FLAG_HETEROGENEOUS))
-                    homogeneous = 0;
-            }
-            else {
-                if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AVERAGE && !(output_options & PROMETHEUS_OUTPUT_HIDEUNITS))
-                    prometheus_units_copy(units, st->units, PROMETHEUS_ELEMENT_MAX, output_options & PROMETHEUS_OUTPUT_OLDUNITS);
-            }
+// adds the metrics of st to wb
+// the caller must hold the charts read lock of the host of st
+void rrd_stats_api_v1_chart_allmetrics_prometheus(RRDSET *st, BUFFER *wb, const char *prefix, BACKEND_OPTIONS backend_options, time_t after, time_t before, const char *labels, PROMETHEUS_OUTPUT_OPTIONS output_options) {
+    if(likely(backends_can_send_rrdset(backend_options, st))) {
+        int names = (output_options & PROMETHEUS_OUTPUT_NAMES) ? 1 : 0;
 
-            if(unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
-                buffer_sprintf(wb, "\n# COMMENT %s chart \"%s\", context \"%s\", family \"%s\", units \"%s\"\n"
-                               , (homogeneous)?"homogeneous":"heterogeneous"
-                               , (output_options & PROMETHEUS_OUTPUT_NAMES && st->name) ? st->name : st->id
-                               , st->context
-                               , st->family
-                               , st->units
-                );
+        // read before the chart, so that a change while its names are made is not missed
+        size_t generation = __atomic_load_n(&st->json_generation, __ATOMIC_ACQUIRE);
 
-            // for each dimension
-            RRDDIM *rd;
-            rrddim_foreach_read(rd, st) {
-                if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
-                    char dimension[PROMETHEUS_ELEMENT_MAX + 1];
-                    char *suffix = "";
+        netdata_mutex_lock(&st->rrdhost->prometheus_names_mutex);
+        rrdset_rdlock(st);
 
-                    if (as_collected) {
-                        // we need as-collected / raw data
+        struct rrdset_prometheus_names *pn = rrdset_prometheus_names_get(st, generation);
+        const char *chart = pn->chart[names];
+        const char *family = pn->family;
+        const char *context = pn->context;
+        const char *units = "";
 
-                        if(unlikely(rd->last_collected_time.tv_sec < after))
-                            continue;
+        int as_collected = (BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED);
+        int homogeneous = 1;
+        if(as_collected) {
+            if(rrdset_flag_check(st, RRDSET_FLAG_HOMOGENEOUS_CHECK))
+                rrdset_update_heterogeneous_flag(st);
 
-                        const char *t = "gauge", *h = "gives";
-                        if(rd->algorithm == RRD_ALGORITHM_INCREMENTAL ||
-                           rd->algorithm == RRD_ALGORITHM_PCENT_OVER_DIFF_TOTAL) {
-                            t = "counter";
-                            h = "delta gives";
-                            suffix = "_total";
-                        }
+            if(rrdset_flag_check(st, RRDSET_FLAG_HETEROGENEOUS))
+                homogeneous = 0;
+        }
+        else {
+            if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AVERAGE && !(output_options & PROMETHEUS_OUTPUT_HIDEUNITS))
+                units = pn->units[(output_options & PROMETHEUS_OUTPUT_OLDUNITS) ? 1 : 0];
+        }
 
-                        if(homogeneous) {
-                            // all the dimensions of the chart, has the same algorithm, multiplier and divisor
-                            // we add all dimensions as labels
+        if(unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
+            buffer_sprintf(wb, "\n# COMMENT %s chart \"%s\", context \"%s\", family \"%s\", units \"%s\"\n"
+                           , (homogeneous)?"homogeneous":"heterogeneous"
+                           , (output_options & PROMETHEUS_OUTPUT_NAMES && st->name) ? st->name : st->id
+                           , st->context
+                           , st->family
+                           , st->units
+            );
 
-                            prometheus_label_copy(dimension, (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id, PROMETHEUS_ELEMENT_MAX);
-
-                            if(unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
-                                buffer_sprintf(wb
-                                               , "# COMMENT %s_%s%s: chart \"%s\", context \"%s\", family \"%s\", dimension \"%s\", value * " COLLECTED_NUMBER_FORMAT " / " COLLECTED_NUMBER_FORMAT " %s %s (%s)\n"
-                                               , prefix
-                                               , context
-                                               , suffix
-                                               , (output_options & PROMETHEUS_OUTPUT_NAMES && st->name) ? st->name : st->id
-                                               , st->context
-                                               , st->family
-                                               , (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id
-                                               , rd->multiplier
-                                               , rd->divisor
-                                               , h
-                                               , st->units
-                                               , t
-                                );
-
-                            if(unlikely(output_options & PROMETHEUS_OUTPUT_TYPES))
-                                buffer_sprintf(wb, "# COMMENT TYPE %s_%s%s %s\n"
-                                               , prefix
-                                               , context
-                                               , suffix
-                                               , t
-                                );
-
-                            if(output_options & PROMETHEUS_OUTPUT_TIMESTAMPS)
-                                buffer_sprintf(wb
-                                               , "%s_%s%s{chart=\"%s\",family=\"%s\",dimension=\"%s\"%s} " COLLECTED_NUMBER_FORMAT " %llu\n"
-                                               , prefix
-                                               , context
-                                               , suffix
-                                               , chart
-                                               , family
-                                               , dimension
-                                               , labels
-                                               , rd->last_collected_value
-                                               , timeval_msec(&rd->last_collected_time)
-                                );
-                            else
-                                buffer_sprintf(wb
-                                               , "%s_%s%s{chart=\"%s\",family=\"%s\",dimension=\"%s\"%s} " COLLECTED_NUMBER_FORMAT "\n"
-                                               , prefix
-                                               , context
-                                               , suffix
-                                               , chart
-                                               , family
-                                               , dimension
-                                               , labels
-                                               , rd->last_collected_value
-                                );
-                        }
-                        else {
-                            // the dimensions of the chart, do not have the same algorithm, multiplier or divisor
-                            // we create a metric per dimension
+        // for each dimension
+        RRDDIM *rd;
+        size_t i = 0;
+        rrddim_foreach_read(rd, st) {
+            struct prometheus_dimension_names *dn = &pn->dimension[i++];
 
-                            prometheus_name_copy(dimension, (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id, PROMETHEUS_ELEMENT_MAX);
-
-                            if(unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
-                                buffer_sprintf(wb
-                                               , "# COMMENT %s_%s_%s%s: chart \"%s\", context \"%s\", family \"%s\", dimension \"%s\", value * " COLLECTED_NUMBER_FORMAT " / " COLLECTED_NUMBER_FORMAT " %s %s (%s)\n"
-                                               , prefix
-                                               , context
-                                               , dimension
-                                               , suffix
-                                               , (output_options & PROMETHEUS_OUTPUT_NAMES && st->name) ? st->name : st->id
-                                               , st->context
-                                               , st->family
-                                               , (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id
-                                               , rd->multiplier
-                                               , rd->divisor
-                                               , h
-                                               , st->units
-                                               , t
-                                );
-
-                            if(unlikely(output_options & PROMETHEUS_OUTPUT_TYPES))
-                                buffer_sprintf(wb, "# COMMENT TYPE %s_%s_%s%s %s\n"
-                                               , prefix
-                                               , context
-                                               , dimension
-                                               , suffix
-                                               , t
-                                );
-
-                            if(output_options & PROMETHEUS_OUTPUT_TIMESTAMPS)
-                                buffer_sprintf(wb
-                                               , "%s_%s_%s%s{chart=\"%s\",family=\"%s\"%s} " COLLECTED_NUMBER_FORMAT " %llu\n"
-                                               , prefix
-                                               , context
-                                               , dimension
-                                               , suffix
-                                               , chart
-                                               , family
-                                               , labels
-                                               , rd->last_collected_value
-                                               , timeval_msec(&rd->last_collected_time)
-                                );
-                            else
-                                buffer_sprintf(wb
-                                               , "%s_%s_%s%s{chart=\"%s\",family=\"%s\"%s} " COLLECTED_NUMBER_FORMAT "\n"
-                                               , prefix
-                                               , context
-                                               , dimension
-                                               , suffix
-                                               , chart
-                                               , family
-                                               , labels
-                                               , rd->last_collected_value
-                                );
-                        }
-                    }
-                    else {
-                        // we need average or sum of the data
+            if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
+                const char *dimension;
+                char *suffix = "";
 
-                        time_t first_t = after, last_t = before;
-                        calculated_number value = backend_calculate_value_from_stored_data(st, rd, after, before, backend_options, &first_t, &last_t);
+                if (as_collected) {
+                    // we need as-collected / raw data
 
-                        if(!isnan(value) && !isinf(value)) {
+                    if(unlikely(rd->last_collected_time.tv_sec < after))
+                        continue;
 
-                            if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AVERAGE)
-                                suffix = "_average";
-                            else if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_SUM)
-                                suffix = "_sum";
+                    const char *t = "gauge", *h = "gives";
+                    if(rd->algorithm == RRD_ALGORITHM_INCREMENTAL ||
+                       rd->algorithm == RRD_ALGORITHM_PCENT_OVER_DIFF_TOTAL) {
+                        t = "counter";
+                        h = "delta gives";
+                        suffix = "_total";
+                    }
 
-                            prometheus_label_copy(dimension, (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id, PROMETHEUS_ELEMENT_MAX);
-
-                            if (unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
-                                buffer_sprintf(wb, "# COMMENT %s_%s%s%s: dimension \"%s\", value is %s, gauge, dt %llu to %llu inclusive\n"
-                                               , prefix
-                                               , context
-                                               , units
-                                               , suffix
-                                               , (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id
-                                               , st->units
-                                               , (unsigned long long)first_t
-                                               , (unsigned long long)last_t
-                                );
-
-                            if (unlikely(output_options & PROMETHEUS_OUTPUT_TYPES))
-                                buffer_sprintf(wb, "# COMMENT TYPE %s_%s%s%s gauge\n"
-                                               , prefix
-                                               , context
-                                               , units
-                                               , suffix
-                                );
-
-                            if(output_options & PROMETHEUS_OUTPUT_TIMESTAMPS)
-                                buffer_sprintf(wb, "%s_%s%s%s{chart=\"%s\",family=\"%s\",dimension=\"%s\"%s} " CALCULATED_NUMBER_FORMAT " %llu\n"
-                                               , prefix
-                                               , context
-                                               , units
-                                               , suffix
-                                               , chart
-                                               , family
-                                               , dimension
-                                               , labels
-                                               , value
-                                               , last_t * MSEC_PER_SEC
-                                );
-                            else
-                                buffer_sprintf(wb, "%s_%s%s%s{chart=\"%s\",family=\"%s\",dimension=\"%s\"%s} " CALCULATED_NUMBER_FORMAT "\n"
-                                               , prefix
-                                               , context
-                                               , units
-                                               , suffix
-                                               , chart
-                                               , family
-                                               , dimension
-                                               , labels
-                                               , value
-                                );
-                        }
+                    if(homogeneous) {
+                        // all the dimensions of the chart, has the same algorithm, multiplier and divisor
+                        // we add all dimensions as labels
+
+                        dimension = dn->label[names];
+
+                        if(unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
+                            buffer_sprintf(wb
+                                           , "# COMMENT %s_%s%s: chart \"%s\", context \"%s\", family \"%s\", dimension \"%s\", value * " COLLECTED_NUMBER_FORMAT " / " COLLECTED_NUMBER_FORMAT " %s %s (%s)\n"
+                                           , prefix
+                                           , context
+                                           , suffix
+                                           , (output_options & PROMETHEUS_OUTPUT_NAMES && st->name) ? st->name : st->id
+                                           , st->context
+                                           , st->family
+                                           , (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id
+                                           , rd->multiplier
+                                           , rd->divisor
+                                           , h
+                                           , st->units
+                                           , t
+                            );
+
+                        if(unlikely(output_options & PROMETHEUS_OUTPUT_TYPES))
+                            buffer_sprintf(wb, "# COMMENT TYPE %s_%s%s %s\n"
+                                           , prefix
+                                           , context
+                                           , suffix
+                                           , t
+                            );
+
+                        prometheus_print_sample_name(wb, prefix, context, NULL, "", suffix, chart, family, dimension, labels);
+                        buffer_print_int64(wb, rd->last_collected_value);
+                        prometheus_print_sample_end(wb, output_options, timeval_msec(&rd->last_collected_time));
+                    }
+                    else {
+                        // the dimensions of the chart, do not have the same algorithm, multiplier or divisor
+                        // we create a metric per dimension
+
+                        dimension = dn->name[names];
+
+                        if(unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
+                            buffer_sprintf(wb
+                                           , "# COMMENT %s_%s_%s%s: chart \"%s\", context \"%s\", family \"%s\", dimension \"%s\", value * " COLLECTED_NUMBER_FORMAT " / " COLLECTED_NUMBER_FORMAT " %s %s (%s)\n"
+                                           , prefix
+                                           , context
+                                           , dimension
+                                           , suffix
+                                           , (output_options & PROMETHEUS_OUTPUT_NAMES && st->name) ? st->name : st->id
+                                           , st->context
+                                           , st->family
+                                           , (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id
+                                           , rd->multiplier
+                                           , rd->divisor
+                                           , h
+                                           , st->units
+                                           , t
+                            );
+
+                        if(unlikely(output_options & PROMETHEUS_OUTPUT_TYPES))
+                            buffer_sprintf(wb, "# COMMENT TYPE %s_%s_%s%s %s\n"
+                                           , prefix
+                                           , context
+                                           , dimension
+                                           , suffix
+                                           , t
+                            );
+
+                        prometheus_print_sample_name(wb, prefix, context, dimension, "", suffix, chart, family, NULL, labels);
+                        buffer_print_int64(wb, rd->last_collected_value);
+                        prometheus_print_sample_end(wb, output_options, timeval_msec(&rd->last_collected_time));
+                    }
+                }
+                else {
+                    // we need average or sum of the data
+
+                    time_t first_t = after, last_t = before;
+                    calculated_number value = backend_calculate_value_from_stored_data(st, rd, after, before, backend_options, &first_t, &last_t);
+
+                    if(!isnan(value) && !isinf(value)) {
+
+                        if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AVERAGE)
+                            suffix = "_average";
+                        else if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_SUM)
+                            suffix = "_sum";
+
+                        dimension = dn->label[names];
+
+                        if (unlikely(output_options & PROMETHEUS_OUTPUT_HELP))
+                            buffer_sprintf(wb, "# COMMENT %s_%s%s%s: dimension \"%s\", value is %s, gauge, dt %llu to %llu inclusive\n"
+                                           , prefix
+                                           , context
+                                           , units
+                                           , suffix
+                                           , (output_options & PROMETHEUS_OUTPUT_NAMES && rd->name) ? rd->name : rd->id
+                                           , st->units
+                                           , (unsigned long long)first_t
+                                           , (unsigned long long)last_t
+                            );
+
+                        if (unlikely(output_options & PROMETHEUS_OUTPUT_TYPES))
+                            buffer_sprintf(wb, "# COMMENT TYPE %s_%s%s%s gauge\n"
+                                           , prefix
+                                           , context
+                                           , units
+                                           , suffix
+                            );
+
+                        prometheus_print_sample_name(wb, prefix, context, NULL, units, suffix, chart, family, dimension, labels);
+                        buffer_print_double_fixed(wb, value, 7);
+                        prometheus_print_sample_end(wb, output_options, (msec_t)last_t * MSEC_PER_SEC);
                     }
                 }
             }
-
-            rrdset_unlock(st);
         }
+
+        rrdset_unlock(st);
+        netdata_mutex_unlock(&st->rrdhost->prometheus_names_mutex);
     }
+}
 
-    rrdhost_unlock(host);
+static void rrd_stats_api_v1_charts_allmetrics_prometheus(RRDHOST *host, BUFFER *wb, const char *prefix, BACKEND_OPTIONS backend_options, time_t after, time_t before, int allhosts, PROMETHEUS_OUTPUT_OPTIONS output_options) {
+    char labels[PROMETHEUS_LABELS_MAX + 1];
+    rrd_stats_api_v1_host_allmetrics_prometheus(host, wb, prefix, backend_options, allhosts, output_options, labels);
+
+    // for each chart
+    unsigned reader = rrdhost_charts_read_lock(host);
+    RRDSET *st;
+    rrdset_foreach_lockless(st, host)
+        rrd_stats_api_v1_chart_allmetrics_prometheus(st, wb, prefix, backend_options, after, before, labels, output_options);
+
+    rrdhost_charts_read_unlock(host, reader);
 }
 
 #if ENABLE_PROMETHEUS_REMOTE_WRITE
@@ -613,20 +742,22 @@ void rrd_stats_remote_write_allmetrics_prometheus(
     }
 
     // for each chart
+    unsigned reader = rrdhost_charts_read_lock(host);
     RRDSET *st;
-    rrdset_foreach_read(st, host) {
-        char chart[PROMETHEUS_ELEMENT_MAX + 1];
-        char context[PROMETHEUS_ELEMENT_MAX + 1];
-        char family[PROMETHEUS_ELEMENT_MAX + 1];
-        char units[PROMETHEUS_ELEMENT_MAX + 1] = "";
-
-        prometheus_label_copy(chart, (backend_options & BACKEND_OPTION_SEND_NAMES && st->name)?st->name:st->id, PROMETHEUS_ELEMENT_MAX);
-        prometheus_label_copy(family, st->family, PROMETHEUS_ELEMENT_MAX);
-        prometheus_name_copy(context, st->context, PROMETHEUS_ELEMENT_MAX);
-
+    rrdset_foreach_lockless(st, host) {
         if(likely(backends_can_send_rrdset(backend_options, st))) {
+            int names = (backend_options & BACKEND_OPTION_SEND_NAMES) ? 1 : 0;
+            size_t generation = __atomic_load_n(&st->json_generation, __ATOMIC_ACQUIRE);
+
+            netdata_mutex_lock(&host->prometheus_names_mutex);
             rrdset_rdlock(st);
 
+            struct rrdset_prometheus_names *pn = rrdset_prometheus_names_get(st, generation);
+            const char *chart = pn->chart[names];
+            const char *family = pn->family;
+            const char *context = pn->context;
+            const char *units = "";
+
             (*count_charts)++;
 
             int as_collected = (BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AS_COLLECTED);
@@ -640,15 +771,18 @@ void rrd_stats_remote_write_allmetrics_prometheus(
             }
             else {
                 if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_AVERAGE)
-                    prometheus_units_copy(units, st->units, PROMETHEUS_ELEMENT_MAX, 0);
+                    units = pn->units[0];
             }
 
             // for each dimension
             RRDDIM *rd;
+            size_t i = 0;
             rrddim_foreach_read(rd, st) {
+                struct prometheus_dimension_names *dn = &pn->dimension[i++];
+
                 if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
                     char name[PROMETHEUS_LABELS_MAX + 1];
-                    char dimension[PROMETHEUS_ELEMENT_MAX + 1];
+                    const char *dimension;
                     char *suffix = "";
 
                     if (as_collected) {
@@ -664,7 +798,7 @@ void rrd_stats_remote_write_allmetrics_prometheus(
                             // all the dimensions of the chart, has the same algorithm, multiplier and divisor
                             // we add all dimensions as labels
 
-                            prometheus_label_copy(dimension, (backend_options & BACKEND_OPTION_SEND_NAMES && rd->name) ? rd->name : rd->id, PROMETHEUS_ELEMENT_MAX);
+                            dimension = dn->label[names];
                             snprintf(name, PROMETHEUS_LABELS_MAX, "%s_%s%s", prefix, context, suffix);
 
                             add_metric(name, chart, family, dimension, hostname, rd->last_collected_value, timeval_msec(&rd->last_collected_time));
@@ -674,7 +808,7 @@ void rrd_stats_remote_write_allmetrics_prometheus(
                             // the dimensions of the chart, do not have the same algorithm, multiplier or divisor
                             // we create a metric per dimension
 
-                            prometheus_name_copy(dimension, (backend_options & BACKEND_OPTION_SEND_NAMES && rd->name) ? rd->name : rd->id, PROMETHEUS_ELEMENT_MAX);
+                            dimension = dn->name[names];
                             snprintf(name, PROMETHEUS_LABELS_MAX, "%s_%s_%s%s", prefix, context, dimension, suffix);
 
                             add_metric(name, chart, family, NULL, hostname, rd->last_collected_value, timeval_msec(&rd->last_collected_time));
@@ -694,7 +828,7 @@ void rrd_stats_remote_write_allmetrics_prometheus(
                             else if(BACKEND_OPTIONS_DATA_SOURCE(backend_options) == BACKEND_SOURCE_DATA_SUM)
                                 suffix = "_sum";
 
-                            prometheus_label_copy(dimension, (backend_options & BACKEND_OPTION_SEND_NAMES && rd->name) ? rd->name : rd->id, PROMETHEUS_ELEMENT_MAX);
+                            dimension = dn->label[names];
                             snprintf(name, PROMETHEUS_LABELS_MAX, "%s_%s%s%s", prefix, context, units, suffix);
 
                             add_metric(name, chart, family, dimension, hostname, rd->last_collected_value, timeval_msec(&rd->last_collected_time));
@@ -705,12 +839,14 @@ void rrd_stats_remote_write_allmetrics_prometheus(
             }
 
             rrdset_unlock(st);
+            netdata_mutex_unlock(&host->prometheus_names_mutex);
         }
     }
+    rrdhost_charts_read_unlock(host, reader);
 }
 #endif /* ENABLE_PROMETHEUS_REMOTE_WRITE */
 
-static inline time_t prometheus_preparation(RRDHOST *host, BUFFER *wb, BACKEND_OPTIONS backend_options, const char *server, time_t now, PROMETHEUS_OUTPUT_OPTIONS output_options) {
+time_t rrd_stats_api_v1_allmetrics_prometheus_preparation(RRDHOST *host, BUFFER *wb, BACKEND_OPTIONS backend_options, const char *server, time_t now, PROMETHEUS_OUTPUT_OPTIONS output_options) {
     if(!server || !*server) server = "default";
 
     time_t after  = prometheus_server_last_access(server, host, now);
@@ -755,7 +891,7 @@ void rrd_stats_api_v1_charts_allmetrics_prometheus_single_host(RRDHOST *host, BU
     time_t before = now_realtime_sec();
 
     // we start at the point we had stopped before
-    time_t after = prometheus_preparation(host, wb, backend_options, server, before, output_options);
+    time_t after = rrd_stats_api_v1_allmetrics_prometheus_preparation(host, wb, backend_options, server, before, output_options);
 
     rrd_stats_api_v1_charts_allmetrics_prometheus(host, wb, prefix, backend_options, after, before, 0, output_options);
 }
@@ -764,7 +900,7 @@ void rrd_stats_api_v1_charts_allmetrics_prometheus_all_hosts(RRDHOST *host, BUFF
     time_t before = now_realtime_sec();
 
     // we start at the point we had stopped before
-    time_t after = prometheus_preparation(host, wb, backend_options, server, before, output_options);
+    time_t after = rrd_stats_api_v1_allmetrics_prometheus_preparation(host, wb, backend_options, server, before, output_options);
 
     rrd_rdlock();
     rrdhost_foreach_read(host) {
@@ -16,9 +16,15 @@ typedef enum prometheus_output_flags {
 	PROMETHEUS_OUTPUT_HIDEUNITS  = (1 << 6)
 } PROMETHEUS_OUTPUT_OPTIONS;
 
+#define PROMETHEUS_LABELS_MAX 1024
+
 extern void rrd_stats_api_v1_charts_allmetrics_prometheus_single_host(RRDHOST *host, BUFFER *wb, const char *server, const char *prefix, BACKEND_OPTIONS backend_options, PROMETHEUS_OUTPUT_OPTIONS output_options);
 extern void rrd_stats_api_v1_charts_allmetrics_prometheus_all_hosts(RRDHOST *host, BUFFER *wb, const char *server, const char *prefix, BACKEND_OPTIONS backend_options, PROMETHEUS_OUTPUT_OPTIONS output_options);
 
+extern time_t rrd_stats_api_v1_allmetrics_prometheus_preparation(RRDHOST *host, BUFFER *wb, BACKEND_OPTIONS backend_options, const char *server, time_t now, PROMETHEUS_OUTPUT_OPTIONS output_options);
+extern void rrd_stats_api_v1_host_allmetrics_prometheus(RRDHOST *host, BUFFER *wb, const char *prefix, BACKEND_OPTIONS backend_options, int allhosts, PROMETHEUS_OUTPUT_OPTIONS output_options, char *labels);
+extern void rrd_stats_api_v1_chart_allmetrics_prometheus(RRDSET *st, BUFFER *wb, const char *prefix, BACKEND_OPTIONS backend_options, time_t after, time_t before, const char *labels, PROMETHEUS_OUTPUT_OPTIONS output_options);
+
 #if ENABLE_PROMETHEUS_REMOTE_WRITE
 extern void rrd_stats_remote_write_allmetrics_prometheus(
         RRDHOST *host
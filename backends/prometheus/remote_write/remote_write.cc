@@ -1,117 +1,223 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
+#include <climits>
+#include <cstring>
+#include <string>
+#include <unordered_map>
 #include <snappy.h>
-#include "remote_write.pb.h"
+#include <google/protobuf/stubs/common.h>
 #include "remote_write.h"
 
-using namespace prometheus;
+/*
+ * The write request is encoded directly in the protocol buffers wire format
+ * of remote_write.proto, into a buffer that is reused on every pass, instead
+ * of building WriteRequest, TimeSeries and Label messages and serializing them.
+ *
+ * The labels of a metric do not change from pass to pass, so their encoded
+ * block is kept, keyed by the values they are encoded from, and only the
+ * sample is encoded again.
+ */
+
+// the wire types and the field numbers of remote_write.proto
+#define WIRE_VARINT 0
+#define WIRE_FIXED64 1
+#define WIRE_LENGTH_DELIMITED 2
+#define FIELD_TAG(field, wire) ((char)(((field) << 3) | (wire)))
+
+#define WRITE_REQUEST_TIMESERIES FIELD_TAG(1, WIRE_LENGTH_DELIMITED)
+#define TIMESERIES_LABELS FIELD_TAG(1, WIRE_LENGTH_DELIMITED)
+#define TIMESERIES_SAMPLES FIELD_TAG(2, WIRE_LENGTH_DELIMITED)
+#define LABEL_NAME FIELD_TAG(1, WIRE_LENGTH_DELIMITED)
+#define LABEL_VALUE FIELD_TAG(2, WIRE_LENGTH_DELIMITED)
+#define SAMPLE_VALUE FIELD_TAG(1, WIRE_FIXED64)
+#define SAMPLE_TIMESTAMP FIELD_TAG(2, WIRE_VARINT)
+
+// the labels not used for so many passes are removed from the cache
+#define LABELS_CACHE_MAX_IDLE_PASSES 60
+
+struct labels_cache_entry {
+    std::string encoded;                // the labels, as they are encoded in a TimeSeries
+    uint32_t pass;                      // the last pass they were used
+};
+
+static std::unordered_map<std::string, labels_cache_entry> labels_cache;
+static uint32_t pass = 0;
+
+static std::string write_request;       // the encoded WriteRequest of the pass
+
+// the timeseries added last, encoded when the next one is added, so that add_tag() can extend it
+static std::string pending_labels;      // its labels, when they are not in the cache
+static const std::string *pending = NULL;
+static double pending_value;
+static int64_t pending_timestamp;
+
+static std::string key;
+
+static inline void encode_varint(std::string &out, uint64_t value) {
+    char buf[10];
+    size_t len = 0;
+
+    while(value >= 0x80) {
+        buf[len++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buf[len++] = (char)value;
 
+    out.append(buf, len);
+}
 
-google::protobuf::Arena arena;
-WriteRequest *write_request;
+static inline size_t varint_size(uint64_t value) {
+    size_t len = 1;
+    while(value >= 0x80) {
+        value >>= 7;
+        len++;
+    }
+    return len;
+}
 
-void init_write_request() {
-    GOOGLE_PROTOBUF_VERIFY_VERSION;
-    write_request = google::protobuf::Arena::CreateMessage<WriteRequest>(&arena);
+static inline void encode_string(std::string &out, char tag, const char *s, size_t len) {
+    out.push_back(tag);
+    encode_varint(out, len);
+    out.append(s, len);
 }
 
-void clear_write_request() {
-    write_request->clear_timeseries();
+static inline void encode_label(std::string &out, const char *name, const char *value) {
+    size_t name_len = strlen(name), value_len = strlen(value);
+    size_t len = 1 + varint_size(name_len) + name_len + 1 + varint_size(value_len) + value_len;
+
+    out.push_back(TIMESERIES_LABELS);
+    encode_varint(out, len);
+    encode_string(out, LABEL_NAME, name, name_len);
+    encode_string(out, LABEL_VALUE, value, value_len);
 }
 
-void add_host_info(const char *name, const char *instance, const char *application, const char *version, const int64_t timestamp) {
-    TimeSeries *timeseries;
-    Sample *sample;
-    Label *label;
+static void flush_pending() {
+    if(!pending) return;
 
-    timeseries = write_request->add_timeseries();
+    uint64_t bits;
+    memcpy(&bits, &pending_value, sizeof(bits));
 
-    label = timeseries->add_labels();
-    label->set_name("__name__");
-    label->set_value(name);
+    size_t sample_len = 1 + 8 + 1 + varint_size((uint64_t)pending_timestamp);
+    size_t len = pending->size() + 1 + varint_size(sample_len) + sample_len;
 
-    label = timeseries->add_labels();
-    label->set_name("instance");
-    label->set_value(instance);
+    write_request.push_back(WRITE_REQUEST_TIMESERIES);
+    encode_varint(write_request, len);
+    write_request.append(*pending);
 
-    if(application) {
-        label = timeseries->add_labels();
-        label->set_name("application");
-        label->set_value(application);
-    }
+    write_request.push_back(TIMESERIES_SAMPLES);
+    encode_varint(write_request, sample_len);
 
-    if(version) {
-        label = timeseries->add_labels();
-        label->set_name("version");
-        label->set_value(version);
-    }
+    char value[9];
+    value[0] = SAMPLE_VALUE;
+    for(int i = 1; i < 9; i++, bits >>= 8)
+        value[i] = (char)(bits & 0xff);
+    write_request.append(value, sizeof(value));
 
-    sample = timeseries->add_samples();
-    sample->set_value(1);
-    sample->set_timestamp(timestamp);
+    write_request.push_back(SAMPLE_TIMESTAMP);
+    encode_varint(write_request, (uint64_t)pending_timestamp);
+
+    pending = NULL;
 }
 
-// adds tag to the last created timeseries
-void add_tag(char *tag, char *value) {
-    TimeSeries *timeseries;
-    Label *label;
+static inline void add_pending(const std::string *labels, const double value, const int64_t timestamp) {
+    flush_pending();
 
-    timeseries = write_request->mutable_timeseries(write_request->timeseries_size() - 1);
+    pending = labels;
+    pending_value = value;
+    pending_timestamp = timestamp;
+}
 
-    label = timeseries->add_labels();
-    label->set_name(tag);
-    label->set_value(value);
+void init_write_request() {
+    GOOGLE_PROTOBUF_VERIFY_VERSION;
 }
 
-void add_metric(const char *name, const char *chart, const char *family, const char *dimension, const char *instance, const double value, const int64_t timestamp) {
-    TimeSeries *timeseries;
-    Sample *sample;
-    Label *label;
+void clear_write_request() {
+    write_request.clear();
+    pending = NULL;
+
+    if(!(++pass % LABELS_CACHE_MAX_IDLE_PASSES)) {
+        for(auto it = labels_cache.begin(); it != labels_cache.end(); ) {
+            if(pass - it->second.pass > LABELS_CACHE_MAX_IDLE_PASSES)
+                it = labels_cache.erase(it);
+            else
+                ++it;
+        }
+    }
+}
 
-    timeseries = write_request->add_timeseries();
+void add_host_info(const char *name, const char *instance, const char *application, const char *version, const int64_t timestamp) {
+    flush_pending();
+
+    pending_labels.clear();
+    encode_label(pending_labels, "__name__", name);
+    encode_label(pending_labels, "instance", instance);
 
-    label = timeseries->add_labels();
-    label->set_name("__name__");
-    label->set_value(name);
+    if(application)
+        encode_label(pending_labels, "application", application);
 
-    label = timeseries->add_labels();
-    label->set_name("chart");
-    label->set_value(chart);
+    if(version)
+        encode_label(pending_labels, "version", version);
+
+    add_pending(&pending_labels, 1, timestamp);
+}
 
-    label = timeseries->add_labels();
-    label->set_name("family");
-    label->set_value(family);
+// adds tag to the last created timeseries
+void add_tag(char *tag, char *value) {
+    if(!pending) return;
 
-    if(dimension) {
-        label = timeseries->add_labels();
-        label->set_name("dimension");
-        label->set_value(dimension);
+    // the cached labels of a metric are not extended
+    if(pending != &pending_labels) {
+        pending_labels = *pending;
+        pending = &pending_labels;
     }
 
-    label = timeseries->add_labels();
-    label->set_name("instance");
-    label->set_value(instance);
+    encode_label(pending_labels, tag, value);
+}
+
+void add_metric(const char *name, const char *chart, const char *family, const char *dimension, const char *instance, const double value, const int64_t timestamp) {
+    key.clear();
+    key.append(name).push_back('\0');
+    key.append(chart).push_back('\0');
+    key.append(family).push_back('\0');
+    if(dimension) key.append(dimension);
+    key.push_back('\0');
+    key.append(instance);
+
+    labels_cache_entry &entry = labels_cache[key];
+    if(entry.encoded.empty()) {
+        encode_label(entry.encoded, "__name__", name);
+        encode_label(entry.encoded, "chart", chart);
+        encode_label(entry.encoded, "family", family);
+
+        if(dimension)
+            encode_label(entry.encoded, "dimension", dimension);
+
+        encode_label(entry.encoded, "instance", instance);
+    }
+    entry.pass = pass;
 
-    sample = timeseries->add_samples();
-    sample->set_value(value);
-    sample->set_timestamp(timestamp);
+    add_pending(&entry.encoded, value, timestamp);
 }
 
 size_t get_write_request_size(){
-    size_t size = (size_t)snappy::MaxCompressedLength(write_request->ByteSize());
+    flush_pending();
+
+    size_t size = (size_t)snappy::MaxCompressedLength(write_request.size());
 
     return (size < INT_MAX)?size:0;
 }
 
 int pack_write_request(char *buffer, size_t *size) {
-    std::string uncompressed_write_request;
-    if(write_request->SerializeToString(&uncompressed_write_request) == false) return 1;
+    flush_pending();
+
+    if(*size < snappy::MaxCompressedLength(write_request.size())) return 1;
 
-    snappy::RawCompress(uncompressed_write_request.data(), uncompressed_write_request.size(), buffer, size);
+    snappy::RawCompress(write_request.data(), write_request.size(), buffer, size);
 
     return 0;
 }
 
 void protocol_buffers_shutdown() {
+    labels_cache.clear();
     google::protobuf::ShutdownProtobufLibrary();
 }
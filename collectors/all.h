@@ -45,6 +45,7 @@
 #define NETDATA_CHART_PRIO_SYSTEM_ACTIVE_PROCESSES     750
 #define NETDATA_CHART_PRIO_SYSTEM_CTXT                 800
 #define NETDATA_CHART_PRIO_SYSTEM_IDLEJITTER           800
+#define NETDATA_CHART_PRIO_SYSTEM_IDLEJITTER_PERCENTILES 801
 #define NETDATA_CHART_PRIO_SYSTEM_INTR                 900
 #define NETDATA_CHART_PRIO_SYSTEM_SOFTIRQS             950
 #define NETDATA_CHART_PRIO_SYSTEM_SOFTNET_STAT         955
@@ -69,6 +70,7 @@
 #define NETDATA_CHART_PRIO_CPU_TEMPERATURE            1050 // freebsd only
 #define NETDATA_CHART_PRIO_CPUFREQ_SCALING_CUR_FREQ   5003 // freebsd only
 #define NETDATA_CHART_PRIO_CPUIDLE                    6000
+#define NETDATA_CHART_PRIO_CPU_IDLEJITTER             7000 // +1 per core
 
 #define NETDATA_CHART_PRIO_CORE_THROTTLING            5001
 #define NETDATA_CHART_PRIO_PACKAGE_THROTTLING         5002
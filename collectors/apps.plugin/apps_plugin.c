@@ -70,6 +70,10 @@ static inline void debug_log_dummy(void) {}
 
 #ifdef __FreeBSD__
 #include <sys/user.h>
+#else
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
 #endif
 
 // ----------------------------------------------------------------------------
@@ -127,6 +131,10 @@ static int
 #else
         enable_file_charts = 1,
         max_fds_cache_seconds = 60,
+        enable_proc_events = 1,
+        idle_read_every = 10,
+        full_scan_every = 60,
+        read_threads = 1,
 #endif
         enable_users_charts = 1,
         enable_groups_charts = 1,
@@ -158,6 +166,9 @@ static size_t
         links_changed_counter = 0,
         targets_assignment_counter = 0;
 
+// the processes may be read by many threads
+#define apps_counter_inc(counter) __atomic_add_fetch(&(counter), 1, __ATOMIC_RELAXED)
+
 
 // ----------------------------------------------------------------------------
 // Normalization
@@ -370,6 +381,7 @@ struct pid_stat {
     kernel_uint_t status_vmswap;
 #ifndef __FreeBSD__
     ARL_BASE *status_arl;
+    struct arl_callback_ptr *status_arl_ptr;
 #endif
 
     kernel_uint_t io_logical_bytes_read_raw;
@@ -397,6 +409,9 @@ struct pid_stat {
     unsigned char updated:1;        // 1 when the process is currently running
     unsigned char merged:1;         // 1 when it has been merged to its parent
     unsigned char read:1;           // 1 when we have already read this process for this iteration
+    unsigned char dirty:1;          // 1 when a process event requires reading it in this iteration
+    unsigned char idle:1;           // 1 when it had no activity the last time it was read
+    int idle_skips;                 // the iterations it has not been read, while idle
 
     int sortlist;                   // higher numbers = top on the process tree
                                     // each process gets a unique number
@@ -418,6 +433,12 @@ struct pid_stat {
     char *io_filename;
     char *cmdline_filename;
 
+#ifndef __FreeBSD__
+    int stat_fd;                    // the files above, kept open between iterations, or -1
+    int status_fd;
+    int io_fd;
+#endif
+
     struct pid_stat *parent;
     struct pid_stat *prev;
     struct pid_stat *next;
@@ -473,13 +494,12 @@ typedef enum fd_filetype {
 } FD_FILETYPE;
 
 struct file_descriptor {
-    avl avl;
-
 #ifdef NETDATA_INTERNAL_CHECKS
     uint32_t magic;
 #endif /* NETDATA_INTERNAL_CHECKS */
 
-    const char *name;
+    const char *name;               // NULL for sockets and pipes, found by their inode
+    uint64_t inode;
     uint32_t hash;
 
     FD_FILETYPE type;
@@ -722,6 +742,79 @@ static int read_apps_groups_conf(const char *path, const char *file)
 }
 
 
+// ----------------------------------------------------------------------------
+// the files of the processes
+//
+// /proc/PID/stat, status and io are kept open while the process runs, and are
+// read with pread(), so that each read is one system call instead of open(),
+// read(), lseek() and close() - while enough file descriptors are left for the
+// rest of the work (the files of the other processes are re-opened every time).
+
+#ifndef __FreeBSD__
+#define PID_FILES_SPARE_FDS 256
+
+static size_t
+        pid_files_open = 0,
+        pid_files_max = 0;
+
+static inline procfile *pid_file_reopen(procfile *ff, int *fd, const char *filename, const char *separators) {
+    if(unlikely(*fd == -1 && __atomic_load_n(&pid_files_open, __ATOMIC_RELAXED) < pid_files_max)) {
+        *fd = open(filename, procfile_open_flags, 0666);
+        if(unlikely(*fd == -1)) {
+            if(errno != EMFILE && errno != ENFILE) {
+                procfile_close(ff);
+                return NULL;
+            }
+
+            error("Cannot keep more than %zu files of processes open.", pid_files_open);
+            pid_files_max = pid_files_open;
+        }
+        else
+            __atomic_add_fetch(&pid_files_open, 1, __ATOMIC_RELAXED);
+    }
+
+    if(likely(*fd != -1))
+        return procfile_reopen_fd(ff, *fd, separators, PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
+
+    return procfile_reopen(ff, filename, separators, PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
+}
+
+static inline void close_pid_file(int *fd) {
+    if(*fd != -1) {
+        close(*fd);
+        *fd = -1;
+        __atomic_sub_fetch(&pid_files_open, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void close_pid_files(struct pid_stat *p) {
+    close_pid_file(&p->stat_fd);
+    close_pid_file(&p->status_fd);
+    close_pid_file(&p->io_fd);
+}
+
+// the processes may be many, allow as many open files as possible
+static void init_pid_files(void) {
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) != 0)
+        return;
+
+    if(rl.rlim_cur < rl.rlim_max) {
+        rlim_t max = rl.rlim_max;
+        rl.rlim_cur = max;
+        if(setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+            info("Cannot raise the limit of open files to %llu", (unsigned long long)max);
+            getrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+
+    if(rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur > PID_FILES_SPARE_FDS)
+        pid_files_max = (size_t)(rl.rlim_cur - PID_FILES_SPARE_FDS);
+    else if(rl.rlim_cur == RLIM_INFINITY)
+        pid_files_max = (size_t)pid_max * 3;
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // struct pid_stat management
 static inline void init_pid_fds(struct pid_stat *p, size_t first, size_t size);
@@ -743,6 +836,12 @@ static inline struct pid_stat *get_pid_entry(pid_t pid) {
 
     p->pid = pid;
 
+#ifndef __FreeBSD__
+    p->stat_fd = -1;
+    p->status_fd = -1;
+    p->io_fd = -1;
+#endif
+
     all_pids[pid] = p;
     all_pids_count++;
 
@@ -781,6 +880,8 @@ static inline void del_pid_entry(pid_t pid) {
     freez(p->status_filename);
 #ifndef __FreeBSD__
     arl_free(p->status_arl);
+    freez(p->status_arl_ptr);
+    close_pid_files(p);
 #endif
     freez(p->io_filename);
     freez(p->cmdline_filename);
@@ -853,7 +954,7 @@ static inline int managed_log(struct pid_stat *p, uint32_t log, int status) {
 }
 
 static inline void assign_target_to_pid(struct pid_stat *p) {
-    targets_assignment_counter++;
+    apps_counter_inc(targets_assignment_counter);
 
     uint32_t hash = simple_hash(p->comm);
     size_t pclen  = strlen(p->comm);
@@ -890,7 +991,7 @@ static inline void assign_target_to_pid(struct pid_stat *p) {
 // update pids from proc
 
 static inline int read_proc_pid_cmdline(struct pid_stat *p) {
-    static char cmdline[MAX_CMDLINE + 1];
+    static __thread char cmdline[MAX_CMDLINE + 1];
 
 #ifdef __FreeBSD__
     size_t i, bytes = MAX_CMDLINE;
@@ -1051,18 +1152,20 @@ static inline int read_proc_pid_status(struct pid_stat *p, void *ptr) {
 #else
     (void)ptr;
 
-    static struct arl_callback_ptr arl_ptr;
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     if(unlikely(!p->status_arl)) {
+        // each process has its own, since it may be read by any thread
+        struct arl_callback_ptr *arl_ptr = p->status_arl_ptr = callocz(1, sizeof(struct arl_callback_ptr));
+
         p->status_arl = arl_create("/proc/pid/status", NULL, 60);
-        arl_expect_custom(p->status_arl, "Uid", arl_callback_status_uid, &arl_ptr);
-        arl_expect_custom(p->status_arl, "Gid", arl_callback_status_gid, &arl_ptr);
-        arl_expect_custom(p->status_arl, "VmSize", arl_callback_status_vmsize, &arl_ptr);
-        arl_expect_custom(p->status_arl, "VmRSS", arl_callback_status_vmrss, &arl_ptr);
-        arl_expect_custom(p->status_arl, "RssFile", arl_callback_status_rssfile, &arl_ptr);
-        arl_expect_custom(p->status_arl, "RssShmem", arl_callback_status_rssshmem, &arl_ptr);
-        arl_expect_custom(p->status_arl, "VmSwap", arl_callback_status_vmswap, &arl_ptr);
+        arl_expect_custom(p->status_arl, "Uid", arl_callback_status_uid, arl_ptr);
+        arl_expect_custom(p->status_arl, "Gid", arl_callback_status_gid, arl_ptr);
+        arl_expect_custom(p->status_arl, "VmSize", arl_callback_status_vmsize, arl_ptr);
+        arl_expect_custom(p->status_arl, "VmRSS", arl_callback_status_vmrss, arl_ptr);
+        arl_expect_custom(p->status_arl, "RssFile", arl_callback_status_rssfile, arl_ptr);
+        arl_expect_custom(p->status_arl, "RssShmem", arl_callback_status_rssshmem, arl_ptr);
+        arl_expect_custom(p->status_arl, "VmSwap", arl_callback_status_vmswap, arl_ptr);
     }
 
     if(unlikely(!p->status_filename)) {
@@ -1071,24 +1174,25 @@ static inline int read_proc_pid_status(struct pid_stat *p, void *ptr) {
         p->status_filename = strdupz(filename);
     }
 
-    ff = procfile_reopen(ff, p->status_filename, (!ff)?" \t:,-()/":NULL, PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
+    ff = pid_file_reopen(ff, &p->status_fd, p->status_filename, (!ff)?" \t:,-()/":NULL);
     if(unlikely(!ff)) return 0;
 
     ff = procfile_readall(ff);
     if(unlikely(!ff)) return 0;
 
-    calls_counter++;
+    apps_counter_inc(calls_counter);
 
     // let ARL use this pid
-    arl_ptr.p = p;
-    arl_ptr.ff = ff;
+    struct arl_callback_ptr *arl_ptr = p->status_arl_ptr;
+    arl_ptr->p = p;
+    arl_ptr->ff = ff;
 
     size_t lines = procfile_lines(ff), l;
     arl_begin(p->status_arl);
 
     for(l = 0; l < lines ;l++) {
         // debug_log("CHECK: line %zu of %zu, key '%s' = '%s'", l, lines, procfile_lineword(ff, l, 0), procfile_lineword(ff, l, 1));
-        arl_ptr.line = l;
+        arl_ptr->line = l;
         if(unlikely(arl_check(p->status_arl,
                 procfile_lineword(ff, l, 0),
                 procfile_lineword(ff, l, 1)))) break;
@@ -1114,7 +1218,7 @@ static inline int read_proc_pid_stat(struct pid_stat *p, void *ptr) {
     if (unlikely(proc_info->ki_tdflags & TDF_IDLETD))
         goto cleanup;
 #else
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     if(unlikely(!p->stat_filename)) {
         char filename[FILENAME_MAX + 1];
@@ -1122,22 +1226,35 @@ static inline int read_proc_pid_stat(struct pid_stat *p, void *ptr) {
         p->stat_filename = strdupz(filename);
     }
 
-    int set_quotes = (!ff)?1:0;
+    int retry = (p->stat_fd != -1);
 
-    ff = procfile_reopen(ff, p->stat_filename, NULL, PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
-    if(unlikely(!ff)) goto cleanup;
+reread:
+    {
+        int set_quotes = (!ff)?1:0;
+
+        ff = pid_file_reopen(ff, &p->stat_fd, p->stat_filename, NULL);
+        if(unlikely(!ff)) goto cleanup;
 
-    // if(set_quotes) procfile_set_quotes(ff, "()");
-    if(unlikely(set_quotes))
-        procfile_set_open_close(ff, "(", ")");
+        // if(set_quotes) procfile_set_quotes(ff, "()");
+        if(unlikely(set_quotes))
+            procfile_set_open_close(ff, "(", ")");
+    }
 
     ff = procfile_readall(ff);
-    if(unlikely(!ff)) goto cleanup;
+    if(unlikely(!ff)) {
+        // the files kept open are of a process that exited - its pid may now be of another one
+        if(retry) {
+            retry = 0;
+            close_pid_files(p);
+            goto reread;
+        }
+        goto cleanup;
+    }
 #endif
 
     p->last_stat_collected_usec = p->stat_collected_usec;
     p->stat_collected_usec = now_monotonic_usec();
-    calls_counter++;
+    apps_counter_inc(calls_counter);
 
 #ifdef __FreeBSD__
     char *comm          = proc_info->ki_comm;
@@ -1274,7 +1391,7 @@ static inline int read_proc_pid_io(struct pid_stat *p, void *ptr) {
 #ifdef __FreeBSD__
     struct kinfo_proc *proc_info = (struct kinfo_proc *)ptr;
 #else
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     if(unlikely(!p->io_filename)) {
         char filename[FILENAME_MAX + 1];
@@ -1283,14 +1400,14 @@ static inline int read_proc_pid_io(struct pid_stat *p, void *ptr) {
     }
 
     // open the file
-    ff = procfile_reopen(ff, p->io_filename, NULL, PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
+    ff = pid_file_reopen(ff, &p->io_fd, p->io_filename, NULL);
     if(unlikely(!ff)) goto cleanup;
 
     ff = procfile_readall(ff);
     if(unlikely(!ff)) goto cleanup;
 #endif
 
-    calls_counter++;
+    apps_counter_inc(calls_counter);
 
     p->last_io_collected_usec = p->io_collected_usec;
     p->io_collected_usec = now_monotonic_usec();
@@ -1352,7 +1469,7 @@ static inline int read_global_time() {
     last_collected_usec = collected_usec;
     collected_usec = now_monotonic_usec();
 
-    calls_counter++;
+    apps_counter_inc(calls_counter);
 
     // temporary - it is added global_ntime;
     kernel_uint_t global_ntime = 0;
@@ -1410,7 +1527,7 @@ static inline int read_global_time() {
     last_collected_usec = collected_usec;
     collected_usec = now_monotonic_usec();
 
-    calls_counter++;
+    apps_counter_inc(calls_counter);
 
     // temporary - it is added global_ntime;
     kernel_uint_t global_ntime = 0;
@@ -1438,49 +1555,121 @@ cleanup:
 #endif /* !__FreeBSD__ */
 
 // ----------------------------------------------------------------------------
+// the index of all_files
+//
+// an open addressing (linear probing) hash table, with the positions of the
+// files in all_files (0 is an empty bucket, all_files[0] is never used).
+// Sockets and pipes (socket:[INODE] and pipe:[INODE]) are the vast majority
+// of the files of a busy system: they are indexed by their type and inode,
+// without keeping their names, so they are found without comparing strings.
 
-int file_descriptor_compare(void* a, void* b) {
-#ifdef NETDATA_INTERNAL_CHECKS
-    if(((struct file_descriptor *)a)->magic != 0x0BADCAFE || ((struct file_descriptor *)b)->magic != 0x0BADCAFE)
-        error("Corrupted index data detected. Please report this.");
-#endif /* NETDATA_INTERNAL_CHECKS */
-
-    if(((struct file_descriptor *)a)->hash < ((struct file_descriptor *)b)->hash)
-        return -1;
+static int *all_files_index = NULL;
+static size_t all_files_index_size = 0;     // always a power of 2
 
-    else if(((struct file_descriptor *)a)->hash > ((struct file_descriptor *)b)->hash)
-        return 1;
+static inline int file_descriptor_parse_inode(const char *name, FD_FILETYPE *type, uint64_t *inode) {
+    const char *s;
 
+    if(name[0] == 's' && !strncmp(name, "socket:[", 8)) {
+        *type = FILETYPE_SOCKET;
+        s = &name[8];
+    }
+    else if(name[0] == 'p' && !strncmp(name, "pipe:[", 6)) {
+        *type = FILETYPE_PIPE;
+        s = &name[6];
+    }
     else
-        return strcmp(((struct file_descriptor *)a)->name, ((struct file_descriptor *)b)->name);
+        return 0;
+
+    if(unlikely(*s < '0' || *s > '9'))
+        return 0;
+
+    uint64_t n = 0;
+    while(*s >= '0' && *s <= '9')
+        n = n * 10 + (uint64_t)(*s++ - '0');
+
+    if(unlikely(s[0] != ']' || s[1] != '\0'))
+        return 0;
+
+    *inode = n;
+    return 1;
 }
 
-// int file_descriptor_iterator(avl *a) { if(a) {}; return 0; }
+static inline uint32_t file_descriptor_inode_hash(FD_FILETYPE type, uint64_t inode) {
+    return (uint32_t)(((inode << 4 | (uint64_t)type) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
 
-avl_tree all_files_index = {
-        NULL,
-        file_descriptor_compare
-};
+static inline int file_descriptor_matches(struct file_descriptor *fd, const char *name, uint32_t hash, FD_FILETYPE type, uint64_t inode) {
+    if(fd->hash != hash)
+        return 0;
 
-static struct file_descriptor *file_descriptor_find(const char *name, uint32_t hash) {
-    struct file_descriptor tmp;
-    tmp.hash = (hash)?hash:simple_hash(name);
-    tmp.name = name;
-    tmp.count = 0;
-    tmp.pos = 0;
-#ifdef NETDATA_INTERNAL_CHECKS
-    tmp.magic = 0x0BADCAFE;
-#endif /* NETDATA_INTERNAL_CHECKS */
+    if(name)
+        return fd->name && !strcmp(fd->name, name);
 
-    return (struct file_descriptor *)avl_search(&all_files_index, (avl *) &tmp);
+    return !fd->name && fd->type == type && fd->inode == inode;
 }
 
-#define file_descriptor_add(fd) avl_insert(&all_files_index, (avl *)(fd))
-#define file_descriptor_remove(fd) avl_remove(&all_files_index, (avl *)(fd))
+// name is NULL for the files indexed by inode
+static struct file_descriptor *file_descriptor_find(const char *name, uint32_t hash, FD_FILETYPE type, uint64_t inode) {
+    if(unlikely(!all_files_index_size))
+        return NULL;
+
+    size_t mask = all_files_index_size - 1, i;
+    for(i = hash & mask; all_files_index[i] ; i = (i + 1) & mask) {
+        struct file_descriptor *fd = &all_files[all_files_index[i]];
+        if(file_descriptor_matches(fd, name, hash, type, inode))
+            return fd;
+    }
+
+    return NULL;
+}
+
+static inline void file_descriptor_add(struct file_descriptor *fd) {
+    size_t mask = all_files_index_size - 1, i;
+    for(i = fd->hash & mask; all_files_index[i] ; i = (i + 1) & mask) ;
+    all_files_index[i] = fd->pos;
+}
+
+static inline void file_descriptor_remove(struct file_descriptor *fd) {
+    size_t mask = all_files_index_size - 1, i, j;
+
+    for(i = fd->hash & mask; all_files_index[i] != fd->pos ; i = (i + 1) & mask) {
+        if(unlikely(!all_files_index[i])) {
+            error("INTERNAL ERROR: removal of fd %d that is not in the index.", fd->pos);
+            return;
+        }
+    }
+
+    // move back the entries that follow it, so that no search stops at the emptied bucket
+    for(j = (i + 1) & mask; all_files_index[j] ; j = (j + 1) & mask) {
+        size_t k = all_files[all_files_index[j]].hash & mask;
+
+        if((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            all_files_index[i] = all_files_index[j];
+            i = j;
+        }
+    }
+
+    all_files_index[i] = 0;
+}
+
+static inline void file_descriptor_index_rebuild(size_t size) {
+    freez(all_files_index);
+    all_files_index = callocz(size, sizeof(int));
+    all_files_index_size = size;
+
+    int i;
+    for(i = 1; i < all_files_size; i++)
+        if(all_files[i].count)
+            file_descriptor_add(&all_files[i]);
+}
 
 // ----------------------------------------------------------------------------
+// all_files is shared by the threads reading the processes, so it is changed
+// only with all_files_mutex locked
+
+static netdata_mutex_t all_files_mutex = NETDATA_MUTEX_INITIALIZER;
 
-static inline void file_descriptor_not_used(int id)
+static inline void file_descriptor_not_used_unsafe(int id)
 {
     if(id > 0 && id < all_files_size) {
 
@@ -1499,8 +1688,7 @@ static inline void file_descriptor_not_used(int id)
             if(!all_files[id].count) {
                 debug_log("  >> slot %d is empty.", id);
 
-                if(unlikely(file_descriptor_remove(&all_files[id]) != (void *)&all_files[id]))
-                    error("INTERNAL ERROR: removal of unused fd from index, removed a different fd");
+                file_descriptor_remove(&all_files[id]);
 
 #ifdef NETDATA_INTERNAL_CHECKS
                 all_files[id].magic = 0x00000000;
@@ -1509,39 +1697,24 @@ static inline void file_descriptor_not_used(int id)
             }
         }
         else
-            error("Request to decrease counter of fd %d (%s), while the use counter is 0", id, all_files[id].name);
+            error("Request to decrease counter of fd %d (%s, inode %llu), while the use counter is 0", id, all_files[id].name?all_files[id].name:"unnamed", (unsigned long long)all_files[id].inode);
     }
     else    error("Request to decrease counter of fd %d, which is outside the array size (1 to %d)", id, all_files_size);
 }
 
 static inline void all_files_grow() {
-    void *old = all_files;
-    int i;
+    int i, size = (all_files_size)?all_files_size * 2:FILE_DESCRIPTORS_INCREASE_STEP;
 
     // there is no empty slot
-    debug_log("extending fd array to %d entries", all_files_size + FILE_DESCRIPTORS_INCREASE_STEP);
-
-    all_files = reallocz(all_files, (all_files_size + FILE_DESCRIPTORS_INCREASE_STEP) * sizeof(struct file_descriptor));
+    debug_log("extending fd array to %d entries", size);
 
-    // if the address changed, we have to rebuild the index
-    // since all pointers are now invalid
-
-    if(unlikely(old && old != (void *)all_files)) {
-        debug_log("  >> re-indexing.");
-
-        all_files_index.root = NULL;
-        for(i = 0; i < all_files_size; i++) {
-            if(!all_files[i].count) continue;
-            if(unlikely(file_descriptor_add(&all_files[i]) != (void *)&all_files[i]))
-                error("INTERNAL ERROR: duplicate indexing of fd during realloc.");
-        }
-
-        debug_log("  >> re-indexing done.");
-    }
+    // the index has the positions of the files, not their addresses,
+    // so it remains valid when all_files moves
+    all_files = reallocz(all_files, size * sizeof(struct file_descriptor));
 
     // initialize the newly added entries
 
-    for(i = all_files_size; i < (all_files_size + FILE_DESCRIPTORS_INCREASE_STEP); i++) {
+    for(i = all_files_size; i < size; i++) {
         all_files[i].count = 0;
         all_files[i].name = NULL;
 #ifdef NETDATA_INTERNAL_CHECKS
@@ -1551,10 +1724,19 @@ static inline void all_files_grow() {
     }
 
     if(unlikely(!all_files_size)) all_files_len = 1;
-    all_files_size += FILE_DESCRIPTORS_INCREASE_STEP;
+    all_files_size = size;
+
+    // keep the index at most half full
+    if(all_files_index_size < (size_t)all_files_size * 2) {
+        size_t index_size = all_files_index_size?all_files_index_size:256;
+        while(index_size < (size_t)all_files_size * 2) index_size *= 2;
+
+        debug_log("  >> re-indexing to %zu buckets.", index_size);
+        file_descriptor_index_rebuild(index_size);
+    }
 }
 
-static inline int file_descriptor_set_on_empty_slot(const char *name, uint32_t hash, FD_FILETYPE type) {
+static inline int file_descriptor_set_on_empty_slot(const char *name, uint32_t hash, FD_FILETYPE type, uint64_t inode) {
     // check we have enough memory to add it
     if(!all_files || all_files_len == all_files_size)
         all_files_grow();
@@ -1573,11 +1755,11 @@ static inline int file_descriptor_set_on_empty_slot(const char *name, uint32_t h
             debug_log("  >> Examining slot %d.", c);
 
 #ifdef NETDATA_INTERNAL_CHECKS
-            if(all_files[c].magic == 0x0BADCAFE && all_files[c].name && file_descriptor_find(all_files[c].name, all_files[c].hash))
-                error("fd on position %d is not cleared properly. It still has %s in it.", c, all_files[c].name);
+            if(all_files[c].magic == 0x0BADCAFE && file_descriptor_find(all_files[c].name, all_files[c].hash, all_files[c].type, all_files[c].inode))
+                error("fd on position %d is not cleared properly. It still has %s in it.", c, all_files[c].name?all_files[c].name:"an inode");
 #endif /* NETDATA_INTERNAL_CHECKS */
 
-            debug_log("  >> %s fd position %d for %s (last name: %s)", all_files[c].name?"re-using":"using", c, name, all_files[c].name);
+            debug_log("  >> %s fd position %d for %s (last name: %s)", all_files[c].name?"re-using":"using", c, name?name:"an inode", all_files[c].name);
 
             freez((void *)all_files[c].name);
             all_files[c].name = NULL;
@@ -1596,7 +1778,8 @@ static inline int file_descriptor_set_on_empty_slot(const char *name, uint32_t h
 
     debug_log("  >> updating slot %d.", c);
 
-    all_files[c].name = strdupz(name);
+    all_files[c].name = (name)?strdupz(name):NULL;
+    all_files[c].inode = inode;
     all_files[c].hash = hash;
     all_files[c].type = type;
     all_files[c].pos  = c;
@@ -1604,21 +1787,28 @@ static inline int file_descriptor_set_on_empty_slot(const char *name, uint32_t h
 #ifdef NETDATA_INTERNAL_CHECKS
     all_files[c].magic = 0x0BADCAFE;
 #endif /* NETDATA_INTERNAL_CHECKS */
-    if(unlikely(file_descriptor_add(&all_files[c]) != (void *)&all_files[c]))
-        error("INTERNAL ERROR: duplicate indexing of fd.");
+    file_descriptor_add(&all_files[c]);
 
     debug_log("using fd position %d (name: %s)", c, all_files[c].name);
 
     return c;
 }
 
-static inline int file_descriptor_find_or_add(const char *name, uint32_t hash) {
-    if(unlikely(!hash))
-        hash = simple_hash(name);
+static inline int file_descriptor_find_or_add_unsafe(const char *name, uint32_t hash) {
 
     debug_log("adding or finding name '%s' with hash %u", name, hash);
 
-    struct file_descriptor *fd = file_descriptor_find(name, hash);
+    FD_FILETYPE type = FILETYPE_OTHER;
+    uint64_t inode = 0;
+
+    if(file_descriptor_parse_inode(name, &type, &inode)) {
+        hash = file_descriptor_inode_hash(type, inode);
+        name = NULL;
+    }
+    else if(unlikely(!hash))
+        hash = simple_hash(name);
+
+    struct file_descriptor *fd = file_descriptor_find(name, hash, type, inode);
     if(fd) {
         // found
         debug_log("  >> found on slot %d", fd->pos);
@@ -1628,8 +1818,9 @@ static inline int file_descriptor_find_or_add(const char *name, uint32_t hash) {
     }
     // not found
 
-    FD_FILETYPE type;
-    if(likely(name[0] == '/')) type = FILETYPE_FILE;
+    if(!name)
+        ; // the type of sockets and pipes is already set
+    else if(likely(name[0] == '/')) type = FILETYPE_FILE;
     else if(likely(strncmp(name, "pipe:", 5) == 0)) type = FILETYPE_PIPE;
     else if(likely(strncmp(name, "socket:", 7) == 0)) type = FILETYPE_SOCKET;
     else if(likely(strncmp(name, "anon_inode:", 11) == 0)) {
@@ -1651,7 +1842,25 @@ static inline int file_descriptor_find_or_add(const char *name, uint32_t hash) {
         type = FILETYPE_OTHER;
     }
 
-    return file_descriptor_set_on_empty_slot(name, hash, type);
+    return file_descriptor_set_on_empty_slot(name, hash, type, inode);
+}
+
+
+static inline int file_descriptor_find_or_add(const char *name, uint32_t hash) {
+    if(unlikely(!hash))
+        hash = simple_hash(name);
+
+    netdata_mutex_lock(&all_files_mutex);
+    int pos = file_descriptor_find_or_add_unsafe(name, hash);
+    netdata_mutex_unlock(&all_files_mutex);
+
+    return pos;
+}
+
+static inline void file_descriptor_not_used(int id) {
+    netdata_mutex_lock(&all_files_mutex);
+    file_descriptor_not_used_unsafe(id);
+    netdata_mutex_unlock(&all_files_mutex);
 }
 
 static inline void clear_pid_fd(struct pid_fd *pfd) {
@@ -1877,7 +2086,7 @@ static inline int read_pid_file_descriptors(struct pid_stat *p, void *ptr) {
 
         if(unlikely(p->fds[fdid].fd < 0 && de->d_ino != p->fds[fdid].inode)) {
             // inodes do not match, clear the previous entry
-            inodes_changed_counter++;
+            apps_counter_inc(inodes_changed_counter);
             file_descriptor_not_used(-p->fds[fdid].fd);
             clear_pid_fd(&p->fds[fdid]);
         }
@@ -1889,13 +2098,13 @@ static inline int read_pid_file_descriptors(struct pid_stat *p, void *ptr) {
         }
 
         if(unlikely(!p->fds[fdid].filename)) {
-            filenames_allocated_counter++;
+            apps_counter_inc(filenames_allocated_counter);
             char fdname[FILENAME_MAX + 1];
             snprintfz(fdname, FILENAME_MAX, "%s/proc/%d/fd/%s", netdata_configured_host_prefix, p->pid, de->d_name);
             p->fds[fdid].filename = strdupz(fdname);
         }
 
-        file_counter++;
+        apps_counter_inc(file_counter);
         ssize_t l = readlink(p->fds[fdid].filename, linkname, FILENAME_MAX);
         if(unlikely(l == -1)) {
             // cannot read the link
@@ -1917,7 +2126,7 @@ static inline int read_pid_file_descriptors(struct pid_stat *p, void *ptr) {
 
         if(unlikely(p->fds[fdid].fd < 0 && p->fds[fdid].link_hash != link_hash)) {
             // the link changed
-            links_changed_counter++;
+            apps_counter_inc(links_changed_counter);
             file_descriptor_not_used(-p->fds[fdid].fd);
             clear_pid_fd(&p->fds[fdid]);
         }
@@ -2267,6 +2476,187 @@ static int compar_pid(const void *pid1, const void *pid2) {
 }
 #endif
 
+// ----------------------------------------------------------------------------
+// process events
+//
+// with the proc connector of the kernel, we learn the processes that started,
+// exec'd or exited since the last iteration. So /proc does not have to be
+// scanned on every iteration (only every full_scan_every iterations, and when
+// events have been lost), and the processes without any activity can be read
+// only every idle_read_every iterations - they are still running, since we
+// would have received their exit.
+
+#ifndef __FreeBSD__
+static int proc_events_fd = -1;
+static int proc_events_lost = 1;            // 1 when /proc has to be scanned, since events may be missing
+
+static pid_t *proc_events_new_pids = NULL;  // the processes started since the last iteration
+static size_t proc_events_new_pids_count = 0, proc_events_new_pids_size = 0;
+
+static int proc_events_open(void) {
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if(fd == -1) {
+        error("Cannot create the netlink socket of the process events.");
+        return -1;
+    }
+
+    struct sockaddr_nl sa = {
+            .nl_family = AF_NETLINK,
+            .nl_groups = CN_IDX_PROC,
+            .nl_pid = 0
+    };
+
+    if(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1) {
+        error("Cannot bind the netlink socket of the process events.");
+        close(fd);
+        return -1;
+    }
+
+    // the kernel drops the events that do not fit, give them space
+    int rcvbuf = 4 * 1024 * 1024;
+    if(setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) == -1)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct __attribute__((aligned(NLMSG_ALIGNTO))) {
+        struct nlmsghdr nl_hdr;
+        struct __attribute__((__packed__)) {
+            struct cn_msg cn_msg;
+            enum proc_cn_mcast_op cn_mcast;
+        };
+    } msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.nl_hdr.nlmsg_len = sizeof(msg);
+    msg.nl_hdr.nlmsg_pid = (__u32)getpid();
+    msg.nl_hdr.nlmsg_type = NLMSG_DONE;
+    msg.cn_msg.id.idx = CN_IDX_PROC;
+    msg.cn_msg.id.val = CN_VAL_PROC;
+    msg.cn_msg.len = sizeof(enum proc_cn_mcast_op);
+    msg.cn_mcast = PROC_CN_MCAST_LISTEN;
+
+    if(send(fd, &msg, sizeof(msg), 0) == -1) {
+        error("Cannot subscribe to the process events.");
+        close(fd);
+        return -1;
+    }
+
+    // without CAP_NET_ADMIN the kernel refuses the subscription in its acknowledgement,
+    // and we would never receive any events
+    int err = -1;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    while(err == -1 && poll(&pfd, 1, 1000) == 1) {
+        char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if(len <= 0)
+            break;
+
+        struct nlmsghdr *nlh;
+        size_t remaining = (size_t)len;
+        for(nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+            struct proc_event *ev = (struct proc_event *)((struct cn_msg *)NLMSG_DATA(nlh))->data;
+            if(nlh->nlmsg_type == NLMSG_DONE && ev->what == PROC_EVENT_NONE) {
+                err = (int)ev->event_data.ack.err;
+                break;
+            }
+        }
+    }
+
+    if(err != 0) {
+        error("The kernel did not accept the subscription to the process events (error %d). Will scan /proc on every iteration.", err);
+        close(fd);
+        return -1;
+    }
+
+    info("receiving process events - /proc will be scanned every %d iterations, idle processes will be read every %d iterations", full_scan_every, idle_read_every);
+    return fd;
+}
+
+static inline void proc_events_pid_dirty(pid_t pid) {
+    if(unlikely(pid <= 0 || pid > pid_max))
+        return;
+
+    if(likely(all_pids[pid])) {
+        all_pids[pid]->dirty = 1;
+        return;
+    }
+
+    if(unlikely(proc_events_new_pids_count == proc_events_new_pids_size)) {
+        proc_events_new_pids_size = (proc_events_new_pids_size)?proc_events_new_pids_size * 2:1024;
+        proc_events_new_pids = reallocz(proc_events_new_pids, proc_events_new_pids_size * sizeof(pid_t));
+    }
+    proc_events_new_pids[proc_events_new_pids_count++] = pid;
+}
+
+// receives the events since the last iteration
+static void proc_events_receive(void) {
+    char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for(;;) {
+        ssize_t len = recv(proc_events_fd, buf, sizeof(buf), 0);
+        if(len == -1) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            if(errno == EINTR)
+                continue;
+
+            if(errno == ENOBUFS) {
+                proc_events_lost = 1;
+                continue;
+            }
+
+            error("Cannot receive the process events. Will scan /proc on every iteration.");
+            close(proc_events_fd);
+            proc_events_fd = -1;
+            proc_events_lost = 1;
+            return;
+        }
+
+        struct nlmsghdr *nlh;
+        size_t remaining = (size_t)len;
+        for(nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+            if(unlikely(nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_OVERRUN)) {
+                proc_events_lost = 1;
+                continue;
+            }
+
+            if(unlikely(nlh->nlmsg_type == NLMSG_NOOP))
+                continue;
+
+            struct cn_msg *cn = NLMSG_DATA(nlh);
+            struct proc_event *ev = (struct proc_event *)cn->data;
+
+            switch(ev->what) {
+                case PROC_EVENT_FORK:
+                    // only processes, not threads
+                    if(ev->event_data.fork.child_pid == ev->event_data.fork.child_tgid)
+                        proc_events_pid_dirty(ev->event_data.fork.child_tgid);
+                    break;
+
+                case PROC_EVENT_EXEC:
+                    proc_events_pid_dirty(ev->event_data.exec.process_tgid);
+                    break;
+
+                case PROC_EVENT_EXIT:
+                    if(ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid) {
+                        pid_t pid = ev->event_data.exit.process_tgid;
+
+                        // its parent accumulates its resources
+                        if(pid > 0 && pid <= pid_max && all_pids[pid])
+                            proc_events_pid_dirty(all_pids[pid]->ppid);
+
+                        proc_events_pid_dirty(pid);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
+#endif
+
 static inline int collect_data_for_pid(pid_t pid, void *ptr) {
     if(unlikely(pid < 0 || pid > pid_max)) {
         error("Invalid pid %d read (expected %d to %d). Ignoring process.", pid, 0, pid_max);
@@ -2277,6 +2667,19 @@ static inline int collect_data_for_pid(pid_t pid, void *ptr) {
     if(unlikely(!p || p->read)) return 0;
     p->read = 1;
 
+#ifndef __FreeBSD__
+    // without any events about it, an idle process is still running and idle
+    if(proc_events_fd != -1 && !proc_events_lost && p->idle && !p->dirty && p->idle_skips < idle_read_every - 1) {
+        p->idle_skips++;
+        p->updated = 1;
+        p->keep = 0;
+        p->keeploops = 0;
+        return 1;
+    }
+    p->dirty = 0;
+    p->idle_skips = 0;
+#endif
+
     // debug_log("Reading process %d (%s), sortlist %d", p->pid, p->comm, p->sortlist);
 
     // --------------------------------------------------------------------
@@ -2321,12 +2724,102 @@ static inline int collect_data_for_pid(pid_t pid, void *ptr) {
     p->keep = 0;
     p->keeploops = 0;
 
+    p->idle = !(p->utime | p->stime | p->gtime | p->minflt | p->majflt
+                | p->cutime | p->cstime | p->cgtime | p->cminflt | p->cmajflt
+                | p->io_logical_bytes_read | p->io_logical_bytes_written
+                | p->io_storage_bytes_read | p->io_storage_bytes_written);
+
     return 1;
 }
 
+// ----------------------------------------------------------------------------
+// reading the processes in parallel
+//
+// with more than one read_threads, the processes already known are read by a
+// pool of threads, each taking the next batch of pids from all_pids_sortlist
+// until all of them have been read. The new processes, the process tree and
+// the aggregation to the targets are handled by the main thread, when all the
+// threads have finished.
+
+#if (ALL_PIDS_ARE_READ_INSTANTLY == 0)
+#define READ_THREADS_MAX 64
+#define READ_THREADS_BATCH 16
+
+static size_t
+        read_threads_next = 0,      // the next slot of all_pids_sortlist to be read
+        read_threads_count = 0;     // the slots of all_pids_sortlist to be read
+
+static netdata_thread_t read_threads_ids[READ_THREADS_MAX];
+static pthread_barrier_t read_threads_start, read_threads_done;
+
+static void read_threads_collect(void) {
+    size_t start;
+
+    while((start = __atomic_fetch_add(&read_threads_next, READ_THREADS_BATCH, __ATOMIC_RELAXED)) < read_threads_count) {
+        size_t end = start + READ_THREADS_BATCH, i;
+        if(end > read_threads_count) end = read_threads_count;
+
+        for(i = start; i < end ; i++)
+            collect_data_for_pid(all_pids_sortlist[i], NULL);
+    }
+}
+
+static void *read_thread_main(void *ptr) {
+    (void)ptr;
+
+    for(;;) {
+        pthread_barrier_wait(&read_threads_start);
+        read_threads_collect();
+        pthread_barrier_wait(&read_threads_done);
+    }
+
+    return NULL;
+}
+
+static void read_threads_init(void) {
+    if(read_threads < 2) return;
+
+    // the main thread is one of them
+    pthread_barrier_init(&read_threads_start, NULL, (unsigned)read_threads);
+    pthread_barrier_init(&read_threads_done, NULL, (unsigned)read_threads);
+
+    int i;
+    for(i = 1; i < read_threads ; i++) {
+        if(netdata_thread_create(&read_threads_ids[i], "APPS_READ", NETDATA_THREAD_OPTION_DONT_LOG, read_thread_main, NULL))
+            fatal("Cannot create the threads to read the processes.");
+    }
+}
+
+// read the first count pids of all_pids_sortlist
+static void collect_data_for_sortlist_pids(size_t count) {
+    read_threads_count = count;
+    read_threads_next = 0;
+
+    if(read_threads < 2) {
+        size_t i;
+        for(i = 0; i < count ; i++)
+            collect_data_for_pid(all_pids_sortlist[i], NULL);
+        return;
+    }
+
+    pthread_barrier_wait(&read_threads_start);
+    read_threads_collect();
+    pthread_barrier_wait(&read_threads_done);
+}
+#endif
+
 static int collect_data_for_all_processes(void) {
     struct pid_stat *p = NULL;
 
+#ifndef __FreeBSD__
+    if(proc_events_fd != -1) {
+        proc_events_receive();
+
+        if(!(global_iterations_counter % full_scan_every))
+            proc_events_lost = 1;
+    }
+#endif
+
 #ifdef __FreeBSD__
     int i, procnum;
 
@@ -2389,20 +2882,20 @@ static int collect_data_for_all_processes(void) {
             all_pids_count = slc;
         }
 
-        if(include_exited_childs) {
+        if(include_exited_childs || read_threads > 1) {
             // Read parents before childs
             // This is needed to prevent a situation where
             // a child is found running, but until we read
             // its parent, it has exited and its parent
             // has accumulated its resources.
 
-            qsort((void *)all_pids_sortlist, (size_t)all_pids_count, sizeof(pid_t), compar_pid);
+            if(include_exited_childs)
+                qsort((void *)all_pids_sortlist, (size_t)all_pids_count, sizeof(pid_t), compar_pid);
 
             // we forward read all running processes
             // collect_data_for_pid() is smart enough,
             // not to read the same pid twice per iteration
-            for(slc = 0; slc < all_pids_count; slc++)
-                collect_data_for_pid(all_pids_sortlist[slc], NULL);
+            collect_data_for_sortlist_pids(all_pids_count);
         }
 #endif
     }
@@ -2413,6 +2906,19 @@ static int collect_data_for_all_processes(void) {
         collect_data_for_pid(pid, &procbase[i]);
     }
 #else
+    if(proc_events_fd != -1 && !proc_events_lost) {
+        // read the known processes (if not read above) and the new ones
+        for(p = root_of_pids; p ; p = p->next)
+            collect_data_for_pid(p->pid, NULL);
+
+        size_t i;
+        for(i = 0; i < proc_events_new_pids_count ; i++)
+            collect_data_for_pid(proc_events_new_pids[i], NULL);
+
+        proc_events_new_pids_count = 0;
+        goto processes_read;
+    }
+
     char dirname[FILENAME_MAX + 1];
 
     snprintfz(dirname, FILENAME_MAX, "%s/proc", netdata_configured_host_prefix);
@@ -2436,6 +2942,12 @@ static int collect_data_for_all_processes(void) {
         collect_data_for_pid(pid, NULL);
     }
     closedir(dir);
+
+    // all the processes running have been found
+    proc_events_lost = 0;
+    proc_events_new_pids_count = 0;
+
+processes_read:
 #endif
 
     if(!all_pids_count)
@@ -3533,6 +4045,50 @@ static void parse_args(int argc, char **argv)
             if(max_fds_cache_seconds < 0) max_fds_cache_seconds = 0;
             continue;
         }
+
+        if(strcmp("with-proc-events", argv[i]) == 0) {
+            enable_proc_events = 1;
+            continue;
+        }
+
+        if(strcmp("no-proc-events", argv[i]) == 0 || strcmp("without-proc-events", argv[i]) == 0) {
+            enable_proc_events = 0;
+            continue;
+        }
+
+        if(strcmp("idle-every", argv[i]) == 0) {
+            if(argc <= i + 1) {
+                fprintf(stderr, "Parameter 'idle-every' requires a number as argument.\n");
+                exit(1);
+            }
+            i++;
+            idle_read_every = str2i(argv[i]);
+            if(idle_read_every < 1) idle_read_every = 1;
+            continue;
+        }
+
+        if(strcmp("threads", argv[i]) == 0) {
+            if(argc <= i + 1) {
+                fprintf(stderr, "Parameter 'threads' requires a number as argument.\n");
+                exit(1);
+            }
+            i++;
+            read_threads = str2i(argv[i]);
+            if(read_threads < 1) read_threads = 1;
+            if(read_threads > READ_THREADS_MAX) read_threads = READ_THREADS_MAX;
+            continue;
+        }
+
+        if(strcmp("full-scan-every", argv[i]) == 0) {
+            if(argc <= i + 1) {
+                fprintf(stderr, "Parameter 'full-scan-every' requires a number as argument.\n");
+                exit(1);
+            }
+            i++;
+            full_scan_every = str2i(argv[i]);
+            if(full_scan_every < 1) full_scan_every = 1;
+            continue;
+        }
 #endif
 
         if(strcmp("no-childs", argv[i]) == 0 || strcmp("without-childs", argv[i]) == 0) {
@@ -3612,12 +4168,33 @@ static void parse_args(int argc, char **argv)
                     "                   max given)\n"
                     "                   (default is %d seconds)\n"
                     "\n"
+                    " with-proc-events\n"
+                    " without-proc-events enable / disable following the\n"
+                    "                   processes with the process events of\n"
+                    "                   the kernel, instead of scanning /proc\n"
+                    "                   on every iteration (needs root)\n"
+                    "                   (default is enabled)\n"
+                    "\n"
+                    " idle-every N      with process events, read the processes\n"
+                    "                   that had no activity every N iterations\n"
+                    "                   (default is %d)\n"
+                    "\n"
+                    " full-scan-every N with process events, scan /proc\n"
+                    "                   every N iterations\n"
+                    "                   (default is %d)\n"
+                    "\n"
+                    " threads N         read the processes with N threads\n"
+                    "                   (default is %d)\n"
+                    "\n"
 #endif
                     " version or -v or -V print program version and exit\n"
                     "\n"
                     , VERSION
 #ifndef __FreeBSD__
                     , max_fds_cache_seconds
+                    , idle_read_every
+                    , full_scan_every
+                    , read_threads
 #endif
             );
             exit(1);
@@ -3767,6 +4344,10 @@ int main(int argc, char **argv) {
 
     parse_args(argc, argv);
 
+#ifndef __FreeBSD__
+    init_pid_files();
+#endif
+
     if(!check_capabilities() && !am_i_running_as_root() && !check_proc_1_io()) {
         uid_t uid = getuid(), euid = geteuid();
 #ifdef HAVE_CAPABILITY
@@ -3790,10 +4371,17 @@ int main(int argc, char **argv) {
 
 #if (ALL_PIDS_ARE_READ_INSTANTLY == 0)
     all_pids_sortlist = callocz(sizeof(pid_t), (size_t)pid_max);
+    read_threads_init();
 #endif
 
     all_pids          = callocz(sizeof(struct pid_stat *), (size_t) pid_max);
 
+#ifndef __FreeBSD__
+    // the process events are not namespaced, they cannot be used for another /proc
+    if(enable_proc_events && (!netdata_configured_host_prefix || !*netdata_configured_host_prefix))
+        proc_events_fd = proc_events_open();
+#endif
+
     usec_t step = update_every * USEC_PER_SEC;
     global_iterations_counter = 1;
     heartbeat_t hb;
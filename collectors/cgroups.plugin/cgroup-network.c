@@ -9,6 +9,9 @@
 #include <sched.h>
 #endif
 
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
 char environment_variable2[FILENAME_MAX + 50] = "";
 char *environment[] = {
         "PATH=/bin:/sbin:/usr/bin:/usr/sbin:/usr/local/bin:/usr/local/sbin",
@@ -424,18 +427,29 @@ void add_device(const char *host, const char *guest) {
     detected_devices = f;
 }
 
-int send_devices(void) {
+int send_devices(FILE *fp) {
     int found = 0;
 
     struct found_device *f;
     for(f = detected_devices; f ; f = f->next) {
         found++;
-        printf("%s %s\n", f->host_device, (f->guest_device)?f->guest_device:f->host_device);
+        fprintf(fp, "%s %s\n", f->host_device, (f->guest_device)?f->guest_device:f->host_device);
     }
 
     return found;
 }
 
+void free_devices(void) {
+    while(detected_devices) {
+        struct found_device *f = detected_devices;
+        detected_devices = f->next;
+
+        freez((void *)f->host_device);
+        freez((void *)f->guest_device);
+        freez(f);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // this function should be called only **ONCE**
 // also it has to be the **LAST** to be called
@@ -600,6 +614,414 @@ int verify_path(const char *path) {
     return 0;
 }
 
+// ----------------------------------------------------------------------------
+// server mode
+//
+// netdata starts it once and asks it the network interfaces of all the
+// cgroups found in a discovery pass, over a unix socket, instead of running
+// cgroup-network (and its helper script) for every cgroup.
+//
+// It never leaves its own namespaces: it enters the network namespace of
+// each cgroup just to dump its interfaces over netlink, and returns. The
+// network namespaces are cached by inode, so the cgroups sharing one (like
+// all the containers of a kubernetes pod) are examined once per request.
+
+#define CGROUP_NETWORK_SERVER_ACCEPT_TIMEOUT_MS 60000
+
+struct netns {
+    dev_t dev;
+    ino_t ino;
+    int fd;                 // the network namespace, kept open while it is used
+
+    size_t request;         // the request its devices were found for
+    BUFFER *devices;        // the "host guest" lines of its devices
+
+    struct netns *next;
+};
+
+static struct netns *netns_root = NULL;
+static size_t netns_request = 0;
+static int netns_own_fd = -1;
+static dev_t netns_own_dev = 0;
+static ino_t netns_own_ino = 0;
+
+static struct iface *read_netlink_ifaces(void) {
+    // the socket belongs to the network namespace we are in
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if(fd == -1) {
+        error("cannot create a netlink socket");
+        return NULL;
+    }
+
+    struct {
+        struct nlmsghdr nh;
+        struct ifinfomsg ifi;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nh.nlmsg_type = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = 1;
+    req.ifi.ifi_family = AF_UNSPEC;
+
+    if(send(fd, &req, req.nh.nlmsg_len, 0) == -1) {
+        error("cannot send a netlink request");
+        close(fd);
+        return NULL;
+    }
+
+    struct iface *root = NULL;
+    long buffer[8192];
+    int done = 0;
+
+    while(!done) {
+        int len = (int)recv(fd, buffer, sizeof(buffer), 0);
+        if(len == -1 && errno == EINTR) continue;
+        if(len <= 0) {
+            error("cannot receive the netlink response");
+            free_host_ifaces(root);
+            root = NULL;
+            break;
+        }
+
+        struct nlmsghdr *nh;
+        for(nh = (struct nlmsghdr *)buffer; NLMSG_OK(nh, len) ; nh = NLMSG_NEXT(nh, len)) {
+            if(nh->nlmsg_type == NLMSG_DONE) {
+                done = 1;
+                break;
+            }
+
+            if(nh->nlmsg_type == NLMSG_ERROR) {
+                errno = 0;
+                error("netlink returned an error");
+                free_host_ifaces(root);
+                root = NULL;
+                done = 1;
+                break;
+            }
+
+            if(nh->nlmsg_type != RTM_NEWLINK) continue;
+
+            struct ifinfomsg *ifi = NLMSG_DATA(nh);
+            const char *name = NULL;
+
+            // like /sys/class/net/IFACE/iflink, it is the ifindex when not linked
+            unsigned int iflink = (unsigned int)ifi->ifi_index;
+
+            int rlen = IFLA_PAYLOAD(nh);
+            struct rtattr *rta;
+            for(rta = IFLA_RTA(ifi); RTA_OK(rta, rlen) ; rta = RTA_NEXT(rta, rlen)) {
+                if(rta->rta_type == IFLA_IFNAME)
+                    name = RTA_DATA(rta);
+                else if(rta->rta_type == IFLA_LINK)
+                    iflink = *(unsigned int *)RTA_DATA(rta);
+            }
+
+            if(!name) continue;
+
+            struct iface *t = callocz(1, sizeof(struct iface));
+            t->device = strdupz(name);
+            t->hash = simple_hash(t->device);
+            t->ifindex = (unsigned int)ifi->ifi_index;
+            t->iflink = iflink;
+            t->next = root;
+            root = t;
+        }
+    }
+
+    close(fd);
+    return root;
+}
+
+static struct netns *netns_get(pid_t pid) {
+    char filename[FILENAME_MAX + 1];
+    snprintfz(filename, FILENAME_MAX, "%s/proc/%d/ns/net", netdata_configured_host_prefix, (int)pid);
+
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        error("cannot open '%s'", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1) {
+        error("cannot fstat() '%s'", filename);
+        close(fd);
+        return NULL;
+    }
+
+    struct netns *n;
+    for(n = netns_root; n ; n = n->next) {
+        if(n->ino == st.st_ino && n->dev == st.st_dev) {
+            close(fd);
+            return n;
+        }
+    }
+
+    n = callocz(1, sizeof(struct netns));
+    n->dev = st.st_dev;
+    n->ino = st.st_ino;
+    n->fd = fd;
+    n->devices = buffer_create(100);
+    n->next = netns_root;
+    netns_root = n;
+
+    return n;
+}
+
+static void netns_find_devices(struct netns *n, struct iface *host) {
+    n->request = netns_request;
+    buffer_flush(n->devices);
+
+    if(!host) return;
+
+#ifdef HAVE_SETNS
+    if(setns(n->fd, CLONE_NEWNET) == -1) {
+        error("cannot switch to network namespace %lu", (unsigned long)n->ino);
+        return;
+    }
+
+    struct iface *cgroup = read_netlink_ifaces();
+
+    if(setns(netns_own_fd, CLONE_NEWNET) == -1)
+        fatal("cannot switch back to the network namespace of cgroup-network");
+
+    struct iface *h, *c;
+    for(h = host; h ; h = h->next) {
+        if(iface_is_eligible(h)) {
+            for (c = cgroup; c; c = c->next) {
+                if(iface_is_eligible(c) && h->ifindex == c->iflink && h->iflink == c->ifindex)
+                    buffer_sprintf(n->devices, "%s %s\n", h->device, c->device);
+            }
+        }
+    }
+
+    free_host_ifaces(cgroup);
+#endif
+}
+
+// forget the network namespaces the last request did not use
+static void netns_cleanup(void) {
+    struct netns *n, *last = NULL;
+
+    for(n = netns_root; n ;) {
+        struct netns *next = n->next;
+
+        if(n->request != netns_request) {
+            if(last) last->next = next;
+            else netns_root = next;
+
+            close(n->fd);
+            buffer_free(n->devices);
+            freez(n);
+        }
+        else
+            last = n;
+
+        n = next;
+    }
+}
+
+static void server_send_cgroup(const char *cgroup, struct iface *host, FILE *fp) {
+    fprintf(fp, "CGROUP %s\n", cgroup);
+
+    if(verify_path(cgroup))
+        return;
+
+    pid_t pid = read_pid_from_cgroup(cgroup);
+    if(pid > 0) {
+        struct netns *n = netns_get(pid);
+        if(n && (n->ino != netns_own_ino || n->dev != netns_own_dev)) {
+            if(n->request != netns_request)
+                netns_find_devices(n, host);
+
+            if(buffer_strlen(n->devices)) {
+                fputs(buffer_tostring(n->devices), fp);
+                return;
+            }
+        }
+    }
+
+    // without veth interfaces, ask the helper script (tun/tap interfaces, virtual machines)
+    call_the_helper(pid, cgroup);
+    send_devices(fp);
+    free_devices();
+}
+
+static void server_serve(int fd) {
+    FILE *in = fdopen(fd, "r");
+    FILE *out = fdopen(dup(fd), "w");
+    if(!in || !out) {
+        error("cannot upgrade the connection to FILE");
+        return;
+    }
+
+    struct iface *host = NULL;
+    int in_request = 0;
+
+    char buffer[CGROUP_NETWORK_INTERFACE_MAX_LINE + 1];
+    char *s;
+    while((s = fgets(buffer, CGROUP_NETWORK_INTERFACE_MAX_LINE, in))) {
+        s = trim(s);
+        if(!s) continue;
+
+        if(!in_request) {
+            netns_request++;
+            host = read_proc_net_dev("host", netdata_configured_host_prefix);
+            in_request = 1;
+        }
+
+        if(!strncmp(s, "CGROUP ", 7))
+            server_send_cgroup(&s[7], host, out);
+
+        else if(!strcmp(s, "END")) {
+            fprintf(out, "END\n");
+            if(fflush(out) == EOF) break;
+
+            netns_cleanup();
+            free_host_ifaces(host);
+            host = NULL;
+            in_request = 0;
+        }
+
+        else {
+            errno = 0;
+            error("invalid request '%s'", s);
+        }
+    }
+
+    free_host_ifaces(host);
+    fclose(out);
+    fclose(in);
+}
+
+static int server_listen(const char *path, uid_t uid, gid_t gid) {
+    struct sockaddr_un sa;
+
+    if(path[0] != '/' || strlen(path) >= sizeof(sa.sun_path)) {
+        errno = 0;
+        error("invalid socket path '%s'", path);
+        return -1;
+    }
+
+    // the socket is created as root, so its directory has to
+    // belong to the user that started us, and only that user
+    // should be able to write to it.
+    char dir[FILENAME_MAX + 1];
+    strncpyz(dir, path, FILENAME_MAX);
+    char *slash = strrchr(dir, '/');
+    if(slash == dir) slash[1] = '\0';
+    else *slash = '\0';
+
+    struct stat st;
+    if(stat(dir, &st) == -1 || (st.st_mode & S_IFMT) != S_IFDIR || st.st_uid != uid || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        errno = 0;
+        error("directory '%s' has to be owned by uid %u and writable only by it", dir, (unsigned int)uid);
+        return -1;
+    }
+
+    if(lstat(path, &st) == 0) {
+        if((st.st_mode & S_IFMT) != S_IFSOCK || st.st_uid != uid) {
+            errno = 0;
+            error("'%s' exists and it is not a socket of uid %u", path, (unsigned int)uid);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        error("cannot create a unix socket");
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpyz(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+
+    mode_t old_umask = umask(0077);
+    int ret = bind(fd, (struct sockaddr *)&sa, sizeof(sa));
+    umask(old_umask);
+
+    if(ret == -1) {
+        error("cannot bind to unix socket '%s'", path);
+        close(fd);
+        return -1;
+    }
+
+    if(chown(path, uid, gid) == -1)
+        error("cannot chown() unix socket '%s' to %u:%u", path, (unsigned int)uid, (unsigned int)gid);
+
+    if(listen(fd, 1) == -1) {
+        error("cannot listen on unix socket '%s'", path);
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    return fd;
+}
+
+int run_server(const char *path) {
+    uid_t uid = getuid();
+    gid_t gid = getgid();
+
+    if(setresuid(0, 0, 0) == -1)
+        error("setresuid(0, 0, 0) failed.");
+
+    // after changing our credentials, netdata cannot signal us - exit when it exits
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    struct stat st;
+    netns_own_fd = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if(netns_own_fd == -1 || fstat(netns_own_fd, &st) == -1) {
+        error("cannot open our own network namespace");
+        return 1;
+    }
+    netns_own_dev = st.st_dev;
+    netns_own_ino = st.st_ino;
+
+    int fd = server_listen(path, uid, gid);
+    if(fd == -1) return 1;
+
+    printf("READY\n");
+    fflush(stdout);
+
+    // wait for netdata to connect, or to close our stdout
+    struct pollfd fds[2] = {
+            { .fd = fd, .events = POLLIN, .revents = 0 },
+            { .fd = STDOUT_FILENO, .events = 0, .revents = 0 },
+    };
+
+    int ret = poll(fds, 2, CGROUP_NETWORK_SERVER_ACCEPT_TIMEOUT_MS);
+    int conn = -1;
+    if(ret > 0 && (fds[0].revents & POLLIN))
+        conn = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+
+    // we serve just one connection
+    unlink(path);
+    close(fd);
+
+    if(conn == -1) {
+        errno = 0;
+        error("netdata did not connect to '%s'", path);
+        return 1;
+    }
+
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if(getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1 || (cred.uid != uid && cred.uid != 0)) {
+        errno = 0;
+        error("rejected a connection from a process not running as uid %u", (unsigned int)uid);
+        close(conn);
+        return 1;
+    }
+
+    server_serve(conn);
+    return 0;
+}
+
 /*
 char *fix_path_variable(void) {
     const char *path = getenv("PATH");
@@ -638,7 +1060,7 @@ char *fix_path_variable(void) {
 // main
 
 void usage(void) {
-    fprintf(stderr, "%s [ -p PID | --pid PID | --cgroup /path/to/cgroup ]\n", program_name);
+    fprintf(stderr, "%s [ -p PID | --pid PID | --cgroup /path/to/cgroup | --server /path/to/socket ]\n", program_name);
     exit(1);
 }
 
@@ -677,6 +1099,9 @@ int main(int argc, char **argv) {
     if(argc != 3)
         usage();
 
+    if(!strcmp(argv[1], "--server"))
+        return run_server(argv[2]);
+
     if(!strcmp(argv[1], "-p") || !strcmp(argv[1], "--pid")) {
         pid = atoi(argv[2]);
 
@@ -707,7 +1132,7 @@ int main(int argc, char **argv) {
     if(pid > 0)
         detect_veth_interfaces(pid);
 
-    int found = send_devices();
+    int found = send_devices(stdout);
     if(found <= 0) return 1;
     return 0;
 }
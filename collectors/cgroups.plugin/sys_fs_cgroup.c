@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "sys_fs_cgroup.h"
+#include <sys/inotify.h>
 
 #define PLUGIN_CGROUPS_NAME "cgroups.plugin"
 #define PLUGIN_CGROUPS_MODULE_SYSTEMD_NAME "systemd"
@@ -23,6 +24,7 @@ static int cgroup_enable_blkio_throttle_io = CONFIG_BOOLEAN_AUTO;
 static int cgroup_enable_blkio_throttle_ops = CONFIG_BOOLEAN_AUTO;
 static int cgroup_enable_blkio_merged_ops = CONFIG_BOOLEAN_AUTO;
 static int cgroup_enable_blkio_queued_ops = CONFIG_BOOLEAN_AUTO;
+static int cgroup_enable_pressure = CONFIG_BOOLEAN_AUTO;
 
 static int cgroup_enable_systemd_services = CONFIG_BOOLEAN_YES;
 static int cgroup_enable_systemd_services_detailed_memory = CONFIG_BOOLEAN_NO;
@@ -35,6 +37,8 @@ static int cgroup_search_in_devices = 1;
 
 static int cgroup_enable_new_cgroups_detected_at_runtime = 1;
 static int cgroup_check_for_new_every = 10;
+static int cgroup_watch_with_inotify = CONFIG_BOOLEAN_YES;
+static int cgroup_read_threads = 1;
 static int cgroup_update_every = 1;
 static int cgroup_containers_chart_priority = NETDATA_CHART_PRIO_CGROUPS_CONTAINERS;
 
@@ -60,13 +64,28 @@ static SIMPLE_PATTERN *systemd_services_cgroups = NULL;
 
 static char *cgroups_rename_script = NULL;
 static char *cgroups_network_interface_script = NULL;
+static int cgroups_network_interface_server = CONFIG_BOOLEAN_YES;
 
 static int cgroups_check = 0;
 
+// the files of the cgroups kept open
+static size_t
+        cgroup_files_open = 0,
+        cgroup_files_max = 0;
+
+// read the files of each cgroup together (with io_uring, when it is available)
+static int cgroup_read_files_together = CONFIG_BOOLEAN_YES;
+
+#define CGROUP_READ_THREADS_MAX 64
+
 static uint32_t Read_hash = 0;
 static uint32_t Write_hash = 0;
 static uint32_t user_hash = 0;
 static uint32_t system_hash = 0;
+static uint32_t rbytes_hash = 0;
+static uint32_t wbytes_hash = 0;
+static uint32_t rios_hash = 0;
+static uint32_t wios_hash = 0;
 
 void read_cgroup_plugin_configuration() {
     system_page_size = sysconf(_SC_PAGESIZE);
@@ -75,6 +94,10 @@ void read_cgroup_plugin_configuration() {
     Write_hash = simple_hash("Write");
     user_hash = simple_hash("user");
     system_hash = simple_hash("system");
+    rbytes_hash = simple_hash("rbytes");
+    wbytes_hash = simple_hash("wbytes");
+    rios_hash = simple_hash("rios");
+    wios_hash = simple_hash("wios");
 
     cgroup_update_every = (int)config_get_number("plugin:cgroups", "update every", localhost->rrd_update_every);
     if(cgroup_update_every < localhost->rrd_update_every)
@@ -84,6 +107,16 @@ void read_cgroup_plugin_configuration() {
     if(cgroup_check_for_new_every < cgroup_update_every)
         cgroup_check_for_new_every = cgroup_update_every;
 
+    cgroup_watch_with_inotify = config_get_boolean("plugin:cgroups", "watch for new cgroups with inotify", cgroup_watch_with_inotify);
+
+    cgroup_files_max = (size_t)config_get_number("plugin:cgroups", "max files kept open", (long long)(rlimit_nofile.rlim_cur / 4));
+
+    cgroup_read_threads = (int)config_get_number("plugin:cgroups", "threads to read cgroups", cgroup_read_threads);
+    if(cgroup_read_threads < 1) cgroup_read_threads = 1;
+    if(cgroup_read_threads > CGROUP_READ_THREADS_MAX) cgroup_read_threads = CGROUP_READ_THREADS_MAX;
+
+    cgroup_read_files_together = config_get_boolean("plugin:cgroups", "read the files of each cgroup together", cgroup_read_files_together);
+
     cgroup_use_unified_cgroups = config_get_boolean_ondemand("plugin:cgroups", "use unified cgroups", cgroup_use_unified_cgroups);
 
     cgroup_containers_chart_priority = (int)config_get_number("plugin:cgroups", "containers priority", cgroup_containers_chart_priority);
@@ -104,6 +137,7 @@ void read_cgroup_plugin_configuration() {
     cgroup_enable_blkio_throttle_ops = config_get_boolean_ondemand("plugin:cgroups", "enable blkio throttle operations", cgroup_enable_blkio_throttle_ops);
     cgroup_enable_blkio_queued_ops = config_get_boolean_ondemand("plugin:cgroups", "enable blkio queued operations", cgroup_enable_blkio_queued_ops);
     cgroup_enable_blkio_merged_ops = config_get_boolean_ondemand("plugin:cgroups", "enable blkio merged operations", cgroup_enable_blkio_merged_ops);
+    cgroup_enable_pressure = config_get_boolean_ondemand("plugin:cgroups", "enable pressure stall information", cgroup_enable_pressure);
 
     cgroup_recheck_zero_blkio_every_iterations = (int)config_get_number("plugin:cgroups", "recheck zero blkio every iterations", cgroup_recheck_zero_blkio_every_iterations);
     cgroup_recheck_zero_mem_failcnt_every_iterations = (int)config_get_number("plugin:cgroups", "recheck zero memory failcnt every iterations", cgroup_recheck_zero_mem_failcnt_every_iterations);
@@ -116,6 +150,9 @@ void read_cgroup_plugin_configuration() {
     char filename[FILENAME_MAX + 1], *s;
     struct mountinfo *mi, *root = mountinfo_read(0);
     if(!cgroup_use_unified_cgroups) {
+        // pressure stall information is given per cgroup only by the unified hierarchy
+        cgroup_enable_pressure = CONFIG_BOOLEAN_NO;
+
         mi = mountinfo_find_by_filesystem_super_option(root, "cgroup", "cpuacct");
         if(!mi) mi = mountinfo_find_by_filesystem_mount_source(root, "cgroup", "cpuacct");
         if(!mi) {
@@ -260,6 +297,7 @@ void read_cgroup_plugin_configuration() {
 
     snprintfz(filename, FILENAME_MAX, "%s/cgroup-network", netdata_configured_primary_plugins_dir);
     cgroups_network_interface_script = config_get("plugin:cgroups", "script to get cgroup network interfaces", filename);
+    cgroups_network_interface_server = config_get_boolean("plugin:cgroups", "run cgroup-network as a server", cgroups_network_interface_server);
 
     enabled_cgroup_renames = simple_pattern_create(
             config_get("plugin:cgroups", "run script to rename cgroups matching",
@@ -304,6 +342,7 @@ struct blkio {
     int delay_counter;
 
     char *filename;
+    int fd;         // filename kept open, or -1
 
     unsigned long long Read;
     unsigned long long Write;
@@ -338,6 +377,11 @@ struct memory {
     char *filename_msw_usage_in_bytes;
     char *filename_failcnt;
 
+    int fd_detailed;                // the files above kept open, or -1
+    int fd_usage_in_bytes;
+    int fd_msw_usage_in_bytes;
+    int fd_failcnt;
+
     int detailed_has_dirty;
     int detailed_has_swap;
 
@@ -399,10 +443,13 @@ struct memory {
 
 // https://www.kernel.org/doc/Documentation/cgroup-v1/cpuacct.txt
 struct cpuacct_stat {
+    ARL_BASE *arl_base;     // cpu.stat of unified cgroups
+
     int updated;
     int enabled; // CONFIG_BOOLEAN_YES or CONFIG_BOOLEAN_AUTO
 
     char *filename;
+    int fd;         // filename kept open, or -1
 
     unsigned long long user;
     unsigned long long system;
@@ -414,11 +461,38 @@ struct cpuacct_usage {
     int enabled; // CONFIG_BOOLEAN_YES or CONFIG_BOOLEAN_AUTO
 
     char *filename;
+    int fd;         // filename kept open, or -1
 
     unsigned int cpus;
     unsigned long long *cpu_percpu;
 };
 
+// https://www.kernel.org/doc/html/latest/accounting/psi.html
+struct pressure_charts {
+    int available;              // the line is given by the kernel
+
+    collected_number avg10;     // hundredths of percentage
+    collected_number avg60;
+    collected_number avg300;
+    unsigned long long total;   // microseconds
+
+    RRDSET *st;
+    RRDDIM *rd_avg10;
+    RRDDIM *rd_avg60;
+    RRDDIM *rd_avg300;
+};
+
+struct pressure {
+    int updated;
+    int enabled; // CONFIG_BOOLEAN_YES or CONFIG_BOOLEAN_AUTO
+
+    char *filename;
+    int fd;         // filename kept open, or -1
+
+    struct pressure_charts some;
+    struct pressure_charts full;
+};
+
 struct cgroup_network_interface {
     const char *host_device;
     const char *container_device;
@@ -436,6 +510,9 @@ struct cgroup {
     char enabled;        // enabled in the config
 
     char pending_renames;
+    size_t rename_request;      // the rename running for it, or 0
+
+    char pending_network_interfaces;    // its network interfaces have to be found
 
     char *id;
     uint32_t hash;
@@ -459,6 +536,10 @@ struct cgroup {
     struct blkio io_merged;                     // operations
     struct blkio io_queued;                     // operations
 
+    struct pressure cpu_pressure;
+    struct pressure memory_pressure;
+    struct pressure io_pressure;
+
     struct cgroup_network_interface *interfaces;
 
     // per cgroup charts
@@ -533,21 +614,180 @@ struct cgroup {
 
 } *cgroup_root = NULL;
 
+// ----------------------------------------------------------------------------
+// the files of the cgroups
+//
+// The files of the cgroups are kept open while the cgroups exist, and are read
+// again with pread(), so that each read is one system call instead of open(),
+// read(), lseek() and close() - up to "max files kept open" files (the rest are
+// opened on every read). The counters are changed by all the reading threads.
+
+static inline int cgroup_file_open(int *fd, const char *filename) {
+    if(likely(*fd != -1))
+        return 1;
+
+    if(unlikely(__atomic_load_n(&cgroup_files_open, __ATOMIC_RELAXED) >= cgroup_files_max))
+        return 0;
+
+    *fd = open(filename, O_RDONLY | O_CLOEXEC, 0666);
+    if(unlikely(*fd == -1))
+        return 0;
+
+    __atomic_add_fetch(&cgroup_files_open, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+static inline void cgroup_file_close(int *fd) {
+    if(*fd != -1) {
+        close(*fd);
+        *fd = -1;
+        __atomic_sub_fetch(&cgroup_files_open, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static inline procfile *cgroup_file_reopen(procfile *ff, int *fd, const char *filename) {
+    if(likely(cgroup_file_open(fd, filename)))
+        return procfile_reopen_fd(ff, *fd, NULL, PROCFILE_FLAG_DEFAULT);
+
+    return procfile_reopen(ff, filename, NULL, PROCFILE_FLAG_DEFAULT);
+}
+
+// procfile_readall() for a file given to cgroup_file_reopen()
+static inline procfile *cgroup_file_readall(procfile *ff, int *fd) {
+    ff = procfile_readall(ff);
+
+    // the cgroup has been removed
+    if(unlikely(!ff))
+        cgroup_file_close(fd);
+
+    return ff;
+}
+
+// ----------------------------------------------------------------------------
+// reading the files of a cgroup together
+//
+// Before the files of a cgroup are read, its files that are kept open and are
+// parsed with procfile are read together, with procfile_batch_readall(), into
+// the spare procfiles of the thread. The function reading each of them then
+// swaps its own procfile with the one its file has been read into, so that
+// the thread keeps the same number of procfiles.
+
+#define CGROUP_PREFETCH_MAX 10
+
+static __thread struct cgroup_prefetch {
+    PROCFILE_BATCH *batch;
+    size_t used;
+    struct {
+        int *fd;        // the file read into ff, NULL once it has been given to its reader
+        procfile *ff;
+    } files[CGROUP_PREFETCH_MAX];
+} cgroup_prefetch = { .batch = NULL, .used = 0 };
+
+static inline void cgroup_prefetch_add(int *fd, const char *filename) {
+    struct cgroup_prefetch *cp = &cgroup_prefetch;
+
+    if(unlikely(!filename || cp->used >= CGROUP_PREFETCH_MAX || !cgroup_file_open(fd, filename)))
+        return;
+
+    size_t i = cp->used++;
+    cp->files[i].ff = procfile_reopen_fd(cp->files[i].ff, *fd, NULL, PROCFILE_FLAG_DEFAULT);
+    cp->files[i].fd = fd;
+    procfile_batch_add(cp->batch, &cp->files[i].ff);
+}
+
+// the checks of the functions reading the files, for the files they will read
+#define cgroup_file_delayed(x, enabled, delay_counter) ((x)->enabled == CONFIG_BOOLEAN_AUTO && (x)->delay_counter > 0)
+
+static inline void cgroup_prefetch_files(struct cgroup *cg) {
+    struct cgroup_prefetch *cp = &cgroup_prefetch;
+
+    if(unlikely(!cp->batch))
+        cp->batch = procfile_batch_create();
+
+    cgroup_prefetch_add(&cg->cpuacct_stat.fd, cg->cpuacct_stat.filename);
+
+    if(!cgroup_file_delayed(&cg->memory, enabled_detailed, delay_counter_detailed))
+        cgroup_prefetch_add(&cg->memory.fd_detailed, cg->memory.filename_detailed);
+
+    if(!(cg->options & CGROUP_OPTIONS_IS_UNIFIED)) {
+        struct blkio *ios[] = {
+                &cg->io_service_bytes, &cg->io_serviced,
+                &cg->throttle_io_service_bytes, &cg->throttle_io_serviced,
+                &cg->io_merged, &cg->io_queued };
+        size_t i;
+
+        cgroup_prefetch_add(&cg->cpuacct_usage.fd, cg->cpuacct_usage.filename);
+
+        for(i = 0; i < sizeof(ios) / sizeof(ios[0]) ; i++)
+            if(!cgroup_file_delayed(ios[i], enabled, delay_counter))
+                cgroup_prefetch_add(&ios[i]->fd, ios[i]->filename);
+    }
+    else {
+        struct blkio *bytes = &cg->io_service_bytes, *ops = &cg->io_serviced;
+        struct blkio *io = (bytes->filename) ? bytes : ops;
+
+        if((bytes->filename && !cgroup_file_delayed(bytes, enabled, delay_counter)) || (ops->filename && !cgroup_file_delayed(ops, enabled, delay_counter)))
+            cgroup_prefetch_add(&io->fd, io->filename);
+
+        cgroup_prefetch_add(&cg->cpu_pressure.fd, cg->cpu_pressure.filename);
+        cgroup_prefetch_add(&cg->memory_pressure.fd, cg->memory_pressure.filename);
+        cgroup_prefetch_add(&cg->io_pressure.fd, cg->io_pressure.filename);
+    }
+
+    procfile_batch_readall(cp->batch);
+}
+
+// reopen and read the file with ff, or give the procfile it has been read into
+static inline procfile *cgroup_file_read(procfile *ff, int *fd, const char *filename) {
+    struct cgroup_prefetch *cp = &cgroup_prefetch;
+    size_t i;
+
+    for(i = 0; i < cp->used ; i++) {
+        if(cp->files[i].fd == fd) {
+            procfile *read = cp->files[i].ff;
+            cp->files[i].fd = NULL;
+            cp->files[i].ff = ff;
+
+            // the cgroup has been removed
+            if(unlikely(!read))
+                cgroup_file_close(fd);
+
+            return read;
+        }
+    }
+
+    ff = cgroup_file_reopen(ff, fd, filename);
+    if(likely(ff))
+        ff = cgroup_file_readall(ff, fd);
+
+    return ff;
+}
+
+static inline int cgroup_read_single_number_file(const char *filename, int *fd, unsigned long long *result) {
+    if(unlikely(!cgroup_file_open(fd, filename)))
+        return read_single_number_file(filename, result);
+
+    char buffer[30 + 1];
+    ssize_t r = pread(*fd, buffer, 30, 0);
+    if(unlikely(r <= 0)) {
+        cgroup_file_close(fd);
+        *result = 0;
+        return 1;
+    }
+
+    buffer[r] = '\0';
+    *result = str2ull(buffer);
+    return 0;
+}
+
 // ----------------------------------------------------------------------------
 // read values from /sys
 
 static inline void cgroup_read_cpuacct_stat(struct cpuacct_stat *cp) {
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     if(likely(cp->filename)) {
-        ff = procfile_reopen(ff, cp->filename, NULL, PROCFILE_FLAG_DEFAULT);
-        if(unlikely(!ff)) {
-            cp->updated = 0;
-            cgroups_check = 1;
-            return;
-        }
-
-        ff = procfile_readall(ff);
+        ff = cgroup_file_read(ff, &cp->fd, cp->filename);
         if(unlikely(!ff)) {
             cp->updated = 0;
             cgroups_check = 1;
@@ -581,24 +821,17 @@ static inline void cgroup_read_cpuacct_stat(struct cpuacct_stat *cp) {
 }
 
 static inline void cgroup2_read_cpuacct_stat(struct cpuacct_stat *cp) {
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     if(likely(cp->filename)) {
-        ff = procfile_reopen(ff, cp->filename, NULL, PROCFILE_FLAG_DEFAULT);
+        ff = cgroup_file_read(ff, &cp->fd, cp->filename);
         if(unlikely(!ff)) {
             cp->updated = 0;
             cgroups_check = 1;
             return;
         }
 
-        ff = procfile_readall(ff);
-        if(unlikely(!ff)) {
-            cp->updated = 0;
-            cgroups_check = 1;
-            return;
-        }
-
-        unsigned long lines = procfile_lines(ff);
+        unsigned long i, lines = procfile_lines(ff);
 
         if(unlikely(lines < 3)) {
             error("CGROUP: file '%s' should have 3+ lines.", cp->filename);
@@ -606,8 +839,20 @@ static inline void cgroup2_read_cpuacct_stat(struct cpuacct_stat *cp) {
             return;
         }
 
-        cp->user = str2ull(procfile_lineword(ff, 1, 1));
-        cp->system = str2ull(procfile_lineword(ff, 2, 1));
+        if(unlikely(!cp->arl_base)) {
+            cp->arl_base = arl_create("cgroup/cpu", NULL, 60);
+
+            arl_expect(cp->arl_base, "user_usec", &cp->user);
+            arl_expect(cp->arl_base, "system_usec", &cp->system);
+        }
+
+        arl_begin(cp->arl_base);
+
+        for(i = 0; i < lines ; i++) {
+            if(arl_check(cp->arl_base,
+                    procfile_lineword(ff, i, 0),
+                    procfile_lineword(ff, i, 1))) break;
+        }
 
         cp->updated = 1;
 
@@ -617,17 +862,10 @@ static inline void cgroup2_read_cpuacct_stat(struct cpuacct_stat *cp) {
 }
 
 static inline void cgroup_read_cpuacct_usage(struct cpuacct_usage *ca) {
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     if(likely(ca->filename)) {
-        ff = procfile_reopen(ff, ca->filename, NULL, PROCFILE_FLAG_DEFAULT);
-        if(unlikely(!ff)) {
-            ca->updated = 0;
-            cgroups_check = 1;
-            return;
-        }
-
-        ff = procfile_readall(ff);
+        ff = cgroup_file_read(ff, &ca->fd, ca->filename);
         if(unlikely(!ff)) {
             ca->updated = 0;
             cgroups_check = 1;
@@ -680,16 +918,9 @@ static inline void cgroup_read_blkio(struct blkio *io) {
     }
 
     if(likely(io->filename)) {
-        static procfile *ff = NULL;
+        static __thread procfile *ff = NULL;
 
-        ff = procfile_reopen(ff, io->filename, NULL, PROCFILE_FLAG_DEFAULT);
-        if(unlikely(!ff)) {
-            io->updated = 0;
-            cgroups_check = 1;
-            return;
-        }
-
-        ff = procfile_readall(ff);
+        ff = cgroup_file_read(ff, &io->fd, io->filename);
         if(unlikely(!ff)) {
             io->updated = 0;
             cgroups_check = 1;
@@ -745,58 +976,136 @@ static inline void cgroup_read_blkio(struct blkio *io) {
     }
 }
 
-static inline void cgroup2_read_blkio(struct blkio *io, unsigned int word_offset) {
-    if(unlikely(io->enabled == CONFIG_BOOLEAN_AUTO && io->delay_counter > 0)) {
-            io->delay_counter--;
-            return;
+static inline void cgroup2_set_blkio(struct blkio *io, unsigned long long Read, unsigned long long Write) {
+    io->Read = Read;
+    io->Write = Write;
+    io->updated = 1;
+
+    if(unlikely(io->enabled == CONFIG_BOOLEAN_AUTO)) {
+        if(unlikely(io->Read || io->Write))
+            io->enabled = CONFIG_BOOLEAN_YES;
+        else
+            io->delay_counter = cgroup_recheck_zero_blkio_every_iterations;
+    }
+}
+
+// io.stat gives both bandwidth and operations, so it is read once for both
+static inline void cgroup2_read_blkio(struct blkio *bytes, struct blkio *ops) {
+    int do_bytes = (bytes->filename != NULL), do_ops = (ops->filename != NULL);
+
+    if(unlikely(do_bytes && bytes->enabled == CONFIG_BOOLEAN_AUTO && bytes->delay_counter > 0)) {
+        bytes->delay_counter--;
+        do_bytes = 0;
+    }
+
+    if(unlikely(do_ops && ops->enabled == CONFIG_BOOLEAN_AUTO && ops->delay_counter > 0)) {
+        ops->delay_counter--;
+        do_ops = 0;
+    }
+
+    if(unlikely(!do_bytes && !do_ops))
+        return;
+
+    // the file is kept open by the first of them having it
+    struct blkio *io = (bytes->filename) ? bytes : ops;
+
+    static __thread procfile *ff = NULL;
+
+    ff = cgroup_file_read(ff, &io->fd, io->filename);
+
+    if(unlikely(!ff)) {
+        bytes->updated = ops->updated = 0;
+        cgroups_check = 1;
+        return;
+    }
+
+    // each line is: MAJOR:MINOR rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N
+    // (the keys given depend on the kernel, and the cgroup may have no lines)
+    unsigned long long rbytes = 0, wbytes = 0, rios = 0, wios = 0;
+    size_t i, lines = procfile_lines(ff);
+
+    for(i = 0; i < lines; i++) {
+        size_t w, words = procfile_linewords(ff, i);
+
+        for(w = 1; w + 1 < words; w += 2) {
+            char *s = procfile_lineword(ff, i, w);
+            uint32_t hash = simple_hash(s);
+
+            if(hash == rbytes_hash && !strcmp(s, "rbytes"))
+                rbytes += str2ull(procfile_lineword(ff, i, w + 1));
+
+            else if(hash == wbytes_hash && !strcmp(s, "wbytes"))
+                wbytes += str2ull(procfile_lineword(ff, i, w + 1));
+
+            else if(hash == rios_hash && !strcmp(s, "rios"))
+                rios += str2ull(procfile_lineword(ff, i, w + 1));
+
+            else if(hash == wios_hash && !strcmp(s, "wios"))
+                wios += str2ull(procfile_lineword(ff, i, w + 1));
         }
+    }
 
-        if(likely(io->filename)) {
-            static procfile *ff = NULL;
+    if(do_bytes) cgroup2_set_blkio(bytes, rbytes, wbytes);
+    if(do_ops)   cgroup2_set_blkio(ops, rios, wios);
+}
 
-            ff = procfile_reopen(ff, io->filename, NULL, PROCFILE_FLAG_DEFAULT);
-            if(unlikely(!ff)) {
-                io->updated = 0;
-                cgroups_check = 1;
-                return;
-            }
+static inline collected_number cgroup2_pressure_value(const char *s) {
+    return (collected_number)(str2ld(s, NULL) * 100.0 + 0.5);
+}
 
-            ff = procfile_readall(ff);
-            if(unlikely(!ff)) {
-                io->updated = 0;
-                cgroups_check = 1;
-                return;
-            }
+// cpu.pressure, memory.pressure and io.pressure, having the lines:
+// some avg10=N.NN avg60=N.NN avg300=N.NN total=N
+// full avg10=N.NN avg60=N.NN avg300=N.NN total=N
+static inline void cgroup2_read_pressure(struct pressure *res) {
+    static __thread procfile *ff = NULL;
 
-            unsigned long i, lines = procfile_lines(ff);
+    if(likely(res->filename)) {
+        ff = cgroup_file_read(ff, &res->fd, res->filename);
 
-            if (unlikely(lines < 1)) {
-                error("CGROUP: file '%s' should have 1+ lines.", io->filename);
-                io->updated = 0;
-                return;
-            }
+        if(unlikely(!ff)) {
+            res->updated = 0;
+            cgroups_check = 1;
+            return;
+        }
 
-            io->Read = 0;
-            io->Write = 0;
+        size_t i, lines = procfile_lines(ff);
 
-            for (i = 0; i < lines; i++) {
-                io->Read += str2ull(procfile_lineword(ff, i, 2 + word_offset));
-                io->Write += str2ull(procfile_lineword(ff, i, 4 + word_offset));
-            }
+        if(unlikely(lines < 1)) {
+            error("CGROUP: file '%s' should have 1+ lines.", res->filename);
+            res->updated = 0;
+            return;
+        }
 
-            io->updated = 1;
+        for(i = 0; i < lines; i++) {
+            struct pressure_charts *pcs;
+            char *s = procfile_lineword(ff, i, 0);
 
-            if(unlikely(io->enabled == CONFIG_BOOLEAN_AUTO)) {
-                if(unlikely(io->Read || io->Write))
-                    io->enabled = CONFIG_BOOLEAN_YES;
-                else
-                    io->delay_counter = cgroup_recheck_zero_blkio_every_iterations;
-            }
+            if(!strcmp(s, "some"))
+                pcs = &res->some;
+            else if(!strcmp(s, "full"))
+                pcs = &res->full;
+            else
+                continue;
+
+            if(unlikely(procfile_linewords(ff, i) < 9))
+                continue;
+
+            pcs->available = 1;
+            pcs->avg10  = cgroup2_pressure_value(procfile_lineword(ff, i, 2));
+            pcs->avg60  = cgroup2_pressure_value(procfile_lineword(ff, i, 4));
+            pcs->avg300 = cgroup2_pressure_value(procfile_lineword(ff, i, 6));
+            pcs->total  = str2ull(procfile_lineword(ff, i, 8));
         }
+
+        res->updated = 1;
+
+        if(unlikely(res->enabled == CONFIG_BOOLEAN_AUTO && (res->some.total || res->full.total)))
+            res->enabled = CONFIG_BOOLEAN_YES;
+    }
 }
 
 static inline void cgroup_read_memory(struct memory *mem, char parent_cg_is_unified) {
-    static procfile *ff = NULL;
+    static __thread procfile *ff = NULL;
 
     // read detailed ram usage
     if(likely(mem->filename_detailed)) {
@@ -805,14 +1114,7 @@ static inline void cgroup_read_memory(struct memory *mem, char parent_cg_is_unif
             goto memory_next;
         }
 
-        ff = procfile_reopen(ff, mem->filename_detailed, NULL, PROCFILE_FLAG_DEFAULT);
-        if(unlikely(!ff)) {
-            mem->updated_detailed = 0;
-            cgroups_check = 1;
-            goto memory_next;
-        }
-
-        ff = procfile_readall(ff);
+        ff = cgroup_file_read(ff, &mem->fd_detailed, mem->filename_detailed);
         if(unlikely(!ff)) {
             mem->updated_detailed = 0;
             cgroups_check = 1;
@@ -892,14 +1194,14 @@ memory_next:
 
     // read usage_in_bytes
     if(likely(mem->filename_usage_in_bytes)) {
-        mem->updated_usage_in_bytes = !read_single_number_file(mem->filename_usage_in_bytes, &mem->usage_in_bytes);
+        mem->updated_usage_in_bytes = !cgroup_read_single_number_file(mem->filename_usage_in_bytes, &mem->fd_usage_in_bytes, &mem->usage_in_bytes);
         if(unlikely(mem->updated_usage_in_bytes && mem->enabled_usage_in_bytes == CONFIG_BOOLEAN_AUTO && mem->usage_in_bytes))
             mem->enabled_usage_in_bytes = CONFIG_BOOLEAN_YES;
     }
 
     // read msw_usage_in_bytes
     if(likely(mem->filename_msw_usage_in_bytes)) {
-        mem->updated_msw_usage_in_bytes = !read_single_number_file(mem->filename_msw_usage_in_bytes, &mem->msw_usage_in_bytes);
+        mem->updated_msw_usage_in_bytes = !cgroup_read_single_number_file(mem->filename_msw_usage_in_bytes, &mem->fd_msw_usage_in_bytes, &mem->msw_usage_in_bytes);
         if(unlikely(mem->updated_msw_usage_in_bytes && mem->enabled_msw_usage_in_bytes == CONFIG_BOOLEAN_AUTO && mem->msw_usage_in_bytes))
             mem->enabled_msw_usage_in_bytes = CONFIG_BOOLEAN_YES;
     }
@@ -911,7 +1213,7 @@ memory_next:
             mem->delay_counter_failcnt--;
         }
         else {
-            mem->updated_failcnt = !read_single_number_file(mem->filename_failcnt, &mem->failcnt);
+            mem->updated_failcnt = !cgroup_read_single_number_file(mem->filename_failcnt, &mem->fd_failcnt, &mem->failcnt);
             if(unlikely(mem->updated_failcnt && mem->enabled_failcnt == CONFIG_BOOLEAN_AUTO)) {
                 if(unlikely(!mem->failcnt))
                     mem->delay_counter_failcnt = cgroup_recheck_zero_mem_failcnt_every_iterations;
@@ -924,6 +1226,9 @@ memory_next:
 
 static inline void cgroup_read(struct cgroup *cg) {
     debug(D_CGROUP, "reading metrics for cgroups '%s'", cg->id);
+
+    if(likely(cgroup_read_files_together))
+        cgroup_prefetch_files(cg);
     if(!(cg->options & CGROUP_OPTIONS_IS_UNIFIED)) {
         cgroup_read_cpuacct_stat(&cg->cpuacct_stat);
         cgroup_read_cpuacct_usage(&cg->cpuacct_usage);
@@ -936,11 +1241,81 @@ static inline void cgroup_read(struct cgroup *cg) {
         cgroup_read_blkio(&cg->io_queued);
     }
     else {
-        //TODO: io_service_bytes and io_serviced use same file merge into 1 function
-        cgroup2_read_blkio(&cg->io_service_bytes, 0);
-        cgroup2_read_blkio(&cg->io_serviced, 4);
+        cgroup2_read_blkio(&cg->io_service_bytes, &cg->io_serviced);
         cgroup2_read_cpuacct_stat(&cg->cpuacct_stat);
         cgroup_read_memory(&cg->memory, 1);
+        cgroup2_read_pressure(&cg->cpu_pressure);
+        cgroup2_read_pressure(&cg->memory_pressure);
+        cgroup2_read_pressure(&cg->io_pressure);
+    }
+
+    cgroup_prefetch.used = 0;
+}
+
+// ----------------------------------------------------------------------------
+// reading the cgroups in parallel
+//
+// with more than one "threads to read cgroups", the cgroups are read by a pool
+// of threads, each taking the next batch of cgroups from cgroup_read_list,
+// until all of them have been read. The cgroups are independent, so they are
+// only read by the threads - the charts are updated by the cgroups thread.
+
+#define CGROUP_READ_BATCH 8
+
+static struct cgroup_readers {
+    struct cgroup **list;       // the cgroups to be read
+    size_t count;
+    size_t size;
+    size_t next;                // the next slot of list to be read
+
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    netdata_thread_t threads[CGROUP_READ_THREADS_MAX];
+} cgroup_readers = {
+        .list = NULL,
+        .count = 0,
+        .size = 0,
+        .next = 0
+};
+
+static void cgroup_readers_read(void) {
+    size_t start;
+
+    while((start = __atomic_fetch_add(&cgroup_readers.next, CGROUP_READ_BATCH, __ATOMIC_RELAXED)) < cgroup_readers.count) {
+        size_t end = start + CGROUP_READ_BATCH, i;
+        if(end > cgroup_readers.count) end = cgroup_readers.count;
+
+        for(i = start; i < end ; i++)
+            cgroup_read(cgroup_readers.list[i]);
+    }
+}
+
+static void *cgroup_reader_thread(void *ptr) {
+    (void)ptr;
+
+    for(;;) {
+        pthread_barrier_wait(&cgroup_readers.start);
+        cgroup_readers_read();
+        pthread_barrier_wait(&cgroup_readers.done);
+    }
+
+    return NULL;
+}
+
+static void cgroup_readers_init(void) {
+    if(cgroup_read_threads < 2) return;
+
+    // the cgroups thread is one of them
+    pthread_barrier_init(&cgroup_readers.start, NULL, (unsigned)cgroup_read_threads);
+    pthread_barrier_init(&cgroup_readers.done, NULL, (unsigned)cgroup_read_threads);
+
+    int i;
+    for(i = 1; i < cgroup_read_threads ; i++) {
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "PLUGIN[cgroups-reader-%d]", i);
+
+        if(netdata_thread_create(&cgroup_readers.threads[i], tag, NETDATA_THREAD_OPTION_DONT_LOG, cgroup_reader_thread, NULL))
+            fatal("CGROUP: cannot create the threads to read cgroups.");
     }
 }
 
@@ -949,15 +1324,71 @@ static inline void read_all_cgroups(struct cgroup *root) {
 
     struct cgroup *cg;
 
+    if(cgroup_read_threads < 2) {
+        for(cg = root; cg ; cg = cg->next)
+            if(cg->enabled && cg->available && !cg->pending_renames)
+                cgroup_read(cg);
+
+        return;
+    }
+
+    if(unlikely(cgroup_readers.size < (size_t)cgroup_root_count)) {
+        cgroup_readers.size = (size_t)cgroup_root_count * 2;
+        cgroup_readers.list = reallocz(cgroup_readers.list, cgroup_readers.size * sizeof(struct cgroup *));
+    }
+
+    cgroup_readers.count = 0;
     for(cg = root; cg ; cg = cg->next)
         if(cg->enabled && cg->available && !cg->pending_renames)
-            cgroup_read(cg);
+            cgroup_readers.list[cgroup_readers.count++] = cg;
+
+    cgroup_readers.next = 0;
+
+    pthread_barrier_wait(&cgroup_readers.start);
+    cgroup_readers_read();
+    pthread_barrier_wait(&cgroup_readers.done);
 }
 
 // ----------------------------------------------------------------------------
 // cgroup network interfaces
 
 #define CGROUP_NETWORK_INTERFACE_MAX_LINE 2048
+
+// add the interface of a "host guest" line of cgroup-network
+static inline void cgroup_network_interface_add(struct cgroup *cg, char *s) {
+    trim(s);
+
+    if(*s && *s != '\n') {
+        char *t = s;
+        while(*t && *t != ' ') t++;
+        if(*t == ' ') {
+            *t = '\0';
+            t++;
+        }
+
+        if(!*s) {
+            error("CGROUP: empty host interface returned by script");
+            return;
+        }
+
+        if(!*t) {
+            error("CGROUP: empty guest interface returned by script");
+            return;
+        }
+
+        struct cgroup_network_interface *i = callocz(1, sizeof(struct cgroup_network_interface));
+        i->host_device = strdupz(s);
+        i->container_device = strdupz(t);
+        i->next = cg->interfaces;
+        cg->interfaces = i;
+
+        info("CGROUP: cgroup '%s' has network interface '%s' as '%s'", cg->id, i->host_device, i->container_device);
+
+        // register a device rename to proc_net_dev.c
+        netdev_rename_device_add(i->host_device, i->container_device, cg->chart_id);
+    }
+}
+
 static inline void read_cgroup_network_interfaces(struct cgroup *cg) {
     debug(D_CGROUP, "looking for the network interfaces of cgroup '%s' with chart id '%s' and title '%s'", cg->id, cg->chart_id, cg->chart_title);
 
@@ -980,39 +1411,8 @@ static inline void read_cgroup_network_interfaces(struct cgroup *cg) {
 
     char *s;
     char buffer[CGROUP_NETWORK_INTERFACE_MAX_LINE + 1];
-    while((s = fgets(buffer, CGROUP_NETWORK_INTERFACE_MAX_LINE, fp))) {
-        trim(s);
-
-        if(*s && *s != '\n') {
-            char *t = s;
-            while(*t && *t != ' ') t++;
-            if(*t == ' ') {
-                *t = '\0';
-                t++;
-            }
-
-            if(!*s) {
-                error("CGROUP: empty host interface returned by script");
-                continue;
-            }
-
-            if(!*t) {
-                error("CGROUP: empty guest interface returned by script");
-                continue;
-            }
-
-            struct cgroup_network_interface *i = callocz(1, sizeof(struct cgroup_network_interface));
-            i->host_device = strdupz(s);
-            i->container_device = strdupz(t);
-            i->next = cg->interfaces;
-            cg->interfaces = i;
-
-            info("CGROUP: cgroup '%s' has network interface '%s' as '%s'", cg->id, i->host_device, i->container_device);
-
-            // register a device rename to proc_net_dev.c
-            netdev_rename_device_add(i->host_device, i->container_device, cg->chart_id);
-        }
-    }
+    while((s = fgets(buffer, CGROUP_NETWORK_INTERFACE_MAX_LINE, fp)))
+        cgroup_network_interface_add(cg, s);
 
     mypclose(fp, cgroup_pid);
     // debug(D_CGROUP, "closed command for cgroup '%s'", cg->id);
@@ -1032,6 +1432,181 @@ static inline void free_cgroup_network_interfaces(struct cgroup *cg) {
     }
 }
 
+// ----------------------------------------------------------------------------
+// cgroup-network server
+//
+// Instead of running cgroup-network (a setuid binary that runs a shell
+// script) for every new cgroup, it is started once as a server and the
+// network interfaces of all the cgroups found in a discovery pass are
+// asked in one request. When it cannot be used, cgroup-network is run
+// for every cgroup, as before.
+
+#define CGROUP_NETWORK_SERVER_RETRY_SECONDS 300
+
+static struct cgroup_network_server {
+    pid_t pid;
+    FILE *fp;           // its stdout
+    FILE *in;           // the connection to it
+    FILE *out;
+    time_t failed_t;    // when it last failed, to try again later
+} cgroup_network_server = {
+        .pid = 0,
+        .fp = NULL,
+        .in = NULL,
+        .out = NULL,
+        .failed_t = 0,
+};
+
+static void cgroup_network_server_stop(void) {
+    // it exits when the connection, or its stdout, is closed
+    if(cgroup_network_server.out) fclose(cgroup_network_server.out);
+    if(cgroup_network_server.in) fclose(cgroup_network_server.in);
+    if(cgroup_network_server.fp) mypclose(cgroup_network_server.fp, cgroup_network_server.pid);
+
+    cgroup_network_server.out = NULL;
+    cgroup_network_server.in = NULL;
+    cgroup_network_server.fp = NULL;
+    cgroup_network_server.pid = 0;
+}
+
+static int cgroup_network_server_start(void) {
+    struct sockaddr_un sa;
+    char filename[FILENAME_MAX + 1];
+    char command[CGROUP_NETWORK_INTERFACE_MAX_LINE + 1];
+
+    snprintfz(filename, FILENAME_MAX, "%s/cgroup-network.sock", netdata_configured_varlib_dir);
+    if(strlen(filename) >= sizeof(sa.sun_path)) {
+        error("CGROUP: the path of the cgroup-network socket '%s' is too long.", filename);
+        goto failed;
+    }
+
+    snprintfz(command, CGROUP_NETWORK_INTERFACE_MAX_LINE, "exec %s --server '%s'", cgroups_network_interface_script, filename);
+
+    debug(D_CGROUP, "executing command '%s'", command);
+    cgroup_network_server.fp = mypopen(command, &cgroup_network_server.pid);
+    if(!cgroup_network_server.fp) {
+        error("CGROUP: cannot popen(\"%s\", \"r\").", command);
+        goto failed;
+    }
+
+    char buffer[100 + 1];
+    char *s = fgets(buffer, 100, cgroup_network_server.fp);
+    if(!s || !(s = trim(s)) || strcmp(s, "READY") != 0) {
+        error("CGROUP: cgroup-network server did not start.");
+        goto failed;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        error("CGROUP: cannot create a unix socket.");
+        goto failed;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpyz(sa.sun_path, filename, sizeof(sa.sun_path) - 1);
+
+    if(connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1) {
+        error("CGROUP: cannot connect to cgroup-network server at '%s'.", filename);
+        close(fd);
+        goto failed;
+    }
+
+    cgroup_network_server.in = fdopen(fd, "r");
+    cgroup_network_server.out = fdopen(dup(fd), "w");
+    if(!cgroup_network_server.in || !cgroup_network_server.out) {
+        error("CGROUP: cannot upgrade the connection to cgroup-network server to FILE.");
+        if(!cgroup_network_server.in) close(fd);
+        goto failed;
+    }
+
+    info("CGROUP: started cgroup-network server with pid %d.", (int)cgroup_network_server.pid);
+    return 0;
+
+failed:
+    cgroup_network_server_stop();
+    cgroup_network_server.failed_t = now_monotonic_sec();
+    return -1;
+}
+
+static inline int read_cgroups_network_interfaces_from_server(struct cgroup **cgs, size_t count) {
+    if(!cgroup_network_server.in) {
+        if(cgroup_network_server.failed_t && now_monotonic_sec() - cgroup_network_server.failed_t < CGROUP_NETWORK_SERVER_RETRY_SECONDS)
+            return -1;
+
+        if(cgroup_network_server_start())
+            return -1;
+    }
+
+    size_t i;
+    for(i = 0; i < count ; i++)
+        fprintf(cgroup_network_server.out, "CGROUP %s%s\n", (cgs[i]->options & CGROUP_OPTIONS_IS_UNIFIED) ? cgroup_unified_base : cgroup_cpuacct_base, cgs[i]->id);
+
+    fprintf(cgroup_network_server.out, "END\n");
+
+    if(fflush(cgroup_network_server.out) != EOF) {
+        // the answers are in the order of the requests
+        struct cgroup *cg = NULL;
+        size_t answered = 0;
+
+        char *s;
+        char buffer[CGROUP_NETWORK_INTERFACE_MAX_LINE + 1];
+        while((s = fgets(buffer, CGROUP_NETWORK_INTERFACE_MAX_LINE, cgroup_network_server.in))) {
+            if(!strncmp(s, "CGROUP ", 7)) {
+                cg = (answered < count) ? cgs[answered++] : NULL;
+                if(cg) debug(D_CGROUP, "looking for the network interfaces of cgroup '%s' with chart id '%s' and title '%s'", cg->id, cg->chart_id, cg->chart_title);
+            }
+            else if(!strcmp(s, "END\n"))
+                return 0;
+            else if(cg)
+                cgroup_network_interface_add(cg, s);
+        }
+    }
+
+    error("CGROUP: lost the connection to cgroup-network server, running it for every cgroup for the next %d seconds.", CGROUP_NETWORK_SERVER_RETRY_SECONDS);
+    cgroup_network_server_stop();
+    cgroup_network_server.failed_t = now_monotonic_sec();
+
+    // the cgroups will be asked again, one by one
+    for(i = 0; i < count ; i++)
+        free_cgroup_network_interfaces(cgs[i]);
+
+    return -1;
+}
+
+// find the network interfaces of all the cgroups that need them, at once
+static inline void read_all_cgroups_network_interfaces(void) {
+    static struct cgroup **cgs = NULL;
+    static size_t cgs_size = 0;
+    size_t count = 0, i;
+
+    struct cgroup *cg;
+    for(cg = cgroup_root; cg ; cg = cg->next) {
+        if(likely(!cg->pending_network_interfaces))
+            continue;
+
+        cg->pending_network_interfaces = 0;
+
+        if(unlikely(!cg->available || !cg->enabled || cg->pending_renames || cg->options & CGROUP_OPTIONS_SYSTEM_SLICE_SERVICE))
+            continue;
+
+        if(unlikely(count == cgs_size)) {
+            cgs_size = (cgs_size) ? cgs_size * 2 : 64;
+            cgs = reallocz(cgs, cgs_size * sizeof(struct cgroup *));
+        }
+        cgs[count++] = cg;
+    }
+
+    if(likely(!count))
+        return;
+
+    if(cgroups_network_interface_server && !read_cgroups_network_interfaces_from_server(cgs, count))
+        return;
+
+    for(i = 0; i < count ; i++)
+        read_cgroup_network_interfaces(cgs[i]);
+}
+
 // ----------------------------------------------------------------------------
 // add/remove/find cgroup objects
 
@@ -1059,95 +1634,136 @@ static inline char *cgroup_chart_id_strdupz(const char *s) {
     return r;
 }
 
-static inline void cgroup_get_chart_name(struct cgroup *cg) {
-    debug(D_CGROUP, "looking for the name of cgroup '%s' with chart id '%s' and title '%s'", cg->id, cg->chart_id, cg->chart_title);
+// ----------------------------------------------------------------------------
+// cgroup renames
+//
+// The script that finds the names of the cgroups may need seconds to ask docker
+// or kubernetes, so it is run by a helper thread, for all the cgroups queued,
+// while the cgroups are collected. The cgroups are not collected until their
+// names are found (pending_renames).
+
+struct cgroup_rename {
+    size_t request;             // the rename_request of the cgroup
+    char *id;
+    char *chart_id;             // the chart id given to the script
+    int retry;                  // 1 for the second attempt, made to deal with the docker lag
+
+    char *name;                 // the name the script gave, or NULL
+    int name_error;             // the exit code of the script
+
+    struct cgroup_rename *next;
+};
+
+static struct cgroup_renames {
+    int threaded;               // 0 when the scripts are run by the cgroups thread
+    size_t last_request;
+
+    netdata_mutex_t mutex;
+    pthread_cond_t cond;
+    struct cgroup_rename *queued;   // under the mutex
+    struct cgroup_rename *done;     // under the mutex
+
+    netdata_thread_t thread;
+} cgroup_renames = {
+        .threaded = 0,
+        .last_request = 0,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .queued = NULL,
+        .done = NULL
+};
 
+static void cgroup_rename_run(struct cgroup_rename *r) {
     pid_t cgroup_pid;
     char command[CGROUP_CHARTID_LINE_MAX + 1];
 
-    snprintfz(command, CGROUP_CHARTID_LINE_MAX, "exec %s '%s'", cgroups_rename_script, cg->chart_id);
+    snprintfz(command, CGROUP_CHARTID_LINE_MAX, "exec %s '%s'", cgroups_rename_script, r->chart_id);
 
-    debug(D_CGROUP, "executing command \"%s\" for cgroup '%s'", command, cg->chart_id);
+    debug(D_CGROUP, "executing command \"%s\" for cgroup '%s'", command, r->chart_id);
     FILE *fp = mypopen(command, &cgroup_pid);
     if(fp) {
-        // debug(D_CGROUP, "reading from command '%s' for cgroup '%s'", command, cg->id);
         char buffer[CGROUP_CHARTID_LINE_MAX + 1];
         char *s = fgets(buffer, CGROUP_CHARTID_LINE_MAX, fp);
-        // debug(D_CGROUP, "closing command for cgroup '%s'", cg->id);
-        int name_error = mypclose(fp, cgroup_pid);
-        // debug(D_CGROUP, "closed command for cgroup '%s'", cg->id);
+        r->name_error = mypclose(fp, cgroup_pid);
 
         if(s && *s && *s != '\n') {
-            debug(D_CGROUP, "cgroup '%s' should be renamed to '%s'", cg->chart_id, s);
-
             s = trim(s);
-            if (s) {
-                if(likely(name_error==0))
-                    cg->pending_renames = 0;
-                else if (unlikely(name_error==3)) {
-                    debug(D_CGROUP, "cgroup '%s' disabled based due to rename command output", cg->chart_id);
-                    cg->enabled = 0;
-                }
-
-                if(likely(cg->pending_renames < 2)) {
-                    freez(cg->chart_title);
-                    cg->chart_title = cgroup_title_strdupz(s);
-
-                    freez(cg->chart_id);
-                    cg->chart_id = cgroup_chart_id_strdupz(s);
-                    cg->hash_chart = simple_hash(cg->chart_id);
-                }
-            }
+            if(s) r->name = strdupz(s);
         }
     }
     else
         error("CGROUP: cannot popen(\"%s\", \"r\").", command);
 }
 
-static inline struct cgroup *cgroup_add(const char *id) {
-    if(!id || !*id) id = "/";
-    debug(D_CGROUP, "adding to list, cgroup with id '%s'", id);
-
-    if(cgroup_root_count >= cgroup_root_max) {
-        info("CGROUP: maximum number of cgroups reached (%d). Not adding cgroup '%s'", cgroup_root_count, id);
-        return NULL;
-    }
+static inline void cgroup_rename_done(struct cgroup_rename *first, struct cgroup_rename *last) {
+    netdata_mutex_lock(&cgroup_renames.mutex);
+    last->next = cgroup_renames.done;
+    cgroup_renames.done = first;
+    netdata_mutex_unlock(&cgroup_renames.mutex);
+}
 
-    int def = simple_pattern_matches(enabled_cgroup_patterns, id)?cgroup_enable_new_cgroups_detected_at_runtime:0;
-    struct cgroup *cg = callocz(1, sizeof(struct cgroup));
+static void *cgroup_renames_thread(void *ptr) {
+    (void)ptr;
 
-    cg->id = strdupz(id);
-    cg->hash = simple_hash(cg->id);
+    netdata_mutex_lock(&cgroup_renames.mutex);
+    while(!netdata_exit) {
+        struct cgroup_rename *batch = cgroup_renames.queued, *r, *last = NULL;
 
-    cg->chart_title = cgroup_title_strdupz(id);
+        if(!batch) {
+            pthread_cond_wait(&cgroup_renames.cond, &cgroup_renames.mutex);
+            continue;
+        }
 
-    cg->chart_id = cgroup_chart_id_strdupz(id);
-    cg->hash_chart = simple_hash(cg->chart_id);
+        cgroup_renames.queued = NULL;
+        netdata_mutex_unlock(&cgroup_renames.mutex);
 
-    if(cgroup_use_unified_cgroups) cg->options |= CGROUP_OPTIONS_IS_UNIFIED;
+        for(r = batch; r ; r = r->next) {
+            cgroup_rename_run(r);
+            last = r;
+        }
 
-    if(!cgroup_root)
-        cgroup_root = cg;
-    else {
-        // append it
-        struct cgroup *e;
-        for(e = cgroup_root; e->next ;e = e->next) ;
-        e->next = cg;
+        cgroup_rename_done(batch, last);
+        netdata_mutex_lock(&cgroup_renames.mutex);
     }
+    netdata_mutex_unlock(&cgroup_renames.mutex);
 
-    cgroup_root_count++;
+    return NULL;
+}
 
-    // fix the chart_id and title by calling the external script
-    if(simple_pattern_matches(enabled_cgroup_renames, cg->id)) {
+static void cgroup_renames_init(void) {
+    if(netdata_thread_create(&cgroup_renames.thread, "PLUGIN[cgroups-names]", NETDATA_THREAD_OPTION_DONT_LOG, cgroup_renames_thread, NULL) == 0)
+        cgroup_renames.threaded = 1;
+    else
+        error("CGROUP: cannot create the thread to rename cgroups. The cgroups will be renamed while they are collected.");
+}
 
-        cg->pending_renames = 2;
-        cgroup_get_chart_name(cg);
+static inline void cgroup_rename_queue(struct cgroup *cg, int retry) {
+    struct cgroup_rename *r = callocz(1, sizeof(struct cgroup_rename));
+    r->request = cg->rename_request = ++cgroup_renames.last_request;
+    r->id = strdupz(cg->id);
+    r->chart_id = strdupz(cg->chart_id);
+    r->retry = retry;
 
-        debug(D_CGROUP, "cgroup '%s' renamed to '%s' (title: '%s')", cg->id, cg->chart_id, cg->chart_title);
+    if(unlikely(!cgroup_renames.threaded)) {
+        cgroup_rename_run(r);
+        cgroup_rename_done(r, r);
+        return;
     }
-    else
-        debug(D_CGROUP, "cgroup '%s' will not be renamed - it matches the list of disabled cgroup renames (will be shown as '%s')", cg->id, cg->chart_id);
 
+    netdata_mutex_lock(&cgroup_renames.mutex);
+    r->next = cgroup_renames.queued;
+    cgroup_renames.queued = r;
+    pthread_cond_signal(&cgroup_renames.cond);
+    netdata_mutex_unlock(&cgroup_renames.mutex);
+}
+
+static inline int cgroup_renames_completed(void) {
+    return __atomic_load_n(&cgroup_renames.done, __ATOMIC_RELAXED) != NULL;
+}
+
+// configure the cgroup, after its name has been found
+static inline void cgroup_configure(struct cgroup *cg) {
+    int def = simple_pattern_matches(enabled_cgroup_patterns, cg->id)?cgroup_enable_new_cgroups_detected_at_runtime:0;
     int user_configurable = 1;
 
     // check if this cgroup should be a systemd service
@@ -1223,10 +1839,73 @@ static inline struct cgroup *cgroup_add(const char *id) {
     }
 
     if(cg->enabled && !cg->pending_renames && !(cg->options & CGROUP_OPTIONS_SYSTEM_SLICE_SERVICE))
-        read_cgroup_network_interfaces(cg);
+        cg->pending_network_interfaces = 1;
 
     debug(D_CGROUP, "ADDED CGROUP: '%s' with chart id '%s' and title '%s' as %s (default was %s)", cg->id, cg->chart_id, cg->chart_title, (cg->enabled)?"enabled":"disabled", (def)?"enabled":"disabled");
+}
+
+static inline struct cgroup *cgroup_add(const char *id) {
+    if(!id || !*id) id = "/";
+    debug(D_CGROUP, "adding to list, cgroup with id '%s'", id);
+
+    if(cgroup_root_count >= cgroup_root_max) {
+        info("CGROUP: maximum number of cgroups reached (%d). Not adding cgroup '%s'", cgroup_root_count, id);
+        return NULL;
+    }
+
+    struct cgroup *cg = callocz(1, sizeof(struct cgroup));
+
+    cg->cpuacct_stat.fd = -1;
+    cg->cpuacct_usage.fd = -1;
+    cg->memory.fd_detailed = -1;
+    cg->memory.fd_usage_in_bytes = -1;
+    cg->memory.fd_msw_usage_in_bytes = -1;
+    cg->memory.fd_failcnt = -1;
+    cg->io_service_bytes.fd = -1;
+    cg->io_serviced.fd = -1;
+    cg->throttle_io_service_bytes.fd = -1;
+    cg->throttle_io_serviced.fd = -1;
+    cg->io_merged.fd = -1;
+    cg->io_queued.fd = -1;
+    cg->cpu_pressure.fd = -1;
+    cg->memory_pressure.fd = -1;
+    cg->io_pressure.fd = -1;
+
+    cg->id = strdupz(id);
+    cg->hash = simple_hash(cg->id);
+
+    cg->chart_title = cgroup_title_strdupz(id);
+
+    cg->chart_id = cgroup_chart_id_strdupz(id);
+    cg->hash_chart = simple_hash(cg->chart_id);
+
+    if(cgroup_use_unified_cgroups) cg->options |= CGROUP_OPTIONS_IS_UNIFIED;
+
+    if(!cgroup_root)
+        cgroup_root = cg;
+    else {
+        // append it
+        struct cgroup *e;
+        for(e = cgroup_root; e->next ;e = e->next) ;
+        e->next = cg;
+    }
+
+    cgroup_root_count++;
+
+    // fix the chart_id and title by calling the external script
+    // the rest is configured when its name is found
+    if(simple_pattern_matches(enabled_cgroup_renames, cg->id)) {
+
+        cg->pending_renames = 2;
+        cgroup_rename_queue(cg, 0);
 
+        debug(D_CGROUP, "cgroup '%s' queued to be renamed", cg->id);
+        return cg;
+    }
+    else
+        debug(D_CGROUP, "cgroup '%s' will not be renamed - it matches the list of disabled cgroup renames (will be shown as '%s')", cg->id, cg->chart_id);
+
+    cgroup_configure(cg);
     return cg;
 }
 
@@ -1250,6 +1929,13 @@ static inline void cgroup_free(struct cgroup *cg) {
     if(cg->st_queued_ops)            rrdset_is_obsolete(cg->st_queued_ops);
     if(cg->st_merged_ops)            rrdset_is_obsolete(cg->st_merged_ops);
 
+    if(cg->cpu_pressure.some.st)     rrdset_is_obsolete(cg->cpu_pressure.some.st);
+    if(cg->cpu_pressure.full.st)     rrdset_is_obsolete(cg->cpu_pressure.full.st);
+    if(cg->memory_pressure.some.st)  rrdset_is_obsolete(cg->memory_pressure.some.st);
+    if(cg->memory_pressure.full.st)  rrdset_is_obsolete(cg->memory_pressure.full.st);
+    if(cg->io_pressure.some.st)      rrdset_is_obsolete(cg->io_pressure.some.st);
+    if(cg->io_pressure.full.st)      rrdset_is_obsolete(cg->io_pressure.full.st);
+
     freez(cg->filename_cpuset_cpus);
     freez(cg->filename_cpu_cfs_period);
     freez(cg->filename_cpu_cfs_quota);
@@ -1260,6 +1946,23 @@ static inline void cgroup_free(struct cgroup *cg) {
 
     freez(cg->cpuacct_usage.cpu_percpu);
 
+    cgroup_file_close(&cg->cpuacct_stat.fd);
+    cgroup_file_close(&cg->cpuacct_usage.fd);
+    cgroup_file_close(&cg->memory.fd_detailed);
+    cgroup_file_close(&cg->memory.fd_usage_in_bytes);
+    cgroup_file_close(&cg->memory.fd_msw_usage_in_bytes);
+    cgroup_file_close(&cg->memory.fd_failcnt);
+    cgroup_file_close(&cg->io_service_bytes.fd);
+    cgroup_file_close(&cg->io_serviced.fd);
+    cgroup_file_close(&cg->throttle_io_service_bytes.fd);
+    cgroup_file_close(&cg->throttle_io_serviced.fd);
+    cgroup_file_close(&cg->io_merged.fd);
+    cgroup_file_close(&cg->io_queued.fd);
+    cgroup_file_close(&cg->cpu_pressure.fd);
+    cgroup_file_close(&cg->memory_pressure.fd);
+    cgroup_file_close(&cg->io_pressure.fd);
+
+    arl_free(cg->cpuacct_stat.arl_base);
     freez(cg->cpuacct_stat.filename);
     freez(cg->cpuacct_usage.filename);
 
@@ -1278,6 +1981,10 @@ static inline void cgroup_free(struct cgroup *cg) {
     freez(cg->io_merged.filename);
     freez(cg->io_queued.filename);
 
+    freez(cg->cpu_pressure.filename);
+    freez(cg->memory_pressure.filename);
+    freez(cg->io_pressure.filename);
+
     freez(cg->id);
     freez(cg->chart_id);
     freez(cg->chart_title);
@@ -1303,6 +2010,148 @@ static inline struct cgroup *cgroup_find(const char *id) {
     return cg;
 }
 
+// apply the names the script found
+static inline void cgroup_renames_apply(void) {
+    netdata_mutex_lock(&cgroup_renames.mutex);
+    struct cgroup_rename *r = cgroup_renames.done;
+    cgroup_renames.done = NULL;
+    netdata_mutex_unlock(&cgroup_renames.mutex);
+
+    while(r) {
+        struct cgroup_rename *next = r->next;
+
+        // the cgroup may have been removed, or even added again, meanwhile
+        struct cgroup *cg = cgroup_find(r->id);
+        if(cg && cg->rename_request == r->request) {
+            cg->rename_request = 0;
+
+            if(r->name) {
+                debug(D_CGROUP, "cgroup '%s' should be renamed to '%s'", cg->chart_id, r->name);
+
+                if(likely(r->name_error == 0))
+                    cg->pending_renames = 0;
+                else if(unlikely(r->name_error == 3)) {
+                    debug(D_CGROUP, "cgroup '%s' disabled based due to rename command output", cg->chart_id);
+                    cg->enabled = 0;
+                }
+
+                if(likely(cg->pending_renames < 2)) {
+                    freez(cg->chart_title);
+                    cg->chart_title = cgroup_title_strdupz(r->name);
+
+                    freez(cg->chart_id);
+                    cg->chart_id = cgroup_chart_id_strdupz(r->name);
+                    cg->hash_chart = simple_hash(cg->chart_id);
+                }
+            }
+
+            debug(D_CGROUP, "cgroup '%s' renamed to '%s' (title: '%s')", cg->id, cg->chart_id, cg->chart_title);
+
+            if(!r->retry)
+                cgroup_configure(cg);
+            else {
+                cg->pending_renames = 0;
+
+                if(cg->enabled && !(cg->options & CGROUP_OPTIONS_SYSTEM_SLICE_SERVICE))
+                    cg->pending_network_interfaces = 1;
+            }
+        }
+
+        freez(r->id);
+        freez(r->chart_id);
+        freez(r->name);
+        freez(r);
+        r = next;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// watching the cgroup hierarchies
+//
+// The directories of the cgroups are watched with inotify, so that only the
+// cgroups created or removed since the last check are examined, instead of
+// walking all the cgroup hierarchies again. They are walked again only when
+// the kernel has dropped events, or when a directory cannot be watched.
+
+struct cgroup_watch {
+    const char *base;           // the cgroup hierarchy of the directory
+    char *path;                 // the full path of the directory, NULL when not used
+};
+
+static struct cgroup_watches {
+    int fd;                     // the inotify file descriptor, or -1
+    int full_scan;              // 1 when the cgroup hierarchies have to be walked
+
+    struct cgroup_watch *watches;   // indexed by the watch descriptors
+    size_t size;
+} cgroup_watches = {
+        .fd = -1,
+        .full_scan = 1,
+        .watches = NULL,
+        .size = 0
+};
+
+static void cgroup_watch_init(void) {
+    if(!cgroup_watch_with_inotify) return;
+
+    cgroup_watches.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(cgroup_watches.fd == -1)
+        error("CGROUP: cannot initialize inotify. The cgroup hierarchies will be walked to find new cgroups.");
+}
+
+static void cgroup_watch_disable(void) {
+    if(cgroup_watches.fd == -1) return;
+
+    close(cgroup_watches.fd);
+    cgroup_watches.fd = -1;
+
+    size_t i;
+    for(i = 0; i < cgroup_watches.size ; i++)
+        freez(cgroup_watches.watches[i].path);
+
+    freez(cgroup_watches.watches);
+    cgroup_watches.watches = NULL;
+    cgroup_watches.size = 0;
+}
+
+static inline void cgroup_watch_add(const char *base, const char *path) {
+    if(cgroup_watches.fd == -1) return;
+
+    int wd = inotify_add_watch(cgroup_watches.fd, path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if(unlikely(wd == -1)) {
+        // it has been removed meanwhile
+        if(errno == ENOENT) return;
+
+        error("CGROUP: cannot watch directory '%s' with inotify (is fs.inotify.max_user_watches too low?). The cgroup hierarchies will be walked to find new cgroups.", path);
+        cgroup_watch_disable();
+        return;
+    }
+
+    if(unlikely((size_t)wd >= cgroup_watches.size)) {
+        size_t size = (cgroup_watches.size)?cgroup_watches.size * 2:1024;
+        while(size <= (size_t)wd) size *= 2;
+
+        cgroup_watches.watches = reallocz(cgroup_watches.watches, size * sizeof(struct cgroup_watch));
+        memset(&cgroup_watches.watches[cgroup_watches.size], 0, (size - cgroup_watches.size) * sizeof(struct cgroup_watch));
+        cgroup_watches.size = size;
+    }
+
+    // the same directory gets the same watch descriptor
+    struct cgroup_watch *w = &cgroup_watches.watches[wd];
+    if(!w->path || strcmp(w->path, path) != 0) {
+        freez(w->path);
+        w->path = strdupz(path);
+    }
+    w->base = base;
+}
+
+static inline int cgroup_watch_has_events(void) {
+    if(cgroup_watches.fd == -1) return 0;
+
+    struct pollfd pfd = { .fd = cgroup_watches.fd, .events = POLLIN, .revents = 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
+
 // ----------------------------------------------------------------------------
 // detect running cgroups
 
@@ -1329,26 +2178,24 @@ static inline void found_subdir_in_dir(const char *dir) {
         cg = cgroup_add(dir);
     }
 
-    if(cg) {
-        // delay renaming of the cgroup and looking for network interfaces to deal with the docker lag when starting the container
-        if(unlikely(cg->pending_renames == 1)) {
-            // fix the chart_id and title by calling the external script
-            if(simple_pattern_matches(enabled_cgroup_renames, cg->id)) {
-
-                cgroup_get_chart_name(cg);
-                cg->pending_renames = 0;
+    if(cg)
+        cg->available = 1;
+}
 
-                if(cg->enabled && !(cg->options & CGROUP_OPTIONS_SYSTEM_SLICE_SERVICE))
-                    read_cgroup_network_interfaces(cg);
+// do not decent in directories we are not interested
+static inline int cgroup_search_under(const char *relative_path) {
+    const char *r = relative_path;
+    if(*r == '\0') r = "/";
 
-                debug(D_CGROUP, "cgroup '%s' renamed to '%s' (title: '%s')", cg->id, cg->chart_id, cg->chart_title);
-            }
-            else
-                debug(D_CGROUP, "cgroup '%s' will not be renamed - it matches the list of disabled cgroup renames (will be shown as '%s')", cg->id, cg->chart_id);
-        }
+    int def = simple_pattern_matches(enabled_cgroup_paths, r);
 
-        cg->available = 1;
-    }
+    // we check for this option here
+    // so that the config will not have settings
+    // for leaf directories
+    char option[FILENAME_MAX + 1];
+    snprintfz(option, FILENAME_MAX, "search for cgroups under %s", r);
+    option[FILENAME_MAX] = '\0';
+    return config_get_boolean("plugin:cgroups", option, def);
 }
 
 static inline int find_dir_in_subdirs(const char *base, const char *this, void (*callback)(const char *)) {
@@ -1370,6 +2217,7 @@ static inline int find_dir_in_subdirs(const char *base, const char *this, void (
     }
     ret = 1;
 
+    cgroup_watch_add(base, this);
     callback(relative_path);
 
     struct dirent *de = NULL;
@@ -1382,21 +2230,8 @@ static inline int find_dir_in_subdirs(const char *base, const char *this, void (
             continue;
 
         if(de->d_type == DT_DIR) {
-            if(enabled == -1) {
-                const char *r = relative_path;
-                if(*r == '\0') r = "/";
-
-                // do not decent in directories we are not interested
-                int def = simple_pattern_matches(enabled_cgroup_paths, r);
-
-                // we check for this option here
-                // so that the config will not have settings
-                // for leaf directories
-                char option[FILENAME_MAX + 1];
-                snprintfz(option, FILENAME_MAX, "search for cgroups under %s", r);
-                option[FILENAME_MAX] = '\0';
-                enabled = config_get_boolean("plugin:cgroups", option, def);
-            }
+            if(enabled == -1)
+                enabled = cgroup_search_under(relative_path);
 
             if(enabled) {
                 char *s = mallocz(dirlen + strlen(de->d_name) + 2);
@@ -1414,6 +2249,107 @@ static inline int find_dir_in_subdirs(const char *base, const char *this, void (
     return ret;
 }
 
+// a directory was created in a watched cgroup directory
+static inline void cgroup_watch_created(const char *base, const char *parent, const char *path) {
+    debug(D_CGROUP, "directory '%s' created", path);
+
+    // the same check the walk does for the subdirectories of parent
+    if(cgroup_search_under(&parent[strlen(base)]))
+        find_dir_in_subdirs(base, path, found_subdir_in_dir);
+}
+
+static inline int cgroup_dir_exists(const char *base, const char *id) {
+    char filename[FILENAME_MAX + 1];
+    struct stat buf;
+
+    snprintfz(filename, FILENAME_MAX, "%s%s", base, id);
+    return stat(filename, &buf) == 0 && S_ISDIR(buf.st_mode);
+}
+
+// a directory was removed from a watched cgroup directory
+static inline void cgroup_watch_removed(const char *base, const char *path) {
+    debug(D_CGROUP, "directory '%s' removed", path);
+
+    const char *id = &path[strlen(base)];
+    struct cgroup *cg = cgroup_find(id);
+    if(!cg) return;
+
+    // the cgroup is still available, if it is found in another hierarchy
+    if(!cgroup_use_unified_cgroups) {
+        if((cgroup_enable_cpuacct_stat || cgroup_enable_cpuacct_usage) && cgroup_dir_exists(cgroup_cpuacct_base, id))
+            return;
+
+        if((cgroup_enable_blkio_io || cgroup_enable_blkio_ops || cgroup_enable_blkio_throttle_io || cgroup_enable_blkio_throttle_ops || cgroup_enable_blkio_merged_ops || cgroup_enable_blkio_queued_ops) && cgroup_dir_exists(cgroup_blkio_base, id))
+            return;
+
+        if((cgroup_enable_memory || cgroup_enable_detailed_memory || cgroup_enable_swap || cgroup_enable_memory_failcnt) && cgroup_dir_exists(cgroup_memory_base, id))
+            return;
+
+        if(cgroup_search_in_devices && cgroup_dir_exists(cgroup_devices_base, id))
+            return;
+    }
+    else if(cgroup_dir_exists(cgroup_unified_base, id))
+        return;
+
+    cg->available = 0;
+}
+
+// process the events of the watched directories
+// returns 0 when the cgroup hierarchies have to be walked
+static inline int cgroup_watch_process_events(void) {
+    char buffer[8192] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    while(cgroup_watches.fd != -1) {
+        ssize_t len = read(cgroup_watches.fd, buffer, sizeof(buffer));
+        if(len == -1) {
+            if(errno == EAGAIN) break;
+            if(errno == EINTR) continue;
+
+            error("CGROUP: cannot read inotify events. The cgroup hierarchies will be walked to find new cgroups.");
+            cgroup_watch_disable();
+            break;
+        }
+
+        char *ptr;
+        for(ptr = buffer; ptr < buffer + len ; ptr += sizeof(struct inotify_event) + ((struct inotify_event *)ptr)->len) {
+            const struct inotify_event *ev = (const struct inotify_event *)ptr;
+
+            if(unlikely(ev->mask & IN_Q_OVERFLOW)) {
+                info("CGROUP: inotify events have been lost. Walking the cgroup hierarchies.");
+                cgroup_watches.full_scan = 1;
+                continue;
+            }
+
+            if(unlikely(ev->wd < 0 || (size_t)ev->wd >= cgroup_watches.size || !cgroup_watches.watches[ev->wd].path))
+                continue;
+
+            if(ev->mask & IN_IGNORED) {
+                // the directory has been removed
+                freez(cgroup_watches.watches[ev->wd].path);
+                cgroup_watches.watches[ev->wd].path = NULL;
+                continue;
+            }
+
+            if(!(ev->mask & IN_ISDIR) || !ev->len)
+                continue;
+
+            // the watches may be reallocated while processing the event
+            const char *base = cgroup_watches.watches[ev->wd].base;
+            char parent[FILENAME_MAX + 1], path[FILENAME_MAX + 1];
+            strncpyz(parent, cgroup_watches.watches[ev->wd].path, FILENAME_MAX);
+            snprintfz(path, FILENAME_MAX, "%s/%s", parent, ev->name);
+
+            if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+                cgroup_watch_created(base, parent, path);
+
+            else if(ev->mask & (IN_DELETE | IN_MOVED_FROM))
+                cgroup_watch_removed(base, path);
+        }
+    }
+
+    return cgroup_watches.fd != -1 && !cgroup_watches.full_scan;
+}
+
 static inline void mark_all_cgroups_as_not_available() {
     debug(D_CGROUP, "marking all cgroups as not available");
 
@@ -1465,6 +2401,11 @@ static inline void cleanup_all_cgroups() {
 static inline void find_all_cgroups() {
     debug(D_CGROUP, "searching for cgroups");
 
+    if(likely(cgroup_watches.fd != -1 && !cgroup_watches.full_scan && cgroup_watch_process_events()))
+        goto found;
+
+    cgroup_watches.full_scan = 0;
+
     mark_all_cgroups_as_not_available();
     if(!cgroup_use_unified_cgroups) {
         if(cgroup_enable_cpuacct_stat || cgroup_enable_cpuacct_usage) {
@@ -1511,14 +2452,31 @@ static inline void find_all_cgroups() {
         }
     }
 
+found:
+    // the names of the cgroups found so far
+    cgroup_renames_apply();
+
     // remove any non-existing cgroups
     cleanup_all_cgroups();
 
+    // the network interfaces of the cgroups added or renamed
+    read_all_cgroups_network_interfaces();
+
     struct cgroup *cg;
     struct stat buf;
     for(cg = cgroup_root; cg ; cg = cg->next) {
         // fprintf(stderr, " >>> CGROUP '%s' (%u - %s) with name '%s'\n", cg->id, cg->hash, cg->available?"available":"stopped", cg->name);
 
+        // its name is being found
+        if(unlikely(cg->rename_request))
+            continue;
+
+        // delay renaming of the cgroup and looking for network interfaces to deal with the docker lag when starting the container
+        if(unlikely(cg->pending_renames == 1 && cg->available)) {
+            cgroup_rename_queue(cg, 1);
+            continue;
+        }
+
         if(unlikely(cg->pending_renames))
             cg->pending_renames--;
 
@@ -1742,6 +2700,39 @@ static inline void find_all_cgroups() {
                 else
                     debug(D_CGROUP, "memory.swap file for cgroup '%s': '%s' does not exist.", cg->id, filename);
             }
+
+            if(unlikely(cgroup_enable_pressure && !cg->cpu_pressure.filename)) {
+                snprintfz(filename, FILENAME_MAX, "%s%s/cpu.pressure", cgroup_unified_base, cg->id);
+                if(likely(stat(filename, &buf) != -1)) {
+                    cg->cpu_pressure.filename = strdupz(filename);
+                    cg->cpu_pressure.enabled = cgroup_enable_pressure;
+                    debug(D_CGROUP, "cpu.pressure filename for cgroup '%s': '%s'", cg->id, cg->cpu_pressure.filename);
+                }
+                else
+                    debug(D_CGROUP, "cpu.pressure file for cgroup '%s': '%s' does not exist.", cg->id, filename);
+            }
+
+            if(unlikely(cgroup_enable_pressure && !cg->memory_pressure.filename)) {
+                snprintfz(filename, FILENAME_MAX, "%s%s/memory.pressure", cgroup_unified_base, cg->id);
+                if(likely(stat(filename, &buf) != -1)) {
+                    cg->memory_pressure.filename = strdupz(filename);
+                    cg->memory_pressure.enabled = cgroup_enable_pressure;
+                    debug(D_CGROUP, "memory.pressure filename for cgroup '%s': '%s'", cg->id, cg->memory_pressure.filename);
+                }
+                else
+                    debug(D_CGROUP, "memory.pressure file for cgroup '%s': '%s' does not exist.", cg->id, filename);
+            }
+
+            if(unlikely(cgroup_enable_pressure && !cg->io_pressure.filename)) {
+                snprintfz(filename, FILENAME_MAX, "%s%s/io.pressure", cgroup_unified_base, cg->id);
+                if(likely(stat(filename, &buf) != -1)) {
+                    cg->io_pressure.filename = strdupz(filename);
+                    cg->io_pressure.enabled = cgroup_enable_pressure;
+                    debug(D_CGROUP, "io.pressure filename for cgroup '%s': '%s'", cg->id, cg->io_pressure.filename);
+                }
+                else
+                    debug(D_CGROUP, "io.pressure file for cgroup '%s': '%s' does not exist.", cg->id, filename);
+            }
         }
     }
 
@@ -2700,6 +3691,46 @@ static inline int update_memory_limits(char **filename, RRDSETVAR **chart_var, u
     return 0;
 }
 
+static inline void update_cgroup_pressure_chart(struct cgroup *cg, struct pressure_charts *pcs, const char *id, const char *family, const char *title, long priority, int update_every) {
+    if(unlikely(!pcs->available))
+        return;
+
+    if(unlikely(!pcs->st)) {
+        char type[RRD_ID_LENGTH_MAX + 1];
+        char context[RRD_ID_LENGTH_MAX + 1];
+        char chart_title[CHART_TITLE_MAX + 1];
+
+        snprintfz(context, RRD_ID_LENGTH_MAX, "cgroup.%s", id);
+        snprintfz(chart_title, CHART_TITLE_MAX, "%s for cgroup %s", title, cg->chart_title);
+
+        pcs->st = rrdset_create_localhost(
+                cgroup_chart_type(type, cg->chart_id, RRD_ID_LENGTH_MAX)
+                , id
+                , NULL
+                , family
+                , context
+                , chart_title
+                , "percentage"
+                , PLUGIN_CGROUPS_NAME
+                , PLUGIN_CGROUPS_MODULE_CGROUPS_NAME
+                , priority
+                , update_every
+                , RRDSET_TYPE_LINE
+        );
+
+        pcs->rd_avg10  = rrddim_add(pcs->st, "avg10",  "10 sec",  1, 100, RRD_ALGORITHM_ABSOLUTE);
+        pcs->rd_avg60  = rrddim_add(pcs->st, "avg60",  "60 sec",  1, 100, RRD_ALGORITHM_ABSOLUTE);
+        pcs->rd_avg300 = rrddim_add(pcs->st, "avg300", "300 sec", 1, 100, RRD_ALGORITHM_ABSOLUTE);
+    }
+    else
+        rrdset_next(pcs->st);
+
+    rrddim_set_by_pointer(pcs->st, pcs->rd_avg10, pcs->avg10);
+    rrddim_set_by_pointer(pcs->st, pcs->rd_avg60, pcs->avg60);
+    rrddim_set_by_pointer(pcs->st, pcs->rd_avg300, pcs->avg300);
+    rrdset_done(pcs->st);
+}
+
 void update_cgroup_charts(int update_every) {
     debug(D_CGROUP, "updating cgroups charts");
 
@@ -3358,6 +4389,21 @@ void update_cgroup_charts(int update_every) {
             rrddim_set(cg->st_merged_ops, "write", cg->io_merged.Write);
             rrdset_done(cg->st_merged_ops);
         }
+
+        if(likely(cg->cpu_pressure.updated && cg->cpu_pressure.enabled == CONFIG_BOOLEAN_YES)) {
+            update_cgroup_pressure_chart(cg, &cg->cpu_pressure.some, "cpu_some_pressure", "cpu", "CPU some pressure", cgroup_containers_chart_priority + 2200, update_every);
+            update_cgroup_pressure_chart(cg, &cg->cpu_pressure.full, "cpu_full_pressure", "cpu", "CPU full pressure", cgroup_containers_chart_priority + 2210, update_every);
+        }
+
+        if(likely(cg->memory_pressure.updated && cg->memory_pressure.enabled == CONFIG_BOOLEAN_YES)) {
+            update_cgroup_pressure_chart(cg, &cg->memory_pressure.some, "mem_some_pressure", "mem", "Memory some pressure", cgroup_containers_chart_priority + 2220, update_every);
+            update_cgroup_pressure_chart(cg, &cg->memory_pressure.full, "mem_full_pressure", "mem", "Memory full pressure", cgroup_containers_chart_priority + 2230, update_every);
+        }
+
+        if(likely(cg->io_pressure.updated && cg->io_pressure.enabled == CONFIG_BOOLEAN_YES)) {
+            update_cgroup_pressure_chart(cg, &cg->io_pressure.some, "io_some_pressure", "disk", "I/O some pressure", cgroup_containers_chart_priority + 2240, update_every);
+            update_cgroup_pressure_chart(cg, &cg->io_pressure.full, "io_full_pressure", "disk", "I/O full pressure", cgroup_containers_chart_priority + 2250, update_every);
+        }
     }
 
     if(likely(cgroup_enable_systemd_services))
@@ -3379,6 +4425,9 @@ static void cgroup_main_cleanup(void *ptr) {
 
     info("cleaning up...");
 
+    cgroup_watch_disable();
+    cgroup_network_server_stop();
+
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
 
@@ -3391,6 +4440,9 @@ void *cgroups_main(void *ptr) {
     int vdo_cpu_netdata = config_get_boolean("plugin:cgroups", "cgroups plugin resource charts", 1);
 
     read_cgroup_plugin_configuration();
+    cgroup_watch_init();
+    cgroup_renames_init();
+    cgroup_readers_init();
 
     RRDSET *stcpu_thread = NULL;
 
@@ -3405,8 +4457,9 @@ void *cgroups_main(void *ptr) {
 
         // BEGIN -- the job to be done
 
+        // the cgroups created or removed, and the names found, are examined as soon as possible
         find_dt += hb_dt;
-        if(unlikely(find_dt >= find_every || cgroups_check)) {
+        if(unlikely(find_dt >= find_every || cgroups_check || cgroup_watch_has_events() || cgroup_renames_completed())) {
             find_all_cgroups();
             find_dt = 0;
             cgroups_check = 0;
@@ -8,23 +8,62 @@
 #define DEFAULT_EXCLUDED_FILESYSTEMS "*gvfs *gluster* *s3fs *ipfs *davfs2 *httpfs *sshfs *gdfs *moosefs fusectl"
 #define CONFIG_SECTION_DISKSPACE "plugin:proc:diskspace"
 
+#define DISKSPACE_STATVFS_BACKOFF_MAX_SEC 300
+
 static struct mountinfo *disk_mountinfo_root = NULL;
 static int check_for_new_mountpoints_every = 15;
 static int cleanup_mount_points = 1;
 
+// the kernel reports POLLPRI | POLLERR on an open mountinfo file when the mount table changes
+static int mountinfo_poll_fd = -1;
+
+static void mountinfo_poll_open(void) {
+    char filename[FILENAME_MAX + 1];
+
+    snprintfz(filename, FILENAME_MAX, "%s/proc/self/mountinfo", netdata_configured_host_prefix);
+    mountinfo_poll_fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+    if(mountinfo_poll_fd == -1) {
+        snprintfz(filename, FILENAME_MAX, "%s/proc/1/mountinfo", netdata_configured_host_prefix);
+        mountinfo_poll_fd = open(filename, O_RDONLY | O_CLOEXEC);
+    }
+
+    if(mountinfo_poll_fd == -1)
+        error("DISKSPACE: cannot open mountinfo to watch it for changes. Mount points will be checked every %d seconds.", check_for_new_mountpoints_every);
+}
+
+static inline int mountinfo_changed(void) {
+    struct pollfd pfd = { .fd = mountinfo_poll_fd, .events = POLLPRI, .revents = 0 };
+
+    if(poll(&pfd, 1, 0) == -1) {
+        error("DISKSPACE: cannot poll mountinfo for changes. Mount points will be checked every %d seconds.", check_for_new_mountpoints_every);
+        close(mountinfo_poll_fd);
+        mountinfo_poll_fd = -1;
+        return 1;
+    }
+
+    return (pfd.revents & (POLLPRI | POLLERR)) ? 1 : 0;
+}
+
 static inline void mountinfo_reload(int force) {
     static time_t last_loaded = 0;
     time_t now = now_realtime_sec();
 
-    if(force || now - last_loaded >= check_for_new_mountpoints_every) {
-        // mountinfo_free_all() can be called with NULL disk_mountinfo_root
-        mountinfo_free_all(disk_mountinfo_root);
+    if(likely(mountinfo_poll_fd != -1 && !force && disk_mountinfo_root)) {
+        // re-read it only when the kernel says it changed
+        if(likely(!mountinfo_changed()))
+            return;
+    }
+    else if(!force && now - last_loaded < check_for_new_mountpoints_every)
+        return;
 
-        // re-read mountinfo in case something changed
-        disk_mountinfo_root = mountinfo_read(0);
+    // mountinfo_free_all() can be called with NULL disk_mountinfo_root
+    mountinfo_free_all(disk_mountinfo_root);
 
-        last_loaded = now;
-    }
+    // re-read mountinfo in case something changed
+    disk_mountinfo_root = mountinfo_read(0);
+
+    last_loaded = now;
 }
 
 // Data to be stored in DICTIONARY dict_mountpoints used by do_disk_space_stats().
@@ -37,6 +76,19 @@ struct mount_point_metadata {
 
     size_t collected; // the number of times this has been collected
 
+    // statvfs() is called by the statvfs threads
+    char *mount_point;
+    int statvfs_state;                  // under the statvfs mutex
+    int statvfs_waited;                 // under the statvfs mutex - the collection thread waits for it
+    int statvfs_errno;                  // under the statvfs mutex
+    struct statvfs statvfs;             // under the statvfs mutex
+    usec_t statvfs_started_ut;          // under the statvfs mutex
+    usec_t statvfs_duration_ut;         // under the statvfs mutex
+    int statvfs_slow;                   // set when the last call did not return in time
+    usec_t statvfs_backoff_ut;          // the current backoff of a slow mount point
+    usec_t statvfs_next_ut;             // do not call statvfs() again before this time
+    struct mount_point_metadata *statvfs_next;
+
     RRDSET *st_space;
     RRDDIM *rd_space_used;
     RRDDIM *rd_space_avail;
@@ -50,6 +102,227 @@ struct mount_point_metadata {
 
 static DICTIONARY *dict_mountpoints = NULL;
 
+// ----------------------------------------------------------------------------
+// statvfs threads
+//
+// A hung NFS or FUSE mount point blocks statvfs() for as long as it is hung.
+// So statvfs() is called by a small pool of threads and the collection thread
+// waits for the results for up to 'statvfs timeout ms'. A mount point that
+// does not answer in time is skipped until its call returns, and then it is
+// called again after a backoff that doubles while it stays slow.
+
+#define STATVFS_IDLE    0
+#define STATVFS_QUEUED  1
+#define STATVFS_RUNNING 2
+#define STATVFS_DONE    3
+
+static struct statvfs_pool {
+    int threads;                            // 0 when statvfs() is called by the collection thread
+    usec_t timeout_ut;
+
+    netdata_mutex_t mutex;
+    pthread_cond_t cond_queued;
+    pthread_cond_t cond_done;
+
+    struct mount_point_metadata *queue;     // under the mutex
+    size_t waiting;                         // under the mutex
+} statvfs_pool = {
+        .threads = 0,
+        .timeout_ut = 500 * USEC_PER_MS,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond_queued = PTHREAD_COND_INITIALIZER,
+        .cond_done = PTHREAD_COND_INITIALIZER,
+        .queue = NULL,
+        .waiting = 0
+};
+
+static inline void statvfs_call(struct mount_point_metadata *m) {
+    struct statvfs buff;
+    usec_t started_ut = now_monotonic_usec();
+
+    int ret = statvfs(m->mount_point, &buff);
+    int err = (ret == -1) ? errno : 0;
+
+    netdata_mutex_lock(&statvfs_pool.mutex);
+    m->statvfs = buff;
+    m->statvfs_errno = (ret == -1) ? (err ? err : EIO) : 0;
+    m->statvfs_duration_ut = now_monotonic_usec() - started_ut;
+    m->statvfs_state = STATVFS_DONE;
+
+    if(m->statvfs_waited) {
+        m->statvfs_waited = 0;
+        if(!--statvfs_pool.waiting)
+            pthread_cond_signal(&statvfs_pool.cond_done);
+    }
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+}
+
+static void *statvfs_thread(void *ptr) {
+    (void)ptr;
+
+    netdata_mutex_lock(&statvfs_pool.mutex);
+    while(!netdata_exit) {
+        struct mount_point_metadata *m = statvfs_pool.queue;
+        if(!m) {
+            pthread_cond_wait(&statvfs_pool.cond_queued, &statvfs_pool.mutex);
+            continue;
+        }
+
+        statvfs_pool.queue = m->statvfs_next;
+        m->statvfs_next = NULL;
+        m->statvfs_state = STATVFS_RUNNING;
+        netdata_mutex_unlock(&statvfs_pool.mutex);
+
+        statvfs_call(m);
+
+        netdata_mutex_lock(&statvfs_pool.mutex);
+    }
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+
+    return NULL;
+}
+
+static void statvfs_pool_init(int threads) {
+    int i;
+    for(i = 0; i < threads ; i++) {
+        netdata_thread_t thread;
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "DISKSPACE[%d]", i);
+
+        if(netdata_thread_create(&thread, tag, NETDATA_THREAD_OPTION_DONT_LOG, statvfs_thread, NULL) != 0) {
+            error("DISKSPACE: cannot create statvfs thread No %d.", i);
+            break;
+        }
+    }
+
+    statvfs_pool.threads = i;
+    if(!statvfs_pool.threads)
+        error("DISKSPACE: statvfs() will be called by the disk space thread. Hung mount points will block it.");
+}
+
+static inline void statvfs_queue(struct mount_point_metadata *m, usec_t now_ut) {
+    netdata_mutex_lock(&statvfs_pool.mutex);
+
+    if(m->statvfs_state != STATVFS_IDLE || now_ut < m->statvfs_next_ut) {
+        netdata_mutex_unlock(&statvfs_pool.mutex);
+        return;
+    }
+
+    m->statvfs_started_ut = now_ut;
+
+    if(unlikely(!statvfs_pool.threads)) {
+        m->statvfs_state = STATVFS_RUNNING;
+        netdata_mutex_unlock(&statvfs_pool.mutex);
+        statvfs_call(m);
+        return;
+    }
+
+    m->statvfs_state = STATVFS_QUEUED;
+    m->statvfs_waited = 1;
+    m->statvfs_next = statvfs_pool.queue;
+    statvfs_pool.queue = m;
+    statvfs_pool.waiting++;
+
+    pthread_cond_signal(&statvfs_pool.cond_queued);
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+}
+
+// wait for the statvfs() calls queued in this iteration, up to the timeout
+static inline void statvfs_wait(usec_t started_ut) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    usec_t now_ut = now_monotonic_usec();
+    usec_t remaining_ut = (now_ut - started_ut < statvfs_pool.timeout_ut) ? statvfs_pool.timeout_ut - (now_ut - started_ut) : 0;
+    deadline.tv_sec  += remaining_ut / USEC_PER_SEC;
+    deadline.tv_nsec += (remaining_ut % USEC_PER_SEC) * NSEC_PER_USEC;
+    if(deadline.tv_nsec >= (long)NSEC_PER_SEC) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NSEC_PER_SEC;
+    }
+
+    netdata_mutex_lock(&statvfs_pool.mutex);
+    while(statvfs_pool.waiting && !netdata_exit)
+        if(pthread_cond_timedwait(&statvfs_pool.cond_done, &statvfs_pool.mutex, &deadline) == ETIMEDOUT)
+            break;
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+}
+
+// stop waiting for the calls that did not return in time
+static inline void statvfs_wait_done(struct mount_point_metadata *m) {
+    netdata_mutex_lock(&statvfs_pool.mutex);
+    if(m->statvfs_waited) {
+        m->statvfs_waited = 0;
+        statvfs_pool.waiting--;
+    }
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+}
+
+// get the result of the last statvfs() of a mount point
+// returns 1 when there is a new result, 0 otherwise
+static inline int statvfs_result(struct mountinfo *mi, struct mount_point_metadata *m, struct statvfs *buff, usec_t now_ut) {
+    netdata_mutex_lock(&statvfs_pool.mutex);
+
+    if(m->statvfs_state != STATVFS_DONE) {
+        int running = (m->statvfs_state != STATVFS_IDLE);
+        usec_t started_ut = m->statvfs_started_ut;
+        netdata_mutex_unlock(&statvfs_pool.mutex);
+
+        if(running && !m->statvfs_slow && now_ut - started_ut > statvfs_pool.timeout_ut) {
+            m->statvfs_slow = 1;
+            error("DISKSPACE: statvfs() of mount point '%s' (disk '%s', filesystem '%s') did not return in %llu ms. It will be skipped until it returns."
+                  , mi->mount_point
+                  , mi->persistent_id
+                  , mi->filesystem?mi->filesystem:""
+                  , statvfs_pool.timeout_ut / USEC_PER_MS
+            );
+        }
+
+        return 0;
+    }
+
+    m->statvfs_state = STATVFS_IDLE;
+    *buff = m->statvfs;
+    int err = m->statvfs_errno;
+    usec_t duration_ut = m->statvfs_duration_ut;
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+
+    if(unlikely(duration_ut > statvfs_pool.timeout_ut)) {
+        // it is slow - back off
+        m->statvfs_backoff_ut = (m->statvfs_backoff_ut) ? m->statvfs_backoff_ut * 2 : statvfs_pool.timeout_ut * 2;
+        if(m->statvfs_backoff_ut > DISKSPACE_STATVFS_BACKOFF_MAX_SEC * USEC_PER_SEC)
+            m->statvfs_backoff_ut = DISKSPACE_STATVFS_BACKOFF_MAX_SEC * USEC_PER_SEC;
+
+        m->statvfs_next_ut = now_ut + m->statvfs_backoff_ut;
+        m->statvfs_slow = 1;
+    }
+    else if(unlikely(m->statvfs_slow)) {
+        info("DISKSPACE: statvfs() of mount point '%s' returned in time again.", mi->mount_point);
+        m->statvfs_slow = 0;
+        m->statvfs_backoff_ut = 0;
+        m->statvfs_next_ut = 0;
+    }
+
+    if(unlikely(err)) {
+        if(!m->shown_error) {
+            errno = err;
+            error("DISKSPACE: failed to statvfs() mount point '%s' (disk '%s', filesystem '%s', root '%s')"
+                  , mi->mount_point
+                  , mi->persistent_id
+                  , mi->filesystem?mi->filesystem:""
+                  , mi->root?mi->root:""
+            );
+            m->shown_error = 1;
+        }
+        return 0;
+    }
+    m->shown_error = 0;
+
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+
 #define rrdset_obsolete_and_pointer_null(st) do { if(st) { rrdset_is_obsolete(st); (st) = NULL; } } while(st)
 
 int mount_point_cleanup(void *entry, void *data) {
@@ -83,8 +356,9 @@ int mount_point_cleanup(void *entry, void *data) {
     return 0;
 }
 
-static inline void do_disk_space_stats(struct mountinfo *mi, int update_every) {
-    const char *family = mi->mount_point;
+// find the settings of a mount point
+// returns NULL when it should not be collected
+static inline struct mount_point_metadata *disk_space_metadata(struct mountinfo *mi) {
     const char *disk = mi->persistent_id;
 
     static SIMPLE_PATTERN *excluded_mountpoints = NULL;
@@ -171,6 +445,14 @@ static inline void do_disk_space_stats(struct mountinfo *mi, int update_every) {
 
                 .collected = 0,
 
+                .mount_point = strdupz(mi->mount_point),
+                .statvfs_state = STATVFS_IDLE,
+                .statvfs_waited = 0,
+                .statvfs_slow = 0,
+                .statvfs_backoff_ut = 0,
+                .statvfs_next_ut = 0,
+                .statvfs_next = NULL,
+
                 .st_space = NULL,
                 .rd_space_avail = NULL,
                 .rd_space_used = NULL,
@@ -188,25 +470,18 @@ static inline void do_disk_space_stats(struct mountinfo *mi, int update_every) {
     m->updated = 1;
 
     if(unlikely(m->do_space == CONFIG_BOOLEAN_NO && m->do_inodes == CONFIG_BOOLEAN_NO))
-        return;
+        return NULL;
 
     if(unlikely(mi->flags & MOUNTINFO_READONLY && !m->collected && m->do_space != CONFIG_BOOLEAN_YES && m->do_inodes != CONFIG_BOOLEAN_YES))
-        return;
+        return NULL;
 
-    struct statvfs buff_statvfs;
-    if (statvfs(mi->mount_point, &buff_statvfs) < 0) {
-        if(!m->shown_error) {
-            error("DISKSPACE: failed to statvfs() mount point '%s' (disk '%s', filesystem '%s', root '%s')"
-                  , mi->mount_point
-                  , disk
-                  , mi->filesystem?mi->filesystem:""
-                  , mi->root?mi->root:""
-            );
-            m->shown_error = 1;
-        }
-        return;
-    }
-    m->shown_error = 0;
+    return m;
+}
+
+static inline void do_disk_space_stats(struct mountinfo *mi, struct mount_point_metadata *m, struct statvfs *buff, int update_every) {
+    const char *family = mi->mount_point;
+    const char *disk = mi->persistent_id;
+    struct statvfs buff_statvfs = *buff;
 
     // logic found at get_fs_usage() in coreutils
     unsigned long bsize = (buff_statvfs.f_frsize) ? buff_statvfs.f_frsize : buff_statvfs.f_bsize;
@@ -339,6 +614,16 @@ static void diskspace_main_cleanup(void *ptr) {
 
     info("cleaning up...");
 
+    // wake up the idle statvfs threads, so that they exit
+    netdata_mutex_lock(&statvfs_pool.mutex);
+    pthread_cond_broadcast(&statvfs_pool.cond_queued);
+    netdata_mutex_unlock(&statvfs_pool.mutex);
+
+    if(mountinfo_poll_fd != -1) {
+        close(mountinfo_poll_fd);
+        mountinfo_poll_fd = -1;
+    }
+
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
 
@@ -357,6 +642,22 @@ void *diskspace_main(void *ptr) {
     if(check_for_new_mountpoints_every < update_every)
         check_for_new_mountpoints_every = update_every;
 
+    long long timeout_ms = config_get_number(CONFIG_SECTION_DISKSPACE, "statvfs timeout ms", (long long)(statvfs_pool.timeout_ut / USEC_PER_MS));
+    if(timeout_ms < 1) timeout_ms = 1;
+    statvfs_pool.timeout_ut = (usec_t)timeout_ms * USEC_PER_MS;
+
+    int statvfs_threads = (int)config_get_number(CONFIG_SECTION_DISKSPACE, "statvfs threads", 2);
+    if(statvfs_threads > 0)
+        statvfs_pool_init(statvfs_threads);
+
+    mountinfo_poll_open();
+
+    struct disk_space_request {
+        struct mountinfo *mi;
+        struct mount_point_metadata *m;
+    } *requests = NULL;
+    size_t requests_size = 0;
+
     struct rusage thread;
 
     usec_t duration = 0;
@@ -379,13 +680,44 @@ void *diskspace_main(void *ptr) {
         // --------------------------------------------------------------------------
         // disk space metrics
 
+        usec_t started_ut = now_monotonic_usec();
+        size_t requests_used = 0, r;
+
         struct mountinfo *mi;
         for(mi = disk_mountinfo_root; mi; mi = mi->next) {
 
             if(unlikely(mi->flags & (MOUNTINFO_IS_DUMMY | MOUNTINFO_IS_BIND)))
                 continue;
 
-            do_disk_space_stats(mi, update_every);
+            struct mount_point_metadata *m = disk_space_metadata(mi);
+            if(unlikely(!m))
+                continue;
+
+            if(unlikely(requests_used == requests_size)) {
+                requests_size = (requests_size) ? requests_size * 2 : 64;
+                requests = reallocz(requests, requests_size * sizeof(struct disk_space_request));
+            }
+
+            requests[requests_used].mi = mi;
+            requests[requests_used].m = m;
+            requests_used++;
+
+            statvfs_queue(m, started_ut);
+        }
+
+        if(likely(statvfs_pool.threads))
+            statvfs_wait(started_ut);
+
+        usec_t now_ut = now_monotonic_usec();
+        for(r = 0; r < requests_used ; r++) {
+            struct statvfs buff;
+
+            if(likely(statvfs_pool.threads))
+                statvfs_wait_done(requests[r].m);
+
+            if(likely(statvfs_result(requests[r].mi, requests[r].m, &buff, now_ut)))
+                do_disk_space_stats(requests[r].mi, requests[r].m, &buff, update_every);
+
             if(unlikely(netdata_exit)) break;
         }
 
@@ -460,6 +792,8 @@ void *diskspace_main(void *ptr) {
         }
     }
 
+    freez(requests);
+
     netdata_thread_cleanup_pop(1);
     return NULL;
 }
@@ -20,6 +20,10 @@ struct cgroup_network_interface {
     int do_drops;
     int do_events;
 
+    int physical;           // -1 until it is matched against the physical interfaces pattern
+
+    struct ifaddrs *ifa;    // the AF_LINK address of the interface, during an iteration
+
     // charts and dimensions
 
     RRDSET *st_bandwidth;
@@ -123,6 +127,7 @@ static struct cgroup_network_interface *get_network_interface(const char *name)
     ifm->name = strdupz(name);
     ifm->hash = simple_hash(ifm->name);
     ifm->len = strlen(ifm->name);
+    ifm->physical = -1;
     network_interfaces_added++;
 
     // link it to the end
@@ -224,22 +229,54 @@ int do_getifaddrs(int update_every, usec_t dt) {
                 u_long  ift_opackets;
                 u_long  ift_imcasts;
                 u_long  ift_omcasts;
-            } iftot = {0, 0, 0, 0, 0, 0};
+            } iftot = {0, 0, 0, 0, 0, 0}, iftot_ipv4 = {0, 0, 0, 0, 0, 0}, iftot_ipv6 = {0, 0, 0, 0, 0, 0};
 
             // --------------------------------------------------------------------
+            // a single pass over all the addresses, to find the interfaces and the totals
 
-            if (likely(do_bandwidth_net)) {
+            network_interfaces_found = 0;
 
-                iftot.ift_ibytes = iftot.ift_obytes = 0;
-                for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
-                    if (ifa->ifa_addr->sa_family != AF_LINK)
-                        continue;
-                    if (!simple_pattern_matches(physical_interfaces, ifa->ifa_name))
-                        continue;
-                    iftot.ift_ibytes += IFA_DATA(ibytes);
-                    iftot.ift_obytes += IFA_DATA(obytes);
+            for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
+                switch (ifa->ifa_addr->sa_family) {
+                    case AF_INET:
+                        iftot_ipv4.ift_ibytes += IFA_DATA(ibytes);
+                        iftot_ipv4.ift_obytes += IFA_DATA(obytes);
+                        break;
+
+                    case AF_INET6:
+                        iftot_ipv6.ift_ibytes += IFA_DATA(ibytes);
+                        iftot_ipv6.ift_obytes += IFA_DATA(obytes);
+                        break;
+
+                    case AF_LINK: {
+                        struct cgroup_network_interface *ifm = get_network_interface(ifa->ifa_name);
+                        ifm->updated = 1;
+                        ifm->ifa = ifa;
+                        network_interfaces_found++;
+
+                        // the pattern is matched once per interface, not on every iteration
+                        if (unlikely(ifm->physical == -1))
+                            ifm->physical = simple_pattern_matches(physical_interfaces, ifa->ifa_name);
+
+                        if (ifm->physical) {
+                            iftot.ift_ibytes += IFA_DATA(ibytes);
+                            iftot.ift_obytes += IFA_DATA(obytes);
+                            iftot.ift_ipackets += IFA_DATA(ipackets);
+                            iftot.ift_opackets += IFA_DATA(opackets);
+                            iftot.ift_imcasts += IFA_DATA(imcasts);
+                            iftot.ift_omcasts += IFA_DATA(omcasts);
+                        }
+                        break;
+                    }
+
+                    default:
+                        break;
                 }
+            }
 
+            // --------------------------------------------------------------------
+
+            if (likely(do_bandwidth_net)) {
                 static RRDSET *st = NULL;
                 static RRDDIM *rd_in = NULL, *rd_out = NULL;
 
@@ -271,19 +308,6 @@ int do_getifaddrs(int update_every, usec_t dt) {
             // --------------------------------------------------------------------
 
             if (likely(do_packets_net)) {
-
-                iftot.ift_ipackets = iftot.ift_opackets = iftot.ift_imcasts = iftot.ift_omcasts = 0;
-                for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
-                    if (ifa->ifa_addr->sa_family != AF_LINK)
-                        continue;
-                    if (!simple_pattern_matches(physical_interfaces, ifa->ifa_name))
-                        continue;
-                    iftot.ift_ipackets += IFA_DATA(ipackets);
-                    iftot.ift_opackets += IFA_DATA(opackets);
-                    iftot.ift_imcasts += IFA_DATA(imcasts);
-                    iftot.ift_omcasts += IFA_DATA(omcasts);
-                }
-
                 static RRDSET *st = NULL;
                 static RRDDIM *rd_packets_in = NULL, *rd_packets_out = NULL, *rd_packets_m_in = NULL, *rd_packets_m_out = NULL;
 
@@ -321,14 +345,6 @@ int do_getifaddrs(int update_every, usec_t dt) {
             // --------------------------------------------------------------------
 
             if (likely(do_bandwidth_ipv4)) {
-                iftot.ift_ibytes = iftot.ift_obytes = 0;
-                for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
-                    if (ifa->ifa_addr->sa_family != AF_INET)
-                        continue;
-                    iftot.ift_ibytes += IFA_DATA(ibytes);
-                    iftot.ift_obytes += IFA_DATA(obytes);
-                }
-
                 static RRDSET *st = NULL;
                 static RRDDIM *rd_in = NULL, *rd_out = NULL;
 
@@ -352,22 +368,14 @@ int do_getifaddrs(int update_every, usec_t dt) {
                 } else
                     rrdset_next(st);
 
-                rrddim_set_by_pointer(st, rd_in,  iftot.ift_ibytes);
-                rrddim_set_by_pointer(st, rd_out, iftot.ift_obytes);
+                rrddim_set_by_pointer(st, rd_in,  iftot_ipv4.ift_ibytes);
+                rrddim_set_by_pointer(st, rd_out, iftot_ipv4.ift_obytes);
                 rrdset_done(st);
             }
 
             // --------------------------------------------------------------------
 
             if (likely(do_bandwidth_ipv6)) {
-                iftot.ift_ibytes = iftot.ift_obytes = 0;
-                for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
-                    if (ifa->ifa_addr->sa_family != AF_INET6)
-                        continue;
-                    iftot.ift_ibytes += IFA_DATA(ibytes);
-                    iftot.ift_obytes += IFA_DATA(obytes);
-                }
-
                 static RRDSET *st = NULL;
                 static RRDDIM *rd_in = NULL, *rd_out = NULL;
 
@@ -391,22 +399,21 @@ int do_getifaddrs(int update_every, usec_t dt) {
                 } else
                     rrdset_next(st);
 
-                rrddim_set_by_pointer(st, rd_in,  iftot.ift_ibytes);
-                rrddim_set_by_pointer(st, rd_out, iftot.ift_obytes);
+                rrddim_set_by_pointer(st, rd_in,  iftot_ipv6.ift_ibytes);
+                rrddim_set_by_pointer(st, rd_out, iftot_ipv6.ift_obytes);
                 rrdset_done(st);
             }
 
             // --------------------------------------------------------------------
 
-            network_interfaces_found = 0;
-
-            for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
-                if (ifa->ifa_addr->sa_family != AF_LINK)
+            struct cgroup_network_interface *ifm;
+            for (ifm = network_interfaces_root; ifm; ifm = ifm->next) {
+                if (unlikely(!ifm->ifa))
                     continue;
 
-                struct cgroup_network_interface *ifm = get_network_interface(ifa->ifa_name);
-                ifm->updated = 1;
-                network_interfaces_found++;
+                // the interfaces found by the pass above
+                ifa = ifm->ifa;
+                ifm->ifa = NULL;
 
                 if (unlikely(!ifm->configured)) {
                     char var_name[4096 + 1];
@@ -109,12 +109,24 @@ int do_kstat_zfs_misc_arcstats(int update_every, usec_t dt) {
         // int arc_meta_min[5];
         // int arc_need_free[5];
         // int arc_sys_free[5];
+        int l2_size[5];
     } mibs;
 
     arcstats.l2exist = -1;
 
-    if(unlikely(sysctlbyname("kstat.zfs.misc.arcstats.l2_size", &l2_size, &uint64_t_size, NULL, 0)))
+    // without logging errors - this is how we find if ZFS is loaded
+    if(unlikely(!mibs.l2_size[0])) {
+        size_t l2_size_miblen = 5;
+        if(unlikely(sysctlnametomib("kstat.zfs.misc.arcstats.l2_size", mibs.l2_size, &l2_size_miblen))) {
+            mibs.l2_size[0] = 0;
+            return 0;
+        }
+    }
+
+    if(unlikely(sysctl(mibs.l2_size, 5, &l2_size, &uint64_t_size, NULL, 0))) {
+        mibs.l2_size[0] = 0;
         return 0;
+    }
 
     if(likely(l2_size))
         arcstats.l2exist = 1;
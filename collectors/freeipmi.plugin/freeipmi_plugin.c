@@ -291,9 +291,17 @@ _get_sensor_type_string (int sensor_type)
 static int debug = 0;
 
 static int netdata_update_every = 5; // this is the minimum update frequency
+static int netdata_sel_update_every = 60; // the SEL is slow to read, so it is read less frequently
 static int netdata_priority = 90000;
 static int netdata_do_sel = 1;
 
+// the sensors are collected by the poller thread, while the main thread
+// sends the last collected values to netdata on schedule - so the charts
+// do not have gaps when a sweep of the BMC takes longer than update every.
+// netdata_collected_mutex protects the sensors list and the counters below.
+static netdata_mutex_t netdata_collected_mutex = NETDATA_MUTEX_INITIALIZER;
+static size_t netdata_sweeps_completed = 0;
+
 static size_t netdata_sensors_updated = 0;
 static size_t netdata_sensors_collected = 0;
 static size_t netdata_sel_events = 0;
@@ -301,6 +309,16 @@ static size_t netdata_sensors_states_nominal = 0;
 static size_t netdata_sensors_states_warning = 0;
 static size_t netdata_sensors_states_critical = 0;
 
+// the counters of the running sweep - used only by the poller
+static struct {
+    size_t id;
+    size_t sensors_collected;
+    size_t sel_events;
+    size_t sensors_states_nominal;
+    size_t sensors_states_warning;
+    size_t sensors_states_critical;
+} netdata_sweep = { 0, 0, 0, 0, 0, 0 };
+
 struct sensor {
     int record_id;
     int sensor_number;
@@ -320,21 +338,49 @@ struct sensor {
     int ignore;
     int exposed;
     int updated;
+    size_t sweep;       // the last sweep that collected this sensor
     struct sensor *next;
 } *sensors_root = NULL;
 
-static void netdata_mark_as_not_updated() {
+static void netdata_mark_as_not_sent() {
     struct sensor *sn;
     for(sn = sensors_root; sn ;sn = sn->next)
-        sn->updated = sn->sent = 0;
+        sn->sent = 0;
 
     netdata_sensors_updated = 0;
-    netdata_sensors_collected = 0;
-    netdata_sel_events = 0;
+}
+
+static void netdata_sweep_start(int do_sel) {
+    netdata_sweep.id++;
+
+    netdata_sweep.sensors_collected = 0;
+    netdata_sweep.sensors_states_nominal = 0;
+    netdata_sweep.sensors_states_warning = 0;
+    netdata_sweep.sensors_states_critical = 0;
+
+    if(do_sel)
+        netdata_sweep.sel_events = 0;
+}
+
+static void netdata_sweep_commit(int do_sel) {
+    netdata_mutex_lock(&netdata_collected_mutex);
+
+    // the sensors not found by this sweep are not sent any more
+    struct sensor *sn;
+    for(sn = sensors_root; sn ;sn = sn->next)
+        sn->updated = (sn->sweep == netdata_sweep.id);
+
+    netdata_sensors_collected = netdata_sweep.sensors_collected;
+    netdata_sensors_states_nominal = netdata_sweep.sensors_states_nominal;
+    netdata_sensors_states_warning = netdata_sweep.sensors_states_warning;
+    netdata_sensors_states_critical = netdata_sweep.sensors_states_critical;
 
-    netdata_sensors_states_nominal = 0;
-    netdata_sensors_states_warning = 0;
-    netdata_sensors_states_critical = 0;
+    if(do_sel)
+        netdata_sel_events = netdata_sweep.sel_events;
+
+    netdata_sweeps_completed++;
+
+    netdata_mutex_unlock(&netdata_collected_mutex);
 }
 
 static void send_chart_to_netdata_for_units(int units) {
@@ -737,19 +783,22 @@ static void netdata_get_sensor(
         case IPMI_MONITORING_SENSOR_READING_TYPE_UNSIGNED_INTEGER8_BOOL:
             sn->sensor_reading.bool_value = *((uint8_t *)sensor_reading);
             sn->updated = 1;
-            netdata_sensors_collected++;
+            sn->sweep = netdata_sweep.id;
+            netdata_sweep.sensors_collected++;
             break;
 
         case IPMI_MONITORING_SENSOR_READING_TYPE_UNSIGNED_INTEGER32:
             sn->sensor_reading.uint32_value = *((uint32_t *)sensor_reading);
             sn->updated = 1;
-            netdata_sensors_collected++;
+            sn->sweep = netdata_sweep.id;
+            netdata_sweep.sensors_collected++;
             break;
 
         case IPMI_MONITORING_SENSOR_READING_TYPE_DOUBLE:
             sn->sensor_reading.double_value = *((double *)sensor_reading);
             sn->updated = 1;
-            netdata_sensors_collected++;
+            sn->sweep = netdata_sweep.id;
+            netdata_sweep.sensors_collected++;
             break;
 
         default:
@@ -766,15 +815,15 @@ static void netdata_get_sensor(
 
     switch(sensor_state) {
         case IPMI_MONITORING_STATE_NOMINAL:
-            netdata_sensors_states_nominal++;
+            netdata_sweep.sensors_states_nominal++;
             break;
 
         case IPMI_MONITORING_STATE_WARNING:
-            netdata_sensors_states_warning++;
+            netdata_sweep.sensors_states_warning++;
             break;
 
         case IPMI_MONITORING_STATE_CRITICAL:
-            netdata_sensors_states_critical++;
+            netdata_sweep.sensors_states_critical++;
             break;
 
         default:
@@ -791,7 +840,7 @@ static void netdata_get_sel(
     (void)record_type_class;
     (void)sel_state;
 
-    netdata_sel_events++;
+    netdata_sweep.sel_events++;
 }
 
 
@@ -1036,6 +1085,7 @@ _ipmimonitoring_sensors (struct ipmi_monitoring_ipmi_config *ipmi_config)
         }
 #endif // NETDATA_COMMENTED
 
+        netdata_mutex_lock(&netdata_collected_mutex);
         netdata_get_sensor(
                 record_id
                 , sensor_number
@@ -1046,6 +1096,7 @@ _ipmimonitoring_sensors (struct ipmi_monitoring_ipmi_config *ipmi_config)
                 , sensor_name
                 , sensor_reading
         );
+        netdata_mutex_unlock(&netdata_collected_mutex);
 
 #ifdef NETDATA_COMMENTED
         if (!strlen (sensor_name))
@@ -1578,6 +1629,45 @@ int ipmi_detect_speed_secs(struct ipmi_monitoring_ipmi_config *ipmi_config) {
     return (int)(( total * 2 / checks / 1000000 ) + 1);
 }
 
+void *ipmi_poller_main(void *ptr) {
+    struct ipmi_monitoring_ipmi_config *ipmi_config = (struct ipmi_monitoring_ipmi_config *)ptr;
+
+    usec_t step = netdata_update_every * USEC_PER_SEC;
+    usec_t sel_step = netdata_sel_update_every * USEC_PER_SEC;
+    usec_t sel_last_ut = 0;
+
+    heartbeat_t hb;
+    heartbeat_init(&hb);
+    for(;;) {
+        // a sweep longer than step just skips the next one
+        heartbeat_next(&hb, step);
+
+        usec_t now_ut = now_monotonic_usec();
+        int do_sel = netdata_do_sel && (!sel_last_ut || now_ut - sel_last_ut >= sel_step);
+
+        netdata_sweep_start(do_sel);
+
+        if(debug) fprintf(stderr, "freeipmi.plugin: calling _ipmimonitoring_sensors()\n");
+        errno = 0;
+        if(_ipmimonitoring_sensors(ipmi_config) < 0)
+            fatal("data collection failed.");
+
+        if(do_sel) {
+            if(debug) fprintf(stderr, "freeipmi.plugin: calling _ipmimonitoring_sel()\n");
+            if(_ipmimonitoring_sel(ipmi_config) < 0)
+                fatal("SEL collection failed.");
+
+            sel_last_ut = now_ut;
+        }
+
+        netdata_sweep_commit(do_sel);
+
+        if(debug) fprintf(stderr, "freeipmi.plugin: sweep %zu completed in %llu usec\n", netdata_sweep.id, now_monotonic_usec() - now_ut);
+    }
+
+    return NULL;
+}
+
 int parse_inband_driver_type (const char *str)
 {
     assert (str);
@@ -1636,6 +1726,23 @@ int main (int argc, char **argv) {
     error_log_throttle_period = 3600;
 
 
+    // ------------------------------------------------------------------------
+    // keep the SDR cache in the netdata cache directory, so that it survives
+    // restarts and reboots - libipmimonitoring validates it against the
+    // SDR repository of the BMC and rebuilds it when the SDR changes
+
+    char *cache_dir = getenv("NETDATA_CACHE_DIR");
+    if(cache_dir && *cache_dir) {
+        char filename[FILENAME_MAX + 1];
+        snprintfz(filename, FILENAME_MAX, "%s/freeipmi-sdr-cache", cache_dir);
+
+        if(mkdir(filename, 0770) == 0 || errno == EEXIST)
+            sdr_cache_directory = strdupz(filename);
+        else
+            error("cannot create directory '%s'. Using '%s' for the SDR cache.", filename, sdr_cache_directory);
+    }
+
+
     // ------------------------------------------------------------------------
     // parse command line parameters
 
@@ -1664,6 +1771,12 @@ int main (int argc, char **argv) {
             netdata_do_sel = 0;
             continue;
         }
+        else if(i < argc && strcmp("sel-freq", argv[i]) == 0) {
+            int n = str2i(argv[++i]);
+            if(n > 0 && n < 86400) netdata_sel_update_every = n;
+            if(debug) fprintf(stderr, "freeipmi.plugin: SEL collection frequency set to %d seconds\n", netdata_sel_update_every);
+            continue;
+        }
         else if(strcmp("-h", argv[i]) == 0 || strcmp("--help", argv[i]) == 0) {
             fprintf(stderr,
                     "\n"
@@ -1686,6 +1799,9 @@ int main (int argc, char **argv) {
                     "  no-sel                  enable/disable SEL collection\n"
                     "                          default: %s\n"
                     "\n"
+                    "  sel-freq SECONDS        SEL collection frequency\n"
+                    "                          default: %d\n"
+                    "\n"
                     "  hostname HOST\n"
                     "  username USER\n"
                     "  password PASS           connect to remote IPMI host\n"
@@ -1726,6 +1842,7 @@ int main (int argc, char **argv) {
                     , VERSION
                     , netdata_update_every
                     , netdata_do_sel?"enabled":"disabled"
+                    , netdata_sel_update_every
                     , sdr_cache_directory?sdr_cache_directory:"system default"
                     , sensor_config_file?sensor_config_file:"system default"
             );
@@ -1823,6 +1940,9 @@ int main (int argc, char **argv) {
         netdata_update_every = freq;
     }
 
+    if(netdata_sel_update_every < netdata_update_every)
+        netdata_sel_update_every = netdata_update_every;
+
 
     // ------------------------------------------------------------------------
     // the main loop
@@ -1834,11 +1954,17 @@ int main (int argc, char **argv) {
     size_t iteration = 0;
     usec_t step = netdata_update_every * USEC_PER_SEC;
 
+    netdata_thread_t poller_thread;
+    if(netdata_thread_create(&poller_thread, "IPMI_POLLER", NETDATA_THREAD_OPTION_DONT_LOG, ipmi_poller_main, &ipmi_config))
+        fatal("cannot create the IPMI poller thread.");
+
     heartbeat_t hb;
     heartbeat_init(&hb);
     for(iteration = 0; 1 ; iteration++) {
         usec_t dt = heartbeat_next(&hb, step);
 
+        netdata_mutex_lock(&netdata_collected_mutex);
+
         if(debug && iteration)
             fprintf(stderr, "freeipmi.plugin: iteration %zu, dt %llu usec, sensors collected %zu, sensors sent to netdata %zu \n"
                     , iteration
@@ -1847,14 +1973,15 @@ int main (int argc, char **argv) {
                     , netdata_sensors_updated
             );
 
-        netdata_mark_as_not_updated();
+        // send the values of the last sweep, even if the poller is still running the next one
+        if(likely(netdata_sweeps_completed)) {
+            netdata_mark_as_not_sent();
 
-        if(debug) fprintf(stderr, "freeipmi.plugin: calling ipmi_collect_data()\n");
-        if(ipmi_collect_data(&ipmi_config) < 0)
-            fatal("data collection failed.");
+            if(debug) fprintf(stderr, "freeipmi.plugin: calling send_metrics_to_netdata()\n");
+            send_metrics_to_netdata();
+        }
 
-        if(debug) fprintf(stderr, "freeipmi.plugin: calling send_metrics_to_netdata()\n");
-        send_metrics_to_netdata();
+        netdata_mutex_unlock(&netdata_collected_mutex);
         fflush(stdout);
 
         // restart check (14400 seconds)
@@ -4,12 +4,232 @@
 
 #define CPU_IDLEJITTER_SLEEP_TIME_MS 20
 
+// ----------------------------------------------------------------------------
+// log-scale histogram of the sleep overshoot
+//
+// values below JITTER_HISTOGRAM_SUB_BUCKETS microseconds get a bucket each,
+// every power of 2 above that is split into JITTER_HISTOGRAM_SUB_BUCKETS
+// linear buckets, so the error of a percentile is at most 1/8 of its value
+
+#define JITTER_HISTOGRAM_SUB_BITS 3
+#define JITTER_HISTOGRAM_SUB_BUCKETS (1 << JITTER_HISTOGRAM_SUB_BITS)
+#define JITTER_HISTOGRAM_MAX_BITS 32
+#define JITTER_HISTOGRAM_BUCKETS ((JITTER_HISTOGRAM_MAX_BITS - JITTER_HISTOGRAM_SUB_BITS + 1) * JITTER_HISTOGRAM_SUB_BUCKETS)
+
+struct jitter_histogram {
+    size_t count;
+    usec_t max;
+    size_t buckets[JITTER_HISTOGRAM_BUCKETS];
+};
+
+static inline size_t jitter_histogram_bucket(usec_t value) {
+    if(value < JITTER_HISTOGRAM_SUB_BUCKETS)
+        return (size_t)value;
+
+    size_t bits = 63 - __builtin_clzll(value);
+    if(unlikely(bits >= JITTER_HISTOGRAM_MAX_BITS))
+        return JITTER_HISTOGRAM_BUCKETS - 1;
+
+    size_t shift = bits - JITTER_HISTOGRAM_SUB_BITS;
+    return (shift + 1) * JITTER_HISTOGRAM_SUB_BUCKETS + (size_t)((value >> shift) & (JITTER_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+// the highest value that falls in a bucket
+static inline usec_t jitter_histogram_bucket_max(size_t bucket) {
+    if(bucket < JITTER_HISTOGRAM_SUB_BUCKETS)
+        return (usec_t)bucket;
+
+    size_t shift = bucket / JITTER_HISTOGRAM_SUB_BUCKETS - 1;
+    usec_t mantissa = JITTER_HISTOGRAM_SUB_BUCKETS + bucket % JITTER_HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+static inline void jitter_histogram_add(struct jitter_histogram *h, usec_t value) {
+    h->buckets[jitter_histogram_bucket(value)]++;
+    h->count++;
+    if(value > h->max) h->max = value;
+}
+
+// permille: 500 = p50, 990 = p99, 999 = p999
+static usec_t jitter_histogram_percentile(struct jitter_histogram *h, size_t permille) {
+    if(unlikely(!h->count))
+        return 0;
+
+    size_t wanted = (h->count * permille + 999) / 1000, seen = 0, i;
+    for(i = 0; i < JITTER_HISTOGRAM_BUCKETS ; i++) {
+        seen += h->buckets[i];
+        if(seen >= wanted) {
+            usec_t value = jitter_histogram_bucket_max(i);
+            return (value < h->max) ? value : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+// ----------------------------------------------------------------------------
+// percentiles chart
+
+static struct {
+    const char *name;
+    size_t permille;
+} jitter_percentiles[] = {
+        { "p50",  500 },
+        { "p90",  900 },
+        { "p99",  990 },
+        { "p999", 999 },
+        { NULL,   0   }
+};
+
+struct jitter_chart {
+    RRDSET *st;
+    RRDDIM *rd_percentiles[sizeof(jitter_percentiles) / sizeof(jitter_percentiles[0])];
+    RRDDIM *rd_max;
+};
+
+static void jitter_chart_update(struct jitter_chart *c, struct jitter_histogram *h, const char *type, const char *id, const char *family, const char *context, const char *title, long priority) {
+    if(unlikely(!c->st)) {
+        c->st = rrdset_create_localhost(
+                type
+                , id
+                , NULL
+                , family
+                , context
+                , title
+                , "microseconds"
+                , "idlejitter.plugin"
+                , NULL
+                , priority
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+
+        size_t i;
+        for(i = 0; jitter_percentiles[i].name ; i++)
+            c->rd_percentiles[i] = rrddim_add(c->st, jitter_percentiles[i].name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+
+        c->rd_max = rrddim_add(c->st, "max", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+    }
+    else
+        rrdset_next(c->st);
+
+    size_t i;
+    for(i = 0; jitter_percentiles[i].name ; i++)
+        rrddim_set_by_pointer(c->st, c->rd_percentiles[i], (collected_number)jitter_histogram_percentile(h, jitter_percentiles[i].permille));
+
+    rrddim_set_by_pointer(c->st, c->rd_max, (collected_number)h->max);
+    rrdset_done(c->st);
+}
+
+// ----------------------------------------------------------------------------
+// per CPU measurement threads
+
+struct jitter_cpu {
+    int cpu;
+    int running;
+    netdata_thread_t thread;
+    netdata_mutex_t mutex;
+    struct jitter_histogram histogram;
+    struct jitter_chart chart;
+};
+
+static struct jitter_cpu *jitter_cpus = NULL;
+static size_t jitter_cpus_count = 0;
+static usec_t jitter_sleep_ut = CPU_IDLEJITTER_SLEEP_TIME_MS * USEC_PER_MS;
+
+static void *cpuidlejitter_cpu_main(void *ptr) {
+    struct jitter_cpu *jc = (struct jitter_cpu *)ptr;
+
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(jc->cpu, &cpu_set);
+
+    if(unlikely(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set)))
+        error("IDLEJITTER: cannot set CPU affinity for core %d, its measurements will not be pinned to it", jc->cpu);
+#endif
+
+    struct timeval before, after;
+
+    while(!netdata_exit) {
+        now_monotonic_timeval(&before);
+        sleep_usec(jitter_sleep_ut);
+        now_monotonic_timeval(&after);
+
+        usec_t error = dt_usec(&after, &before) - jitter_sleep_ut;
+
+        netdata_mutex_lock(&jc->mutex);
+        jitter_histogram_add(&jc->histogram, error);
+        netdata_mutex_unlock(&jc->mutex);
+    }
+
+    return NULL;
+}
+
+static void cpuidlejitter_cpus_start(void) {
+    long cpus = get_system_cpus();
+    if(cpus < 1) cpus = 1;
+
+    jitter_cpus = callocz((size_t)cpus, sizeof(struct jitter_cpu));
+
+    long i;
+    for(i = 0; i < cpus ; i++) {
+        struct jitter_cpu *jc = &jitter_cpus[jitter_cpus_count];
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+
+        jc->cpu = (int)i;
+        netdata_mutex_init(&jc->mutex);
+
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "IDLEJITTER%ld", i);
+        if(netdata_thread_create(&jc->thread, tag, NETDATA_THREAD_OPTION_JOINABLE | NETDATA_THREAD_OPTION_DONT_LOG, cpuidlejitter_cpu_main, jc)) {
+            error("IDLEJITTER: cannot create the measurement thread for cpu %ld", i);
+            continue;
+        }
+
+        jc->running = 1;
+        jitter_cpus_count++;
+    }
+}
+
+static void cpuidlejitter_cpus_stop(void) {
+    size_t i;
+    for(i = 0; i < jitter_cpus_count ; i++) {
+        if(jitter_cpus[i].running) {
+            netdata_thread_cancel(jitter_cpus[i].thread);
+            netdata_thread_join(jitter_cpus[i].thread, NULL);
+            jitter_cpus[i].running = 0;
+        }
+    }
+}
+
+static void cpuidlejitter_cpus_charts(void) {
+    size_t i;
+    for(i = 0; i < jitter_cpus_count ; i++) {
+        struct jitter_cpu *jc = &jitter_cpus[i];
+        struct jitter_histogram h;
+
+        netdata_mutex_lock(&jc->mutex);
+        memcpy(&h, &jc->histogram, sizeof(h));
+        memset(&jc->histogram, 0, sizeof(jc->histogram));
+        netdata_mutex_unlock(&jc->mutex);
+
+        char id[50 + 1], title[100 + 1];
+        snprintfz(id, 50, "cpu%d_idlejitter", jc->cpu);
+        snprintfz(title, 100, "CPU%d Idle Jitter Percentiles", jc->cpu);
+        jitter_chart_update(&jc->chart, &h, "cpu", id, "idlejitter", "cpu.idlejitter", title, NETDATA_CHART_PRIO_CPU_IDLEJITTER + jc->cpu);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 static void cpuidlejitter_main_cleanup(void *ptr) {
     struct netdata_static_thread *static_thread = (struct netdata_static_thread *)ptr;
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITING;
 
     info("cleaning up...");
 
+    cpuidlejitter_cpus_stop();
+
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
 
@@ -21,6 +241,20 @@ void *cpuidlejitter_main(void *ptr) {
         config_set_number("plugin:idlejitter", "loop time in ms", CPU_IDLEJITTER_SLEEP_TIME_MS);
         sleep_ut = CPU_IDLEJITTER_SLEEP_TIME_MS * USEC_PER_MS;
     }
+    jitter_sleep_ut = sleep_ut;
+
+    int do_histogram = config_get_boolean("plugin:idlejitter", "percentiles", CONFIG_BOOLEAN_NO);
+    int do_per_cpu = config_get_boolean("plugin:idlejitter", "per cpu core", CONFIG_BOOLEAN_NO);
+
+#ifndef __linux__
+    if(do_per_cpu) {
+        info("IDLEJITTER: per cpu core measurements are supported only on Linux, disabling them.");
+        do_per_cpu = 0;
+    }
+#endif
+
+    if(do_per_cpu)
+        cpuidlejitter_cpus_start();
 
     RRDSET *st = rrdset_create_localhost(
             "system"
@@ -40,6 +274,10 @@ void *cpuidlejitter_main(void *ptr) {
     RRDDIM *rd_max = rrddim_add(st, "max", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
     RRDDIM *rd_avg = rrddim_add(st, "average", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
 
+    struct jitter_histogram histogram;
+    struct jitter_chart histogram_chart;
+    memset(&histogram_chart, 0, sizeof(histogram_chart));
+
     usec_t update_every_ut = localhost->rrd_update_every * USEC_PER_SEC;
     struct timeval before, after;
     unsigned long long counter;
@@ -53,6 +291,9 @@ void *cpuidlejitter_main(void *ptr) {
 
         if(netdata_exit) break;
 
+        if(do_histogram)
+            memset(&histogram, 0, sizeof(histogram));
+
         while(elapsed < update_every_ut) {
             now_monotonic_timeval(&before);
             sleep_usec(sleep_ut);
@@ -72,6 +313,9 @@ void *cpuidlejitter_main(void *ptr) {
             if(error > error_max)
                 error_max = error;
 
+            if(do_histogram)
+                jitter_histogram_add(&histogram, error);
+
             iterations++;
         }
 
@@ -83,10 +327,15 @@ void *cpuidlejitter_main(void *ptr) {
             rrddim_set_by_pointer(st, rd_max, error_max);
             rrddim_set_by_pointer(st, rd_avg, error_total / iterations);
             rrdset_done(st);
+
+            if(do_histogram)
+                jitter_chart_update(&histogram_chart, &histogram, "system", "idlejitter_percentiles", "idlejitter", NULL, "CPU Idle Jitter Percentiles", NETDATA_CHART_PRIO_SYSTEM_IDLEJITTER_PERCENTILES);
         }
+
+        if(do_per_cpu)
+            cpuidlejitter_cpus_charts();
     }
 
     netdata_thread_cleanup_pop(1);
     return NULL;
 }
-
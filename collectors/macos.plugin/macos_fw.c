@@ -21,6 +21,128 @@
 #define MEGA_FACTOR 1048576     // 1024 * 1024
 #define GIGA_FACTOR 1073741824  // 1024 * 1024 * 1024
 
+// --------------------------------------------------------------------
+// IOBlockStorageDriver services are looked up once and kept across
+// iterations; IOKit matching notifications tell us when to look again
+
+struct macos_drive {
+    io_registry_entry_t drive;
+    char name[MAXDRIVENAME];
+};
+
+static struct macos_drive *drives = NULL;
+static size_t drives_used = 0, drives_size = 0;
+static int drives_rescan = 1;
+
+static IONotificationPortRef drives_notify_port = NULL;
+static io_iterator_t drives_added = 0, drives_removed = 0;
+
+static void macos_drives_changed(void *refcon, io_iterator_t iterator) {
+    (void)refcon;
+    io_object_t service;
+
+    // the iterator has to be drained to arm the notification again
+    while ((service = IOIteratorNext(iterator)) != 0)
+        IOObjectRelease(service);
+
+    drives_rescan = 1;
+}
+
+static void macos_drives_notifications_init(mach_port_t master_port) {
+    drives_notify_port = IONotificationPortCreate(master_port);
+    if (unlikely(!drives_notify_port)) {
+        error("MACOS: IONotificationPortCreate() failed, disks will be re-scanned on every iteration");
+        return;
+    }
+
+    // IOServiceAddMatchingNotification() consumes the matching dictionary
+    if (unlikely(IOServiceAddMatchingNotification(drives_notify_port, kIOFirstMatchNotification, IOServiceMatching("IOBlockStorageDriver"), macos_drives_changed, NULL, &drives_added)
+                 || IOServiceAddMatchingNotification(drives_notify_port, kIOTerminatedNotification, IOServiceMatching("IOBlockStorageDriver"), macos_drives_changed, NULL, &drives_removed))) {
+        error("MACOS: IOServiceAddMatchingNotification() failed, disks will be re-scanned on every iteration");
+        if (drives_added) IOObjectRelease(drives_added);
+        drives_added = 0;
+        IONotificationPortDestroy(drives_notify_port);
+        drives_notify_port = NULL;
+        return;
+    }
+
+    macos_drives_changed(NULL, drives_added);
+    macos_drives_changed(NULL, drives_removed);
+}
+
+// dispatch the pending notifications, without blocking
+static void macos_drives_notifications_poll(void) {
+    if (unlikely(!drives_notify_port)) {
+        drives_rescan = 1;
+        return;
+    }
+
+    mach_port_t port = IONotificationPortGetMachPort(drives_notify_port);
+    struct {
+        mach_msg_header_t header;
+        uint8_t body[4096];
+    } msg;
+
+    while (mach_msg(&msg.header, MACH_RCV_MSG | MACH_RCV_TIMEOUT, 0, sizeof(msg), port, 0, MACH_PORT_NULL) == MACH_MSG_SUCCESS)
+        IODispatchCalloutFromMessage(NULL, &msg.header, drives_notify_port);
+}
+
+static int macos_drives_scan(mach_port_t master_port) {
+    io_registry_entry_t drive, drive_media;
+    io_iterator_t       drive_list;
+    CFDictionaryRef     properties;
+    CFStringRef         name;
+    size_t              i;
+
+    for (i = 0; i < drives_used; i++)
+        IOObjectRelease(drives[i].drive);
+    drives_used = 0;
+
+    /* Get the list of all drive objects. */
+    if (unlikely(IOServiceGetMatchingServices(master_port, IOServiceMatching("IOBlockStorageDriver"), &drive_list))) {
+        error("MACOS: IOServiceGetMatchingServices() failed");
+        return -1;
+    }
+
+    while ((drive = IOIteratorNext(drive_list)) != 0) {
+        char drive_name[MAXDRIVENAME] = "";
+
+        /* Get drive media object. */
+        if (unlikely(IORegistryEntryGetChildEntry(drive, kIOServicePlane, &drive_media) != KERN_SUCCESS)) {
+            IOObjectRelease(drive);
+            continue;
+        }
+
+        /* Get disk name from the drive media properties. */
+        properties = 0;
+        if (likely(!IORegistryEntryCreateCFProperties(drive_media, (CFMutableDictionaryRef *)&properties, kCFAllocatorDefault, 0))) {
+            if (likely(name = (CFStringRef)CFDictionaryGetValue(properties, CFSTR(kIOBSDNameKey))))
+                CFStringGetCString(name, drive_name, MAXDRIVENAME, kCFStringEncodingUTF8);
+            CFRelease(properties);
+        }
+        IOObjectRelease(drive_media);
+
+        if (unlikely(!*drive_name)) {
+            IOObjectRelease(drive);
+            continue;
+        }
+
+        if (unlikely(drives_used == drives_size)) {
+            drives_size = (drives_size) ? drives_size * 2 : 16;
+            drives = reallocz(drives, drives_size * sizeof(struct macos_drive));
+        }
+
+        // keep the reference IOIteratorNext() gave us, until the next scan
+        drives[drives_used].drive = drive;
+        strncpyz(drives[drives_used].name, drive_name, MAXDRIVENAME - 1);
+        drives_used++;
+    }
+
+    IOObjectRelease(drive_list);
+    drives_rescan = 0;
+    return 0;
+}
+
 int do_macos_iokit(int update_every, usec_t dt) {
     (void)dt;
 
@@ -35,13 +157,11 @@ int do_macos_iokit(int update_every, usec_t dt) {
 
     RRDSET *st;
 
-    mach_port_t         master_port;
-    io_registry_entry_t drive, drive_media;
-    io_iterator_t       drive_list;
+    static mach_port_t  master_port = MACH_PORT_NULL;
+    io_registry_entry_t drive;
     CFDictionaryRef     properties, statistics;
-    CFStringRef         name;
     CFNumberRef         number;
-    kern_return_t       status;
+    size_t              d;
     collected_number    total_disk_reads = 0;
     collected_number    total_disk_writes = 0;
     struct diskstat {
@@ -80,53 +200,40 @@ int do_macos_iokit(int update_every, usec_t dt) {
     struct ifaddrs *ifa, *ifap;
 
     /* Get ports and services for drive statistics. */
-    if (unlikely(IOMasterPort(bootstrap_port, &master_port))) {
-        error("MACOS: IOMasterPort() failed");
-        do_io = 0;
-        error("DISABLED: system.io");
-    /* Get the list of all drive objects. */
-    } else if (unlikely(IOServiceGetMatchingServices(master_port, IOServiceMatching("IOBlockStorageDriver"), &drive_list))) {
-        error("MACOS: IOServiceGetMatchingServices() failed");
-        do_io = 0;
-        error("DISABLED: system.io");
-    } else {
-        while ((drive = IOIteratorNext(drive_list)) != 0) {
+    if (likely(do_io) && unlikely(master_port == MACH_PORT_NULL)) {
+        if (unlikely(IOMasterPort(bootstrap_port, &master_port))) {
+            error("MACOS: IOMasterPort() failed");
+            master_port = MACH_PORT_NULL;
+            do_io = 0;
+            error("DISABLED: system.io");
+        }
+        else
+            macos_drives_notifications_init(master_port);
+    }
+
+    if (likely(do_io)) {
+        macos_drives_notifications_poll();
+
+        if (unlikely(drives_rescan) && unlikely(macos_drives_scan(master_port))) {
+            do_io = 0;
+            error("DISABLED: system.io");
+        }
+    }
+
+    if (likely(do_io)) {
+        for (d = 0; d < drives_used; d++) {
+            drive = drives[d].drive;
             properties = 0;
             statistics = 0;
             number = 0;
             bzero(&diskstat, sizeof(diskstat));
-
-            /* Get drive media object. */
-            status = IORegistryEntryGetChildEntry(drive, kIOServicePlane, &drive_media);
-            if (unlikely(status != KERN_SUCCESS)) {
-                IOObjectRelease(drive);
-                continue;
-            }
-
-            /* Get drive media properties. */
-            if (likely(!IORegistryEntryCreateCFProperties(drive_media, (CFMutableDictionaryRef *)&properties, kCFAllocatorDefault, 0))) {
-                /* Get disk name. */
-                if (likely(name = (CFStringRef)CFDictionaryGetValue(properties, CFSTR(kIOBSDNameKey)))) {
-                    CFStringGetCString(name, diskstat.name, MAXDRIVENAME, kCFStringEncodingUTF8);
-                }
-            }
-
-            /* Release. */
-            CFRelease(properties);
-            IOObjectRelease(drive_media);
-
-            if(unlikely(!diskstat.name || !*diskstat.name)) {
-                IOObjectRelease(drive);
-                continue;
-            }
+            strncpyz(diskstat.name, drives[d].name, MAXDRIVENAME - 1);
 
             /* Obtain the properties for this drive object. */
             if (unlikely(IORegistryEntryCreateCFProperties(drive, (CFMutableDictionaryRef *)&properties, kCFAllocatorDefault, 0))) {
-                IOObjectRelease(drive);
-                error("MACOS: IORegistryEntryCreateCFProperties() failed");
-                do_io = 0;
-                error("DISABLED: system.io");
-                break;
+                // the drive may have gone away before its notification arrived
+                drives_rescan = 1;
+                continue;
             } else if (likely(properties)) {
                 /* Obtain the statistics from the drive properties. */
                 if (likely(statistics = (CFDictionaryRef)CFDictionaryGetValue(properties, CFSTR(kIOBlockStorageDriverStatisticsKey)))) {
@@ -390,14 +497,7 @@ int do_macos_iokit(int update_every, usec_t dt) {
                 /* Release. */
                 CFRelease(properties);
             }
-
-            /* Release. */
-            IOObjectRelease(drive);
         }
-        IOIteratorReset(drive_list);
-
-        /* Release. */
-        IOObjectRelease(drive_list);
     }
 
     if (likely(do_io)) {
@@ -20,8 +20,8 @@ int do_macos_mach_smi(int update_every, usec_t dt) {
 
 	kern_return_t kr;
 	mach_msg_type_number_t count;
-    host_t host;
-    vm_size_t system_pagesize;
+    static host_t host = MACH_PORT_NULL;
+    static vm_size_t system_pagesize = 0;
 
 
     // NEEDED BY: do_cpu
@@ -34,10 +34,13 @@ int do_macos_mach_smi(int update_every, usec_t dt) {
     vm_statistics_data_t vm_statistics;
 #endif
 
-    host = mach_host_self();
-    kr = host_page_size(host, &system_pagesize);
-    if (unlikely(kr != KERN_SUCCESS))
-        return -1;
+    // mach_host_self() adds a send right on every call, so ask only once
+    if (unlikely(host == MACH_PORT_NULL)) {
+        host = mach_host_self();
+        kr = host_page_size(host, &system_pagesize);
+        if (unlikely(kr != KERN_SUCCESS))
+            return -1;
+    }
 
     // --------------------------------------------------------------------
 
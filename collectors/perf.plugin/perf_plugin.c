@@ -139,6 +139,11 @@ enum perf_event_group {
 static int number_of_cpus;
 
 static int *group_leader_fds[EV_GROUP_NUM];
+static int *group_members[EV_GROUP_NUM];
+
+// the values of all the members of a group are read with a single read() of its leader:
+// nr, time_enabled, time_running, value[nr]
+static uint64_t group_read_buffer[3 + EV_ID_END];
 
 static struct perf_event {
     perf_event_id_t id;
@@ -157,116 +162,119 @@ static struct perf_event {
     uint64_t *prev_value;
     uint64_t *prev_time_enabled;
     uint64_t *prev_time_running;
+
+    // the position of the event in the group read of each CPU, or -1
+    int *group_index;
 } perf_events[] = {
     // Hardware counters
-    {EV_ID_CPU_CYCLES,              PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,              &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_INSTRUCTIONS,            PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,            &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_CACHE_REFERENCES,        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,        &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_CACHE_MISSES,            PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,            &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_BRANCH_INSTRUCTIONS,     PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,     &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_BRANCH_MISSES,           PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,           &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_BUS_CYCLES,              PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES,              &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_STALLED_CYCLES_FRONTEND, PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_STALLED_CYCLES_BACKEND,  PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND,  &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_REF_CPU_CYCLES,          PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES,          &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL},
+    {EV_ID_CPU_CYCLES,              PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,              &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_INSTRUCTIONS,            PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,            &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_CACHE_REFERENCES,        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,        &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_CACHE_MISSES,            PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,            &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_BRANCH_INSTRUCTIONS,     PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,     &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_BRANCH_MISSES,           PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,           &group_leader_fds[EV_GROUP_INSTRUCTIONS_AND_CACHE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_BUS_CYCLES,              PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES,              &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_STALLED_CYCLES_FRONTEND, PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_STALLED_CYCLES_BACKEND,  PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND,  &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_REF_CPU_CYCLES,          PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES,          &group_leader_fds[EV_GROUP_CYCLES], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
 
     // Software counters
-    // {EV_ID_CPU_CLOCK,        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK,        &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    // {EV_ID_TASK_CLOCK,       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,       &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    // {EV_ID_PAGE_FAULTS,      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,      &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    // {EV_ID_CONTEXT_SWITCHES, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_CPU_MIGRATIONS,   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS,   &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    // {EV_ID_PAGE_FAULTS_MIN,  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN,  &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    // {EV_ID_PAGE_FAULTS_MAJ,  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ,  &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_ALIGNMENT_FAULTS, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_ALIGNMENT_FAULTS, &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
-    {EV_ID_EMULATION_FAULTS, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_EMULATION_FAULTS, &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL},
+    // {EV_ID_CPU_CLOCK,        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK,        &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    // {EV_ID_TASK_CLOCK,       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,       &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    // {EV_ID_PAGE_FAULTS,      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,      &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    // {EV_ID_CONTEXT_SWITCHES, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_CPU_MIGRATIONS,   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS,   &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    // {EV_ID_PAGE_FAULTS_MIN,  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN,  &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    // {EV_ID_PAGE_FAULTS_MAJ,  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ,  &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_ALIGNMENT_FAULTS, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_ALIGNMENT_FAULTS, &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
+    {EV_ID_EMULATION_FAULTS, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_EMULATION_FAULTS, &group_leader_fds[EV_GROUP_SOFTWARE], NULL, 1, 0, 0, NULL, NULL, NULL, NULL},
 
     // Hardware cache counters
     {
         EV_ID_L1D_READ_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_L1D_READ_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_L1D_WRITE_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_L1D_WRITE_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_L1D_PREFETCH_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1D) | (PERF_COUNT_HW_CACHE_OP_PREFETCH << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1D], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     },
 
     {
         EV_ID_L1I_READ_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1I) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_L1I_READ_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_L1I) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     },
 
     {
         EV_ID_LL_READ_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_LL) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_LL_READ_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_LL) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_LL_WRITE_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_LL) | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_LL_WRITE_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_LL) | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     },
 
     {
         EV_ID_DTLB_READ_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_DTLB_READ_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_DTLB_WRITE_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_L1I_LL_DTLB], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_DTLB_WRITE_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     },
 
     {
         EV_ID_ITLB_READ_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_ITLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     }, {
         EV_ID_ITLB_READ_MISS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_ITLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     },
 
     {
         EV_ID_PBU_READ_ACCESS, PERF_TYPE_HW_CACHE,
         (PERF_COUNT_HW_CACHE_BPU) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
-        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL
+        &group_leader_fds[EV_GROUP_CACHE_ITLB_BPU], NULL, 1, 0, 0, NULL, NULL, NULL, NULL
     },
 
-    {EV_ID_END, 0, 0, NULL, NULL, 0, 0, 0, NULL, NULL, NULL}
+    {EV_ID_END, 0, 0, NULL, NULL, 0, 0, 0, NULL, NULL, NULL, NULL}
 };
 
 static int perf_init() {
@@ -290,11 +298,17 @@ static int perf_init() {
 
         current_event->prev_time_running = mallocz(number_of_cpus * sizeof(uint64_t));
         memset(current_event->prev_time_running, 0, number_of_cpus * sizeof(uint64_t));
+
+        current_event->group_index = mallocz(number_of_cpus * sizeof(int));
+        memset(current_event->group_index, -1, number_of_cpus * sizeof(int));
     }
 
     for(group = 0; group < EV_GROUP_NUM; group++) {
         group_leader_fds[group] = mallocz(number_of_cpus * sizeof(int));
         memset(group_leader_fds[group], NO_FD, number_of_cpus * sizeof(int));
+
+        group_members[group] = mallocz(number_of_cpus * sizeof(int));
+        memset(group_members[group], 0, number_of_cpus * sizeof(int));
     }
 
     memset(&perf_event_attr, 0, sizeof(perf_event_attr));
@@ -305,7 +319,7 @@ static int perf_init() {
 
             perf_event_attr.type = current_event->type;
             perf_event_attr.config = current_event->config;
-            perf_event_attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            perf_event_attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
 
             int fd, group_leader_fd = *(*current_event->group_leader_fd + cpu);
 
@@ -334,6 +348,12 @@ static int perf_init() {
                 error("Disabling event %u", current_event->id);
                 current_event->disabled = 1;
             }
+            else {
+                // the kernel returns the members of a group in the order they were added to it
+                int group_number = (int)(current_event->group_leader_fd - group_leader_fds);
+                *(current_event->group_index + cpu) = *(group_members[group_number] + cpu);
+                (*(group_members[group_number] + cpu))++;
+            }
 
             *(current_event->fd + cpu) = fd;
             *(*current_event->group_leader_fd + cpu) = group_leader_fd;
@@ -357,10 +377,13 @@ static void perf_free(void) {
         free(current_event->prev_value);
         free(current_event->prev_time_enabled);
         free(current_event->prev_time_running);
+        free(current_event->group_index);
     }
 
-    for(group = 0; group < EV_GROUP_NUM; group++)
+    for(group = 0; group < EV_GROUP_NUM; group++) {
         free(group_leader_fds[group]);
+        free(group_members[group]);
+    }
 }
 
 static void reenable_events() {
@@ -382,47 +405,64 @@ static void reenable_events() {
 }
 
 static int perf_collect() {
-    int cpu;
+    int group, cpu;
     struct perf_event *current_event = NULL;
     static uint64_t prev_cpu_cycles_value = 0;
-    struct {
-        uint64_t value;
-        uint64_t time_enabled;
-        uint64_t time_running;
-    } read_result;
 
     for(current_event = &perf_events[0]; current_event->id != EV_ID_END; current_event++) {
         current_event->updated = 0;
         current_event->value = 0;
+    }
 
-        if(unlikely(current_event->disabled)) continue;
-
+    for(group = 0; group < EV_GROUP_NUM; group++) {
         for(cpu = 0; cpu < number_of_cpus; cpu++) {
+            int current_fd = *(group_leader_fds[group] + cpu);
+            uint64_t members = (uint64_t)*(group_members[group] + cpu);
 
-            ssize_t read_size = read(current_event->fd[cpu], &read_result, sizeof(read_result));
+            if(unlikely(current_fd < 0 || !members)) continue;
 
-            if(likely(read_size == sizeof(read_result))) {
-                if (likely(read_result.time_running
-                           && read_result.time_running != *(current_event->prev_time_running + cpu)
-                           && (read_result.time_enabled / read_result.time_running < RUNNING_THRESHOLD))) {
-                    current_event->value += (read_result.value - *(current_event->prev_value + cpu)) \
-                                             * (read_result.time_enabled - *(current_event->prev_time_enabled + cpu)) \
-                                             / (read_result.time_running - *(current_event->prev_time_running + cpu));
+            ssize_t read_size = read(current_fd, group_read_buffer, sizeof(group_read_buffer));
+
+            if(unlikely(read_size != (ssize_t)((3 + members) * sizeof(uint64_t)) || group_read_buffer[0] != members)) {
+                error("Cannot update values for event group %d", group);
+                return 1;
+            }
+
+            // all the members of a group are scheduled together,
+            // so they share the time they were enabled and running
+            uint64_t time_enabled = group_read_buffer[1];
+            uint64_t time_running = group_read_buffer[2];
+
+            for(current_event = &perf_events[0]; current_event->id != EV_ID_END; current_event++) {
+                if(current_event->group_leader_fd != &group_leader_fds[group]) continue;
+                if(unlikely(current_event->disabled)) continue;
+
+                int index = *(current_event->group_index + cpu);
+                if(unlikely(index < 0)) continue;
+
+                uint64_t value = group_read_buffer[3 + index];
+
+                if (likely(time_running
+                           && time_running != *(current_event->prev_time_running + cpu)
+                           && (time_enabled / time_running < RUNNING_THRESHOLD))) {
+                    current_event->value += (value - *(current_event->prev_value + cpu)) \
+                                             * (time_enabled - *(current_event->prev_time_enabled + cpu)) \
+                                             / (time_running - *(current_event->prev_time_running + cpu));
                 }
 
-                *(current_event->prev_value + cpu) = read_result.value;
-                *(current_event->prev_time_enabled + cpu) = read_result.time_enabled;
-                *(current_event->prev_time_running + cpu) = read_result.time_running;
+                *(current_event->prev_value + cpu) = value;
+                *(current_event->prev_time_enabled + cpu) = time_enabled;
+                *(current_event->prev_time_running + cpu) = time_running;
 
                 current_event->updated = 1;
             }
-            else {
-                error("Cannot update value for event %u", current_event->id);
-                return 1;
-            }
         }
+    }
 
-        if(unlikely(debug)) fprintf(stderr, "perf.plugin: successfully read event id = %u, value = %lu\n", current_event->id, current_event->value);
+    if(unlikely(debug)) {
+        for(current_event = &perf_events[0]; current_event->id != EV_ID_END; current_event++)
+            if(current_event->updated)
+                fprintf(stderr, "perf.plugin: successfully read event id = %u, value = %lu\n", current_event->id, current_event->value);
     }
 
     if(unlikely(perf_events[EV_ID_CPU_CYCLES].value == prev_cpu_cycles_value))
@@ -117,388 +117,1259 @@ inline int pluginsd_split_words(char *str, char **words, int max_words) {
     return quoted_strings_splitter(str, words, max_words, pluginsd_space);
 }
 
-inline size_t pluginsd_process(RRDHOST *host, struct plugind *cd, FILE *fp, int trust_durations) {
-    int enabled = cd->enabled;
+// the collected values of a chart that is being replicated are stored after the replicated ones
+static inline void pluginsd_done(RRDSET *st) {
+    if(likely(!rrdset_flag_check(st, RRDSET_FLAG_REPLICATING)))
+        rrdset_done(st);
+}
 
-    if(!fp || !enabled) {
-        cd->enabled = 0;
-        return 0;
+static inline void pluginsd_begin(RRDSET *st, usec_t microseconds, int trust_durations) {
+    if(likely(st->counter_done)) {
+        if(likely(microseconds)) {
+            if(trust_durations)
+                rrdset_next_usec_unfiltered(st, microseconds);
+            else
+                rrdset_next_usec(st, microseconds);
+        }
+        else rrdset_next(st);
     }
+}
 
-    size_t count = 0;
+// ----------------------------------------------------------------------------
+// the binary protocol of streaming
 
-    char line[PLUGINSD_LINE_MAX + 1];
+struct pluginsd_binary_chart {
+    char *id;                           // the id of the chart, to find it again when the charts of the host change
+    RRDSET *st;
+    int shed;                           // 1 when the chart has been shed, its metrics are ignored
+    size_t generation;                  // the charts_generation of the host st and dims have been found at
 
-    char *words[PLUGINSD_MAX_WORDS] = { NULL };
-    uint32_t BEGIN_HASH = simple_hash(PLUGINSD_KEYWORD_BEGIN);
-    uint32_t END_HASH = simple_hash(PLUGINSD_KEYWORD_END);
-    uint32_t FLUSH_HASH = simple_hash(PLUGINSD_KEYWORD_FLUSH);
-    uint32_t CHART_HASH = simple_hash(PLUGINSD_KEYWORD_CHART);
-    uint32_t DIMENSION_HASH = simple_hash(PLUGINSD_KEYWORD_DIMENSION);
-    uint32_t DISABLE_HASH = simple_hash(PLUGINSD_KEYWORD_DISABLE);
-    uint32_t VARIABLE_HASH = simple_hash(PLUGINSD_KEYWORD_VARIABLE);
-
-    RRDSET *st = NULL;
-    uint32_t hash;
+    size_t dimensions;
+    char **dimension_ids;
+    RRDDIM **dims;                      // by their position in the definition of the chart
+};
+
+struct pluginsd_binary {
+    size_t size;
+    struct pluginsd_binary_chart *charts; // by their number
 
-    errno = 0;
-    clearerr(fp);
+    size_t defined;                     // the dimensions of the chart being defined, until it is bound
+    size_t defined_size;
+    RRDDIM **defined_dims;              // NULL for the ones shed
+};
 
-    if(unlikely(fileno(fp) == -1)) {
-        error("file descriptor given is not a valid stream");
-        goto cleanup;
+struct pluginsd_parser {
+    RRDHOST *host;
+    struct plugind *cd;
+    int trust_durations;
+    int binary;                         // binary metrics frames may be received, between the lines
+
+    RRDSET *st;                         // the chart of the last BEGIN or CHART
+    struct pluginsd_ring *ring;         // the shared memory ring, after RING
+
+    // the dimensions are SET nearly always in the same order, the order of their definition,
+    // so the one after the last SET is tried before searching for the dimension
+    RRDSET *set_st;                     // the chart of the last BEGIN, until its END
+    RRDDIM *set_next;                   // the dimension expected in the next SET
+    struct pluginsd_binary b;
+    size_t count;                       // the collections completed
+
+    BUFFER *replies;                    // not NULL when the charts are replicated, what is sent back
+    RRDSET *replay_st;                  // the chart of the last REPLAY_BEGIN
+
+    struct pluginsd_limits *limits;     // not NULL when the charts and dimensions it creates are limited
+    DICTIONARY *shed;                   // the ids of the charts and dimensions shed, once they are
+    int shedding;                       // 1 while the chart of the last CHART or BEGIN is shed
+    char shed_id[RRD_ID_LENGTH_MAX + 1];    // the id of that chart
+};
+
+static void pluginsd_binary_chart_free(struct pluginsd_binary_chart *c) {
+    size_t i;
+    for(i = 0; i < c->dimensions ; i++)
+        freez(c->dimension_ids[i]);
+
+    freez(c->dimension_ids);
+    freez(c->dims);
+    freez(c->id);
+    memset(c, 0, sizeof(struct pluginsd_binary_chart));
+}
+
+static void pluginsd_binary_free(struct pluginsd_binary *b) {
+    size_t i;
+    for(i = 0; i < b->size ; i++)
+        pluginsd_binary_chart_free(&b->charts[i]);
+
+    freez(b->charts);
+    freez(b->defined_dims);
+}
+
+static inline void pluginsd_binary_defined_dimension(struct pluginsd_binary *b, RRDDIM *rd) {
+    if(unlikely(b->defined == b->defined_size)) {
+        b->defined_size = (b->defined_size)?b->defined_size * 2:32;
+        b->defined_dims = reallocz(b->defined_dims, b->defined_size * sizeof(RRDDIM *));
     }
+    b->defined_dims[b->defined++] = rd;
+}
 
-    while(!ferror(fp)) {
-        if(unlikely(netdata_exit)) break;
+// gives number to st, which has just been defined, with the dimensions defined after it
+// st is NULL when the chart id has been shed, its metrics are ignored
+static int pluginsd_binary_bind(RRDHOST *host, struct pluginsd_binary *b, RRDSET *st, const char *id, size_t number) {
+    if(unlikely(!number || number >= PLUGINSD_BINARY_MAX_CHARTS)) {
+        error("requested a BIND of chart '%s' on host '%s' to number %zu, which is not valid. Disabling it.", id, host->hostname, number);
+        return 1;
+    }
 
-        char *r = fgets(line, PLUGINSD_LINE_MAX, fp);
-        if(unlikely(!r)) {
-            error("read failed");
-            break;
+    if(unlikely(number >= b->size)) {
+        size_t size = (number * 2 < PLUGINSD_BINARY_MAX_CHARTS)?number * 2:PLUGINSD_BINARY_MAX_CHARTS;
+        b->charts = reallocz(b->charts, size * sizeof(struct pluginsd_binary_chart));
+        memset(&b->charts[b->size], 0, (size - b->size) * sizeof(struct pluginsd_binary_chart));
+        b->size = size;
+    }
+
+    struct pluginsd_binary_chart *c = &b->charts[number];
+    pluginsd_binary_chart_free(c);
+
+    c->id = strdupz(id);
+    c->st = st;
+    c->shed = !st;
+    c->generation = __atomic_load_n(&host->charts_generation, __ATOMIC_ACQUIRE);
+    c->dimensions = b->defined;
+    c->dimension_ids = mallocz((b->defined + 1) * sizeof(char *));
+    c->dims = mallocz((b->defined + 1) * sizeof(RRDDIM *));
+
+    size_t i;
+    for(i = 0; i < b->defined ; i++) {
+        c->dims[i] = b->defined_dims[i];
+        c->dimension_ids[i] = (b->defined_dims[i])?strdupz(b->defined_dims[i]->id):NULL;
+    }
+
+    b->defined = 0;
+    return 0;
+}
+
+// the chart with this number, after finding it again if the charts of the host have changed
+static inline struct pluginsd_binary_chart *pluginsd_binary_chart(RRDHOST *host, struct pluginsd_binary *b, uint64_t number) {
+    if(unlikely(number >= b->size || !b->charts[number].id))
+        return NULL;
+
+    struct pluginsd_binary_chart *c = &b->charts[number];
+
+    size_t generation = __atomic_load_n(&host->charts_generation, __ATOMIC_ACQUIRE);
+    if(unlikely(c->generation != generation)) {
+        size_t i;
+
+        c->st = (c->shed)?NULL:rrdset_find(host, c->id);
+        for(i = 0; i < c->dimensions ; i++)
+            c->dims[i] = (c->st && c->dimension_ids[i])?rrddim_find(c->st, c->dimension_ids[i]):NULL;
+
+        c->generation = generation;
+    }
+
+    return (c->st || c->shed)?c:NULL;
+}
+
+// decodes the varint at s, which has len bytes
+// returns the bytes it has, 0 when it has not been received completely, -1 when it is invalid
+static inline int pluginsd_binary_varint(const char *s, size_t len, uint64_t *value) {
+    uint64_t v = 0;
+    int i, shift;
+
+    for(i = 0, shift = 0; i < PLUGINSD_BINARY_VARINT_MAX ; i++, shift += 7) {
+        if(unlikely((size_t)i >= len))
+            return 0;
+
+        unsigned char c = (unsigned char)s[i];
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if(likely(!(c & 0x80))) {
+            *value = v;
+            return i + 1;
         }
+    }
 
-        if(unlikely(netdata_exit)) break;
+    return -1;
+}
 
-        line[PLUGINSD_LINE_MAX] = '\0';
+// the size of the metrics frame at s, which has len bytes
+// 0 when it has not been received completely, -1 when it is invalid
+static ssize_t pluginsd_binary_frame_size(const char *s, size_t len) {
+    size_t pos = 1, varints = 0;
+    uint64_t position = 1;
 
-        int w = pluginsd_split_words(line, words, PLUGINSD_MAX_WORDS);
-        char *s = words[0];
-        if(unlikely(!s || !*s || !w)) {
-            continue;
+    // the number of the chart, the microseconds, then pairs of position and value until position 0
+    while(varints < 2 || position) {
+        uint64_t value;
+        int bytes = pluginsd_binary_varint(&s[pos], len - pos, &value);
+        if(unlikely(bytes <= 0))
+            return bytes;
+
+        if(varints >= 2 && !(varints & 1))
+            position = value;
+
+        pos += bytes;
+        varints++;
+    }
+
+    return (ssize_t)pos;
+}
+
+// processes a complete frame with the metrics of a chart
+static int pluginsd_binary_metrics(struct pluginsd_parser *p, const char *s, size_t len) {
+    RRDHOST *host = p->host;
+    uint64_t number, microseconds, position, value;
+    size_t pos = 1;
+
+    pos += pluginsd_binary_varint(&s[pos], len - pos, &number);
+    pos += pluginsd_binary_varint(&s[pos], len - pos, &microseconds);
+
+    struct pluginsd_binary_chart *c = pluginsd_binary_chart(host, &p->b, number);
+    if(unlikely(!c)) {
+        error("received the metrics of chart number %llu, which does not exist on host '%s'. Disabling it.", (unsigned long long)number, host->hostname);
+        return 1;
+    }
+
+    RRDSET *st = c->st;
+    if(unlikely(!st))
+        return 0;
+
+    pluginsd_begin(st, (usec_t)microseconds, p->trust_durations);
+    p->set_st = NULL;
+
+    for(;;) {
+        pos += pluginsd_binary_varint(&s[pos], len - pos, &position);
+        if(unlikely(!position))
+            break;
+
+        pos += pluginsd_binary_varint(&s[pos], len - pos, &value);
+
+        if(unlikely(position > c->dimensions || !c->dims[position - 1])) {
+            if(position <= c->dimensions && !c->dimension_ids[position - 1])
+                continue;
+
+            error("received the metrics of dimension number %llu of chart '%s' on host '%s', which does not exist. Disabling it.", (unsigned long long)position, st->id, host->hostname);
+            return 1;
         }
 
-        // debug(D_PLUGINSD, "PLUGINSD: words 0='%s' 1='%s' 2='%s' 3='%s' 4='%s' 5='%s' 6='%s' 7='%s' 8='%s' 9='%s'", words[0], words[1], words[2], words[3], words[4], words[5], words[6], words[7], words[8], words[9]);
+        rrddim_set_by_pointer(st, c->dims[position - 1], (collected_number)(int64_t)((value >> 1) ^ (~(value & 1) + 1)));
+        if(unlikely(p->limits)) p->limits->points++;
+    }
 
-        if(likely(!simple_hash_strcmp(s, "SET", &hash))) {
-            char *dimension = words[1];
-            char *value = words[2];
+    if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
+        debug(D_PLUGINSD, "received the metrics of chart %s", st->id);
 
-            if(unlikely(!dimension || !*dimension)) {
-                error("requested a SET on chart '%s' of host '%s', without a dimension. Disabling it.", st->id, host->hostname);
-                enabled = 0;
-                break;
-            }
+    pluginsd_done(st);
+    p->count++;
+    return 0;
+}
 
-            if(unlikely(!value || !*value)) value = NULL;
+// ----------------------------------------------------------------------------
+// the parser of the plugins.d protocol
+
+static uint32_t BEGIN_HASH, END_HASH, FLUSH_HASH, CHART_HASH, DIMENSION_HASH, DISABLE_HASH, VARIABLE_HASH, BIND_HASH,
+                REPLAY_BEGIN_HASH, REPLAY_SET_HASH, REPLAY_END_HASH, CHART_DEFINED_HASH, BINARY_HASH, RING_HASH;
+
+// replies is given when the charts are replicated, the parser appends to it what has to be sent back
+struct pluginsd_parser *pluginsd_parser_create(RRDHOST *host, struct plugind *cd, int trust_durations, int binary, BUFFER *replies) {
+    if(unlikely(!BIND_HASH)) {
+        BEGIN_HASH = simple_hash(PLUGINSD_KEYWORD_BEGIN);
+        END_HASH = simple_hash(PLUGINSD_KEYWORD_END);
+        FLUSH_HASH = simple_hash(PLUGINSD_KEYWORD_FLUSH);
+        CHART_HASH = simple_hash(PLUGINSD_KEYWORD_CHART);
+        DIMENSION_HASH = simple_hash(PLUGINSD_KEYWORD_DIMENSION);
+        DISABLE_HASH = simple_hash(PLUGINSD_KEYWORD_DISABLE);
+        VARIABLE_HASH = simple_hash(PLUGINSD_KEYWORD_VARIABLE);
+        REPLAY_BEGIN_HASH = simple_hash(PLUGINSD_KEYWORD_REPLAY_BEGIN);
+        REPLAY_SET_HASH = simple_hash(PLUGINSD_KEYWORD_REPLAY_SET);
+        REPLAY_END_HASH = simple_hash(PLUGINSD_KEYWORD_REPLAY_END);
+        CHART_DEFINED_HASH = simple_hash(PLUGINSD_KEYWORD_CHART_DEFINED);
+        BINARY_HASH = simple_hash(PLUGINSD_KEYWORD_BINARY);
+        RING_HASH = simple_hash(PLUGINSD_KEYWORD_RING);
+        __atomic_store_n(&BIND_HASH, simple_hash(PLUGINSD_KEYWORD_BIND), __ATOMIC_RELEASE);
+    }
 
-            if(unlikely(!st)) {
-                error("requested a SET on dimension %s with value %s on host '%s', without a BEGIN. Disabling it.", dimension, value?value:"<nothing>", host->hostname);
-                enabled = 0;
-                break;
-            }
+    struct pluginsd_parser *p = callocz(1, sizeof(struct pluginsd_parser));
+    p->host = host;
+    p->cd = cd;
+    p->trust_durations = trust_durations;
+    p->binary = binary;
+    p->replies = replies;
+    return p;
+}
+
+// limits the charts and dimensions the parser creates on its host, counting the ones the host has
+void pluginsd_parser_limits(struct pluginsd_parser *p, struct pluginsd_limits *limits) {
+    RRDHOST *host = p->host;
+    RRDSET *st;
+    RRDDIM *rd;
+
+    limits->charts = 0;
+    limits->dimensions = 0;
+
+    rrdhost_rdlock(host);
+    rrdset_foreach_read(st, host) {
+        limits->charts++;
+
+        rrdset_rdlock(st);
+        rrddim_foreach_read(rd, st)
+            limits->dimensions++;
+        rrdset_unlock(st);
+    }
+    rrdhost_unlock(host);
+
+    p->limits = limits;
+}
+
+// remembers the chart or dimension id shed, returns 1 the first time it is
+static int pluginsd_shed(struct pluginsd_parser *p, const char *id) {
+    if(unlikely(!p->shed))
+        p->shed = dictionary_create(DICTIONARY_FLAG_SINGLE_THREADED);
+
+    if(dictionary_get(p->shed, id))
+        return 0;
+
+    dictionary_set(p->shed, id, "", 1);
+    return 1;
+}
+
+// asks the sending netdata for the values of st it has stored after the ones st has,
+// once per connection - the collected values are not stored until they are received
+static void pluginsd_replicate(struct pluginsd_parser *p, RRDSET *st) {
+    if(!p->replies || st->rrd_memory_mode == RRD_MEMORY_MODE_NONE || rrdset_flag_check(st, RRDSET_FLAG_REPLICATING) || rrdset_flag_check(st, RRDSET_FLAG_REPLICATED))
+        return;
+
+    // the database cannot keep older values
+    time_t after = rrdset_last_entry_t(st), oldest = now_realtime_sec() - (time_t)st->entries * st->update_every;
+    if(after < oldest) after = oldest;
+
+    st->replicate_after = after;
+    rrdset_flag_set(st, RRDSET_FLAG_REPLICATING);
+
+    buffer_sprintf(p->replies, PLUGINSD_KEYWORD_REPLICATE " \"%s\" %ld\n", st->id, (long)after);
+}
+
+// updates the statistics of the plugin, frees the parser and returns the collections it completed
+size_t pluginsd_parser_free(struct pluginsd_parser *p, int enabled) {
+    struct plugind *cd = p->cd;
+    size_t count = p->count;
+
+    pluginsd_binary_free(&p->b);
+    if(p->shed) dictionary_destroy(p->shed);
+    freez(p);
+
+    cd->enabled = enabled;
+
+    if(likely(count)) {
+        cd->successful_collections += count;
+        cd->serial_failures = 0;
+    }
+    else
+        cd->serial_failures++;
+
+    return count;
+}
+
+// processes a line the plugin has sent, without its newline
+// returns 0 to continue, 1 when the plugin has to be disabled
+static int pluginsd_parse_line(struct pluginsd_parser *p, char *line) {
+    RRDHOST *host = p->host;
+    struct plugind *cd = p->cd;
+    RRDSET *st = p->st;
+    char *words[PLUGINSD_MAX_WORDS] = { NULL };
+    uint32_t hash;
+
+    int w = pluginsd_split_words(line, words, PLUGINSD_MAX_WORDS);
+    char *s = words[0];
+    if(unlikely(!s || !*s || !w))
+        return 0;
+
+    // debug(D_PLUGINSD, "PLUGINSD: words 0='%s' 1='%s' 2='%s' 3='%s' 4='%s' 5='%s' 6='%s' 7='%s' 8='%s' 9='%s'", words[0], words[1], words[2], words[3], words[4], words[5], words[6], words[7], words[8], words[9]);
+
+    if(likely(!simple_hash_strcmp(s, "SET", &hash))) {
+        char *dimension = words[1];
+        char *value = words[2];
+
+        if(unlikely(p->shedding))
+            return 0;
+
+        if(unlikely(!dimension || !*dimension)) {
+            error("requested a SET on chart '%s' of host '%s', without a dimension. Disabling it.", st->id, host->hostname);
+            goto disable;
+        }
+
+        if(unlikely(!value || !*value)) value = NULL;
 
-            if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
-                debug(D_PLUGINSD, "is setting dimension %s/%s to %s", st->id, dimension, value?value:"<nothing>");
+        if(unlikely(!st)) {
+            error("requested a SET on dimension %s with value %s on host '%s', without a BEGIN. Disabling it.", dimension, value?value:"<nothing>", host->hostname);
+            goto disable;
+        }
+
+        if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
+            debug(D_PLUGINSD, "is setting dimension %s/%s to %s", st->id, dimension, value?value:"<nothing>");
 
-            if(value) {
-                RRDDIM *rd = rrddim_find(st, dimension);
+        if(value) {
+            RRDDIM *rd = p->set_next;
+            if(unlikely(p->set_st != st || !rd || strcmp(rd->id, dimension))) {
+                rd = rrddim_find(st, dimension);
                 if(unlikely(!rd)) {
+                    if(p->shed) {
+                        char key[RRD_ID_LENGTH_MAX * 2 + 2];
+                        snprintfz(key, RRD_ID_LENGTH_MAX * 2 + 1, "%s/%s", st->id, dimension);
+                        if(dictionary_get(p->shed, key))
+                            return 0;
+                    }
+
                     error("requested a SET to dimension with id '%s' on stats '%s' (%s) on host '%s', which does not exist. Disabling it.", dimension, st->name, st->id, st->rrdhost->hostname);
-                    enabled = 0;
-                    break;
+                    goto disable;
                 }
-                else
-                    rrddim_set_by_pointer(st, rd, strtoll(value, NULL, 0));
             }
+
+            p->set_next = rd->next;
+            rrddim_set_by_pointer(st, rd, strtoll(value, NULL, 0));
+            if(unlikely(p->limits)) p->limits->points++;
         }
-        else if(likely(hash == BEGIN_HASH && !strcmp(s, PLUGINSD_KEYWORD_BEGIN))) {
-            char *id = words[1];
-            char *microseconds_txt = words[2];
+    }
+    else if(likely(hash == BEGIN_HASH && !strcmp(s, PLUGINSD_KEYWORD_BEGIN))) {
+        char *id = words[1];
+        char *microseconds_txt = words[2];
 
-            if(unlikely(!id)) {
-                error("requested a BEGIN without a chart id for host '%s'. Disabling it.", host->hostname);
-                enabled = 0;
-                break;
-            }
+        if(unlikely(!id)) {
+            error("requested a BEGIN without a chart id for host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
 
-            st = rrdset_find(host, id);
-            if(unlikely(!st)) {
-                error("requested a BEGIN on chart '%s', which does not exist on host '%s'. Disabling it.", id, host->hostname);
-                enabled = 0;
-                break;
+        st = rrdset_find(host, id);
+        if(unlikely(!st)) {
+            if(p->shed && dictionary_get(p->shed, id)) {
+                p->shedding = 1;
+                p->set_st = NULL;
+                p->st = NULL;
+                return 0;
             }
 
-            if(likely(st->counter_done)) {
-                usec_t microseconds = 0;
-                if(microseconds_txt && *microseconds_txt) microseconds = str2ull(microseconds_txt);
+            error("requested a BEGIN on chart '%s', which does not exist on host '%s'. Disabling it.", id, host->hostname);
+            goto disable;
+        }
+        p->shedding = 0;
 
-                if(likely(microseconds)) {
-                    if(trust_durations)
-                        rrdset_next_usec_unfiltered(st, microseconds);
-                    else
-                        rrdset_next_usec(st, microseconds);
-                }
-                else rrdset_next(st);
-            }
+        usec_t microseconds = 0;
+        if(microseconds_txt && *microseconds_txt) microseconds = str2ull(microseconds_txt);
+        pluginsd_begin(st, microseconds, p->trust_durations);
+
+        p->set_st = st;
+        p->set_next = st->dimensions;
+    }
+    else if(likely(hash == END_HASH && !strcmp(s, PLUGINSD_KEYWORD_END))) {
+        if(unlikely(p->shedding)) {
+            p->shedding = 0;
+            return 0;
         }
-        else if(likely(hash == END_HASH && !strcmp(s, PLUGINSD_KEYWORD_END))) {
-            if(unlikely(!st)) {
-                error("requested an END, without a BEGIN on host '%s'. Disabling it.", host->hostname);
-                enabled = 0;
-                break;
-            }
 
-            if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
-                debug(D_PLUGINSD, "requested an END on chart %s", st->id);
-
-            rrdset_done(st);
-            st = NULL;
-
-            count++;
-        }
-        else if(likely(hash == CHART_HASH && !strcmp(s, PLUGINSD_KEYWORD_CHART))) {
-            st = NULL;
-
-            char *type           = words[1];
-            char *name           = words[2];
-            char *title          = words[3];
-            char *units          = words[4];
-            char *family         = words[5];
-            char *context        = words[6];
-            char *chart          = words[7];
-            char *priority_s     = words[8];
-            char *update_every_s = words[9];
-            char *options        = words[10];
-            char *plugin         = words[11];
-            char *module         = words[12];
-
-            // parse the id from type
-            char *id = NULL;
-            if(likely(type && (id = strchr(type, '.')))) {
-                *id = '\0';
-                id++;
-            }
+        if(unlikely(!st)) {
+            error("requested an END, without a BEGIN on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
 
-            // make sure we have the required variables
-            if(unlikely(!type || !*type || !id || !*id)) {
-                error("requested a CHART, without a type.id, on host '%s'. Disabling it.", host->hostname);
-                enabled = 0;
-                break;
-            }
+        if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
+            debug(D_PLUGINSD, "requested an END on chart %s", st->id);
 
-            // parse the name, and make sure it does not include 'type.'
-            if(unlikely(name && *name)) {
-                // when data are coming from slaves
-                // name will be type.name
-                // so we have to remove 'type.' from name too
-                size_t len = strlen(type);
-                if(strncmp(type, name, len) == 0 && name[len] == '.')
-                    name = &name[len + 1];
-
-                // if the name is the same with the id,
-                // or is just 'NULL', clear it.
-                if(unlikely(strcmp(name, id) == 0 || strcasecmp(name, "NULL") == 0 || strcasecmp(name, "(NULL)") == 0))
-                    name = NULL;
-            }
+        pluginsd_done(st);
+        st = NULL;
+        p->set_st = NULL;
+
+        p->count++;
+    }
+    else if(likely(hash == CHART_HASH && !strcmp(s, PLUGINSD_KEYWORD_CHART))) {
+        st = NULL;
+        p->set_st = NULL;
+        p->b.defined = 0;
+        p->shedding = 0;
+
+        char *type           = words[1];
+        char *name           = words[2];
+        char *title          = words[3];
+        char *units          = words[4];
+        char *family         = words[5];
+        char *context        = words[6];
+        char *chart          = words[7];
+        char *priority_s     = words[8];
+        char *update_every_s = words[9];
+        char *options        = words[10];
+        char *plugin         = words[11];
+        char *module         = words[12];
+
+        // parse the id from type
+        char *id = NULL;
+        if(likely(type && (id = strchr(type, '.')))) {
+            *id = '\0';
+            id++;
+        }
 
-            int priority = 1000;
-            if(likely(priority_s && *priority_s)) priority = str2i(priority_s);
+        // make sure we have the required variables
+        if(unlikely(!type || !*type || !id || !*id)) {
+            error("requested a CHART, without a type.id, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
 
-            int update_every = cd->update_every;
-            if(likely(update_every_s && *update_every_s)) update_every = str2i(update_every_s);
-            if(unlikely(!update_every)) update_every = cd->update_every;
+        // parse the name, and make sure it does not include 'type.'
+        if(unlikely(name && *name)) {
+            // when data are coming from slaves
+            // name will be type.name
+            // so we have to remove 'type.' from name too
+            size_t len = strlen(type);
+            if(strncmp(type, name, len) == 0 && name[len] == '.')
+                name = &name[len + 1];
+
+            // if the name is the same with the id,
+            // or is just 'NULL', clear it.
+            if(unlikely(strcmp(name, id) == 0 || strcasecmp(name, "NULL") == 0 || strcasecmp(name, "(NULL)") == 0))
+                name = NULL;
+        }
 
-            RRDSET_TYPE chart_type = RRDSET_TYPE_LINE;
-            if(unlikely(chart)) chart_type = rrdset_type_id(chart);
+        int priority = 1000;
+        if(likely(priority_s && *priority_s)) priority = str2i(priority_s);
 
-            if(unlikely(name && !*name)) name = NULL;
-            if(unlikely(family && !*family)) family = NULL;
-            if(unlikely(context && !*context)) context = NULL;
-            if(unlikely(!title)) title = "";
-            if(unlikely(!units)) units = "unknown";
+        int update_every = cd->update_every;
+        if(likely(update_every_s && *update_every_s)) update_every = str2i(update_every_s);
+        if(unlikely(!update_every)) update_every = cd->update_every;
 
-            debug(D_PLUGINSD, "creating chart type='%s', id='%s', name='%s', family='%s', context='%s', chart='%s', priority=%d, update_every=%d"
-                  , type, id
-                  , name?name:""
-                  , family?family:""
-                  , context?context:""
-                  , rrdset_type_name(chart_type)
-                  , priority
-                  , update_every
-            );
+        RRDSET_TYPE chart_type = RRDSET_TYPE_LINE;
+        if(unlikely(chart)) chart_type = rrdset_type_id(chart);
 
-            st = rrdset_create(
-                    host
-                    , type
-                    , id
-                    , name
-                    , family
-                    , context
-                    , title
-                    , units
-                    , (plugin && *plugin)?plugin:cd->filename
-                    , module
-                    , priority
-                    , update_every
-                    , chart_type
-            );
+        if(unlikely(name && !*name)) name = NULL;
+        if(unlikely(family && !*family)) family = NULL;
+        if(unlikely(context && !*context)) context = NULL;
+        if(unlikely(!title)) title = "";
+        if(unlikely(!units)) units = "unknown";
 
-            if(options && *options) {
-                if(strstr(options, "obsolete"))
-                    rrdset_is_obsolete(st);
-                else
-                    rrdset_isnot_obsolete(st);
+        // the new charts over the limit are shed, the ones the host has are defined again
+        if(unlikely(p->limits && p->limits->max_charts)) {
+            snprintfz(p->shed_id, RRD_ID_LENGTH_MAX, "%s.%s", type, id);
 
-                if(strstr(options, "detail"))
-                    rrdset_flag_set(st, RRDSET_FLAG_DETAIL);
-                else
-                    rrdset_flag_clear(st, RRDSET_FLAG_DETAIL);
+            if(!rrdset_find(host, p->shed_id)) {
+                if(p->limits->charts >= p->limits->max_charts) {
+                    if(pluginsd_shed(p, p->shed_id) && p->limits->shed_charts++ == 0)
+                        error("host '%s' has %zu charts, the maximum allowed. Chart '%s' and the new ones after it are shed.", host->hostname, p->limits->charts, p->shed_id);
 
-                if(strstr(options, "hidden"))
-                    rrdset_flag_set(st, RRDSET_FLAG_HIDDEN);
-                else
-                    rrdset_flag_clear(st, RRDSET_FLAG_HIDDEN);
+                    p->shedding = 1;
+                    p->st = NULL;
+                    return 0;
+                }
 
-                if(strstr(options, "store_first"))
-                    rrdset_flag_set(st, RRDSET_FLAG_STORE_FIRST);
-                else
-                    rrdset_flag_clear(st, RRDSET_FLAG_STORE_FIRST);
+                p->limits->charts++;
             }
-            else {
+        }
+
+        debug(D_PLUGINSD, "creating chart type='%s', id='%s', name='%s', family='%s', context='%s', chart='%s', priority=%d, update_every=%d"
+              , type, id
+              , name?name:""
+              , family?family:""
+              , context?context:""
+              , rrdset_type_name(chart_type)
+              , priority
+              , update_every
+        );
+
+        st = rrdset_create(
+                host
+                , type
+                , id
+                , name
+                , family
+                , context
+                , title
+                , units
+                , (plugin && *plugin)?plugin:cd->filename
+                , module
+                , priority
+                , update_every
+                , chart_type
+        );
+
+        // a plugin restarted with another update_every (throttled) redefines its charts
+        if(unlikely(st->update_every != update_every))
+            rrdset_set_update_every(st, update_every);
+
+        if(options && *options) {
+            if(strstr(options, "obsolete"))
+                rrdset_is_obsolete(st);
+            else
                 rrdset_isnot_obsolete(st);
+
+            if(strstr(options, "detail"))
+                rrdset_flag_set(st, RRDSET_FLAG_DETAIL);
+            else
                 rrdset_flag_clear(st, RRDSET_FLAG_DETAIL);
+
+            if(strstr(options, "hidden"))
+                rrdset_flag_set(st, RRDSET_FLAG_HIDDEN);
+            else
+                rrdset_flag_clear(st, RRDSET_FLAG_HIDDEN);
+
+            if(strstr(options, "store_first"))
+                rrdset_flag_set(st, RRDSET_FLAG_STORE_FIRST);
+            else
                 rrdset_flag_clear(st, RRDSET_FLAG_STORE_FIRST);
-            }
         }
-        else if(likely(hash == DIMENSION_HASH && !strcmp(s, PLUGINSD_KEYWORD_DIMENSION))) {
-            char *id = words[1];
-            char *name = words[2];
-            char *algorithm = words[3];
-            char *multiplier_s = words[4];
-            char *divisor_s = words[5];
-            char *options = words[6];
-
-            if(unlikely(!id || !*id)) {
-                error("requested a DIMENSION, without an id, host '%s' and chart '%s'. Disabling it.", host->hostname, st?st->id:"UNSET");
-                enabled = 0;
-                break;
+        else {
+            rrdset_isnot_obsolete(st);
+            rrdset_flag_clear(st, RRDSET_FLAG_DETAIL);
+            rrdset_flag_clear(st, RRDSET_FLAG_STORE_FIRST);
+        }
+
+        pluginsd_replicate(p, st);
+    }
+    else if(likely(hash == CHART_DEFINED_HASH && !strcmp(s, PLUGINSD_KEYWORD_CHART_DEFINED))) {
+        char *id = words[1];
+
+        if(unlikely(!id || !*id)) {
+            error("requested a CHART_DEFINED, without a chart id, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
+
+        st = rrdset_find(host, id);
+        if(unlikely(!st)) {
+            error("requested a CHART_DEFINED on chart '%s', which does not exist on host '%s'. Disabling it.", id, host->hostname);
+            goto disable;
+        }
+        p->shedding = 0;
+
+        // the dimensions of the definition, for the BIND that follows
+        if(p->binary) {
+            RRDDIM *rd;
+
+            p->b.defined = 0;
+            rrdset_rdlock(st);
+            rrddim_foreach_read(rd, st)
+                pluginsd_binary_defined_dimension(&p->b, rd);
+            rrdset_unlock(st);
+        }
+
+        pluginsd_replicate(p, st);
+    }
+    else if(likely(hash == DIMENSION_HASH && !strcmp(s, PLUGINSD_KEYWORD_DIMENSION))) {
+        char *id = words[1];
+        char *name = words[2];
+        char *algorithm = words[3];
+        char *multiplier_s = words[4];
+        char *divisor_s = words[5];
+        char *options = words[6];
+
+        if(unlikely(p->shedding))
+            return 0;
+
+        if(unlikely(!id || !*id)) {
+            error("requested a DIMENSION, without an id, host '%s' and chart '%s'. Disabling it.", host->hostname, st?st->id:"UNSET");
+            goto disable;
+        }
+
+        if(unlikely(!st)) {
+            error("requested a DIMENSION, without a CHART, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
+
+        long multiplier = 1;
+        if(multiplier_s && *multiplier_s) multiplier = strtol(multiplier_s, NULL, 0);
+        if(unlikely(!multiplier)) multiplier = 1;
+
+        long divisor = 1;
+        if(likely(divisor_s && *divisor_s)) divisor = strtol(divisor_s, NULL, 0);
+        if(unlikely(!divisor)) divisor = 1;
+
+        if(unlikely(!algorithm || !*algorithm)) algorithm = "absolute";
+
+        // the new dimensions over the limit are shed, keeping their positions for the binary metrics
+        if(unlikely(p->limits && p->limits->max_dimensions && !rrddim_find(st, id))) {
+            if(p->limits->dimensions >= p->limits->max_dimensions) {
+                char key[RRD_ID_LENGTH_MAX * 2 + 2];
+                snprintfz(key, RRD_ID_LENGTH_MAX * 2 + 1, "%s/%s", st->id, id);
+
+                if(pluginsd_shed(p, key) && p->limits->shed_dimensions++ == 0)
+                    error("host '%s' has %zu dimensions, the maximum allowed. Dimension '%s' of chart '%s' and the new ones after it are shed.", host->hostname, p->limits->dimensions, id, st->id);
+
+                if(p->binary)
+                    pluginsd_binary_defined_dimension(&p->b, NULL);
+
+                return 0;
             }
 
-            if(unlikely(!st)) {
-                error("requested a DIMENSION, without a CHART, on host '%s'. Disabling it.", host->hostname);
-                enabled = 0;
-                break;
+            p->limits->dimensions++;
+        }
+
+        if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
+            debug(D_PLUGINSD, "creating dimension in chart %s, id='%s', name='%s', algorithm='%s', multiplier=%ld, divisor=%ld, hidden='%s'"
+                  , st->id
+                  , id
+                  , name?name:""
+                  , rrd_algorithm_name(rrd_algorithm_id(algorithm))
+                  , multiplier
+                  , divisor
+                  , options?options:""
+            );
+
+        RRDDIM *rd = rrddim_add(st, id, name, multiplier, divisor, rrd_algorithm_id(algorithm));
+        if(options && *options && strstr(options, "hidden") != NULL)
+            rrddim_hide(st, rd->id);
+        else
+            rrddim_unhide(st, rd->id);
+        rrddim_flag_clear(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS);
+        if(options && *options) {
+            if(strstr(options, "obsolete") != NULL)
+                rrddim_is_obsolete(st, rd);
+            else
+                rrddim_isnot_obsolete(st, rd);
+            if(strstr(options, "noreset") != NULL) rrddim_flag_set(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS);
+            if(strstr(options, "nooverflow") != NULL) rrddim_flag_set(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS);
+        }
+        else {
+            rrddim_isnot_obsolete(st, rd);
+        }
+
+        if(p->binary)
+            pluginsd_binary_defined_dimension(&p->b, rd);
+    }
+    else if(likely(hash == BIND_HASH && !strcmp(s, PLUGINSD_KEYWORD_BIND))) {
+        char *number = words[1];
+
+        if(unlikely(p->shedding && p->binary && number && *number)) {
+            if(unlikely(pluginsd_binary_bind(host, &p->b, NULL, p->shed_id, (size_t)str2ull(number))))
+                goto disable;
+
+            return 0;
+        }
+
+        if(unlikely(!p->binary || !st || !number || !*number)) {
+            error("requested a BIND without a CHART, a number or the binary protocol, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
+
+        if(unlikely(pluginsd_binary_bind(host, &p->b, st, st->id, (size_t)str2ull(number)))) {
+            goto disable;
+        }
+    }
+    else if(unlikely(hash == BINARY_HASH && !strcmp(s, PLUGINSD_KEYWORD_BINARY))) {
+        if(!p->binary)
+            info("PLUGINSD: '%s' switched to the binary protocol on host '%s'", (cd)?cd->fullfilename:"-", host->hostname);
+
+        p->binary = 1;
+    }
+    else if(unlikely(hash == RING_HASH && !strcmp(s, PLUGINSD_KEYWORD_RING))) {
+        if(unlikely(!p->binary || !cd || !cd->ring)) {
+            error("requested a RING without the binary protocol or a shared memory ring, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
+
+        info("PLUGINSD: '%s' switched to its shared memory ring on host '%s'", cd->fullfilename, host->hostname);
+        p->ring = cd->ring;
+    }
+    else if(likely(hash == VARIABLE_HASH && !strcmp(s, PLUGINSD_KEYWORD_VARIABLE))) {
+        char *name = words[1];
+        char *value = words[2];
+        int global = (st || p->shedding)?0:1;
+
+        if(name && *name) {
+            if((strcmp(name, "GLOBAL") == 0 || strcmp(name, "HOST") == 0)) {
+                global = 1;
+                name = words[2];
+                value  = words[3];
             }
+            else if((strcmp(name, "LOCAL") == 0 || strcmp(name, "CHART") == 0)) {
+                global = 0;
+                name = words[2];
+                value  = words[3];
+            }
+        }
+
+        if(unlikely(!name || !*name)) {
+            error("requested a VARIABLE on host '%s', without a variable name. Disabling it.", host->hostname);
+            goto disable;
+        }
+
+        if(unlikely(!value || !*value))
+            value = NULL;
 
-            long multiplier = 1;
-            if(multiplier_s && *multiplier_s) multiplier = strtol(multiplier_s, NULL, 0);
-            if(unlikely(!multiplier)) multiplier = 1;
-
-            long divisor = 1;
-            if(likely(divisor_s && *divisor_s)) divisor = strtol(divisor_s, NULL, 0);
-            if(unlikely(!divisor)) divisor = 1;
-
-            if(unlikely(!algorithm || !*algorithm)) algorithm = "absolute";
-
-            if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG)))
-                debug(D_PLUGINSD, "creating dimension in chart %s, id='%s', name='%s', algorithm='%s', multiplier=%ld, divisor=%ld, hidden='%s'"
-                      , st->id
-                      , id
-                      , name?name:""
-                      , rrd_algorithm_name(rrd_algorithm_id(algorithm))
-                      , multiplier
-                      , divisor
-                      , options?options:""
-                );
-
-            RRDDIM *rd = rrddim_add(st, id, name, multiplier, divisor, rrd_algorithm_id(algorithm));
-            rrddim_flag_clear(rd, RRDDIM_FLAG_HIDDEN);
-            rrddim_flag_clear(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS);
-            if(options && *options) {
-                if(strstr(options, "obsolete") != NULL)
-                    rrddim_is_obsolete(st, rd);
+        if(value) {
+            char *endptr = NULL;
+            calculated_number v = (calculated_number)str2ld(value, &endptr);
+
+            if(unlikely(endptr && *endptr)) {
+                if(endptr == value)
+                    error("the value '%s' of VARIABLE '%s' on host '%s' cannot be parsed as a number", value, name, host->hostname);
                 else
-                    rrddim_isnot_obsolete(st, rd);
-                if(strstr(options, "hidden") != NULL) rrddim_flag_set(rd, RRDDIM_FLAG_HIDDEN);
-                if(strstr(options, "noreset") != NULL) rrddim_flag_set(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS);
-                if(strstr(options, "nooverflow") != NULL) rrddim_flag_set(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS);
+                    error("the value '%s' of VARIABLE '%s' on host '%s' has leftovers: '%s'", value, name, host->hostname, endptr);
             }
-            else {
-                rrddim_isnot_obsolete(st, rd);
+
+            if(global) {
+                RRDVAR *rv = rrdvar_custom_host_variable_create(host, name);
+                if (rv) rrdvar_custom_host_variable_set(host, rv, v);
+                else error("cannot find/create HOST VARIABLE '%s' on host '%s'", name, host->hostname);
+            }
+            else if(st) {
+                RRDSETVAR *rs = rrdsetvar_custom_chart_variable_create(st, name);
+                if (rs) rrdsetvar_custom_chart_variable_set(rs, v);
+                else error("cannot find/create CHART VARIABLE '%s' on host '%s', chart '%s'", name, host->hostname, st->id);
             }
+            else if(!p->shedding)
+                error("cannot find/create CHART VARIABLE '%s' on host '%s' without a chart", name, host->hostname);
         }
-        else if(likely(hash == VARIABLE_HASH && !strcmp(s, PLUGINSD_KEYWORD_VARIABLE))) {
-            char *name = words[1];
-            char *value = words[2];
-            int global = (st)?0:1;
+        else
+            error("cannot set %s VARIABLE '%s' on host '%s' to an empty value", (global)?"HOST":"CHART", name, host->hostname);
+    }
+    else if(likely(hash == REPLAY_SET_HASH && !strcmp(s, PLUGINSD_KEYWORD_REPLAY_SET))) {
+        char *dimension = words[1];
+        char *timestamp = words[2];
 
-            if(name && *name) {
-                if((strcmp(name, "GLOBAL") == 0 || strcmp(name, "HOST") == 0)) {
-                    global = 1;
-                    name = words[2];
-                    value  = words[3];
-                }
-                else if((strcmp(name, "LOCAL") == 0 || strcmp(name, "CHART") == 0)) {
-                    global = 0;
-                    name = words[2];
-                    value  = words[3];
-                }
-            }
+        if(unlikely(!p->replies || !dimension || !*dimension || !timestamp || !*timestamp)) {
+            error("requested a REPLAY_SET without replication, a dimension or a timestamp, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
 
-            if(unlikely(!name || !*name)) {
-                error("requested a VARIABLE on host '%s', without a variable name. Disabling it.", host->hostname);
-                enabled = 0;
-                break;
+        // the chart may not be replicating any more, when it was asked for on a previous connection
+        RRDSET *rst = p->replay_st;
+        if(likely(rst)) {
+            RRDDIM *rd = rrddim_find(rst, dimension);
+            if(likely(rd)) {
+                time_t t = (time_t)str2ull(timestamp);
+                int i;
+
+                for(i = 3; i < w && words[i] ; i++, t += rst->update_every)
+                    rrddim_replay_store(rd, t, (storage_number)strtoul(words[i], NULL, 16));
             }
+            else
+                error("requested a REPLAY_SET to dimension with id '%s' on chart '%s' of host '%s', which does not exist.", dimension, rst->id, host->hostname);
+        }
+    }
+    else if(likely(hash == REPLAY_BEGIN_HASH && !strcmp(s, PLUGINSD_KEYWORD_REPLAY_BEGIN))) {
+        char *id = words[1];
+        char *first = words[2];
+        char *last = words[3];
+
+        if(unlikely(!p->replies || !id || !*id || !first || !*first || !last || !*last)) {
+            error("requested a REPLAY_BEGIN without replication, a chart id or timestamps, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
 
-            if(unlikely(!value || !*value))
-                value = NULL;
+        RRDSET *rst = rrdset_find(host, id);
+        if(unlikely(!rst)) {
+            error("requested a REPLAY_BEGIN on chart '%s', which does not exist on host '%s'. Disabling it.", id, host->hostname);
+            goto disable;
+        }
 
-            if(value) {
-                char *endptr = NULL;
-                calculated_number v = (calculated_number)str2ld(value, &endptr);
+        p->replay_st = NULL;
+        if(likely(rrdset_flag_check(rst, RRDSET_FLAG_REPLICATING))) {
+            rrdset_replay_begin(rst, (time_t)str2ull(first), (time_t)str2ull(last));
+            p->replay_st = rst;
+        }
+    }
+    else if(likely(hash == REPLAY_END_HASH && !strcmp(s, PLUGINSD_KEYWORD_REPLAY_END))) {
+        char *id = words[1];
 
-                if(unlikely(endptr && *endptr)) {
-                    if(endptr == value)
-                        error("the value '%s' of VARIABLE '%s' on host '%s' cannot be parsed as a number", value, name, host->hostname);
-                    else
-                        error("the value '%s' of VARIABLE '%s' on host '%s' has leftovers: '%s'", value, name, host->hostname, endptr);
-                }
+        if(unlikely(!p->replies || !id || !*id)) {
+            error("requested a REPLAY_END without replication or a chart id, on host '%s'. Disabling it.", host->hostname);
+            goto disable;
+        }
 
-                if(global) {
-                    RRDVAR *rv = rrdvar_custom_host_variable_create(host, name);
-                    if (rv) rrdvar_custom_host_variable_set(host, rv, v);
-                    else error("cannot find/create HOST VARIABLE '%s' on host '%s'", name, host->hostname);
-                }
-                else if(st) {
-                    RRDSETVAR *rs = rrdsetvar_custom_chart_variable_create(st, name);
-                    if (rs) rrdsetvar_custom_chart_variable_set(rs, v);
-                    else error("cannot find/create CHART VARIABLE '%s' on host '%s', chart '%s'", name, host->hostname, st->id);
-                }
-                else
-                    error("cannot find/create CHART VARIABLE '%s' on host '%s' without a chart", name, host->hostname);
+        RRDSET *rst = rrdset_find(host, id);
+        if(likely(rst && rrdset_flag_check(rst, RRDSET_FLAG_REPLICATING))) {
+            rrdset_replay_end(rst);
+            rrdset_flag_set(rst, RRDSET_FLAG_REPLICATED);
+            rrdset_flag_clear(rst, RRDSET_FLAG_REPLICATING);
+        }
+
+        p->replay_st = NULL;
+    }
+    else if(likely(hash == FLUSH_HASH && !strcmp(s, PLUGINSD_KEYWORD_FLUSH))) {
+        debug(D_PLUGINSD, "requested a FLUSH");
+        st = NULL;
+        p->set_st = NULL;
+    }
+    else if(unlikely(hash == DISABLE_HASH && !strcmp(s, PLUGINSD_KEYWORD_DISABLE))) {
+        info("called DISABLE. Disabling it.");
+        goto disable;
+    }
+    else {
+        error("sent command '%s' which is not known by netdata, for host '%s'. Disabling it.", s, host->hostname);
+        goto disable;
+    }
+
+    p->st = st;
+    return 0;
+
+disable:
+    p->st = st;
+    return 1;
+}
+
+// applies the frames the plugin has written to its shared memory ring
+static int pluginsd_ring_drain(struct pluginsd_parser *p) {
+    struct pluginsd_ring *ring = p->ring;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->tail;
+    int ret = 0;
+
+    // the ring has only frames and padding, not the byte that rings it
+    p->ring = NULL;
+
+    while(tail < head) {
+        size_t pos = (size_t)(tail % ring->size);
+        size_t len = (size_t)(head - tail);
+        if(len > ring->size - pos) len = (size_t)(ring->size - pos);
+
+        ssize_t used = pluginsd_parse_buffer(p, &ring->data[pos], len);
+        if(unlikely(used < 0 || (size_t)used != len)) {
+            if(used >= 0)
+                error("received an incomplete frame in the shared memory ring on host '%s'. Disabling it.", p->host->hostname);
+            ret = 1;
+            break;
+        }
+
+        tail += len;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    p->ring = ring;
+    return ret;
+}
+
+// processes the complete lines and binary frames of the len bytes at buf, which are modified
+// returns the bytes processed - the rest have to be given again, with the data that follow
+// them - or -1 when the plugin has to be disabled
+ssize_t pluginsd_parse_buffer(struct pluginsd_parser *p, char *buf, size_t len) {
+    size_t pos = 0;
+
+    while(pos < len) {
+        if(unlikely(netdata_exit))
+            return -1;
+
+        if(p->ring && buf[pos] == PLUGINSD_BINARY_FRAME_RING) {
+            if(unlikely(pluginsd_ring_drain(p)))
+                return -1;
+
+            pos++;
+            continue;
+        }
+
+        if(p->binary && buf[pos] == PLUGINSD_BINARY_FRAME_METRICS) {
+            ssize_t size = pluginsd_binary_frame_size(&buf[pos], len - pos);
+            if(unlikely(size < 0)) {
+                error("received an invalid metrics frame on host '%s'. Disabling it.", p->host->hostname);
+                return -1;
             }
-            else
-                error("cannot set %s VARIABLE '%s' on host '%s' to an empty value", (global)?"HOST":"CHART", name, host->hostname);
+            if(!size)
+                break;
+
+            if(unlikely(pluginsd_binary_metrics(p, &buf[pos], (size_t)size)))
+                return -1;
+
+            pos += (size_t)size;
+            continue;
         }
-        else if(likely(hash == FLUSH_HASH && !strcmp(s, PLUGINSD_KEYWORD_FLUSH))) {
-            debug(D_PLUGINSD, "requested a FLUSH");
-            st = NULL;
+
+        // like fgets(), longer lines are split
+        size_t max = len - pos;
+        if(max > PLUGINSD_LINE_MAX - 1) max = PLUGINSD_LINE_MAX - 1;
+
+        char *line = &buf[pos], *eol = memchr(line, '\n', max);
+        if(likely(eol)) {
+            *eol = '\0';
+            pos += eol - line + 1;
         }
-        else if(unlikely(hash == DISABLE_HASH && !strcmp(s, PLUGINSD_KEYWORD_DISABLE))) {
-            info("called DISABLE. Disabling it.");
-            enabled = 0;
+        else if(max == PLUGINSD_LINE_MAX - 1) {
+            char saved = line[max];
+            line[max] = '\0';
+            int ret = pluginsd_parse_line(p, line);
+            line[max] = saved;
+            if(unlikely(ret))
+                return -1;
+
+            pos += max;
+            continue;
+        }
+        else
+            break;
+
+        if(unlikely(pluginsd_parse_line(p, line)))
+            return -1;
+    }
+
+    return (ssize_t)pos;
+}
+
+inline size_t pluginsd_process(RRDHOST *host, struct plugind *cd, FILE *fp, int trust_durations) {
+    int enabled = cd->enabled;
+
+    if(!fp || !enabled) {
+        cd->enabled = 0;
+        return 0;
+    }
+
+    // the plugin switches to the binary protocol with its BINARY banner
+    struct pluginsd_parser *p = pluginsd_parser_create(host, cd, trust_durations, 0, NULL);
+
+    // the pipe is read in blocks, not with stdio, so that binary frames can be parsed in place
+    int fd = fileno(fp);
+    size_t size = PLUGINSD_READ_BUFFER, len = 0;
+    char *buf = mallocz(size + 1);
+
+    while(!netdata_exit) {
+        if(unlikely(len == size)) {
+            // a binary frame larger than the buffer
+            size *= 2;
+            buf = reallocz(buf, size + 1);
+        }
+
+        ssize_t bytes = read(fd, &buf[len], size - len);
+        if(unlikely(bytes <= 0)) {
+            if(bytes == -1 && errno == EINTR)
+                continue;
+
+            error("read failed");
             break;
         }
-        else {
-            error("sent command '%s' which is not known by netdata, for host '%s'. Disabling it.", s, host->hostname);
+
+        if(unlikely(netdata_exit)) break;
+
+        len += (size_t)bytes;
+        buf[len] = '\0';
+
+        ssize_t used = pluginsd_parse_buffer(p, buf, len);
+        if(unlikely(used < 0)) {
             enabled = 0;
             break;
         }
+
+        len -= (size_t)used;
+        if(used && len)
+            memmove(buf, &buf[used], len);
     }
 
-cleanup:
-    cd->enabled = enabled;
+    freez(buf);
+    return pluginsd_parser_free(p, enabled);
+}
 
-    if(likely(count)) {
-        cd->successful_collections += count;
-        cd->serial_failures = 0;
+// ----------------------------------------------------------------------------
+// the shared memory rings of the plugins
+
+static char *pluginsd_ring_dir = NULL;      // NULL when the rings are disabled
+static size_t pluginsd_ring_size = 0;
+
+static void pluginsd_ring_filename(struct plugind *cd, char *filename, size_t len) {
+    snprintfz(filename, len, "%s/%s" PLUGINSD_RING_SUFFIX, pluginsd_ring_dir, cd->filename);
+}
+
+static void pluginsd_rings_init(void) {
+    pluginsd_ring_size = (size_t)config_get_number(CONFIG_SECTION_PLUGINS, "shared memory ring size", 1024 * 1024);
+    if(!pluginsd_ring_size)
+        return;
+
+    if(pluginsd_ring_size < 4096)
+        pluginsd_ring_size = 4096;
+
+    char dir[FILENAME_MAX + 1];
+    snprintfz(dir, FILENAME_MAX, "%s/netdata-%d", config_get(CONFIG_SECTION_PLUGINS, "shared memory rings directory", "/dev/shm"), (int)getpid());
+
+    if(mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        error("cannot create the directory '%s' of the shared memory rings of the plugins. The plugins will not have rings.", dir);
+        return;
     }
-    else
-        cd->serial_failures++;
 
-    return count;
+    pluginsd_ring_dir = strdupz(dir);
+    setenv("NETDATA_PLUGINS_RING_DIR", pluginsd_ring_dir, 1);
+}
+
+// creates the ring of the plugin, before it is started
+static void pluginsd_ring_create(struct plugind *cd) {
+    if(!pluginsd_ring_dir)
+        return;
+
+    char filename[FILENAME_MAX + 1];
+    pluginsd_ring_filename(cd, filename, FILENAME_MAX);
+
+    size_t size = PLUGINSD_RING_FILE_SIZE(pluginsd_ring_size);
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(fd == -1 || ftruncate(fd, (off_t)size) == -1) {
+        error("cannot create the shared memory ring '%s' of plugin '%s'", filename, cd->fullfilename);
+        if(fd != -1) close(fd);
+        return;
+    }
+
+    struct pluginsd_ring *ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(ring == MAP_FAILED) {
+        error("cannot map the shared memory ring '%s' of plugin '%s'", filename, cd->fullfilename);
+        unlink(filename);
+        return;
+    }
+
+    ring->size = pluginsd_ring_size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->version = PLUGINSD_RING_VERSION;
+    __atomic_store_n(&ring->magic, PLUGINSD_RING_MAGIC, __ATOMIC_RELEASE);
+
+    cd->ring = ring;
+}
+
+// removes the ring of the plugin, after it has exited
+static void pluginsd_ring_destroy(struct plugind *cd) {
+    if(!cd->ring)
+        return;
+
+    char filename[FILENAME_MAX + 1];
+    pluginsd_ring_filename(cd, filename, FILENAME_MAX);
+
+    munmap(cd->ring, PLUGINSD_RING_FILE_SIZE(cd->ring->size));
+    unlink(filename);
+    cd->ring = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// the resources used by the plugins
+
+#define PLUGINSD_CPU_BUDGET_WINDOW 60   // seconds
+
+static int pluginsd_max_update_every = 60;
+static unsigned long long pluginsd_page_size = 4096;
+
+static void pluginsd_cmd(struct plugind *cd) {
+    char *def = "";
+    snprintfz(cd->cmd, PLUGINSD_CMD_MAX, "exec %s %d %s", cd->fullfilename, cd->update_every, config_get(cd->id, "command options", def));
+}
+
+static void pluginsd_usage_read(struct plugind *cd) {
+    struct plugind_usage *u = &cd->usage;
+    pid_t pid = cd->pid;
+
+    if(unlikely(pid != u->pid)) {
+        // the ticks of the previous process are final
+        u->base_ticks += u->run_ticks;
+        u->run_ticks = 0;
+        u->rss = 0;
+        u->pid = pid;
+    }
+
+    if(unlikely(!pid)) return;
+
+    char filename[FILENAME_MAX + 1], buffer[1024 + 1];
+    snprintfz(filename, FILENAME_MAX, "/proc/%d/stat", pid);
+    if(unlikely(read_file(filename, buffer, 1024))) return;
+
+    // the process name may have spaces and parenthesis in it
+    char *s = strrchr(buffer, ')');
+    if(unlikely(!s)) return;
+
+    unsigned long long ticks = 0, rss = 0;
+    int field;
+    for(field = 3, s++; *s && field <= 24 ; field++) {
+        while(*s == ' ') s++;
+
+        if(field >= 14 && field <= 17) ticks += str2ull(s);     // utime, stime, cutime, cstime
+        else if(field == 24) rss = str2ull(s);                  // pages
+
+        while(*s && *s != ' ') s++;
+    }
+
+    if(unlikely(field <= 24)) return;
+
+    if(likely(ticks > u->run_ticks)) u->run_ticks = ticks;
+    u->rss = rss * pluginsd_page_size;
+}
+
+static void pluginsd_usage_check_budget(struct plugind *cd, time_t now) {
+    struct plugind_usage *u = &cd->usage;
+    unsigned long long ticks = u->base_ticks + u->run_ticks;
+
+    if(unlikely(!u->window_started_t)) {
+        u->window_started_t = now;
+        u->window_ticks = ticks;
+        return;
+    }
+
+    time_t elapsed = now - u->window_started_t;
+    if(likely(elapsed < PLUGINSD_CPU_BUDGET_WINDOW)) return;
+
+    double percent = (double)(ticks - u->window_ticks) * 100.0 / (double)system_hz / (double)elapsed;
+    u->window_started_t = now;
+    u->window_ticks = ticks;
+
+    if(likely(!cd->cpu_budget || !u->pid || cd->restart || percent <= (double)cd->cpu_budget)) return;
+
+    if(unlikely(cd->update_every >= pluginsd_max_update_every)) {
+        debug(D_PLUGINSD, "'%s' (pid %d) used %0.1f%% cpu, over its budget of %d%%, but it already collects data every %d seconds.", cd->fullfilename, u->pid, percent, cd->cpu_budget, cd->update_every);
+        return;
+    }
+
+    int update_every = cd->update_every * 2;
+    if(update_every > pluginsd_max_update_every) update_every = pluginsd_max_update_every;
+
+    error("'%s' (pid %d) used %0.1f%% cpu in the last %ld seconds, over its budget of %d%%. Restarting it to collect data every %d seconds, instead of %d.", cd->fullfilename, u->pid, percent, (long)elapsed, cd->cpu_budget, update_every, cd->update_every);
+
+    // the worker thread restarts it with the new update_every on its command line
+    cd->update_every = update_every;
+    cd->restart = 1;
+    killpid(u->pid, SIGTERM);
+}
+
+static void pluginsd_usage_update(time_t now) {
+    static RRDSET *st_cpu = NULL, *st_mem = NULL;
+
+    if(unlikely(!st_cpu)) {
+        st_cpu = rrdset_create_localhost(
+                "netdata"
+                , "plugins_cpu"
+                , NULL
+                , "plugins"
+                , NULL
+                , "External Plugins CPU Time"
+                , "milliseconds/s"
+                , "netdata"
+                , "plugins.d"
+                , 130540
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_STACKED
+        );
+
+        st_mem = rrdset_create_localhost(
+                "netdata"
+                , "plugins_memory"
+                , NULL
+                , "plugins"
+                , NULL
+                , "External Plugins Resident Memory"
+                , "MiB"
+                , "netdata"
+                , "plugins.d"
+                , 130541
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_STACKED
+        );
+    }
+    else {
+        rrdset_next(st_cpu);
+        rrdset_next(st_mem);
+    }
+
+    struct plugind *cd;
+    for(cd = pluginsd_root; cd ; cd = cd->next) {
+        struct plugind_usage *u = &cd->usage;
+
+        pluginsd_usage_read(cd);
+
+        if(unlikely(!u->rd_cpu)) {
+            // the plugins that never ran are not charted
+            if(!u->pid) continue;
+
+            u->rd_cpu = rrddim_add(st_cpu, cd->filename, NULL, 1000, system_hz, RRD_ALGORITHM_INCREMENTAL);
+            u->rd_mem = rrddim_add(st_mem, cd->filename, NULL, 1, 1024 * 1024, RRD_ALGORITHM_ABSOLUTE);
+        }
+
+        rrddim_set_by_pointer(st_cpu, u->rd_cpu, (collected_number)(u->base_ticks + u->run_ticks));
+        rrddim_set_by_pointer(st_mem, u->rd_mem, (collected_number)u->rss);
+
+        pluginsd_usage_check_budget(cd, now);
+    }
+
+    rrdset_done(st_cpu);
+    rrdset_done(st_mem);
 }
 
 static void pluginsd_worker_thread_cleanup(void *arg) {
@@ -518,6 +1389,8 @@ static void pluginsd_worker_thread_cleanup(void *arg) {
             }
             cd->pid = 0;
         }
+
+        pluginsd_ring_destroy(cd);
     }
 }
 
@@ -530,9 +1403,12 @@ void *pluginsd_worker_thread(void *arg) {
     size_t count = 0;
 
     while(!netdata_exit) {
+        pluginsd_ring_create(cd);
+
         FILE *fp = mypopen(cd->cmd, &cd->pid);
         if(unlikely(!fp)) {
             error("Cannot popen(\"%s\", \"r\").", cd->cmd);
+            pluginsd_ring_destroy(cd);
             break;
         }
 
@@ -543,6 +1419,16 @@ void *pluginsd_worker_thread(void *arg) {
 
         // get the return code
         int code = mypclose(fp, cd->pid);
+        pluginsd_ring_destroy(cd);
+
+        if(unlikely(cd->restart)) {
+            // it was stopped for exceeding its cpu budget - start it again now
+            cd->restart = 0;
+            cd->pid = 0;
+            pluginsd_cmd(cd);
+            info("restarting '%s' to collect data every %d seconds.", cd->fullfilename, cd->update_every);
+            continue;
+        }
 
         if(code != 0) {
             // the plugin reports failure
@@ -605,6 +1491,9 @@ static void pluginsd_main_cleanup(void *data) {
         }
     }
 
+    if(pluginsd_ring_dir)
+        rmdir(pluginsd_ring_dir);
+
     info("cleanup completed.");
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
@@ -616,98 +1505,125 @@ void *pluginsd_main(void *ptr) {
     int scan_frequency = (int) config_get_number(CONFIG_SECTION_PLUGINS, "check for new plugins every", 60);
     if(scan_frequency < 1) scan_frequency = 1;
 
+    int cpu_budget = (int) config_get_number(CONFIG_SECTION_PLUGINS, "plugins cpu budget percent", 0);
+    if(cpu_budget < 0) cpu_budget = 0;
+
+    pluginsd_max_update_every = (int) config_get_number(CONFIG_SECTION_PLUGINS, "throttled plugins max update every", 60);
+    if(pluginsd_max_update_every < 1) pluginsd_max_update_every = 1;
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    if(page_size > 0) pluginsd_page_size = (unsigned long long)page_size;
+
+    pluginsd_rings_init();
+
     // store the errno for each plugins directory
     // so that we don't log broken directories on each loop
     int directory_errors[PLUGINSD_MAX_DIRECTORIES] =  { 0 };
 
+    heartbeat_t hb;
+    heartbeat_init(&hb);
+    usec_t step = (usec_t)localhost->rrd_update_every * USEC_PER_SEC;
+    time_t next_scan_t = 0;
+
     while(!netdata_exit) {
-        int idx;
-        const char *directory_name;
-
-        for( idx = 0; idx < PLUGINSD_MAX_DIRECTORIES && (directory_name = plugin_directories[idx]) ; idx++ ) {
-            if(unlikely(netdata_exit)) break;
-
-            errno = 0;
-            DIR *dir = opendir(directory_name);
-            if(unlikely(!dir)) {
-                if(directory_errors[idx] != errno) {
-                    directory_errors[idx] = errno;
-                    error("cannot open plugins directory '%s'", directory_name);
-                }
-                continue;
-            }
+        time_t now = now_monotonic_sec();
 
-            struct dirent *file = NULL;
-            while(likely((file = readdir(dir)))) {
-                if(unlikely(netdata_exit)) break;
+        if(unlikely(now >= next_scan_t)) {
+            next_scan_t = now + scan_frequency;
 
-                debug(D_PLUGINSD, "examining file '%s'", file->d_name);
+            int idx;
+            const char *directory_name;
 
-                if(unlikely(strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)) continue;
+            for( idx = 0; idx < PLUGINSD_MAX_DIRECTORIES && (directory_name = plugin_directories[idx]) ; idx++ ) {
+                if(unlikely(netdata_exit)) break;
 
-                int len = (int) strlen(file->d_name);
-                if(unlikely(len <= (int)PLUGINSD_FILE_SUFFIX_LEN)) continue;
-                if(unlikely(strcmp(PLUGINSD_FILE_SUFFIX, &file->d_name[len - (int)PLUGINSD_FILE_SUFFIX_LEN]) != 0)) {
-                    debug(D_PLUGINSD, "file '%s' does not end in '%s'", file->d_name, PLUGINSD_FILE_SUFFIX);
+                errno = 0;
+                DIR *dir = opendir(directory_name);
+                if(unlikely(!dir)) {
+                    if(directory_errors[idx] != errno) {
+                        directory_errors[idx] = errno;
+                        error("cannot open plugins directory '%s'", directory_name);
+                    }
                     continue;
                 }
 
-                char pluginname[CONFIG_MAX_NAME + 1];
-                snprintfz(pluginname, CONFIG_MAX_NAME, "%.*s", (int)(len - PLUGINSD_FILE_SUFFIX_LEN), file->d_name);
-                int enabled = config_get_boolean(CONFIG_SECTION_PLUGINS, pluginname, automatic_run);
+                struct dirent *file = NULL;
+                while(likely((file = readdir(dir)))) {
+                    if(unlikely(netdata_exit)) break;
 
-                if(unlikely(!enabled)) {
-                    debug(D_PLUGINSD, "plugin '%s' is not enabled", file->d_name);
-                    continue;
-                }
+                    debug(D_PLUGINSD, "examining file '%s'", file->d_name);
 
-                // check if it runs already
-                struct plugind *cd;
-                for(cd = pluginsd_root ; cd ; cd = cd->next)
-                    if(unlikely(strcmp(cd->filename, file->d_name) == 0)) break;
+                    if(unlikely(strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)) continue;
 
-                if(likely(cd && !cd->obsolete)) {
-                    debug(D_PLUGINSD, "plugin '%s' is already running", cd->filename);
-                    continue;
-                }
+                    int len = (int) strlen(file->d_name);
+                    if(unlikely(len <= (int)PLUGINSD_FILE_SUFFIX_LEN)) continue;
+                    if(unlikely(strcmp(PLUGINSD_FILE_SUFFIX, &file->d_name[len - (int)PLUGINSD_FILE_SUFFIX_LEN]) != 0)) {
+                        debug(D_PLUGINSD, "file '%s' does not end in '%s'", file->d_name, PLUGINSD_FILE_SUFFIX);
+                        continue;
+                    }
+
+                    char pluginname[CONFIG_MAX_NAME + 1];
+                    snprintfz(pluginname, CONFIG_MAX_NAME, "%.*s", (int)(len - PLUGINSD_FILE_SUFFIX_LEN), file->d_name);
+                    int enabled = config_get_boolean(CONFIG_SECTION_PLUGINS, pluginname, automatic_run);
+
+                    if(unlikely(!enabled)) {
+                        debug(D_PLUGINSD, "plugin '%s' is not enabled", file->d_name);
+                        continue;
+                    }
+
+                    // check if it runs already
+                    struct plugind *cd;
+                    for(cd = pluginsd_root ; cd ; cd = cd->next)
+                        if(unlikely(strcmp(cd->filename, file->d_name) == 0)) break;
+
+                    if(likely(cd && !cd->obsolete)) {
+                        debug(D_PLUGINSD, "plugin '%s' is already running", cd->filename);
+                        continue;
+                    }
 
-                // it is not running
-                // allocate a new one, or use the obsolete one
-                if(unlikely(!cd)) {
-                    cd = callocz(sizeof(struct plugind), 1);
+                    // it is not running
+                    // allocate a new one, or use the obsolete one
+                    if(unlikely(!cd)) {
+                        cd = callocz(sizeof(struct plugind), 1);
 
-                    snprintfz(cd->id, CONFIG_MAX_NAME, "plugin:%s", pluginname);
+                        snprintfz(cd->id, CONFIG_MAX_NAME, "plugin:%s", pluginname);
 
-                    strncpyz(cd->filename, file->d_name, FILENAME_MAX);
-                    snprintfz(cd->fullfilename, FILENAME_MAX, "%s/%s", directory_name, cd->filename);
+                        strncpyz(cd->filename, file->d_name, FILENAME_MAX);
+                        snprintfz(cd->fullfilename, FILENAME_MAX, "%s/%s", directory_name, cd->filename);
 
-                    cd->enabled = enabled;
-                    cd->update_every = (int) config_get_number(cd->id, "update every", localhost->rrd_update_every);
-                    cd->started_t = now_realtime_sec();
+                        cd->enabled = enabled;
+                        cd->update_every = (int) config_get_number(cd->id, "update every", localhost->rrd_update_every);
+                        cd->cpu_budget = (int) config_get_number(cd->id, "cpu budget percent", cpu_budget);
+                        if(cd->cpu_budget < 0) cd->cpu_budget = 0;
+                        cd->started_t = now_realtime_sec();
 
-                    char *def = "";
-                    snprintfz(cd->cmd, PLUGINSD_CMD_MAX, "exec %s %d %s", cd->fullfilename, cd->update_every, config_get(cd->id, "command options", def));
+                        pluginsd_cmd(cd);
 
-                    // link it
-                    if(likely(pluginsd_root)) cd->next = pluginsd_root;
-                    pluginsd_root = cd;
+                        // link it
+                        if(likely(pluginsd_root)) cd->next = pluginsd_root;
+                        pluginsd_root = cd;
 
-                    // it is not currently running
-                    cd->obsolete = 1;
+                        // it is not currently running
+                        cd->obsolete = 1;
 
-                    if(cd->enabled) {
-                        char tag[NETDATA_THREAD_TAG_MAX + 1];
-                        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "PLUGINSD[%s]", pluginname);
-                        // spawn a new thread for it
-                        netdata_thread_create(&cd->thread, tag, NETDATA_THREAD_OPTION_DEFAULT, pluginsd_worker_thread, cd);
+                        if(cd->enabled) {
+                            char tag[NETDATA_THREAD_TAG_MAX + 1];
+                            snprintfz(tag, NETDATA_THREAD_TAG_MAX, "PLUGINSD[%s]", pluginname);
+                            // spawn a new thread for it
+                            netdata_thread_create(&cd->thread, tag, NETDATA_THREAD_OPTION_DEFAULT, pluginsd_worker_thread, cd);
+                        }
                     }
                 }
-            }
 
-            closedir(dir);
+                closedir(dir);
+            }
         }
 
-        sleep((unsigned int) scan_frequency);
+        if(unlikely(netdata_exit)) break;
+
+        pluginsd_usage_update(now);
+
+        heartbeat_next(&hb, step);
     }
 
     netdata_thread_cleanup_pop(1);
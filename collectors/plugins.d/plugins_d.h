@@ -4,6 +4,8 @@
 #define NETDATA_PLUGINS_D_H 1
 
 #include "../../daemon/common.h"
+#include "pluginsd_binary.h"
+#include "pluginsd_ring.h"
 
 #define NETDATA_PLUGIN_HOOK_PLUGINSD \
     { \
@@ -29,13 +31,60 @@
 #define PLUGINSD_KEYWORD_FLUSH "FLUSH"
 #define PLUGINSD_KEYWORD_DISABLE "DISABLE"
 #define PLUGINSD_KEYWORD_VARIABLE "VARIABLE"
+#define PLUGINSD_KEYWORD_BIND "BIND"
+#define PLUGINSD_KEYWORD_REPLICATE "REPLICATE"
+#define PLUGINSD_KEYWORD_REPLAY_BEGIN "REPLAY_BEGIN"
+#define PLUGINSD_KEYWORD_REPLAY_SET "REPLAY_SET"
+#define PLUGINSD_KEYWORD_REPLAY_END "REPLAY_END"
+#define PLUGINSD_KEYWORD_DEFINITION "DEFINITION"
+#define PLUGINSD_KEYWORD_DEFINITIONS_END "DEFINITIONS_END"
+#define PLUGINSD_KEYWORD_CHART_DEFINED "CHART_DEFINED"
+#define PLUGINSD_KEYWORD_BINARY "BINARY"
+#define PLUGINSD_KEYWORD_RING "RING"
+
+// the binary protocol of streaming and of the external plugins is in pluginsd_binary.h,
+// the shared memory ring of the external plugins in pluginsd_ring.h
+
+// the replication of streaming
+//
+// the receiving netdata replies to the CHART of a chart it stores with REPLICATE "CHART_ID" AFTER,
+// and does not store the collected values of the chart until the sending netdata replies with
+// the values it has stored after the timestamp AFTER, in slices of consecutive values:
+//
+// REPLAY_BEGIN "CHART_ID" FIRST LAST, the timestamps of the first and the last value of the slice
+// REPLAY_SET "DIMENSION_ID" TIMESTAMP N1 N2 ..., consecutive stored values in hex, from TIMESTAMP
+// REPLAY_END "CHART_ID", after the last slice
+#define PLUGINSD_REPLAY_MAX_VALUES 16
+
+// the definitions of the charts, when streaming reconnects
+//
+// the receiving netdata sends, right after its reply, DEFINITION "CHART_ID" HASH for every chart
+// it has, the hash of the CHART and DIMENSION lines of its definition, followed by DEFINITIONS_END.
+// The sending netdata sends CHART_DEFINED "CHART_ID" instead of the CHART and DIMENSION lines of
+// the charts that have the same definition - the dimensions are the ones of the receiving netdata,
+// in the same order.
 
 #define PLUGINSD_LINE_MAX 1024
+#define PLUGINSD_READ_BUFFER (64 * 1024)
 #define PLUGINSD_MAX_WORDS 20
 
 #define PLUGINSD_MAX_DIRECTORIES 20
 extern char *plugin_directories[PLUGINSD_MAX_DIRECTORIES];
 
+// the resources used by a plugin, read from /proc/PID/stat of its process
+// by the main plugins.d thread, once per second
+struct plugind_usage {
+    pid_t pid;                          // the process the ticks below are of
+    unsigned long long run_ticks;       // utime + stime + cutime + cstime of the running process
+    unsigned long long base_ticks;      // the ticks of its processes that have exited
+    unsigned long long window_ticks;    // the total ticks when the cpu budget window started
+    time_t window_started_t;
+    unsigned long long rss;             // bytes
+
+    RRDDIM *rd_cpu;
+    RRDDIM *rd_mem;
+};
+
 struct plugind {
     char id[CONFIG_MAX_NAME+1];         // config node id
 
@@ -53,11 +102,17 @@ struct plugind {
                                         // without collecting values
 
     int update_every;                   // the plugin default data collection frequency
+    int cpu_budget;                     // the cpu percentage above which it is throttled, 0 = unlimited
+    volatile sig_atomic_t restart;      // restart it now, to collect data every update_every
     volatile sig_atomic_t obsolete;     // do not touch this structure after setting this to 1
     volatile sig_atomic_t enabled;      // if this is enabled or not
 
     time_t started_t;
 
+    struct pluginsd_ring *ring;         // the shared memory ring of the running plugin, or NULL
+
+    struct plugind_usage usage;
+
     struct plugind *next;
 };
 
@@ -66,6 +121,25 @@ extern struct plugind *pluginsd_root;
 extern void *pluginsd_main(void *ptr);
 
 extern size_t pluginsd_process(RRDHOST *host, struct plugind *cd, FILE *fp, int trust_durations);
+
+// the limits of the charts and dimensions a parser may create on its host
+// the new ones over them are shed: their definitions and values are ignored
+struct pluginsd_limits {
+    size_t max_charts;                  // 0 without a limit
+    size_t max_dimensions;              // 0 without a limit
+
+    size_t charts;                      // the charts of the host, with the ones created
+    size_t dimensions;                  // the dimensions of the host, with the ones created
+    size_t shed_charts;                 // the new charts refused
+    size_t shed_dimensions;             // the new dimensions refused
+    size_t points;                      // the values collected
+};
+
+struct pluginsd_parser;
+extern struct pluginsd_parser *pluginsd_parser_create(RRDHOST *host, struct plugind *cd, int trust_durations, int binary, BUFFER *replies);
+extern void pluginsd_parser_limits(struct pluginsd_parser *p, struct pluginsd_limits *limits);
+extern ssize_t pluginsd_parse_buffer(struct pluginsd_parser *p, char *buf, size_t len);
+extern size_t pluginsd_parser_free(struct pluginsd_parser *p, int enabled);
 extern int pluginsd_split_words(char *str, char **words, int max_words);
 
 extern int pluginsd_initialize_plugin_directories();
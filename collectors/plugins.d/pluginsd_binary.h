@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_PLUGINSD_BINARY_H
+#define NETDATA_PLUGINSD_BINARY_H 1
+
+// the binary protocol of streaming and of the external plugins
+//
+// streaming uses it when both sides support STREAMING_PROTOCOL_VERSION_BINARY, an external
+// plugin when it prints the line BINARY before its charts - netdata sets the environment
+// variable NETDATA_PLUGINS_BINARY to the version of the protocol it supports
+//
+// after the DIMENSION lines of a chart, the line BIND NUMBER gives the chart a number and
+// its dimensions their position in the definition. Then the metrics of a collection of the
+// chart are sent as a frame, instead of BEGIN, SET and END lines:
+//
+// PLUGINSD_BINARY_FRAME_METRICS, the number of the chart, the microseconds since its last
+// update, the position + 1 and the value of every updated dimension, 0
+//
+// the numbers are unsigned varints (7 bits per byte, the least significant first, the high
+// bit set on all bytes except the last), the values are zigzag encoded to be unsigned
+//
+// this header does not depend on libnetdata, so that the plugins written in C can include it
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define PLUGINSD_BINARY_FRAME_METRICS 0x01
+#define PLUGINSD_BINARY_FRAME_RING 0x02     // the frames are in the shared memory ring, see pluginsd_ring.h
+#define PLUGINSD_BINARY_VARINT_MAX 10
+#define PLUGINSD_BINARY_MAX_CHARTS (1024 * 1024)
+#define PLUGINSD_BINARY_VERSION 1
+
+// the bytes a frame with the metrics of that many dimensions may need
+#define PLUGINSD_BINARY_FRAME_MAX(dimensions) (2 + (2 + 2 * (size_t)(dimensions)) * PLUGINSD_BINARY_VARINT_MAX)
+
+// non-zero when the netdata running the plugin accepts binary frames
+static inline int pluginsd_binary_supported(void) {
+    const char *s = getenv("NETDATA_PLUGINS_BINARY");
+    return (s && atoi(s) >= PLUGINSD_BINARY_VERSION);
+}
+
+// the encoders write at s and return where they stopped
+
+static inline char *pluginsd_binary_put_varint(char *s, uint64_t value) {
+    while(value >= 0x80) {
+        *s++ = (char)(value | 0x80);
+        value >>= 7;
+    }
+    *s++ = (char)value;
+    return s;
+}
+
+// starts the frame of the chart bound to number
+// microseconds are the time since its last update, 0 on the first one
+static inline char *pluginsd_binary_begin(char *s, uint64_t number, uint64_t microseconds) {
+    *s++ = PLUGINSD_BINARY_FRAME_METRICS;
+    s = pluginsd_binary_put_varint(s, number);
+    return pluginsd_binary_put_varint(s, microseconds);
+}
+
+// sets the dimension at position (from 0, in the order of the DIMENSION lines) to value
+static inline char *pluginsd_binary_set(char *s, size_t position, int64_t value) {
+    s = pluginsd_binary_put_varint(s, (uint64_t)position + 1);
+    return pluginsd_binary_put_varint(s, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+// ends the frame, the values are committed like with END
+static inline char *pluginsd_binary_end(char *s) {
+    *s++ = 0;
+    return s;
+}
+
+#endif /* NETDATA_PLUGINSD_BINARY_H */
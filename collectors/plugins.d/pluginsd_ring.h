@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_PLUGINSD_RING_H
+#define NETDATA_PLUGINSD_RING_H 1
+
+// the shared memory ring of the external plugins
+//
+// before starting a plugin, netdata creates the file PLUGIN_FILENAME.ring in the directory of
+// the environment variable NETDATA_PLUGINS_RING_DIR (on tmpfs). A plugin using the binary
+// protocol may map it and print the line RING. Then, instead of writing its metrics frames
+// to its output, it writes them to the ring and, when it has written a batch of them, the
+// byte PLUGINSD_BINARY_FRAME_RING to its output. netdata applies the frames of the ring
+// when it reads that byte, so the frames of the ring are ordered with the lines of the pipe.
+//
+// the ring has a single producer (the plugin) and a single consumer (netdata): head and tail
+// count the bytes written and read since the ring was created. A frame is never split at the
+// end of the ring - the bytes left there are filled with '\n', which netdata ignores.
+// When the ring is full, the plugin writes the frame to its output, after ringing the ring.
+//
+// this header does not depend on libnetdata, so that the plugins written in C can include it
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pluginsd_binary.h"
+
+#define PLUGINSD_RING_MAGIC 0x474e4952 // "RING"
+#define PLUGINSD_RING_VERSION 1
+#define PLUGINSD_RING_SUFFIX ".ring"
+
+struct pluginsd_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                      // the bytes of data
+
+    uint64_t head __attribute__((aligned(64))); // written by the plugin
+    uint64_t tail __attribute__((aligned(64))); // written by netdata
+
+    char data[] __attribute__((aligned(64))); // size bytes, plus one netdata may terminate them with
+};
+
+// the bytes of the file of a ring with that many bytes of data
+#define PLUGINSD_RING_FILE_SIZE(size) (sizeof(struct pluginsd_ring) + (size_t)(size) + 1)
+
+// maps the ring netdata has created for the plugin with that filename
+// returns NULL when there is none - the plugin should then not print RING
+static inline struct pluginsd_ring *pluginsd_ring_open(const char *filename) {
+    const char *dir = getenv("NETDATA_PLUGINS_RING_DIR");
+    if(!dir || !*dir || !filename || !*filename)
+        return NULL;
+
+    const char *s = strrchr(filename, '/');
+    if(s) filename = s + 1;
+
+    char path[FILENAME_MAX + 1];
+    snprintf(path, FILENAME_MAX, "%s/%s" PLUGINSD_RING_SUFFIX, dir, filename);
+
+    int fd = open(path, O_RDWR);
+    if(fd == -1)
+        return NULL;
+
+    struct stat stat;
+    struct pluginsd_ring *ring = NULL;
+    if(fstat(fd, &stat) == 0 && (size_t)stat.st_size > sizeof(struct pluginsd_ring)) {
+        ring = mmap(NULL, (size_t)stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(ring == MAP_FAILED)
+            ring = NULL;
+        else if(ring->magic != PLUGINSD_RING_MAGIC || ring->version != PLUGINSD_RING_VERSION
+                || PLUGINSD_RING_FILE_SIZE(ring->size) != (size_t)stat.st_size) {
+            munmap(ring, (size_t)stat.st_size);
+            ring = NULL;
+        }
+    }
+
+    close(fd);
+    return ring;
+}
+
+// contiguous space for a frame of up to bytes, or NULL when the ring is full
+static inline char *pluginsd_ring_reserve(struct pluginsd_ring *ring, size_t bytes) {
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    size_t pos = (size_t)(head % ring->size);
+    size_t pad = (ring->size - pos < bytes)?(size_t)(ring->size - pos):0;
+
+    if(head + pad + bytes - tail > ring->size)
+        return NULL;
+
+    if(pad) {
+        memset(&ring->data[pos], '\n', pad);
+        __atomic_store_n(&ring->head, head + pad, __ATOMIC_RELEASE);
+        pos = 0;
+    }
+
+    return &ring->data[pos];
+}
+
+// publishes the frame written at the space given by pluginsd_ring_reserve(), up to end
+static inline void pluginsd_ring_commit(struct pluginsd_ring *ring, const char *end) {
+    uint64_t head = ring->head;
+    const char *start = &ring->data[head % ring->size];
+    __atomic_store_n(&ring->head, head + (uint64_t)(end - start), __ATOMIC_RELEASE);
+}
+
+#endif /* NETDATA_PLUGINSD_RING_H */
@@ -7,11 +7,15 @@ static struct proc_module {
     const char *dim;
 
     int enabled;
+    int group;                  // the thread group running it - 0 is the main thread
 
     int (*func)(int update_every, usec_t dt);
-    usec_t duration;
+    usec_t duration;            // the duration of its last run
+    usec_t duration_max;        // its longest run since the chart was updated
+    size_t overruns;            // its runs longer than the update every of its group, since the chart was updated
 
     RRDDIM *rd;
+    RRDDIM *rd_overruns;
 
 } proc_modules[] = {
 
@@ -49,17 +53,17 @@ static struct proc_module {
 
         // disk metrics
         { .name = "/proc/diskstats", .dim = "diskstats", .func = do_proc_diskstats },
-        { .name = "/proc/mdstat", .dim = "mdstat", .func = do_proc_mdstat },
+        { .name = "/proc/mdstat", .dim = "mdstat", .func = do_proc_mdstat, .group = 1 },
 
         // NFS metrics
         { .name = "/proc/net/rpc/nfsd", .dim = "nfsd", .func = do_proc_net_rpc_nfsd },
         { .name = "/proc/net/rpc/nfs", .dim = "nfs", .func = do_proc_net_rpc_nfs },
 
         // ZFS metrics
-        { .name = "/proc/spl/kstat/zfs/arcstats", .dim = "zfs_arcstats", .func = do_proc_spl_kstat_zfs_arcstats },
+        { .name = "/proc/spl/kstat/zfs/arcstats", .dim = "zfs_arcstats", .func = do_proc_spl_kstat_zfs_arcstats, .group = 1 },
 
         // BTRFS metrics
-        { .name = "/sys/fs/btrfs", .dim = "btrfs", .func = do_sys_fs_btrfs },
+        { .name = "/sys/fs/btrfs", .dim = "btrfs", .func = do_sys_fs_btrfs, .group = 1 },
 
         // IPC metrics
         { .name = "ipc", .dim = "ipc", .func = do_ipc },
@@ -71,12 +75,145 @@ static struct proc_module {
         { .name = NULL, .dim = NULL, .func = NULL }
 };
 
+// ----------------------------------------------------------------------------
+// thread groups
+//
+// The modules of thread group 0 are run by the proc plugin thread. The modules
+// of the other thread groups are run by a thread for each group, with its own
+// update every, so that a slow module (i.e. /proc/mdstat under heavy I/O) does
+// not delay the others. Modules sharing data (/proc/net/netstat and
+// /proc/net/snmp) should be in the same group.
+
+#define PROC_THREAD_GROUPS_MAX 8
+
+static struct proc_thread_group {
+    int update_every;
+    size_t modules;
+
+    int started;
+    netdata_thread_t thread;
+} proc_thread_groups[PROC_THREAD_GROUPS_MAX];
+
+// run the enabled modules of a thread group once
+static void proc_run_modules(int group, int update_every, heartbeat_t *hb, usec_t hb_dt) {
+    usec_t duration = 0ULL;
+
+    int i;
+    for(i = 0 ; proc_modules[i].name ;i++) {
+        struct proc_module *pm = &proc_modules[i];
+        if(unlikely(!pm->enabled || pm->group != group)) continue;
+
+        debug(D_PROCNETDEV_LOOP, "PROC calling %s.", pm->name);
+
+//#ifdef NETDATA_LOG_ALLOCATIONS
+//            if(pm->func == do_proc_interrupts)
+//                log_thread_memory_allocations = iterations;
+//#endif
+        pm->enabled = !pm->func(update_every, hb_dt);
+
+        usec_t dt = heartbeat_monotonic_dt_to_now_usec(hb) - duration;
+        duration += dt;
+
+        // the chart is updated by the proc plugin thread
+        __atomic_store_n(&pm->duration, dt, __ATOMIC_RELAXED);
+
+        usec_t max = __atomic_load_n(&pm->duration_max, __ATOMIC_RELAXED);
+        while(dt > max && !__atomic_compare_exchange_n(&pm->duration_max, &max, dt, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) ;
+
+        if(unlikely(dt > (usec_t)update_every * USEC_PER_SEC))
+            __atomic_add_fetch(&pm->overruns, 1, __ATOMIC_RELAXED);
+
+//#ifdef NETDATA_LOG_ALLOCATIONS
+//            if(pm->func == do_proc_interrupts)
+//                log_thread_memory_allocations = 0;
+//#endif
+
+        if(unlikely(netdata_exit)) break;
+    }
+}
+
+static void *proc_thread_group_main(void *ptr) {
+    struct proc_thread_group *tg = (struct proc_thread_group *)ptr;
+    int group = (int)(tg - proc_thread_groups);
+
+    usec_t step = tg->update_every * USEC_PER_SEC;
+    heartbeat_t hb;
+    heartbeat_init(&hb);
+
+    while(!netdata_exit) {
+        usec_t hb_dt = heartbeat_next(&hb, step);
+        if(unlikely(netdata_exit)) break;
+
+        proc_run_modules(group, tg->update_every, &hb, hb_dt);
+    }
+
+    return NULL;
+}
+
+static void proc_thread_groups_init(void) {
+    char section[CONFIG_MAX_NAME + 1], key[CONFIG_MAX_NAME + 1], tag[NETDATA_THREAD_TAG_MAX + 1];
+    int i;
+
+    proc_thread_groups[0].update_every = localhost->rrd_update_every;
+
+    for(i = 0 ; proc_modules[i].name ;i++) {
+        struct proc_module *pm = &proc_modules[i];
+        if(unlikely(!pm->enabled)) continue;
+
+        snprintfz(section, CONFIG_MAX_NAME, "plugin:proc:%s", pm->name);
+        pm->group = (int)config_get_number(section, "thread group", pm->group);
+        if(pm->group < 0 || pm->group >= PROC_THREAD_GROUPS_MAX) {
+            error("PROC: module '%s' has thread group %d, but thread groups are 0 to %d. Using thread group 0.", pm->name, pm->group, PROC_THREAD_GROUPS_MAX - 1);
+            pm->group = 0;
+        }
+
+        proc_thread_groups[pm->group].modules++;
+    }
+
+    for(i = 1; i < PROC_THREAD_GROUPS_MAX ; i++) {
+        struct proc_thread_group *tg = &proc_thread_groups[i];
+        if(!tg->modules) continue;
+
+        snprintfz(key, CONFIG_MAX_NAME, "thread group %d update every", i);
+        tg->update_every = (int)config_get_number("plugin:proc", key, localhost->rrd_update_every);
+        if(tg->update_every < localhost->rrd_update_every)
+            tg->update_every = localhost->rrd_update_every;
+
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "PLUGIN[proc-%d]", i);
+        if(netdata_thread_create(&tg->thread, tag, NETDATA_THREAD_OPTION_JOINABLE | NETDATA_THREAD_OPTION_DONT_LOG, proc_thread_group_main, tg) == 0)
+            tg->started = 1;
+        else {
+            error("PROC: cannot create the thread of thread group %d. Its modules will be run by the proc plugin thread.", i);
+
+            int m;
+            for(m = 0 ; proc_modules[m].name ;m++)
+                if(proc_modules[m].group == i) proc_modules[m].group = 0;
+        }
+    }
+}
+
+static void proc_thread_groups_stop(void) {
+    int i;
+    for(i = 1; i < PROC_THREAD_GROUPS_MAX ; i++) {
+        struct proc_thread_group *tg = &proc_thread_groups[i];
+        if(!tg->started) continue;
+
+        netdata_thread_cancel(tg->thread);
+        netdata_thread_join(tg->thread, NULL);
+        tg->started = 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 static void proc_main_cleanup(void *ptr) {
     struct netdata_static_thread *static_thread = (struct netdata_static_thread *)ptr;
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITING;
 
     info("cleaning up...");
 
+    proc_thread_groups_stop();
+
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
 
@@ -92,9 +229,14 @@ void *proc_main(void *ptr) {
 
         pm->enabled = config_get_boolean("plugin:proc", pm->name, 1);
         pm->duration = 0ULL;
+        pm->duration_max = 0ULL;
+        pm->overruns = 0;
         pm->rd = NULL;
+        pm->rd_overruns = NULL;
     }
 
+    proc_thread_groups_init();
+
     usec_t step = localhost->rrd_update_every * USEC_PER_SEC;
     heartbeat_t hb;
     heartbeat_init(&hb);
@@ -105,33 +247,12 @@ void *proc_main(void *ptr) {
         (void)iterations;
 
         usec_t hb_dt = heartbeat_next(&hb, step);
-        usec_t duration = 0ULL;
 
         if(unlikely(netdata_exit)) break;
 
         // BEGIN -- the job to be done
 
-        for(i = 0 ; proc_modules[i].name ;i++) {
-            struct proc_module *pm = &proc_modules[i];
-            if(unlikely(!pm->enabled)) continue;
-
-            debug(D_PROCNETDEV_LOOP, "PROC calling %s.", pm->name);
-
-//#ifdef NETDATA_LOG_ALLOCATIONS
-//            if(pm->func == do_proc_interrupts)
-//                log_thread_memory_allocations = iterations;
-//#endif
-            pm->enabled = !pm->func(localhost->rrd_update_every, hb_dt);
-            pm->duration = heartbeat_monotonic_dt_to_now_usec(&hb) - duration;
-            duration += pm->duration;
-
-//#ifdef NETDATA_LOG_ALLOCATIONS
-//            if(pm->func == do_proc_interrupts)
-//                log_thread_memory_allocations = 0;
-//#endif
-
-            if(unlikely(netdata_exit)) break;
-        }
+        proc_run_modules(0, localhost->rrd_update_every, &hb, hb_dt);
 
         // END -- the job is done
 
@@ -169,14 +290,53 @@ void *proc_main(void *ptr) {
             }
             else rrdset_next(st);
 
+            // the longest run of each module since the last update, or its last run
             for(i = 0 ; proc_modules[i].name ;i++) {
                 struct proc_module *pm = &proc_modules[i];
                 if(unlikely(!pm->enabled)) continue;
 
-                rrddim_set_by_pointer(st, pm->rd, pm->duration);
+                usec_t duration = __atomic_exchange_n(&pm->duration_max, 0ULL, __ATOMIC_RELAXED);
+                if(!duration) duration = __atomic_load_n(&pm->duration, __ATOMIC_RELAXED);
+
+                rrddim_set_by_pointer(st, pm->rd, duration);
             }
             rrdset_done(st);
 
+            static RRDSET *st_overruns = NULL;
+
+            if(unlikely(!st_overruns)) {
+                st_overruns = rrdset_create_localhost(
+                        "netdata"
+                        , "plugin_proc_modules_overruns"
+                        , NULL
+                        , "proc"
+                        , NULL
+                        , "NetData Proc Plugin Modules Runs Longer Than Their Update Every"
+                        , "runs"
+                        , "netdata"
+                        , "stats"
+                        , 132002
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                for(i = 0 ; proc_modules[i].name ;i++) {
+                    struct proc_module *pm = &proc_modules[i];
+                    if(unlikely(!pm->enabled)) continue;
+
+                    pm->rd_overruns = rrddim_add(st_overruns, pm->dim, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                }
+            }
+            else rrdset_next(st_overruns);
+
+            for(i = 0 ; proc_modules[i].name ;i++) {
+                struct proc_module *pm = &proc_modules[i];
+                if(unlikely(!pm->enabled || !pm->rd_overruns)) continue;
+
+                rrddim_set_by_pointer(st_overruns, pm->rd_overruns, (collected_number)__atomic_exchange_n(&pm->overruns, 0, __ATOMIC_RELAXED));
+            }
+            rrdset_done(st_overruns);
+
             global_statistics_charts();
             registry_statistics();
         }
@@ -219,3 +379,82 @@ int get_numa_node_count(void)
 
     return numa_node_count;
 }
+
+// the numa node of a cpu, from the cpulist of the numa nodes, or -1
+int get_cpu_numa_node(int cpu)
+{
+    static int *cpu_nodes = NULL;
+    static int cpu_nodes_size = -1;
+
+    if (unlikely(cpu_nodes_size == -1)) {
+        cpu_nodes_size = 0;
+
+        char name[FILENAME_MAX + 1];
+        snprintfz(name, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/sys/devices/system/node");
+        char *dirname = config_get("plugin:proc:/sys/devices/system/node", "directory to monitor", name);
+
+        DIR *dir = opendir(dirname);
+        if(dir) {
+            struct dirent *de = NULL;
+            while((de = readdir(dir))) {
+                if(de->d_type != DT_DIR || strncmp(de->d_name, "node", 4) != 0 || !isdigit(de->d_name[4]))
+                    continue;
+
+                int node = str2i(&de->d_name[4]);
+
+                // the cpulist is like 0-63,128-191
+                char buffer[4096 + 1];
+                snprintfz(name, FILENAME_MAX, "%s/%s/cpulist", dirname, de->d_name);
+                if(read_file(name, buffer, 4096) != 0)
+                    continue;
+
+                char *s = buffer;
+                while(isdigit(*s)) {
+                    int first = (int)strtol(s, &s, 10), last = first;
+                    if(*s == '-')
+                        last = (int)strtol(s + 1, &s, 10);
+                    if(*s == ',')
+                        s++;
+
+                    if(last >= cpu_nodes_size) {
+                        cpu_nodes = reallocz(cpu_nodes, (last + 1) * sizeof(int));
+                        for(; cpu_nodes_size <= last; cpu_nodes_size++)
+                            cpu_nodes[cpu_nodes_size] = -1;
+                    }
+
+                    for(; first <= last; first++)
+                        cpu_nodes[first] = node;
+                }
+            }
+            closedir(dir);
+        }
+    }
+
+    if (cpu < 0 || cpu >= cpu_nodes_size)
+        return -1;
+
+    return cpu_nodes[cpu];
+}
+
+// the numa node of each cpu column of /proc/interrupts and /proc/softirqs, from their CPUnn header
+// returns the number of numa nodes, or 0 when the cpus do not belong to any
+int get_cpu_columns_numa_nodes(procfile *ff, int cpus, int *cpu_node)
+{
+    size_t words = procfile_linewords(ff, 0), w;
+    int c = 0, nodes = 0;
+
+    for(w = 0; w < words && c < cpus ; w++) {
+        char *word = procfile_lineword(ff, 0, w);
+        if(likely(strncmp(word, "CPU", 3) == 0)) {
+            cpu_node[c] = get_cpu_numa_node(str2i(&word[3]));
+            if(cpu_node[c] + 1 > nodes)
+                nodes = cpu_node[c] + 1;
+            c++;
+        }
+    }
+
+    for(; c < cpus ; c++)
+        cpu_node[c] = -1;
+
+    return nodes;
+}
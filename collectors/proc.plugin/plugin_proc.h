@@ -55,6 +55,8 @@ extern int do_proc_net_sctp_snmp(int update_every, usec_t dt);
 extern int do_ipc(int update_every, usec_t dt);
 extern int do_sys_class_power_supply(int update_every, usec_t dt);
 extern int get_numa_node_count(void);
+extern int get_cpu_numa_node(int cpu);
+extern int get_cpu_columns_numa_nodes(procfile *ff, int cpus, int *cpu_node);
 
 // metrics that need to be shared among data collectors
 extern unsigned long long tcpext_TCPSynRetrans;
@@ -14,7 +14,14 @@
 #define DEFAULT_PREFERRED_IDS "*"
 #define DEFAULT_EXCLUDED_DISKS "loop* ram*"
 
+// the metadata of new disks are discovered by a background thread
+#define DISK_STATE_DISCOVERING 0    // the discovery thread owns the metadata
+#define DISK_STATE_DISCOVERED  1    // the metadata are ready, the disk needs to be configured
+#define DISK_STATE_READY       2    // the disk is configured and collected
+
 static struct disk {
+    avl avl;                // the index by major:minor - has to be first
+
     char *disk;             // the name of the disk (sda, sdb, etc, after being looked up)
     char *device;           // the device of the disk (before being looked up)
     unsigned long major;
@@ -35,6 +42,7 @@ static struct disk {
     int do_bcache;
 
     int updated;
+    int state;
 
     int device_is_bcache;
 
@@ -132,9 +140,33 @@ static struct disk {
     RRDDIM *rd_bcache_cache_read_races;
     RRDDIM *rd_bcache_cache_io_errors;
 
+    struct disk *discovery_next;
+
     struct disk *next;
 } *disk_root = NULL;
 
+static int disk_compare(void *a, void *b) {
+    struct disk *d1 = (struct disk *)a, *d2 = (struct disk *)b;
+
+    if(d1->major < d2->major) return -1;
+    if(d1->major > d2->major) return 1;
+    if(d1->minor < d2->minor) return -1;
+    if(d1->minor > d2->minor) return 1;
+    return 0;
+}
+
+static avl_tree disk_index = { NULL, disk_compare };
+
+#define disk_index_add(d) (struct disk *)avl_insert(&disk_index, (avl *)(d))
+#define disk_index_del(d) (struct disk *)avl_remove(&disk_index, (avl *)(d))
+
+static inline struct disk *disk_index_find(unsigned long major, unsigned long minor) {
+    struct disk tmp;
+    tmp.major = major;
+    tmp.minor = minor;
+    return (struct disk *)avl_search(&disk_index, (avl *)&tmp);
+}
+
 #define rrdset_obsolete_and_pointer_null(st) do { if(st) { rrdset_is_obsolete(st); (st) = NULL; } } while(st)
 
 // static char *path_to_get_hw_sector_size = NULL;
@@ -539,39 +571,15 @@ static void get_disk_config(struct disk *d) {
     }
 }
 
-static struct disk *get_disk(unsigned long major, unsigned long minor, char *disk) {
+// find the metadata of a new disk
+// this runs in the discovery thread, and touches only the metadata of the disk
+static void disk_discover(struct disk *d) {
     static struct mountinfo *disk_mountinfo_root = NULL;
 
-    struct disk *d;
-
-    // search for it in our RAM list.
-    // this is sequential, but since we just walk through
-    // and the number of disks / partitions in a system
-    // should not be that many, it should be acceptable
-    for(d = disk_root; d ; d = d->next)
-        if(unlikely(d->major == major && d->minor == minor))
-            return d;
+    unsigned long major = d->major, minor = d->minor;
+    const char *disk = d->device;
 
-    // not found
-    // create a new disk structure
-    d = (struct disk *)callocz(1, sizeof(struct disk));
-
-    d->disk = get_disk_name(major, minor, disk);
-    d->device = strdupz(disk);
-    d->major = major;
-    d->minor = minor;
-    d->type = DISK_TYPE_UNKNOWN; // Default type. Changed later if not correct.
-    d->sector_size = 512; // the default, will be changed below
-    d->next = NULL;
-
-    // append it to the list
-    if(unlikely(!disk_root))
-        disk_root = d;
-    else {
-        struct disk *last;
-        for(last = disk_root; last->next ;last = last->next);
-        last->next = d;
-    }
+    d->disk = get_disk_name(major, minor, d->device);
 
     char buffer[FILENAME_MAX + 1];
 
@@ -790,7 +798,112 @@ static struct disk *get_disk(unsigned long major, unsigned long minor, char *dis
             error("bcache file '%s' cannot be read.", buffer2);
     }
 
-    get_disk_config(d);
+    __atomic_store_n(&d->state, DISK_STATE_DISCOVERED, __ATOMIC_RELEASE);
+}
+
+// ----------------------------------------------------------------------------
+// disk discovery thread
+//
+// Finding the name, the type, the mount point and the bcache files of a disk
+// walks several directories (/dev/mapper, /dev/disk/by-id, etc). With
+// thousands of device mapper devices this takes seconds, so new disks are
+// discovered in the background and they are collected when this is done.
+
+static struct disk_discovery {
+    int threaded;               // 0 when the disks are discovered by the collection thread
+
+    netdata_mutex_t mutex;
+    pthread_cond_t cond;
+    struct disk *queued;        // under the mutex
+
+    netdata_thread_t thread;
+} disk_discovery = {
+        .threaded = 0,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .queued = NULL
+};
+
+static void *disk_discovery_thread(void *ptr) {
+    (void)ptr;
+
+    netdata_mutex_lock(&disk_discovery.mutex);
+    while(!netdata_exit) {
+        struct disk *d = disk_discovery.queued, *next;
+
+        if(!d) {
+            pthread_cond_wait(&disk_discovery.cond, &disk_discovery.mutex);
+            continue;
+        }
+
+        disk_discovery.queued = NULL;
+        netdata_mutex_unlock(&disk_discovery.mutex);
+
+        for( ; d ; d = next) {
+            // the disk may be freed as soon as it is discovered
+            next = d->discovery_next;
+            disk_discover(d);
+        }
+
+        netdata_mutex_lock(&disk_discovery.mutex);
+    }
+    netdata_mutex_unlock(&disk_discovery.mutex);
+
+    return NULL;
+}
+
+static void disk_discovery_init(void) {
+    if(netdata_thread_create(&disk_discovery.thread, "PLUGIN[diskstats]", NETDATA_THREAD_OPTION_DONT_LOG, disk_discovery_thread, NULL) == 0)
+        disk_discovery.threaded = 1;
+    else
+        error("DISKSTATS: cannot create the thread to discover new disks. The disks will be discovered while they are collected.");
+}
+
+static inline void disk_discovery_queue(struct disk *d) {
+    if(unlikely(!disk_discovery.threaded)) {
+        disk_discover(d);
+        return;
+    }
+
+    netdata_mutex_lock(&disk_discovery.mutex);
+    d->discovery_next = disk_discovery.queued;
+    disk_discovery.queued = d;
+    pthread_cond_signal(&disk_discovery.cond);
+    netdata_mutex_unlock(&disk_discovery.mutex);
+}
+
+// ----------------------------------------------------------------------------
+
+static struct disk *get_disk(unsigned long major, unsigned long minor, char *disk) {
+    struct disk *d = disk_index_find(major, minor);
+    if(likely(d))
+        return d;
+
+    // not found
+    // create a new disk structure
+    d = (struct disk *)callocz(1, sizeof(struct disk));
+
+    d->device = strdupz(disk);
+    d->major = major;
+    d->minor = minor;
+    d->type = DISK_TYPE_UNKNOWN; // Default type. Changed later if not correct.
+    d->sector_size = 512; // the default, will be changed below
+    d->state = DISK_STATE_DISCOVERING;
+    d->next = NULL;
+
+    if(unlikely(disk_index_add(d) != d))
+        error("DISKSTATS: disk %lu:%lu is already indexed.", major, minor);
+
+    // append it to the list
+    if(unlikely(!disk_root))
+        disk_root = d;
+    else {
+        struct disk *last;
+        for(last = disk_root; last->next ;last = last->next);
+        last->next = d;
+    }
+
+    disk_discovery_queue(d);
     return d;
 }
 
@@ -862,6 +975,9 @@ int do_proc_diskstats(int update_every, usec_t dt) {
                 , NULL
                 , SIMPLE_PATTERN_EXACT
         );
+
+        if(config_get_boolean(CONFIG_SECTION_PLUGIN_PROC_DISKSTATS, "discover new disks in the background", CONFIG_BOOLEAN_YES))
+            disk_discovery_init();
     }
 
     // --------------------------------------------------------------------------
@@ -955,6 +1071,15 @@ int do_proc_diskstats(int update_every, usec_t dt) {
         struct disk *d = get_disk(major, minor, disk);
         d->updated = 1;
 
+        if(unlikely(d->state != DISK_STATE_READY)) {
+            // wait for the discovery thread to find its metadata
+            if(__atomic_load_n(&d->state, __ATOMIC_ACQUIRE) != DISK_STATE_DISCOVERED)
+                continue;
+
+            get_disk_config(d);
+            d->state = DISK_STATE_READY;
+        }
+
         // --------------------------------------------------------------------------
         // count the global system disk I/O of physical disks
 
@@ -1611,9 +1736,13 @@ int do_proc_diskstats(int update_every, usec_t dt) {
 
     struct disk *d = disk_root, *last = NULL;
     while(d) {
-        if(unlikely(global_cleanup_removed_disks && !d->updated)) {
+        // the disks still being discovered are removed after their discovery
+        if(unlikely(global_cleanup_removed_disks && !d->updated && __atomic_load_n(&d->state, __ATOMIC_ACQUIRE) != DISK_STATE_DISCOVERING)) {
             struct disk *t = d;
 
+            if(unlikely(disk_index_del(t) != t))
+                error("DISKSTATS: disk %lu:%lu was not indexed.", t->major, t->minor);
+
             rrdset_obsolete_and_pointer_null(d->st_avgsz);
             rrdset_obsolete_and_pointer_null(d->st_await);
             rrdset_obsolete_and_pointer_null(d->st_backlog);
@@ -71,7 +71,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         do_hugepages    = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_MEMINFO, "hugepages", CONFIG_BOOLEAN_AUTO);
         do_transparent_hugepages = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_MEMINFO, "transparent hugepages", CONFIG_BOOLEAN_AUTO);
 
-        arl_base = arl_create("meminfo", NULL, 60);
+        arl_base = arl_create_perfect_hash("meminfo", NULL, 60);
         arl_expect(arl_base, "MemTotal", &MemTotal);
         arl_expect(arl_base, "MemFree", &MemFree);
         arl_memavailable = arl_expect(arl_base, "MemAvailable", &MemAvailable);
@@ -121,7 +121,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
     if(unlikely(!ff)) {
         char filename[FILENAME_MAX + 1];
         snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/proc/meminfo");
-        ff = procfile_open(config_get(CONFIG_SECTION_PLUGIN_PROC_MEMINFO, "filename to monitor", filename), " \t:", PROCFILE_FLAG_DEFAULT);
+        ff = procfile_open(config_get(CONFIG_SECTION_PLUGIN_PROC_MEMINFO, "filename to monitor", filename), " \t:", PROCFILE_FLAG_LAZY_LINES);
         if(unlikely(!ff))
             return 1;
     }
@@ -149,6 +149,10 @@ int do_proc_meminfo(int update_every, usec_t dt) {
     unsigned long long MemCached = Cached + SReclaimable;
     unsigned long long MemUsed = MemTotal - MemFree - MemCached - Buffers;
 
+    // the charts are committed together, at the end
+    RRDSET *charts_done[10];
+    size_t charts_done_count = 0;
+
     if(do_ram) {
         {
             static RRDSET *st_system_ram = NULL;
@@ -182,7 +186,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
             rrddim_set_by_pointer(st_system_ram, rd_cached,  MemCached);
             rrddim_set_by_pointer(st_system_ram, rd_buffers, Buffers);
 
-            rrdset_done(st_system_ram);
+            charts_done[charts_done_count++] = st_system_ram;
         }
 
         if(arl_memavailable->flags & ARL_ENTRY_FLAG_FOUND) {
@@ -211,7 +215,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
 
             rrddim_set_by_pointer(st_mem_available, rd_avail, MemAvailable);
 
-            rrdset_done(st_mem_available);
+            charts_done[charts_done_count++] = st_mem_available;
         }
     }
 
@@ -251,7 +255,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         rrddim_set_by_pointer(st_system_swap, rd_used, SwapUsed);
         rrddim_set_by_pointer(st_system_swap, rd_free, SwapFree);
 
-        rrdset_done(st_system_swap);
+        charts_done[charts_done_count++] = st_system_swap;
     }
 
     // --------------------------------------------------------------------
@@ -286,7 +290,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
 
         rrddim_set_by_pointer(st_mem_hwcorrupt, rd_corrupted, HardwareCorrupted);
 
-        rrdset_done(st_mem_hwcorrupt);
+        charts_done[charts_done_count++] = st_mem_hwcorrupt;
     }
 
     // --------------------------------------------------------------------
@@ -319,7 +323,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
 
         rrddim_set_by_pointer(st_mem_committed, rd_committed, Committed_AS);
 
-        rrdset_done(st_mem_committed);
+        charts_done[charts_done_count++] = st_mem_committed;
     }
 
     // --------------------------------------------------------------------
@@ -359,7 +363,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         rrddim_set_by_pointer(st_mem_writeback, rd_nfs_writeback, NFS_Unstable);
         rrddim_set_by_pointer(st_mem_writeback, rd_bounce,        Bounce);
 
-        rrdset_done(st_mem_writeback);
+        charts_done[charts_done_count++] = st_mem_writeback;
     }
 
     // --------------------------------------------------------------------
@@ -398,7 +402,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         rrddim_set_by_pointer(st_mem_kernel, rd_pagetables,  PageTables);
         rrddim_set_by_pointer(st_mem_kernel, rd_vmallocused, VmallocUsed);
 
-        rrdset_done(st_mem_kernel);
+        charts_done[charts_done_count++] = st_mem_kernel;
     }
 
     // --------------------------------------------------------------------
@@ -433,7 +437,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         rrddim_set_by_pointer(st_mem_slab, rd_reclaimable, SReclaimable);
         rrddim_set_by_pointer(st_mem_slab, rd_unreclaimable, SUnreclaim);
 
-        rrdset_done(st_mem_slab);
+        charts_done[charts_done_count++] = st_mem_slab;
     }
 
     // --------------------------------------------------------------------
@@ -474,7 +478,7 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         rrddim_set_by_pointer(st_mem_hugepages, rd_rsvd, HugePages_Rsvd);
         rrddim_set_by_pointer(st_mem_hugepages, rd_surp, HugePages_Surp);
 
-        rrdset_done(st_mem_hugepages);
+        charts_done[charts_done_count++] = st_mem_hugepages;
     }
 
     // --------------------------------------------------------------------
@@ -511,9 +515,11 @@ int do_proc_meminfo(int update_every, usec_t dt) {
         rrddim_set_by_pointer(st_mem_transparent_hugepages, rd_anonymous, AnonHugePages);
         rrddim_set_by_pointer(st_mem_transparent_hugepages, rd_shared, ShmemHugePages);
 
-        rrdset_done(st_mem_transparent_hugepages);
+        charts_done[charts_done_count++] = st_mem_transparent_hugepages;
     }
 
+    rrdset_done_many(charts_done, charts_done_count);
+
     return 0;
 }
 
@@ -2,6 +2,9 @@
 
 #include "plugin_proc.h"
 
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
 #define PLUGIN_PROC_MODULE_NETDEV_NAME "/proc/net/dev"
 #define CONFIG_SECTION_PLUGIN_PROC_NETDEV "plugin:" PLUGIN_PROC_CONFIG_NAME ":" PLUGIN_PROC_MODULE_NETDEV_NAME
 
@@ -96,7 +99,11 @@ static struct netdev {
     RRDDIM *rd_tcarrier;
     RRDDIM *rd_tcompressed;
 
+    int ifindex;
+    int operstate;
+
     usec_t speed_last_collected_usec;
+    int speed_refresh;
     char *filename_speed;
     RRDSETVAR *chart_var_speed;
 
@@ -434,116 +441,415 @@ static struct netdev *get_netdev(const char *name) {
     return d;
 }
 
-int do_proc_net_dev(int update_every, usec_t dt) {
-    (void)dt;
-    static SIMPLE_PATTERN *disabled_list = NULL;
-    static procfile *ff = NULL;
-    static int enable_new_interfaces = -1;
-    static int do_bandwidth = -1, do_packets = -1, do_errors = -1, do_drops = -1, do_fifo = -1, do_compressed = -1, do_events = -1;
-    static char *path_to_sys_devices_virtual_net = NULL, *path_to_sys_class_net_speed = NULL, *proc_net_dev_filename = NULL;
-    static long long int dt_to_refresh_speed = 0;
+// ----------------------------------------------------------------------------
+// netdev configuration
 
-    if(unlikely(enable_new_interfaces == -1)) {
-        char filename[FILENAME_MAX + 1];
+static SIMPLE_PATTERN *disabled_list = NULL;
+static int enable_new_interfaces = -1;
+static int do_bandwidth = -1, do_packets = -1, do_errors = -1, do_drops = -1, do_fifo = -1, do_compressed = -1, do_events = -1;
+static char *path_to_sys_devices_virtual_net = NULL, *path_to_sys_class_net_speed = NULL, *proc_net_dev_filename = NULL;
+static long long int dt_to_refresh_speed = 0;
 
-        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, (*netdata_configured_host_prefix)?"/proc/1/net/dev":"/proc/net/dev");
-        proc_net_dev_filename = config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "filename to monitor", filename);
+static inline int netdev_configure(struct netdev *d) {
+    if(likely(d->configured))
+        return d->enabled;
 
-        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/sys/devices/virtual/net/%s");
-        path_to_sys_devices_virtual_net = config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "path to get virtual interfaces", filename);
+    // this is the first time we see this interface
 
-        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/sys/class/net/%s/speed");
-        path_to_sys_class_net_speed = config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "path to get net device speed", filename);
+    // remember we configured it
+    d->configured = 1;
 
-        enable_new_interfaces = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "enable new interfaces detected at runtime", CONFIG_BOOLEAN_AUTO);
+    d->enabled = enable_new_interfaces;
 
-        do_bandwidth    = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "bandwidth for all interfaces", CONFIG_BOOLEAN_AUTO);
-        do_packets      = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "packets for all interfaces", CONFIG_BOOLEAN_AUTO);
-        do_errors       = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "errors for all interfaces", CONFIG_BOOLEAN_AUTO);
-        do_drops        = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "drops for all interfaces", CONFIG_BOOLEAN_AUTO);
-        do_fifo         = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "fifo for all interfaces", CONFIG_BOOLEAN_AUTO);
-        do_compressed   = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "compressed packets for all interfaces", CONFIG_BOOLEAN_AUTO);
-        do_events       = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "frames, collisions, carrier counters for all interfaces", CONFIG_BOOLEAN_AUTO);
+    if(d->enabled)
+        d->enabled = !simple_pattern_matches(disabled_list, d->name);
 
-        disabled_list = simple_pattern_create(config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "disable by default interfaces matching", "lo fireqos* *-ifb"), NULL, SIMPLE_PATTERN_EXACT);
+    char buffer[FILENAME_MAX + 1];
 
-        dt_to_refresh_speed = config_get_number(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "refresh interface speed every seconds", 10) * USEC_PER_SEC;
-        if(dt_to_refresh_speed < 0) dt_to_refresh_speed = 0;
+    snprintfz(buffer, FILENAME_MAX, path_to_sys_devices_virtual_net, d->name);
+    if(likely(access(buffer, R_OK) == 0)) {
+        d->virtual = 1;
     }
+    else
+        d->virtual = 0;
 
-    if(unlikely(!ff)) {
-        ff = procfile_open(proc_net_dev_filename, " \t,|", PROCFILE_FLAG_DEFAULT);
-        if(unlikely(!ff)) return 1;
+    if(likely(!d->virtual)) {
+        // set the filename to get the interface speed
+        snprintfz(buffer, FILENAME_MAX, path_to_sys_class_net_speed, d->name);
+        d->filename_speed = strdupz(buffer);
     }
 
-    ff = procfile_readall(ff);
-    if(unlikely(!ff)) return 0; // we return 0, so that we will retry to open it next time
+    snprintfz(buffer, FILENAME_MAX, "plugin:proc:/proc/net/dev:%s", d->name);
+    d->enabled = config_get_boolean_ondemand(buffer, "enabled", d->enabled);
+    d->virtual = config_get_boolean(buffer, "virtual", d->virtual);
 
-    // rename all the devices, if we have pending renames
-    if(unlikely(netdev_pending_renames))
-        netdev_rename_all_lock();
+    if(d->enabled == CONFIG_BOOLEAN_NO)
+        return d->enabled;
 
-    netdev_found = 0;
+    d->do_bandwidth  = config_get_boolean_ondemand(buffer, "bandwidth",  do_bandwidth);
+    d->do_packets    = config_get_boolean_ondemand(buffer, "packets",    do_packets);
+    d->do_errors     = config_get_boolean_ondemand(buffer, "errors",     do_errors);
+    d->do_drops      = config_get_boolean_ondemand(buffer, "drops",      do_drops);
+    d->do_fifo       = config_get_boolean_ondemand(buffer, "fifo",       do_fifo);
+    d->do_compressed = config_get_boolean_ondemand(buffer, "compressed", do_compressed);
+    d->do_events     = config_get_boolean_ondemand(buffer, "events",     do_events);
 
-    kernel_uint_t system_rbytes = 0;
-    kernel_uint_t system_tbytes = 0;
+    return d->enabled;
+}
 
-    size_t lines = procfile_lines(ff), l;
-    for(l = 2; l < lines ;l++) {
-        // require 17 words on each line
-        if(unlikely(procfile_linewords(ff, l) < 17)) continue;
+// ----------------------------------------------------------------------------
+// netdev charts
 
-        char *name = procfile_lineword(ff, l, 0);
-        size_t len = strlen(name);
-        if(name[len - 1] == ':') name[len - 1] = '\0';
+static void netdev_update_charts(struct netdev *d, int update_every, usec_t dt) {
+    // --------------------------------------------------------------------
 
-        struct netdev *d = get_netdev(name);
-        d->updated = 1;
-        netdev_found++;
+    if(unlikely((d->do_bandwidth == CONFIG_BOOLEAN_AUTO && (d->rbytes || d->tbytes))))
+        d->do_bandwidth = CONFIG_BOOLEAN_YES;
 
-        if(unlikely(!d->configured)) {
-            // this is the first time we see this interface
+    if(d->do_bandwidth == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_bandwidth)) {
 
-            // remember we configured it
-            d->configured = 1;
+            d->st_bandwidth = rrdset_create_localhost(
+                    d->chart_type_net_bytes
+                    , d->chart_id_net_bytes
+                    , NULL
+                    , d->chart_family
+                    , "net.net"
+                    , "Bandwidth"
+                    , "kilobits/s"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority
+                    , update_every
+                    , RRDSET_TYPE_AREA
+            );
 
-            d->enabled = enable_new_interfaces;
+            d->rd_rbytes = rrddim_add(d->st_bandwidth, "received", NULL,  8, BITS_IN_A_KILOBIT, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tbytes = rrddim_add(d->st_bandwidth, "sent",     NULL, -8, BITS_IN_A_KILOBIT, RRD_ALGORITHM_INCREMENTAL);
 
-            if(d->enabled)
-                d->enabled = !simple_pattern_matches(disabled_list, d->name);
+            if(d->flipped) {
+                // flip receive/trasmit
 
-            char buffer[FILENAME_MAX + 1];
+                RRDDIM *td = d->rd_rbytes;
+                d->rd_rbytes = d->rd_tbytes;
+                d->rd_tbytes = td;
+            }
+        }
+        else rrdset_next(d->st_bandwidth);
+
+        rrddim_set_by_pointer(d->st_bandwidth, d->rd_rbytes, (collected_number)d->rbytes);
+        rrddim_set_by_pointer(d->st_bandwidth, d->rd_tbytes, (collected_number)d->tbytes);
+        rrdset_done(d->st_bandwidth);
+
+        // update the interface speed
+        if(d->filename_speed) {
+            // with netlink, the speed is refreshed when the operational state changes
+            if(!d->ifindex) {
+                d->speed_last_collected_usec += dt;
 
-            snprintfz(buffer, FILENAME_MAX, path_to_sys_devices_virtual_net, d->name);
-            if(likely(access(buffer, R_OK) == 0)) {
-                d->virtual = 1;
+                if(unlikely(d->speed_last_collected_usec >= (usec_t)dt_to_refresh_speed))
+                    d->speed_refresh = 1;
             }
-            else
-                d->virtual = 0;
 
-            if(likely(!d->virtual)) {
-                // set the filename to get the interface speed
-                snprintfz(buffer, FILENAME_MAX, path_to_sys_class_net_speed, d->name);
-                d->filename_speed = strdupz(buffer);
+            if(unlikely(d->speed_refresh)) {
+
+                if(unlikely(!d->chart_var_speed)) {
+                    d->chart_var_speed = rrdsetvar_custom_chart_variable_create(d->st_bandwidth, "nic_speed_max");
+                    if(!d->chart_var_speed) {
+                        error("Cannot create interface %s chart variable 'nic_speed_max'. Will not update its speed anymore.", d->name);
+                        freez(d->filename_speed);
+                        d->filename_speed = NULL;
+                    }
+                }
+
+                if(d->filename_speed && d->chart_var_speed) {
+                    if(read_single_number_file(d->filename_speed, (unsigned long long *) &d->speed)) {
+                        error("Cannot refresh interface %s speed by reading '%s'. Will not update its speed anymore.", d->name, d->filename_speed);
+                        freez(d->filename_speed);
+                        d->filename_speed = NULL;
+                    }
+                    else {
+                        rrdsetvar_custom_chart_variable_set(d->chart_var_speed, (calculated_number) d->speed);
+                        d->speed_last_collected_usec = 0;
+                        d->speed_refresh = 0;
+                    }
+                }
             }
+        }
+    }
 
-            snprintfz(buffer, FILENAME_MAX, "plugin:proc:/proc/net/dev:%s", d->name);
-            d->enabled = config_get_boolean_ondemand(buffer, "enabled", d->enabled);
-            d->virtual = config_get_boolean(buffer, "virtual", d->virtual);
+    // --------------------------------------------------------------------
 
-            if(d->enabled == CONFIG_BOOLEAN_NO)
-                continue;
+    if(unlikely((d->do_packets == CONFIG_BOOLEAN_AUTO && (d->rpackets || d->tpackets || d->rmulticast))))
+        d->do_packets = CONFIG_BOOLEAN_YES;
+
+    if(d->do_packets == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_packets)) {
+
+            d->st_packets = rrdset_create_localhost(
+                    d->chart_type_net_packets
+                    , d->chart_id_net_packets
+                    , NULL
+                    , d->chart_family
+                    , "net.packets"
+                    , "Packets"
+                    , "packets/s"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority + 1
+                    , update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rrdset_flag_set(d->st_packets, RRDSET_FLAG_DETAIL);
+
+            d->rd_rpackets   = rrddim_add(d->st_packets, "received",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tpackets   = rrddim_add(d->st_packets, "sent",      NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_rmulticast = rrddim_add(d->st_packets, "multicast", NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+            if(d->flipped) {
+                // flip receive/trasmit
+
+                RRDDIM *td = d->rd_rpackets;
+                d->rd_rpackets = d->rd_tpackets;
+                d->rd_tpackets = td;
+            }
+        }
+        else rrdset_next(d->st_packets);
+
+        rrddim_set_by_pointer(d->st_packets, d->rd_rpackets, (collected_number)d->rpackets);
+        rrddim_set_by_pointer(d->st_packets, d->rd_tpackets, (collected_number)d->tpackets);
+        rrddim_set_by_pointer(d->st_packets, d->rd_rmulticast, (collected_number)d->rmulticast);
+        rrdset_done(d->st_packets);
+    }
+
+    // --------------------------------------------------------------------
+
+    if(unlikely((d->do_errors == CONFIG_BOOLEAN_AUTO && (d->rerrors || d->terrors))))
+        d->do_errors = CONFIG_BOOLEAN_YES;
+
+    if(d->do_errors == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_errors)) {
+
+            d->st_errors = rrdset_create_localhost(
+                    d->chart_type_net_errors
+                    , d->chart_id_net_errors
+                    , NULL
+                    , d->chart_family
+                    , "net.errors"
+                    , "Interface Errors"
+                    , "errors/s"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority + 2
+                    , update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rrdset_flag_set(d->st_errors, RRDSET_FLAG_DETAIL);
+
+            d->rd_rerrors = rrddim_add(d->st_errors, "inbound",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_terrors = rrddim_add(d->st_errors, "outbound", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+            if(d->flipped) {
+                // flip receive/trasmit
+
+                RRDDIM *td = d->rd_rerrors;
+                d->rd_rerrors = d->rd_terrors;
+                d->rd_terrors = td;
+            }
+        }
+        else rrdset_next(d->st_errors);
+
+        rrddim_set_by_pointer(d->st_errors, d->rd_rerrors, (collected_number)d->rerrors);
+        rrddim_set_by_pointer(d->st_errors, d->rd_terrors, (collected_number)d->terrors);
+        rrdset_done(d->st_errors);
+    }
+
+    // --------------------------------------------------------------------
+
+    if(unlikely((d->do_drops == CONFIG_BOOLEAN_AUTO && (d->rdrops || d->tdrops))))
+        d->do_drops = CONFIG_BOOLEAN_YES;
+
+    if(d->do_drops == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_drops)) {
+
+            d->st_drops = rrdset_create_localhost(
+                    d->chart_type_net_drops
+                    , d->chart_id_net_drops
+                    , NULL
+                    , d->chart_family
+                    , "net.drops"
+                    , "Interface Drops"
+                    , "drops/s"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority + 3
+                    , update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rrdset_flag_set(d->st_drops, RRDSET_FLAG_DETAIL);
+
+            d->rd_rdrops = rrddim_add(d->st_drops, "inbound",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tdrops = rrddim_add(d->st_drops, "outbound", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+            if(d->flipped) {
+                // flip receive/trasmit
+
+                RRDDIM *td = d->rd_rdrops;
+                d->rd_rdrops = d->rd_tdrops;
+                d->rd_tdrops = td;
+            }
+        }
+        else rrdset_next(d->st_drops);
+
+        rrddim_set_by_pointer(d->st_drops, d->rd_rdrops, (collected_number)d->rdrops);
+        rrddim_set_by_pointer(d->st_drops, d->rd_tdrops, (collected_number)d->tdrops);
+        rrdset_done(d->st_drops);
+    }
+
+    // --------------------------------------------------------------------
+
+    if(unlikely((d->do_fifo == CONFIG_BOOLEAN_AUTO && (d->rfifo || d->tfifo))))
+        d->do_fifo = CONFIG_BOOLEAN_YES;
+
+    if(d->do_fifo == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_fifo)) {
+
+            d->st_fifo = rrdset_create_localhost(
+                    d->chart_type_net_fifo
+                    , d->chart_id_net_fifo
+                    , NULL
+                    , d->chart_family
+                    , "net.fifo"
+                    , "Interface FIFO Buffer Errors"
+                    , "errors"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority + 4
+                    , update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rrdset_flag_set(d->st_fifo, RRDSET_FLAG_DETAIL);
+
+            d->rd_rfifo = rrddim_add(d->st_fifo, "receive",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tfifo = rrddim_add(d->st_fifo, "transmit", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+            if(d->flipped) {
+                // flip receive/trasmit
+
+                RRDDIM *td = d->rd_rfifo;
+                d->rd_rfifo = d->rd_tfifo;
+                d->rd_tfifo = td;
+            }
+        }
+        else rrdset_next(d->st_fifo);
+
+        rrddim_set_by_pointer(d->st_fifo, d->rd_rfifo, (collected_number)d->rfifo);
+        rrddim_set_by_pointer(d->st_fifo, d->rd_tfifo, (collected_number)d->tfifo);
+        rrdset_done(d->st_fifo);
+    }
 
-            d->do_bandwidth  = config_get_boolean_ondemand(buffer, "bandwidth",  do_bandwidth);
-            d->do_packets    = config_get_boolean_ondemand(buffer, "packets",    do_packets);
-            d->do_errors     = config_get_boolean_ondemand(buffer, "errors",     do_errors);
-            d->do_drops      = config_get_boolean_ondemand(buffer, "drops",      do_drops);
-            d->do_fifo       = config_get_boolean_ondemand(buffer, "fifo",       do_fifo);
-            d->do_compressed = config_get_boolean_ondemand(buffer, "compressed", do_compressed);
-            d->do_events     = config_get_boolean_ondemand(buffer, "events",     do_events);
+    // --------------------------------------------------------------------
+
+    if(unlikely((d->do_compressed == CONFIG_BOOLEAN_AUTO && (d->rcompressed || d->tcompressed))))
+        d->do_compressed = CONFIG_BOOLEAN_YES;
+
+    if(d->do_compressed == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_compressed)) {
+
+            d->st_compressed = rrdset_create_localhost(
+                    d->chart_type_net_compressed
+                    , d->chart_id_net_compressed
+                    , NULL
+                    , d->chart_family
+                    , "net.compressed"
+                    , "Compressed Packets"
+                    , "packets/s"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority + 5
+                    , update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rrdset_flag_set(d->st_compressed, RRDSET_FLAG_DETAIL);
+
+            d->rd_rcompressed = rrddim_add(d->st_compressed, "received", NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tcompressed = rrddim_add(d->st_compressed, "sent",     NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+            if(d->flipped) {
+                // flip receive/trasmit
+
+                RRDDIM *td = d->rd_rcompressed;
+                d->rd_rcompressed = d->rd_tcompressed;
+                d->rd_tcompressed = td;
+            }
+        }
+        else rrdset_next(d->st_compressed);
+
+        rrddim_set_by_pointer(d->st_compressed, d->rd_rcompressed, (collected_number)d->rcompressed);
+        rrddim_set_by_pointer(d->st_compressed, d->rd_tcompressed, (collected_number)d->tcompressed);
+        rrdset_done(d->st_compressed);
+    }
+
+    // --------------------------------------------------------------------
+
+    if(unlikely((d->do_events == CONFIG_BOOLEAN_AUTO && (d->rframe || d->tcollisions || d->tcarrier))))
+        d->do_events = CONFIG_BOOLEAN_YES;
+
+    if(d->do_events == CONFIG_BOOLEAN_YES) {
+        if(unlikely(!d->st_events)) {
+
+            d->st_events = rrdset_create_localhost(
+                    d->chart_type_net_events
+                    , d->chart_id_net_events
+                    , NULL
+                    , d->chart_family
+                    , "net.events"
+                    , "Network Interface Events"
+                    , "events/s"
+                    , PLUGIN_PROC_NAME
+                    , PLUGIN_PROC_MODULE_NETDEV_NAME
+                    , d->priority + 6
+                    , update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rrdset_flag_set(d->st_events, RRDSET_FLAG_DETAIL);
+
+            d->rd_rframe      = rrddim_add(d->st_events, "frames",     NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tcollisions = rrddim_add(d->st_events, "collisions", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+            d->rd_tcarrier    = rrddim_add(d->st_events, "carrier",    NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
         }
+        else rrdset_next(d->st_events);
+
+        rrddim_set_by_pointer(d->st_events, d->rd_rframe,      (collected_number)d->rframe);
+        rrddim_set_by_pointer(d->st_events, d->rd_tcollisions, (collected_number)d->tcollisions);
+        rrddim_set_by_pointer(d->st_events, d->rd_tcarrier,    (collected_number)d->tcarrier);
+        rrdset_done(d->st_events);
+    }}
+
+// ----------------------------------------------------------------------------
+// netdev data collection from /proc/net/dev
 
-        if(unlikely(!d->enabled))
+static void netdev_collect_procfile(procfile *ff, int update_every, usec_t dt, kernel_uint_t *system_rbytes, kernel_uint_t *system_tbytes) {
+    size_t lines = procfile_lines(ff), l;
+    for(l = 2; l < lines ;l++) {
+        // require 17 words on each line
+        if(unlikely(procfile_linewords(ff, l) < 17)) continue;
+
+        char *name = procfile_lineword(ff, l, 0);
+        size_t len = strlen(name);
+        if(name[len - 1] == ':') name[len - 1] = '\0';
+
+        struct netdev *d = get_netdev(name);
+        d->updated = 1;
+        netdev_found++;
+
+        if(unlikely(!netdev_configure(d)))
             continue;
 
         if(likely(d->do_bandwidth != CONFIG_BOOLEAN_NO || !d->virtual)) {
@@ -551,8 +857,8 @@ int do_proc_net_dev(int update_every, usec_t dt) {
             d->tbytes      = str2kernel_uint_t(procfile_lineword(ff, l, 9));
 
             if(likely(!d->virtual)) {
-                system_rbytes += d->rbytes;
-                system_tbytes += d->tbytes;
+                *system_rbytes += d->rbytes;
+                *system_tbytes += d->tbytes;
             }
         }
 
@@ -599,330 +905,306 @@ int do_proc_net_dev(int update_every, usec_t dt) {
         //        , d->rframe, d->tcollisions, d->tcarrier
         //        );
 
-        // --------------------------------------------------------------------
-
-        if(unlikely((d->do_bandwidth == CONFIG_BOOLEAN_AUTO && (d->rbytes || d->tbytes))))
-            d->do_bandwidth = CONFIG_BOOLEAN_YES;
-
-        if(d->do_bandwidth == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_bandwidth)) {
-
-                d->st_bandwidth = rrdset_create_localhost(
-                        d->chart_type_net_bytes
-                        , d->chart_id_net_bytes
-                        , NULL
-                        , d->chart_family
-                        , "net.net"
-                        , "Bandwidth"
-                        , "kilobits/s"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority
-                        , update_every
-                        , RRDSET_TYPE_AREA
-                );
-
-                d->rd_rbytes = rrddim_add(d->st_bandwidth, "received", NULL,  8, BITS_IN_A_KILOBIT, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tbytes = rrddim_add(d->st_bandwidth, "sent",     NULL, -8, BITS_IN_A_KILOBIT, RRD_ALGORITHM_INCREMENTAL);
-
-                if(d->flipped) {
-                    // flip receive/trasmit
-
-                    RRDDIM *td = d->rd_rbytes;
-                    d->rd_rbytes = d->rd_tbytes;
-                    d->rd_tbytes = td;
-                }
-            }
-            else rrdset_next(d->st_bandwidth);
+        netdev_update_charts(d, update_every, dt);
+    }
+}
 
-            rrddim_set_by_pointer(d->st_bandwidth, d->rd_rbytes, (collected_number)d->rbytes);
-            rrddim_set_by_pointer(d->st_bandwidth, d->rd_tbytes, (collected_number)d->tbytes);
-            rrdset_done(d->st_bandwidth);
+// ----------------------------------------------------------------------------
+// netdev data collection with netlink
+//
+// A single RTM_GETLINK dump returns the IFLA_STATS64 counters of all the
+// interfaces, so there is no text to parse. Interfaces are matched by their
+// ifindex and their speed is read from sysfs only when they appear or their
+// operational state changes.
+
+#define NETDEV_NETLINK_BUFFER_SIZE 65536
+
+static int netdev_netlink_fd = -1;
+static uint32_t netdev_netlink_seq = 0;
+static char *netdev_netlink_buffer = NULL;
+
+static int netdev_netlink_open(void) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if(unlikely(fd == -1)) {
+        error("PROC_NET_DEV: cannot create a netlink route socket.");
+        return -1;
+    }
 
-            // update the interface speed
-            if(d->filename_speed) {
-                d->speed_last_collected_usec += dt;
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+    if(unlikely(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1)) {
+        error("PROC_NET_DEV: cannot bind the netlink route socket.");
+        close(fd);
+        return -1;
+    }
 
-                if(unlikely(d->speed_last_collected_usec >= (usec_t)dt_to_refresh_speed)) {
+    // never block the plugin if the kernel does not answer
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    if(unlikely(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1))
+        error("PROC_NET_DEV: cannot set the receive timeout of the netlink route socket.");
 
-                    if(unlikely(!d->chart_var_speed)) {
-                        d->chart_var_speed = rrdsetvar_custom_chart_variable_create(d->st_bandwidth, "nic_speed_max");
-                        if(!d->chart_var_speed) {
-                            error("Cannot create interface %s chart variable 'nic_speed_max'. Will not update its speed anymore.", d->name);
-                            freez(d->filename_speed);
-                            d->filename_speed = NULL;
-                        }
-                    }
+    if(unlikely(!netdev_netlink_buffer))
+        netdev_netlink_buffer = mallocz(NETDEV_NETLINK_BUFFER_SIZE);
 
-                    if(d->filename_speed && d->chart_var_speed) {
-                        if(read_single_number_file(d->filename_speed, (unsigned long long *) &d->speed)) {
-                            error("Cannot refresh interface %s speed by reading '%s'. Will not update its speed anymore.", d->name, d->filename_speed);
-                            freez(d->filename_speed);
-                            d->filename_speed = NULL;
-                        }
-                        else {
-                            rrdsetvar_custom_chart_variable_set(d->chart_var_speed, (calculated_number) d->speed);
-                            d->speed_last_collected_usec = 0;
-                        }
-                    }
-                }
-            }
-        }
+    return fd;
+}
 
-        // --------------------------------------------------------------------
-
-        if(unlikely((d->do_packets == CONFIG_BOOLEAN_AUTO && (d->rpackets || d->tpackets || d->rmulticast))))
-            d->do_packets = CONFIG_BOOLEAN_YES;
-
-        if(d->do_packets == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_packets)) {
-
-                d->st_packets = rrdset_create_localhost(
-                        d->chart_type_net_packets
-                        , d->chart_id_net_packets
-                        , NULL
-                        , d->chart_family
-                        , "net.packets"
-                        , "Packets"
-                        , "packets/s"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority + 1
-                        , update_every
-                        , RRDSET_TYPE_LINE
-                );
-
-                rrdset_flag_set(d->st_packets, RRDSET_FLAG_DETAIL);
-
-                d->rd_rpackets   = rrddim_add(d->st_packets, "received",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tpackets   = rrddim_add(d->st_packets, "sent",      NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_rmulticast = rrddim_add(d->st_packets, "multicast", NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-
-                if(d->flipped) {
-                    // flip receive/trasmit
-
-                    RRDDIM *td = d->rd_rpackets;
-                    d->rd_rpackets = d->rd_tpackets;
-                    d->rd_tpackets = td;
-                }
-            }
-            else rrdset_next(d->st_packets);
+static void netdev_netlink_close(void) {
+    if(netdev_netlink_fd != -1)
+        close(netdev_netlink_fd);
 
-            rrddim_set_by_pointer(d->st_packets, d->rd_rpackets, (collected_number)d->rpackets);
-            rrddim_set_by_pointer(d->st_packets, d->rd_tpackets, (collected_number)d->tpackets);
-            rrddim_set_by_pointer(d->st_packets, d->rd_rmulticast, (collected_number)d->rmulticast);
-            rrdset_done(d->st_packets);
-        }
+    netdev_netlink_fd = -1;
+    freez(netdev_netlink_buffer);
+    netdev_netlink_buffer = NULL;
 
-        // --------------------------------------------------------------------
+    // from now on the interfaces are matched by name
+    struct netdev *d;
+    for(d = netdev_root; d ; d = d->next)
+        d->ifindex = 0;
+}
 
-        if(unlikely((d->do_errors == CONFIG_BOOLEAN_AUTO && (d->rerrors || d->terrors))))
-            d->do_errors = CONFIG_BOOLEAN_YES;
+static struct netdev *get_netdev_by_ifindex(int ifindex, const char *name) {
+    struct netdev *d;
 
-        if(d->do_errors == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_errors)) {
+    // the dump returns the interfaces in the same order every time,
+    // so the one we need is usually the one after the last we used
+    for(d = netdev_last_used ; d ; d = d->next)
+        if(d->ifindex == ifindex) break;
 
-                d->st_errors = rrdset_create_localhost(
-                        d->chart_type_net_errors
-                        , d->chart_id_net_errors
-                        , NULL
-                        , d->chart_family
-                        , "net.errors"
-                        , "Interface Errors"
-                        , "errors/s"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority + 2
-                        , update_every
-                        , RRDSET_TYPE_LINE
-                );
+    if(unlikely(!d))
+        for(d = netdev_root ; d != netdev_last_used ; d = d->next)
+            if(d->ifindex == ifindex) break;
 
-                rrdset_flag_set(d->st_errors, RRDSET_FLAG_DETAIL);
+    if(likely(d)) {
+        if(likely(!strcmp(d->name, name))) {
+            netdev_last_used = d->next;
+            return d;
+        }
 
-                d->rd_rerrors = rrddim_add(d->st_errors, "inbound",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_terrors = rrddim_add(d->st_errors, "outbound", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+        // the interface has been renamed, or the ifindex has been reused
+        d->ifindex = 0;
+    }
 
-                if(d->flipped) {
-                    // flip receive/trasmit
+    d = get_netdev(name);
+    if(d->ifindex != ifindex) {
+        d->ifindex = ifindex;
 
-                    RRDDIM *td = d->rd_rerrors;
-                    d->rd_rerrors = d->rd_terrors;
-                    d->rd_terrors = td;
-                }
+        // the interface appeared - refresh its speed
+        d->operstate = -1;
+    }
+
+    return d;
+}
+
+static void netdev_netlink_link(struct nlmsghdr *nlh, int update_every, usec_t dt, kernel_uint_t *system_rbytes, kernel_uint_t *system_tbytes) {
+    struct ifinfomsg *ifm = NLMSG_DATA(nlh);
+    int attrlen = (int)IFLA_PAYLOAD(nlh);
+
+    const char *name = NULL;
+    int operstate = 0;
+    int have_stats = 0;
+    struct rtnl_link_stats64 stats;
+
+    struct rtattr *rta;
+    for(rta = IFLA_RTA(ifm); RTA_OK(rta, attrlen) ; rta = RTA_NEXT(rta, attrlen)) {
+        switch(rta->rta_type) {
+            case IFLA_IFNAME:
+                name = (const char *)RTA_DATA(rta);
+                break;
+
+            case IFLA_OPERSTATE:
+                operstate = *(uint8_t *)RTA_DATA(rta);
+                break;
+
+            case IFLA_STATS64: {
+                // the attribute is only 4-byte aligned and its size depends on the kernel version
+                size_t size = RTA_PAYLOAD(rta);
+                if(size > sizeof(stats)) size = sizeof(stats);
+                memset(&stats, 0, sizeof(stats));
+                memcpy(&stats, RTA_DATA(rta), size);
+                have_stats = 1;
+                break;
             }
-            else rrdset_next(d->st_errors);
 
-            rrddim_set_by_pointer(d->st_errors, d->rd_rerrors, (collected_number)d->rerrors);
-            rrddim_set_by_pointer(d->st_errors, d->rd_terrors, (collected_number)d->terrors);
-            rrdset_done(d->st_errors);
+            default:
+                break;
         }
+    }
 
-        // --------------------------------------------------------------------
+    if(unlikely(!name || !*name || !have_stats))
+        return;
 
-        if(unlikely((d->do_drops == CONFIG_BOOLEAN_AUTO && (d->rdrops || d->tdrops))))
-            d->do_drops = CONFIG_BOOLEAN_YES;
+    struct netdev *d = get_netdev_by_ifindex(ifm->ifi_index, name);
+    d->updated = 1;
+    netdev_found++;
 
-        if(d->do_drops == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_drops)) {
+    if(unlikely(d->operstate != operstate)) {
+        d->operstate = operstate;
+        d->speed_refresh = 1;
+    }
 
-                d->st_drops = rrdset_create_localhost(
-                        d->chart_type_net_drops
-                        , d->chart_id_net_drops
-                        , NULL
-                        , d->chart_family
-                        , "net.drops"
-                        , "Interface Drops"
-                        , "drops/s"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority + 3
-                        , update_every
-                        , RRDSET_TYPE_LINE
-                );
+    if(unlikely(!netdev_configure(d)))
+        return;
 
-                rrdset_flag_set(d->st_drops, RRDSET_FLAG_DETAIL);
+    d->rbytes      = (kernel_uint_t)stats.rx_bytes;
+    d->tbytes      = (kernel_uint_t)stats.tx_bytes;
 
-                d->rd_rdrops = rrddim_add(d->st_drops, "inbound",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tdrops = rrddim_add(d->st_drops, "outbound", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+    if(likely(!d->virtual)) {
+        *system_rbytes += d->rbytes;
+        *system_tbytes += d->tbytes;
+    }
 
-                if(d->flipped) {
-                    // flip receive/trasmit
+    d->rpackets    = (kernel_uint_t)stats.rx_packets;
+    d->rmulticast  = (kernel_uint_t)stats.multicast;
+    d->tpackets    = (kernel_uint_t)stats.tx_packets;
 
-                    RRDDIM *td = d->rd_rdrops;
-                    d->rd_rdrops = d->rd_tdrops;
-                    d->rd_tdrops = td;
-                }
-            }
-            else rrdset_next(d->st_drops);
+    d->rerrors     = (kernel_uint_t)stats.rx_errors;
+    d->terrors     = (kernel_uint_t)stats.tx_errors;
 
-            rrddim_set_by_pointer(d->st_drops, d->rd_rdrops, (collected_number)d->rdrops);
-            rrddim_set_by_pointer(d->st_drops, d->rd_tdrops, (collected_number)d->tdrops);
-            rrdset_done(d->st_drops);
-        }
+    d->rdrops      = (kernel_uint_t)stats.rx_dropped;
+    d->tdrops      = (kernel_uint_t)stats.tx_dropped;
 
-        // --------------------------------------------------------------------
+    d->rfifo       = (kernel_uint_t)stats.rx_fifo_errors;
+    d->tfifo       = (kernel_uint_t)stats.tx_fifo_errors;
 
-        if(unlikely((d->do_fifo == CONFIG_BOOLEAN_AUTO && (d->rfifo || d->tfifo))))
-            d->do_fifo = CONFIG_BOOLEAN_YES;
+    d->rcompressed = (kernel_uint_t)stats.rx_compressed;
+    d->tcompressed = (kernel_uint_t)stats.tx_compressed;
 
-        if(d->do_fifo == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_fifo)) {
+    d->rframe      = (kernel_uint_t)stats.rx_frame_errors;
+    d->tcollisions = (kernel_uint_t)stats.collisions;
+    d->tcarrier    = (kernel_uint_t)stats.tx_carrier_errors;
 
-                d->st_fifo = rrdset_create_localhost(
-                        d->chart_type_net_fifo
-                        , d->chart_id_net_fifo
-                        , NULL
-                        , d->chart_family
-                        , "net.fifo"
-                        , "Interface FIFO Buffer Errors"
-                        , "errors"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority + 4
-                        , update_every
-                        , RRDSET_TYPE_LINE
-                );
+    netdev_update_charts(d, update_every, dt);
+}
 
-                rrdset_flag_set(d->st_fifo, RRDSET_FLAG_DETAIL);
+static int netdev_collect_netlink(int update_every, usec_t dt, kernel_uint_t *system_rbytes, kernel_uint_t *system_tbytes) {
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifm;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len   = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nlh.nlmsg_type  = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq   = ++netdev_netlink_seq;
+    req.ifm.ifi_family  = AF_UNSPEC;
+
+    if(unlikely(send(netdev_netlink_fd, &req, req.nlh.nlmsg_len, 0) == -1)) {
+        error("PROC_NET_DEV: cannot send the RTM_GETLINK request to netlink.");
+        return 1;
+    }
 
-                d->rd_rfifo = rrddim_add(d->st_fifo, "receive",  NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tfifo = rrddim_add(d->st_fifo, "transmit", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+    for(;;) {
+        // MSG_TRUNC makes recv() return the real size of the datagram
+        ssize_t bytes = recv(netdev_netlink_fd, netdev_netlink_buffer, NETDEV_NETLINK_BUFFER_SIZE, MSG_TRUNC);
+        if(unlikely(bytes == -1)) {
+            if(errno == EINTR) continue;
+            error("PROC_NET_DEV: cannot receive the RTM_GETLINK response from netlink.");
+            return 1;
+        }
 
-                if(d->flipped) {
-                    // flip receive/trasmit
+        if(unlikely(bytes == 0 || bytes > NETDEV_NETLINK_BUFFER_SIZE)) {
+            error("PROC_NET_DEV: received an invalid netlink datagram of %zd bytes.", bytes);
+            return 1;
+        }
 
-                    RRDDIM *td = d->rd_rfifo;
-                    d->rd_rfifo = d->rd_tfifo;
-                    d->rd_tfifo = td;
-                }
+        int len = (int)bytes;
+        struct nlmsghdr *nlh;
+        for(nlh = (struct nlmsghdr *)netdev_netlink_buffer; NLMSG_OK(nlh, len) ; nlh = NLMSG_NEXT(nlh, len)) {
+            if(unlikely(nlh->nlmsg_seq != netdev_netlink_seq))
+                continue;
+
+            if(unlikely(nlh->nlmsg_type == NLMSG_DONE))
+                return 0;
+
+            if(unlikely(nlh->nlmsg_type == NLMSG_ERROR)) {
+                error("PROC_NET_DEV: netlink failed to dump the network interfaces.");
+                return 1;
             }
-            else rrdset_next(d->st_fifo);
 
-            rrddim_set_by_pointer(d->st_fifo, d->rd_rfifo, (collected_number)d->rfifo);
-            rrddim_set_by_pointer(d->st_fifo, d->rd_tfifo, (collected_number)d->tfifo);
-            rrdset_done(d->st_fifo);
+            if(likely(nlh->nlmsg_type == RTM_NEWLINK))
+                netdev_netlink_link(nlh, update_every, dt, system_rbytes, system_tbytes);
         }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+int do_proc_net_dev(int update_every, usec_t dt) {
+    static procfile *ff = NULL;
+    static int use_netlink = -1;
+
+    if(unlikely(enable_new_interfaces == -1)) {
+        char filename[FILENAME_MAX + 1];
+
+        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, (*netdata_configured_host_prefix)?"/proc/1/net/dev":"/proc/net/dev");
+        proc_net_dev_filename = config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "filename to monitor", filename);
 
-        // --------------------------------------------------------------------
+        // netlink reports the interfaces of our own network namespace,
+        // so it can only replace the default filename
+        use_netlink = config_get_boolean(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "collect with netlink", !strcmp(proc_net_dev_filename, "/proc/net/dev"));
 
-        if(unlikely((d->do_compressed == CONFIG_BOOLEAN_AUTO && (d->rcompressed || d->tcompressed))))
-            d->do_compressed = CONFIG_BOOLEAN_YES;
+        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/sys/devices/virtual/net/%s");
+        path_to_sys_devices_virtual_net = config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "path to get virtual interfaces", filename);
 
-        if(d->do_compressed == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_compressed)) {
+        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/sys/class/net/%s/speed");
+        path_to_sys_class_net_speed = config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "path to get net device speed", filename);
 
-                d->st_compressed = rrdset_create_localhost(
-                        d->chart_type_net_compressed
-                        , d->chart_id_net_compressed
-                        , NULL
-                        , d->chart_family
-                        , "net.compressed"
-                        , "Compressed Packets"
-                        , "packets/s"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority + 5
-                        , update_every
-                        , RRDSET_TYPE_LINE
-                );
+        enable_new_interfaces = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "enable new interfaces detected at runtime", CONFIG_BOOLEAN_AUTO);
 
-                rrdset_flag_set(d->st_compressed, RRDSET_FLAG_DETAIL);
+        do_bandwidth    = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "bandwidth for all interfaces", CONFIG_BOOLEAN_AUTO);
+        do_packets      = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "packets for all interfaces", CONFIG_BOOLEAN_AUTO);
+        do_errors       = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "errors for all interfaces", CONFIG_BOOLEAN_AUTO);
+        do_drops        = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "drops for all interfaces", CONFIG_BOOLEAN_AUTO);
+        do_fifo         = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "fifo for all interfaces", CONFIG_BOOLEAN_AUTO);
+        do_compressed   = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "compressed packets for all interfaces", CONFIG_BOOLEAN_AUTO);
+        do_events       = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "frames, collisions, carrier counters for all interfaces", CONFIG_BOOLEAN_AUTO);
 
-                d->rd_rcompressed = rrddim_add(d->st_compressed, "received", NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tcompressed = rrddim_add(d->st_compressed, "sent",     NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+        disabled_list = simple_pattern_create(config_get(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "disable by default interfaces matching", "lo fireqos* *-ifb"), NULL, SIMPLE_PATTERN_EXACT);
 
-                if(d->flipped) {
-                    // flip receive/trasmit
+        dt_to_refresh_speed = config_get_number(CONFIG_SECTION_PLUGIN_PROC_NETDEV, "refresh interface speed every seconds", 10) * USEC_PER_SEC;
+        if(dt_to_refresh_speed < 0) dt_to_refresh_speed = 0;
+    }
 
-                    RRDDIM *td = d->rd_rcompressed;
-                    d->rd_rcompressed = d->rd_tcompressed;
-                    d->rd_tcompressed = td;
-                }
-            }
-            else rrdset_next(d->st_compressed);
+    if(unlikely(use_netlink && netdev_netlink_fd == -1)) {
+        netdev_netlink_fd = netdev_netlink_open();
+        if(unlikely(netdev_netlink_fd == -1)) {
+            error("PROC_NET_DEV: cannot use netlink, falling back to '%s'.", proc_net_dev_filename);
+            netdev_netlink_close();
+            use_netlink = 0;
+        }
+    }
 
-            rrddim_set_by_pointer(d->st_compressed, d->rd_rcompressed, (collected_number)d->rcompressed);
-            rrddim_set_by_pointer(d->st_compressed, d->rd_tcompressed, (collected_number)d->tcompressed);
-            rrdset_done(d->st_compressed);
+    if(unlikely(!use_netlink)) {
+        if(unlikely(!ff)) {
+            ff = procfile_open(proc_net_dev_filename, " \t,|", PROCFILE_FLAG_DEFAULT);
+            if(unlikely(!ff)) return 1;
         }
 
-        // --------------------------------------------------------------------
-
-        if(unlikely((d->do_events == CONFIG_BOOLEAN_AUTO && (d->rframe || d->tcollisions || d->tcarrier))))
-            d->do_events = CONFIG_BOOLEAN_YES;
-
-        if(d->do_events == CONFIG_BOOLEAN_YES) {
-            if(unlikely(!d->st_events)) {
-
-                d->st_events = rrdset_create_localhost(
-                        d->chart_type_net_events
-                        , d->chart_id_net_events
-                        , NULL
-                        , d->chart_family
-                        , "net.events"
-                        , "Network Interface Events"
-                        , "events/s"
-                        , PLUGIN_PROC_NAME
-                        , PLUGIN_PROC_MODULE_NETDEV_NAME
-                        , d->priority + 6
-                        , update_every
-                        , RRDSET_TYPE_LINE
-                );
-
-                rrdset_flag_set(d->st_events, RRDSET_FLAG_DETAIL);
-
-                d->rd_rframe      = rrddim_add(d->st_events, "frames",     NULL,  1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tcollisions = rrddim_add(d->st_events, "collisions", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
-                d->rd_tcarrier    = rrddim_add(d->st_events, "carrier",    NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
-            }
-            else rrdset_next(d->st_events);
+        ff = procfile_readall(ff);
+        if(unlikely(!ff)) return 0; // we return 0, so that we will retry to open it next time
+    }
+
+    // rename all the devices, if we have pending renames
+    if(unlikely(netdev_pending_renames))
+        netdev_rename_all_lock();
+
+    netdev_found = 0;
 
-            rrddim_set_by_pointer(d->st_events, d->rd_rframe,      (collected_number)d->rframe);
-            rrddim_set_by_pointer(d->st_events, d->rd_tcollisions, (collected_number)d->tcollisions);
-            rrddim_set_by_pointer(d->st_events, d->rd_tcarrier,    (collected_number)d->tcarrier);
-            rrdset_done(d->st_events);
+    kernel_uint_t system_rbytes = 0;
+    kernel_uint_t system_tbytes = 0;
+
+    if(likely(use_netlink)) {
+        if(unlikely(netdev_collect_netlink(update_every, dt, &system_rbytes, &system_tbytes))) {
+            // some interfaces may have been updated already - skip this iteration
+            error("PROC_NET_DEV: disabling netlink, falling back to '%s'.", proc_net_dev_filename);
+            netdev_netlink_close();
+            use_netlink = 0;
+            return 0;
         }
     }
+    else
+        netdev_collect_procfile(ff, update_every, dt, &system_rbytes, &system_tbytes);
 
     if(do_bandwidth == CONFIG_BOOLEAN_YES || (do_bandwidth == CONFIG_BOOLEAN_AUTO && (system_rbytes || system_tbytes))) {
         do_bandwidth = CONFIG_BOOLEAN_YES;
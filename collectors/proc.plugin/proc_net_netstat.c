@@ -135,8 +135,8 @@ int do_proc_net_netstat(int update_every, usec_t dt) {
         do_tcpext_syn_queue    = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETSTAT, "TCP SYN queue", CONFIG_BOOLEAN_AUTO);
         do_tcpext_accept_queue = config_get_boolean_ondemand(CONFIG_SECTION_PLUGIN_PROC_NETSTAT, "TCP accept queue", CONFIG_BOOLEAN_AUTO);
 
-        arl_ipext  = arl_create("netstat/ipext", NULL, 60);
-        arl_tcpext = arl_create("netstat/tcpext", NULL, 60);
+        arl_ipext  = arl_create_perfect_hash("netstat/ipext", NULL, 60);
+        arl_tcpext = arl_create_perfect_hash("netstat/tcpext", NULL, 60);
 
         // --------------------------------------------------------------------
         // IP
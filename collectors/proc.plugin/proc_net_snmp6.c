@@ -152,7 +152,7 @@ int do_proc_net_snmp6(int update_every, usec_t dt) {
         do_icmp_types       = config_get_boolean_ondemand("plugin:proc:/proc/net/snmp6", "icmp types", CONFIG_BOOLEAN_AUTO);
         do_ect              = config_get_boolean_ondemand("plugin:proc:/proc/net/snmp6", "ect", CONFIG_BOOLEAN_AUTO);
 
-        arl_base = arl_create("snmp6", NULL, 60);
+        arl_base = arl_create_perfect_hash("snmp6", NULL, 60);
         arl_expect(arl_base, "Ip6InReceives", &Ip6InReceives);
         arl_expect(arl_base, "Ip6InHdrErrors", &Ip6InHdrErrors);
         arl_expect(arl_base, "Ip6InTooBigErrors", &Ip6InTooBigErrors);
@@ -250,7 +250,7 @@ int do_proc_net_snmp6(int update_every, usec_t dt) {
     if(unlikely(!ff)) {
         char filename[FILENAME_MAX + 1];
         snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/proc/net/snmp6");
-        ff = procfile_open(config_get("plugin:proc:/proc/net/snmp6", "filename to monitor", filename), " \t:", PROCFILE_FLAG_DEFAULT);
+        ff = procfile_open(config_get("plugin:proc:/proc/net/snmp6", "filename to monitor", filename), " \t:", PROCFILE_FLAG_LAZY_LINES);
         if(unlikely(!ff))
             return 1;
     }
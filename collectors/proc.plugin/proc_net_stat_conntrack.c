@@ -2,15 +2,207 @@
 
 #include "plugin_proc.h"
 
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+
 #define RRD_TYPE_NET_STAT_NETFILTER     "netfilter"
 #define RRD_TYPE_NET_STAT_CONNTRACK     "conntrack"
 #define PLUGIN_PROC_MODULE_CONNTRACK_NAME "/proc/net/stat/nf_conntrack"
 
+// the fields of /proc/net/stat/nf_conntrack, in their order
+enum conntrack_field {
+    CONNTRACK_ENTRIES = 0,
+    CONNTRACK_SEARCHED,
+    CONNTRACK_FOUND,
+    CONNTRACK_NEW,
+    CONNTRACK_INVALID,
+    CONNTRACK_IGNORE,
+    CONNTRACK_DELETE,
+    CONNTRACK_DELETE_LIST,
+    CONNTRACK_INSERT,
+    CONNTRACK_INSERT_FAILED,
+    CONNTRACK_DROP,
+    CONNTRACK_EARLY_DROP,
+    CONNTRACK_ICMP_ERROR,
+    CONNTRACK_EXPECT_NEW,
+    CONNTRACK_EXPECT_CREATE,
+    CONNTRACK_EXPECT_DELETE,
+    CONNTRACK_SEARCH_RESTART,
+
+    // terminator
+    CONNTRACK_FIELDS
+};
+
+// the fields are 8 digit hex numbers, without a prefix
+static inline unsigned long long str2ull_hex(const char *s) {
+    unsigned long long n = 0;
+    char c;
+
+    while((c = *s++)) {
+        if(c >= '0' && c <= '9') n = (n << 4) | (unsigned long long)(c - '0');
+        else if(c >= 'a' && c <= 'f') n = (n << 4) | (unsigned long long)(c - 'a' + 10);
+        else if(c >= 'A' && c <= 'F') n = (n << 4) | (unsigned long long)(c - 'A' + 10);
+        else break;
+    }
+
+    return n;
+}
+
+// ----------------------------------------------------------------------------
+// ctnetlink
+//
+// The kernel sends the statistics of all the CPUs in one binary dump, instead
+// of a text line per CPU. It requires CAP_NET_ADMIN, so when netdata does not
+// have it, the file is read. The module does not link libmnl (nfacct.plugin
+// does, but it is a separate program), so the messages are built and parsed
+// here.
+
+#define CONNTRACK_NETLINK_ATTRS 32
+#define CONNTRACK_NETLINK_BUFFER_SIZE 32768
+
+static int conntrack_netlink_fd = -1;
+static uint32_t conntrack_netlink_seq = 0;
+
+static void conntrack_netlink_close(void) {
+    if(conntrack_netlink_fd != -1)
+        close(conntrack_netlink_fd);
+
+    conntrack_netlink_fd = -1;
+}
+
+// send a ctnetlink request and sum the u32 attributes of all its replies into values[]
+static int conntrack_netlink_query(uint16_t subsys, uint16_t msg, int dump, unsigned long long *values) {
+    static long buffer[CONNTRACK_NETLINK_BUFFER_SIZE / sizeof(long)];
+
+    memset(values, 0, CONNTRACK_NETLINK_ATTRS * sizeof(unsigned long long));
+
+    struct {
+        struct nlmsghdr nh;
+        struct nfgenmsg nfg;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+    req.nh.nlmsg_type = (uint16_t)((subsys << 8) | msg);
+    req.nh.nlmsg_flags = (uint16_t)(NLM_F_REQUEST | ((dump) ? NLM_F_DUMP : 0));
+    req.nh.nlmsg_seq = ++conntrack_netlink_seq;
+    req.nfg.nfgen_family = AF_UNSPEC;
+    req.nfg.version = NFNETLINK_V0;
+    req.nfg.res_id = 0;
+
+    if(unlikely(send(conntrack_netlink_fd, &req, req.nh.nlmsg_len, 0) == -1))
+        return -1;
+
+    for(;;) {
+        int len = (int)recv(conntrack_netlink_fd, buffer, sizeof(buffer), 0);
+        if(unlikely(len == -1 && errno == EINTR)) continue;
+        if(unlikely(len <= 0)) return -1;
+
+        struct nlmsghdr *nh;
+        for(nh = (struct nlmsghdr *)buffer; NLMSG_OK(nh, len) ; nh = NLMSG_NEXT(nh, len)) {
+            if(unlikely(nh->nlmsg_seq != conntrack_netlink_seq))
+                continue;
+
+            if(unlikely(nh->nlmsg_type == NLMSG_DONE))
+                return 0;
+
+            if(unlikely(nh->nlmsg_type == NLMSG_ERROR)) {
+                struct nlmsgerr *err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return -1;
+            }
+
+            struct nlattr *nla = (struct nlattr *)((char *)NLMSG_DATA(nh) + NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+            int rem = (int)nh->nlmsg_len - NLMSG_LENGTH(NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+
+            while(rem >= (int)sizeof(struct nlattr) && nla->nla_len >= sizeof(struct nlattr) && nla->nla_len <= rem) {
+                int type = nla->nla_type & NLA_TYPE_MASK;
+
+                if(likely(type < CONNTRACK_NETLINK_ATTRS && nla->nla_len >= NLA_HDRLEN + sizeof(uint32_t))) {
+                    uint32_t v;
+                    memcpy(&v, (char *)nla + NLA_HDRLEN, sizeof(v));
+                    values[type] += ntohl(v);
+                }
+
+                rem -= NLA_ALIGN(nla->nla_len);
+                nla = (struct nlattr *)((char *)nla + NLA_ALIGN(nla->nla_len));
+            }
+
+            // a request that is not a dump has a single reply
+            if(!dump) return 0;
+        }
+    }
+}
+
+// fill the fields of /proc/net/stat/nf_conntrack, summed for all the cpus
+static int conntrack_netlink_read(unsigned long long *fields) {
+    unsigned long long ct[CONNTRACK_NETLINK_ATTRS], exp[CONNTRACK_NETLINK_ATTRS], global[CONNTRACK_NETLINK_ATTRS];
+
+    if(unlikely(conntrack_netlink_query(NFNL_SUBSYS_CTNETLINK, IPCTNL_MSG_CT_GET_STATS_CPU, 1, ct)
+            || conntrack_netlink_query(NFNL_SUBSYS_CTNETLINK_EXP, IPCTNL_MSG_EXP_GET_STATS_CPU, 1, exp)
+            || conntrack_netlink_query(NFNL_SUBSYS_CTNETLINK, IPCTNL_MSG_CT_GET_STATS, 0, global)))
+        return -1;
+
+    fields[CONNTRACK_ENTRIES]        = global[CTA_STATS_GLOBAL_ENTRIES];
+    fields[CONNTRACK_SEARCHED]       = ct[CTA_STATS_SEARCHED];
+    fields[CONNTRACK_FOUND]          = ct[CTA_STATS_FOUND];
+    fields[CONNTRACK_NEW]            = ct[CTA_STATS_NEW];
+    fields[CONNTRACK_INVALID]        = ct[CTA_STATS_INVALID];
+    fields[CONNTRACK_IGNORE]         = ct[CTA_STATS_IGNORE];
+    fields[CONNTRACK_DELETE]         = ct[CTA_STATS_DELETE];
+    fields[CONNTRACK_DELETE_LIST]    = ct[CTA_STATS_DELETE_LIST];
+    fields[CONNTRACK_INSERT]         = ct[CTA_STATS_INSERT];
+    fields[CONNTRACK_INSERT_FAILED]  = ct[CTA_STATS_INSERT_FAILED];
+    fields[CONNTRACK_DROP]           = ct[CTA_STATS_DROP];
+    fields[CONNTRACK_EARLY_DROP]     = ct[CTA_STATS_EARLY_DROP];
+    fields[CONNTRACK_ICMP_ERROR]     = ct[CTA_STATS_ERROR];
+    fields[CONNTRACK_EXPECT_NEW]     = exp[CTA_STATS_EXP_NEW];
+    fields[CONNTRACK_EXPECT_CREATE]  = exp[CTA_STATS_EXP_CREATE];
+    fields[CONNTRACK_EXPECT_DELETE]  = exp[CTA_STATS_EXP_DELETE];
+    fields[CONNTRACK_SEARCH_RESTART] = ct[CTA_STATS_SEARCH_RESTART];
+
+    return 0;
+}
+
+static int conntrack_netlink_open(void) {
+    conntrack_netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER);
+    if(conntrack_netlink_fd == -1) {
+        error("Cannot create a netlink socket for conntrack statistics, reading '/proc/net/stat/nf_conntrack' instead.");
+        return -1;
+    }
+
+    // never block the proc plugin for long
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    if(setsockopt(conntrack_netlink_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1)
+        error("Cannot set a receive timeout to the conntrack netlink socket.");
+
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if(bind(conntrack_netlink_fd, (struct sockaddr *)&sa, sizeof(sa)) == -1) {
+        error("Cannot bind the conntrack netlink socket, reading '/proc/net/stat/nf_conntrack' instead.");
+        conntrack_netlink_close();
+        return -1;
+    }
+
+    unsigned long long fields[CONNTRACK_FIELDS];
+    if(conntrack_netlink_read(fields)) {
+        info("Cannot get conntrack statistics over netlink (netdata needs CAP_NET_ADMIN), reading '/proc/net/stat/nf_conntrack' instead.");
+        conntrack_netlink_close();
+        return -1;
+    }
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
 int do_proc_net_stat_conntrack(int update_every, usec_t dt) {
     static procfile *ff = NULL;
     static int do_sockets = -1, do_new = -1, do_changes = -1, do_expect = -1, do_search = -1, do_errors = -1;
     static usec_t get_max_every = 10 * USEC_PER_SEC, usec_since_last_max = 0;
-    static int read_full = 1;
+    static int read_full = 1, use_netlink = 1;
     static char *nf_conntrack_filename, *nf_conntrack_count_filename, *nf_conntrack_max_filename;
     static RRDVAR *rrdvar_max = NULL;
 
@@ -26,34 +218,66 @@ int do_proc_net_stat_conntrack(int update_every, usec_t dt) {
         nf_conntrack_max_filename = config_get("plugin:proc:/proc/sys/net/netfilter/nf_conntrack_max", "filename to monitor", filename);
         usec_since_last_max = get_max_every = config_get_number("plugin:proc:/proc/sys/net/netfilter/nf_conntrack_max", "read every seconds", 10) * USEC_PER_SEC;
 
+        // netlink reports the conntrack of the network namespace of netdata
+        use_netlink = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "use netlink", !*netdata_configured_host_prefix);
+        if(use_netlink && conntrack_netlink_open())
+            use_netlink = 0;
+
         read_full = 1;
         ff = procfile_open(nf_conntrack_filename, " \t:", PROCFILE_FLAG_DEFAULT);
         if(!ff) read_full = 0;
 
-        do_new = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter new connections", read_full);
-        do_changes = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connection changes", read_full);
-        do_expect = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connection expectations", read_full);
-        do_search = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connection searches", read_full);
-        do_errors = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter errors", read_full);
+        do_new = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter new connections", read_full || use_netlink);
+        do_changes = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connection changes", read_full || use_netlink);
+        do_expect = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connection expectations", read_full || use_netlink);
+        do_search = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connection searches", read_full || use_netlink);
+        do_errors = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter errors", read_full || use_netlink);
 
-        do_sockets = 1;
-        if(!read_full) {
-            snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/proc/sys/net/netfilter/nf_conntrack_count");
-            nf_conntrack_count_filename = config_get("plugin:proc:/proc/sys/net/netfilter/nf_conntrack_count", "filename to monitor", filename);
+        snprintfz(filename, FILENAME_MAX, "%s%s", netdata_configured_host_prefix, "/proc/sys/net/netfilter/nf_conntrack_count");
+        nf_conntrack_count_filename = config_get("plugin:proc:/proc/sys/net/netfilter/nf_conntrack_count", "filename to monitor", filename);
 
+        do_sockets = 1;
+        if(!read_full && !use_netlink) {
             if(read_single_number_file(nf_conntrack_count_filename, &aentries))
                 do_sockets = 0;
         }
 
         do_sockets = config_get_boolean("plugin:proc:/proc/net/stat/nf_conntrack", "netfilter connections", do_sockets);
 
-        if(!do_sockets && !read_full)
+        if(!do_sockets && !read_full && !use_netlink)
             return 1;
 
         rrdvar_max = rrdvar_custom_host_variable_create(localhost, "netfilter_conntrack_max");
     }
 
-    if(likely(read_full)) {
+    unsigned long long fields[CONNTRACK_FIELDS];
+
+    if(likely(use_netlink && !conntrack_netlink_read(fields))) {
+        aentries        = fields[CONNTRACK_ENTRIES];
+        asearched       = fields[CONNTRACK_SEARCHED];
+        afound          = fields[CONNTRACK_FOUND];
+        anew            = fields[CONNTRACK_NEW];
+        ainvalid        = fields[CONNTRACK_INVALID];
+        aignore         = fields[CONNTRACK_IGNORE];
+        adelete         = fields[CONNTRACK_DELETE];
+        adelete_list    = fields[CONNTRACK_DELETE_LIST];
+        ainsert         = fields[CONNTRACK_INSERT];
+        ainsert_failed  = fields[CONNTRACK_INSERT_FAILED];
+        adrop           = fields[CONNTRACK_DROP];
+        aearly_drop     = fields[CONNTRACK_EARLY_DROP];
+        aicmp_error     = fields[CONNTRACK_ICMP_ERROR];
+        aexpect_new     = fields[CONNTRACK_EXPECT_NEW];
+        aexpect_create  = fields[CONNTRACK_EXPECT_CREATE];
+        aexpect_delete  = fields[CONNTRACK_EXPECT_DELETE];
+        asearch_restart = fields[CONNTRACK_SEARCH_RESTART];
+    }
+    else if(unlikely(use_netlink)) {
+        error("Cannot get conntrack statistics over netlink, reading '%s' from now on.", nf_conntrack_filename);
+        conntrack_netlink_close();
+        use_netlink = 0;
+        return 0;
+    }
+    else if(likely(read_full)) {
         if(unlikely(!ff)) {
             ff = procfile_open(nf_conntrack_filename, " \t:", PROCFILE_FLAG_DEFAULT);
             if(unlikely(!ff))
@@ -75,23 +299,23 @@ int do_proc_net_stat_conntrack(int update_every, usec_t dt) {
 
             unsigned long long tentries = 0, tsearched = 0, tfound = 0, tnew = 0, tinvalid = 0, tignore = 0, tdelete = 0, tdelete_list = 0, tinsert = 0, tinsert_failed = 0, tdrop = 0, tearly_drop = 0, ticmp_error = 0, texpect_new = 0, texpect_create = 0, texpect_delete = 0, tsearch_restart = 0;
 
-            tentries        = strtoull(procfile_lineword(ff, l, 0), NULL, 16);
-            tsearched       = strtoull(procfile_lineword(ff, l, 1), NULL, 16);
-            tfound          = strtoull(procfile_lineword(ff, l, 2), NULL, 16);
-            tnew            = strtoull(procfile_lineword(ff, l, 3), NULL, 16);
-            tinvalid        = strtoull(procfile_lineword(ff, l, 4), NULL, 16);
-            tignore         = strtoull(procfile_lineword(ff, l, 5), NULL, 16);
-            tdelete         = strtoull(procfile_lineword(ff, l, 6), NULL, 16);
-            tdelete_list    = strtoull(procfile_lineword(ff, l, 7), NULL, 16);
-            tinsert         = strtoull(procfile_lineword(ff, l, 8), NULL, 16);
-            tinsert_failed  = strtoull(procfile_lineword(ff, l, 9), NULL, 16);
-            tdrop           = strtoull(procfile_lineword(ff, l, 10), NULL, 16);
-            tearly_drop     = strtoull(procfile_lineword(ff, l, 11), NULL, 16);
-            ticmp_error     = strtoull(procfile_lineword(ff, l, 12), NULL, 16);
-            texpect_new     = strtoull(procfile_lineword(ff, l, 13), NULL, 16);
-            texpect_create  = strtoull(procfile_lineword(ff, l, 14), NULL, 16);
-            texpect_delete  = strtoull(procfile_lineword(ff, l, 15), NULL, 16);
-            tsearch_restart = strtoull(procfile_lineword(ff, l, 16), NULL, 16);
+            tentries        = str2ull_hex(procfile_lineword(ff, l, 0));
+            tsearched       = str2ull_hex(procfile_lineword(ff, l, 1));
+            tfound          = str2ull_hex(procfile_lineword(ff, l, 2));
+            tnew            = str2ull_hex(procfile_lineword(ff, l, 3));
+            tinvalid        = str2ull_hex(procfile_lineword(ff, l, 4));
+            tignore         = str2ull_hex(procfile_lineword(ff, l, 5));
+            tdelete         = str2ull_hex(procfile_lineword(ff, l, 6));
+            tdelete_list    = str2ull_hex(procfile_lineword(ff, l, 7));
+            tinsert         = str2ull_hex(procfile_lineword(ff, l, 8));
+            tinsert_failed  = str2ull_hex(procfile_lineword(ff, l, 9));
+            tdrop           = str2ull_hex(procfile_lineword(ff, l, 10));
+            tearly_drop     = str2ull_hex(procfile_lineword(ff, l, 11));
+            ticmp_error     = str2ull_hex(procfile_lineword(ff, l, 12));
+            texpect_new     = str2ull_hex(procfile_lineword(ff, l, 13));
+            texpect_create  = str2ull_hex(procfile_lineword(ff, l, 14));
+            texpect_delete  = str2ull_hex(procfile_lineword(ff, l, 15));
+            tsearch_restart = str2ull_hex(procfile_lineword(ff, l, 16));
 
             if(unlikely(!aentries)) aentries =  tentries;
 
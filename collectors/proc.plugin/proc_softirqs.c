@@ -17,7 +17,7 @@ struct interrupt {
     char name[MAX_INTERRUPT_NAME + 1];
     RRDDIM *rd;
     unsigned long long total;
-    struct cpu_interrupt cpu[];
+    struct cpu_interrupt cpu[];     // the cpus, followed by the numa nodes when softirqs are aggregated per node
 };
 
 // since each interrupt is variable in size
@@ -55,11 +55,14 @@ static inline struct interrupt *get_interrupts_array(size_t lines, int cpus) {
 int do_proc_softirqs(int update_every, usec_t dt) {
     (void)dt;
     static procfile *ff = NULL;
-    static int cpus = -1, do_per_core = CONFIG_BOOLEAN_INVALID;
+    static int cpus = -1, nodes = 0, do_per_core = CONFIG_BOOLEAN_INVALID, do_per_node = CONFIG_BOOLEAN_INVALID;
+    static int *cpu_node = NULL;
     struct interrupt *irrs = NULL;
 
-    if(unlikely(do_per_core == CONFIG_BOOLEAN_INVALID))
+    if(unlikely(do_per_core == CONFIG_BOOLEAN_INVALID)) {
         do_per_core = config_get_boolean_ondemand("plugin:proc:/proc/softirqs", "interrupts per core", CONFIG_BOOLEAN_AUTO);
+        do_per_node = config_get_boolean("plugin:proc:/proc/softirqs", "interrupts per numa node instead of per core", CONFIG_BOOLEAN_NO);
+    }
 
     if(unlikely(!ff)) {
         char filename[FILENAME_MAX + 1];
@@ -94,30 +97,59 @@ int do_proc_softirqs(int update_every, usec_t dt) {
         return 1;
     }
 
+    // on machines with hundreds of cpus, chart the softirqs of each numa node
+    if(unlikely(do_per_node == CONFIG_BOOLEAN_YES)) {
+        do_per_node = CONFIG_BOOLEAN_NO;
+
+        if(do_per_core != CONFIG_BOOLEAN_NO) {
+            cpu_node = mallocz(cpus * sizeof(int));
+            nodes = get_cpu_columns_numa_nodes(ff, cpus, cpu_node);
+
+            if(unlikely(!nodes)) {
+                info("PLUGIN: PROC_SOFTIRQS: the CPUs do not belong to NUMA nodes, charting the softirqs per core.");
+                freez(cpu_node);
+                cpu_node = NULL;
+            }
+        }
+    }
+
+    // the numa nodes are kept after the cpus of each softirq
+    int columns = cpus + nodes;
+
     // allocate the size we need;
-    irrs = get_interrupts_array(lines, cpus);
+    irrs = get_interrupts_array(lines, columns);
     irrs[0].used = 0;
 
     // loop through all lines
     for(l = 1; l < lines ;l++) {
-        struct interrupt *irr = irrindex(irrs, l, cpus);
+        struct interrupt *irr = irrindex(irrs, l, columns);
         irr->used = 0;
         irr->total = 0;
 
         words = procfile_linewords(ff, l);
         if(unlikely(!words)) continue;
 
-        irr->id = procfile_lineword(ff, l, 0);
+        // the lines are as wide as the cpus, so walk their words directly
+        char **row = procfile_linewords_array(ff, l);
+
+        irr->id = row[0];
         if(unlikely(!irr->id || !irr->id[0])) continue;
 
-        int c;
-        for(c = 0; c < cpus ;c++) {
-            if(likely((c + 1) < (int)words))
-                irr->cpu[c].value = str2ull(procfile_lineword(ff, l, (uint32_t)(c + 1)));
-            else
+        int c, values = ((int)words - 1 < cpus) ? (int)words - 1 : cpus;
+        for(c = 0; c < values ;c++) {
+            irr->cpu[c].value = str2ull(row[c + 1]);
+            irr->total += irr->cpu[c].value;
+        }
+        for(; c < cpus ;c++)
+            irr->cpu[c].value = 0;
+
+        if(unlikely(nodes)) {
+            for(c = cpus; c < columns ;c++)
                 irr->cpu[c].value = 0;
 
-            irr->total += irr->cpu[c].value;
+            for(c = 0; c < cpus ;c++)
+                if(likely(cpu_node[c] >= 0))
+                    irr->cpu[cpus + cpu_node[c]].value += irr->cpu[c].value;
         }
 
         strncpyz(irr->name, irr->id, MAX_INTERRUPT_NAME);
@@ -147,7 +179,7 @@ int do_proc_softirqs(int update_every, usec_t dt) {
         rrdset_next(st_system_softirqs);
 
     for(l = 0; l < lines ;l++) {
-        struct interrupt *irr = irrindex(irrs, l, cpus);
+        struct interrupt *irr = irrindex(irrs, l, columns);
 
         if(irr->used && irr->total) {
             // some interrupt may have changed without changing the total number of lines
@@ -160,7 +192,7 @@ int do_proc_softirqs(int update_every, usec_t dt) {
                 // also reset per cpu RRDDIMs to avoid repeating strncmp() in the per core loop
                 if(likely(do_per_core != CONFIG_BOOLEAN_NO)) {
                     int c;
-                    for(c = 0; c < cpus; c++) irr->cpu[c].rd = NULL;
+                    for(c = 0; c < columns; c++) irr->cpu[c].rd = NULL;
                 }
             }
 
@@ -172,7 +204,58 @@ int do_proc_softirqs(int update_every, usec_t dt) {
 
     // --------------------------------------------------------------------
 
-    if(do_per_core != CONFIG_BOOLEAN_NO) {
+    if(unlikely(nodes)) {
+        static RRDSET **node_st = NULL;
+
+        if(unlikely(!node_st))
+            node_st = callocz(nodes, sizeof(RRDSET *));
+
+        int n;
+
+        for(n = 0; n < nodes ;n++) {
+            if(unlikely(!node_st[n])) {
+                char id[50 + 1];
+                snprintfz(id, 50, "node%d_softirqs", n);
+
+                char title[100 + 1];
+                snprintfz(title, 100, "NUMA Node %d softirqs", n);
+
+                node_st[n] = rrdset_create_localhost(
+                        "cpu"
+                        , id
+                        , NULL
+                        , "softirqs"
+                        , "cpu.node_softirqs"
+                        , title
+                        , "softirqs/s"
+                        , PLUGIN_PROC_NAME
+                        , PLUGIN_PROC_MODULE_SOFTIRQS_NAME
+                        , NETDATA_CHART_PRIO_SOFTIRQS_PER_CORE + n
+                        , update_every
+                        , RRDSET_TYPE_STACKED
+                );
+            }
+            else
+                rrdset_next(node_st[n]);
+
+            for(l = 0; l < lines ;l++) {
+                struct interrupt *irr = irrindex(irrs, l, columns);
+                struct cpu_interrupt *ci = &irr->cpu[cpus + n];
+
+                if(irr->used && (do_per_core == CONFIG_BOOLEAN_YES || ci->value)) {
+                    if(unlikely(!ci->rd)) {
+                        ci->rd = rrddim_add(node_st[n], irr->id, irr->name, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+                        rrddim_set_name(node_st[n], ci->rd, irr->name);
+                    }
+
+                    rrddim_set_by_pointer(node_st[n], ci->rd, ci->value);
+                }
+            }
+
+            rrdset_done(node_st[n]);
+        }
+    }
+    else if(do_per_core != CONFIG_BOOLEAN_NO) {
         static RRDSET **core_st = NULL;
         static int old_cpus = 0;
 
@@ -190,7 +273,7 @@ int do_proc_softirqs(int update_every, usec_t dt) {
                 unsigned long long core_sum = 0;
 
                 for (l = 0; l < lines; l++) {
-                    struct interrupt *irr = irrindex(irrs, l, cpus);
+                    struct interrupt *irr = irrindex(irrs, l, columns);
                     if (unlikely(!irr->used)) continue;
                     core_sum += irr->cpu[c].value;
                 }
@@ -222,7 +305,7 @@ int do_proc_softirqs(int update_every, usec_t dt) {
                 rrdset_next(core_st[c]);
 
             for(l = 0; l < lines ;l++) {
-                struct interrupt *irr = irrindex(irrs, l, cpus);
+                struct interrupt *irr = irrindex(irrs, l, columns);
 
                 if(irr->used && (do_per_core == CONFIG_BOOLEAN_YES || irr->cpu[c].value)) {
                     if(unlikely(!irr->cpu[c].rd)) {
@@ -8,9 +8,8 @@
 extern struct arcstats arcstats;
 
 int do_proc_spl_kstat_zfs_arcstats(int update_every, usec_t dt) {
-    (void)dt;
-
     static int show_zero_charts = 0, do_zfs_stats = 0;
+    static usec_t pools_check_every = 0, pools_check_delta = 0;
     static procfile *ff = NULL;
     static char *dirname = NULL;
     static ARL_BASE *arl_base = NULL;
@@ -126,10 +125,15 @@ int do_proc_spl_kstat_zfs_arcstats(int update_every, usec_t dt) {
         show_zero_charts = config_get_boolean_ondemand("plugin:proc:" ZFS_PROC_ARCSTATS, "show zero charts", CONFIG_BOOLEAN_NO);
         if(unlikely(show_zero_charts == CONFIG_BOOLEAN_YES))
             do_zfs_stats = 1;
+
+        pools_check_every = pools_check_delta = config_get_number("plugin:proc:" ZFS_PROC_ARCSTATS, "check for pools every", 10) * USEC_PER_SEC;
     }
 
     // check if any pools exist
-    if(likely(!do_zfs_stats)) {
+    pools_check_delta += dt;
+    if(likely(!do_zfs_stats && pools_check_delta >= pools_check_every)) {
+        pools_check_delta = 0;
+
         DIR *dir = opendir(dirname);
         if(unlikely(!dir)) {
             error("Cannot read directory '%s'", dirname);
@@ -30,14 +30,22 @@ typedef struct btrfs_node {
     // unsigned long long int nodesize;
     // unsigned long long int quota_override;
 
+    // the allocation files are kept open (the fd is 0 when not open)
+
     #define declare_btrfs_allocation_section_field(SECTION, FIELD) \
         char *allocation_ ## SECTION ## _ ## FIELD ## _filename; \
+        int allocation_ ## SECTION ## _ ## FIELD ## _fd; \
         unsigned long long int allocation_ ## SECTION ## _ ## FIELD;
 
     #define declare_btrfs_allocation_field(FIELD) \
         char *allocation_ ## FIELD ## _filename; \
+        int allocation_ ## FIELD ## _fd; \
         unsigned long long int allocation_ ## FIELD;
 
+    // the allocation changes slowly, so it may be collected less frequently
+    usec_t allocation_every;
+    usec_t allocation_delta;
+
     RRDSET *st_allocation_disks;
     RRDDIM *rd_allocation_disks_unallocated;
     RRDDIM *rd_allocation_disks_data_used;
@@ -104,14 +112,26 @@ static inline void btrfs_free_node(BTRFS_NODE *node) {
     if(node->st_allocation_system)
         rrdset_is_obsolete(node->st_allocation_system);
 
-    freez(node->allocation_data_bytes_used_filename);
-    freez(node->allocation_data_total_bytes_filename);
+    #define free_btrfs_allocation_field(FIELD) { \
+        freez(node->allocation_ ## FIELD ## _filename); \
+        if(node->allocation_ ## FIELD ## _fd > 0) close(node->allocation_ ## FIELD ## _fd); \
+    }
 
-    freez(node->allocation_metadata_bytes_used_filename);
-    freez(node->allocation_metadata_total_bytes_filename);
+    free_btrfs_allocation_field(data_total_bytes);
+    free_btrfs_allocation_field(data_bytes_used);
+    free_btrfs_allocation_field(data_disk_total);
+    free_btrfs_allocation_field(data_disk_used);
 
-    freez(node->allocation_system_bytes_used_filename);
-    freez(node->allocation_system_total_bytes_filename);
+    free_btrfs_allocation_field(metadata_total_bytes);
+    free_btrfs_allocation_field(metadata_bytes_used);
+    free_btrfs_allocation_field(metadata_disk_total);
+    free_btrfs_allocation_field(metadata_disk_used);
+    free_btrfs_allocation_field(global_rsv_size);
+
+    free_btrfs_allocation_field(system_total_bytes);
+    free_btrfs_allocation_field(system_bytes_used);
+    free_btrfs_allocation_field(system_disk_total);
+    free_btrfs_allocation_field(system_disk_used);
 
     while(node->disks) {
         BTRFS_DISK *d = node->disks;
@@ -124,6 +144,26 @@ static inline void btrfs_free_node(BTRFS_NODE *node) {
     freez(node);
 }
 
+// read a number from a file kept open, opening it when needed
+static inline int btrfs_read_number(const char *filename, int *fd, unsigned long long *value) {
+    if(unlikely(*fd <= 0)) {
+        *fd = open(filename, O_RDONLY | O_CLOEXEC, 0666);
+        if(unlikely(*fd == -1)) {
+            *fd = 0;
+            *value = 0;
+            return 1;
+        }
+    }
+
+    if(unlikely(read_single_number_fd(*fd, value))) {
+        close(*fd);
+        *fd = 0;
+        return 1;
+    }
+
+    return 0;
+}
+
 static inline int find_btrfs_disks(BTRFS_NODE *node, const char *path) {
     char filename[FILENAME_MAX + 1];
 
@@ -246,7 +286,7 @@ static inline int find_btrfs_disks(BTRFS_NODE *node, const char *path) {
 }
 
 
-static inline int find_all_btrfs_pools(const char *path) {
+static inline int find_all_btrfs_pools(const char *path, usec_t allocation_every) {
     static int logged_error = 0;
     char filename[FILENAME_MAX + 1];
 
@@ -324,6 +364,12 @@ static inline int find_all_btrfs_pools(const char *path) {
                 node->label = strdupz(node->id);
         }
 
+        {
+            char var_name[4096 + 1];
+            snprintfz(var_name, 4096, "plugin:proc:/sys/fs/btrfs:%s", node->label);
+            node->allocation_every = config_get_number(var_name, "collect allocation every", allocation_every / USEC_PER_SEC) * USEC_PER_SEC;
+        }
+
         //snprintfz(filename, FILENAME_MAX, "%s/%s/sectorsize", path, de->d_name);
         //if(read_single_number_file(filename, &node->sectorsize) != 0) {
         //    error("BTRFS: failed to read '%s'", filename);
@@ -350,7 +396,7 @@ static inline int find_all_btrfs_pools(const char *path) {
 
         #define init_btrfs_allocation_field(FIELD) {\
             snprintfz(filename, FILENAME_MAX, "%s/%s/allocation/" #FIELD, path, de->d_name); \
-            if(read_single_number_file(filename, &node->allocation_ ## FIELD) != 0) {\
+            if(btrfs_read_number(filename, &node->allocation_ ## FIELD ## _fd, &node->allocation_ ## FIELD) != 0) {\
                 error("BTRFS: failed to read '%s'", filename);\
                 btrfs_free_node(node);\
                 continue;\
@@ -361,7 +407,7 @@ static inline int find_all_btrfs_pools(const char *path) {
 
         #define init_btrfs_allocation_section_field(SECTION, FIELD) {\
             snprintfz(filename, FILENAME_MAX, "%s/%s/allocation/" #SECTION "/" #FIELD, path, de->d_name); \
-            if(read_single_number_file(filename, &node->allocation_ ## SECTION ## _ ## FIELD) != 0) {\
+            if(btrfs_read_number(filename, &node->allocation_ ## SECTION ## _ ## FIELD ## _fd, &node->allocation_ ## SECTION ## _ ## FIELD) != 0) {\
                 error("BTRFS: failed to read '%s'", filename);\
                 btrfs_free_node(node);\
                 continue;\
@@ -455,11 +501,9 @@ int do_sys_fs_btrfs(int update_every, usec_t dt) {
         , do_allocation_data = CONFIG_BOOLEAN_AUTO
         , do_allocation_metadata = CONFIG_BOOLEAN_AUTO;
 
-    static usec_t refresh_delta = 0, refresh_every = 60 * USEC_PER_SEC;
+    static usec_t refresh_delta = 0, refresh_every = 60 * USEC_PER_SEC, allocation_every = 0;
     static char *btrfs_path = NULL;
 
-    (void)dt;
-
     if(unlikely(!initialized)) {
         initialized = 1;
 
@@ -470,6 +514,8 @@ int do_sys_fs_btrfs(int update_every, usec_t dt) {
         refresh_every = config_get_number("plugin:proc:/sys/fs/btrfs", "check for btrfs changes every", refresh_every / USEC_PER_SEC) * USEC_PER_SEC;
         refresh_delta = refresh_every;
 
+        allocation_every = config_get_number("plugin:proc:/sys/fs/btrfs", "collect allocation every", update_every) * USEC_PER_SEC;
+
         do_allocation_disks = config_get_boolean_ondemand("plugin:proc:/sys/fs/btrfs", "physical disks allocation", do_allocation_disks);
         do_allocation_data = config_get_boolean_ondemand("plugin:proc:/sys/fs/btrfs", "data allocation", do_allocation_data);
         do_allocation_metadata = config_get_boolean_ondemand("plugin:proc:/sys/fs/btrfs", "metadata allocation", do_allocation_metadata);
@@ -479,7 +525,7 @@ int do_sys_fs_btrfs(int update_every, usec_t dt) {
     refresh_delta += dt;
     if(refresh_delta >= refresh_every) {
         refresh_delta = 0;
-        find_all_btrfs_pools(btrfs_path);
+        find_all_btrfs_pools(btrfs_path, allocation_every);
     }
 
     BTRFS_NODE *node;
@@ -488,10 +534,17 @@ int do_sys_fs_btrfs(int update_every, usec_t dt) {
         // allocation/system
 
         #define collect_btrfs_allocation_field(FIELD) \
-            read_single_number_file(node->allocation_ ## FIELD ## _filename, &node->allocation_ ## FIELD)
+            btrfs_read_number(node->allocation_ ## FIELD ## _filename, &node->allocation_ ## FIELD ## _fd, &node->allocation_ ## FIELD)
 
         #define collect_btrfs_allocation_section_field(SECTION, FIELD) \
-            read_single_number_file(node->allocation_ ## SECTION ## _ ## FIELD ## _filename, &node->allocation_ ## SECTION ## _ ## FIELD)
+            btrfs_read_number(node->allocation_ ## SECTION ## _ ## FIELD ## _filename, &node->allocation_ ## SECTION ## _ ## FIELD ## _fd, &node->allocation_ ## SECTION ## _ ## FIELD)
+
+        // between the collections of the allocation, the charts get the last values
+        node->allocation_delta += dt;
+        if(node->allocation_delta < node->allocation_every)
+            goto charts;
+
+        node->allocation_delta = 0;
 
         if(do_allocation_disks != CONFIG_BOOLEAN_NO) {
             if(     collect_btrfs_allocation_section_field(data, disk_total) != 0
@@ -542,6 +595,7 @@ int do_sys_fs_btrfs(int update_every, usec_t dt) {
         // --------------------------------------------------------------------
         // allocation/disks
 
+charts:
         if(do_allocation_disks == CONFIG_BOOLEAN_YES || (do_allocation_disks == CONFIG_BOOLEAN_AUTO && node->all_disks_total && node->allocation_data_disk_total)) {
             do_allocation_disks = CONFIG_BOOLEAN_YES;
 
@@ -8,10 +8,8 @@
 
 // --------------------------------------------------------------------------------------
 
-// #define STATSD_MULTITHREADED 1
-
-#ifdef STATSD_MULTITHREADED
-// DO NOT ENABLE MULTITHREADING - IT IS NOT WELL TESTED
+// the collector threads add the metrics to the indexes, the charting thread walks them
+// (the values of the metrics are aggregated by every collector thread in its own shard)
 #define STATSD_AVL_TREE avl_tree_lock
 #define STATSD_AVL_INSERT avl_insert_lock
 #define STATSD_AVL_SEARCH avl_search_lock
@@ -20,18 +18,7 @@
 #define STATSD_FIRST_PTR_MUTEX_INIT .first_mutex = NETDATA_MUTEX_INITIALIZER
 #define STATSD_FIRST_PTR_MUTEX_LOCK(index) netdata_mutex_lock(&((index)->first_mutex))
 #define STATSD_FIRST_PTR_MUTEX_UNLOCK(index) netdata_mutex_unlock(&((index)->first_mutex))
-#define STATSD_DICTIONARY_OPTIONS DICTIONARY_FLAG_DEFAULT
-#else
-#define STATSD_AVL_TREE avl_tree
-#define STATSD_AVL_INSERT avl_insert
-#define STATSD_AVL_SEARCH avl_search
-#define STATSD_AVL_INDEX_INIT { .root = NULL, .compar = statsd_metric_compare }
-#define STATSD_FIRST_PTR_MUTEX
-#define STATSD_FIRST_PTR_MUTEX_INIT
-#define STATSD_FIRST_PTR_MUTEX_LOCK(index)
-#define STATSD_FIRST_PTR_MUTEX_UNLOCK(index)
 #define STATSD_DICTIONARY_OPTIONS DICTIONARY_FLAG_SINGLE_THREADED
-#endif
 
 #define STATSD_DECIMAL_DETAIL 1000 // floating point values get multiplied by this, with the same divisor
 
@@ -46,9 +33,37 @@ typedef struct statsd_metric_counter { // counter and meter
     long long value;
 } STATSD_METRIC_COUNTER;
 
-typedef struct statsd_histogram_extensions {
-    netdata_mutex_t mutex;
+// a histogram sketch keeps the number of values (their weights, actually) in logarithmic bins,
+// so that every bin covers the values within a relative accuracy of the value it gives for them
+// a value v > 0 goes to the bin ceil(log(v) / log(gamma)), with gamma = (1 + accuracy) / (1 - accuracy)
+// (the negative values go to the same bins of their own, and the ones that round to zero to a single bin)
+// the bins are kept in memory for the range of the keys seen, up to STATSD_SKETCH_BINS_MAX - then
+// the lowest keys are collapsed into one bin - so a sketch needs the same memory, whatever the
+// number of values added to it
+
+#define STATSD_SKETCH_BINS_MAX 2048
+#define STATSD_SKETCH_BINS_STEP 32
+
+typedef struct statsd_sketch_bins {
+    int offset;             // the key of bin 0
+    int size;               // the number of bins allocated
+    double *counts;         // the weights of the values in every bin
+} STATSD_SKETCH_BINS;
+
+typedef struct statsd_sketch {
+    STATSD_SKETCH_BINS positive;
+    STATSD_SKETCH_BINS negative;
+    double zero;            // the weight of the values that round to zero
+
+    double count;           // the weight of all the values
+    LONG_DOUBLE min;
+    LONG_DOUBLE max;
+    LONG_DOUBLE sum;
+    LONG_DOUBLE mean;       // the running mean and the sum of the squared differences
+    LONG_DOUBLE m2;         // from it, for the standard deviation
+} STATSD_SKETCH;
 
+typedef struct statsd_histogram_extensions {
     // average is stored in metric->last
     collected_number last_min;
     collected_number last_max;
@@ -69,6 +84,8 @@ typedef struct statsd_histogram_extensions {
     size_t size;
     size_t used;
     LONG_DOUBLE *values;   // dynamic array of values collected
+
+    STATSD_SKETCH *sketch; // or the sketch of the values collected, instead of them
 } STATSD_METRIC_HISTOGRAM_EXTENSIONS;
 
 typedef struct statsd_metric_histogram { // histogram and timer
@@ -78,6 +95,7 @@ typedef struct statsd_metric_histogram { // histogram and timer
 typedef struct statsd_metric_set {
     DICTIONARY *dict;
     size_t unique;
+    uint8_t *registers;    // or the registers of a hyperloglog, to estimate the unique values
 } STATSD_METRIC_SET;
 
 
@@ -94,6 +112,9 @@ typedef enum statsd_metric_options {
     STATSD_METRIC_OPTION_USED_IN_APPS                 = 0x00000020, // set when this metric is used in apps
     STATSD_METRIC_OPTION_CHECKED                      = 0x00000040, // set when the charting thread checks this metric for use in charts (its usefulness)
     STATSD_METRIC_OPTION_USEFUL                       = 0x00000080, // set when the charting thread finds the metric useful (i.e. used in a chart)
+    STATSD_METRIC_OPTION_SET_HYPERLOGLOG              = 0x00000100, // count the unique values of this set with a hyperloglog
+    STATSD_METRIC_OPTION_KEEP_TAGS                    = 0x00000200, // the values of this metric with tags go to a metric of their tag set
+    STATSD_METRIC_OPTION_TAG_SETS_EXCEEDED            = 0x00000400, // set when this metric has reached the maximum number of tag sets
 } STATS_METRIC_OPTIONS;
 
 typedef enum statsd_metric_type {
@@ -105,12 +126,16 @@ typedef enum statsd_metric_type {
     STATSD_METRIC_TYPE_SET
 } STATSD_METRIC_TYPE;
 
+#define STATSD_METRIC_TYPES (STATSD_METRIC_TYPE_SET + 1)
+
 
 typedef struct statsd_metric {
     avl avl;                        // indexing - has to be first
 
     const char *name;               // the name of the metric
     uint32_t hash;                  // hash of the name
+    const char *tags;               // the tag set of the metric (interned), NULL for the metrics without tags
+    size_t tag_sets;                // the number of tag sets of the metric name (on the metric without tags)
 
     STATSD_METRIC_TYPE type;
 
@@ -118,7 +143,7 @@ typedef struct statsd_metric {
     collected_number events;        // the number of times this metric has been collected (never resets)
     size_t count;                   // the number of times this metric has been collected since the last flush
 
-    // the actual collected data
+    // the actual collected data, merged from the shards of the collector threads
     union {
         STATSD_METRIC_GAUGE gauge;
         STATSD_METRIC_COUNTER counter;
@@ -128,7 +153,7 @@ typedef struct statsd_metric {
 
     // chart related members
     STATS_METRIC_OPTIONS options;   // STATSD_METRIC_OPTION_* (bitfield)
-    char reset;                     // set to 1 by the charting thread to instruct the collector thread(s) to reset this metric
+    char reset;                     // set to 1 by the charting thread, to reset this metric when the next data are merged into it
     collected_number last;          // the last value sent to netdata
     RRDSET *st;                     // the private chart of this metric
     RRDDIM *rd_value;               // the dimension of this metric value
@@ -160,6 +185,75 @@ typedef struct statsd_index {
 
 static int statsd_metric_compare(void* a, void* b);
 
+// --------------------------------------------------------------------------------------------------------------------
+// collector thread shards
+// every collector thread aggregates the values it receives in a shard of its own, with the values of every
+// metric since they were last merged into it - the charting thread merges them into the metrics before
+// flushing them, so that the collector threads never update the same memory
+// a collector thread holds the mutex of its shard while it processes the data it receives, and the
+// charting thread while it merges the shard
+
+// the names of the metrics are hashed with FNV-1a while they are parsed, the finalizer of murmur3
+// spreads the bits of the hash for the slots of the hash tables
+#define STATSD_HASH_INIT 14695981039346656037ULL
+#define statsd_hash_add(h, c) (((h) ^ (uint64_t)(unsigned char)(c)) * 1099511628211ULL)
+
+static inline uint64_t statsd_hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#define STATSD_SHARD_SLOTS_INITIAL 1024
+#define STATSD_NAMES_CHUNK_SIZE 65536
+
+typedef struct statsd_shard_metric {
+    uint64_t key;                   // the hash of the name and the type, that indexes it in the shard
+    STATSD_METRIC *m;               // the metric (and tag set) these values are for
+    size_t events;                  // the values received since the last merge
+
+    union {
+        struct {
+            LONG_DOUBLE value;
+            int absolute;           // a value was set, so value is not just the sum of the increments
+        } gauge;
+
+        long long counter;          // counter and meter
+
+        struct {                    // histogram and timer
+            size_t size;
+            size_t used;
+            LONG_DOUBLE *values;
+            STATSD_SKETCH *sketch;
+        } histogram;
+
+        struct {
+            DICTIONARY *dict;
+            uint8_t *registers;
+        } set;
+    };
+
+    struct statsd_shard_metric *next_updated;
+} STATSD_SHARD_METRIC;
+
+typedef struct statsd_shard {
+    netdata_mutex_t mutex;
+
+    STATSD_SHARD_METRIC **slots;    // the metrics of the shard, in an open addressing hash table
+    size_t size;                    // the number of slots (a power of 2)
+    size_t used;                    // the number of metrics in the slots
+
+    char *names;                    // the chunk the names of the metrics the shard adds are copied to
+    size_t names_used;              // (the metrics are never freed, so the chunks are not either)
+    size_t names_size;
+
+    STATSD_SHARD_METRIC *first_updated;     // the metrics updated since the last merge
+    size_t events[STATSD_METRIC_TYPES];     // the events of every metric type since the last merge
+} STATSD_SHARD;
+
 // --------------------------------------------------------------------------------------------------------------------
 // synthetic charts
 
@@ -181,6 +275,9 @@ typedef struct statsd_app_chart_dimension {
     uint32_t metric_hash;           // hash for fast string comparisons
 
     SIMPLE_PATTERN *metric_pattern; // set when the 'metric' is a simple pattern
+    const char *tag;                // set when the values of this tag of the 'metric' give the dimensions
+    const char *tags;               // the tag set of the metric of this dimension, NULL for metrics without tags
+    const char *id;                 // the id of the dimension, when it is not the metric
 
     collected_number multiplier;    // the multipler of the dimension
     collected_number divisor;       // the divisor of the dimension
@@ -232,12 +329,23 @@ typedef struct statsd_app {
 struct collection_thread_status {
     int status;
     size_t max_sockets;
+    LISTEN_SOCKETS *sockets;            // the sockets this thread receives metrics from
+    STATSD_SHARD shard;                 // the values this thread has received since the last merge
+
+    size_t udp_socket_reads;
+    size_t udp_packets_received;
+    size_t udp_bytes_read;
+    size_t udp_packets_dropped;         // by the kernel, because the receive buffers of the sockets were full
+    uint32_t udp_socket_drops[MAX_LISTEN_FDS]; // the last drops counter the kernel gave for each of the sockets
 
     netdata_thread_t thread;
     struct rusage rusage;
     RRDSET *st_cpu;
     RRDDIM *rd_user;
     RRDDIM *rd_system;
+    RRDSET *st_packets;
+    RRDDIM *rd_received;
+    RRDDIM *rd_dropped;
 };
 
 static struct statsd {
@@ -264,6 +372,7 @@ static struct statsd {
     SIMPLE_PATTERN *charts_for;
 
     size_t tcp_idle_timeout;
+    size_t tcp_buffer_size;
     collected_number decimal_detail;
     size_t private_charts;
     size_t max_private_charts;
@@ -277,6 +386,16 @@ static struct statsd {
     size_t histogram_increase_step;
     double histogram_percentile;
     char *histogram_percentile_str;
+    int histogram_sketches;
+    LONG_DOUBLE histogram_sketch_log_gamma;
+    LONG_DOUBLE histogram_sketch_zero;
+    SIMPLE_PATTERN *sets_hyperloglog_for;
+    int sets_hyperloglog_precision;
+
+    DICTIONARY *tagged_metrics;         // the names of the metrics the tags are kept for
+    DICTIONARY *tag_sets;               // the tag sets of the metrics, interned
+    netdata_mutex_t tag_sets_mutex;
+    size_t max_tag_sets;
 
     int threads;
     struct collection_thread_status *collection_threads_status;
@@ -346,10 +465,16 @@ static struct statsd {
         },
 
         .tcp_idle_timeout = 600,
+        .tcp_buffer_size = 262144,
 
         .apps = NULL,
         .histogram_percentile = 95.0,
         .histogram_increase_step = 10,
+        .sets_hyperloglog_precision = 12,
+        .tagged_metrics = NULL,
+        .tag_sets = NULL,
+        .tag_sets_mutex = NETDATA_MUTEX_INITIALIZER,
+        .max_tag_sets = 100,
         .threads = 0,
         .collection_threads_status = NULL,
         .sockets = {
@@ -365,47 +490,111 @@ static struct statsd {
 // --------------------------------------------------------------------------------------------------------------------
 // statsd index management - add/find metrics
 
+static inline int statsd_tags_compare(const char *a, const char *b) {
+    if(a == b) return 0;
+    if(!a) return -1;
+    if(!b) return 1;
+    return strcmp(a, b);
+}
+
 static int statsd_metric_compare(void* a, void* b) {
     if(((STATSD_METRIC *)a)->hash < ((STATSD_METRIC *)b)->hash) return -1;
     else if(((STATSD_METRIC *)a)->hash > ((STATSD_METRIC *)b)->hash) return 1;
-    else return strcmp(((STATSD_METRIC *)a)->name, ((STATSD_METRIC *)b)->name);
+    else {
+        int ret = strcmp(((STATSD_METRIC *)a)->name, ((STATSD_METRIC *)b)->name);
+        if(ret) return ret;
+        return statsd_tags_compare(((STATSD_METRIC *)a)->tags, ((STATSD_METRIC *)b)->tags);
+    }
 }
 
-static inline STATSD_METRIC *statsd_metric_index_find(STATSD_INDEX *index, const char *name, uint32_t hash) {
+static inline STATSD_METRIC *statsd_metric_index_find(STATSD_INDEX *index, const char *name, const char *tags, uint32_t hash) {
     STATSD_METRIC tmp;
     tmp.name = name;
+    tmp.tags = tags;
     tmp.hash = (hash)?hash:simple_hash(tmp.name);
 
     return (STATSD_METRIC *)STATSD_AVL_SEARCH(&index->index, (avl *)&tmp);
 }
 
-static inline STATSD_METRIC *statsd_find_or_add_metric(STATSD_INDEX *index, const char *name, STATSD_METRIC_TYPE type) {
-    debug(D_STATSD, "searching for metric '%s' under '%s'", name, index->name);
+// the tag sets are kept once, for all the metrics having them
+static const char *statsd_tag_set_intern(const char *tags) {
+    netdata_mutex_lock(&statsd.tag_sets_mutex);
+
+    if(unlikely(!statsd.tag_sets))
+        statsd.tag_sets = dictionary_create(DICTIONARY_FLAG_SINGLE_THREADED);
+
+    const char *t = dictionary_get(statsd.tag_sets, tags);
+    if(!t) t = dictionary_set(statsd.tag_sets, tags, (void *)tags, strlen(tags) + 1);
+
+    netdata_mutex_unlock(&statsd.tag_sets_mutex);
+    return t;
+}
+
+// the name, in the chunks of names of the shard
+static inline const char *statsd_shard_strdup(STATSD_SHARD *shard, const char *name) {
+    size_t len = strlen(name) + 1;
+
+    if(unlikely(shard->names_used + len > shard->names_size)) {
+        shard->names_size = (len > STATSD_NAMES_CHUNK_SIZE) ? len : STATSD_NAMES_CHUNK_SIZE;
+        shard->names = mallocz(shard->names_size);
+        shard->names_used = 0;
+    }
+
+    char *s = &shard->names[shard->names_used];
+    memcpy(s, name, len);
+    shard->names_used += len;
+    return s;
+}
+
+// base is the metric without tags, when tags are given - it is NULL when the base metric
+// already has the maximum number of tag sets
+static inline STATSD_METRIC *statsd_find_or_add_metric(STATSD_SHARD *shard, STATSD_INDEX *index, const char *name, const char *tags, STATSD_METRIC *base, STATSD_METRIC_TYPE type) {
+    debug(D_STATSD, "searching for metric '%s' with tags '%s' under '%s'", name, tags?tags:"", index->name);
 
     uint32_t hash = simple_hash(name);
 
-    STATSD_METRIC *m = statsd_metric_index_find(index, name, hash);
+    STATSD_METRIC *m = statsd_metric_index_find(index, name, tags, hash);
     if(unlikely(!m)) {
-        debug(D_STATSD, "Creating new %s metric '%s'", index->name, name);
+        if(unlikely(base && __atomic_load_n(&base->tag_sets, __ATOMIC_RELAXED) >= statsd.max_tag_sets)) {
+            if(!(base->options & STATSD_METRIC_OPTION_TAG_SETS_EXCEEDED)) {
+                base->options |= STATSD_METRIC_OPTION_TAG_SETS_EXCEEDED;
+                error("STATSD: %s metric '%s' has %zu tag sets, the tags of the values of its new tag sets are ignored. Increase 'max tag sets per metric' in netdata.conf, [statsd] section.", index->name, name, statsd.max_tag_sets);
+            }
+            return NULL;
+        }
+
+        debug(D_STATSD, "Creating new %s metric '%s' with tags '%s'", index->name, name, tags?tags:"");
 
         m = (STATSD_METRIC *)callocz(sizeof(STATSD_METRIC), 1);
-        m->name = strdupz(name);
+        m->name = statsd_shard_strdup(shard, name);
         m->hash = hash;
+        m->tags = (tags) ? statsd_tag_set_intern(tags) : NULL;
         m->type = type;
         m->options = index->default_options;
 
+        if(type == STATSD_METRIC_TYPE_SET && simple_pattern_matches(statsd.sets_hyperloglog_for, name))
+            m->options |= STATSD_METRIC_OPTION_SET_HYPERLOGLOG;
+
+        if(!tags && statsd.tagged_metrics && dictionary_get(statsd.tagged_metrics, name))
+            m->options |= STATSD_METRIC_OPTION_KEEP_TAGS;
+
         if(type == STATSD_METRIC_TYPE_HISTOGRAM || type == STATSD_METRIC_TYPE_TIMER) {
             m->histogram.ext = callocz(sizeof(STATSD_METRIC_HISTOGRAM_EXTENSIONS), 1);
-            netdata_mutex_init(&m->histogram.ext->mutex);
+
+            if(statsd.histogram_sketches)
+                m->histogram.ext->sketch = callocz(sizeof(STATSD_SKETCH), 1);
         }
         STATSD_METRIC *n = (STATSD_METRIC *)STATSD_AVL_INSERT(&index->index, (avl *)m);
         if(unlikely(n != m)) {
+            // another thread added it first - its name is left unused in the chunk
+            if(m->histogram.ext) freez((void *)m->histogram.ext->sketch);
             freez((void *)m->histogram.ext);
-            freez((void *)m->name);
             freez((void *)m);
             m = n;
         }
         else {
+            if(base) __atomic_add_fetch(&base->tag_sets, 1, __ATOMIC_RELAXED);
+
             STATSD_FIRST_PTR_MUTEX_LOCK(index);
             index->metrics++;
             m->next = index->first;
@@ -414,10 +603,141 @@ static inline STATSD_METRIC *statsd_find_or_add_metric(STATSD_INDEX *index, cons
         }
     }
 
-    index->events++;
     return m;
 }
 
+static void statsd_shard_init(STATSD_SHARD *shard) {
+    netdata_mutex_init(&shard->mutex);
+    shard->size = STATSD_SHARD_SLOTS_INITIAL;
+    shard->slots = callocz(shard->size, sizeof(STATSD_SHARD_METRIC *));
+}
+
+static void statsd_shard_resize(STATSD_SHARD *shard) {
+    size_t i, size = shard->size * 2, mask = size - 1;
+    STATSD_SHARD_METRIC **slots = callocz(size, sizeof(STATSD_SHARD_METRIC *));
+
+    for(i = 0; i < shard->size ;i++) {
+        STATSD_SHARD_METRIC *sm = shard->slots[i];
+        if(!sm) continue;
+
+        size_t slot = sm->key & mask;
+        while(slots[slot]) slot = (slot + 1) & mask;
+        slots[slot] = sm;
+    }
+
+    freez(shard->slots);
+    shard->slots = slots;
+    shard->size = size;
+}
+
+// the values of the shard for the metric (and tag set), that is added to the index when it is not there
+// hash is the FNV-1a hash of the name (and the tags), computed while parsing it
+static inline STATSD_SHARD_METRIC *statsd_shard_metric_get(STATSD_SHARD *shard, STATSD_INDEX *index, const char *name, const char *tags, uint64_t hash, STATSD_METRIC *base, STATSD_METRIC_TYPE type) {
+    uint64_t key = statsd_hash_mix(hash + (uint64_t)type);
+    size_t mask = shard->size - 1, slot = key & mask;
+
+    STATSD_SHARD_METRIC *sm;
+    while((sm = shard->slots[slot])) {
+        if(likely(sm->key == key && sm->m->type == type && !strcmp(sm->m->name, name) && !statsd_tags_compare(sm->m->tags, tags)))
+            return sm;
+
+        slot = (slot + 1) & mask;
+    }
+
+    STATSD_METRIC *m = statsd_find_or_add_metric(shard, index, name, tags, base, type);
+    if(unlikely(!m)) return NULL;
+
+    sm = callocz(sizeof(STATSD_SHARD_METRIC), 1);
+    sm->key = key;
+    sm->m = m;
+
+    if((type == STATSD_METRIC_TYPE_HISTOGRAM || type == STATSD_METRIC_TYPE_TIMER) && statsd.histogram_sketches)
+        sm->histogram.sketch = callocz(sizeof(STATSD_SKETCH), 1);
+
+    shard->slots[slot] = sm;
+
+    // up to 3/4 of the slots are used, so that the probes stay short
+    if(unlikely(++shard->used * 4 > shard->size * 3))
+        statsd_shard_resize(shard);
+
+    return sm;
+}
+
+#define STATSD_TAGS_MAX 64
+
+static int statsd_tag_compare(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+// the tags in the order of their names, so that the same tags give the same tag set
+// returns the length of the tag set written to dst (that needs the size of tags)
+static size_t statsd_tags_sort(const char *tags, char *dst) {
+    char *tag[STATSD_TAGS_MAX];
+    size_t i, count = 0, len = 0;
+
+    strcpy(dst, tags);
+
+    char *s = dst;
+    while(*s && count < STATSD_TAGS_MAX) {
+        char *e = s;
+        while(*e && *e != ',') e++;
+        char c = *e;
+        *e = '\0';
+
+        s = trim(s);
+        if(s && *s) tag[count++] = s;
+
+        if(!c) break;
+        s = e + 1;
+    }
+
+    if(!count) return 0;
+
+    qsort(tag, count, sizeof(char *), statsd_tag_compare);
+
+    char sorted[strlen(tags) + 1];
+    for(i = 0; i < count ;i++) {
+        size_t l = strlen(tag[i]);
+        if(i) sorted[len++] = ',';
+        memcpy(&sorted[len], tag[i], l);
+        len += l;
+    }
+    sorted[len] = '\0';
+
+    memcpy(dst, sorted, len + 1);
+    return len;
+}
+
+static inline STATSD_SHARD_METRIC *statsd_shard_find_or_add_metric(STATSD_SHARD *shard, STATSD_INDEX *index, const char *name, uint64_t hash, const char *tags, STATSD_METRIC_TYPE type) {
+    STATSD_SHARD_METRIC *sm = statsd_shard_metric_get(shard, index, name, NULL, hash, NULL, type);
+
+    if(unlikely(tags && *tags && (sm->m->options & STATSD_METRIC_OPTION_KEEP_TAGS))) {
+        char sorted[strlen(tags) + 1];
+        size_t i, len = statsd_tags_sort(tags, sorted);
+
+        if(likely(len)) {
+            uint64_t h = statsd_hash_add(hash, '#');
+            for(i = 0; i < len ;i++)
+                h = statsd_hash_add(h, sorted[i]);
+
+            // when the metric has too many tag sets, the value goes to the metric without tags
+            STATSD_SHARD_METRIC *tsm = statsd_shard_metric_get(shard, index, name, sorted, h, sm->m, type);
+            if(likely(tsm)) sm = tsm;
+        }
+    }
+
+    shard->events[type]++;
+    return sm;
+}
+
+// a value has been added to sm
+static inline void statsd_shard_metric_updated(STATSD_SHARD *shard, STATSD_SHARD_METRIC *sm) {
+    if(unlikely(!sm->events++)) {
+        sm->next_updated = shard->first_updated;
+        shard->first_updated = sm;
+    }
+}
+
 
 // --------------------------------------------------------------------------------------------------------------------
 // statsd parsing numbers
@@ -475,70 +795,213 @@ static inline int value_is_zinit(const char *value) {
 #define is_metric_checked(m) ((m)->options & STATSD_METRIC_OPTION_CHECKED)
 #define is_metric_useful_for_collection(m) (!is_metric_checked(m) || ((m)->options & STATSD_METRIC_OPTION_USEFUL))
 
-static inline void statsd_process_gauge(STATSD_METRIC *m, const char *value, const char *sampling) {
-    if(!is_metric_useful_for_collection(m)) return;
+static inline void statsd_process_gauge(STATSD_SHARD *shard, STATSD_SHARD_METRIC *sm, const char *value, const char *sampling) {
+    if(!is_metric_useful_for_collection(sm->m)) return;
 
     if(unlikely(!value || !*value)) {
-        error("STATSD: metric '%s' of type gauge, with empty value is ignored.", m->name);
+        error("STATSD: metric '%s' of type gauge, with empty value is ignored.", sm->m->name);
         return;
     }
 
-    if(unlikely(m->reset)) {
-        // no need to reset anything specific for gauges
-        statsd_reset_metric(m);
-    }
-
     if(unlikely(value_is_zinit(value))) {
         // magic loading of metric, without affecting anything
     }
     else {
         if (unlikely(*value == '+' || *value == '-'))
-            m->gauge.value += statsd_parse_float(value, 1.0) / statsd_parse_sampling_rate(sampling);
-        else
-            m->gauge.value = statsd_parse_float(value, 1.0);
+            sm->gauge.value += statsd_parse_float(value, 1.0) / statsd_parse_sampling_rate(sampling);
+        else {
+            sm->gauge.value = statsd_parse_float(value, 1.0);
+            sm->gauge.absolute = 1;
+        }
 
-        m->events++;
-        m->count++;
+        statsd_shard_metric_updated(shard, sm);
     }
 }
 
-static inline void statsd_process_counter_or_meter(STATSD_METRIC *m, const char *value, const char *sampling) {
-    if(!is_metric_useful_for_collection(m)) return;
+static inline void statsd_process_counter_or_meter(STATSD_SHARD *shard, STATSD_SHARD_METRIC *sm, const char *value, const char *sampling) {
+    if(!is_metric_useful_for_collection(sm->m)) return;
 
     // we accept empty values for counters
 
-    if(unlikely(m->reset)) statsd_reset_metric(m);
-
     if(unlikely(value_is_zinit(value))) {
         // magic loading of metric, without affecting anything
     }
     else {
-        m->counter.value += llrintl((LONG_DOUBLE) statsd_parse_int(value, 1) / statsd_parse_sampling_rate(sampling));
+        sm->counter += llrintl((LONG_DOUBLE) statsd_parse_int(value, 1) / statsd_parse_sampling_rate(sampling));
+
+        statsd_shard_metric_updated(shard, sm);
+    }
+}
+
+#define statsd_process_counter(shard, sm, value, sampling) statsd_process_counter_or_meter(shard, sm, value, sampling)
+#define statsd_process_meter(shard, sm, value, sampling) statsd_process_counter_or_meter(shard, sm, value, sampling)
+
+// ----------------------------------------------------------------------------
+// histogram sketches
+
+// the bins of the keys lo to hi, with the weights of the ones out of them in the first or the last bin
+static void statsd_sketch_bins_resize(STATSD_SKETCH_BINS *b, int lo, int hi) {
+    double *counts = callocz((size_t)(hi - lo + 1), sizeof(double));
+
+    int i;
+    for(i = 0; i < b->size ;i++) {
+        int key = b->offset + i;
+        if(key < lo) key = lo;
+        else if(key > hi) key = hi;
+        counts[key - lo] += b->counts[i];
+    }
+
+    freez(b->counts);
+    b->counts = counts;
+    b->offset = lo;
+    b->size = hi - lo + 1;
+}
+
+static inline void statsd_sketch_bins_add(STATSD_SKETCH_BINS *b, int key, double weight) {
+    if(unlikely(!b->size || key < b->offset || key >= b->offset + b->size)) {
+        int lo = (b->size && b->offset < key) ? b->offset : key;
+        int hi = (b->size && b->offset + b->size - 1 > key) ? b->offset + b->size - 1 : key;
+
+        if(hi - lo + 1 > STATSD_SKETCH_BINS_MAX)
+            lo = hi - STATSD_SKETCH_BINS_MAX + 1;
+        else {
+            // room for the keys next to it, in the direction the keys grow
+            int room = STATSD_SKETCH_BINS_MAX - (hi - lo + 1);
+            if(room > STATSD_SKETCH_BINS_STEP) room = STATSD_SKETCH_BINS_STEP;
+
+            if(!b->size) { lo -= room / 2; hi += room - room / 2; }
+            else if(key < b->offset) lo -= room;
+            else hi += room;
+        }
+
+        statsd_sketch_bins_resize(b, lo, hi);
+
+        if(key < b->offset) key = b->offset;
+    }
+
+    b->counts[key - b->offset] += weight;
+}
+
+static inline void statsd_sketch_add(STATSD_SKETCH *sk, LONG_DOUBLE v, double weight) {
+    if(isless(fabsl(v), statsd.histogram_sketch_zero))
+        sk->zero += weight;
+    else {
+        int key = (int)ceill(logl(fabsl(v)) / statsd.histogram_sketch_log_gamma);
+        statsd_sketch_bins_add(isless(v, 0) ? &sk->negative : &sk->positive, key, weight);
+    }
+
+    if(unlikely(sk->count == 0)) {
+        sk->min = sk->max = v;
+    }
+    else {
+        if(isless(v, sk->min)) sk->min = v;
+        if(isgreater(v, sk->max)) sk->max = v;
+    }
 
-        m->events++;
-        m->count++;
+    sk->count += weight;
+    sk->sum += v * weight;
+
+    LONG_DOUBLE delta = v - sk->mean;
+    sk->mean += delta * weight / sk->count;
+    sk->m2 += weight * delta * (v - sk->mean);
+}
+
+// the sketches have the same bins, so merging them adds the weights of their bins
+// (and the running means and squared differences are combined as for parallel variance)
+static inline void statsd_sketch_bins_merge(STATSD_SKETCH_BINS *dst, STATSD_SKETCH_BINS *src) {
+    int i;
+    for(i = 0; i < src->size ;i++) {
+        if(src->counts[i] != 0)
+            statsd_sketch_bins_add(dst, src->offset + i, src->counts[i]);
     }
 }
 
-#define statsd_process_counter(m, value, sampling) statsd_process_counter_or_meter(m, value, sampling)
-#define statsd_process_meter(m, value, sampling) statsd_process_counter_or_meter(m, value, sampling)
+static inline void statsd_sketch_merge(STATSD_SKETCH *dst, STATSD_SKETCH *src) {
+    if(src->count == 0) return;
+
+    statsd_sketch_bins_merge(&dst->positive, &src->positive);
+    statsd_sketch_bins_merge(&dst->negative, &src->negative);
+    dst->zero += src->zero;
 
-static inline void statsd_process_histogram_or_timer(STATSD_METRIC *m, const char *value, const char *sampling, const char *type) {
-    if(!is_metric_useful_for_collection(m)) return;
+    if(unlikely(dst->count == 0)) {
+        dst->min = src->min;
+        dst->max = src->max;
+    }
+    else {
+        if(isless(src->min, dst->min)) dst->min = src->min;
+        if(isgreater(src->max, dst->max)) dst->max = src->max;
+    }
+
+    double count = dst->count + src->count;
+    LONG_DOUBLE delta = src->mean - dst->mean;
+    dst->m2 += src->m2 + delta * delta * dst->count * src->count / count;
+    dst->mean += delta * src->count / count;
+    dst->sum += src->sum;
+    dst->count = count;
+}
+
+static inline void statsd_sketch_reset(STATSD_SKETCH *sk) {
+    if(sk->positive.size) memset(sk->positive.counts, 0, sk->positive.size * sizeof(double));
+    if(sk->negative.size) memset(sk->negative.counts, 0, sk->negative.size * sizeof(double));
+    sk->zero = 0;
+    sk->count = 0;
+    sk->min = sk->max = sk->sum = sk->mean = sk->m2 = 0;
+}
+
+// the value of the bin key, the middle of the values in it
+static inline LONG_DOUBLE statsd_sketch_bin_value(int key) {
+    LONG_DOUBLE gamma = expl(statsd.histogram_sketch_log_gamma);
+    return 2.0 * expl(statsd.histogram_sketch_log_gamma * (LONG_DOUBLE)key) / (gamma + 1.0);
+}
+
+// the value having a weight of rank values (of the sorted values) before it
+static LONG_DOUBLE statsd_sketch_value_at_rank(STATSD_SKETCH *sk, double rank) {
+    LONG_DOUBLE v = sk->max;
+    double seen = 0;
+    int i;
+
+    // the negative values, the biggest in absolute value first
+    for(i = sk->negative.size - 1; i >= 0 ;i--) {
+        seen += sk->negative.counts[i];
+        if(seen > rank) { v = -statsd_sketch_bin_value(sk->negative.offset + i); goto found; }
+    }
+
+    seen += sk->zero;
+    if(seen > rank) { v = 0; goto found; }
+
+    for(i = 0; i < sk->positive.size ;i++) {
+        seen += sk->positive.counts[i];
+        if(seen > rank) { v = statsd_sketch_bin_value(sk->positive.offset + i); goto found; }
+    }
+
+found:
+    if(isless(v, sk->min)) v = sk->min;
+    if(isgreater(v, sk->max)) v = sk->max;
+    return v;
+}
+
+// ----------------------------------------------------------------------------
+
+static inline void statsd_process_histogram_or_timer(STATSD_SHARD *shard, STATSD_SHARD_METRIC *sm, const char *value, const char *sampling, const char *type) {
+    if(!is_metric_useful_for_collection(sm->m)) return;
 
     if(unlikely(!value || !*value)) {
         error("STATSD: metric of type %s, with empty value is ignored.", type);
         return;
     }
 
-    if(unlikely(m->reset)) {
-        m->histogram.ext->used = 0;
-        statsd_reset_metric(m);
-    }
-
     if(unlikely(value_is_zinit(value))) {
         // magic loading of metric, without affecting anything
     }
+    else if(sm->histogram.sketch) {
+        LONG_DOUBLE v = statsd_parse_float(value, 1.0);
+
+        // the sampling rate is the weight of the value
+        if(likely(isfinite(v)))
+            statsd_sketch_add(sm->histogram.sketch, v, (double)(1.0 / statsd_parse_sampling_rate(sampling)));
+
+        statsd_shard_metric_updated(shard, sm);
+    }
     else {
         LONG_DOUBLE v = statsd_parse_float(value, 1.0);
         LONG_DOUBLE sampling_rate = statsd_parse_sampling_rate(sampling);
@@ -548,57 +1011,96 @@ static inline void statsd_process_histogram_or_timer(STATSD_METRIC *m, const cha
         long long samples = llrintl(1.0 / sampling_rate);
         while(samples-- > 0) {
 
-            if(unlikely(m->histogram.ext->used == m->histogram.ext->size)) {
-                netdata_mutex_lock(&m->histogram.ext->mutex);
-                m->histogram.ext->size += statsd.histogram_increase_step;
-                m->histogram.ext->values = reallocz(m->histogram.ext->values, sizeof(LONG_DOUBLE) * m->histogram.ext->size);
-                netdata_mutex_unlock(&m->histogram.ext->mutex);
+            if(unlikely(sm->histogram.used == sm->histogram.size)) {
+                sm->histogram.size += statsd.histogram_increase_step;
+                sm->histogram.values = reallocz(sm->histogram.values, sizeof(LONG_DOUBLE) * sm->histogram.size);
             }
 
-            m->histogram.ext->values[m->histogram.ext->used++] = v;
+            sm->histogram.values[sm->histogram.used++] = v;
         }
 
-        m->events++;
-        m->count++;
+        statsd_shard_metric_updated(shard, sm);
     }
 }
 
-#define statsd_process_timer(m, value, sampling) statsd_process_histogram_or_timer(m, value, sampling, "timer")
-#define statsd_process_histogram(m, value, sampling) statsd_process_histogram_or_timer(m, value, sampling, "histogram")
+#define statsd_process_timer(shard, sm, value, sampling) statsd_process_histogram_or_timer(shard, sm, value, sampling, "timer")
+#define statsd_process_histogram(shard, sm, value, sampling) statsd_process_histogram_or_timer(shard, sm, value, sampling, "histogram")
 
-static inline void statsd_process_set(STATSD_METRIC *m, const char *value) {
-    if(!is_metric_useful_for_collection(m)) return;
+// ----------------------------------------------------------------------------
+// hyperloglog sets
+// every value is hashed to 64 bits, the first bits of the hash select one of the 2^precision
+// registers and the register keeps the maximum number of leading zeros (plus one) of the rest
+// of the bits of the hashes it gets - the registers of two hyperloglogs of the same
+// precision can be merged by keeping the maximum of each register
 
-    if(unlikely(!value || !*value)) {
-        error("STATSD: metric of type set, with empty value is ignored.");
-        return;
-    }
+static inline uint64_t statsd_hyperloglog_hash(const char *value) {
+    uint64_t h = STATSD_HASH_INIT;
+    while(*value)
+        h = statsd_hash_add(h, *value++);
 
-    if(unlikely(m->reset)) {
-        if(likely(m->set.dict)) {
-            dictionary_destroy(m->set.dict);
-            m->set.dict = NULL;
-        }
-        statsd_reset_metric(m);
+    return statsd_hash_mix(h);
+}
+
+static inline void statsd_hyperloglog_add(uint8_t *registers, const char *value) {
+    int precision = statsd.sets_hyperloglog_precision;
+    uint64_t h = statsd_hyperloglog_hash(value);
+
+    size_t index = (size_t)(h >> (64 - precision));
+    uint64_t rest = (h << precision) | (1ULL << (precision - 1)); // so that it is never zero
+    uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+
+    if(rank > registers[index])
+        registers[index] = rank;
+}
+
+static inline size_t statsd_hyperloglog_estimate(const uint8_t *registers) {
+    size_t i, m = (size_t)1 << statsd.sets_hyperloglog_precision, zeros = 0;
+    double sum = 0;
+
+    for(i = 0; i < m ;i++) {
+        sum += ldexp(1.0, -(int)registers[i]);
+        if(!registers[i]) zeros++;
     }
 
-    if (unlikely(!m->set.dict)) {
-        m->set.dict   = dictionary_create(STATSD_DICTIONARY_OPTIONS | DICTIONARY_FLAG_VALUE_LINK_DONT_CLONE);
-        m->set.unique = 0;
+    double alpha = 0.7213 / (1.0 + 1.079 / (double)m);
+    double estimate = alpha * (double)m * (double)m / sum;
+
+    // few values, linear counting is more accurate
+    if(estimate <= 2.5 * (double)m && zeros)
+        estimate = (double)m * log((double)m / (double)zeros);
+
+    return (size_t)llrint(estimate);
+}
+
+// ----------------------------------------------------------------------------
+
+static inline void statsd_process_set(STATSD_SHARD *shard, STATSD_SHARD_METRIC *sm, const char *value) {
+    if(!is_metric_useful_for_collection(sm->m)) return;
+
+    if(unlikely(!value || !*value)) {
+        error("STATSD: metric of type set, with empty value is ignored.");
+        return;
     }
 
     if(unlikely(value_is_zinit(value))) {
         // magic loading of metric, without affecting anything
     }
     else {
-        void *t = dictionary_get(m->set.dict, value);
-        if (unlikely(!t)) {
-            dictionary_set(m->set.dict, value, NULL, 1);
-            m->set.unique++;
+        if(sm->m->options & STATSD_METRIC_OPTION_SET_HYPERLOGLOG) {
+            if(unlikely(!sm->set.registers))
+                sm->set.registers = callocz((size_t)1 << statsd.sets_hyperloglog_precision, sizeof(uint8_t));
+
+            statsd_hyperloglog_add(sm->set.registers, value);
+        }
+        else {
+            if(unlikely(!sm->set.dict))
+                sm->set.dict = dictionary_create(STATSD_DICTIONARY_OPTIONS | DICTIONARY_FLAG_VALUE_LINK_DONT_CLONE);
+
+            if(unlikely(!dictionary_get(sm->set.dict, value)))
+                dictionary_set(sm->set.dict, value, NULL, 1);
         }
 
-        m->events++;
-        m->count++;
+        statsd_shard_metric_updated(shard, sm);
     }
 }
 
@@ -606,9 +1108,7 @@ static inline void statsd_process_set(STATSD_METRIC *m, const char *value) {
 // --------------------------------------------------------------------------------------------------------------------
 // statsd parsing
 
-static void statsd_process_metric(const char *name, const char *value, const char *type, const char *sampling, const char *tags) {
-    (void)tags;
-
+static void statsd_process_metric(STATSD_SHARD *shard, const char *name, uint64_t hash, const char *value, const char *type, const char *sampling, const char *tags) {
     debug(D_STATSD, "STATSD: raw metric '%s', value '%s', type '%s', sampling '%s', tags '%s'", name?name:"(null)", value?value:"(null)", type?type:"(null)", sampling?sampling:"(null)", tags?tags:"(null)");
 
     if(unlikely(!name || !*name)) return;
@@ -617,35 +1117,35 @@ static void statsd_process_metric(const char *name, const char *value, const cha
     char t0 = type[0], t1 = type[1];
 
     if(unlikely(t0 == 'g' && t1 == '\0')) {
-        statsd_process_gauge(
-                statsd_find_or_add_metric(&statsd.gauges, name, STATSD_METRIC_TYPE_GAUGE),
+        statsd_process_gauge(shard,
+                statsd_shard_find_or_add_metric(shard, &statsd.gauges, name, hash, tags, STATSD_METRIC_TYPE_GAUGE),
                 value, sampling);
     }
     else if(unlikely((t0 == 'c' || t0 == 'C') && t1 == '\0')) {
         // etsy/statsd uses 'c'
         // brubeck     uses 'C'
-        statsd_process_counter(
-                statsd_find_or_add_metric(&statsd.counters, name, STATSD_METRIC_TYPE_COUNTER),
+        statsd_process_counter(shard,
+                statsd_shard_find_or_add_metric(shard, &statsd.counters, name, hash, tags, STATSD_METRIC_TYPE_COUNTER),
                 value, sampling);
     }
     else if(unlikely(t0 == 'm' && t1 == '\0')) {
-        statsd_process_meter(
-                statsd_find_or_add_metric(&statsd.meters, name, STATSD_METRIC_TYPE_METER),
+        statsd_process_meter(shard,
+                statsd_shard_find_or_add_metric(shard, &statsd.meters, name, hash, tags, STATSD_METRIC_TYPE_METER),
                 value, sampling);
     }
     else if(unlikely(t0 == 'h' && t1 == '\0')) {
-        statsd_process_histogram(
-                statsd_find_or_add_metric(&statsd.histograms, name, STATSD_METRIC_TYPE_HISTOGRAM),
+        statsd_process_histogram(shard,
+                statsd_shard_find_or_add_metric(shard, &statsd.histograms, name, hash, tags, STATSD_METRIC_TYPE_HISTOGRAM),
                 value, sampling);
     }
     else if(unlikely(t0 == 's' && t1 == '\0')) {
-        statsd_process_set(
-                statsd_find_or_add_metric(&statsd.sets, name, STATSD_METRIC_TYPE_SET),
+        statsd_process_set(shard,
+                statsd_shard_find_or_add_metric(shard, &statsd.sets, name, hash, tags, STATSD_METRIC_TYPE_SET),
                 value);
     }
     else if(unlikely(t0 == 'm' && t1 == 's' && type[2] == '\0')) {
-        statsd_process_timer(
-                statsd_find_or_add_metric(&statsd.timers, name, STATSD_METRIC_TYPE_TIMER),
+        statsd_process_timer(shard,
+                statsd_shard_find_or_add_metric(shard, &statsd.timers, name, hash, tags, STATSD_METRIC_TYPE_TIMER),
                 value, sampling);
     }
     else {
@@ -670,6 +1170,22 @@ const char *statsd_parse_skip_spaces(const char *s) {
     return s;
 }
 
+// like statsd_parse_skip_up_to() for the name, with the hash of it without the spaces around it
+static inline const char *statsd_parse_name(const char *s, uint64_t *hash) {
+    uint64_t h = STATSD_HASH_INIT;
+    char c;
+
+    for(c = *s; c == ' ' || c == '\t'; c = *++s) ;
+
+    *hash = h;
+    for(; c && c != ':' && c != '|' && c != '\r' && c != '\n'; c = *++s) {
+        h = statsd_hash_add(h, c);
+        if(likely(c != ' ' && c != '\t')) *hash = h;
+    }
+
+    return s;
+}
+
 static inline const char *statsd_parse_field_trim(const char *start, char *end) {
     if(unlikely(!start)) {
         start = end;
@@ -687,7 +1203,7 @@ static inline const char *statsd_parse_field_trim(const char *start, char *end)
     return start;
 }
 
-static inline size_t statsd_process(char *buffer, size_t size, int require_newlines) {
+static inline void statsd_process_locked(STATSD_SHARD *shard, char *buffer, size_t size) {
     buffer[size] = '\0';
     debug(D_STATSD, "RECEIVED: %zu bytes: '%s'", size, buffer);
 
@@ -695,8 +1211,9 @@ static inline size_t statsd_process(char *buffer, size_t size, int require_newli
     while(*s) {
         const char *name = NULL, *value = NULL, *type = NULL, *sampling = NULL, *tags = NULL;
         char *name_end = NULL, *value_end = NULL, *type_end = NULL, *sampling_end = NULL, *tags_end = NULL;
+        uint64_t hash;
 
-        s = name_end = (char *)statsd_parse_skip_up_to(name = s, ':', '|');
+        s = name_end = (char *)statsd_parse_name(name = s, &hash);
         if(name == name_end) {
             s = statsd_parse_skip_spaces(s);
             continue;
@@ -720,33 +1237,32 @@ static inline size_t statsd_process(char *buffer, size_t size, int require_newli
 
         // skip everything until the end of the line
         while(*s && *s != '\n') s++;
-
-        if(unlikely(require_newlines && *s != '\n' && s > buffer)) {
-            // move the remaining data to the beginning
-            size -= (name - buffer);
-            memmove(buffer, name, size);
-            return size;
-        }
-        else
-            s = statsd_parse_skip_spaces(s);
+        s = statsd_parse_skip_spaces(s);
 
         statsd_process_metric(
-                  statsd_parse_field_trim(name, name_end)
+                  shard
+                , statsd_parse_field_trim(name, name_end)
+                , hash
                 , statsd_parse_field_trim(value, value_end)
                 , statsd_parse_field_trim(type, type_end)
                 , statsd_parse_field_trim(sampling, sampling_end)
                 , statsd_parse_field_trim(tags, tags_end)
         );
     }
+}
 
-    return 0;
+// buffer needs size + 1 bytes, for the terminator
+static inline void statsd_process(STATSD_SHARD *shard, char *buffer, size_t size) {
+    netdata_mutex_lock(&shard->mutex);
+    statsd_process_locked(shard, buffer, size);
+    netdata_mutex_unlock(&shard->mutex);
 }
 
 
 // --------------------------------------------------------------------------------------------------------------------
 // statsd pollfd interface
 
-#define STATSD_TCP_BUFFER_SIZE 65536 // minimize tcp reads
+#define STATSD_TCP_READS_PER_EVENT 16 // then the other sockets are served, the rest of the data wait in the kernel
 #define STATSD_UDP_BUFFER_SIZE 9000  // this should be up to MTU
 
 typedef enum {
@@ -755,38 +1271,91 @@ typedef enum {
 } STATSD_SOCKET_DATA_TYPE;
 
 struct statsd_tcp {
+    STATSD_SHARD *shard;
     STATSD_SOCKET_DATA_TYPE type;
+    int discard;                // the line in the buffer is longer than it, so it is skipped up to its end
     size_t size;
     size_t len;
     char buffer[];
 };
 
 #ifdef HAVE_RECVMMSG
+#ifdef SO_RXQ_OVFL
+// the kernel gives the number of datagrams it has dropped on a socket with the ones received
+#define STATSD_UDP_CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+#endif
+
 struct statsd_udp {
-    int *running;
+    struct collection_thread_status *status;
     STATSD_SOCKET_DATA_TYPE type;
     size_t size;
     struct iovec *iovecs;
     struct mmsghdr *msgs;
+#ifdef STATSD_UDP_CONTROL_SIZE
+    char *control;
+#endif
 };
 #else
 struct statsd_udp {
-    int *running;
+    struct collection_thread_status *status;
     STATSD_SOCKET_DATA_TYPE type;
     char buffer[STATSD_UDP_BUFFER_SIZE];
 };
 #endif
 
+static inline char *statsd_last_newline(char *s, size_t len) {
+#ifdef __GLIBC__
+    // vectorized by libc
+    return memrchr(s, '\n', len);
+#else
+    while(len--)
+        if(s[len] == '\n') return &s[len];
+
+    return NULL;
+#endif
+}
+
+// the complete lines a TCP client has sent are processed, the last one is kept until its end is received
+static inline void statsd_process_tcp(struct statsd_tcp *d) {
+    if(unlikely(d->discard)) {
+        char *nl = memchr(d->buffer, '\n', d->len);
+        if(!nl) {
+            d->len = 0;
+            return;
+        }
+
+        d->len -= (size_t)(nl + 1 - d->buffer);
+        memmove(d->buffer, nl + 1, d->len);
+        d->discard = 0;
+    }
+
+    char *nl = statsd_last_newline(d->buffer, d->len);
+    if(likely(nl)) {
+        // the last newline is replaced by the terminator
+        size_t len = (size_t)(nl - d->buffer);
+        statsd_process(d->shard, d->buffer, len);
+
+        d->len -= len + 1;
+        if(d->len) memmove(d->buffer, nl + 1, d->len);
+    }
+    else if(unlikely(d->len == d->size)) {
+        error("STATSD: a TCP client sent a line longer than %zu bytes. It is ignored.", d->size);
+        statsd.socket_errors++;
+        d->len = 0;
+        d->discard = 1;
+    }
+}
+
 // new TCP client connected
 static void *statsd_add_callback(POLLINFO *pi, short int *events, void *data) {
     (void)pi;
-    (void)data;
 
     *events = POLLIN;
 
-    struct statsd_tcp *t = (struct statsd_tcp *)callocz(sizeof(struct statsd_tcp) + STATSD_TCP_BUFFER_SIZE, 1);
+    struct statsd_tcp *t = (struct statsd_tcp *)callocz(sizeof(struct statsd_tcp) + statsd.tcp_buffer_size, 1);
+    t->shard = &((struct statsd_udp *)data)->status->shard;
     t->type = STATSD_SOCKET_DATA_TYPE_TCP;
-    t->size = STATSD_TCP_BUFFER_SIZE - 1;
+    t->size = statsd.tcp_buffer_size - 1;
     statsd.tcp_socket_connects++;
     statsd.tcp_socket_connected++;
 
@@ -799,10 +1368,11 @@ static void statsd_del_callback(POLLINFO *pi) {
 
     if(likely(t)) {
         if(t->type == STATSD_SOCKET_DATA_TYPE_TCP) {
-            if(t->len != 0) {
+            if(t->len != 0 && !t->discard) {
                 statsd.socket_errors++;
+                t->buffer[t->len] = '\0';
                 error("STATSD: client is probably sending unterminated metrics. Closed socket left with '%s'. Trying to process it.", t->buffer);
-                statsd_process(t->buffer, t->len, 0);
+                statsd_process(t->shard, t->buffer, t->len);
             }
             statsd.tcp_socket_disconnects++;
             statsd.tcp_socket_connected--;
@@ -814,6 +1384,20 @@ static void statsd_del_callback(POLLINFO *pi) {
     }
 }
 
+#ifdef STATSD_UDP_CONTROL_SIZE
+// the kernel counts the datagrams dropped on every socket since it was opened
+static inline void statsd_udp_socket_drops(struct collection_thread_status *status, int fd, uint32_t drops) {
+    size_t i;
+    for(i = 0; i < status->sockets->opened ;i++) {
+        if(status->sockets->fds[i] == fd) {
+            status->udp_packets_dropped += (uint32_t)(drops - status->udp_socket_drops[i]);
+            status->udp_socket_drops[i] = drops;
+            return;
+        }
+    }
+}
+#endif
+
 // Receive data
 static int statsd_rcv_callback(POLLINFO *pi, short int *events) {
     *events = POLLIN;
@@ -838,6 +1422,7 @@ static int statsd_rcv_callback(POLLINFO *pi, short int *events) {
 #endif
 
             int ret = 0;
+            size_t reads = 0;
             ssize_t rc;
             do {
                 rc = recv(fd, &d->buffer[d->len], d->size - d->len, MSG_DONTWAIT);
@@ -859,17 +1444,16 @@ static int statsd_rcv_callback(POLLINFO *pi, short int *events) {
                     d->len += rc;
                     statsd.tcp_socket_reads++;
                     statsd.tcp_bytes_read += rc;
-                }
-
-                if(likely(d->len > 0)) {
                     statsd.tcp_packets_received++;
-                    d->len = statsd_process(d->buffer, d->len, 1);
+                    statsd_process_tcp(d);
                 }
 
                 if(unlikely(ret == -1))
                     return -1;
 
-            } while (rc != -1);
+                // a busy client is read again at the next poll, so that it does not starve the others
+                // (while its data wait, the kernel slows it down, instead of dropping them)
+            } while (rc != -1 && ++reads < STATSD_TCP_READS_PER_EVENT);
             break;
         }
 
@@ -889,9 +1473,17 @@ static int statsd_rcv_callback(POLLINFO *pi, short int *events) {
             }
 #endif
 
+            struct collection_thread_status *status = d->status;
+
 #ifdef HAVE_RECVMMSG
             ssize_t rc;
             do {
+#ifdef STATSD_UDP_CONTROL_SIZE
+                size_t m;
+                for(m = 0; m < d->size; m++)
+                    d->msgs[m].msg_hdr.msg_controllen = STATSD_UDP_CONTROL_SIZE;
+#endif
+
                 rc = recvmmsg(fd, d->msgs, (unsigned int)d->size, MSG_DONTWAIT, NULL);
                 if (rc < 0) {
                     // read failed
@@ -902,15 +1494,27 @@ static int statsd_rcv_callback(POLLINFO *pi, short int *events) {
                     }
                 } else if (rc) {
                     // data received
-                    statsd.udp_socket_reads++;
-                    statsd.udp_packets_received += rc;
+                    status->udp_socket_reads++;
+                    status->udp_packets_received += rc;
 
                     size_t i;
                     for (i = 0; i < (size_t)rc; ++i) {
                         size_t len = (size_t)d->msgs[i].msg_len;
-                        statsd.udp_bytes_read += len;
-                        statsd_process(d->msgs[i].msg_hdr.msg_iov->iov_base, len, 0);
+                        status->udp_bytes_read += len;
+                        statsd_process(&status->shard, d->msgs[i].msg_hdr.msg_iov->iov_base, len);
+                    }
+
+#ifdef STATSD_UDP_CONTROL_SIZE
+                    // the counter is the same for all the datagrams of the batch, or newer on the last ones
+                    struct cmsghdr *cmsg;
+                    for(cmsg = CMSG_FIRSTHDR(&d->msgs[rc - 1].msg_hdr); cmsg ; cmsg = CMSG_NXTHDR(&d->msgs[rc - 1].msg_hdr, cmsg)) {
+                        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                            uint32_t drops;
+                            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                            statsd_udp_socket_drops(status, fd, drops);
+                        }
                     }
+#endif
                 }
             } while (rc != -1);
 
@@ -927,10 +1531,10 @@ static int statsd_rcv_callback(POLLINFO *pi, short int *events) {
                     }
                 } else if (rc) {
                     // data received
-                    statsd.udp_socket_reads++;
-                    statsd.udp_packets_received++;
-                    statsd.udp_bytes_read += rc;
-                    statsd_process(d->buffer, (size_t) rc, 0);
+                    status->udp_socket_reads++;
+                    status->udp_packets_received++;
+                    status->udp_bytes_read += rc;
+                    statsd_process(&status->shard, d->buffer, (size_t) rc);
                 }
             } while (rc != -1);
 #endif
@@ -966,7 +1570,7 @@ static void statsd_timer_callback(void *timer_data) {
 
 void statsd_collector_thread_cleanup(void *data) {
     struct statsd_udp *d = data;
-    *d->running = 0;
+    d->status->status = 0;
 
     info("cleaning up...");
 
@@ -977,6 +1581,9 @@ void statsd_collector_thread_cleanup(void *data) {
 
     freez(d->iovecs);
     freez(d->msgs);
+#ifdef STATSD_UDP_CONTROL_SIZE
+    freez(d->control);
+#endif
 #endif
 
     freez(d);
@@ -989,7 +1596,7 @@ void *statsd_collector_thread(void *ptr) {
     info("STATSD collector thread started with taskid %d", gettid());
 
     struct statsd_udp *d = callocz(sizeof(struct statsd_udp), 1);
-    d->running = &status->status;
+    d->status = status;
 
     netdata_thread_cleanup_push(statsd_collector_thread_cleanup, d);
 
@@ -999,16 +1606,32 @@ void *statsd_collector_thread(void *ptr) {
     d->iovecs = callocz(sizeof(struct iovec), d->size);
     d->msgs = callocz(sizeof(struct mmsghdr), d->size);
 
+#ifdef STATSD_UDP_CONTROL_SIZE
+    d->control = callocz(STATSD_UDP_CONTROL_SIZE, d->size);
+#endif
+
     size_t i;
     for (i = 0; i < d->size; i++) {
         d->iovecs[i].iov_base = mallocz(STATSD_UDP_BUFFER_SIZE);
         d->iovecs[i].iov_len = STATSD_UDP_BUFFER_SIZE - 1;
         d->msgs[i].msg_hdr.msg_iov = &d->iovecs[i];
         d->msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef STATSD_UDP_CONTROL_SIZE
+        d->msgs[i].msg_hdr.msg_control = &d->control[i * STATSD_UDP_CONTROL_SIZE];
+        d->msgs[i].msg_hdr.msg_controllen = STATSD_UDP_CONTROL_SIZE;
+#endif
     }
+
+#ifdef STATSD_UDP_CONTROL_SIZE
+    int enable = 1;
+    for(i = 0; i < status->sockets->opened ;i++) {
+        if(status->sockets->fds_types[i] == SOCK_DGRAM && setsockopt(status->sockets->fds[i], SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) != 0)
+            error("STATSD: cannot enable SO_RXQ_OVFL on %s, its dropped packets will not be counted.", status->sockets->fds_names[i]);
+    }
+#endif
 #endif
 
-    poll_events(&statsd.sockets
+    poll_events(status->sockets
             , statsd_add_callback
             , statsd_del_callback
             , statsd_rcv_callback
@@ -1276,6 +1899,10 @@ static int statsd_readfile(const char *filename, STATSD_APP *app, STATSD_APP_CHA
                 if (!strcmp(value, "yes") || !strcmp(value, "on"))
                     app->default_options |= STATSD_METRIC_OPTION_SHOW_GAPS_WHEN_NOT_COLLECTED;
             }
+            else if (!strcmp(name, "hyperloglog sets")) {
+                if (!strcmp(value, "yes") || !strcmp(value, "on"))
+                    app->default_options |= STATSD_METRIC_OPTION_SET_HYPERLOGLOG;
+            }
             else if (!strcmp(name, "memory mode")) {
                 app->rrd_memory_mode = rrd_memory_mode_id(value);
             }
@@ -1328,11 +1955,26 @@ static int statsd_readfile(const char *filename, STATSD_APP *app, STATSD_APP_CHA
                 int pattern = 0;
                 size_t i = 0;
                 char *metric_name   = words[i++];
+                char *tag           = NULL;
 
-                if(strcmp(metric_name, "pattern") == 0) {
+                if(metric_name && strcmp(metric_name, "pattern") == 0) {
                     metric_name = words[i++];
                     pattern = 1;
                 }
+                else if(metric_name && strcmp(metric_name, "tag") == 0) {
+                    tag = words[i++];
+                    metric_name = words[i++];
+
+                    if(!tag || !*tag || !metric_name || !*metric_name) {
+                        error("STATSD: ignoring line %zu of file '%s', a dimension by tag needs a tag and a metric.", line, filename);
+                        continue;
+                    }
+                }
+
+                if(!metric_name || !*metric_name) {
+                    error("STATSD: ignoring line %zu of file '%s', the dimension has no metric.", line, filename);
+                    continue;
+                }
 
                 char *dim_name      = words[i++];
                 char *type          = words[i++];
@@ -1347,7 +1989,7 @@ static int statsd_readfile(const char *filename, STATSD_APP *app, STATSD_APP_CHA
                     if(strstr(options, "nooverflow") != NULL) flags |= RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS;
                 }
 
-                if(!pattern) {
+                if(!pattern && !tag) {
                     if(app->dict) {
                         if(dim_name && *dim_name) {
                             char *n = dictionary_get(app->dict, dim_name);
@@ -1375,6 +2017,16 @@ static int statsd_readfile(const char *filename, STATSD_APP *app, STATSD_APP_CHA
 
                 if(pattern)
                     dim->metric_pattern = simple_pattern_create(dim->metric, NULL, SIMPLE_PATTERN_EXACT);
+
+                if(tag) {
+                    dim->tag = strdupz(tag);
+
+                    // the collector threads keep the tags of this metric
+                    if(!statsd.tagged_metrics)
+                        statsd.tagged_metrics = dictionary_create(DICTIONARY_FLAG_SINGLE_THREADED);
+
+                    dictionary_set(statsd.tagged_metrics, dim->metric, "", 1);
+                }
             }
             else {
                 error("STATSD: ignoring line %zu ('%s') of file '%s'. Unknown keyword for the [%s] section.", line, name, filename, chart->id);
@@ -1650,6 +2302,141 @@ static inline void statsd_private_chart_timer_or_histogram(STATSD_METRIC *m, con
     rrdset_done(m->st);
 }
 
+// --------------------------------------------------------------------------------------------------------------------
+// statsd merge the shards of the collector threads into the metrics
+
+static int statsd_set_merge_value(char *name, void *entry, void *data) {
+    (void)entry;
+    STATSD_METRIC *m = (STATSD_METRIC *)data;
+
+    if(unlikely(!dictionary_get(m->set.dict, name))) {
+        dictionary_set(m->set.dict, name, NULL, 1);
+        m->set.unique++;
+    }
+
+    return 0;
+}
+
+static inline void statsd_shard_metric_merge(STATSD_SHARD_METRIC *sm) {
+    STATSD_METRIC *m = sm->m;
+
+    if(unlikely(m->reset)) {
+        switch(m->type) {
+            case STATSD_METRIC_TYPE_TIMER:
+            case STATSD_METRIC_TYPE_HISTOGRAM:
+                m->histogram.ext->used = 0;
+                if(m->histogram.ext->sketch) statsd_sketch_reset(m->histogram.ext->sketch);
+                break;
+
+            case STATSD_METRIC_TYPE_SET:
+                if(likely(m->set.dict)) {
+                    dictionary_destroy(m->set.dict);
+                    m->set.dict = NULL;
+                }
+                if(m->set.registers)
+                    memset(m->set.registers, 0, (size_t)1 << statsd.sets_hyperloglog_precision);
+                m->set.unique = 0;
+                break;
+
+            default:
+                // no need to reset anything specific for gauges, counters and meters
+                break;
+        }
+
+        statsd_reset_metric(m);
+    }
+
+    switch(m->type) {
+        case STATSD_METRIC_TYPE_GAUGE:
+            if(sm->gauge.absolute)
+                m->gauge.value = sm->gauge.value;
+            else
+                m->gauge.value += sm->gauge.value;
+
+            sm->gauge.value = 0;
+            sm->gauge.absolute = 0;
+            break;
+
+        case STATSD_METRIC_TYPE_COUNTER:
+        case STATSD_METRIC_TYPE_METER:
+            m->counter.value += sm->counter;
+            sm->counter = 0;
+            break;
+
+        case STATSD_METRIC_TYPE_TIMER:
+        case STATSD_METRIC_TYPE_HISTOGRAM: {
+            STATSD_METRIC_HISTOGRAM_EXTENSIONS *ext = m->histogram.ext;
+
+            if(sm->histogram.sketch) {
+                statsd_sketch_merge(ext->sketch, sm->histogram.sketch);
+                statsd_sketch_reset(sm->histogram.sketch);
+            }
+            else if(sm->histogram.used) {
+                if(unlikely(ext->used + sm->histogram.used > ext->size)) {
+                    ext->size = ext->used + sm->histogram.used + statsd.histogram_increase_step;
+                    ext->values = reallocz(ext->values, sizeof(LONG_DOUBLE) * ext->size);
+                }
+
+                memcpy(&ext->values[ext->used], sm->histogram.values, sizeof(LONG_DOUBLE) * sm->histogram.used);
+                ext->used += sm->histogram.used;
+                sm->histogram.used = 0;
+            }
+            break;
+        }
+
+        case STATSD_METRIC_TYPE_SET:
+            if(sm->set.registers) {
+                size_t i, registers = (size_t)1 << statsd.sets_hyperloglog_precision;
+
+                if(unlikely(!m->set.registers))
+                    m->set.registers = callocz(registers, sizeof(uint8_t));
+
+                for(i = 0; i < registers ;i++)
+                    if(sm->set.registers[i] > m->set.registers[i])
+                        m->set.registers[i] = sm->set.registers[i];
+
+                memset(sm->set.registers, 0, registers);
+            }
+            else if(sm->set.dict) {
+                if(unlikely(!m->set.dict))
+                    m->set.dict = dictionary_create(STATSD_DICTIONARY_OPTIONS | DICTIONARY_FLAG_VALUE_LINK_DONT_CLONE);
+
+                dictionary_get_all_name_value(sm->set.dict, statsd_set_merge_value, m);
+
+                // the values are merged, the shard starts over
+                dictionary_destroy(sm->set.dict);
+                sm->set.dict = NULL;
+            }
+            break;
+    }
+
+    m->events += sm->events;
+    m->count += sm->events;
+    sm->events = 0;
+}
+
+// called by the charting thread, before flushing the metrics
+static void statsd_shard_merge(STATSD_SHARD *shard) {
+    netdata_mutex_lock(&shard->mutex);
+
+    STATSD_SHARD_METRIC *sm;
+    for(sm = shard->first_updated; sm ; sm = sm->next_updated)
+        statsd_shard_metric_merge(sm);
+
+    shard->first_updated = NULL;
+
+    statsd.gauges.events     += shard->events[STATSD_METRIC_TYPE_GAUGE];
+    statsd.counters.events   += shard->events[STATSD_METRIC_TYPE_COUNTER];
+    statsd.meters.events     += shard->events[STATSD_METRIC_TYPE_METER];
+    statsd.timers.events     += shard->events[STATSD_METRIC_TYPE_TIMER];
+    statsd.histograms.events += shard->events[STATSD_METRIC_TYPE_HISTOGRAM];
+    statsd.sets.events       += shard->events[STATSD_METRIC_TYPE_SET];
+    memset(shard->events, 0, sizeof(shard->events));
+
+    netdata_mutex_unlock(&shard->mutex);
+}
+
+
 // --------------------------------------------------------------------------------------------------------------------
 // statsd flush metrics
 
@@ -1696,7 +2483,7 @@ static inline void statsd_flush_set(STATSD_METRIC *m) {
 
     int updated = 0;
     if(unlikely(!m->reset && m->count)) {
-        m->last = (collected_number)m->set.unique;
+        m->last = (collected_number)(m->set.registers ? statsd_hyperloglog_estimate(m->set.registers) : m->set.unique);
 
         m->reset = 1;
         updated = 1;
@@ -1713,9 +2500,33 @@ static inline void statsd_flush_timer_or_histogram(STATSD_METRIC *m, const char
     debug(D_STATSD, "flushing %s metric '%s'", dim, m->name);
 
     int updated = 0;
-    if(unlikely(!m->reset && m->count && m->histogram.ext->used > 0)) {
-        netdata_mutex_lock(&m->histogram.ext->mutex);
+    if(unlikely(!m->reset && m->count && m->histogram.ext->sketch && m->histogram.ext->sketch->count > 0)) {
+        STATSD_SKETCH *sk = m->histogram.ext->sketch;
+
+        m->histogram.ext->last_min = (collected_number)roundl(sk->min * statsd.decimal_detail);
+        m->histogram.ext->last_max = (collected_number)roundl(sk->max * statsd.decimal_detail);
+        m->last = (collected_number)roundl(sk->sum / sk->count * statsd.decimal_detail);
+        m->histogram.ext->last_median = (collected_number)roundl(statsd_sketch_value_at_rank(sk, sk->count / 2.0) * statsd.decimal_detail);
+        m->histogram.ext->last_sum = (collected_number)roundl(sk->sum * statsd.decimal_detail);
+
+        // like standard_deviation(), the value itself when there is just one
+        LONG_DOUBLE stddev = (sk->count == 1) ? sk->sum : sqrtl(sk->m2 / sk->count);
+        m->histogram.ext->last_stddev = (collected_number)roundl(stddev * statsd.decimal_detail);
+
+        double pct_rank = floor(sk->count * statsd.histogram_percentile / 100.0);
+        if(pct_rank < 1)
+            m->histogram.ext->last_percentile = (collected_number)(sk->min * statsd.decimal_detail);
+        else
+            m->histogram.ext->last_percentile = (collected_number)roundl(statsd_sketch_value_at_rank(sk, pct_rank - 1) * statsd.decimal_detail);
+
+        debug(D_STATSD, "STATSD %s metric %s: min " COLLECTED_NUMBER_FORMAT ", max " COLLECTED_NUMBER_FORMAT ", last " COLLECTED_NUMBER_FORMAT ", pcent " COLLECTED_NUMBER_FORMAT ", median " COLLECTED_NUMBER_FORMAT ", stddev " COLLECTED_NUMBER_FORMAT ", sum " COLLECTED_NUMBER_FORMAT,
+              dim, m->name, m->histogram.ext->last_min, m->histogram.ext->last_max, m->last, m->histogram.ext->last_percentile, m->histogram.ext->last_median, m->histogram.ext->last_stddev, m->histogram.ext->last_sum);
 
+        m->histogram.ext->zeroed = 0;
+        m->reset = 1;
+        updated = 1;
+    }
+    else if(unlikely(!m->reset && m->count && m->histogram.ext->used > 0)) {
         size_t len = m->histogram.ext->used;
         LONG_DOUBLE *series = m->histogram.ext->values;
         sort_series(series, len);
@@ -1733,8 +2544,6 @@ static inline void statsd_flush_timer_or_histogram(STATSD_METRIC *m, const char
         else
             m->histogram.ext->last_percentile = (collected_number)roundl(series[pct_len - 1] * statsd.decimal_detail);
 
-        netdata_mutex_unlock(&m->histogram.ext->mutex);
-
         debug(D_STATSD, "STATSD %s metric %s: min " COLLECTED_NUMBER_FORMAT ", max " COLLECTED_NUMBER_FORMAT ", last " COLLECTED_NUMBER_FORMAT ", pcent " COLLECTED_NUMBER_FORMAT ", median " COLLECTED_NUMBER_FORMAT ", stddev " COLLECTED_NUMBER_FORMAT ", sum " COLLECTED_NUMBER_FORMAT,
               dim, m->name, m->histogram.ext->last_min, m->histogram.ext->last_max, m->last, m->histogram.ext->last_percentile, m->histogram.ext->last_median, m->histogram.ext->last_stddev, m->histogram.ext->last_sum);
 
@@ -1851,6 +2660,31 @@ static inline void link_metric_to_app_dimension(STATSD_APP *app, STATSD_METRIC *
     debug(D_STATSD, "metric '%s' of type %u linked with app '%s', chart '%s', dimension '%s', algorithm '%s'", m->name, m->type, app->name, chart->id, dim->name, rrd_algorithm_name(dim->algorithm));
 }
 
+// the value of the tag in the tag set
+static int statsd_tags_get(const char *tags, const char *tag, char *value, size_t len) {
+    size_t tag_len = strlen(tag);
+
+    while(*tags) {
+        const char *e = tags;
+        while(*e && *e != ',') e++;
+
+        if(!strncmp(tags, tag, tag_len) && (tags[tag_len] == ':' || &tags[tag_len] == e)) {
+            const char *v = (&tags[tag_len] == e) ? e : &tags[tag_len + 1];
+            size_t l = (size_t)(e - v);
+            if(l >= len) l = len - 1;
+
+            memcpy(value, v, l);
+            value[l] = '\0';
+            return 1;
+        }
+
+        if(!*e) break;
+        tags = e + 1;
+    }
+
+    return 0;
+}
+
 static inline void check_if_metric_is_for_app(STATSD_INDEX *index, STATSD_METRIC *m) {
     (void)index;
 
@@ -1871,6 +2705,10 @@ static inline void check_if_metric_is_for_app(STATSD_INDEX *index, STATSD_METRIC
             else
                 m->options &= ~STATSD_METRIC_OPTION_SHOW_GAPS_WHEN_NOT_COLLECTED;
 
+            // sets switch to the hyperloglog the next time they are reset
+            if(m->type == STATSD_METRIC_TYPE_SET && app->default_options & STATSD_METRIC_OPTION_SET_HYPERLOGLOG)
+                m->options |= STATSD_METRIC_OPTION_SET_HYPERLOGLOG;
+
             m->options |= STATSD_METRIC_OPTION_PRIVATE_CHART_CHECKED;
 
             // check if there is a chart in this app, willing to get this metric
@@ -1879,7 +2717,56 @@ static inline void check_if_metric_is_for_app(STATSD_INDEX *index, STATSD_METRIC
 
                 STATSD_APP_CHART_DIM *dim;
                 for(dim = chart->dimensions; dim ; dim = dim->next) {
-                    if(unlikely(dim->metric_pattern)) {
+                    if(unlikely(dim->tag)) {
+                        if(!m->tags || dim->metric_hash != m->hash || strcmp(dim->metric, m->name))
+                            continue;
+
+                        char value[strlen(m->tags) + 1];
+                        if(!statsd_tags_get(m->tags, dim->tag, value, sizeof(value)))
+                            continue;
+
+                        size_t dim_name_len = strlen(dim->name);
+                        size_t tagged_len = dim_name_len + strlen(value) + 1;
+                        char tagged[tagged_len];
+                        snprintfz(tagged, tagged_len - 1, "%s%s", dim->name, value);
+
+                        char *final_name = (app->dict) ? dictionary_get(app->dict, tagged) : NULL;
+                        if(!final_name)
+                            final_name = tagged;
+
+                        // more tag sets may have the same value of the tag
+                        size_t id_len = strlen(m->name) + tagged_len + 30;
+                        char id[id_len];
+                        snprintfz(id, id_len - 1, "%s_%s", m->name, tagged);
+
+                        size_t same = 0, len = strlen(id);
+                        STATSD_APP_CHART_DIM *tdim;
+                        for(tdim = chart->dimensions; tdim ; tdim = tdim->next)
+                            if(tdim->id && !strncmp(tdim->id, id, len)) same++;
+
+                        if(same)
+                            snprintfz(&id[len], id_len - len - 1, "_%zu", same + 1);
+
+                        tdim = add_dimension_to_app_chart(
+                                app
+                                , chart
+                                , m->name
+                                , final_name
+                                , dim->multiplier
+                                , dim->divisor
+                                , dim->flags
+                                , dim->value_type
+                        );
+
+                        tdim->tags = m->tags;
+                        tdim->id = strdupz(id);
+
+                        // the new dimension is appended to the list
+                        // so, it will be matched and linked later too
+                    }
+                    else if(unlikely(dim->metric_pattern)) {
+                        if(m->tags) continue;
+
                         size_t dim_name_len = strlen(dim->name);
                         size_t wildcarded_len = dim_name_len + strlen(m->name) + 1;
                         char wildcarded[wildcarded_len];
@@ -1921,7 +2808,7 @@ static inline void check_if_metric_is_for_app(STATSD_INDEX *index, STATSD_METRIC
                             // so, it will be matched and linked later too
                         }
                     }
-                    else if(!dim->value_ptr && dim->metric_hash == m->hash && !strcmp(dim->metric, m->name)) {
+                    else if(!dim->value_ptr && dim->metric_hash == m->hash && !strcmp(dim->metric, m->name) && !statsd_tags_compare(dim->tags, m->tags)) {
                         // we have a match - this metric should be linked to this dimension
                         link_metric_to_app_dimension(app, m, chart, dim);
                     }
@@ -1935,6 +2822,13 @@ static inline void check_if_metric_is_for_app(STATSD_INDEX *index, STATSD_METRIC
 static inline RRDDIM *statsd_add_dim_to_app_chart(STATSD_APP *app, STATSD_APP_CHART *chart, STATSD_APP_CHART_DIM *dim) {
     (void)app;
 
+    if(unlikely(dim->id)) {
+        // a tag set of the metric
+        dim->rd = rrddim_add(chart->st, dim->id, dim->name, dim->multiplier, dim->divisor, dim->algorithm);
+        if(dim->flags != RRDDIM_FLAG_NONE) dim->rd->flags |= dim->flags;
+        return dim->rd;
+    }
+
     // allow the same statsd metric to be added multiple times to the same chart
 
     STATSD_APP_CHART_DIM *tdim;
@@ -1942,7 +2836,7 @@ static inline RRDDIM *statsd_add_dim_to_app_chart(STATSD_APP *app, STATSD_APP_CH
     size_t pos_same_metric_value_type = 0;
 
     for (tdim = chart->dimensions; tdim && tdim->next; tdim = tdim->next) {
-        if (dim->metric_hash == tdim->metric_hash && !strcmp(dim->metric, tdim->metric)) {
+        if (!tdim->tag && !tdim->id && dim->metric_hash == tdim->metric_hash && !strcmp(dim->metric, tdim->metric)) {
             count_same_metric++;
 
             if(dim->value_type == tdim->value_type) {
@@ -2007,7 +2901,7 @@ static inline void statsd_update_app_chart(STATSD_APP *app, STATSD_APP_CHART *ch
 
     STATSD_APP_CHART_DIM *dim;
     for(dim = chart->dimensions; dim ;dim = dim->next) {
-        if(likely(!dim->metric_pattern)) {
+        if(likely(!dim->metric_pattern && !dim->tag)) {
             if (unlikely(!dim->rd))
                 statsd_add_dim_to_app_chart(app, chart, dim);
 
@@ -2062,7 +2956,7 @@ static inline void statsd_flush_index_metrics(STATSD_INDEX *index, void (*flush_
         if(unlikely(is_metric_checked(m))) break;
 
         if(unlikely(!(m->options & STATSD_METRIC_OPTION_CHECKED_IN_APPS))) {
-            log_access("NEW STATSD METRIC '%s': '%s'", statsd_metric_type_string(m->type), m->name);
+            log_access("NEW STATSD METRIC '%s': '%s'%s%s", statsd_metric_type_string(m->type), m->name, m->tags ? " with tags " : "", m->tags ? m->tags : "");
             check_if_metric_is_for_app(index, m);
             m->options |= STATSD_METRIC_OPTION_CHECKED_IN_APPS;
         }
@@ -2086,6 +2980,10 @@ static inline void statsd_flush_index_metrics(STATSD_INDEX *index, void (*flush_
             m->options |= STATSD_METRIC_OPTION_PRIVATE_CHART_CHECKED;
         }
 
+        // the tag sets of a metric are charted only as dimensions of app charts
+        if(unlikely(m->tags))
+            m->options &= ~STATSD_METRIC_OPTION_PRIVATE_CHART_ENABLED;
+
         // mark it as checked
         m->options |= STATSD_METRIC_OPTION_CHECKED;
 
@@ -2131,6 +3029,17 @@ static void statsd_main_cleanup(void *data) {
     }
 
     info("STATSD: closing sockets...");
+    if (statsd.collection_threads_status) {
+        int i;
+        for (i = 0; i < statsd.threads; i++) {
+            LISTEN_SOCKETS *sockets = statsd.collection_threads_status[i].sockets;
+            if(sockets && sockets != &statsd.sockets) {
+                listen_sockets_close(sockets);
+                freez(sockets);
+            }
+            statsd.collection_threads_status[i].sockets = NULL;
+        }
+    }
     listen_sockets_close(&statsd.sockets);
 
     info("STATSD: cleanup completed.");
@@ -2163,6 +3072,12 @@ void *statsd_main(void *ptr) {
     statsd.private_charts_rrd_history_entries = (int)config_get_number(CONFIG_SECTION_STATSD, "private charts history", default_rrd_history_entries);
     statsd.decimal_detail = (collected_number)config_get_number(CONFIG_SECTION_STATSD, "decimal detail", (long long int)statsd.decimal_detail);
     statsd.tcp_idle_timeout = (size_t) config_get_number(CONFIG_SECTION_STATSD, "disconnect idle tcp clients after seconds", (long long int)statsd.tcp_idle_timeout);
+
+    statsd.tcp_buffer_size = (size_t) config_get_number(CONFIG_SECTION_STATSD, "tcp buffer per client", (long long int)statsd.tcp_buffer_size);
+    if(statsd.tcp_buffer_size < 4096) {
+        error("STATSD: tcp buffer per client %zu is too small, using 4096", statsd.tcp_buffer_size);
+        statsd.tcp_buffer_size = 4096;
+    }
     statsd.private_charts_hidden = (unsigned int)config_get_boolean(CONFIG_SECTION_STATSD, "private charts hidden", statsd.private_charts_hidden);
 
     statsd.histogram_percentile = (double)config_get_float(CONFIG_SECTION_STATSD, "histograms and timers percentile (percentThreshold)", statsd.histogram_percentile);
@@ -2176,6 +3091,30 @@ void *statsd_main(void *ptr) {
         statsd.histogram_percentile_str = strdupz(buffer);
     }
 
+    statsd.sets_hyperloglog_for = simple_pattern_create(config_get(CONFIG_SECTION_STATSD, "hyperloglog sets for metrics matching", ""), NULL, SIMPLE_PATTERN_EXACT);
+    statsd.sets_hyperloglog_precision = (int)config_get_number(CONFIG_SECTION_STATSD, "hyperloglog sets precision", statsd.sets_hyperloglog_precision);
+    if(statsd.sets_hyperloglog_precision < 4 || statsd.sets_hyperloglog_precision > 18) {
+        error("STATSD: invalid hyperloglog sets precision %d given, using 12", statsd.sets_hyperloglog_precision);
+        statsd.sets_hyperloglog_precision = 12;
+    }
+
+    statsd.max_tag_sets = (size_t)config_get_number(CONFIG_SECTION_STATSD, "max tag sets per metric", (long long)statsd.max_tag_sets);
+
+    statsd.histogram_sketches = config_get_boolean(CONFIG_SECTION_STATSD, "histograms and timers sketches", statsd.histogram_sketches);
+    if(statsd.histogram_sketches) {
+        double accuracy = (double)config_get_float(CONFIG_SECTION_STATSD, "histograms and timers sketches accuracy %", 1.0);
+        if(isless(accuracy, 0.01) || isgreater(accuracy, 50.0)) {
+            error("STATSD: invalid histograms and timers sketches accuracy %0.5f%% given, using 1%%", accuracy);
+            accuracy = 1.0;
+        }
+
+        accuracy /= 100.0;
+        statsd.histogram_sketch_log_gamma = logl((1.0 + accuracy) / (1.0 - accuracy));
+
+        // the values that are zero with the decimal detail of the charts
+        statsd.histogram_sketch_zero = 0.5 / (LONG_DOUBLE)statsd.decimal_detail;
+    }
+
     if(config_get_boolean(CONFIG_SECTION_STATSD, "add dimension for number of events received", 1)) {
         statsd.gauges.default_options |= STATSD_METRIC_OPTION_CHART_DIMENSION_COUNT;
         statsd.counters.default_options |= STATSD_METRIC_OPTION_CHART_DIMENSION_COUNT;
@@ -2205,16 +3144,13 @@ void *statsd_main(void *ptr) {
 
     size_t max_sockets = (size_t)config_get_number(CONFIG_SECTION_STATSD, "statsd server max TCP sockets", (long long int)(rlimit_nofile.rlim_cur / 4));
 
-#ifdef STATSD_MULTITHREADED
+    // every collector thread aggregates the metrics it receives in a shard of its own
     statsd.threads = (int)config_get_number(CONFIG_SECTION_STATSD, "threads", processors);
     if(statsd.threads < 1) {
         error("STATSD: Invalid number of threads %d, using %d", statsd.threads, processors);
         statsd.threads = processors;
-        config_set_number(CONFIG_SECTION_STATSD, "collector threads", statsd.threads);
+        config_set_number(CONFIG_SECTION_STATSD, "threads", statsd.threads);
     }
-#else
-    statsd.threads = 1;
-#endif
 
     // read custom application definitions
     statsd_readdir(netdata_configured_user_config_dir, netdata_configured_stock_config_dir, "statsd.d");
@@ -2232,9 +3168,33 @@ void *statsd_main(void *ptr) {
 
     statsd.collection_threads_status = callocz((size_t)statsd.threads, sizeof(struct collection_thread_status));
 
+    // with sockets of their own for every UDP and TCP port, the kernel distributes
+    // the datagrams (by their source address) and the connections among the threads,
+    // instead of waking all of them up to race for every datagram
+    int listen_per_thread = config_get_boolean(CONFIG_SECTION_STATSD, "listen sockets per thread",
+#ifdef __linux__
+                                               CONFIG_BOOLEAN_YES
+#else
+                                               CONFIG_BOOLEAN_NO
+#endif
+    );
+
     int i;
     for(i = 0; i < statsd.threads ;i++) {
         statsd.collection_threads_status[i].max_sockets = max_sockets / statsd.threads;
+        statsd_shard_init(&statsd.collection_threads_status[i].shard);
+        statsd.collection_threads_status[i].sockets = &statsd.sockets;
+
+        if(i > 0 && listen_per_thread) {
+            LISTEN_SOCKETS *sockets = callocz(1, sizeof(LISTEN_SOCKETS));
+            if(listen_sockets_reuseport(sockets, &statsd.sockets) > 0)
+                statsd.collection_threads_status[i].sockets = sockets;
+            else {
+                listen_sockets_close(sockets);
+                freez(sockets);
+            }
+        }
+
         char tag[NETDATA_THREAD_TAG_MAX + 1];
         snprintfz(tag, NETDATA_THREAD_TAG_MAX, "STATSD_COLLECTOR[%d]", i + 1);
         netdata_thread_create(&statsd.collection_threads_status[i].thread, tag, NETDATA_THREAD_OPTION_DEFAULT, statsd_collector_thread, &statsd.collection_threads_status[i]);
@@ -2451,6 +3411,27 @@ void *statsd_main(void *ptr) {
 
         statsd.collection_threads_status[i].rd_user   = rrddim_add(statsd.collection_threads_status[i].st_cpu, "user", NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
         statsd.collection_threads_status[i].rd_system = rrddim_add(statsd.collection_threads_status[i].st_cpu, "system", NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
+
+        snprintfz(id, 100, "plugin_statsd_collector%d_udp_packets", i + 1);
+        snprintfz(title, 100, "NetData statsd collector thread No %d UDP packets", i + 1);
+
+        statsd.collection_threads_status[i].st_packets = rrdset_create_localhost(
+                "netdata"
+                , id
+                , NULL
+                , "statsd"
+                , "netdata.statsd_collector_udp_packets"
+                , title
+                , "packets/s"
+                , PLUGIN_STATSD_NAME
+                , "stats"
+                , 132100 + i
+                , statsd.update_every
+                , RRDSET_TYPE_LINE
+        );
+
+        statsd.collection_threads_status[i].rd_received = rrddim_add(statsd.collection_threads_status[i].st_packets, "received", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+        statsd.collection_threads_status[i].rd_dropped  = rrddim_add(statsd.collection_threads_status[i].st_packets, "dropped", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
     }
 
             // ----------------------------------------------------------------------------------------------------------------
@@ -2462,6 +3443,9 @@ void *statsd_main(void *ptr) {
     while(!netdata_exit) {
         usec_t hb_dt = heartbeat_next(&hb, step);
 
+        for(i = 0; i < statsd.threads ;i++)
+            statsd_shard_merge(&statsd.collection_threads_status[i].shard);
+
         statsd_flush_index_metrics(&statsd.gauges,     statsd_flush_gauge);
         statsd_flush_index_metrics(&statsd.counters,   statsd_flush_counter);
         statsd_flush_index_metrics(&statsd.meters,     statsd_flush_meter);
@@ -2487,8 +3471,20 @@ void *statsd_main(void *ptr) {
             rrdset_next(st_tcp_connected);
             rrdset_next(st_pcharts);
             rrdset_next(stcpu_thread);
-            for(i = 0; i < statsd.threads ;i++)
+            for(i = 0; i < statsd.threads ;i++) {
                 rrdset_next(statsd.collection_threads_status[i].st_cpu);
+                rrdset_next(statsd.collection_threads_status[i].st_packets);
+            }
+        }
+
+        // every collector thread counts the UDP packets it receives
+        statsd.udp_socket_reads = 0;
+        statsd.udp_packets_received = 0;
+        statsd.udp_bytes_read = 0;
+        for(i = 0; i < statsd.threads ;i++) {
+            statsd.udp_socket_reads     += statsd.collection_threads_status[i].udp_socket_reads;
+            statsd.udp_packets_received += statsd.collection_threads_status[i].udp_packets_received;
+            statsd.udp_bytes_read       += statsd.collection_threads_status[i].udp_bytes_read;
         }
 
         rrddim_set_by_pointer(st_metrics, rd_metrics_gauge,        (collected_number)statsd.gauges.metrics);
@@ -2547,6 +3543,10 @@ void *statsd_main(void *ptr) {
             rrddim_set_by_pointer(statsd.collection_threads_status[i].st_cpu, statsd.collection_threads_status[i].rd_user, statsd.collection_threads_status[i].rusage.ru_utime.tv_sec * 1000000ULL + statsd.collection_threads_status[i].rusage.ru_utime.tv_usec);
             rrddim_set_by_pointer(statsd.collection_threads_status[i].st_cpu, statsd.collection_threads_status[i].rd_system, statsd.collection_threads_status[i].rusage.ru_stime.tv_sec * 1000000ULL + statsd.collection_threads_status[i].rusage.ru_stime.tv_usec);
             rrdset_done(statsd.collection_threads_status[i].st_cpu);
+
+            rrddim_set_by_pointer(statsd.collection_threads_status[i].st_packets, statsd.collection_threads_status[i].rd_received, (collected_number)statsd.collection_threads_status[i].udp_packets_received);
+            rrddim_set_by_pointer(statsd.collection_threads_status[i].st_packets, statsd.collection_threads_status[i].rd_dropped, (collected_number)statsd.collection_threads_status[i].udp_packets_dropped);
+            rrdset_done(statsd.collection_threads_status[i].st_packets);
         }
     }
 
@@ -2,12 +2,19 @@
 
 #include "plugin_tc.h"
 
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/gen_stats.h>
+
 #define RRD_TYPE_TC "tc"
 #define PLUGIN_TC_NAME "tc.plugin"
 
 // ----------------------------------------------------------------------------
 // /sbin/tc processor
-// this requires the script plugins.d/tc-qos-helper.sh
+// this requires the script plugins.d/tc-qos-helper.sh,
+// unless the qdiscs and classes can be collected with netlink
 
 #define TC_LINE_MAX 1024
 
@@ -831,6 +838,629 @@ static inline void tc_split_words(char *str, char **words, int max_words) {
     while(i < max_words) words[i++] = NULL;
 }
 
+// ----------------------------------------------------------------------------
+// tc data collection with netlink
+//
+// The qdiscs and classes are dumped with RTM_GETQDISC / RTM_GETTCLASS and
+// added to the same structures the tc-qos-helper.sh output is parsed into.
+// The ids are formatted the way tc prints them, so the charts and the
+// dimensions are the same with both methods. Nothing is forked: the
+// FireQOS and /etc/iproute2/tc_cls names are read here too.
+
+#define TC_NETLINK_BUFFER_SIZE 65536
+#define TC_NETLINK_ID_MAX 20
+
+static int tc_netlink_fd = -1;
+static uint32_t tc_netlink_seq = 0;
+static char *tc_netlink_buffer = NULL;
+
+// like tc_show in tc-qos-helper.sh: chart the qdiscs, or the classes
+static int tc_netlink_show_classes = 0;
+static char *tc_fireqos_run_dir = NULL;
+
+// the interfaces that have classes, refreshed together with the names
+struct tc_netlink_interface {
+    int ifindex;
+    char name[IF_NAMESIZE + 1];
+};
+
+static struct tc_netlink_interface *tc_netlink_interfaces = NULL;
+static size_t tc_netlink_interfaces_used = 0, tc_netlink_interfaces_size = 0, tc_netlink_interfaces_last = 0;
+
+// the device the messages of the running dump are added to
+static struct tc_device *tc_netlink_device = NULL;
+static int tc_netlink_device_ifindex = 0;
+static int tc_netlink_fix_names = 0;
+
+static int tc_netlink_open(void) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if(unlikely(fd == -1)) {
+        error("TC: cannot create a netlink route socket.");
+        return -1;
+    }
+
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+    if(unlikely(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == -1)) {
+        error("TC: cannot bind the netlink route socket.");
+        close(fd);
+        return -1;
+    }
+
+    // never block the plugin if the kernel does not answer
+    struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+    if(unlikely(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1))
+        error("TC: cannot set the receive timeout of the netlink route socket.");
+
+    if(unlikely(!tc_netlink_buffer))
+        tc_netlink_buffer = mallocz(TC_NETLINK_BUFFER_SIZE);
+
+    return fd;
+}
+
+static void tc_netlink_close(void) {
+    if(tc_netlink_fd != -1)
+        close(tc_netlink_fd);
+
+    tc_netlink_fd = -1;
+    freez(tc_netlink_buffer);
+    tc_netlink_buffer = NULL;
+
+    freez(tc_netlink_interfaces);
+    tc_netlink_interfaces = NULL;
+    tc_netlink_interfaces_used = tc_netlink_interfaces_size = tc_netlink_interfaces_last = 0;
+
+    tc_netlink_device = NULL;
+    tc_netlink_device_ifindex = 0;
+}
+
+// dump the qdiscs or the classes of an interface (or of all interfaces, with ifindex 0)
+// and call the callback for each of them - returns non-zero on failure
+static int tc_netlink_dump(int type, int ifindex, void (*callback)(struct nlmsghdr *nlh, void *data), void *data) {
+    struct {
+        struct nlmsghdr nlh;
+        struct tcmsg tcm;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len   = NLMSG_LENGTH(sizeof(struct tcmsg));
+    req.nlh.nlmsg_type  = (uint16_t)type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq   = ++tc_netlink_seq;
+    req.tcm.tcm_family  = AF_UNSPEC;
+    req.tcm.tcm_ifindex = ifindex;
+
+    const char *what = (type == RTM_GETQDISC) ? "RTM_GETQDISC" : "RTM_GETTCLASS";
+
+    if(unlikely(send(tc_netlink_fd, &req, req.nlh.nlmsg_len, 0) == -1)) {
+        error("TC: cannot send the %s request to netlink.", what);
+        return 1;
+    }
+
+    for(;;) {
+        // MSG_TRUNC makes recv() return the real size of the datagram
+        ssize_t bytes = recv(tc_netlink_fd, tc_netlink_buffer, TC_NETLINK_BUFFER_SIZE, MSG_TRUNC);
+        if(unlikely(bytes == -1)) {
+            if(errno == EINTR) continue;
+            error("TC: cannot receive the %s response from netlink.", what);
+            return 1;
+        }
+
+        if(unlikely(bytes == 0 || bytes > TC_NETLINK_BUFFER_SIZE)) {
+            error("TC: received an invalid netlink datagram of %zd bytes.", bytes);
+            return 1;
+        }
+
+        int len = (int)bytes;
+        struct nlmsghdr *nlh;
+        for(nlh = (struct nlmsghdr *)tc_netlink_buffer; NLMSG_OK(nlh, len) ; nlh = NLMSG_NEXT(nlh, len)) {
+            if(unlikely(nlh->nlmsg_seq != tc_netlink_seq))
+                continue;
+
+            if(unlikely(nlh->nlmsg_type == NLMSG_DONE))
+                return 0;
+
+            if(unlikely(nlh->nlmsg_type == NLMSG_ERROR)) {
+                struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+                // the interface has been removed since we found it
+                if(ifindex && err->error == -ENODEV)
+                    return 0;
+
+                error("TC: netlink failed to answer %s for interface %d (error %d).", what, ifindex, -err->error);
+                return 1;
+            }
+
+            if(likely(nlh->nlmsg_type == RTM_NEWQDISC || nlh->nlmsg_type == RTM_NEWTCLASS))
+                callback(nlh, data);
+        }
+    }
+}
+
+// format a handle the way tc prints it
+static inline void tc_netlink_handle_to_id(char *dst, uint32_t handle) {
+    if(handle == TC_H_ROOT)
+        snprintfz(dst, TC_NETLINK_ID_MAX, "root");
+    else if(handle == TC_H_UNSPEC)
+        snprintfz(dst, TC_NETLINK_ID_MAX, "none");
+    else if(!TC_H_MAJ(handle))
+        snprintfz(dst, TC_NETLINK_ID_MAX, ":%x", TC_H_MIN(handle));
+    else if(!TC_H_MIN(handle))
+        snprintfz(dst, TC_NETLINK_ID_MAX, "%x:", TC_H_MAJ(handle) >> 16);
+    else
+        snprintfz(dst, TC_NETLINK_ID_MAX, "%x:%x", TC_H_MAJ(handle) >> 16, TC_H_MIN(handle));
+}
+
+// ----------------------------------------------------------------------------
+// class and device names, the same tc-qos-helper.sh sends
+
+static inline void tc_netlink_set_class_name(struct tc_device *d, char **words) {
+    // words are the fields of a FireQOS monitored class
+    char *id = tc_netlink_show_classes ? words[2] : words[3];
+    char *name = words[1];
+
+    if(likely(id && *id && name && *name))
+        tc_device_set_class_name(d, id, name);
+}
+
+// return the value of a shell variable assignment, without its quotes
+static inline char *tc_netlink_shell_value(char *line, const char *variable, size_t variable_len) {
+    while(tc_space(*line)) line++;
+
+    if(strncmp(line, variable, variable_len) != 0 || line[variable_len] != '=')
+        return NULL;
+
+    char *s = &line[variable_len + 1];
+    s[strcspn(s, "\r\n")] = '\0';
+
+    size_t len = strlen(s);
+    if(len >= 2 && (*s == '"' || *s == '\'') && s[len - 1] == *s) {
+        s[len - 1] = '\0';
+        s++;
+    }
+
+    return s;
+}
+
+static int tc_netlink_fireqos_names(struct tc_device *d) {
+    char filename[FILENAME_MAX + 1];
+    char name[TC_LINE_MAX + 1];
+
+    snprintfz(filename, FILENAME_MAX, "%s/ifaces/%s", tc_fireqos_run_dir, d->id);
+    if(read_file(filename, name, TC_LINE_MAX) != 0)
+        return 1;
+
+    char *device_name = trim(name);
+    if(unlikely(!device_name))
+        return 1;
+
+    tc_device_set_device_name(d, device_name);
+
+    snprintfz(filename, FILENAME_MAX, "%s/%s.conf", tc_fireqos_run_dir, device_name);
+    FILE *fp = fopen(filename, "r");
+    if(unlikely(!fp))
+        return 0;
+
+    char line[TC_LINE_MAX + 1];
+    char family[TC_LINE_MAX + 1] = "";
+    while(fgets(line, TC_LINE_MAX, fp) != NULL) {
+        char *value;
+
+        if((value = tc_netlink_shell_value(line, "interface_classes_monitor", sizeof("interface_classes_monitor") - 1))) {
+            char *words[PLUGINSD_MAX_WORDS];
+            char *class = value, *next;
+
+            while(class && *class) {
+                while(tc_space(*class)) class++;
+                next = class;
+                while(*next && !tc_space(*next)) next++;
+                if(*next) *next++ = '\0';
+                else next = NULL;
+
+                // the fields are separated with | and, like in the shell, empty ones are skipped
+                char *s;
+                for(s = class; *s ; s++)
+                    if(*s == '|') *s = ' ';
+
+                tc_split_words(class, words, PLUGINSD_MAX_WORDS);
+                tc_netlink_set_class_name(d, words);
+
+                class = next;
+            }
+        }
+        else if((value = tc_netlink_shell_value(line, "interface_dev", sizeof("interface_dev") - 1)))
+            strncpyz(family, value, TC_LINE_MAX);
+    }
+    fclose(fp);
+
+    if(*family)
+        tc_device_set_device_family(d, family);
+
+    return 0;
+}
+
+static void tc_netlink_tc_cls_names(struct tc_device *d) {
+    FILE *fp = fopen("/etc/iproute2/tc_cls", "r");
+    if(unlikely(!fp))
+        return;
+
+    char line[TC_LINE_MAX + 1];
+    char *words[PLUGINSD_MAX_WORDS];
+    while(fgets(line, TC_LINE_MAX, fp) != NULL) {
+        tc_split_words(line, words, PLUGINSD_MAX_WORDS);
+
+        char *classid = words[0], *name = words[1];
+        if(!classid || !*classid || *classid == '#' || !name || !*name || *name == '#')
+            continue;
+
+        tc_device_set_class_name(d, classid, name);
+    }
+    fclose(fp);
+}
+
+static inline void tc_netlink_device_names(struct tc_device *d) {
+    if(tc_netlink_fireqos_names(d) != 0 && tc_netlink_show_classes)
+        tc_netlink_tc_cls_names(d);
+}
+
+// ----------------------------------------------------------------------------
+// qdiscs and classes
+
+static inline struct tc_netlink_interface *tc_netlink_interface_find(int ifindex) {
+    size_t i;
+
+    // the dumps return the interfaces in the same order every time,
+    // so the one we need is usually the one after the last we used
+    for(i = tc_netlink_interfaces_last; i < tc_netlink_interfaces_used ; i++)
+        if(tc_netlink_interfaces[i].ifindex == ifindex) goto found;
+
+    for(i = 0; i < tc_netlink_interfaces_last && i < tc_netlink_interfaces_used ; i++)
+        if(tc_netlink_interfaces[i].ifindex == ifindex) goto found;
+
+    return NULL;
+
+found:
+    tc_netlink_interfaces_last = i;
+    return &tc_netlink_interfaces[i];
+}
+
+static void tc_netlink_device_commit(void) {
+    if(unlikely(!tc_netlink_device))
+        return;
+
+    if(unlikely(tc_netlink_fix_names))
+        tc_netlink_device_names(tc_netlink_device);
+
+    netdata_thread_disable_cancelability();
+    tc_device_commit(tc_netlink_device);
+    netdata_thread_enable_cancelability();
+
+    tc_netlink_device = NULL;
+    tc_netlink_device_ifindex = 0;
+}
+
+static void tc_netlink_message(struct nlmsghdr *nlh, void *data) {
+    (void)data;
+
+    struct tcmsg *tcm = NLMSG_DATA(nlh);
+    int len = (int)nlh->nlmsg_len - (int)NLMSG_LENGTH(sizeof(struct tcmsg));
+    if(unlikely(len < 0))
+        return;
+
+    struct tc_netlink_interface *ifc = tc_netlink_interface_find(tcm->tcm_ifindex);
+    if(unlikely(!ifc))
+        return;
+
+    struct rtattr *rta, *rta_kind = NULL, *rta_stats2 = NULL, *rta_stats = NULL, *rta_xstats = NULL;
+    for(rta = TCA_RTA(tcm); RTA_OK(rta, len) ; rta = RTA_NEXT(rta, len)) {
+        switch(rta->rta_type) {
+            case TCA_KIND:   rta_kind   = rta; break;
+            case TCA_STATS2: rta_stats2 = rta; break;
+            case TCA_STATS:  rta_stats  = rta; break;
+            case TCA_XSTATS: rta_xstats = rta; break;
+            default: break;
+        }
+    }
+
+    if(unlikely(!rta_kind || !RTA_PAYLOAD(rta_kind)))
+        return;
+
+    const char *kind = RTA_DATA(rta_kind);
+    char qdisc = (char)(nlh->nlmsg_type == RTM_NEWQDISC);
+
+    // we don't want to get the ingress qdisc
+    // there should be an IFB interface for this
+    if(qdisc && !strcmp(kind, "ingress"))
+        return;
+
+    // tc prints neither 'root' nor 'parent' for these
+    if(unlikely(tcm->tcm_parent == TC_H_UNSPEC))
+        return;
+
+    if(tcm->tcm_ifindex != tc_netlink_device_ifindex) {
+        tc_netlink_device_commit();
+        tc_netlink_device = tc_device_create(ifc->name);
+        tc_netlink_device_ifindex = tcm->tcm_ifindex;
+    }
+
+    char id[TC_NETLINK_ID_MAX + 1], parentbuf[TC_NETLINK_ID_MAX + 1], leafbuf[TC_NETLINK_ID_MAX + 1];
+    char *parentid = NULL, *leafid = NULL;
+
+    tc_netlink_handle_to_id(id, tcm->tcm_handle);
+
+    if(tcm->tcm_parent != TC_H_ROOT) {
+        // the parent of a qdisc is a class, but its major: is also the id of the parent qdisc
+        tc_netlink_handle_to_id(parentbuf, qdisc ? TC_H_MAJ(tcm->tcm_parent) : tcm->tcm_parent);
+        parentid = parentbuf;
+
+        // tcm_info is the handle of the leaf qdisc of a class
+        if(!qdisc && tcm->tcm_info) {
+            snprintfz(leafbuf, TC_NETLINK_ID_MAX, "%x:1", TC_H_MAJ(tcm->tcm_info) >> 16);
+            leafid = leafbuf;
+        }
+    }
+
+    struct tc_class *c = tc_class_add(tc_netlink_device, id, qdisc, parentid, leafid);
+
+    struct gnet_stats_basic basic;
+    struct gnet_stats_queue queue;
+    struct rtattr *rta_basic = NULL, *rta_queue = NULL;
+
+    memset(&basic, 0, sizeof(basic));
+    memset(&queue, 0, sizeof(queue));
+
+    if(likely(rta_stats2)) {
+        int stats_len = (int)RTA_PAYLOAD(rta_stats2);
+        for(rta = RTA_DATA(rta_stats2); RTA_OK(rta, stats_len) ; rta = RTA_NEXT(rta, stats_len)) {
+            switch(rta->rta_type) {
+                case TCA_STATS_BASIC: rta_basic  = rta; break;
+                case TCA_STATS_QUEUE: rta_queue  = rta; break;
+                case TCA_STATS_APP:   rta_xstats = rta; break;
+                default: break;
+            }
+        }
+
+        // the kernel may send these shorter or longer than our headers define them
+        if(rta_basic) memcpy(&basic, RTA_DATA(rta_basic), MIN(RTA_PAYLOAD(rta_basic), sizeof(basic)));
+        if(rta_queue) memcpy(&queue, RTA_DATA(rta_queue), MIN(RTA_PAYLOAD(rta_queue), sizeof(queue)));
+    }
+    else if(rta_stats) {
+        struct tc_stats st;
+        memset(&st, 0, sizeof(st));
+        memcpy(&st, RTA_DATA(rta_stats), MIN(RTA_PAYLOAD(rta_stats), sizeof(st)));
+
+        rta_basic = rta_queue = rta_stats;
+        basic.bytes = st.bytes;
+        basic.packets = st.packets;
+        queue.drops = st.drops;
+        queue.overlimits = st.overlimits;
+    }
+
+    if(unlikely(!rta_basic)) {
+        c->updated = 0;
+        return;
+    }
+
+    c->bytes = basic.bytes;
+    c->packets = basic.packets;
+    c->dropped = queue.drops;
+    c->overlimits = queue.overlimits;
+    c->requeues = queue.requeues;
+    c->updated = 1;
+
+    if(!qdisc && rta_xstats && !strcmp(kind, "htb")) {
+        struct tc_htb_xstats xstats;
+        memset(&xstats, 0, sizeof(xstats));
+        memcpy(&xstats, RTA_DATA(rta_xstats), MIN(RTA_PAYLOAD(rta_xstats), sizeof(xstats)));
+
+        c->lended = xstats.lends;
+        c->borrowed = xstats.borrows;
+        c->giants = xstats.giants;
+
+        // the tokens are signed, but the text parser reads the negative ones as zero
+        c->tokens = ((int32_t)xstats.tokens < 0) ? 0 : (unsigned long long)xstats.tokens;
+        c->ctokens = ((int32_t)xstats.ctokens < 0) ? 0 : (unsigned long long)xstats.ctokens;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// find the interfaces that have classes, like find_tc_devices() in tc-qos-helper.sh
+
+struct tc_netlink_ifindexes {
+    int *ifindex;
+    size_t used;
+    size_t size;
+};
+
+static void tc_netlink_qdisc_ifindex(struct nlmsghdr *nlh, void *data) {
+    struct tc_netlink_ifindexes *ifs = (struct tc_netlink_ifindexes *)data;
+    struct tcmsg *tcm = NLMSG_DATA(nlh);
+
+    // the qdiscs of each interface are dumped together
+    if(ifs->used && ifs->ifindex[ifs->used - 1] == tcm->tcm_ifindex)
+        return;
+
+    if(unlikely(ifs->used == ifs->size)) {
+        ifs->size = ifs->size ? ifs->size * 2 : 16;
+        ifs->ifindex = reallocz(ifs->ifindex, ifs->size * sizeof(int));
+    }
+
+    ifs->ifindex[ifs->used++] = tcm->tcm_ifindex;
+}
+
+static void tc_netlink_class_count(struct nlmsghdr *nlh, void *data) {
+    (void)nlh;
+    (*(size_t *)data)++;
+}
+
+static int tc_netlink_find_interfaces(void) {
+    struct tc_netlink_ifindexes ifs = { .ifindex = NULL, .used = 0, .size = 0 };
+
+    // RTM_GETTCLASS cannot dump all the interfaces at once,
+    // so we ask only the ones that have qdiscs
+    if(unlikely(tc_netlink_dump(RTM_GETQDISC, 0, tc_netlink_qdisc_ifindex, &ifs))) {
+        freez(ifs.ifindex);
+        return 1;
+    }
+
+    tc_netlink_interfaces_used = tc_netlink_interfaces_last = 0;
+
+    size_t i;
+    for(i = 0; i < ifs.used ; i++) {
+        size_t classes = 0;
+
+        if(unlikely(tc_netlink_dump(RTM_GETTCLASS, ifs.ifindex[i], tc_netlink_class_count, &classes))) {
+            freez(ifs.ifindex);
+            return 1;
+        }
+
+        if(!classes)
+            continue;
+
+        if(unlikely(tc_netlink_interfaces_used == tc_netlink_interfaces_size)) {
+            tc_netlink_interfaces_size = tc_netlink_interfaces_size ? tc_netlink_interfaces_size * 2 : 16;
+            tc_netlink_interfaces = reallocz(tc_netlink_interfaces, tc_netlink_interfaces_size * sizeof(struct tc_netlink_interface));
+        }
+
+        struct tc_netlink_interface *ifc = &tc_netlink_interfaces[tc_netlink_interfaces_used];
+        if(unlikely(!if_indextoname((unsigned int)ifs.ifindex[i], ifc->name)))
+            continue;
+
+        ifc->ifindex = ifs.ifindex[i];
+        tc_netlink_interfaces_used++;
+    }
+
+    freez(ifs.ifindex);
+    return 0;
+}
+
+static int tc_netlink_collect(void) {
+    int ret = 0;
+
+    if(tc_netlink_show_classes) {
+        size_t i;
+        for(i = 0; !ret && i < tc_netlink_interfaces_used ; i++)
+            ret = tc_netlink_dump(RTM_GETTCLASS, tc_netlink_interfaces[i].ifindex, tc_netlink_message, NULL);
+    }
+    else
+        ret = tc_netlink_dump(RTM_GETQDISC, 0, tc_netlink_message, NULL);
+
+    if(unlikely(ret)) {
+        // like an interface without END from the script
+        tc_netlink_device = NULL;
+        tc_netlink_device_ifindex = 0;
+        return ret;
+    }
+
+    tc_netlink_device_commit();
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static void tc_worktime_charts(long long run_time) {
+    struct rusage thread;
+    getrusage(RUSAGE_THREAD, &thread);
+
+    static RRDSET *stcpu = NULL;
+    static RRDDIM *rd_user = NULL, *rd_system = NULL;
+
+    if(unlikely(!stcpu)) {
+        stcpu = rrdset_create_localhost(
+                "netdata"
+                , "plugin_tc_cpu"
+                , NULL
+                , "tc.helper"
+                , NULL
+                , "NetData TC CPU usage"
+                , "milliseconds/s"
+                , PLUGIN_TC_NAME
+                , NULL
+                , NETDATA_CHART_PRIO_NETDATA_TC_CPU
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_STACKED
+        );
+        rd_user   = rrddim_add(stcpu, "user",  NULL,  1, 1000, RRD_ALGORITHM_INCREMENTAL);
+        rd_system = rrddim_add(stcpu, "system", NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
+    }
+    else rrdset_next(stcpu);
+
+    rrddim_set_by_pointer(stcpu, rd_user  , thread.ru_utime.tv_sec * 1000000ULL + thread.ru_utime.tv_usec);
+    rrddim_set_by_pointer(stcpu, rd_system, thread.ru_stime.tv_sec * 1000000ULL + thread.ru_stime.tv_usec);
+    rrdset_done(stcpu);
+
+    static RRDSET *sttime = NULL;
+    static RRDDIM *rd_run_time = NULL;
+
+    if(unlikely(!sttime)) {
+        sttime = rrdset_create_localhost(
+                "netdata"
+                , "plugin_tc_time"
+                , NULL
+                , "tc.helper"
+                , NULL
+                , "NetData TC script execution"
+                , "milliseconds/run"
+                , PLUGIN_TC_NAME
+                , NULL
+                , NETDATA_CHART_PRIO_NETDATA_TC_TIME
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_AREA
+        );
+        rd_run_time = rrddim_add(sttime, "run_time",  "run time",  1, 1, RRD_ALGORITHM_ABSOLUTE);
+    }
+    else rrdset_next(sttime);
+
+    rrddim_set_by_pointer(sttime, rd_run_time, run_time);
+    rrdset_done(sttime);
+}
+
+// returns non-zero when netlink cannot be used
+static int tc_netlink_main(void) {
+    tc_netlink_fd = tc_netlink_open();
+    if(unlikely(tc_netlink_fd == -1))
+        return 1;
+
+    const char *show = config_get("plugin:tc", "netlink show qdisc or class", "qdisc");
+    tc_netlink_show_classes = !strcmp(show, "class");
+    if(unlikely(!tc_netlink_show_classes && strcmp(show, "qdisc") != 0))
+        error("TC: 'netlink show qdisc or class' can be either 'qdisc' or 'class' but it is set to '%s'. Assuming it is 'qdisc'.", show);
+
+    tc_fireqos_run_dir = config_get("plugin:tc", "fireqos run directory", "/var/run/fireqos");
+
+    long long names_every = config_get_number("plugin:tc", "get class names every", 120);
+    if(names_every < localhost->rrd_update_every) names_every = localhost->rrd_update_every;
+
+    usec_t step = localhost->rrd_update_every * USEC_PER_SEC;
+    usec_t names_every_ut = (usec_t)names_every * USEC_PER_SEC, names_last_ut = 0;
+
+    heartbeat_t hb;
+    heartbeat_init(&hb);
+
+    while(!netdata_exit) {
+        heartbeat_next(&hb, step);
+        if(unlikely(netdata_exit)) break;
+
+        usec_t started_ut = now_monotonic_usec();
+
+        // find the interfaces and refresh the names, like the script does every 2 minutes
+        tc_netlink_fix_names = 0;
+        if(unlikely(!names_last_ut || started_ut - names_last_ut >= names_every_ut)) {
+            if(unlikely(tc_netlink_find_interfaces()))
+                return 1;
+
+            tc_netlink_fix_names = 1;
+            names_last_ut = started_ut;
+        }
+
+        if(unlikely(tc_netlink_collect()))
+            return 1;
+
+        tc_worktime_charts((long long)((now_monotonic_usec() - started_ut) / USEC_PER_MS));
+    }
+
+    return 0;
+}
+
 static pid_t tc_child_pid = 0;
 
 static void tc_main_cleanup(void *ptr) {
@@ -852,14 +1482,14 @@ static void tc_main_cleanup(void *ptr) {
         tc_child_pid = 0;
     }
 
+    tc_netlink_close();
+
     static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
 }
 
 void *tc_main(void *ptr) {
     netdata_thread_cleanup_push(tc_main_cleanup, ptr);
 
-    struct rusage thread;
-
     char command[FILENAME_MAX + 1];
     char *words[PLUGINSD_MAX_WORDS] = { NULL };
 
@@ -882,6 +1512,16 @@ void *tc_main(void *ptr) {
     snprintfz(command, TC_LINE_MAX, "%s/tc-qos-helper.sh", netdata_configured_primary_plugins_dir);
     char *tc_script = config_get("plugin:tc", "script to run to get tc values", command);
 
+    if(config_get_boolean("plugin:tc", "collect with netlink", CONFIG_BOOLEAN_YES)) {
+        if(!tc_netlink_main()) {
+            tc_device_free_all();
+            goto cleanup;
+        }
+
+        error("TC: cannot collect tc values with netlink, falling back to '%s'.", tc_script);
+        tc_netlink_close();
+    }
+
     while(!netdata_exit) {
         FILE *fp;
         struct tc_device *device = NULL;
@@ -1064,60 +1704,7 @@ void *tc_main(void *ptr) {
             }
             else if(unlikely(first_hash == WORKTIME_HASH && strcmp(words[0], "WORKTIME") == 0)) {
                 // debug(D_TC_LOOP, "WORKTIME line '%s' '%s'", words[1], words[2]);
-                getrusage(RUSAGE_THREAD, &thread);
-
-                static RRDSET *stcpu = NULL;
-                static RRDDIM *rd_user = NULL, *rd_system = NULL;
-
-                if(unlikely(!stcpu)) {
-                    stcpu = rrdset_create_localhost(
-                            "netdata"
-                            , "plugin_tc_cpu"
-                            , NULL
-                            , "tc.helper"
-                            , NULL
-                            , "NetData TC CPU usage"
-                            , "milliseconds/s"
-                            , PLUGIN_TC_NAME
-                            , NULL
-                            , NETDATA_CHART_PRIO_NETDATA_TC_CPU
-                            , localhost->rrd_update_every
-                            , RRDSET_TYPE_STACKED
-                    );
-                    rd_user   = rrddim_add(stcpu, "user",  NULL,  1, 1000, RRD_ALGORITHM_INCREMENTAL);
-                    rd_system = rrddim_add(stcpu, "system", NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
-                }
-                else rrdset_next(stcpu);
-
-                rrddim_set_by_pointer(stcpu, rd_user  , thread.ru_utime.tv_sec * 1000000ULL + thread.ru_utime.tv_usec);
-                rrddim_set_by_pointer(stcpu, rd_system, thread.ru_stime.tv_sec * 1000000ULL + thread.ru_stime.tv_usec);
-                rrdset_done(stcpu);
-
-                static RRDSET *sttime = NULL;
-                static RRDDIM *rd_run_time = NULL;
-
-                if(unlikely(!sttime)) {
-                    sttime = rrdset_create_localhost(
-                            "netdata"
-                            , "plugin_tc_time"
-                            , NULL
-                            , "tc.helper"
-                            , NULL
-                            , "NetData TC script execution"
-                            , "milliseconds/run"
-                            , PLUGIN_TC_NAME
-                            , NULL
-                            , NETDATA_CHART_PRIO_NETDATA_TC_TIME
-                            , localhost->rrd_update_every
-                            , RRDSET_TYPE_AREA
-                    );
-                    rd_run_time = rrddim_add(sttime, "run_time",  "run time",  1, 1, RRD_ALGORITHM_ABSOLUTE);
-                }
-                else rrdset_next(sttime);
-
-                rrddim_set_by_pointer(sttime, rd_run_time, str2ll(words[1], NULL));
-                rrdset_done(sttime);
-
+                tc_worktime_charts(str2ll(words[1], NULL));
             }
 #ifdef DETACH_PLUGINS_FROM_NETDATA
             else if(unlikely(first_hash == MYPID_HASH && (strcmp(words[0], "MYPID") == 0))) {
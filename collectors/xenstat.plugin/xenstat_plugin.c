@@ -67,6 +67,10 @@ static int debug = 0;
 
 static int netdata_update_every = 1;
 
+// the networks and the vbds of the domains are the most expensive to
+// enumerate, so they may be collected less frequently than the domains
+static int devices_update_every = 0;
+
 #ifdef HAVE_LIBXENSTAT
 #include <xenstat.h>
 #include <libxl.h>
@@ -182,6 +186,11 @@ static struct node_metrics node_metrics = {
         .domain_root = NULL
 };
 
+// the domains, indexed by their domain id
+// (a domain id is not reused while the domain exists)
+#define XENSTAT_DOMAIN_IDS 32768
+static struct domain_metrics *domains_by_id[XENSTAT_DOMAIN_IDS];
+
 static inline struct domain_metrics *domain_metrics_get(const char *uuid, uint32_t hash) {
     struct domain_metrics *d = NULL, *last = NULL;
     for(d = node_metrics.domain_root; d ; last = d, d = d->next) {
@@ -207,7 +216,7 @@ static inline struct domain_metrics *domain_metrics_get(const char *uuid, uint32
     return d;
 }
 
-static struct domain_metrics *domain_metrics_free(struct domain_metrics *d) {
+static void domain_metrics_free(struct domain_metrics *d) {
     struct domain_metrics *cur = NULL, *last = NULL;
     struct vcpu_metrics *vcpu, *vcpu_f;
     struct vbd_metrics *vbd, *vbd_f;
@@ -221,13 +230,16 @@ static struct domain_metrics *domain_metrics_free(struct domain_metrics *d) {
 
     if(unlikely(!cur)) {
         error("XENSTAT: failed to free domain metrics.");
-        return NULL;
+        return;
     }
 
     if(likely(last))
         last->next = cur->next;
     else
-        node_metrics.domain_root = NULL;
+        node_metrics.domain_root = cur->next;
+
+    if(likely(cur->id < XENSTAT_DOMAIN_IDS && domains_by_id[cur->id] == cur))
+        domains_by_id[cur->id] = NULL;
 
     freez(cur->uuid);
     freez(cur->name);
@@ -254,8 +266,6 @@ static struct domain_metrics *domain_metrics_free(struct domain_metrics *d) {
     }
 
     freez(cur);
-
-    return last ? last : NULL;
 }
 
 static int vcpu_metrics_collect(struct domain_metrics *d, xenstat_domain *domain) {
@@ -396,14 +406,18 @@ static int network_metrics_collect(struct domain_metrics *d, xenstat_domain *dom
     return 0;
 }
 
-static int xenstat_collect(xenstat_handle *xhandle, libxl_ctx *ctx, libxl_dominfo *info) {
+static int xenstat_collect(xenstat_handle *xhandle, libxl_ctx *ctx, libxl_dominfo *info, int devices) {
 
     // mark all old metrics as not-updated
     struct domain_metrics *d;
     for(d = node_metrics.domain_root; d ; d = d->next)
         d->updated = 0;
 
-    xenstat_node *node = xenstat_get_node(xhandle, XENSTAT_ALL);
+    // the xen version is never used
+    unsigned int flags = XENSTAT_VCPU;
+    if(devices) flags |= XENSTAT_NETWORK | XENSTAT_VBD;
+
+    xenstat_node *node = xenstat_get_node(xhandle, flags);
     if (unlikely(!node)) {
         error("XENSTAT: failed to retrieve statistics from libxenstat.");
         return 1;
@@ -423,17 +437,27 @@ static int xenstat_collect(xenstat_handle *xhandle, libxl_ctx *ctx, libxl_dominf
 
         domain = xenstat_node_domain_by_index(node, i);
 
-        // get domain UUID
         unsigned int id = xenstat_domain_id(domain);
-        if(unlikely(libxl_domain_info(ctx, info, id))) {
-            error("XENSTAT: cannot get domain info.");
-        }
-        else {
+        d = (likely(id < XENSTAT_DOMAIN_IDS)) ? domains_by_id[id] : NULL;
+
+        if(unlikely(!d)) {
+            // a new domain id - get domain UUID
+            if(unlikely(libxl_domain_info(ctx, info, id))) {
+                error("XENSTAT: cannot get domain info.");
+                continue;
+            }
             snprintfz(uuid, LIBXL_UUID_FMTLEN, LIBXL_UUID_FMT "\n", LIBXL_UUID_BYTES(info->uuid));
-        }
 
-        uint32_t hash = simple_hash(uuid);
-        d = domain_metrics_get(uuid, hash);
+            uint32_t hash = simple_hash(uuid);
+            d = domain_metrics_get(uuid, hash);
+
+            // a domain gets a new id when it is migrated or restored
+            if(unlikely(d->id != id && d->id < XENSTAT_DOMAIN_IDS && domains_by_id[d->id] == d))
+                domains_by_id[d->id] = NULL;
+
+            if(likely(id < XENSTAT_DOMAIN_IDS))
+                domains_by_id[id] = d;
+        }
 
         d->id = id;
         if(unlikely(!d->name)) {
@@ -459,7 +483,7 @@ static int xenstat_collect(xenstat_handle *xhandle, libxl_ctx *ctx, libxl_dominf
         d->tmem.succ_pers_puts = xenstat_tmem_succ_pers_puts(tmem);
         d->tmem.succ_pers_gets = xenstat_tmem_succ_pers_gets(tmem);
 
-        if(unlikely(vcpu_metrics_collect(d, domain) || vbd_metrics_collect(d, domain) || network_metrics_collect(d, domain))) {
+        if(unlikely(vcpu_metrics_collect(d, domain) || (devices && (vbd_metrics_collect(d, domain) || network_metrics_collect(d, domain))))) {
             xenstat_free_node(node);
             return 1;
         }
@@ -661,7 +685,7 @@ static void print_domain_vbd_oo_chart_definition(char *type, unsigned int vbd, i
                        , vbd
                        , vbd
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_VBD_OO_REQ + vbd
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -674,7 +698,7 @@ static void print_domain_vbd_requests_chart_definition(char *type, unsigned int
                        , vbd
                        , vbd
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_VBD_REQUESTS + vbd
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -688,7 +712,7 @@ static void print_domain_vbd_sectors_chart_definition(char *type, unsigned int v
                        , vbd
                        , vbd
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_VBD_SECTORS + vbd
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -702,7 +726,7 @@ static void print_domain_network_bytes_chart_definition(char *type, unsigned int
                        , network
                        , network
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_NET_BYTES + network
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -716,7 +740,7 @@ static void print_domain_network_packets_chart_definition(char *type, unsigned i
                        , network
                        , network
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_NET_PACKETS + network
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -730,7 +754,7 @@ static void print_domain_network_errors_chart_definition(char *type, unsigned in
                        , network
                        , network
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_NET_PACKETS + network
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -744,7 +768,7 @@ static void print_domain_network_drops_chart_definition(char *type, unsigned int
                        , network
                        , network
                        , NETDATA_CHART_PRIO_XENSTAT_DOMAIN_NET_PACKETS + network
-                       , netdata_update_every
+                       , devices_update_every
                        , obsolete_flag ? "obsolete": "''"
                        , PLUGIN_XENSTAT_NAME
     );
@@ -752,12 +776,14 @@ static void print_domain_network_drops_chart_definition(char *type, unsigned int
     printf("DIMENSION sent '' incremental -1 %d\n", netdata_update_every);
 }
 
-static void xenstat_send_domain_metrics() {
+static void xenstat_send_domain_metrics(int devices) {
 
     if(unlikely(!node_metrics.domain_root)) return;
-    struct domain_metrics *d;
+    struct domain_metrics *d, *next;
+
+    for(d = node_metrics.domain_root; d; d = next) {
+        next = d->next;
 
-    for(d = node_metrics.domain_root; d; d = d->next) {
         char type[TYPE_LENGTH_MAX + 1];
         snprintfz(type, TYPE_LENGTH_MAX, "xendomain_%s_%s", d->name, d->uuid);
 
@@ -873,8 +899,10 @@ static void xenstat_send_domain_metrics() {
 
             // ----------------------------------------------------------------
 
+            // the vbds and the networks are sent when they are collected
+
             struct vbd_metrics *vbd_m;
-            for(vbd_m = d->vbd_root; vbd_m; vbd_m = vbd_m->next) {
+            for(vbd_m = (devices) ? d->vbd_root : NULL; vbd_m; vbd_m = vbd_m->next) {
                 if(likely(vbd_m->updated && !vbd_m->error)) {
                     if(unlikely(!vbd_m->oo_req_chart_generated)) {
                         print_domain_vbd_oo_chart_definition(type, vbd_m->id, CHART_IS_NOT_OBSOLETE);
@@ -941,7 +969,7 @@ static void xenstat_send_domain_metrics() {
             // ----------------------------------------------------------------
 
             struct network_metrics *network_m;
-            for(network_m = d->network_root; network_m; network_m = network_m->next) {
+            for(network_m = (devices) ? d->network_root : NULL; network_m; network_m = network_m->next) {
                 if(likely(network_m->updated)) {
                     if(unlikely(!network_m->bytes_chart_generated)) {
                         print_domain_network_bytes_chart_definition(type, network_m->id, CHART_IS_NOT_OBSOLETE);
@@ -1035,7 +1063,7 @@ static void xenstat_send_domain_metrics() {
             print_domain_tmem_pages_chart_definition(type, CHART_IS_OBSOLETE);
             print_domain_tmem_operations_chart_definition(type, CHART_IS_OBSOLETE);
 
-            d = domain_metrics_free(d);
+            domain_metrics_free(d);
         }
     }
 }
@@ -1074,6 +1102,10 @@ int main(int argc, char **argv) {
             debug = 1;
             continue;
         }
+        else if(strcmp("devices-every", argv[i]) == 0 && i + 1 < argc) {
+            devices_update_every = str2i(argv[++i]);
+            continue;
+        }
         else if(strcmp("-h", argv[i]) == 0 || strcmp("--help", argv[i]) == 0) {
             fprintf(stderr,
                     "\n"
@@ -1092,6 +1124,10 @@ int main(int argc, char **argv) {
                     "  debug                   enable verbose output\n"
                     "                          default: disabled\n"
                     "\n"
+                    "  devices-every SECONDS   collect the networks and the vbds of the\n"
+                    "                          domains every SECONDS\n"
+                    "                          default: the data collection frequency\n"
+                    "\n"
                     "  -v\n"
                     "  -V\n"
                     "  --version               print version and exit\n"
@@ -1118,6 +1154,12 @@ int main(int argc, char **argv) {
     else if(freq)
         error("update frequency %d seconds is too small for XENSTAT. Using %d.", freq, netdata_update_every);
 
+    // a multiple of the data collection frequency
+    if(devices_update_every < netdata_update_every)
+        devices_update_every = netdata_update_every;
+    devices_update_every -= devices_update_every % netdata_update_every;
+    size_t devices_iterations = (size_t)(devices_update_every / netdata_update_every);
+
     // ------------------------------------------------------------------------
     // initialize xen API handles
     xenstat_handle *xhandle = NULL;
@@ -1160,13 +1202,14 @@ int main(int argc, char **argv) {
 
         if(likely(xhandle)) {
             if(unlikely(debug)) fprintf(stderr, "xenstat.plugin: calling xenstat_collect()\n");
-            int ret = xenstat_collect(xhandle, ctx, &info);
+            int devices = (iteration % devices_iterations == 0);
+            int ret = xenstat_collect(xhandle, ctx, &info, devices);
 
             if(likely(!ret)) {
                 if(unlikely(debug)) fprintf(stderr, "xenstat.plugin: calling xenstat_send_node_metrics()\n");
                 xenstat_send_node_metrics();
                 if(unlikely(debug)) fprintf(stderr, "xenstat.plugin: calling xenstat_send_domain_metrics()\n");
-                xenstat_send_domain_metrics();
+                xenstat_send_domain_metrics(devices);
             }
             else {
                 if(unlikely(debug)) fprintf(stderr, "xenstat.plugin: can't collect data\n");
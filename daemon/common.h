@@ -15,6 +15,7 @@
 #define config_get_boolean(section, name, value) appconfig_get_boolean(&netdata_config, section, name, value)
 #define config_get_boolean_ondemand(section, name, value) appconfig_get_boolean_ondemand(&netdata_config, section, name, value)
 #define config_get_duration(section, name, value) appconfig_get_duration(&netdata_config, section, name, value)
+#define config_get_handle(section, name, default_value) appconfig_get_handle(&netdata_config, section, name, default_value)
 
 #define config_set(section, name, default_value) appconfig_set(&netdata_config, section, name, default_value)
 #define config_set_default(section, name, value) appconfig_set_default(&netdata_config, section, name, value)
@@ -23,6 +24,7 @@
 #define config_set_boolean(section, name, value) appconfig_set_boolean(&netdata_config, section, name, value)
 
 #define config_exists(section, name) appconfig_exists(&netdata_config, section, name)
+#define config_freeze() appconfig_freeze(&netdata_config)
 #define config_move(section_old, name_old, section_new, name_new) appconfig_move(&netdata_config, section_old, name_old, section_new, name_new)
 
 #define config_generate(buffer, only_changed) appconfig_generate(&netdata_config, buffer, only_changed)
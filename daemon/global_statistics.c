@@ -4,8 +4,26 @@
 
 #define GLOBAL_STATS_RESET_WEB_USEC_MAX 0x01
 
+// the upper limits (in usec) of the buckets of the API latency histograms
+// the last bucket has all the requests that took longer
+static uint64_t api_latency_limits[GLOBAL_STATS_API_LATENCY_BUCKETS - 1] = {
+        1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000
+};
+
+static const char *api_latency_buckets[GLOBAL_STATS_API_LATENCY_BUCKETS] = {
+        "1ms", "5ms", "10ms", "50ms", "100ms", "500ms", "1s", "5s", "more"
+};
 
-static struct global_statistics {
+static const char *api_endpoint_names[GLOBAL_STATS_API_ENDPOINTS] = {
+        [GLOBAL_STATS_API_NONE]       = NULL,
+        [GLOBAL_STATS_API_DATA]       = "data",
+        [GLOBAL_STATS_API_CHARTS]     = "charts",
+        [GLOBAL_STATS_API_ALLMETRICS] = "allmetrics",
+        [GLOBAL_STATS_API_BADGE]      = "badge",
+        [GLOBAL_STATS_API_OTHER]      = "other",
+};
+
+struct global_statistics {
     volatile uint16_t connected_clients;
 
     volatile uint64_t web_requests;
@@ -21,22 +39,65 @@ static struct global_statistics {
     volatile uint64_t rrdr_queries_made;
     volatile uint64_t rrdr_db_points_read;
     volatile uint64_t rrdr_result_points_generated;
-} global_statistics = {
+
+    volatile uint64_t rrdset_done_calls;
+    volatile uint64_t rrdset_done_usec;
+
+    volatile uint64_t api_latency[GLOBAL_STATS_API_ENDPOINTS][GLOBAL_STATS_API_LATENCY_BUCKETS];
+    volatile uint64_t web_phase_latency[WEB_CLIENT_PHASES][GLOBAL_STATS_API_LATENCY_BUCKETS];
+    volatile uint64_t api_rejected[GLOBAL_STATS_API_ENDPOINTS];
+    volatile uint32_t api_in_flight[GLOBAL_STATS_API_ENDPOINTS]; // only in global_statistics, not in the slots
+} __attribute__((aligned(64)));
+
+// the clients are counted here - once per connection
+static struct global_statistics global_statistics = {
         .connected_clients = 0,
-        .web_requests = 0,
-        .web_usec = 0,
-        .bytes_received = 0,
-        .bytes_sent = 0,
-        .content_size = 0,
-        .compressed_content_size = 0,
         .web_client_count = 1,
-
-        .rrdr_queries_made = 0,
-        .rrdr_db_points_read = 0,
-        .rrdr_result_points_generated = 0,
 };
 
+// ----------------------------------------------------------------------------
+// per thread statistics slots
+//
+// The counters updated for every web request and every query are kept in one
+// slot per thread, each on its own cache lines, so that the web and the query
+// threads do not bounce a shared cache line between the cpus, and do not need
+// locked instructions: only the owner of a slot writes to it, so it stores its
+// counters with relaxed atomics. global_statistics_copy() sums the slots.
+//
+// The slots are never released (the counters they have are still needed when
+// their threads exit). When all the slots are taken, the threads share slot 0,
+// and they update it with (relaxed) atomic additions.
+
+#if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+#define GLOBAL_STATS_SLOTS 128
+#else
+#define GLOBAL_STATS_SLOTS 1
+#endif
+
+static struct global_statistics global_statistics_slots[GLOBAL_STATS_SLOTS];
+static size_t global_statistics_slots_used = 1;
+
 #if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+static __thread struct global_statistics *global_statistics_my_slot = NULL;
+
+static inline struct global_statistics *global_statistics_slot(void) {
+    if(unlikely(!global_statistics_my_slot)) {
+        size_t slot = __atomic_fetch_add(&global_statistics_slots_used, 1, __ATOMIC_RELAXED);
+        global_statistics_my_slot = &global_statistics_slots[(slot < GLOBAL_STATS_SLOTS) ? slot : 0];
+    }
+
+    return global_statistics_my_slot;
+}
+
+#define global_statistics_slot_add(gs, member, value) do { \
+        if(likely((gs) != &global_statistics_slots[0])) \
+            __atomic_store_n(&(gs)->member, (gs)->member + (value), __ATOMIC_RELAXED); \
+        else \
+            __atomic_fetch_add(&(gs)->member, (value), __ATOMIC_RELAXED); \
+    } while(0)
+
+#define global_statistics_slot_read(gs, member) __atomic_load_n(&(gs)->member, __ATOMIC_RELAXED)
+
 #else
 netdata_mutex_t global_statistics_mutex = NETDATA_MUTEX_INITIALIZER;
 
@@ -47,64 +108,180 @@ static inline void global_statistics_lock(void) {
 static inline void global_statistics_unlock(void) {
     netdata_mutex_unlock(&global_statistics_mutex);
 }
+
+static inline struct global_statistics *global_statistics_slot(void) {
+    return &global_statistics_slots[0];
+}
+
+#define global_statistics_slot_add(gs, member, value) (gs)->member += (value)
+#define global_statistics_slot_read(gs, member) (gs)->member
 #endif
 
+static inline size_t api_latency_bucket(uint64_t dt) {
+    size_t i;
+    for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS - 1 && dt > api_latency_limits[i] ; i++) ;
+    return i;
+}
 
-void rrdr_query_completed(uint64_t db_points_read, uint64_t result_points_generated) {
-#if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
-    __atomic_fetch_add(&global_statistics.rrdr_queries_made, 1, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.rrdr_db_points_read, db_points_read, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.rrdr_result_points_generated, result_points_generated, __ATOMIC_SEQ_CST);
-#else
+// the time the queries of this thread have taken, so that the web clients can tell
+// the time their requests spent in the queries
+static __thread uint64_t rrdr_thread_query_usec = 0;
+
+uint64_t rrdr_query_usec_of_this_thread(void) {
+    return rrdr_thread_query_usec;
+}
+
+void rrdr_query_completed(uint64_t db_points_read, uint64_t result_points_generated, uint64_t dt) {
+    rrdr_thread_query_usec += dt;
+
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
     #warning NOT using atomic operations - using locks for global statistics
     if (web_server_is_multithreaded)
         global_statistics_lock();
+#endif
 
-    global_statistics.rrdr_queries_made++;
-    global_statistics.rrdr_db_points_read += db_points_read;
-    global_statistics.rrdr_result_points_generated += result_points_generated;
+    struct global_statistics *gs = global_statistics_slot();
+    global_statistics_slot_add(gs, rrdr_queries_made, 1);
+    global_statistics_slot_add(gs, rrdr_db_points_read, db_points_read);
+    global_statistics_slot_add(gs, rrdr_result_points_generated, result_points_generated);
 
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
     if (web_server_is_multithreaded)
         global_statistics_unlock();
 #endif
 }
 
-void finished_web_request_statistics(uint64_t dt,
+void rrdset_done_completed(uint64_t dt) {
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+    global_statistics_lock();
+#endif
+
+    struct global_statistics *gs = global_statistics_slot();
+    global_statistics_slot_add(gs, rrdset_done_calls, 1);
+    global_statistics_slot_add(gs, rrdset_done_usec, dt);
+
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+    global_statistics_unlock();
+#endif
+}
+
+void finished_web_request_statistics(GLOBAL_STATS_API_ENDPOINT endpoint,
+                                     uint64_t dt,
                                      uint64_t bytes_received,
                                      uint64_t bytes_sent,
                                      uint64_t content_size,
-                                     uint64_t compressed_content_size) {
+                                     uint64_t compressed_content_size,
+                                     const usec_t *phases_dt) {
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+    if (web_server_is_multithreaded)
+        global_statistics_lock();
+#endif
+
+    struct global_statistics *gs = global_statistics_slot();
+
 #if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
-    uint64_t old_web_usec_max = global_statistics.web_usec_max;
+    // the reset of global_statistics_copy() may race with us
+    uint64_t old_web_usec_max = __atomic_load_n(&gs->web_usec_max, __ATOMIC_RELAXED);
     while(dt > old_web_usec_max)
-        __atomic_compare_exchange(&global_statistics.web_usec_max, &old_web_usec_max, &dt, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
-
-    __atomic_fetch_add(&global_statistics.web_requests, 1, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.web_usec, dt, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.bytes_received, bytes_received, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.bytes_sent, bytes_sent, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.content_size, content_size, __ATOMIC_SEQ_CST);
-    __atomic_fetch_add(&global_statistics.compressed_content_size, compressed_content_size, __ATOMIC_SEQ_CST);
+        __atomic_compare_exchange(&gs->web_usec_max, &old_web_usec_max, &dt, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#else
+    if (dt > gs->web_usec_max)
+        gs->web_usec_max = dt;
+#endif
+
+    global_statistics_slot_add(gs, web_requests, 1);
+    global_statistics_slot_add(gs, web_usec, dt);
+    global_statistics_slot_add(gs, bytes_received, bytes_received);
+    global_statistics_slot_add(gs, bytes_sent, bytes_sent);
+    global_statistics_slot_add(gs, content_size, content_size);
+    global_statistics_slot_add(gs, compressed_content_size, compressed_content_size);
+
+    if(endpoint != GLOBAL_STATS_API_NONE && endpoint < GLOBAL_STATS_API_ENDPOINTS)
+        global_statistics_slot_add(gs, api_latency[endpoint][api_latency_bucket(dt)], 1);
+
+    if(phases_dt) {
+        int p;
+        for(p = 0; p < WEB_CLIENT_PHASES ; p++)
+            global_statistics_slot_add(gs, web_phase_latency[p][api_latency_bucket(phases_dt[p])], 1);
+    }
+
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+    if (web_server_is_multithreaded)
+        global_statistics_unlock();
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// admission control of the API requests
+//
+// The web server threads serve their requests one by one, so a few expensive
+// requests can keep all of them busy while cheap ones, like the health checks of
+// load balancers, wait. A request of an endpoint that has max_in_flight requests
+// running already is not admitted, so that it can be rejected at once instead.
+// max_in_flight 0 means no limit. The admitted requests have to be completed
+// with web_request_completed().
+
+int web_request_admitted(GLOBAL_STATS_API_ENDPOINT endpoint, uint32_t max_in_flight) {
+#if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+    uint32_t in_flight = __atomic_add_fetch(&global_statistics.api_in_flight[endpoint], 1, __ATOMIC_RELAXED);
+    if(likely(!max_in_flight || in_flight <= max_in_flight))
+        return 1;
+
+    __atomic_sub_fetch(&global_statistics.api_in_flight[endpoint], 1, __ATOMIC_RELAXED);
+
+    struct global_statistics *gs = global_statistics_slot();
+    global_statistics_slot_add(gs, api_rejected[endpoint], 1);
+    return 0;
 #else
-#warning NOT using atomic operations - using locks for global statistics
+    int admitted = 0;
+
     if (web_server_is_multithreaded)
         global_statistics_lock();
 
-    if (dt > global_statistics.web_usec_max)
-        global_statistics.web_usec_max = dt;
+    if(!max_in_flight || global_statistics.api_in_flight[endpoint] < max_in_flight) {
+        global_statistics.api_in_flight[endpoint]++;
+        admitted = 1;
+    }
+    else
+        global_statistics_slots[0].api_rejected[endpoint]++;
+
+    if (web_server_is_multithreaded)
+        global_statistics_unlock();
+
+    return admitted;
+#endif
+}
+
+void web_request_completed(GLOBAL_STATS_API_ENDPOINT endpoint) {
+#if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+    __atomic_sub_fetch(&global_statistics.api_in_flight[endpoint], 1, __ATOMIC_RELAXED);
+#else
+    if (web_server_is_multithreaded)
+        global_statistics_lock();
 
-    global_statistics.web_requests++;
-    global_statistics.web_usec += dt;
-    global_statistics.bytes_received += bytes_received;
-    global_statistics.bytes_sent += bytes_sent;
-    global_statistics.content_size += content_size;
-    global_statistics.compressed_content_size += compressed_content_size;
+    global_statistics.api_in_flight[endpoint]--;
 
     if (web_server_is_multithreaded)
         global_statistics_unlock();
 #endif
 }
 
+// the API requests running now, of all the endpoints
+uint32_t web_requests_in_flight(void) {
+    uint32_t in_flight = 0;
+    int e;
+
+    for(e = 0; e < GLOBAL_STATS_API_ENDPOINTS ; e++) {
+#if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+        in_flight += __atomic_load_n(&global_statistics.api_in_flight[e], __ATOMIC_RELAXED);
+#else
+        in_flight += global_statistics.api_in_flight[e];
+#endif
+    }
+
+    return in_flight;
+}
+
 uint64_t web_client_connected(void) {
 #if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
     __atomic_fetch_add(&global_statistics.connected_clients, 1, __ATOMIC_SEQ_CST);
@@ -139,34 +316,76 @@ void web_client_disconnected(void) {
 
 
 static inline void global_statistics_copy(struct global_statistics *gs, uint8_t options) {
+    size_t slot, slots, e, b;
+
+    memset(gs, 0, sizeof(struct global_statistics));
+
 #if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
-    gs->connected_clients            = __atomic_fetch_add(&global_statistics.connected_clients, 0, __ATOMIC_SEQ_CST);
-    gs->web_requests                 = __atomic_fetch_add(&global_statistics.web_requests, 0, __ATOMIC_SEQ_CST);
-    gs->web_usec                     = __atomic_fetch_add(&global_statistics.web_usec, 0, __ATOMIC_SEQ_CST);
-    gs->web_usec_max                 = __atomic_fetch_add(&global_statistics.web_usec_max, 0, __ATOMIC_SEQ_CST);
-    gs->bytes_received               = __atomic_fetch_add(&global_statistics.bytes_received, 0, __ATOMIC_SEQ_CST);
-    gs->bytes_sent                   = __atomic_fetch_add(&global_statistics.bytes_sent, 0, __ATOMIC_SEQ_CST);
-    gs->content_size                 = __atomic_fetch_add(&global_statistics.content_size, 0, __ATOMIC_SEQ_CST);
-    gs->compressed_content_size      = __atomic_fetch_add(&global_statistics.compressed_content_size, 0, __ATOMIC_SEQ_CST);
-    gs->web_client_count             = __atomic_fetch_add(&global_statistics.web_client_count, 0, __ATOMIC_SEQ_CST);
-
-    gs->rrdr_queries_made            = __atomic_fetch_add(&global_statistics.rrdr_queries_made, 0, __ATOMIC_SEQ_CST);
-    gs->rrdr_db_points_read          = __atomic_fetch_add(&global_statistics.rrdr_db_points_read, 0, __ATOMIC_SEQ_CST);
-    gs->rrdr_result_points_generated = __atomic_fetch_add(&global_statistics.rrdr_result_points_generated, 0, __ATOMIC_SEQ_CST);
-
-    if(options & GLOBAL_STATS_RESET_WEB_USEC_MAX) {
-        uint64_t n = 0;
-        __atomic_compare_exchange(&global_statistics.web_usec_max, &gs->web_usec_max, &n, 1, __ATOMIC_SEQ_CST,
-                                  __ATOMIC_SEQ_CST);
-    }
+    gs->connected_clients            = __atomic_load_n(&global_statistics.connected_clients, __ATOMIC_SEQ_CST);
+    gs->web_client_count             = __atomic_load_n(&global_statistics.web_client_count, __ATOMIC_SEQ_CST);
+
+    for(e = 0; e < GLOBAL_STATS_API_ENDPOINTS ; e++)
+        gs->api_in_flight[e]         = __atomic_load_n(&global_statistics.api_in_flight[e], __ATOMIC_RELAXED);
+
+    slots = __atomic_load_n(&global_statistics_slots_used, __ATOMIC_RELAXED);
+    if(slots > GLOBAL_STATS_SLOTS) slots = GLOBAL_STATS_SLOTS;
 #else
     global_statistics_lock();
 
-    memcpy(gs, (const void *)&global_statistics, sizeof(struct global_statistics));
+    gs->connected_clients            = global_statistics.connected_clients;
+    gs->web_client_count             = global_statistics.web_client_count;
+
+    for(e = 0; e < GLOBAL_STATS_API_ENDPOINTS ; e++)
+        gs->api_in_flight[e]         = global_statistics.api_in_flight[e];
+
+    slots = 1;
+#endif
+
+    for(slot = 0; slot < slots ; slot++) {
+        struct global_statistics *s = &global_statistics_slots[slot];
+
+        gs->web_requests                 += global_statistics_slot_read(s, web_requests);
+        gs->web_usec                     += global_statistics_slot_read(s, web_usec);
+        gs->bytes_received               += global_statistics_slot_read(s, bytes_received);
+        gs->bytes_sent                   += global_statistics_slot_read(s, bytes_sent);
+        gs->content_size                 += global_statistics_slot_read(s, content_size);
+        gs->compressed_content_size      += global_statistics_slot_read(s, compressed_content_size);
+
+        gs->rrdr_queries_made            += global_statistics_slot_read(s, rrdr_queries_made);
+        gs->rrdr_db_points_read          += global_statistics_slot_read(s, rrdr_db_points_read);
+        gs->rrdr_result_points_generated += global_statistics_slot_read(s, rrdr_result_points_generated);
+
+        gs->rrdset_done_calls            += global_statistics_slot_read(s, rrdset_done_calls);
+        gs->rrdset_done_usec             += global_statistics_slot_read(s, rrdset_done_usec);
 
-    if (options & GLOBAL_STATS_RESET_WEB_USEC_MAX)
-        global_statistics.web_usec_max = 0;
+        for(e = 0; e < GLOBAL_STATS_API_ENDPOINTS ; e++) {
+            for(b = 0; b < GLOBAL_STATS_API_LATENCY_BUCKETS ; b++)
+                gs->api_latency[e][b] += global_statistics_slot_read(s, api_latency[e][b]);
 
+            gs->api_rejected[e] += global_statistics_slot_read(s, api_rejected[e]);
+        }
+
+        for(e = 0; e < WEB_CLIENT_PHASES ; e++) {
+            for(b = 0; b < GLOBAL_STATS_API_LATENCY_BUCKETS ; b++)
+                gs->web_phase_latency[e][b] += global_statistics_slot_read(s, web_phase_latency[e][b]);
+        }
+
+        uint64_t web_usec_max;
+#if defined(HAVE_C___ATOMIC) && !defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
+        if(options & GLOBAL_STATS_RESET_WEB_USEC_MAX)
+            web_usec_max = __atomic_exchange_n(&s->web_usec_max, 0, __ATOMIC_RELAXED);
+        else
+            web_usec_max = __atomic_load_n(&s->web_usec_max, __ATOMIC_RELAXED);
+#else
+        web_usec_max = s->web_usec_max;
+        if(options & GLOBAL_STATS_RESET_WEB_USEC_MAX)
+            s->web_usec_max = 0;
+#endif
+        if(web_usec_max > gs->web_usec_max)
+            gs->web_usec_max = web_usec_max;
+    }
+
+#if !defined(HAVE_C___ATOMIC) || defined(NETDATA_NO_ATOMIC_INSTRUCTIONS)
     global_statistics_unlock();
 #endif
 }
@@ -182,6 +401,7 @@ void global_statistics_charts(void) {
 
     struct global_statistics gs;
     struct rusage me, thread;
+    int i;
 
     global_statistics_copy(&gs, GLOBAL_STATS_RESET_WEB_USEC_MAX);
     getrusage(RUSAGE_THREAD, &thread);
@@ -304,6 +524,56 @@ void global_statistics_charts(void) {
 
     // ----------------------------------------------------------------
 
+    {
+        static RRDSET *st_thread_connections = NULL;
+        static RRDDIM **rd_thread_connections = NULL;
+        static size_t *thread_connections = NULL;
+        static size_t threads = 0;
+
+        if (unlikely(!st_thread_connections)) {
+            threads = web_server_threads_connections(NULL, 0);
+            if (threads) {
+                st_thread_connections = rrdset_create_localhost(
+                        "netdata"
+                        , "web_thread_connections"
+                        , NULL
+                        , "netdata"
+                        , NULL
+                        , "NetData Web Server Connections Per Thread"
+                        , "connections/s"
+                        , "netdata"
+                        , "stats"
+                        , 130250
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                rd_thread_connections = callocz(threads, sizeof(RRDDIM *));
+                thread_connections = callocz(threads, sizeof(size_t));
+
+                size_t i;
+                for (i = 0; i < threads; i++) {
+                    char id[50 + 1];
+                    snprintfz(id, 50, "thread%zu", i + 1);
+                    rd_thread_connections[i] = rrddim_add(st_thread_connections, id, NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+                }
+            }
+        }
+        else
+            rrdset_next(st_thread_connections);
+
+        if (likely(st_thread_connections)) {
+            web_server_threads_connections(thread_connections, threads);
+
+            size_t i;
+            for (i = 0; i < threads; i++)
+                rrddim_set_by_pointer(st_thread_connections, rd_thread_connections[i], (collected_number) thread_connections[i]);
+            rrdset_done(st_thread_connections);
+        }
+    }
+
+    // ----------------------------------------------------------------
+
     {
         static RRDSET *st_reqs = NULL;
         static RRDDIM *rd_requests = NULL;
@@ -419,6 +689,155 @@ void global_statistics_charts(void) {
 
     // ----------------------------------------------------------------
 
+    {
+        static RRDSET *st_api_latency[GLOBAL_STATS_API_ENDPOINTS];
+        static RRDDIM *rd_api_latency[GLOBAL_STATS_API_ENDPOINTS][GLOBAL_STATS_API_LATENCY_BUCKETS];
+        int e;
+
+        for(e = GLOBAL_STATS_API_NONE + 1; e < GLOBAL_STATS_API_ENDPOINTS ; e++) {
+            // the chart of an endpoint is added when it gets its first request
+            if (unlikely(!st_api_latency[e])) {
+                uint64_t requests = 0;
+                for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS ; i++)
+                    requests += gs.api_latency[e][i];
+
+                if(!requests) continue;
+
+                char id[RRD_ID_LENGTH_MAX + 1], title[100 + 1];
+                snprintfz(id, RRD_ID_LENGTH_MAX, "api_latency_%s", api_endpoint_names[e]);
+                snprintfz(title, 100, "NetData API /api/v1/%s Response Time", api_endpoint_names[e]);
+
+                st_api_latency[e] = rrdset_create_localhost(
+                        "netdata"
+                        , id
+                        , NULL
+                        , "netdata"
+                        , NULL
+                        , title
+                        , "requests/s"
+                        , "netdata"
+                        , "stats"
+                        , 130400 + e
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS ; i++)
+                    rd_api_latency[e][i] = rrddim_add(st_api_latency[e], api_latency_buckets[i], NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_api_latency[e]);
+
+            for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS ; i++)
+                rrddim_set_by_pointer(st_api_latency[e], rd_api_latency[e][i], (collected_number)gs.api_latency[e][i]);
+            rrdset_done(st_api_latency[e]);
+        }
+    }
+
+    // ----------------------------------------------------------------
+
+    {
+        static RRDSET *st_api_in_flight = NULL, *st_api_rejected = NULL;
+        static RRDDIM *rd_api_in_flight[GLOBAL_STATS_API_ENDPOINTS], *rd_api_rejected[GLOBAL_STATS_API_ENDPOINTS];
+        int e;
+
+        if (unlikely(!st_api_in_flight)) {
+            st_api_in_flight = rrdset_create_localhost(
+                    "netdata"
+                    , "api_in_flight"
+                    , NULL
+                    , "netdata"
+                    , NULL
+                    , "NetData API Requests Running"
+                    , "requests"
+                    , "netdata"
+                    , "stats"
+                    , 130450
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_STACKED
+            );
+
+            st_api_rejected = rrdset_create_localhost(
+                    "netdata"
+                    , "api_rejected"
+                    , NULL
+                    , "netdata"
+                    , NULL
+                    , "NetData API Requests Rejected by Admission Control"
+                    , "requests/s"
+                    , "netdata"
+                    , "stats"
+                    , 130451
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_STACKED
+            );
+
+            for(e = GLOBAL_STATS_API_NONE + 1; e < GLOBAL_STATS_API_ENDPOINTS ; e++) {
+                rd_api_in_flight[e] = rrddim_add(st_api_in_flight, api_endpoint_names[e], NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                rd_api_rejected[e] = rrddim_add(st_api_rejected, api_endpoint_names[e], NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+        }
+        else {
+            rrdset_next(st_api_in_flight);
+            rrdset_next(st_api_rejected);
+        }
+
+        for(e = GLOBAL_STATS_API_NONE + 1; e < GLOBAL_STATS_API_ENDPOINTS ; e++) {
+            rrddim_set_by_pointer(st_api_in_flight, rd_api_in_flight[e], (collected_number)gs.api_in_flight[e]);
+            rrddim_set_by_pointer(st_api_rejected, rd_api_rejected[e], (collected_number)gs.api_rejected[e]);
+        }
+        rrdset_done(st_api_in_flight);
+        rrdset_done(st_api_rejected);
+    }
+
+    // ----------------------------------------------------------------
+
+    {
+        static RRDSET *st_web_phase[WEB_CLIENT_PHASES];
+        static RRDDIM *rd_web_phase[WEB_CLIENT_PHASES][GLOBAL_STATS_API_LATENCY_BUCKETS];
+        int p;
+
+        for(p = 0; p < WEB_CLIENT_PHASES ; p++) {
+            if (unlikely(!st_web_phase[p])) {
+                uint64_t requests = 0;
+                for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS ; i++)
+                    requests += gs.web_phase_latency[p][i];
+
+                if(!requests) continue;
+
+                char id[RRD_ID_LENGTH_MAX + 1], title[100 + 1];
+                snprintfz(id, RRD_ID_LENGTH_MAX, "web_phase_%s", web_client_phase_names[p]);
+                snprintfz(title, 100, "NetData Web Requests Time to %s", web_client_phase_titles[p]);
+
+                st_web_phase[p] = rrdset_create_localhost(
+                        "netdata"
+                        , id
+                        , NULL
+                        , "netdata"
+                        , NULL
+                        , title
+                        , "requests/s"
+                        , "netdata"
+                        , "stats"
+                        , 130460 + p
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS ; i++)
+                    rd_web_phase[p][i] = rrddim_add(st_web_phase[p], api_latency_buckets[i], NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_web_phase[p]);
+
+            for(i = 0; i < GLOBAL_STATS_API_LATENCY_BUCKETS ; i++)
+                rrddim_set_by_pointer(st_web_phase[p], rd_web_phase[p][i], (collected_number)gs.web_phase_latency[p][i]);
+            rrdset_done(st_web_phase[p]);
+        }
+    }
+
+    // ----------------------------------------------------------------
+
     {
         static RRDSET *st_compression = NULL;
         static RRDDIM *rd_savings = NULL;
@@ -533,12 +952,235 @@ void global_statistics_charts(void) {
 
     // ----------------------------------------------------------------
 
+    {
+        static RRDSET *st_collection_time = NULL, *st_collection_charts = NULL;
+        static RRDDIM *rd_collection_time = NULL, *rd_collection_charts = NULL;
+
+        if (unlikely(!st_collection_time)) {
+            st_collection_time = rrdset_create_localhost(
+                    "netdata"
+                    , "collection_time"
+                    , NULL
+                    , "collection"
+                    , NULL
+                    , "NetData Time to Store, Stream and Check the Collected Values (see /api/v1/costly_charts)"
+                    , "milliseconds/s"
+                    , "netdata"
+                    , "stats"
+                    , 130530
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_AREA
+            );
+
+            rd_collection_time = rrddim_add(st_collection_time, "rrdset_done", NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
+
+            st_collection_charts = rrdset_create_localhost(
+                    "netdata"
+                    , "collection_charts"
+                    , NULL
+                    , "collection"
+                    , NULL
+                    , "NetData Collected Values Stored"
+                    , "charts/s"
+                    , "netdata"
+                    , "stats"
+                    , 130531
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            rd_collection_charts = rrddim_add(st_collection_charts, "rrdset_done", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+        }
+        else {
+            rrdset_next(st_collection_time);
+            rrdset_next(st_collection_charts);
+        }
+
+        rrddim_set_by_pointer(st_collection_time, rd_collection_time, (collected_number)gs.rrdset_done_usec);
+        rrddim_set_by_pointer(st_collection_charts, rd_collection_charts, (collected_number)gs.rrdset_done_calls);
+
+        rrdset_done(st_collection_time);
+        rrdset_done(st_collection_charts);
+    }
+
+    // ----------------------------------------------------------------
+
+    {
+        static RRDSET *st_memory = NULL;
+
+        if (unlikely(!st_memory)) {
+            st_memory = rrdset_create_localhost(
+                    "netdata"
+                    , "memory"
+                    , NULL
+                    , "memory"
+                    , NULL
+                    , "NetData Charts and Dimensions Memory"
+                    , "KiB"
+                    , "netdata"
+                    , "stats"
+                    , 130502
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_STACKED
+            );
+        }
+        else
+            rrdset_next(st_memory);
+
+        // one dimension per host
+        RRDHOST *host;
+        rrd_rdlock();
+        rrdhost_foreach_read(host) {
+            RRDDIM *rd = rrddim_find(st_memory, host->hostname);
+            if(unlikely(!rd))
+                rd = rrddim_add(st_memory, host->hostname, NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
+
+            rrddim_set_by_pointer(st_memory, rd, (collected_number)__atomic_load_n(&host->rrd_memory, __ATOMIC_RELAXED));
+        }
+        rrd_unlock();
+
+        rrdset_done(st_memory);
+    }
+
+    // ----------------------------------------------------------------
+
+    {
+        static RRDSET *st_shed = NULL,
+                      *st_throttled = NULL;
+
+        // one dimension per host with limits in stream.conf
+        RRDHOST *host;
+        rrd_rdlock();
+        rrdhost_foreach_read(host) {
+            if(likely(!host->rrdpush_receiver_limited))
+                continue;
+
+            if (unlikely(!st_shed)) {
+                st_shed = rrdset_create_localhost(
+                        "netdata"
+                        , "streaming_shed"
+                        , NULL
+                        , "streaming"
+                        , NULL
+                        , "NetData Streaming Charts and Dimensions Shed, over the limits of the hosts"
+                        , "definitions"
+                        , "netdata"
+                        , "stats"
+                        , 130550
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                st_throttled = rrdset_create_localhost(
+                        "netdata"
+                        , "streaming_throttled"
+                        , NULL
+                        , "streaming"
+                        , NULL
+                        , "NetData Streaming Time Not Reading, over the points per second of the hosts"
+                        , "percentage"
+                        , "netdata"
+                        , "stats"
+                        , 130551
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+            }
+
+            RRDDIM *rd = rrddim_find(st_shed, host->hostname);
+            if(unlikely(!rd))
+                rd = rrddim_add(st_shed, host->hostname, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+            rrddim_set_by_pointer(st_shed, rd, (collected_number)__atomic_load_n(&host->rrdpush_receiver_shed, __ATOMIC_RELAXED));
+
+            rd = rrddim_find(st_throttled, host->hostname);
+            if(unlikely(!rd))
+                rd = rrddim_add(st_throttled, host->hostname, NULL, 1, 10000, RRD_ALGORITHM_INCREMENTAL);
+            rrddim_set_by_pointer(st_throttled, rd, (collected_number)__atomic_load_n(&host->rrdpush_receiver_throttled_ut, __ATOMIC_RELAXED));
+        }
+        rrd_unlock();
+
+        if(st_shed) {
+            if(st_shed->counter_done) {
+                rrdset_next(st_shed);
+                rrdset_next(st_throttled);
+            }
+
+            rrdset_done(st_shed);
+            rrdset_done(st_throttled);
+        }
+    }
+
+    // ----------------------------------------------------------------
+
+    {
+        static RRDSET *st_heartbeat_latency = NULL,
+                      *st_heartbeat_overruns = NULL;
+
+        struct heartbeat_statistics hs[HEARTBEAT_STATISTICS_MAX];
+        size_t jobs = heartbeat_statistics_copy(hs, HEARTBEAT_STATISTICS_MAX);
+
+        if (unlikely(!st_heartbeat_latency)) {
+            st_heartbeat_latency = rrdset_create_localhost(
+                    "netdata"
+                    , "heartbeat_latency"
+                    , NULL
+                    , "heartbeat"
+                    , NULL
+                    , "NetData Jobs Maximum Wake-up Latency"
+                    , "milliseconds"
+                    , "netdata"
+                    , "stats"
+                    , 130520
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_LINE
+            );
+
+            st_heartbeat_overruns = rrdset_create_localhost(
+                    "netdata"
+                    , "heartbeat_overruns"
+                    , NULL
+                    , "heartbeat"
+                    , NULL
+                    , "NetData Jobs Missed Iterations"
+                    , "iterations/s"
+                    , "netdata"
+                    , "stats"
+                    , 130521
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_LINE
+            );
+        }
+        else {
+            rrdset_next(st_heartbeat_latency);
+            rrdset_next(st_heartbeat_overruns);
+        }
+
+        // one dimension per job
+        size_t i;
+        for(i = 0; i < jobs ; i++) {
+            RRDDIM *rd = rrddim_find(st_heartbeat_latency, hs[i].tag);
+            if(unlikely(!rd))
+                rd = rrddim_add(st_heartbeat_latency, hs[i].tag, NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+            rrddim_set_by_pointer(st_heartbeat_latency, rd, (collected_number)hs[i].latency_max);
+
+            rd = rrddim_find(st_heartbeat_overruns, hs[i].tag);
+            if(unlikely(!rd))
+                rd = rrddim_add(st_heartbeat_overruns, hs[i].tag, NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            rrddim_set_by_pointer(st_heartbeat_overruns, rd, (collected_number)hs[i].overruns);
+        }
+
+        rrdset_done(st_heartbeat_latency);
+        rrdset_done(st_heartbeat_overruns);
+    }
+
+    // ----------------------------------------------------------------
+
 #ifdef ENABLE_DBENGINE
     if (localhost->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
         unsigned long long stats_array[RRDENG_NR_STATS];
 
         /* get localhost's DB engine's statistics */
-        rrdeng_get_33_statistics(localhost->rrdeng_ctx, stats_array);
+        rrdeng_get_38_statistics(localhost->rrdeng_ctx, stats_array);
 
         // ----------------------------------------------------------------
 
@@ -818,7 +1460,291 @@ void global_statistics_charts(void) {
             rrddim_set_by_pointer(st_fd, rd_fd_max, (collected_number)rlimit_nofile.rlim_cur / 4);
             rrdset_done(st_fd);
         }
+
+        // ----------------------------------------------------------------
+
+        {
+            static RRDSET *st_cmd_queue = NULL;
+            static RRDDIM *rd_depth = NULL;
+            static RRDDIM *rd_stalls = NULL;
+
+            if (unlikely(!st_cmd_queue)) {
+                st_cmd_queue = rrdset_create_localhost(
+                        "netdata"
+                        , "dbengine_command_queue"
+                        , NULL
+                        , "dbengine"
+                        , NULL
+                        , "NetData DB engine command queue"
+                        , "commands"
+                        , "netdata"
+                        , "stats"
+                        , 130509
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+
+                rd_depth = rrddim_add(st_cmd_queue, "depth", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                rd_stalls = rrddim_add(st_cmd_queue, "producer stalls", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_cmd_queue);
+
+            rrddim_set_by_pointer(st_cmd_queue, rd_depth, (collected_number)stats_array[33]);
+            rrddim_set_by_pointer(st_cmd_queue, rd_stalls, (collected_number)stats_array[34]);
+            rrdset_done(st_cmd_queue);
+        }
+
+        // ----------------------------------------------------------------
+
+        {
+            static RRDSET *st_writeback = NULL;
+            static RRDDIM *rd_dirty = NULL;
+            static RRDDIM *rd_target = NULL;
+            static RRDDIM *rd_flushed = NULL;
+            static RRDDIM *rd_forced = NULL;
+
+            if (unlikely(!st_writeback)) {
+                st_writeback = rrdset_create_localhost(
+                        "netdata"
+                        , "dbengine_writeback"
+                        , NULL
+                        , "dbengine"
+                        , NULL
+                        , "NetData DB engine dirty page write-back"
+                        , "pages"
+                        , "netdata"
+                        , "stats"
+                        , 130510
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+
+                rd_dirty = rrddim_add(st_writeback, "dirty", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                rd_target = rrddim_add(st_writeback, "target", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                rd_flushed = rrddim_add(st_writeback, "flushed", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+                rd_forced = rrddim_add(st_writeback, "forced", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_writeback);
+
+            rrddim_set_by_pointer(st_writeback, rd_dirty, (collected_number)stats_array[4]);
+            rrddim_set_by_pointer(st_writeback, rd_target, (collected_number)stats_array[35]);
+            rrddim_set_by_pointer(st_writeback, rd_flushed, (collected_number)stats_array[36]);
+            rrddim_set_by_pointer(st_writeback, rd_forced, (collected_number)stats_array[37]);
+            rrdset_done(st_writeback);
+        }
+
+        // ----------------------------------------------------------------
+
+        {
+            static RRDSET *st_latency[RRDENG_LATENCIES];
+            static RRDDIM *rd_latency[RRDENG_LATENCIES][RRDENG_LATENCY_BUCKETS];
+            static const char *titles[RRDENG_LATENCIES] = {
+                    [RRDENG_LATENCY_PAGE_MISS] = "NetData DB engine queries waiting for pages read from disk",
+                    [RRDENG_LATENCY_PAGE_WAIT] = "NetData DB engine threads waiting for busy pages",
+                    [RRDENG_LATENCY_CMD_QUEUE] = "NetData DB engine commands waiting in the command queue",
+                    [RRDENG_LATENCY_FLUSH]     = "NetData DB engine extents flushed to disk",
+            };
+            unsigned long long latencies[RRDENG_LATENCIES][RRDENG_LATENCY_BUCKETS];
+            int l, b;
+
+            rrdeng_get_latency_histograms(latencies);
+
+            for(l = 0; l < RRDENG_LATENCIES ; l++) {
+                if (unlikely(!st_latency[l])) {
+                    char id[RRD_ID_LENGTH_MAX + 1];
+                    snprintfz(id, RRD_ID_LENGTH_MAX, "dbengine_latency_%s", rrdeng_latency_names[l]);
+
+                    st_latency[l] = rrdset_create_localhost(
+                            "netdata"
+                            , id
+                            , NULL
+                            , "dbengine"
+                            , NULL
+                            , titles[l]
+                            , "events/s"
+                            , "netdata"
+                            , "stats"
+                            , 130511 + l
+                            , localhost->rrd_update_every
+                            , RRDSET_TYPE_STACKED
+                    );
+
+                    for(b = 0; b < RRDENG_LATENCY_BUCKETS ; b++)
+                        rd_latency[l][b] = rrddim_add(st_latency[l], rrdeng_latency_bucket_names[b], NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+                }
+                else
+                    rrdset_next(st_latency[l]);
+
+                for(b = 0; b < RRDENG_LATENCY_BUCKETS ; b++)
+                    rrddim_set_by_pointer(st_latency[l], rd_latency[l][b], (collected_number)latencies[l][b]);
+                rrdset_done(st_latency[l]);
+            }
+        }
     }
 #endif
 
+    // ----------------------------------------------------------------
+
+    {
+        static RRDSET *st_pools_cpu = NULL, *st_pools_threads = NULL;
+        static RRDDIM *rd_pools_cpu[NETDATA_THREAD_POOLS_MAX], *rd_pools_threads[NETDATA_THREAD_POOLS_MAX];
+        NETDATA_THREAD_POOL_STATS pools[NETDATA_THREAD_POOLS_MAX];
+        size_t p, pools_count = netdata_thread_pools_stats(pools, NETDATA_THREAD_POOLS_MAX);
+
+        if (unlikely(!st_pools_cpu)) {
+            st_pools_cpu = rrdset_create_localhost(
+                    "netdata"
+                    , "thread_pools_cpu"
+                    , NULL
+                    , "threads"
+                    , NULL
+                    , "NetData Thread Pools CPU usage"
+                    , "milliseconds/s"
+                    , "netdata"
+                    , "stats"
+                    , 130710
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_STACKED
+            );
+
+            st_pools_threads = rrdset_create_localhost(
+                    "netdata"
+                    , "thread_pools_threads"
+                    , NULL
+                    , "threads"
+                    , NULL
+                    , "NetData Thread Pools Threads"
+                    , "threads"
+                    , "netdata"
+                    , "stats"
+                    , 130711
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_STACKED
+            );
+
+            // the pools are added at startup, so they are all here
+            for(p = 0; p < pools_count ; p++) {
+                rd_pools_cpu[p] = rrddim_add(st_pools_cpu, pools[p].name, NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
+                rd_pools_threads[p] = rrddim_add(st_pools_threads, pools[p].name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+            }
+        }
+        else {
+            rrdset_next(st_pools_cpu);
+            rrdset_next(st_pools_threads);
+        }
+
+        for(p = 0; p < pools_count ; p++) {
+            rrddim_set_by_pointer(st_pools_cpu, rd_pools_cpu[p], (collected_number)pools[p].cpu_usec);
+            rrddim_set_by_pointer(st_pools_threads, rd_pools_threads[p], (collected_number)pools[p].threads);
+        }
+        rrdset_done(st_pools_cpu);
+        rrdset_done(st_pools_threads);
+    }
+
+    // ----------------------------------------------------------------
+
+    if(netdata_locks_profiling) {
+        NETDATA_LOCKS_PROFILE lp;
+        netdata_locks_profile_totals(&lp);
+
+        {
+            static RRDSET *st_locks = NULL;
+            static RRDDIM *rd_acquisitions = NULL,
+                          *rd_contended = NULL;
+
+            if (unlikely(!st_locks)) {
+                st_locks = rrdset_create_localhost(
+                        "netdata"
+                        , "locks"
+                        , NULL
+                        , "locks"
+                        , NULL
+                        , "NetData Lock Acquisitions"
+                        , "acquisitions/s"
+                        , "netdata"
+                        , "stats"
+                        , 130700
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+
+                rd_acquisitions = rrddim_add(st_locks, "acquisitions", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+                rd_contended = rrddim_add(st_locks, "contended", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_locks);
+
+            rrddim_set_by_pointer(st_locks, rd_acquisitions, (collected_number)lp.acquisitions);
+            rrddim_set_by_pointer(st_locks, rd_contended, (collected_number)lp.contended);
+            rrdset_done(st_locks);
+        }
+
+        // ----------------------------------------------------------------
+
+        {
+            static RRDSET *st_wait = NULL;
+            static RRDDIM *rd_wait[NETDATA_LOCKS_PROFILE_BUCKETS];
+
+            if (unlikely(!st_wait)) {
+                st_wait = rrdset_create_localhost(
+                        "netdata"
+                        , "locks_wait"
+                        , NULL
+                        , "locks"
+                        , NULL
+                        , "NetData Lock Wait Time"
+                        , "acquisitions/s"
+                        , "netdata"
+                        , "stats"
+                        , 130701
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++)
+                    rd_wait[i] = rrddim_add(st_wait, netdata_locks_profile_buckets[i], NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_wait);
+
+            for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++)
+                rrddim_set_by_pointer(st_wait, rd_wait[i], (collected_number)lp.wait_histogram[i]);
+            rrdset_done(st_wait);
+        }
+
+        // ----------------------------------------------------------------
+
+        {
+            static RRDSET *st_hold = NULL;
+            static RRDDIM *rd_hold[NETDATA_LOCKS_PROFILE_BUCKETS];
+
+            if (unlikely(!st_hold)) {
+                st_hold = rrdset_create_localhost(
+                        "netdata"
+                        , "locks_hold"
+                        , NULL
+                        , "locks"
+                        , NULL
+                        , "NetData Lock Hold Time"
+                        , "releases/s"
+                        , "netdata"
+                        , "stats"
+                        , 130702
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_STACKED
+                );
+
+                for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++)
+                    rd_hold[i] = rrddim_add(st_hold, netdata_locks_profile_buckets[i], NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_hold);
+
+            for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++)
+                rrddim_set_by_pointer(st_hold, rd_hold[i], (collected_number)lp.hold_histogram[i]);
+            rrdset_done(st_hold);
+        }
+    }
 }
@@ -8,13 +8,36 @@
 // ----------------------------------------------------------------------------
 // global statistics
 
-extern void rrdr_query_completed(uint64_t db_points_read, uint64_t result_points_generated);
+// the API endpoints that get a latency histogram
+typedef enum global_stats_api_endpoint {
+    GLOBAL_STATS_API_NONE = 0,          // not an API request
+    GLOBAL_STATS_API_DATA,
+    GLOBAL_STATS_API_CHARTS,
+    GLOBAL_STATS_API_ALLMETRICS,
+    GLOBAL_STATS_API_BADGE,
+    GLOBAL_STATS_API_OTHER,             // all the other API requests
 
-extern void finished_web_request_statistics(uint64_t dt,
+    // terminator
+    GLOBAL_STATS_API_ENDPOINTS
+} GLOBAL_STATS_API_ENDPOINT;
+
+#define GLOBAL_STATS_API_LATENCY_BUCKETS 9
+
+extern void rrdr_query_completed(uint64_t db_points_read, uint64_t result_points_generated, uint64_t dt);
+extern uint64_t rrdr_query_usec_of_this_thread(void);
+extern void rrdset_done_completed(uint64_t dt);
+
+extern void finished_web_request_statistics(GLOBAL_STATS_API_ENDPOINT endpoint,
+                                     uint64_t dt,
                                      uint64_t bytes_received,
                                      uint64_t bytes_sent,
                                      uint64_t content_size,
-                                     uint64_t compressed_content_size);
+                                     uint64_t compressed_content_size,
+                                     const usec_t *phases_dt);
+
+extern int web_request_admitted(GLOBAL_STATS_API_ENDPOINT endpoint, uint32_t max_in_flight);
+extern void web_request_completed(GLOBAL_STATS_API_ENDPOINT endpoint);
+extern uint32_t web_requests_in_flight(void);
 
 extern uint64_t web_client_connected(void);
 extern void web_client_disconnected(void);
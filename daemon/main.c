@@ -54,6 +54,7 @@ void netdata_cleanup_and_exit(int ret) {
 #endif
 
     info("EXIT: all done - netdata is now exiting - bye bye...");
+    log_async_stop();
     exit(ret);
 }
 
@@ -76,6 +77,7 @@ struct netdata_static_thread static_threads[] = {
     {"BACKENDS",             NULL,                    NULL,         1, NULL, NULL, backends_main},
     {"WEB_SERVER[static1]",  NULL,                    NULL,         0, NULL, NULL, socket_listen_main_static_threaded},
     {"STREAM",               NULL,                    NULL,         0, NULL, NULL, rrdpush_sender_thread},
+    {"DBSAVE",               NULL,                    NULL,         1, NULL, NULL, rrd_checkpoint_main},
 
     NETDATA_PLUGIN_HOOK_PLUGINSD
     NETDATA_PLUGIN_HOOK_HEALTH
@@ -103,6 +105,7 @@ void web_server_config_options(void) {
     respect_web_browser_do_not_track_policy = config_get_boolean(CONFIG_SECTION_WEB, "respect do not track policy", respect_web_browser_do_not_track_policy);
     web_x_frame_options = config_get(CONFIG_SECTION_WEB, "x-frame-options response header", "");
     if(!*web_x_frame_options) web_x_frame_options = NULL;
+    web_client_access_log_timings = config_get_boolean(CONFIG_SECTION_WEB, "access log request phases", web_client_access_log_timings);
 
     web_allow_connections_from = simple_pattern_create(config_get(CONFIG_SECTION_WEB, "allow connections from", "localhost *"), NULL, SIMPLE_PATTERN_EXACT);
     web_allow_dashboard_from   = simple_pattern_create(config_get(CONFIG_SECTION_WEB, "allow dashboard from", "localhost *"), NULL, SIMPLE_PATTERN_EXACT);
@@ -111,6 +114,7 @@ void web_server_config_options(void) {
     web_allow_streaming_from   = simple_pattern_create(config_get(CONFIG_SECTION_WEB, "allow streaming from", "*"), NULL, SIMPLE_PATTERN_EXACT);
     web_allow_netdataconf_from = simple_pattern_create(config_get(CONFIG_SECTION_WEB, "allow netdata.conf from", "localhost fd* 10.* 192.168.* 172.16.* 172.17.* 172.18.* 172.19.* 172.20.* 172.21.* 172.22.* 172.23.* 172.24.* 172.25.* 172.26.* 172.27.* 172.28.* 172.29.* 172.30.* 172.31.*"), NULL, SIMPLE_PATTERN_EXACT);
     web_allow_mgmt_from        = simple_pattern_create(config_get(CONFIG_SECTION_WEB, "allow management from", "localhost"), NULL, SIMPLE_PATTERN_EXACT);
+    web_allow_unix_users       = simple_pattern_create(config_get(CONFIG_SECTION_WEB, "allow unix socket users", "*"), NULL, SIMPLE_PATTERN_EXACT);
 
 
 #ifdef NETDATA_WITH_ZLIB
@@ -141,10 +145,70 @@ void web_server_config_options(void) {
         error("Invalid compression level %d. Valid levels are 1 (fastest) to 9 (best ratio). Proceeding with level 9 (best compression).", web_gzip_level);
         web_gzip_level = 9;
     }
+
+    long long min_size = config_get_number(CONFIG_SECTION_WEB, "gzip compression minimum size", (long long)web_gzip_min_size);
+    if(min_size < 0) {
+        error("Invalid gzip compression minimum size %lld. Proceeding with %zu bytes.", min_size, web_gzip_min_size);
+        min_size = (long long)web_gzip_min_size;
+    }
+    web_gzip_min_size = (size_t)min_size;
+
+    long long cache_mb = config_get_number(CONFIG_SECTION_WEB, "gzip static files cache MB", WEB_FILES_CACHE_DEFAULT_SIZE_MB);
+    if(cache_mb < 0) {
+        error("Invalid gzip static files cache size %lld MB. Proceeding with %d MB.", cache_mb, WEB_FILES_CACHE_DEFAULT_SIZE_MB);
+        cache_mb = WEB_FILES_CACHE_DEFAULT_SIZE_MB;
+    }
+    web_files_cache_max_size = (size_t)cache_mb * 1024 * 1024;
 #endif /* NETDATA_WITH_ZLIB */
 }
 
 
+static struct {
+    const char *name;
+    const char *threads;
+} default_thread_pools[] = {
+        { "collectors", "PLUGIN[* PLUGINSD[* STATSD* DISKSPACE[* IDLEJITTER* APPS_READ IPMI_POLLER" },
+        { "web",        "WEB_SERVER* QUERY[*" },
+        { "streaming",  "STREAM_*" },
+        { "health",     "HEALTH*" },
+        { "backends",   "BACKEND*" },
+        { NULL,         NULL }
+};
+
+static void thread_pools_config(void) {
+    char buf[CONFIG_MAX_VALUE + 1], *s, *name;
+    size_t i;
+
+    buf[0] = '\0';
+    for(i = 0; default_thread_pools[i].name ; i++) {
+        if(i) strcat(buf, " ");
+        strcat(buf, default_thread_pools[i].name);
+    }
+
+    strncpyz(buf, config_get(CONFIG_SECTION_GLOBAL, "thread pools", buf), CONFIG_MAX_VALUE);
+
+    s = buf;
+    while(s && (name = mystrsep(&s, " \t")) && *name) {
+
+        const char *threads = "";
+        for(i = 0; default_thread_pools[i].name ; i++)
+            if(!strcmp(name, default_thread_pools[i].name)) threads = default_thread_pools[i].threads;
+
+        char section[CONFIG_MAX_NAME + 1];
+        snprintfz(section, CONFIG_MAX_NAME, "thread pool:%s", name);
+
+        netdata_thread_pool_add(
+                name
+                , config_get(section, "threads", threads)
+                , config_get(section, "cpu affinity", "")
+                , config_get(section, "scheduling policy", "keep")
+                , (int)config_get_number(section, "scheduling priority", 0)
+                , (int)config_get_number(section, "nice level", 0)
+        );
+    }
+}
+
+
 int killpid(pid_t pid, int signal)
 {
     int ret = -1;
@@ -305,7 +369,11 @@ int help(int exitcode) {
             "  -W stacksize=N           Set the stacksize (in bytes).\n\n"
             "  -W debug_flags=N         Set runtime tracing to debug.log.\n\n"
             "  -W unittest              Run internal unittests and exit.\n\n"
+            "  -W perftest[=scale=N,repeat=N,only=PATTERN|PATTERN]\n"
+            "                           Run the micro-benchmarks of the hot paths, print them as JSON and exit.\n\n"
             "  -W createdataset=N       Create a DB engine dataset of N seconds and exit.\n\n"
+            "  -W dbengine-bench[=hosts=N,charts=N,dimensions=N,seconds=N,update_every=N,threads=N,queries=N]\n"
+            "                           Benchmark the DB engine ingestion and queries and exit.\n\n"
             "  -W set section option value\n"
             "                           set netdata.conf option from the command line.\n\n"
             "  -W simple-pattern pattern string\n"
@@ -358,6 +426,10 @@ static void security_init(){
     snprintfz(filename, FILENAME_MAX, "%s/ssl/cert.pem",netdata_configured_user_config_dir);
     security_cert    = config_get(CONFIG_SECTION_WEB, "ssl certificate",  filename);
 
+    netdata_ssl_session_cache_size = config_get_number(CONFIG_SECTION_WEB, "ssl session cache size", NETDATA_SSL_SESSION_CACHE_SIZE);
+    netdata_ssl_session_timeout = config_get_number(CONFIG_SECTION_WEB, "ssl session timeout", NETDATA_SSL_SESSION_TIMEOUT);
+    if(netdata_ssl_session_timeout < 1) netdata_ssl_session_timeout = NETDATA_SSL_SESSION_TIMEOUT;
+
     security_openssl_library();
 }
 #endif
@@ -489,6 +561,9 @@ static void get_netdata_configured_variables() {
     // get default memory mode for the database
 
     default_rrd_memory_mode = rrd_memory_mode_id(config_get(CONFIG_SECTION_GLOBAL, "memory mode", rrd_memory_mode_name(default_rrd_memory_mode)));
+    default_rrd_map_packed = config_get_boolean(CONFIG_SECTION_GLOBAL, "map packed files", default_rrd_map_packed);
+    default_rrd_ram_blocked = config_get_boolean(CONFIG_SECTION_GLOBAL, "ram column blocks", default_rrd_ram_blocked);
+    default_rrd_ram_summaries = config_get_boolean(CONFIG_SECTION_GLOBAL, "ram summaries", default_rrd_ram_summaries);
 
 #ifdef ENABLE_DBENGINE
     // ------------------------------------------------------------------------
@@ -500,6 +575,29 @@ static void get_netdata_configured_variables() {
         default_rrdeng_page_cache_mb = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
     }
 
+    // ------------------------------------------------------------------------
+    // get default Database Engine page cache NUMA node arenas and the share of the page cache of every node
+
+    {
+        unsigned numa_nodes = page_arena_detect_nodes();
+        int page_cache_numa = config_get_boolean_ondemand(CONFIG_SECTION_GLOBAL, "page cache numa", CONFIG_BOOLEAN_AUTO);
+
+        if(page_cache_numa == CONFIG_BOOLEAN_YES || (page_cache_numa == CONFIG_BOOLEAN_AUTO && numa_nodes >= 2)) {
+            unsigned node;
+            char option[101];
+
+            for(node = 0; node < numa_nodes; node++) {
+                snprintfz(option, 100, "page cache size node %u percent", node);
+                default_rrdeng_page_cache_node_share[node] = (int) config_get_number(CONFIG_SECTION_GLOBAL, option, 100 / numa_nodes);
+                if(default_rrdeng_page_cache_node_share[node] < 0 || default_rrdeng_page_cache_node_share[node] > 100) {
+                    error("Invalid %s %d given. Defaulting to %u.", option, default_rrdeng_page_cache_node_share[node], 100 / numa_nodes);
+                    default_rrdeng_page_cache_node_share[node] = 100 / numa_nodes;
+                }
+            }
+            page_arena_init(numa_nodes);
+        }
+    }
+
     // ------------------------------------------------------------------------
     // get default Database Engine disk space quota in MiB
 
@@ -508,6 +606,102 @@ static void get_netdata_configured_variables() {
         error("Invalid dbengine disk space %d given. Defaulting to %d.", default_rrdeng_disk_quota_mb, RRDENG_MIN_DISK_SPACE_MB);
         default_rrdeng_disk_quota_mb = RRDENG_MIN_DISK_SPACE_MB;
     }
+
+    // ------------------------------------------------------------------------
+    // get default Database Engine number of worker event loops
+
+    default_rrdeng_workers = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine workers", default_rrdeng_workers);
+    if(default_rrdeng_workers < 1 || default_rrdeng_workers > RRDENG_MAX_WORKERS) {
+        error("Invalid dbengine workers %d given. Defaulting to 1.", default_rrdeng_workers);
+        default_rrdeng_workers = 1;
+    }
+
+    // ------------------------------------------------------------------------
+    // get default Database Engine number of storage tiers
+
+    default_rrdeng_storage_tiers = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine storage tiers", default_rrdeng_storage_tiers);
+    if(default_rrdeng_storage_tiers < 1 || default_rrdeng_storage_tiers > RRDENG_MAX_TIERS) {
+        error("Invalid dbengine storage tiers %d given. Defaulting to 1.", default_rrdeng_storage_tiers);
+        default_rrdeng_storage_tiers = 1;
+    }
+
+    // ------------------------------------------------------------------------
+    // get default Database Engine I/O backend
+
+    default_rrdeng_io_uring = config_get_boolean(CONFIG_SECTION_GLOBAL, "dbengine io_uring", default_rrdeng_io_uring);
+
+    // ------------------------------------------------------------------------
+    // get default Database Engine retention classes and their disk space
+
+    default_rrdeng_retention_classes = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine retention classes", default_rrdeng_retention_classes);
+    if(default_rrdeng_retention_classes < 1 || default_rrdeng_retention_classes > RRDENG_MAX_RETENTION_CLASSES) {
+        error("Invalid dbengine retention classes %d given. Defaulting to 1.", default_rrdeng_retention_classes);
+        default_rrdeng_retention_classes = 1;
+    }
+    default_rrdeng_retention_class = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine retention class", default_rrdeng_retention_class);
+    if(default_rrdeng_retention_class < 1 || default_rrdeng_retention_class > default_rrdeng_retention_classes) {
+        error("Invalid dbengine retention class %d given. Defaulting to 1.", default_rrdeng_retention_class);
+        default_rrdeng_retention_class = 1;
+    }
+    {
+        int retention_class;
+        char option[101];
+
+        for(retention_class = 2; retention_class <= default_rrdeng_retention_classes; retention_class++) {
+            snprintfz(option, 100, "dbengine retention class %d disk space", retention_class);
+            default_rrdeng_class_disk_quota_mb[retention_class - 1] = (int) config_get_number(CONFIG_SECTION_GLOBAL, option, default_rrdeng_disk_quota_mb);
+            if(default_rrdeng_class_disk_quota_mb[retention_class - 1] < RRDENG_MIN_DISK_SPACE_MB) {
+                error("Invalid %s %d given. Defaulting to %d.", option, default_rrdeng_class_disk_quota_mb[retention_class - 1], RRDENG_MIN_DISK_SPACE_MB);
+                default_rrdeng_class_disk_quota_mb[retention_class - 1] = RRDENG_MIN_DISK_SPACE_MB;
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // get default Database Engine percentage of dead pages that makes a datafile be compacted
+
+    default_rrdeng_compaction_threshold = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine compaction threshold", default_rrdeng_compaction_threshold);
+    if(default_rrdeng_compaction_threshold < 0 || default_rrdeng_compaction_threshold > 100) {
+        error("Invalid dbengine compaction threshold %d given. Defaulting to 50.", default_rrdeng_compaction_threshold);
+        default_rrdeng_compaction_threshold = 50;
+    }
+
+    // ------------------------------------------------------------------------
+    // get default Database Engine percentage of the page cache the write-back keeps the dirty pages under
+
+    default_rrdeng_dirty_page_ratio = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine dirty page ratio", default_rrdeng_dirty_page_ratio);
+    if(default_rrdeng_dirty_page_ratio < 1 || default_rrdeng_dirty_page_ratio > 90) {
+        error("Invalid dbengine dirty page ratio %d given. Defaulting to 10.", default_rrdeng_dirty_page_ratio);
+        default_rrdeng_dirty_page_ratio = 10;
+    }
+
+    // ------------------------------------------------------------------------
+    // get the Database Engine checksum of the files it creates
+
+    {
+        const char *checksum = config_get(CONFIG_SECTION_GLOBAL, "dbengine checksum", "crc32c");
+        if(!strcmp(checksum, "crc32c"))
+            default_rrdeng_checksum_crc32c = 1;
+        else if(!strcmp(checksum, "crc32"))
+            default_rrdeng_checksum_crc32c = 0;
+        else
+            error("Invalid dbengine checksum '%s' given. Defaulting to crc32c.", checksum);
+    }
+
+    // ------------------------------------------------------------------------
+    // get the Database Engine instance shared by the children, its page cache size and disk space in MiB
+
+    default_rrdeng_multihost = config_get_boolean(CONFIG_SECTION_GLOBAL, "dbengine multihost", default_rrdeng_multihost);
+    default_rrdeng_multihost_page_cache_mb = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine multihost page cache size", default_rrdeng_page_cache_mb);
+    if(default_rrdeng_multihost_page_cache_mb < RRDENG_MIN_PAGE_CACHE_SIZE_MB) {
+        error("Invalid dbengine multihost page cache size %d given. Defaulting to %d.", default_rrdeng_multihost_page_cache_mb, RRDENG_MIN_PAGE_CACHE_SIZE_MB);
+        default_rrdeng_multihost_page_cache_mb = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
+    }
+    default_rrdeng_multihost_disk_quota_mb = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine multihost disk space", default_rrdeng_disk_quota_mb);
+    if(default_rrdeng_multihost_disk_quota_mb < RRDENG_MIN_DISK_SPACE_MB) {
+        error("Invalid dbengine multihost disk space %d given. Defaulting to %d.", default_rrdeng_multihost_disk_quota_mb, RRDENG_MIN_DISK_SPACE_MB);
+        default_rrdeng_multihost_disk_quota_mb = RRDENG_MIN_DISK_SPACE_MB;
+    }
 #endif
     // ------------------------------------------------------------------------
 
@@ -623,6 +817,9 @@ void set_global_environment() {
         char b[16];
         snprintfz(b, 15, "%d", default_rrd_update_every);
         setenv("NETDATA_UPDATE_EVERY", b, 1);
+
+        snprintfz(b, 15, "%d", PLUGINSD_BINARY_VERSION);
+        setenv("NETDATA_PLUGINS_BINARY", b, 1);
     }
 
     setenv("NETDATA_VERSION"          , program_version, 1);
@@ -886,10 +1083,14 @@ int main(int argc, char **argv) {
                         char* stacksize_string = "stacksize=";
                         char* debug_flags_string = "debug_flags=";
                         char* createdataset_string = "createdataset=";
+                        char* dbengine_bench_string = "dbengine-bench";
+                        char* perftest_string = "perftest";
 
                         if(strcmp(optarg, "unittest") == 0) {
                             if(unit_test_buffer()) return 1;
+                            if(unit_test_string_pool()) return 1;
                             if(unit_test_str2ld()) return 1;
+                            if(test_median_on_unsorted_series()) return 1;
                             get_netdata_configured_variables();
                             default_rrd_update_every = 1;
                             default_rrd_memory_mode = RRD_MEMORY_MODE_RAM;
@@ -898,12 +1099,27 @@ int main(int argc, char **argv) {
                             default_rrdpush_enabled = 0;
                             if(run_all_mockup_tests()) return 1;
                             if(unit_test_storage()) return 1;
+                            if(test_rrdset_blocks()) return 1;
+                            if(test_rrdset_done_many()) return 1;
+                            if(test_query_grouping_add_many()) return 1;
+                            if(test_rrd2rrdr_query_threads()) return 1;
+                            if(test_query_cache()) return 1;
+                            if(test_rrd2rrdr_incremental()) return 1;
+                            if(test_rrddim_summaries()) return 1;
+                            if(test_rrdr2json()) return 1;
+                            if(test_rrdr2binary()) return 1;
+                            if(test_allmetrics_stream()) return 1;
+                            if(test_hash_index()) return 1;
 #ifdef ENABLE_DBENGINE
                             if(test_dbengine()) return 1;
 #endif
                             fprintf(stderr, "\n\nALL TESTS PASSED\n\n");
                             return 0;
                         }
+                        else if(strncmp(optarg, perftest_string, strlen(perftest_string)) == 0) {
+                            optarg += strlen(perftest_string);
+                            return perf_test((*optarg == '=') ? optarg + 1 : optarg);
+                        }
                         else if(strncmp(optarg, createdataset_string, strlen(createdataset_string)) == 0) {
                             optarg += strlen(createdataset_string);
 #ifdef ENABLE_DBENGINE
@@ -912,6 +1128,17 @@ int main(int argc, char **argv) {
 #endif
                             return 0;
                         }
+                        else if(strncmp(optarg, dbengine_bench_string, strlen(dbengine_bench_string)) == 0) {
+                            optarg += strlen(dbengine_bench_string);
+#ifdef ENABLE_DBENGINE
+                            get_netdata_configured_variables();
+                            default_health_enabled = 0;
+                            return dbengine_benchmark((*optarg == '=') ? optarg + 1 : optarg);
+#else
+                            fprintf(stderr, "netdata has been built without the DB engine.\n");
+                            return 1;
+#endif
+                        }
                         else if(strcmp(optarg, "simple-pattern") == 0) {
                             if(optind + 2 > argc) {
                                 fprintf(stderr, "%s", "\nUSAGE: -W simple-pattern 'pattern' 'string'\n\n"
@@ -1060,6 +1287,7 @@ int main(int argc, char **argv) {
             mallopt(M_ARENA_MAX, 1);
 #endif
         test_clock_boottime();
+        test_clock_coarse();
 
         // prepare configuration environment variables for the plugins
 
@@ -1095,6 +1323,11 @@ int main(int argc, char **argv) {
 #endif
         }
 
+#ifdef NETDATA_LOCKS_DEBUG
+        // the wait and hold times of the locks, at /api/v1/locks and the netdata.locks charts
+        netdata_locks_profiling = config_get_boolean(CONFIG_SECTION_GLOBAL, "profile locks", netdata_locks_profiling);
+#endif
+
 
         // --------------------------------------------------------------------
         // get log filenames and settings
@@ -1194,8 +1427,14 @@ int main(int argc, char **argv) {
     web_files_uid();
     web_files_gid();
 
+    // the pools have to be ready before the first thread is created
+    thread_pools_config();
+
     netdata_threads_init_after_fork((size_t)config_get_number(CONFIG_SECTION_GLOBAL, "pthread stack size", (long)default_stacksize));
 
+    // from now on, the log is written by a thread
+    log_async_start();
+
     // ------------------------------------------------------------------------
     // initialize rrd, registry, health, rrdpush, etc.
 
@@ -1214,6 +1453,9 @@ int main(int argc, char **argv) {
 
     web_server_config_options();
 
+    // the options of the startup are in place - index them for lock free lookups
+    config_freeze();
+
     for (i = 0; static_threads[i].name != NULL ; i++) {
         struct netdata_static_thread *st = &static_threads[i];
 
@@ -1,6 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "common.h"
+#include "web/api/queries/average/average.h"
+#include "web/api/queries/incremental_sum/incremental_sum.h"
+#include "web/api/queries/max/max.h"
+#include "web/api/queries/min/min.h"
+#include "web/api/queries/sum/sum.h"
 
 static int check_number_printing(void) {
     struct {
@@ -316,8 +321,93 @@ static int check_storage_number_exists() {
     return 0;
 }
 
+// pack_storage_numbers() has to pack like pack_storage_number(), it may only round
+// the last digit differently, since it calculates with doubles
+static int check_storage_number_batch(void) {
+    const size_t ENTRIES = 4096;
+    double values[ENTRIES];
+    uint32_t flags[ENTRIES];
+    storage_number numbers[ENTRIES];
+    size_t i, same = 0, errors = 0;
+
+    srandom(1);
+    for(i = 0; i < ENTRIES ; i++) {
+        double magnitude = pow(10.0, (double)(random() % 30) - 9.0);
+        values[i] = (i % 64) ? (double)(random() % 100000000) / 10000000.0 * magnitude : 0.0;
+        if(i % 3 == 0) values[i] = -values[i];
+        flags[i] = (i % 5) ? SN_EXISTS : SN_EXISTS_RESET;
+    }
+
+    pack_storage_numbers(values, flags, numbers, ENTRIES);
+
+    for(i = 0; i < ENTRIES ; i++) {
+        storage_number expected = pack_storage_number(values[i], flags[i]);
+
+        if(numbers[i] == expected) {
+            same++;
+            continue;
+        }
+
+        if((numbers[i] & 0xff000000) != (expected & 0xff000000) ||
+           labs((long)(numbers[i] & 0x00ffffff) - (long)(expected & 0x00ffffff)) > 1) {
+            fprintf(stderr, "Batch packing %0.7e gave %08x, expected %08x ### E R R O R ###\n", values[i], numbers[i], expected);
+            errors++;
+        }
+    }
+
+    fprintf(stderr, "Batch packing: %zu of %zu storage numbers are the same, %zu errors\n", same, ENTRIES, errors);
+
+    unpack_storage_number_array(numbers, values, ENTRIES);
+
+    for(i = 0, same = 0; i < ENTRIES ; i++) {
+        calculated_number expected = unpack_storage_number(numbers[i]);
+
+        if((calculated_number)values[i] == expected) {
+            same++;
+            continue;
+        }
+
+        if(accuracy_loss(expected, (calculated_number)values[i]) > ACCURACY_LOSS_ACCEPTED_PERCENT / 1000000.0) {
+            fprintf(stderr, "Batch unpacking %08x gave %0.15e, expected " CALCULATED_NUMBER_FORMAT " ### E R R O R ###\n", numbers[i], values[i], expected);
+            errors++;
+        }
+    }
+
+    fprintf(stderr, "Batch unpacking: %zu of %zu values are the same, %zu errors\n", same, ENTRIES, errors);
+
+    // the queries unpack them with their flags, every other one missing
+    size_t non_zero = 0, resets = 0;
+    for(i = 0; i < ENTRIES ; i += 2) numbers[i] = SN_EMPTY_SLOT;
+    for(i = 1; i < ENTRIES ; i += 2) {
+        if(numbers[i] & 0x00ffffff) non_zero++;
+        if(did_storage_number_reset(numbers[i])) resets++;
+    }
+
+    int reset;
+    size_t query_non_zero = unpack_storage_number_query_array(numbers, values, ENTRIES, &reset);
+
+    for(i = 0; i < ENTRIES ; i++) {
+        double expected;
+        unpack_storage_number_array(&numbers[i], &expected, 1);
+
+        if(does_storage_number_exist(numbers[i]) ? values[i] != expected : !isnan(values[i])) {
+            fprintf(stderr, "Query unpacking %08x gave %0.15e ### E R R O R ###\n", numbers[i], values[i]);
+            errors++;
+        }
+    }
+    if(query_non_zero != non_zero || reset != (resets ? 1 : 0)) {
+        fprintf(stderr, "Query unpacking counted %zu non-zero values and reset %d, expected %zu and %d ### E R R O R ###\n",
+                query_non_zero, reset, non_zero, resets ? 1 : 0);
+        errors++;
+    }
+
+    fprintf(stderr, "Query unpacking: %zu errors\n", errors);
+    return (errors) ? 1 : 0;
+}
+
 int unit_test_storage() {
     if(check_storage_number_exists()) return 0;
+    if(check_storage_number_batch()) return 1;
 
     calculated_number storage_number_positive_min = unpack_storage_number(STORAGE_NUMBER_POSITIVE_MIN_RAW);
     calculated_number storage_number_negative_max = unpack_storage_number(STORAGE_NUMBER_NEGATIVE_MAX_RAW);
@@ -347,6 +437,908 @@ int unit_test_storage() {
     return r;
 }
 
+#define HASH_INDEX_TEST_ITEMS 50000
+#define HASH_INDEX_TEST_ALIVE 0x11111111
+#define HASH_INDEX_TEST_FREED 0xdeaddead
+
+struct hash_index_test_item {
+    char key[20];
+    uint32_t hash;
+    uint32_t magic;
+};
+
+struct hash_index_test {
+    HASH_INDEX index;
+    struct hash_index_test_item items[HASH_INDEX_TEST_ITEMS];
+    int stop;
+    size_t errors;
+    size_t found;
+};
+
+static size_t hash_index_test_freed_compared = 0;
+
+// the index must never compare a key with an item after hash_index_del() returned it
+static int hash_index_test_equal(void *item, const void *key) {
+    struct hash_index_test_item *it = item;
+
+    if(__atomic_load_n(&it->magic, __ATOMIC_RELAXED) != HASH_INDEX_TEST_ALIVE)
+        __atomic_add_fetch(&hash_index_test_freed_compared, 1, __ATOMIC_RELAXED);
+
+    return !strcmp(it->key, (const char *)key);
+}
+
+// searches the index while the main thread changes it
+static void *hash_index_test_reader(void *ptr) {
+    struct hash_index_test *t = ptr;
+    size_t i = 0;
+
+    while(!__atomic_load_n(&t->stop, __ATOMIC_RELAXED)) {
+        struct hash_index_test_item *want = &t->items[i++ % HASH_INDEX_TEST_ITEMS];
+        struct hash_index_test_item *item = hash_index_get(&t->index, want->hash, want->key);
+
+        if(item) {
+            if(item != want)
+                t->errors++;
+            t->found++;
+        }
+    }
+    return NULL;
+}
+
+// adds, deletes and searches items in a hash index, while another thread searches it too
+int test_hash_index(void) {
+    struct hash_index_test *t = callocz(1, sizeof(struct hash_index_test));
+    netdata_thread_t thread;
+    size_t i, round, errors = 0;
+
+    fprintf(stderr, "\nTesting hash index with %d items\n", HASH_INDEX_TEST_ITEMS);
+
+    hash_index_init(&t->index, hash_index_test_equal);
+    for(i = 0; i < HASH_INDEX_TEST_ITEMS ; i++) {
+        snprintfz(t->items[i].key, 19, "item%zu", i);
+        // few distinct hashes, so that the probing and the comparisons are tested too
+        t->items[i].hash = (i % 1000 == 0) ? 7 : simple_hash(t->items[i].key);
+    }
+
+    netdata_thread_create(&thread, "UNITTEST", NETDATA_THREAD_OPTION_JOINABLE, hash_index_test_reader, t);
+
+    for(round = 0; round < 3 ; round++) {
+        for(i = 0; i < HASH_INDEX_TEST_ITEMS ; i++) {
+            __atomic_store_n(&t->items[i].magic, HASH_INDEX_TEST_ALIVE, __ATOMIC_RELAXED);
+            if(hash_index_set(&t->index, t->items[i].hash, t->items[i].key, &t->items[i]) != &t->items[i]) {
+                fprintf(stderr, "    Adding item '%s' returned another item ### E R R O R ###\n", t->items[i].key);
+                errors++;
+            }
+        }
+
+        if(t->index.entries != HASH_INDEX_TEST_ITEMS) {
+            fprintf(stderr, "    The index has %zu items, expected %d ### E R R O R ###\n", t->index.entries, HASH_INDEX_TEST_ITEMS);
+            errors++;
+        }
+
+        for(i = 0; i < HASH_INDEX_TEST_ITEMS ; i++) {
+            if(hash_index_set(&t->index, t->items[i].hash, t->items[i].key, &t->items[(i + 1) % HASH_INDEX_TEST_ITEMS]) != &t->items[i]) {
+                fprintf(stderr, "    Adding duplicate item '%s' did not return the indexed one ### E R R O R ###\n", t->items[i].key);
+                errors++;
+            }
+        }
+
+        // delete all the items but one every round + 2, in a different order every round
+        for(i = 0; i < HASH_INDEX_TEST_ITEMS ; i++) {
+            size_t k = (i * 7919 + round) % HASH_INDEX_TEST_ITEMS;
+            if(k % (round + 2) == 0) continue;
+
+            if(hash_index_del(&t->index, t->items[k].hash, t->items[k].key) != &t->items[k]) {
+                fprintf(stderr, "    Deleting item '%s' did not return it ### E R R O R ###\n", t->items[k].key);
+                errors++;
+            }
+            __atomic_store_n(&t->items[k].magic, HASH_INDEX_TEST_FREED, __ATOMIC_RELAXED);
+        }
+
+        for(i = 0; i < HASH_INDEX_TEST_ITEMS ; i++) {
+            void *item = hash_index_get(&t->index, t->items[i].hash, t->items[i].key);
+            if((i % (round + 2) == 0) != (item == &t->items[i])) {
+                fprintf(stderr, "    Searching item '%s' after the deletions gave %p ### E R R O R ###\n", t->items[i].key, item);
+                errors++;
+            }
+        }
+
+        for(i = 0; i < HASH_INDEX_TEST_ITEMS ; i += round + 2) {
+            (void)hash_index_del(&t->index, t->items[i].hash, t->items[i].key);
+            __atomic_store_n(&t->items[i].magic, HASH_INDEX_TEST_FREED, __ATOMIC_RELAXED);
+        }
+
+        if(t->index.entries != 0) {
+            fprintf(stderr, "    The index has %zu items after deleting all of them ### E R R O R ###\n", t->index.entries);
+            errors++;
+        }
+    }
+
+    __atomic_store_n(&t->stop, 1, __ATOMIC_RELAXED);
+    netdata_thread_join(thread, NULL);
+
+    if(t->errors)
+        fprintf(stderr, "    The reader found %zu wrong items ### E R R O R ###\n", t->errors);
+    if(hash_index_test_freed_compared)
+        fprintf(stderr, "    The index compared %zu keys with deleted items ### E R R O R ###\n", hash_index_test_freed_compared);
+    errors += t->errors + hash_index_test_freed_compared;
+
+    fprintf(stderr, "Hash index: the reader found %zu items, %zu errors\n", t->found, errors);
+
+    hash_index_destroy(&t->index);
+    freez(t);
+    return (errors) ? 1 : 0;
+}
+
+// stores a known value in every slot of the column-blocked dimensions of a chart, adding
+// dimensions in two steps so that the blocks grow, and reads them back
+int test_rrdset_blocks(void) {
+    const int DIMS = 6;
+    RRDDIM *rd[DIMS];
+    struct rrddim_query_handle handle;
+    storage_number n;
+    long slot;
+    int i, errors = 0, blocked = default_rrd_ram_blocked;
+
+    fprintf(stderr, "\nRunning column-blocked RAM storage test\n");
+
+    default_rrd_ram_blocked = 1;
+    RRDSET *st = rrdset_create_custom(localhost, "netdata", "unittest-ram-blocks", NULL, "netdata", NULL, "Unit Testing",
+                                      "a value", "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_RAM, 100);
+
+    for(i = 0; i < DIMS ; i++) {
+        char name[101];
+
+        snprintfz(name, 100, "dim%d", i);
+        rd[i] = rrddim_add(st, name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+
+        // the first half of the dimensions are stored before the second half is added
+        if(i == DIMS / 2 - 1 || i == DIMS - 1) {
+            int j;
+
+            for(slot = 0; slot < st->entries ; slot++) {
+                st->current_entry = slot;
+                for(j = (i < DIMS / 2) ? 0 : DIMS / 2; j <= i ; j++)
+                    rd[j]->state->collect_ops->store_metric(rd[j], 0, pack_storage_number(j * 1000 + slot, SN_EXISTS));
+            }
+        }
+    }
+    default_rrd_ram_blocked = blocked;
+
+    for(i = 0; i < DIMS ; i++) {
+        if(rd[i]->state->column < 0) {
+            fprintf(stderr, "    dimension %s is not column-blocked ### E R R O R ###\n", rd[i]->name);
+            return 1;
+        }
+
+        handle.rd = rd[i];
+        handle.slotted.slot = 0;
+        handle.slotted.last_slot = st->entries - 1;
+        handle.slotted.finished = 0;
+        for(slot = 0; !rd[i]->state->query_ops->is_finished(&handle) ; slot++) {
+            n = rd[i]->state->query_ops->next_metric(&handle);
+            if(unpack_storage_number(n) != (calculated_number)(i * 1000 + slot)) {
+                fprintf(stderr, "    %s: slot %ld expecting value %d, found " CALCULATED_NUMBER_FORMAT " ### E R R O R ###\n",
+                        rd[i]->name, slot, (int)(i * 1000 + slot), unpack_storage_number(n));
+                errors++;
+            }
+        }
+        if(slot != st->entries) {
+            fprintf(stderr, "    %s: read %ld slots, expecting %ld ### E R R O R ###\n", rd[i]->name, slot, st->entries);
+            errors++;
+        }
+    }
+    st->current_entry = 0;
+
+    fprintf(stderr, "    %d dimensions of %ld slots in %ld columns, %d errors\n", DIMS, st->entries, st->blocks->columns, errors);
+    return errors;
+}
+
+// the charts committed by rrdset_done_many() should store the same values as the ones committed by rrdset_done()
+int test_rrdset_done_many(void) {
+    const int CHARTS = 3, FEED = 20;
+    RRDSET *st[CHARTS];
+    RRDDIM *rd[CHARTS];
+    int i, c, errors = 0;
+    long slot;
+
+    fprintf(stderr, "\nRunning rrdset_done_many() test\n");
+
+    for(i = 0; i < CHARTS ; i++) {
+        char name[101];
+
+        snprintfz(name, 100, "unittest-done-many-%d", i);
+        st[i] = rrdset_create_custom(localhost, "netdata", name, NULL, "netdata", NULL, "Unit Testing", "a value",
+                                     "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, 100);
+        rd[i] = rrddim_add(st[i], "dim", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+    }
+
+    for(c = 0; c < FEED ; c++) {
+        for(i = 0; i < CHARTS ; i++) {
+            if(c) st[i]->usec_since_last_update = USEC_PER_SEC;
+            rrddim_set_by_pointer(st[i], rd[i], c * 1000 + (c % 3) * 7);
+        }
+
+        // the first chart is committed alone, the rest together
+        rrdset_done(st[0]);
+        rrdset_done_many(&st[1], CHARTS - 1);
+
+        // align all of them to the first one
+        if(!c) {
+            for(i = 0; i < CHARTS ; i++) {
+                rd[i]->last_collected_time = st[i]->last_collected_time = st[i]->last_updated = st[0]->last_collected_time;
+                st[i]->last_collected_time.tv_usec = st[i]->last_updated.tv_usec = rd[i]->last_collected_time.tv_usec = 0;
+            }
+        }
+    }
+
+    for(i = 1; i < CHARTS ; i++) {
+        if(st[i]->counter != st[0]->counter) {
+            fprintf(stderr, "    %s stored %zu entries, expecting %zu ### E R R O R ###\n", st[i]->id, st[i]->counter, st[0]->counter);
+            errors++;
+            continue;
+        }
+
+        for(slot = 0; slot < (long)st[0]->counter ; slot++) {
+            if(rd[i]->values[slot] != rd[0]->values[slot]) {
+                fprintf(stderr, "    %s: slot %ld has value " CALCULATED_NUMBER_FORMAT ", expecting " CALCULATED_NUMBER_FORMAT " ### E R R O R ###\n",
+                        st[i]->id, slot, unpack_storage_number(rd[i]->values[slot]), unpack_storage_number(rd[0]->values[slot]));
+                errors++;
+            }
+        }
+    }
+
+    fprintf(stderr, "    %d charts, %zu entries, %d errors\n", CHARTS, st[0]->counter, errors);
+    return errors;
+}
+
+// the grouping methods should give the same result for values added one by one and for values added in blocks
+int test_query_grouping_add_many(void) {
+    const size_t VALUES = 300, BLOCK = 37;
+    struct {
+        const char *name;
+        void *(*create)(RRDR *r);
+        void (*free)(RRDR *r);
+        void (*add)(RRDR *r, query_number value);
+        void (*add_many)(RRDR *r, const query_number *values, size_t count);
+        query_number (*flush)(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+    } methods[] = {
+            { "average", grouping_create_average, grouping_free_average, grouping_add_average, grouping_add_many_average, grouping_flush_average },
+            { "sum", grouping_create_sum, grouping_free_sum, grouping_add_sum, grouping_add_many_sum, grouping_flush_sum },
+            { "min", grouping_create_min, grouping_free_min, grouping_add_min, grouping_add_many_min, grouping_flush_min },
+            { "max", grouping_create_max, grouping_free_max, grouping_add_max, grouping_add_many_max, grouping_flush_max },
+            { "incremental_sum", grouping_create_incremental_sum, grouping_free_incremental_sum, grouping_add_incremental_sum, grouping_add_many_incremental_sum, grouping_flush_incremental_sum },
+            { NULL, NULL, NULL, NULL, NULL, NULL }
+    };
+    query_number values[VALUES];
+    size_t i, m, start, end, group;
+    int errors = 0;
+    RRDR r;
+
+    fprintf(stderr, "\nRunning query grouping add_many() test\n");
+
+    // a few leading and trailing empty values and a few empty groups
+    for(i = 0; i < VALUES ; i++) {
+        if(i < 3 || i % 7 == 0 || (i >= 100 && i < 150) || i >= VALUES - 5)
+            values[i] = NAN;
+        else
+            values[i] = (query_number)((long)(i * 7919 % 1000) - 400) / 10.0;
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.internal.resampling_group = 1;
+    r.internal.resampling_divisor = 1;
+
+    for(m = 0; methods[m].name ; m++) {
+        for(group = 1; group <= VALUES ; group += (group < 10) ? 1 : 49) {
+            for(start = 0; start < VALUES ; start += group) {
+                RRDR_VALUE_FLAGS flags_one = RRDR_VALUE_NOTHING, flags_many = RRDR_VALUE_NOTHING;
+                query_number one, many;
+
+                end = (start + group < VALUES) ? start + group : VALUES;
+
+                r.internal.grouping_data = methods[m].create(&r);
+                for(i = start; i < end ; i++)
+                    methods[m].add(&r, values[i]);
+                one = methods[m].flush(&r, &flags_one);
+                methods[m].free(&r);
+
+                r.internal.grouping_data = methods[m].create(&r);
+                for(i = start; i < end ; i += BLOCK)
+                    methods[m].add_many(&r, &values[i], (i + BLOCK < end) ? BLOCK : end - i);
+                many = methods[m].flush(&r, &flags_many);
+                methods[m].free(&r);
+
+                // the sums of the blocks are added in a different order
+                if(flags_one != flags_many || query_number_fabs(one - many) > calculated_number_epsilon * (1 + query_number_fabs(one))) {
+                    fprintf(stderr, "    %s: values %zu to %zu gave " QUERY_NUMBER_FORMAT " (flags %u), expecting " QUERY_NUMBER_FORMAT " (flags %u) ### E R R O R ###\n",
+                            methods[m].name, start, end, many, (unsigned)flags_many, one, (unsigned)flags_one);
+                    errors++;
+                }
+            }
+        }
+    }
+
+    fprintf(stderr, "    %zu methods, %d errors\n", m, errors);
+    return errors;
+}
+
+// the median found by selection should be the one found by sorting
+int test_median_on_unsorted_series(void) {
+    const size_t MAX_ENTRIES = 300;
+    LONG_DOUBLE series[MAX_ENTRIES], sorted[MAX_ENTRIES], four[] = { 4.0, 1.0, 3.0, 2.0 };
+    size_t entries, i, pattern;
+    int errors = 0;
+
+    fprintf(stderr, "\nRunning median test\n");
+
+    if(median_on_unsorted_series(four, 4) != 2.5) {
+        fprintf(stderr, "    the median of 1, 2, 3, 4 is not 2.5 ### E R R O R ###\n");
+        errors++;
+    }
+
+    for(pattern = 0; pattern < 4 ; pattern++) {
+        for(entries = 1; entries <= MAX_ENTRIES ; entries++) {
+            for(i = 0; i < entries ; i++) {
+                switch(pattern) {
+                    case 0: series[i] = (LONG_DOUBLE)(i * 7919 % 1009) - 500; break;   // shuffled
+                    case 1: series[i] = (LONG_DOUBLE)(i % 5); break;                   // many equal values
+                    case 2: series[i] = (LONG_DOUBLE)i; break;                         // sorted
+                    default: series[i] = (LONG_DOUBLE)(entries - i); break;            // reversed
+                }
+            }
+
+            memcpy(sorted, series, entries * sizeof(LONG_DOUBLE));
+            sort_series(sorted, entries);
+
+            LONG_DOUBLE expected = median_on_sorted_series(sorted, entries);
+            LONG_DOUBLE found = median_on_unsorted_series(series, entries);
+
+            if(found != expected) {
+                fprintf(stderr, "    pattern %zu, %zu entries: median is %" LONG_DOUBLE_MODIFIER ", expecting %" LONG_DOUBLE_MODIFIER " ### E R R O R ###\n",
+                        pattern, entries, found, expected);
+                errors++;
+            }
+        }
+    }
+
+    fprintf(stderr, "    %d errors\n", errors);
+    return errors;
+}
+
+// the queries run by the query threads should return what the queries run by a single thread return
+int test_rrd2rrdr_query_threads(void) {
+    const int DIMS = 64, FEED = 120;
+    RRDR_GROUPING methods[] = { RRDR_GROUPING_AVERAGE, RRDR_GROUPING_MAX, RRDR_GROUPING_MEDIAN, RRDR_GROUPING_UNDEFINED };
+    RRDDIM *rd[DIMS];
+    RRDSET *st;
+    int i, c, m, errors = 0;
+    long rows = 0;
+
+    fprintf(stderr, "\nRunning query threads test\n");
+
+    st = rrdset_create_custom(localhost, "netdata", "unittest-query-threads", NULL, "netdata", NULL, "Unit Testing", "a value",
+                              "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, FEED * 2);
+    for(i = 0; i < DIMS ; i++) {
+        char name[101];
+        snprintfz(name, 100, "dim%d", i);
+        rd[i] = rrddim_add(st, name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+    }
+
+    for(c = 0; c < FEED ; c++) {
+        if(c) st->usec_since_last_update = USEC_PER_SEC;
+        for(i = 0; i < DIMS ; i++)
+            rrddim_set_by_pointer(st, rd[i], (c * 37 + i * 101) % 1000 + i);
+        rrdset_done(st);
+    }
+
+    RRDR *single[3];
+    for(m = 0; methods[m] != RRDR_GROUPING_UNDEFINED ; m++)
+        single[m] = rrd2rrdr(st, 20, 0, 0, methods[m], 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+
+    config_set_number(CONFIG_SECTION_WEB, "query threads", 2);
+    config_set_number(CONFIG_SECTION_WEB, "query parallel dimensions", 2);
+    rrd2rrdr_init_query_threads();
+
+    for(m = 0; methods[m] != RRDR_GROUPING_UNDEFINED ; m++) {
+        RRDR *r = rrd2rrdr(st, 20, 0, 0, methods[m], 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+        long n;
+
+        if(r->rows != single[m]->rows || r->before != single[m]->before || r->after != single[m]->after || r->min != single[m]->min || r->max != single[m]->max) {
+            fprintf(stderr, "    %s: got %ld rows from %ld to %ld, min " QUERY_NUMBER_FORMAT " max " QUERY_NUMBER_FORMAT
+                            ", expecting %ld rows from %ld to %ld, min " QUERY_NUMBER_FORMAT " max " QUERY_NUMBER_FORMAT " ### E R R O R ###\n",
+                    group_method2string(methods[m]), r->rows, (long)r->after, (long)r->before, r->min, r->max,
+                    single[m]->rows, (long)single[m]->after, (long)single[m]->before, single[m]->min, single[m]->max);
+            errors++;
+        }
+        else {
+            for(n = 0; n < r->rows * r->d ; n++) {
+                if(r->v[n] != single[m]->v[n] || r->o[n] != single[m]->o[n]) {
+                    fprintf(stderr, "    %s: value %ld of the chart is " QUERY_NUMBER_FORMAT ", expecting " QUERY_NUMBER_FORMAT " ### E R R O R ###\n",
+                            group_method2string(methods[m]), n, r->v[n], single[m]->v[n]);
+                    errors++;
+                    break;
+                }
+            }
+        }
+        rows += r->rows;
+
+        rrdr_free(r);
+        rrdr_free(single[m]);
+    }
+
+    config_set_number(CONFIG_SECTION_WEB, "query threads", 0);
+
+    fprintf(stderr, "    %d dimensions, %ld rows, %d errors\n", DIMS, rows, errors);
+    return errors;
+}
+
+// the cached output of a query should be the output of the query, until the chart is updated
+int test_query_cache(void) {
+    BUFFER *wb[3];
+    RRDSET *st;
+    RRDDIM *rd;
+    size_t hits, misses, hits_before, misses_before;
+    int i, c, errors = 0;
+
+    fprintf(stderr, "\nRunning query cache test\n");
+
+    st = rrdset_create_custom(localhost, "netdata", "unittest-query-cache", NULL, "netdata", NULL, "Unit Testing", "a value",
+                              "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, 100);
+    rd = rrddim_add(st, "dim", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+
+    for(c = 0; c < 20 ; c++) {
+        if(c) st->usec_since_last_update = USEC_PER_SEC;
+        rrddim_set_by_pointer(st, rd, c * 10);
+        rrdset_done(st);
+    }
+
+    rrdset2anything_cache_init();
+    rrdset2anything_cache_statistics(&hits_before, &misses_before);
+
+    for(i = 0; i < 3 ; i++) {
+        if(i == 2) {
+            st->usec_since_last_update = USEC_PER_SEC;
+            rrddim_set_by_pointer(st, rd, c * 10);
+            rrdset_done(st);
+        }
+
+        wb[i] = buffer_create(1024);
+        buffer_strcat(wb[i], "prefix(");
+        rrdset2anything_api_v1(st, wb[i], NULL, DATASOURCE_JSON, 10, -10, 0, RRDR_GROUPING_AVERAGE, 0, RRDR_OPTION_SECONDS, NULL);
+    }
+
+    rrdset2anything_cache_statistics(&hits, &misses);
+
+    if(hits - hits_before != 1 || misses - misses_before != 2) {
+        fprintf(stderr, "    the cache had %zu hits and %zu misses, expecting 1 hit and 2 misses ### E R R O R ###\n", hits - hits_before, misses - misses_before);
+        errors++;
+    }
+    if(strcmp(buffer_tostring(wb[0]), buffer_tostring(wb[1])) != 0) {
+        fprintf(stderr, "    the cached output is '%s', expecting '%s' ### E R R O R ###\n", buffer_tostring(wb[1]), buffer_tostring(wb[0]));
+        errors++;
+    }
+    if(strcmp(buffer_tostring(wb[1]), buffer_tostring(wb[2])) == 0) {
+        fprintf(stderr, "    the output did not change after the chart was updated ### E R R O R ###\n");
+        errors++;
+    }
+
+    for(i = 0; i < 3 ; i++)
+        buffer_free(wb[i]);
+
+    fprintf(stderr, "    %d errors\n", errors);
+    return errors;
+}
+
+// the queries that continue previous ones should return what the queries that run from scratch return
+int test_rrd2rrdr_incremental(void) {
+    const int DIMS = 4, FEED = 200, STEPS = 12;
+    RRDR_GROUPING methods[] = { RRDR_GROUPING_AVERAGE, RRDR_GROUPING_MAX, RRDR_GROUPING_MEDIAN, RRDR_GROUPING_INCREMENTAL_SUM, RRDR_GROUPING_UNDEFINED };
+    RRDDIM *rd[DIMS];
+    RRDSET *st;
+    size_t hits, rows_reused, hits_before, rows_reused_before;
+    int i, c, m, step, errors = 0;
+
+    fprintf(stderr, "\nRunning incremental query test\n");
+
+    rrd2rrdr_init_previous_results();
+    rrd2rrdr_previous_results_statistics(&hits_before, &rows_reused_before);
+
+    st = rrdset_create_custom(localhost, "netdata", "unittest-incremental", NULL, "netdata", NULL, "Unit Testing", "a value",
+                              "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, FEED * 2);
+    for(i = 0; i < DIMS ; i++) {
+        char name[101];
+        snprintfz(name, 100, "dim%d", i);
+        rd[i] = rrddim_add(st, name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+    }
+
+    for(c = 0, step = 0; step < STEPS ; step++) {
+        for( ; c < FEED + step ; c++) {
+            if(c) st->usec_since_last_update = USEC_PER_SEC;
+            for(i = 0; i < DIMS ; i++)
+                rrddim_set_by_pointer(st, rd[i], (c % 7) ? (c * 13 + i * 101) % 500 : 0);
+            rrdset_done(st);
+        }
+
+        for(m = 0; methods[m] != RRDR_GROUPING_UNDEFINED ; m++) {
+            char pattern[101];
+            long n;
+
+            // the dimensions pattern makes the key unique, so that this one runs from scratch
+            snprintfz(pattern, 100, "*|unittest-%d", step);
+
+            RRDR *r = rrd2rrdr(st, 30, -120, 0, methods[m], 0, 0, NULL);
+            RRDR *expected = rrd2rrdr(st, 30, -120, 0, methods[m], 0, 0, pattern);
+
+            if(r->rows != expected->rows || r->before != expected->before || r->after != expected->after
+               || r->min != expected->min || r->max != expected->max) {
+                fprintf(stderr, "    %s, step %d: got %ld rows from %ld to %ld, min " QUERY_NUMBER_FORMAT " max " QUERY_NUMBER_FORMAT
+                                ", expecting %ld rows from %ld to %ld, min " QUERY_NUMBER_FORMAT " max " QUERY_NUMBER_FORMAT " ### E R R O R ###\n",
+                        group_method2string(methods[m]), step, r->rows, (long)r->after, (long)r->before, r->min, r->max,
+                        expected->rows, (long)expected->after, (long)expected->before, expected->min, expected->max);
+                errors++;
+            }
+            else {
+                for(n = 0; n < r->rows ; n++) {
+                    if(r->t[n] != expected->t[n]) {
+                        fprintf(stderr, "    %s, step %d: row %ld is at %ld, expecting %ld ### E R R O R ###\n",
+                                group_method2string(methods[m]), step, n, (long)r->t[n], (long)expected->t[n]);
+                        errors++;
+                        break;
+                    }
+                }
+                for(n = 0; n < r->rows * r->d ; n++) {
+                    if(r->v[n] != expected->v[n] || r->o[n] != expected->o[n]) {
+                        fprintf(stderr, "    %s, step %d: value %ld is " QUERY_NUMBER_FORMAT ", expecting " QUERY_NUMBER_FORMAT " ### E R R O R ###\n",
+                                group_method2string(methods[m]), step, n, r->v[n], expected->v[n]);
+                        errors++;
+                        break;
+                    }
+                }
+                for(n = 0; n < r->d ; n++) {
+                    if(r->od[n] != expected->od[n]) {
+                        fprintf(stderr, "    %s, step %d: dimension %ld has flags %u, expecting %u ### E R R O R ###\n",
+                                group_method2string(methods[m]), step, n, (unsigned)r->od[n], (unsigned)expected->od[n]);
+                        errors++;
+                    }
+                }
+            }
+
+            rrdr_free(expected);
+            rrdr_free(r);
+        }
+    }
+
+    rrd2rrdr_previous_results_statistics(&hits, &rows_reused);
+    if(hits == hits_before) {
+        fprintf(stderr, "    no query continued a previous one ### E R R O R ###\n");
+        errors++;
+    }
+
+    fprintf(stderr, "    %zu queries continued previous ones, reusing %zu rows, %d errors\n", hits - hits_before, rows_reused - rows_reused_before, errors);
+    return errors;
+}
+
+// the queries of dimensions with summaries should return what the queries of the same values without summaries return,
+// reading fewer points; the chart wraps around its round robin database, so that summaries are calculated again
+int test_rrddim_summaries(void) {
+    const int DIMS = 3, FEED = 2600;
+    const long ENTRIES = 1000;
+    RRDR_GROUPING methods[] = { RRDR_GROUPING_AVERAGE, RRDR_GROUPING_MIN, RRDR_GROUPING_MAX, RRDR_GROUPING_SUM, RRDR_GROUPING_MEDIAN, RRDR_GROUPING_UNDEFINED };
+    struct { long points; long after; } queries[] = { { 5, 0 }, { 7, -600 }, { 100, 0 }, { 3, -40 }, { 0, 0 } };
+    RRDDIM *rd[2][DIMS];
+    RRDSET *st[2];
+    size_t read[2] = { 0, 0 };
+    int i, c, m, q, errors = 0, blocked = default_rrd_ram_blocked, summaries = default_rrd_ram_summaries;
+
+    fprintf(stderr, "\nRunning dimension summaries test\n");
+
+    for(c = 0; c < 2 ; c++) {
+        // the dimensions with summaries are also column-blocked
+        default_rrd_ram_blocked = default_rrd_ram_summaries = c;
+        st[c] = rrdset_create_custom(localhost, "netdata", c ? "unittest-summaries" : "unittest-no-summaries", NULL, "netdata", NULL,
+                                     "Unit Testing", "a value", "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_RAM, ENTRIES);
+        for(i = 0; i < DIMS ; i++) {
+            char name[101];
+            snprintfz(name, 100, "dim%d", i);
+            rd[c][i] = rrddim_add(st[c], name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+        }
+    }
+    default_rrd_ram_blocked = blocked;
+    default_rrd_ram_summaries = summaries;
+
+    if(!rd[1][0]->state->summaries || rd[0][0]->state->summaries) {
+        fprintf(stderr, "    the summaries of the dimensions are not the expected ones ### E R R O R ###\n");
+        return 1;
+    }
+
+    for(c = 0; c < FEED ; c++) {
+        int j;
+        for(j = 0; j < 2 ; j++) {
+            if(c) st[j]->usec_since_last_update = USEC_PER_SEC;
+            for(i = 0; i < DIMS ; i++) {
+                // leave some gaps
+                if((c + i) % 53)
+                    rrddim_set_by_pointer(st[j], rd[j][i], (c * 37 + i * 101) % 1000 - 300 * i);
+            }
+            rrdset_done(st[j]);
+        }
+    }
+
+    for(q = 0; queries[q].points ; q++) {
+        for(m = 0; methods[m] != RRDR_GROUPING_UNDEFINED ; m++) {
+            RRDR *r[2];
+            long n;
+
+            for(c = 0; c < 2 ; c++) {
+                r[c] = rrd2rrdr(st[c], queries[q].points, queries[q].after, 0, methods[m], 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+                read[c] += r[c]->internal.db_points_read;
+            }
+
+            if(r[1]->rows != r[0]->rows || r[1]->d != r[0]->d) {
+                fprintf(stderr, "    %s, %ld points: got %ld rows, expecting %ld ### E R R O R ###\n",
+                        group_method2string(methods[m]), queries[q].points, r[1]->rows, r[0]->rows);
+                errors++;
+            }
+            else {
+                for(n = 0; n < r[0]->rows * r[0]->d ; n++) {
+                    calculated_number v = r[1]->v[n], expected = r[0]->v[n];
+
+                    // the summaries add the values in a different order
+                    if(r[1]->o[n] != r[0]->o[n] || calculated_number_fabs(v - expected) > 0.000001 * (calculated_number_fabs(expected) + 1)) {
+                        fprintf(stderr, "    %s, %ld points: value %ld is " CALCULATED_NUMBER_FORMAT " with flags %u, expecting " CALCULATED_NUMBER_FORMAT " with flags %u ### E R R O R ###\n",
+                                group_method2string(methods[m]), queries[q].points, n, v, (unsigned)r[1]->o[n], expected, (unsigned)r[0]->o[n]);
+                        errors++;
+                        break;
+                    }
+                }
+            }
+
+            rrdr_free(r[0]);
+            rrdr_free(r[1]);
+        }
+    }
+
+    if(read[1] >= read[0]) {
+        fprintf(stderr, "    the queries with summaries read %zu points, without them %zu ### E R R O R ###\n", read[1], read[0]);
+        errors++;
+    }
+
+    fprintf(stderr, "    %zu points read with summaries, %zu without them, %d errors\n", read[1], read[0], errors);
+    return errors;
+}
+
+// the JSON of a query should have the names of the dimensions escaped, in the labels and in the keys of the values
+int test_rrdr2json(void) {
+    const char *names[] = { "quote\"d", "back\\slash", "plain" };
+    const char *escaped[] = { "quote\\\"d", "back\\\\slash", "plain" };
+    const int DIMS = 3;
+    RRDDIM *rd[DIMS];
+    BUFFER *wb = buffer_create(10), *expected = buffer_create(10);
+    int i, c, errors = 0;
+    long n;
+
+    fprintf(stderr, "\nRunning JSON formatter test\n");
+
+    RRDSET *st = rrdset_create_custom(localhost, "netdata", "unittest-json", NULL, "netdata", NULL, "Unit Testing", "a value",
+                                      "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, 20);
+    for(i = 0; i < DIMS ; i++)
+        rd[i] = rrddim_add(st, names[i], NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+
+    for(c = 0; c < 10 ; c++) {
+        if(c) st->usec_since_last_update = USEC_PER_SEC;
+        for(i = 0; i < DIMS ; i++)
+            rrddim_set_by_pointer(st, rd[i], c * 10 - i * 25);
+        rrdset_done(st);
+    }
+
+    rrdset_rdlock(st);
+    RRDR *r = rrd2rrdr(st, 4, -4, 0, RRDR_GROUPING_AVERAGE, 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+    rrdr2json(r, wb, RRDR_OPTION_OBJECTSROWS, 0);
+
+    buffer_strcat(expected, "{\n \"labels\": [\"time\"");
+    for(i = 0; i < DIMS ; i++)
+        buffer_sprintf(expected, ", \"%s\"", escaped[i]);
+    buffer_strcat(expected, "],\n    \"data\":\n [\n");
+    for(n = rrdr_rows(r) - 1; n >= 0 ; n--) {
+        buffer_sprintf(expected, "      { \"time\": %ld", (long)r->t[n]);
+        for(i = 0; i < DIMS ; i++) {
+            buffer_sprintf(expected, ", \"%s\": ", escaped[i]);
+            if(r->o[n * r->d + i] & RRDR_VALUE_EMPTY)
+                buffer_strcat(expected, "null");
+            else
+                buffer_rrd_value(expected, r->v[n * r->d + i]);
+        }
+        buffer_strcat(expected, (n) ? "},\n" : "}");
+    }
+    buffer_strcat(expected, "\n  ]\n}");
+
+    if(strcmp(buffer_tostring(wb), buffer_tostring(expected)) != 0) {
+        fprintf(stderr, "    got:\n%s\n    expecting:\n%s\n    ### E R R O R ###\n", buffer_tostring(wb), buffer_tostring(expected));
+        errors++;
+    }
+
+    n = rrdr_rows(r);
+    rrdr_free(r);
+    rrdset_unlock(st);
+
+    fprintf(stderr, "    %ld rows, %zu bytes, %d errors\n", n, buffer_strlen(wb), errors);
+    buffer_free(wb);
+    buffer_free(expected);
+    return errors;
+}
+
+static uint64_t test_binary_uint64(const unsigned char *s, int bytes) {
+    uint64_t v = 0;
+    while(bytes--) v = (v << 8) | s[bytes];
+    return v;
+}
+
+// the binary format of a query should have the values of the query, column by column
+int test_rrdr2binary(void) {
+    const int DIMS = 3;
+    RRDDIM *rd[DIMS];
+    int i, c, f, errors = 0;
+    long n, rows = 0;
+
+    fprintf(stderr, "\nRunning binary formatter test\n");
+
+    RRDSET *st = rrdset_create_custom(localhost, "netdata", "unittest-binary", NULL, "netdata", NULL, "Unit Testing", "a value",
+                                      "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, 30);
+    for(i = 0; i < DIMS ; i++) {
+        char name[101];
+        snprintfz(name, 100, "dim%d", i);
+        rd[i] = rrddim_add(st, name, NULL, 1, 3, RRD_ALGORITHM_ABSOLUTE);
+    }
+
+    for(c = 0; c < 20 ; c++) {
+        if(c) st->usec_since_last_update = USEC_PER_SEC;
+        for(i = 0; i < DIMS ; i++) {
+            // leave a gap in the first dimension
+            if(i || c != 15)
+                rrddim_set_by_pointer(st, rd[i], c * 7 - i * 40);
+        }
+        rrdset_done(st);
+    }
+
+    rrdset_rdlock(st);
+    RRDR *r = rrd2rrdr(st, 10, -10, 0, RRDR_GROUPING_AVERAGE, 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+
+    for(f = 0; f < 2 ; f++) {
+        BUFFER *wb = buffer_create(10);
+        rrdr2binary(r, wb, RRDR_OPTION_REVERSED, f);
+
+        const unsigned char *s = (const unsigned char *)wb->buffer;
+        size_t header_size = test_binary_uint64(&s[8], 4), value_size = test_binary_uint64(&s[20], 4);
+        rows = (long)test_binary_uint64(&s[12], 4);
+        long dims = (long)test_binary_uint64(&s[16], 4);
+
+        if(strcmp((const char *)s, RRDR_BINARY_MAGIC) != 0 || rows != rrdr_rows(r) || dims != DIMS || value_size != (f ? 4 : 8)
+           || (time_t)test_binary_uint64(&s[24], 8) != r->after || (time_t)test_binary_uint64(&s[32], 8) != r->before
+           || buffer_strlen(wb) != header_size + rows * 8 + rows * dims * value_size
+           || test_binary_uint64(&s[RRDR_BINARY_HEADER_SIZE], 4) != 4 || memcmp(&s[RRDR_BINARY_HEADER_SIZE + 4], "dim0", 4) != 0) {
+            fprintf(stderr, "    the header of the %zu byte values is wrong ### E R R O R ###\n", value_size);
+            errors++;
+            buffer_free(wb);
+            continue;
+        }
+
+        for(n = 0; n < rows ; n++) {
+            if((time_t)test_binary_uint64(&s[header_size + n * 8], 8) != r->t[n]) {
+                fprintf(stderr, "    row %ld is at %" PRIu64 ", expecting %ld ### E R R O R ###\n", n, test_binary_uint64(&s[header_size + n * 8], 8), (long)r->t[n]);
+                errors++;
+            }
+
+            for(i = 0; i < DIMS ; i++) {
+                const unsigned char *v = &s[header_size + rows * 8 + (i * rows + n) * value_size];
+                uint64_t bits = test_binary_uint64(v, (int)value_size);
+                calculated_number value, expected = r->v[n * r->d + i];
+
+                if(f) {
+                    uint32_t b = (uint32_t)bits;
+                    float fl;
+                    memcpy(&fl, &b, sizeof(fl));
+                    value = fl;
+                    expected = (float)expected;
+                }
+                else {
+                    double d;
+                    memcpy(&d, &bits, sizeof(d));
+                    value = d;
+                    expected = (double)expected;
+                }
+
+                if(r->o[n * r->d + i] & RRDR_VALUE_EMPTY)
+                    expected = NAN;
+
+                if(isnan(expected) ? !isnan(value) : value != expected) {
+                    fprintf(stderr, "    %zu byte values: row %ld of %s is " CALCULATED_NUMBER_FORMAT ", expecting " CALCULATED_NUMBER_FORMAT " ### E R R O R ###\n",
+                            value_size, n, rd[i]->name, value, expected);
+                    errors++;
+                }
+            }
+        }
+
+        buffer_free(wb);
+    }
+
+    rrdr_free(r);
+    rrdset_unlock(st);
+
+    fprintf(stderr, "    %ld rows, %d errors\n", rows, errors);
+    return errors;
+}
+
+// the allmetrics responses generated while they are sent should be the same with the ones generated at once
+int test_allmetrics_stream(void) {
+    const char *formats[] = { "shell", "json", NULL };
+    int c, i, f, errors = 0;
+
+    fprintf(stderr, "\nRunning allmetrics streaming test\n");
+
+    for(c = 0; c < 400 ; c++) {
+        char id[101];
+        snprintfz(id, 100, "unittest-allmetrics-%d", c);
+        RRDSET *st = rrdset_create_custom(localhost, "netdata", id, NULL, "netdata", NULL, "Unit Testing", "a value",
+                                          "unittest", NULL, 1, 1, RRDSET_TYPE_LINE, RRD_MEMORY_MODE_ALLOC, 5);
+        for(i = 0; i < 4 ; i++) {
+            char name[101];
+            snprintfz(name, 100, "dimension%d", i);
+            rrddim_set_by_pointer(st, rrddim_add(st, name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE), c * 4 + i);
+        }
+        rrdset_done(st);
+    }
+
+    for(f = 0; formats[f] ; f++) {
+        struct web_client *w = callocz(1, sizeof(struct web_client));
+        w->response.data = buffer_create(NETDATA_WEB_RESPONSE_INITIAL_SIZE);
+        BUFFER *expected = buffer_create(NETDATA_WEB_RESPONSE_INITIAL_SIZE);
+        BUFFER *streamed = buffer_create(NETDATA_WEB_RESPONSE_INITIAL_SIZE);
+        size_t parts = 0;
+
+        if(!strcmp(formats[f], "shell"))
+            rrd_stats_api_v1_charts_allmetrics_shell(localhost, expected);
+        else
+            rrd_stats_api_v1_charts_allmetrics_json(localhost, expected);
+
+        char url[101];
+        snprintfz(url, 100, "format=%s", formats[f]);
+        web_client_api_request_v1_allmetrics(localhost, w, url);
+
+        // send the response, the way the web server does
+        for(;;) {
+            buffer_strcat(streamed, buffer_tostring(w->response.data));
+            buffer_flush(w->response.data);
+            parts++;
+
+            if(!w->response.producer) break;
+            if(!w->response.producer(w, w->response.producer_data)) {
+                w->response.producer_free(w->response.producer_data);
+                w->response.producer = NULL;
+            }
+        }
+
+        fprintf(stderr, "    format %s: %zu bytes in %zu parts\n", formats[f], buffer_strlen(streamed), parts);
+
+        if(parts < 3 || buffer_strlen(streamed) != buffer_strlen(expected) || strcmp(buffer_tostring(streamed), buffer_tostring(expected)) != 0) {
+            fprintf(stderr, "    format %s: the streamed response is not the expected one (%zu bytes expected) ### E R R O R ###\n", formats[f], buffer_strlen(expected));
+            errors++;
+        }
+
+        buffer_free(streamed);
+        buffer_free(expected);
+        buffer_free(w->response.data);
+        freez(w);
+    }
+
+    if(errors)
+        fprintf(stderr, "\nallmetrics streaming test: %d errors\n", errors);
+    else
+        fprintf(stderr, "\nallmetrics streaming test: OK\n");
+
+    return errors;
+}
+
 int unit_test_str2ld() {
     char *values[] = {
             "1.2345678", "-35.6", "0.00123", "23842384234234.2", ".1", "1.2e-10",
@@ -403,17 +1395,55 @@ int unit_test_buffer() {
 
     const char *s = buffer_tostring(wb);
 
-    if(buffer_strlen(wb) != strlen(final) || strcmp(s, final) != 0) {
-        fprintf(stderr, "\nbuffer_sprintf() is faulty.\n");
-        fprintf(stderr, "\nstring  : %s (length %zu)\n", string, strlen(string));
-        fprintf(stderr, "\nbuffer  : %s (length %zu)\n", s, buffer_strlen(wb));
-        fprintf(stderr, "\nexpected: %s (length %zu)\n", final, strlen(final));
-        buffer_free(wb);
+    if(buffer_strlen(wb) != strlen(final) || strcmp(s, final) != 0) {
+        fprintf(stderr, "\nbuffer_sprintf() is faulty.\n");
+        fprintf(stderr, "\nstring  : %s (length %zu)\n", string, strlen(string));
+        fprintf(stderr, "\nbuffer  : %s (length %zu)\n", s, buffer_strlen(wb));
+        fprintf(stderr, "\nexpected: %s (length %zu)\n", final, strlen(final));
+        buffer_free(wb);
+        return -1;
+    }
+
+    fprintf(stderr, "buffer_sprintf() works as expected.\n");
+    buffer_free(wb);
+    return 0;
+}
+
+int unit_test_string_pool() {
+    char copy[100];
+    size_t entries = string_pool_entries();
+
+    strcpy(copy, "unittest-string");
+    const char *s1 = string_pool_get("unittest-string");
+    const char *s2 = string_pool_get(copy);
+    const char *s3 = string_pool_dup(s1);
+    const char *other = string_pool_get("unittest-other-string");
+
+    if(!string_pool_equal(s1, s2) || !string_pool_equal(s1, s3) || string_pool_equal(s1, other) || strcmp(s1, copy) != 0) {
+        fprintf(stderr, "\nstring_pool_get() does not return one copy of every string.\n");
+        return -1;
+    }
+
+    if(string_pool_entries() != entries + 2) {
+        fprintf(stderr, "\nstring pool has %zu new strings, expecting 2.\n", string_pool_entries() - entries);
+        return -1;
+    }
+
+    string_pool_release(s1);
+    string_pool_release(s2);
+    string_pool_release(other);
+    if(string_pool_entries() != entries + 1) {
+        fprintf(stderr, "\nstring pool freed a string that is still referenced, or kept one that is not.\n");
+        return -1;
+    }
+
+    string_pool_release(s3);
+    if(string_pool_entries() != entries) {
+        fprintf(stderr, "\nstring pool did not free a string without references.\n");
         return -1;
     }
 
-    fprintf(stderr, "buffer_sprintf() works as expected.\n");
-    buffer_free(wb);
+    fprintf(stderr, "string pool works as expected.\n");
     return 0;
 }
 
@@ -1596,13 +2626,21 @@ int test_dbengine(void)
     time_t time_now;
     collected_number last;
     struct rrddim_query_handle handle;
-    calculated_number value, expected;
+    calculated_number value, expected, min, max, sum;
     storage_number n;
+    int storage_tiers, retention_classes;
+    unsigned tier, series, points, summarized;
+    time_t interval, first;
+    struct rrdeng_page_summary summary;
 
     error_log_limit_unlimited();
     fprintf(stderr, "\nRunning DB-engine test\n");
 
     default_rrd_memory_mode = RRD_MEMORY_MODE_DBENGINE;
+    storage_tiers = default_rrdeng_storage_tiers;
+    default_rrdeng_storage_tiers = RRDENG_MAX_TIERS;
+    retention_classes = default_rrdeng_retention_classes;
+    default_rrdeng_retention_classes = 2;
 
     debug(D_RRDHOST, "Initializing localhost with hostname 'unittest-dbengine'");
     host = rrdhost_find_or_create(
@@ -1624,6 +2662,8 @@ int test_dbengine(void)
             , default_rrdpush_send_charts_matching
             , NULL
     );
+    default_rrdeng_storage_tiers = storage_tiers;
+    default_rrdeng_retention_classes = retention_classes;
     if (NULL == host)
         return 1;
 
@@ -1635,6 +2675,8 @@ int test_dbengine(void)
                 NULL, 1, 1, RRDSET_TYPE_LINE);
         rrdset_flag_set(st[i], RRDSET_FLAG_DEBUG);
         rrdset_flag_set(st[i], RRDSET_FLAG_STORE_FIRST);
+        // every other chart is stored in the second retention class
+        st[i]->rrdeng_retention_class = 1 + i % 2;
         for (j = 0 ; j < DIMS ; ++j) {
             snprintfz(name, 100, "dim-%d", j);
 
@@ -1673,12 +2715,12 @@ int test_dbengine(void)
         time_now = c + 2;
         for (i = 0 ; i < CHARTS ; ++i) {
             for (j = 0; j < DIMS; ++j) {
-                rd[i][j]->state->query_ops.init(rd[i][j], &handle, time_now, time_now + QUERY_BATCH);
+                rd[i][j]->state->query_ops->init(rd[i][j], &handle, time_now, time_now + QUERY_BATCH);
                 for (k = 0; k < QUERY_BATCH; ++k) {
                     last = i * DIMS * POINTS + j * POINTS + c + k;
                     expected = unpack_storage_number(pack_storage_number((calculated_number)last, SN_EXISTS));
 
-                    n = rd[i][j]->state->query_ops.next_metric(&handle);
+                    n = rd[i][j]->state->query_ops->next_metric(&handle);
                     value = unpack_storage_number(n);
 
                     same = (calculated_number_round(value * 10000000.0) == calculated_number_round(expected * 10000000.0)) ? 1 : 0;
@@ -1689,12 +2731,104 @@ int test_dbengine(void)
                         errors++;
                     }
                 }
-                rd[i][j]->state->query_ops.finalize(&handle);
+                rd[i][j]->state->query_ops->finalize(&handle);
+            }
+        }
+    }
+
+    // check the page summaries of the first dimension, only the pages being collected have none
+    for (i = 0 ; i < CHARTS ; ++i) {
+        summarized = 0;
+        time_now = 2;
+        rd[i][0]->state->query_ops->init(rd[i][0], &handle, time_now, POINTS + 1);
+        while (time_now <= POINTS + 1) {
+            points = rrdeng_load_metric_next_summary(&handle, POINTS + 1, &summary);
+            if (!points) {
+                (void)rd[i][0]->state->query_ops->next_metric(&handle);
+                ++time_now;
+                continue;
+            }
+            min = max = sum = 0;
+            for (k = 0 ; k < (int)points ; ++k) {
+                last = i * DIMS * POINTS + time_now + k - 2;
+                value = unpack_storage_number(pack_storage_number((calculated_number)last, SN_EXISTS));
+                if (k == 0)
+                    min = max = value;
+                min = MIN(min, value);
+                max = MAX(max, value);
+                sum += value;
+            }
+            if (summary.count != points || unpack_storage_number(summary.min) != min ||
+                unpack_storage_number(summary.max) != max ||
+                calculated_number_round(summary.sum) != calculated_number_round(sum)) {
+                fprintf(stderr, "    DB-engine unittest %s/%s: page summary at %lu secs, expecting %u points min "
+                                CALCULATED_NUMBER_FORMAT " max " CALCULATED_NUMBER_FORMAT " sum " CALCULATED_NUMBER_FORMAT
+                                ", found %u points min " CALCULATED_NUMBER_FORMAT " max " CALCULATED_NUMBER_FORMAT
+                                " sum " CALCULATED_NUMBER_FORMAT ", ### E R R O R ###\n",
+                        st[i]->name, rd[i][0]->name, (unsigned long)time_now, points, min, max, sum, summary.count,
+                        unpack_storage_number(summary.min), unpack_storage_number(summary.max),
+                        (calculated_number)summary.sum);
+                errors++;
+            }
+            ++summarized;
+            time_now += points;
+        }
+        rd[i][0]->state->query_ops->finalize(&handle);
+        if (!summarized) {
+            fprintf(stderr, "    DB-engine unittest %s/%s: no page has a summary, ### E R R O R ###\n",
+                    st[i]->name, rd[i][0]->name);
+            errors++;
+        }
+    }
+
+    // check the rollups of the higher storage tiers, only complete intervals have been stored
+    for (tier = 2 ; tier <= RRDENG_MAX_TIERS ; ++tier) {
+        interval = (tier == 2) ? 60 : 3600;
+        for (i = 0 ; i < CHARTS ; ++i) {
+            for (j = 0; j < DIMS; ++j) {
+                for (series = 0 ; series < RRDENG_ROLLUP_SERIES ; ++series) {
+                    // the first point is at time 2, so the first interval has one point less
+                    time_now = interval;
+                    rrdeng_load_rollup_init(rd[i][j], &handle, tier, series, time_now, (POINTS + 1) / interval * interval);
+                    for ( ; time_now <= POINTS + 1 - interval ; time_now += interval) {
+                        first = MAX(time_now - interval + 1, 2);
+                        sum = 0;
+                        for (k = first ; k <= time_now ; ++k) {
+                            last = i * DIMS * POINTS + j * POINTS + k - 2;
+                            value = unpack_storage_number(pack_storage_number((calculated_number)last, SN_EXISTS));
+                            if (k == first)
+                                min = max = value;
+                            min = MIN(min, value);
+                            max = MAX(max, value);
+                            sum += value;
+                        }
+                        if (RRDENG_ROLLUP_MIN == series)
+                            expected = min;
+                        else if (RRDENG_ROLLUP_MAX == series)
+                            expected = max;
+                        else if (RRDENG_ROLLUP_SUM == series)
+                            expected = sum;
+                        else
+                            expected = time_now - first + 1;
+                        expected = unpack_storage_number(pack_storage_number(expected, SN_EXISTS));
+
+                        n = rrdeng_load_metric_next(&handle);
+                        value = unpack_storage_number(n);
+                        if (!does_storage_number_exist(n) || value != expected) {
+                            fprintf(stderr, "    DB-engine unittest %s/%s: tier %u series %u at %lu secs, expecting value "
+                                            CALCULATED_NUMBER_FORMAT ", found " CALCULATED_NUMBER_FORMAT ", ### E R R O R ###\n",
+                                    st[i]->name, rd[i][j]->name, tier, series, (unsigned long)time_now, expected, value);
+                            errors++;
+                        }
+                    }
+                    rrdeng_load_metric_finalize(&handle);
+                }
             }
         }
     }
 
     rrdeng_exit(host->rrdeng_ctx);
+    host->rrdeng_ctx = NULL;
     rrd_wrlock();
     rrdhost_delete_charts(host);
     rrd_unlock();
@@ -1777,4 +2911,796 @@ void generate_dbengine_dataset(unsigned history_seconds)
     rrd_unlock();
 
 }
-#endif
\ No newline at end of file
+
+// ----------------------------------------------------------------------------
+// dbengine benchmark
+//
+// -W dbengine-bench=hosts=N,charts=N,dimensions=N,seconds=N,update_every=N,threads=N,queries=N
+//
+// Every host gets its own ingest thread, that stores seconds of its charts at update_every,
+// as fast as it can. Then the query threads run the queries, a mix of short and long ranges
+// and of grouping methods. The values and the queries depend only on the parameters, so the
+// same parameters give the same workload, to compare the numbers of different builds.
+
+struct dbengine_bench {
+    int hosts;
+    int charts;                         // per host
+    int dimensions;                     // per chart
+    int update_every;
+    int threads;                        // the query threads
+    time_t seconds;                     // the history to store
+    size_t queries;
+
+    RRDSET **st;                        // the charts of all the hosts
+    time_t first_t, last_t;
+
+    size_t next_query;                  // the query threads take the queries in order
+    usec_t *latencies;                  // of every query
+    size_t errors;
+};
+
+struct dbengine_bench_ingest {
+    struct dbengine_bench *b;
+    int host;
+    netdata_thread_t thread;
+};
+
+static const RRDR_GROUPING dbengine_bench_groupings[] = {
+        RRDR_GROUPING_AVERAGE, RRDR_GROUPING_MAX, RRDR_GROUPING_SUM, RRDR_GROUPING_MEDIAN, RRDR_GROUPING_STDDEV
+};
+
+static void *dbengine_bench_ingest_thread(void *ptr) {
+    struct dbengine_bench_ingest *bi = ptr;
+    struct dbengine_bench *b = bi->b;
+    RRDSET **st = &b->st[bi->host * b->charts];
+    RRDDIM *rd;
+    time_t t;
+    int i, j;
+
+    for(t = b->first_t + b->update_every; t <= b->last_t ; t += b->update_every) {
+        for(i = 0; i < b->charts ; i++) {
+            st[i]->usec_since_last_update = b->update_every * USEC_PER_SEC;
+
+            // slowly changing values, different for every dimension
+            for(rd = st[i]->dimensions, j = 0; rd ; rd = rd->next, j++)
+                rrddim_set_by_pointer_fake_time(rd, (t / b->update_every + i * 31) % (100 + j * 7) + j * 1000, t);
+
+            rrdset_done(st[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static void *dbengine_bench_query_thread(void *ptr) {
+    struct dbengine_bench *b = ptr;
+    time_t history = b->last_t - b->first_t;
+    size_t q;
+
+    while((q = __atomic_fetch_add(&b->next_query, 1, __ATOMIC_RELAXED)) < b->queries) {
+        RRDSET *st = b->st[(q * 7919) % ((size_t)b->hosts * b->charts)];
+        RRDR_GROUPING group = dbengine_bench_groupings[(q / 4) % (sizeof(dbengine_bench_groupings) / sizeof(RRDR_GROUPING))];
+
+        // half of the queries are of the last 10 minutes, a quarter of a random hour, and a quarter of all the history
+        time_t duration, before = b->last_t;
+        switch(q % 4) {
+            case 0:
+            case 1:
+                duration = 600;
+                break;
+
+            case 2:
+                duration = 3600;
+                if(history > duration)
+                    before -= (time_t)((q * 104729) % (size_t)(history - duration));
+                break;
+
+            default:
+                duration = history;
+                break;
+        }
+        if(duration > history) duration = history;
+
+        usec_t started_ut = now_monotonic_usec();
+        RRDR *r = rrd2rrdr(st, 300, before - duration, before, group, 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+        b->latencies[q] = now_monotonic_usec() - started_ut;
+
+        if(unlikely(!r || !r->rows))
+            __atomic_add_fetch(&b->errors, 1, __ATOMIC_RELAXED);
+
+        if(r) rrdr_free(r);
+    }
+
+    return NULL;
+}
+
+// the statistics of all the dbengine instances of the hosts, counted once each
+static void dbengine_bench_statistics(struct dbengine_bench *b, unsigned long long *stats) {
+    unsigned long long array[RRDENG_NR_STATS];
+    int h, i, k;
+
+    memset(stats, 0, sizeof(*stats) * RRDENG_NR_STATS);
+    for(h = 0; h < b->hosts ; h++) {
+        struct rrdengine_instance *ctx = b->st[h * b->charts]->rrdhost->rrdeng_ctx;
+
+        for(i = 0; i < h && b->st[i * b->charts]->rrdhost->rrdeng_ctx != ctx ; i++) ;
+        if(!ctx || i < h) continue;
+
+        rrdeng_get_38_statistics(ctx, array);
+        for(k = 0; k < RRDENG_NR_STATS ; k++)
+            stats[k] += array[k];
+    }
+}
+
+static int dbengine_bench_latency_compare(const void *a, const void *b) {
+    usec_t x = *(const usec_t *)a, y = *(const usec_t *)b;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void dbengine_bench_print_rate(const char *what, unsigned long long count, usec_t duration_ut) {
+    if(!duration_ut) duration_ut = 1;
+    fprintf(stderr, " > %-32s %llu per second\n", what, count * USEC_PER_SEC / duration_ut);
+}
+
+int dbengine_benchmark(const char *parameters) {
+    struct dbengine_bench b = {
+            .hosts = 1,
+            .charts = 100,
+            .dimensions = 10,
+            .update_every = 1,
+            .threads = 4,
+            .seconds = 86400,
+            .queries = 10000,
+    };
+    char *s = strdupz(parameters), *p = s, *name;
+    int h, i, j;
+
+    while(p && (name = mystrsep(&p, ",")) && *name) {
+        char *value = strchr(name, '=');
+        if(!value) continue;
+        *value++ = '\0';
+
+        long long n = str2ll(value, NULL);
+        if(n < 1) {
+            fprintf(stderr, "dbengine benchmark: invalid value '%s' of '%s'\n", value, name);
+            freez(s);
+            return 1;
+        }
+
+        if(!strcmp(name, "hosts")) b.hosts = (int)n;
+        else if(!strcmp(name, "charts")) b.charts = (int)n;
+        else if(!strcmp(name, "dimensions")) b.dimensions = (int)n;
+        else if(!strcmp(name, "seconds")) b.seconds = (time_t)n;
+        else if(!strcmp(name, "update_every")) b.update_every = (int)n;
+        else if(!strcmp(name, "threads")) b.threads = (int)n;
+        else if(!strcmp(name, "queries")) b.queries = (size_t)n;
+        else {
+            fprintf(stderr, "dbengine benchmark: unknown parameter '%s'\n", name);
+            freez(s);
+            return 1;
+        }
+    }
+    freez(s);
+
+    error_log_limit_unlimited();
+    default_rrd_memory_mode = RRD_MEMORY_MODE_DBENGINE;
+
+    fprintf(stderr, "\nRunning DB-engine benchmark: %d hosts x %d charts x %d dimensions, %ld seconds every %d seconds, "
+                    "%zu queries in %d threads\n", b.hosts, b.charts, b.dimensions, (long)b.seconds, b.update_every, b.queries, b.threads);
+
+    b.st = callocz((size_t)b.hosts * b.charts, sizeof(RRDSET *));
+    b.last_t = now_realtime_sec() / b.update_every * b.update_every;
+    b.first_t = b.last_t - b.seconds / b.update_every * b.update_every;
+
+    for(h = 0; h < b.hosts ; h++) {
+        char hostname[101];
+        snprintfz(hostname, 100, "dbengine-bench-%d", h);
+
+        RRDHOST *host = rrdhost_find_or_create(
+                hostname
+                , hostname
+                , hostname
+                , os_type
+                , netdata_configured_timezone
+                , ""
+                , program_name
+                , program_version
+                , b.update_every
+                , default_rrd_history_entries
+                , RRD_MEMORY_MODE_DBENGINE
+                , 0
+                , 0
+                , NULL
+                , NULL
+                , NULL
+                , NULL
+        );
+        if(!host) {
+            fprintf(stderr, "dbengine benchmark: cannot create host '%s'\n", hostname);
+            return 1;
+        }
+
+        for(i = 0; i < b.charts ; i++) {
+            char name[101];
+            snprintfz(name, 100, "chart%d", i);
+
+            RRDSET *st = rrdset_create(host, "bench", name, name, "bench", NULL, "Benchmark", "value", "bench",
+                                       NULL, 1, b.update_every, RRDSET_TYPE_LINE);
+            for(j = 0; j < b.dimensions ; j++) {
+                snprintfz(name, 100, "dim%d", j);
+                rrddim_add(st, name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+            }
+
+            RRDDIM *rd;
+            st->last_collected_time.tv_sec = st->last_updated.tv_sec = b.first_t;
+            st->last_collected_time.tv_usec = st->last_updated.tv_usec = 0;
+            for(rd = st->dimensions; rd ; rd = rd->next) {
+                rd->last_collected_time.tv_sec = b.first_t;
+                rd->last_collected_time.tv_usec = 0;
+            }
+
+            b.st[h * b.charts + i] = st;
+        }
+    }
+
+    unsigned long long before[RRDENG_NR_STATS], after[RRDENG_NR_STATS];
+
+    // ------------------------------------------------------------------------
+    // ingest, every host in a thread of its own
+
+    struct dbengine_bench_ingest *bi = callocz((size_t)b.hosts, sizeof(struct dbengine_bench_ingest));
+    unsigned long long points = (unsigned long long)b.hosts * b.charts * b.dimensions * (unsigned long long)((b.last_t - b.first_t) / b.update_every);
+
+    usec_t started_ut = now_monotonic_usec();
+    for(h = 0; h < b.hosts ; h++) {
+        bi[h].b = &b;
+        bi[h].host = h;
+        netdata_thread_create(&bi[h].thread, "DBENGINE_BENCH", NETDATA_THREAD_OPTION_JOINABLE, dbengine_bench_ingest_thread, &bi[h]);
+    }
+    for(h = 0; h < b.hosts ; h++)
+        netdata_thread_join(bi[h].thread, NULL);
+    usec_t ingest_ut = now_monotonic_usec() - started_ut;
+    freez(bi);
+
+    dbengine_bench_statistics(&b, before);
+
+    // ------------------------------------------------------------------------
+    // queries
+
+    netdata_thread_t *threads = callocz((size_t)b.threads, sizeof(netdata_thread_t));
+    b.latencies = callocz(b.queries, sizeof(usec_t));
+
+    started_ut = now_monotonic_usec();
+    for(i = 0; i < b.threads ; i++)
+        netdata_thread_create(&threads[i], "DBENGINE_BENCH", NETDATA_THREAD_OPTION_JOINABLE, dbengine_bench_query_thread, &b);
+    for(i = 0; i < b.threads ; i++)
+        netdata_thread_join(threads[i], NULL);
+    usec_t query_ut = now_monotonic_usec() - started_ut;
+    freez(threads);
+
+    dbengine_bench_statistics(&b, after);
+
+    // ------------------------------------------------------------------------
+    // the results
+
+    qsort(b.latencies, b.queries, sizeof(usec_t), dbengine_bench_latency_compare);
+
+    unsigned long long hits = after[7] - before[7], misses = after[8] - before[8];
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(stderr, "\n");
+    dbengine_bench_print_rate("points stored", points, ingest_ut);
+    dbengine_bench_print_rate("queries", b.queries, query_ut);
+    fprintf(stderr, " > %-32s %llu usec\n", "query latency p50", (unsigned long long)b.latencies[b.queries / 2]);
+    fprintf(stderr, " > %-32s %llu usec\n", "query latency p99", (unsigned long long)b.latencies[b.queries * 99 / 100]);
+    fprintf(stderr, " > %-32s %llu usec\n", "query latency max", (unsigned long long)b.latencies[b.queries - 1]);
+    fprintf(stderr, " > %-32s %0.2f %% (%llu hits, %llu misses)\n", "page cache hit ratio",
+            (hits + misses) ? (double)hits * 100.0 / (double)(hits + misses) : 100.0, hits, misses);
+    fprintf(stderr, " > %-32s %llu bytes (%llu before compression)\n", "bytes written", after[15], after[11]);
+    fprintf(stderr, " > %-32s %llu bytes\n", "bytes read", after[17]);
+    fprintf(stderr, " > %-32s %ld KiB\n", "max resident memory", (long)usage.ru_maxrss);
+    fprintf(stderr, "\n%zu queries without data\n", b.errors);
+
+    freez(b.latencies);
+
+    // the database of the benchmark is not kept
+    for(h = 0; h < b.hosts ; h++) {
+        RRDHOST *host = b.st[h * b.charts]->rrdhost;
+
+        // the hosts may share a dbengine instance
+        for(i = 0; i < h && b.st[i * b.charts]->rrdhost->rrdeng_ctx != host->rrdeng_ctx ; i++) ;
+        if(host->rrdeng_ctx && i == h)
+            rrdeng_exit(host->rrdeng_ctx);
+    }
+    for(h = 0; h < b.hosts ; h++) {
+        RRDHOST *host = b.st[h * b.charts]->rrdhost;
+
+        host->rrdeng_ctx = NULL;
+        rrd_wrlock();
+        rrdhost_delete_charts(host);
+        rrd_unlock();
+    }
+    freez(b.st);
+
+    return 0;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// -W perftest: the micro-benchmarks of the hot paths, as JSON on stdout
+//
+// Every benchmark is run a few times and the fastest run is reported, in nanoseconds and
+// in allocations (mallocz(), callocz(), reallocz(), strdupz()) per operation, so that the
+// output of two builds can be compared to catch the regressions of the hot paths.
+
+struct perftest_run {
+    usec_t started_ut;
+    size_t started_allocations;
+
+    usec_t ut;
+    size_t allocations;
+};
+
+static volatile calculated_number perftest_sink = 0;
+
+static inline void perftest_start(struct perftest_run *pr) {
+    pr->started_allocations = memory_thread_allocations;
+    pr->started_ut = now_monotonic_usec();
+}
+
+static inline void perftest_stop(struct perftest_run *pr) {
+    pr->ut = now_monotonic_usec() - pr->started_ut;
+    pr->allocations = memory_thread_allocations - pr->started_allocations;
+}
+
+// the numbers the storage number benchmarks pack, of all magnitudes and both signs
+static void perftest_numbers(calculated_number *numbers, size_t entries) {
+    size_t i;
+    for(i = 0; i < entries ; i++) {
+        calculated_number n = (calculated_number)((i * 7919) % 100003) / 7.0;
+        numbers[i] = n * calculated_number_pow(10.0, (calculated_number)(i % 12) - 4.0) * ((i & 1) ? -1 : 1);
+    }
+}
+
+#define PERFTEST_NUMBERS 4096
+
+static size_t perftest_storage_number_pack(struct perftest_run *pr, size_t loops) {
+    calculated_number numbers[PERFTEST_NUMBERS];
+    storage_number sum = 0;
+    size_t i, l;
+
+    perftest_numbers(numbers, PERFTEST_NUMBERS);
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++)
+        for(i = 0; i < PERFTEST_NUMBERS ; i++)
+            sum += pack_storage_number(numbers[i], SN_EXISTS);
+    perftest_stop(pr);
+
+    perftest_sink = sum;
+    return loops * PERFTEST_NUMBERS;
+}
+
+static size_t perftest_storage_number_unpack(struct perftest_run *pr, size_t loops) {
+    calculated_number numbers[PERFTEST_NUMBERS], sum = 0;
+    storage_number packed[PERFTEST_NUMBERS];
+    size_t i, l;
+
+    perftest_numbers(numbers, PERFTEST_NUMBERS);
+    for(i = 0; i < PERFTEST_NUMBERS ; i++)
+        packed[i] = pack_storage_number(numbers[i], SN_EXISTS);
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++)
+        for(i = 0; i < PERFTEST_NUMBERS ; i++)
+            sum += unpack_storage_number(packed[i]);
+    perftest_stop(pr);
+
+    perftest_sink = sum;
+    return loops * PERFTEST_NUMBERS;
+}
+
+static size_t perftest_storage_number_unpack_array(struct perftest_run *pr, size_t loops) {
+    calculated_number numbers[PERFTEST_NUMBERS];
+    storage_number packed[PERFTEST_NUMBERS];
+    double values[PERFTEST_NUMBERS], sum = 0;
+    size_t i, l;
+
+    perftest_numbers(numbers, PERFTEST_NUMBERS);
+    for(i = 0; i < PERFTEST_NUMBERS ; i++)
+        packed[i] = pack_storage_number(numbers[i], SN_EXISTS);
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++) {
+        unpack_storage_number_array(packed, values, PERFTEST_NUMBERS);
+        sum += values[l % PERFTEST_NUMBERS];
+    }
+    perftest_stop(pr);
+
+    perftest_sink = sum;
+    return loops * PERFTEST_NUMBERS;
+}
+
+static size_t perftest_print_calculated_number(struct perftest_run *pr, size_t loops) {
+    calculated_number numbers[PERFTEST_NUMBERS];
+    char buffer[100];
+    size_t i, l, len = 0;
+
+    perftest_numbers(numbers, PERFTEST_NUMBERS);
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++)
+        for(i = 0; i < PERFTEST_NUMBERS ; i++)
+            len += print_calculated_number(buffer, unpack_storage_number(pack_storage_number(numbers[i], SN_EXISTS)));
+    perftest_stop(pr);
+
+    perftest_sink = len;
+    return loops * PERFTEST_NUMBERS;
+}
+
+// the grouping kernels of the queries, given the values in blocks, like rrd2rrdr() does
+static size_t perftest_query_grouping(struct perftest_run *pr, size_t loops, RRDR_GROUPING group_method) {
+    query_number values[PERFTEST_NUMBERS], sum = 0;
+    RRDR_VALUE_FLAGS flags = RRDR_VALUE_NOTHING;
+    size_t i, l;
+    RRDR r;
+
+    for(i = 0; i < PERFTEST_NUMBERS ; i++)
+        values[i] = (i % 61) ? (query_number)((i * 7919) % 1009) / 10.0 : NAN;
+
+    memset(&r, 0, sizeof(r));
+    r.internal.resampling_group = 1;
+    r.internal.resampling_divisor = 1;
+
+    void (*add_many)(RRDR *r, const query_number *values, size_t count);
+    query_number (*flush)(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+    void (*free_it)(RRDR *r);
+
+    switch(group_method) {
+        case RRDR_GROUPING_MAX:
+            r.internal.grouping_data = grouping_create_max(&r);
+            add_many = grouping_add_many_max; flush = grouping_flush_max; free_it = grouping_free_max;
+            break;
+
+        default:
+            r.internal.grouping_data = grouping_create_average(&r);
+            add_many = grouping_add_many_average; flush = grouping_flush_average; free_it = grouping_free_average;
+            break;
+    }
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++) {
+        // the groups of a query of 4096 points of data, 64 points per group
+        for(i = 0; i < PERFTEST_NUMBERS ; i += 64) {
+            add_many(&r, &values[i], 64);
+            sum += flush(&r, &flags);
+        }
+    }
+    perftest_stop(pr);
+
+    free_it(&r);
+
+    perftest_sink = sum;
+    return loops * PERFTEST_NUMBERS;
+}
+
+static size_t perftest_query_grouping_average(struct perftest_run *pr, size_t loops) {
+    return perftest_query_grouping(pr, loops, RRDR_GROUPING_AVERAGE);
+}
+
+static size_t perftest_query_grouping_max(struct perftest_run *pr, size_t loops) {
+    return perftest_query_grouping(pr, loops, RRDR_GROUPING_MAX);
+}
+
+// a file like /proc/meminfo, for the procfile and the ARL benchmarks
+#define PERFTEST_MEMINFO_LINES 48
+
+static const char *perftest_meminfo_keyword(size_t line, char *buffer, size_t size) {
+    static const char *keywords[] = {
+            "MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "SwapCached", "Active", "Inactive",
+            "Active(anon)", "Inactive(anon)", "Active(file)", "Inactive(file)", "Unevictable", "Mlocked",
+            "SwapTotal", "SwapFree", "Dirty", "Writeback", "AnonPages", "Mapped", "Shmem", "Slab",
+            "SReclaimable", "SUnreclaim", "KernelStack", "PageTables", "NFS_Unstable", "Bounce",
+            "WritebackTmp", "CommitLimit", "Committed_AS", "VmallocTotal", "VmallocUsed", "VmallocChunk",
+            "HardwareCorrupted", "AnonHugePages", "ShmemHugePages", "ShmemPmdMapped", "CmaTotal", "CmaFree",
+            "HugePages_Total", "HugePages_Free", "HugePages_Rsvd", "HugePages_Surp", "Hugepagesize",
+            "DirectMap4k", "DirectMap2M", "DirectMap1G"
+    };
+
+    snprintfz(buffer, size, "%s", keywords[line % (sizeof(keywords) / sizeof(keywords[0]))]);
+    return buffer;
+}
+
+static int perftest_meminfo_file(char *filename, size_t size) {
+    snprintfz(filename, size, "/tmp/netdata-perftest-meminfo-XXXXXX");
+
+    int fd = mkstemp(filename);
+    if(fd == -1) return 1;
+
+    FILE *fp = fdopen(fd, "w");
+    if(!fp) {
+        close(fd);
+        unlink(filename);
+        return 1;
+    }
+
+    size_t line;
+    for(line = 0; line < PERFTEST_MEMINFO_LINES ; line++) {
+        char keyword[50];
+        fprintf(fp, "%s:%*llu kB\n", perftest_meminfo_keyword(line, keyword, 50), 16, (unsigned long long)(line * 104729 % 16777216));
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static size_t perftest_procfile(struct perftest_run *pr, size_t loops) {
+    char filename[FILENAME_MAX + 1];
+    size_t l, line, words = 0;
+
+    if(perftest_meminfo_file(filename, FILENAME_MAX)) return 0;
+
+    procfile *ff = procfile_open(filename, " \t:", PROCFILE_FLAG_DEFAULT);
+    if(!ff) {
+        unlink(filename);
+        return 0;
+    }
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++) {
+        ff = procfile_readall(ff);
+        if(unlikely(!ff)) break;
+
+        for(line = 0; line < procfile_lines(ff) ; line++)
+            words += procfile_linewords(ff, line);
+    }
+    perftest_stop(pr);
+
+    procfile_close(ff);
+    unlink(filename);
+
+    perftest_sink = words;
+    return l;
+}
+
+static size_t perftest_arl(struct perftest_run *pr, size_t loops) {
+    unsigned long long values[PERFTEST_MEMINFO_LINES], sum = 0;
+    char keywords[PERFTEST_MEMINFO_LINES][50], numbers[PERFTEST_MEMINFO_LINES][30];
+    size_t l, line;
+
+    // the collectors expect a part of the keywords only
+    ARL_BASE *base = arl_create("perftest", NULL, 60);
+    for(line = 0; line < PERFTEST_MEMINFO_LINES ; line++) {
+        perftest_meminfo_keyword(line, keywords[line], 50);
+        snprintfz(numbers[line], 30, "%llu", (unsigned long long)(line * 104729 % 16777216));
+
+        if(line % 3 != 2)
+            arl_expect(base, keywords[line], &values[line]);
+    }
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++) {
+        arl_begin(base);
+        for(line = 0; line < PERFTEST_MEMINFO_LINES ; line++)
+            if(unlikely(arl_check(base, keywords[line], numbers[line]))) break;
+
+        sum += values[l % 2];
+    }
+    perftest_stop(pr);
+
+    arl_free(base);
+
+    perftest_sink = sum;
+    return loops;
+}
+
+#define PERFTEST_DICTIONARY_ENTRIES 10000
+
+static char **perftest_dictionary_names(void) {
+    char **names = mallocz(PERFTEST_DICTIONARY_ENTRIES * sizeof(char *));
+    size_t i;
+
+    for(i = 0; i < PERFTEST_DICTIONARY_ENTRIES ; i++) {
+        char name[100];
+        snprintfz(name, 100, "chart_%zu.dimension_%zu", i / 10, i % 10);
+        names[i] = strdupz(name);
+    }
+
+    return names;
+}
+
+static void perftest_dictionary_names_free(char **names) {
+    size_t i;
+    for(i = 0; i < PERFTEST_DICTIONARY_ENTRIES ; i++)
+        freez(names[i]);
+    freez(names);
+}
+
+static size_t perftest_dictionary_set(struct perftest_run *pr, size_t loops) {
+    char **names = perftest_dictionary_names();
+    size_t i, l;
+
+    // a new dictionary every time, so that all the names are new
+    // only the dictionary_set() calls are measured
+    for(l = 0; l < loops ; l++) {
+        DICTIONARY *dict = dictionary_create(DICTIONARY_FLAG_DEFAULT);
+        struct perftest_run one;
+
+        perftest_start(&one);
+        for(i = 0; i < PERFTEST_DICTIONARY_ENTRIES ; i++)
+            dictionary_set(dict, names[i], &i, sizeof(i));
+        perftest_stop(&one);
+
+        pr->ut += one.ut;
+        pr->allocations += one.allocations;
+
+        dictionary_destroy(dict);
+    }
+
+    perftest_dictionary_names_free(names);
+    return loops * PERFTEST_DICTIONARY_ENTRIES;
+}
+
+static size_t perftest_dictionary_get(struct perftest_run *pr, size_t loops) {
+    char **names = perftest_dictionary_names();
+    size_t i, l, found = 0;
+
+    DICTIONARY *dict = dictionary_create(DICTIONARY_FLAG_DEFAULT);
+    for(i = 0; i < PERFTEST_DICTIONARY_ENTRIES ; i++)
+        dictionary_set(dict, names[i], &i, sizeof(i));
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++)
+        for(i = 0; i < PERFTEST_DICTIONARY_ENTRIES ; i++)
+            if(likely(dictionary_get(dict, names[i]))) found++;
+    perftest_stop(pr);
+
+    dictionary_destroy(dict);
+    perftest_dictionary_names_free(names);
+
+    perftest_sink = found;
+    return loops * PERFTEST_DICTIONARY_ENTRIES;
+}
+
+static size_t perftest_eval(struct perftest_run *pr, size_t loops) {
+    const char *failed_at = NULL;
+    int error = 0;
+    size_t l;
+
+    EVAL_EXPRESSION *exp = expression_parse("((5 + 3) * 2 - 1) / 3 > 4 && abs(10 - 3 * 4) == 2 || 1 != 2", &failed_at, &error);
+    if(!exp) {
+        fprintf(stderr, "perftest: cannot parse the eval expression: %s\n", expression_strerror(error));
+        return 0;
+    }
+
+    calculated_number sum = 0;
+
+    perftest_start(pr);
+    for(l = 0; l < loops ; l++) {
+        if(unlikely(!expression_evaluate(exp))) break;
+        sum += exp->result;
+    }
+    perftest_stop(pr);
+
+    expression_free(exp);
+
+    perftest_sink = sum;
+    return l;
+}
+
+static struct perftest {
+    const char *name;
+    size_t (*run)(struct perftest_run *pr, size_t loops);
+    size_t loops;                       // of the default scale (1), the operations are loops x what run() does in one
+} perftests[] = {
+        { "storage_number_pack",         perftest_storage_number_pack,         2000 },
+        { "storage_number_unpack",       perftest_storage_number_unpack,       2000 },
+        { "storage_number_unpack_array", perftest_storage_number_unpack_array, 5000 },
+        { "print_calculated_number",     perftest_print_calculated_number,     200 },
+        { "query_grouping_average",      perftest_query_grouping_average,      5000 },
+        { "query_grouping_max",          perftest_query_grouping_max,          5000 },
+        { "procfile_readall",            perftest_procfile,                    100000 },
+        { "arl_check",                   perftest_arl,                         500000 },
+        { "dictionary_set",              perftest_dictionary_set,              100 },
+        { "dictionary_get",              perftest_dictionary_get,              500 },
+        { "eval_expression",             perftest_eval,                        1000000 },
+        { NULL, NULL, 0 }
+};
+
+int perf_test(const char *parameters) {
+    size_t scale = 1, repeat = 5, i, r;
+    SIMPLE_PATTERN *only = NULL;
+    char *s = strdupz(parameters), *p = s, *name;
+
+    while(p && (name = mystrsep(&p, ",")) && *name) {
+        char *value = strchr(name, '=');
+        if(!value) continue;
+        *value++ = '\0';
+
+        if(!strcmp(name, "only")) {
+            // a simple pattern of the benchmarks to run, i.e. 'storage_number_* query_*'
+            only = simple_pattern_create(value, "|", SIMPLE_PATTERN_EXACT);
+            continue;
+        }
+
+        long long n = str2ll(value, NULL);
+        if(n < 1) {
+            fprintf(stderr, "perftest: invalid value '%s' of '%s'\n", value, name);
+            freez(s);
+            return 1;
+        }
+
+        if(!strcmp(name, "scale")) scale = (size_t)n;
+        else if(!strcmp(name, "repeat")) repeat = (size_t)n;
+        else {
+            fprintf(stderr, "perftest: unknown parameter '%s'\n", name);
+            freez(s);
+            return 1;
+        }
+    }
+    freez(s);
+
+    fprintf(stderr, "\nRunning the micro-benchmarks, %zu times each, at scale %zu\n", repeat, scale);
+
+    fprintf(stdout,
+            "{\n"
+            "\t\"version\": \"%s\",\n"
+            "\t\"calculated_number_size\": %zu,\n"
+            "\t\"query_number_size\": %zu,\n"
+            "\t\"scale\": %zu,\n"
+            "\t\"repeat\": %zu,\n"
+            "\t\"benchmarks\": ["
+            , program_version
+            , sizeof(calculated_number)
+            , sizeof(query_number)
+            , scale
+            , repeat
+    );
+
+    int errors = 0;
+    size_t ran = 0;
+    for(i = 0; perftests[i].name ; i++) {
+        if(only && !simple_pattern_matches(only, perftests[i].name)) continue;
+
+        struct perftest_run best = { .ut = 0, .allocations = 0 };
+        size_t ops = 0;
+
+        for(r = 0; r < repeat ; r++) {
+            struct perftest_run pr = { 0, 0, 0, 0 };
+
+            ops = perftests[i].run(&pr, perftests[i].loops * scale);
+            if(!ops) break;
+
+            if(!r || pr.ut < best.ut)
+                best = pr;
+        }
+
+        if(!ops) {
+            fprintf(stderr, " > %-32s FAILED\n", perftests[i].name);
+            errors++;
+            continue;
+        }
+
+        double ns = (double)best.ut * 1000.0 / (double)ops;
+        double allocations = (double)best.allocations / (double)ops;
+
+        fprintf(stderr, " > %-32s %12.3f ns/op, %8.3f allocations/op\n", perftests[i].name, ns, allocations);
+
+        fprintf(stdout,
+                "%s\n\t\t{ \"name\": \"%s\", \"ops\": %zu, \"ns_per_op\": %0.3f, \"allocations_per_op\": %0.3f }"
+                , ran ? "," : ""
+                , perftests[i].name
+                , ops
+                , ns
+                , allocations
+        );
+        ran++;
+    }
+
+    fprintf(stdout, "\n\t],\n\t\"errors\": %d\n}\n", errors);
+    fflush(stdout);
+
+    simple_pattern_free(only);
+    return errors ? 1 : 0;
+}
@@ -4,13 +4,28 @@
 #define NETDATA_UNIT_TEST_H 1
 
 extern int unit_test_storage(void);
+extern int test_rrdset_blocks(void);
+extern int test_rrdset_done_many(void);
+extern int test_query_grouping_add_many(void);
+extern int test_median_on_unsorted_series(void);
+extern int test_rrd2rrdr_query_threads(void);
+extern int test_query_cache(void);
+extern int test_rrd2rrdr_incremental(void);
+extern int test_rrddim_summaries(void);
+extern int test_rrdr2json(void);
+extern int test_rrdr2binary(void);
+extern int test_allmetrics_stream(void);
+extern int test_hash_index(void);
 extern int unit_test(long delay, long shift);
 extern int run_all_mockup_tests(void);
 extern int unit_test_str2ld(void);
 extern int unit_test_buffer(void);
+extern int unit_test_string_pool(void);
+extern int perf_test(const char *parameters);
 #ifdef ENABLE_DBENGINE
 extern int test_dbengine(void);
 extern void generate_dbengine_dataset(unsigned history_seconds);
+extern int dbengine_benchmark(const char *parameters);
 #endif
 
 #endif /* NETDATA_UNIT_TEST_H */
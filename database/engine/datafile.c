@@ -4,6 +4,13 @@
 void df_extent_insert(struct extent_info *extent)
 {
     struct rrdengine_datafile *datafile = extent->datafile;
+    unsigned i;
+
+    datafile->nr_pages += extent->number_of_pages;
+    for (i = 0 ; i < extent->number_of_pages ; ++i) {
+        if (NULL == extent->pages[i])
+            ++datafile->nr_dead_pages;
+    }
 
     if (likely(NULL != datafile->extents.last)) {
         datafile->extents.last->next = extent;
@@ -14,6 +21,22 @@ void df_extent_insert(struct extent_info *extent)
     datafile->extents.last = extent;
 }
 
+/* The page no longer lives in the extent, the extent keeps its place in the data file until the file is deleted */
+void df_extent_drop_page(struct extent_info *extent, struct rrdeng_page_descr *descr)
+{
+    struct rrdengine_datafile *datafile = extent->datafile;
+    unsigned i;
+
+    for (i = 0 ; i < extent->number_of_pages ; ++i) {
+        if (extent->pages[i] == descr) {
+            extent->pages[i] = NULL;
+            ++datafile->nr_dead_pages;
+            datafile->stale_index = 1;
+            return;
+        }
+    }
+}
+
 void datafile_list_insert(struct rrdengine_instance *ctx, struct rrdengine_datafile *datafile)
 {
     if (likely(NULL != ctx->datafiles.last)) {
@@ -27,23 +50,32 @@ void datafile_list_insert(struct rrdengine_instance *ctx, struct rrdengine_dataf
 
 void datafile_list_delete(struct rrdengine_instance *ctx, struct rrdengine_datafile *datafile)
 {
-    struct rrdengine_datafile *next;
+    struct rrdengine_datafile *prev;
 
-    next = datafile->next;
-    assert((NULL != next) && (ctx->datafiles.first == datafile) && (ctx->datafiles.last != datafile));
-    ctx->datafiles.first = next;
+    assert((NULL != datafile->next) && (ctx->datafiles.last != datafile));
+    if (ctx->datafiles.first == datafile) {
+        ctx->datafiles.first = datafile->next;
+        return;
+    }
+    /* compacted data files can be anywhere in the list except for its end */
+    for (prev = ctx->datafiles.first ; prev->next != datafile ; prev = prev->next)
+        assert(NULL != prev->next);
+    prev->next = datafile->next;
 }
 
 
 static void datafile_init(struct rrdengine_datafile *datafile, struct rrdengine_instance *ctx,
                           unsigned tier, unsigned fileno)
 {
-    assert(tier == 1);
+    assert(tier == ctx->tier);
     datafile->tier = tier;
     datafile->fileno = fileno;
     datafile->file = (uv_file)0;
     datafile->pos = 0;
+    datafile->version = rrdeng_new_file_version();
     datafile->extents.first = datafile->extents.last = NULL; /* will be populated by journalfile */
+    datafile->nr_pages = datafile->nr_dead_pages = 0;
+    datafile->stale_index = 0;
     datafile->journalfile = NULL;
     datafile->next = NULL;
     datafile->ctx = ctx;
@@ -139,8 +171,8 @@ int create_data_file(struct rrdengine_datafile *datafile)
         fatal("posix_memalign:%s", strerror(ret));
     }
     (void) strncpy(superblock->magic_number, RRDENG_DF_MAGIC, RRDENG_MAGIC_SZ);
-    (void) strncpy(superblock->version, RRDENG_DF_VER, RRDENG_VER_SZ);
-    superblock->tier = 1;
+    (void) strncpy(superblock->version, (3 == datafile->version) ? RRDENG_DF_VER_3 : RRDENG_DF_VER, RRDENG_VER_SZ);
+    superblock->tier = datafile->tier;
 
     iov = uv_buf_init((void *)superblock, sizeof(*superblock));
 
@@ -165,7 +197,8 @@ int create_data_file(struct rrdengine_datafile *datafile)
     return 0;
 }
 
-static int check_data_file_superblock(uv_file file)
+/* Sets version to the on-disk format version of the data file */
+static int check_data_file_superblock(uv_file file, unsigned tier, unsigned *version)
 {
     int ret;
     struct rrdeng_df_sb *superblock;
@@ -187,9 +220,20 @@ static int check_data_file_superblock(uv_file file)
     assert(req.result >= 0);
     uv_fs_req_cleanup(&req);
 
+    if (!strncmp(superblock->version, RRDENG_DF_VER, RRDENG_VER_SZ)) {
+        *version = DATAFILE_VERSION;
+    } else if (!strncmp(superblock->version, RRDENG_DF_VER_3, RRDENG_VER_SZ)) {
+        *version = 3;
+    } else if (!strncmp(superblock->version, RRDENG_DF_VER_2, RRDENG_VER_SZ)) {
+        *version = 2;
+    } else if (!strncmp(superblock->version, RRDENG_DF_VER_1, RRDENG_VER_SZ)) {
+        *version = 1;
+    } else {
+        *version = 0;
+    }
     if (strncmp(superblock->magic_number, RRDENG_DF_MAGIC, RRDENG_MAGIC_SZ) ||
-        strncmp(superblock->version, RRDENG_DF_VER, RRDENG_VER_SZ) ||
-        superblock->tier != 1) {
+        !*version ||
+        superblock->tier != tier) {
         error("File has invalid superblock.");
         ret = UV_EINVAL;
     } else {
@@ -223,7 +267,7 @@ static int load_data_file(struct rrdengine_datafile *datafile)
         goto error;
     file_size = ALIGN_BYTES_CEILING(file_size);
 
-    ret = check_data_file_superblock(file);
+    ret = check_data_file_superblock(file, datafile->tier, &datafile->version);
     if (ret)
         goto error;
     ctx->stats.io_read_bytes += sizeof(struct rrdeng_df_sb);
@@ -232,7 +276,7 @@ static int load_data_file(struct rrdengine_datafile *datafile)
     datafile->file = file;
     datafile->pos = file_size;
 
-    info("Data file \"%s\" initialized (size:%"PRIu64").", path, file_size);
+    info("Data file \"%s\" initialized (size:%"PRIu64", version:%u).", path, file_size, datafile->version);
     return 0;
 
     error:
@@ -284,7 +328,9 @@ static int scan_data_files(struct rrdengine_instance *ctx)
     for (matched_files = 0 ; UV_EOF != uv_fs_scandir_next(&req, &dent) && matched_files < MAX_DATAFILES ; ) {
         info("Scanning file \"%s/%s\"", ctx->dbfiles_path, dent.name);
         ret = sscanf(dent.name, DATAFILE_PREFIX RRDENG_FILE_NUMBER_SCAN_TMPL DATAFILE_EXTENSION, &tier, &no);
-        if (2 == ret) {
+        if (2 == ret && tier != ctx->tier) {
+            info("Ignoring file \"%s/%s\" of tier %u in tier %u path.", ctx->dbfiles_path, dent.name, tier, ctx->tier);
+        } else if (2 == ret) {
             info("Matched file \"%s/%s\"", ctx->dbfiles_path, dent.name);
             datafile = mallocz(sizeof(*datafile));
             datafile_init(datafile, ctx, tier, no);
@@ -301,7 +347,6 @@ static int scan_data_files(struct rrdengine_instance *ctx)
         error("Warning: hit maximum database engine file limit of %d files", MAX_DATAFILES);
     }
     qsort(datafiles, matched_files, sizeof(*datafiles), scan_data_files_cmp);
-    /* TODO: change this when tiering is implemented */
     ctx->last_fileno = datafiles[matched_files - 1]->fileno;
 
     for (failed_to_load = 0, i = 0 ; i < matched_files ; ++i) {
@@ -325,6 +370,10 @@ static int scan_data_files(struct rrdengine_instance *ctx)
         }
         datafile_list_insert(ctx, datafile);
         ctx->disk_space += datafile->pos + journalfile->pos;
+        if (i != matched_files - 1 && !journalfile->indexed) {
+            /* sealed by an older version, index it so that the next startup is faster */
+            (void) write_journal_index(ctx, datafile);
+        }
     }
     freez(datafiles);
     if (failed_to_load) {
@@ -384,6 +433,7 @@ error_after_datafile:
 int init_data_files(struct rrdengine_instance *ctx)
 {
     int ret;
+    struct rrdengine_datafile *sealed_datafile;
 
     ret = scan_data_files(ctx);
     if (ret < 0) {
@@ -391,12 +441,25 @@ int init_data_files(struct rrdengine_instance *ctx)
         return ret;
     } else if (0 == ret) {
         info("Data files not found, creating in path \"%s\".", ctx->dbfiles_path);
-        ret = create_new_datafile_pair(ctx, 1, 1);
+        ret = create_new_datafile_pair(ctx, ctx->tier, 1);
         if (ret) {
             error("Failed to create data and journal files in path \"%s\".", ctx->dbfiles_path);
             return ret;
         }
         ctx->last_fileno = 1;
+    } else if (ctx->datafiles.last->version != rrdeng_new_file_version() ||
+               ctx->datafiles.last->journalfile->version != rrdeng_new_file_version()) {
+        /* never append to files of other format versions */
+        info("Data files in path \"%s\" use another format version, starting a new data and journal file pair.",
+             ctx->dbfiles_path);
+        sealed_datafile = ctx->datafiles.last;
+        ret = create_new_datafile_pair(ctx, ctx->tier, ctx->last_fileno + 1);
+        if (ret) {
+            error("Failed to create data and journal files in path \"%s\".", ctx->dbfiles_path);
+            return ret;
+        }
+        ++ctx->last_fileno;
+        (void) write_journal_index(ctx, sealed_datafile);
     }
 
     return 0;
@@ -20,10 +20,12 @@ struct rrdengine_instance;
 
 #define DATAFILE_IDEAL_IO_SIZE (1048576U)
 
+#define DATAFILE_VERSION (4) /* matches RRDENG_DF_VER */
+
 struct extent_info {
     uint64_t offset;
     uint32_t size;
-    uint8_t number_of_pages;
+    uint16_t number_of_pages;
     struct rrdengine_datafile *datafile;
     struct extent_info *next;
     struct rrdeng_page_descr *pages[];
@@ -39,10 +41,15 @@ struct rrdengine_df_extents {
 struct rrdengine_datafile {
     unsigned tier;
     unsigned fileno;
+    unsigned version; /* on-disk format version, 1 to 4 */
     uv_file file;
     uint64_t pos;
     struct rrdengine_instance *ctx;
     struct rrdengine_df_extents extents;
+    /* pages of the extents, dead pages have been deleted or rewritten to a newer data file */
+    unsigned nr_pages;
+    unsigned nr_dead_pages;
+    uint8_t stale_index; /* pages died after the journal index was written */
     struct rrdengine_journalfile *journalfile;
     struct rrdengine_datafile *next;
 };
@@ -53,6 +60,7 @@ struct rrdengine_datafile_list {
 };
 
 extern void df_extent_insert(struct extent_info *extent);
+extern void df_extent_drop_page(struct extent_info *extent, struct rrdeng_page_descr *descr);
 extern void datafile_list_insert(struct rrdengine_instance *ctx, struct rrdengine_datafile *datafile);
 extern void datafile_list_delete(struct rrdengine_instance *ctx, struct rrdengine_datafile *datafile);
 extern void generate_datafilepath(struct rrdengine_datafile *datafile, char *str, size_t maxlen);
@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "rrdengine.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * Every worker owns a ring that its extent reads and flushes are queued to. Requests are submitted in batches, once
+ * per command batch or timer expiration of the event loop, and completions are reaped in the event loop when the
+ * eventfd registered with the ring becomes readable, so the callbacks run in the worker thread like libuv ones.
+ */
+
+/* the size of the biggest extent that can be flushed */
+#define RRDENG_URING_FLUSH_BUFFER_SIZE ALIGN_BYTES_CEILING(sizeof(struct rrdeng_df_extent_header) +               \
+    MAX_PAGES_PER_EXTENT * (sizeof(struct rrdeng_extent_page_descr) + RRDENG_BLOCK_SIZE) +                         \
+    sizeof(struct rrdeng_df_extent_trailer))
+
+struct rrdeng_uring {
+    struct rrdengine_worker_config *wc;
+    int fd;
+    int eventfd;
+    uv_poll_t poll;
+
+    /* submission queue, written by the worker and consumed by the kernel */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned queued; /* entries that have not been submitted yet */
+
+    /* completion queue, written by the kernel and consumed by the worker */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned cq_entries;
+
+    unsigned in_flight; /* submitted requests that have not completed yet */
+
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+
+    /* buffers registered with the ring, NULL when registration failed */
+    void *flush_buffers;
+    unsigned flush_buffers_used; /* bitmap of the buffers being flushed */
+};
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_reap_completions(struct rrdeng_uring *ring)
+{
+    struct rrdeng_uring_req *req;
+    struct io_uring_cqe *cqe;
+    unsigned head, tail;
+    int result;
+
+    head = *ring->cq_head;
+    while (head != (tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))) {
+        do {
+            cqe = &ring->cqes[head & *ring->cq_mask];
+            req = (struct rrdeng_uring_req *)(uintptr_t)cqe->user_data;
+            result = cqe->res;
+            /* return the entry to the kernel before the callback frees the request */
+            __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+            --ring->in_flight;
+
+            if (result >= 0 && (unsigned)result != req->length)
+                result = UV_EIO;
+            req->cb(ring->wc, req->data, result);
+        } while (head != tail);
+    }
+}
+
+/* Blocks until at least one of the submitted requests completes and runs the callbacks of the completed ones */
+static void uring_wait_completions(struct rrdeng_uring *ring)
+{
+    if (unlikely(sys_io_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)) {
+        fatal("io_uring_enter: %s", strerror(errno));
+    }
+    uring_reap_completions(ring);
+}
+
+static void uring_poll_cb(uv_poll_t *handle, int status, int events)
+{
+    struct rrdeng_uring *ring = handle->data;
+    uint64_t value;
+    (void)events;
+
+    if (unlikely(status < 0)) {
+        error("%s: uv_poll: %s", __func__, uv_strerror(status));
+        return;
+    }
+    /* the counter is non-blocking, it only tells that there are completions */
+    if (read(ring->eventfd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        error("%s: read: %s", __func__, strerror(errno));
+    uring_reap_completions(ring);
+}
+
+static void uring_close_cb(uv_handle_t *handle)
+{
+    struct rrdeng_uring *ring = handle->data;
+
+    if (ring->flush_buffers)
+        free(ring->flush_buffers);
+    (void) munmap(ring->sqes, ring->sq_entries * sizeof(struct io_uring_sqe));
+    if (ring->cq_ring != ring->sq_ring)
+        (void) munmap(ring->cq_ring, ring->cq_ring_size);
+    (void) munmap(ring->sq_ring, ring->sq_ring_size);
+    (void) close(ring->eventfd);
+    (void) close(ring->fd);
+    freez(ring);
+}
+
+static void uring_register_flush_buffers(struct rrdeng_uring *ring)
+{
+    struct iovec iov[RRDENG_URING_FLUSH_BUFFERS];
+    unsigned i;
+    int ret;
+
+    ret = posix_memalign(&ring->flush_buffers, RRDFILE_ALIGNMENT,
+                         RRDENG_URING_FLUSH_BUFFERS * RRDENG_URING_FLUSH_BUFFER_SIZE);
+    if (unlikely(ret)) {
+        fatal("posix_memalign:%s", strerror(ret));
+    }
+    for (i = 0 ; i < RRDENG_URING_FLUSH_BUFFERS ; ++i) {
+        iov[i].iov_base = ring->flush_buffers + i * RRDENG_URING_FLUSH_BUFFER_SIZE;
+        iov[i].iov_len = RRDENG_URING_FLUSH_BUFFER_SIZE;
+    }
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov, RRDENG_URING_FLUSH_BUFFERS) < 0) {
+        /* usually RLIMIT_MEMLOCK on older kernels, flushes work without registered buffers as well */
+        info("DB engine cannot register io_uring buffers: %s", strerror(errno));
+        free(ring->flush_buffers);
+        ring->flush_buffers = NULL;
+    }
+    ring->flush_buffers_used = 0;
+}
+
+void rrdeng_uring_init(struct rrdengine_worker_config *wc)
+{
+    struct rrdeng_uring *ring;
+    struct io_uring_params params;
+    int ret;
+
+    wc->uring = NULL;
+    if (!default_rrdeng_io_uring)
+        return;
+
+    ring = callocz(1, sizeof(*ring));
+    ring->wc = wc;
+    memset(&params, 0, sizeof(params));
+    ring->fd = sys_io_uring_setup(RRDENG_URING_ENTRIES, &params);
+    if (ring->fd < 0) {
+        info("DB engine cannot use io_uring: %s", strerror(errno));
+        goto error_after_alloc;
+    }
+    /* IORING_OP_READ and IORING_OP_WRITE need Linux 5.6, fast poll is the closest feature flag (5.7) */
+    if (!(params.features & IORING_FEAT_FAST_POLL)) {
+        info("DB engine cannot use io_uring: the kernel is too old.");
+        goto error_after_setup;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sq_ring_size = ring->cq_ring_size = MAX(ring->sq_ring_size, ring->cq_ring_size);
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ring->sq_ring) {
+        error("DB engine cannot map the io_uring submission queue.");
+        goto error_after_setup;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ring->cq_ring) {
+            error("DB engine cannot map the io_uring completion queue.");
+            goto error_after_sq_ring;
+        }
+    }
+    ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (MAP_FAILED == ring->sqes) {
+        error("DB engine cannot map the io_uring submission queue entries.");
+        goto error_after_cq_ring;
+    }
+    ring->sq_head = ring->sq_ring + params.sq_off.head;
+    ring->sq_tail = ring->sq_ring + params.sq_off.tail;
+    ring->sq_mask = ring->sq_ring + params.sq_off.ring_mask;
+    ring->sq_array = ring->sq_ring + params.sq_off.array;
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = ring->cq_ring + params.cq_off.head;
+    ring->cq_tail = ring->cq_ring + params.cq_off.tail;
+    ring->cq_mask = ring->cq_ring + params.cq_off.ring_mask;
+    ring->cqes = ring->cq_ring + params.cq_off.cqes;
+    ring->cq_entries = params.cq_entries;
+
+    ring->eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring->eventfd < 0) {
+        error("DB engine cannot create the io_uring eventfd.");
+        goto error_after_sqes;
+    }
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_EVENTFD, &ring->eventfd, 1) < 0) {
+        error("DB engine cannot register the io_uring eventfd.");
+        goto error_after_eventfd;
+    }
+    ret = uv_poll_init(wc->loop, &ring->poll, ring->eventfd);
+    if (ret) {
+        error("uv_poll_init(): %s", uv_strerror(ret));
+        goto error_after_eventfd;
+    }
+    ring->poll.data = ring;
+    assert(0 == uv_poll_start(&ring->poll, UV_READABLE, uring_poll_cb));
+    /* in-flight requests are completed by rrdeng_uring_exit(), they must not keep the event loop alive */
+    uv_unref((uv_handle_t *)&ring->poll);
+
+    uring_register_flush_buffers(ring);
+    wc->uring = ring;
+    return;
+
+error_after_eventfd:
+    (void) close(ring->eventfd);
+error_after_sqes:
+    (void) munmap(ring->sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+error_after_cq_ring:
+    if (ring->cq_ring != ring->sq_ring)
+        (void) munmap(ring->cq_ring, ring->cq_ring_size);
+error_after_sq_ring:
+    (void) munmap(ring->sq_ring, ring->sq_ring_size);
+error_after_setup:
+    (void) close(ring->fd);
+error_after_alloc:
+    freez(ring);
+}
+
+/* Waits for the in-flight requests to complete and releases the ring, the event loop must run once more after it */
+void rrdeng_uring_exit(struct rrdengine_worker_config *wc)
+{
+    struct rrdeng_uring *ring = wc->uring;
+
+    if (NULL == ring)
+        return;
+
+    rrdeng_uring_submit(wc);
+    while (ring->in_flight)
+        uring_wait_completions(ring);
+    wc->uring = NULL;
+    uv_close((uv_handle_t *)&ring->poll, uring_close_cb);
+}
+
+void rrdeng_uring_submit(struct rrdengine_worker_config *wc)
+{
+    struct rrdeng_uring *ring = wc->uring;
+    int ret;
+
+    if (NULL == ring)
+        return;
+
+    while (ring->queued) {
+        ret = sys_io_uring_enter(ring->fd, ring->queued, 0, 0);
+        if (unlikely(ret < 0)) {
+            if (EINTR == errno)
+                continue;
+            if ((EAGAIN == errno || EBUSY == errno) && ring->in_flight) {
+                /* the kernel is out of resources for completions, make room for them */
+                uring_wait_completions(ring);
+                continue;
+            }
+            fatal("io_uring_enter: %s", strerror(errno));
+        }
+        ring->queued -= ret;
+        ring->in_flight += ret;
+        ++wc->ctx->stats.io_uring_submissions;
+    }
+}
+
+/* The request is submitted by the next rrdeng_uring_submit(), buf_index is the registered buffer or -1 */
+static void uring_queue_rw(struct rrdeng_uring *ring, uint8_t opcode, uv_file file, void *buf, unsigned length,
+                          uint64_t offset, int buf_index, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+    if (unlikely(ring->queued == ring->sq_entries))
+        rrdeng_uring_submit(ring->wc);
+    /* never have more requests than the completion queue can hold, wait for some of them instead */
+    while (unlikely(ring->in_flight + ring->queued >= ring->cq_entries)) {
+        rrdeng_uring_submit(ring->wc);
+        uring_wait_completions(ring);
+    }
+
+    req->cb = cb;
+    req->data = data;
+    req->length = length;
+
+    tail = *ring->sq_tail;
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = file;
+    sqe->off = offset;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = length;
+    if (buf_index >= 0)
+        sqe->buf_index = (uint16_t)buf_index;
+    sqe->user_data = (uintptr_t)req;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->queued;
+}
+
+int rrdeng_uring_read(struct rrdengine_worker_config *wc, uv_file file, void *buf, unsigned length,
+                      uint64_t offset, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data)
+{
+    if (NULL == wc->uring)
+        return UV_ENOSYS;
+    uring_queue_rw(wc->uring, IORING_OP_READ, file, buf, length, offset, -1, req, cb, data);
+    return 0;
+}
+
+int rrdeng_uring_write(struct rrdengine_worker_config *wc, uv_file file, void *buf, unsigned length,
+                       uint64_t offset, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data)
+{
+    struct rrdeng_uring *ring = wc->uring;
+    size_t buffer_offset;
+
+    if (NULL == ring)
+        return UV_ENOSYS;
+    if (ring->flush_buffers && buf >= ring->flush_buffers &&
+        buf < ring->flush_buffers + RRDENG_URING_FLUSH_BUFFERS * RRDENG_URING_FLUSH_BUFFER_SIZE) {
+        buffer_offset = buf - ring->flush_buffers;
+        uring_queue_rw(ring, IORING_OP_WRITE_FIXED, file, buf, length, offset,
+                       (int)(buffer_offset / RRDENG_URING_FLUSH_BUFFER_SIZE), req, cb, data);
+    } else {
+        uring_queue_rw(ring, IORING_OP_WRITE, file, buf, length, offset, -1, req, cb, data);
+    }
+    return 0;
+}
+
+/* Returns a registered buffer of at least size bytes or NULL */
+void *rrdeng_uring_get_flush_buffer(struct rrdengine_worker_config *wc, unsigned size)
+{
+    struct rrdeng_uring *ring = wc->uring;
+    unsigned i;
+
+    if (NULL == ring || NULL == ring->flush_buffers || size > RRDENG_URING_FLUSH_BUFFER_SIZE)
+        return NULL;
+    for (i = 0 ; i < RRDENG_URING_FLUSH_BUFFERS ; ++i) {
+        if (!(ring->flush_buffers_used & (1U << i))) {
+            ring->flush_buffers_used |= 1U << i;
+            return ring->flush_buffers + i * RRDENG_URING_FLUSH_BUFFER_SIZE;
+        }
+    }
+    return NULL;
+}
+
+/* Returns 1 when buf was a registered buffer and has been released, 0 when it must be freed by the caller */
+int rrdeng_uring_put_flush_buffer(struct rrdengine_worker_config *wc, void *buf)
+{
+    struct rrdeng_uring *ring = wc->uring;
+    unsigned i;
+
+    if (NULL == ring || NULL == ring->flush_buffers || buf < ring->flush_buffers ||
+        buf >= ring->flush_buffers + RRDENG_URING_FLUSH_BUFFERS * RRDENG_URING_FLUSH_BUFFER_SIZE)
+        return 0;
+    i = (buf - ring->flush_buffers) / RRDENG_URING_FLUSH_BUFFER_SIZE;
+    ring->flush_buffers_used &= ~(1U << i);
+    return 1;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
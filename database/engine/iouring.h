@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_IOURING_H
+#define NETDATA_IOURING_H
+
+#include "rrdengine.h"
+
+/* Forward declarations */
+struct rrdengine_worker_config;
+struct rrdeng_uring;
+
+typedef void (*rrdeng_uring_cb)(struct rrdengine_worker_config *wc, void *data, int result);
+
+/* an I/O request of the ring, it must stay valid until its callback is called */
+struct rrdeng_uring_req {
+    rrdeng_uring_cb cb;
+    void *data;
+    unsigned length; /* short transfers are reported as errors */
+};
+
+#define RRDENG_URING_ENTRIES (128) /* submission queue depth of every worker */
+#define RRDENG_URING_FLUSH_BUFFERS (4) /* registered buffers of every worker that extents are flushed from */
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+extern void rrdeng_uring_init(struct rrdengine_worker_config *wc);
+extern void rrdeng_uring_exit(struct rrdengine_worker_config *wc);
+extern int rrdeng_uring_read(struct rrdengine_worker_config *wc, uv_file file, void *buf, unsigned length,
+                             uint64_t offset, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data);
+extern int rrdeng_uring_write(struct rrdengine_worker_config *wc, uv_file file, void *buf, unsigned length,
+                              uint64_t offset, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data);
+extern void rrdeng_uring_submit(struct rrdengine_worker_config *wc);
+extern void *rrdeng_uring_get_flush_buffer(struct rrdengine_worker_config *wc, unsigned size);
+extern int rrdeng_uring_put_flush_buffer(struct rrdengine_worker_config *wc, void *buf);
+
+#else
+
+/* without io_uring all I/O goes through the libuv threadpool */
+static inline void rrdeng_uring_init(struct rrdengine_worker_config *wc)
+{
+    (void)wc;
+}
+
+static inline void rrdeng_uring_exit(struct rrdengine_worker_config *wc)
+{
+    (void)wc;
+}
+
+static inline int rrdeng_uring_read(struct rrdengine_worker_config *wc, uv_file file, void *buf, unsigned length,
+                                    uint64_t offset, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data)
+{
+    (void)wc; (void)file; (void)buf; (void)length; (void)offset; (void)req; (void)cb; (void)data;
+    return UV_ENOSYS;
+}
+
+static inline int rrdeng_uring_write(struct rrdengine_worker_config *wc, uv_file file, void *buf, unsigned length,
+                                     uint64_t offset, struct rrdeng_uring_req *req, rrdeng_uring_cb cb, void *data)
+{
+    (void)wc; (void)file; (void)buf; (void)length; (void)offset; (void)req; (void)cb; (void)data;
+    return UV_ENOSYS;
+}
+
+static inline void rrdeng_uring_submit(struct rrdengine_worker_config *wc)
+{
+    (void)wc;
+}
+
+static inline void *rrdeng_uring_get_flush_buffer(struct rrdengine_worker_config *wc, unsigned size)
+{
+    (void)wc; (void)size;
+    return NULL;
+}
+
+static inline int rrdeng_uring_put_flush_buffer(struct rrdengine_worker_config *wc, void *buf)
+{
+    (void)wc; (void)buf;
+    return 0;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
+#endif /* NETDATA_IOURING_H */
@@ -48,10 +48,11 @@ void wal_flush_transaction_buffer(struct rrdengine_worker_config* wc)
     ret = uv_fs_write(wc->loop, &io_descr->req, journalfile->file, &io_descr->iov, 1,
                       journalfile->pos, flush_transaction_buffer_cb);
     assert (-1 != ret);
-    journalfile->pos += RRDENG_BLOCK_SIZE;
-    ctx->disk_space += RRDENG_BLOCK_SIZE;
+    /* the buffer spans multiple blocks when it holds a transaction bigger than RRDENG_BLOCK_SIZE */
+    journalfile->pos += size;
+    ctx->disk_space += size;
     ctx->commit_log.buf = NULL;
-    ctx->stats.io_write_bytes += RRDENG_BLOCK_SIZE;
+    ctx->stats.io_write_bytes += size;
     ++ctx->stats.io_write_requests;
 }
 
@@ -93,10 +94,18 @@ void generate_journalfilepath(struct rrdengine_datafile *datafile, char *str, si
                     datafile->ctx->dbfiles_path, datafile->tier, datafile->fileno);
 }
 
+void generate_journalindexpath(struct rrdengine_datafile *datafile, char *str, size_t maxlen)
+{
+    (void) snprintf(str, maxlen, "%s/" WALFILE_PREFIX RRDENG_FILE_NUMBER_PRINT_TMPL WALFILE_INDEX_EXTENSION,
+                    datafile->ctx->dbfiles_path, datafile->tier, datafile->fileno);
+}
+
 void journalfile_init(struct rrdengine_journalfile *journalfile, struct rrdengine_datafile *datafile)
 {
     journalfile->file = (uv_file)0;
     journalfile->pos = 0;
+    journalfile->version = rrdeng_new_file_version();
+    journalfile->indexed = 0;
     journalfile->datafile = datafile;
 }
 
@@ -155,6 +164,19 @@ int destroy_journal_file(struct rrdengine_journalfile *journalfile, struct rrden
 
     ++ctx->stats.journalfile_deletions;
 
+    if (journalfile->indexed) {
+        int index_ret;
+
+        generate_journalindexpath(datafile, path, sizeof(path));
+        index_ret = uv_fs_unlink(NULL, &req, path, NULL);
+        if (index_ret < 0) {
+            error("uv_fs_fsunlink(%s): %s", path, uv_strerror(index_ret));
+            ++ctx->stats.fs_errors;
+            rrd_stat_atomic_add(&global_fs_errors, 1);
+        }
+        uv_fs_req_cleanup(&req);
+    }
+
     return ret;
 }
 
@@ -183,7 +205,7 @@ int create_journal_file(struct rrdengine_journalfile *journalfile, struct rrdeng
         fatal("posix_memalign:%s", strerror(ret));
     }
     (void) strncpy(superblock->magic_number, RRDENG_JF_MAGIC, RRDENG_MAGIC_SZ);
-    (void) strncpy(superblock->version, RRDENG_JF_VER, RRDENG_VER_SZ);
+    (void) strncpy(superblock->version, (3 == journalfile->version) ? RRDENG_JF_VER_3 : RRDENG_JF_VER, RRDENG_VER_SZ);
 
     iov = uv_buf_init((void *)superblock, sizeof(*superblock));
 
@@ -208,7 +230,8 @@ int create_journal_file(struct rrdengine_journalfile *journalfile, struct rrdeng
     return 0;
 }
 
-static int check_journal_file_superblock(uv_file file)
+/* Sets version to the on-disk format version of the journal file */
+static int check_journal_file_superblock(uv_file file, unsigned *version)
 {
     int ret;
     struct rrdeng_jf_sb *superblock;
@@ -230,8 +253,18 @@ static int check_journal_file_superblock(uv_file file)
     assert(req.result >= 0);
     uv_fs_req_cleanup(&req);
 
-    if (strncmp(superblock->magic_number, RRDENG_JF_MAGIC, RRDENG_MAGIC_SZ) ||
-        strncmp(superblock->version, RRDENG_JF_VER, RRDENG_VER_SZ)) {
+    if (!strncmp(superblock->version, RRDENG_JF_VER, RRDENG_VER_SZ)) {
+        *version = WALFILE_VERSION;
+    } else if (!strncmp(superblock->version, RRDENG_JF_VER_3, RRDENG_VER_SZ)) {
+        *version = 3;
+    } else if (!strncmp(superblock->version, RRDENG_JF_VER_2, RRDENG_VER_SZ)) {
+        *version = 2;
+    } else if (!strncmp(superblock->version, RRDENG_JF_VER_1, RRDENG_VER_SZ)) {
+        *version = 1;
+    } else {
+        *version = 0;
+    }
+    if (strncmp(superblock->magic_number, RRDENG_JF_MAGIC, RRDENG_MAGIC_SZ) || !*version) {
         error("File has invalid superblock.");
         ret = UV_EINVAL;
     } else {
@@ -242,6 +275,35 @@ static int check_journal_file_superblock(uv_file file)
     return ret;
 }
 
+/*
+ * Compaction rewrites the live pages of a data file before deleting it, so after a crash the same page can be found
+ * in two data files. Data files are loaded from oldest to newest and the newest copy of the page is kept.
+ */
+static void drop_superseded_page(struct rrdengine_instance *ctx, struct pg_cache_page_index *page_index,
+                                 usec_t start_time)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct rrdeng_page_descr *descr;
+    Pvoid_t *PValue;
+
+    uv_rwlock_wrlock(&page_index->lock);
+    PValue = JudyLGet(page_index->JudyL_array, (Word_t)(start_time / USEC_PER_SEC), PJE0);
+    if (likely(NULL == PValue)) {
+        uv_rwlock_wrunlock(&page_index->lock);
+        return;
+    }
+    descr = *PValue;
+    (void) JudyLDel(&page_index->JudyL_array, (Word_t)(start_time / USEC_PER_SEC), PJE0);
+    uv_rwlock_wrunlock(&page_index->lock);
+
+    uv_rwlock_wrlock(&pg_cache->pg_cache_rwlock);
+    --pg_cache->page_descriptors;
+    uv_rwlock_wrunlock(&pg_cache->pg_cache_rwlock);
+
+    df_extent_drop_page(descr->extent, descr);
+    pg_cache_free_descr(descr);
+}
+
 static void restore_extent_metadata(struct rrdengine_instance *ctx, struct rrdengine_journalfile *journalfile,
                                     void *buf, unsigned max_size)
 {
@@ -250,20 +312,62 @@ static void restore_extent_metadata(struct rrdengine_instance *ctx, struct rrden
     struct rrdeng_page_descr *descr;
     struct extent_info *extent;
     /* persistent structures */
-    struct rrdeng_jf_store_data *jf_metric_data;
+    struct rrdeng_extent_page_descr *jf_descr;
+    struct rrdeng_extent_page_descr_v2 *jf_descr_v2 = NULL;
+    uint64_t extent_offset;
+    uint32_t extent_size;
+
+    if (1 == journalfile->version) {
+        struct rrdeng_jf_store_data_v1 *jf_metric_data = buf;
+
+        if (sizeof(*jf_metric_data) > max_size) {
+            error("Corrupted transaction payload.");
+            return;
+        }
+        count = jf_metric_data->number_of_pages;
+        payload_length = sizeof(*jf_metric_data);
+        extent_offset = jf_metric_data->extent_offset;
+        extent_size = jf_metric_data->extent_size;
+        jf_descr_v2 = jf_metric_data->descr;
+    } else if (2 == journalfile->version) {
+        struct rrdeng_jf_store_data_v2 *jf_metric_data = buf;
+
+        if (sizeof(*jf_metric_data) > max_size) {
+            error("Corrupted transaction payload.");
+            return;
+        }
+        count = jf_metric_data->number_of_pages;
+        payload_length = sizeof(*jf_metric_data);
+        extent_offset = jf_metric_data->extent_offset;
+        extent_size = jf_metric_data->extent_size;
+        jf_descr_v2 = jf_metric_data->descr;
+    } else {
+        struct rrdeng_jf_store_data *jf_metric_data = buf;
 
-    jf_metric_data = buf;
-    count = jf_metric_data->number_of_pages;
-    descr_size = sizeof(*jf_metric_data->descr) * count;
-    payload_length = sizeof(*jf_metric_data) + descr_size;
-    if (payload_length > max_size) {
+        if (sizeof(*jf_metric_data) > max_size) {
+            error("Corrupted transaction payload.");
+            return;
+        }
+        count = jf_metric_data->number_of_pages;
+        payload_length = sizeof(*jf_metric_data);
+        extent_offset = jf_metric_data->extent_offset;
+        extent_size = jf_metric_data->extent_size;
+        jf_descr = jf_metric_data->descr;
+    }
+    descr_size = (jf_descr_v2 ? sizeof(*jf_descr_v2) : sizeof(*jf_descr)) * count;
+    payload_length += descr_size;
+    if (payload_length > max_size || count > MAX_PAGES_PER_EXTENT) {
         error("Corrupted transaction payload.");
         return;
     }
+    if (jf_descr_v2) {
+        jf_descr = mallocz(sizeof(*jf_descr) * MAX(count, 1));
+        convert_extent_page_descr_v2(jf_descr, jf_descr_v2, count);
+    }
 
     extent = mallocz(sizeof(*extent) + count * sizeof(extent->pages[0]));
-    extent->offset = jf_metric_data->extent_offset;
-    extent->size = jf_metric_data->extent_size;
+    extent->offset = extent_offset;
+    extent->size = extent_size;
     extent->number_of_pages = count;
     extent->datafile = journalfile->datafile;
     extent->next = NULL;
@@ -273,12 +377,13 @@ static void restore_extent_metadata(struct rrdengine_instance *ctx, struct rrden
         Pvoid_t *PValue;
         struct pg_cache_page_index *page_index;
 
-        if (PAGE_METRICS != jf_metric_data->descr[i].type) {
+        if (PAGE_METRICS != jf_descr[i].type) {
             error("Unknown page type encountered.");
+            extent->pages[i] = NULL;
             continue;
         }
         ++valid_pages;
-        temp_id = (uuid_t *)jf_metric_data->descr[i].uuid;
+        temp_id = (uuid_t *)jf_descr[i].uuid;
 
         uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
         PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, temp_id, sizeof(uuid_t));
@@ -297,10 +402,16 @@ static void restore_extent_metadata(struct rrdengine_instance *ctx, struct rrden
             uv_rwlock_wrunlock(&pg_cache->metrics_index.lock);
         }
 
+        drop_superseded_page(ctx, page_index, jf_descr[i].start_time);
         descr = pg_cache_create_descr();
-        descr->page_length = jf_metric_data->descr[i].page_length;
-        descr->start_time = jf_metric_data->descr[i].start_time;
-        descr->end_time = jf_metric_data->descr[i].end_time;
+        descr->page_length = jf_descr[i].page_length;
+        pg_descr_set_start_time(descr, jf_descr[i].start_time);
+        pg_descr_set_end_time(descr, jf_descr[i].end_time);
+        descr->summary.flags = jf_descr[i].summary_flags;
+        descr->summary.count = jf_descr[i].count;
+        descr->summary.min = jf_descr[i].min;
+        descr->summary.max = jf_descr[i].max;
+        descr->summary.sum = jf_descr[i].sum;
         descr->id = &page_index->id;
         descr->extent = extent;
         extent->pages[i] = descr;
@@ -308,52 +419,74 @@ static void restore_extent_metadata(struct rrdengine_instance *ctx, struct rrden
     }
     if (likely(valid_pages))
         df_extent_insert(extent);
+    if (jf_descr_v2)
+        freez(jf_descr);
 }
 
 /*
  * Replays transaction by interpreting up to max_size bytes from buf.
  * Sets id to the current transaction id or to 0 if unknown.
  * Returns size of transaction record or 0 for unknown size.
+ * When the transaction record is bigger than max_size it is not replayed and a size bigger than max_size is returned,
+ * so that the caller can read the whole record and retry.
  */
 static unsigned replay_transaction(struct rrdengine_instance *ctx, struct rrdengine_journalfile *journalfile,
                                    void *buf, uint64_t *id, unsigned max_size)
 {
-    unsigned payload_length, size_bytes;
+    unsigned header_size, payload_length, size_bytes;
     int ret;
+    uint8_t type;
     /* persistent structures */
-    struct rrdeng_jf_transaction_header *jf_header;
     struct rrdeng_jf_transaction_trailer *jf_trailer;
     uLong crc;
 
     *id = 0;
-    jf_header = buf;
-    if (STORE_PADDING == jf_header->type) {
+    type = *(uint8_t *)buf;
+    if (STORE_PADDING == type) {
         debug(D_RRDENGINE, "Skipping padding.");
         return 0;
     }
-    if (sizeof(*jf_header) > max_size) {
-        error("Corrupted transaction record, skipping.");
-        return 0;
+    if (1 == journalfile->version) {
+        struct rrdeng_jf_transaction_header_v1 *jf_header = buf;
+
+        header_size = sizeof(*jf_header);
+        if (header_size > max_size) {
+            error("Corrupted transaction record, skipping.");
+            return 0;
+        }
+        *id = jf_header->id;
+        payload_length = jf_header->payload_length;
+    } else {
+        struct rrdeng_jf_transaction_header *jf_header = buf;
+
+        header_size = sizeof(*jf_header);
+        if (header_size > max_size) {
+            error("Corrupted transaction record, skipping.");
+            return 0;
+        }
+        *id = jf_header->id;
+        payload_length = jf_header->payload_length;
     }
-    *id = jf_header->id;
-    payload_length = jf_header->payload_length;
-    size_bytes = sizeof(*jf_header) + payload_length + sizeof(*jf_trailer);
+    size_bytes = header_size + payload_length + sizeof(*jf_trailer);
     if (size_bytes > max_size) {
-        error("Corrupted transaction record, skipping.");
-        return 0;
+        if (1 == journalfile->version) {
+            error("Corrupted transaction record, skipping.");
+            return 0;
+        }
+        *id = 0;
+        return size_bytes;
     }
-    jf_trailer = buf + sizeof(*jf_header) + payload_length;
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, buf, sizeof(*jf_header) + payload_length);
+    jf_trailer = buf + header_size + payload_length;
+    crc = rrdeng_checksum(journalfile->version, buf, header_size + payload_length);
     ret = crc32cmp(jf_trailer->checksum, crc);
-    debug(D_RRDENGINE, "Transaction %"PRIu64" was read from disk. CRC32 check: %s", *id, ret ? "FAILED" : "SUCCEEDED");
+    debug(D_RRDENGINE, "Transaction %"PRIu64" was read from disk. Checksum check: %s", *id, ret ? "FAILED" : "SUCCEEDED");
     if (unlikely(ret)) {
         return size_bytes;
     }
-    switch (jf_header->type) {
+    switch (type) {
     case STORE_DATA:
-        debug(D_RRDENGINE, "Replaying transaction %"PRIu64"", jf_header->id);
-        restore_extent_metadata(ctx, journalfile, buf + sizeof(*jf_header), payload_length);
+        debug(D_RRDENGINE, "Replaying transaction %"PRIu64"", *id);
+        restore_extent_metadata(ctx, journalfile, buf + header_size, payload_length);
         break;
     default:
         error("Unknown transaction type. Skipping record.");
@@ -391,7 +524,7 @@ static uint64_t iterate_transactions(struct rrdengine_instance *ctx, struct rrde
         fatal("posix_memalign:%s", strerror(ret));
     }
 
-    for (pos = sizeof(struct rrdeng_jf_sb) ; pos < file_size ; pos += READAHEAD_BYTES) {
+    for (pos = sizeof(struct rrdeng_jf_sb) ; pos < file_size ; pos += pos_i) {
         size_bytes = MIN(READAHEAD_BYTES, file_size - pos);
         iov = uv_buf_init(buf, size_bytes);
         ret = uv_fs_read(NULL, &req, file, &iov, 1, pos, NULL);
@@ -409,9 +542,19 @@ static uint64_t iterate_transactions(struct rrdengine_instance *ctx, struct rrde
         for (pos_i = 0 ; pos_i < size_bytes ; ) {
             unsigned max_size;
 
-            max_size = pos + size_bytes - pos_i;
+            max_size = size_bytes - pos_i;
             ret = replay_transaction(ctx, journalfile, buf + pos_i, &id, max_size);
-            if (!ret) /* TODO: support transactions bigger than 4K */
+            if ((unsigned)ret > max_size) {
+                /* multi-block transactions start at block boundaries */
+                if (pos_i && pos_i == ALIGN_BYTES_FLOOR(pos_i) && pos + pos_i + ret <= file_size &&
+                    ret <= READAHEAD_BYTES) {
+                    /* the transaction crosses the read-ahead window, read it again from its start */
+                    break;
+                }
+                error("Corrupted transaction record, skipping.");
+                ret = 0;
+            }
+            if (!ret)
                 /* unknown transaction size, move on to the next block */
                 pos_i = ALIGN_BYTES_FLOOR(pos_i + RRDENG_BLOCK_SIZE);
             else
@@ -424,6 +567,329 @@ static uint64_t iterate_transactions(struct rrdengine_instance *ctx, struct rrde
     return max_id;
 }
 
+struct journal_index_entry {
+    struct rrdeng_page_descr *descr;
+    uint32_t extent_index;
+    uint16_t extent_page_index;
+};
+
+static int journal_index_entry_cmp(const void *a, const void *b)
+{
+    const struct journal_index_entry *entry1 = a, *entry2 = b;
+    int ret;
+
+    ret = memcmp(entry1->descr->id, entry2->descr->id, sizeof(uuid_t));
+    if (ret)
+        return ret;
+    if (pg_descr_start_time(entry1->descr) < pg_descr_start_time(entry2->descr))
+        return -1;
+    return (pg_descr_start_time(entry1->descr) > pg_descr_start_time(entry2->descr)) ? 1 : 0;
+}
+
+/*
+ * Writes the index of a sealed journal file so that the next startup does not need to replay the journal.
+ * The data file must not receive any more extents and must not be under deletion.
+ * Returns 0 on success.
+ */
+int write_journal_index(struct rrdengine_instance *ctx, struct rrdengine_datafile *datafile)
+{
+    struct rrdengine_journalfile *journalfile = datafile->journalfile;
+    struct extent_info *extent;
+    struct journal_index_entry *entries;
+    uv_fs_t req;
+    uv_file file;
+    uv_buf_t iov;
+    int ret, fd;
+    unsigned i;
+    uint32_t nr_extents, nr_metrics, metric_pages;
+    uint64_t nr_pages, page, size_bytes;
+    void *buf;
+    uLong crc;
+    char path[RRDENG_PATH_MAX];
+    /* persistent structures */
+    struct rrdeng_ji_header *header;
+    struct rrdeng_ji_extent *ji_extents;
+    struct rrdeng_ji_metric *ji_metrics;
+    struct rrdeng_ji_page *ji_pages;
+
+    for (nr_extents = 0, nr_pages = 0, extent = datafile->extents.first ; extent != NULL ; extent = extent->next) {
+        for (i = 0 ; i < extent->number_of_pages ; ++i) {
+            if (extent->pages[i])
+                ++nr_pages;
+        }
+        ++nr_extents;
+    }
+    entries = mallocz(sizeof(*entries) * MAX(nr_pages, 1));
+    for (nr_extents = 0, page = 0, extent = datafile->extents.first ; extent != NULL ; extent = extent->next) {
+        for (i = 0 ; i < extent->number_of_pages ; ++i) {
+            if (!extent->pages[i])
+                continue;
+            entries[page].descr = extent->pages[i];
+            entries[page].extent_index = nr_extents;
+            entries[page].extent_page_index = i;
+            ++page;
+        }
+        ++nr_extents;
+    }
+    qsort(entries, nr_pages, sizeof(*entries), journal_index_entry_cmp);
+    for (nr_metrics = 0, page = 0 ; page < nr_pages ; ++page) {
+        if (0 == page || uuid_compare(*entries[page - 1].descr->id, *entries[page].descr->id))
+            ++nr_metrics;
+    }
+
+    size_bytes = sizeof(*header) + nr_extents * sizeof(*ji_extents) + nr_metrics * sizeof(*ji_metrics) +
+                 nr_pages * sizeof(*ji_pages);
+    buf = mallocz(size_bytes);
+    header = buf;
+    ji_extents = buf + sizeof(*header);
+    ji_metrics = (void *)(ji_extents + nr_extents);
+    ji_pages = (void *)(ji_metrics + nr_metrics);
+
+    (void) strncpy(header->magic_number, RRDENG_JI_MAGIC, RRDENG_MAGIC_SZ);
+    (void) strncpy(header->version, RRDENG_JI_VER, RRDENG_VER_SZ);
+    header->journal_size = journalfile->pos;
+    header->max_transaction_id = ctx->commit_log.transaction_id - 1;
+    header->number_of_extents = nr_extents;
+    header->number_of_metrics = nr_metrics;
+    header->number_of_pages = nr_pages;
+
+    for (i = 0, extent = datafile->extents.first ; extent != NULL ; extent = extent->next, ++i) {
+        ji_extents[i].offset = extent->offset;
+        ji_extents[i].size = extent->size;
+        ji_extents[i].number_of_pages = extent->number_of_pages;
+    }
+    for (nr_metrics = 0, metric_pages = 0, page = 0 ; page < nr_pages ; ++page) {
+        struct rrdeng_page_descr *descr = entries[page].descr;
+
+        if (0 == page || uuid_compare(*entries[page - 1].descr->id, *descr->id)) {
+            if (page)
+                ji_metrics[nr_metrics++].number_of_pages = metric_pages;
+            uuid_copy(*(uuid_t *)ji_metrics[nr_metrics].uuid, *descr->id);
+            metric_pages = 0;
+        }
+        ++metric_pages;
+        ji_pages[page].start_time = pg_descr_start_time(descr);
+        ji_pages[page].end_time = pg_descr_end_time(descr);
+        ji_pages[page].page_length = descr->page_length;
+        ji_pages[page].extent_index = entries[page].extent_index;
+        ji_pages[page].extent_page_index = entries[page].extent_page_index;
+        ji_pages[page].summary_flags = descr->summary.flags;
+        ji_pages[page].count = descr->summary.count;
+        ji_pages[page].min = descr->summary.min;
+        ji_pages[page].max = descr->summary.max;
+        ji_pages[page].sum = descr->summary.sum;
+    }
+    if (nr_pages)
+        ji_metrics[nr_metrics++].number_of_pages = metric_pages;
+    freez(entries);
+
+    crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, buf + sizeof(*header), size_bytes - sizeof(*header));
+    crc32set(header->checksum, crc);
+
+    generate_journalindexpath(datafile, path, sizeof(path));
+    fd = uv_fs_open(NULL, &req, path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR, NULL);
+    uv_fs_req_cleanup(&req);
+    if (fd < 0) {
+        error("uv_fs_open(%s): %s", path, uv_strerror(fd));
+        ++ctx->stats.fs_errors;
+        rrd_stat_atomic_add(&global_fs_errors, 1);
+        freez(buf);
+        return fd;
+    }
+    file = fd;
+
+    iov = uv_buf_init(buf, size_bytes);
+    ret = uv_fs_write(NULL, &req, file, &iov, 1, 0, NULL);
+    if (ret >= 0 && (uint64_t)ret != size_bytes)
+        ret = UV_EIO;
+    if (ret < 0) {
+        error("uv_fs_write(%s): %s", path, uv_strerror(ret));
+        ++ctx->stats.io_errors;
+        rrd_stat_atomic_add(&global_io_errors, 1);
+    }
+    uv_fs_req_cleanup(&req);
+    freez(buf);
+    if (ret >= 0) {
+        ret = uv_fs_fsync(NULL, &req, file, NULL);
+        uv_fs_req_cleanup(&req);
+    }
+    (void) uv_fs_close(NULL, &req, file, NULL);
+    uv_fs_req_cleanup(&req);
+    if (ret < 0) {
+        (void) uv_fs_unlink(NULL, &req, path, NULL);
+        uv_fs_req_cleanup(&req);
+        return ret;
+    }
+    ctx->stats.io_write_bytes += size_bytes;
+    ++ctx->stats.io_write_requests;
+    journalfile->indexed = 1;
+    info("Wrote journal index \"%s\" (%"PRIu32" extents, %"PRIu32" metrics, %"PRIu64" pages).", path, nr_extents,
+         nr_metrics, nr_pages);
+
+    return 0;
+}
+
+/*
+ * Populates the page cache from the journal index of a sealed journal file.
+ * Sets max_id to the maximum transaction id of the journal.
+ * Returns 0 on success, otherwise the journal file must be replayed.
+ */
+static int load_journal_index(struct rrdengine_instance *ctx, struct rrdengine_journalfile *journalfile,
+                              struct rrdengine_datafile *datafile, uint64_t *max_id)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct extent_info **extents, *extent;
+    struct rrdeng_page_descr *descr;
+    struct pg_cache_page_index *page_index;
+    Pvoid_t *PValue;
+    uv_fs_t req;
+    int fd, ret;
+    uint32_t i, j;
+    uint64_t size_bytes, page, pages_sum;
+    void *map;
+    uLong crc;
+    char path[RRDENG_PATH_MAX];
+    /* persistent structures */
+    struct rrdeng_ji_header *header;
+    struct rrdeng_ji_extent *ji_extents;
+    struct rrdeng_ji_metric *ji_metrics;
+    struct rrdeng_ji_page *ji_pages;
+
+    generate_journalindexpath(datafile, path, sizeof(path));
+    fd = uv_fs_open(NULL, &req, path, O_RDONLY, 0, NULL);
+    uv_fs_req_cleanup(&req);
+    if (fd < 0) {
+        /* the journal was not sealed by this version */
+        return fd;
+    }
+    ret = uv_fs_fstat(NULL, &req, fd, NULL);
+    size_bytes = req.statbuf.st_size;
+    uv_fs_req_cleanup(&req);
+    if (ret < 0 || size_bytes < sizeof(*header)) {
+        (void) uv_fs_close(NULL, &req, fd, NULL);
+        uv_fs_req_cleanup(&req);
+        error("Journal index \"%s\" is invalid, replaying the journal file.", path);
+        return UV_EINVAL;
+    }
+    map = mmap(NULL, size_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    (void) uv_fs_close(NULL, &req, fd, NULL);
+    uv_fs_req_cleanup(&req);
+    if (MAP_FAILED == map) {
+        error("Cannot memory map journal index \"%s\", replaying the journal file.", path);
+        return UV_ENOMEM;
+    }
+    ctx->stats.io_read_bytes += size_bytes;
+    ++ctx->stats.io_read_requests;
+
+    /* validate everything before touching the page cache */
+    ret = UV_EINVAL;
+    header = map;
+    ji_extents = map + sizeof(*header);
+    ji_metrics = (void *)(ji_extents + header->number_of_extents);
+    ji_pages = (void *)(ji_metrics + header->number_of_metrics);
+    if (strncmp(header->magic_number, RRDENG_JI_MAGIC, RRDENG_MAGIC_SZ) ||
+        strncmp(header->version, RRDENG_JI_VER, RRDENG_VER_SZ) ||
+        header->journal_size != journalfile->pos ||
+        size_bytes != sizeof(*header) + (uint64_t)header->number_of_extents * sizeof(*ji_extents) +
+                      (uint64_t)header->number_of_metrics * sizeof(*ji_metrics) +
+                      header->number_of_pages * sizeof(*ji_pages)) {
+        goto error;
+    }
+    crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, map + sizeof(*header), size_bytes - sizeof(*header));
+    if (crc32cmp(header->checksum, crc))
+        goto error;
+    for (i = 0 ; i < header->number_of_extents ; ++i) {
+        if (ji_extents[i].number_of_pages > MAX_PAGES_PER_EXTENT)
+            goto error;
+    }
+    for (i = 0, pages_sum = 0 ; i < header->number_of_metrics ; ++i)
+        pages_sum += ji_metrics[i].number_of_pages;
+    if (pages_sum != header->number_of_pages)
+        goto error;
+    for (page = 0 ; page < header->number_of_pages ; ++page) {
+        if (ji_pages[page].extent_index >= header->number_of_extents ||
+            ji_pages[page].extent_page_index >= ji_extents[ji_pages[page].extent_index].number_of_pages)
+            goto error;
+    }
+
+    extents = mallocz(sizeof(*extents) * MAX(header->number_of_extents, 1));
+    for (i = 0 ; i < header->number_of_extents ; ++i) {
+        extent = mallocz(sizeof(*extent) + ji_extents[i].number_of_pages * sizeof(extent->pages[0]));
+        extent->offset = ji_extents[i].offset;
+        extent->size = ji_extents[i].size;
+        extent->number_of_pages = ji_extents[i].number_of_pages;
+        extent->datafile = datafile;
+        extent->next = NULL;
+        for (j = 0 ; j < extent->number_of_pages ; ++j)
+            extent->pages[j] = NULL;
+        extents[i] = extent;
+    }
+    for (i = 0, page = 0 ; i < header->number_of_metrics ; ++i) {
+        uuid_t *temp_id = (uuid_t *)ji_metrics[i].uuid;
+
+        /* one metrics index lookup per metric instead of one per page */
+        uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
+        PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, temp_id, sizeof(uuid_t));
+        if (likely(NULL != PValue)) {
+            page_index = *PValue;
+        }
+        uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
+        if (NULL == PValue) {
+            /* First time we see the UUID */
+            uv_rwlock_wrlock(&pg_cache->metrics_index.lock);
+            PValue = JudyHSIns(&pg_cache->metrics_index.JudyHS_array, temp_id, sizeof(uuid_t), PJE0);
+            assert(NULL == *PValue); /* TODO: figure out concurrency model */
+            *PValue = page_index = create_page_index(temp_id);
+            page_index->prev = pg_cache->metrics_index.last_page_index;
+            pg_cache->metrics_index.last_page_index = page_index;
+            uv_rwlock_wrunlock(&pg_cache->metrics_index.lock);
+        }
+
+        for (j = 0 ; j < ji_metrics[i].number_of_pages ; ++j, ++page) {
+            extent = extents[ji_pages[page].extent_index];
+
+            drop_superseded_page(ctx, page_index, ji_pages[page].start_time);
+            descr = pg_cache_create_descr();
+            descr->page_length = ji_pages[page].page_length;
+            pg_descr_set_start_time(descr, ji_pages[page].start_time);
+            pg_descr_set_end_time(descr, ji_pages[page].end_time);
+            descr->summary.flags = ji_pages[page].summary_flags;
+            descr->summary.count = ji_pages[page].count;
+            descr->summary.min = ji_pages[page].min;
+            descr->summary.max = ji_pages[page].max;
+            descr->summary.sum = ji_pages[page].sum;
+            descr->id = &page_index->id;
+            descr->extent = extent;
+            extent->pages[ji_pages[page].extent_page_index] = descr;
+            pg_cache_insert(ctx, page_index, descr);
+        }
+    }
+    for (i = 0 ; i < header->number_of_extents ; ++i) {
+        extent = extents[i];
+        for (j = 0 ; j < extent->number_of_pages && NULL == extent->pages[j] ; ++j)
+            ;
+        if (likely(j < extent->number_of_pages))
+            df_extent_insert(extent);
+        else
+            freez(extent);
+    }
+    freez(extents);
+
+    *max_id = header->max_transaction_id;
+    journalfile->indexed = 1;
+    info("Loaded journal index \"%s\" (%"PRIu32" extents, %"PRIu32" metrics, %"PRIu64" pages).", path,
+         header->number_of_extents, header->number_of_metrics, (uint64_t)header->number_of_pages);
+    ret = 0;
+
+error:
+    if (ret)
+        error("Journal index \"%s\" is invalid, replaying the journal file.", path);
+    munmap(map, size_bytes);
+    return ret;
+}
+
 int load_journal_file(struct rrdengine_instance *ctx, struct rrdengine_journalfile *journalfile,
                       struct rrdengine_datafile *datafile)
 {
@@ -447,7 +913,7 @@ int load_journal_file(struct rrdengine_instance *ctx, struct rrdengine_journalfi
         goto error;
     file_size = ALIGN_BYTES_FLOOR(file_size);
 
-    ret = check_journal_file_superblock(file);
+    ret = check_journal_file_superblock(file, &journalfile->version);
     if (ret)
         goto error;
     ctx->stats.io_read_bytes += sizeof(struct rrdeng_jf_sb);
@@ -456,11 +922,12 @@ int load_journal_file(struct rrdengine_instance *ctx, struct rrdengine_journalfi
     journalfile->file = file;
     journalfile->pos = file_size;
 
-    max_id = iterate_transactions(ctx, journalfile);
+    if (load_journal_index(ctx, journalfile, datafile, &max_id))
+        max_id = iterate_transactions(ctx, journalfile);
 
     ctx->commit_log.transaction_id = MAX(ctx->commit_log.transaction_id, max_id + 1);
 
-    info("Journal file \"%s\" loaded (size:%"PRIu64").", path, file_size);
+    info("Journal file \"%s\" loaded (size:%"PRIu64", version:%u).", path, file_size, journalfile->version);
     return 0;
 
     error:
@@ -14,11 +14,17 @@ struct rrdengine_journalfile;
 #define WALFILE_PREFIX "journalfile-"
 #define WALFILE_EXTENSION ".njf"
 
+#define WALFILE_VERSION (4) /* matches RRDENG_JF_VER */
+
+#define WALFILE_INDEX_EXTENSION ".nji"
+
 
 /* only one event loop is supported for now */
 struct rrdengine_journalfile {
     uv_file file;
     uint64_t pos;
+    unsigned version; /* on-disk format version, 1 to 4 */
+    uint8_t indexed; /* a valid journal index file exists */
 
     struct rrdengine_datafile *datafile;
 };
@@ -34,6 +40,7 @@ struct transaction_commit_log {
 };
 
 extern void generate_journalfilepath(struct rrdengine_datafile *datafile, char *str, size_t maxlen);
+extern void generate_journalindexpath(struct rrdengine_datafile *datafile, char *str, size_t maxlen);
 extern void journalfile_init(struct rrdengine_journalfile *journalfile, struct rrdengine_datafile *datafile);
 extern void *wal_get_transaction_buffer(struct rrdengine_worker_config* wc, unsigned size);
 extern void wal_flush_transaction_buffer(struct rrdengine_worker_config* wc);
@@ -43,6 +50,7 @@ extern int create_journal_file(struct rrdengine_journalfile *journalfile, struct
 extern int load_journal_file(struct rrdengine_instance *ctx, struct rrdengine_journalfile *journalfile,
                              struct rrdengine_datafile *datafile);
 extern void init_commit_log(struct rrdengine_instance *ctx);
+extern int write_journal_index(struct rrdengine_instance *ctx, struct rrdengine_datafile *datafile);
 
 
 #endif /* NETDATA_JOURNALFILE_H */
\ No newline at end of file
@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "rrdengine.h"
+
+/* the longest name of a metric: the machine GUID, the chart id and the dimension id */
+#define METRICDIR_NAME_MAX (GUID_LEN + 1 + RRD_ID_LENGTH_MAX + 1 + RRD_ID_LENGTH_MAX)
+
+#define METRICDIR_RECORD_SIZE(name_length) (sizeof(struct rrdeng_md_record) + (name_length) + CHECKSUM_SZ)
+
+/* The UUID of the metrics of the versions without a metric directory, the directory keeps using it */
+void rrdeng_generate_legacy_uuid(const char *dim_id, const char *chart_id, const char *machine_guid,
+                                 uuid_t *ret_uuid)
+{
+    EVP_MD_CTX *evpctx;
+    unsigned char hash_value[EVP_MAX_MD_SIZE];
+    unsigned int hash_len;
+
+    evpctx = EVP_MD_CTX_create();
+    EVP_DigestInit_ex(evpctx, EVP_sha256(), NULL);
+    if (machine_guid) {
+        /* the same chart and dimension of different hosts are different metrics of multihost instances */
+        EVP_DigestUpdate(evpctx, machine_guid, strlen(machine_guid));
+    }
+    EVP_DigestUpdate(evpctx, dim_id, strlen(dim_id));
+    EVP_DigestUpdate(evpctx, chart_id, strlen(chart_id));
+    EVP_DigestFinal_ex(evpctx, hash_value, &hash_len);
+    EVP_MD_CTX_destroy(evpctx);
+    assert(hash_len > sizeof(uuid_t));
+    memcpy(ret_uuid, hash_value, sizeof(uuid_t));
+}
+
+/* Returns the length of the name of the metric of rd */
+static size_t metricdir_name(struct rrdengine_instance *ctx, RRDDIM *rd, char *name)
+{
+    size_t len = 0, n;
+
+    if (ctx->multihost) {
+        n = strnlen(rd->rrdset->rrdhost->machine_guid, GUID_LEN);
+        memcpy(name, rd->rrdset->rrdhost->machine_guid, n);
+        len += n;
+        name[len++] = '\0';
+    }
+    n = strnlen(rd->rrdset->id, RRD_ID_LENGTH_MAX);
+    memcpy(&name[len], rd->rrdset->id, n);
+    len += n;
+    name[len++] = '\0';
+    n = strnlen(rd->id, RRD_ID_LENGTH_MAX);
+    memcpy(&name[len], rd->id, n);
+    len += n;
+
+    return len;
+}
+
+/* The caller must hold the write lock of the directory */
+static struct metricdir_entry *metricdir_add(struct metricdir *md, Pvoid_t *PValue, uuid_t *id, Word_t metric_id)
+{
+    struct metricdir_entry *entry;
+
+    entry = mallocz(sizeof(*entry));
+    uuid_copy(entry->id, *id);
+    entry->metric_id = metric_id;
+    *PValue = entry;
+
+    if (metric_id > md->size) {
+        Word_t size = MAX(md->size * 2, metric_id);
+
+        md->entries = reallocz(md->entries, size * sizeof(*md->entries));
+        memset(&md->entries[md->size], 0, (size - md->size) * sizeof(*md->entries));
+        md->size = size;
+    }
+    md->entries[metric_id - 1] = entry;
+    md->nr_entries = MAX(md->nr_entries, metric_id);
+    return entry;
+}
+
+/* Appends the record of a metric to the file, the caller must hold the write lock of the directory */
+static void metricdir_append(struct rrdengine_instance *ctx, struct metricdir *md, struct metricdir_entry *entry,
+                             char *name, size_t name_length)
+{
+    struct rrdeng_md_record *record;
+    size_t size_bytes = METRICDIR_RECORD_SIZE(name_length);
+    char buf[METRICDIR_RECORD_SIZE(METRICDIR_NAME_MAX)];
+    uv_fs_t req;
+    uv_buf_t iov;
+    uLong crc;
+    int ret;
+
+    if (md->fd < 0)
+        return;
+
+    record = (struct rrdeng_md_record *)buf;
+    record->metric_id = (uint32_t)entry->metric_id;
+    uuid_copy(*(uuid_t *)record->uuid, entry->id);
+    record->name_length = (uint16_t)name_length;
+    memcpy(record->name, name, name_length);
+    crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (void *)buf, size_bytes - CHECKSUM_SZ);
+    crc32set(buf + size_bytes - CHECKSUM_SZ, crc);
+
+    /* the file is synced when the instance exits, the records lost on a crash are derived again */
+    iov = uv_buf_init(buf, size_bytes);
+    ret = uv_fs_write(NULL, &req, md->fd, &iov, 1, -1, NULL);
+    if (ret >= 0 && (size_t)ret != size_bytes)
+        ret = UV_EIO;
+    uv_fs_req_cleanup(&req);
+    if (ret < 0) {
+        error("Cannot append to the metric directory \"%s\", it will not be updated: %s", md->path, uv_strerror(ret));
+        ++ctx->stats.io_errors;
+        rrd_stat_atomic_add(&global_io_errors, 1);
+        (void) uv_fs_close(NULL, &req, md->fd, NULL);
+        uv_fs_req_cleanup(&req);
+        md->fd = -1;
+        return;
+    }
+    ctx->stats.io_write_bytes += size_bytes;
+    ++ctx->stats.io_write_requests;
+}
+
+/* Returns the size of the valid part of the file, 0 when it has to be created again */
+static uint64_t metricdir_load(struct rrdengine_instance *ctx, struct metricdir *md, int fd)
+{
+    struct rrdeng_md_header *header;
+    struct rrdeng_md_record *record;
+    uint64_t size_bytes, pos, record_size;
+    Pvoid_t *PValue;
+    void *map;
+    uv_fs_t req;
+    uLong crc;
+    int ret;
+
+    ret = uv_fs_fstat(NULL, &req, fd, NULL);
+    size_bytes = req.statbuf.st_size;
+    uv_fs_req_cleanup(&req);
+    if (ret < 0 || size_bytes < sizeof(*header))
+        return 0;
+    map = mmap(NULL, size_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == map) {
+        error("Cannot memory map the metric directory \"%s\".", md->path);
+        return 0;
+    }
+    ctx->stats.io_read_bytes += size_bytes;
+    ++ctx->stats.io_read_requests;
+
+    header = map;
+    if (strncmp(header->magic_number, RRDENG_MD_MAGIC, RRDENG_MAGIC_SZ) ||
+        strncmp(header->version, RRDENG_MD_VER, RRDENG_VER_SZ)) {
+        error("Metric directory \"%s\" is invalid, creating it again.", md->path);
+        (void) munmap(map, size_bytes);
+        return 0;
+    }
+
+    for (pos = sizeof(*header) ; pos + sizeof(*record) <= size_bytes ; pos += record_size) {
+        record = map + pos;
+        record_size = METRICDIR_RECORD_SIZE(record->name_length);
+        if (pos + record_size > size_bytes || 0 == record->metric_id || record->name_length > METRICDIR_NAME_MAX)
+            break;
+        crc = crc32(0L, Z_NULL, 0);
+        crc = crc32(crc, (void *)record, record_size - CHECKSUM_SZ);
+        if (crc32cmp((uint8_t *)record + record_size - CHECKSUM_SZ, crc))
+            break;
+
+        if (record->metric_id <= md->size && md->entries[record->metric_id - 1])
+            continue; /* a metric id cannot be used twice */
+        PValue = JudyHSIns(&md->JudyHS_array, record->name, record->name_length, PJE0);
+        if (NULL == *PValue)
+            (void) metricdir_add(md, PValue, (uuid_t *)record->uuid, record->metric_id);
+    }
+    if (pos != size_bytes) {
+        /* a record was not written completely when netdata stopped */
+        info("Metric directory \"%s\" has %"PRIu64" invalid bytes at its end, they are dropped.", md->path,
+             size_bytes - pos);
+    }
+    (void) munmap(map, size_bytes);
+    return pos;
+}
+
+/* Loads the metric directory of the instance, or creates it */
+void metricdir_init(struct rrdengine_instance *ctx)
+{
+    struct metricdir *md;
+    struct rrdeng_md_header header;
+    uint64_t pos;
+    uv_fs_t req;
+    uv_buf_t iov;
+    int fd, ret;
+
+    md = callocz(1, sizeof(*md));
+    assert(0 == uv_rwlock_init(&md->lock));
+    md->JudyHS_array = (Pvoid_t) NULL;
+    md->fd = -1;
+    snprintfz(md->path, RRDENG_PATH_MAX - 1, "%s/" METRICDIR_FILE, ctx->dbfiles_path);
+    ctx->metricdir = md;
+
+    fd = uv_fs_open(NULL, &req, md->path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR, NULL);
+    uv_fs_req_cleanup(&req);
+    if (fd < 0) {
+        error("uv_fs_open(%s): %s", md->path, uv_strerror(fd));
+        ++ctx->stats.fs_errors;
+        rrd_stat_atomic_add(&global_fs_errors, 1);
+        return;
+    }
+
+    pos = metricdir_load(ctx, md, fd);
+    if (0 == pos) {
+        memset(&header, 0, sizeof(header));
+        (void) strncpy(header.magic_number, RRDENG_MD_MAGIC, RRDENG_MAGIC_SZ);
+        (void) strncpy(header.version, RRDENG_MD_VER, RRDENG_VER_SZ);
+        iov = uv_buf_init((void *)&header, sizeof(header));
+        ret = uv_fs_write(NULL, &req, fd, &iov, 1, 0, NULL);
+        uv_fs_req_cleanup(&req);
+        if (ret != sizeof(header)) {
+            error("Cannot write the metric directory \"%s\".", md->path);
+            ++ctx->stats.io_errors;
+            rrd_stat_atomic_add(&global_io_errors, 1);
+            (void) uv_fs_close(NULL, &req, fd, NULL);
+            uv_fs_req_cleanup(&req);
+            return;
+        }
+        pos = sizeof(header);
+    }
+    /* the records are appended after the valid ones */
+    ret = uv_fs_ftruncate(NULL, &req, fd, pos, NULL);
+    uv_fs_req_cleanup(&req);
+    if (ret < 0 || (off_t)pos != lseek(fd, pos, SEEK_SET)) {
+        error("Cannot truncate the metric directory \"%s\".", md->path);
+        ++ctx->stats.fs_errors;
+        rrd_stat_atomic_add(&global_fs_errors, 1);
+        (void) uv_fs_close(NULL, &req, fd, NULL);
+        uv_fs_req_cleanup(&req);
+        return;
+    }
+    md->fd = fd;
+    info("Metric directory \"%s\" has %lu metrics.", md->path, (unsigned long)md->nr_entries);
+}
+
+void metricdir_exit(struct rrdengine_instance *ctx)
+{
+    struct metricdir *md = ctx->metricdir;
+    uv_fs_t req;
+    Word_t i;
+
+    if (NULL == md)
+        return;
+
+    if (md->fd >= 0) {
+        (void) uv_fs_fsync(NULL, &req, md->fd, NULL);
+        uv_fs_req_cleanup(&req);
+        (void) uv_fs_close(NULL, &req, md->fd, NULL);
+        uv_fs_req_cleanup(&req);
+    }
+    (void) JudyHSFreeArray(&md->JudyHS_array, PJE0);
+    for (i = 0 ; i < md->nr_entries ; ++i)
+        freez(md->entries[i]);
+    freez(md->entries);
+    uv_rwlock_destroy(&md->lock);
+    freez(md);
+    ctx->metricdir = NULL;
+}
+
+/*
+ * Returns the entry of the metric of rd, it is added to the directory when it is seen for the first time.
+ * Returns NULL when the instance has no metric directory.
+ */
+struct metricdir_entry *metricdir_get(struct rrdengine_instance *ctx, RRDDIM *rd)
+{
+    struct metricdir *md = ctx->metricdir;
+    struct metricdir_entry *entry = NULL;
+    char name[METRICDIR_NAME_MAX];
+    size_t name_length;
+    Pvoid_t *PValue;
+    uuid_t id;
+
+    if (unlikely(NULL == md))
+        return NULL;
+
+    name_length = metricdir_name(ctx, rd, name);
+    uv_rwlock_rdlock(&md->lock);
+    PValue = JudyHSGet(md->JudyHS_array, name, name_length);
+    if (likely(NULL != PValue))
+        entry = *PValue;
+    uv_rwlock_rdunlock(&md->lock);
+    if (likely(NULL != entry))
+        return entry;
+
+    /* First time we see the metric */
+    rrdeng_generate_legacy_uuid(rd->id, rd->rrdset->id, ctx->multihost ? rd->rrdset->rrdhost->machine_guid : NULL,
+                                &id);
+    uv_rwlock_wrlock(&md->lock);
+    PValue = JudyHSIns(&md->JudyHS_array, name, name_length, PJE0);
+    entry = *PValue;
+    if (NULL == entry) {
+        entry = metricdir_add(md, PValue, &id, md->nr_entries + 1);
+        metricdir_append(ctx, md, entry, name, name_length);
+    }
+    uv_rwlock_wrunlock(&md->lock);
+    return entry;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_METRICDIR_H
+#define NETDATA_METRICDIR_H
+
+#include "rrdengine.h"
+
+/* Forward declarations */
+struct rrdengine_instance;
+
+#define METRICDIR_FILE "metrics.dir"
+
+/* a metric of the directory, entries are never freed while the instance is running */
+struct metricdir_entry {
+    uuid_t id;
+    Word_t metric_id; /* compact number of the metric in its instance, starting from 1 */
+};
+
+/*
+ * Maps the chart and dimension ids of the metrics (and the machine GUID of their host in multihost instances) to
+ * their UUIDs and compact metric ids, so that the UUIDs are not derived again at every startup and the page
+ * indices of the metrics can be looked up by metric id. It is persisted in the metric directory file of the
+ * instance, that every metric seen for the first time is appended to.
+ */
+struct metricdir {
+    uv_rwlock_t lock;
+    Pvoid_t JudyHS_array; /* metric names to entries */
+    struct metricdir_entry **entries; /* indexed by metric id - 1 */
+    Word_t nr_entries;
+    Word_t size;
+    int fd; /* -1 when the file cannot be written, the directory keeps working in memory */
+    char path[RRDENG_PATH_MAX];
+};
+
+extern void metricdir_init(struct rrdengine_instance *ctx);
+extern void metricdir_exit(struct rrdengine_instance *ctx);
+extern struct metricdir_entry *metricdir_get(struct rrdengine_instance *ctx, RRDDIM *rd);
+extern void rrdeng_generate_legacy_uuid(const char *dim_id, const char *chart_id, const char *machine_guid,
+                                        uuid_t *ret_uuid);
+
+#endif /* NETDATA_METRICDIR_H */
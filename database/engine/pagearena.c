@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "rrdengine.h"
+
+/*
+ * The pages of the page cache come from a slab shared by all DB engine instances. When NUMA node arenas are
+ * enabled, every node has its own slab whose memory is bound to the node instead. Every instance keeps a share of
+ * its page cache on every node, pages are allocated from the node of the thread that is going to use them and,
+ * under pressure, the pages of that node are evicted first so that they can be reused locally.
+ */
+
+unsigned page_arena_nodes = 0;
+
+static struct rrdeng_slab page_slab = RRDENG_SLAB_INITIALIZER(RRDENG_SLAB_PAGES, RRDENG_BLOCK_SIZE,
+                                                              PAGE_ARENA_SLAB_PAGES);
+static struct rrdeng_slab page_arenas[RRDENG_MAX_NUMA_NODES];
+static uint8_t page_arena_cpu_node[PAGE_ARENA_MAX_CPUS];
+
+/* Parses cpulist, e.g. "0-3,8-11", and maps its CPUs to node */
+static void page_arena_map_cpus(char *cpulist, uint8_t node)
+{
+    char *s = cpulist, *end;
+    unsigned long first, last, cpu;
+
+    while (*s) {
+        first = strtoul(s, &end, 10);
+        if (end == s)
+            break;
+        last = first;
+        s = end;
+        if ('-' == *s) {
+            last = strtoul(s + 1, &end, 10);
+            s = end;
+        }
+        for (cpu = first ; cpu <= last && cpu < PAGE_ARENA_MAX_CPUS ; ++cpu)
+            page_arena_cpu_node[cpu] = node;
+        if (',' != *s)
+            break;
+        ++s;
+    }
+}
+
+/*
+ * Maps the CPUs of the system to their NUMA nodes.
+ * Returns the number of NUMA nodes, 1 when the system does not report any.
+ */
+unsigned page_arena_detect_nodes(void)
+{
+    unsigned node, nr_nodes;
+    char path[RRDENG_PATH_MAX], cpulist[4096];
+    FILE *fp;
+
+    memset(page_arena_cpu_node, 0, sizeof(page_arena_cpu_node));
+    for (node = 0, nr_nodes = 1 ; node < RRDENG_MAX_NUMA_NODES ; ++node) {
+        snprintfz(path, RRDENG_PATH_MAX - 1, "/sys/devices/system/node/node%u/cpulist", node);
+        fp = fopen(path, "r");
+        if (NULL == fp)
+            continue;
+        if (NULL != fgets(cpulist, sizeof(cpulist), fp)) {
+            page_arena_map_cpus(cpulist, node);
+            nr_nodes = node + 1;
+        }
+        fclose(fp);
+    }
+    return nr_nodes;
+}
+
+/* The page cache is allocated from the arenas of nr_nodes NUMA nodes from now on */
+void page_arena_init(unsigned nr_nodes)
+{
+    unsigned node;
+
+    assert(nr_nodes && nr_nodes <= RRDENG_MAX_NUMA_NODES);
+    for (node = 0 ; node < nr_nodes ; ++node) {
+        rrdeng_slab_init(&page_arenas[node], RRDENG_SLAB_NUMA_PAGES + node, RRDENG_BLOCK_SIZE, PAGE_ARENA_SLAB_PAGES,
+                         (int)node);
+    }
+    page_arena_nodes = nr_nodes;
+    info("DBENGINE: allocating the page cache from the arenas of %u NUMA nodes.", nr_nodes);
+}
+
+unsigned page_arena_current_node(void)
+{
+#ifdef HAVE_SCHED_GETCPU
+    int cpu = sched_getcpu();
+
+    if (likely(cpu >= 0 && cpu < PAGE_ARENA_MAX_CPUS && page_arena_cpu_node[cpu] < page_arena_nodes))
+        return page_arena_cpu_node[cpu];
+#endif
+    return 0;
+}
+
+/*
+ * Picks the NUMA node the pages the calling thread is going to use should be allocated from, which is also the one
+ * whose pages are evicted first. That is the local node, unless its share of the page cache of ctx is used up.
+ */
+uint8_t page_arena_pick_node(struct rrdengine_instance *ctx)
+{
+    unsigned node, i, best;
+    unsigned long pages, room, best_room;
+
+    if (!page_arena_nodes)
+        return RRDENG_NUMA_NODE_ANY;
+
+    node = page_arena_current_node();
+    if (__atomic_load_n(&ctx->node_pages[node], __ATOMIC_RELAXED) < ctx->node_max_pages[node])
+        return node;
+    for (i = 0, best = node, best_room = 0 ; i < page_arena_nodes ; ++i) {
+        pages = __atomic_load_n(&ctx->node_pages[i], __ATOMIC_RELAXED);
+        room = (ctx->node_max_pages[i] > pages) ? ctx->node_max_pages[i] - pages : 0;
+        if (room > best_room) {
+            best = i;
+            best_room = room;
+        }
+    }
+    return best;
+}
+
+/*
+ * Allocates a page of ctx from the arena of node, from the page slab if node is RRDENG_NUMA_NODE_ANY or from the
+ * heap if node is RRDENG_NUMA_NODE_NONE. Only the heap can allocate pages that are not RRDENG_BLOCK_SIZE bytes.
+ */
+void *page_arena_alloc(struct rrdengine_instance *ctx, uint8_t node, uint32_t size)
+{
+    if (RRDENG_NUMA_NODE_NONE == node)
+        return mallocz(size);
+
+    assert(RRDENG_BLOCK_SIZE == size);
+    if (RRDENG_NUMA_NODE_ANY == node)
+        return rrdeng_slab_alloc(&page_slab);
+
+    assert(node < page_arena_nodes);
+    __atomic_add_fetch(&ctx->node_pages[node], 1, __ATOMIC_RELAXED);
+    return rrdeng_slab_alloc(&page_arenas[node]);
+}
+
+/* Frees a page of ctx that was allocated by page_arena_alloc() with the same node */
+void page_arena_free(struct rrdengine_instance *ctx, void *page, uint8_t node)
+{
+    if (RRDENG_NUMA_NODE_NONE == node) {
+        freez(page);
+        return;
+    }
+    if (RRDENG_NUMA_NODE_ANY == node) {
+        rrdeng_slab_free(&page_slab, page);
+        return;
+    }
+    rrdeng_slab_free(&page_arenas[node], page);
+    __atomic_sub_fetch(&ctx->node_pages[node], 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_PAGEARENA_H
+#define NETDATA_PAGEARENA_H
+
+#include "rrdengine.h"
+
+/* Forward declarations */
+struct rrdengine_instance;
+
+#define RRDENG_NUMA_NODE_NONE (0xFF) /* the page was allocated from the heap */
+#define RRDENG_NUMA_NODE_ANY (0xFE) /* the page was allocated from the page slab, NUMA node arenas are not used */
+
+#define PAGE_ARENA_SLAB_PAGES (512) /* pages the slabs of the page cache grow by, 2MiB */
+#define PAGE_ARENA_MAX_CPUS (4096)
+
+extern unsigned page_arena_nodes; /* 0 when the pages of the page cache are not allocated from arenas */
+
+extern unsigned page_arena_detect_nodes(void);
+extern void page_arena_init(unsigned nr_nodes);
+extern unsigned page_arena_current_node(void);
+extern uint8_t page_arena_pick_node(struct rrdengine_instance *ctx);
+extern void *page_arena_alloc(struct rrdengine_instance *ctx, uint8_t node, uint32_t size);
+extern void page_arena_free(struct rrdengine_instance *ctx, void *page, uint8_t node);
+
+#endif /* NETDATA_PAGEARENA_H */
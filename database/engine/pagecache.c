@@ -6,27 +6,49 @@
 /* Forward declerations */
 static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx);
 
-/* always inserts into tail */
-static inline void pg_cache_replaceQ_insert_unsafe(struct rrdengine_instance *ctx,
+static inline struct pg_cache_replaceQ_shard *pg_cache_replaceQ_shard(struct rrdengine_instance *ctx,
+                                                                       struct rrdeng_page_descr *descr)
+{
+    /* page descriptors never move in memory, discard the low bits that are common due to alignment */
+    return &ctx->pg_cache.replaceQ.shards[((uintptr_t)descr >> 4) % PG_CACHE_REPLACEQ_SHARDS];
+}
+
+/* always inserts into tail, the caller must hold the shard lock */
+static inline void pg_cache_replaceQ_insert_unsafe(struct pg_cache_replaceQ_shard *shard,
                                                    struct rrdeng_page_descr *descr)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
     struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
 
-    if (likely(NULL != pg_cache->replaceQ.tail)) {
-        pg_cache_descr->prev = pg_cache->replaceQ.tail;
-        pg_cache->replaceQ.tail->next = pg_cache_descr;
+    if (likely(NULL != shard->tail)) {
+        pg_cache_descr->prev = shard->tail;
+        shard->tail->next = pg_cache_descr;
     }
-    if (unlikely(NULL == pg_cache->replaceQ.head)) {
-        pg_cache->replaceQ.head = pg_cache_descr;
+    if (unlikely(NULL == shard->head)) {
+        shard->head = pg_cache_descr;
     }
-    pg_cache->replaceQ.tail = pg_cache_descr;
+    shard->tail = pg_cache_descr;
 }
 
-static inline void pg_cache_replaceQ_delete_unsafe(struct rrdengine_instance *ctx,
+/* inserts into head, where the next victim is looked for, the caller must hold the shard lock */
+static inline void pg_cache_replaceQ_insert_head_unsafe(struct pg_cache_replaceQ_shard *shard,
+                                                        struct rrdeng_page_descr *descr)
+{
+    struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
+
+    if (likely(NULL != shard->head)) {
+        pg_cache_descr->next = shard->head;
+        shard->head->prev = pg_cache_descr;
+    }
+    if (unlikely(NULL == shard->tail)) {
+        shard->tail = pg_cache_descr;
+    }
+    shard->head = pg_cache_descr;
+}
+
+/* the caller must hold the shard lock */
+static inline void pg_cache_replaceQ_delete_unsafe(struct pg_cache_replaceQ_shard *shard,
                                                    struct rrdeng_page_descr *descr)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
     struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr, *prev, *next;
 
     prev = pg_cache_descr->prev;
@@ -38,11 +60,11 @@ static inline void pg_cache_replaceQ_delete_unsafe(struct rrdengine_instance *ct
     if (likely(NULL != next)) {
         next->prev = prev;
     }
-    if (unlikely(pg_cache_descr == pg_cache->replaceQ.head)) {
-        pg_cache->replaceQ.head = next;
+    if (unlikely(pg_cache_descr == shard->head)) {
+        shard->head = next;
     }
-    if (unlikely(pg_cache_descr == pg_cache->replaceQ.tail)) {
-        pg_cache->replaceQ.tail = prev;
+    if (unlikely(pg_cache_descr == shard->tail)) {
+        shard->tail = prev;
     }
     pg_cache_descr->prev = pg_cache_descr->next = NULL;
 }
@@ -50,45 +72,71 @@ static inline void pg_cache_replaceQ_delete_unsafe(struct rrdengine_instance *ct
 void pg_cache_replaceQ_insert(struct rrdengine_instance *ctx,
                               struct rrdeng_page_descr *descr)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_replaceQ_shard *shard = pg_cache_replaceQ_shard(ctx, descr);
 
-    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    pg_cache_replaceQ_insert_unsafe(ctx, descr);
-    uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
+    descr->pg_cache_descr->referenced = 0;
+    uv_rwlock_wrlock(&shard->lock);
+    /* the pages of scan queries are the first to go */
+    if (unlikely(descr->pg_cache_descr->flags & RRD_PAGE_SCAN))
+        pg_cache_replaceQ_insert_head_unsafe(shard, descr);
+    else
+        pg_cache_replaceQ_insert_unsafe(shard, descr);
+    uv_rwlock_wrunlock(&shard->lock);
 }
 
 void pg_cache_replaceQ_delete(struct rrdengine_instance *ctx,
                               struct rrdeng_page_descr *descr)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_replaceQ_shard *shard = pg_cache_replaceQ_shard(ctx, descr);
 
-    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    pg_cache_replaceQ_delete_unsafe(ctx, descr);
-    uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
+    uv_rwlock_wrlock(&shard->lock);
+    pg_cache_replaceQ_delete_unsafe(shard, descr);
+    uv_rwlock_wrunlock(&shard->lock);
 }
+
+/* The caller must hold a reference to the page so that its page cache descriptor cannot go away */
 void pg_cache_replaceQ_set_hot(struct rrdengine_instance *ctx,
                                struct rrdeng_page_descr *descr)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
+    (void)ctx;
+
+    if (!pg_cache_descr->referenced)
+        __atomic_store_n(&pg_cache_descr->referenced, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Page descriptors are the most numerous allocations of the DB engine, so they are carved out of the chunks of a
+ * slab shared by all DB engine instances instead of being allocated one by one.
+ */
+#define PG_CACHE_DESCR_CHUNK_ENTRIES (1024)
+
+static struct rrdeng_slab descr_slab = RRDENG_SLAB_INITIALIZER(RRDENG_SLAB_PAGE_DESCR, sizeof(struct rrdeng_page_descr),
+                                                               PG_CACHE_DESCR_CHUNK_ENTRIES);
 
-    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    pg_cache_replaceQ_delete_unsafe(ctx, descr);
-    pg_cache_replaceQ_insert_unsafe(ctx, descr);
-    uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
+static inline struct rrdeng_page_descr *pg_cache_alloc_descr(void)
+{
+    return rrdeng_slab_alloc(&descr_slab);
+}
+
+void pg_cache_free_descr(struct rrdeng_page_descr *descr)
+{
+    rrdeng_slab_free(&descr_slab, descr);
 }
 
 struct rrdeng_page_descr *pg_cache_create_descr(void)
 {
     struct rrdeng_page_descr *descr;
 
-    descr = mallocz(sizeof(*descr));
+    descr = pg_cache_alloc_descr();
     descr->page_length = 0;
-    descr->start_time = INVALID_TIME;
-    descr->end_time = INVALID_TIME;
+    pg_descr_set_start_time(descr, INVALID_TIME);
+    pg_descr_set_end_time(descr, INVALID_TIME);
     descr->id = NULL;
     descr->extent = NULL;
     descr->pg_cache_descr_state = 0;
     descr->pg_cache_descr = NULL;
+    descr->summary.flags = 0;
 
     return descr;
 }
@@ -109,10 +157,13 @@ void pg_cache_wake_up_waiters_unsafe(struct rrdeng_page_descr *descr)
 void pg_cache_wait_event_unsafe(struct rrdeng_page_descr *descr)
 {
     struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
+    usec_t started_ut = now_monotonic_usec();
 
     ++pg_cache_descr->waiters;
     uv_cond_wait(&pg_cache_descr->cond, &pg_cache_descr->mutex);
     --pg_cache_descr->waiters;
+
+    rrdeng_latency_record(RRDENG_LATENCY_PAGE_WAIT, now_monotonic_usec() - started_ut);
 }
 
 /*
@@ -231,6 +282,8 @@ static void pg_cache_reserve_pages(struct rrdengine_instance *ctx, unsigned numb
 
             uv_rwlock_wrunlock(&pg_cache->pg_cache_rwlock);
 
+            /* the write-back did not keep up with the collected pages */
+            rrd_stat_atomic_add(&ctx->stats.writeback_forced_flushes, 1);
             init_completion(&compl);
             cmd.opcode = RRDENG_FLUSH_PAGES;
             cmd.completion = &compl;
@@ -252,7 +305,7 @@ static void pg_cache_reserve_pages(struct rrdengine_instance *ctx, unsigned numb
  * It may trigger evictions if the ctx->cache_pages_low_watermark limit is hit.
  * Returns 0 on failure and 1 on success.
  */
-static int pg_cache_try_reserve_pages(struct rrdengine_instance *ctx, unsigned number)
+int pg_cache_try_reserve_pages(struct rrdengine_instance *ctx, unsigned number)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
     unsigned count = 0;
@@ -287,32 +340,44 @@ static void pg_cache_evict_unsafe(struct rrdengine_instance *ctx, struct rrdeng_
 {
     struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
 
-    freez(pg_cache_descr->page);
+    page_arena_free(ctx, pg_cache_descr->page, pg_cache_descr->node);
     pg_cache_descr->page = NULL;
-    pg_cache_descr->flags &= ~RRD_PAGE_POPULATED;
+    pg_cache_descr->flags &= ~(RRD_PAGE_POPULATED | RRD_PAGE_SCAN);
     pg_cache_release_pages_unsafe(ctx, 1);
     ++ctx->stats.pg_cache_evictions;
 }
 
 /*
- * The caller must hold the page cache lock.
- * Lock order: page cache -> replaceQ -> page descriptor
- * This function iterates all pages and tries to evict one.
- * If it fails it sets in_flight_descr to the oldest descriptor that has write-back in progress,
- * or it sets it to NULL if no write-back is in progress.
+ * The caller must hold the shard lock.
+ * Runs one CLOCK sweep over the shard: referenced pages get a second chance by having their reference bit cleared
+ * and moving to the tail, the first unreferenced page that can be evicted is evicted.
+ * Pages that were not allocated from the arena of node are skipped, unless node is RRDENG_NUMA_NODE_NONE.
  *
- * Returns 1 on success and 0 on failure.
+ * Returns the evicted page descriptor or NULL on failure.
  */
-static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx)
+static struct rrdeng_page_descr *pg_cache_replaceQ_shard_evict_unsafe(struct rrdengine_instance *ctx,
+                                                                      struct pg_cache_replaceQ_shard *shard,
+                                                                      uint8_t node)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
     unsigned long old_flags;
     struct rrdeng_page_descr *descr;
-    struct page_cache_descr *pg_cache_descr = NULL;
+    struct page_cache_descr *pg_cache_descr, *next, *last;
 
-    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    for (pg_cache_descr = pg_cache->replaceQ.head ; NULL != pg_cache_descr ; pg_cache_descr = pg_cache_descr->next) {
+    last = shard->tail;
+    for (pg_cache_descr = shard->head ; NULL != pg_cache_descr ; pg_cache_descr = next) {
+        next = (pg_cache_descr == last) ? NULL : pg_cache_descr->next;
         descr = pg_cache_descr->descr;
+        if (RRDENG_NUMA_NODE_NONE != node && pg_cache_descr->node != node)
+            continue;
+
+        if (pg_cache_descr->referenced) {
+            __atomic_store_n(&pg_cache_descr->referenced, 0, __ATOMIC_RELAXED);
+            if (pg_cache_descr != shard->tail) {
+                pg_cache_replaceQ_delete_unsafe(shard, descr);
+                pg_cache_replaceQ_insert_unsafe(shard, descr);
+            }
+            continue;
+        }
 
         rrdeng_page_descr_mutex_lock(ctx, descr);
         old_flags = pg_cache_descr->flags;
@@ -320,23 +385,65 @@ static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx)
             /* must evict */
             pg_cache_evict_unsafe(ctx, descr);
             pg_cache_put_unsafe(descr);
-            pg_cache_replaceQ_delete_unsafe(ctx, descr);
+            pg_cache_replaceQ_delete_unsafe(shard, descr);
 
             rrdeng_page_descr_mutex_unlock(ctx, descr);
-            uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
+            return descr;
+        }
+        rrdeng_page_descr_mutex_unlock(ctx, descr);
+    }
+    return NULL;
+}
 
-            rrdeng_try_deallocate_pg_cache_descr(ctx, descr);
+/*
+ * The caller must hold the page cache lock.
+ * Lock order: page cache -> replaceQ shard -> page descriptor
+ * This function sweeps the replaceQ shards starting from the clock hand and tries to evict one page.
+ * Since the first sweep may only clear reference bits, the shards are swept at most twice.
+ *
+ * Returns 1 on success and 0 on failure.
+ */
+static int pg_cache_try_evict_one_page_of_node_unsafe(struct rrdengine_instance *ctx, uint8_t node)
+{
+    struct pg_cache_replaceQ *replaceQ = &ctx->pg_cache.replaceQ;
+    struct pg_cache_replaceQ_shard *shard;
+    struct rrdeng_page_descr *descr;
+    unsigned i;
+
+    for (i = 0 ; i < 2 * PG_CACHE_REPLACEQ_SHARDS ; ++i) {
+        shard = &replaceQ->shards[replaceQ->clock_hand];
+
+        uv_rwlock_wrlock(&shard->lock);
+        descr = pg_cache_replaceQ_shard_evict_unsafe(ctx, shard, node);
+        uv_rwlock_wrunlock(&shard->lock);
 
+        replaceQ->clock_hand = (replaceQ->clock_hand + 1) % PG_CACHE_REPLACEQ_SHARDS;
+        if (descr) {
+            rrdeng_try_deallocate_pg_cache_descr(ctx, descr);
             return 1;
         }
-        rrdeng_page_descr_mutex_unlock(ctx, descr);
     }
-    uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
 
     /* failed to evict */
     return 0;
 }
 
+/*
+ * The caller must hold the page cache lock.
+ * Under NUMA arenas the pages of the node the calling thread allocates from are evicted first, so that the page
+ * that is made room for is allocated locally.
+ *
+ * Returns 1 on success and 0 on failure.
+ */
+static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx)
+{
+    uint8_t node = page_arena_pick_node(ctx);
+
+    if (node < page_arena_nodes && pg_cache_try_evict_one_page_of_node_unsafe(ctx, node))
+        return 1;
+    return pg_cache_try_evict_one_page_of_node_unsafe(ctx, RRDENG_NUMA_NODE_NONE);
+}
+
 void pg_cache_punch_hole(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr, uint8_t remove_dirty)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
@@ -352,7 +459,7 @@ void pg_cache_punch_hole(struct rrdengine_instance *ctx, struct rrdeng_page_desc
     uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
 
     uv_rwlock_wrlock(&page_index->lock);
-    ret = JudyLDel(&page_index->JudyL_array, (Word_t)(descr->start_time / USEC_PER_SEC), PJE0);
+    ret = JudyLDel(&page_index->JudyL_array, (Word_t)(pg_descr_start_time(descr) / USEC_PER_SEC), PJE0);
     uv_rwlock_wrunlock(&page_index->lock);
     if (unlikely(0 == ret)) {
         error("Page under deletion was not in index.");
@@ -399,16 +506,78 @@ void pg_cache_punch_hole(struct rrdengine_instance *ctx, struct rrdeng_page_desc
 
     rrdeng_destroy_pg_cache_descr(ctx, pg_cache_descr);
 destroy:
-    freez(descr);
+    if (descr->extent)
+        df_extent_drop_page(descr->extent, descr);
+    pg_cache_free_descr(descr);
     pg_cache_update_metric_times(page_index);
 }
 
+/*
+ * Same as pg_cache_punch_hole() without removing dirty pages, but it never waits.
+ * Returns 1 if the page was removed and 0 if it is in use and has been left intact.
+ */
+int pg_cache_try_punch_hole(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct page_cache_descr *pg_cache_descr = NULL;
+    Pvoid_t *PValue;
+    struct pg_cache_page_index *page_index;
+    int ret;
+
+    rrdeng_page_descr_mutex_lock(ctx, descr);
+    pg_cache_descr = descr->pg_cache_descr;
+    if ((pg_cache_descr->flags & RRD_PAGE_DIRTY) || !pg_cache_try_get_unsafe(descr, 1)) {
+        rrdeng_page_descr_mutex_unlock(ctx, descr);
+        return 0;
+    }
+    rrdeng_page_descr_mutex_unlock(ctx, descr);
+
+    uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
+    PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, descr->id, sizeof(uuid_t));
+    assert(NULL != PValue);
+    page_index = *PValue;
+    uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
+
+    uv_rwlock_wrlock(&page_index->lock);
+    ret = JudyLDel(&page_index->JudyL_array, (Word_t)(pg_descr_start_time(descr) / USEC_PER_SEC), PJE0);
+    uv_rwlock_wrunlock(&page_index->lock);
+    if (unlikely(0 == ret)) {
+        error("Page under deletion was not in index.");
+        if (unlikely(debug_flags & D_RRDENGINE)) {
+            print_page_descr(descr);
+        }
+    } else {
+        uv_rwlock_wrlock(&pg_cache->pg_cache_rwlock);
+        ++ctx->stats.pg_cache_deletions;
+        --pg_cache->page_descriptors;
+        uv_rwlock_wrunlock(&pg_cache->pg_cache_rwlock);
+    }
+
+    if (pg_cache_descr->flags & RRD_PAGE_POPULATED) {
+        /* only after locking can it be safely deleted from LRU */
+        pg_cache_replaceQ_delete(ctx, descr);
+
+        uv_rwlock_wrlock(&pg_cache->pg_cache_rwlock);
+        pg_cache_evict_unsafe(ctx, descr);
+        uv_rwlock_wrunlock(&pg_cache->pg_cache_rwlock);
+    }
+    pg_cache_put(ctx, descr);
+
+    rrdeng_destroy_pg_cache_descr(ctx, pg_cache_descr);
+    if (descr->extent)
+        df_extent_drop_page(descr->extent, descr);
+    pg_cache_free_descr(descr);
+    pg_cache_update_metric_times(page_index);
+
+    return 1;
+}
+
 static inline int is_page_in_time_range(struct rrdeng_page_descr *descr, usec_t start_time, usec_t end_time)
 {
     usec_t pg_start, pg_end;
 
-    pg_start = descr->start_time;
-    pg_end = descr->end_time;
+    pg_start = pg_descr_start_time(descr);
+    pg_end = pg_descr_end_time(descr);
 
     return (pg_start < start_time && pg_end >= start_time) ||
            (pg_start >= start_time && pg_start <= end_time);
@@ -416,7 +585,7 @@ static inline int is_page_in_time_range(struct rrdeng_page_descr *descr, usec_t
 
 static inline int is_point_in_time_in_page(struct rrdeng_page_descr *descr, usec_t point_in_time)
 {
-    return (point_in_time >= descr->start_time && point_in_time <= descr->end_time);
+    return (point_in_time >= pg_descr_start_time(descr) && point_in_time <= pg_descr_end_time(descr));
 }
 
 /* Update metric oldest and latest timestamps efficiently when adding new values */
@@ -425,11 +594,11 @@ void pg_cache_add_new_metric_time(struct pg_cache_page_index *page_index, struct
     usec_t oldest_time = page_index->oldest_time;
     usec_t latest_time = page_index->latest_time;
 
-    if (unlikely(oldest_time == INVALID_TIME || descr->start_time < oldest_time)) {
-        page_index->oldest_time = descr->start_time;
+    if (unlikely(oldest_time == INVALID_TIME || pg_descr_start_time(descr) < oldest_time)) {
+        page_index->oldest_time = pg_descr_start_time(descr);
     }
-    if (likely(descr->end_time > latest_time || latest_time == INVALID_TIME)) {
-        page_index->latest_time = descr->end_time;
+    if (likely(pg_descr_end_time(descr) > latest_time || latest_time == INVALID_TIME)) {
+        page_index->latest_time = pg_descr_end_time(descr);
     }
 }
 
@@ -448,13 +617,13 @@ void pg_cache_update_metric_times(struct pg_cache_page_index *page_index)
     firstPValue = JudyLFirst(page_index->JudyL_array, &firstIndex, PJE0);
     if (likely(NULL != firstPValue)) {
         descr = *firstPValue;
-        oldest_time = descr->start_time;
+        oldest_time = pg_descr_start_time(descr);
     }
     lastIndex = (Word_t)-1;
     lastPValue = JudyLLast(page_index->JudyL_array, &lastIndex, PJE0);
     if (likely(NULL != lastPValue)) {
         descr = *lastPValue;
-        latest_time = descr->end_time;
+        latest_time = pg_descr_end_time(descr);
     }
     uv_rwlock_rdunlock(&page_index->lock);
 
@@ -499,7 +668,7 @@ void pg_cache_insert(struct rrdengine_instance *ctx, struct pg_cache_page_index
     }
 
     uv_rwlock_wrlock(&page_index->lock);
-    PValue = JudyLIns(&page_index->JudyL_array, (Word_t)(descr->start_time / USEC_PER_SEC), PJE0);
+    PValue = JudyLIns(&page_index->JudyL_array, (Word_t)(pg_descr_start_time(descr) / USEC_PER_SEC), PJE0);
     *PValue = descr;
     pg_cache_add_new_metric_time(page_index, descr);
     uv_rwlock_wrunlock(&page_index->lock);
@@ -511,33 +680,25 @@ void pg_cache_insert(struct rrdengine_instance *ctx, struct pg_cache_page_index
 }
 
 /*
- * Searches for a page and triggers disk I/O if necessary and possible.
- * Does not get a reference.
- * Returns page index pointer for given metric UUID.
+ * Gets exclusive access to up to max_pages pages of the metric that are in the given time range and not in memory,
+ * so that they can be read from disk. Returns the number of pages stored in preload_array.
+ * Sets preloaded_until to the time up to which pages have been considered, which is end_time unless the page
+ * limit was reached. The pages are marked with RRD_PAGE_SCAN when scan is set.
  */
-struct pg_cache_page_index *
-        pg_cache_preload(struct rrdengine_instance *ctx, uuid_t *id, usec_t start_time, usec_t end_time)
+static unsigned pg_cache_get_preload_pages(struct rrdengine_instance *ctx, struct pg_cache_page_index *page_index,
+                                           usec_t start_time, usec_t end_time, unsigned max_pages,
+                                           struct rrdeng_page_descr **preload_array, usec_t *preloaded_until,
+                                           uint8_t scan)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
-    struct rrdeng_page_descr *descr = NULL, *preload_array[PAGE_CACHE_MAX_PRELOAD_PAGES];
+    struct rrdeng_page_descr *descr = NULL;
     struct page_cache_descr *pg_cache_descr = NULL;
-    int i, j, k, count, found;
+    unsigned count;
+    int found;
     unsigned long flags;
     Pvoid_t *PValue;
-    struct pg_cache_page_index *page_index;
     Word_t Index;
-    uint8_t failed_to_reserve;
 
-    uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
-    PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, id, sizeof(uuid_t));
-    if (likely(NULL != PValue)) {
-        page_index = *PValue;
-    }
-    uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
-    if (NULL == PValue) {
-        debug(D_RRDENGINE, "%s: No page was found to attempt preload.", __func__);
-        return NULL;
-    }
+    *preloaded_until = end_time;
 
     uv_rwlock_rdlock(&page_index->lock);
     /* Find first page in range */
@@ -563,7 +724,7 @@ struct pg_cache_page_index *
     if (!found) {
         uv_rwlock_rdunlock(&page_index->lock);
         debug(D_RRDENGINE, "%s: No page was found to attempt preload.", __func__);
-        return page_index;
+        return 0;
     }
 
     for (count = 0 ;
@@ -586,8 +747,11 @@ struct pg_cache_page_index *
             }
         }
         if (!(flags & RRD_PAGE_POPULATED) && pg_cache_try_get_unsafe(descr, 1)) {
+            if (scan)
+                pg_cache_descr->flags |= RRD_PAGE_SCAN;
             preload_array[count++] = descr;
-            if (PAGE_CACHE_MAX_PRELOAD_PAGES == count) {
+            if (max_pages == count) {
+                *preloaded_until = pg_descr_end_time(descr);
                 rrdeng_page_descr_mutex_unlock(ctx, descr);
                 break;
             }
@@ -597,67 +761,177 @@ struct pg_cache_page_index *
     }
     uv_rwlock_rdunlock(&page_index->lock);
 
-    failed_to_reserve = 0;
-    for (i = 0 ; i < count && !failed_to_reserve ; ++i) {
-        struct rrdeng_cmd cmd;
-        struct rrdeng_page_descr *next;
+    return count;
+}
 
-        descr = preload_array[i];
-        if (NULL == descr) {
-            continue;
-        }
-        if (!pg_cache_try_reserve_pages(ctx, 1)) {
-            failed_to_reserve = 1;
-            break;
-        }
+static int preload_page_cmp(const void *a, const void *b)
+{
+    uintptr_t extent1 = (uintptr_t)(*(struct rrdeng_page_descr **)a)->extent;
+    uintptr_t extent2 = (uintptr_t)(*(struct rrdeng_page_descr **)b)->extent;
+
+    if (extent1 < extent2)
+        return -1;
+    return (extent1 > extent2) ? 1 : 0;
+}
+
+/*
+ * Issues one read command per extent for the pages of preload_array, whose exclusive access has been acquired with
+ * pg_cache_get_preload_pages(). The pages that do not fit in the page cache are released without being read.
+ */
+static void pg_cache_read_preload_pages(struct rrdengine_instance *ctx, struct rrdeng_page_descr **preload_array,
+                                        unsigned count)
+{
+    struct rrdeng_cmd cmd;
+    unsigned i, j, k;
+    uint8_t failed_to_reserve;
+
+    if (!count) {
+        /* no such page */
+        debug(D_RRDENGINE, "%s: No page was eligible to attempt preload.", __func__);
+        return;
+    }
+    /* consolidate the pages of every extent */
+    qsort(preload_array, count, sizeof(*preload_array), preload_page_cmp);
+
+    failed_to_reserve = 0;
+    for (i = 0, j = 0 ; i < count && !failed_to_reserve ; i = j) {
         cmd.opcode = RRDENG_READ_EXTENT;
-        cmd.read_extent.page_cache_descr[0] = descr;
-        /* don't use this page again */
-        preload_array[i] = NULL;
-        for (j = 0, k = 1 ; j < count ; ++j) {
-            next = preload_array[j];
-            if (NULL == next) {
-                continue;
-            }
-            if (descr->extent == next->extent) {
-                /* same extent, consolidate */
-                if (!pg_cache_try_reserve_pages(ctx, 1)) {
-                    failed_to_reserve = 1;
-                    break;
-                }
-                cmd.read_extent.page_cache_descr[k++] = next;
-                /* don't use this page again */
-                preload_array[j] = NULL;
+        for (k = 0 ; j < count && preload_array[j]->extent == preload_array[i]->extent &&
+                    k < RRDENG_READ_EXTENT_MAX_PAGES ; ++j) {
+            if (!pg_cache_try_reserve_pages(ctx, 1)) {
+                failed_to_reserve = 1;
+                break;
             }
+            cmd.read_extent.page_cache_descr[k++] = preload_array[j];
+        }
+        if (k) {
+            cmd.read_extent.page_count = k;
+            cmd.read_extent.node = page_arena_pick_node(ctx);
+            rrdeng_enq_cmd(&ctx->worker_config, &cmd);
         }
-        cmd.read_extent.page_count = k;
-        rrdeng_enq_cmd(&ctx->worker_config, &cmd);
     }
     if (failed_to_reserve) {
         debug(D_RRDENGINE, "%s: Failed to reserve enough memory, canceling I/O.", __func__);
-        for (i = 0 ; i < count ; ++i) {
-            descr = preload_array[i];
-            if (NULL == descr) {
-                continue;
-            }
-            pg_cache_put(ctx, descr);
-        }
+        for ( ; j < count ; ++j)
+            pg_cache_put(ctx, preload_array[j]);
     }
-    if (!count) {
-        /* no such page */
-        debug(D_RRDENGINE, "%s: No page was eligible to attempt preload.", __func__);
+}
+
+/*
+ * Triggers disk I/O for up to max_pages pages of the metric that are in the given time range and not in memory.
+ * Does not get a reference and never waits for I/O.
+ * Sets preloaded_until to the time up to which pages have been considered, which is end_time unless the page
+ * limit was reached.
+ * When scan is set the pages are read for a scan query and are evicted first, see struct pg_cache_replaceQ.
+ */
+void pg_cache_preload_range(struct rrdengine_instance *ctx, struct pg_cache_page_index *page_index,
+                            usec_t start_time, usec_t end_time, unsigned max_pages, usec_t *preloaded_until,
+                            uint8_t scan)
+{
+    struct rrdeng_page_descr *preload_array[PAGE_CACHE_MAX_PRELOAD_PAGES];
+    unsigned count;
+
+    max_pages = MIN(max_pages, PAGE_CACHE_MAX_PRELOAD_PAGES);
+    count = pg_cache_get_preload_pages(ctx, page_index, start_time, end_time, max_pages, preload_array,
+                                       preloaded_until, scan);
+    pg_cache_read_preload_pages(ctx, preload_array, count);
+}
+
+/*
+ * Triggers disk I/O for the pages of many metrics at once, e.g. the dimensions of a chart, so that every extent is
+ * read once for all the metrics whose pages it holds. Up to max_pages pages of every metric are considered and
+ * preloaded_until[] is set for every metric like pg_cache_preload_range() does. NULL page indices are skipped.
+ */
+void pg_cache_preload_metrics(struct rrdengine_instance *ctx, struct pg_cache_page_index **page_indices,
+                              unsigned nr_metrics, usec_t start_time, usec_t end_time, unsigned max_pages,
+                              usec_t *preloaded_until, uint8_t scan)
+{
+    struct rrdeng_page_descr **preload_array;
+    unsigned i, count;
+
+    max_pages = MIN(max_pages, PAGE_CACHE_MAX_PRELOAD_PAGES);
+    preload_array = mallocz(sizeof(*preload_array) * MAX(nr_metrics * max_pages, 1));
+    for (i = 0, count = 0 ; i < nr_metrics ; ++i) {
+        preloaded_until[i] = end_time;
+        if (page_indices[i])
+            count += pg_cache_get_preload_pages(ctx, page_indices[i], start_time, end_time, max_pages,
+                                                preload_array + count, &preloaded_until[i], scan);
+    }
+    pg_cache_read_preload_pages(ctx, preload_array, count);
+    freez(preload_array);
+}
+
+/*
+ * Searches for a page and triggers disk I/O if necessary and possible.
+ * Does not get a reference.
+ * Sets preloaded_until and handles scan like pg_cache_preload_range() does.
+ * Returns page index pointer for given metric UUID.
+ */
+struct pg_cache_page_index *
+        pg_cache_preload(struct rrdengine_instance *ctx, uuid_t *id, usec_t start_time, usec_t end_time,
+                         usec_t *preloaded_until, uint8_t scan)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    Pvoid_t *PValue;
+    struct pg_cache_page_index *page_index;
+
+    *preloaded_until = end_time;
+    uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
+    PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, id, sizeof(uuid_t));
+    if (likely(NULL != PValue)) {
+        page_index = *PValue;
     }
+    uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
+    if (NULL == PValue) {
+        debug(D_RRDENGINE, "%s: No page was found to attempt preload.", __func__);
+        return NULL;
+    }
+
+    pg_cache_preload_range(ctx, page_index, start_time, end_time, PAGE_CACHE_MAX_PRELOAD_PAGES, preloaded_until,
+                           scan);
     return page_index;
 }
 
+/*
+ * Copies the summary of the page of the metric that starts at start_time, when the summary is valid and the page ends
+ * at or before end_time. The page is neither referenced nor read from disk.
+ * Returns 1 and sets the end time and the length of the page on success, 0 otherwise.
+ */
+int pg_cache_lookup_summary(struct pg_cache_page_index *page_index, usec_t start_time, usec_t end_time,
+                            struct rrdeng_page_summary *summary, usec_t *page_end_time, uint32_t *page_length)
+{
+    struct rrdeng_page_descr *descr;
+    Pvoid_t *PValue;
+    int ret = 0;
+
+    uv_rwlock_rdlock(&page_index->lock);
+    PValue = JudyLGet(page_index->JudyL_array, (Word_t)(start_time / USEC_PER_SEC), PJE0);
+    if (likely(NULL != PValue)) {
+        descr = *PValue;
+        /* pairs with the release store of the collector that committed the page */
+        if ((__atomic_load_n(&descr->summary.flags, __ATOMIC_ACQUIRE) & PAGE_SUMMARY_VALID) &&
+            pg_descr_start_time(descr) == start_time && pg_descr_end_time(descr) <= end_time) {
+            *summary = descr->summary;
+            *page_end_time = pg_descr_end_time(descr);
+            *page_length = descr->page_length;
+            ret = 1;
+        }
+    }
+    uv_rwlock_rdunlock(&page_index->lock);
+
+    return ret;
+}
+
 /*
  * Searches for a page and gets a reference.
  * When point_in_time is INVALID_TIME get any page.
  * If index is NULL lookup by UUID (id).
+ * Scan queries neither set the reference bit of the pages they hit nor promote the pages of other scan queries,
+ * and the pages they read from disk are evicted first.
  */
 struct rrdeng_page_descr *
         pg_cache_lookup(struct rrdengine_instance *ctx, struct pg_cache_page_index *index, uuid_t *id,
-                        usec_t point_in_time)
+                        usec_t point_in_time, uint8_t scan)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
     struct rrdeng_page_descr *descr = NULL;
@@ -706,6 +980,8 @@ struct rrdeng_page_descr *
         flags = pg_cache_descr->flags;
         if ((flags & RRD_PAGE_POPULATED) && pg_cache_try_get_unsafe(descr, 0)) {
             /* success */
+            if (!scan)
+                pg_cache_descr->flags &= ~RRD_PAGE_SCAN;
             rrdeng_page_descr_mutex_unlock(ctx, descr);
             debug(D_RRDENGINE, "%s: Page was found in memory.", __func__);
             break;
@@ -715,8 +991,14 @@ struct rrdeng_page_descr *
 
             uv_rwlock_rdunlock(&page_index->lock);
 
+            if (scan)
+                pg_cache_descr->flags |= RRD_PAGE_SCAN;
+
+            usec_t miss_started_ut = now_monotonic_usec();
+
             cmd.opcode = RRDENG_READ_PAGE;
             cmd.read_page.page_cache_descr = descr;
+            cmd.read_page.node = page_arena_pick_node(ctx);
             rrdeng_enq_cmd(&ctx->worker_config, &cmd);
 
             debug(D_RRDENGINE, "%s: Waiting for page to be asynchronously read from disk:", __func__);
@@ -725,6 +1007,7 @@ struct rrdeng_page_descr *
             while (!(pg_cache_descr->flags & RRD_PAGE_POPULATED)) {
                 pg_cache_wait_event_unsafe(descr);
             }
+            rrdeng_latency_record(RRDENG_LATENCY_PAGE_MISS, now_monotonic_usec() - miss_started_ut);
             /* success */
             /* Downgrade exclusive reference to allow other readers */
             pg_cache_descr->flags &= ~RRD_PAGE_LOCKED;
@@ -747,7 +1030,7 @@ struct rrdeng_page_descr *
     }
     uv_rwlock_rdunlock(&page_index->lock);
 
-    if (!(flags & RRD_PAGE_DIRTY))
+    if (!(flags & RRD_PAGE_DIRTY) && !scan)
         pg_cache_replaceQ_set_hot(ctx, descr);
     pg_cache_release_pages(ctx, 1);
     if (page_not_in_cache)
@@ -777,6 +1060,7 @@ static void init_metrics_index(struct rrdengine_instance *ctx)
     struct page_cache *pg_cache = &ctx->pg_cache;
 
     pg_cache->metrics_index.JudyHS_array = (Pvoid_t) NULL;
+    pg_cache->metrics_index.JudyL_array = (Pvoid_t) NULL;
     pg_cache->metrics_index.last_page_index = NULL;
     assert(0 == uv_rwlock_init(&pg_cache->metrics_index.lock));
 }
@@ -784,10 +1068,14 @@ static void init_metrics_index(struct rrdengine_instance *ctx)
 static void init_replaceQ(struct rrdengine_instance *ctx)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
+    unsigned i;
 
-    pg_cache->replaceQ.head = NULL;
-    pg_cache->replaceQ.tail = NULL;
-    assert(0 == uv_rwlock_init(&pg_cache->replaceQ.lock));
+    for (i = 0 ; i < PG_CACHE_REPLACEQ_SHARDS ; ++i) {
+        pg_cache->replaceQ.shards[i].head = NULL;
+        pg_cache->replaceQ.shards[i].tail = NULL;
+        assert(0 == uv_rwlock_init(&pg_cache->replaceQ.shards[i].lock));
+    }
+    pg_cache->replaceQ.clock_hand = 0;
 }
 
 static void init_commited_page_index(struct rrdengine_instance *ctx)
@@ -846,13 +1134,13 @@ void free_page_cache(struct rrdengine_instance *ctx)
                 /* Check rrdenglocking.c */
                 pg_cache_descr = descr->pg_cache_descr;
                 if (pg_cache_descr->flags & RRD_PAGE_POPULATED) {
-                    freez(pg_cache_descr->page);
+                    page_arena_free(ctx, pg_cache_descr->page, pg_cache_descr->node);
                     bytes_freed += RRDENG_BLOCK_SIZE;
                 }
                 rrdeng_destroy_pg_cache_descr(ctx, pg_cache_descr);
                 bytes_freed += sizeof(*pg_cache_descr);
             }
-            freez(descr);
+            pg_cache_free_descr(descr);
             bytes_freed += sizeof(*descr);
 
             PValue = JudyLNext(page_index->JudyL_array, &Index, PJE0);
@@ -870,6 +1158,9 @@ void free_page_cache(struct rrdengine_instance *ctx)
     ret_Judy = JudyHSFreeArray(&pg_cache->metrics_index.JudyHS_array, PJE0);
     assert(NULL == pg_cache->metrics_index.JudyHS_array);
     bytes_freed += ret_Judy;
+    ret_Judy = JudyLFreeArray(&pg_cache->metrics_index.JudyL_array, PJE0);
+    assert(NULL == pg_cache->metrics_index.JudyL_array);
+    bytes_freed += ret_Judy;
 
     info("Freed %lu bytes of memory from page cache.", bytes_freed);
 }
\ No newline at end of file
@@ -18,13 +18,16 @@ struct rrdeng_page_descr;
 #define RRD_PAGE_READ_PENDING   (1LU << 2)
 #define RRD_PAGE_WRITE_PENDING  (1LU << 3)
 #define RRD_PAGE_POPULATED      (1LU << 4)
+#define RRD_PAGE_SCAN           (1LU << 5) /* read for a scan query and not hit by another query since */
 
 struct page_cache_descr {
     struct rrdeng_page_descr *descr; /* parent descriptor */
     void *page;
+    uint8_t node; /* NUMA node arena of the page, RRDENG_NUMA_NODE_NONE when it was allocated from the heap */
     unsigned long flags;
-    struct page_cache_descr *prev; /* LRU */
-    struct page_cache_descr *next; /* LRU */
+    struct page_cache_descr *prev; /* replaceQ shard */
+    struct page_cache_descr *next; /* replaceQ shard */
+    volatile unsigned referenced; /* CLOCK reference bit, set without locks on page cache hits */
 
     unsigned refcnt;
     uv_mutex_t mutex; /* always take it after the page cache lock or after the commit lock */
@@ -47,10 +50,20 @@ struct page_cache_descr {
  * -----------------------------+------------+------------+-----------|
  * number of descriptor users   |    DESTROY |     LOCKED | ALLOCATED |
  */
+/* summary of the points of a page that exist, it does not change after PAGE_SUMMARY_VALID is set */
+struct rrdeng_page_summary {
+    double sum;
+    storage_number min;
+    storage_number max;
+    uint32_t count;
+    uint8_t flags; /* PAGE_SUMMARY_* */
+};
+
 struct rrdeng_page_descr {
     uint32_t page_length;
-    usec_t start_time;
-    usec_t end_time;
+    /* page boundaries are always aligned to seconds, use the pg_descr_*_time() accessors */
+    uint32_t start_time_s;
+    uint32_t end_time_s;
     uuid_t *id; /* never changes */
     struct extent_info *extent;
 
@@ -59,9 +72,34 @@ struct rrdeng_page_descr {
 
     /* Compare-And-Swap target for page cache descriptor allocation algorithm */
     volatile unsigned long pg_cache_descr_state;
+
+    struct rrdeng_page_summary summary;
 };
 
+static inline usec_t pg_descr_start_time(struct rrdeng_page_descr *descr)
+{
+    return (usec_t)descr->start_time_s * USEC_PER_SEC;
+}
+
+static inline usec_t pg_descr_end_time(struct rrdeng_page_descr *descr)
+{
+    return (usec_t)descr->end_time_s * USEC_PER_SEC;
+}
+
+static inline void pg_descr_set_start_time(struct rrdeng_page_descr *descr, usec_t start_time)
+{
+    descr->start_time_s = (uint32_t)(start_time / USEC_PER_SEC);
+}
+
+static inline void pg_descr_set_end_time(struct rrdeng_page_descr *descr, usec_t end_time)
+{
+    descr->end_time_s = (uint32_t)(end_time / USEC_PER_SEC);
+}
+
 #define PAGE_CACHE_MAX_PRELOAD_PAGES    (256)
+#define PAGE_CACHE_READAHEAD_PAGES      (64) /* pages queried ahead of sequential range queries */
+#define PAGE_CACHE_MAX_CHART_PRELOAD_PAGES (4096) /* pages preloaded for all the dimensions of a chart query */
+#define PAGE_CACHE_SCAN_QUERY_SHARE     (8) /* queries of more than 1/8th of the page cache are scan queries */
 
 /* maps time ranges to pages */
 struct pg_cache_page_index {
@@ -88,10 +126,11 @@ struct pg_cache_page_index {
     struct pg_cache_page_index *prev;
 };
 
-/* maps UUIDs to page indices */
+/* maps UUIDs, and the metric ids of the metric directory, to page indices */
 struct pg_cache_metrics_index {
     uv_rwlock_t lock;
     Pvoid_t JudyHS_array;
+    Pvoid_t JudyL_array; /* the page indices of the metrics initialized by their metric id */
     struct pg_cache_page_index *last_page_index;
 };
 
@@ -111,15 +150,28 @@ struct pg_cache_commited_page_index {
     unsigned nr_commited_pages;
 };
 
+#define PG_CACHE_REPLACEQ_SHARDS (16)
+
+struct pg_cache_replaceQ_shard {
+    uv_rwlock_t lock; /* shard lock */
+
+    struct page_cache_descr *head; /* next CLOCK victim candidate, where the pages of scan queries are inserted */
+    struct page_cache_descr *tail; /* most recently inserted or given a second chance */
+};
+
 /*
  * Gathers populated pages to be evicted.
  * Relies on page cache descriptors being there as it uses their memory.
+ * Pages are spread across shards by descriptor address and evicted with the CLOCK algorithm, so that page cache
+ * hits only need to set the reference bit of the page instead of relinking a global LRU list.
+ * The pages read for scan queries, e.g. a month of a big chart, are admitted at the head of their shard without the
+ * reference bit, so that they are evicted before the pages that were already cached and the scan recycles its own
+ * window of pages. They are promoted by the reference bit once another query hits them.
  */
 struct pg_cache_replaceQ {
-    uv_rwlock_t lock; /* LRU lock */
+    struct pg_cache_replaceQ_shard shards[PG_CACHE_REPLACEQ_SHARDS];
 
-    struct page_cache_descr *head; /* LRU */
-    struct page_cache_descr *tail; /* MRU */
+    unsigned clock_hand; /* next shard to scan for eviction, protected by the page cache lock */
 };
 
 struct page_cache { /* TODO: add statistics */
@@ -143,17 +195,29 @@ extern void pg_cache_replaceQ_delete(struct rrdengine_instance *ctx,
 extern void pg_cache_replaceQ_set_hot(struct rrdengine_instance *ctx,
                                       struct rrdeng_page_descr *descr);
 extern struct rrdeng_page_descr *pg_cache_create_descr(void);
+extern void pg_cache_free_descr(struct rrdeng_page_descr *descr);
 extern int pg_cache_try_get_unsafe(struct rrdeng_page_descr *descr, int exclusive_access);
 extern void pg_cache_put_unsafe(struct rrdeng_page_descr *descr);
 extern void pg_cache_put(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr);
 extern void pg_cache_insert(struct rrdengine_instance *ctx, struct pg_cache_page_index *index,
                             struct rrdeng_page_descr *descr);
 extern void pg_cache_punch_hole(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr, uint8_t remove_dirty);
+extern int pg_cache_try_reserve_pages(struct rrdengine_instance *ctx, unsigned number);
+extern int pg_cache_try_punch_hole(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr);
+extern int pg_cache_lookup_summary(struct pg_cache_page_index *page_index, usec_t start_time, usec_t end_time,
+                                   struct rrdeng_page_summary *summary, usec_t *page_end_time, uint32_t *page_length);
+extern void pg_cache_preload_range(struct rrdengine_instance *ctx, struct pg_cache_page_index *page_index,
+                                   usec_t start_time, usec_t end_time, unsigned max_pages, usec_t *preloaded_until,
+                                   uint8_t scan);
+extern void pg_cache_preload_metrics(struct rrdengine_instance *ctx, struct pg_cache_page_index **page_indices,
+                                     unsigned nr_metrics, usec_t start_time, usec_t end_time, unsigned max_pages,
+                                     usec_t *preloaded_until, uint8_t scan);
 extern struct pg_cache_page_index *
-        pg_cache_preload(struct rrdengine_instance *ctx, uuid_t *id, usec_t start_time, usec_t end_time);
+        pg_cache_preload(struct rrdengine_instance *ctx, uuid_t *id, usec_t start_time, usec_t end_time,
+                         usec_t *preloaded_until, uint8_t scan);
 extern struct rrdeng_page_descr *
         pg_cache_lookup(struct rrdengine_instance *ctx, struct pg_cache_page_index *index, uuid_t *id,
-                        usec_t point_in_time);
+                        usec_t point_in_time, uint8_t scan);
 extern struct pg_cache_page_index *create_page_index(uuid_t *id);
 extern void init_page_cache(struct rrdengine_instance *ctx);
 extern void free_page_cache(struct rrdengine_instance *ctx);
@@ -11,14 +11,23 @@
 #define RRDENG_JF_MAGIC "netdata-journal-file"
 
 #define RRDENG_VER_SZ (16)
-#define RRDENG_DF_VER "1.0"
-#define RRDENG_JF_VER "1.0"
+#define RRDENG_DF_VER "4.0"
+#define RRDENG_JF_VER "4.0"
+/* version 1 to 3 files can still be loaded, but they are never appended to */
+#define RRDENG_DF_VER_1 "1.0"
+#define RRDENG_JF_VER_1 "1.0"
+#define RRDENG_DF_VER_2 "2.0"
+#define RRDENG_JF_VER_2 "2.0"
+/* version 3 files are the same as version 4 ones, but they are checksummed with CRC32 instead of CRC32C */
+#define RRDENG_DF_VER_3 "3.0"
+#define RRDENG_JF_VER_3 "3.0"
 
 #define UUID_SZ (16)
-#define CHECKSUM_SZ (4) /* CRC32 */
+#define CHECKSUM_SZ (4) /* CRC32C, CRC32 before version 4 */
 
 #define RRD_NO_COMPRESSION (0)
 #define RRD_LZ4 (1)
+#define RRD_XOR (2) /* per page XOR encoding of consecutive storage numbers, version 2 data files only */
 
 #define RRDENG_DF_SB_PADDING_SZ (RRDENG_BLOCK_SIZE - (RRDENG_MAGIC_SZ + RRDENG_VER_SZ + sizeof(uint8_t)))
 /*
@@ -37,6 +46,12 @@ struct rrdeng_df_sb {
 #define PAGE_METRICS    (0)
 #define PAGE_LOGS       (1) /* reserved */
 
+/*
+ * Page summary flags
+ */
+#define PAGE_SUMMARY_VALID  (1 << 0) /* the summary describes every point of the page */
+#define PAGE_SUMMARY_RESET  (1 << 1) /* some point of the page was flagged as reset */
+
 /*
  * Data file page descriptor
  */
@@ -47,6 +62,25 @@ struct rrdeng_extent_page_descr {
     uint32_t page_length;
     uint64_t start_time;
     uint64_t end_time;
+
+    /* summary of the points of the page that exist, so that queries can aggregate the page without reading it */
+    uint8_t summary_flags;
+    uint32_t count;
+    uint32_t min; /* storage number */
+    uint32_t max; /* storage number */
+    double sum;
+} __attribute__ ((packed));
+
+/*
+ * Data file page descriptor of version 1 and 2 files, their pages have no summary
+ */
+struct rrdeng_extent_page_descr_v2 {
+    uint8_t type;
+
+    uint8_t uuid[UUID_SZ];
+    uint32_t page_length;
+    uint64_t start_time;
+    uint64_t end_time;
 } __attribute__ ((packed));
 
 /*
@@ -55,11 +89,33 @@ struct rrdeng_extent_page_descr {
 struct rrdeng_df_extent_header {
     uint32_t payload_length;
     uint8_t compression_algorithm;
-    uint8_t number_of_pages;
+    uint16_t number_of_pages;
     /* #number_of_pages page descriptors follow */
     struct rrdeng_extent_page_descr descr[];
 } __attribute__ ((packed));
 
+/*
+ * Data file extent header of version 2 data files
+ */
+struct rrdeng_df_extent_header_v2 {
+    uint32_t payload_length;
+    uint8_t compression_algorithm;
+    uint16_t number_of_pages;
+    /* #number_of_pages page descriptors follow */
+    struct rrdeng_extent_page_descr_v2 descr[];
+} __attribute__ ((packed));
+
+/*
+ * Data file extent header of version 1 data files
+ */
+struct rrdeng_df_extent_header_v1 {
+    uint32_t payload_length;
+    uint8_t compression_algorithm;
+    uint8_t number_of_pages;
+    /* #number_of_pages page descriptors follow */
+    struct rrdeng_extent_page_descr_v2 descr[];
+} __attribute__ ((packed));
+
 /*
  * Data file extent trailer
  */
@@ -86,11 +142,25 @@ struct rrdeng_jf_sb {
 
 /*
  * Journal file transaction record header
+ * Transactions that do not fit in the remainder of a block start at the beginning of the next block and can span
+ * multiple blocks.
  */
 struct rrdeng_jf_transaction_header {
     /* when set to STORE_PADDING jump to start of next block */
     uint8_t type;
 
+    uint32_t reserved; /* reserved for future use */
+    uint64_t id;
+    uint32_t payload_length;
+} __attribute__ ((packed));
+
+/*
+ * Journal file transaction record header of version 1 journal files, transactions never span blocks
+ */
+struct rrdeng_jf_transaction_header_v1 {
+    /* when set to STORE_PADDING jump to start of next block */
+    uint8_t type;
+
     uint32_t reserved; /* reserved for future use */
     uint64_t id;
     uint16_t payload_length;
@@ -111,9 +181,113 @@ struct rrdeng_jf_store_data {
     uint64_t extent_offset;
     uint32_t extent_size;
 
-    uint8_t number_of_pages;
+    uint16_t number_of_pages;
     /* #number_of_pages page descriptors follow */
     struct rrdeng_extent_page_descr descr[];
 } __attribute__ ((packed));
 
+/*
+ * Journal file STORE_DATA action of version 2 journal files
+ */
+struct rrdeng_jf_store_data_v2 {
+    /* data file extent information */
+    uint64_t extent_offset;
+    uint32_t extent_size;
+
+    uint16_t number_of_pages;
+    /* #number_of_pages page descriptors follow */
+    struct rrdeng_extent_page_descr_v2 descr[];
+} __attribute__ ((packed));
+
+/*
+ * Journal file STORE_DATA action of version 1 journal files
+ */
+struct rrdeng_jf_store_data_v1 {
+    /* data file extent information */
+    uint64_t extent_offset;
+    uint32_t extent_size;
+
+    uint8_t number_of_pages;
+    /* #number_of_pages page descriptors follow */
+    struct rrdeng_extent_page_descr_v2 descr[];
+} __attribute__ ((packed));
+
+#define RRDENG_JI_MAGIC "netdata-journal-index"
+#define RRDENG_JI_VER "2.0"
+
+/*
+ * Journal index file header
+ * The journal index is written when a journal file is sealed and describes the same pages as the journal, grouped by
+ * metric. It is followed by #number_of_extents extents, #number_of_metrics metrics and #number_of_pages pages.
+ */
+struct rrdeng_ji_header {
+    char magic_number[RRDENG_MAGIC_SZ];
+    char version[RRDENG_VER_SZ];
+    uint64_t journal_size; /* the index is only valid for a journal file of this size */
+    uint64_t max_transaction_id;
+    uint32_t number_of_extents;
+    uint32_t number_of_metrics;
+    uint64_t number_of_pages;
+    uint8_t checksum[CHECKSUM_SZ]; /* CRC32 of everything that follows the header */
+} __attribute__ ((packed));
+
+/*
+ * Journal index extent, extents are sorted by data file offset
+ */
+struct rrdeng_ji_extent {
+    uint64_t offset;
+    uint32_t size;
+    uint16_t number_of_pages;
+} __attribute__ ((packed));
+
+/*
+ * Journal index metric, metrics are sorted by UUID and their pages are stored consecutively in the page array
+ */
+struct rrdeng_ji_metric {
+    uint8_t uuid[UUID_SZ];
+    uint32_t number_of_pages;
+} __attribute__ ((packed));
+
+/*
+ * Journal index page, pages of a metric are sorted by start time
+ */
+struct rrdeng_ji_page {
+    uint64_t start_time;
+    uint64_t end_time;
+    uint32_t page_length;
+    uint32_t extent_index;
+    uint16_t extent_page_index; /* position of the page in the extent */
+
+    /* the page summary, as in the data file page descriptor */
+    uint8_t summary_flags;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    double sum;
+} __attribute__ ((packed));
+
+#define RRDENG_MD_MAGIC "netdata-metric-directory"
+#define RRDENG_MD_VER "1.0"
+
+/*
+ * Metric directory file header
+ * It is followed by the records of the metrics, in the order they were seen for the first time.
+ */
+struct rrdeng_md_header {
+    char magic_number[RRDENG_MAGIC_SZ];
+    char version[RRDENG_VER_SZ];
+} __attribute__ ((packed));
+
+/*
+ * Metric directory record, followed by #name_length bytes of the name of the metric and the CRC32 of the record and
+ * the name. The name is the chart id and the dimension id, preceded by the machine GUID of the host in multihost
+ * instances, separated by zero bytes.
+ */
+struct rrdeng_md_record {
+    uint32_t metric_id;
+    uint8_t uuid[UUID_SZ];
+    uint16_t name_length;
+    uint8_t name[];
+} __attribute__ ((packed));
+
 #endif /* NETDATA_RRDDISKPROTOCOL_H */
\ No newline at end of file
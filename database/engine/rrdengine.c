@@ -7,6 +7,69 @@ rrdeng_stats_t global_io_errors = 0;
 rrdeng_stats_t global_fs_errors = 0;
 rrdeng_stats_t rrdeng_reserved_file_descriptors = 0;
 
+/*
+ * Latency histograms.
+ * Every thread records its latencies in its own slot, on its own cache lines, with relaxed stores and no locked
+ * instructions. The slots are never released. When all of them are taken, the threads share slot 0 and update it
+ * with atomic additions. rrdeng_get_latency_histograms() sums the slots.
+ */
+#define RRDENG_LATENCY_SLOTS (128)
+
+const char *rrdeng_latency_names[RRDENG_LATENCIES] = {
+    [RRDENG_LATENCY_PAGE_MISS] = "page_miss",
+    [RRDENG_LATENCY_PAGE_WAIT] = "page_wait",
+    [RRDENG_LATENCY_CMD_QUEUE] = "command_queue",
+    [RRDENG_LATENCY_FLUSH]     = "flush",
+};
+
+const char *rrdeng_latency_bucket_names[RRDENG_LATENCY_BUCKETS] = {
+    "10us", "100us", "1ms", "10ms", "100ms", "1s", "10s", "more"
+};
+
+static struct rrdeng_latency_slot {
+    rrdeng_stats_t counts[RRDENG_LATENCIES][RRDENG_LATENCY_BUCKETS];
+} __attribute__((aligned(64))) latency_slots[RRDENG_LATENCY_SLOTS];
+
+static unsigned long latency_slots_used = 1;
+static __thread struct rrdeng_latency_slot *latency_my_slot = NULL;
+
+void rrdeng_latency_record(enum rrdeng_latency latency, usec_t dt)
+{
+    struct rrdeng_latency_slot *slot = latency_my_slot;
+    unsigned bucket;
+    usec_t limit;
+
+    if (unlikely(NULL == slot)) {
+        unsigned long n = __atomic_fetch_add(&latency_slots_used, 1, __ATOMIC_RELAXED);
+
+        slot = latency_my_slot = &latency_slots[n < RRDENG_LATENCY_SLOTS ? n : 0];
+    }
+    for (bucket = 0, limit = 10 ; bucket < RRDENG_LATENCY_BUCKETS - 1 && dt > limit ; ++bucket, limit *= 10)
+        ;
+
+    if (likely(slot != &latency_slots[0]))
+        __atomic_store_n(&slot->counts[latency][bucket], slot->counts[latency][bucket] + 1, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_add(&slot->counts[latency][bucket], 1, __ATOMIC_RELAXED);
+}
+
+void rrdeng_get_latency_histograms(unsigned long long array[RRDENG_LATENCIES][RRDENG_LATENCY_BUCKETS])
+{
+    unsigned long i, slots;
+    unsigned l, b;
+
+    memset(array, 0, sizeof(unsigned long long) * RRDENG_LATENCIES * RRDENG_LATENCY_BUCKETS);
+
+    slots = __atomic_load_n(&latency_slots_used, __ATOMIC_RELAXED);
+    if (slots > RRDENG_LATENCY_SLOTS)
+        slots = RRDENG_LATENCY_SLOTS;
+
+    for (i = 0 ; i < slots ; ++i)
+        for (l = 0 ; l < RRDENG_LATENCIES ; ++l)
+            for (b = 0 ; b < RRDENG_LATENCY_BUCKETS ; ++b)
+                array[l][b] += (unsigned long long)__atomic_load_n(&latency_slots[i].counts[l][b], __ATOMIC_RELAXED);
+}
+
 void sanity_check(void)
 {
     /* Magic numbers must fit in the super-blocks */
@@ -22,85 +85,444 @@ void sanity_check(void)
 
     BUILD_BUG_ON(sizeof(uuid_t) != UUID_SZ); /* check UUID size */
 
-    /* page count must fit in 8 bits */
-    BUILD_BUG_ON(MAX_PAGES_PER_EXTENT > 255);
+    /* page count must fit in 16 bits */
+    BUILD_BUG_ON(MAX_PAGES_PER_EXTENT > 65535);
+
+    /* extent read commands cannot address more pages than an extent has */
+    BUILD_BUG_ON(RRDENG_READ_EXTENT_MAX_PAGES > MAX_PAGES_PER_EXTENT);
 }
 
-void read_extent_cb(uv_fs_t* req)
+/*
+ * Extent payload codecs. Every compressed extent records in its header the algorithm of the codec that encoded its
+ * payload, so codecs can be chosen per extent and new ones added without changing the data file format version.
+ */
+struct rrdeng_codec {
+    uint8_t algorithm;
+    const char *name;
+    /* returns the compressed payload size or 0 when it does not fit in dst_capacity bytes */
+    uint32_t (*compress)(void *src, uint32_t src_length, struct rrdeng_extent_page_descr *descr, unsigned count,
+                         void *dst, uint32_t dst_capacity);
+    /*
+     * Decodes at least the pages flagged in wanted[] to their offsets of the uncompressed payload in dst.
+     * Returns the number of decoded bytes or 0 on failure.
+     */
+    uint32_t (*decompress)(void *src, uint32_t src_length, struct rrdeng_extent_page_descr *descr, unsigned count,
+                           uint8_t *wanted, void *dst);
+};
+
+static uint32_t lz4_compress(void *src, uint32_t src_length, struct rrdeng_extent_page_descr *descr, unsigned count,
+                             void *dst, uint32_t dst_capacity)
 {
-    struct rrdengine_worker_config* wc = req->loop->data;
-    struct rrdengine_instance *ctx = wc->ctx;
-    struct extent_io_descriptor *xt_io_descr;
-    struct rrdeng_page_descr *descr;
-    struct page_cache_descr *pg_cache_descr;
     int ret;
-    unsigned i, j, count;
-    void *page, *uncompressed_buf = NULL;
-    uint32_t payload_length, payload_offset, page_offset, uncompressed_payload_length;
-    /* persistent structures */
-    struct rrdeng_df_extent_header *header;
-    struct rrdeng_df_extent_trailer *trailer;
-    uLong crc;
+    (void)descr;
+    (void)count;
 
-    xt_io_descr = req->data;
-    if (req->result < 0) {
-        error("%s: uv_fs_read: %s", __func__, uv_strerror((int)req->result));
-        goto cleanup;
+    assert(src_length < LZ4_MAX_INPUT_SIZE);
+    ret = LZ4_compress_default(src, dst, src_length, dst_capacity);
+    return ret > 0 ? (uint32_t)ret : 0;
+}
+
+static uint32_t lz4_decompress(void *src, uint32_t src_length, struct rrdeng_extent_page_descr *descr, unsigned count,
+                               uint8_t *wanted, void *dst)
+{
+    int ret;
+    unsigned i;
+    uint32_t page_offset, uncompressed_length, decompressed_length;
+
+    /* LZ4 blocks can only be decoded from the start, stop after the last wanted page */
+    for (i = 0, page_offset = 0, decompressed_length = 0 ; i < count ; ++i) {
+        page_offset += descr[i].page_length;
+        if (wanted[i])
+            decompressed_length = page_offset;
     }
+    uncompressed_length = page_offset;
+    ret = LZ4_decompress_safe_partial(src, dst, src_length, decompressed_length, uncompressed_length);
+    return ret > 0 ? (uint32_t)ret : 0;
+}
 
-    header = xt_io_descr->buf;
-    payload_length = header->payload_length;
-    count = header->number_of_pages;
+/*
+ * XOR codec: metrics that are flat or change slowly produce consecutive storage numbers that differ in few bits.
+ * Every page is encoded as an independent bit stream, the first value verbatim and then each value as the XOR
+ * with its predecessor (timestamps are implicit in dbengine pages):
+ *   '0'                                   same value as the previous one
+ *   '10' <bits>                           meaningful bits fit within the previous leading/trailing zeros window
+ *   '11' <5-bit leading zeros> <5-bit length - 1> <bits>   a new window
+ * The payload starts with the encoded length of every page, so that pages can be decoded individually.
+ */
+struct xor_bit_writer {
+    uint8_t *buf;
+    uint32_t capacity;
+    uint32_t pos;
+    uint64_t acc;
+    unsigned nbits;
+    int overflow;
+};
+
+struct xor_bit_reader {
+    uint8_t *buf;
+    uint32_t length;
+    uint32_t pos;
+    uint64_t acc;
+    unsigned nbits;
+};
+
+static inline void xor_put_bits(struct xor_bit_writer *w, uint32_t value, unsigned bits)
+{
+    w->acc = (w->acc << bits) | ((uint64_t)value & ((1ULL << bits) - 1));
+    w->nbits += bits;
+    while (w->nbits >= 8) {
+        w->nbits -= 8;
+        if (unlikely(w->pos == w->capacity)) {
+            w->overflow = 1;
+            continue;
+        }
+        w->buf[w->pos++] = (uint8_t)(w->acc >> w->nbits);
+    }
+}
 
-    payload_offset = sizeof(*header) + sizeof(header->descr[0]) * count;
+static inline uint32_t xor_get_bits(struct xor_bit_reader *r, unsigned bits)
+{
+    while (r->nbits < bits) {
+        r->acc = (r->acc << 8) | (likely(r->pos < r->length) ? r->buf[r->pos++] : 0);
+        r->nbits += 8;
+    }
+    r->nbits -= bits;
+    return (uint32_t)((r->acc >> r->nbits) & ((1ULL << bits) - 1));
+}
 
-    trailer = xt_io_descr->buf + xt_io_descr->bytes - sizeof(*trailer);
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, xt_io_descr->buf, xt_io_descr->bytes - sizeof(*trailer));
-    ret = crc32cmp(trailer->checksum, crc);
-#ifdef NETDATA_INTERNAL_CHECKS
-    {
-        struct rrdengine_datafile *datafile = xt_io_descr->descr_array[0]->extent->datafile;
-        debug(D_RRDENGINE, "%s: Extent at offset %"PRIu64"(%u) was read from datafile %u-%u. CRC32 check: %s", __func__,
-              xt_io_descr->pos, xt_io_descr->bytes, datafile->tier, datafile->fileno, ret ? "FAILED" : "SUCCEEDED");
+/* returns the encoded page length or 0 when it does not fit in capacity bytes */
+static uint32_t xor_encode_page(uint8_t *page, uint32_t page_length, uint8_t *dst, uint32_t capacity)
+{
+    struct xor_bit_writer w = { .buf = dst, .capacity = capacity };
+    unsigned i, nr_values, lz, tz, prev_lz = 0, prev_tz = 0, bits;
+    uint32_t value, prev, x;
+
+    nr_values = page_length / sizeof(storage_number);
+    for (i = 0, prev = 0 ; i < nr_values && !w.overflow ; ++i) {
+        (void) memcpy(&value, page + i * sizeof(storage_number), sizeof(value));
+        if (unlikely(0 == i)) {
+            xor_put_bits(&w, value, 32);
+            prev = value;
+            continue;
+        }
+        x = value ^ prev;
+        prev = value;
+        if (0 == x) {
+            xor_put_bits(&w, 0, 1);
+            continue;
+        }
+        lz = __builtin_clz(x);
+        tz = __builtin_ctz(x);
+        if (prev_lz + prev_tz && lz >= prev_lz && tz >= prev_tz) {
+            bits = 32 - prev_lz - prev_tz;
+            xor_put_bits(&w, 2, 2);
+            xor_put_bits(&w, x >> prev_tz, bits);
+        } else {
+            bits = 32 - lz - tz;
+            xor_put_bits(&w, 3, 2);
+            xor_put_bits(&w, lz, 5);
+            xor_put_bits(&w, bits - 1, 5);
+            xor_put_bits(&w, x >> tz, bits);
+            prev_lz = lz;
+            prev_tz = tz;
+        }
     }
-#endif
-    if (unlikely(ret)) {
-        /* TODO: handle errors */
-        exit(UV_EIO);
-        goto cleanup;
+    /* pages are always made of whole storage numbers, but do not lose any trailing bytes */
+    for (i = nr_values * sizeof(storage_number) ; i < page_length ; ++i)
+        xor_put_bits(&w, page[i], 8);
+    if (w.nbits)
+        xor_put_bits(&w, 0, 8 - w.nbits);
+
+    return w.overflow ? 0 : w.pos;
+}
+
+static void xor_decode_page(uint8_t *src, uint32_t src_length, uint8_t *page, uint32_t page_length)
+{
+    struct xor_bit_reader r = { .buf = src, .length = src_length };
+    unsigned i, nr_values, lz = 0, tz = 0, bits;
+    uint32_t value = 0;
+
+    nr_values = page_length / sizeof(storage_number);
+    for (i = 0 ; i < nr_values ; ++i) {
+        if (unlikely(0 == i)) {
+            value = xor_get_bits(&r, 32);
+        } else if (xor_get_bits(&r, 1)) {
+            if (xor_get_bits(&r, 1)) {
+                lz = xor_get_bits(&r, 5);
+                bits = xor_get_bits(&r, 5) + 1;
+                tz = 32 - MIN(32, lz + bits);
+            }
+            bits = 32 - lz - tz;
+            value ^= xor_get_bits(&r, bits) << tz;
+        }
+        (void) memcpy(page + i * sizeof(storage_number), &value, sizeof(value));
     }
+    for (i = nr_values * sizeof(storage_number) ; i < page_length ; ++i)
+        page[i] = (uint8_t)xor_get_bits(&r, 8);
+}
 
-    if (RRD_NO_COMPRESSION != header->compression_algorithm) {
-        uncompressed_payload_length = 0;
-        for (i = 0 ; i < count ; ++i) {
-            uncompressed_payload_length += header->descr[i].page_length;
+static uint32_t xor_compress(void *src, uint32_t src_length, struct rrdeng_extent_page_descr *descr, unsigned count,
+                             void *dst, uint32_t dst_capacity)
+{
+    unsigned i;
+    uint32_t page_offset, pos, length, stream_lengths[MAX_PAGES_PER_EXTENT];
+    (void)src_length;
+
+    pos = count * sizeof(stream_lengths[0]);
+    if (pos >= dst_capacity)
+        return 0;
+    for (i = 0, page_offset = 0 ; i < count ; ++i) {
+        length = xor_encode_page(src + page_offset, descr[i].page_length, dst + pos, dst_capacity - pos);
+        if (0 == length && descr[i].page_length)
+            return 0;
+        stream_lengths[i] = length;
+        page_offset += descr[i].page_length;
+        pos += length;
+    }
+    (void) memcpy(dst, stream_lengths, count * sizeof(stream_lengths[0]));
+    return pos;
+}
+
+static uint32_t xor_decompress(void *src, uint32_t src_length, struct rrdeng_extent_page_descr *descr, unsigned count,
+                               uint8_t *wanted, void *dst)
+{
+    unsigned i;
+    uint32_t page_offset, pos, decompressed_length, stream_lengths[MAX_PAGES_PER_EXTENT];
+
+    pos = count * sizeof(stream_lengths[0]);
+    if (unlikely(pos > src_length))
+        return 0;
+    (void) memcpy(stream_lengths, src, pos);
+    for (i = 0, page_offset = 0, decompressed_length = 0 ; i < count ; ++i) {
+        if (unlikely(stream_lengths[i] > src_length - pos))
+            return 0;
+        if (wanted[i]) {
+            xor_decode_page(src + pos, stream_lengths[i], dst + page_offset, descr[i].page_length);
+            decompressed_length += descr[i].page_length;
         }
-        uncompressed_buf = mallocz(uncompressed_payload_length);
-        ret = LZ4_decompress_safe(xt_io_descr->buf + payload_offset, uncompressed_buf,
-                                  payload_length, uncompressed_payload_length);
-        ctx->stats.before_decompress_bytes += payload_length;
-        ctx->stats.after_decompress_bytes += ret;
-        debug(D_RRDENGINE, "LZ4 decompressed %u bytes to %d bytes.", payload_length, ret);
-        /* care, we don't hold the descriptor mutex */
+        page_offset += descr[i].page_length;
+        pos += stream_lengths[i];
+    }
+    return decompressed_length;
+}
+
+static struct rrdeng_codec rrdeng_codecs[] = {
+    { .algorithm = RRD_LZ4, .name = "LZ4", .compress = lz4_compress, .decompress = lz4_decompress },
+    { .algorithm = RRD_XOR, .name = "XOR", .compress = xor_compress, .decompress = xor_decompress },
+};
+
+static struct rrdeng_codec *get_codec(uint8_t compression_algorithm)
+{
+    unsigned i;
+
+    for (i = 0 ; i < sizeof(rrdeng_codecs) / sizeof(rrdeng_codecs[0]) ; ++i) {
+        if (rrdeng_codecs[i].algorithm == compression_algorithm)
+            return &rrdeng_codecs[i];
+    }
+    return NULL;
+}
+
+/*
+ * Compresses the uncompressed payload of an extent in place with every codec and keeps the smallest result.
+ * The payload is stored uncompressed when no codec makes it smaller. Returns the chosen algorithm.
+ */
+static uint8_t compress_extent_payload(struct rrdengine_instance *ctx, void *payload, uint32_t uncompressed_length,
+                                       struct rrdeng_extent_page_descr *descr, unsigned count,
+                                       uint32_t *payload_length)
+{
+    unsigned i;
+    uint32_t compressed_size, best_size;
+    uint8_t compression_algorithm = RRD_NO_COMPRESSION;
+    void *compressed_buf, *best_buf, *tmp;
+
+    *payload_length = uncompressed_length;
+    if (RRD_NO_COMPRESSION == ctx->global_compress_alg || 0 == uncompressed_length)
+        return RRD_NO_COMPRESSION;
+
+    compressed_buf = mallocz(uncompressed_length);
+    best_buf = mallocz(uncompressed_length);
+    best_size = uncompressed_length;
+    for (i = 0 ; i < sizeof(rrdeng_codecs) / sizeof(rrdeng_codecs[0]) ; ++i) {
+        /* only accept results that are smaller than the best so far */
+        compressed_size = rrdeng_codecs[i].compress(payload, uncompressed_length, descr, count, compressed_buf,
+                                                    best_size - 1);
+        if (compressed_size && compressed_size < best_size) {
+            best_size = compressed_size;
+            compression_algorithm = rrdeng_codecs[i].algorithm;
+            tmp = best_buf;
+            best_buf = compressed_buf;
+            compressed_buf = tmp;
+        }
+    }
+    if (RRD_NO_COMPRESSION != compression_algorithm) {
+        (void) memcpy(payload, best_buf, best_size);
+        *payload_length = best_size;
+    }
+    freez(compressed_buf);
+    freez(best_buf);
+
+    ctx->stats.before_compress_bytes += uncompressed_length;
+    ctx->stats.after_compress_bytes += *payload_length;
+    if (RRD_XOR == compression_algorithm)
+        ++ctx->stats.xor_compressed_extents;
+    debug(D_RRDENGINE, "Compressed %"PRIu32" bytes to %"PRIu32" bytes with algorithm %u.", uncompressed_length,
+          *payload_length, (unsigned)compression_algorithm);
+
+    return compression_algorithm;
+}
+
+static struct extent_cache_entry *extent_cache_lookup(struct rrdengine_worker_config* wc,
+                                                      struct rrdengine_datafile *datafile, uint64_t pos)
+{
+    struct extent_cache *extent_cache = &wc->extent_cache;
+    struct extent_cache_entry *entry;
+    unsigned i;
+
+    for (i = 0 ; i < RRDENG_EXTENT_CACHE_SIZE ; ++i) {
+        entry = &extent_cache->entries[i];
+        if (entry->datafile == datafile && entry->pos == pos) {
+            entry->last_used = ++extent_cache->clock;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* The extent cache takes ownership of buf */
+static void extent_cache_insert(struct rrdengine_worker_config* wc, struct rrdengine_datafile *datafile, uint64_t pos,
+                                void *buf, unsigned bytes)
+{
+    struct extent_cache *extent_cache = &wc->extent_cache;
+    struct extent_cache_entry *entry, *victim;
+    unsigned i;
+
+    victim = &extent_cache->entries[0];
+    for (i = 0 ; i < RRDENG_EXTENT_CACHE_SIZE ; ++i) {
+        entry = &extent_cache->entries[i];
+        if (NULL == entry->datafile) {
+            victim = entry;
+            break;
+        }
+        if (entry->last_used < victim->last_used)
+            victim = entry;
+    }
+    if (victim->datafile)
+        free(victim->buf);
+    victim->datafile = datafile;
+    victim->pos = pos;
+    victim->bytes = bytes;
+    victim->buf = buf;
+    victim->last_used = ++extent_cache->clock;
+}
+
+/* Drops the cached extents of datafile, or all of them if datafile is NULL */
+static void extent_cache_invalidate(struct rrdengine_worker_config* wc, struct rrdengine_datafile *datafile)
+{
+    struct extent_cache_entry *entry;
+    unsigned i;
+
+    for (i = 0 ; i < RRDENG_EXTENT_CACHE_SIZE ; ++i) {
+        entry = &wc->extent_cache.entries[i];
+        if (entry->datafile && (NULL == datafile || entry->datafile == datafile)) {
+            free(entry->buf);
+            entry->datafile = NULL;
+            entry->buf = NULL;
+        }
+    }
+}
+
+/*
+ * Populates the pages of xt_io_descr from the extent in buf, which has already passed the CRC check.
+ * Compressed extents are only decoded as far as their codec needs to reach the requested pages.
+ */
+static void populate_extent_pages(struct rrdengine_instance *ctx, struct extent_io_descriptor *xt_io_descr, void *buf)
+{
+    struct rrdeng_page_descr *descr;
+    struct page_cache_descr *pg_cache_descr;
+    struct rrdeng_codec *codec;
+    unsigned i, j, count;
+    void *page, *uncompressed_buf = NULL;
+    uint32_t payload_length, payload_offset, page_offset, uncompressed_payload_length, decompressed_length;
+    uint32_t page_offsets[MAX_PAGES_PER_EXTENT];
+    uint8_t compression_algorithm, wanted[MAX_PAGES_PER_EXTENT];
+    /* persistent structures */
+    struct rrdeng_extent_page_descr *extent_descr, *converted_descr = NULL;
+
+    if (1 == xt_io_descr->descr_array[0]->extent->datafile->version) {
+        struct rrdeng_df_extent_header_v1 *header = buf;
+
+        payload_length = header->payload_length;
+        compression_algorithm = header->compression_algorithm;
+        count = header->number_of_pages;
+        extent_descr = converted_descr = mallocz(sizeof(*extent_descr) * MAX(count, 1));
+        convert_extent_page_descr_v2(extent_descr, header->descr, count);
+        payload_offset = sizeof(*header) + sizeof(header->descr[0]) * count;
+    } else if (2 == xt_io_descr->descr_array[0]->extent->datafile->version) {
+        struct rrdeng_df_extent_header_v2 *header = buf;
+
+        payload_length = header->payload_length;
+        compression_algorithm = header->compression_algorithm;
+        count = header->number_of_pages;
+        extent_descr = converted_descr = mallocz(sizeof(*extent_descr) * MAX(count, 1));
+        convert_extent_page_descr_v2(extent_descr, header->descr, count);
+        payload_offset = sizeof(*header) + sizeof(header->descr[0]) * count;
+    } else {
+        struct rrdeng_df_extent_header *header = buf;
+
+        payload_length = header->payload_length;
+        compression_algorithm = header->compression_algorithm;
+        count = header->number_of_pages;
+        extent_descr = header->descr;
+        payload_offset = sizeof(*header) + sizeof(header->descr[0]) * count;
     }
 
+    (void) memset(wanted, 0, count);
     for (i = 0 ; i < xt_io_descr->descr_count; ++i) {
-        page = mallocz(RRDENG_BLOCK_SIZE);
         descr = xt_io_descr->descr_array[i];
         for (j = 0, page_offset = 0; j < count; ++j) {
             /* care, we don't hold the descriptor mutex */
-            if (!uuid_compare(*(uuid_t *) header->descr[j].uuid, *descr->id) &&
-                header->descr[j].page_length == descr->page_length &&
-                header->descr[j].start_time == descr->start_time &&
-                header->descr[j].end_time == descr->end_time) {
+            if (!uuid_compare(*(uuid_t *) extent_descr[j].uuid, *descr->id) &&
+                extent_descr[j].page_length == descr->page_length &&
+                extent_descr[j].start_time == pg_descr_start_time(descr) &&
+                extent_descr[j].end_time == pg_descr_end_time(descr)) {
+                wanted[j] = 1;
                 break;
             }
-            page_offset += header->descr[j].page_length;
+            page_offset += extent_descr[j].page_length;
         }
+        page_offsets[i] = page_offset;
+    }
+
+    if (RRD_NO_COMPRESSION != compression_algorithm) {
+        uncompressed_payload_length = 0;
+        for (i = 0 ; i < count ; ++i) {
+            uncompressed_payload_length += extent_descr[i].page_length;
+        }
+        uncompressed_buf = callocz(1, uncompressed_payload_length);
+        codec = get_codec(compression_algorithm);
+        if (unlikely(NULL == codec)) {
+            error("%s: Unknown compression algorithm %u in extent at offset %"PRIu64" of datafile %u-%u.", __func__,
+                  (unsigned)compression_algorithm, xt_io_descr->pos, xt_io_descr->descr_array[0]->extent->datafile->tier,
+                  xt_io_descr->descr_array[0]->extent->datafile->fileno);
+            decompressed_length = 0;
+        } else {
+            decompressed_length = codec->decompress(buf + payload_offset, payload_length, extent_descr, count, wanted,
+                                                    uncompressed_buf);
+            debug(D_RRDENGINE, "%s decompressed %u bytes to %u bytes.", codec->name, payload_length,
+                  decompressed_length);
+        }
+        ctx->stats.before_decompress_bytes += payload_length;
+        ctx->stats.after_decompress_bytes += decompressed_length;
         /* care, we don't hold the descriptor mutex */
-        if (RRD_NO_COMPRESSION == header->compression_algorithm) {
-            (void) memcpy(page, xt_io_descr->buf + payload_offset + page_offset, descr->page_length);
+    }
+
+    for (i = 0 ; i < xt_io_descr->descr_count; ++i) {
+        page = page_arena_alloc(ctx, xt_io_descr->node, RRDENG_BLOCK_SIZE);
+        descr = xt_io_descr->descr_array[i];
+        page_offset = page_offsets[i];
+        /* care, we don't hold the descriptor mutex */
+        if (RRD_NO_COMPRESSION == compression_algorithm) {
+            (void) memcpy(page, buf + payload_offset + page_offset, descr->page_length);
         } else {
             (void) memcpy(page, uncompressed_buf + page_offset, descr->page_length);
         }
@@ -108,6 +530,7 @@ void read_extent_cb(uv_fs_t* req)
         rrdeng_page_descr_mutex_lock(ctx, descr);
         pg_cache_descr = descr->pg_cache_descr;
         pg_cache_descr->page = page;
+        pg_cache_descr->node = xt_io_descr->node;
         pg_cache_descr->flags |= RRD_PAGE_POPULATED;
         pg_cache_descr->flags &= ~RRD_PAGE_READ_PENDING;
         debug(D_RRDENGINE, "%s: Waking up waiters.", __func__);
@@ -118,22 +541,71 @@ void read_extent_cb(uv_fs_t* req)
         }
         rrdeng_page_descr_mutex_unlock(ctx, descr);
     }
-    if (RRD_NO_COMPRESSION != header->compression_algorithm) {
+    if (RRD_NO_COMPRESSION != compression_algorithm) {
         freez(uncompressed_buf);
     }
+    freez(converted_descr);
     if (xt_io_descr->completion)
         complete(xt_io_descr->completion);
+}
+
+/* result is the number of bytes read or a negative error code */
+static void read_extent_complete(struct rrdengine_worker_config* wc, struct extent_io_descriptor *xt_io_descr,
+                                 int result)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct rrdengine_datafile *datafile;
+    int ret;
+    /* persistent structures */
+    struct rrdeng_df_extent_trailer *trailer;
+    uLong crc;
+
+    datafile = xt_io_descr->descr_array[0]->extent->datafile;
+    if (result < 0) {
+        error("%s: extent read: %s", __func__, uv_strerror(result));
+        goto cleanup;
+    }
+
+    trailer = xt_io_descr->buf + xt_io_descr->bytes - sizeof(*trailer);
+    crc = rrdeng_checksum(datafile->version, xt_io_descr->buf, xt_io_descr->bytes - sizeof(*trailer));
+    ret = crc32cmp(trailer->checksum, crc);
+    debug(D_RRDENGINE, "%s: Extent at offset %"PRIu64"(%u) was read from datafile %u-%u. Checksum check: %s", __func__,
+          xt_io_descr->pos, xt_io_descr->bytes, datafile->tier, datafile->fileno, ret ? "FAILED" : "SUCCEEDED");
+    if (unlikely(ret)) {
+        /* TODO: handle errors */
+        exit(UV_EIO);
+        goto cleanup;
+    }
+
+    populate_extent_pages(ctx, xt_io_descr, xt_io_descr->buf);
+    /* keep the extent around, neighbouring pages are likely to be requested soon */
+    extent_cache_insert(wc, datafile, xt_io_descr->pos, xt_io_descr->buf, xt_io_descr->bytes);
+    xt_io_descr->buf = NULL;
 cleanup:
-    uv_fs_req_cleanup(req);
     free(xt_io_descr->buf);
     freez(xt_io_descr);
 }
 
+void read_extent_cb(uv_fs_t* req)
+{
+    struct rrdengine_worker_config* wc = req->loop->data;
+    int result = (int)req->result;
+
+    uv_fs_req_cleanup(req);
+    read_extent_complete(wc, req->data, result);
+}
+
+static void read_extent_uring_cb(struct rrdengine_worker_config* wc, void *data, int result)
+{
+    read_extent_complete(wc, data, result);
+}
 
+/* the pages are allocated from the arena of NUMA node, see page_arena_pick_node() */
 static void do_read_extent(struct rrdengine_worker_config* wc,
                            struct rrdeng_page_descr **descr,
                            unsigned count,
-                           uint8_t release_descr)
+                           uint8_t release_descr,
+                           uint8_t node)
 {
     struct rrdengine_instance *ctx = wc->ctx;
     struct page_cache_descr *pg_cache_descr;
@@ -142,17 +614,24 @@ static void do_read_extent(struct rrdengine_worker_config* wc,
 //    uint32_t payload_length;
     struct extent_io_descriptor *xt_io_descr;
     struct rrdengine_datafile *datafile;
+    struct extent_cache_entry *cached_extent;
 
     datafile = descr[0]->extent->datafile;
     pos = descr[0]->extent->offset;
     size_bytes = descr[0]->extent->size;
 
+    cached_extent = extent_cache_lookup(wc, datafile, pos);
+
     xt_io_descr = mallocz(sizeof(*xt_io_descr));
-    ret = posix_memalign((void *)&xt_io_descr->buf, RRDFILE_ALIGNMENT, ALIGN_BYTES_CEILING(size_bytes));
-    if (unlikely(ret)) {
-        fatal("posix_memalign:%s", strerror(ret));
-        /* freez(xt_io_descr);
-        return;*/
+    if (cached_extent) {
+        xt_io_descr->buf = NULL;
+    } else {
+        ret = posix_memalign((void *)&xt_io_descr->buf, RRDFILE_ALIGNMENT, ALIGN_BYTES_CEILING(size_bytes));
+        if (unlikely(ret)) {
+            fatal("posix_memalign:%s", strerror(ret));
+            /* freez(xt_io_descr);
+            return;*/
+        }
     }
     for (i = 0 ; i < count; ++i) {
         rrdeng_page_descr_mutex_lock(ctx, descr[i]);
@@ -170,11 +649,24 @@ static void do_read_extent(struct rrdengine_worker_config* wc,
     xt_io_descr->completion = NULL;
     /* xt_io_descr->descr_commit_idx_array[0] */
     xt_io_descr->release_descr = release_descr;
+    xt_io_descr->node = node;
+
+    if (cached_extent) {
+        /* no I/O needed, decode the requested pages from the cached extent */
+        populate_extent_pages(ctx, xt_io_descr, cached_extent->buf);
+        freez(xt_io_descr);
+        ++ctx->stats.extent_cache_hits;
+        return;
+    }
 
     real_io_size = ALIGN_BYTES_CEILING(size_bytes);
-    xt_io_descr->iov = uv_buf_init((void *)xt_io_descr->buf, real_io_size);
-    ret = uv_fs_read(wc->loop, &xt_io_descr->req, datafile->file, &xt_io_descr->iov, 1, pos, read_extent_cb);
-    assert (-1 != ret);
+    ret = rrdeng_uring_read(wc, datafile->file, xt_io_descr->buf, real_io_size, pos, &xt_io_descr->uring_req,
+                            read_extent_uring_cb, xt_io_descr);
+    if (ret) {
+        xt_io_descr->iov = uv_buf_init((void *)xt_io_descr->buf, real_io_size);
+        ret = uv_fs_read(wc->loop, &xt_io_descr->req, datafile->file, &xt_io_descr->iov, 1, pos, read_extent_cb);
+        assert (-1 != ret);
+    }
     ctx->stats.io_read_bytes += real_io_size;
     ++ctx->stats.io_read_requests;
     ctx->stats.io_read_extent_bytes += real_io_size;
@@ -215,8 +707,8 @@ static void commit_data_extent(struct rrdengine_worker_config* wc, struct extent
     memcpy(jf_metric_data->descr, df_header->descr, descr_size);
 
     jf_trailer = buf + sizeof(*jf_header) + payload_length;
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, buf, sizeof(*jf_header) + payload_length);
+    crc = rrdeng_checksum(xt_io_descr->descr_array[0]->extent->datafile->journalfile->version, buf,
+                          sizeof(*jf_header) + payload_length);
     crc32set(jf_trailer->checksum, crc);
 }
 
@@ -232,23 +724,24 @@ static void do_commit_transaction(struct rrdengine_worker_config* wc, uint8_t ty
     }
 }
 
-void flush_pages_cb(uv_fs_t* req)
+/* result is the number of bytes written or a negative error code */
+static void flush_pages_complete(struct rrdengine_worker_config* wc, struct extent_io_descriptor *xt_io_descr,
+                                 int result)
 {
-    struct rrdengine_worker_config* wc = req->loop->data;
     struct rrdengine_instance *ctx = wc->ctx;
     struct page_cache *pg_cache = &ctx->pg_cache;
-    struct extent_io_descriptor *xt_io_descr;
     struct rrdeng_page_descr *descr;
     struct page_cache_descr *pg_cache_descr;
     int ret;
     unsigned i, count;
     Word_t commit_id;
 
-    xt_io_descr = req->data;
-    if (req->result < 0) {
-        error("%s: uv_fs_write: %s", __func__, uv_strerror((int)req->result));
+    if (result < 0) {
+        error("%s: extent write: %s", __func__, uv_strerror(result));
+        /* the pages stay pending and are never flushed again */
         goto cleanup;
     }
+    rrdeng_latency_record(RRDENG_LATENCY_FLUSH, now_monotonic_usec() - xt_io_descr->started_ut);
 #ifdef NETDATA_INTERNAL_CHECKS
     {
         struct rrdengine_datafile *datafile = xt_io_descr->descr_array[0]->extent->datafile;
@@ -257,6 +750,7 @@ void flush_pages_cb(uv_fs_t* req)
     }
 #endif
     count = xt_io_descr->descr_count;
+    wc->writeback.pending_pages -= count;
     for (i = 0 ; i < count ; ++i) {
         /* care, we don't hold the descriptor mutex */
         descr = xt_io_descr->descr_array[i];
@@ -280,32 +774,45 @@ void flush_pages_cb(uv_fs_t* req)
     if (xt_io_descr->completion)
         complete(xt_io_descr->completion);
 cleanup:
-    uv_fs_req_cleanup(req);
-    free(xt_io_descr->buf);
+    if (!rrdeng_uring_put_flush_buffer(wc, xt_io_descr->buf))
+        free(xt_io_descr->buf);
     freez(xt_io_descr);
 }
 
+void flush_pages_cb(uv_fs_t* req)
+{
+    struct rrdengine_worker_config* wc = req->loop->data;
+    int result = (int)req->result;
+
+    uv_fs_req_cleanup(req);
+    flush_pages_complete(wc, req->data, result);
+}
+
+static void flush_pages_uring_cb(struct rrdengine_worker_config* wc, void *data, int result)
+{
+    flush_pages_complete(wc, data, result);
+}
+
 /*
  * completion must be NULL or valid.
+ * Writes up to max_pages dirty pages in one extent, max_pages must not exceed MAX_PAGES_PER_EXTENT.
  * Returns 0 when no flushing can take place.
  * Returns datafile bytes to be written on successful flushing initiation.
  */
-static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct completion *completion)
+static int do_flush_pages(struct rrdengine_worker_config* wc, int force, unsigned max_pages,
+                          struct completion *completion)
 {
     struct rrdengine_instance *ctx = wc->ctx;
     struct page_cache *pg_cache = &ctx->pg_cache;
     int ret;
-    int compressed_size, max_compressed_size = 0;
     unsigned i, count, size_bytes, pos, real_io_size;
-    uint32_t uncompressed_payload_length, payload_offset;
+    uint32_t uncompressed_payload_length, payload_offset, payload_length;
     struct rrdeng_page_descr *descr, *eligible_pages[MAX_PAGES_PER_EXTENT];
     struct page_cache_descr *pg_cache_descr;
     struct extent_io_descriptor *xt_io_descr;
-    void *compressed_buf = NULL;
     Word_t descr_commit_idx_array[MAX_PAGES_PER_EXTENT];
     Pvoid_t *PValue;
     Word_t Index;
-    uint8_t compression_algorithm = ctx->global_compress_alg;
     struct extent_info *extent;
     struct rrdengine_datafile *datafile;
     /* persistent structures */
@@ -321,7 +828,7 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
          PValue = JudyLFirst(pg_cache->commited_page_index.JudyL_array, &Index, PJE0),
          descr = unlikely(NULL == PValue) ? NULL : *PValue ;
 
-         descr != NULL && count != MAX_PAGES_PER_EXTENT ;
+         descr != NULL && count != max_pages ;
 
          PValue = JudyLNext(pg_cache->commited_page_index.JudyL_array, &Index, PJE0),
          descr = unlikely(NULL == PValue) ? NULL : *PValue) {
@@ -346,30 +853,26 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
             complete(completion);
         return 0;
     }
+    wc->writeback.pending_pages += count;
     xt_io_descr = mallocz(sizeof(*xt_io_descr));
+    xt_io_descr->started_ut = now_monotonic_usec();
     payload_offset = sizeof(*header) + count * sizeof(header->descr[0]);
-    switch (compression_algorithm) {
-    case RRD_NO_COMPRESSION:
-        size_bytes = payload_offset + uncompressed_payload_length + sizeof(*trailer);
-        break;
-    default: /* Compress */
-        assert(uncompressed_payload_length < LZ4_MAX_INPUT_SIZE);
-        max_compressed_size = LZ4_compressBound(uncompressed_payload_length);
-        compressed_buf = mallocz(max_compressed_size);
-        size_bytes = payload_offset + MAX(uncompressed_payload_length, (unsigned)max_compressed_size) + sizeof(*trailer);
-        break;
-    }
-    ret = posix_memalign((void *)&xt_io_descr->buf, RRDFILE_ALIGNMENT, ALIGN_BYTES_CEILING(size_bytes));
-    if (unlikely(ret)) {
-        fatal("posix_memalign:%s", strerror(ret));
-        /* freez(xt_io_descr);*/
+    /* compressed payloads are never larger than uncompressed ones */
+    size_bytes = payload_offset + uncompressed_payload_length + sizeof(*trailer);
+    /* registered buffers save the kernel from mapping the pages of every write */
+    xt_io_descr->buf = rrdeng_uring_get_flush_buffer(wc, ALIGN_BYTES_CEILING(size_bytes));
+    if (NULL == xt_io_descr->buf) {
+        ret = posix_memalign((void *)&xt_io_descr->buf, RRDFILE_ALIGNMENT, ALIGN_BYTES_CEILING(size_bytes));
+        if (unlikely(ret)) {
+            fatal("posix_memalign:%s", strerror(ret));
+            /* freez(xt_io_descr);*/
+        }
     }
     (void) memcpy(xt_io_descr->descr_array, eligible_pages, sizeof(struct rrdeng_page_descr *) * count);
     xt_io_descr->descr_count = count;
 
     pos = 0;
     header = xt_io_descr->buf;
-    header->compression_algorithm = compression_algorithm;
     header->number_of_pages = count;
     pos += sizeof(*header);
 
@@ -388,8 +891,13 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
         header->descr[i].type = PAGE_METRICS;
         uuid_copy(*(uuid_t *)header->descr[i].uuid, *descr->id);
         header->descr[i].page_length = descr->page_length;
-        header->descr[i].start_time = descr->start_time;
-        header->descr[i].end_time = descr->end_time;
+        header->descr[i].start_time = pg_descr_start_time(descr);
+        header->descr[i].end_time = pg_descr_end_time(descr);
+        header->descr[i].summary_flags = descr->summary.flags;
+        header->descr[i].count = descr->summary.count;
+        header->descr[i].min = descr->summary.min;
+        header->descr[i].max = descr->summary.max;
+        header->descr[i].sum = descr->summary.sum;
         pos += sizeof(header->descr[i]);
     }
     for (i = 0 ; i < count ; ++i) {
@@ -403,22 +911,11 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
     }
     df_extent_insert(extent);
 
-    switch (compression_algorithm) {
-    case RRD_NO_COMPRESSION:
-        header->payload_length = uncompressed_payload_length;
-        break;
-    default: /* Compress */
-        compressed_size = LZ4_compress_default(xt_io_descr->buf + payload_offset, compressed_buf,
-                                               uncompressed_payload_length, max_compressed_size);
-        ctx->stats.before_compress_bytes += uncompressed_payload_length;
-        ctx->stats.after_compress_bytes += compressed_size;
-        debug(D_RRDENGINE, "LZ4 compressed %"PRIu32" bytes to %d bytes.", uncompressed_payload_length, compressed_size);
-        (void) memcpy(xt_io_descr->buf + payload_offset, compressed_buf, compressed_size);
-        freez(compressed_buf);
-        size_bytes = payload_offset + compressed_size + sizeof(*trailer);
-        header->payload_length = compressed_size;
-        break;
-    }
+    header->compression_algorithm = compress_extent_payload(ctx, xt_io_descr->buf + payload_offset,
+                                                            uncompressed_payload_length, header->descr, count,
+                                                            &payload_length);
+    header->payload_length = payload_length;
+    size_bytes = payload_offset + payload_length + sizeof(*trailer);
     extent->size = size_bytes;
     xt_io_descr->bytes = size_bytes;
     xt_io_descr->pos = datafile->pos;
@@ -426,14 +923,18 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
     xt_io_descr->completion = completion;
 
     trailer = xt_io_descr->buf + size_bytes - sizeof(*trailer);
-    crc = crc32(0L, Z_NULL, 0);
-    crc = crc32(crc, xt_io_descr->buf, size_bytes - sizeof(*trailer));
+    crc = rrdeng_checksum(datafile->version, xt_io_descr->buf, size_bytes - sizeof(*trailer));
     crc32set(trailer->checksum, crc);
 
     real_io_size = ALIGN_BYTES_CEILING(size_bytes);
-    xt_io_descr->iov = uv_buf_init((void *)xt_io_descr->buf, real_io_size);
-    ret = uv_fs_write(wc->loop, &xt_io_descr->req, datafile->file, &xt_io_descr->iov, 1, datafile->pos, flush_pages_cb);
-    assert (-1 != ret);
+    ret = rrdeng_uring_write(wc, datafile->file, xt_io_descr->buf, real_io_size, datafile->pos,
+                             &xt_io_descr->uring_req, flush_pages_uring_cb, xt_io_descr);
+    if (ret) {
+        xt_io_descr->iov = uv_buf_init((void *)xt_io_descr->buf, real_io_size);
+        ret = uv_fs_write(wc->loop, &xt_io_descr->req, datafile->file, &xt_io_descr->iov, 1, datafile->pos,
+                          flush_pages_cb);
+        assert (-1 != ret);
+    }
     ctx->stats.io_write_bytes += real_io_size;
     ++ctx->stats.io_write_requests;
     ctx->stats.io_write_extent_bytes += real_io_size;
@@ -446,24 +947,22 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
     return ALIGN_BYTES_CEILING(size_bytes);
 }
 
-static void after_delete_old_data(uv_work_t *req, int status)
+/* The data file must not be the newest one and its extents must have been freed */
+static void delete_datafile_pair(struct rrdengine_worker_config* wc, struct rrdengine_datafile *datafile)
 {
-    struct rrdengine_instance *ctx = req->data;
-    struct rrdengine_worker_config* wc = &ctx->worker_config;
-    struct rrdengine_datafile *datafile;
+    struct rrdengine_instance *ctx = wc->ctx;
     struct rrdengine_journalfile *journalfile;
     unsigned deleted_bytes, journalfile_bytes, datafile_bytes;
     int ret;
     char path[RRDENG_PATH_MAX];
 
-    (void)status;
-    datafile = ctx->datafiles.first;
     journalfile = datafile->journalfile;
     datafile_bytes = datafile->pos;
     journalfile_bytes = journalfile->pos;
     deleted_bytes = 0;
 
     info("Deleting data and journal file pair.");
+    extent_cache_invalidate(wc, datafile);
     datafile_list_delete(ctx, datafile);
     ret = destroy_journal_file(journalfile, datafile);
     if (!ret) {
@@ -482,6 +981,15 @@ static void after_delete_old_data(uv_work_t *req, int status)
 
     ctx->disk_space -= deleted_bytes;
     info("Reclaimed %u bytes of disk space.", deleted_bytes);
+}
+
+static void after_delete_old_data(uv_work_t *req, int status)
+{
+    struct rrdengine_instance *ctx = req->data;
+    struct rrdengine_worker_config* wc = &ctx->worker_config;
+
+    (void)status;
+    delete_datafile_pair(wc, ctx->datafiles.first);
 
     /* unfreeze command processing */
     wc->now_deleting.data = NULL;
@@ -504,13 +1012,205 @@ static void delete_old_data(uv_work_t *req)
         count = extent->number_of_pages;
         for (i = 0 ; i < count ; ++i) {
             descr = extent->pages[i];
-            pg_cache_punch_hole(ctx, descr, 0);
+            /* deleted and compacted pages have already left the extent */
+            if (descr)
+                pg_cache_punch_hole(ctx, descr, 0);
         }
         next = extent->next;
         freez(extent);
     }
 }
 
+/* Deletes the pages of deleted metrics, pages that are in use are retried on the next timer tick */
+static void do_delete_metric_pages(struct rrdengine_worker_config* wc)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct rrdeng_deleted_metric *metric, **metricp;
+    struct pg_cache_page_index *page_index;
+    struct rrdeng_page_descr *descr;
+    Pvoid_t *PValue;
+    Word_t Index;
+    uint8_t busy;
+
+    for (metricp = &wc->deleted_metrics ; NULL != (metric = *metricp) ; ) {
+        busy = 0;
+        uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
+        PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, &metric->id, sizeof(uuid_t));
+        page_index = (NULL == PValue) ? NULL : *PValue;
+        uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
+
+        for (Index = 0 ; page_index != NULL ; ++Index) {
+            uv_rwlock_rdlock(&page_index->lock);
+            PValue = JudyLFirst(page_index->JudyL_array, &Index, PJE0);
+            descr = (NULL == PValue) ? NULL : *PValue;
+            uv_rwlock_rdunlock(&page_index->lock);
+            /* the pages of a chart that has been created again after the deletion are kept */
+            if (NULL == descr || pg_descr_start_time(descr) > metric->before)
+                break;
+            if (!pg_cache_try_punch_hole(ctx, descr))
+                busy = 1;
+        }
+        if (busy) {
+            metricp = &metric->next;
+            continue;
+        }
+        *metricp = metric->next;
+        freez(metric);
+    }
+}
+
+/* The journal indices of sealed data files stop listing the pages that have been deleted since they were written */
+static void rewrite_stale_journal_indices(struct rrdengine_worker_config* wc)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct rrdengine_datafile *datafile;
+
+    for (datafile = ctx->datafiles.first ; datafile != ctx->datafiles.last ; datafile = datafile->next) {
+        /* the data file being compacted will be deleted */
+        if (!datafile->stale_index || datafile == wc->compacting)
+            continue;
+        (void) write_journal_index(ctx, datafile);
+        datafile->stale_index = 0;
+    }
+}
+
+/* Picks the oldest sealed data file with enough dead pages whose live pages fit in the disk space quota */
+static void pick_datafile_to_compact(struct rrdengine_worker_config* wc)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct rrdengine_datafile *datafile;
+    uint64_t nr_pages, nr_live_pages, live_bytes;
+
+    if (!default_rrdeng_compaction_threshold)
+        return;
+    for (datafile = ctx->datafiles.first ; datafile != ctx->datafiles.last ; datafile = datafile->next) {
+        nr_pages = datafile->nr_pages;
+        if (!nr_pages || (uint64_t)datafile->nr_dead_pages * 100 < nr_pages * default_rrdeng_compaction_threshold)
+            continue;
+        nr_live_pages = nr_pages - MIN(nr_pages, datafile->nr_dead_pages);
+        live_bytes = datafile->pos / nr_pages * nr_live_pages;
+        if (ctx->disk_space + live_bytes > ctx->max_disk_space)
+            continue;
+        info("Compacting data file \"%s/"DATAFILE_PREFIX RRDENG_FILE_NUMBER_PRINT_TMPL DATAFILE_EXTENSION"\", %"PRIu64
+             " of %"PRIu64" pages are live.", ctx->dbfiles_path, datafile->tier, datafile->fileno, nr_live_pages,
+             nr_pages);
+        wc->compacting = datafile;
+        wc->compaction_cursor = datafile->extents.first;
+        wc->compaction_corr_id = 0;
+        wc->compaction_done = 0;
+        return;
+    }
+}
+
+/* Returns 1 when no dirty page up to the correlation ID is waiting to be written to disk */
+static int dirty_pages_flushed(struct rrdengine_instance *ctx, Word_t corr_id)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    Pvoid_t *PValue;
+    Word_t Index = 0;
+
+    uv_rwlock_rdlock(&pg_cache->commited_page_index.lock);
+    PValue = JudyLFirst(pg_cache->commited_page_index.JudyL_array, &Index, PJE0);
+    uv_rwlock_rdunlock(&pg_cache->commited_page_index.lock);
+
+    return NULL == PValue || Index > corr_id;
+}
+
+/*
+ * Rewrites the live pages of the data file being compacted as dirty pages, which the normal flushing writes to fresh
+ * extents of the newest data file and journal file. Pages that are not in memory are read first, at most one extent
+ * per timer tick, and rewritten on the next tick. Pages that are in use are rewritten by the next pass over the file.
+ * When no live page is left and the rewritten pages are on disk, the old pair is deleted.
+ */
+static void do_compact_datafile(struct rrdengine_worker_config* wc)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct rrdengine_datafile *datafile = wc->compacting;
+    struct extent_info *extent, *next;
+    struct rrdeng_page_descr *descr, *read_array[MAX_PAGES_PER_EXTENT];
+    struct page_cache_descr *pg_cache_descr;
+    Pvoid_t *PValue;
+    unsigned i, count, moved_bytes;
+
+    for (moved_bytes = 0 ; wc->compaction_cursor && moved_bytes < DATAFILE_IDEAL_IO_SIZE ; ) {
+        extent = wc->compaction_cursor;
+        for (i = 0, count = 0 ; i < extent->number_of_pages ; ++i) {
+            descr = extent->pages[i];
+            if (NULL == descr)
+                continue;
+            rrdeng_page_descr_mutex_lock(ctx, descr);
+            pg_cache_descr = descr->pg_cache_descr;
+            if (!pg_cache_try_get_unsafe(descr, 1)) {
+                rrdeng_page_descr_mutex_unlock(ctx, descr);
+                continue;
+            }
+            if (!(pg_cache_descr->flags & RRD_PAGE_POPULATED)) {
+                rrdeng_page_descr_mutex_unlock(ctx, descr);
+                read_array[count++] = descr;
+                continue;
+            }
+            /* the page leaves the LRU until it has been written again */
+            pg_cache_descr->flags |= RRD_PAGE_DIRTY;
+            rrdeng_page_descr_mutex_unlock(ctx, descr);
+            pg_cache_replaceQ_delete(ctx, descr);
+            df_extent_drop_page(extent, descr);
+
+            uv_rwlock_wrlock(&pg_cache->commited_page_index.lock);
+            wc->compaction_corr_id = pg_cache->commited_page_index.latest_corr_id++;
+            PValue = JudyLIns(&pg_cache->commited_page_index.JudyL_array, wc->compaction_corr_id, PJE0);
+            *PValue = descr;
+            ++pg_cache->commited_page_index.nr_commited_pages;
+            uv_rwlock_wrunlock(&pg_cache->commited_page_index.lock);
+
+            pg_cache_put(ctx, descr);
+            moved_bytes += descr->page_length;
+            ++ctx->stats.compacted_pages;
+        }
+        if (count) {
+            /* the read releases the pages, the extent is visited again on the next tick */
+            for (i = 0 ; i < count && pg_cache_try_reserve_pages(ctx, 1) ; ++i)
+                ;
+            if (i)
+                do_read_extent(wc, read_array, i, 1, page_arena_pick_node(ctx));
+            for ( ; i < count ; ++i)
+                pg_cache_put(ctx, read_array[i]);
+            break;
+        }
+        wc->compaction_cursor = extent->next;
+    }
+    if (wc->compaction_cursor)
+        return;
+
+    for (extent = datafile->extents.first ; extent != NULL ; extent = extent->next) {
+        for (i = 0 ; i < extent->number_of_pages ; ++i) {
+            if (extent->pages[i]) {
+                /* start the next pass */
+                wc->compaction_cursor = extent;
+                return;
+            }
+        }
+    }
+    if (!wc->compaction_done) {
+        if (!dirty_pages_flushed(ctx, wc->compaction_corr_id))
+            return;
+        /* the old pair is deleted on the next tick, after the transactions of the rewritten pages are on disk */
+        wal_flush_transaction_buffer(wc);
+        wc->compaction_done = 1;
+        return;
+    }
+
+    for (extent = datafile->extents.first ; extent != NULL ; extent = next) {
+        next = extent->next;
+        freez(extent);
+    }
+    datafile->extents.first = datafile->extents.last = NULL;
+    wc->compacting = NULL;
+    ++ctx->stats.datafile_compactions;
+    delete_datafile_pair(wc, datafile);
+}
+
 void rrdeng_test_quota(struct rrdengine_worker_config* wc)
 {
     struct rrdengine_instance *ctx = wc->ctx;
@@ -532,9 +1232,11 @@ void rrdeng_test_quota(struct rrdengine_worker_config* wc)
     if (unlikely(current_size >= target_size || (out_of_space && only_one_datafile))) {
         /* Finalize data and journal file and create a new pair */
         wal_flush_transaction_buffer(wc);
-        ret = create_new_datafile_pair(ctx, 1, ctx->last_fileno + 1);
+        ret = create_new_datafile_pair(ctx, ctx->tier, ctx->last_fileno + 1);
         if (likely(!ret)) {
             ++ctx->last_fileno;
+            /* the previous pair is sealed, no more extents will be written to it */
+            (void) write_journal_index(ctx, datafile);
         }
     }
     if (unlikely(out_of_space)) {
@@ -551,6 +1253,10 @@ void rrdeng_test_quota(struct rrdengine_worker_config* wc)
         }
         info("Deleting data file \"%s/"DATAFILE_PREFIX RRDENG_FILE_NUMBER_PRINT_TMPL DATAFILE_EXTENSION"\".",
              ctx->dbfiles_path, ctx->datafiles.first->tier, ctx->datafiles.first->fileno);
+        if (wc->compacting == ctx->datafiles.first) {
+            /* the pages that have already been rewritten are safe in the newest data file */
+            wc->compacting = NULL;
+        }
         wc->now_deleting.data = ctx;
         assert(0 == uv_queue_work(wc->loop, &wc->now_deleting, delete_old_data, after_delete_old_data));
     }
@@ -569,61 +1275,91 @@ void finalize_rrd_files(struct rrdengine_instance *ctx)
 
 void rrdeng_init_cmd_queue(struct rrdengine_worker_config* wc)
 {
+    unsigned long i;
+
     wc->cmd_queue.head = wc->cmd_queue.tail = 0;
-    wc->queue_size = 0;
-    assert(0 == uv_cond_init(&wc->cmd_cond));
-    assert(0 == uv_mutex_init(&wc->cmd_mutex));
+    for (i = 0 ; i < RRDENG_CMD_Q_MAX_SIZE ; ++i) {
+        wc->cmd_queue.cmd_array[i].sequence = i;
+    }
+    wc->async_pending = 0;
 }
 
+/*
+ * Can be called concurrently by any number of threads.
+ * It only blocks when the queue is full.
+ */
 void rrdeng_enq_cmd(struct rrdengine_worker_config* wc, struct rrdeng_cmd *cmd)
 {
-    unsigned queue_size;
-
-    /* wait for free space in queue */
-    uv_mutex_lock(&wc->cmd_mutex);
-    while ((queue_size = wc->queue_size) == RRDENG_CMD_Q_MAX_SIZE) {
-        uv_cond_wait(&wc->cmd_cond, &wc->cmd_mutex);
+    struct rrdeng_cmdqueue *queue = &wc->cmd_queue;
+    struct rrdeng_cmdqueue_slot *slot;
+    unsigned long pos, sequence;
+    uint8_t stalled = 0;
+
+    pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    while (1) {
+        slot = &queue->cmd_array[pos & (RRDENG_CMD_Q_MAX_SIZE - 1)];
+        sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == pos) {
+            /* the slot is free, try to claim it */
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+            /* another producer claimed it, pos has been updated to the current tail */
+            continue;
+        }
+        if ((long)(sequence - pos) < 0) {
+            /* wait for free space in queue */
+            if (!stalled) {
+                stalled = 1;
+                rrd_stat_atomic_add(&wc->ctx->stats.cmd_queue_producer_stalls, 1);
+            }
+            sleep_usec(RRDENG_CMD_Q_STALL_USEC);
+        }
+        pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
     }
-    assert(queue_size < RRDENG_CMD_Q_MAX_SIZE);
     /* enqueue command */
-    wc->cmd_queue.cmd_array[wc->cmd_queue.tail] = *cmd;
-    wc->cmd_queue.tail = wc->cmd_queue.tail != RRDENG_CMD_Q_MAX_SIZE - 1 ?
-                         wc->cmd_queue.tail + 1 : 0;
-    wc->queue_size = queue_size + 1;
-    uv_mutex_unlock(&wc->cmd_mutex);
+    slot->cmd = *cmd;
+    slot->cmd.enqueued_ut = now_monotonic_usec();
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_SEQ_CST);
 
-    /* wake up event loop */
-    assert(0 == uv_async_send(&wc->async));
+    /* wake up event loop, only the first command of every batch needs to */
+    if (0 == __atomic_exchange_n(&wc->async_pending, 1, __ATOMIC_SEQ_CST))
+        assert(0 == uv_async_send(&wc->async));
 }
 
+/* Must only be called by the event loop */
 struct rrdeng_cmd rrdeng_deq_cmd(struct rrdengine_worker_config* wc)
 {
+    struct rrdeng_cmdqueue *queue = &wc->cmd_queue;
+    struct rrdeng_cmdqueue_slot *slot;
     struct rrdeng_cmd ret;
-    unsigned queue_size;
+    unsigned long pos;
 
-    uv_mutex_lock(&wc->cmd_mutex);
-    queue_size = wc->queue_size;
-    if (queue_size == 0) {
+    pos = queue->head;
+    slot = &queue->cmd_array[pos & (RRDENG_CMD_Q_MAX_SIZE - 1)];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_SEQ_CST) != pos + 1) {
+        /* the queue is empty or the producer of the next command has not stored it yet */
         ret.opcode = RRDENG_NOOP;
-    } else {
-        /* dequeue command */
-        ret = wc->cmd_queue.cmd_array[wc->cmd_queue.head];
-        if (queue_size == 1) {
-            wc->cmd_queue.head = wc->cmd_queue.tail = 0;
-        } else {
-            wc->cmd_queue.head = wc->cmd_queue.head != RRDENG_CMD_Q_MAX_SIZE - 1 ?
-                                 wc->cmd_queue.head + 1 : 0;
-        }
-        wc->queue_size = queue_size - 1;
-
-        /* wake up producers */
-        uv_cond_signal(&wc->cmd_cond);
+        return ret;
     }
-    uv_mutex_unlock(&wc->cmd_mutex);
+    /* dequeue command */
+    ret = slot->cmd;
+    rrdeng_latency_record(RRDENG_LATENCY_CMD_QUEUE, now_monotonic_usec() - ret.enqueued_ut);
+    /* hand the slot back to producers for the next lap of the ring */
+    __atomic_store_n(&slot->sequence, pos + RRDENG_CMD_Q_MAX_SIZE, __ATOMIC_RELEASE);
+    __atomic_store_n(&queue->head, pos + 1, __ATOMIC_RELAXED);
 
     return ret;
 }
 
+unsigned long rrdeng_cmd_queue_depth(struct rrdengine_worker_config* wc)
+{
+    unsigned long head, tail;
+
+    head = __atomic_load_n(&wc->cmd_queue.head, __ATOMIC_RELAXED);
+    tail = __atomic_load_n(&wc->cmd_queue.tail, __ATOMIC_RELAXED);
+    return (long)(tail - head) > 0 ? tail - head : 0;
+}
+
 void async_cb(uv_async_t *handle)
 {
     uv_stop(handle->loop);
@@ -640,15 +1376,23 @@ void timer_cb(uv_timer_t* handle)
     rrdeng_test_quota(wc);
     debug(D_RRDENGINE, "%s: timeout reached.", __func__);
     if (likely(!wc->now_deleting.data)) {
-        unsigned total_bytes, bytes_written;
+        struct page_cache *pg_cache = &wc->ctx->pg_cache;
 
-        /* There is free space so we can write to disk */
-        debug(D_RRDENGINE, "Flushing pages to disk.");
-        for (total_bytes = bytes_written = do_flush_pages(wc, 0, NULL) ;
-             bytes_written && (total_bytes < DATAFILE_IDEAL_IO_SIZE) ;
-             total_bytes += bytes_written) {
-            bytes_written = do_flush_pages(wc, 0, NULL);
+        if (wc->deleted_metrics) {
+            do_delete_metric_pages(wc);
+        }
+        if (NULL == wc->deleted_metrics) {
+            rewrite_stale_journal_indices(wc);
+        }
+        /* compaction has low priority, it waits while the flushing does not keep up with the collected pages */
+        if (pg_cache->commited_page_index.nr_commited_pages < DATAFILE_IDEAL_IO_SIZE / RRDENG_BLOCK_SIZE) {
+            if (wc->compacting)
+                do_compact_datafile(wc);
+            else
+                pick_datafile_to_compact(wc);
         }
+
+        rrdeng_uring_submit(wc);
     }
 #ifdef NETDATA_INTERNAL_CHECKS
     {
@@ -658,7 +1402,60 @@ void timer_cb(uv_timer_t* handle)
 #endif
 }
 
-/* Flushes dirty pages when timer expires */
+/*
+ * Flushes the dirty pages at the smoothed rate they are committed at, instead of all of them once per second, so
+ * that collectors do not find the page cache full of dirty pages between the bursts. The dirty pages waiting are
+ * drained within RRDENG_WRITEBACK_HORIZON ticks, the ones above the dirty page target of the page cache within
+ * RRDENG_WRITEBACK_CATCHUP ticks. Extents with fewer than MAX_PAGES_PER_EXTENT pages are only written once the
+ * credit covers all the pages waiting, so that slow collection still makes large extents.
+ */
+static void do_writeback(struct rrdengine_worker_config* wc)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct rrdeng_writeback *wb = &wc->writeback;
+    Word_t corr_id;
+    unsigned waiting, pending, flushed;
+
+    uv_rwlock_rdlock(&pg_cache->commited_page_index.lock);
+    corr_id = pg_cache->commited_page_index.latest_corr_id;
+    waiting = pg_cache->commited_page_index.nr_commited_pages;
+    uv_rwlock_rdunlock(&pg_cache->commited_page_index.lock);
+
+    /* every new page gets a correlation ID */
+    wb->commit_rate += ((double)(corr_id - wb->last_corr_id) - wb->commit_rate) / RRDENG_WRITEBACK_HORIZON;
+    wb->last_corr_id = corr_id;
+
+    waiting -= MIN(waiting, wb->pending_pages);
+    wb->credit += wb->commit_rate + (double)waiting / RRDENG_WRITEBACK_HORIZON;
+    if (waiting > ctx->dirty_pages_target)
+        wb->credit += (double)(waiting - ctx->dirty_pages_target) / RRDENG_WRITEBACK_CATCHUP;
+    /* credit is not saved up for pages that have not been committed yet */
+    wb->credit = MIN(wb->credit, (double)waiting);
+
+    while (waiting && wb->credit >= MIN(waiting, MAX_PAGES_PER_EXTENT)) {
+        pending = wb->pending_pages;
+        if (!do_flush_pages(wc, 0, MIN((unsigned)wb->credit, MAX_PAGES_PER_EXTENT), NULL))
+            break;
+        flushed = wb->pending_pages - pending;
+        ctx->stats.writeback_pages += flushed;
+        wb->credit -= flushed;
+        waiting -= MIN(waiting, flushed);
+    }
+}
+
+void writeback_timer_cb(uv_timer_t* handle)
+{
+    struct rrdengine_worker_config* wc = handle->data;
+
+    uv_update_time(handle->loop);
+    if (likely(!wc->now_deleting.data)) {
+        do_writeback(wc);
+        rrdeng_uring_submit(wc);
+    }
+}
+
+/* Runs the maintenance of the datafiles when timer expires */
 #define TIMER_PERIOD_MS (1000)
 
 #define CMD_BATCH_SIZE (256)
@@ -670,10 +1467,11 @@ void rrdeng_worker(void* arg)
     uv_loop_t* loop;
     int shutdown, ret;
     enum rrdeng_opcode opcode;
-    uv_timer_t timer_req;
+    uv_timer_t timer_req, writeback_timer_req;
     struct rrdeng_cmd cmd;
 
     rrdeng_init_cmd_queue(wc);
+    memset(&wc->extent_cache, 0, sizeof(wc->extent_cache));
 
     loop = wc->loop = mallocz(sizeof(uv_loop_t));
     ret = uv_loop_init(loop);
@@ -691,8 +1489,11 @@ void rrdeng_worker(void* arg)
     wc->async.data = wc;
 
     wc->now_deleting.data = NULL;
+    wc->deleted_metrics = NULL;
+    wc->compacting = NULL;
+    wc->compaction_cursor = NULL;
 
-    /* dirty page flushing timer */
+    /* datafile maintenance timer */
     ret = uv_timer_init(loop, &timer_req);
     if (ret) {
         error("uv_timer_init(): %s", uv_strerror(ret));
@@ -700,14 +1501,29 @@ void rrdeng_worker(void* arg)
     }
     timer_req.data = wc;
 
+    /* dirty page flushing timer */
+    ret = uv_timer_init(loop, &writeback_timer_req);
+    if (ret) {
+        error("uv_timer_init(): %s", uv_strerror(ret));
+        goto error_after_writeback_timer_init;
+    }
+    writeback_timer_req.data = wc;
+    memset(&wc->writeback, 0, sizeof(wc->writeback));
+
+    rrdeng_uring_init(wc);
+
     wc->error = 0;
     /* wake up initialization thread */
     complete(&ctx->rrdengine_completion);
 
     assert(0 == uv_timer_start(&timer_req, timer_cb, TIMER_PERIOD_MS, TIMER_PERIOD_MS));
+    assert(0 == uv_timer_start(&writeback_timer_req, writeback_timer_cb, RRDENG_WRITEBACK_PERIOD_MS,
+                               RRDENG_WRITEBACK_PERIOD_MS));
     shutdown = 0;
     while (shutdown == 0 || uv_loop_alive(loop)) {
         uv_run(loop, UV_RUN_DEFAULT);
+        /* commands enqueued from now on must wake up the event loop again */
+        __atomic_store_n(&wc->async_pending, 0, __ATOMIC_SEQ_CST);
         /* wait for commands */
         do {
             cmd = rrdeng_deq_cmd(wc);
@@ -727,12 +1543,15 @@ void rrdeng_worker(void* arg)
                 uv_close((uv_handle_t *)&wc->async, NULL);
                 assert(0 == uv_timer_stop(&timer_req));
                 uv_close((uv_handle_t *)&timer_req, NULL);
+                assert(0 == uv_timer_stop(&writeback_timer_req));
+                uv_close((uv_handle_t *)&writeback_timer_req, NULL);
                 break;
             case RRDENG_READ_PAGE:
-                do_read_extent(wc, &cmd.read_page.page_cache_descr, 1, 0);
+                do_read_extent(wc, &cmd.read_page.page_cache_descr, 1, 0, cmd.read_page.node);
                 break;
             case RRDENG_READ_EXTENT:
-                do_read_extent(wc, cmd.read_extent.page_cache_descr, cmd.read_extent.page_count, 1);
+                do_read_extent(wc, cmd.read_extent.page_cache_descr, cmd.read_extent.page_count, 1,
+                               cmd.read_extent.node);
                 break;
             case RRDENG_COMMIT_PAGE:
                 do_commit_transaction(wc, STORE_DATA, NULL);
@@ -741,40 +1560,59 @@ void rrdeng_worker(void* arg)
                 unsigned bytes_written;
 
                 /* First I/O should be enough to call completion */
-                bytes_written = do_flush_pages(wc, 1, cmd.completion);
+                bytes_written = do_flush_pages(wc, 1, MAX_PAGES_PER_EXTENT, cmd.completion);
                 if (bytes_written) {
-                    while (do_flush_pages(wc, 1, NULL)) {
+                    while (do_flush_pages(wc, 1, MAX_PAGES_PER_EXTENT, NULL)) {
                         ; /* Force flushing of all commited pages. */
                     }
                 }
                 break;
             }
+            case RRDENG_DELETE_METRIC: {
+                struct rrdeng_deleted_metric *metric = mallocz(sizeof(*metric));
+
+                uuid_copy(metric->id, cmd.delete_metric.id);
+                metric->before = cmd.delete_metric.before;
+                metric->next = wc->deleted_metrics;
+                wc->deleted_metrics = metric;
+                break;
+            }
             default:
                 debug(D_RRDENGINE, "%s: default.", __func__);
                 break;
             }
         } while (opcode != RRDENG_NOOP);
+        /* the I/O requests of the whole batch of commands go to the kernel at once */
+        rrdeng_uring_submit(wc);
     }
     /* cleanup operations of the event loop */
     if (unlikely(wc->now_deleting.data)) {
         info("Postponing shutting RRD engine event loop down until after datafile deletion is finished.");
     }
     info("Shutting down RRD engine event loop.");
-    while (do_flush_pages(wc, 1, NULL)) {
+    while (do_flush_pages(wc, 1, MAX_PAGES_PER_EXTENT, NULL)) {
         ; /* Force flushing of all commited pages. */
     }
+    rrdeng_uring_exit(wc);
     wal_flush_transaction_buffer(wc);
     uv_run(loop, UV_RUN_DEFAULT);
+    extent_cache_invalidate(wc, NULL);
+    while (wc->deleted_metrics) {
+        struct rrdeng_deleted_metric *metric = wc->deleted_metrics;
+
+        /* pages that have not been deleted yet are loaded again on the next start */
+        wc->deleted_metrics = metric->next;
+        freez(metric);
+    }
 
     info("Shutting down RRD engine event loop complete.");
-    /* TODO: don't let the API block by waiting to enqueue commands */
-    uv_cond_destroy(&wc->cmd_cond);
-/*  uv_mutex_destroy(&wc->cmd_mutex); */
     assert(0 == uv_loop_close(loop));
     freez(loop);
 
     return;
 
+error_after_writeback_timer_init:
+    uv_close((uv_handle_t *)&timer_req, NULL);
 error_after_timer_init:
     uv_close((uv_handle_t *)&wc->async, NULL);
 error_after_async_init:
@@ -23,6 +23,10 @@
 #include "rrdengineapi.h"
 #include "pagecache.h"
 #include "rrdenglocking.h"
+#include "iouring.h"
+#include "rrdengslab.h"
+#include "pagearena.h"
+#include "metricdir.h"
 
 #ifdef NETDATA_RRD_INTERNALS
 
@@ -31,7 +35,11 @@
 /* Forward declerations */
 struct rrdengine_instance;
 
-#define MAX_PAGES_PER_EXTENT (64) /* TODO: can go higher only when journal supports bigger than 4KiB transactions */
+#define MAX_PAGES_PER_EXTENT (256) /* 1MiB of uncompressed metric data */
+#define RRDENG_READ_EXTENT_MAX_PAGES (64) /* maximum number of pages of a single extent read command */
+
+#define RRDENG_MAX_WORKERS (64)
+#define RRDENG_WORKER_DIR_PREFIX "worker-"
 
 #define RRDENG_FILE_NUMBER_SCAN_TMPL "%1u-%10u"
 #define RRDENG_FILE_NUMBER_PRINT_TMPL "%1.1u-%10.10u"
@@ -51,6 +59,7 @@ enum rrdeng_opcode {
     RRDENG_READ_EXTENT,
     RRDENG_COMMIT_PAGE,
     RRDENG_FLUSH_PAGES,
+    RRDENG_DELETE_METRIC,
     RRDENG_SHUTDOWN,
 
     RRDENG_MAX_OPCODE
@@ -58,34 +67,62 @@ enum rrdeng_opcode {
 
 struct rrdeng_cmd {
     enum rrdeng_opcode opcode;
+    usec_t enqueued_ut; /* set by rrdeng_enq_cmd(), for the latency histogram of the command queue */
     union {
         struct rrdeng_read_page {
             struct rrdeng_page_descr *page_cache_descr;
+            uint8_t node; /* NUMA node the page is allocated from */
         } read_page;
         struct rrdeng_read_extent {
-            struct rrdeng_page_descr *page_cache_descr[MAX_PAGES_PER_EXTENT];
+            struct rrdeng_page_descr *page_cache_descr[RRDENG_READ_EXTENT_MAX_PAGES];
             int page_count;
+            uint8_t node; /* NUMA node the pages are allocated from */
         } read_extent;
+        struct rrdeng_delete_metric {
+            uuid_t id;
+            usec_t before; /* pages that end after this time are kept */
+        } delete_metric;
         struct completion *completion;
     };
 };
 
-#define RRDENG_CMD_Q_MAX_SIZE (2048)
+#define RRDENG_CMD_Q_MAX_SIZE (2048) /* must be a power of 2 */
+#define RRDENG_CMD_Q_STALL_USEC (100) /* how long producers sleep when the queue is full */
+
+struct rrdeng_deleted_metric {
+    uuid_t id;
+    usec_t before;
+    struct rrdeng_deleted_metric *next;
+};
+
+struct rrdeng_cmdqueue_slot {
+    /*
+     * Slot sequence number, it is equal to the queue position when the slot is free to be claimed
+     * by a producer and to the queue position + 1 when the command has been stored and can be consumed.
+     */
+    volatile unsigned long sequence;
+    struct rrdeng_cmd cmd;
+};
 
+/* bounded lock-free multiple-producer single-consumer FIFO */
 struct rrdeng_cmdqueue {
-    unsigned head, tail;
-    struct rrdeng_cmd cmd_array[RRDENG_CMD_Q_MAX_SIZE];
+    volatile unsigned long head; /* only the event loop moves the head */
+    volatile unsigned long tail; /* producers claim slots by moving the tail */
+    struct rrdeng_cmdqueue_slot cmd_array[RRDENG_CMD_Q_MAX_SIZE];
 };
 
 struct extent_io_descriptor {
     uv_fs_t req;
+    struct rrdeng_uring_req uring_req;
     uv_buf_t iov;
     void *buf;
     uint64_t pos;
     unsigned bytes;
     struct completion *completion;
+    usec_t started_ut; /* when the flushing of the extent started, for the latency histogram of flushing */
     unsigned descr_count;
     int release_descr;
+    uint8_t node; /* NUMA node the pages being read are allocated from */
     struct rrdeng_page_descr *descr_array[MAX_PAGES_PER_EXTENT];
     Word_t descr_commit_idx_array[MAX_PAGES_PER_EXTENT];
 };
@@ -99,6 +136,38 @@ struct generic_io_descriptor {
     struct completion *completion;
 };
 
+#define RRDENG_EXTENT_CACHE_SIZE (8)
+
+/* keeps the raw on-disk contents of recently read extents so that their pages can be decoded on demand */
+struct extent_cache_entry {
+    struct rrdengine_datafile *datafile; /* NULL when the entry is free */
+    uint64_t pos;
+    unsigned bytes;
+    void *buf;
+    unsigned long last_used;
+};
+
+/* Only accessed by the event loop */
+struct extent_cache {
+    struct extent_cache_entry entries[RRDENG_EXTENT_CACHE_SIZE];
+    unsigned long clock;
+};
+
+/* write-back interval of dirty pages, the flushing is paced over these ticks instead of bursting once per second */
+#define RRDENG_WRITEBACK_PERIOD_MS (100)
+/* the dirty pages are flushed within this many ticks, which is about as long as they waited before */
+#define RRDENG_WRITEBACK_HORIZON (10)
+/* the dirty pages above the target of the page cache are flushed within this many ticks */
+#define RRDENG_WRITEBACK_CATCHUP (2)
+
+/* paces the flushing of dirty pages to follow the rate they are committed at */
+struct rrdeng_writeback {
+    Word_t last_corr_id; /* newest page correlation ID at the previous tick */
+    double commit_rate; /* smoothed pages committed per tick */
+    double credit; /* pages that may be flushed, fractions of pages carry over to the next tick */
+    unsigned pending_pages; /* pages of the extents being written */
+};
+
 struct rrdengine_worker_config {
     struct rrdengine_instance *ctx;
 
@@ -107,12 +176,23 @@ struct rrdengine_worker_config {
     uv_async_t async;
     uv_work_t now_deleting;
 
+    /* metrics whose pages are being deleted, pages that are in use are retried on every timer tick */
+    struct rrdeng_deleted_metric *deleted_metrics;
+
+    /* the data file whose live pages are being rewritten to the newest data file, NULL when not compacting */
+    struct rrdengine_datafile *compacting;
+    struct extent_info *compaction_cursor; /* next extent of the data file to be rewritten */
+    Word_t compaction_corr_id; /* the data file can go when no dirty page up to this correlation ID is left */
+    uint8_t compaction_done; /* the rewritten pages are on disk, the data file is deleted on the next timer tick */
+
     /* FIFO command queue */
-    uv_mutex_t cmd_mutex;
-    uv_cond_t cmd_cond;
-    volatile unsigned queue_size;
+    volatile unsigned long async_pending; /* the event loop has been woken up and has not drained the queue yet */
     struct rrdeng_cmdqueue cmd_queue;
 
+    struct extent_cache extent_cache;
+    struct rrdeng_writeback writeback; /* only accessed by the event loop */
+    struct rrdeng_uring *uring; /* NULL when extent I/O goes through the libuv threadpool */
+
     int error;
 };
 
@@ -148,8 +228,34 @@ struct rrdengine_statistics {
     rrdeng_stats_t page_cache_descriptors;
     rrdeng_stats_t io_errors;
     rrdeng_stats_t fs_errors;
+    rrdeng_stats_t cmd_queue_producer_stalls;
+    rrdeng_stats_t extent_cache_hits;
+    rrdeng_stats_t xor_compressed_extents;
+    rrdeng_stats_t io_uring_submissions;
+    rrdeng_stats_t compacted_pages;
+    rrdeng_stats_t datafile_compactions;
+    rrdeng_stats_t writeback_pages;
+    rrdeng_stats_t writeback_forced_flushes;
+};
+
+/* the latencies dbengine keeps log-bucket histograms of, for all its instances */
+enum rrdeng_latency {
+    RRDENG_LATENCY_PAGE_MISS = 0, /* a query waiting for a page to be read from disk */
+    RRDENG_LATENCY_PAGE_WAIT,     /* a thread waiting in pg_cache_wait_event() */
+    RRDENG_LATENCY_CMD_QUEUE,     /* a command waiting in the queue of the event loop */
+    RRDENG_LATENCY_FLUSH,         /* an extent of dirty pages, from its compression to the completion of its write */
+
+    RRDENG_LATENCIES
 };
 
+/* bucket i counts the latencies up to 10^(i+1) microseconds, the last one all the longer ones */
+#define RRDENG_LATENCY_BUCKETS (8)
+
+extern const char *rrdeng_latency_names[RRDENG_LATENCIES];
+extern const char *rrdeng_latency_bucket_names[RRDENG_LATENCY_BUCKETS];
+extern void rrdeng_latency_record(enum rrdeng_latency latency, usec_t dt);
+extern void rrdeng_get_latency_histograms(unsigned long long array[RRDENG_LATENCIES][RRDENG_LATENCY_BUCKETS]);
+
 /* I/O errors global counter */
 extern rrdeng_stats_t global_io_errors;
 /* File-System errors global counter */
@@ -161,7 +267,7 @@ struct rrdengine_instance {
     struct rrdengine_worker_config worker_config;
     struct completion rrdengine_completion;
     struct page_cache pg_cache;
-    uint8_t global_compress_alg;
+    uint8_t global_compress_alg; /* RRD_NO_COMPRESSION disables compression, otherwise the best codec per extent */
     struct transaction_commit_log commit_log;
     struct rrdengine_datafile_list datafiles;
     char dbfiles_path[FILENAME_MAX+1];
@@ -170,6 +276,37 @@ struct rrdengine_instance {
     unsigned last_fileno; /* newest index of datafile and journalfile */
     unsigned long max_cache_pages;
     unsigned long cache_pages_low_watermark;
+    unsigned long dirty_pages_target; /* the write-back keeps fewer dirty pages than this in the page cache */
+    /* the pages of the page cache allocated from the arena of every NUMA node and their share of max_cache_pages */
+    unsigned long node_pages[RRDENG_MAX_NUMA_NODES];
+    unsigned long node_max_pages[RRDENG_MAX_NUMA_NODES];
+
+    /*
+     * Worker shards of this instance. Metrics are distributed to shards by UUID and every shard has its own
+     * event loop, page cache and datafile/journalfile pairs. The first shard is always the instance itself.
+     */
+    unsigned nr_shards;
+    struct rrdengine_instance *shards[RRDENG_MAX_WORKERS];
+
+    unsigned tier; /* datafile tier of this instance */
+    /*
+     * Storage tiers of this instance, the first tier is always the instance itself. Every higher tier is an
+     * independent single shard instance that stores coarser rollups of the metrics under its own quota.
+     */
+    unsigned nr_tiers;
+    struct rrdengine_instance *tiers[RRDENG_MAX_TIERS];
+
+    /*
+     * Retention classes of this instance, the first class is always the instance itself. Every other class is an
+     * independent single shard instance with its own quota, that stores the metrics of the charts assigned to it.
+     */
+    unsigned nr_classes;
+    struct rrdengine_instance *classes[RRDENG_MAX_RETENTION_CLASSES];
+
+    unsigned multihost; /* the instance is shared by many hosts, the UUIDs of metrics include their machine GUID */
+
+    /* the metrics of the instance and of its shards, tiers and classes, NULL in these */
+    struct metricdir *metricdir;
 
     struct rrdengine_statistics stats;
 };
@@ -181,5 +318,6 @@ extern void rrdeng_test_quota(struct rrdengine_worker_config* wc);
 extern void rrdeng_worker(void* arg);
 extern void rrdeng_enq_cmd(struct rrdengine_worker_config* wc, struct rrdeng_cmd *cmd);
 extern struct rrdeng_cmd rrdeng_deq_cmd(struct rrdengine_worker_config* wc);
+extern unsigned long rrdeng_cmd_queue_depth(struct rrdengine_worker_config* wc);
 
 #endif /* NETDATA_RRDENGINE_H */
\ No newline at end of file
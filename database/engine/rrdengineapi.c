@@ -6,45 +6,98 @@ static struct rrdengine_instance default_global_ctx;
 
 int default_rrdeng_page_cache_mb = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
 int default_rrdeng_disk_quota_mb = RRDENG_MIN_DISK_SPACE_MB;
+int default_rrdeng_workers = 1;
+int default_rrdeng_storage_tiers = 1;
+int default_rrdeng_io_uring = 1;
+int default_rrdeng_retention_classes = 1;
+int default_rrdeng_retention_class = 1;
+int default_rrdeng_compaction_threshold = 50;
+int default_rrdeng_dirty_page_ratio = 10;
+/* the percentage of every page cache that is allocated from every NUMA node, when the page cache uses NUMA arenas */
+int default_rrdeng_page_cache_node_share[RRDENG_MAX_NUMA_NODES] = { 0 };
+/* new data and journal files are checksummed with CRC32C, or with CRC32 in the format of version 3 */
+int default_rrdeng_checksum_crc32c = 1;
+/* the hosts streamed to this one share a single instance, with its own page cache and disk space quota */
+int default_rrdeng_multihost = 0;
+int default_rrdeng_multihost_page_cache_mb = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
+int default_rrdeng_multihost_disk_quota_mb = RRDENG_MIN_DISK_SPACE_MB;
+/* the disk space quota of every retention class, the first class uses the quota given to rrdeng_init() */
+int default_rrdeng_class_disk_quota_mb[RRDENG_MAX_RETENTION_CLASSES] = {
+    RRDENG_MIN_DISK_SPACE_MB, RRDENG_MIN_DISK_SPACE_MB, RRDENG_MIN_DISK_SPACE_MB, RRDENG_MIN_DISK_SPACE_MB
+};
+
+/* the interval of the points of every storage tier, tier 1 follows the update frequency of the charts */
+static const time_t rrdeng_tier_interval[RRDENG_MAX_TIERS] = { 0, 60, 3600 };
 
 /*
- * Gets a handle for storing metrics to the database.
- * The handle must be released with rrdeng_store_metric_final().
+ * Percentage of the disk space of an instance that every storage tier gets, by number of tiers. Every tier gets the
+ * whole page cache instead, since it keeps the pages of all metrics being collected in memory like the first tier.
  */
-void rrdeng_store_metric_init(RRDDIM *rd)
+static const unsigned rrdeng_tier_share[RRDENG_MAX_TIERS][RRDENG_MAX_TIERS] = {
+    { 100,  0,  0 },
+    {  80, 20,  0 },
+    {  70, 20, 10 },
+};
+
+/* Returns the worker shard of the instance that owns the metric UUID */
+static inline struct rrdengine_instance *rrdeng_shard_ctx(struct rrdengine_instance *ctx, uuid_t *id)
 {
-    struct rrdeng_collect_handle *handle;
-    struct page_cache *pg_cache;
-    struct rrdengine_instance *ctx;
-    uuid_t temp_id;
-    Pvoid_t *PValue;
-    struct pg_cache_page_index *page_index;
-    EVP_MD_CTX *evpctx;
-    unsigned char hash_value[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
+    uint32_t hash;
 
-    //&default_global_ctx; TODO: test this use case or remove it?
+    if (likely(ctx->nr_shards <= 1))
+        return ctx;
+    /* metric UUIDs are SHA-256 digests so any 4 bytes of them are uniformly distributed */
+    memcpy(&hash, id, sizeof(hash));
+    return ctx->shards[hash % ctx->nr_shards];
+}
 
-    ctx = rd->rrdset->rrdhost->rrdeng_ctx;
-    pg_cache = &ctx->pg_cache;
-    handle = &rd->state->handle.rrdeng;
-    handle->ctx = ctx;
+/* Returns the instance that stores the metric UUID of rd at full resolution */
+static inline struct rrdengine_instance *rrdeng_metric_ctx(RRDDIM *rd, uuid_t *id)
+{
+    struct rrdengine_instance *ctx = rd->rrdset->rrdhost->rrdeng_ctx;
+    unsigned retention_class = rd->rrdset->rrdeng_retention_class;
 
-    evpctx = EVP_MD_CTX_create();
-    EVP_DigestInit_ex(evpctx, EVP_sha256(), NULL);
-    EVP_DigestUpdate(evpctx, rd->id, strlen(rd->id));
-    EVP_DigestUpdate(evpctx, rd->rrdset->id, strlen(rd->rrdset->id));
-    EVP_DigestFinal_ex(evpctx, hash_value, &hash_len);
-    EVP_MD_CTX_destroy(evpctx);
-    assert(hash_len > sizeof(temp_id));
-    memcpy(&temp_id, hash_value, sizeof(temp_id));
+    /* charts of classes the instance has not been started with stay in the first class */
+    if (unlikely(retention_class > 1 && retention_class <= ctx->nr_classes))
+        return ctx->classes[retention_class - 1];
+    return rrdeng_shard_ctx(ctx, id);
+}
 
-    handle->descr = NULL;
-    handle->prev_descr = NULL;
-    handle->unaligned_page = 0;
+/* Returns the i-th of the worker shards, storage tiers and retention classes of the instance or NULL */
+static struct rrdengine_instance *rrdeng_get_instance(struct rrdengine_instance *ctx, unsigned i)
+{
+    if (i < ctx->nr_shards)
+        return ctx->shards[i];
+    i -= ctx->nr_shards;
+    if (i < ctx->nr_tiers - 1)
+        return ctx->tiers[i + 1];
+    i -= ctx->nr_tiers - 1;
+    if (i < ctx->nr_classes - 1)
+        return ctx->classes[i + 1];
+    return NULL;
+}
+
+/*
+ * Returns the page index of the metric UUID, it is created when the instance does not know the metric yet.
+ * metric_id is the id of the metric in the metric directory, the page index is looked up by it when it is not 0.
+ */
+static struct pg_cache_page_index *rrdeng_get_page_index(struct rrdengine_instance *ctx, uuid_t *id,
+                                                         Word_t metric_id)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    Pvoid_t *PValue;
+    struct pg_cache_page_index *page_index = NULL;
 
     uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
-    PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, &temp_id, sizeof(uuid_t));
+    if (metric_id) {
+        PValue = JudyLGet(pg_cache->metrics_index.JudyL_array, metric_id, PJE0);
+        if (likely(NULL != PValue)) {
+            page_index = *PValue;
+            uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
+            return page_index;
+        }
+    }
+    PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, id, sizeof(uuid_t));
     if (likely(NULL != PValue)) {
         page_index = *PValue;
     }
@@ -52,15 +105,144 @@ void rrdeng_store_metric_init(RRDDIM *rd)
     if (NULL == PValue) {
         /* First time we see the UUID */
         uv_rwlock_wrlock(&pg_cache->metrics_index.lock);
-        PValue = JudyHSIns(&pg_cache->metrics_index.JudyHS_array, &temp_id, sizeof(uuid_t), PJE0);
+        PValue = JudyHSIns(&pg_cache->metrics_index.JudyHS_array, id, sizeof(uuid_t), PJE0);
         assert(NULL == *PValue); /* TODO: figure out concurrency model */
-        *PValue = page_index = create_page_index(&temp_id);
+        *PValue = page_index = create_page_index(id);
         page_index->prev = pg_cache->metrics_index.last_page_index;
         pg_cache->metrics_index.last_page_index = page_index;
         uv_rwlock_wrunlock(&pg_cache->metrics_index.lock);
     }
-    rd->state->rrdeng_uuid = &page_index->id;
-    handle->page_index = page_index;
+    if (metric_id) {
+        uv_rwlock_wrlock(&pg_cache->metrics_index.lock);
+        PValue = JudyLIns(&pg_cache->metrics_index.JudyL_array, metric_id, PJE0);
+        *PValue = page_index;
+        uv_rwlock_wrunlock(&pg_cache->metrics_index.lock);
+    }
+    return page_index;
+}
+
+static void rrdeng_store_handle_init(struct rrdeng_collect_handle *handle, struct rrdengine_instance *ctx, uuid_t *id,
+                                     Word_t metric_id)
+{
+    handle->ctx = ctx;
+    handle->descr = NULL;
+    handle->prev_descr = NULL;
+    handle->unaligned_page = 0;
+    handle->rollup = NULL;
+    handle->page_index = rrdeng_get_page_index(ctx, id, metric_id);
+}
+
+/* Sets up the rollups of the higher storage tiers whose interval is a multiple of the update frequency of rd */
+static void rrdeng_rollup_init(RRDDIM *rd, struct rrdeng_collect_handle *handle, Word_t metric_id)
+{
+    struct rrdengine_instance *ctx = rd->rrdset->rrdhost->rrdeng_ctx;
+    struct rrdeng_rollup_handle *rollup = NULL;
+    struct rrdeng_rollup_tier *rollup_tier;
+    time_t interval, update_every = rd->rrdset->update_every;
+    unsigned i;
+
+    for (i = 1 ; i < ctx->nr_tiers ; ++i) {
+        interval = rrdeng_tier_interval[i];
+        if (interval <= update_every || interval % update_every)
+            continue;
+        if (NULL == rollup)
+            rollup = callocz(1, sizeof(*rollup));
+        rollup_tier = &rollup->tiers[rollup->nr_tiers++];
+        rollup_tier->tier = ctx->tiers[i]->tier;
+        rollup_tier->interval = interval;
+        /* the rollups of a metric use the UUID of the metric in the instance of the tier */
+        rrdeng_store_handle_init(&rollup_tier->handle, ctx->tiers[i], &handle->page_index->id, metric_id);
+    }
+    handle->rollup = rollup;
+}
+
+/*
+ * Deletes the pages of the metric in all storage tiers, the space they take on disk is reclaimed by compaction.
+ * Pages that are being collected when this is called are deleted once they have been written to disk.
+ */
+void rrdeng_delete_metric(RRDDIM *rd)
+{
+    struct rrdengine_instance *ctx = rd->rrdset->rrdhost->rrdeng_ctx;
+    struct rrdeng_cmd cmd;
+    unsigned i;
+
+    if (unlikely(NULL == ctx)) {
+        /* the instance has been stopped, the files of the host are deleted as a whole */
+        return;
+    }
+    cmd.opcode = RRDENG_DELETE_METRIC;
+    uuid_copy(cmd.delete_metric.id, *rd->state->rrdeng_uuid);
+    cmd.delete_metric.before = now_realtime_usec();
+    rrdeng_enq_cmd(&rrdeng_metric_ctx(rd, rd->state->rrdeng_uuid)->worker_config, &cmd);
+    for (i = 1 ; i < ctx->nr_tiers ; ++i)
+        rrdeng_enq_cmd(&ctx->tiers[i]->worker_config, &cmd);
+}
+
+/*
+ * Gets a handle for storing metrics to the database.
+ * The handle must be released with rrdeng_store_metric_final().
+ */
+void rrdeng_store_metric_init(RRDDIM *rd)
+{
+    struct rrdeng_collect_handle *handle;
+    struct rrdengine_instance *ctx, *host_ctx = rd->rrdset->rrdhost->rrdeng_ctx;
+    struct metricdir_entry *entry;
+    uuid_t temp_id;
+    Word_t metric_id = 0;
+
+    //&default_global_ctx; TODO: test this use case or remove it?
+
+    /* the UUID is derived from the ids of the metric the first time it is seen */
+    entry = metricdir_get(host_ctx, rd);
+    if (likely(NULL != entry)) {
+        uuid_copy(temp_id, entry->id);
+        metric_id = entry->metric_id;
+    } else {
+        rrdeng_generate_legacy_uuid(rd->id, rd->rrdset->id,
+                                    host_ctx->multihost ? rd->rrdset->rrdhost->machine_guid : NULL, &temp_id);
+    }
+
+    ctx = rrdeng_metric_ctx(rd, &temp_id);
+    handle = &rd->state->handle.rrdeng;
+    rrdeng_store_handle_init(handle, ctx, &temp_id, metric_id);
+    rd->state->rrdeng_uuid = &handle->page_index->id;
+    rrdeng_rollup_init(rd, handle, metric_id);
+}
+
+/* Also gets a reference for the page, page_size must not exceed RRDENG_BLOCK_SIZE */
+static void *rrdeng_create_page_of_size(struct rrdengine_instance *ctx, uuid_t *id, uint32_t page_size,
+                                        struct rrdeng_page_descr **ret_descr)
+{
+    struct rrdeng_page_descr *descr;
+    struct page_cache_descr *pg_cache_descr;
+    void *page;
+    uint8_t node;
+    /* TODO: check maximum number of pages in page cache limit */
+
+    descr = pg_cache_create_descr();
+    descr->id = id; /* TODO: add page type: metric, log, something? */
+    /* the smaller pages of the higher storage tiers come from the heap */
+    node = (RRDENG_BLOCK_SIZE == page_size) ? page_arena_pick_node(ctx) : RRDENG_NUMA_NODE_NONE;
+    page = page_arena_alloc(ctx, node, page_size);
+    rrdeng_page_descr_mutex_lock(ctx, descr);
+    pg_cache_descr = descr->pg_cache_descr;
+    pg_cache_descr->page = page;
+    pg_cache_descr->node = node;
+    pg_cache_descr->flags = RRD_PAGE_DIRTY /*| RRD_PAGE_LOCKED */ | RRD_PAGE_POPULATED /* | BEING_COLLECTED */;
+    pg_cache_descr->refcnt = 1;
+
+    debug(D_RRDENGINE, "Created new page:");
+    if (unlikely(debug_flags & D_RRDENGINE))
+        print_page_cache_descr(descr);
+    rrdeng_page_descr_mutex_unlock(ctx, descr);
+    *ret_descr = descr;
+    return page;
+}
+
+/* Also gets a reference for the page */
+void *rrdeng_create_page(struct rrdengine_instance *ctx, uuid_t *id, struct rrdeng_page_descr **ret_descr)
+{
+    return rrdeng_create_page_of_size(ctx, id, RRDENG_BLOCK_SIZE, ret_descr);
 }
 
 /* The page must be populated and referenced */
@@ -80,13 +262,52 @@ static int page_has_only_empty_metrics(struct rrdeng_page_descr *descr)
     return has_only_empty_metrics;
 }
 
-void rrdeng_store_metric_flush_current_page(RRDDIM *rd)
+#define PAGE_SUMMARIZE_BATCH (256) /* the values of a page are unpacked in batches of this many */
+
+/* The page must be populated and referenced, it must not change any more */
+static void page_summarize(struct rrdeng_page_descr *descr)
+{
+    struct rrdeng_page_summary *summary = &descr->summary;
+    unsigned i, j, batch, nr_values;
+    uint8_t flags = PAGE_SUMMARY_VALID;
+    storage_number *page;
+    double values[PAGE_SUMMARIZE_BATCH];
+    calculated_number value, min = 0, max = 0;
+
+    page = descr->pg_cache_descr->page;
+    nr_values = descr->page_length / sizeof(storage_number);
+    summary->sum = 0;
+    summary->count = 0;
+    summary->min = summary->max = SN_EMPTY_SLOT;
+    for (i = 0 ; i < nr_values ; i += batch) {
+        batch = MIN(nr_values - i, PAGE_SUMMARIZE_BATCH);
+        unpack_storage_number_array(&page[i], values, batch);
+        for (j = 0 ; j < batch ; ++j) {
+            if (!does_storage_number_exist(page[i + j]))
+                continue;
+            if (did_storage_number_reset(page[i + j]))
+                flags |= PAGE_SUMMARY_RESET;
+            value = values[j];
+            if (0 == summary->count++ || value < min) {
+                min = value;
+                summary->min = page[i + j];
+            }
+            if (1 == summary->count || value > max) {
+                max = value;
+                summary->max = page[i + j];
+            }
+            summary->sum += value;
+        }
+    }
+    /* queries only use the summary after they see the flags */
+    __atomic_store_n(&summary->flags, flags, __ATOMIC_RELEASE);
+}
+
+static void rrdeng_store_handle_flush_current_page(struct rrdeng_collect_handle *handle)
 {
-    struct rrdeng_collect_handle *handle;
     struct rrdengine_instance *ctx;
     struct rrdeng_page_descr *descr;
 
-    handle = &rd->state->handle.rrdeng;
     ctx = handle->ctx;
     descr = handle->descr;
     if (unlikely(NULL == descr)) {
@@ -117,27 +338,39 @@ void rrdeng_store_metric_flush_current_page(RRDDIM *rd)
             rrdeng_page_descr_mutex_unlock(ctx, descr);
             assert (1 == ret);
 
+            /* the pages of higher storage tiers interleave several series and are not summarized */
+            if (1 == ctx->tier)
+                page_summarize(descr);
             rrdeng_commit_page(ctx, descr, handle->page_correlation_id);
             handle->prev_descr = descr;
         }
     } else {
-        freez(descr->pg_cache_descr->page);
+        page_arena_free(ctx, descr->pg_cache_descr->page, descr->pg_cache_descr->node);
         rrdeng_destroy_pg_cache_descr(ctx, descr->pg_cache_descr);
-        freez(descr);
+        pg_cache_free_descr(descr);
     }
     handle->descr = NULL;
 }
 
-void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number number)
+void rrdeng_store_metric_flush_current_page(RRDDIM *rd)
+{
+    rrdeng_store_handle_flush_current_page(&rd->state->handle.rrdeng);
+}
+
+/*
+ * Stores a point of nr_numbers storage numbers, pages are flushed when they are page_size bytes long.
+ * page_alignment is shared by the handles whose pages are kept in alignment, e.g. the dimensions of a chart.
+ */
+static void rrdeng_store_handle_next(struct rrdeng_collect_handle *handle, size_t *page_alignment, uint32_t page_size,
+                                     usec_t point_in_time, storage_number *numbers, unsigned nr_numbers)
 {
-    struct rrdeng_collect_handle *handle;
     struct rrdengine_instance *ctx;
     struct page_cache *pg_cache;
     struct rrdeng_page_descr *descr;
     storage_number *page;
     uint8_t must_flush_unaligned_page = 0, perfect_page_alignment = 0;
+    uint32_t point_size = nr_numbers * sizeof(storage_number);
 
-    handle = &rd->state->handle.rrdeng;
     ctx = handle->ctx;
     pg_cache = &ctx->pg_cache;
     descr = handle->descr;
@@ -145,31 +378,31 @@ void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number n
     if (descr) {
         /* Make alignment decisions */
 
-        if (descr->page_length == rd->rrdset->rrddim_page_alignment) {
+        if (descr->page_length == *page_alignment) {
             /* this is the leading dimension that defines chart alignment */
             perfect_page_alignment = 1;
         }
         /* is the metric far enough out of alignment with the others? */
-        if (unlikely(descr->page_length + sizeof(number) < rd->rrdset->rrddim_page_alignment)) {
+        if (unlikely(descr->page_length + point_size < *page_alignment)) {
             handle->unaligned_page = 1;
-            debug(D_RRDENGINE, "Metric page is not aligned with chart:");
+            debug(D_RRDENGINE, "Metric page is not aligned with the pages of its chart:");
             if (unlikely(debug_flags & D_RRDENGINE))
                 print_page_cache_descr(descr);
         }
         if (unlikely(handle->unaligned_page &&
                      /* did the other metrics change page? */
-                     rd->rrdset->rrddim_page_alignment <= sizeof(number))) {
+                     *page_alignment <= point_size)) {
             debug(D_RRDENGINE, "Flushing unaligned metric page.");
             must_flush_unaligned_page = 1;
             handle->unaligned_page = 0;
         }
     }
     if (unlikely(NULL == descr ||
-                 descr->page_length + sizeof(number) > RRDENG_BLOCK_SIZE ||
+                 descr->page_length + point_size > page_size ||
                  must_flush_unaligned_page)) {
-        rrdeng_store_metric_flush_current_page(rd);
+        rrdeng_store_handle_flush_current_page(handle);
 
-        page = rrdeng_create_page(ctx, &handle->page_index->id, &descr);
+        page = rrdeng_create_page_of_size(ctx, &handle->page_index->id, page_size, &descr);
         assert(page);
 
         handle->descr = descr;
@@ -178,19 +411,19 @@ void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number n
         handle->page_correlation_id = pg_cache->commited_page_index.latest_corr_id++;
         uv_rwlock_wrunlock(&pg_cache->commited_page_index.lock);
 
-        if (0 == rd->rrdset->rrddim_page_alignment) {
+        if (0 == *page_alignment) {
             /* this is the leading dimension that defines chart alignment */
             perfect_page_alignment = 1;
         }
     }
     page = descr->pg_cache_descr->page;
-    page[descr->page_length / sizeof(number)] = number;
-    descr->end_time = point_in_time;
-    descr->page_length += sizeof(number);
+    (void) memcpy(page + descr->page_length / sizeof(storage_number), numbers, point_size);
+    pg_descr_set_end_time(descr, point_in_time);
+    descr->page_length += point_size;
     if (perfect_page_alignment)
-        rd->rrdset->rrddim_page_alignment = descr->page_length;
-    if (unlikely(INVALID_TIME == descr->start_time)) {
-        descr->start_time = point_in_time;
+        *page_alignment = descr->page_length;
+    if (unlikely(INVALID_TIME == pg_descr_start_time(descr))) {
+        pg_descr_set_start_time(descr, point_in_time);
 
 #ifdef NETDATA_INTERNAL_CHECKS
         rrd_stat_atomic_add(&ctx->stats.metric_API_producers, 1);
@@ -201,42 +434,318 @@ void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number n
     }
 }
 
+/* Stores the aggregates of the interval that just ended as a single point of RRDENG_ROLLUP_SERIES numbers */
+static void rrdeng_rollup_store(struct rrdeng_rollup_tier *rollup_tier)
+{
+    storage_number numbers[RRDENG_ROLLUP_SERIES];
+    unsigned i;
+
+    if (likely(rollup_tier->count)) {
+        numbers[RRDENG_ROLLUP_MIN] = pack_storage_number(rollup_tier->min, SN_EXISTS);
+        numbers[RRDENG_ROLLUP_MAX] = pack_storage_number(rollup_tier->max, SN_EXISTS);
+        numbers[RRDENG_ROLLUP_SUM] = pack_storage_number(rollup_tier->sum, SN_EXISTS);
+        numbers[RRDENG_ROLLUP_COUNT] = pack_storage_number((calculated_number)rollup_tier->count, SN_EXISTS);
+    } else {
+        for (i = 0 ; i < RRDENG_ROLLUP_SERIES ; ++i)
+            numbers[i] = SN_EMPTY_SLOT;
+    }
+    rrdeng_store_handle_next(&rollup_tier->handle, &rollup_tier->page_alignment, RRDENG_ROLLUP_PAGE_SIZE,
+                             rollup_tier->interval_end * USEC_PER_SEC, numbers, RRDENG_ROLLUP_SERIES);
+}
+
+static void rrdeng_rollup_next(struct rrdeng_rollup_handle *rollup, usec_t point_in_time, storage_number number)
+{
+    struct rrdeng_rollup_tier *rollup_tier;
+    calculated_number value;
+    time_t now, interval_end;
+    unsigned i;
+
+    now = (time_t)(point_in_time / USEC_PER_SEC);
+    for (i = 0 ; i < rollup->nr_tiers ; ++i) {
+        rollup_tier = &rollup->tiers[i];
+        interval_end = now + (rollup_tier->interval - now % rollup_tier->interval) % rollup_tier->interval;
+        if (unlikely(interval_end != rollup_tier->interval_end)) {
+            if (likely(rollup_tier->interval_end)) {
+                /* when time goes backwards the aggregates of the current interval are dropped */
+                if (likely(interval_end > rollup_tier->interval_end))
+                    rrdeng_rollup_store(rollup_tier);
+                if (unlikely(interval_end != rollup_tier->interval_end + rollup_tier->interval)) {
+                    /* pages must contain consecutive intervals, start new ones after gaps */
+                    rrdeng_store_handle_flush_current_page(&rollup_tier->handle);
+                    rollup_tier->page_alignment = 0;
+                }
+            }
+            rollup_tier->interval_end = interval_end;
+            rollup_tier->count = 0;
+        }
+        if (unlikely(!does_storage_number_exist(number)))
+            continue;
+        value = unpack_storage_number(number);
+        if (0 == rollup_tier->count++) {
+            rollup_tier->min = rollup_tier->max = rollup_tier->sum = value;
+        } else {
+            rollup_tier->min = MIN(rollup_tier->min, value);
+            rollup_tier->max = MAX(rollup_tier->max, value);
+            rollup_tier->sum += value;
+        }
+    }
+}
+
+void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number number)
+{
+    struct rrdeng_collect_handle *handle = &rd->state->handle.rrdeng;
+
+    rrdeng_store_handle_next(handle, &rd->rrdset->rrddim_page_alignment, RRDENG_BLOCK_SIZE, point_in_time, &number, 1);
+    if (handle->rollup)
+        rrdeng_rollup_next(handle->rollup, point_in_time, number);
+}
+
+static void rrdeng_store_handle_finalize(struct rrdeng_collect_handle *handle)
+{
+    rrdeng_store_handle_flush_current_page(handle);
+    if (handle->prev_descr) {
+        /* unpin old second page */
+        pg_cache_put(handle->ctx, handle->prev_descr);
+    }
+}
+
 /*
  * Releases the database reference from the handle for storing metrics.
+ * The aggregates of the current interval of the rollup tiers are dropped since the interval is not complete.
  */
 void rrdeng_store_metric_finalize(RRDDIM *rd)
 {
     struct rrdeng_collect_handle *handle;
-    struct rrdengine_instance *ctx;
+    struct rrdeng_rollup_handle *rollup;
+    unsigned i;
 
     handle = &rd->state->handle.rrdeng;
-    ctx = handle->ctx;
-    rrdeng_store_metric_flush_current_page(rd);
-    if (handle->prev_descr) {
-        /* unpin old second page */
-        pg_cache_put(ctx, handle->prev_descr);
+    rrdeng_store_handle_finalize(handle);
+    rollup = handle->rollup;
+    if (rollup) {
+        for (i = 0 ; i < rollup->nr_tiers ; ++i)
+            rrdeng_store_handle_finalize(&rollup->tiers[i].handle);
+        freez(rollup);
+        handle->rollup = NULL;
     }
 }
 
+/*
+ * Returns 1 when querying nr_metrics metrics of ctx over [start_time, end_time] reads more than a share of the page
+ * cache, e.g. a month of a big chart. The pages of such scan queries are admitted to the page cache without evicting
+ * the pages the dashboards keep hitting.
+ */
+static uint8_t rrdeng_is_scan_query(struct rrdengine_instance *ctx, unsigned nr_metrics, time_t dt, unsigned stride,
+                                    time_t start_time, time_t end_time)
+{
+    unsigned long points, pages;
+
+    if (unlikely(dt <= 0 || end_time < start_time))
+        return 0;
+    points = (unsigned long)((end_time - start_time) / dt + 1) * stride;
+    pages = nr_metrics * (points / (RRDENG_BLOCK_SIZE / sizeof(storage_number)) + 1);
+    return pages > ctx->max_cache_pages / PAGE_CACHE_SCAN_QUERY_SHARE;
+}
+
 /*
  * Gets a handle for loading metrics from the database.
  * The handle must be released with rrdeng_load_metric_final().
  */
-void rrdeng_load_metric_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle, time_t start_time, time_t end_time)
+/* Every point of the pages of the metric has stride storage numbers, the one at offset is loaded */
+static void rrdeng_load_handle_setup(struct rrddim_query_handle *rrdimm_handle, struct rrdengine_instance *ctx,
+                                     struct pg_cache_page_index *page_index, usec_t preloaded_until, time_t dt,
+                                     unsigned stride, unsigned offset, time_t start_time, time_t end_time,
+                                     uint8_t scan)
 {
     struct rrdeng_query_handle *handle;
-    struct rrdengine_instance *ctx;
 
-    ctx = rd->rrdset->rrdhost->rrdeng_ctx;
     rrdimm_handle->start_time = start_time;
     rrdimm_handle->end_time = end_time;
     handle = &rrdimm_handle->rrdeng;
     handle->now = start_time;
-    handle->dt = rd->rrdset->update_every;
+    handle->dt = dt;
+    handle->stride = stride;
+    handle->offset = offset;
     handle->ctx = ctx;
     handle->descr = NULL;
-    handle->page_index = pg_cache_preload(ctx, rd->state->rrdeng_uuid,
-                                          start_time * USEC_PER_SEC, end_time * USEC_PER_SEC);
+    handle->page_index = page_index;
+    handle->preloaded_until = preloaded_until;
+    handle->scan = scan;
+}
+
+/* The page index of the metric is the one its collection handle got, so that it is not looked up again */
+static void rrdeng_load_handle_init(struct rrddim_query_handle *rrdimm_handle, struct rrdengine_instance *ctx,
+                                    struct pg_cache_page_index *page_index, time_t dt, unsigned stride,
+                                    unsigned offset, time_t start_time, time_t end_time)
+{
+    usec_t preloaded_until = end_time * USEC_PER_SEC;
+    uint8_t scan;
+
+    scan = rrdeng_is_scan_query(ctx, 1, dt, stride, start_time, end_time);
+    pg_cache_preload_range(ctx, page_index, start_time * USEC_PER_SEC, end_time * USEC_PER_SEC,
+                           PAGE_CACHE_MAX_PRELOAD_PAGES, &preloaded_until, scan);
+    rrdeng_load_handle_setup(rrdimm_handle, ctx, page_index, preloaded_until, dt, stride, offset, start_time,
+                             end_time, scan);
+}
+
+void rrdeng_load_metric_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle, time_t start_time, time_t end_time)
+{
+    struct rrdengine_instance *ctx;
+
+    ctx = rrdeng_metric_ctx(rd, rd->state->rrdeng_uuid);
+    rrdeng_load_handle_init(rrdimm_handle, ctx, rd->state->handle.rrdeng.page_index, rd->rrdset->update_every, 1,
+                            0, start_time, end_time);
+}
+
+/*
+ * Preloads the pages of many dimensions of a chart in [start_time, end_time] in one pass, so that every extent is
+ * read once for all the dimensions whose pages it holds instead of once per dimension. rds[] has NULL entries for
+ * the dimensions that are not loaded. The query handles of the dimensions are initialized with
+ * rrdeng_load_chart_metric_init() and the chart query must be released with rrdeng_load_chart_finalize().
+ */
+struct rrdeng_chart_query *rrdeng_load_chart_init(RRDDIM **rds, unsigned nr_dims, time_t start_time, time_t end_time)
+{
+    struct rrdeng_chart_query *chart_query;
+    struct rrdengine_instance *ctx, **ctxs;
+    struct pg_cache_page_index **page_indices;
+    usec_t *preloaded_until;
+    unsigned i, j, nr_metrics, max_pages;
+    uint8_t scan;
+
+    chart_query = callocz(1, sizeof(*chart_query) + nr_dims * sizeof(chart_query->dims[0]));
+    chart_query->nr_dims = nr_dims;
+    ctxs = callocz(MAX(nr_dims, 1), sizeof(*ctxs));
+    page_indices = callocz(MAX(nr_dims, 1), sizeof(*page_indices));
+    preloaded_until = callocz(MAX(nr_dims, 1), sizeof(*preloaded_until));
+    for (i = 0 ; i < nr_dims ; ++i) {
+        chart_query->dims[i].rd = rds[i];
+        chart_query->dims[i].preloaded_until = end_time * USEC_PER_SEC;
+        if (rds[i])
+            ctxs[i] = rrdeng_metric_ctx(rds[i], rds[i]->state->rrdeng_uuid);
+    }
+
+    /* every worker reads the pages of its own metrics */
+    for (i = 0 ; i < nr_dims ; ++i) {
+        ctx = ctxs[i];
+        if (NULL == ctx)
+            continue;
+        for (j = i, nr_metrics = 0 ; j < nr_dims ; ++j) {
+            page_indices[j] = NULL;
+            if (ctxs[j] == ctx) {
+                page_indices[j] = rds[j]->state->handle.rrdeng.page_index;
+                ++nr_metrics;
+            }
+        }
+        /* the pages that do not fit in the budget are read ahead by every dimension */
+        max_pages = MAX(1, PAGE_CACHE_MAX_CHART_PRELOAD_PAGES / nr_metrics);
+        /* the dimensions are read together, so they are a scan query together */
+        scan = rrdeng_is_scan_query(ctx, nr_metrics, rds[i]->rrdset->update_every, 1, start_time, end_time);
+        pg_cache_preload_metrics(ctx, page_indices + i, nr_dims - i, start_time * USEC_PER_SEC,
+                                 end_time * USEC_PER_SEC, max_pages, preloaded_until + i, scan);
+        for (j = i ; j < nr_dims ; ++j) {
+            if (ctxs[j] == ctx) {
+                chart_query->dims[j].preloaded_until = preloaded_until[j];
+                chart_query->dims[j].scan = scan;
+                ctxs[j] = NULL;
+            }
+        }
+    }
+    freez(preloaded_until);
+    freez(page_indices);
+    freez(ctxs);
+
+    return chart_query;
+}
+
+/*
+ * Initializes the query handle of the dimension at index dim of a chart query, without looking up its pages again.
+ * The handle is used and released like the handles of rrdeng_load_metric_init().
+ */
+void rrdeng_load_chart_metric_init(struct rrdeng_chart_query *chart_query, unsigned dim,
+                                   struct rrddim_query_handle *rrdimm_handle, time_t start_time, time_t end_time)
+{
+    RRDDIM *rd = chart_query->dims[dim].rd;
+    struct rrdengine_instance *ctx;
+
+    assert(dim < chart_query->nr_dims && rd);
+    ctx = rrdeng_metric_ctx(rd, rd->state->rrdeng_uuid);
+    rrdeng_load_handle_setup(rrdimm_handle, ctx, rd->state->handle.rrdeng.page_index,
+                             chart_query->dims[dim].preloaded_until, rd->rrdset->update_every, 1, 0,
+                             start_time, end_time, chart_query->dims[dim].scan);
+}
+
+void rrdeng_load_chart_finalize(struct rrdeng_chart_query *chart_query)
+{
+    freez(chart_query);
+}
+
+static struct rrdeng_rollup_tier *rrdeng_get_rollup_tier(RRDDIM *rd, unsigned tier)
+{
+    struct rrdeng_rollup_handle *rollup = rd->state->handle.rrdeng.rollup;
+    unsigned i;
+
+    if (NULL == rollup)
+        return NULL;
+    for (i = 0 ; i < rollup->nr_tiers ; ++i) {
+        if (rollup->tiers[i].tier == tier)
+            return &rollup->tiers[i];
+    }
+    return NULL;
+}
+
+/*
+ * Returns the storage tier with the coarsest rollups of rd whose interval fits in group_duration seconds,
+ * or 0 when there is none. The interval of the tier is returned in *interval.
+ */
+unsigned rrdeng_pick_rollup_tier(RRDDIM *rd, time_t group_duration, time_t *interval)
+{
+    struct rrdeng_rollup_handle *rollup = rd->state->handle.rrdeng.rollup;
+    unsigned i, tier = 0;
+
+    if (NULL == rollup)
+        return 0;
+    /* tiers are ordered by interval */
+    for (i = 0 ; i < rollup->nr_tiers && rollup->tiers[i].interval <= group_duration ; ++i) {
+        tier = rollup->tiers[i].tier;
+        *interval = rollup->tiers[i].interval;
+    }
+    return tier;
+}
+
+/*
+ * Gets a handle for loading a rollup series of rd from a higher storage tier, it must exist.
+ * Every point of the series aggregates the interval that ends at its time. The handle is used and released like
+ * the handles of rrdeng_load_metric_init().
+ */
+void rrdeng_load_rollup_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle, unsigned tier,
+                             unsigned series, time_t start_time, time_t end_time)
+{
+    struct rrdeng_rollup_tier *rollup_tier;
+
+    rollup_tier = rrdeng_get_rollup_tier(rd, tier);
+    assert(rollup_tier && series < RRDENG_ROLLUP_SERIES);
+    rrdeng_load_handle_init(rrdimm_handle, rollup_tier->handle.ctx, rollup_tier->handle.page_index,
+                            rollup_tier->interval, RRDENG_ROLLUP_SERIES, series, start_time, end_time);
+}
+
+/*
+ * Requests the next pages of a long range query from disk while the current page is being consumed, when the
+ * pages preloaded so far are about to run out.
+ */
+static inline void rrdeng_load_metric_readahead(struct rrddim_query_handle *rrdimm_handle,
+                                                struct rrdeng_page_descr *descr)
+{
+    struct rrdeng_query_handle *handle = &rrdimm_handle->rrdeng;
+    usec_t end_time, page_duration;
+
+    end_time = rrdimm_handle->end_time * USEC_PER_SEC;
+    if (likely(handle->preloaded_until >= end_time))
+        return;
+    page_duration = pg_descr_end_time(descr) - pg_descr_start_time(descr);
+    if (pg_descr_end_time(descr) + page_duration * (PAGE_CACHE_READAHEAD_PAGES / 2) < handle->preloaded_until)
+        return;
+    pg_cache_preload_range(handle->ctx, handle->page_index, handle->preloaded_until, end_time,
+                           PAGE_CACHE_READAHEAD_PAGES, &handle->preloaded_until, handle->scan);
 }
 
 storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle)
@@ -261,8 +770,8 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
         goto out;
     }
     if (unlikely(NULL == descr ||
-                 point_in_time < descr->start_time ||
-                 point_in_time > descr->end_time)) {
+                 point_in_time < pg_descr_start_time(descr) ||
+                 point_in_time > pg_descr_end_time(descr))) {
         if (descr) {
 #ifdef NETDATA_INTERNAL_CHECKS
             rrd_stat_atomic_add(&ctx->stats.metric_API_consumers, -1);
@@ -270,7 +779,7 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
             pg_cache_put(ctx, descr);
             handle->descr = NULL;
         }
-        descr = pg_cache_lookup(ctx, handle->page_index, &handle->page_index->id, point_in_time);
+        descr = pg_cache_lookup(ctx, handle->page_index, &handle->page_index->id, point_in_time, handle->scan);
         if (NULL == descr) {
             ret = SN_EMPTY_SLOT;
             goto out;
@@ -279,20 +788,22 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
         rrd_stat_atomic_add(&ctx->stats.metric_API_consumers, 1);
 #endif
         handle->descr = descr;
+        rrdeng_load_metric_readahead(rrdimm_handle, descr);
     }
-    if (unlikely(INVALID_TIME == descr->start_time ||
-                 INVALID_TIME == descr->end_time)) {
+    if (unlikely(INVALID_TIME == pg_descr_start_time(descr) ||
+                 INVALID_TIME == pg_descr_end_time(descr))) {
         ret = SN_EMPTY_SLOT;
         goto out;
     }
     page = descr->pg_cache_descr->page;
-    if (unlikely(descr->start_time == descr->end_time)) {
-        ret = page[0];
+    if (unlikely(pg_descr_start_time(descr) == pg_descr_end_time(descr))) {
+        ret = page[handle->offset];
         goto out;
     }
-    position = ((uint64_t)(point_in_time - descr->start_time)) * (descr->page_length / sizeof(storage_number)) /
-               (descr->end_time - descr->start_time + 1);
-    ret = page[position];
+    position = ((uint64_t)(point_in_time - pg_descr_start_time(descr))) *
+               (descr->page_length / (sizeof(storage_number) * handle->stride)) /
+               (pg_descr_end_time(descr) - pg_descr_start_time(descr) + 1);
+    ret = page[position * handle->stride + handle->offset];
 
 out:
     handle->now += handle->dt;
@@ -302,6 +813,93 @@ out:
     return ret;
 }
 
+/*
+ * Loads up to entries of the next points of the query, the ones in the page of the next point, like that many calls to
+ * rrdeng_load_metric_next() would. The page is looked up once, so the caller has to call again for the points after
+ * it. Returns the number of points loaded, 0 when the query is finished.
+ */
+size_t rrdeng_load_metric_next_many(struct rrddim_query_handle *rrdimm_handle, storage_number *numbers, size_t entries)
+{
+    struct rrdeng_query_handle *handle;
+    struct rrdeng_page_descr *descr;
+    storage_number *page;
+    usec_t point_in_time, start_time, end_time;
+    uint64_t page_entries;
+    unsigned position;
+    size_t count;
+
+    handle = &rrdimm_handle->rrdeng;
+    if (unlikely(INVALID_TIME == handle->now || 0 == entries)) {
+        return 0;
+    }
+    /* the first point finds the page, the rest are read from it directly */
+    numbers[0] = rrdeng_load_metric_next(rrdimm_handle);
+    descr = handle->descr;
+    if (unlikely(INVALID_TIME == handle->now || NULL == descr)) {
+        return 1;
+    }
+    start_time = pg_descr_start_time(descr);
+    end_time = pg_descr_end_time(descr);
+    if (unlikely(INVALID_TIME == start_time || INVALID_TIME == end_time || start_time == end_time)) {
+        return 1;
+    }
+    page = descr->pg_cache_descr->page;
+    page_entries = descr->page_length / (sizeof(storage_number) * handle->stride);
+
+    for (count = 1 ; count < entries ; ++count) {
+        point_in_time = handle->now * USEC_PER_SEC;
+        if (point_in_time < start_time || point_in_time > end_time) {
+            break;
+        }
+        position = ((uint64_t)(point_in_time - start_time)) * page_entries / (end_time - start_time + 1);
+        numbers[count] = page[position * handle->stride + handle->offset];
+
+        handle->now += handle->dt;
+        if (unlikely(handle->now > rrdimm_handle->end_time)) {
+            handle->now = INVALID_TIME;
+            ++count;
+            break;
+        }
+    }
+    return count;
+}
+
+/*
+ * Skips the next page of the query when it starts at the next point of the query, ends at or before end_time and has
+ * a summary, so that queries can aggregate it without reading it. Returns the number of points of the page and fills
+ * in its summary, or 0 when the points of the page have to be loaded one by one.
+ */
+unsigned rrdeng_load_metric_next_summary(struct rrddim_query_handle *rrdimm_handle, time_t end_time,
+                                         struct rrdeng_page_summary *summary)
+{
+    struct rrdeng_query_handle *handle;
+    usec_t page_end_time;
+    uint32_t page_length;
+    time_t page_duration;
+    unsigned points;
+
+    handle = &rrdimm_handle->rrdeng;
+    if (unlikely(INVALID_TIME == handle->now || NULL == handle->page_index || 1 != handle->stride))
+        return 0;
+    if (end_time > rrdimm_handle->end_time)
+        end_time = rrdimm_handle->end_time;
+    if (!pg_cache_lookup_summary(handle->page_index, handle->now * USEC_PER_SEC, end_time * USEC_PER_SEC, summary,
+                                 &page_end_time, &page_length))
+        return 0;
+
+    /* the points of the page must be the points the query would load */
+    points = page_length / sizeof(storage_number);
+    page_duration = (time_t)(page_end_time / USEC_PER_SEC) - handle->now;
+    if (unlikely(page_duration % handle->dt || (time_t)points != page_duration / handle->dt + 1))
+        return 0;
+
+    handle->now += points * handle->dt;
+    if (unlikely(handle->now > rrdimm_handle->end_time)) {
+        handle->now = INVALID_TIME;
+    }
+    return points;
+}
+
 int rrdeng_load_metric_is_finished(struct rrddim_query_handle *rrdimm_handle)
 {
     struct rrdeng_query_handle *handle;
@@ -340,40 +938,38 @@ time_t rrdeng_metric_latest_time(RRDDIM *rd)
 
     return page_index->latest_time / USEC_PER_SEC;
 }
+
+/* The rollups of the higher storage tiers usually reach further in the past than the metric itself */
 time_t rrdeng_metric_oldest_time(RRDDIM *rd)
 {
     struct rrdeng_collect_handle *handle;
-    struct pg_cache_page_index *page_index;
+    struct rrdeng_rollup_handle *rollup;
+    usec_t oldest_time, rollup_oldest_time;
+    unsigned i;
 
     handle = &rd->state->handle.rrdeng;
-    page_index = handle->page_index;
-
-    return page_index->oldest_time / USEC_PER_SEC;
+    oldest_time = handle->page_index->oldest_time;
+    rollup = handle->rollup;
+    for (i = 0 ; rollup && i < rollup->nr_tiers ; ++i) {
+        rollup_oldest_time = rollup->tiers[i].handle.page_index->oldest_time;
+        if (INVALID_TIME != rollup_oldest_time) {
+            /* the first point of a rollup aggregates the interval before it */
+            rollup_oldest_time -= (rollup->tiers[i].interval - rd->rrdset->update_every) * USEC_PER_SEC;
+            if (INVALID_TIME == oldest_time || rollup_oldest_time < oldest_time)
+                oldest_time = rollup_oldest_time;
+        }
+    }
+    return oldest_time / USEC_PER_SEC;
 }
 
-/* Also gets a reference for the page */
-void *rrdeng_create_page(struct rrdengine_instance *ctx, uuid_t *id, struct rrdeng_page_descr **ret_descr)
+time_t rrdeng_rollup_latest_time(RRDDIM *rd, unsigned tier)
 {
-    struct rrdeng_page_descr *descr;
-    struct page_cache_descr *pg_cache_descr;
-    void *page;
-    /* TODO: check maximum number of pages in page cache limit */
+    struct rrdeng_rollup_tier *rollup_tier;
 
-    descr = pg_cache_create_descr();
-    descr->id = id; /* TODO: add page type: metric, log, something? */
-    page = mallocz(RRDENG_BLOCK_SIZE); /*TODO: add page size */
-    rrdeng_page_descr_mutex_lock(ctx, descr);
-    pg_cache_descr = descr->pg_cache_descr;
-    pg_cache_descr->page = page;
-    pg_cache_descr->flags = RRD_PAGE_DIRTY /*| RRD_PAGE_LOCKED */ | RRD_PAGE_POPULATED /* | BEING_COLLECTED */;
-    pg_cache_descr->refcnt = 1;
-
-    debug(D_RRDENGINE, "Created new page:");
-    if (unlikely(debug_flags & D_RRDENGINE))
-        print_page_cache_descr(descr);
-    rrdeng_page_descr_mutex_unlock(ctx, descr);
-    *ret_descr = descr;
-    return page;
+    rollup_tier = rrdeng_get_rollup_tier(rd, tier);
+    if (NULL == rollup_tier)
+        return 0;
+    return rollup_tier->handle.page_index->latest_time / USEC_PER_SEC;
 }
 
 /* The page must not be empty */
@@ -405,7 +1001,7 @@ void *rrdeng_get_latest_page(struct rrdengine_instance *ctx, uuid_t *id, void **
     struct page_cache_descr *pg_cache_descr;
 
     debug(D_RRDENGINE, "Reading existing page:");
-    descr = pg_cache_lookup(ctx, NULL, id, INVALID_TIME);
+    descr = pg_cache_lookup(ctx, NULL, id, INVALID_TIME, 0);
     if (NULL == descr) {
         *handle = NULL;
 
@@ -424,7 +1020,7 @@ void *rrdeng_get_page(struct rrdengine_instance *ctx, uuid_t *id, usec_t point_i
     struct page_cache_descr *pg_cache_descr;
 
     debug(D_RRDENGINE, "Reading existing page:");
-    descr = pg_cache_lookup(ctx, NULL, id, point_in_time);
+    descr = pg_cache_lookup(ctx, NULL, id, point_in_time, 0);
     if (NULL == descr) {
         *handle = NULL;
 
@@ -441,45 +1037,58 @@ void *rrdeng_get_page(struct rrdengine_instance *ctx, uuid_t *id, usec_t point_i
  * Careful when modifying this function.
  * You must not change the indices of the statistics or user code will break.
  * You must not exceed RRDENG_NR_STATS or it will crash.
+ * The per instance statistics are the sums of the statistics of all worker shards, storage tiers and retention classes.
  */
-void rrdeng_get_33_statistics(struct rrdengine_instance *ctx, unsigned long long *array)
+void rrdeng_get_38_statistics(struct rrdengine_instance *ctx, unsigned long long *array)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct rrdengine_instance *shard;
+    struct page_cache *pg_cache;
+    unsigned i;
 
-    array[0] = (uint64_t)ctx->stats.metric_API_producers;
-    array[1] = (uint64_t)ctx->stats.metric_API_consumers;
-    array[2] = (uint64_t)pg_cache->page_descriptors;
-    array[3] = (uint64_t)pg_cache->populated_pages;
-    array[4] = (uint64_t)pg_cache->commited_page_index.nr_commited_pages;
-    array[5] = (uint64_t)ctx->stats.pg_cache_insertions;
-    array[6] = (uint64_t)ctx->stats.pg_cache_deletions;
-    array[7] = (uint64_t)ctx->stats.pg_cache_hits;
-    array[8] = (uint64_t)ctx->stats.pg_cache_misses;
-    array[9] = (uint64_t)ctx->stats.pg_cache_backfills;
-    array[10] = (uint64_t)ctx->stats.pg_cache_evictions;
-    array[11] = (uint64_t)ctx->stats.before_compress_bytes;
-    array[12] = (uint64_t)ctx->stats.after_compress_bytes;
-    array[13] = (uint64_t)ctx->stats.before_decompress_bytes;
-    array[14] = (uint64_t)ctx->stats.after_decompress_bytes;
-    array[15] = (uint64_t)ctx->stats.io_write_bytes;
-    array[16] = (uint64_t)ctx->stats.io_write_requests;
-    array[17] = (uint64_t)ctx->stats.io_read_bytes;
-    array[18] = (uint64_t)ctx->stats.io_read_requests;
-    array[19] = (uint64_t)ctx->stats.io_write_extent_bytes;
-    array[20] = (uint64_t)ctx->stats.io_write_extents;
-    array[21] = (uint64_t)ctx->stats.io_read_extent_bytes;
-    array[22] = (uint64_t)ctx->stats.io_read_extents;
-    array[23] = (uint64_t)ctx->stats.datafile_creations;
-    array[24] = (uint64_t)ctx->stats.datafile_deletions;
-    array[25] = (uint64_t)ctx->stats.journalfile_creations;
-    array[26] = (uint64_t)ctx->stats.journalfile_deletions;
-    array[27] = (uint64_t)ctx->stats.page_cache_descriptors;
-    array[28] = (uint64_t)ctx->stats.io_errors;
-    array[29] = (uint64_t)ctx->stats.fs_errors;
+    memset(array, 0, sizeof(*array) * RRDENG_NR_STATS);
+    for (i = 0 ; NULL != (shard = rrdeng_get_instance(ctx, i)) ; ++i) {
+        pg_cache = &shard->pg_cache;
+
+        array[0] += (uint64_t)shard->stats.metric_API_producers;
+        array[1] += (uint64_t)shard->stats.metric_API_consumers;
+        array[2] += (uint64_t)pg_cache->page_descriptors;
+        array[3] += (uint64_t)pg_cache->populated_pages;
+        array[4] += (uint64_t)pg_cache->commited_page_index.nr_commited_pages;
+        array[5] += (uint64_t)shard->stats.pg_cache_insertions;
+        array[6] += (uint64_t)shard->stats.pg_cache_deletions;
+        array[7] += (uint64_t)shard->stats.pg_cache_hits;
+        array[8] += (uint64_t)shard->stats.pg_cache_misses;
+        array[9] += (uint64_t)shard->stats.pg_cache_backfills;
+        array[10] += (uint64_t)shard->stats.pg_cache_evictions;
+        array[11] += (uint64_t)shard->stats.before_compress_bytes;
+        array[12] += (uint64_t)shard->stats.after_compress_bytes;
+        array[13] += (uint64_t)shard->stats.before_decompress_bytes;
+        array[14] += (uint64_t)shard->stats.after_decompress_bytes;
+        array[15] += (uint64_t)shard->stats.io_write_bytes;
+        array[16] += (uint64_t)shard->stats.io_write_requests;
+        array[17] += (uint64_t)shard->stats.io_read_bytes;
+        array[18] += (uint64_t)shard->stats.io_read_requests;
+        array[19] += (uint64_t)shard->stats.io_write_extent_bytes;
+        array[20] += (uint64_t)shard->stats.io_write_extents;
+        array[21] += (uint64_t)shard->stats.io_read_extent_bytes;
+        array[22] += (uint64_t)shard->stats.io_read_extents;
+        array[23] += (uint64_t)shard->stats.datafile_creations;
+        array[24] += (uint64_t)shard->stats.datafile_deletions;
+        array[25] += (uint64_t)shard->stats.journalfile_creations;
+        array[26] += (uint64_t)shard->stats.journalfile_deletions;
+        array[27] += (uint64_t)shard->stats.page_cache_descriptors;
+        array[28] += (uint64_t)shard->stats.io_errors;
+        array[29] += (uint64_t)shard->stats.fs_errors;
+        array[33] += (uint64_t)rrdeng_cmd_queue_depth(&shard->worker_config);
+        array[34] += (uint64_t)shard->stats.cmd_queue_producer_stalls;
+        array[35] += (uint64_t)shard->dirty_pages_target;
+        array[36] += (uint64_t)shard->stats.writeback_pages;
+        array[37] += (uint64_t)shard->stats.writeback_forced_flushes;
+    }
     array[30] = (uint64_t)global_io_errors;
     array[31] = (uint64_t)global_fs_errors;
     array[32] = (uint64_t)rrdeng_reserved_file_descriptors;
-    assert(RRDENG_NR_STATS == 33);
+    assert(RRDENG_NR_STATS == 38);
 }
 
 /* Releases reference to page */
@@ -490,15 +1099,47 @@ void rrdeng_put_page(struct rrdengine_instance *ctx, void *handle)
 }
 
 /*
+ * Counts the worker shards of an existing database in dbfiles_path.
+ * Returns 0 when there is no database in dbfiles_path.
+ */
+static unsigned rrdeng_find_existing_workers(char *dbfiles_path)
+{
+    uv_fs_t req;
+    uv_dirent_t dent;
+    unsigned tier, no, workers;
+    int ret, found;
+    char path[RRDENG_PATH_MAX];
+
+    ret = uv_fs_scandir(NULL, &req, dbfiles_path, 0, NULL);
+    if (ret < 0) {
+        uv_fs_req_cleanup(&req);
+        return 0;
+    }
+    for (found = 0 ; !found && UV_EOF != uv_fs_scandir_next(&req, &dent) ; ) {
+        found = (2 == sscanf(dent.name, DATAFILE_PREFIX RRDENG_FILE_NUMBER_SCAN_TMPL DATAFILE_EXTENSION, &tier, &no));
+    }
+    uv_fs_req_cleanup(&req);
+    if (!found)
+        return 0;
+
+    for (workers = 1 ; workers < RRDENG_MAX_WORKERS ; ++workers) {
+        snprintfz(path, RRDENG_PATH_MAX - 1, "%s/" RRDENG_WORKER_DIR_PREFIX "%u", dbfiles_path, workers);
+        if (0 != access(path, F_OK))
+            break;
+    }
+    return workers;
+}
+
+/*
+ * Initializes and starts the event loop of a single worker shard, that is its own only shard, tier and class.
  * Returns 0 on success, negative on error
  */
-int rrdeng_init(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb, unsigned disk_space_mb)
+static int rrdeng_init_shard(struct rrdengine_instance *ctx, unsigned tier, char *dbfiles_path,
+                             unsigned page_cache_mb, unsigned disk_space_mb)
 {
-    struct rrdengine_instance *ctx;
     int error;
     uint32_t max_open_files;
-
-    sanity_check();
+    unsigned node, total_share;
 
     max_open_files = rlimit_nofile.rlim_cur / 4;
 
@@ -513,19 +1154,22 @@ int rrdeng_init(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned p
         return UV_EMFILE;
     }
 
-    if (NULL == ctxp) {
-        /* for testing */
-        ctx = &default_global_ctx;
-        memset(ctx, 0, sizeof(*ctx));
-    } else {
-        *ctxp = ctx = callocz(1, sizeof(*ctx));
-    }
+    ctx->tier = tier;
     ctx->global_compress_alg = RRD_LZ4;
     if (page_cache_mb < RRDENG_MIN_PAGE_CACHE_SIZE_MB)
         page_cache_mb = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
     ctx->max_cache_pages = page_cache_mb * (1048576LU / RRDENG_BLOCK_SIZE);
     /* try to keep 5% of the page cache free */
     ctx->cache_pages_low_watermark = (ctx->max_cache_pages * 95LLU) / 100;
+    ctx->dirty_pages_target = MAX((ctx->max_cache_pages * default_rrdeng_dirty_page_ratio) / 100, MAX_PAGES_PER_EXTENT);
+    for (node = 0, total_share = 0 ; node < page_arena_nodes ; ++node)
+        total_share += default_rrdeng_page_cache_node_share[node];
+    for (node = 0 ; node < page_arena_nodes ; ++node) {
+        ctx->node_pages[node] = 0;
+        ctx->node_max_pages[node] = total_share ?
+            (ctx->max_cache_pages * default_rrdeng_page_cache_node_share[node]) / total_share :
+            ctx->max_cache_pages / page_arena_nodes;
+    }
     if (disk_space_mb < RRDENG_MIN_DISK_SPACE_MB)
         disk_space_mb = RRDENG_MIN_DISK_SPACE_MB;
     ctx->max_disk_space = disk_space_mb * 1048576LLU;
@@ -549,18 +1193,204 @@ int rrdeng_init(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned p
     if (ctx->worker_config.error) {
         goto error_after_rrdeng_worker;
     }
+    ctx->shards[0] = ctx;
+    ctx->nr_shards = 1;
+    ctx->tiers[0] = ctx;
+    ctx->nr_tiers = 1;
+    ctx->classes[0] = ctx;
+    ctx->nr_classes = 1;
     return 0;
 
 error_after_rrdeng_worker:
     finalize_rrd_files(ctx);
 error_after_init_rrd_files:
     free_page_cache(ctx);
+    rrd_stat_atomic_add(&rrdeng_reserved_file_descriptors, -RRDENG_FD_BUDGET_PER_INSTANCE);
+    return UV_EIO;
+}
+
+/* Stops the event loops of the worker shards [first, ctx->nr_shards) and releases their resources */
+static void rrdeng_exit_shards(struct rrdengine_instance *ctx, unsigned first)
+{
+    struct rrdeng_cmd cmd;
+    unsigned i;
+
+    /* let all event loops flush and shut down in parallel */
+    cmd.opcode = RRDENG_SHUTDOWN;
+    for (i = first ; i < ctx->nr_shards ; ++i) {
+        rrdeng_enq_cmd(&ctx->shards[i]->worker_config, &cmd);
+    }
+    for (i = first ; i < ctx->nr_shards ; ++i) {
+        struct rrdengine_instance *shard = ctx->shards[i];
+
+        assert(0 == uv_thread_join(&shard->worker_config.thread));
+
+        finalize_rrd_files(shard);
+        free_page_cache(shard);
+        if (shard != ctx) {
+            freez(shard);
+        }
+        rrd_stat_atomic_add(&rrdeng_reserved_file_descriptors, -RRDENG_FD_BUDGET_PER_INSTANCE);
+    }
+    ctx->nr_shards = first;
+}
+
+/* Stops the higher storage tiers of the instance and releases their resources */
+static void rrdeng_exit_tiers(struct rrdengine_instance *ctx)
+{
+    unsigned i;
+
+    for (i = 1 ; i < ctx->nr_tiers ; ++i) {
+        rrdeng_exit_shards(ctx->tiers[i], 0);
+        freez(ctx->tiers[i]);
+    }
+    ctx->nr_tiers = 1;
+}
+
+/* Stops the retention classes of the instance but the first one and releases their resources */
+static void rrdeng_exit_classes(struct rrdengine_instance *ctx)
+{
+    unsigned i;
+
+    for (i = 1 ; i < ctx->nr_classes ; ++i) {
+        rrdeng_exit_shards(ctx->classes[i], 0);
+        freez(ctx->classes[i]);
+    }
+    ctx->nr_classes = 1;
+}
+
+/*
+ * Returns 0 on success, negative on error
+ */
+int rrdeng_init(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb, unsigned disk_space_mb)
+{
+    struct rrdengine_instance *ctx;
+    int error;
+    unsigned i, nr_shards, nr_tiers, nr_classes, tier_disk_space_mb;
+    char path[RRDENG_PATH_MAX];
+
+    sanity_check();
+    crc32c_init();
+    nr_tiers = (unsigned)MAX(1, MIN(default_rrdeng_storage_tiers, RRDENG_MAX_TIERS));
+    nr_classes = (unsigned)MAX(1, MIN(default_rrdeng_retention_classes, RRDENG_MAX_RETENTION_CLASSES));
+
+    if (NULL == ctxp) {
+        /* for testing */
+        ctx = &default_global_ctx;
+        memset(ctx, 0, sizeof(*ctx));
+    } else {
+        *ctxp = ctx = callocz(1, sizeof(*ctx));
+    }
+
+    /* the number of shards of an existing database cannot change since metrics would move to other shards */
+    nr_shards = rrdeng_find_existing_workers(dbfiles_path);
+    if (0 == nr_shards) {
+        nr_shards = (unsigned)MAX(1, MIN(default_rrdeng_workers, RRDENG_MAX_WORKERS));
+    } else if (nr_shards != (unsigned)default_rrdeng_workers) {
+        info("DB engine in path \"%s\" was created with %u worker(s), ignoring configured value %d.",
+             dbfiles_path, nr_shards, default_rrdeng_workers);
+    }
+
+    /* the disk space budget is split between tiers, the budgets of the first tier evenly between its shards */
+    tier_disk_space_mb = disk_space_mb * rrdeng_tier_share[nr_tiers - 1][0] / 100;
+    error = rrdeng_init_shard(ctx, 1, dbfiles_path, page_cache_mb / nr_shards, tier_disk_space_mb / nr_shards);
+    if (error) {
+        goto error_after_init_shards;
+    }
+
+    for (i = 1 ; i < nr_shards ; ++i) {
+        struct rrdengine_instance *shard;
+
+        snprintfz(path, RRDENG_PATH_MAX - 1, "%s/" RRDENG_WORKER_DIR_PREFIX "%u", dbfiles_path, i);
+        error = mkdir(path, 0775);
+        if (error != 0 && errno != EEXIST) {
+            error("Cannot create directory '%s' for DB engine worker %u", path, i);
+            error = UV_EIO;
+            goto error_after_init_shards;
+        }
+        shard = callocz(1, sizeof(*shard));
+        error = rrdeng_init_shard(shard, 1, path, page_cache_mb / nr_shards, tier_disk_space_mb / nr_shards);
+        if (error) {
+            freez(shard);
+            goto error_after_init_shards;
+        }
+        ctx->shards[ctx->nr_shards++] = shard;
+    }
+    if (nr_shards > 1)
+        info("DB engine in path \"%s\" started %u workers.", dbfiles_path, nr_shards);
+
+    for (i = 1 ; i < nr_tiers ; ++i) {
+        struct rrdengine_instance *tier_ctx;
+
+        snprintfz(path, RRDENG_PATH_MAX - 1, "%s/" RRDENG_TIER_DIR_PREFIX "%u", dbfiles_path, i + 1);
+        error = mkdir(path, 0775);
+        if (error != 0 && errno != EEXIST) {
+            error("Cannot create directory '%s' for DB engine tier %u", path, i + 1);
+            error = UV_EIO;
+            goto error_after_init_tiers;
+        }
+        tier_ctx = callocz(1, sizeof(*tier_ctx));
+        error = rrdeng_init_shard(tier_ctx, i + 1, path, page_cache_mb,
+                                  disk_space_mb * rrdeng_tier_share[nr_tiers - 1][i] / 100);
+        if (error) {
+            freez(tier_ctx);
+            goto error_after_init_tiers;
+        }
+        ctx->tiers[ctx->nr_tiers++] = tier_ctx;
+    }
+    if (nr_tiers > 1)
+        info("DB engine in path \"%s\" started %u storage tiers.", dbfiles_path, nr_tiers);
+
+    for (i = 1 ; i < nr_classes ; ++i) {
+        struct rrdengine_instance *class_ctx;
+
+        snprintfz(path, RRDENG_PATH_MAX - 1, "%s/" RRDENG_CLASS_DIR_PREFIX "%u", dbfiles_path, i + 1);
+        error = mkdir(path, 0775);
+        if (error != 0 && errno != EEXIST) {
+            error("Cannot create directory '%s' for DB engine retention class %u", path, i + 1);
+            error = UV_EIO;
+            goto error_after_init_classes;
+        }
+        class_ctx = callocz(1, sizeof(*class_ctx));
+        error = rrdeng_init_shard(class_ctx, 1, path, page_cache_mb, default_rrdeng_class_disk_quota_mb[i]);
+        if (error) {
+            freez(class_ctx);
+            goto error_after_init_classes;
+        }
+        ctx->classes[ctx->nr_classes++] = class_ctx;
+    }
+    if (nr_classes > 1)
+        info("DB engine in path \"%s\" started %u retention classes.", dbfiles_path, nr_classes);
+    metricdir_init(ctx);
+    return 0;
+
+error_after_init_classes:
+    rrdeng_exit_classes(ctx);
+error_after_init_tiers:
+    rrdeng_exit_tiers(ctx);
+error_after_init_shards:
+    rrdeng_exit_shards(ctx, 0);
     if (ctx != &default_global_ctx) {
         freez(ctx);
         *ctxp = NULL;
     }
-    rrd_stat_atomic_add(&rrdeng_reserved_file_descriptors, -RRDENG_FD_BUDGET_PER_INSTANCE);
-    return UV_EIO;
+    return error;
+}
+
+/*
+ * Initializes an instance shared by many hosts. Since it has a single page cache and disk space quota, the hosts
+ * that collect more metrics get more of them, and the oldest datafiles of all hosts are deleted first.
+ * Returns 0 on success, negative on error
+ */
+int rrdeng_init_multihost(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb,
+                          unsigned disk_space_mb)
+{
+    int error;
+
+    error = rrdeng_init(ctxp, dbfiles_path, page_cache_mb, disk_space_mb);
+    if (!error)
+        (*ctxp)->multihost = 1;
+    return error;
 }
 
 /*
@@ -568,24 +1398,18 @@ error_after_init_rrd_files:
  */
 int rrdeng_exit(struct rrdengine_instance *ctx)
 {
-    struct rrdeng_cmd cmd;
-
     if (NULL == ctx) {
         return 1;
     }
 
     /* TODO: add page to page cache */
-    cmd.opcode = RRDENG_SHUTDOWN;
-    rrdeng_enq_cmd(&ctx->worker_config, &cmd);
-
-    assert(0 == uv_thread_join(&ctx->worker_config.thread));
-
-    finalize_rrd_files(ctx);
-    free_page_cache(ctx);
+    metricdir_exit(ctx);
+    rrdeng_exit_classes(ctx);
+    rrdeng_exit_tiers(ctx);
+    rrdeng_exit_shards(ctx, 0);
 
     if (ctx != &default_global_ctx) {
         freez(ctx);
     }
-    rrd_stat_atomic_add(&rrdeng_reserved_file_descriptors, -RRDENG_FD_BUDGET_PER_INSTANCE);
     return 0;
-}
\ No newline at end of file
+}
@@ -3,17 +3,81 @@
 #ifndef NETDATA_RRDENGINEAPI_H
 #define NETDATA_RRDENGINEAPI_H
 
+/* storage tiers are numbered like the tiers of datafiles, tier 1 stores metrics at full resolution */
+#define RRDENG_MAX_TIERS (3)
+#define RRDENG_TIER_DIR_PREFIX "tier-"
+
+/* retention classes are numbered from 1, the first class is the instance itself */
+#define RRDENG_MAX_RETENTION_CLASSES (4)
+#define RRDENG_CLASS_DIR_PREFIX "class-"
+
+/* NUMA nodes the page cache can be allocated from */
+#define RRDENG_MAX_NUMA_NODES (8)
+
 #include "rrdengine.h"
 
+/* Forward declarations */
+struct rrdeng_page_summary;
+
 #define RRDENG_MIN_PAGE_CACHE_SIZE_MB (32)
 #define RRDENG_MIN_DISK_SPACE_MB (256)
 
-#define RRDENG_NR_STATS (33)
+#define RRDENG_NR_STATS (38)
 
 #define RRDENG_FD_BUDGET_PER_INSTANCE (50)
 
+/* the series every higher storage tier keeps per metric, one point per tier interval */
+#define RRDENG_ROLLUP_MIN       (0)
+#define RRDENG_ROLLUP_MAX       (1)
+#define RRDENG_ROLLUP_SUM       (2)
+#define RRDENG_ROLLUP_COUNT     (3)
+#define RRDENG_ROLLUP_SERIES    (4)
+
+/* the series of a rollup tier are interleaved in small pages, so that few points are lost if the agent crashes */
+#define RRDENG_ROLLUP_PAGE_POINTS   (64)
+#define RRDENG_ROLLUP_PAGE_SIZE     (RRDENG_ROLLUP_PAGE_POINTS * RRDENG_ROLLUP_SERIES * sizeof(storage_number))
+
 extern int default_rrdeng_page_cache_mb;
 extern int default_rrdeng_disk_quota_mb;
+extern int default_rrdeng_workers;
+extern int default_rrdeng_storage_tiers;
+extern int default_rrdeng_io_uring;
+extern int default_rrdeng_retention_classes;
+extern int default_rrdeng_retention_class;
+extern int default_rrdeng_class_disk_quota_mb[RRDENG_MAX_RETENTION_CLASSES];
+extern int default_rrdeng_compaction_threshold;
+extern int default_rrdeng_dirty_page_ratio;
+extern int default_rrdeng_page_cache_node_share[RRDENG_MAX_NUMA_NODES];
+extern int default_rrdeng_multihost;
+extern int default_rrdeng_checksum_crc32c;
+extern int default_rrdeng_multihost_page_cache_mb;
+extern int default_rrdeng_multihost_disk_quota_mb;
+
+/* aggregates the points of a metric that fall in the current interval of a higher storage tier */
+struct rrdeng_rollup_tier {
+    unsigned tier;
+    time_t interval;
+    time_t interval_end; /* the interval being aggregated is (interval_end - interval, interval_end] */
+    calculated_number min, max, sum;
+    uint32_t count;
+    size_t page_alignment;
+    struct rrdeng_collect_handle handle; /* every point of its pages has RRDENG_ROLLUP_SERIES numbers */
+};
+
+struct rrdeng_rollup_handle {
+    unsigned nr_tiers;
+    struct rrdeng_rollup_tier tiers[RRDENG_MAX_TIERS - 1];
+};
+
+/* the dimensions of a chart whose pages are preloaded together, see rrdeng_load_chart_init() */
+struct rrdeng_chart_query {
+    unsigned nr_dims;
+    struct rrdeng_chart_query_dim {
+        RRDDIM *rd; /* NULL when the dimension is not loaded */
+        usec_t preloaded_until;
+        uint8_t scan;
+    } dims[];
+};
 
 extern void *rrdeng_create_page(struct rrdengine_instance *ctx, uuid_t *id, struct rrdeng_page_descr **ret_descr);
 extern void rrdeng_commit_page(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr,
@@ -25,18 +89,35 @@ extern void rrdeng_store_metric_init(RRDDIM *rd);
 extern void rrdeng_store_metric_flush_current_page(RRDDIM *rd);
 extern void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number number);
 extern void rrdeng_store_metric_finalize(RRDDIM *rd);
+extern void rrdeng_delete_metric(RRDDIM *rd);
 extern void rrdeng_load_metric_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle,
                                     time_t start_time, time_t end_time);
+extern struct rrdeng_chart_query *rrdeng_load_chart_init(RRDDIM **rds, unsigned nr_dims, time_t start_time,
+                                                         time_t end_time);
+extern void rrdeng_load_chart_metric_init(struct rrdeng_chart_query *chart_query, unsigned dim,
+                                          struct rrddim_query_handle *rrdimm_handle, time_t start_time,
+                                          time_t end_time);
+extern void rrdeng_load_chart_finalize(struct rrdeng_chart_query *chart_query);
 extern storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle);
+extern size_t rrdeng_load_metric_next_many(struct rrddim_query_handle *rrdimm_handle, storage_number *numbers,
+                                           size_t entries);
+extern unsigned rrdeng_load_metric_next_summary(struct rrddim_query_handle *rrdimm_handle, time_t end_time,
+                                                struct rrdeng_page_summary *summary);
 extern int rrdeng_load_metric_is_finished(struct rrddim_query_handle *rrdimm_handle);
 extern void rrdeng_load_metric_finalize(struct rrddim_query_handle *rrdimm_handle);
 extern time_t rrdeng_metric_latest_time(RRDDIM *rd);
 extern time_t rrdeng_metric_oldest_time(RRDDIM *rd);
-extern void rrdeng_get_33_statistics(struct rrdengine_instance *ctx, unsigned long long *array);
+extern unsigned rrdeng_pick_rollup_tier(RRDDIM *rd, time_t group_duration, time_t *interval);
+extern void rrdeng_load_rollup_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle, unsigned tier,
+                                    unsigned series, time_t start_time, time_t end_time);
+extern time_t rrdeng_rollup_latest_time(RRDDIM *rd, unsigned tier);
+extern void rrdeng_get_38_statistics(struct rrdengine_instance *ctx, unsigned long long *array);
 
 /* must call once before using anything */
 extern int rrdeng_init(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb,
                        unsigned disk_space_mb);
+extern int rrdeng_init_multihost(struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb,
+                                 unsigned disk_space_mb);
 
 extern int rrdeng_exit(struct rrdengine_instance *ctx);
 
@@ -1,8 +1,123 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 #include "rrdengine.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HW_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_HW_ARM 1
+#endif
+
 #define BUFSIZE (512)
 
+/*
+ * CRC32C (Castagnoli) of the files of format version 4 and later. It is computed 8 bytes at a time with the CRC32
+ * instructions of SSE 4.2 or ARMv8 when the CPU has them, and with slicing-by-8 tables otherwise.
+ */
+#define CRC32C_POLY (0x82F63B78U) /* reflected */
+
+static uint32_t crc32c_table[8][256];
+static uint32_t (*crc32c_update)(uint32_t crc, const uint8_t *p, size_t len);
+
+static uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t word;
+
+    for ( ; len && ((uintptr_t)p & 7) ; --len)
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    for ( ; len >= 8 ; len -= 8, p += 8) {
+        memcpy(&word, p, sizeof(word));
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xff] ^
+              crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^
+              crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^
+              crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^
+              crc32c_table[0][word >> 56];
+    }
+    for ( ; len ; --len)
+        crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(CRC32C_HW_X86)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t word, crc64;
+
+    for ( ; len && ((uintptr_t)p & 7) ; --len)
+        crc = _mm_crc32_u8(crc, *p++);
+    for (crc64 = crc ; len >= 8 ; len -= 8, p += 8) {
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    for (crc = (uint32_t)crc64 ; len ; --len)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#elif defined(CRC32C_HW_ARM)
+static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+    uint64_t word;
+
+    for ( ; len && ((uintptr_t)p & 7) ; --len)
+        crc = __crc32cb(crc, *p++);
+    for ( ; len >= 8 ; len -= 8, p += 8) {
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+    for ( ; len ; --len)
+        crc = __crc32cb(crc, *p++);
+    return crc;
+}
+#endif
+
+/* Picks the implementation of CRC32C, it must be called before any instance starts */
+void crc32c_init(void)
+{
+    uint32_t crc;
+    unsigned i, j;
+
+    if (crc32c_update)
+        return;
+
+    for (i = 0 ; i < 256 ; ++i) {
+        crc = i;
+        for (j = 0 ; j < 8 ; ++j)
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        crc32c_table[0][i] = crc;
+    }
+    for (i = 0 ; i < 256 ; ++i) {
+        for (j = 1 ; j < 8 ; ++j)
+            crc32c_table[j][i] = crc32c_table[0][crc32c_table[j - 1][i] & 0xff] ^ (crc32c_table[j - 1][i] >> 8);
+    }
+
+    crc32c_update = crc32c_update_sw;
+#if defined(CRC32C_HW_X86)
+    if (__builtin_cpu_supports("sse4.2"))
+        crc32c_update = crc32c_update_hw;
+#elif defined(CRC32C_HW_ARM)
+    crc32c_update = crc32c_update_hw;
+#endif
+    info("DB engine computes CRC32C checksums with %s.",
+         (crc32c_update == crc32c_update_sw) ? "lookup tables" : "CPU instructions");
+}
+
+uint32_t crc32c(const void *buf, size_t len)
+{
+    return ~crc32c_update(~0U, buf, len);
+}
+
+/* Returns the format version of the data and journal files that are created */
+unsigned rrdeng_new_file_version(void)
+{
+    return default_rrdeng_checksum_crc32c ? DATAFILE_VERSION : 3;
+}
+
 /* Caller must hold descriptor lock */
 void print_page_cache_descr(struct rrdeng_page_descr *descr)
 {
@@ -16,8 +131,8 @@ void print_page_cache_descr(struct rrdeng_page_descr *descr)
                                     "--->len:%"PRIu32" time:%"PRIu64"->%"PRIu64" xt_offset:",
                     pg_cache_descr->page, uuid_str,
                     descr->page_length,
-                    (uint64_t)descr->start_time,
-                    (uint64_t)descr->end_time);
+                    (uint64_t)pg_descr_start_time(descr),
+                    (uint64_t)pg_descr_end_time(descr));
     if (!descr->extent) {
         pos += snprintfz(str + pos, BUFSIZE - pos, "N/A");
     } else {
@@ -39,8 +154,8 @@ void print_page_descr(struct rrdeng_page_descr *descr)
                                      "--->len:%"PRIu32" time:%"PRIu64"->%"PRIu64" xt_offset:",
                      uuid_str,
                      descr->page_length,
-                     (uint64_t)descr->start_time,
-                     (uint64_t)descr->end_time);
+                     (uint64_t)pg_descr_start_time(descr),
+                     (uint64_t)pg_descr_end_time(descr));
     if (!descr->extent) {
         pos += snprintfz(str + pos, BUFSIZE - pos, "N/A");
     } else {
@@ -50,6 +165,22 @@ void print_page_descr(struct rrdeng_page_descr *descr)
     fputs(str, stderr);
 }
 
+/* Converts page descriptors of version 1 and 2 files to the current format, their pages are not summarized */
+void convert_extent_page_descr_v2(struct rrdeng_extent_page_descr *dst, struct rrdeng_extent_page_descr_v2 *src,
+                                  unsigned count)
+{
+    unsigned i;
+
+    for (i = 0 ; i < count ; ++i) {
+        (void) memset(&dst[i], 0, sizeof(dst[i]));
+        dst[i].type = src[i].type;
+        (void) memcpy(dst[i].uuid, src[i].uuid, sizeof(dst[i].uuid));
+        dst[i].page_length = src[i].page_length;
+        dst[i].start_time = src[i].start_time;
+        dst[i].end_time = src[i].end_time;
+    }
+}
+
 int check_file_properties(uv_file file, uint64_t *file_size, size_t min_size)
 {
     int ret;
@@ -153,7 +284,17 @@ char *get_rrdeng_statistics(struct rrdengine_instance *ctx, char *str, size_t si
               "datafile_creations: %ld\n"
               "datafile_deletions: %ld\n"
               "journalfile_creations: %ld\n"
-              "journalfile_deletions: %ld\n",
+              "journalfile_deletions: %ld\n"
+              "cmd_queue_depth: %ld\n"
+              "cmd_queue_producer_stalls: %ld\n"
+              "extent_cache_hits: %ld\n"
+              "xor_compressed_extents: %ld\n"
+              "io_uring_submissions: %ld\n"
+              "compacted_pages: %ld\n"
+              "datafile_compactions: %ld\n"
+              "dirty_pages_target: %ld\n"
+              "writeback_pages: %ld\n"
+              "writeback_forced_flushes: %ld\n",
               (long)ctx->stats.metric_API_producers,
               (long)ctx->stats.metric_API_consumers,
               (long)pg_cache->page_descriptors,
@@ -181,7 +322,17 @@ char *get_rrdeng_statistics(struct rrdengine_instance *ctx, char *str, size_t si
               (long)ctx->stats.datafile_creations,
               (long)ctx->stats.datafile_deletions,
               (long)ctx->stats.journalfile_creations,
-              (long)ctx->stats.journalfile_deletions
+              (long)ctx->stats.journalfile_deletions,
+              (long)rrdeng_cmd_queue_depth(&ctx->worker_config),
+              (long)ctx->stats.cmd_queue_producer_stalls,
+              (long)ctx->stats.extent_cache_hits,
+              (long)ctx->stats.xor_compressed_extents,
+              (long)ctx->stats.io_uring_submissions,
+              (long)ctx->stats.compacted_pages,
+              (long)ctx->stats.datafile_compactions,
+              (long)ctx->dirty_pages_target,
+              (long)ctx->stats.writeback_pages,
+              (long)ctx->stats.writeback_forced_flushes
     );
     return str;
 }
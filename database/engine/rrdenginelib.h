@@ -92,10 +92,24 @@ static inline void crc32set(void *crcp, uLong crc)
     *(uint32_t *)crcp = crc;
 }
 
+extern void crc32c_init(void);
+extern uint32_t crc32c(const void *buf, size_t len);
+extern unsigned rrdeng_new_file_version(void);
+
+/* Returns the checksum of the extents and the transactions of the files of the format version */
+static inline uLong rrdeng_checksum(unsigned version, const void *buf, size_t len)
+{
+    if (version >= 4)
+        return crc32c(buf, len);
+    return crc32(crc32(0L, Z_NULL, 0), buf, len);
+}
+
 extern void print_page_cache_descr(struct rrdeng_page_descr *page_cache_descr);
 extern void print_page_descr(struct rrdeng_page_descr *descr);
 extern int check_file_properties(uv_file file, uint64_t *file_size, size_t min_size);
 extern int open_file_direct_io(char *path, int flags, uv_file *file);
 extern char *get_rrdeng_statistics(struct rrdengine_instance *ctx, char *str, size_t size);
+extern void convert_extent_page_descr_v2(struct rrdeng_extent_page_descr *dst,
+                                        struct rrdeng_extent_page_descr_v2 *src, unsigned count);
 
 #endif /* NETDATA_RRDENGINELIB_H */
\ No newline at end of file
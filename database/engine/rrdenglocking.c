@@ -1,15 +1,24 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 #include "rrdengine.h"
 
+/* page cache descriptors come and go with every page that enters and leaves the page cache */
+#define PG_CACHE_DESCR_SLAB_CHUNK_ENTRIES (1024)
+
+static struct rrdeng_slab pg_cache_descr_slab = RRDENG_SLAB_INITIALIZER(RRDENG_SLAB_PG_CACHE_DESCR,
+                                                                        sizeof(struct page_cache_descr),
+                                                                        PG_CACHE_DESCR_SLAB_CHUNK_ENTRIES);
+
 struct page_cache_descr *rrdeng_create_pg_cache_descr(struct rrdengine_instance *ctx)
 {
     struct page_cache_descr *pg_cache_descr;
 
-    pg_cache_descr = mallocz(sizeof(*pg_cache_descr));
+    pg_cache_descr = rrdeng_slab_alloc(&pg_cache_descr_slab);
     rrd_stat_atomic_add(&ctx->stats.page_cache_descriptors, 1);
     pg_cache_descr->page = NULL;
+    pg_cache_descr->node = RRDENG_NUMA_NODE_NONE;
     pg_cache_descr->flags = 0;
     pg_cache_descr->prev = pg_cache_descr->next = NULL;
+    pg_cache_descr->referenced = 0;
     pg_cache_descr->refcnt = 0;
     pg_cache_descr->waiters = 0;
     assert(0 == uv_cond_init(&pg_cache_descr->cond));
@@ -22,7 +31,7 @@ void rrdeng_destroy_pg_cache_descr(struct rrdengine_instance *ctx, struct page_c
 {
     uv_cond_destroy(&pg_cache_descr->cond);
     uv_mutex_destroy(&pg_cache_descr->mutex);
-    freez(pg_cache_descr);
+    rrdeng_slab_free(&pg_cache_descr_slab, pg_cache_descr);
     rrd_stat_atomic_add(&ctx->stats.page_cache_descriptors, -1);
 }
 
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "rrdengine.h"
+
+#include <sys/mman.h>
+#ifdef HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#define RRDENG_SLAB_ALIGNMENT (16)
+
+struct rrdeng_slab_thread_cache {
+    struct rrdeng_slab *slab; /* NULL until the thread uses the slab */
+    unsigned count;
+    void *objects[RRDENG_SLAB_THREAD_CACHE];
+};
+
+/* the caches of all slabs of the calling thread, they go back to their slabs when the thread exits */
+static __thread struct rrdeng_slab_thread_cache *thread_caches = NULL;
+static pthread_key_t thread_caches_key;
+static pthread_once_t thread_caches_once = PTHREAD_ONCE_INIT;
+
+void rrdeng_slab_init(struct rrdeng_slab *slab, enum rrdeng_slab_id id, size_t object_size, unsigned chunk_objects,
+                      int node)
+{
+    assert(id < RRDENG_MAX_SLABS && object_size >= sizeof(void *));
+    netdata_mutex_init(&slab->mutex);
+    slab->free_objects = NULL;
+    slab->id = id;
+    slab->object_size = object_size;
+    slab->chunk_objects = chunk_objects;
+    slab->node = node;
+    slab->nr_objects = 0;
+    slab->nr_free_objects = 0;
+}
+
+/* The caller must hold the slab lock */
+static void rrdeng_slab_grow_unsafe(struct rrdeng_slab *slab)
+{
+    size_t stride, chunk_size;
+    char *chunk;
+    unsigned i;
+
+    stride = ((slab->object_size + RRDENG_SLAB_ALIGNMENT - 1) / RRDENG_SLAB_ALIGNMENT) * RRDENG_SLAB_ALIGNMENT;
+    chunk_size = ALIGN_BYTES_CEILING(stride * slab->chunk_objects);
+    chunk = mmap(NULL, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (unlikely(MAP_FAILED == chunk))
+        fatal("DBENGINE: cannot allocate %zu bytes for slab %u.", chunk_size, (unsigned)slab->id);
+#if defined(HAVE_LINUX_MEMPOLICY_H) && defined(__NR_mbind)
+    if (slab->node >= 0) {
+        unsigned long nodemask = 1UL << slab->node;
+
+        /* the memory is preferred, not bound, to the node so that a full node does not make the agent fail */
+        if (syscall(__NR_mbind, chunk, chunk_size, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8, 0))
+            error("DBENGINE: cannot bind the memory of slab %u to NUMA node %d.", (unsigned)slab->id, slab->node);
+    }
+#endif
+    /* also faults in the memory of the chunk, on its node */
+    for (i = 0 ; i < slab->chunk_objects ; ++i) {
+        *(void **)(chunk + i * stride) = slab->free_objects;
+        slab->free_objects = chunk + i * stride;
+    }
+    slab->nr_objects += slab->chunk_objects;
+    slab->nr_free_objects += slab->chunk_objects;
+}
+
+static void rrdeng_slab_thread_exit(void *ptr)
+{
+    struct rrdeng_slab_thread_cache *caches = ptr, *cache;
+    struct rrdeng_slab *slab;
+    unsigned i;
+    void *object;
+
+    for (i = 0 ; i < RRDENG_MAX_SLABS ; ++i) {
+        cache = &caches[i];
+        slab = cache->slab;
+        if (NULL == slab || !cache->count)
+            continue;
+        netdata_mutex_lock(&slab->mutex);
+        while (cache->count) {
+            object = cache->objects[--cache->count];
+            *(void **)object = slab->free_objects;
+            slab->free_objects = object;
+            ++slab->nr_free_objects;
+        }
+        netdata_mutex_unlock(&slab->mutex);
+    }
+    freez(caches);
+    thread_caches = NULL;
+}
+
+static void rrdeng_slab_thread_caches_key_init(void)
+{
+    assert(0 == pthread_key_create(&thread_caches_key, rrdeng_slab_thread_exit));
+}
+
+static inline struct rrdeng_slab_thread_cache *rrdeng_slab_thread_cache(struct rrdeng_slab *slab)
+{
+    struct rrdeng_slab_thread_cache *cache;
+
+    if (unlikely(NULL == thread_caches)) {
+        assert(0 == pthread_once(&thread_caches_once, rrdeng_slab_thread_caches_key_init));
+        thread_caches = callocz(RRDENG_MAX_SLABS, sizeof(*thread_caches));
+        assert(0 == pthread_setspecific(thread_caches_key, thread_caches));
+    }
+    cache = &thread_caches[slab->id];
+    if (unlikely(NULL == cache->slab))
+        cache->slab = slab;
+    assert(cache->slab == slab);
+
+    return cache;
+}
+
+void *rrdeng_slab_alloc(struct rrdeng_slab *slab)
+{
+    struct rrdeng_slab_thread_cache *cache = rrdeng_slab_thread_cache(slab);
+    void *object;
+
+    if (unlikely(!cache->count)) {
+        netdata_mutex_lock(&slab->mutex);
+        while (cache->count < RRDENG_SLAB_BATCH) {
+            if (unlikely(NULL == slab->free_objects))
+                rrdeng_slab_grow_unsafe(slab);
+            object = slab->free_objects;
+            slab->free_objects = *(void **)object;
+            --slab->nr_free_objects;
+            cache->objects[cache->count++] = object;
+        }
+        netdata_mutex_unlock(&slab->mutex);
+    }
+    return cache->objects[--cache->count];
+}
+
+void rrdeng_slab_free(struct rrdeng_slab *slab, void *object)
+{
+    struct rrdeng_slab_thread_cache *cache = rrdeng_slab_thread_cache(slab);
+    void *free_object;
+
+    if (unlikely(RRDENG_SLAB_THREAD_CACHE == cache->count)) {
+        netdata_mutex_lock(&slab->mutex);
+        while (cache->count > RRDENG_SLAB_THREAD_CACHE - RRDENG_SLAB_BATCH) {
+            free_object = cache->objects[--cache->count];
+            *(void **)free_object = slab->free_objects;
+            slab->free_objects = free_object;
+            ++slab->nr_free_objects;
+        }
+        netdata_mutex_unlock(&slab->mutex);
+    }
+    cache->objects[cache->count++] = object;
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_RRDENGSLAB_H
+#define NETDATA_RRDENGSLAB_H
+
+#include "rrdengine.h"
+
+/* the slabs of the DB engine, every slab has its own cache of free objects in every thread that uses it */
+enum rrdeng_slab_id {
+    RRDENG_SLAB_PAGE_DESCR = 0,
+    RRDENG_SLAB_PG_CACHE_DESCR,
+    RRDENG_SLAB_PAGES, /* pages of the page cache when it is not allocated from NUMA node arenas */
+    RRDENG_SLAB_NUMA_PAGES, /* first NUMA node arena, every node has its own slab */
+
+    RRDENG_MAX_SLABS = RRDENG_SLAB_NUMA_PAGES + RRDENG_MAX_NUMA_NODES
+};
+
+#define RRDENG_SLAB_THREAD_CACHE (32) /* free objects that every thread keeps per slab */
+#define RRDENG_SLAB_BATCH (16) /* objects moved between a thread cache and its slab at once */
+
+/*
+ * Fixed size objects carved out of big chunks of memory. Freed objects go to the cache of the freeing thread and
+ * only batches of them move from and to the free list of the slab, so that allocations rarely take its lock.
+ * Chunks are never returned to the system.
+ */
+struct rrdeng_slab {
+    netdata_mutex_t mutex;
+    void *free_objects; /* linked through their first bytes */
+    enum rrdeng_slab_id id;
+    size_t object_size;
+    unsigned chunk_objects;
+    int node; /* NUMA node the chunks are preferred on, -1 for any */
+    unsigned long nr_objects; /* objects of all the chunks, including the ones cached by threads */
+    unsigned long nr_free_objects;
+};
+
+#define RRDENG_SLAB_INITIALIZER(slab_id, size, nr_chunk_objects)                                                 \
+    { .mutex = NETDATA_MUTEX_INITIALIZER, .free_objects = NULL, .id = (slab_id), .object_size = (size),            \
+      .chunk_objects = (nr_chunk_objects), .node = -1, .nr_objects = 0, .nr_free_objects = 0 }
+
+extern void rrdeng_slab_init(struct rrdeng_slab *slab, enum rrdeng_slab_id id, size_t object_size,
+                             unsigned chunk_objects, int node);
+extern void *rrdeng_slab_alloc(struct rrdeng_slab *slab);
+extern void rrdeng_slab_free(struct rrdeng_slab *slab, void *object);
+
+#endif /* NETDATA_RRDENGSLAB_H */
@@ -40,6 +40,8 @@ extern int default_rrd_update_every;
 extern int default_rrd_history_entries;
 extern int gap_when_lost_iterations_above;
 extern time_t rrdset_free_obsolete_time;
+extern time_t rrd_checkpoint_every;
+extern int rrd_save_threads;
 
 #define RRD_ID_LENGTH_MAX 200
 
@@ -86,6 +88,9 @@ typedef enum rrd_memory_mode {
 #define RRD_MEMORY_MODE_DBENGINE_NAME "dbengine"
 
 extern RRD_MEMORY_MODE default_rrd_memory_mode;
+extern int default_rrd_map_packed;
+extern int default_rrd_ram_blocked;
+extern int default_rrd_ram_summaries;
 
 extern const char *rrd_memory_mode_name(RRD_MEMORY_MODE id);
 extern RRD_MEMORY_MODE rrd_memory_mode_id(const char *name);
@@ -115,7 +120,7 @@ extern const char *rrd_algorithm_name(RRD_ALGORITHM algorithm);
 struct rrdfamily {
     avl avl;
 
-    const char *family;
+    const char *family;                             // from the string pool
     uint32_t hash_family;
 
     size_t use_count;
@@ -156,12 +161,12 @@ struct rrddim {
     // ------------------------------------------------------------------------
     // binary indexing structures
 
-    avl avl;                                        // the binary index - this has to be first member!
+    avl avl;                                        // not used any more, it keeps the layout of the database files
 
     // ------------------------------------------------------------------------
     // the dimension definition
 
-    const char *id;                                 // the id of this dimension (for internal identification)
+    const char *id;                                 // the id of this dimension (for internal identification), from the string pool
     const char *name;                               // the name of this dimension (as presented to user)
                                                     // this is a pointer to the config structure
                                                     // since the config always has a higher priority
@@ -252,10 +257,34 @@ union rrddim_collect_handle {
         struct pg_cache_page_index *page_index;
         // set to 1 when this dimension is not page aligned with the other dimensions in the chart
         uint8_t unaligned_page;
+        // rollups of the higher storage tiers, NULL when the dimension has none
+        struct rrdeng_rollup_handle *rollup;
     } rrdeng; // state the database engine uses
 #endif
 };
 
+// ----------------------------------------------------------------------------
+// summaries of the values of the dimensions that have their values in memory
+// every summary of the first level summarizes RRDDIM_SUMMARY_FANOUT slots, every
+// summary of the next levels RRDDIM_SUMMARY_FANOUT summaries of the level below
+
+#define RRDDIM_SUMMARY_LEVELS 3
+#define RRDDIM_SUMMARY_SHIFT 4
+#define RRDDIM_SUMMARY_FANOUT (1 << RRDDIM_SUMMARY_SHIFT)
+
+#define RRDDIM_SUMMARY_RESET 0x01           // at least one of the values has the reset flag
+
+struct rrddim_summary {
+    double sum;                             // the sum of the values that exist
+    storage_number min;                     // the values with the smallest and the biggest absolute value,
+    storage_number max;                     // the ones the min and max groupings look for
+    uint32_t count;                         // the number of the values that exist
+    uint8_t flags;                          // RRDDIM_SUMMARY_*
+    uint8_t valid;                          // 1 when the summary matches the values of its slots
+};
+
+struct rrddim_summaries;
+
 // ----------------------------------------------------------------------------
 // iterator state for RRD dimension data queries
 struct rrddim_query_handle {
@@ -273,8 +302,12 @@ struct rrddim_query_handle {
             struct rrdeng_page_descr *descr;
             struct rrdengine_instance *ctx;
             struct pg_cache_page_index *page_index;
+            usec_t preloaded_until; // pages up to this time have already been requested from disk
             time_t now; //TODO: remove now to implement next point iteration
             time_t dt; //TODO: remove dt to implement next point iteration
+            unsigned stride; // storage numbers per point of the pages
+            unsigned offset; // the storage number of every point being loaded
+            uint8_t scan; // the query reads too many pages to keep them cached, see rrdeng_load_handle_setup()
         } rrdeng; // state the database engine uses
 #endif
     };
@@ -282,45 +315,72 @@ struct rrddim_query_handle {
 
 
 // ----------------------------------------------------------------------------
-// volatile state per RRD dimension
-struct rrddim_volatile {
-#ifdef ENABLE_DBENGINE
-    uuid_t *rrdeng_uuid;                 // database engine metric UUID
-#endif
-    union rrddim_collect_handle handle;
-    // ------------------------------------------------------------------------
-    // function pointers that handle data collection
-    struct rrddim_collect_ops {
-        // an initialization function to run before starting collection
-        void (*init)(RRDDIM *rd);
+// function pointers that handle data collection
+struct rrddim_collect_ops {
+    // an initialization function to run before starting collection
+    void (*init)(RRDDIM *rd);
 
-        // run this to store each metric into the database
-        void (*store_metric)(RRDDIM *rd, usec_t point_in_time, storage_number number);
+    // run this to store each metric into the database
+    void (*store_metric)(RRDDIM *rd, usec_t point_in_time, storage_number number);
+
+    // an finalization function to run after collection is over
+    void (*finalize)(RRDDIM *rd);
+};
 
-        // an finalization function to run after collection is over
-        void (*finalize)(RRDDIM *rd);
-    } collect_ops;
+// function pointers that handle database queries
+struct rrddim_query_ops {
+    // run this before starting a series of next_metric() database queries
+    void (*init)(RRDDIM *rd, struct rrddim_query_handle *handle, time_t start_time, time_t end_time);
 
-    // function pointers that handle database queries
-    struct rrddim_query_ops {
-        // run this before starting a series of next_metric() database queries
-        void (*init)(RRDDIM *rd, struct rrddim_query_handle *handle, time_t start_time, time_t end_time);
+    // run this to load each metric number from the database
+    storage_number (*next_metric)(struct rrddim_query_handle *handle);
 
-        // run this to load each metric number from the database
-        storage_number (*next_metric)(struct rrddim_query_handle *handle);
+    // run this to load up to entries consecutive metric numbers at once, like that many next_metric() calls
+    // it may load fewer, at the end of a storage block or page - it returns how many it loaded
+    size_t (*next_metrics)(struct rrddim_query_handle *handle, storage_number *numbers, size_t entries);
 
-        // run this to test if the series of next_metric() database queries is finished
-        int (*is_finished)(struct rrddim_query_handle *handle);
+    // run this to test if the series of next_metric() database queries is finished
+    int (*is_finished)(struct rrddim_query_handle *handle);
 
-        // run this after finishing a series of load_metric() database queries
-        void (*finalize)(struct rrddim_query_handle *handle);
+    // run this after finishing a series of load_metric() database queries
+    void (*finalize)(struct rrddim_query_handle *handle);
 
-        // get the timestamp of the last entry of this metric
-        time_t (*latest_time)(RRDDIM *rd);
+    // get the timestamp of the last entry of this metric
+    time_t (*latest_time)(RRDDIM *rd);
 
-        // get the timestamp of the first entry of this metric
-        time_t (*oldest_time)(RRDDIM *rd);
-    } query_ops;
+    // get the timestamp of the first entry of this metric
+    time_t (*oldest_time)(RRDDIM *rd);
+};
+
+// ----------------------------------------------------------------------------
+// volatile state per RRD dimension
+// the last value of a dimension a backend has sent, for the backends that send only the values that change
+struct rrddim_backend_value {
+    calculated_number value;
+    time_t sent;                         // when it was sent, 0 when it has not been sent yet
+};
+
+struct rrddim_volatile {
+#ifdef ENABLE_DBENGINE
+    uuid_t *rrdeng_uuid;                 // database engine metric UUID
+#endif
+    struct rrdmap_file *map_file;        // the packed map file of the dimension, NULL when it has a file of its own
+    long column;                         // the column of the dimension in the blocks of its chart, -1 when
+                                         // its values are in rd->values
+    size_t rrdpush_index;                // the position of the dimension in the definition of its chart
+                                         // last sent upstream, for the binary streaming protocol
+    calculated_number rrdpush_sum;       // the values collected since the last one sent upstream, for the
+    collected_number rrdpush_max;        // charts that are streamed at a lower frequency than they are
+    size_t rrdpush_count;                // collected
+    struct rrddim_summaries *summaries;  // the summaries of the values, NULL when they are not kept
+    struct rrddim_backend_value *backend_values; // by backend index, NULL until a backend sends only the changed values
+    time_t saved_time;                   // the last update of the chart saved to the file of the dimension,
+                                         // 0 when the whole file has to be saved (memory mode = save)
+    union rrddim_collect_handle handle;
+
+    // the functions of the storage of the dimension, shared by all the dimensions with the same storage
+    const struct rrddim_collect_ops *collect_ops;
+    const struct rrddim_query_ops *query_ops;
 };
 
 // ----------------------------------------------------------------------------
@@ -356,7 +416,10 @@ typedef enum rrdset_flags {
     RRDSET_FLAG_HOMOGENEOUS_CHECK   = 1 << 11, // if set, the chart should be checked to determine if the dimensions are homogeneous
     RRDSET_FLAG_HIDDEN              = 1 << 12, // if set, do not show this chart on the dashboard, but use it for backends
     RRDSET_FLAG_SYNC_CLOCK          = 1 << 13, // if set, microseconds on next data collection will be ignored (the chart will be synced to now)
-    RRDSET_FLAG_OBSOLETE_DIMENSIONS = 1 << 14  // this is marked by the collector/module when a chart has obsolete dimensions
+    RRDSET_FLAG_OBSOLETE_DIMENSIONS = 1 << 14, // this is marked by the collector/module when a chart has obsolete dimensions
+    RRDSET_FLAG_REPLICATING         = 1 << 15, // if set, the slave is sending the values it stored while not connected (streaming)
+    RRDSET_FLAG_REPLICATED          = 1 << 16, // if set, the values of this chart have been replicated on this connection (streaming)
+    RRDSET_FLAG_PENDING_HEALTH_LINK = 1 << 17  // if set, the health thread has not linked the alarms to this chart yet
 } RRDSET_FLAGS;
 
 #ifdef HAVE_C___ATOMIC
@@ -370,13 +433,20 @@ typedef enum rrdset_flags {
 #endif
 #define rrdset_flag_check_noatomic(st, flag) ((st)->flags & (flag))
 
-struct rrdset {
-    // ------------------------------------------------------------------------
-    // binary indexing structures
-
-    avl avl;                                        // the index, with key the id - this has to be first!
-    avl avlname;                                    // the index, with key the name
+// the parts of the JSON of a chart that change only when its definition changes
+// it is never modified: when the definition changes a new one replaces it, and the old one
+// is freed when the readers that may have found it are gone (see rrdhost_json_read_lock())
+typedef struct rrdset_json_snapshot {
+    size_t generation;                              // the json_generation of the chart it has been generated for
+    size_t split;                                   // the offset of the part after the first and last entries
+    size_t dimensions;                              // the dimensions in it
+    unsigned long memory;                           // the memory of the chart and the dimensions in it
+    struct rrdset_json_snapshot *next;              // in the list of the replaced ones of the host
+    size_t len;
+    char json[];
+} RRDSET_JSON_SNAPSHOT;
 
+struct rrdset {
     // ------------------------------------------------------------------------
     // the set configuration
 
@@ -429,13 +499,35 @@ struct rrdset {
 
     time_t last_accessed_time;                      // the last time this RRDSET has been accessed
     time_t upstream_resync_time;                    // the timestamp up to which we should resync clock upstream
+    size_t upstream_id;                             // the number of the chart in the binary streaming protocol, 0 = not assigned
+    uint32_t upstream_definition_hash;              // the hash of the definition the remote netdata has, 0 = unknown
+    int upstream_update_every;                      // the update frequency of the chart in the definition sent upstream
+    time_t upstream_next_time;                      // when the chart is streamed downsampled, the collection time
+                                                    // the next point is sent at
+    usec_t upstream_usec;                           // and the microseconds its values have been collected over
+    time_t replicate_after;                         // the values replicated from the slave have to be after this timestamp
 
     char *plugin_name;                              // the name of the plugin that generated this
     char *module_name;                              // the name of the plugin module that generated this
 
-    size_t unused[5];
+    size_t unused[2];
+
+    struct rrdset_prometheus_names *prometheus_names; // the names and labels of the metrics of the chart, for prometheus
+    struct rrdset_blocks *blocks;                   // the values of the dimensions, when they are column-blocked
+    struct rrdset_store_batch *store_batch;         // the values rrdset_done() packs at once
+
+    struct rrdset_cost {                            // the cost of maintaining the chart, for /api/v1/costly_charts
+        size_t collections;                         // the times rrdset_done() has been called since the chart was created
+        usec_t done_usec;                           // the time spent in rrdset_done()
+        size_t pushed_bytes;                        // the bytes of the chart queued for streaming
+        size_t backend_metrics;                     // the metrics of the chart copied for the backends
+    } cost;
+
+    size_t json_generation;                         // incremented every time the definition of the chart changes
+    RRDSET_JSON_SNAPSHOT *json_snapshot;            // the last one generated, read without locks
 
     size_t rrddim_page_alignment;                   // keeps metric pages in alignment when using dbengine
+    unsigned rrdeng_retention_class;                // the dbengine retention class the chart is stored in
 
     uint32_t hash;                                  // a simple hash on the id, to speed up searching
                                                     // we first compare hashes, and only if the hashes are equal we do string comparisons
@@ -464,6 +556,7 @@ struct rrdset {
     avl_tree_lock rrdvar_root_index;                // RRDVAR index for this chart
     RRDSETVAR *variables;                           // RRDSETVAR linked list for this chart (one RRDSETVAR, many RRDVARs)
     RRDCALC *alarms;                                // RRDCALC linked list for this chart
+    volatile time_t alarms_due;                     // wake up health when a point at or after this time is stored
 
     // ------------------------------------------------------------------------
     // members for checking the data when loading from disk
@@ -475,11 +568,41 @@ struct rrdset {
     // ------------------------------------------------------------------------
     // the dimensions
 
-    avl_tree_lock dimensions_index;                 // the root of the dimensions index
+    HASH_INDEX dimensions_index;                    // the dimensions index (by id)
     RRDDIM *dimensions;                             // the actual data for every dimension
 
 };
 
+// ----------------------------------------------------------------------------
+// RRDSET column-blocked values
+//
+// With memory mode = ram the values of the dimensions of a chart can be stored
+// together, in blocks of RRDSET_BLOCK_SLOTS consecutive slots. In every block
+// each dimension has a column of RRDSET_BLOCK_SLOTS values, one cache line, and
+// the columns of all the dimensions are next to each other. So, a row of the
+// chart is in a few adjacent cache lines, while each dimension can still be read
+// sequentially one cache line at a time.
+
+#define RRDSET_BLOCK_SLOTS 16
+
+struct rrdset_blocks {
+    long columns;                                   // the dimensions every block has room for
+    uint8_t *used;                                  // 1 for the columns given to dimensions
+    storage_number *values;
+};
+
+static inline storage_number *rrdset_blocks_value(struct rrdset_blocks *blocks, long column, long slot) {
+    return &blocks->values[((size_t)(slot / RRDSET_BLOCK_SLOTS) * blocks->columns + column) * RRDSET_BLOCK_SLOTS + slot % RRDSET_BLOCK_SLOTS];
+}
+
+// the value of rd at slot, wherever it is stored
+static inline storage_number *rrddim_slot_value(RRDDIM *rd, long slot) {
+    if(unlikely(rd->state->column >= 0))
+        return rrdset_blocks_value(rd->rrdset->blocks, rd->state->column, slot);
+
+    return &rd->values[slot];
+}
+
 #define rrdset_rdlock(st) netdata_rwlock_rdlock(&((st)->rrdset_rwlock))
 #define rrdset_wrlock(st) netdata_rwlock_wrlock(&((st)->rrdset_rwlock))
 #define rrdset_unlock(st) netdata_rwlock_unlock(&((st)->rrdset_rwlock))
@@ -494,6 +617,20 @@ struct rrdset {
 #define rrdset_foreach_write(st, host) \
     for((st) = (host)->rrdset_root, rrdhost_check_wrlock(host); st ; (st) = (st)->next)
 
+// the charts of the host (or their JSON) have to be generated again
+#define rrdhost_charts_changed(host) __atomic_add_fetch(&(host)->charts_generation, 1, __ATOMIC_RELEASE)
+
+// the definition of the chart changed, after the change is visible to the readers
+#define rrdset_json_changed(st) do { \
+        __atomic_add_fetch(&(st)->json_generation, 1, __ATOMIC_RELEASE); \
+        rrdhost_charts_changed((st)->rrdhost); \
+    } while(0)
+
+// walks the charts of the host between rrdhost_charts_read_lock() and rrdhost_charts_read_unlock(),
+// without the host lock - the charts found are not freed before rrdhost_charts_read_unlock()
+#define rrdset_foreach_lockless(st, host) \
+    for((st) = __atomic_load_n(&(host)->rrdset_root, __ATOMIC_ACQUIRE); st ; (st) = __atomic_load_n(&(st)->next, __ATOMIC_ACQUIRE))
+
 
 // ----------------------------------------------------------------------------
 // RRDHOST flags
@@ -507,6 +644,8 @@ typedef enum rrdhost_flags {
     RRDHOST_FLAG_DELETE_ORPHAN_HOST     = 1 << 2, // delete the entire host when orphan
     RRDHOST_FLAG_BACKEND_SEND           = 1 << 3, // send it to backends
     RRDHOST_FLAG_BACKEND_DONT_SEND      = 1 << 4, // don't send it to backends
+    RRDHOST_FLAG_VARIABLES_INDEXED      = 1 << 5, // the variables of the charts are indexed (the host has alarms)
+    RRDHOST_FLAG_PENDING_HEALTH_LINK    = 1 << 6, // the host has charts not linked to their alarms yet
 } RRDHOST_FLAGS;
 
 #ifdef HAVE_C___ATOMIC
@@ -664,10 +803,33 @@ struct rrdhost {
     SIMPLE_PATTERN *rrdpush_send_charts_matching;   // pattern to match the charts to be sent
 
     // metrics may be collected asynchronously
-    // these synchronize all the threads willing the write to our sending buffer
-    netdata_mutex_t rrdpush_sender_buffer_mutex;    // exclusive access to rrdpush_sender_buffer
+    // every thread appends them to a queue of its own, the sender takes them from all the queues
+    netdata_mutex_t rrdpush_sender_buffer_mutex;    // exclusive access to the list of queues, when it changes
+    struct rrdpush_queue *rrdpush_sender_queues;    // the queues of the threads sending metrics for this host
+    struct rrdpush_queue *rrdpush_sender_dead_queues; // the queues the sender has freed, until the host is freed
+    size_t rrdpush_sender_queues_id;                // the threads check it to know their queues are for this host
+    size_t rrdpush_sender_queued_bytes;             // the bytes in the queues
+    int rrdpush_sender_signaled;                    // 1 when the sender has been signaled and has not run since
     int rrdpush_sender_pipe[2];                     // collector to sender thread signaling
-    BUFFER *rrdpush_sender_buffer;                  // collector fills it, sender sends it
+    BUFFER *rrdpush_sender_buffer;                  // the sender takes the queues here and sends it
+    size_t *rrdpush_sender_record_ends;             // where each record in rrdpush_sender_buffer ends
+    size_t rrdpush_sender_records;
+    size_t rrdpush_sender_records_size;
+    int rrdpush_sender_version;                     // the streaming protocol version agreed with the remote netdata
+    size_t rrdpush_sender_chart_ids;                // the last number given to a chart for the binary streaming protocol
+    struct rrdpush_compressor *rrdpush_sender_compressor; // not NULL when the stream to the remote netdata is compressed
+    BUFFER *rrdpush_sender_compressed;              // the compressed data of rrdpush_sender_buffer, the sender sends it
+    int rrdpush_sender_replication;                 // 1 when the remote netdata asks for the values stored while not connected
+    struct rrdpush_replication *rrdpush_sender_replications; // the charts the remote netdata has asked for
+    BUFFER *rrdpush_sender_requests;                // what the remote netdata has sent, not processed yet
+    volatile int rrdpush_pass_through;              // 1 when the metrics of its slave are sent as they are received
+    volatile int rrdpush_pass_through_reset;        // 1 when the slave has to connect again, to define its charts again
+    uint32_t rrdpush_pass_through_streams;          // the connections of the slave, the records received from each are numbered
+    uint32_t rrdpush_sender_stream;                 // the last connection of the slave the sender has records of
+    int rrdpush_sender_stream_version;              // the streaming protocol version the slave uses on it
+    size_t rrdpush_sender_stream_start;             // where its records start in the pending buffer
+    int rrdpush_sender_stream_complete;             // 1 when the pending buffer has all its records
+    struct rrdpush_mirrors *rrdpush_sender_mirrors; // the other netdata the metrics are sent to at the same time, or NULL
 
 
     // ------------------------------------------------------------------------
@@ -678,16 +840,35 @@ struct rrdhost {
 
     time_t senders_disconnected_time;               // the time the last sender was disconnected
 
+    volatile int rrdpush_receiver_limited;          // 1 when its senders are limited, in stream.conf
+    size_t rrdpush_receiver_shed;                   // the charts and dimensions of its connected senders shed, over the limits
+    usec_t rrdpush_receiver_throttled_ut;           // the time its senders have not been read, over the points per second limit
+
+    time_t obsolete_charts_check_time;              // the last time the obsolete charts were checked for removal
+
     // ------------------------------------------------------------------------
     // health monitoring options
 
     unsigned int health_enabled:1;                  // 1 when this host has health enabled
+    unsigned int health_loaded:1;                   // 1 when the alarms and the alarm log of this host are loaded
     time_t health_delay_up_to;                      // a timestamp to delay alarms processing up to
     char *health_default_exec;                      // the full path of the alarms notifications program
     char *health_default_recipient;                 // the default recipient for all alarms
     char *health_log_filename;                      // the alarms event log filename
     size_t health_log_entries_written;              // the number of alarm events writtern to the alarms event log
     FILE *health_log_fp;                            // the FILE pointer to the open alarms event log file
+    struct health_log_compaction *health_log_compaction; // the running compaction of the alarms event log, or NULL
+    netdata_thread_t health_log_compaction_thread;  // the thread running it
+    uint32_t health_alarms_json_version;            // the version of the last alarm JSON cached
+    uint32_t health_alarms_json_generation;         // the last generation given to /api/v1/alarms
+
+    struct rrdhost_health_alarms_json {             // what /api/v1/alarms and /api/v1/alarms?all last returned
+        uint32_t generation;                        // 0 when never returned
+        uint32_t max_version;                       // the highest version of the alarms JSON included
+        uint32_t count;                             // the number of alarms included
+        uint32_t latest_log_id;
+        int enabled;
+    } health_alarms_json[2];
     uint32_t health_default_warn_repeat_every;      // the default value for the interval between repeating warning notifications
     uint32_t health_default_crit_repeat_every;      // the default value for the interval between repeating critical notifications
 
@@ -714,18 +895,20 @@ struct rrdhost {
     // the charts of the host
 
     RRDSET *rrdset_root;                            // the host charts
+    size_t rrd_memory;                              // the memory of the charts and the dimensions of the host, in bytes
 
 
     // ------------------------------------------------------------------------
     // locks
 
     netdata_rwlock_t rrdhost_rwlock;                // lock for this RRDHOST (protects rrdset_root linked list)
+    netdata_epoch_t rrdset_root_epoch;              // the readers of rrdset_root that do not lock the host
 
     // ------------------------------------------------------------------------
     // indexes
 
-    avl_tree_lock rrdset_root_index;                // the host's charts index (by id)
-    avl_tree_lock rrdset_root_index_name;           // the host's charts index (by name)
+    HASH_INDEX rrdset_root_index;                   // the host's charts index (by id)
+    HASH_INDEX rrdset_root_index_name;              // the host's charts index (by name)
 
     avl_tree_lock rrdfamily_root_index;             // the host's chart families index
     avl_tree_lock rrdvar_root_index;                // the host's chart variables index
@@ -734,6 +917,27 @@ struct rrdhost {
     struct rrdengine_instance *rrdeng_ctx;          // DB engine instance for this host
 #endif
 
+    netdata_mutex_t rrdmap_mutex;                   // protects the packed map files
+    struct rrdmap_file *rrdmap_files;               // the packed map files of the dimensions of this host
+
+    size_t charts_generation;                       // incremented every time a chart is added, removed or changed
+    netdata_mutex_t charts_json_mutex;              // protects charts_json, serializes freeing the replaced json snapshots
+    netdata_epoch_t json_snapshots_epoch;           // the readers of the json snapshots of the charts
+    RRDSET_JSON_SNAPSHOT *json_snapshots_replaced;  // to be freed, when their readers are gone
+    BUFFER *charts_json;                            // the last /api/v1/charts response
+    size_t charts_json_generation;                  // the charts_generation charts_json has been generated for
+    time_t charts_json_time;                        // the time charts_json has been generated
+    size_t charts_json_hosts;                       // the hosts charts_json lists
+
+    netdata_mutex_t prometheus_names_mutex;         // protects the prometheus_names of the charts
+
+    netdata_mutex_t allmetrics_mutex;               // protects the allmetrics snapshots
+    struct rrdhost_allmetrics_snapshot {
+        BUFFER *wb;                                 // the last /api/v1/allmetrics response of the format
+        time_t time;                                // the time it has been generated
+        uint32_t etag;                              // the hash of its contents
+    } allmetrics_shell, allmetrics_json;
+
 #ifdef ENABLE_HTTPS
     struct netdata_ssl ssl;                         //Structure used to encrypt the connection
 #endif
@@ -746,6 +950,36 @@ extern RRDHOST *localhost;
 #define rrdhost_wrlock(host) netdata_rwlock_wrlock(&((host)->rrdhost_rwlock))
 #define rrdhost_unlock(host) netdata_rwlock_unlock(&((host)->rrdhost_rwlock))
 
+// the charts of the host can be read without the host lock, between these two calls
+// the charts are added and removed under the host write lock, and rrdset_free() waits
+// for the readers to finish before it frees an unlinked chart
+static inline unsigned rrdhost_charts_read_lock(RRDHOST *host) {
+    netdata_thread_disable_cancelability();
+    return netdata_epoch_read_lock(&host->rrdset_root_epoch);
+}
+
+static inline void rrdhost_charts_read_unlock(RRDHOST *host, unsigned reader) {
+    netdata_epoch_read_unlock(&host->rrdset_root_epoch, reader);
+    netdata_thread_enable_cancelability();
+}
+
+// the json snapshots of the charts of the host can be used between these two calls
+static inline unsigned rrdhost_json_read_lock(RRDHOST *host) {
+    netdata_thread_disable_cancelability();
+    return netdata_epoch_read_lock(&host->json_snapshots_epoch);
+}
+
+static inline void rrdhost_json_read_unlock(RRDHOST *host, unsigned reader) {
+    netdata_epoch_read_unlock(&host->json_snapshots_epoch, reader);
+    netdata_thread_enable_cancelability();
+}
+
+// a json snapshot has been replaced, it is freed when its readers are gone
+static inline void rrdhost_json_snapshot_replaced(RRDHOST *host, RRDSET_JSON_SNAPSHOT *s) {
+    s->next = __atomic_load_n(&host->json_snapshots_replaced, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(&host->json_snapshots_replaced, &s->next, s, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) ;
+}
+
 // ----------------------------------------------------------------------------
 // these loop macros make sure the linked list is accessed with the right lock
 
@@ -851,6 +1085,7 @@ extern RRDSET *rrdset_create_custom(RRDHOST *host
 extern void rrdhost_free_all(void);
 extern void rrdhost_save_all(void);
 extern void rrdhost_cleanup_all(void);
+extern void *rrd_checkpoint_main(void *ptr);
 
 extern void rrdhost_cleanup_orphan_hosts_nolock(RRDHOST *protected);
 extern void rrdhost_system_info_free(struct rrdhost_system_info *system_info);
@@ -876,9 +1111,16 @@ extern void rrdset_next_usec(RRDSET *st, usec_t microseconds);
 #define rrdset_next(st) rrdset_next_usec(st, 0ULL)
 
 extern void rrdset_done(RRDSET *st);
+extern void rrdset_done_many(RRDSET **charts, size_t count);
+
+// the values a streaming slave stored while it was not connected, see rrdset.c
+extern void rrdset_replay_begin(RRDSET *st, time_t first_t, time_t last_t);
+extern void rrddim_replay_store(RRDDIM *rd, time_t t, storage_number n);
+extern void rrdset_replay_end(RRDSET *st);
 
 extern void rrdset_is_obsolete(RRDSET *st);
 extern void rrdset_isnot_obsolete(RRDSET *st);
+extern void rrdset_set_update_every(RRDSET *st, int update_every);
 
 // checks if the RRDSET should be offered to viewers
 #define rrdset_is_available_for_viewers(st) (rrdset_flag_check(st, RRDSET_FLAG_ENABLED) && !rrdset_flag_check(st, RRDSET_FLAG_HIDDEN) && !rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE) && (st)->dimensions && (st)->rrd_memory_mode != RRD_MEMORY_MODE_NONE)
@@ -895,7 +1137,7 @@ static inline time_t rrdset_last_entry_t(RRDSET *st) {
 
         int ret = netdata_rwlock_tryrdlock(&st->rrdset_rwlock);
         rrddim_foreach_read(rd, st) {
-            last_entry_t = MAX(last_entry_t, rd->state->query_ops.latest_time(rd));
+            last_entry_t = MAX(last_entry_t, rd->state->query_ops->latest_time(rd));
         }
         if(0 == ret) netdata_rwlock_unlock(&st->rrdset_rwlock);
 
@@ -913,7 +1155,7 @@ static inline time_t rrdset_first_entry_t(RRDSET *st) {
 
         int ret = netdata_rwlock_tryrdlock(&st->rrdset_rwlock);
         rrddim_foreach_read(rd, st) {
-            first_entry_t = MIN(first_entry_t, rd->state->query_ops.oldest_time(rd));
+            first_entry_t = MIN(first_entry_t, rd->state->query_ops->oldest_time(rd));
         }
         if(0 == ret) netdata_rwlock_unlock(&st->rrdset_rwlock);
 
@@ -1007,6 +1249,8 @@ static inline time_t rrdset_slot2time(RRDSET *st, size_t slot) {
 // ----------------------------------------------------------------------------
 // RRD DIMENSION functions
 
+extern unsigned rrddim_query_next_summary(struct rrddim_query_handle *handle, long points, struct rrddim_summary *summary);
+
 extern RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collected_number multiplier, collected_number divisor, RRD_ALGORITHM algorithm, RRD_MEMORY_MODE memory_mode);
 #define rrddim_add(st, id, name, multiplier, divisor, algorithm) rrddim_add_custom(st, id, name, multiplier, divisor, algorithm, (st)->rrd_memory_mode)
 
@@ -1045,17 +1289,18 @@ extern char *rrdset_strncpyz_name(char *to, const char *from, size_t length);
 extern char *rrdset_cache_dir(RRDHOST *host, const char *id, const char *config_section);
 
 extern void rrddim_free(RRDSET *st, RRDDIM *rd);
+extern int rrddim_save(RRDDIM *rd);
 
-extern int rrddim_compare(void* a, void* b);
-extern int rrdset_compare(void* a, void* b);
-extern int rrdset_compare_name(void* a, void* b);
+extern int rrddim_equal(void *item, const void *key);
+extern int rrdset_equal(void *item, const void *key);
+extern int rrdset_equal_name(void *item, const void *key);
 extern int rrdfamily_compare(void *a, void *b);
 
 extern RRDFAMILY *rrdfamily_create(RRDHOST *host, const char *id);
 extern void rrdfamily_free(RRDHOST *host, RRDFAMILY *rc);
 
-#define rrdset_index_add(host, st) (RRDSET *)avl_insert_lock(&((host)->rrdset_root_index), (avl *)(st))
-#define rrdset_index_del(host, st) (RRDSET *)avl_remove_lock(&((host)->rrdset_root_index), (avl *)(st))
+#define rrdset_index_add(host, st) (RRDSET *)hash_index_set(&((host)->rrdset_root_index), (st)->hash, (st)->id, (st))
+#define rrdset_index_del(host, st) (RRDSET *)hash_index_del(&((host)->rrdset_root_index), (st)->hash, (st)->id)
 extern RRDSET *rrdset_index_del_name(RRDHOST *host, RRDSET *st);
 
 extern void rrdset_free(RRDSET *st);
@@ -1066,6 +1311,18 @@ extern void rrdset_delete_obsolete_dimensions(RRDSET *st);
 
 extern void rrdhost_cleanup_obsolete_charts(RRDHOST *host);
 
+extern long rrdset_blocks_add_column(RRDSET *st);
+extern void rrdset_blocks_del_column(RRDSET *st, long column);
+extern void rrdset_blocks_free(RRDSET *st);
+
+extern RRDDIM *rrdmap_attach(RRDSET *st, const char *id, unsigned long size, struct rrdmap_file **file, char *filename, size_t filename_length);
+extern void rrdmap_detach(RRDHOST *host, struct rrdmap_file *mf, RRDDIM *rd);
+extern void rrdmap_delete(RRDDIM *rd);
+extern void rrdmap_free_all(RRDHOST *host);
+extern void rrdmap_willneed(RRDDIM *rd, long first, long last);
+
+extern void rrddim_summaries_store(RRDDIM *rd, long slot);
+
 #endif /* NETDATA_RRD_INTERNALS */
 
 // ----------------------------------------------------------------------------
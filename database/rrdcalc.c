@@ -196,6 +196,7 @@ inline void rrdsetcalc_unlink(RRDCALC *rc) {
     rc->hostname = NULL;
 
     rc->rrdset = NULL;
+    rrdcalc_window_free(rc);
 
     // RRDCALC will remain in RRDHOST
     // so that if the matching chart is found in the future
@@ -345,21 +346,10 @@ inline RRDCALC *rrdcalc_create_from_template(RRDHOST *host, RRDCALCTEMPLATE *rt,
     if(rt->units) rc->units = strdupz(rt->units);
     if(rt->info) rc->info = strdupz(rt->info);
 
-    if(rt->calculation) {
-        rc->calculation = expression_parse(rt->calculation->source, NULL, NULL);
-        if(!rc->calculation)
-            error("Health alarm '%s.%s': failed to parse calculation expression '%s'", chart, rt->name, rt->calculation->source);
-    }
-    if(rt->warning) {
-        rc->warning = expression_parse(rt->warning->source, NULL, NULL);
-        if(!rc->warning)
-            error("Health alarm '%s.%s': failed to re-parse warning expression '%s'", chart, rt->name, rt->warning->source);
-    }
-    if(rt->critical) {
-        rc->critical = expression_parse(rt->critical->source, NULL, NULL);
-        if(!rc->critical)
-            error("Health alarm '%s.%s': failed to re-parse critical expression '%s'", chart, rt->name, rt->critical->source);
-    }
+    // the copies share the compiled program of the template
+    rc->calculation = expression_copy(rt->calculation);
+    rc->warning = expression_copy(rt->warning);
+    rc->critical = expression_copy(rt->critical);
 
     debug(D_HEALTH, "Health runtime added alarm '%s.%s': exec '%s', recipient '%s', green " CALCULATED_NUMBER_FORMAT_AUTO ", red " CALCULATED_NUMBER_FORMAT_AUTO ", lookup: group %d, after %d, before %d, options %u, dimensions '%s', update every %d, calculation '%s', warning '%s', critical '%s', source '%s', delay up %d, delay down %d, delay max %d, delay_multiplier %f, warn_repeat_every %u, crit_repeat_every %u",
             (rc->chart)?rc->chart:"NOCHART",
@@ -398,6 +388,8 @@ inline RRDCALC *rrdcalc_create_from_template(RRDHOST *host, RRDCALCTEMPLATE *rt,
 void rrdcalc_free(RRDCALC *rc) {
     if(unlikely(!rc)) return;
 
+    rrdcalc_window_free(rc);
+    health_alarm_json_free(rc);
 
     expression_free(rc->calculation);
     expression_free(rc->warning);
@@ -507,3 +499,234 @@ RRDCALC *alarm_max_last_repeat(RRDHOST *host, char *alarm_name,uint32_t hash) {
 
     return rc;
 }
+
+// ----------------------------------------------------------------------------
+// RRDCALC incremental database lookup
+//
+// Instead of querying the whole lookup window on every evaluation, the running
+// sum and count of the points of each selected dimension are kept, and each
+// evaluation reads from the database only the points that entered the window
+// since the previous one, and the points that left it.
+// This is possible for unaligned lookups ending now, grouped by average or sum,
+// which are most of the alarms. All the others still query the database with
+// rrdset2value_api_v1().
+
+struct rrdcalc_window {
+    int update_every;               // the update frequency of the chart, when the window was created
+    size_t points;                  // the points of the lookup window
+    time_t last_t;                  // the timestamp of the last point added to the sums
+
+    size_t dimensions;              // all the dimensions of the chart, to detect changes
+    RRDDIM **all;
+
+    size_t selected;                // the dimensions the lookup uses
+    RRDDIM **rd;
+    calculated_number *sum;         // per selected dimension, the sum of its non-empty points in the window
+    size_t *count;                  // per selected dimension, the number of its non-empty points in the window
+
+    size_t updates;                 // points added since the sums were last read in full
+};
+
+static inline int rrdcalc_window_is_possible(RRDCALC *rc) {
+    if(rc->after >= 0 || rc->before != 0)
+        return 0;
+
+    if(!(rc->options & RRDR_OPTION_NOT_ALIGNED) || (rc->options & (RRDR_OPTION_PERCENTAGE | RRDR_OPTION_MIN2MAX | RRDR_OPTION_NONZERO)))
+        return 0;
+
+    return (rc->group == RRDR_GROUPING_AVERAGE || rc->group == RRDR_GROUPING_SUM);
+}
+
+void rrdcalc_window_free(RRDCALC *rc) {
+    struct rrdcalc_window *w = rc->window;
+    if(likely(!w)) return;
+
+    freez(w->all);
+    freez(w->rd);
+    freez(w->sum);
+    freez(w->count);
+    freez(w);
+    rc->window = NULL;
+}
+
+static inline int rrdcalc_window_dimensions_changed(struct rrdcalc_window *w, RRDSET *st) {
+    RRDDIM *rd;
+    size_t c = 0;
+
+    rrddim_foreach_read(rd, st) {
+        if(unlikely(c >= w->dimensions || w->all[c] != rd))
+            return 1;
+        c++;
+    }
+
+    return c != w->dimensions;
+}
+
+// select the dimensions the same way rrd2rrdr() does
+static struct rrdcalc_window *rrdcalc_window_create(RRDCALC *rc, RRDSET *st, int update_every, size_t points) {
+    struct rrdcalc_window *w = callocz(1, sizeof(struct rrdcalc_window));
+    w->update_every = update_every;
+    w->points = points;
+
+    const char *dims = rc->dimensions;
+    SIMPLE_PATTERN *pattern = NULL;
+    int match_ids = 1, match_names = 1;
+
+    if(dims && *dims && !(dims[0] == '*' && dims[1] == '\0')) {
+        pattern = simple_pattern_create(dims, ",|\t\r\n\f\v", SIMPLE_PATTERN_EXACT);
+
+        if(rc->options & (RRDR_OPTION_MATCH_IDS | RRDR_OPTION_MATCH_NAMES)) {
+            match_ids = (rc->options & RRDR_OPTION_MATCH_IDS) ? 1 : 0;
+            match_names = (rc->options & RRDR_OPTION_MATCH_NAMES) ? 1 : 0;
+        }
+    }
+
+    RRDDIM *rd;
+    rrddim_foreach_read(rd, st)
+        w->dimensions++;
+
+    w->all = mallocz((w->dimensions + 1) * sizeof(RRDDIM *));
+    w->rd = mallocz((w->dimensions + 1) * sizeof(RRDDIM *));
+
+    size_t c = 0;
+    rrddim_foreach_read(rd, st) {
+        w->all[c++] = rd;
+
+        int selected;
+        if(pattern)
+            selected = (match_ids && simple_pattern_matches(pattern, rd->id)) || (match_names && simple_pattern_matches(pattern, rd->name));
+        else
+            selected = !rrddim_flag_check(rd, RRDDIM_FLAG_HIDDEN);
+
+        if(selected)
+            w->rd[w->selected++] = rd;
+    }
+
+    simple_pattern_free(pattern);
+
+    w->sum = callocz(w->selected + 1, sizeof(calculated_number));
+    w->count = callocz(w->selected + 1, sizeof(size_t));
+
+    return w;
+}
+
+// add (or remove, when remove is set) the points from after to before to the sums
+static void rrdcalc_window_add(struct rrdcalc_window *w, time_t after, time_t before, int remove) {
+    size_t k;
+
+    for(k = 0; k < w->selected ; k++) {
+        RRDDIM *rd = w->rd[k];
+        struct rrddim_query_handle handle;
+        calculated_number sum = 0.0;
+        size_t count = 0;
+        time_t t;
+
+        rd->state->query_ops->init(rd, &handle, after, before);
+        for(t = after; t <= before ; t += w->update_every) {
+            storage_number n = rd->state->query_ops->next_metric(&handle);
+            if(likely(does_storage_number_exist(n))) {
+                sum += unpack_storage_number(n);
+                count++;
+            }
+        }
+        rd->state->query_ops->finalize(&handle);
+
+        if(unlikely(remove)) {
+            w->sum[k] -= sum;
+            w->count[k] -= (count < w->count[k]) ? count : w->count[k];
+        }
+        else {
+            w->sum[k] += sum;
+            w->count[k] += count;
+        }
+    }
+}
+
+// returns 0 when the lookup cannot be done incrementally,
+// otherwise the same return codes as rrdset2value_api_v1()
+int rrdcalc_window_lookup(RRDCALC *rc, calculated_number *value, time_t *db_after, time_t *db_before, int *value_is_null) {
+    RRDSET *st = rc->rrdset;
+
+    if(unlikely(!st || !rrdcalc_window_is_possible(rc))) {
+        rrdcalc_window_free(rc);
+        return 0;
+    }
+
+    // the same rounding rrd2rrdr() does
+    int update_every = st->update_every;
+    long long duration = -rc->after;
+    if(duration % update_every)
+        duration += update_every - duration % update_every;
+
+    size_t points = (size_t)(duration / update_every);
+
+    rrdset_rdlock(st);
+
+    struct rrdcalc_window *w = rc->window;
+    if(unlikely(w && (w->update_every != update_every || w->points != points || rrdcalc_window_dimensions_changed(w, st))))
+        rrdcalc_window_free(rc);
+
+    if(unlikely(!rc->window))
+        rc->window = rrdcalc_window_create(rc, st, update_every, points);
+
+    w = rc->window;
+
+    time_t first_t = rrdset_first_entry_t(st);
+    time_t last_t = rrdset_last_entry_t(st);
+    time_t window_t = (time_t)points * update_every;
+
+    if(unlikely(!last_t || last_t - window_t + update_every < first_t)) {
+        rrdset_unlock(st);
+        *value_is_null = 1;
+        *db_after = *db_before = 0;
+        return 400;
+    }
+
+    if(unlikely(!w->last_t || last_t < w->last_t || last_t - w->last_t >= window_t
+                || w->last_t + update_every - window_t < first_t || w->updates >= w->points)) {
+        // read the whole window, when we have nothing usable,
+        // when the points to be removed are not in the database any more,
+        // or once per window, so that rounding errors do not accumulate
+        size_t k;
+        for(k = 0; k < w->selected ; k++) {
+            w->sum[k] = 0.0;
+            w->count[k] = 0;
+        }
+
+        rrdcalc_window_add(w, last_t - window_t + update_every, last_t, 0);
+        w->updates = 0;
+    }
+    else if(last_t > w->last_t) {
+        rrdcalc_window_add(w, w->last_t + update_every - window_t, last_t - window_t, 1);
+        rrdcalc_window_add(w, w->last_t + update_every, last_t, 0);
+        w->updates += (size_t)((last_t - w->last_t) / update_every);
+    }
+
+    w->last_t = last_t;
+
+    // combine the dimensions, like rrdr2value() does
+    calculated_number total = 0.0;
+    int all_null = 1;
+    size_t k;
+
+    for(k = 0; k < w->selected ; k++) {
+        if(!w->count[k]) continue;
+
+        calculated_number v = (rc->group == RRDR_GROUPING_AVERAGE) ? w->sum[k] / (calculated_number)w->count[k] : w->sum[k];
+
+        if((rc->options & RRDR_OPTION_ABSOLUTE) && v < 0)
+            v = -v;
+
+        total += v;
+        all_null = 0;
+    }
+
+    rrdset_unlock(st);
+
+    *db_after = last_t - window_t + update_every;
+    *db_before = last_t;
+    *value_is_null = all_null;
+    *value = (all_null) ? 0.0 : total;
+
+    return 200;
+}
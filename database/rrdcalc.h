@@ -63,6 +63,17 @@ struct rrdcalc {
     int after;                      // starting point in time-series
     uint32_t options;               // calculation options
 
+    struct rrdcalc_window *window;  // the incremental database lookup, if the lookup allows it
+
+    // the result of the last database lookup, for the alarms of the same chart with the same lookup
+    // settings to use, instead of doing the same lookup again in the same evaluation round
+    time_t lookup_round;            // the evaluation round of the lookup
+    int lookup_ret;                 // its return code
+    int lookup_is_null;             // set when it gave no value
+    calculated_number lookup_value; // its value
+    time_t lookup_after;            // the first timestamp it evaluated
+    time_t lookup_before;           // the last timestamp it evaluated
+
     // ------------------------------------------------------------------------
     // expressions related to the alarm
 
@@ -109,6 +120,8 @@ struct rrdcalc {
     int delay_down_current;         // the current down notification delay duration
     int delay_last;                 // the last delay we used
 
+    struct rrdcalc_json *json;      // the cached JSON of the alarm for /api/v1/alarms
+
     // ------------------------------------------------------------------------
     // variables this alarm exposes to the rest of the alarms
 
@@ -135,6 +148,9 @@ extern RRDCALC *alarm_max_last_repeat(RRDHOST *host, char *alarm_name, uint32_t
 
 #define RRDCALC_HAS_DB_LOOKUP(rc) ((rc)->after)
 
+extern int rrdcalc_window_lookup(RRDCALC *rc, calculated_number *value, time_t *db_after, time_t *db_before, int *value_is_null);
+extern void rrdcalc_window_free(RRDCALC *rc);
+
 extern void rrdsetcalc_link_matching(RRDSET *st);
 extern void rrdsetcalc_unlink(RRDCALC *rc);
 extern RRDCALC *rrdcalc_find(RRDSET *st, const char *name);
@@ -6,21 +6,17 @@
 // ----------------------------------------------------------------------------
 // RRDDIM index
 
-int rrddim_compare(void* a, void* b) {
-    if(((RRDDIM *)a)->hash < ((RRDDIM *)b)->hash) return -1;
-    else if(((RRDDIM *)a)->hash > ((RRDDIM *)b)->hash) return 1;
-    else return strcmp(((RRDDIM *)a)->id, ((RRDDIM *)b)->id);
+// the hash index compares the keys of the dimensions with the same hash
+int rrddim_equal(void *item, const void *key) {
+    // the ids of the dimensions are in the string pool, so the index finds them by pointer when it deletes them
+    return ((RRDDIM *)item)->id == (const char *)key || !strcmp(((RRDDIM *)item)->id, (const char *)key);
 }
 
-#define rrddim_index_add(st, rd) (RRDDIM *)avl_insert_lock(&((st)->dimensions_index), (avl *)(rd))
-#define rrddim_index_del(st,rd ) (RRDDIM *)avl_remove_lock(&((st)->dimensions_index), (avl *)(rd))
+#define rrddim_index_add(st, rd) (RRDDIM *)hash_index_set(&((st)->dimensions_index), (rd)->hash, (rd)->id, (rd))
+#define rrddim_index_del(st,rd ) (RRDDIM *)hash_index_del(&((st)->dimensions_index), (rd)->hash, (rd)->id)
 
 static inline RRDDIM *rrddim_index_find(RRDSET *st, const char *id, uint32_t hash) {
-    RRDDIM tmp = {
-            .id = id,
-            .hash = (hash)?hash:simple_hash(id)
-    };
-    return (RRDDIM *)avl_search_lock(&(st->dimensions_index), (avl *) &tmp);
+    return (RRDDIM *)hash_index_get(&(st->dimensions_index), (hash)?hash:simple_hash(id), id);
 }
 
 
@@ -50,6 +46,7 @@ inline int rrddim_set_name(RRDSET *st, RRDDIM *rd, const char *name) {
     rrddimvar_rename_all(rd);
     rd->exposed = 0;
     rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
+    rrdset_json_changed(st);
     return 1;
 }
 
@@ -89,6 +86,162 @@ inline int rrddim_set_divisor(RRDSET *st, RRDDIM *rd, collected_number divisor)
     return 1;
 }
 
+// ----------------------------------------------------------------------------
+// RRDDIM summaries of the values
+// a summary is valid only while the slots it summarizes keep the values it was
+// calculated from - it is invalidated when one of them is stored and it is
+// calculated again when the last of them is stored
+
+struct rrddim_summaries {
+    size_t memsize;
+    long count[RRDDIM_SUMMARY_LEVELS];                  // the summaries of every level
+    struct rrddim_summary *level[RRDDIM_SUMMARY_LEVELS];
+};
+
+static inline void rrddim_summary_add(struct rrddim_summary *s, storage_number min, storage_number max, double sum, uint32_t count, uint8_t flags) {
+    if(unlikely(!count)) return;
+
+    if(!s->count || calculated_number_fabs(unpack_storage_number(min)) < calculated_number_fabs(unpack_storage_number(s->min))) s->min = min;
+    if(!s->count || calculated_number_fabs(unpack_storage_number(max)) > calculated_number_fabs(unpack_storage_number(s->max))) s->max = max;
+    s->sum += sum;
+    s->count += count;
+    s->flags |= flags;
+}
+
+// calculates summary index of level
+static void rrddim_summary_calculate(RRDDIM *rd, int level, long index) {
+    struct rrddim_summaries *sm = rd->state->summaries;
+    struct rrddim_summary s = { .sum = 0.0, .min = SN_EMPTY_SLOT, .max = SN_EMPTY_SLOT, .count = 0, .flags = 0, .valid = 1 };
+    long first = index << RRDDIM_SUMMARY_SHIFT, end = first + RRDDIM_SUMMARY_FANOUT, i;
+
+    if(!level) {
+        if(end > rd->entries) end = rd->entries;
+
+        for(i = first; i < end ; i++) {
+            storage_number n = *rrddim_slot_value(rd, i);
+            if(likely(does_storage_number_exist(n)))
+                rrddim_summary_add(&s, n, n, unpack_storage_number(n), 1, did_storage_number_reset(n) ? RRDDIM_SUMMARY_RESET : 0);
+        }
+    }
+    else {
+        struct rrddim_summary *below = sm->level[level - 1];
+        if(end > sm->count[level - 1]) end = sm->count[level - 1];
+
+        for(i = first; i < end ; i++) {
+            if(unlikely(!below[i].valid)) {
+                s.valid = 0;
+                break;
+            }
+            rrddim_summary_add(&s, below[i].min, below[i].max, below[i].sum, below[i].count, below[i].flags);
+        }
+    }
+
+    struct rrddim_summary *dst = &sm->level[level][index];
+    dst->sum = s.sum;
+    dst->min = s.min;
+    dst->max = s.max;
+    dst->count = s.count;
+    dst->flags = s.flags;
+    __atomic_store_n(&dst->valid, s.valid, __ATOMIC_RELEASE);
+}
+
+static void rrddim_summaries_create(RRDDIM *rd) {
+    struct rrddim_summaries *sm;
+    long count = rd->entries, total = 0;
+    int level;
+
+    sm = callocz(1, sizeof(struct rrddim_summaries));
+    for(level = 0; level < RRDDIM_SUMMARY_LEVELS ; level++) {
+        count = (count + RRDDIM_SUMMARY_FANOUT - 1) >> RRDDIM_SUMMARY_SHIFT;
+        sm->count[level] = count;
+        total += count;
+    }
+
+    sm->memsize = sizeof(struct rrddim_summaries) + total * sizeof(struct rrddim_summary);
+    sm->level[0] = callocz((size_t)total, sizeof(struct rrddim_summary));
+    for(level = 1; level < RRDDIM_SUMMARY_LEVELS ; level++)
+        sm->level[level] = sm->level[level - 1] + sm->count[level - 1];
+
+    rd->state->summaries = sm;
+
+    // the values of save and map dimensions may have been loaded from disk
+    for(level = 0; level < RRDDIM_SUMMARY_LEVELS ; level++) {
+        long index;
+        for(index = 0; index < sm->count[level] ; index++)
+            rrddim_summary_calculate(rd, level, index);
+    }
+}
+
+static void rrddim_summaries_free(RRDDIM *rd) {
+    struct rrddim_summaries *sm = rd->state->summaries;
+
+    if(likely(!sm)) return;
+
+    freez(sm->level[0]);
+    freez(sm);
+    rd->state->summaries = NULL;
+}
+
+// to be called every time the value of slot is stored
+void rrddim_summaries_store(RRDDIM *rd, long slot) {
+    struct rrddim_summaries *sm = rd->state->summaries;
+    int level;
+
+    for(level = 0; level < RRDDIM_SUMMARY_LEVELS ; level++)
+        __atomic_store_n(&sm->level[level][slot >> (RRDDIM_SUMMARY_SHIFT * (level + 1))].valid, 0, __ATOMIC_RELEASE);
+
+    // the summaries that end at this slot are complete again
+    for(level = 0; level < RRDDIM_SUMMARY_LEVELS ; level++) {
+        long span = 1L << (RRDDIM_SUMMARY_SHIFT * (level + 1));
+
+        if(((slot + 1) & (span - 1)) && slot != rd->entries - 1)
+            break;
+
+        rrddim_summary_calculate(rd, level, slot >> (RRDDIM_SUMMARY_SHIFT * (level + 1)));
+    }
+}
+
+// when a valid summary starts at the next slot of the query and covers at most points
+// slots, copies the biggest one to summary and moves the query after its slots
+// returns the slots of the summary, or 0 when they have to be read one by one
+unsigned rrddim_query_next_summary(struct rrddim_query_handle *handle, long points, struct rrddim_summary *summary) {
+    RRDDIM *rd = handle->rd;
+    struct rrddim_summaries *sm = rd->state->summaries;
+    long entries = rd->rrdset->entries, slot = handle->slotted.slot, last_slot = handle->slotted.last_slot, remaining;
+    int level;
+
+    if(unlikely(!sm || handle->slotted.finished))
+        return 0;
+
+    remaining = (last_slot >= slot) ? last_slot - slot + 1 : entries - slot + last_slot + 1;
+    if(points > remaining) points = remaining;
+
+    for(level = RRDDIM_SUMMARY_LEVELS - 1; level >= 0 ; level--) {
+        long span = 1L << (RRDDIM_SUMMARY_SHIFT * (level + 1));
+
+        // the last summary of a level may cover fewer slots, it is not used
+        if(span > points || (slot & (span - 1)) || slot + span > entries)
+            continue;
+
+        struct rrddim_summary *s = &sm->level[level][slot >> (RRDDIM_SUMMARY_SHIFT * (level + 1))];
+        if(!__atomic_load_n(&s->valid, __ATOMIC_ACQUIRE))
+            continue;
+
+        *summary = *s;
+
+        if(span == remaining)
+            handle->slotted.finished = 1;
+
+        slot += span;
+        if(slot >= entries) slot = 0;
+        handle->slotted.slot = slot;
+
+        return (unsigned)span;
+    }
+
+    return 0;
+}
+
 // ----------------------------------------------------------------------------
 // RRDDIM legacy data collection functions
 
@@ -99,6 +252,8 @@ static void rrddim_collect_store_metric(RRDDIM *rd, usec_t point_in_time, storag
     (void)point_in_time;
 
     rd->values[rd->rrdset->current_entry] = number;
+    if(unlikely(rd->state->summaries))
+        rrddim_summaries_store(rd, rd->rrdset->current_entry);
 }
 static void rrddim_collect_finalize(RRDDIM *rd) {
     (void)rd;
@@ -116,6 +271,9 @@ static void rrddim_query_init(RRDDIM *rd, struct rrddim_query_handle *handle, ti
     handle->slotted.slot = rrdset_time2slot(rd->rrdset, start_time);
     handle->slotted.last_slot = rrdset_time2slot(rd->rrdset, end_time);
     handle->slotted.finished = 0;
+
+    if(rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)
+        rrdmap_willneed(rd, handle->slotted.slot, handle->slotted.last_slot);
 }
 
 static storage_number rrddim_query_next_metric(struct rrddim_query_handle *handle) {
@@ -133,6 +291,27 @@ static storage_number rrddim_query_next_metric(struct rrddim_query_handle *handl
     return n;
 }
 
+static size_t rrddim_query_next_metrics(struct rrddim_query_handle *handle, storage_number *numbers, size_t entries) {
+    RRDDIM *rd = handle->rd;
+    long slot = handle->slotted.slot;
+
+    // up to the last slot of the query or the end of the ring, whichever comes first
+    long end = (handle->slotted.last_slot >= slot) ? handle->slotted.last_slot + 1 : rd->rrdset->entries;
+    size_t count = (size_t)(end - slot);
+    if(count > entries) count = entries;
+
+    memcpy(numbers, &rd->values[slot], count * sizeof(storage_number));
+
+    slot += (long)count;
+    if(unlikely(slot - 1 == handle->slotted.last_slot))
+        handle->slotted.finished = 1;
+
+    if(unlikely(slot >= rd->rrdset->entries)) slot = 0;
+    handle->slotted.slot = slot;
+
+    return count;
+}
+
 static int rrddim_query_is_finished(struct rrddim_query_handle *handle) {
     return handle->slotted.finished;
 }
@@ -151,6 +330,118 @@ static time_t rrddim_query_oldest_time(RRDDIM *rd) {
     return rrdset_first_entry_t(rd->rrdset);
 }
 
+// ----------------------------------------------------------------------------
+// RRDDIM column-blocked data collection and query functions
+// the rest are the legacy ones, only the location of the values differs
+
+static void rrddim_blocks_collect_init(RRDDIM *rd) {
+    *rrdset_blocks_value(rd->rrdset->blocks, rd->state->column, rd->rrdset->current_entry) = SN_EMPTY_SLOT;
+}
+static void rrddim_blocks_collect_store_metric(RRDDIM *rd, usec_t point_in_time, storage_number number) {
+    (void)point_in_time;
+
+    *rrdset_blocks_value(rd->rrdset->blocks, rd->state->column, rd->rrdset->current_entry) = number;
+    if(unlikely(rd->state->summaries))
+        rrddim_summaries_store(rd, rd->rrdset->current_entry);
+}
+
+static storage_number rrddim_blocks_query_next_metric(struct rrddim_query_handle *handle) {
+    RRDDIM *rd = handle->rd;
+    long entries = rd->rrdset->entries;
+    long slot = handle->slotted.slot;
+
+    if (unlikely(handle->slotted.slot == handle->slotted.last_slot))
+        handle->slotted.finished = 1;
+    storage_number n = *rrdset_blocks_value(rd->rrdset->blocks, rd->state->column, slot++);
+
+    if(unlikely(slot >= entries)) slot = 0;
+    handle->slotted.slot = slot;
+
+    return n;
+}
+
+static size_t rrddim_blocks_query_next_metrics(struct rrddim_query_handle *handle, storage_number *numbers, size_t entries) {
+    RRDDIM *rd = handle->rd;
+    long slot = handle->slotted.slot;
+
+    // the slots of a column are consecutive only up to the end of their block
+    long end = (handle->slotted.last_slot >= slot) ? handle->slotted.last_slot + 1 : rd->rrdset->entries;
+    long block_end = (slot / RRDSET_BLOCK_SLOTS + 1) * RRDSET_BLOCK_SLOTS;
+    if(end > block_end) end = block_end;
+
+    size_t count = (size_t)(end - slot);
+    if(count > entries) count = entries;
+
+    memcpy(numbers, rrdset_blocks_value(rd->rrdset->blocks, rd->state->column, slot), count * sizeof(storage_number));
+
+    slot += (long)count;
+    if(unlikely(slot - 1 == handle->slotted.last_slot))
+        handle->slotted.finished = 1;
+
+    if(unlikely(slot >= rd->rrdset->entries)) slot = 0;
+    handle->slotted.slot = slot;
+
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+// RRDDIM storage functions, shared by all the dimensions with the same storage
+
+static const struct rrddim_collect_ops rrddim_collect_ops = {
+        .init         = rrddim_collect_init,
+        .store_metric = rrddim_collect_store_metric,
+        .finalize     = rrddim_collect_finalize
+};
+
+static const struct rrddim_query_ops rrddim_query_ops = {
+        .init         = rrddim_query_init,
+        .next_metric  = rrddim_query_next_metric,
+        .next_metrics = rrddim_query_next_metrics,
+        .is_finished  = rrddim_query_is_finished,
+        .finalize     = rrddim_query_finalize,
+        .latest_time  = rrddim_query_latest_time,
+        .oldest_time  = rrddim_query_oldest_time
+};
+
+static const struct rrddim_collect_ops rrddim_blocks_collect_ops = {
+        .init         = rrddim_blocks_collect_init,
+        .store_metric = rrddim_blocks_collect_store_metric,
+        .finalize     = rrddim_collect_finalize
+};
+
+static const struct rrddim_query_ops rrddim_blocks_query_ops = {
+        .init         = rrddim_query_init,
+        .next_metric  = rrddim_blocks_query_next_metric,
+        .next_metrics = rrddim_blocks_query_next_metrics,
+        .is_finished  = rrddim_query_is_finished,
+        .finalize     = rrddim_query_finalize,
+        .latest_time  = rrddim_query_latest_time,
+        .oldest_time  = rrddim_query_oldest_time
+};
+
+#ifdef ENABLE_DBENGINE
+static const struct rrddim_collect_ops rrdeng_collect_ops = {
+        .init         = rrdeng_store_metric_init,
+        .store_metric = rrdeng_store_metric_next,
+        .finalize     = rrdeng_store_metric_finalize
+};
+
+static const struct rrddim_query_ops rrdeng_query_ops = {
+        .init         = rrdeng_load_metric_init,
+        .next_metric  = rrdeng_load_metric_next,
+        .next_metrics = rrdeng_load_metric_next_many,
+        .is_finished  = rrdeng_load_metric_is_finished,
+        .finalize     = rrdeng_load_metric_finalize,
+        .latest_time  = rrdeng_metric_latest_time,
+        .oldest_time  = rrdeng_metric_oldest_time
+};
+#endif
+
+// the memory of the dimension, as accounted to its host
+static inline size_t rrddim_memory(RRDDIM *rd) {
+    return rd->memsize + sizeof(struct rrddim_volatile) + (rd->cache_filename ? strlen(rd->cache_filename) + 1 : 0)
+           + (rd->state->summaries ? rd->state->summaries->memsize : 0);
+}
 
 // ----------------------------------------------------------------------------
 // RRDDIM create a dimension
@@ -179,7 +470,15 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
     char fullfilename[FILENAME_MAX + 1];
 
     char varname[CONFIG_MAX_NAME + 1];
-    unsigned long size = sizeof(RRDDIM) + (st->entries * sizeof(storage_number));
+    int blocked = (memory_mode == RRD_MEMORY_MODE_RAM && default_rrd_ram_blocked);
+
+    // the values of the dbengine dimensions are in the database engine, so they are allocated
+    // without values, from the heap - a memory map would take at least a page per dimension
+    int dbengine = (memory_mode == RRD_MEMORY_MODE_DBENGINE);
+
+    unsigned long size = sizeof(RRDDIM) + ((blocked || dbengine) ? 0 : st->entries * sizeof(storage_number));
+    struct rrdmap_file *map_file = NULL;
+    int loaded = 0;
 
     debug(D_RRD_CALLS, "Adding dimension '%s/%s'.", st->id, id);
 
@@ -187,13 +486,17 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
     snprintfz(fullfilename, FILENAME_MAX, "%s/%s.db", st->cache_dir, filename);
 
     if(memory_mode == RRD_MEMORY_MODE_SAVE || memory_mode == RRD_MEMORY_MODE_MAP ||
-       memory_mode == RRD_MEMORY_MODE_RAM || memory_mode == RRD_MEMORY_MODE_DBENGINE) {
-        rd = (RRDDIM *)mymmap(
-                  (memory_mode == RRD_MEMORY_MODE_RAM || memory_mode == RRD_MEMORY_MODE_DBENGINE)?NULL:fullfilename
-                , size
-                , ((memory_mode == RRD_MEMORY_MODE_MAP) ? MAP_SHARED : MAP_PRIVATE)
-                , 1
-        );
+       memory_mode == RRD_MEMORY_MODE_RAM) {
+        if(memory_mode == RRD_MEMORY_MODE_MAP && default_rrd_map_packed)
+            rd = rrdmap_attach(st, id, size, &map_file, fullfilename, FILENAME_MAX);
+
+        if(!rd)
+            rd = (RRDDIM *)mymmap(
+                      (memory_mode == RRD_MEMORY_MODE_RAM)?NULL:fullfilename
+                    , size
+                    , ((memory_mode == RRD_MEMORY_MODE_MAP) ? MAP_SHARED : MAP_PRIVATE)
+                    , 1
+            );
 
         if(likely(rd)) {
             // we have a file mapped for rd
@@ -210,7 +513,7 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
             struct timeval now;
             now_realtime_timeval(&now);
 
-            if(memory_mode == RRD_MEMORY_MODE_RAM || memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+            if(memory_mode == RRD_MEMORY_MODE_RAM) {
                 memset(rd, 0, size);
             }
             else {
@@ -237,6 +540,9 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
                     reset = 1;
                 }
 
+                // the values in memory are the ones in the file
+                loaded = (!reset && memory_mode == RRD_MEMORY_MODE_SAVE);
+
                 if(!reset) {
                     if(rd->algorithm != algorithm) {
                         info("File %s does not have the expected algorithm (expected %u '%s', found %u '%s'). Previous values may be wrong.",
@@ -262,17 +568,17 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
     if(unlikely(!rd)) {
         // if we didn't manage to get a mmap'd dimension, just create one
         rd = callocz(1, size);
-        rd->rrd_memory_mode = (memory_mode == RRD_MEMORY_MODE_NONE) ? RRD_MEMORY_MODE_NONE : RRD_MEMORY_MODE_ALLOC;
+        rd->rrd_memory_mode = (memory_mode == RRD_MEMORY_MODE_NONE || dbengine) ? memory_mode : RRD_MEMORY_MODE_ALLOC;
     }
 
     rd->memsize = size;
 
     strcpy(rd->magic, RRDDIMENSION_MAGIC);
 
-    rd->id = strdupz(id);
+    rd->id = string_pool_get(id);
     rd->hash = simple_hash(rd->id);
 
-    rd->cache_filename = strdupz(fullfilename);
+    rd->cache_filename = dbengine ? NULL : strdupz(fullfilename);
 
     snprintfz(varname, CONFIG_MAX_NAME, "dim %s name", rd->id);
     rd->name = config_get(st->config_section, varname, (name && *name)?name:rd->id);
@@ -311,30 +617,30 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
     rd->last_collected_time.tv_usec = 0;
     rd->rrdset = st;
     rd->state = mallocz(sizeof(*rd->state));
+    rd->state->map_file = map_file;
+    rd->state->column = -1;
+    rd->state->summaries = NULL;
+    rd->state->backend_values = NULL;
+    rd->state->rrdpush_index = 0;
+    rd->state->saved_time = loaded ? st->last_updated.tv_sec : 0;
     if(memory_mode == RRD_MEMORY_MODE_DBENGINE) {
 #ifdef ENABLE_DBENGINE
-        rd->state->collect_ops.init         = rrdeng_store_metric_init;
-        rd->state->collect_ops.store_metric = rrdeng_store_metric_next;
-        rd->state->collect_ops.finalize     = rrdeng_store_metric_finalize;
-        rd->state->query_ops.init           = rrdeng_load_metric_init;
-        rd->state->query_ops.next_metric    = rrdeng_load_metric_next;
-        rd->state->query_ops.is_finished    = rrdeng_load_metric_is_finished;
-        rd->state->query_ops.finalize       = rrdeng_load_metric_finalize;
-        rd->state->query_ops.latest_time    = rrdeng_metric_latest_time;
-        rd->state->query_ops.oldest_time    = rrdeng_metric_oldest_time;
+        rd->state->collect_ops = &rrdeng_collect_ops;
+        rd->state->query_ops   = &rrdeng_query_ops;
 #endif
-    } else {
-        rd->state->collect_ops.init         = rrddim_collect_init;
-        rd->state->collect_ops.store_metric = rrddim_collect_store_metric;
-        rd->state->collect_ops.finalize     = rrddim_collect_finalize;
-        rd->state->query_ops.init           = rrddim_query_init;
-        rd->state->query_ops.next_metric    = rrddim_query_next_metric;
-        rd->state->query_ops.is_finished    = rrddim_query_is_finished;
-        rd->state->query_ops.finalize       = rrddim_query_finalize;
-        rd->state->query_ops.latest_time    = rrddim_query_latest_time;
-        rd->state->query_ops.oldest_time    = rrddim_query_oldest_time;
     }
-    rd->state->collect_ops.init(rd);
+    else if(blocked) {
+        rd->state->column      = rrdset_blocks_add_column(st);
+        rd->state->collect_ops = &rrddim_blocks_collect_ops;
+        rd->state->query_ops   = &rrddim_blocks_query_ops;
+    }
+    else {
+        rd->state->collect_ops = &rrddim_collect_ops;
+        rd->state->query_ops   = &rrddim_query_ops;
+    }
+    rd->state->collect_ops->init(rd);
+    if(default_rrd_ram_summaries && !dbengine && memory_mode != RRD_MEMORY_MODE_NONE)
+        rrddim_summaries_create(rd);
     // append this dimension
     if(!st->dimensions)
         st->dimensions = rd;
@@ -370,10 +676,70 @@ RRDDIM *rrddim_add_custom(RRDSET *st, const char *id, const char *name, collecte
     if(unlikely(rrddim_index_add(st, rd) != rd))
         error("RRDDIM: INTERNAL ERROR: attempt to index duplicate dimension '%s' on chart '%s'", rd->id, st->id);
 
+    __atomic_add_fetch(&host->rrd_memory, rrddim_memory(rd), __ATOMIC_RELAXED);
+
     rrdset_unlock(st);
+    rrdset_json_changed(st);
     return(rd);
 }
 
+// ----------------------------------------------------------------------------
+// RRDDIM save a dimension (memory mode = save)
+
+// Saves the dimension to its file. Only the first save of a dimension writes
+// the whole file. The next ones write its header and the values stored since
+// the last save (the slots between rd->state->saved_time and the last update
+// of the chart), in place.
+// The caller should have a read lock on the chart.
+int rrddim_save(RRDDIM *rd) {
+    RRDSET *st = rd->rrdset;
+
+    time_t last_updated = st->last_updated.tv_sec;
+    time_t saved_time = rd->state->saved_time;
+    long entries = rd->entries, current_entry = st->current_entry;
+    long dirty = entries;
+
+    if(saved_time && last_updated >= saved_time && st->update_every > 0)
+        dirty = (long)((last_updated - saved_time) / st->update_every) + 1;
+
+    int fd = -1;
+    if(dirty < entries && current_entry < entries)
+        fd = open(rd->cache_filename, O_WRONLY | O_NOATIME);
+
+    if(fd == -1) {
+        debug(D_RRD_STATS, "Saving dimension '%s' to '%s'.", rd->name, rd->cache_filename);
+
+        if(memory_file_save(rd->cache_filename, rd, rd->memsize) == -1)
+            return -1;
+
+        rd->state->saved_time = last_updated;
+        return 0;
+    }
+
+    debug(D_RRD_STATS, "Saving %ld values of dimension '%s' to '%s'.", dirty, rd->name, rd->cache_filename);
+
+    // the dirty slots end at the current entry, and may wrap around
+    long first = current_entry - dirty;
+    if(first < 0) first += entries;
+
+    ssize_t header = (ssize_t)offsetof(RRDDIM, values);
+    ssize_t len1 = (ssize_t)(((first + dirty <= entries) ? dirty : entries - first) * sizeof(storage_number));
+    ssize_t len2 = (ssize_t)(dirty * sizeof(storage_number)) - len1;
+
+    int ret = 0;
+    if(pwrite(fd, rd, header, 0) != header ||
+       pwrite(fd, &rd->values[first], len1, header + first * sizeof(storage_number)) != len1 ||
+       (len2 && pwrite(fd, &rd->values[0], len2, header) != len2)) {
+        error("Cannot save dimension '%s' to '%s'.", rd->name, rd->cache_filename);
+        ret = -1;
+    }
+    else
+        rd->state->saved_time = last_updated;
+
+    close(fd);
+    return ret;
+}
+
 // ----------------------------------------------------------------------------
 // RRDDIM remove / free a dimension
 
@@ -381,7 +747,15 @@ void rrddim_free(RRDSET *st, RRDDIM *rd)
 {
     debug(D_RRD_CALLS, "rrddim_free() %s.%s", st->name, rd->name);
 
-    rd->state->collect_ops.finalize(rd);
+    struct rrdmap_file *map_file = rd->state->map_file;
+
+    __atomic_sub_fetch(&st->rrdhost->rrd_memory, rrddim_memory(rd), __ATOMIC_RELAXED);
+
+    rd->state->collect_ops->finalize(rd);
+    if(rd->state->column >= 0)
+        rrdset_blocks_del_column(st, rd->state->column);
+    rrddim_summaries_free(rd);
+    freez(rd->state->backend_values);
     freez(rd->state);
 
     if(rd == st->dimensions)
@@ -403,23 +777,28 @@ void rrddim_free(RRDSET *st, RRDDIM *rd)
     if(unlikely(rrddim_index_del(st, rd) != rd))
         error("RRDDIM: INTERNAL ERROR: attempt to remove from index dimension '%s' on chart '%s', removed a different dimension.", rd->id, st->id);
 
+    rrdset_json_changed(st);
+
     // free(rd->annotations);
 
     switch(rd->rrd_memory_mode) {
         case RRD_MEMORY_MODE_SAVE:
         case RRD_MEMORY_MODE_MAP:
         case RRD_MEMORY_MODE_RAM:
-        case RRD_MEMORY_MODE_DBENGINE:
             debug(D_RRD_CALLS, "Unmapping dimension '%s'.", rd->name);
-            freez((void *)rd->id);
+            string_pool_release(rd->id);
             freez(rd->cache_filename);
-            munmap(rd, rd->memsize);
+            if(map_file)
+                rrdmap_detach(st->rrdhost, map_file, rd);
+            else
+                munmap(rd, rd->memsize);
             break;
 
         case RRD_MEMORY_MODE_ALLOC:
         case RRD_MEMORY_MODE_NONE:
+        case RRD_MEMORY_MODE_DBENGINE:
             debug(D_RRD_CALLS, "Removing dimension '%s'.", rd->name);
-            freez((void *)rd->id);
+            string_pool_release(rd->id);
             freez(rd->cache_filename);
             freez(rd);
             break;
@@ -441,7 +820,10 @@ int rrddim_hide(RRDSET *st, const char *id) {
         return 1;
     }
 
-    rrddim_flag_set(rd, RRDDIM_FLAG_HIDDEN);
+    if(!rrddim_flag_check(rd, RRDDIM_FLAG_HIDDEN)) {
+        rrddim_flag_set(rd, RRDDIM_FLAG_HIDDEN);
+        rrdset_json_changed(st);
+    }
     return 0;
 }
 
@@ -455,21 +837,30 @@ int rrddim_unhide(RRDSET *st, const char *id) {
         return 1;
     }
 
-    rrddim_flag_clear(rd, RRDDIM_FLAG_HIDDEN);
+    if(rrddim_flag_check(rd, RRDDIM_FLAG_HIDDEN)) {
+        rrddim_flag_clear(rd, RRDDIM_FLAG_HIDDEN);
+        rrdset_json_changed(st);
+    }
     return 0;
 }
 
 inline void rrddim_is_obsolete(RRDSET *st, RRDDIM *rd) {
     debug(D_RRD_CALLS, "rrddim_is_obsolete() for chart %s, dimension %s", st->name, rd->name);
 
-    rrddim_flag_set(rd, RRDDIM_FLAG_OBSOLETE);
+    if(!rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
+        rrddim_flag_set(rd, RRDDIM_FLAG_OBSOLETE);
+        rrdset_json_changed(st);
+    }
     rrdset_flag_set(st, RRDSET_FLAG_OBSOLETE_DIMENSIONS);
 }
 
 inline void rrddim_isnot_obsolete(RRDSET *st, RRDDIM *rd) {
     debug(D_RRD_CALLS, "rrddim_isnot_obsolete() for chart %s, dimension %s", st->name, rd->name);
 
-    rrddim_flag_clear(rd, RRDDIM_FLAG_OBSOLETE);
+    if(rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
+        rrddim_flag_clear(rd, RRDDIM_FLAG_OBSOLETE);
+        rrdset_json_changed(st);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -153,7 +153,6 @@ static inline void rrddimvar_create_variables(RRDDIMVAR *rs) {
 
 RRDDIMVAR *rrddimvar_create(RRDDIM *rd, RRDVAR_TYPE type, const char *prefix, const char *suffix, void *value, RRDVAR_OPTIONS options) {
     RRDSET *st = rd->rrdset;
-    (void)st;
 
     debug(D_VARIABLES, "RRDDIMSET create for chart id '%s' name '%s', dimension id '%s', name '%s%s%s'", st->id, st->name, rd->id, (prefix)?prefix:"", rd->name, (suffix)?suffix:"");
 
@@ -173,17 +172,28 @@ RRDDIMVAR *rrddimvar_create(RRDDIM *rd, RRDVAR_TYPE type, const char *prefix, co
     rs->next = rd->variables;
     rd->variables = rs;
 
-    rrddimvar_create_variables(rs);
+    // indexed later, if the host gets any alarms
+    if(rrdhost_flag_check(st->rrdhost, RRDHOST_FLAG_VARIABLES_INDEXED))
+        rrddimvar_create_variables(rs);
 
     return rs;
 }
 
+void rrddimvar_index_all(RRDDIM *rd) {
+    RRDDIMVAR *rs;
+    for(rs = rd->variables; rs ; rs = rs->next)
+        if(!rs->key_id)
+            rrddimvar_create_variables(rs);
+}
+
 void rrddimvar_rename_all(RRDDIM *rd) {
     RRDSET *st = rd->rrdset;
-    (void)st;
 
     debug(D_VARIABLES, "RRDDIMSET rename for chart id '%s' name '%s', dimension id '%s', name '%s'", st->id, st->name, rd->id, rd->name);
 
+    if(!rrdhost_flag_check(st->rrdhost, RRDHOST_FLAG_VARIABLES_INDEXED))
+        return;
+
     RRDDIMVAR *rs, *next = rd->variables;
     while((rs = next)) {
         next = rs->next;
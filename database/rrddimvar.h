@@ -48,6 +48,7 @@ struct rrddimvar {
 
 
 extern void rrddimvar_rename_all(RRDDIM *rd);
+extern void rrddimvar_index_all(RRDDIM *rd);
 extern RRDDIMVAR *rrddimvar_create(RRDDIM *rd, RRDVAR_TYPE type, const char *prefix, const char *suffix, void *value, RRDVAR_OPTIONS options);
 extern void rrddimvar_free(RRDDIMVAR *rs);
 
@@ -9,6 +9,7 @@
 int rrdfamily_compare(void *a, void *b) {
     if(((RRDFAMILY *)a)->hash_family < ((RRDFAMILY *)b)->hash_family) return -1;
     else if(((RRDFAMILY *)a)->hash_family > ((RRDFAMILY *)b)->hash_family) return 1;
+    else if(((RRDFAMILY *)a)->family == ((RRDFAMILY *)b)->family) return 0;
     else return strcmp(((RRDFAMILY *)a)->family, ((RRDFAMILY *)b)->family);
 }
 
@@ -28,7 +29,7 @@ RRDFAMILY *rrdfamily_create(RRDHOST *host, const char *id) {
     if(!rc) {
         rc = callocz(1, sizeof(RRDFAMILY));
 
-        rc->family = strdupz(id);
+        rc->family = string_pool_get(id);
         rc->hash_family = simple_hash(rc->family);
 
         // initialize the variables index
@@ -53,7 +54,7 @@ void rrdfamily_free(RRDHOST *host, RRDFAMILY *rc) {
             debug(D_RRD_CALLS, "RRDFAMILY: Cleaning up remaining family variables for host '%s', family '%s'", host->hostname, rc->family);
             rrdvar_free_remaining_variables(host, &rc->rrdvar_root_index);
 
-            freez((void *) rc->family);
+            string_pool_release(rc->family);
             freez(rc);
         }
     }
@@ -9,6 +9,8 @@ netdata_rwlock_t rrd_rwlock = NETDATA_RWLOCK_INITIALIZER;
 
 time_t rrdset_free_obsolete_time = 3600;
 time_t rrdhost_free_orphan_time = 3600;
+time_t rrd_checkpoint_every = 3600;
+int rrd_save_threads = 0;
 
 // ----------------------------------------------------------------------------
 // RRDHOST index
@@ -106,6 +108,39 @@ static inline void rrdhost_init_machine_guid(RRDHOST *host, const char *machine_
 // ----------------------------------------------------------------------------
 // RRDHOST - add a host
 
+#ifdef ENABLE_DBENGINE
+// ----------------------------------------------------------------------------
+// RRDHOST - the dbengine instance shared by the children
+//
+// With dbengine multihost enabled, the hosts streamed to this one do not start
+// an instance each, with its own threads, page cache and files. They all store
+// their metrics in a single instance, started by the first of them, so that
+// the busiest of them get more of its page cache and its disk space.
+
+static struct rrdengine_instance *rrdeng_multihost_ctx = NULL;
+
+// the caller must hold the rrd write lock
+static struct rrdengine_instance *rrdhost_multihost_dbengine(void) {
+    static int failed = 0;
+
+    if(unlikely(!rrdeng_multihost_ctx && !failed)) {
+        char dbenginepath[FILENAME_MAX + 1];
+
+        snprintfz(dbenginepath, FILENAME_MAX, "%s/dbengine-multihost", netdata_configured_cache_dir);
+        int ret = mkdir(dbenginepath, 0775);
+        if(ret != 0 && errno != EEXIST)
+            error("Cannot create directory '%s'", dbenginepath);
+        else if(!rrdeng_init_multihost(&rrdeng_multihost_ctx, dbenginepath, (unsigned)default_rrdeng_multihost_page_cache_mb, (unsigned)default_rrdeng_multihost_disk_quota_mb))
+            info("Started the DB engine instance shared by the children, at '%s'", dbenginepath);
+
+        // do not try again for every child
+        failed = (rrdeng_multihost_ctx == NULL);
+    }
+
+    return rrdeng_multihost_ctx;
+}
+#endif
+
 RRDHOST *rrdhost_create(const char *hostname,
                         const char *registry_hostname,
                         const char *guid,
@@ -154,6 +189,10 @@ RRDHOST *rrdhost_create(const char *hostname,
 
     netdata_mutex_init(&host->rrdpush_sender_buffer_mutex);
     netdata_rwlock_init(&host->rrdhost_rwlock);
+    netdata_mutex_init(&host->rrdmap_mutex);
+    netdata_mutex_init(&host->charts_json_mutex);
+    netdata_mutex_init(&host->prometheus_names_mutex);
+    netdata_mutex_init(&host->allmetrics_mutex);
 
     rrdhost_init_hostname(host, hostname);
     rrdhost_init_machine_guid(host, guid);
@@ -168,8 +207,10 @@ RRDHOST *rrdhost_create(const char *hostname,
 
     host->system_info = system_info;
 
-    avl_init_lock(&(host->rrdset_root_index),      rrdset_compare);
-    avl_init_lock(&(host->rrdset_root_index_name), rrdset_compare_name);
+    netdata_epoch_init(&host->rrdset_root_epoch);
+    netdata_epoch_init(&host->json_snapshots_epoch);
+    hash_index_init(&(host->rrdset_root_index),      rrdset_equal);
+    hash_index_init(&(host->rrdset_root_index_name), rrdset_equal_name);
     avl_init_lock(&(host->rrdfamily_root_index),   rrdfamily_compare);
     avl_init_lock(&(host->rrdvar_root_index),   rrdvar_compare);
 
@@ -239,12 +280,18 @@ RRDHOST *rrdhost_create(const char *hostname,
         char dbenginepath[FILENAME_MAX + 1];
         int ret;
 
-        snprintfz(dbenginepath, FILENAME_MAX, "%s/dbengine", host->cache_dir);
-        ret = mkdir(dbenginepath, 0775);
-        if(ret != 0 && errno != EEXIST)
-            error("Host '%s': cannot create directory '%s'", host->hostname, dbenginepath);
-        else
-            ret = rrdeng_init(&host->rrdeng_ctx, dbenginepath, host->page_cache_mb, host->disk_space_mb);
+        if(default_rrdeng_multihost && !is_localhost) {
+            host->rrdeng_ctx = rrdhost_multihost_dbengine();
+            ret = (host->rrdeng_ctx == NULL);
+        }
+        else {
+            snprintfz(dbenginepath, FILENAME_MAX, "%s/dbengine", host->cache_dir);
+            ret = mkdir(dbenginepath, 0775);
+            if(ret != 0 && errno != EEXIST)
+                error("Host '%s': cannot create directory '%s'", host->hostname, dbenginepath);
+            else
+                ret = rrdeng_init(&host->rrdeng_ctx, dbenginepath, host->page_cache_mb, host->disk_space_mb);
+        }
         if(ret) {
             error("Host '%s': cannot initialize host with machine guid '%s'. Failed to initialize DB engine at '%s'.",
                   host->hostname, host->machine_guid, host->cache_dir);
@@ -277,14 +324,10 @@ RRDHOST *rrdhost_create(const char *hostname,
     // ------------------------------------------------------------------------
     // load health configuration
 
-    if(host->health_enabled) {
-        rrdhost_wrlock(host);
-        health_readdir(host, health_user_config_dir(), health_stock_config_dir(), NULL);
-        rrdhost_unlock(host);
-
-        health_alarm_log_load(host);
-        health_alarm_log_open(host);
-    }
+    // the other hosts are created with the hosts write locked, when their
+    // child connects, so the health thread loads them when it first runs for them
+    if(host->health_enabled && is_localhost)
+        health_host_load(host);
 
 
     // ------------------------------------------------------------------------
@@ -355,6 +398,8 @@ RRDHOST *rrdhost_create(const char *hostname,
     return host;
 }
 
+static void rrdhost_reaper_wait(const char *guid);
+
 RRDHOST *rrdhost_find_or_create(
           const char *hostname
         , const char *registry_hostname
@@ -379,6 +424,8 @@ RRDHOST *rrdhost_find_or_create(
     rrd_wrlock();
     RRDHOST *host = rrdhost_find_by_guid(guid, 0);
     if(!host) {
+        rrdhost_reaper_wait(guid);
+
         host = rrdhost_create(
                 hostname
                 , registry_hostname
@@ -457,32 +504,13 @@ inline int rrdhost_should_be_removed(RRDHOST *host, RRDHOST *protected, time_t n
     return 0;
 }
 
-void rrdhost_cleanup_orphan_hosts_nolock(RRDHOST *protected) {
-    time_t now = now_realtime_sec();
-
-    RRDHOST *host;
-
-restart_after_removal:
-    rrdhost_foreach_write(host) {
-        if(rrdhost_should_be_removed(host, protected, now)) {
-            info("Host '%s' with machine guid '%s' is obsolete - cleaning up.", host->hostname, host->machine_guid);
-
-            if(rrdhost_flag_check(host, RRDHOST_FLAG_DELETE_ORPHAN_HOST))
-                rrdhost_delete_charts(host);
-            else
-                rrdhost_save_charts(host);
-
-            rrdhost_free(host);
-            goto restart_after_removal;
-        }
-    }
-}
-
 // ----------------------------------------------------------------------------
 // RRDHOST global / startup initialization
 
 void rrd_init(char *hostname, struct rrdhost_system_info *system_info) {
     rrdset_free_obsolete_time = config_get_number(CONFIG_SECTION_GLOBAL, "cleanup obsolete charts after seconds", rrdset_free_obsolete_time);
+    rrd_checkpoint_every = config_get_number(CONFIG_SECTION_GLOBAL, "save database every seconds", rrd_checkpoint_every);
+    rrd_save_threads = (int)config_get_number(CONFIG_SECTION_GLOBAL, "save database threads", rrd_save_threads);
     gap_when_lost_iterations_above = (int)config_get_number(CONFIG_SECTION_GLOBAL, "gap when lost iterations above", gap_when_lost_iterations_above);
     if (gap_when_lost_iterations_above < 1)
         gap_when_lost_iterations_above = 1;
@@ -577,15 +605,43 @@ void rrdhost_system_info_free(struct rrdhost_system_info *system_info) {
     }
 }
 
-void rrdhost_free(RRDHOST *host) {
-    if(!host) return;
-
-    info("Freeing all memory for host '%s'...", host->hostname);
+// ----------------------------------------------------------------------------
+// RRDHOST - remove a host from the index and the list of hosts
 
+static void rrdhost_unlink(RRDHOST *host, RRDHOST *prev) {
     rrd_check_wrlock();     // make sure the RRDs are write locked
 
+    if(rrdhost_index_del(host) != host)
+        error("RRDHOST '%s' removed from index, deleted the wrong entry.", host->hostname);
+
+    if(host == localhost) {
+        localhost = host->next;
+    }
+    else {
+        // find the previous one
+        if(!prev)
+            for(prev = localhost; prev && prev->next != host ; prev = prev->next) ;
+
+        // bypass it
+        if(prev) prev->next = host->next;
+        else error("Request to free RRDHOST '%s': cannot find it", host->hostname);
+    }
+
+    host->next = NULL;
+    rrd_hosts_available--;
+}
+
+// ----------------------------------------------------------------------------
+// RRDHOST - free
+
+// frees a host that is not in the index and the list of hosts anymore,
+// it does not need any global lock
+static void rrdhost_free_unlinked(RRDHOST *host) {
+    info("Freeing all memory for host '%s'...", host->hostname);
+
     // stop a possibly running thread
     rrdpush_sender_thread_stop(host);
+    rrdpush_sender_free_queues(host);
 
     rrdhost_wrlock(host);   // lock this RRDHOST
 
@@ -595,6 +651,18 @@ void rrdhost_free(RRDHOST *host) {
     while(host->rrdset_root)
         rrdset_free(host->rrdset_root);
 
+    rrdmap_free_all(host);
+    buffer_free(host->charts_json);
+    while(host->json_snapshots_replaced) {
+        RRDSET_JSON_SNAPSHOT *next = host->json_snapshots_replaced->next;
+        freez(host->json_snapshots_replaced);
+        host->json_snapshots_replaced = next;
+    }
+    buffer_free(host->allmetrics_shell.wb);
+    buffer_free(host->allmetrics_json.wb);
+    hash_index_destroy(&host->rrdset_root_index);
+    hash_index_destroy(&host->rrdset_root_index_name);
+
     while(host->alarms)
         rrdcalc_unlink_and_free(host, host->alarms);
 
@@ -608,33 +676,12 @@ void rrdhost_free(RRDHOST *host) {
 
     if (host->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
 #ifdef ENABLE_DBENGINE
-        rrdeng_exit(host->rrdeng_ctx);
+        // the shared instance is stopped after all the hosts
+        if(host->rrdeng_ctx != rrdeng_multihost_ctx)
+            rrdeng_exit(host->rrdeng_ctx);
 #endif
     }
 
-    // ------------------------------------------------------------------------
-    // remove it from the indexes
-
-    if(rrdhost_index_del(host) != host)
-        error("RRDHOST '%s' removed from index, deleted the wrong entry.", host->hostname);
-
-
-    // ------------------------------------------------------------------------
-    // unlink it from the host
-
-    if(host == localhost) {
-        localhost = host->next;
-    }
-    else {
-        // find the previous one
-        RRDHOST *h;
-        for(h = localhost; h && h->next != host ; h = h->next) ;
-
-        // bypass it
-        if(h) h->next = host->next;
-        else error("Request to free RRDHOST '%s': cannot find it", host->hostname);
-    }
-
     // ------------------------------------------------------------------------
     // free it
 
@@ -658,16 +705,255 @@ void rrdhost_free(RRDHOST *host) {
     netdata_rwlock_destroy(&host->health_log.alarm_log_rwlock);
     netdata_rwlock_destroy(&host->rrdhost_rwlock);
     freez(host);
+}
 
-    rrd_hosts_available--;
+void rrdhost_free(RRDHOST *host) {
+    if(!host) return;
+
+    rrdhost_unlink(host, NULL);
+    rrdhost_free_unlinked(host);
+}
+
+// ----------------------------------------------------------------------------
+// RRDHOST - free the orphan hosts in the background
+//
+// The orphan hosts are only removed from the index and the list of hosts while
+// the hosts are write locked. Saving (or deleting) their charts and freeing them
+// is done by a thread, without any lock that would stop the queries of the
+// other hosts. A host that connects again before it is freed waits for it.
+
+static struct {
+    netdata_mutex_t mutex;      // protects the queue and current
+    netdata_mutex_t busy;       // held while a host is being freed
+    RRDHOST *queue;             // the hosts to be freed, linked by host->next
+    RRDHOST *current;           // the host being freed
+    int running;
+} rrdhost_reaper = {
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .busy = NETDATA_MUTEX_INITIALIZER,
+        .queue = NULL,
+        .current = NULL,
+        .running = 0
+};
+
+static void rrdhost_reap(RRDHOST *host) {
+    if(rrdhost_flag_check(host, RRDHOST_FLAG_DELETE_ORPHAN_HOST))
+        rrdhost_delete_charts(host);
+    else
+        rrdhost_save_charts(host);
+
+    rrdhost_free_unlinked(host);
+}
+
+static void *rrdhost_reaper_main(void *ptr) {
+    (void)ptr;
+
+    while(1) {
+        netdata_mutex_lock(&rrdhost_reaper.busy);
+
+        netdata_mutex_lock(&rrdhost_reaper.mutex);
+        RRDHOST *host = rrdhost_reaper.current = rrdhost_reaper.queue;
+        if(host) rrdhost_reaper.queue = host->next;
+        else rrdhost_reaper.running = 0;
+        netdata_mutex_unlock(&rrdhost_reaper.mutex);
+
+        if(host) {
+            host->next = NULL;
+            rrdhost_reap(host);
+
+            netdata_mutex_lock(&rrdhost_reaper.mutex);
+            rrdhost_reaper.current = NULL;
+            netdata_mutex_unlock(&rrdhost_reaper.mutex);
+        }
+
+        netdata_mutex_unlock(&rrdhost_reaper.busy);
+
+        if(!host) break;
+    }
+
+    return NULL;
+}
+
+static void rrdhost_reaper_add(RRDHOST *host) {
+    netdata_mutex_lock(&rrdhost_reaper.mutex);
+
+    host->next = rrdhost_reaper.queue;
+    rrdhost_reaper.queue = host;
+
+    if(!rrdhost_reaper.running) {
+        netdata_thread_t thread;
+        if(netdata_thread_create(&thread, "HOSTFREE", NETDATA_THREAD_OPTION_DONT_LOG, rrdhost_reaper_main, NULL) == 0)
+            rrdhost_reaper.running = 1;
+        else
+            error("Cannot create the thread to free the orphan hosts. They will be freed on exit.");
+    }
+
+    netdata_mutex_unlock(&rrdhost_reaper.mutex);
+}
+
+// frees the host with this machine guid now, if it is waiting to be freed
+// or waits for it, if it is being freed
+static void rrdhost_reaper_wait(const char *guid) {
+    RRDHOST *host, *prev = NULL;
+    int wait = 0;
+
+    netdata_mutex_lock(&rrdhost_reaper.mutex);
+
+    for(host = rrdhost_reaper.queue; host ; prev = host, host = host->next)
+        if(!strcmp(host->machine_guid, guid)) break;
+
+    if(host) {
+        if(prev) prev->next = host->next;
+        else rrdhost_reaper.queue = host->next;
+        host->next = NULL;
+    }
+    else if(rrdhost_reaper.current && !strcmp(rrdhost_reaper.current->machine_guid, guid))
+        wait = 1;
+
+    netdata_mutex_unlock(&rrdhost_reaper.mutex);
+
+    if(host) {
+        info("Host with machine guid '%s' is back, before it was freed - freeing it now.", guid);
+        rrdhost_reap(host);
+    }
+    else if(wait) {
+        info("Host with machine guid '%s' is back, while it is freed - waiting for it.", guid);
+        netdata_mutex_lock(&rrdhost_reaper.busy);
+        netdata_mutex_unlock(&rrdhost_reaper.busy);
+    }
+}
+
+// frees all the hosts waiting to be freed (on exit)
+static void rrdhost_reaper_free_all(void) {
+    netdata_mutex_lock(&rrdhost_reaper.busy);
+
+    netdata_mutex_lock(&rrdhost_reaper.mutex);
+    RRDHOST *host = rrdhost_reaper.queue;
+    rrdhost_reaper.queue = NULL;
+    netdata_mutex_unlock(&rrdhost_reaper.mutex);
+
+    while(host) {
+        RRDHOST *next = host->next;
+        host->next = NULL;
+        rrdhost_reap(host);
+        host = next;
+    }
+
+    netdata_mutex_unlock(&rrdhost_reaper.busy);
+}
+
+void rrdhost_cleanup_orphan_hosts_nolock(RRDHOST *protected) {
+    time_t now = now_realtime_sec();
+
+    RRDHOST *host, *next, *prev = NULL;
+
+    rrd_check_wrlock();
+
+    for(host = localhost; host ; host = next) {
+        next = host->next;
+
+        if(rrdhost_should_be_removed(host, protected, now)) {
+            info("Host '%s' with machine guid '%s' is obsolete - cleaning up.", host->hostname, host->machine_guid);
+
+            rrdhost_unlink(host, prev);
+            rrdhost_reaper_add(host);
+        }
+        else
+            prev = host;
+    }
 }
 
 void rrdhost_free_all(void) {
     rrd_wrlock();
+    rrdhost_reaper_free_all();
     while(localhost) rrdhost_free(localhost);
+
+#ifdef ENABLE_DBENGINE
+    rrdeng_exit(rrdeng_multihost_ctx);
+    rrdeng_multihost_ctx = NULL;
+#endif
+
     rrd_unlock();
 }
 
+// ----------------------------------------------------------------------------
+// RRDHOST - save charts with a few threads
+//
+// With memory mode = save, every dimension is a file, so the charts are saved
+// by rrd_save_threads threads (the number of processors by default), that
+// take the charts from a list, one at a time.
+
+#define RRD_SAVE_CHARTS_PER_THREAD 100
+
+struct rrdset_save_work {
+    RRDSET **charts;
+    size_t count;
+    size_t next;
+    int checkpoint;             // stop when netdata exits
+    netdata_mutex_t mutex;
+};
+
+static void *rrdset_save_worker(void *ptr) {
+    struct rrdset_save_work *work = (struct rrdset_save_work *)ptr;
+
+    while(!(work->checkpoint && netdata_exit)) {
+        netdata_mutex_lock(&work->mutex);
+        size_t i = work->next++;
+        netdata_mutex_unlock(&work->mutex);
+
+        if(i >= work->count) break;
+
+        RRDSET *st = work->charts[i];
+        rrdset_rdlock(st);
+        rrdset_save(st);
+        rrdset_unlock(st);
+    }
+
+    return NULL;
+}
+
+// the caller should have a lock on the host of the charts
+static void rrdset_save_parallel(RRDSET **charts, size_t count, int checkpoint) {
+    struct rrdset_save_work work = {
+            .charts = charts,
+            .count = count,
+            .next = 0,
+            .checkpoint = checkpoint
+    };
+    netdata_mutex_init(&work.mutex);
+
+    size_t threads = (size_t)((rrd_save_threads > 0) ? rrd_save_threads : processors);
+    if(threads > count / RRD_SAVE_CHARTS_PER_THREAD)
+        threads = count / RRD_SAVE_CHARTS_PER_THREAD;
+
+    // this thread is one of the workers
+    size_t i, started = 0;
+    netdata_thread_t *workers = NULL;
+    if(threads > 1) {
+        workers = mallocz((threads - 1) * sizeof(netdata_thread_t));
+        for(i = 0; i < threads - 1 ; i++) {
+            if(netdata_thread_create(&workers[started], "DBSAVE", NETDATA_THREAD_OPTION_JOINABLE | NETDATA_THREAD_OPTION_DONT_LOG, rrdset_save_worker, &work) == 0)
+                started++;
+        }
+    }
+
+    rrdset_save_worker(&work);
+
+    for(i = 0; i < started ; i++)
+        netdata_thread_join(workers[i], NULL);
+
+    freez(workers);
+}
+
+static inline void rrdset_save_list_add(RRDSET ***charts, size_t *count, size_t *size, RRDSET *st) {
+    if(unlikely(*count == *size)) {
+        *size = (*size) ? *size * 2 : 1024;
+        *charts = reallocz(*charts, *size * sizeof(RRDSET *));
+    }
+
+    (*charts)[(*count)++] = st;
+}
+
 // ----------------------------------------------------------------------------
 // RRDHOST - save host files
 
@@ -676,19 +962,95 @@ void rrdhost_save_charts(RRDHOST *host) {
 
     info("Saving/Closing database of host '%s'...", host->hostname);
 
-    RRDSET *st;
+    RRDSET *st, **charts = NULL;
+    size_t count = 0, size = 0;
 
     // we get a write lock
     // to ensure only one thread is saving the database
     rrdhost_wrlock(host);
 
-    rrdset_foreach_write(st, host) {
-        rrdset_rdlock(st);
-        rrdset_save(st);
-        rrdset_unlock(st);
-    }
+    rrdset_foreach_write(st, host)
+        rrdset_save_list_add(&charts, &count, &size, st);
+
+    rrdset_save_parallel(charts, count, 0);
 
     rrdhost_unlock(host);
+
+    freez(charts);
+}
+
+// ----------------------------------------------------------------------------
+// RRDHOST - periodic save of the database (memory mode = save)
+//
+// Only the values stored since the last save of each dimension are written,
+// so that a crash does not lose everything collected since netdata started,
+// and the save on exit has less to write.
+
+static void rrdhost_checkpoint_charts(RRDHOST *host) {
+    RRDSET *st, **charts = NULL;
+    size_t count = 0, size = 0;
+
+    // a read lock, so that the data collection of the host is not stopped;
+    // it still waits for the write locks of rrdhost_save_charts()
+    rrdhost_rdlock(host);
+
+    rrdset_foreach_read(st, host)
+        rrdset_save_list_add(&charts, &count, &size, st);
+
+    rrdset_save_parallel(charts, count, 1);
+
+    rrdhost_unlock(host);
+
+    freez(charts);
+}
+
+static void rrd_checkpoint_main_cleanup(void *ptr) {
+    struct netdata_static_thread *static_thread = (struct netdata_static_thread *)ptr;
+    static_thread->enabled = NETDATA_MAIN_THREAD_EXITING;
+
+    info("cleaning up...");
+
+    static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
+}
+
+void *rrd_checkpoint_main(void *ptr) {
+    netdata_thread_cleanup_push(rrd_checkpoint_main_cleanup, ptr);
+
+    if(rrd_checkpoint_every > 0) {
+        heartbeat_t hb;
+        heartbeat_init(&hb);
+
+        while(!netdata_exit) {
+            heartbeat_next(&hb, rrd_checkpoint_every * USEC_PER_SEC);
+            if(unlikely(netdata_exit)) break;
+
+            // do not leave the locks of the hosts and the charts locked
+            netdata_thread_disable_cancelability();
+
+            usec_t started = now_monotonic_usec();
+            size_t hosts = 0;
+
+            rrd_rdlock();
+
+            RRDHOST *host;
+            rrdhost_foreach_read(host) {
+                if(host->rrd_memory_mode != RRD_MEMORY_MODE_SAVE) continue;
+
+                rrdhost_checkpoint_charts(host);
+                hosts++;
+            }
+
+            rrd_unlock();
+
+            if(hosts)
+                info("Saved the database of %zu host(s) in %llu ms.", hosts, (now_monotonic_usec() - started) / USEC_PER_MS);
+
+            netdata_thread_enable_cancelability();
+        }
+    }
+
+    netdata_thread_cleanup_pop(1);
+    return NULL;
 }
 
 // ----------------------------------------------------------------------------
@@ -724,7 +1086,8 @@ void rrdhost_cleanup_charts(RRDHOST *host) {
 
     info("Cleaning up database of host '%s'...", host->hostname);
 
-    RRDSET *st;
+    RRDSET *st, **charts = NULL;
+    size_t count = 0, size = 0;
     uint32_t rrdhost_delete_obsolete_charts = rrdhost_flag_check(host, RRDHOST_FLAG_DELETE_OBSOLETE_CHARTS);
 
     // we get a write lock
@@ -732,19 +1095,25 @@ void rrdhost_cleanup_charts(RRDHOST *host) {
     rrdhost_wrlock(host);
 
     rrdset_foreach_write(st, host) {
-        rrdset_rdlock(st);
-
-        if(rrdhost_delete_obsolete_charts && rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE))
+        if(rrdhost_delete_obsolete_charts && rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE)) {
+            rrdset_rdlock(st);
             rrdset_delete(st);
-        else if(rrdhost_delete_obsolete_charts && rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE_DIMENSIONS))
+            rrdset_unlock(st);
+        }
+        else if(rrdhost_delete_obsolete_charts && rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE_DIMENSIONS)) {
+            rrdset_rdlock(st);
             rrdset_delete_obsolete_dimensions(st);
+            rrdset_unlock(st);
+        }
         else
-            rrdset_save(st);
-
-        rrdset_unlock(st);
+            rrdset_save_list_add(&charts, &count, &size, st);
     }
 
+    rrdset_save_parallel(charts, count, 0);
+
     rrdhost_unlock(host);
+
+    freez(charts);
 }
 
 
@@ -789,6 +1158,13 @@ void rrdhost_cleanup_all(void) {
 void rrdhost_cleanup_obsolete_charts(RRDHOST *host) {
     time_t now = now_realtime_sec();
 
+    // it runs for every chart created, so when a child sends thousands
+    // of them at once, the charts are checked once per second
+    if(host->obsolete_charts_check_time == now)
+        return;
+
+    host->obsolete_charts_check_time = now;
+
     RRDSET *st;
 
     uint32_t rrdhost_delete_obsolete_charts = rrdhost_flag_check(host, RRDHOST_FLAG_DELETE_OBSOLETE_CHARTS);
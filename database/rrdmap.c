@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define NETDATA_RRD_INTERNALS
+#include "rrd.h"
+
+// ----------------------------------------------------------------------------
+// RRDDIM packed map files
+//
+// With memory mode = map every dimension normally has its own small file.
+// When packing is enabled, the dimensions of a host are packed in a few
+// large files instead, one series of files per dimension size. Every file
+// starts with a directory of its slots, keyed by chart and dimension id,
+// followed by the slots themselves. The slots are aligned to huge pages, so
+// that the kernel can back them with huge pages when the cache directory is
+// on a file system that supports them (hugetlbfs, tmpfs with huge=).
+
+#define RRDMAP_MAGIC "NETDATA PACKED DIMENSIONS V1"
+#define RRDMAP_ALIGNMENT (2 * 1024 * 1024)          // the huge page size, the files and their slots are aligned to it
+#define RRDMAP_FILE_SIZE (64 * 1024 * 1024)         // the size of the slots of a file, it is smaller for big dimensions
+#define RRDMAP_MAX_SLOTS 4096
+#define RRDMAP_DIRECTORY_OFFSET 4096
+#define RRDMAP_KEY_LENGTH 504                       // fits "chart id/dimension id"
+
+#define rrdmap_align(x, alignment) ((((x) + (alignment) - 1) / (alignment)) * (alignment))
+
+struct rrdmap_header {
+    char magic[32];
+    uint32_t slot_size;
+    uint32_t nr_slots;
+    uint64_t data_offset;
+    uint64_t size;
+};
+
+struct rrdmap_entry {
+    uint32_t hash;
+    uint32_t used;                                  // 1 when the slot stores a dimension
+    char key[RRDMAP_KEY_LENGTH];
+};
+
+struct rrdmap_file {
+    char *filename;
+    size_t size;
+    struct rrdmap_header *header;                   // the whole file is mapped here
+    struct rrdmap_entry *directory;
+    char *data;
+    uint32_t slot_size;
+    uint32_t nr_slots;
+    uint8_t *attached;                              // 1 for the slots of the dimensions in memory
+    struct rrdmap_file *next;
+};
+
+int default_rrd_map_packed = CONFIG_BOOLEAN_NO;
+
+static size_t rrdmap_page_size = 0;
+
+static inline size_t rrdmap_get_page_size(void) {
+    if(unlikely(!rrdmap_page_size))
+        rrdmap_page_size = (size_t)sysconf(_SC_PAGESIZE);
+    return rrdmap_page_size;
+}
+
+// maps file number of the pack files of slot_size of host, creating it when it does not exist
+// the caller must hold the rrdmap lock of the host
+static struct rrdmap_file *rrdmap_file_open(RRDHOST *host, uint32_t slot_size, unsigned number, int create) {
+    char filename[FILENAME_MAX + 1];
+    struct rrdmap_header header;
+    uint32_t nr_slots;
+    uint64_t data_offset, size;
+    int fd, reset = 0;
+
+    snprintfz(filename, FILENAME_MAX, "%s/dimensions-%u-%u.map", host->cache_dir, slot_size, number);
+
+    nr_slots = RRDMAP_FILE_SIZE / slot_size;
+    if(nr_slots < 1) nr_slots = 1;
+    if(nr_slots > RRDMAP_MAX_SLOTS) nr_slots = RRDMAP_MAX_SLOTS;
+    data_offset = rrdmap_align(RRDMAP_DIRECTORY_OFFSET + nr_slots * sizeof(struct rrdmap_entry), RRDMAP_ALIGNMENT);
+    size = rrdmap_align(data_offset + (uint64_t)nr_slots * slot_size, RRDMAP_ALIGNMENT);
+
+    fd = open(filename, O_RDWR | (create ? O_CREAT : 0) | O_NOATIME, 0664);
+    if(fd == -1) {
+        if(create) error("Cannot create/open packed dimensions file '%s'.", filename);
+        return NULL;
+    }
+
+    if(pread(fd, &header, sizeof(header), 0) != sizeof(header) || strcmp(header.magic, RRDMAP_MAGIC) != 0) {
+        if(!create) {
+            close(fd);
+            return NULL;
+        }
+        info("Initializing packed dimensions file '%s'.", filename);
+        reset = 1;
+    }
+    else if(header.slot_size != slot_size || header.nr_slots != nr_slots || header.data_offset != data_offset || header.size != size) {
+        error("Packed dimensions file '%s' does not have the expected layout. Clearing it.", filename);
+        reset = 1;
+    }
+
+    if(reset && ftruncate(fd, 0) != 0)
+        error("Cannot truncate packed dimensions file '%s'.", filename);
+    if(ftruncate(fd, (off_t)size) != 0) {
+        error("Cannot resize packed dimensions file '%s' to %llu bytes.", filename, (unsigned long long)size);
+        close(fd);
+        return NULL;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        error("Cannot map packed dimensions file '%s'.", filename);
+        return NULL;
+    }
+#ifdef NETDATA_LOG_ALLOCATIONS
+    mmap_accounting(size);
+#endif
+
+    if(madvise(mem, size, MADV_DONTFORK) != 0)
+        error("Cannot advise the kernel about the memory usage (MADV_DONTFORK) of file '%s'.", filename);
+#ifdef MADV_HUGEPAGE
+    // the slots are accessed all over the place, fewer TLB misses matter more than
+    // read-ahead; this may fail when the file system cannot use huge pages
+    (void)madvise((char *)mem + data_offset, size - data_offset, MADV_HUGEPAGE);
+#endif
+
+    struct rrdmap_file *mf = callocz(1, sizeof(struct rrdmap_file));
+    mf->filename = strdupz(filename);
+    mf->size = size;
+    mf->header = mem;
+    mf->directory = (struct rrdmap_entry *)((char *)mem + RRDMAP_DIRECTORY_OFFSET);
+    mf->data = (char *)mem + data_offset;
+    mf->slot_size = slot_size;
+    mf->nr_slots = nr_slots;
+    mf->attached = callocz(nr_slots, sizeof(uint8_t));
+
+    if(reset) {
+        // the header is written last, so that a file is never valid with a partial directory
+        memset(mf->directory, 0, nr_slots * sizeof(struct rrdmap_entry));
+        mf->header->slot_size = slot_size;
+        mf->header->nr_slots = nr_slots;
+        mf->header->data_offset = data_offset;
+        mf->header->size = size;
+        strcpy(mf->header->magic, RRDMAP_MAGIC);
+    }
+
+    mf->next = host->rrdmap_files;
+    host->rrdmap_files = mf;
+
+    return mf;
+}
+
+// maps the pack files of slot_size of host that are already on disk
+// the caller must hold the rrdmap lock of the host
+static unsigned rrdmap_files_load(RRDHOST *host, uint32_t slot_size) {
+    struct rrdmap_file *mf;
+    unsigned files = 0;
+
+    for(mf = host->rrdmap_files; mf ; mf = mf->next)
+        if(mf->slot_size == slot_size) files++;
+
+    if(!files)
+        while(rrdmap_file_open(host, slot_size, files, 0)) files++;
+
+    return files;
+}
+
+static inline RRDDIM *rrdmap_slot(struct rrdmap_file *mf, uint32_t slot) {
+    return (RRDDIM *)(mf->data + (size_t)slot * mf->slot_size);
+}
+
+static inline uint32_t rrdmap_slot_of(struct rrdmap_file *mf, RRDDIM *rd) {
+    return (uint32_t)(((char *)rd - mf->data) / mf->slot_size);
+}
+
+// returns the slot of dimension id of st in the pack files of its host, size bytes long,
+// or NULL when the dimension has to be mapped to a file of its own
+RRDDIM *rrdmap_attach(RRDSET *st, const char *id, unsigned long size, struct rrdmap_file **file, char *filename, size_t filename_length) {
+    RRDHOST *host = st->rrdhost;
+    char key[RRDMAP_KEY_LENGTH];
+    struct rrdmap_file *mf, *free_mf = NULL;
+    uint32_t hash, slot, free_slot = 0, slot_size;
+    unsigned files;
+    RRDDIM *rd = NULL;
+
+    if(unlikely(snprintfz(key, RRDMAP_KEY_LENGTH - 1, "%s/%s", st->id, id) >= RRDMAP_KEY_LENGTH - 1))
+        return NULL;
+    hash = simple_hash(key);
+
+    slot_size = (uint32_t)rrdmap_align(size, rrdmap_get_page_size());
+
+    netdata_mutex_lock(&host->rrdmap_mutex);
+
+    files = rrdmap_files_load(host, slot_size);
+
+    for(mf = host->rrdmap_files; mf ; mf = mf->next) {
+        if(mf->slot_size != slot_size) continue;
+
+        for(slot = 0; slot < mf->nr_slots ; slot++) {
+            struct rrdmap_entry *e = &mf->directory[slot];
+
+            if(!e->used) {
+                if(!free_mf && !mf->attached[slot]) {
+                    free_mf = mf;
+                    free_slot = slot;
+                }
+                continue;
+            }
+
+            if(e->hash == hash && !strcmp(e->key, key)) {
+                if(unlikely(mf->attached[slot])) {
+                    error("Packed dimension '%s' of host '%s' is already in use.", key, host->hostname);
+                    goto cleanup;
+                }
+                rd = rrdmap_slot(mf, slot);
+                break;
+            }
+        }
+        if(rd) break;
+    }
+
+    if(!rd) {
+        if(!free_mf) {
+            free_mf = rrdmap_file_open(host, slot_size, files, 1);
+            if(!free_mf) goto cleanup;
+            free_slot = 0;
+        }
+
+        mf = free_mf;
+        slot = free_slot;
+        rd = rrdmap_slot(mf, slot);
+
+        // whatever was stored in the slot is not this dimension
+        memset(rd, 0, sizeof(RRDDIM));
+        strncpyz(mf->directory[slot].key, key, RRDMAP_KEY_LENGTH - 1);
+        mf->directory[slot].hash = hash;
+        mf->directory[slot].used = 1;
+    }
+
+    mf->attached[slot] = 1;
+    *file = mf;
+    if(filename)
+        snprintfz(filename, filename_length, "%s (slot %u)", mf->filename, slot);
+
+cleanup:
+    netdata_mutex_unlock(&host->rrdmap_mutex);
+    return rd;
+}
+
+// the dimension is not in memory any more, its slot keeps its data
+void rrdmap_detach(RRDHOST *host, struct rrdmap_file *mf, RRDDIM *rd) {
+    netdata_mutex_lock(&host->rrdmap_mutex);
+    mf->attached[rrdmap_slot_of(mf, rd)] = 0;
+    netdata_mutex_unlock(&host->rrdmap_mutex);
+}
+
+// the data of the dimension are deleted, its slot can be reused after the dimension is freed
+void rrdmap_delete(RRDDIM *rd) {
+    RRDHOST *host = rd->rrdset->rrdhost;
+    struct rrdmap_file *mf = rd->state->map_file;
+    struct rrdmap_entry *e;
+
+    info("Deleting packed dimension '%s' of chart '%s' from '%s'.", rd->id, rd->rrdset->id, mf->filename);
+
+    netdata_mutex_lock(&host->rrdmap_mutex);
+    e = &mf->directory[rrdmap_slot_of(mf, rd)];
+    e->used = 0;
+    e->hash = 0;
+    e->key[0] = '\0';
+    netdata_mutex_unlock(&host->rrdmap_mutex);
+}
+
+// unmaps all the pack files of host, after all its dimensions have been freed
+void rrdmap_free_all(RRDHOST *host) {
+    netdata_mutex_lock(&host->rrdmap_mutex);
+    while(host->rrdmap_files) {
+        struct rrdmap_file *mf = host->rrdmap_files;
+        host->rrdmap_files = mf->next;
+
+        debug(D_RRD_CALLS, "Unmapping packed dimensions file '%s'.", mf->filename);
+        munmap(mf->header, mf->size);
+        freez(mf->attached);
+        freez(mf->filename);
+        freez(mf);
+    }
+    netdata_mutex_unlock(&host->rrdmap_mutex);
+}
+
+// tells the kernel that the values of rd from slot first to slot last, wrapping around the
+// end of the round robin database, are going to be read, so that it starts paging them in
+void rrdmap_willneed(RRDDIM *rd, long first, long last) {
+    long entries = rd->entries;
+    uintptr_t start, end;
+
+    if(unlikely(first < 0 || last < 0 || first >= entries || last >= entries))
+        return;
+
+    if(first > last) {
+        rrdmap_willneed(rd, first, entries - 1);
+        first = 0;
+    }
+
+    start = (uintptr_t)&rd->values[first] & ~((uintptr_t)rrdmap_get_page_size() - 1);
+    end = (uintptr_t)&rd->values[last + 1];
+    (void)madvise((void *)start, end - start, MADV_WILLNEED);
+}
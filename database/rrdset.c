@@ -23,50 +23,30 @@ void __rrdset_check_wrlock(RRDSET *st, const char *file, const char *function, c
 // ----------------------------------------------------------------------------
 // RRDSET index
 
-int rrdset_compare(void* a, void* b) {
-    if(((RRDSET *)a)->hash < ((RRDSET *)b)->hash) return -1;
-    else if(((RRDSET *)a)->hash > ((RRDSET *)b)->hash) return 1;
-    else return strcmp(((RRDSET *)a)->id, ((RRDSET *)b)->id);
+// the hash index compares the keys of the charts with the same hash
+int rrdset_equal(void *item, const void *key) {
+    return !strcmp(((RRDSET *)item)->id, (const char *)key);
 }
 
 static RRDSET *rrdset_index_find(RRDHOST *host, const char *id, uint32_t hash) {
-    RRDSET tmp;
-    strncpyz(tmp.id, id, RRD_ID_LENGTH_MAX);
-    tmp.hash = (hash)?hash:simple_hash(tmp.id);
-
-    return (RRDSET *)avl_search_lock(&(host->rrdset_root_index), (avl *) &tmp);
+    return (RRDSET *)hash_index_get(&(host->rrdset_root_index), (hash)?hash:simple_hash(id), id);
 }
 
 // ----------------------------------------------------------------------------
 // RRDSET name index
 
-#define rrdset_from_avlname(avlname_ptr) ((RRDSET *)((avlname_ptr) - offsetof(RRDSET, avlname)))
-
-int rrdset_compare_name(void* a, void* b) {
-    RRDSET *A = rrdset_from_avlname(a);
-    RRDSET *B = rrdset_from_avlname(b);
-
-    // fprintf(stderr, "COMPARING: %s with %s\n", A->name, B->name);
-
-    if(A->hash_name < B->hash_name) return -1;
-    else if(A->hash_name > B->hash_name) return 1;
-    else return strcmp(A->name, B->name);
+int rrdset_equal_name(void *item, const void *key) {
+    return !strcmp(((RRDSET *)item)->name, (const char *)key);
 }
 
 RRDSET *rrdset_index_add_name(RRDHOST *host, RRDSET *st) {
-    void *result;
     // fprintf(stderr, "ADDING: %s (name: %s)\n", st->id, st->name);
-    result = avl_insert_lock(&host->rrdset_root_index_name, (avl *) (&st->avlname));
-    if(result) return rrdset_from_avlname(result);
-    return NULL;
+    return (RRDSET *)hash_index_set(&host->rrdset_root_index_name, st->hash_name, st->name, st);
 }
 
 RRDSET *rrdset_index_del_name(RRDHOST *host, RRDSET *st) {
-    void *result;
     // fprintf(stderr, "DELETING: %s (name: %s)\n", st->id, st->name);
-    result = (RRDSET *)avl_remove_lock(&((host)->rrdset_root_index_name), (avl *)(&st->avlname));
-    if(result) return rrdset_from_avlname(result);
-    return NULL;
+    return (RRDSET *)hash_index_del(&host->rrdset_root_index_name, st->hash_name, st->name);
 }
 
 
@@ -74,20 +54,14 @@ RRDSET *rrdset_index_del_name(RRDHOST *host, RRDSET *st) {
 // RRDSET - find charts
 
 static inline RRDSET *rrdset_index_find_name(RRDHOST *host, const char *name, uint32_t hash) {
-    void *result = NULL;
-    RRDSET tmp;
-    tmp.name = name;
-    tmp.hash_name = (hash)?hash:simple_hash(tmp.name);
-
     // fprintf(stderr, "SEARCHING: %s\n", name);
-    result = avl_search_lock(&host->rrdset_root_index_name, (avl *) (&(tmp.avlname)));
-    if(result) {
-        RRDSET *st = rrdset_from_avlname(result);
+    RRDSET *st = (RRDSET *)hash_index_get(&host->rrdset_root_index_name, (hash)?hash:simple_hash(name), name);
+    if(st) {
         if(strcmp(st->magic, RRDSET_MAGIC) != 0)
             error("Search for RRDSET %s returned an invalid RRDSET %s (name %s)", name, st->id, st->name);
 
         // fprintf(stderr, "FOUND: %s\n", name);
-        return rrdset_from_avlname(result);
+        return st;
     }
     // fprintf(stderr, "NOT FOUND: %s\n", name);
     return NULL;
@@ -180,6 +154,7 @@ int rrdset_set_name(RRDSET *st, const char *name) {
     rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_IGNORE);
     rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
 
+    rrdset_json_changed(st);
     return 1;
 }
 
@@ -187,6 +162,7 @@ inline void rrdset_is_obsolete(RRDSET *st) {
     if(unlikely(!(rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE)))) {
         rrdset_flag_set(st, RRDSET_FLAG_OBSOLETE);
         rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
+        rrdhost_charts_changed(st->rrdhost);
 
         // the chart will not get more updates (data collection)
         // so, we have to push its definition now
@@ -198,6 +174,7 @@ inline void rrdset_isnot_obsolete(RRDSET *st) {
     if(unlikely((rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE)))) {
         rrdset_flag_clear(st, RRDSET_FLAG_OBSOLETE);
         rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
+        rrdhost_charts_changed(st->rrdhost);
 
         // the chart will be pushed upstream automatically
         // due to data collection
@@ -267,6 +244,150 @@ void rrdset_reset(RRDSET *st) {
     }
 }
 
+// ----------------------------------------------------------------------------
+// RRDSET - change the data collection frequency of a chart
+
+void rrdset_set_update_every(RRDSET *st, int update_every) {
+    if(unlikely(update_every < 1 || update_every == st->update_every)) return;
+
+    info("host '%s', chart '%s': changing the data collection frequency from %d to %d seconds"
+         , st->rrdhost->hostname, st->id, st->update_every, update_every);
+
+    rrdset_wrlock(st);
+
+    st->update_every = update_every;
+
+    RRDDIM *rd;
+    rrddim_foreach_read(rd, st)
+        rd->update_every = update_every;
+
+    // the values stored so far are spaced by the old frequency,
+    // so the chart starts over (the dbengine pages are flushed)
+    rrdset_reset(st);
+
+    rrdset_unlock(st);
+
+    rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
+    rrdset_json_changed(st);
+}
+
+// ----------------------------------------------------------------------------
+// RRDSET - replication
+//
+// A slave that reconnects sends the values it stored while it was not connected.
+// They are stored with these, in slices of consecutive values: rrdset_replay_begin()
+// with the timestamps of the slice, rrddim_replay_store() for each value, and
+// rrdset_replay_end() after the last slice, before the collected values are stored again.
+
+// makes room in the database of st for the values from first_t to last_t
+void rrdset_replay_begin(RRDSET *st, time_t first_t, time_t last_t) {
+    RRDDIM *rd;
+
+    rrdset_rdlock(st);
+
+#ifdef ENABLE_DBENGINE
+    if(st->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+        // the values of a page are consecutive, the replicated ones start a new page
+        if(!st->last_updated.tv_sec || first_t > st->last_updated.tv_sec + st->update_every) {
+            rrddim_foreach_read(rd, st)
+                rrdeng_store_metric_flush_current_page(rd);
+        }
+
+        if(last_t > st->last_updated.tv_sec) {
+            st->last_updated.tv_sec = last_t;
+            st->last_updated.tv_usec = 0;
+        }
+
+        rrdset_unlock(st);
+        return;
+    }
+#endif
+
+    if(!st->last_updated.tv_sec) {
+        st->last_updated.tv_sec = first_t - st->update_every;
+        st->last_updated.tv_usec = 0;
+    }
+
+    long slots = (long)((last_t - st->last_updated.tv_sec) / st->update_every), entries = st->entries;
+    if(slots > 0) {
+        // the new slots are empty, until their values are stored
+        long c, clear = (slots < entries) ? slots : entries;
+        long first = (st->current_entry + slots - clear) % entries;
+
+        rrddim_foreach_read(rd, st) {
+            long slot = first;
+            for(c = 0; c < clear ; c++) {
+                *rrddim_slot_value(rd, slot) = SN_EMPTY_SLOT;
+                if(unlikely(rd->state->summaries))
+                    rrddim_summaries_store(rd, slot);
+                slot = ((slot + 1) >= entries) ? 0 : slot + 1;
+            }
+        }
+
+        st->current_entry = (st->current_entry + slots) % entries;
+        st->counter += slots;
+        st->last_updated.tv_sec += slots * st->update_every;
+        st->last_updated.tv_usec = 0;
+    }
+
+    rrdset_unlock(st);
+}
+
+// stores the value n of rd at t, between the timestamps given to rrdset_replay_begin()
+// the values of a dimension have to be stored in the order of their timestamps
+void rrddim_replay_store(RRDDIM *rd, time_t t, storage_number n) {
+    RRDSET *st = rd->rrdset;
+
+    if(unlikely(t <= st->replicate_after || t > st->last_updated.tv_sec))
+        return;
+
+#ifdef ENABLE_DBENGINE
+    if(st->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+        rd->state->collect_ops->store_metric(rd, (usec_t)t * USEC_PER_SEC, n);
+        return;
+    }
+#endif
+
+    long back = (long)((st->last_updated.tv_sec - t) / st->update_every), entries = st->entries;
+    if(unlikely(back >= entries))
+        return;
+
+    long slot = st->current_entry - 1 - back;
+    if(slot < 0) slot += entries;
+
+    // the next save of the dimension has to write this slot too
+    if(unlikely(rd->state->saved_time >= t))
+        rd->state->saved_time = t - st->update_every;
+
+    *rrddim_slot_value(rd, slot) = n;
+    if(unlikely(rd->state->summaries))
+        rrddim_summaries_store(rd, slot);
+}
+
+// the collected values are stored again, after the replicated ones,
+// like the ones of a chart that has just been loaded from disk
+void rrdset_replay_end(RRDSET *st) {
+    RRDDIM *rd;
+
+    rrdset_rdlock(st);
+
+    st->last_collected_time.tv_sec = 0;
+    st->last_collected_time.tv_usec = 0;
+    st->counter_done = 0;
+
+    rrddim_foreach_read(rd, st) {
+        rd->last_collected_time.tv_sec = 0;
+        rd->last_collected_time.tv_usec = 0;
+        rd->collections_counter = 0;
+#ifdef ENABLE_DBENGINE
+        if(st->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE)
+            rrdeng_store_metric_flush_current_page(rd);
+#endif
+    }
+
+    rrdset_unlock(st);
+}
+
 // ----------------------------------------------------------------------------
 // RRDSET - helpers for rrdset_create()
 
@@ -304,6 +425,112 @@ static inline void last_updated_time_align(RRDSET *st) {
     st->last_updated.tv_usec = 0;
 }
 
+// ----------------------------------------------------------------------------
+// RRDSET - the values of all the dimensions of a chart stored by one iteration of
+// rrdset_done_interpolate(), so that they are packed to storage numbers at once
+
+struct rrdset_store_batch {
+    size_t size;                                    // the dimensions the arrays have room for
+    size_t used;
+    RRDDIM **dimensions;
+    double *values;
+    uint32_t *flags;                                // 0 to store SN_EMPTY_SLOT
+    storage_number *numbers;
+};
+
+static inline void rrdset_store_batch_add(struct rrdset_store_batch *batch, RRDDIM *rd, double value, uint32_t flags) {
+    if(unlikely(batch->used == batch->size)) {
+        batch->size = (batch->size) ? batch->size * 2 : 16;
+        batch->dimensions = reallocz(batch->dimensions, batch->size * sizeof(RRDDIM *));
+        batch->values = reallocz(batch->values, batch->size * sizeof(double));
+        batch->flags = reallocz(batch->flags, batch->size * sizeof(uint32_t));
+        batch->numbers = reallocz(batch->numbers, batch->size * sizeof(storage_number));
+    }
+
+    batch->dimensions[batch->used] = rd;
+    batch->values[batch->used] = value;
+    batch->flags[batch->used] = flags;
+    batch->used++;
+}
+
+static void rrdset_store_batch_free(RRDSET *st) {
+    struct rrdset_store_batch *batch = st->store_batch;
+    if(likely(!batch)) return;
+
+    freez(batch->dimensions);
+    freez(batch->values);
+    freez(batch->flags);
+    freez(batch->numbers);
+    freez(batch);
+    st->store_batch = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// RRDSET - column-blocked values of memory mode ram
+// the caller must hold a write lock on the chart
+
+#define RRDSET_BLOCKS_MIN_COLUMNS 4
+
+// moves the values of the chart to blocks with room for columns dimensions
+static void rrdset_blocks_resize(RRDSET *st, long columns) {
+    struct rrdset_blocks *blocks = st->blocks;
+    size_t nr_blocks = (size_t)(st->entries + RRDSET_BLOCK_SLOTS - 1) / RRDSET_BLOCK_SLOTS, block;
+    size_t old_block_size = (size_t)blocks->columns * RRDSET_BLOCK_SLOTS, new_block_size = (size_t)columns * RRDSET_BLOCK_SLOTS;
+
+    debug(D_RRD_CALLS, "Resizing the blocks of chart '%s' from %ld to %ld columns.", st->id, blocks->columns, columns);
+
+    // SN_EMPTY_SLOT is zero, the new columns are empty
+    storage_number *values = callocz(nr_blocks * new_block_size, sizeof(storage_number));
+    if(blocks->values) {
+        for(block = 0; block < nr_blocks ; block++)
+            memcpy(&values[block * new_block_size], &blocks->values[block * old_block_size], old_block_size * sizeof(storage_number));
+        freez(blocks->values);
+    }
+    blocks->values = values;
+
+    blocks->used = reallocz(blocks->used, (size_t)columns * sizeof(uint8_t));
+    memset(&blocks->used[blocks->columns], 0, (size_t)(columns - blocks->columns) * sizeof(uint8_t));
+    blocks->columns = columns;
+}
+
+// returns an empty column of the chart for a new dimension
+long rrdset_blocks_add_column(RRDSET *st) {
+    struct rrdset_blocks *blocks = st->blocks;
+    long column, slot;
+
+    if(unlikely(!blocks))
+        blocks = st->blocks = callocz(1, sizeof(struct rrdset_blocks));
+
+    for(column = 0; column < blocks->columns && blocks->used[column] ; column++) ;
+
+    if(column == blocks->columns) {
+        long columns = blocks->columns + blocks->columns / 4;
+        if(columns < blocks->columns + RRDSET_BLOCKS_MIN_COLUMNS) columns = blocks->columns + RRDSET_BLOCKS_MIN_COLUMNS;
+        rrdset_blocks_resize(st, columns);
+    }
+    else {
+        // the column may have the values of a freed dimension
+        for(slot = 0; slot < st->entries ; slot++)
+            *rrdset_blocks_value(blocks, column, slot) = SN_EMPTY_SLOT;
+    }
+
+    blocks->used[column] = 1;
+    return column;
+}
+
+void rrdset_blocks_del_column(RRDSET *st, long column) {
+    st->blocks->used[column] = 0;
+}
+
+void rrdset_blocks_free(RRDSET *st) {
+    if(likely(!st->blocks)) return;
+
+    freez(st->blocks->values);
+    freez(st->blocks->used);
+    freez(st->blocks);
+    st->blocks = NULL;
+}
+
 // ----------------------------------------------------------------------------
 // RRDSET - free a chart
 
@@ -313,6 +540,31 @@ void rrdset_free(RRDSET *st) {
     RRDHOST *host = st->rrdhost;
 
     rrdhost_check_wrlock(host);  // make sure we have a write lock on the host
+
+    // ------------------------------------------------------------------------
+    // unlink it from the host
+
+    // the readers that walk the charts without the host lock may be on it,
+    // so its next pointer is left as it is
+    if(st == host->rrdset_root) {
+        __atomic_store_n(&host->rrdset_root, st->next, __ATOMIC_RELEASE);
+    }
+    else {
+        // find the previous one
+        RRDSET *s;
+        for(s = host->rrdset_root; s && s->next != st ; s = s->next) ;
+
+        // bypass it
+        if(s) __atomic_store_n(&s->next, st->next, __ATOMIC_RELEASE);
+        else error("Request to free RRDSET '%s': cannot find it under host '%s'", st->id, host->hostname);
+    }
+
+    rrdhost_charts_changed(host);
+
+    // wait for the lockless readers that may have found it, without holding its lock,
+    // since they may be waiting for it
+    netdata_epoch_synchronize(&host->rrdset_root_epoch);
+
     rrdset_wrlock(st);                  // lock this RRDSET
 
     // info("Removing chart '%s' ('%s')", st->id, st->name);
@@ -331,28 +583,17 @@ void rrdset_free(RRDSET *st) {
     while(st->variables)  rrdsetvar_free(st->variables);
     while(st->alarms)     rrdsetcalc_unlink(st->alarms);
     while(st->dimensions) rrddim_free(st, st->dimensions);
+    rrdset_blocks_free(st);
+    rrdset_store_batch_free(st);
+    if(st->json_snapshot) rrdhost_json_snapshot_replaced(host, st->json_snapshot);
+    freez(st->prometheus_names);
+    hash_index_destroy(&st->dimensions_index);
 
     rrdfamily_free(host, st->rrdfamily);
 
     debug(D_RRD_CALLS, "RRDSET: Cleaning up remaining chart variables for host '%s', chart '%s'", host->hostname, st->id);
     rrdvar_free_remaining_variables(host, &st->rrdvar_root_index);
 
-    // ------------------------------------------------------------------------
-    // unlink it from the host
-
-    if(st == host->rrdset_root) {
-        host->rrdset_root = st->next;
-    }
-    else {
-        // find the previous one
-        RRDSET *s;
-        for(s = host->rrdset_root; s && s->next != st ; s = s->next) ;
-
-        // bypass it
-        if(s) s->next = st->next;
-        else error("Request to free RRDSET '%s': cannot find it under host '%s'", st->id, host->hostname);
-    }
-
     rrdset_unlock(st);
 
     // ------------------------------------------------------------------------
@@ -360,6 +601,8 @@ void rrdset_free(RRDSET *st) {
 
     netdata_rwlock_destroy(&st->rrdset_rwlock);
 
+    __atomic_sub_fetch(&host->rrd_memory, st->memsize, __ATOMIC_RELAXED);
+
     // free directly allocated members
     freez(st->config_section);
     freez(st->plugin_name);
@@ -369,13 +612,13 @@ void rrdset_free(RRDSET *st) {
         case RRD_MEMORY_MODE_SAVE:
         case RRD_MEMORY_MODE_MAP:
         case RRD_MEMORY_MODE_RAM:
-        case RRD_MEMORY_MODE_DBENGINE:
             debug(D_RRD_CALLS, "Unmapping stats '%s'.", st->name);
             munmap(st, st->memsize);
             break;
 
         case RRD_MEMORY_MODE_ALLOC:
         case RRD_MEMORY_MODE_NONE:
+        case RRD_MEMORY_MODE_DBENGINE:
             freez(st);
             break;
     }
@@ -393,10 +636,8 @@ void rrdset_save(RRDSET *st) {
 
     RRDDIM *rd;
     rrddim_foreach_read(rd, st) {
-        if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE)) {
-            debug(D_RRD_STATS, "Saving dimension '%s' to '%s'.", rd->name, rd->cache_filename);
-            memory_file_save(rd->cache_filename, rd, rd->memsize);
-        }
+        if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE))
+            rrddim_save(rd);
     }
 }
 
@@ -414,11 +655,19 @@ void rrdset_delete(RRDSET *st) {
     }
 
     rrddim_foreach_read(rd, st) {
-        if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE || rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)) {
+        if(unlikely(rd->state->map_file))
+            rrdmap_delete(rd);
+        else if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE || rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)) {
             info("Deleting dimension file '%s'.", rd->cache_filename);
             if(unlikely(unlink(rd->cache_filename) == -1))
                 error("Cannot delete dimension file '%s'", rd->cache_filename);
         }
+#ifdef ENABLE_DBENGINE
+        else if(rd->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+            info("Deleting dimension '%s' from the database engine.", rd->id);
+            rrdeng_delete_metric(rd);
+        }
+#endif
     }
 
     recursively_delete_dir(st->cache_dir, "left-over chart");
@@ -433,11 +682,19 @@ void rrdset_delete_obsolete_dimensions(RRDSET *st) {
 
     rrddim_foreach_read(rd, st) {
         if(rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
-            if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE || rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)) {
+            if(unlikely(rd->state->map_file))
+                rrdmap_delete(rd);
+            else if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE || rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)) {
                 info("Deleting dimension file '%s'.", rd->cache_filename);
                 if(unlikely(unlink(rd->cache_filename) == -1))
                     error("Cannot delete dimension file '%s'", rd->cache_filename);
             }
+#ifdef ENABLE_DBENGINE
+            else if(rd->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+                info("Deleting dimension '%s' from the database engine.", rd->id);
+                rrdeng_delete_metric(rd);
+            }
+#endif
         }
     }
 }
@@ -567,21 +824,20 @@ RRDSET *rrdset_create_custom(
 
     debug(D_RRD_CALLS, "Creating RRD_STATS for '%s.%s'.", type, id);
 
+    // the charts of dbengine are allocated from the heap, like their dimensions
     snprintfz(fullfilename, FILENAME_MAX, "%s/main.db", cache_dir);
     if(memory_mode == RRD_MEMORY_MODE_SAVE || memory_mode == RRD_MEMORY_MODE_MAP ||
-       memory_mode == RRD_MEMORY_MODE_RAM || memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+       memory_mode == RRD_MEMORY_MODE_RAM) {
         st = (RRDSET *) mymmap(
-                  (memory_mode == RRD_MEMORY_MODE_RAM || memory_mode == RRD_MEMORY_MODE_DBENGINE)?NULL:fullfilename
+                  (memory_mode == RRD_MEMORY_MODE_RAM)?NULL:fullfilename
                 , size
                 , ((memory_mode == RRD_MEMORY_MODE_MAP) ? MAP_SHARED : MAP_PRIVATE)
                 , 0
         );
 
         if(st) {
-            memset(&st->avl, 0, sizeof(avl));
-            memset(&st->avlname, 0, sizeof(avl));
             memset(&st->rrdvar_root_index, 0, sizeof(avl_tree_lock));
-            memset(&st->dimensions_index, 0, sizeof(avl_tree_lock));
+            memset(&st->dimensions_index, 0, sizeof(HASH_INDEX));
             memset(&st->rrdset_rwlock, 0, sizeof(netdata_rwlock_t));
 
             st->name = NULL;
@@ -600,9 +856,16 @@ RRDSET *rrdset_create_custom(
             st->next = NULL;
             st->variables = NULL;
             st->alarms = NULL;
+            st->blocks = NULL;
+            st->store_batch = NULL;
+            st->json_snapshot = NULL;
+            st->prometheus_names = NULL;
+            memset(&st->cost, 0, sizeof(st->cost));
+            st->upstream_id = 0;
+            st->replicate_after = 0;
             st->flags = 0x00000000;
 
-            if(memory_mode == RRD_MEMORY_MODE_RAM || memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+            if(memory_mode == RRD_MEMORY_MODE_RAM) {
                 memset(st, 0, size);
             }
             else {
@@ -715,13 +978,23 @@ RRDSET *rrdset_create_custom(
     st->last_collected_time.tv_usec = 0;
     st->counter_done = 0;
     st->rrddim_page_alignment = 0;
+#ifdef ENABLE_DBENGINE
+    if(st->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+        long retention_class = config_get_number(st->config_section, "dbengine retention class", default_rrdeng_retention_class);
+        if(retention_class < 1 || retention_class > RRDENG_MAX_RETENTION_CLASSES) {
+            error("Invalid dbengine retention class %ld given for chart '%s'. Defaulting to %d.", retention_class, st->id, default_rrdeng_retention_class);
+            retention_class = default_rrdeng_retention_class;
+        }
+        st->rrdeng_retention_class = (unsigned)retention_class;
+    }
+#endif
 
     st->gap_when_lost_iterations_above = (int) (gap_when_lost_iterations_above + 2);
 
     st->last_accessed_time = 0;
     st->upstream_resync_time = 0;
 
-    avl_init_lock(&st->dimensions_index, rrddim_compare);
+    hash_index_init(&st->dimensions_index, rrddim_equal);
     avl_init_lock(&st->rrdvar_root_index, rrdvar_compare);
 
     netdata_rwlock_init(&st->rrdset_rwlock);
@@ -738,8 +1011,12 @@ RRDSET *rrdset_create_custom(
 
     st->rrdfamily = rrdfamily_create(host, st->family);
 
+    __atomic_add_fetch(&host->rrd_memory, st->memsize, __ATOMIC_RELAXED);
+
+    // the lockless readers of the charts of the host may find it as soon as it is linked
     st->next = host->rrdset_root;
-    host->rrdset_root = st;
+    __atomic_store_n(&host->rrdset_root, st, __ATOMIC_RELEASE);
+    rrdhost_charts_changed(host);
 
     if(host->health_enabled) {
         rrdsetvar_create(st, "last_collected_t",    RRDVAR_TYPE_TIME_T,     &st->last_collected_time.tv_sec, RRDVAR_OPTION_DEFAULT);
@@ -752,8 +1029,16 @@ RRDSET *rrdset_create_custom(
     if(unlikely(rrdset_index_add(host, st) != st))
         error("RRDSET: INTERNAL ERROR: attempt to index duplicate chart '%s'", st->id);
 
-    rrdsetcalc_link_matching(st);
-    rrdcalctemplate_link_matching(st);
+    if(host == localhost) {
+        rrdsetcalc_link_matching(st);
+        rrdcalctemplate_link_matching(st);
+    }
+    else {
+        // the children send all their charts at once when they connect,
+        // so the health thread links them to their alarms in bulk
+        rrdset_flag_set(st, RRDSET_FLAG_PENDING_HEALTH_LINK);
+        rrdhost_flag_set(host, RRDHOST_FLAG_PENDING_HEALTH_LINK);
+    }
 
     rrdhost_cleanup_obsolete_charts(host);
 
@@ -928,7 +1213,7 @@ static inline usec_t rrdset_init_last_updated_time(RRDSET *st) {
     return last_updated_ut;
 }
 
-static inline void rrdset_done_push_exclusive(RRDSET *st) {
+static inline void rrdset_done_push_exclusive(RRDSET *st, BUFFER *push_batch) {
 //    usec_t update_every_ut = st->update_every * USEC_PER_SEC; // st->update_every in microseconds
 //
 //    if(unlikely(st->usec_since_last_update > update_every_ut * remote_clock_resync_iterations)) {
@@ -951,7 +1236,10 @@ static inline void rrdset_done_push_exclusive(RRDSET *st) {
     st->counter_done++;
 
     rrdset_rdlock(st);
-    rrdset_done_push(st);
+    if(push_batch)
+        rrdset_done_push_batch(st, push_batch);
+    else
+        rrdset_done_push(st);
     rrdset_unlock(st);
 }
 
@@ -979,6 +1267,10 @@ static inline size_t rrdset_done_interpolate(
     size_t counter = st->counter;
     long current_entry = st->current_entry;
 
+    struct rrdset_store_batch *batch = st->store_batch;
+    if(unlikely(!batch))
+        batch = st->store_batch = callocz(1, sizeof(struct rrdset_store_batch));
+
     for( ; next_store_ut <= now_collect_ut ; last_collect_ut = next_store_ut, next_store_ut += update_every_ut, iterations-- ) {
 
         #ifdef NETDATA_INTERNAL_CHECKS
@@ -989,6 +1281,7 @@ static inline size_t rrdset_done_interpolate(
 
         last_ut = next_store_ut;
 
+        batch->used = 0;
         rrddim_foreach_read(rd, st) {
             calculated_number new_value;
 
@@ -1073,25 +1366,13 @@ static inline size_t rrdset_done_interpolate(
             }
 
             if(unlikely(!store_this_entry)) {
-                rd->state->collect_ops.store_metric(rd, next_store_ut, SN_EMPTY_SLOT); //pack_storage_number(0, SN_NOT_EXISTS)
-//                rd->values[current_entry] = SN_EMPTY_SLOT; //pack_storage_number(0, SN_NOT_EXISTS);
+                rrdset_store_batch_add(batch, rd, 0.0, 0); // packs to SN_EMPTY_SLOT
                 continue;
             }
 
             if(likely(rd->updated && rd->collections_counter > 1 && iterations < st->gap_when_lost_iterations_above)) {
-                rd->state->collect_ops.store_metric(rd, next_store_ut, pack_storage_number(new_value, storage_flags));
-//                rd->values[current_entry] = pack_storage_number(new_value, storage_flags );
+                rrdset_store_batch_add(batch, rd, (double)new_value, storage_flags);
                 rd->last_stored_value = new_value;
-
-                #ifdef NETDATA_INTERNAL_CHECKS
-                rrdset_debug(st, "%s: STORE[%ld] "
-                            CALCULATED_NUMBER_FORMAT " = " CALCULATED_NUMBER_FORMAT
-                          , rd->name
-                          , current_entry
-                          , unpack_storage_number(rd->values[current_entry]), new_value
-                );
-                #endif
-
             }
             else {
 
@@ -1102,41 +1383,60 @@ static inline size_t rrdset_done_interpolate(
                 );
                 #endif
 
-//                rd->values[current_entry] = SN_EMPTY_SLOT; // pack_storage_number(0, SN_NOT_EXISTS);
-                rd->state->collect_ops.store_metric(rd, next_store_ut, SN_EMPTY_SLOT); //pack_storage_number(0, SN_NOT_EXISTS)
+                rrdset_store_batch_add(batch, rd, 0.0, 0); // packs to SN_EMPTY_SLOT
                 rd->last_stored_value = NAN;
             }
 
             stored_entries++;
+        }
+
+        // pack the values of all the dimensions at once and store them
+        pack_storage_numbers(batch->values, batch->flags, batch->numbers, batch->used);
+
+        size_t i;
+        for(i = 0; i < batch->used ; i++) {
+            rd = batch->dimensions[i];
+            rd->state->collect_ops->store_metric(rd, next_store_ut, batch->numbers[i]);
 
             #ifdef NETDATA_INTERNAL_CHECKS
-            if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG))) {
-                calculated_number t1 = new_value * (calculated_number)rd->multiplier / (calculated_number)rd->divisor;
-                calculated_number t2 = unpack_storage_number(rd->values[current_entry]);
-
-                calculated_number accuracy = accuracy_loss(t1, t2);
-                debug(D_RRD_STATS, "%s/%s: UNPACK[%ld] = " CALCULATED_NUMBER_FORMAT " FLAGS=0x%08x (original = " CALCULATED_NUMBER_FORMAT ", accuracy loss = " CALCULATED_NUMBER_FORMAT "%%%s)"
-                      , st->id, rd->name
-                      , current_entry
-                      , t2
-                      , get_storage_number_flags(rd->values[current_entry])
-                      , t1
-                      , accuracy
-                      , (accuracy > ACCURACY_LOSS_ACCEPTED_PERCENT) ? " **TOO BIG** " : ""
-                );
+            if(likely(batch->flags[i])) {
+                calculated_number new_value = batch->values[i];
 
-                rd->collected_volume += t1;
-                rd->stored_volume += t2;
-
-                accuracy = accuracy_loss(rd->collected_volume, rd->stored_volume);
-                debug(D_RRD_STATS, "%s/%s: VOLUME[%ld] = " CALCULATED_NUMBER_FORMAT ", calculated  = " CALCULATED_NUMBER_FORMAT ", accuracy loss = " CALCULATED_NUMBER_FORMAT "%%%s"
-                      , st->id, rd->name
-                      , current_entry
-                      , rd->stored_volume
-                      , rd->collected_volume
-                      , accuracy
-                      , (accuracy > ACCURACY_LOSS_ACCEPTED_PERCENT) ? " **TOO BIG** " : ""
+                rrdset_debug(st, "%s: STORE[%ld] "
+                            CALCULATED_NUMBER_FORMAT " = " CALCULATED_NUMBER_FORMAT
+                          , rd->name
+                          , current_entry
+                          , unpack_storage_number(batch->numbers[i]), new_value
                 );
+
+                if(unlikely(rrdset_flag_check(st, RRDSET_FLAG_DEBUG))) {
+                    calculated_number t1 = new_value * (calculated_number)rd->multiplier / (calculated_number)rd->divisor;
+                    calculated_number t2 = unpack_storage_number(batch->numbers[i]);
+
+                    calculated_number accuracy = accuracy_loss(t1, t2);
+                    debug(D_RRD_STATS, "%s/%s: UNPACK[%ld] = " CALCULATED_NUMBER_FORMAT " FLAGS=0x%08x (original = " CALCULATED_NUMBER_FORMAT ", accuracy loss = " CALCULATED_NUMBER_FORMAT "%%%s)"
+                          , st->id, rd->name
+                          , current_entry
+                          , t2
+                          , get_storage_number_flags(batch->numbers[i])
+                          , t1
+                          , accuracy
+                          , (accuracy > ACCURACY_LOSS_ACCEPTED_PERCENT) ? " **TOO BIG** " : ""
+                    );
+
+                    rd->collected_volume += t1;
+                    rd->stored_volume += t2;
+
+                    accuracy = accuracy_loss(rd->collected_volume, rd->stored_volume);
+                    debug(D_RRD_STATS, "%s/%s: VOLUME[%ld] = " CALCULATED_NUMBER_FORMAT ", calculated  = " CALCULATED_NUMBER_FORMAT ", accuracy loss = " CALCULATED_NUMBER_FORMAT "%%%s"
+                          , st->id, rd->name
+                          , current_entry
+                          , rd->stored_volume
+                          , rd->collected_volume
+                          , accuracy
+                          , (accuracy > ACCURACY_LOSS_ACCEPTED_PERCENT) ? " **TOO BIG** " : ""
+                    );
+                }
             }
             #endif
         }
@@ -1176,7 +1476,9 @@ static inline void rrdset_done_fill_the_gap(RRDSET *st) {
         long current_entry = st->current_entry;
 
         for(c = 0; c < entries && next_store_ut <= now_collect_ut ; next_store_ut += update_every_ut, c++) {
-            rd->values[current_entry] = SN_EMPTY_SLOT;
+            *rrddim_slot_value(rd, current_entry) = SN_EMPTY_SLOT;
+            if(unlikely(rd->state->summaries))
+                rrddim_summaries_store(rd, current_entry);
             current_entry = ((current_entry + 1) >= entries) ? 0 : current_entry + 1;
 
             #ifdef NETDATA_INTERNAL_CHECKS
@@ -1195,12 +1497,14 @@ static inline void rrdset_done_fill_the_gap(RRDSET *st) {
     }
 }
 
-void rrdset_done(RRDSET *st) {
-    if(unlikely(netdata_exit)) return;
-
+// stores the values collected for st
+// when push_batch is given, the metrics to be streamed are appended to it,
+// instead of the sender buffer of the host of st
+// the caller has disabled thread cancelability
+static inline void rrdset_done_one(RRDSET *st, BUFFER *push_batch) {
     if(unlikely(st->rrd_memory_mode == RRD_MEMORY_MODE_NONE)) {
         if(unlikely(st->rrdhost->rrdpush_send_enabled))
-            rrdset_done_push_exclusive(st);
+            rrdset_done_push_exclusive(st, push_batch);
 
         return;
     }
@@ -1220,8 +1524,6 @@ void rrdset_done(RRDSET *st) {
             next_store_ut,          // the timestamp in microseconds, of the next entry to store in the db
             update_every_ut = st->update_every * USEC_PER_SEC; // st->update_every in microseconds
 
-    netdata_thread_disable_cancelability();
-
     // a read lock is OK here
     rrdset_rdlock(st);
 
@@ -1344,8 +1646,12 @@ void rrdset_done(RRDSET *st) {
     }
     st->counter_done++;
 
-    if(unlikely(st->rrdhost->rrdpush_send_enabled))
-        rrdset_done_push(st);
+    if(unlikely(st->rrdhost->rrdpush_send_enabled)) {
+        if(push_batch)
+            rrdset_done_push_batch(st, push_batch);
+        else
+            rrdset_done_push(st);
+    }
 
     #ifdef NETDATA_INTERNAL_CHECKS
     rrdset_debug(st, "last_collect_ut = %0.3" LONG_DOUBLE_MODIFIER " (last collection time)", (LONG_DOUBLE)last_collect_ut/USEC_PER_SEC);
@@ -1660,7 +1966,7 @@ void rrdset_done(RRDSET *st) {
     // --------------------------------------------------------------------
 
     // find if there are any obsolete dimensions
-    time_t now = now_realtime_sec();
+    time_t now = now_realtime_coarse_sec();
 
     if(unlikely(rrddim_flag_check(st, RRDSET_FLAG_OBSOLETE_DIMENSIONS))) {
         rrddim_foreach_read(rd, st)
@@ -1678,11 +1984,19 @@ void rrdset_done(RRDSET *st) {
                 if(unlikely(rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE) && (rd->last_collected_time.tv_sec + rrdset_free_obsolete_time < now))) {
                     info("Removing obsolete dimension '%s' (%s) of '%s' (%s).", rd->name, rd->id, st->name, st->id);
 
-                    if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE || rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)) {
+                    if(unlikely(rd->state->map_file))
+                        rrdmap_delete(rd);
+                    else if(likely(rd->rrd_memory_mode == RRD_MEMORY_MODE_SAVE || rd->rrd_memory_mode == RRD_MEMORY_MODE_MAP)) {
                         info("Deleting dimension file '%s'.", rd->cache_filename);
                         if(unlikely(unlink(rd->cache_filename) == -1))
                             error("Cannot delete dimension file '%s'", rd->cache_filename);
                     }
+#ifdef ENABLE_DBENGINE
+                    else if(rd->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) {
+                        info("Deleting dimension '%s' from the database engine.", rd->id);
+                        rrdeng_delete_metric(rd);
+                    }
+#endif
 
                     if(unlikely(!last)) {
                         rrddim_free(st, rd);
@@ -1707,5 +2021,68 @@ void rrdset_done(RRDSET *st) {
 
     rrdset_unlock(st);
 
+    // an alarm of this chart waits for this point
+    time_t alarms_due = st->alarms_due;
+    if(unlikely(alarms_due && st->last_updated.tv_sec >= alarms_due)) {
+        st->alarms_due = 0;
+        health_wakeup();
+    }
+}
+
+// rrdset_done_one(), accounting its time to the cost of st
+static inline void rrdset_done_one_costed(RRDSET *st, BUFFER *push_batch) {
+    usec_t started_ut = now_monotonic_usec();
+
+    rrdset_done_one(st, push_batch);
+
+    usec_t dt = now_monotonic_usec() - started_ut;
+    __atomic_store_n(&st->cost.done_usec, st->cost.done_usec + dt, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->cost.collections, st->cost.collections + 1, __ATOMIC_RELAXED);
+    rrdset_done_completed(dt);
+}
+
+void rrdset_done(RRDSET *st) {
+    if(unlikely(netdata_exit)) return;
+
+    netdata_thread_disable_cancelability();
+    rrdset_done_one_costed(st, NULL);
+    netdata_thread_enable_cancelability();
+}
+
+// commits the values collected for all the charts at once, like calling rrdset_done() for each of them,
+// but the metrics of the charts are streamed together, locking the sender buffer of their host
+// and waking up its sender once, instead of once per chart
+void rrdset_done_many(RRDSET **charts, size_t count) {
+    static __thread BUFFER *push_batch = NULL;
+    RRDHOST *push_host = NULL;
+    size_t i;
+
+    if(unlikely(netdata_exit)) return;
+
+    netdata_thread_disable_cancelability();
+
+    for(i = 0; i < count ; i++) {
+        RRDSET *st = charts[i];
+
+        if(unlikely(!st->rrdhost->rrdpush_send_enabled)) {
+            rrdset_done_one_costed(st, NULL);
+            continue;
+        }
+
+        // the batch has the metrics of one host
+        if(unlikely(push_host != st->rrdhost)) {
+            if(push_host) rrdpush_send_batch(push_host, push_batch);
+            push_host = st->rrdhost;
+        }
+
+        if(unlikely(!push_batch))
+            push_batch = buffer_create(4096);
+
+        rrdset_done_one_costed(st, push_batch);
+    }
+
+    if(push_host)
+        rrdpush_send_batch(push_host, push_batch);
+
     netdata_thread_enable_cancelability();
 }
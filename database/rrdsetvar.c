@@ -41,6 +41,13 @@ static inline void rrdsetvar_free_variables(RRDSETVAR *rs) {
     rs->key_fullname = NULL;
 }
 
+// the variables of the charts are indexed only on the hosts that have alarms
+// (see rrdhost_index_variables()), except the custom chart variables, that are
+// also exported through the host index (i.e. to prometheus)
+static inline int rrdsetvar_is_indexed(RRDSETVAR *rs) {
+    return (rs->options & RRDVAR_OPTION_CUSTOM_CHART_VAR) || rrdhost_flag_check(rs->rrdset->rrdhost, RRDHOST_FLAG_VARIABLES_INDEXED);
+}
+
 static inline void rrdsetvar_create_variables(RRDSETVAR *rs) {
     RRDSET *st = rs->rrdset;
     RRDHOST *host = st->rrdhost;
@@ -93,17 +100,26 @@ RRDSETVAR *rrdsetvar_create(RRDSET *st, const char *variable, RRDVAR_TYPE type,
     rs->next = st->variables;
     st->variables = rs;
 
-    rrdsetvar_create_variables(rs);
+    if(rrdsetvar_is_indexed(rs))
+        rrdsetvar_create_variables(rs);
 
     return rs;
 }
 
+void rrdsetvar_index_all(RRDSET *st) {
+    RRDSETVAR *rs;
+    for(rs = st->variables; rs ; rs = rs->next)
+        if(!rs->key_fullid)
+            rrdsetvar_create_variables(rs);
+}
+
 void rrdsetvar_rename_all(RRDSET *st) {
     debug(D_VARIABLES, "RRDSETVAR rename for chart id '%s' name '%s'", st->id, st->name);
 
     RRDSETVAR *rs;
     for(rs = st->variables; rs ; rs = rs->next)
-        rrdsetvar_create_variables(rs);
+        if(rrdsetvar_is_indexed(rs))
+            rrdsetvar_create_variables(rs);
 
     rrdsetcalc_link_matching(st);
 }
@@ -118,7 +134,7 @@ void rrdsetvar_free(RRDSETVAR *rs) {
     else {
         RRDSETVAR *t;
         for (t = st->variables; t && t->next != rs; t = t->next);
-        if(!t) error("RRDSETVAR '%s' not found in chart '%s' variables linked list", rs->key_fullname, st->id);
+        if(!t) error("RRDSETVAR '%s' not found in chart '%s' variables linked list", rs->variable, st->id);
         else t->next = rs->next;
     }
 
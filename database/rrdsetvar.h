@@ -38,6 +38,7 @@ extern RRDSETVAR *rrdsetvar_custom_chart_variable_create(RRDSET *st, const char
 extern void rrdsetvar_custom_chart_variable_set(RRDSETVAR *rv, calculated_number value);
 
 extern void rrdsetvar_rename_all(RRDSET *st);
+extern void rrdsetvar_index_all(RRDSET *st);
 extern RRDSETVAR *rrdsetvar_create(RRDSET *st, const char *variable, RRDVAR_TYPE type, void *value, RRDVAR_OPTIONS options);
 extern void rrdsetvar_free(RRDSETVAR *rs);
 
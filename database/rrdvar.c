@@ -23,6 +23,7 @@ inline int rrdvar_fix_name(char *variable) {
 int rrdvar_compare(void* a, void* b) {
     if(((RRDVAR *)a)->hash < ((RRDVAR *)b)->hash) return -1;
     else if(((RRDVAR *)a)->hash > ((RRDVAR *)b)->hash) return 1;
+    else if(((RRDVAR *)a)->name == ((RRDVAR *)b)->name) return 0;
     else return strcmp(((RRDVAR *)a)->name, ((RRDVAR *)b)->name);
 }
 
@@ -44,17 +45,23 @@ static inline RRDVAR *rrdvar_index_del(avl_tree_lock *tree, RRDVAR *rv) {
 
 static inline RRDVAR *rrdvar_index_find(avl_tree_lock *tree, const char *name, uint32_t hash) {
     RRDVAR tmp;
-    tmp.name = (char *)name;
+    tmp.name = name;
     tmp.hash = (hash)?hash:simple_hash(tmp.name);
 
     return (RRDVAR *)avl_search_lock(tree, (avl *)&tmp);
 }
 
+// incremented every time a variable is added or removed,
+// to rebind the variables of the alarm expressions
+static volatile uint32_t rrdvar_version = 1;
+
 inline void rrdvar_free(RRDHOST *host, avl_tree_lock *tree, RRDVAR *rv) {
     (void)host;
 
     if(!rv) return;
 
+    __atomic_add_fetch(&rrdvar_version, 1, __ATOMIC_RELEASE);
+
     if(tree) {
         debug(D_VARIABLES, "Deleting variable '%s'", rv->name);
         if(unlikely(!rrdvar_index_del(tree, rv)))
@@ -64,7 +71,7 @@ inline void rrdvar_free(RRDHOST *host, avl_tree_lock *tree, RRDVAR *rv) {
     if(rv->options & RRDVAR_OPTION_ALLOCATED)
         freez(rv->value);
 
-    freez(rv->name);
+    string_pool_release(rv->name);
     freez(rv);
 }
 
@@ -78,7 +85,7 @@ inline RRDVAR *rrdvar_create_and_index(const char *scope, avl_tree_lock *tree, c
         debug(D_VARIABLES, "Variable '%s' not found in scope '%s'. Creating a new one.", variable, scope);
 
         rv = callocz(1, sizeof(RRDVAR));
-        rv->name = variable;
+        rv->name = string_pool_get(variable);
         rv->hash = hash;
         rv->type = type;
         rv->options = options;
@@ -88,12 +95,16 @@ inline RRDVAR *rrdvar_create_and_index(const char *scope, avl_tree_lock *tree, c
         RRDVAR *ret = rrdvar_index_add(tree, rv);
         if(unlikely(ret != rv)) {
             debug(D_VARIABLES, "Variable '%s' in scope '%s' already exists", variable, scope);
+            string_pool_release(rv->name);
             freez(rv);
-            freez(variable);
             rv = NULL;
         }
-        else
+        else {
+            __atomic_add_fetch(&rrdvar_version, 1, __ATOMIC_RELEASE);
             debug(D_VARIABLES, "Variable '%s' created in scope '%s'", variable, scope);
+        }
+
+        freez(variable);
     }
     else {
         debug(D_VARIABLES, "Variable '%s' is already found in scope '%s'.", variable, scope);
@@ -124,6 +135,47 @@ void rrdvar_free_remaining_variables(RRDHOST *host, avl_tree_lock *tree_lock) {
     }
 }
 
+// ----------------------------------------------------------------------------
+// lazy indexing of the chart and dimension variables
+//
+// the variables of the charts and the dimensions are only needed by the alarms,
+// so they are indexed only when the host gets its first alarm. Until then, the
+// RRDSETVARs and the RRDDIMVARs are just kept at their charts and dimensions.
+
+// the host has to be write locked
+void rrdhost_index_variables_nolock(RRDHOST *host) {
+    if(rrdhost_flag_check(host, RRDHOST_FLAG_VARIABLES_INDEXED))
+        return;
+
+    // set before walking the charts, so that the dimensions added
+    // meanwhile (under the chart lock) are indexed by rrddimvar_create()
+    rrdhost_flag_set(host, RRDHOST_FLAG_VARIABLES_INDEXED);
+
+    debug(D_VARIABLES, "Indexing the chart variables of host '%s'", host->hostname);
+
+    RRDSET *st;
+    rrdset_foreach_write(st, host) {
+        rrdset_wrlock(st);
+
+        rrdsetvar_index_all(st);
+
+        RRDDIM *rd;
+        rrddim_foreach_write(rd, st)
+            rrddimvar_index_all(rd);
+
+        rrdset_unlock(st);
+    }
+}
+
+void rrdhost_index_variables(RRDHOST *host) {
+    if(likely(rrdhost_flag_check(host, RRDHOST_FLAG_VARIABLES_INDEXED)))
+        return;
+
+    rrdhost_wrlock(host);
+    rrdhost_index_variables_nolock(host);
+    rrdhost_unlock(host);
+}
+
 // ----------------------------------------------------------------------------
 // CUSTOM HOST VARIABLES
 
@@ -213,26 +265,23 @@ calculated_number rrdvar2number(RRDVAR *rv) {
     }
 }
 
-int health_variable_lookup(const char *variable, uint32_t hash, RRDCALC *rc, calculated_number *result) {
-    RRDSET *st = rc->rrdset;
-    if(!st) return 0;
-
-    RRDHOST *host = st->rrdhost;
+static inline RRDVAR *health_variable_find(const char *variable, uint32_t hash, RRDSET *st) {
     RRDVAR *rv;
 
     rv = rrdvar_index_find(&st->rrdvar_root_index, variable, hash);
-    if(rv) {
-        *result = rrdvar2number(rv);
-        return 1;
-    }
+    if(rv) return rv;
 
     rv = rrdvar_index_find(&st->rrdfamily->rrdvar_root_index, variable, hash);
-    if(rv) {
-        *result = rrdvar2number(rv);
-        return 1;
-    }
+    if(rv) return rv;
+
+    return rrdvar_index_find(&st->rrdhost->rrdvar_root_index, variable, hash);
+}
 
-    rv = rrdvar_index_find(&host->rrdvar_root_index, variable, hash);
+int health_variable_lookup(const char *variable, uint32_t hash, RRDCALC *rc, calculated_number *result) {
+    RRDSET *st = rc->rrdset;
+    if(!st) return 0;
+
+    RRDVAR *rv = health_variable_find(variable, hash, st);
     if(rv) {
         *result = rrdvar2number(rv);
         return 1;
@@ -241,6 +290,34 @@ int health_variable_lookup(const char *variable, uint32_t hash, RRDCALC *rc, cal
     return 0;
 }
 
+static calculated_number health_variable_bound_value(void *bound) {
+    return rrdvar2number((RRDVAR *)bound);
+}
+
+// bind the variables of an expression to the RRDVARs they resolve to,
+// so that evaluating it does not search the indexes.
+// they are bound again only when variables are added or removed.
+void health_expression_bind_variables(EVAL_EXPRESSION *exp, RRDCALC *rc) {
+    if(unlikely(!exp)) return;
+
+    RRDSET *st = rc->rrdset;
+    if(unlikely(!st)) {
+        exp->bound_value = NULL;
+        return;
+    }
+
+    uint32_t version = __atomic_load_n(&rrdvar_version, __ATOMIC_ACQUIRE);
+    if(likely(exp->bound_value && exp->bound_version == version))
+        return;
+
+    EVAL_VARIABLE *v;
+    for(v = exp->variables; v ; v = v->next)
+        v->bound = health_variable_find(v->name, v->hash, st);
+
+    exp->bound_version = version;
+    exp->bound_value = health_variable_bound_value;
+}
+
 // ----------------------------------------------------------------------------
 // RRDVAR to JSON
 
@@ -267,6 +344,9 @@ static int single_variable2json(void *entry, void *data) {
 void health_api_v1_chart_variables2json(RRDSET *st, BUFFER *buf) {
     RRDHOST *host = st->rrdhost;
 
+    // show them, even if no alarm has needed them yet
+    rrdhost_index_variables(host);
+
     struct variable2json_helper helper = {
             .buf = buf,
             .counter = 0
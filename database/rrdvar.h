@@ -34,7 +34,7 @@ typedef enum rrdvar_options {
 struct rrdvar {
     avl avl;
 
-    char *name;
+    const char *name;                   // from the string pool
     uint32_t hash;
 
     RRDVAR_TYPE type;
@@ -60,6 +60,9 @@ extern int  rrdvar_callback_for_all_host_variables(RRDHOST *host, int (*callback
 
 extern calculated_number rrdvar2number(RRDVAR *rv);
 
+extern void rrdhost_index_variables(RRDHOST *host);
+extern void rrdhost_index_variables_nolock(RRDHOST *host);
+
 extern RRDVAR *rrdvar_create_and_index(const char *scope, avl_tree_lock *tree, const char *name, RRDVAR_TYPE type, RRDVAR_OPTIONS options, void *value);
 extern void rrdvar_free(RRDHOST *host, avl_tree_lock *tree, RRDVAR *rv);
 
@@ -10,6 +10,47 @@ struct health_cmdapi_thread_status {
 
 unsigned int default_health_enabled = 1;
 
+static int health_incremental_lookups = 1;
+static int health_shared_lookups = 1;
+
+// ----------------------------------------------------------------------------
+// waking up the health thread when charts with pending alarms get new data
+
+static struct {
+    netdata_mutex_t mutex;
+    pthread_cond_t cond;
+    int pending;
+} health_wakeup_data = {
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .pending = 0
+};
+
+/**
+ * Wake up
+ *
+ * Called by rrdset_done() when a chart has stored the point one of its alarms waits for.
+ */
+void health_wakeup(void) {
+    netdata_mutex_lock(&health_wakeup_data.mutex);
+    health_wakeup_data.pending = 1;
+    pthread_cond_signal(&health_wakeup_data.cond);
+    netdata_mutex_unlock(&health_wakeup_data.mutex);
+}
+
+// sleep up to the given time, or until health_wakeup() is called
+static void health_sleep_until(time_t until) {
+    struct timespec deadline = { .tv_sec = until, .tv_nsec = 0 };
+
+    netdata_mutex_lock(&health_wakeup_data.mutex);
+    while(!health_wakeup_data.pending && !netdata_exit) {
+        if(pthread_cond_timedwait(&health_wakeup_data.cond, &health_wakeup_data.mutex, &deadline) == ETIMEDOUT)
+            break;
+    }
+    health_wakeup_data.pending = 0;
+    netdata_mutex_unlock(&health_wakeup_data.mutex);
+}
+
 // ----------------------------------------------------------------------------
 // health initialization
 
@@ -84,9 +125,91 @@ void health_init(void) {
         return;
     }
 
+    health_incremental_lookups = config_get_boolean(CONFIG_SECTION_HEALTH, "incremental database lookups", health_incremental_lookups);
+    health_shared_lookups = config_get_boolean(CONFIG_SECTION_HEALTH, "shared database lookups", health_shared_lookups);
+
     health_silencers_init();
 }
 
+// ----------------------------------------------------------------------------
+// load the health configuration and the alarm log of a host
+
+/**
+ * Load host
+ *
+ * Load the alarms and the alarm log of a host. localhost is loaded when it is
+ * created. The other hosts are created when their child connects, with all
+ * the hosts write locked, so the health thread loads them the first time it
+ * runs for them.
+ *
+ * @param host the structure of the host that the function will load.
+ */
+static inline void health_link_chart(RRDSET *st) {
+    rrdset_flag_clear(st, RRDSET_FLAG_PENDING_HEALTH_LINK);
+    rrdsetcalc_link_matching(st);
+    rrdcalctemplate_link_matching(st);
+}
+
+void health_host_load(RRDHOST *host) {
+    if(unlikely(host->health_loaded))
+        return;
+
+    rrdhost_wrlock(host);
+    health_readdir(host, health_user_config_dir(), health_stock_config_dir(), NULL);
+
+    // the alarms need the variables of the charts
+    if(host->alarms || host->templates)
+        rrdhost_index_variables_nolock(host);
+
+    rrdhost_unlock(host);
+
+    health_alarm_log_load(host);
+    health_alarm_log_open(host);
+
+    // link the loaded alarms to the charts the child has already sent,
+    // after the alarm log is loaded, since this logs their initial status
+    rrdhost_wrlock(host);
+
+    rrdhost_flag_clear(host, RRDHOST_FLAG_PENDING_HEALTH_LINK);
+
+    RRDSET *st;
+    rrdset_foreach_write(st, host)
+        health_link_chart(st);
+
+    host->health_loaded = 1;
+    rrdhost_unlock(host);
+}
+
+/**
+ * Link pending charts
+ *
+ * The charts of the children are created without linking them to their alarms,
+ * so that a child (or many of them, after the parent is restarted) can send
+ * thousands of chart definitions at once, without waiting for health.
+ * The health thread links them here, in one pass.
+ *
+ * @param host the structure of the host with the charts to link.
+ */
+static void health_host_link_pending_charts(RRDHOST *host) {
+    rrdhost_wrlock(host);
+
+    // the charts are created with the host write locked, so none is missed
+    rrdhost_flag_clear(host, RRDHOST_FLAG_PENDING_HEALTH_LINK);
+
+    size_t linked = 0;
+    RRDSET *st;
+    rrdset_foreach_write(st, host) {
+        if(rrdset_flag_check(st, RRDSET_FLAG_PENDING_HEALTH_LINK)) {
+            health_link_chart(st);
+            linked++;
+        }
+    }
+
+    rrdhost_unlock(host);
+
+    debug(D_HEALTH, "Health linked %zu new charts of host '%s'", linked, host->hostname);
+}
+
 // ----------------------------------------------------------------------------
 // re-load health configuration
 
@@ -98,7 +221,8 @@ void health_init(void) {
  * @param host the structure of the host that the function will reload the configuration.
  */
 void health_reload_host(RRDHOST *host) {
-    if(unlikely(!host->health_enabled))
+    // the hosts not loaded yet, will load the new configuration
+    if(unlikely(!host->health_enabled || !host->health_loaded))
         return;
 
     char *user_path = health_user_config_dir();
@@ -135,11 +259,13 @@ void health_reload_host(RRDHOST *host) {
     rrdhost_wrlock(host);
     health_readdir(host, user_path, stock_path, NULL);
 
+    if(host->alarms || host->templates)
+        rrdhost_index_variables_nolock(host);
+
     // link the loaded alarms to their charts
-    rrdset_foreach_write(st, host) {
-        rrdsetcalc_link_matching(st);
-        rrdcalctemplate_link_matching(st);
-    }
+    rrdhost_flag_clear(host, RRDHOST_FLAG_PENDING_HEALTH_LINK);
+    rrdset_foreach_write(st, host)
+        health_link_chart(st);
 
     rrdhost_unlock(host);
 }
@@ -169,6 +295,381 @@ static inline RRDCALC_STATUS rrdcalc_value2status(calculated_number n) {
     return RRDCALC_STATUS_CLEAR;
 }
 
+// ----------------------------------------------------------------------------
+// alarm notifications executor
+//
+// the notifications are run by a pool of threads, so that slow notification
+// methods do not delay the evaluation of the alarms. the health threads queue
+// them and apply their exit codes to the alarm log on their next iteration.
+// a queued notification that has not started yet is replaced by a newer one
+// of the same alarm, and recipients can be limited to a number of
+// notifications per minute.
+
+struct health_notification {
+    RRDHOST *host;
+    uint32_t unique_id;
+    uint32_t alarm_id;
+
+    char *recipient;
+    uint32_t recipient_hash;
+
+    char *command;
+    int exec_code;
+    int coalesced;                  // replaced by a newer notification of the same alarm, before it run
+
+    struct health_notification *next;
+};
+
+struct health_notification_recipient {
+    char *name;
+    uint32_t hash;
+
+    time_t minute;                  // the minute sent is counted for
+    size_t sent;
+
+    struct health_notification_recipient *next;
+};
+
+static struct {
+    size_t threads;                 // 0 = run them synchronously
+    netdata_thread_t *workers;
+    size_t max_queued;
+    size_t max_per_recipient;       // per minute, 0 = unlimited
+
+    netdata_mutex_t mutex;
+    pthread_cond_t cond_queued;     // a notification has been queued
+    pthread_cond_t cond_finished;   // a notification has finished running
+    int stop;
+
+    struct health_notification *queued;     // oldest first
+    struct health_notification *running;
+    struct health_notification *finished;   // to be applied to the alarm log
+    size_t queued_count;
+
+    struct health_notification_recipient *recipients;
+} health_notifications = {
+        .threads = 0,
+        .workers = NULL,
+        .max_queued = 1000,
+        .max_per_recipient = 0,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond_queued = PTHREAD_COND_INITIALIZER,
+        .cond_finished = PTHREAD_COND_INITIALIZER,
+        .stop = 0,
+        .queued = NULL,
+        .running = NULL,
+        .finished = NULL,
+        .queued_count = 0,
+        .recipients = NULL
+};
+
+static int health_notification_run(const char *command) {
+    pid_t command_pid;
+
+    debug(D_HEALTH, "executing command '%s'", command);
+    FILE *fp = mypopen(command, &command_pid);
+    if(!fp) {
+        error("HEALTH: Cannot popen(\"%s\", \"r\").", command);
+        return -1;
+    }
+    debug(D_HEALTH, "HEALTH reading from command (discarding command's output)");
+    char buffer[100 + 1];
+    while(fgets(buffer, 100, fp) != NULL) ;
+    int exec_code = mypclose(fp, command_pid);
+    debug(D_HEALTH, "done executing command - returned with code %d", exec_code);
+
+    return exec_code;
+}
+
+static void health_notification_free(struct health_notification *n) {
+    freez(n->recipient);
+    freez(n->command);
+    freez(n);
+}
+
+// returns 1 if the recipient can get one more notification now
+// it has to be called with the mutex locked
+static int health_notification_recipient_allowed(struct health_notification *n, time_t now) {
+    if(!health_notifications.max_per_recipient)
+        return 1;
+
+    struct health_notification_recipient *r;
+    for(r = health_notifications.recipients; r ; r = r->next)
+        if(r->hash == n->recipient_hash && !strcmp(r->name, n->recipient))
+            break;
+
+    if(unlikely(!r)) {
+        r = callocz(1, sizeof(struct health_notification_recipient));
+        r->name = strdupz(n->recipient);
+        r->hash = n->recipient_hash;
+        r->next = health_notifications.recipients;
+        health_notifications.recipients = r;
+    }
+
+    if(r->minute != now / 60) {
+        r->minute = now / 60;
+        r->sent = 0;
+    }
+
+    if(r->sent >= health_notifications.max_per_recipient)
+        return 0;
+
+    r->sent++;
+    return 1;
+}
+
+// get the oldest queued notification allowed to run
+// it has to be called with the mutex locked
+static struct health_notification *health_notification_get(int *rate_limited) {
+    time_t now = now_realtime_sec();
+    struct health_notification *n, *last = NULL;
+
+    *rate_limited = 0;
+
+    for(n = health_notifications.queued; n ; last = n, n = n->next) {
+        if(likely(health_notification_recipient_allowed(n, now))) {
+            if(last) last->next = n->next;
+            else health_notifications.queued = n->next;
+
+            health_notifications.queued_count--;
+            n->next = NULL;
+            return n;
+        }
+
+        *rate_limited = 1;
+    }
+
+    return NULL;
+}
+
+static void *health_notification_worker_main(void *ptr) {
+    (void)ptr;
+
+    netdata_mutex_lock(&health_notifications.mutex);
+    while(!health_notifications.stop) {
+        int rate_limited;
+        struct health_notification *n = health_notification_get(&rate_limited);
+
+        if(!n) {
+            if(rate_limited) {
+                // check again when the recipients may have budget again
+                struct timespec deadline = { .tv_sec = now_realtime_sec() + 1, .tv_nsec = 0 };
+                pthread_cond_timedwait(&health_notifications.cond_queued, &health_notifications.mutex, &deadline);
+            }
+            else
+                pthread_cond_wait(&health_notifications.cond_queued, &health_notifications.mutex);
+
+            continue;
+        }
+
+        n->next = health_notifications.running;
+        health_notifications.running = n;
+        netdata_mutex_unlock(&health_notifications.mutex);
+
+        n->exec_code = health_notification_run(n->command);
+
+        netdata_mutex_lock(&health_notifications.mutex);
+
+        struct health_notification *t, *last = NULL;
+        for(t = health_notifications.running; t && t != n ; last = t, t = t->next) ;
+        if(last) last->next = n->next;
+        else health_notifications.running = n->next;
+
+        n->next = health_notifications.finished;
+        health_notifications.finished = n;
+
+        pthread_cond_broadcast(&health_notifications.cond_finished);
+    }
+    netdata_mutex_unlock(&health_notifications.mutex);
+
+    return NULL;
+}
+
+static void health_notifications_start(void) {
+    long long threads = config_get_number(CONFIG_SECTION_HEALTH, "notification threads", 4);
+    if(threads < 0) threads = 0;
+
+    long long max_queued = config_get_number(CONFIG_SECTION_HEALTH, "max queued notifications", (long long)health_notifications.max_queued);
+    if(max_queued < 1) max_queued = 1;
+
+    long long max_per_recipient = config_get_number(CONFIG_SECTION_HEALTH, "max notifications per recipient per minute", 0);
+    if(max_per_recipient < 0) max_per_recipient = 0;
+
+    health_notifications.max_queued = (size_t)max_queued;
+    health_notifications.max_per_recipient = (size_t)max_per_recipient;
+
+    if(!threads)
+        return;
+
+    health_notifications.workers = callocz((size_t)threads, sizeof(netdata_thread_t));
+
+    size_t i;
+    for(i = 0; i < (size_t)threads ; i++) {
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "HEALTH_NOTIFY[%zu]", i + 1);
+
+        if(netdata_thread_create(&health_notifications.workers[health_notifications.threads], tag, NETDATA_THREAD_OPTION_JOINABLE, health_notification_worker_main, NULL))
+            error("HEALTH: cannot create health notification thread %zu", i + 1);
+        else
+            health_notifications.threads++;
+    }
+}
+
+static void health_notifications_stop(void) {
+    netdata_mutex_lock(&health_notifications.mutex);
+    health_notifications.stop = 1;
+    pthread_cond_broadcast(&health_notifications.cond_queued);
+    netdata_mutex_unlock(&health_notifications.mutex);
+
+    size_t i;
+    for(i = 0; i < health_notifications.threads ; i++)
+        netdata_thread_join(health_notifications.workers[i], NULL);
+
+    if(health_notifications.queued_count)
+        info("HEALTH: %zu queued alarm notifications have not been sent, because netdata is exiting.", health_notifications.queued_count);
+}
+
+// queue the notification of an alarm log entry
+static void health_notification_queue(RRDHOST *host, ALARM_ENTRY *ae, const char *recipient, const char *command) {
+    netdata_mutex_lock(&health_notifications.mutex);
+
+    // a queued notification of the same alarm has not started yet - this one replaces it
+    struct health_notification *n, *last = NULL;
+    for(n = health_notifications.queued; n ; last = n, n = n->next) {
+        if(n->host == host && n->alarm_id == ae->alarm_id) {
+            if(last) last->next = n->next;
+            else health_notifications.queued = n->next;
+            health_notifications.queued_count--;
+
+            n->coalesced = 1;
+            n->next = health_notifications.finished;
+            health_notifications.finished = n;
+            break;
+        }
+    }
+
+    if(unlikely(health_notifications.queued_count >= health_notifications.max_queued)) {
+        netdata_mutex_unlock(&health_notifications.mutex);
+
+        error("HEALTH [%s]: cannot queue the notification for alarm '%s.%s' status %s, %zu notifications are already queued."
+              , host->hostname, ae->chart, ae->name, rrdcalc_status2string(ae->new_status), health_notifications.max_queued);
+
+        ae->exec_code = -1;
+        ae->flags |= HEALTH_ENTRY_FLAG_EXEC_FAILED;
+        return;
+    }
+
+    n = callocz(1, sizeof(struct health_notification));
+    n->host = host;
+    n->unique_id = ae->unique_id;
+    n->alarm_id = ae->alarm_id;
+    n->recipient = strdupz(recipient);
+    n->recipient_hash = simple_hash(n->recipient);
+    n->command = strdupz(command);
+
+    for(last = health_notifications.queued; last && last->next ; last = last->next) ;
+    if(last) last->next = n;
+    else health_notifications.queued = n;
+    health_notifications.queued_count++;
+
+    pthread_cond_signal(&health_notifications.cond_queued);
+    netdata_mutex_unlock(&health_notifications.mutex);
+}
+
+// apply the results of the finished notifications of a host to its alarm log
+static void health_notifications_apply(RRDHOST *host) {
+    struct health_notification *mine = NULL, *n, *next, *last = NULL;
+
+    netdata_mutex_lock(&health_notifications.mutex);
+    for(n = health_notifications.finished; n ; n = next) {
+        next = n->next;
+
+        if(n->host == host) {
+            if(last) last->next = next;
+            else health_notifications.finished = next;
+
+            n->next = mine;
+            mine = n;
+        }
+        else
+            last = n;
+    }
+    netdata_mutex_unlock(&health_notifications.mutex);
+
+    if(likely(!mine))
+        return;
+
+    netdata_rwlock_rdlock(&host->health_log.alarm_log_rwlock);
+
+    for(n = mine; n ; n = next) {
+        next = n->next;
+
+        ALARM_ENTRY *ae;
+        for(ae = host->health_log.alarms; ae && ae->unique_id > n->unique_id ; ae = ae->next) ;
+
+        if(likely(ae && ae->unique_id == n->unique_id)) {
+            if(n->coalesced) {
+                // it was never sent
+                ae->flags &= ~HEALTH_ENTRY_FLAG_EXEC_RUN;
+                debug(D_HEALTH, "Health notification for alarm '%s.%s' status %s was replaced by a newer one", ae->chart, ae->name, rrdcalc_status2string(ae->new_status));
+            }
+            else {
+                ae->exec_code = n->exec_code;
+                if(ae->exec_code != 0)
+                    ae->flags |= HEALTH_ENTRY_FLAG_EXEC_FAILED;
+            }
+
+            health_alarm_log_save(host, ae);
+        }
+
+        health_notification_free(n);
+    }
+
+    netdata_rwlock_unlock(&host->health_log.alarm_log_rwlock);
+}
+
+/**
+ * Notifications host cleanup
+ *
+ * Drops the queued and finished notifications of a host that is being freed,
+ * after its running notifications finish.
+ *
+ * @param host the host being freed.
+ */
+void health_notifications_host_cleanup(RRDHOST *host) {
+    struct health_notification **list[] = { &health_notifications.queued, &health_notifications.finished, NULL };
+    struct health_notification *n, *next, *last;
+    int i;
+
+    netdata_mutex_lock(&health_notifications.mutex);
+
+    while(1) {
+        for(n = health_notifications.running; n && n->host != host ; n = n->next) ;
+        if(!n) break;
+        pthread_cond_wait(&health_notifications.cond_finished, &health_notifications.mutex);
+    }
+
+    for(i = 0; list[i] ; i++) {
+        for(last = NULL, n = *list[i]; n ; n = next) {
+            next = n->next;
+
+            if(n->host == host) {
+                if(last) last->next = next;
+                else *list[i] = next;
+
+                if(list[i] == &health_notifications.queued)
+                    health_notifications.queued_count--;
+
+                health_notification_free(n);
+            }
+            else
+                last = n;
+        }
+    }
+
+    netdata_mutex_unlock(&health_notifications.mutex);
+}
+
 #define ALARM_EXEC_COMMAND_LENGTH 8192
 
 static inline void health_alarm_execute(RRDHOST *host, ALARM_ENTRY *ae) {
@@ -224,8 +725,7 @@ static inline void health_alarm_execute(RRDHOST *host, ALARM_ENTRY *ae) {
         goto done;
     }
 
-    static char command_to_run[ALARM_EXEC_COMMAND_LENGTH + 1];
-    pid_t command_pid;
+    static __thread char command_to_run[ALARM_EXEC_COMMAND_LENGTH + 1];
 
     const char *exec      = (ae->exec)      ? ae->exec      : host->health_default_exec;
     const char *recipient = (ae->recipient) ? ae->recipient : host->health_default_recipient;
@@ -275,7 +775,7 @@ static inline void health_alarm_execute(RRDHOST *host, ALARM_ENTRY *ae) {
               ae->new_value_string,
               ae->old_value_string,
               (expr && expr->source)?expr->source:"NOSOURCE",
-              (expr && expr->error_msg)?buffer_tostring(expr->error_msg):"NOERRMSG",
+              (expr && expr->error_msg)?expression_error_msg(expr):"NOERRMSG",
               n_warn,
               n_crit
     );
@@ -283,18 +783,12 @@ static inline void health_alarm_execute(RRDHOST *host, ALARM_ENTRY *ae) {
     ae->flags |= HEALTH_ENTRY_FLAG_EXEC_RUN;
     ae->exec_run_timestamp = now_realtime_sec();
 
-    debug(D_HEALTH, "executing command '%s'", command_to_run);
-    FILE *fp = mypopen(command_to_run, &command_pid);
-    if(!fp) {
-        error("HEALTH: Cannot popen(\"%s\", \"r\").", command_to_run);
+    if(health_notifications.threads) {
+        health_notification_queue(host, ae, recipient, command_to_run);
         goto done;
     }
-    debug(D_HEALTH, "HEALTH reading from command (discarding command's output)");
-    char buffer[100 + 1];
-    while(fgets(buffer, 100, fp) != NULL) ;
-    ae->exec_code = mypclose(fp, command_pid);
-    debug(D_HEALTH, "done executing command - returned with code %d", ae->exec_code);
 
+    ae->exec_code = health_notification_run(command_to_run);
     if(ae->exec_code != 0)
         ae->flags |= HEALTH_ENTRY_FLAG_EXEC_FAILED;
 
@@ -314,6 +808,8 @@ static inline void health_process_notifications(RRDHOST *host, ALARM_ENTRY *ae)
 }
 
 static inline void health_alarm_log_process(RRDHOST *host) {
+    health_notifications_apply(host);
+
     uint32_t first_waiting = (host->health_log.alarms)?host->health_log.alarms->unique_id:0;
     time_t now = now_realtime_sec();
 
@@ -432,6 +928,18 @@ static inline int rrdcalc_isrunnable(RRDCALC *rc, time_t now, time_t *next_run)
                   , (unsigned long) last);
             return 0;
         }
+
+        // the chart has not stored a new point since the last lookup,
+        // so let rrdset_done() wake us up when it does - unless it is late
+        // for more than a whole alarm period, in which case run it anyway
+        if(last <= rc->db_before && now < rc->next_update + rc->update_every) {
+            time_t due = rc->db_before + update_every;
+            if(!rc->rrdset->alarms_due || due < rc->rrdset->alarms_due)
+                rc->rrdset->alarms_due = due;
+
+            debug(D_HEALTH, "Health postponing alarm '%s.%s' until its chart stores a new point.", rc->chart?rc->chart:"NOCHART", rc->name);
+            return 0;
+        }
     }
 
     return 1;
@@ -454,15 +962,6 @@ static inline int check_if_resumed_from_suspention(void) {
     return ret;
 }
 
-static void health_main_cleanup(void *ptr) {
-    struct netdata_static_thread *static_thread = (struct netdata_static_thread *)ptr;
-    static_thread->enabled = NETDATA_MAIN_THREAD_EXITING;
-
-    info("cleaning up...");
-
-    static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
-}
-
 SILENCE_TYPE check_silenced(RRDCALC *rc, char* host, SILENCERS *silencers) {
 	SILENCER *s;
     debug(D_HEALTH, "Checking if alarm was silenced via the command API. Alarm info name:%s context:%s chart:%s host:%s family:%s",
@@ -535,389 +1034,746 @@ int update_disabled_silenced(RRDHOST *host, RRDCALC *rc) {
 }
 
 /**
- * Health Main
+ * Shared lookup
  *
- * The main thread of the health system. In this function all the alarms will be processed.
+ * Find an alarm of the same chart with the same database lookup, that did it in this round.
+ * The stock alarms often look up the same window of the same chart, grouped the same way.
  *
- * @param ptr is a pointer to the netdata_static_thread structure.
+ * @param rc the alarm that needs the lookup.
+ * @param now the time of this health iteration.
  *
- * @return It always returns NULL
+ * @return the alarm with the result of the lookup, or NULL when rc has to do it.
  */
-void *health_main(void *ptr) {
-    netdata_thread_cleanup_push(health_main_cleanup, ptr);
+static inline RRDCALC *health_shared_lookup(RRDCALC *rc, time_t now) {
+	RRDCALC *rc2;
 
-    int min_run_every = (int)config_get_number(CONFIG_SECTION_HEALTH, "run at least every seconds", 10);
-    if(min_run_every < 1) min_run_every = 1;
+	if (unlikely(!rc->rrdset))
+		return NULL;
 
-    time_t now                = now_realtime_sec();
-    time_t hibernation_delay  = config_get_number(CONFIG_SECTION_HEALTH, "postpone alarms during hibernation for seconds", 60);
+	for (rc2 = rc->rrdset->alarms; rc2; rc2 = rc2->rrdset_next) {
+		if (rc2 == rc || rc2->lookup_round != now)
+			continue;
 
-    unsigned int loop = 0;
-    while(!netdata_exit) {
-		loop++;
-		debug(D_HEALTH, "Health monitoring iteration no %u started", loop);
+		if (rc2->after == rc->after && rc2->before == rc->before && rc2->group == rc->group &&
+			rc2->options == rc->options &&
+			(rc2->dimensions == rc->dimensions ||
+			 (rc2->dimensions && rc->dimensions && !strcmp(rc2->dimensions, rc->dimensions))))
+			return rc2;
+	}
 
-		int runnable = 0, apply_hibernation_delay = 0;
-		time_t next_run = now + min_run_every;
-		RRDCALC *rc;
+	return NULL;
+}
 
-		if (unlikely(check_if_resumed_from_suspention())) {
-			apply_hibernation_delay = 1;
+/**
+ * Run host
+ *
+ * Evaluate the alarms of a host, and process its alarm log.
+ * It is called by health_main(), or by a health worker thread, never by two threads for the same host.
+ *
+ * @param host the host whose alarms will be evaluated.
+ * @param now the time of this health iteration.
+ * @param apply_hibernation_delay set when the system was just resumed from suspension.
+ * @param hibernation_delay the seconds to postpone the alarms after a suspension.
+ * @param next_run updated to the time the next health iteration is needed for this host.
+ */
+static void health_run_host(RRDHOST *host, time_t now, int apply_hibernation_delay, time_t hibernation_delay, time_t *next_run) {
+	int runnable = 0;
+	RRDCALC *rc;
 
-			info("Postponing alarm checks for %ld seconds, because it seems that the system was just resumed from suspension.",
-				 hibernation_delay
-			);
+	if (unlikely(!host->health_enabled))
+		return;
+
+	if (unlikely(!host->health_loaded))
+		health_host_load(host);
+
+	if (unlikely(rrdhost_flag_check(host, RRDHOST_FLAG_PENDING_HEALTH_LINK)))
+		health_host_link_pending_charts(host);
+
+	if (unlikely(apply_hibernation_delay)) {
+
+		info("Postponing health checks for %ld seconds, on host '%s'.", hibernation_delay, host->hostname
+		);
+
+		host->health_delay_up_to = now + hibernation_delay;
+	}
+
+	if (unlikely(host->health_delay_up_to)) {
+		if (unlikely(now < host->health_delay_up_to))
+			return;
+
+		info("Resuming health checks on host '%s'.", host->hostname);
+		host->health_delay_up_to = 0;
+	}
+
+	rrdhost_rdlock(host);
+
+	// the first loop is to lookup values from the db
+	for (rc = host->alarms; rc; rc = rc->next) {
+
+		if (update_disabled_silenced(host, rc))
+			continue;
+
+		if (unlikely(!rrdcalc_isrunnable(rc, now, next_run))) {
+			if (unlikely(rc->rrdcalc_flags & RRDCALC_FLAG_RUNNABLE))
+				rc->rrdcalc_flags &= ~RRDCALC_FLAG_RUNNABLE;
+			continue;
 		}
 
-		if (unlikely(silencers->all_alarms && silencers->stype == STYPE_DISABLE_ALARMS)) {
-			static int logged=0;
-			if (!logged) {
-				info("Skipping health checks, because all alarms are disabled via a %s command.",
-					 HEALTH_CMDAPI_CMD_DISABLEALL);
-				logged = 1;
+		runnable++;
+		rc->old_value = rc->value;
+		rc->rrdcalc_flags |= RRDCALC_FLAG_RUNNABLE;
+
+		// ------------------------------------------------------------
+		// if there is database lookup, do it
+
+		if (unlikely(RRDCALC_HAS_DB_LOOKUP(rc))) {
+			/* time_t old_db_timestamp = rc->db_before; */
+			int value_is_null = 0;
+
+			int ret = 0;
+
+			RRDCALC *shared = (likely(health_shared_lookups)) ? health_shared_lookup(rc, now) : NULL;
+			if (unlikely(shared)) {
+				// another alarm of the chart did the same lookup in this round
+				ret = shared->lookup_ret;
+				value_is_null = shared->lookup_is_null;
+				rc->value = shared->lookup_value;
+				rc->db_after = shared->lookup_after;
+				rc->db_before = shared->lookup_before;
+
+				// its incremental lookup would only go stale
+				rrdcalc_window_free(rc);
+
+				debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database lookup shared with alarm '%s'",
+					  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name, shared->name
+				);
+			}
+			else {
+				if (likely(health_incremental_lookups))
+					ret = rrdcalc_window_lookup(rc, &rc->value, &rc->db_after, &rc->db_before, &value_is_null);
+
+				if (unlikely(!ret))
+					ret = rrdset2value_api_v1(rc->rrdset, NULL, &rc->value, rc->dimensions, 1, rc->after,
+											  rc->before, rc->group, 0, rc->options, &rc->db_after,
+											  &rc->db_before, &value_is_null
+					);
+
+				rc->lookup_round = now;
+				rc->lookup_ret = ret;
+				rc->lookup_is_null = value_is_null;
+				rc->lookup_value = rc->value;
+				rc->lookup_after = rc->db_after;
+				rc->lookup_before = rc->db_before;
+			}
+
+			if (unlikely(ret != 200)) {
+				// database lookup failed
+				rc->value = NAN;
+				rc->rrdcalc_flags |= RRDCALC_FLAG_DB_ERROR;
+
+				debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database lookup returned error %d",
+					  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name, ret
+				);
+			} else
+				rc->rrdcalc_flags &= ~RRDCALC_FLAG_DB_ERROR;
+
+			/* - RRDCALC_FLAG_DB_STALE not currently used
+			if (unlikely(old_db_timestamp == rc->db_before)) {
+				// database is stale
+
+				debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database is stale", host->hostname, rc->chart?rc->chart:"NOCHART", rc->name);
+
+				if (unlikely(!(rc->rrdcalc_flags & RRDCALC_FLAG_DB_STALE))) {
+					rc->rrdcalc_flags |= RRDCALC_FLAG_DB_STALE;
+					error("Health on host '%s', alarm '%s.%s': database is stale", host->hostname, rc->chart?rc->chart:"NOCHART", rc->name);
+				}
 			}
+			else if (unlikely(rc->rrdcalc_flags & RRDCALC_FLAG_DB_STALE))
+				rc->rrdcalc_flags &= ~RRDCALC_FLAG_DB_STALE;
+			*/
+
+			if (unlikely(value_is_null)) {
+				// collected value is null
+				rc->value = NAN;
+				rc->rrdcalc_flags |= RRDCALC_FLAG_DB_NAN;
+
+				debug(D_HEALTH,
+					  "Health on host '%s', alarm '%s.%s': database lookup returned empty value (possibly value is not collected yet)",
+					  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name
+				);
+			} else
+				rc->rrdcalc_flags &= ~RRDCALC_FLAG_DB_NAN;
+
+			debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database lookup gave value "
+					CALCULATED_NUMBER_FORMAT, host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
+				  rc->value
+			);
 		}
 
-		rrd_rdlock();
+		// ------------------------------------------------------------
+		// if there is calculation expression, run it
 
-		RRDHOST *host;
-		rrdhost_foreach_read(host) {
-			if (unlikely(!host->health_enabled))
-				continue;
+		if (unlikely(rc->calculation)) {
+			health_expression_bind_variables(rc->calculation, rc);
 
-			if (unlikely(apply_hibernation_delay)) {
+			if (unlikely(!expression_evaluate(rc->calculation))) {
+				// calculation failed
+				rc->value = NAN;
+				rc->rrdcalc_flags |= RRDCALC_FLAG_CALC_ERROR;
 
-				info("Postponing health checks for %ld seconds, on host '%s'.", hibernation_delay, host->hostname
+				debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': expression '%s' failed: %s",
+					  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
+					  rc->calculation->parsed_as, expression_error_msg(rc->calculation)
+				);
+			} else {
+				rc->rrdcalc_flags &= ~RRDCALC_FLAG_CALC_ERROR;
+
+				debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': expression '%s' gave value "
+						CALCULATED_NUMBER_FORMAT
+						": %s (source: %s)", host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
+					  rc->calculation->parsed_as, rc->calculation->result,
+					  expression_error_msg(rc->calculation), rc->source
 				);
 
-				host->health_delay_up_to = now + hibernation_delay;
+				rc->value = rc->calculation->result;
+
+				if (rc->local) rc->local->last_updated = now;
+				if (rc->family) rc->family->last_updated = now;
+				if (rc->hostid) rc->hostid->last_updated = now;
+				if (rc->hostname) rc->hostname->last_updated = now;
 			}
+		}
+	}
 
-			if (unlikely(host->health_delay_up_to)) {
-				if (unlikely(now < host->health_delay_up_to))
-					continue;
+	rrdhost_unlock(host);
 
-				info("Resuming health checks on host '%s'.", host->hostname);
-				host->health_delay_up_to = 0;
+	if (unlikely(runnable && !netdata_exit)) {
+		rrdhost_rdlock(host);
+
+		for (rc = host->alarms; rc; rc = rc->next) {
+			if (unlikely(!(rc->rrdcalc_flags & RRDCALC_FLAG_RUNNABLE)))
+				continue;
+
+			if (rc->rrdcalc_flags & RRDCALC_FLAG_DISABLED) {
+				continue;
 			}
+			RRDCALC_STATUS warning_status = RRDCALC_STATUS_UNDEFINED;
+			RRDCALC_STATUS critical_status = RRDCALC_STATUS_UNDEFINED;
 
-			rrdhost_rdlock(host);
+			// --------------------------------------------------------
+			// check the warning expression
 
-			// the first loop is to lookup values from the db
-			for (rc = host->alarms; rc; rc = rc->next) {
+			if (likely(rc->warning)) {
+				health_expression_bind_variables(rc->warning, rc);
 
-				if (update_disabled_silenced(host, rc))
-					continue;
+				if (unlikely(!expression_evaluate(rc->warning))) {
+					// calculation failed
+					rc->rrdcalc_flags |= RRDCALC_FLAG_WARN_ERROR;
 
-				if (unlikely(!rrdcalc_isrunnable(rc, now, &next_run))) {
-					if (unlikely(rc->rrdcalc_flags & RRDCALC_FLAG_RUNNABLE))
-						rc->rrdcalc_flags &= ~RRDCALC_FLAG_RUNNABLE;
-					continue;
+					debug(D_HEALTH,
+						  "Health on host '%s', alarm '%s.%s': warning expression failed with error: %s",
+						  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
+						  expression_error_msg(rc->warning)
+					);
+				} else {
+					rc->rrdcalc_flags &= ~RRDCALC_FLAG_WARN_ERROR;
+					debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': warning expression gave value "
+							CALCULATED_NUMBER_FORMAT
+							": %s (source: %s)", host->hostname, rc->chart ? rc->chart : "NOCHART",
+						  rc->name, rc->warning->result, expression_error_msg(rc->warning), rc->source
+					);
+					warning_status = rrdcalc_value2status(rc->warning->result);
 				}
+			}
 
-				runnable++;
-				rc->old_value = rc->value;
-				rc->rrdcalc_flags |= RRDCALC_FLAG_RUNNABLE;
+			// --------------------------------------------------------
+			// check the critical expression
 
-				// ------------------------------------------------------------
-				// if there is database lookup, do it
+			if (likely(rc->critical)) {
+				health_expression_bind_variables(rc->critical, rc);
 
-				if (unlikely(RRDCALC_HAS_DB_LOOKUP(rc))) {
-					/* time_t old_db_timestamp = rc->db_before; */
-					int value_is_null = 0;
+				if (unlikely(!expression_evaluate(rc->critical))) {
+					// calculation failed
+					rc->rrdcalc_flags |= RRDCALC_FLAG_CRIT_ERROR;
 
-					int ret = rrdset2value_api_v1(rc->rrdset, NULL, &rc->value, rc->dimensions, 1, rc->after,
-												  rc->before, rc->group, 0, rc->options, &rc->db_after,
-												  &rc->db_before, &value_is_null
+					debug(D_HEALTH,
+						  "Health on host '%s', alarm '%s.%s': critical expression failed with error: %s",
+						  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
+						  expression_error_msg(rc->critical)
 					);
-
-					if (unlikely(ret != 200)) {
-						// database lookup failed
-						rc->value = NAN;
-						rc->rrdcalc_flags |= RRDCALC_FLAG_DB_ERROR;
-
-						debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database lookup returned error %d",
-							  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name, ret
-						);
-					} else
-						rc->rrdcalc_flags &= ~RRDCALC_FLAG_DB_ERROR;
-
-					/* - RRDCALC_FLAG_DB_STALE not currently used
-					if (unlikely(old_db_timestamp == rc->db_before)) {
-						// database is stale
-
-						debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database is stale", host->hostname, rc->chart?rc->chart:"NOCHART", rc->name);
-
-						if (unlikely(!(rc->rrdcalc_flags & RRDCALC_FLAG_DB_STALE))) {
-							rc->rrdcalc_flags |= RRDCALC_FLAG_DB_STALE;
-							error("Health on host '%s', alarm '%s.%s': database is stale", host->hostname, rc->chart?rc->chart:"NOCHART", rc->name);
-						}
-					}
-					else if (unlikely(rc->rrdcalc_flags & RRDCALC_FLAG_DB_STALE))
-						rc->rrdcalc_flags &= ~RRDCALC_FLAG_DB_STALE;
-					*/
-
-					if (unlikely(value_is_null)) {
-						// collected value is null
-						rc->value = NAN;
-						rc->rrdcalc_flags |= RRDCALC_FLAG_DB_NAN;
-
-						debug(D_HEALTH,
-							  "Health on host '%s', alarm '%s.%s': database lookup returned empty value (possibly value is not collected yet)",
-							  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name
-						);
-					} else
-						rc->rrdcalc_flags &= ~RRDCALC_FLAG_DB_NAN;
-
-					debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': database lookup gave value "
-							CALCULATED_NUMBER_FORMAT, host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
-						  rc->value
+				} else {
+					rc->rrdcalc_flags &= ~RRDCALC_FLAG_CRIT_ERROR;
+					debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': critical expression gave value "
+							CALCULATED_NUMBER_FORMAT
+							": %s (source: %s)", host->hostname, rc->chart ? rc->chart : "NOCHART",
+						  rc->name, rc->critical->result, expression_error_msg(rc->critical),
+						  rc->source
 					);
+					critical_status = rrdcalc_value2status(rc->critical->result);
 				}
+			}
 
-				// ------------------------------------------------------------
-				// if there is calculation expression, run it
-
-				if (unlikely(rc->calculation)) {
-					if (unlikely(!expression_evaluate(rc->calculation))) {
-						// calculation failed
-						rc->value = NAN;
-						rc->rrdcalc_flags |= RRDCALC_FLAG_CALC_ERROR;
-
-						debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': expression '%s' failed: %s",
-							  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
-							  rc->calculation->parsed_as, buffer_tostring(rc->calculation->error_msg)
-						);
-					} else {
-						rc->rrdcalc_flags &= ~RRDCALC_FLAG_CALC_ERROR;
-
-						debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': expression '%s' gave value "
-								CALCULATED_NUMBER_FORMAT
-								": %s (source: %s)", host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
-							  rc->calculation->parsed_as, rc->calculation->result,
-							  buffer_tostring(rc->calculation->error_msg), rc->source
-						);
-
-						rc->value = rc->calculation->result;
-
-						if (rc->local) rc->local->last_updated = now;
-						if (rc->family) rc->family->last_updated = now;
-						if (rc->hostid) rc->hostid->last_updated = now;
-						if (rc->hostname) rc->hostname->last_updated = now;
-					}
-				}
+			// --------------------------------------------------------
+			// decide the final alarm status
+
+			RRDCALC_STATUS status = RRDCALC_STATUS_UNDEFINED;
+
+			switch (warning_status) {
+				case RRDCALC_STATUS_CLEAR:
+					status = RRDCALC_STATUS_CLEAR;
+					break;
+
+				case RRDCALC_STATUS_RAISED:
+					status = RRDCALC_STATUS_WARNING;
+					break;
+
+				default:
+					break;
 			}
 
-			rrdhost_unlock(host);
-
-			if (unlikely(runnable && !netdata_exit)) {
-				rrdhost_rdlock(host);
-
-				for (rc = host->alarms; rc; rc = rc->next) {
-					if (unlikely(!(rc->rrdcalc_flags & RRDCALC_FLAG_RUNNABLE)))
-						continue;
-
-					if (rc->rrdcalc_flags & RRDCALC_FLAG_DISABLED) {
-						continue;
-					}
-					RRDCALC_STATUS warning_status = RRDCALC_STATUS_UNDEFINED;
-					RRDCALC_STATUS critical_status = RRDCALC_STATUS_UNDEFINED;
-
-					// --------------------------------------------------------
-					// check the warning expression
-
-					if (likely(rc->warning)) {
-						if (unlikely(!expression_evaluate(rc->warning))) {
-							// calculation failed
-							rc->rrdcalc_flags |= RRDCALC_FLAG_WARN_ERROR;
-
-							debug(D_HEALTH,
-								  "Health on host '%s', alarm '%s.%s': warning expression failed with error: %s",
-								  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
-								  buffer_tostring(rc->warning->error_msg)
-							);
-						} else {
-							rc->rrdcalc_flags &= ~RRDCALC_FLAG_WARN_ERROR;
-							debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': warning expression gave value "
-									CALCULATED_NUMBER_FORMAT
-									": %s (source: %s)", host->hostname, rc->chart ? rc->chart : "NOCHART",
-								  rc->name, rc->warning->result, buffer_tostring(rc->warning->error_msg), rc->source
-							);
-							warning_status = rrdcalc_value2status(rc->warning->result);
-						}
-					}
-
-					// --------------------------------------------------------
-					// check the critical expression
-
-					if (likely(rc->critical)) {
-						if (unlikely(!expression_evaluate(rc->critical))) {
-							// calculation failed
-							rc->rrdcalc_flags |= RRDCALC_FLAG_CRIT_ERROR;
-
-							debug(D_HEALTH,
-								  "Health on host '%s', alarm '%s.%s': critical expression failed with error: %s",
-								  host->hostname, rc->chart ? rc->chart : "NOCHART", rc->name,
-								  buffer_tostring(rc->critical->error_msg)
-							);
-						} else {
-							rc->rrdcalc_flags &= ~RRDCALC_FLAG_CRIT_ERROR;
-							debug(D_HEALTH, "Health on host '%s', alarm '%s.%s': critical expression gave value "
-									CALCULATED_NUMBER_FORMAT
-									": %s (source: %s)", host->hostname, rc->chart ? rc->chart : "NOCHART",
-								  rc->name, rc->critical->result, buffer_tostring(rc->critical->error_msg),
-								  rc->source
-							);
-							critical_status = rrdcalc_value2status(rc->critical->result);
-						}
-					}
-
-					// --------------------------------------------------------
-					// decide the final alarm status
-
-					RRDCALC_STATUS status = RRDCALC_STATUS_UNDEFINED;
-
-					switch (warning_status) {
-						case RRDCALC_STATUS_CLEAR:
-							status = RRDCALC_STATUS_CLEAR;
-							break;
-
-						case RRDCALC_STATUS_RAISED:
-							status = RRDCALC_STATUS_WARNING;
-							break;
-
-						default:
-							break;
-					}
-
-					switch (critical_status) {
-						case RRDCALC_STATUS_CLEAR:
-							if (status == RRDCALC_STATUS_UNDEFINED)
-								status = RRDCALC_STATUS_CLEAR;
-							break;
-
-						case RRDCALC_STATUS_RAISED:
-							status = RRDCALC_STATUS_CRITICAL;
-							break;
-
-						default:
-							break;
-					}
-
-					// --------------------------------------------------------
-					// check if the new status and the old differ
-
-					if (status != rc->status) {
-						int delay = 0;
-
-						// apply trigger hysteresis
-
-						if (now > rc->delay_up_to_timestamp) {
-							rc->delay_up_current = rc->delay_up_duration;
-							rc->delay_down_current = rc->delay_down_duration;
-							rc->delay_last = 0;
-							rc->delay_up_to_timestamp = 0;
-						} else {
-							rc->delay_up_current = (int) (rc->delay_up_current * rc->delay_multiplier);
-							if (rc->delay_up_current > rc->delay_max_duration)
-								rc->delay_up_current = rc->delay_max_duration;
-
-							rc->delay_down_current = (int) (rc->delay_down_current * rc->delay_multiplier);
-							if (rc->delay_down_current > rc->delay_max_duration)
-								rc->delay_down_current = rc->delay_max_duration;
-						}
-
-						if (status > rc->status)
-							delay = rc->delay_up_current;
-						else
-							delay = rc->delay_down_current;
-
-						// COMMENTED: because we do need to send raising alarms
-						// if(now + delay < rc->delay_up_to_timestamp)
-						//    delay = (int)(rc->delay_up_to_timestamp - now);
-
-						rc->delay_last = delay;
-						rc->delay_up_to_timestamp = now + delay;
-
-                        if(likely(!rrdcalc_isrepeating(rc))) {
-                            ALARM_ENTRY *ae = health_create_alarm_entry(
-                                    host, rc->id, rc->next_event_id++, now, rc->name, rc->rrdset->id,
-                                    rc->rrdset->family, rc->exec, rc->recipient, now - rc->last_status_change,
-                                    rc->old_value, rc->value, rc->status, status, rc->source, rc->units, rc->info,
-                                    rc->delay_last,
-                                    (
-                                            ((rc->options & RRDCALC_FLAG_NO_CLEAR_NOTIFICATION)? HEALTH_ENTRY_FLAG_NO_CLEAR_NOTIFICATION : 0) |
-                                            ((rc->rrdcalc_flags & RRDCALC_FLAG_SILENCED)? HEALTH_ENTRY_FLAG_SILENCED : 0)
-                                    )
-                            );
-                            health_alarm_log(host, ae);
-                        }
-                        rc->last_status_change = now;
-                        rc->old_status = rc->status;
-                        rc->status = status;
-					}
-
-					rc->last_updated = now;
-					rc->next_update = now + rc->update_every;
-
-					if (next_run > rc->next_update)
-						next_run = rc->next_update;
+			switch (critical_status) {
+				case RRDCALC_STATUS_CLEAR:
+					if (status == RRDCALC_STATUS_UNDEFINED)
+						status = RRDCALC_STATUS_CLEAR;
+					break;
+
+				case RRDCALC_STATUS_RAISED:
+					status = RRDCALC_STATUS_CRITICAL;
+					break;
+
+				default:
+					break;
+			}
+
+			// --------------------------------------------------------
+			// check if the new status and the old differ
+
+			if (status != rc->status) {
+				int delay = 0;
+
+				// apply trigger hysteresis
+
+				if (now > rc->delay_up_to_timestamp) {
+					rc->delay_up_current = rc->delay_up_duration;
+					rc->delay_down_current = rc->delay_down_duration;
+					rc->delay_last = 0;
+					rc->delay_up_to_timestamp = 0;
+				} else {
+					rc->delay_up_current = (int) (rc->delay_up_current * rc->delay_multiplier);
+					if (rc->delay_up_current > rc->delay_max_duration)
+						rc->delay_up_current = rc->delay_max_duration;
+
+					rc->delay_down_current = (int) (rc->delay_down_current * rc->delay_multiplier);
+					if (rc->delay_down_current > rc->delay_max_duration)
+						rc->delay_down_current = rc->delay_max_duration;
 				}
 
-                // process repeating alarms
-                RRDCALC *rc;
-                for(rc = host->alarms; rc ; rc = rc->next) {
-                    int repeat_every = 0;
-                    if(unlikely(rrdcalc_isrepeating(rc))) {
-                        if(unlikely(rc->status == RRDCALC_STATUS_WARNING))
-                            repeat_every = rc->warn_repeat_every;
-                        else if(unlikely(rc->status == RRDCALC_STATUS_CRITICAL))
-                            repeat_every = rc->crit_repeat_every;
-                    }
-                    if(unlikely(repeat_every > 0 && (rc->last_repeat + repeat_every) <= now)) {
-                        rc->last_repeat = now;
-                        ALARM_ENTRY *ae = health_create_alarm_entry(
-                                host, rc->id, rc->next_event_id++, now, rc->name, rc->rrdset->id,
-                                rc->rrdset->family, rc->exec, rc->recipient, now - rc->last_status_change,
-                                rc->old_value, rc->value, rc->old_status, rc->status, rc->source, rc->units, rc->info,
-                                rc->delay_last,
-                                (
-                                        ((rc->options & RRDCALC_FLAG_NO_CLEAR_NOTIFICATION)? HEALTH_ENTRY_FLAG_NO_CLEAR_NOTIFICATION : 0) |
-                                        ((rc->rrdcalc_flags & RRDCALC_FLAG_SILENCED)? HEALTH_ENTRY_FLAG_SILENCED : 0)
-                                )
-                        );
-                        ae->last_repeat = rc->last_repeat;
-                        health_process_notifications(host, ae);
-                        debug(D_HEALTH, "Notification sent for the repeating alarm %u.", ae->alarm_id);
-                        health_alarm_log_free_one_nochecks_nounlink(ae);
-                    }
+				if (status > rc->status)
+					delay = rc->delay_up_current;
+				else
+					delay = rc->delay_down_current;
+
+				// COMMENTED: because we do need to send raising alarms
+				// if(now + delay < rc->delay_up_to_timestamp)
+				//    delay = (int)(rc->delay_up_to_timestamp - now);
+
+				rc->delay_last = delay;
+				rc->delay_up_to_timestamp = now + delay;
+
+                if(likely(!rrdcalc_isrepeating(rc))) {
+                    ALARM_ENTRY *ae = health_create_alarm_entry(
+                            host, rc->id, rc->next_event_id++, now, rc->name, rc->rrdset->id,
+                            rc->rrdset->family, rc->exec, rc->recipient, now - rc->last_status_change,
+                            rc->old_value, rc->value, rc->status, status, rc->source, rc->units, rc->info,
+                            rc->delay_last,
+                            (
+                                    ((rc->options & RRDCALC_FLAG_NO_CLEAR_NOTIFICATION)? HEALTH_ENTRY_FLAG_NO_CLEAR_NOTIFICATION : 0) |
+                                    ((rc->rrdcalc_flags & RRDCALC_FLAG_SILENCED)? HEALTH_ENTRY_FLAG_SILENCED : 0)
+                            )
+                    );
+                    health_alarm_log(host, ae);
                 }
-
-				rrdhost_unlock(host);
+                rc->last_status_change = now;
+                rc->old_status = rc->status;
+                rc->status = status;
 			}
 
-			if (unlikely(netdata_exit))
-				break;
+			rc->last_updated = now;
+			rc->next_update = now + rc->update_every;
+
+			if (*next_run > rc->next_update)
+				*next_run = rc->next_update;
+		}
+
+        // process repeating alarms
+        RRDCALC *rc;
+        for(rc = host->alarms; rc ; rc = rc->next) {
+            int repeat_every = 0;
+            if(unlikely(rrdcalc_isrepeating(rc))) {
+                if(unlikely(rc->status == RRDCALC_STATUS_WARNING))
+                    repeat_every = rc->warn_repeat_every;
+                else if(unlikely(rc->status == RRDCALC_STATUS_CRITICAL))
+                    repeat_every = rc->crit_repeat_every;
+            }
+            if(unlikely(repeat_every > 0 && (rc->last_repeat + repeat_every) <= now)) {
+                rc->last_repeat = now;
+                ALARM_ENTRY *ae = health_create_alarm_entry(
+                        host, rc->id, rc->next_event_id++, now, rc->name, rc->rrdset->id,
+                        rc->rrdset->family, rc->exec, rc->recipient, now - rc->last_status_change,
+                        rc->old_value, rc->value, rc->old_status, rc->status, rc->source, rc->units, rc->info,
+                        rc->delay_last,
+                        (
+                                ((rc->options & RRDCALC_FLAG_NO_CLEAR_NOTIFICATION)? HEALTH_ENTRY_FLAG_NO_CLEAR_NOTIFICATION : 0) |
+                                ((rc->rrdcalc_flags & RRDCALC_FLAG_SILENCED)? HEALTH_ENTRY_FLAG_SILENCED : 0)
+                        )
+                );
+                ae->last_repeat = rc->last_repeat;
+                health_process_notifications(host, ae);
+                debug(D_HEALTH, "Notification sent for the repeating alarm %u.", ae->alarm_id);
+                health_alarm_log_free_one_nochecks_nounlink(ae);
+            }
+        }
 
-			// execute notifications
-			// and cleanup
-			health_alarm_log_process(host);
+		rrdhost_unlock(host);
+	}
 
-			if (unlikely(netdata_exit))
-				break;
+	if (unlikely(netdata_exit))
+		return;
 
-		} /* rrdhost_foreach */
+	// execute notifications
+	// and cleanup
+	health_alarm_log_process(host);
+}
 
-		rrd_unlock();
+// ----------------------------------------------------------------------------
+// health workers
+//
+// With "worker threads" above 1, the hosts of each health iteration are
+// claimed one by one by a pool of worker threads, so that a host with
+// thousands of alarms does not delay the alarms of all the others.
+// Each host is run by exactly one thread per iteration and health_main()
+// waits for all of them before the next iteration, so the alarm log entries
+// of every host are still generated in order.
+
+struct health_worker {
+    size_t id;
+    netdata_thread_t thread;
+    int running;
+
+    time_t next_run;                // the next run needed by the hosts this worker run
+    usec_t busy_usec;               // the time spent running hosts, in total
+    size_t hosts;                   // the hosts run, in total
+
+    RRDDIM *rd_busy;
+    RRDDIM *rd_hosts;
+};
+
+static struct {
+    size_t count;                   // the number of workers, 1 means health_main() runs all the hosts itself
+    struct health_worker *workers;
+
+    netdata_mutex_t mutex;
+    pthread_cond_t cond_work;       // a new iteration has been published
+    pthread_cond_t cond_done;       // all the workers finished the iteration
+    size_t iteration;
+    size_t busy;
+    int stop;
+
+    // the current iteration
+    RRDHOST **hosts;
+    size_t hosts_used;
+    size_t hosts_size;
+    size_t next_host;               // the next host to be claimed by a worker
+    time_t now;
+    int apply_hibernation_delay;
+    time_t hibernation_delay;
+} health_workers = {
+        .count = 1,
+        .workers = NULL,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond_work = PTHREAD_COND_INITIALIZER,
+        .cond_done = PTHREAD_COND_INITIALIZER,
+        .iteration = 0,
+        .busy = 0,
+        .stop = 0,
+        .hosts = NULL,
+        .hosts_used = 0,
+        .hosts_size = 0,
+        .next_host = 0
+};
+
+static void health_worker_run(struct health_worker *w) {
+    usec_t started_ut = now_monotonic_usec();
+    size_t i;
+
+    while(!netdata_exit && (i = __atomic_fetch_add(&health_workers.next_host, 1, __ATOMIC_RELAXED)) < health_workers.hosts_used) {
+        health_run_host(health_workers.hosts[i], health_workers.now, health_workers.apply_hibernation_delay, health_workers.hibernation_delay, &w->next_run);
+        w->hosts++;
+    }
+
+    w->busy_usec += now_monotonic_usec() - started_ut;
+}
+
+static void *health_worker_main(void *ptr) {
+    struct health_worker *w = (struct health_worker *)ptr;
+    size_t iteration = 0;
+
+    netdata_mutex_lock(&health_workers.mutex);
+    while(1) {
+        while(!health_workers.stop && health_workers.iteration == iteration)
+            pthread_cond_wait(&health_workers.cond_work, &health_workers.mutex);
+
+        if(health_workers.stop)
+            break;
 
+        iteration = health_workers.iteration;
+        netdata_mutex_unlock(&health_workers.mutex);
+
+        health_worker_run(w);
+
+        netdata_mutex_lock(&health_workers.mutex);
+        if(--health_workers.busy == 0)
+            pthread_cond_signal(&health_workers.cond_done);
+    }
+    netdata_mutex_unlock(&health_workers.mutex);
+
+    return NULL;
+}
+
+static void health_workers_start(void) {
+    long long count = config_get_number(CONFIG_SECTION_HEALTH, "worker threads", 1);
+    if(count < 1) count = 1;
+
+    health_workers.count = (size_t)count;
+    health_workers.workers = callocz(health_workers.count, sizeof(struct health_worker));
+
+    size_t i;
+    for(i = 0; i < health_workers.count ; i++)
+        health_workers.workers[i].id = i;
+
+    if(health_workers.count == 1)
+        return;
+
+    for(i = 0; i < health_workers.count ; i++) {
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "HEALTH_WORKER[%zu]", i + 1);
+
+        if(netdata_thread_create(&health_workers.workers[i].thread, tag, NETDATA_THREAD_OPTION_JOINABLE, health_worker_main, &health_workers.workers[i]))
+            error("HEALTH: cannot create health worker thread %zu", i + 1);
+        else
+            health_workers.workers[i].running = 1;
+    }
+}
+
+static void health_workers_stop(void) {
+    netdata_mutex_lock(&health_workers.mutex);
+    health_workers.stop = 1;
+    pthread_cond_broadcast(&health_workers.cond_work);
+    netdata_mutex_unlock(&health_workers.mutex);
+
+    size_t i;
+    for(i = 0; i < health_workers.count && health_workers.workers ; i++) {
+        if(health_workers.workers[i].running) {
+            netdata_thread_join(health_workers.workers[i].thread, NULL);
+            health_workers.workers[i].running = 0;
+        }
+    }
+}
+
+/**
+ * Run hosts
+ *
+ * Run one health iteration on all the hosts, with the worker threads when there are any.
+ * It has to be called with the rrd lock held.
+ */
+static void health_run_hosts(time_t now, int apply_hibernation_delay, time_t hibernation_delay, time_t *next_run) {
+    RRDHOST *host;
+    size_t i, running = 0;
+
+    for(i = 0; i < health_workers.count ; i++) {
+        health_workers.workers[i].next_run = *next_run;
+        if(health_workers.workers[i].running) running++;
+    }
+
+    if(!running) {
+        struct health_worker *w = &health_workers.workers[0];
+        usec_t started_ut = now_monotonic_usec();
+
+        rrdhost_foreach_read(host) {
+            health_run_host(host, now, apply_hibernation_delay, hibernation_delay, &w->next_run);
+            w->hosts++;
+
+            if (unlikely(netdata_exit))
+                break;
+        }
+
+        w->busy_usec += now_monotonic_usec() - started_ut;
+    }
+    else {
+        health_workers.hosts_used = 0;
+        rrdhost_foreach_read(host) {
+            if(unlikely(health_workers.hosts_used == health_workers.hosts_size)) {
+                health_workers.hosts_size = (health_workers.hosts_size) ? health_workers.hosts_size * 2 : 16;
+                health_workers.hosts = reallocz(health_workers.hosts, health_workers.hosts_size * sizeof(RRDHOST *));
+            }
+            health_workers.hosts[health_workers.hosts_used++] = host;
+        }
+
+        // the workers use the mutex and the condition variables,
+        // so this thread must not be cancelled while waiting for them
+        netdata_thread_disable_cancelability();
+
+        netdata_mutex_lock(&health_workers.mutex);
+        health_workers.now = now;
+        health_workers.apply_hibernation_delay = apply_hibernation_delay;
+        health_workers.hibernation_delay = hibernation_delay;
+        health_workers.next_host = 0;
+        health_workers.busy = running;
+        health_workers.iteration++;
+        pthread_cond_broadcast(&health_workers.cond_work);
+
+        while(health_workers.busy)
+            pthread_cond_wait(&health_workers.cond_done, &health_workers.mutex);
+        netdata_mutex_unlock(&health_workers.mutex);
+
+        netdata_thread_enable_cancelability();
+    }
+
+    for(i = 0; i < health_workers.count ; i++)
+        if(health_workers.workers[i].next_run < *next_run)
+            *next_run = health_workers.workers[i].next_run;
+}
+
+static void health_workers_charts(void) {
+    static RRDSET *st_busy = NULL, *st_hosts = NULL;
+    size_t i;
+
+    if(unlikely(!st_busy)) {
+        st_busy = rrdset_create_localhost(
+                "netdata"
+                , "health_workers_time"
+                , NULL
+                , "health"
+                , NULL
+                , "NetData Health Workers Busy Time"
+                , "milliseconds/s"
+                , "health"
+                , "stats"
+                , 132100
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_STACKED
+        );
+
+        st_hosts = rrdset_create_localhost(
+                "netdata"
+                , "health_workers_hosts"
+                , NULL
+                , "health"
+                , NULL
+                , "NetData Health Workers Hosts Evaluated"
+                , "hosts/s"
+                , "health"
+                , "stats"
+                , 132101
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_STACKED
+        );
+
+        for(i = 0; i < health_workers.count ; i++) {
+            char id[50 + 1];
+            snprintfz(id, 50, "worker%zu", i + 1);
+
+            health_workers.workers[i].rd_busy = rrddim_add(st_busy, id, NULL, 1, 1000, RRD_ALGORITHM_INCREMENTAL);
+            health_workers.workers[i].rd_hosts = rrddim_add(st_hosts, id, NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+        }
+    }
+    else {
+        rrdset_next(st_busy);
+        rrdset_next(st_hosts);
+    }
+
+    for(i = 0; i < health_workers.count ; i++) {
+        rrddim_set_by_pointer(st_busy, health_workers.workers[i].rd_busy, (collected_number)health_workers.workers[i].busy_usec);
+        rrddim_set_by_pointer(st_hosts, health_workers.workers[i].rd_hosts, (collected_number)health_workers.workers[i].hosts);
+    }
+
+    rrdset_done(st_busy);
+    rrdset_done(st_hosts);
+}
+
+static void health_main_cleanup(void *ptr) {
+    struct netdata_static_thread *static_thread = (struct netdata_static_thread *)ptr;
+    static_thread->enabled = NETDATA_MAIN_THREAD_EXITING;
+
+    info("cleaning up...");
+
+    health_workers_stop();
+    health_notifications_stop();
+
+    static_thread->enabled = NETDATA_MAIN_THREAD_EXITED;
+}
+
+/**
+ * Health Main
+ *
+ * The main thread of the health system. In this function all the alarms will be processed.
+ *
+ * @param ptr is a pointer to the netdata_static_thread structure.
+ *
+ * @return It always returns NULL
+ */
+void *health_main(void *ptr) {
+    netdata_thread_cleanup_push(health_main_cleanup, ptr);
+
+    int min_run_every = (int)config_get_number(CONFIG_SECTION_HEALTH, "run at least every seconds", 10);
+    if(min_run_every < 1) min_run_every = 1;
+
+    time_t now                = now_realtime_sec();
+    time_t hibernation_delay  = config_get_number(CONFIG_SECTION_HEALTH, "postpone alarms during hibernation for seconds", 60);
+
+    health_workers_start();
+    health_notifications_start();
+
+    unsigned int loop = 0;
+    while(!netdata_exit) {
+		loop++;
+		debug(D_HEALTH, "Health monitoring iteration no %u started", loop);
+
+		int apply_hibernation_delay = 0;
+		time_t next_run = now + min_run_every;
+
+		if (unlikely(check_if_resumed_from_suspention())) {
+			apply_hibernation_delay = 1;
+
+			info("Postponing alarm checks for %ld seconds, because it seems that the system was just resumed from suspension.",
+				 hibernation_delay
+			);
+		}
+
+		if (unlikely(silencers->all_alarms && silencers->stype == STYPE_DISABLE_ALARMS)) {
+			static int logged=0;
+			if (!logged) {
+				info("Skipping health checks, because all alarms are disabled via a %s command.",
+					 HEALTH_CMDAPI_CMD_DISABLEALL);
+				logged = 1;
+			}
+		}
+
+		rrd_rdlock();
+
+		health_run_hosts(now, apply_hibernation_delay, hibernation_delay, &next_run);
+
+		rrd_unlock();
 
         if(unlikely(netdata_exit))
             break;
 
+        health_workers_charts();
+
         now = now_realtime_sec();
         if(now < next_run) {
             debug(D_HEALTH, "Health monitoring iteration no %u done. Next iteration in %d secs", loop, (int) (next_run - now));
-            sleep_usec(USEC_PER_SEC * (usec_t) (next_run - now));
+            health_sleep_until(next_run);
             now = now_realtime_sec();
         }
         else
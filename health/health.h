@@ -54,11 +54,14 @@ char *silencers_filename;
 
 extern void health_init(void);
 extern void *health_main(void *ptr);
+extern void health_wakeup(void);
 
 extern void health_reload(void);
 
 extern int health_variable_lookup(const char *variable, uint32_t hash, RRDCALC *rc, calculated_number *result);
-extern void health_alarms2json(RRDHOST *host, BUFFER *wb, int all);
+extern void health_expression_bind_variables(EVAL_EXPRESSION *exp, RRDCALC *rc);
+extern int health_alarms2json(RRDHOST *host, BUFFER *wb, int all, uint32_t if_modified_since);
+extern void health_alarm_json_free(RRDCALC *rc);
 extern void health_alarm_log2json(RRDHOST *host, BUFFER *wb, uint32_t after);
 
 void health_api_v1_chart_variables2json(RRDSET *st, BUFFER *buf);
@@ -69,6 +72,7 @@ extern void health_log_rotate(RRDHOST *host);
 extern void health_alarm_log_save(RRDHOST *host, ALARM_ENTRY *ae);
 extern ssize_t health_alarm_log_read(RRDHOST *host, FILE *fp, const char *filename);
 extern void health_alarm_log_load(RRDHOST *host);
+extern void health_host_load(RRDHOST *host);
 
 extern ALARM_ENTRY* health_create_alarm_entry(
         RRDHOST *host,
@@ -98,6 +102,7 @@ extern char *health_user_config_dir(void);
 extern char *health_stock_config_dir(void);
 extern void health_reload_host(RRDHOST *host);
 extern void health_alarm_log_free(RRDHOST *host);
+extern void health_notifications_host_cleanup(RRDHOST *host);
 
 extern void health_alarm_log_free_one_nochecks_nounlink(ALARM_ENTRY *ae);
 
@@ -99,11 +99,10 @@ void health_alarm_log2json(RRDHOST *host, BUFFER *wb, uint32_t after) {
     unsigned int max = host->health_log.max;
     unsigned int count = 0;
     ALARM_ENTRY *ae;
-    for(ae = host->health_log.alarms; ae && count < max ; count++, ae = ae->next) {
-        if(ae->unique_id > after) {
-            if(likely(count)) buffer_strcat(wb, ",");
-            health_alarm_entry2json_nolock(wb, ae, host);
-        }
+    // the log is sorted by unique id, newest first
+    for(ae = host->health_log.alarms; ae && count < max && ae->unique_id > after ; count++, ae = ae->next) {
+        if(likely(count)) buffer_strcat(wb, ",");
+        health_alarm_entry2json_nolock(wb, ae, host);
     }
 
     buffer_strcat(wb, "\n]\n");
@@ -227,34 +226,188 @@ static inline void health_rrdcalc2json_nolock(RRDHOST *host, BUFFER *wb, RRDCALC
     buffer_strcat(wb, "\t\t}");
 }
 
+// ----------------------------------------------------------------------------
+// cached JSON of the alarms
+//
+// dashboards poll /api/v1/alarms every few seconds, for every viewer.
+// the JSON of each alarm is kept and regenerated only when a field of it
+// has changed since, and each response gets a generation, so that clients
+// having the latest one get nothing back.
+
+// the runtime fields the JSON of an alarm depends on
+// everything else is configuration, that does not change for the life of the RRDCALC
+struct rrdcalc_json_state {
+    RRDSET *rrdset;
+    uint32_t rrdcalc_flags;
+    RRDCALC_STATUS status;
+    int delay_last;
+    time_t last_status_change;
+    time_t last_updated;
+    time_t next_update;
+    time_t delay_up_to_timestamp;
+    time_t db_after;
+    time_t db_before;
+    calculated_number value;
+    calculated_number green;
+    calculated_number red;
+};
+
+struct rrdcalc_json {
+    struct rrdcalc_json_state state;    // the state the JSON was generated for
+    uint32_t version;                   // from host->health_alarms_json_version, when it was generated
+    uint32_t request;                   // the last response it was included in
+    BUFFER *wb;
+};
+
+// serializes the use of the cached JSON and the generations of the hosts
+static netdata_mutex_t health_alarms_json_mutex = NETDATA_MUTEX_INITIALIZER;
+static uint32_t health_alarms_json_request = 0;
+
+static inline void health_rrdcalc_json_state(RRDCALC *rc, struct rrdcalc_json_state *s) {
+    // zero the padding too, the states are compared with memcmp()
+    memset(s, 0, sizeof(struct rrdcalc_json_state));
+
+    s->rrdset                = rc->rrdset;
+    s->rrdcalc_flags         = rc->rrdcalc_flags;
+    s->status                = rc->status;
+    s->delay_last            = rc->delay_last;
+    s->last_status_change    = rc->last_status_change;
+    s->last_updated          = rc->last_updated;
+    s->next_update           = rc->next_update;
+    s->delay_up_to_timestamp = rc->delay_up_to_timestamp;
+    s->db_after              = rc->db_after;
+    s->db_before             = rc->db_before;
+    s->value                 = rc->value;
+    s->green                 = rc->green;
+    s->red                   = rc->red;
+}
+
+// returns the cached JSON of the alarm, regenerating it if the alarm has changed
+// it has to be called with health_alarms_json_mutex locked
+static struct rrdcalc_json *health_rrdcalc_json(RRDHOST *host, RRDCALC *rc) {
+    struct rrdcalc_json_state state;
+    health_rrdcalc_json_state(rc, &state);
+
+    struct rrdcalc_json *j = rc->json;
+    if(likely(j && !memcmp(&j->state, &state, sizeof(struct rrdcalc_json_state))))
+        return j;
+
+    if(unlikely(!j)) {
+        j = rc->json = callocz(1, sizeof(struct rrdcalc_json));
+        j->wb = buffer_create(2048);
+    }
+
+    // the state is taken before the JSON is generated,
+    // so the JSON of an alarm updated meanwhile will be regenerated next time
+    j->state = state;
+    j->version = ++host->health_alarms_json_version;
+
+    buffer_flush(j->wb);
+    health_rrdcalc2json_nolock(host, j->wb, rc);
+
+    return j;
+}
+
+void health_alarm_json_free(RRDCALC *rc) {
+    struct rrdcalc_json *j = rc->json;
+    if(likely(!j)) return;
+
+    buffer_free(j->wb);
+    freez(j);
+    rc->json = NULL;
+}
+
+static inline int health_alarms2json_include(RRDCALC *rc, int all) {
+    if(unlikely(!rc->rrdset || !rc->rrdset->last_collected_time.tv_sec))
+        return 0;
+
+    if(likely(!all && !(rc->status == RRDCALC_STATUS_WARNING || rc->status == RRDCALC_STATUS_CRITICAL)))
+        return 0;
+
+    return 1;
+}
+
 //void health_rrdcalctemplate2json_nolock(BUFFER *wb, RRDCALCTEMPLATE *rt) {
 //
 //}
 
-void health_alarms2json(RRDHOST *host, BUFFER *wb, int all) {
+/**
+ * Alarms to JSON
+ *
+ * Writes the alarms of a host for /api/v1/alarms, from the cached JSON of each alarm.
+ *
+ * @param host the host.
+ * @param wb the buffer to write to.
+ * @param all 1 for all the alarms, 0 for the raised ones.
+ * @param if_modified_since the generation the client already has, or 0.
+ *
+ * @return It returns 1 when the alarms are still at generation if_modified_since and nothing was written, 0 otherwise.
+ */
+int health_alarms2json(RRDHOST *host, BUFFER *wb, int all, uint32_t if_modified_since) {
     int i;
+    RRDCALC *rc;
+    uint32_t max_version = 0, count = 0;
+
+    all = all?1:0;
 
     rrdhost_rdlock(host);
+    netdata_mutex_lock(&health_alarms_json_mutex);
+
+    uint32_t latest_log_id = (host->health_log.next_log_id > 0)?(host->health_log.next_log_id - 1):0;
+
+    // the alarms may change status while we work,
+    // so the alarms included are decided once and marked
+    uint32_t request = ++health_alarms_json_request;
+
+    for(rc = host->alarms; rc ; rc = rc->next) {
+        if(unlikely(!health_alarms2json_include(rc, all)))
+            continue;
+
+        struct rrdcalc_json *j = health_rrdcalc_json(host, rc);
+        j->request = request;
+        if(j->version > max_version) max_version = j->version;
+        count++;
+    }
+
+    // a JSON regenerated since the last response has a higher version than all the JSON included in it,
+    // so the response changes if and only if one of these changes
+    struct rrdhost_health_alarms_json *g = &host->health_alarms_json[all];
+    if(unlikely(!g->generation
+                || g->max_version != max_version
+                || g->count != count
+                || g->latest_log_id != latest_log_id
+                || g->enabled != (int)host->health_enabled)) {
+        g->generation = ++host->health_alarms_json_generation;
+        g->max_version = max_version;
+        g->count = count;
+        g->latest_log_id = latest_log_id;
+        g->enabled = (int)host->health_enabled;
+    }
+
+    if(if_modified_since && if_modified_since == g->generation) {
+        netdata_mutex_unlock(&health_alarms_json_mutex);
+        rrdhost_unlock(host);
+        return 1;
+    }
+
     buffer_sprintf(wb, "{\n\t\"hostname\": \"%s\","
                     "\n\t\"latest_alarm_log_unique_id\": %u,"
                     "\n\t\"status\": %s,"
                     "\n\t\"now\": %lu,"
+                    "\n\t\"generation\": %u,"
                     "\n\t\"alarms\": {\n",
             host->hostname,
-            (host->health_log.next_log_id > 0)?(host->health_log.next_log_id - 1):0,
+            latest_log_id,
             host->health_enabled?"true":"false",
-            (unsigned long)now_realtime_sec());
+            (unsigned long)now_realtime_sec(),
+            g->generation);
 
-    RRDCALC *rc;
     for(i = 0, rc = host->alarms; rc ; rc = rc->next) {
-        if(unlikely(!rc->rrdset || !rc->rrdset->last_collected_time.tv_sec))
-            continue;
-
-        if(likely(!all && !(rc->status == RRDCALC_STATUS_WARNING || rc->status == RRDCALC_STATUS_CRITICAL)))
+        if(unlikely(!rc->json || rc->json->request != request))
             continue;
 
         if(likely(i)) buffer_strcat(wb, ",\n");
-        health_rrdcalc2json_nolock(host, wb, rc);
+        buffer_strcat(wb, buffer_tostring(rc->json->wb));
         i++;
     }
 
@@ -264,8 +417,9 @@ void health_alarms2json(RRDHOST *host, BUFFER *wb, int all) {
 //        health_rrdcalctemplate2json_nolock(wb, rt);
 
     buffer_strcat(wb, "\n\t}\n}\n");
-    rrdhost_unlock(host);
-}
-
 
+    netdata_mutex_unlock(&health_alarms_json_mutex);
+    rrdhost_unlock(host);
 
+    return 0;
+}
@@ -5,21 +5,151 @@
 // ----------------------------------------------------------------------------
 // health alarm log load/save
 // no need for locking - only one thread is reading / writing the alarms log
+//
+// the log is binary: a file header followed by appended records.
+// each record has a fixed header, followed by the strings of the entry.
+// 'A' records add an entry, 'U' records replace the fields of an entry.
+//
+// when enough records have been appended, the log is rotated out and all
+// the entries in memory are written as a compacted snapshot, in the
+// background. the snapshot is health-log.db.old - loading it and the
+// records appended since is all that is needed on restart.
+//
+// logs in the older text format are still loaded, and are converted
+// to the binary format by the compaction made at startup.
+
+#define HEALTH_LOG_FILE_MAGIC "NDHLOG01"
+#define HEALTH_LOG_FILE_MAGIC_LENGTH (sizeof(HEALTH_LOG_FILE_MAGIC) - 1)
+#define HEALTH_LOG_RECORD_SIGNATURE 0x474f4c48 // "HLOG"
+#define HEALTH_LOG_STRINGS 8
+#define HEALTH_LOG_STRING_MAX_LENGTH 65535
+
+// all fields are in host byte order
+struct health_log_record {
+    uint32_t signature;
+    uint32_t length;                                // the length of the record, including the strings
+    uint8_t type;                                   // 'A' or 'U'
+    uint8_t reserved[3];
+
+    uint32_t unique_id;
+    uint32_t alarm_id;
+    uint32_t alarm_event_id;
+    uint32_t updated_by_id;
+    uint32_t updates_id;
+
+    uint32_t when;
+    uint32_t duration;
+    uint32_t non_clear_duration;
+    uint32_t flags;
+    uint32_t exec_run_timestamp;
+    uint32_t delay_up_to_timestamp;
+
+    int32_t exec_code;
+    int32_t new_status;
+    int32_t old_status;
+    int32_t delay;
+
+    double new_value;
+    double old_value;
+    uint64_t last_repeat;
+
+    // name, chart, family, exec, recipient, source, units, info
+    // each one including its terminating zero
+    uint16_t strings_length[HEALTH_LOG_STRINGS];
+};
+
+#define HEALTH_LOG_RECORD_MAX_LENGTH (sizeof(struct health_log_record) + HEALTH_LOG_STRINGS * HEALTH_LOG_STRING_MAX_LENGTH)
+
+struct health_log_compaction {
+    char *filename;                                 // the snapshot to write
+    char *rotated_filename;                         // the log rotated out, removed when the snapshot is saved
+    BUFFER *snapshot;
+    volatile int done;
+};
+
+static void health_log_record2buffer(BUFFER *wb, ALARM_ENTRY *ae, char type) {
+    const char *strings[HEALTH_LOG_STRINGS] = {
+            ae->name, ae->chart, ae->family, ae->exec, ae->recipient, ae->source, ae->units, ae->info
+    };
+
+    struct health_log_record r = {
+            .signature              = HEALTH_LOG_RECORD_SIGNATURE,
+            .type                   = (uint8_t)type,
+
+            .unique_id              = ae->unique_id,
+            .alarm_id               = ae->alarm_id,
+            .alarm_event_id         = ae->alarm_event_id,
+            .updated_by_id          = ae->updated_by_id,
+            .updates_id             = ae->updates_id,
+
+            .when                   = (uint32_t)ae->when,
+            .duration               = (uint32_t)ae->duration,
+            .non_clear_duration     = (uint32_t)ae->non_clear_duration,
+            .flags                  = ae->flags,
+            .exec_run_timestamp     = (uint32_t)ae->exec_run_timestamp,
+            .delay_up_to_timestamp  = (uint32_t)ae->delay_up_to_timestamp,
+
+            .exec_code              = ae->exec_code,
+            .new_status             = ae->new_status,
+            .old_status             = ae->old_status,
+            .delay                  = ae->delay,
+
+            .new_value              = (double)ae->new_value,
+            .old_value              = (double)ae->old_value,
+            .last_repeat            = (uint64_t)ae->last_repeat
+    };
+
+    size_t i, length = sizeof(r);
+    for(i = 0; i < HEALTH_LOG_STRINGS ; i++) {
+        size_t len = (strings[i])?strlen(strings[i]):0;
+        if(unlikely(len > HEALTH_LOG_STRING_MAX_LENGTH - 1))
+            len = HEALTH_LOG_STRING_MAX_LENGTH - 1;
+
+        r.strings_length[i] = (uint16_t)(len + 1);
+        length += len + 1;
+    }
+    r.length = (uint32_t)length;
+
+    buffer_need_bytes(wb, length + 1);
+    buffer_fast_strcat(wb, (const char *)&r, sizeof(r));
+    for(i = 0; i < HEALTH_LOG_STRINGS ; i++) {
+        // the strings may have been truncated, so copy them with their zero
+        buffer_fast_strcat(wb, (strings[i])?strings[i]:"", r.strings_length[i] - 1U);
+        buffer_fast_strcat(wb, "", 1);
+    }
+}
 
-inline int health_alarm_log_open(RRDHOST *host) {
+static int health_alarm_log_open_file(RRDHOST *host, int truncate) {
     if(host->health_log_fp)
         fclose(host->health_log_fp);
 
-    host->health_log_fp = fopen(host->health_log_filename, "a");
+    host->health_log_fp = fopen(host->health_log_filename, (truncate)?"w+":"a+");
 
-    if(host->health_log_fp) {
-        if (setvbuf(host->health_log_fp, NULL, _IOLBF, 0) != 0)
-            error("HEALTH [%s]: cannot set line buffering on health log file '%s'.", host->hostname, host->health_log_filename);
-        return 0;
+    if(!host->health_log_fp) {
+        error("HEALTH [%s]: cannot open health log file '%s'. Health data will be lost in case of netdata or server crash.", host->hostname, host->health_log_filename);
+        return -1;
     }
 
-    error("HEALTH [%s]: cannot open health log file '%s'. Health data will be lost in case of netdata or server crash.", host->hostname, host->health_log_filename);
-    return -1;
+    char magic[HEALTH_LOG_FILE_MAGIC_LENGTH];
+    if(fseek(host->health_log_fp, 0, SEEK_SET) == 0 && fread(magic, HEALTH_LOG_FILE_MAGIC_LENGTH, 1, host->health_log_fp) == 1) {
+        if(likely(!memcmp(magic, HEALTH_LOG_FILE_MAGIC, HEALTH_LOG_FILE_MAGIC_LENGTH)))
+            return 0;
+
+        // the startup compaction converts the text logs, so this should not happen
+        error("HEALTH [%s]: health log file '%s' is not in the binary format. Truncating it.", host->hostname, host->health_log_filename);
+        return health_alarm_log_open_file(host, 1);
+    }
+
+    // a new file
+    clearerr(host->health_log_fp);
+    if(fwrite(HEALTH_LOG_FILE_MAGIC, HEALTH_LOG_FILE_MAGIC_LENGTH, 1, host->health_log_fp) != 1 || fflush(host->health_log_fp) != 0)
+        error("HEALTH [%s]: cannot write the header of health log file '%s'.", host->hostname, host->health_log_filename);
+
+    return 0;
+}
+
+inline int health_alarm_log_open(RRDHOST *host) {
+    return health_alarm_log_open_file(host, 0);
 }
 
 inline void health_alarm_log_close(RRDHOST *host) {
@@ -29,92 +159,159 @@ inline void health_alarm_log_close(RRDHOST *host) {
     }
 }
 
-inline void health_log_rotate(RRDHOST *host) {
-    static size_t rotate_every = 0;
+// ----------------------------------------------------------------------------
+// health alarm log compaction
 
-    if(unlikely(rotate_every == 0)) {
-        rotate_every = (size_t)config_get_number(CONFIG_SECTION_HEALTH, "rotate log every lines", 2000);
-        if(rotate_every < 100) rotate_every = 100;
+static void health_log_compaction_free(struct health_log_compaction *c) {
+    freez(c->filename);
+    freez(c->rotated_filename);
+    buffer_free(c->snapshot);
+    freez(c);
+}
+
+static void *health_log_compaction_main(void *ptr) {
+    struct health_log_compaction *c = (struct health_log_compaction *)ptr;
+
+    char tmp_filename[FILENAME_MAX + 1];
+    snprintfz(tmp_filename, FILENAME_MAX, "%s.tmp", c->filename);
+
+    int fd = open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if(fd == -1) {
+        error("HEALTH: cannot create health log snapshot '%s'", tmp_filename);
+        goto cleanup;
     }
 
-    if(unlikely(host->health_log_entries_written > rotate_every)) {
-        health_alarm_log_close(host);
+    const char *s = c->snapshot->buffer;
+    size_t remaining = c->snapshot->len;
+    while(remaining) {
+        ssize_t written = write(fd, s, remaining);
+        if(written == -1) {
+            if(errno == EINTR) continue;
+            error("HEALTH: cannot write health log snapshot '%s'", tmp_filename);
+            close(fd);
+            unlink(tmp_filename);
+            goto cleanup;
+        }
+        s += written;
+        remaining -= (size_t)written;
+    }
+
+    // the snapshot replaces the rotated log - it has to be on disk first
+    if(fsync(fd) == -1)
+        error("HEALTH: cannot sync health log snapshot '%s'", tmp_filename);
 
-        char old_filename[FILENAME_MAX + 1];
-        snprintfz(old_filename, FILENAME_MAX, "%s.old", host->health_log_filename);
+    close(fd);
 
-        if(unlink(old_filename) == -1 && errno != ENOENT)
-            error("HEALTH [%s]: cannot remove old alarms log file '%s'", host->hostname, old_filename);
+    if(rename(tmp_filename, c->filename) == -1) {
+        error("HEALTH: cannot rename health log snapshot '%s' to '%s'", tmp_filename, c->filename);
+        unlink(tmp_filename);
+        goto cleanup;
+    }
 
-        if(link(host->health_log_filename, old_filename) == -1 && errno != ENOENT)
-            error("HEALTH [%s]: cannot move file '%s' to '%s'.", host->hostname, host->health_log_filename, old_filename);
+    if(unlink(c->rotated_filename) == -1 && errno != ENOENT)
+        error("HEALTH: cannot remove rotated health log '%s'", c->rotated_filename);
 
-        if(unlink(host->health_log_filename) == -1 && errno != ENOENT)
-            error("HEALTH [%s]: cannot remove old alarms log file '%s'", host->hostname, host->health_log_filename);
+cleanup:
+    c->done = 1;
+    return NULL;
+}
 
-        // open it with truncate
-        host->health_log_fp = fopen(host->health_log_filename, "w");
+// wait for the running compaction of the host, if any
+static void health_log_compaction_wait(RRDHOST *host) {
+    if(!host->health_log_compaction) return;
 
-        if(host->health_log_fp)
-            fclose(host->health_log_fp);
-        else
-            error("HEALTH [%s]: cannot truncate health log '%s'", host->hostname, host->health_log_filename);
+    netdata_thread_join(host->health_log_compaction_thread, NULL);
+    health_log_compaction_free(host->health_log_compaction);
+    host->health_log_compaction = NULL;
+}
 
-        host->health_log_fp = NULL;
+// rotate the log out and write a snapshot of the entries in memory
+static void health_log_compact(RRDHOST *host, int background) {
+    health_log_compaction_wait(host);
+
+    struct health_log_compaction *c = callocz(1, sizeof(struct health_log_compaction));
+
+    char filename[FILENAME_MAX + 1];
+    snprintfz(filename, FILENAME_MAX, "%s.old", host->health_log_filename);
+    c->filename = strdupz(filename);
+    snprintfz(filename, FILENAME_MAX, "%s.rotated", host->health_log_filename);
+    c->rotated_filename = strdupz(filename);
+
+    c->snapshot = buffer_create(HEALTH_LOG_FILE_MAGIC_LENGTH + host->health_log.count * 512);
+    buffer_fast_strcat(c->snapshot, HEALTH_LOG_FILE_MAGIC, HEALTH_LOG_FILE_MAGIC_LENGTH);
+
+    netdata_rwlock_rdlock(&host->health_log.alarm_log_rwlock);
+
+    // the list has the newest entry first - the snapshot needs the oldest first
+    size_t count = 0, i;
+    ALARM_ENTRY *ae;
+    for(ae = host->health_log.alarms; ae ; ae = ae->next)
+        count++;
+
+    if(count) {
+        ALARM_ENTRY **entries = mallocz(count * sizeof(ALARM_ENTRY *));
+        for(i = count, ae = host->health_log.alarms; ae ; ae = ae->next)
+            entries[--i] = ae;
+
+        for(i = 0; i < count ; i++)
+            health_log_record2buffer(c->snapshot, entries[i], 'A');
+
+        freez(entries);
+    }
+
+    netdata_rwlock_unlock(&host->health_log.alarm_log_rwlock);
+
+    // from now on, the new records are appended to a new log
+    health_alarm_log_close(host);
+
+    if(rename(host->health_log_filename, c->rotated_filename) == -1 && errno != ENOENT)
+        error("HEALTH [%s]: cannot move file '%s' to '%s'.", host->hostname, host->health_log_filename, c->rotated_filename);
+
+    health_alarm_log_open_file(host, 1);
+    host->health_log_entries_written = 0;
+
+    if(background) {
+        host->health_log_compaction = c;
+
+        if(netdata_thread_create(&host->health_log_compaction_thread, "HEALTHLOG", NETDATA_THREAD_OPTION_JOINABLE | NETDATA_THREAD_OPTION_DONT_LOG, health_log_compaction_main, c) == 0)
+            return;
 
-        host->health_log_entries_written = 0;
-        health_alarm_log_open(host);
+        error("HEALTH [%s]: cannot start the health log compaction thread. Compacting synchronously.", host->hostname);
+        host->health_log_compaction = NULL;
+    }
+
+    health_log_compaction_main(c);
+    health_log_compaction_free(c);
+}
+
+inline void health_log_rotate(RRDHOST *host) {
+    static size_t rotate_every = 0;
+
+    if(unlikely(rotate_every == 0)) {
+        rotate_every = (size_t)config_get_number(CONFIG_SECTION_HEALTH, "rotate log every lines", 2000);
+        if(rotate_every < 100) rotate_every = 100;
+    }
+
+    if(unlikely(host->health_log_entries_written > rotate_every)) {
+        // let the previous compaction finish first
+        if(host->health_log_compaction && !host->health_log_compaction->done)
+            return;
+
+        health_log_compact(host, 1);
     }
 }
 
 inline void health_alarm_log_save(RRDHOST *host, ALARM_ENTRY *ae) {
-    health_log_rotate(host);
+    static __thread BUFFER *wb = NULL;
 
     if(likely(host->health_log_fp)) {
-        if(unlikely(fprintf(host->health_log_fp
-                            , "%c\t%s"
-                        "\t%08x\t%08x\t%08x\t%08x\t%08x"
-                        "\t%08x\t%08x\t%08x"
-                        "\t%08x\t%08x\t%08x"
-                        "\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s"
-                        "\t%d\t%d\t%d\t%d"
-                        "\t" CALCULATED_NUMBER_FORMAT_AUTO "\t" CALCULATED_NUMBER_FORMAT_AUTO
-                        "\t%016lx"
-                        "\n"
-                            , (ae->flags & HEALTH_ENTRY_FLAG_SAVED)?'U':'A'
-                            , host->hostname
-
-                            , ae->unique_id
-                            , ae->alarm_id
-                            , ae->alarm_event_id
-                            , ae->updated_by_id
-                            , ae->updates_id
-
-                            , (uint32_t)ae->when
-                            , (uint32_t)ae->duration
-                            , (uint32_t)ae->non_clear_duration
-                            , (uint32_t)ae->flags
-                            , (uint32_t)ae->exec_run_timestamp
-                            , (uint32_t)ae->delay_up_to_timestamp
-
-                            , (ae->name)?ae->name:""
-                            , (ae->chart)?ae->chart:""
-                            , (ae->family)?ae->family:""
-                            , (ae->exec)?ae->exec:""
-                            , (ae->recipient)?ae->recipient:""
-                            , (ae->source)?ae->source:""
-                            , (ae->units)?ae->units:""
-                            , (ae->info)?ae->info:""
-
-                            , ae->exec_code
-                            , ae->new_status
-                            , ae->old_status
-                            , ae->delay
-
-                            , ae->new_value
-                            , ae->old_value
-                            , (uint64_t)ae->last_repeat
-        ) < 0))
+        if(unlikely(!wb))
+            wb = buffer_create(1024);
+
+        buffer_flush(wb);
+        health_log_record2buffer(wb, ae, (ae->flags & HEALTH_ENTRY_FLAG_SAVED)?'U':'A');
+
+        if(unlikely(fwrite(wb->buffer, wb->len, 1, host->health_log_fp) != 1 || fflush(host->health_log_fp) != 0))
             error("HEALTH [%s]: failed to save alarm log entry to '%s'. Health data may be lost in case of abnormal restart.", host->hostname, host->health_log_filename);
         else {
             ae->flags |= HEALTH_ENTRY_FLAG_SAVED;
@@ -123,17 +320,174 @@ inline void health_alarm_log_save(RRDHOST *host, ALARM_ENTRY *ae) {
     }
 }
 
-inline ssize_t health_alarm_log_read(RRDHOST *host, FILE *fp, const char *filename) {
-    errno = 0;
+// ----------------------------------------------------------------------------
+// health alarm log loading
+
+struct health_log_read_stats {
+    ssize_t loaded;
+    ssize_t updated;
+    ssize_t errored;
+    ssize_t duplicate;
+};
+
+// apply a record of the log to the entries in memory
+// the strings of the record are copied
+static void health_alarm_log_apply(RRDHOST *host, char type, ALARM_ENTRY *r, int has_last_repeat, const char *filename, size_t line, struct health_log_read_stats *stats) {
+    ALARM_ENTRY *ae = NULL;
+
+    // check that we have valid ids
+    if(!r->unique_id) {
+        error("HEALTH [%s]: record %zu of file '%s' states alarm entry with invalid unique id %u. Ignoring it.", host->hostname, line, filename, r->unique_id);
+        stats->errored++;
+        return;
+    }
+
+    if(!r->alarm_id) {
+        error("HEALTH [%s]: record %zu of file '%s' states alarm entry for invalid alarm id %u. Ignoring it.", host->hostname, line, filename, r->alarm_id);
+        stats->errored++;
+        return;
+    }
+
+    // Check if we got last_repeat field
+    if(has_last_repeat) {
+        RRDCALC *rc = alarm_max_last_repeat(host, r->name, simple_hash(r->name));
+        if (!rc) {
+            for(rc = host->alarms; rc ; rc = rc->next) {
+                RRDCALC *rdcmp  = (RRDCALC *) avl_insert_lock(&(host)->alarms_idx_name, (avl *)rc);
+                if(rdcmp != rc) {
+                    error("Cannot insert the alarm index ID using log %s", rc->name);
+                }
+            }
+
+            rc = alarm_max_last_repeat(host, r->name, simple_hash(r->name));
+        }
+
+        if(unlikely(rc)) {
+            if (rrdcalc_isrepeating(rc)) {
+                rc->last_repeat = r->last_repeat;
+                // We iterate through repeating alarm entries only to
+                // find the latest last_repeat timestamp. Otherwise,
+                // there is no need to keep them in memory.
+                return;
+            }
+        }
+    }
+
+    // an entry already loaded (e.g. from both a snapshot and the log it
+    // was made from) is an update
+    if(unlikely(type == 'A' && host->health_log.alarms && r->unique_id == host->health_log.alarms->unique_id)) {
+        type = 'U';
+        stats->duplicate++;
+    }
+
+    if(unlikely(type == 'A')) {
+        // make sure it is properly numbered
+        if(unlikely(host->health_log.alarms && r->unique_id < host->health_log.alarms->unique_id)) {
+            error( "HEALTH [%s]: record %zu of file '%s' has alarm log entry %u in wrong order. Ignoring it."
+                   , host->hostname, line, filename, r->unique_id);
+            stats->errored++;
+            return;
+        }
+
+        ae = callocz(1, sizeof(ALARM_ENTRY));
+    }
+    else {
+        // find the original
+        for(ae = host->health_log.alarms; ae ; ae = ae->next) {
+            if(unlikely(r->unique_id == ae->unique_id))
+                break;
+
+            else if(unlikely(r->unique_id > ae->unique_id)) {
+                // no need to continue
+                // the linked list is sorted
+                ae = NULL;
+                break;
+            }
+        }
+    }
+
+    // if not found, skip this record
+    if(unlikely(!ae))
+        return;
 
+    ae->unique_id               = r->unique_id;
+    ae->alarm_id                = r->alarm_id;
+    ae->alarm_event_id          = r->alarm_event_id;
+    ae->updated_by_id           = r->updated_by_id;
+    ae->updates_id              = r->updates_id;
+
+    ae->when                    = r->when;
+    ae->duration                = r->duration;
+    ae->non_clear_duration      = r->non_clear_duration;
+
+    ae->flags                   = r->flags;
+    ae->flags |= HEALTH_ENTRY_FLAG_SAVED;
+
+    ae->exec_run_timestamp      = r->exec_run_timestamp;
+    ae->delay_up_to_timestamp   = r->delay_up_to_timestamp;
+
+    freez(ae->name);
+    ae->name = strdupz(r->name);
+    ae->hash_name = simple_hash(ae->name);
+
+    freez(ae->chart);
+    ae->chart = strdupz(r->chart);
+    ae->hash_chart = simple_hash(ae->chart);
+
+    freez(ae->family);
+    ae->family = strdupz(r->family);
+
+    freez(ae->exec);
+    ae->exec = (*r->exec)?strdupz(r->exec):NULL;
+
+    freez(ae->recipient);
+    ae->recipient = (*r->recipient)?strdupz(r->recipient):NULL;
+
+    freez(ae->source);
+    ae->source = (*r->source)?strdupz(r->source):NULL;
+
+    freez(ae->units);
+    ae->units = (*r->units)?strdupz(r->units):NULL;
+
+    freez(ae->info);
+    ae->info = (*r->info)?strdupz(r->info):NULL;
+
+    ae->exec_code   = r->exec_code;
+    ae->new_status  = r->new_status;
+    ae->old_status  = r->old_status;
+    ae->delay       = r->delay;
+
+    ae->new_value   = r->new_value;
+    ae->old_value   = r->old_value;
+
+    ae->last_repeat = r->last_repeat;
+
+    char value_string[100 + 1];
+    freez(ae->old_value_string);
+    freez(ae->new_value_string);
+    ae->old_value_string = strdupz(format_value_and_unit(value_string, 100, ae->old_value, ae->units, -1));
+    ae->new_value_string = strdupz(format_value_and_unit(value_string, 100, ae->new_value, ae->units, -1));
+
+    // add it to host if not already there
+    if(unlikely(type == 'A')) {
+        ae->next = host->health_log.alarms;
+        host->health_log.alarms = ae;
+        stats->loaded++;
+    }
+    else stats->updated++;
+
+    if(unlikely(ae->unique_id > host->health_max_unique_id))
+        host->health_max_unique_id = ae->unique_id;
+
+    if(unlikely(ae->alarm_id >= host->health_max_alarm_id))
+        host->health_max_alarm_id = ae->alarm_id;
+}
+
+static void health_alarm_log_read_text(RRDHOST *host, FILE *fp, const char *filename, struct health_log_read_stats *stats) {
     char *s, *buf = mallocz(65536 + 1);
     size_t line = 0, len = 0;
-    ssize_t loaded = 0, updated = 0, errored = 0, duplicate = 0;
-
-    netdata_rwlock_rdlock(&host->health_log.alarm_log_rwlock);
 
     while((s = fgets_trim_len(buf, 65536, fp, &len))) {
-        host->health_log_entries_written++;
         line++;
 
         int max_entries = 30, entries = 0;
@@ -153,220 +507,191 @@ inline ssize_t health_alarm_log_read(RRDHOST *host, FILE *fp, const char *filena
         }
 
         if(likely(*pointers[0] == 'U' || *pointers[0] == 'A')) {
-            ALARM_ENTRY *ae = NULL;
-
             if(entries < 26) {
                 error("HEALTH [%s]: line %zu of file '%s' should have at least 26 entries, but it has %d. Ignoring it.", host->hostname, line, filename, entries);
-                errored++;
-                continue;
-            }
-
-            // check that we have valid ids
-            uint32_t unique_id = (uint32_t)strtoul(pointers[2], NULL, 16);
-            if(!unique_id) {
-                error("HEALTH [%s]: line %zu of file '%s' states alarm entry with invalid unique id %u (%s). Ignoring it.", host->hostname, line, filename, unique_id, pointers[2]);
-                errored++;
-                continue;
-            }
-
-            uint32_t alarm_id = (uint32_t)strtoul(pointers[3], NULL, 16);
-            if(!alarm_id) {
-                error("HEALTH [%s]: line %zu of file '%s' states alarm entry for invalid alarm id %u (%s). Ignoring it.", host->hostname, line, filename, alarm_id, pointers[3]);
-                errored++;
-                continue;
-            }
-
-            // Check if we got last_repeat field
-            time_t last_repeat = 0;
-            if(entries > 27) {
-                char* alarm_name = pointers[13];
-                last_repeat = (time_t)strtoul(pointers[27], NULL, 16);
-
-                RRDCALC *rc = alarm_max_last_repeat(host, alarm_name,simple_hash(alarm_name));
-                if (!rc) {
-                    for(rc = host->alarms; rc ; rc = rc->next) {
-                        RRDCALC *rdcmp  = (RRDCALC *) avl_insert_lock(&(host)->alarms_idx_name, (avl *)rc);
-                        if(rdcmp != rc) {
-                            error("Cannot insert the alarm index ID using log %s", rc->name);
-                        }
-                    }
-
-                    rc = alarm_max_last_repeat(host, alarm_name,simple_hash(alarm_name));
-                }
-
-                if(unlikely(rc)) {
-                    if (rrdcalc_isrepeating(rc)) {
-                        rc->last_repeat = last_repeat;
-                        // We iterate through repeating alarm entries only to
-                        // find the latest last_repeat timestamp. Otherwise,
-                        // there is no need to keep them in memory.
-                        continue;
-                    }
-                }
-            }
-
-            if(unlikely(*pointers[0] == 'A')) {
-                // make sure it is properly numbered
-                if(unlikely(host->health_log.alarms && unique_id < host->health_log.alarms->unique_id)) {
-                    error( "HEALTH [%s]: line %zu of file '%s' has alarm log entry %u in wrong order. Ignoring it."
-                           , host->hostname, line, filename, unique_id);
-                    errored++;
-                    continue;
-                }
-
-                ae = callocz(1, sizeof(ALARM_ENTRY));
-            }
-            else if(unlikely(*pointers[0] == 'U')) {
-                // find the original
-                for(ae = host->health_log.alarms; ae ; ae = ae->next) {
-                    if(unlikely(unique_id == ae->unique_id)) {
-                        if(unlikely(*pointers[0] == 'A')) {
-                            error("HEALTH [%s]: line %zu of file '%s' adds duplicate alarm log entry %u. Using the later."
-                            , host->hostname, line, filename, unique_id);
-                            *pointers[0] = 'U';
-                            duplicate++;
-                        }
-                        break;
-                    }
-                    else if(unlikely(unique_id > ae->unique_id)) {
-                        // no need to continue
-                        // the linked list is sorted
-                        ae = NULL;
-                        break;
-                    }
-                }
-            }
-
-            // if not found, skip this line
-            if(unlikely(!ae)) {
-                // error("HEALTH [%s]: line %zu of file '%s' updates alarm log entry with unique id %u, but it is not found.", host->hostname, line, filename, unique_id);
+                stats->errored++;
                 continue;
             }
 
-            // check for a possible host missmatch
-            //if(strcmp(pointers[1], host->hostname))
-            //    error("HEALTH [%s]: line %zu of file '%s' provides an alarm for host '%s' but this is named '%s'.", host->hostname, line, filename, pointers[1], host->hostname);
-
-            ae->unique_id               = unique_id;
-            ae->alarm_id                = alarm_id;
-            ae->alarm_event_id          = (uint32_t)strtoul(pointers[4], NULL, 16);
-            ae->updated_by_id           = (uint32_t)strtoul(pointers[5], NULL, 16);
-            ae->updates_id              = (uint32_t)strtoul(pointers[6], NULL, 16);
-
-            ae->when                    = (uint32_t)strtoul(pointers[7], NULL, 16);
-            ae->duration                = (uint32_t)strtoul(pointers[8], NULL, 16);
-            ae->non_clear_duration      = (uint32_t)strtoul(pointers[9], NULL, 16);
-
-            ae->flags                   = (uint32_t)strtoul(pointers[10], NULL, 16);
-            ae->flags |= HEALTH_ENTRY_FLAG_SAVED;
-
-            ae->exec_run_timestamp      = (uint32_t)strtoul(pointers[11], NULL, 16);
-            ae->delay_up_to_timestamp   = (uint32_t)strtoul(pointers[12], NULL, 16);
-
-            freez(ae->name);
-            ae->name = strdupz(pointers[13]);
-            ae->hash_name = simple_hash(ae->name);
+            ALARM_ENTRY r = {
+                    .unique_id              = (uint32_t)strtoul(pointers[2], NULL, 16),
+                    .alarm_id               = (uint32_t)strtoul(pointers[3], NULL, 16),
+                    .alarm_event_id         = (uint32_t)strtoul(pointers[4], NULL, 16),
+                    .updated_by_id          = (uint32_t)strtoul(pointers[5], NULL, 16),
+                    .updates_id             = (uint32_t)strtoul(pointers[6], NULL, 16),
+
+                    .when                   = (uint32_t)strtoul(pointers[7], NULL, 16),
+                    .duration               = (uint32_t)strtoul(pointers[8], NULL, 16),
+                    .non_clear_duration     = (uint32_t)strtoul(pointers[9], NULL, 16),
+                    .flags                  = (uint32_t)strtoul(pointers[10], NULL, 16),
+                    .exec_run_timestamp     = (uint32_t)strtoul(pointers[11], NULL, 16),
+                    .delay_up_to_timestamp  = (uint32_t)strtoul(pointers[12], NULL, 16),
+
+                    .name                   = pointers[13],
+                    .chart                  = pointers[14],
+                    .family                 = pointers[15],
+                    .exec                   = pointers[16],
+                    .recipient              = pointers[17],
+                    .source                 = pointers[18],
+                    .units                  = pointers[19],
+                    .info                   = pointers[20],
+
+                    .exec_code              = str2i(pointers[21]),
+                    .new_status             = str2i(pointers[22]),
+                    .old_status             = str2i(pointers[23]),
+                    .delay                  = str2i(pointers[24]),
+
+                    .new_value              = str2l(pointers[25]),
+                    .old_value              = str2l(pointers[26]),
+
+                    .last_repeat            = (entries > 27)?(time_t)strtoul(pointers[27], NULL, 16):0
+            };
+
+            health_alarm_log_apply(host, *pointers[0], &r, entries > 27, filename, line, stats);
+        }
+        else {
+            error("HEALTH [%s]: line %zu of file '%s' is invalid (unrecognized entry type '%s').", host->hostname, line, filename, pointers[0]);
+            stats->errored++;
+        }
+    }
 
-            freez(ae->chart);
-            ae->chart = strdupz(pointers[14]);
-            ae->hash_chart = simple_hash(ae->chart);
+    freez(buf);
+}
 
-            freez(ae->family);
-            ae->family = strdupz(pointers[15]);
+static void health_alarm_log_read_binary(RRDHOST *host, FILE *fp, const char *filename, struct health_log_read_stats *stats) {
+    char *buf = mallocz(HEALTH_LOG_RECORD_MAX_LENGTH);
+    size_t record = 0;
+    struct health_log_record r;
 
-            freez(ae->exec);
-            ae->exec = strdupz(pointers[16]);
-            if(!*ae->exec) { freez(ae->exec); ae->exec = NULL; }
+    while(fread(&r, sizeof(r), 1, fp) == 1) {
+        record++;
 
-            freez(ae->recipient);
-            ae->recipient = strdupz(pointers[17]);
-            if(!*ae->recipient) { freez(ae->recipient); ae->recipient = NULL; }
+        // a crash may leave a partially written record at the end
+        if(unlikely(r.signature != HEALTH_LOG_RECORD_SIGNATURE || r.length < sizeof(r) || r.length > HEALTH_LOG_RECORD_MAX_LENGTH || (r.type != 'A' && r.type != 'U'))) {
+            error("HEALTH [%s]: record %zu of file '%s' is invalid. Ignoring the rest of the file.", host->hostname, record, filename);
+            stats->errored++;
+            break;
+        }
 
-            freez(ae->source);
-            ae->source = strdupz(pointers[18]);
-            if(!*ae->source) { freez(ae->source); ae->source = NULL; }
+        size_t len = r.length - sizeof(r);
+        if(unlikely(fread(buf, len, 1, fp) != 1)) {
+            error("HEALTH [%s]: record %zu of file '%s' is truncated. Ignoring it.", host->hostname, record, filename);
+            stats->errored++;
+            break;
+        }
 
-            freez(ae->units);
-            ae->units = strdupz(pointers[19]);
-            if(!*ae->units) { freez(ae->units); ae->units = NULL; }
+        const char *strings[HEALTH_LOG_STRINGS];
+        size_t i, pos = 0;
+        for(i = 0; i < HEALTH_LOG_STRINGS ; i++) {
+            if(unlikely(!r.strings_length[i] || pos + r.strings_length[i] > len || buf[pos + r.strings_length[i] - 1] != '\0'))
+                break;
 
-            freez(ae->info);
-            ae->info = strdupz(pointers[20]);
-            if(!*ae->info) { freez(ae->info); ae->info = NULL; }
+            strings[i] = &buf[pos];
+            pos += r.strings_length[i];
+        }
 
-            ae->exec_code   = str2i(pointers[21]);
-            ae->new_status  = str2i(pointers[22]);
-            ae->old_status  = str2i(pointers[23]);
-            ae->delay       = str2i(pointers[24]);
+        if(unlikely(i != HEALTH_LOG_STRINGS || pos != len)) {
+            error("HEALTH [%s]: record %zu of file '%s' has invalid strings. Ignoring the rest of the file.", host->hostname, record, filename);
+            stats->errored++;
+            break;
+        }
 
-            ae->new_value   = str2l(pointers[25]);
-            ae->old_value   = str2l(pointers[26]);
+        ALARM_ENTRY e = {
+                .unique_id              = r.unique_id,
+                .alarm_id               = r.alarm_id,
+                .alarm_event_id         = r.alarm_event_id,
+                .updated_by_id          = r.updated_by_id,
+                .updates_id             = r.updates_id,
+
+                .when                   = r.when,
+                .duration               = r.duration,
+                .non_clear_duration     = r.non_clear_duration,
+                .flags                  = r.flags,
+                .exec_run_timestamp     = r.exec_run_timestamp,
+                .delay_up_to_timestamp  = r.delay_up_to_timestamp,
+
+                .name                   = (char *)strings[0],
+                .chart                  = (char *)strings[1],
+                .family                 = (char *)strings[2],
+                .exec                   = (char *)strings[3],
+                .recipient              = (char *)strings[4],
+                .source                 = (char *)strings[5],
+                .units                  = (char *)strings[6],
+                .info                   = (char *)strings[7],
+
+                .exec_code              = r.exec_code,
+                .new_status             = r.new_status,
+                .old_status             = r.old_status,
+                .delay                  = r.delay,
+
+                .new_value              = r.new_value,
+                .old_value              = r.old_value,
+
+                .last_repeat            = (time_t)r.last_repeat
+        };
+
+        health_alarm_log_apply(host, (char)r.type, &e, 1, filename, record, stats);
+    }
 
-            ae->last_repeat = last_repeat;
+    freez(buf);
+}
 
-            char value_string[100 + 1];
-            freez(ae->old_value_string);
-            freez(ae->new_value_string);
-            ae->old_value_string = strdupz(format_value_and_unit(value_string, 100, ae->old_value, ae->units, -1));
-            ae->new_value_string = strdupz(format_value_and_unit(value_string, 100, ae->new_value, ae->units, -1));
+inline ssize_t health_alarm_log_read(RRDHOST *host, FILE *fp, const char *filename) {
+    errno = 0;
 
-            // add it to host if not already there
-            if(unlikely(*pointers[0] == 'A')) {
-                ae->next = host->health_log.alarms;
-                host->health_log.alarms = ae;
-                loaded++;
-            }
-            else updated++;
+    struct health_log_read_stats stats = { 0, 0, 0, 0 };
 
-            if(unlikely(ae->unique_id > host->health_max_unique_id))
-                host->health_max_unique_id = ae->unique_id;
+    netdata_rwlock_rdlock(&host->health_log.alarm_log_rwlock);
 
-            if(unlikely(ae->alarm_id >= host->health_max_alarm_id))
-                host->health_max_alarm_id = ae->alarm_id;
-        }
-        else {
-            error("HEALTH [%s]: line %zu of file '%s' is invalid (unrecognized entry type '%s').", host->hostname, line, filename, pointers[0]);
-            errored++;
-        }
+    char magic[HEALTH_LOG_FILE_MAGIC_LENGTH];
+    if(fread(magic, HEALTH_LOG_FILE_MAGIC_LENGTH, 1, fp) == 1 && !memcmp(magic, HEALTH_LOG_FILE_MAGIC, HEALTH_LOG_FILE_MAGIC_LENGTH))
+        health_alarm_log_read_binary(host, fp, filename, &stats);
+    else {
+        rewind(fp);
+        health_alarm_log_read_text(host, fp, filename, &stats);
     }
 
     netdata_rwlock_unlock(&host->health_log.alarm_log_rwlock);
 
-    freez(buf);
-
     if(!host->health_max_unique_id) host->health_max_unique_id = (uint32_t)now_realtime_sec();
     if(!host->health_max_alarm_id)  host->health_max_alarm_id  = (uint32_t)now_realtime_sec();
 
     host->health_log.next_log_id = host->health_max_unique_id + 1;
     host->health_log.next_alarm_id = host->health_max_alarm_id + 1;
 
-    debug(D_HEALTH, "HEALTH [%s]: loaded file '%s' with %zd new alarm entries, updated %zd alarms, errors %zd entries, duplicate %zd", host->hostname, filename, loaded, updated, errored, duplicate);
-    return loaded;
+    debug(D_HEALTH, "HEALTH [%s]: loaded file '%s' with %zd new alarm entries, updated %zd alarms, errors %zd entries, duplicate %zd", host->hostname, filename, stats.loaded, stats.updated, stats.errored, stats.duplicate);
+    return stats.loaded;
+}
+
+static void health_alarm_log_read_file(RRDHOST *host, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if(!fp) {
+        if(errno != ENOENT)
+            error("HEALTH [%s]: cannot open health file: %s", host->hostname, filename);
+        return;
+    }
+
+    health_alarm_log_read(host, fp, filename);
+    fclose(fp);
 }
 
 inline void health_alarm_log_load(RRDHOST *host) {
     health_alarm_log_close(host);
 
+    // the last snapshot, a log rotated out before its snapshot was saved
+    // (if netdata stopped in between) and the current log, in this order
     char filename[FILENAME_MAX + 1];
     snprintfz(filename, FILENAME_MAX, "%s.old", host->health_log_filename);
-    FILE *fp = fopen(filename, "r");
-    if(!fp)
-        error("HEALTH [%s]: cannot open health file: %s", host->hostname, filename);
-    else {
-        health_alarm_log_read(host, fp, filename);
-        fclose(fp);
-    }
+    health_alarm_log_read_file(host, filename);
 
-    host->health_log_entries_written = 0;
-    fp = fopen(host->health_log_filename, "r");
-    if(!fp)
-        error("HEALTH [%s]: cannot open health file: %s", host->hostname, host->health_log_filename);
-    else {
-        health_alarm_log_read(host, fp, host->health_log_filename);
-        fclose(fp);
-    }
+    snprintfz(filename, FILENAME_MAX, "%s.rotated", host->health_log_filename);
+    health_alarm_log_read_file(host, filename);
+
+    health_alarm_log_read_file(host, host->health_log_filename);
 
-    health_alarm_log_open(host);
+    // start with a fresh snapshot, so that the next restart
+    // has to read only the records appended from now on
+    health_log_compact(host, 0);
 }
 
 
@@ -481,6 +806,9 @@ inline void health_alarm_log(
     netdata_rwlock_unlock(&host->health_log.alarm_log_rwlock);
 
     health_alarm_log_save(host, ae);
+
+    // not in health_alarm_log_save(), which may be called with the log locked
+    health_log_rotate(host);
 }
 
 inline void health_alarm_log_free_one_nochecks_nounlink(ALARM_ENTRY *ae) {
@@ -500,6 +828,10 @@ inline void health_alarm_log_free_one_nochecks_nounlink(ALARM_ENTRY *ae) {
 inline void health_alarm_log_free(RRDHOST *host) {
     rrdhost_check_wrlock(host);
 
+    health_notifications_host_cleanup(host);
+    health_log_compaction_wait(host);
+    health_alarm_log_close(host);
+
     netdata_rwlock_wrlock(&host->health_log.alarm_log_rwlock);
 
     ALARM_ENTRY *ae;
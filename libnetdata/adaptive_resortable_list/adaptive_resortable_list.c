@@ -47,10 +47,148 @@ ARL_BASE *arl_create(const char *name, void (*processor)(const char *, uint32_t,
     return base;
 }
 
+ARL_BASE *arl_create_perfect_hash(const char *name, void (*processor)(const char *, uint32_t, const char *, void *), size_t rechecks) {
+    ARL_BASE *base = arl_create(name, processor, rechecks);
+    base->flags |= ARL_BASE_FLAG_PERFECT_HASH;
+    return base;
+}
+
+// ----------------------------------------------------------------------------
+// perfect hash
+//
+// The expected keywords are grouped in buckets by their hash, and for each
+// bucket (the biggest first) we find a displacement that places all its
+// keywords in free slots of the table (hash and displace). So, arl_check()
+// finds any keyword with one hash, one lookup and one strcmp(), no matter
+// the order of the source data. The keywords are not relinked: each one
+// remembers the one found after it (phash_next), so that arl_check() tries
+// it with a strcmp() first, like the adaptive list does.
+
+#define ARL_PHASH_MAX_DISPLACEMENT 65535
+#define ARL_PHASH_MAX_TABLE_RATIO 16    // the table can be up to 16 times the keywords
+
+static void arl_phash_free(ARL_BASE *base) {
+    freez(base->phash_displacements);
+    freez(base->phash_table);
+    base->phash_displacements = NULL;
+    base->phash_table = NULL;
+    base->phash_mask = 0;
+    base->phash_buckets_mask = 0;
+    base->phash_first = NULL;
+    base->phash_last = NULL;
+}
+
+static inline uint32_t arl_phash_pow2(size_t n) {
+    uint32_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+}
+
+// places the keywords of the table, returns 0 on success
+static int arl_phash_place(ARL_BASE *base, ARL_ENTRY **entries, size_t count, uint32_t table_size, uint32_t buckets) {
+    size_t i, j, k;
+
+    base->phash_mask = table_size - 1;
+    base->phash_buckets_mask = buckets - 1;
+    base->phash_table = callocz(table_size, sizeof(ARL_ENTRY *));
+    base->phash_displacements = callocz(buckets, sizeof(uint16_t));
+
+    // the number of keywords of each bucket
+    size_t *sizes = callocz(buckets, sizeof(size_t)), max_size = 0;
+    for(i = 0; i < count ; i++) {
+        size_t b = arl_phash_bucket(entries[i]->hash, base->phash_buckets_mask);
+        if(++sizes[b] > max_size) max_size = sizes[b];
+    }
+
+    ARL_ENTRY **bucket = mallocz((max_size ? max_size : 1) * sizeof(ARL_ENTRY *));
+    uint32_t *slots = mallocz((max_size ? max_size : 1) * sizeof(uint32_t));
+    int ret = 0;
+
+    // the biggest buckets first, while the table is empty
+    size_t size;
+    for(size = max_size; size > 0 && !ret ; size--) {
+        uint32_t b;
+        for(b = 0; b < buckets && !ret ; b++) {
+            if(sizes[b] != size) continue;
+
+            for(i = 0, j = 0; i < count ; i++)
+                if(arl_phash_bucket(entries[i]->hash, base->phash_buckets_mask) == b)
+                    bucket[j++] = entries[i];
+
+            uint32_t d;
+            for(d = 0; d <= ARL_PHASH_MAX_DISPLACEMENT ; d++) {
+                for(j = 0; j < size ; j++) {
+                    slots[j] = arl_phash_slot(bucket[j]->hash, (uint16_t)d, base->phash_mask);
+                    if(base->phash_table[slots[j]]) break;
+
+                    for(k = 0; k < j && slots[k] != slots[j] ; k++) ;
+                    if(k != j) break;
+                }
+
+                if(j == size) break;
+            }
+
+            if(d > ARL_PHASH_MAX_DISPLACEMENT) {
+                ret = 1;
+                break;
+            }
+
+            base->phash_displacements[b] = (uint16_t)d;
+            for(j = 0; j < size ; j++)
+                base->phash_table[slots[j]] = bucket[j];
+        }
+    }
+
+    freez(slots);
+    freez(bucket);
+    freez(sizes);
+
+    if(ret) arl_phash_free(base);
+    return ret;
+}
+
+static void arl_phash_build(ARL_BASE *base) {
+    ARL_ENTRY *e, **entries;
+    size_t count = 0, i, j;
+
+    arl_phash_free(base);
+    base->phash_expected = base->expected;
+
+    for(e = base->head; e ; e = e->next)
+        if(e->flags & ARL_ENTRY_FLAG_EXPECTED) count++;
+
+    entries = mallocz((count ? count : 1) * sizeof(ARL_ENTRY *));
+    for(e = base->head, i = 0; e ; e = e->next)
+        if(e->flags & ARL_ENTRY_FLAG_EXPECTED) entries[i++] = e;
+
+    // keywords with the same hash cannot be separated by the perfect hash
+    for(i = 0; i < count ; i++) {
+        for(j = i + 1; j < count ; j++) {
+            if(entries[i]->hash == entries[j]->hash) {
+                info("ARL '%s': keywords '%s' and '%s' have the same hash, using an adaptive list for them.", base->name, entries[i]->name, entries[j]->name);
+                freez(entries);
+                return;
+            }
+        }
+    }
+
+    uint32_t buckets = arl_phash_pow2(count / 2 + 1), table_size;
+    for(table_size = arl_phash_pow2(count * 2 + 1); table_size <= arl_phash_pow2(count * ARL_PHASH_MAX_TABLE_RATIO + 1) ; table_size <<= 1)
+        if(!arl_phash_place(base, entries, count, table_size, buckets))
+            break;
+
+    if(!base->phash_table)
+        info("ARL '%s': cannot build a perfect hash for its %zu keywords, using an adaptive list for them.", base->name, count);
+
+    freez(entries);
+}
+
 void arl_free(ARL_BASE *arl_base) {
     if(unlikely(!arl_base))
         return;
 
+    arl_phash_free(arl_base);
+
     while(arl_base->head) {
         ARL_ENTRY *e = arl_base->head;
         arl_base->head = e->next;
@@ -74,7 +212,7 @@ void arl_free(ARL_BASE *arl_base) {
 void arl_begin(ARL_BASE *base) {
 
 #ifdef NETDATA_INTERNAL_CHECKS
-    if(likely(base->iteration > 10)) {
+    if(likely(base->iteration > 10 && !base->phash_table)) {
         // do these checks after the ARL has been sorted
 
         if(unlikely(base->relinkings > (base->expected + base->allocated)))
@@ -163,10 +301,18 @@ void arl_begin(ARL_BASE *base) {
         arl_expect(base, "a-really-not-existing-source-keyword", NULL);
     }
 
+    if(unlikely((base->flags & ARL_BASE_FLAG_PERFECT_HASH) && base->phash_expected != base->expected))
+        arl_phash_build(base);
+
     base->iteration++;
     base->next_keyword = base->head;
     base->found = 0;
 
+    if(base->phash_table) {
+        base->next_keyword = base->phash_first;
+        base->phash_last = NULL;
+    }
+
 }
 
 // register an expected keyword to the ARL
@@ -9,6 +9,8 @@
 #define ARL_ENTRY_FLAG_EXPECTED 0x02    // the entry is expected by the program
 #define ARL_ENTRY_FLAG_DYNAMIC  0x04    // the entry was dynamically allocated, from source data
 
+#define ARL_BASE_FLAG_PERFECT_HASH 0x01 // find the keywords with a perfect hash of the expected ones
+
 typedef struct arl_entry {
     char *name;             // the keywords
     uint32_t hash;          // the hash of the keyword
@@ -22,6 +24,9 @@ typedef struct arl_entry {
 
     // double linked list for fast re-linkings
     struct arl_entry *prev, *next;
+
+    // with a perfect hash, the expected keyword found after this one, the last time
+    struct arl_entry *phash_next;
 } ARL_ENTRY;
 
 typedef struct arl_base {
@@ -61,11 +66,29 @@ typedef struct arl_base {
     // since we keep the list of keywords sorted (as found in the source data)
     // this is next keyword that we expect to find in the source data.
     ARL_ENTRY *next_keyword;
+
+    uint8_t flags;      // ARL_BASE_FLAG_*
+
+    // the perfect hash of the expected keywords (ARL_BASE_FLAG_PERFECT_HASH)
+    // it is built by arl_begin(), every time new keywords are expected
+    // when it cannot be built, the ARL works as an adaptive list
+    size_t phash_expected;          // the expected keywords it has been built for
+    uint32_t phash_buckets_mask;    // the keywords are first grouped in buckets
+    uint32_t phash_mask;            // and then placed in the table
+    uint16_t *phash_displacements;  // by the displacement of their bucket
+    ARL_ENTRY **phash_table;
+    ARL_ENTRY *phash_first;         // the first expected keyword found, the last time
+    ARL_ENTRY *phash_last;          // the last expected keyword found in this iteration
 } ARL_BASE;
 
 // create a new ARL
 extern ARL_BASE *arl_create(const char *name, void (*processor)(const char *, uint32_t, const char *, void *), size_t rechecks);
 
+// create a new ARL, that finds the expected keywords with a perfect hash
+// instead of following the order of the source data - for sources that have
+// a fixed set of keywords, but not necessarily in the same order
+extern ARL_BASE *arl_create_perfect_hash(const char *name, void (*processor)(const char *, uint32_t, const char *, void *), size_t rechecks);
+
 // free an ARL
 extern void arl_free(ARL_BASE *arl_base);
 
@@ -84,12 +107,69 @@ extern void arl_callback_str2ull(const char *name, uint32_t hash, const char *va
 extern void arl_callback_str2kernel_uint_t(const char *name, uint32_t hash, const char *value, void *dst);
 extern void arl_callback_ssize_t(const char *name, uint32_t hash, const char *value, void *dst);
 
+// the slot of the perfect hash table of a keyword hash
+static inline uint32_t arl_phash_bucket(uint32_t hash, uint32_t buckets_mask) {
+    return (hash ^ (hash >> 16)) & buckets_mask;
+}
+
+static inline uint32_t arl_phash_slot(uint32_t hash, uint16_t displacement, uint32_t mask) {
+    uint32_t h = hash ^ ((uint32_t)displacement * 0x9e3779b9U);
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return h & mask;
+}
+
+// arl_check() for ARLs with a perfect hash
+// the expected keywords are remembered in the order they were found, so that
+// when the source keeps its order, a strcmp() finds them without hashing them
+// the keywords that are not expected are not remembered, they are just skipped
+static inline int arl_check_perfect_hash(ARL_BASE *base, const char *keyword, const char *value) {
+    ARL_ENTRY *e = base->next_keyword;
+
+    if(unlikely(!e || strcmp(keyword, e->name))) {
+        uint32_t hash = simple_hash(keyword);
+        e = base->phash_table[arl_phash_slot(hash, base->phash_displacements[arl_phash_bucket(hash, base->phash_buckets_mask)], base->phash_mask)];
+
+        if(unlikely(!e || e->hash != hash || strcmp(e->name, keyword))) {
+#ifdef NETDATA_INTERNAL_CHECKS
+            base->slow++;
+#endif
+            return 0;
+        }
+
+        // remember the order of the source
+        if(base->phash_last) base->phash_last->phash_next = e;
+        else base->phash_first = e;
+    }
+
+#ifdef NETDATA_INTERNAL_CHECKS
+    base->fast++;
+#endif
+
+    base->phash_last = e;
+    base->next_keyword = e->phash_next;
+    e->flags |= ARL_ENTRY_FLAG_FOUND;
+
+    // execute the processor
+    if(unlikely(e->dst)) {
+        e->processor(e->name, e->hash, value, e->dst);
+        base->found++;
+    }
+
+    // stop if we collected all the values for this iteration
+    return (base->found == base->wanted);
+}
+
 // check a keyword against the ARL
 // this is to be called for each keyword read from source data
 // s = the keyword, as collected
 // src = the src data to be passed to the processor
 // it is defined in the header file in order to be inlined
 static inline int arl_check(ARL_BASE *base, const char *keyword, const char *value) {
+    if(base->phash_table)
+        return arl_check_perfect_hash(base, keyword, value);
+
     ARL_ENTRY *e = base->next_keyword;
 
 #ifdef NETDATA_INTERNAL_CHECKS
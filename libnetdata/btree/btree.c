@@ -0,0 +1,449 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "../libnetdata.h"
+
+// A B-tree of minimum degree BTREE_T = BTREE_MIN_DEGREE: every node but the root has
+// BTREE_T - 1 to 2 * BTREE_T - 1 items, every internal node has one child more than its items.
+// Inserting splits the full nodes on the way down and removing fills the nodes
+// with BTREE_T - 1 items on the way down (Cormen et al.), so both are single pass.
+
+#define BTREE_T BTREE_MIN_DEGREE
+
+// what btree_node_find() looks for
+typedef enum btree_key_type {
+    BTREE_KEY_ITEM,         // the item equal to key.item
+    BTREE_KEY_MIN,          // the first item
+    BTREE_KEY_MAX           // the last item
+} BTREE_KEY_TYPE;
+
+typedef struct btree_key {
+    BTREE_KEY_TYPE type;
+    uint32_t prefix;
+    void *item;
+} BTREE_KEY;
+
+// ----------------------------------------------------------------------------
+// nodes
+
+static BTREE_NODE *btree_node_create(BTREE *tree, int leaf) {
+    // the leaves do not need the children
+    size_t size = leaf ? offsetof(BTREE_NODE, children) : sizeof(BTREE_NODE);
+
+    BTREE_NODE *node = mallocz(size);
+    node->count = 0;
+    node->leaf = (uint16_t)leaf;
+
+    tree->nodes++;
+    return node;
+}
+
+static void btree_node_free(BTREE *tree, BTREE_NODE *node) {
+    freez(node);
+    tree->nodes--;
+}
+
+static inline void btree_key_set(BTREE *tree, BTREE_KEY *key, BTREE_KEY_TYPE type, void *item) {
+    key->type = type;
+    key->item = item;
+    key->prefix = (item && tree->prefix) ? tree->prefix(item) : 0;
+}
+
+static inline int btree_compare(BTREE *tree, BTREE_KEY *key, BTREE_NODE *node, int i) {
+    switch(key->type) {
+        case BTREE_KEY_MIN:
+            return -1;
+
+        case BTREE_KEY_MAX:
+            return 1;
+
+        case BTREE_KEY_ITEM:
+        default:
+            if(key->prefix < node->prefix[i]) return -1;
+            if(key->prefix > node->prefix[i]) return 1;
+            return tree->compar(key->item, node->items[i]);
+    }
+}
+
+// returns the position of the first item of node that is not less than key
+// found is set when that item is equal to key
+static inline int btree_node_find(BTREE *tree, BTREE_NODE *node, BTREE_KEY *key, int *found) {
+    int low = 0, high = node->count;
+
+    *found = 0;
+    while(low < high) {
+        int mid = (low + high) / 2;
+        int cmp = btree_compare(tree, key, node, mid);
+
+        if(cmp > 0)
+            low = mid + 1;
+        else {
+            if(cmp == 0) {
+                *found = 1;
+                return mid;
+            }
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static inline void btree_node_insert_item(BTREE_NODE *node, int i, uint32_t prefix, void *item) {
+    memmove(&node->prefix[i + 1], &node->prefix[i], (node->count - i) * sizeof(uint32_t));
+    memmove(&node->items[i + 1], &node->items[i], (node->count - i) * sizeof(void *));
+    node->prefix[i] = prefix;
+    node->items[i] = item;
+    node->count++;
+}
+
+static inline void btree_node_remove_item(BTREE_NODE *node, int i) {
+    memmove(&node->prefix[i], &node->prefix[i + 1], (node->count - i - 1) * sizeof(uint32_t));
+    memmove(&node->items[i], &node->items[i + 1], (node->count - i - 1) * sizeof(void *));
+    node->count--;
+}
+
+static inline void btree_node_insert_child(BTREE_NODE *node, int i, BTREE_NODE *child) {
+    // the item has been inserted already, so the node has count + 1 children
+    memmove(&node->children[i + 1], &node->children[i], (node->count - i) * sizeof(BTREE_NODE *));
+    node->children[i] = child;
+}
+
+static inline void btree_node_remove_child(BTREE_NODE *node, int i) {
+    // the item has been removed already, so the node had count + 2 children
+    memmove(&node->children[i], &node->children[i + 1], (node->count + 1 - i) * sizeof(BTREE_NODE *));
+}
+
+// splits the full child i of parent, moving its middle item to parent
+static void btree_split_child(BTREE *tree, BTREE_NODE *parent, int i) {
+    BTREE_NODE *left = parent->children[i];
+    BTREE_NODE *right = btree_node_create(tree, left->leaf);
+
+    right->count = BTREE_T - 1;
+    memcpy(right->prefix, &left->prefix[BTREE_T], (BTREE_T - 1) * sizeof(uint32_t));
+    memcpy(right->items, &left->items[BTREE_T], (BTREE_T - 1) * sizeof(void *));
+    if(!left->leaf)
+        memcpy(right->children, &left->children[BTREE_T], BTREE_T * sizeof(BTREE_NODE *));
+
+    left->count = BTREE_T - 1;
+
+    btree_node_insert_item(parent, i, left->prefix[BTREE_T - 1], left->items[BTREE_T - 1]);
+    btree_node_insert_child(parent, i + 1, right);
+}
+
+// merges child i + 1 of parent and item i of parent into child i
+// both children have BTREE_T - 1 items
+static void btree_merge_children(BTREE *tree, BTREE_NODE *parent, int i) {
+    BTREE_NODE *left = parent->children[i];
+    BTREE_NODE *right = parent->children[i + 1];
+
+    left->prefix[BTREE_T - 1] = parent->prefix[i];
+    left->items[BTREE_T - 1] = parent->items[i];
+    memcpy(&left->prefix[BTREE_T], right->prefix, right->count * sizeof(uint32_t));
+    memcpy(&left->items[BTREE_T], right->items, right->count * sizeof(void *));
+    if(!left->leaf)
+        memcpy(&left->children[BTREE_T], right->children, (right->count + 1) * sizeof(BTREE_NODE *));
+
+    left->count = (uint16_t)(BTREE_T + right->count);
+
+    btree_node_remove_item(parent, i);
+    btree_node_remove_child(parent, i + 1);
+    btree_node_free(tree, right);
+}
+
+// makes sure child i of parent has at least BTREE_T items, before descending to it
+// returns the child to descend to, which may be another one after a merge
+static int btree_fill_child(BTREE *tree, BTREE_NODE *parent, int i) {
+    BTREE_NODE *child = parent->children[i];
+
+    if(child->count >= BTREE_T)
+        return i;
+
+    if(i > 0 && parent->children[i - 1]->count >= BTREE_T) {
+        // borrow the last item of the left sibling, through the parent
+        BTREE_NODE *left = parent->children[i - 1];
+
+        btree_node_insert_item(child, 0, parent->prefix[i - 1], parent->items[i - 1]);
+        if(!child->leaf) {
+            memmove(&child->children[1], &child->children[0], child->count * sizeof(BTREE_NODE *));
+            child->children[0] = left->children[left->count];
+        }
+
+        parent->prefix[i - 1] = left->prefix[left->count - 1];
+        parent->items[i - 1] = left->items[left->count - 1];
+        left->count--;
+        return i;
+    }
+
+    if(i < parent->count && parent->children[i + 1]->count >= BTREE_T) {
+        // borrow the first item of the right sibling, through the parent
+        BTREE_NODE *right = parent->children[i + 1];
+
+        child->prefix[child->count] = parent->prefix[i];
+        child->items[child->count] = parent->items[i];
+        child->count++;
+        if(!child->leaf)
+            child->children[child->count] = right->children[0];
+
+        parent->prefix[i] = right->prefix[0];
+        parent->items[i] = right->items[0];
+
+        btree_node_remove_item(right, 0);
+        if(!right->leaf)
+            memmove(&right->children[0], &right->children[1], (right->count + 1) * sizeof(BTREE_NODE *));
+
+        return i;
+    }
+
+    // both siblings have BTREE_T - 1 items, merge with one of them
+    if(i < parent->count) {
+        btree_merge_children(tree, parent, i);
+        return i;
+    }
+
+    btree_merge_children(tree, parent, i - 1);
+    return i - 1;
+}
+
+// removes the item equal to key from the subtree of node, that has at least BTREE_T items (or is the root)
+static void *btree_remove_from(BTREE *tree, BTREE_NODE *node, BTREE_KEY *key) {
+    for(;;) {
+        int found;
+        int i = btree_node_find(tree, node, key, &found);
+
+        if(node->leaf) {
+            if(key->type == BTREE_KEY_MAX && node->count) {
+                i = node->count - 1;
+                found = 1;
+            }
+            else if(key->type == BTREE_KEY_MIN && node->count)
+                found = 1;
+
+            if(!found)
+                return NULL;
+
+            void *item = node->items[i];
+            btree_node_remove_item(node, i);
+            return item;
+        }
+
+        if(found) {
+            void *item = node->items[i];
+            BTREE_KEY k;
+
+            if(node->children[i]->count >= BTREE_T) {
+                // replace it with its predecessor
+                btree_key_set(tree, &k, BTREE_KEY_MAX, NULL);
+                void *predecessor = btree_remove_from(tree, node->children[i], &k);
+                node->prefix[i] = tree->prefix ? tree->prefix(predecessor) : 0;
+                node->items[i] = predecessor;
+                return item;
+            }
+
+            if(node->children[i + 1]->count >= BTREE_T) {
+                // replace it with its successor
+                btree_key_set(tree, &k, BTREE_KEY_MIN, NULL);
+                void *successor = btree_remove_from(tree, node->children[i + 1], &k);
+                node->prefix[i] = tree->prefix ? tree->prefix(successor) : 0;
+                node->items[i] = successor;
+                return item;
+            }
+
+            // merge it with both children and remove it from there
+            btree_merge_children(tree, node, i);
+            node = node->children[i];
+            continue;
+        }
+
+        i = btree_fill_child(tree, node, i);
+        node = node->children[i];
+    }
+}
+
+static int btree_walker(BTREE_NODE *node, int (*callback)(void *entry, void *data), void *data) {
+    int total = 0, ret, i;
+
+    for(i = 0; i < node->count ; i++) {
+        if(!node->leaf) {
+            ret = btree_walker(node->children[i], callback, data);
+            if(ret < 0) return ret;
+            total += ret;
+        }
+
+        ret = callback(node->items[i], data);
+        if(ret < 0) return ret;
+        total += ret;
+    }
+
+    if(!node->leaf) {
+        ret = btree_walker(node->children[i], callback, data);
+        if(ret < 0) return ret;
+        total += ret;
+    }
+
+    return total;
+}
+
+static void btree_free_nodes(BTREE *tree, BTREE_NODE *node) {
+    int i;
+
+    if(!node->leaf)
+        for(i = 0; i <= node->count ; i++)
+            btree_free_nodes(tree, node->children[i]);
+
+    btree_node_free(tree, node);
+}
+
+// ----------------------------------------------------------------------------
+// public API
+
+void btree_init(BTREE *tree, int (*compar)(void *a, void *b), uint32_t (*prefix)(void *item)) {
+    tree->root = NULL;
+    tree->compar = compar;
+    tree->prefix = prefix;
+    tree->entries = 0;
+    tree->nodes = 0;
+}
+
+void btree_destroy(BTREE *tree) {
+    if(tree->root)
+        btree_free_nodes(tree, tree->root);
+
+    tree->root = NULL;
+    tree->entries = 0;
+}
+
+void *btree_search(BTREE *tree, void *item) {
+    BTREE_NODE *node = tree->root;
+    BTREE_KEY key;
+    int found;
+
+    btree_key_set(tree, &key, BTREE_KEY_ITEM, item);
+
+    while(node) {
+        int i = btree_node_find(tree, node, &key, &found);
+        if(found)
+            return node->items[i];
+
+        node = node->leaf ? NULL : node->children[i];
+    }
+
+    return NULL;
+}
+
+void *btree_insert(BTREE *tree, void *item) {
+    BTREE_KEY key;
+    int found, i;
+
+    btree_key_set(tree, &key, BTREE_KEY_ITEM, item);
+
+    if(unlikely(!tree->root))
+        tree->root = btree_node_create(tree, 1);
+
+    if(unlikely(tree->root->count == BTREE_MAX_ITEMS)) {
+        // the tree grows at the root
+        BTREE_NODE *root = btree_node_create(tree, 0);
+        root->children[0] = tree->root;
+        tree->root = root;
+        btree_split_child(tree, root, 0);
+    }
+
+    BTREE_NODE *node = tree->root;
+    for(;;) {
+        i = btree_node_find(tree, node, &key, &found);
+        if(found)
+            return node->items[i];
+
+        if(node->leaf)
+            break;
+
+        if(node->children[i]->count == BTREE_MAX_ITEMS) {
+            btree_split_child(tree, node, i);
+
+            // the middle item of the child is now at i
+            int cmp = btree_compare(tree, &key, node, i);
+            if(cmp == 0)
+                return node->items[i];
+            if(cmp > 0)
+                i++;
+        }
+
+        node = node->children[i];
+    }
+
+    btree_node_insert_item(node, i, key.prefix, item);
+    tree->entries++;
+    return item;
+}
+
+void *btree_remove(BTREE *tree, void *item) {
+    if(unlikely(!tree->root))
+        return NULL;
+
+    BTREE_KEY key;
+    btree_key_set(tree, &key, BTREE_KEY_ITEM, item);
+
+    void *ret = btree_remove_from(tree, tree->root, &key);
+    if(ret)
+        tree->entries--;
+
+    // the tree shrinks at the root
+    BTREE_NODE *root = tree->root;
+    if(!root->count) {
+        tree->root = root->leaf ? NULL : root->children[0];
+        btree_node_free(tree, root);
+    }
+
+    return ret;
+}
+
+int btree_traverse(BTREE *tree, int (*callback)(void *entry, void *data), void *data) {
+    if(tree->root)
+        return btree_walker(tree->root, callback, data);
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// the locked variants
+
+void btree_init_lock(BTREE_LOCK *tree, int (*compar)(void *a, void *b), uint32_t (*prefix)(void *item)) {
+    btree_init(&tree->btree, compar, prefix);
+
+    int lock = netdata_rwlock_init(&tree->rwlock);
+    if(lock != 0)
+        fatal("Failed to initialize btree rwlock, error: %d", lock);
+}
+
+void btree_destroy_lock(BTREE_LOCK *tree) {
+    netdata_rwlock_wrlock(&tree->rwlock);
+    btree_destroy(&tree->btree);
+    netdata_rwlock_unlock(&tree->rwlock);
+}
+
+void *btree_search_lock(BTREE_LOCK *tree, void *item) {
+    netdata_rwlock_rdlock(&tree->rwlock);
+    void *ret = btree_search(&tree->btree, item);
+    netdata_rwlock_unlock(&tree->rwlock);
+    return ret;
+}
+
+void *btree_insert_lock(BTREE_LOCK *tree, void *item) {
+    netdata_rwlock_wrlock(&tree->rwlock);
+    void *ret = btree_insert(&tree->btree, item);
+    netdata_rwlock_unlock(&tree->rwlock);
+    return ret;
+}
+
+void *btree_remove_lock(BTREE_LOCK *tree, void *item) {
+    netdata_rwlock_wrlock(&tree->rwlock);
+    void *ret = btree_remove(&tree->btree, item);
+    netdata_rwlock_unlock(&tree->rwlock);
+    return ret;
+}
+
+int btree_traverse_lock(BTREE_LOCK *tree, int (*callback)(void *entry, void *data), void *data) {
+    netdata_rwlock_rdlock(&tree->rwlock);
+    int ret = btree_traverse(&tree->btree, callback, data);
+    netdata_rwlock_unlock(&tree->rwlock);
+    return ret;
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_BTREE_H
+#define NETDATA_BTREE_H 1
+
+#include "../libnetdata.h"
+
+// an ordered index of pointers to items, with the same interface as the avl
+// tree: a B-tree with up to BTREE_MAX_ITEMS items per node, so a search visits
+// a few nodes instead of one node per level of a binary tree.
+//
+// The items are not linked to the tree, so they do not need any members for it.
+// Optionally, the tree keeps a 32-bit prefix of the key of each item in its
+// nodes (like the hash the avl compar() functions of netdata compare first),
+// so that a search compares the prefixes in the node and calls compar() - which
+// dereferences the items - only for the items with the same prefix.
+
+#define BTREE_MIN_DEGREE 8
+#define BTREE_MAX_ITEMS (2 * BTREE_MIN_DEGREE - 1)
+
+typedef struct btree_node {
+    uint16_t count;                                     // the items in the node
+    uint16_t leaf;                                      // the leaves do not have children
+    uint32_t prefix[BTREE_MAX_ITEMS];                   // the prefixes of the items, in one cache line
+    void *items[BTREE_MAX_ITEMS];
+    struct btree_node *children[BTREE_MAX_ITEMS + 1];   // not allocated for the leaves
+} BTREE_NODE;
+
+typedef struct btree {
+    BTREE_NODE *root;
+    int (*compar)(void *a, void *b);
+
+    // optional: compar() has to order the items by it first
+    uint32_t (*prefix)(void *item);
+
+    size_t entries;
+    size_t nodes;
+} BTREE;
+
+typedef struct btree_lock {
+    BTREE btree;
+    netdata_rwlock_t rwlock;
+} BTREE_LOCK;
+
+// Initialize the tree - prefix can be NULL
+extern void btree_init(BTREE *tree, int (*compar)(void *a, void *b), uint32_t (*prefix)(void *item));
+extern void btree_init_lock(BTREE_LOCK *tree, int (*compar)(void *a, void *b), uint32_t (*prefix)(void *item));
+
+// Free the nodes of the tree - the items are not freed
+extern void btree_destroy(BTREE *tree);
+extern void btree_destroy_lock(BTREE_LOCK *tree);
+
+// Insert item into the tree
+// returns item, or the item of the tree that is equal to it (as returned by tree->compar())
+extern void *btree_insert(BTREE *tree, void *item) NEVERNULL WARNUNUSED;
+extern void *btree_insert_lock(BTREE_LOCK *tree, void *item) NEVERNULL WARNUNUSED;
+
+// Remove the item of the tree that is equal to item
+// returns the removed item, or NULL if it is not found
+extern void *btree_remove(BTREE *tree, void *item) WARNUNUSED;
+extern void *btree_remove_lock(BTREE_LOCK *tree, void *item) WARNUNUSED;
+
+// Find the item of the tree that is equal to item
+// returns NULL if it is not found
+extern void *btree_search(BTREE *tree, void *item);
+extern void *btree_search_lock(BTREE_LOCK *tree, void *item);
+
+// Call callback for all the items, in order
+// like avl_traverse(), it stops when callback returns a negative number and returns it,
+// otherwise it returns the sum of the values returned by callback
+extern int btree_traverse(BTREE *tree, int (*callback)(void *entry, void *data), void *data);
+extern int btree_traverse_lock(BTREE_LOCK *tree, int (*callback)(void *entry, void *data), void *data);
+
+#endif /* NETDATA_BTREE_H */
@@ -99,31 +99,177 @@ inline char *print_number_llu_r_smart(char *str, unsigned long long uvalue) {
     return str;
 }
 
+// ----------------------------------------------------------------------------
+// typed appenders
+//
+// They print the numbers two digits at a time, from a lookup table, instead of
+// going through the printf() machinery, and they grow the buffer once for the
+// longest number they may print.
+
+static const char buffer_digits2[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+static const uint64_t buffer_pow10[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL
+};
+
+#define BUFFER_PRINT_DOUBLE_MAX_PRECISION ((int)(sizeof(buffer_pow10) / sizeof(buffer_pow10[0])) - 1)
+
+// the values that scaled to their precision stay below this, are printed
+// with integer arithmetic - the rest with printf()
+#define BUFFER_PRINT_DOUBLE_MAX_SCALED 1e15
+
+// writes the digits of value ending at end, returns where they start
+static inline char *print_uint64_backwards(char *end, uint64_t value) {
+    char *s = end;
+    size_t i;
+
+    // like print_number_llu_r(), use 64 bit divisions only while the value needs them
+    while(value > (uint64_t)0xffffffff) {
+        i = (size_t)(value % 100) * 2;
+        value /= 100;
+        *--s = buffer_digits2[i + 1];
+        *--s = buffer_digits2[i];
+    }
+
+    uint32_t v = (uint32_t)value;
+    while(v >= 100) {
+        i = (size_t)(v % 100) * 2;
+        v /= 100;
+        *--s = buffer_digits2[i + 1];
+        *--s = buffer_digits2[i];
+    }
+
+    if(v >= 10) {
+        i = (size_t)v * 2;
+        *--s = buffer_digits2[i + 1];
+        *--s = buffer_digits2[i];
+    }
+    else
+        *--s = (char)('0' + v);
+
+    return s;
+}
+
+void buffer_print_uint64(BUFFER *wb, uint64_t value) {
+    char digits[24], *end = &digits[sizeof(digits)];
+    char *s = print_uint64_backwards(end, value);
+
+    buffer_fast_strcat(wb, s, (size_t)(end - s));
+}
+
+void buffer_print_int64(BUFFER *wb, int64_t value) {
+    char digits[24], *end = &digits[sizeof(digits)];
+    char *s;
+
+    if(value < 0) {
+        s = print_uint64_backwards(end, (uint64_t)0 - (uint64_t)value);
+        *--s = '-';
+    }
+    else
+        s = print_uint64_backwards(end, (uint64_t)value);
+
+    buffer_fast_strcat(wb, s, (size_t)(end - s));
+}
+
 void buffer_print_llu(BUFFER *wb, unsigned long long uvalue)
 {
-    buffer_need_bytes(wb, 50);
+    buffer_print_uint64(wb, (uint64_t)uvalue);
+}
 
-    char *str = &wb->buffer[wb->len];
-    char *wstr = str;
+// prints value like printf("%0.*f", precision, value) does, but NaN and
+// infinity are printed as null, like buffer_rrd_value() does
+// the last digit may differ from printf() when value is very close to the middle
+// of two numbers of this precision, since value is rounded after it is scaled
+void buffer_print_double_fixed(BUFFER *wb, calculated_number value, int precision) {
+    if(unlikely(isnan(value) || isinf(value))) {
+        buffer_fast_strcat(wb, "null", 4);
+        return;
+    }
 
-#ifdef ENVIRONMENT32
-    if(uvalue > (unsigned long long)0xffffffff)
-        wstr = print_number_llu_r(wstr, uvalue);
-    else
-        wstr = print_number_lu_r(wstr, uvalue);
-#else
-    do *wstr++ = (char)('0' + (uvalue % 10)); while(uvalue /= 10);
-#endif
+    if(unlikely(precision < 0)) precision = 0;
 
-    // terminate it
-    *wstr = '\0';
+    calculated_number scaled = (value < 0) ? -value : value;
+    if(likely(precision <= BUFFER_PRINT_DOUBLE_MAX_PRECISION))
+        scaled *= (calculated_number)buffer_pow10[precision];
+
+    if(unlikely(precision > BUFFER_PRINT_DOUBLE_MAX_PRECISION || scaled >= BUFFER_PRINT_DOUBLE_MAX_SCALED)) {
+        buffer_sprintf(wb, "%0.*" LONG_DOUBLE_MODIFIER, precision, (LONG_DOUBLE)value);
+        return;
+    }
+
+    // round half to even, like printf() does
+    uint64_t n = (uint64_t)scaled;
+    calculated_number remainder = scaled - (calculated_number)n;
+    if(remainder > 0.5 || (remainder == 0.5 && (n & 1))) n++;
+    char digits[48], *end = &digits[sizeof(digits)], *s = end;
+
+    if(precision) {
+        uint64_t fractional = n % buffer_pow10[precision];
+        int i;
+
+        n /= buffer_pow10[precision];
+
+        for(i = 0; i < precision ; i++) {
+            *--s = (char)('0' + fractional % 10);
+            fractional /= 10;
+        }
+        *--s = '.';
+    }
+
+    s = print_uint64_backwards(s, n);
+    if(value < 0) *--s = '-';
+
+    buffer_fast_strcat(wb, s, (size_t)(end - s));
+}
 
-    // reverse it
-    char *begin = str, *end = wstr - 1, aux;
-    while (end > begin) aux = *end, *end-- = *begin, *begin++ = aux;
+// appends txt as the contents of a JSON string (without the quotes)
+void buffer_strcat_json_escaped(BUFFER *wb, const char *txt) {
+    if(unlikely(!txt)) return;
+
+    const unsigned char *t = (const unsigned char *)txt;
+    while(*t) {
+        // copy the characters that do not need escaping at once
+        const unsigned char *start = t;
+        while(*t && *t >= 0x20 && *t != '"' && *t != '\\') t++;
+        if(t != start) buffer_fast_strcat(wb, (const char *)start, (size_t)(t - start));
+        if(!*t) break;
+
+        char *s = buffer_reserve(wb, 7);
+        *s++ = '\\';
+        switch(*t) {
+            case '"':  *s++ = '"'; break;
+            case '\\': *s++ = '\\'; break;
+            case '\n': *s++ = 'n'; break;
+            case '\r': *s++ = 'r'; break;
+            case '\t': *s++ = 't'; break;
+            case '\b': *s++ = 'b'; break;
+            case '\f': *s++ = 'f'; break;
+            default:
+                *s++ = 'u';
+                *s++ = '0';
+                *s++ = '0';
+                *s++ = "0123456789abcdef"[*t >> 4];
+                *s++ = "0123456789abcdef"[*t & 0x0f];
+                break;
+        }
+        *s = '\0';
+        wb->len = (size_t)(s - wb->buffer);
+        t++;
+    }
 
-    // return the buffer length
-    wb->len += wstr - str;
+    buffer_overflow_check(wb);
 }
 
 void buffer_strcat(BUFFER *wb, const char *txt)
@@ -381,6 +527,21 @@ void buffer_free(BUFFER *b) {
     freez(b);
 }
 
+// makes a buffer bigger than size bytes, size bytes again, if its content fits
+void buffer_shrink(BUFFER *b, size_t size) {
+    buffer_overflow_check(b);
+
+    if(b->size <= size || b->len >= size) return;
+
+    debug(D_WEB_BUFFER, "Shrinking data buffer from size %zu to %zu.", b->size, size);
+
+    b->buffer = reallocz(b->buffer, size + sizeof(BUFFER_OVERFLOW_EOF) + 2);
+    b->size = size;
+
+    buffer_overflow_init(b);
+    buffer_overflow_check(b);
+}
+
 void buffer_increase(BUFFER *b, size_t free_size_required) {
     buffer_overflow_check(b);
 
@@ -391,6 +552,9 @@ void buffer_increase(BUFFER *b, size_t free_size_required) {
     size_t increase = free_size_required - left;
     if(increase < WEB_DATA_LENGTH_INCREASE_STEP) increase = WEB_DATA_LENGTH_INCREASE_STEP;
 
+    // double the size at least, so that big responses are copied a few times only while they grow
+    if(increase < b->size) increase = b->size;
+
     debug(D_WEB_BUFFER, "Increasing data buffer from size %zu to %zu.", b->size, b->size + increase);
 
     b->buffer = reallocz(b->buffer, b->size + increase + sizeof(BUFFER_OVERFLOW_EOF) + 2);
@@ -44,6 +44,7 @@ typedef struct web_buffer {
 #define CT_IMAGE_ICNS                   20
 #define CT_IMAGE_BMP                    21
 #define CT_PROMETHEUS                   22
+#define CT_TEXT_EVENT_STREAM            23
 
 #define buffer_cacheable(wb)    do { (wb)->options |= WB_CONTENT_CACHEABLE;    if((wb)->options & WB_CONTENT_NO_CACHEABLE) (wb)->options &= ~WB_CONTENT_NO_CACHEABLE; } while(0)
 #define buffer_no_cacheable(wb) do { (wb)->options |= WB_CONTENT_NO_CACHEABLE; if((wb)->options & WB_CONTENT_CACHEABLE)    (wb)->options &= ~WB_CONTENT_CACHEABLE;  (wb)->expires = 0; } while(0)
@@ -63,6 +64,7 @@ extern void buffer_jsdate(BUFFER *wb, int year, int month, int day, int hours, i
 extern BUFFER *buffer_create(size_t size);
 extern void buffer_free(BUFFER *b);
 extern void buffer_increase(BUFFER *b, size_t free_size_required);
+extern void buffer_shrink(BUFFER *b, size_t size);
 
 extern void buffer_snprintf(BUFFER *wb, size_t len, const char *fmt, ...) PRINTFLIKE(3, 4);
 extern void buffer_vsprintf(BUFFER *wb, const char *fmt, va_list args);
@@ -76,10 +78,29 @@ extern char *print_number_llu_r(char *str, unsigned long long uvalue);
 extern char *print_number_llu_r_smart(char *str, unsigned long long uvalue);
 
 extern void buffer_print_llu(BUFFER *wb, unsigned long long uvalue);
+extern void buffer_print_uint64(BUFFER *wb, uint64_t value);
+extern void buffer_print_int64(BUFFER *wb, int64_t value);
+extern void buffer_print_double_fixed(BUFFER *wb, calculated_number value, int precision);
+extern void buffer_strcat_json_escaped(BUFFER *wb, const char *txt);
 
 static inline void buffer_need_bytes(BUFFER *buffer, size_t needed_free_size) {
     if(unlikely(buffer->size - buffer->len < needed_free_size))
         buffer_increase(buffer, needed_free_size);
 }
 
+// makes room for bytes more bytes (growing the buffer geometrically) and returns
+// where they should be written - the caller adds what it writes to wb->len
+static inline char *buffer_reserve(BUFFER *wb, size_t bytes) {
+    buffer_need_bytes(wb, bytes);
+    return &wb->buffer[wb->len];
+}
+
+// appends the len bytes of txt, when its length is known
+static inline void buffer_fast_strcat(BUFFER *wb, const char *txt, size_t len) {
+    buffer_need_bytes(wb, len + 1);
+    memcpy(&wb->buffer[wb->len], txt, len);
+    wb->len += len;
+    wb->buffer[wb->len] = '\0';
+}
+
 #endif /* NETDATA_WEB_BUFFER_H */
@@ -3,6 +3,7 @@
 #include "../libnetdata.h"
 
 static int clock_boottime_valid = 1;
+static int clock_coarse_valid = 1;
 
 #ifndef HAVE_CLOCK_GETTIME
 inline int clock_gettime(clockid_t clk_id, struct timespec *ts) {
@@ -23,6 +24,12 @@ void test_clock_boottime(void) {
         clock_boottime_valid = 0;
 }
 
+void test_clock_coarse(void) {
+    struct timespec ts;
+    if(clock_gettime(NETDATA_CLOCK_REALTIME_COARSE, &ts) == -1 || clock_gettime(NETDATA_CLOCK_MONOTONIC_COARSE, &ts) == -1)
+        clock_coarse_valid = 0;
+}
+
 static inline time_t now_sec(clockid_t clk_id) {
     struct timespec ts;
     if(unlikely(clock_gettime(clk_id, &ts) == -1)) {
@@ -92,6 +99,22 @@ inline int now_boottime_timeval(struct timeval *tv) {
     return now_timeval(likely(clock_boottime_valid) ? CLOCK_BOOTTIME : CLOCK_MONOTONIC, tv);
 }
 
+inline time_t now_realtime_coarse_sec(void) {
+    return now_sec(likely(clock_coarse_valid) ? NETDATA_CLOCK_REALTIME_COARSE : CLOCK_REALTIME);
+}
+
+inline usec_t now_realtime_coarse_usec(void) {
+    return now_usec(likely(clock_coarse_valid) ? NETDATA_CLOCK_REALTIME_COARSE : CLOCK_REALTIME);
+}
+
+inline time_t now_monotonic_coarse_sec(void) {
+    return now_sec(likely(clock_coarse_valid) ? NETDATA_CLOCK_MONOTONIC_COARSE : CLOCK_MONOTONIC);
+}
+
+inline usec_t now_monotonic_coarse_usec(void) {
+    return now_usec(likely(clock_coarse_valid) ? NETDATA_CLOCK_MONOTONIC_COARSE : CLOCK_MONOTONIC);
+}
+
 inline usec_t timeval_usec(struct timeval *tv) {
     return (usec_t)tv->tv_sec * USEC_PER_SEC + (tv->tv_usec % USEC_PER_SEC);
 }
@@ -114,9 +137,51 @@ inline usec_t dt_usec(struct timeval *now, struct timeval *old) {
     return (ts1 > ts2) ? (ts1 - ts2) : (ts2 - ts1);
 }
 
-inline void heartbeat_init(heartbeat_t *hb)
+static struct heartbeat_statistics heartbeat_statistics[HEARTBEAT_STATISTICS_MAX];
+static size_t heartbeat_statistics_used = 0;
+static netdata_mutex_t heartbeat_statistics_mutex = NETDATA_MUTEX_INITIALIZER;
+
+void heartbeat_init(heartbeat_t *hb)
 {
     hb->monotonic = hb->realtime = 0ULL;
+
+    // external plugins run on their MAIN thread, so use the program name for them
+    const char *tag = netdata_thread_tag();
+    if(!strcmp(tag, "MAIN") && program_name && *program_name)
+        tag = program_name;
+
+    hb->offset = (simple_hash(tag) % HEARTBEAT_PHASE_SLOTS) * HEARTBEAT_PHASE_STEP_USEC;
+    hb->statistics_slot = -1;
+
+    netdata_mutex_lock(&heartbeat_statistics_mutex);
+
+    size_t i;
+    for(i = 0; i < heartbeat_statistics_used ; i++)
+        if(!strncmp(heartbeat_statistics[i].tag, tag, HEARTBEAT_TAG_MAX))
+            break;
+
+    if(i == heartbeat_statistics_used && heartbeat_statistics_used < HEARTBEAT_STATISTICS_MAX) {
+        strncpyz(heartbeat_statistics[i].tag, tag, HEARTBEAT_TAG_MAX);
+        heartbeat_statistics_used++;
+    }
+
+    if(i < heartbeat_statistics_used)
+        hb->statistics_slot = (int)i;
+
+    netdata_mutex_unlock(&heartbeat_statistics_mutex);
+}
+
+size_t heartbeat_statistics_copy(struct heartbeat_statistics *dst, size_t max) {
+    netdata_mutex_lock(&heartbeat_statistics_mutex);
+
+    size_t i;
+    for(i = 0; i < heartbeat_statistics_used && i < max ; i++) {
+        dst[i] = heartbeat_statistics[i];
+        heartbeat_statistics[i].latency_max = 0;
+    }
+
+    netdata_mutex_unlock(&heartbeat_statistics_mutex);
+    return i;
 }
 
 // waits for the next heartbeat
@@ -128,7 +193,11 @@ usec_t heartbeat_next(heartbeat_t *hb, usec_t tick) {
     now.monotonic = now_monotonic_usec();
     now.realtime  = now_realtime_usec();
 
-    usec_t next_monotonic = now.monotonic - (now.monotonic % tick) + tick;
+    // keep the phase within the first quarter of the tick,
+    // so that the collected values stay close to the tick boundary
+    usec_t offset = (tick >= 4) ? hb->offset % (tick / 4) : 0;
+
+    usec_t next_monotonic = now.monotonic - ((now.monotonic - offset) % tick) + tick;
 
     while(now.monotonic < next_monotonic) {
         sleep_usec(next_monotonic - now.monotonic);
@@ -143,11 +212,23 @@ usec_t heartbeat_next(heartbeat_t *hb, usec_t tick) {
         hb->monotonic = now.monotonic;
         hb->realtime  = now.realtime;
 
+        size_t overruns = 0;
         if(unlikely(dt_monotonic >= tick + tick / 2)) {
+            overruns = (dt_monotonic - tick / 2) / tick;
             errno = 0;
             error("heartbeat missed %llu monotonic microseconds", dt_monotonic - tick);
         }
 
+        if(likely(hb->statistics_slot >= 0)) {
+            usec_t latency = now.monotonic - next_monotonic;
+            struct heartbeat_statistics *hs = &heartbeat_statistics[hb->statistics_slot];
+
+            netdata_mutex_lock(&heartbeat_statistics_mutex);
+            hs->overruns += overruns;
+            if(latency > hs->latency_max) hs->latency_max = latency;
+            netdata_mutex_unlock(&heartbeat_statistics_mutex);
+        }
+
         return dt_realtime;
     }
     else {
@@ -24,8 +24,24 @@ typedef long long susec_t;
 typedef struct heartbeat {
     usec_t monotonic;
     usec_t realtime;
+    usec_t offset;              // the phase of this job within each tick
+    int statistics_slot;        // its slot in heartbeat_statistics[], or -1
 } heartbeat_t;
 
+// every job waiting on a heartbeat wakes up at a fixed phase offset within its tick,
+// derived from its thread tag, so that all of them do not wake up at the same time
+#define HEARTBEAT_PHASE_STEP_USEC 10000ULL
+#define HEARTBEAT_PHASE_SLOTS 25
+
+#define HEARTBEAT_STATISTICS_MAX 64
+#define HEARTBEAT_TAG_MAX 16
+
+struct heartbeat_statistics {
+    char tag[HEARTBEAT_TAG_MAX + 1];
+    size_t overruns;            // the number of ticks that were missed completely
+    usec_t latency_max;         // the latest wake-up since heartbeat_statistics_copy() was last called
+};
+
 /* Linux value is as good as any other */
 #ifndef CLOCK_REALTIME
 #define CLOCK_REALTIME  0
@@ -54,6 +70,20 @@ typedef struct heartbeat {
 
 #endif // CLOCK_BOOTTIME
 
+#if defined(CLOCK_REALTIME_COARSE) && defined(CLOCK_MONOTONIC_COARSE)
+/* linux */
+#define NETDATA_CLOCK_REALTIME_COARSE  CLOCK_REALTIME_COARSE
+#define NETDATA_CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC_COARSE
+#elif defined(CLOCK_REALTIME_FAST) && defined(CLOCK_MONOTONIC_FAST)
+/* freebsd */
+#define NETDATA_CLOCK_REALTIME_COARSE  CLOCK_REALTIME_FAST
+#define NETDATA_CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC_FAST
+#else
+/* the coarse clocks fall back to the precise ones */
+#define NETDATA_CLOCK_REALTIME_COARSE  CLOCK_REALTIME
+#define NETDATA_CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC
+#endif
+
 #define NSEC_PER_MSEC   1000000ULL
 
 #define NSEC_PER_SEC    1000000000ULL
@@ -112,6 +142,19 @@ extern time_t now_boottime_sec(void);
 extern usec_t now_boottime_usec(void);
 
 
+/*
+ * The COARSE clocks return the time of the last timer tick of the kernel, so they are up to a few milliseconds
+ * behind the precise ones (cf. clock_getres(CLOCK_REALTIME_COARSE)), but they are read without touching the
+ * hardware clock. Use them where second or a few milliseconds precision is enough (logs, timeouts, "now" of
+ * the expressions, last access times, etc).
+ * If the system does not have coarse clocks, they are the same as the precise ones.
+ */
+extern time_t now_realtime_coarse_sec(void);
+extern usec_t now_realtime_coarse_usec(void);
+
+extern time_t now_monotonic_coarse_sec(void);
+extern usec_t now_monotonic_coarse_usec(void);
+
 extern usec_t timeval_usec(struct timeval *tv);
 extern msec_t timeval_msec(struct timeval *tv);
 
@@ -128,6 +171,11 @@ extern usec_t heartbeat_next(heartbeat_t *hb, usec_t tick);
 /* Returns elapsed time in microseconds since last heartbeat */
 extern usec_t heartbeat_monotonic_dt_to_now_usec(heartbeat_t *hb);
 
+/* Copies the statistics of up to max jobs to dst and resets their latency_max.
+ * Returns the number of jobs copied.
+ */
+extern size_t heartbeat_statistics_copy(struct heartbeat_statistics *dst, size_t max);
+
 extern int sleep_usec(usec_t usec);
 
 /*
@@ -136,4 +184,9 @@ extern int sleep_usec(usec_t usec);
  */
 void test_clock_boottime(void);
 
+/*
+ * The coarse clocks are available since Linux 2.6.32. If they are not available, the precise ones are used.
+ */
+void test_clock_coarse(void);
+
 #endif /* NETDATA_CLOCKS_H */
@@ -19,7 +19,7 @@ struct config_option {
     uint32_t hash;          // a simple hash to speed up searching
                             // we first compare hashes, and only if the hashes are equal we do string comparisons
 
-    char *name;
+    const char *name;       // from the string pool, the same names are repeated in many sections
     char *value;
 
     struct config_option *next; // config->mutex protects just this
@@ -42,6 +42,22 @@ struct section {
                             // readers are protected using the rwlock in avl_tree_lock
 };
 
+// the read-only index of appconfig_freeze()
+// an open addressing hash table of all the options that existed when the
+// config was frozen - it is never modified or freed, so it is searched without locks
+struct config_frozen_slot {
+    uint32_t hash;          // of the section and the option names
+    const char *section;    // the name of the section (the sections are never freed)
+    const char *name;       // the name of the option, a reference of the string pool
+    struct config_option *cv;
+};
+
+struct config_frozen {
+    size_t mask;
+    size_t entries;
+    struct config_frozen_slot *slots;
+};
+
 
 // ----------------------------------------------------------------------------
 // locking
@@ -105,6 +121,76 @@ static struct section *appconfig_index_find(struct config *root, const char *nam
 }
 
 
+// ----------------------------------------------------------------------------
+// frozen config index
+
+static inline uint32_t appconfig_frozen_hash(uint32_t section_hash, uint32_t name_hash) {
+    return (section_hash * 16777619U) ^ name_hash;
+}
+
+static struct config_option *appconfig_frozen_find(struct config_frozen *frozen, const char *section, const char *name) {
+    uint32_t hash = appconfig_frozen_hash(simple_hash(section), simple_hash(name));
+    size_t i;
+
+    for(i = hash & frozen->mask; frozen->slots[i].cv ; i = (i + 1) & frozen->mask) {
+        struct config_frozen_slot *slot = &frozen->slots[i];
+        if(slot->hash == hash && !strcmp(slot->name, name) && !strcmp(slot->section, section))
+            return slot->cv;
+    }
+
+    return NULL;
+}
+
+void appconfig_freeze(struct config *root) {
+    struct section *co;
+    struct config_option *cv;
+    size_t entries = 0, size = 16;
+
+    appconfig_wrlock(root);
+
+    if(root->frozen) {
+        appconfig_unlock(root);
+        error("CONFIG: the config is already frozen.");
+        return;
+    }
+
+    for(co = root->sections; co ; co = co->next) {
+        config_section_wrlock(co);
+        for(cv = co->values; cv ; cv = cv->next) entries++;
+        config_section_unlock(co);
+    }
+
+    // keep the table at most half full
+    while(size < entries * 2) size <<= 1;
+
+    struct config_frozen *frozen = callocz(1, sizeof(struct config_frozen));
+    frozen->mask = size - 1;
+    frozen->slots = callocz(size, sizeof(struct config_frozen_slot));
+
+    for(co = root->sections; co ; co = co->next) {
+        config_section_wrlock(co);
+        for(cv = co->values; cv && frozen->entries < entries ; cv = cv->next) {
+            uint32_t hash = appconfig_frozen_hash(co->hash, cv->hash);
+            size_t i = hash & frozen->mask;
+            while(frozen->slots[i].cv) i = (i + 1) & frozen->mask;
+
+            frozen->slots[i].hash = hash;
+            frozen->slots[i].section = co->name;
+            frozen->slots[i].name = string_pool_get(cv->name);
+            frozen->slots[i].cv = cv;
+            frozen->entries++;
+        }
+        config_section_unlock(co);
+    }
+
+    __atomic_store_n(&root->frozen, frozen, __ATOMIC_RELEASE);
+
+    appconfig_unlock(root);
+
+    info("CONFIG: frozen %zu options in a read-only index of %zu slots.", frozen->entries, size);
+}
+
+
 // ----------------------------------------------------------------------------
 // config section methods
 
@@ -145,7 +231,7 @@ static inline struct config_option *appconfig_value_create(struct section *co, c
     debug(D_CONFIG, "Creating config entry for name '%s', value '%s', in section '%s'.", name, value, co->name);
 
     struct config_option *cv = callocz(1, sizeof(struct config_option));
-    cv->name = strdupz(name);
+    cv->name = string_pool_get(name);
     cv->hash = simple_hash(cv->name);
     cv->value = strdupz(value);
 
@@ -153,7 +239,7 @@ static inline struct config_option *appconfig_value_create(struct section *co, c
     if(found != cv) {
         error("indexing of config '%s' in section '%s': already exists - using the existing one.", cv->name, co->name);
         freez(cv->value);
-        freez(cv->name);
+        string_pool_release(cv->name);
         freez(cv);
         return found;
     }
@@ -190,6 +276,11 @@ int appconfig_move(struct config *root, const char *section_old, const char *nam
 
     debug(D_CONFIG, "request to rename config in section '%s', old name '%s', to section '%s', new name '%s'", section_old, name_old, section_new, name_new);
 
+    if(unlikely(__atomic_load_n(&root->frozen, __ATOMIC_ACQUIRE))) {
+        error("CONFIG: cannot move '%s' of section '%s' to '%s' of section '%s', the config is frozen.", name_old, section_old, name_new, section_new);
+        return ret;
+    }
+
     struct section *co_old = appconfig_section_find(root, section_old);
     if(!co_old) return ret;
 
@@ -221,8 +312,8 @@ int appconfig_move(struct config *root, const char *section_old, const char *nam
             t->next = cv_old->next;
     }
 
-    freez(cv_old->name);
-    cv_old->name = strdupz(name_new);
+    string_pool_release(cv_old->name);
+    cv_old->name = string_pool_get(name_new);
     cv_old->hash = simple_hash(cv_old->name);
 
     cv_new = cv_old;
@@ -241,12 +332,37 @@ cleanup:
     return ret;
 }
 
-char *appconfig_get(struct config *root, const char *section, const char *name, const char *default_value)
+static inline struct config_option *appconfig_option_used(struct config_option *cv, const char *default_value) {
+    // the flags are written only once, so that the readers of the frozen index do not keep writing to shared memory
+    if(unlikely(!(cv->flags & CONFIG_VALUE_USED)))
+        cv->flags |= CONFIG_VALUE_USED;
+
+    if((cv->flags & CONFIG_VALUE_LOADED) || (cv->flags & CONFIG_VALUE_CHANGED)) {
+        // this is a loaded value from the config file
+        // if it is different that the default, mark it
+        if(!(cv->flags & CONFIG_VALUE_CHECKED)) {
+            if(strcmp(cv->value, default_value) != 0) cv->flags |= CONFIG_VALUE_CHANGED;
+            cv->flags |= CONFIG_VALUE_CHECKED;
+        }
+    }
+
+    return cv;
+}
+
+static struct config_option *appconfig_get_option(struct config *root, const char *section, const char *name, const char *default_value)
 {
     struct config_option *cv;
 
     debug(D_CONFIG, "request to get config in section '%s', name '%s', default_value '%s'", section, name, default_value);
 
+    struct config_frozen *frozen = __atomic_load_n(&root->frozen, __ATOMIC_ACQUIRE);
+    if(likely(frozen)) {
+        cv = appconfig_frozen_find(frozen, section, name);
+        if(likely(cv)) return appconfig_option_used(cv, default_value);
+
+        // options created after appconfig_freeze() are found in the indexes of their sections
+    }
+
     struct section *co = appconfig_section_find(root, section);
     if(!co) co = appconfig_section_create(root, section);
 
@@ -255,18 +371,20 @@ char *appconfig_get(struct config *root, const char *section, const char *name,
         cv = appconfig_value_create(co, name, default_value);
         if(!cv) return NULL;
     }
-    cv->flags |= CONFIG_VALUE_USED;
 
-    if((cv->flags & CONFIG_VALUE_LOADED) || (cv->flags & CONFIG_VALUE_CHANGED)) {
-        // this is a loaded value from the config file
-        // if it is different that the default, mark it
-        if(!(cv->flags & CONFIG_VALUE_CHECKED)) {
-            if(strcmp(cv->value, default_value) != 0) cv->flags |= CONFIG_VALUE_CHANGED;
-            cv->flags |= CONFIG_VALUE_CHECKED;
-        }
-    }
+    return appconfig_option_used(cv, default_value);
+}
+
+char *appconfig_get(struct config *root, const char *section, const char *name, const char *default_value)
+{
+    struct config_option *cv = appconfig_get_option(root, section, name, default_value);
+    return (cv)?cv->value:NULL;
+}
 
-    return(cv->value);
+char **appconfig_get_handle(struct config *root, const char *section, const char *name, const char *default_value)
+{
+    struct config_option *cv = appconfig_get_option(root, section, name, default_value);
+    return (cv)?&cv->value:NULL;
 }
 
 long long appconfig_get_number(struct config *root, const char *section, const char *name, long long value)
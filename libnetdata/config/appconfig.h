@@ -101,6 +101,7 @@ struct config {
     struct section *sections;
     netdata_mutex_t mutex;
     avl_tree_lock index;
+    struct config_frozen *frozen;   // the read-only index of appconfig_freeze(), NULL until then
 };
 
 #define CONFIG_BOOLEAN_INVALID 100  // an invalid value to check for validity (used as default initialization when needed)
@@ -121,6 +122,16 @@ extern int appconfig_get_boolean(struct config *root, const char *section, const
 extern int appconfig_get_boolean_ondemand(struct config *root, const char *section, const char *name, int value);
 extern int appconfig_get_duration(struct config *root, const char *section, const char *name, const char *value);
 
+// returns a handle to the value of the option, valid for the lifetime of the config
+// resolve it once and read the current value with *handle
+extern char **appconfig_get_handle(struct config *root, const char *section, const char *name, const char *default_value);
+
+// index all the options of the config in a read-only hash table, searched
+// without locks by appconfig_get() and friends - call it once, after startup
+// options created later are still found, through the locked indexes
+// appconfig_move() is not allowed on a frozen config
+extern void appconfig_freeze(struct config *root);
+
 extern const char *appconfig_set(struct config *root, const char *section, const char *name, const char *value);
 extern const char *appconfig_set_default(struct config *root, const char *section, const char *name, const char *value);
 extern long long appconfig_set_number(struct config *root, const char *section, const char *name, long long value);
@@ -52,6 +52,32 @@ static inline void dictionary_unlock(DICTIONARY *dict) {
 }
 
 
+// ----------------------------------------------------------------------------
+// hash index
+//
+// With DICTIONARY_FLAG_HASH_INDEX the entries are indexed by a HASH_INDEX
+// instead of the avl tree. The readers of the hash index do not lock, so
+// dictionary_get() does not take the dictionary lock; the writers still
+// take it, so that finding and creating an entry is atomic.
+
+// simple_hash() is FNV-1a, its low bits - the ones that select the slot of
+// the hash table - are mixed with the finalizer of murmur3
+static inline uint32_t dictionary_hash(const char *name) {
+    uint32_t h = simple_hash(name);
+
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static int name_value_equal(void *item, const void *key) {
+    return !strcmp(((NAME_VALUE *)item)->name, (const char *)key);
+}
+
 // ----------------------------------------------------------------------------
 // avl index
 
@@ -61,12 +87,20 @@ static int name_value_compare(void* a, void* b) {
     else return strcmp(((NAME_VALUE *)a)->name, ((NAME_VALUE *)b)->name);
 }
 
+static inline uint32_t dictionary_name_hash(DICTIONARY *dict, const char *name) {
+    return (dict->hash_index) ? dictionary_hash(name) : simple_hash(name);
+}
+
 static inline NAME_VALUE *dictionary_name_value_index_find_nolock(DICTIONARY *dict, const char *name, uint32_t hash) {
+    NETDATA_DICTIONARY_STATS_SEARCHES_PLUS1(dict);
+
+    if(dict->hash_index)
+        return (NAME_VALUE *)hash_index_get(dict->hash_index, (hash)?hash:dictionary_hash(name), name);
+
     NAME_VALUE tmp;
     tmp.hash = (hash)?hash:simple_hash(name);
     tmp.name = (char *)name;
 
-    NETDATA_DICTIONARY_STATS_SEARCHES_PLUS1(dict);
     return (NAME_VALUE *)avl_search(&(dict->values_index), (avl *) &tmp);
 }
 
@@ -84,7 +118,7 @@ static NAME_VALUE *dictionary_name_value_create_nolock(DICTIONARY *dict, const c
         nv->name = strdupz(name);
     }
 
-    nv->hash = (hash)?hash:simple_hash(nv->name);
+    nv->hash = (hash)?hash:dictionary_name_hash(dict, nv->name);
 
     if(dict->flags & DICTIONARY_FLAG_VALUE_LINK_DONT_CLONE)
         nv->value = value;
@@ -95,7 +129,11 @@ static NAME_VALUE *dictionary_name_value_create_nolock(DICTIONARY *dict, const c
 
     // index it
     NETDATA_DICTIONARY_STATS_INSERTS_PLUS1(dict);
-    if(unlikely(avl_insert(&((dict)->values_index), (avl *)(nv)) != (avl *)nv))
+    if(dict->hash_index) {
+        if(unlikely(hash_index_set(dict->hash_index, nv->hash, nv->name, nv) != nv))
+            error("dictionary: INTERNAL ERROR: duplicate insertion to dictionary.");
+    }
+    else if(unlikely(avl_insert(&((dict)->values_index), (avl *)(nv)) != (avl *)nv))
         error("dictionary: INTERNAL ERROR: duplicate insertion to dictionary.");
 
     NETDATA_DICTIONARY_STATS_ENTRIES_PLUS1(dict);
@@ -107,7 +145,12 @@ static void dictionary_name_value_destroy_nolock(DICTIONARY *dict, NAME_VALUE *n
     debug(D_DICTIONARY, "Destroying name value entry for name '%s'.", nv->name);
 
     NETDATA_DICTIONARY_STATS_DELETES_PLUS1(dict);
-    if(unlikely(avl_remove(&(dict->values_index), (avl *)(nv)) != (avl *)nv))
+    if(dict->hash_index) {
+        // it returns after the readers that may have found nv are done with it
+        if(unlikely(hash_index_del(dict->hash_index, nv->hash, nv->name) != nv))
+            error("dictionary: INTERNAL ERROR: dictionary invalid removal of node.");
+    }
+    else if(unlikely(avl_remove(&(dict->values_index), (avl *)(nv)) != (avl *)nv))
         error("dictionary: INTERNAL ERROR: dictionary invalid removal of node.");
 
     NETDATA_DICTIONARY_STATS_ENTRIES_MINUS1(dict);
@@ -125,6 +168,40 @@ static void dictionary_name_value_destroy_nolock(DICTIONARY *dict, NAME_VALUE *n
     freez(nv);
 }
 
+// ----------------------------------------------------------------------------
+// hash index traversal
+
+struct dictionary_collect {
+    NAME_VALUE **entries;
+    size_t used;
+    size_t size;
+};
+
+static int dictionary_collect_callback(void *item, void *data) {
+    struct dictionary_collect *c = data;
+
+    if(c->used < c->size)
+        c->entries[c->used++] = item;
+
+    return 0;
+}
+
+struct dictionary_walk {
+    int (*callback)(void *entry, void *data);
+    int (*callback_name_value)(char *name, void *entry, void *data);
+    void *data;
+};
+
+static int dictionary_walk_callback(void *item, void *data) {
+    struct dictionary_walk *w = data;
+    NAME_VALUE *nv = item;
+
+    if(w->callback_name_value)
+        return w->callback_name_value(nv->name, nv->value, w->data);
+
+    return w->callback(nv->value, w->data);
+}
+
 // ----------------------------------------------------------------------------
 // API - basic methods
 
@@ -142,6 +219,12 @@ DICTIONARY *dictionary_create(uint8_t flags) {
     }
 
     avl_init(&dict->values_index, name_value_compare);
+
+    if(flags & DICTIONARY_FLAG_HASH_INDEX) {
+        dict->hash_index = callocz(1, sizeof(HASH_INDEX));
+        hash_index_init(dict->hash_index, name_value_equal);
+    }
+
     dict->flags = flags;
 
     return dict;
@@ -152,11 +235,29 @@ void dictionary_destroy(DICTIONARY *dict) {
 
     dictionary_write_lock(dict);
 
-    while(dict->values_index.root)
-        dictionary_name_value_destroy_nolock(dict, (NAME_VALUE *)dict->values_index.root);
+    if(dict->hash_index) {
+        // the entries cannot be deleted while the hash index is traversed
+        size_t entries = dict->hash_index->entries, i;
+        struct dictionary_collect c = { .entries = mallocz((entries + 1) * sizeof(NAME_VALUE *)), .used = 0, .size = entries };
+
+        hash_index_traverse(dict->hash_index, dictionary_collect_callback, &c);
+        for(i = 0; i < c.used ; i++)
+            dictionary_name_value_destroy_nolock(dict, c.entries[i]);
+
+        freez(c.entries);
+    }
+    else {
+        while(dict->values_index.root)
+            dictionary_name_value_destroy_nolock(dict, (NAME_VALUE *)dict->values_index.root);
+    }
 
     dictionary_unlock(dict);
 
+    if(dict->hash_index) {
+        hash_index_destroy(dict->hash_index);
+        freez(dict->hash_index);
+    }
+
     if(dict->stats)
         freez(dict->stats);
 
@@ -173,7 +274,7 @@ void dictionary_destroy(DICTIONARY *dict) {
 void *dictionary_set(DICTIONARY *dict, const char *name, void *value, size_t value_len) {
     debug(D_DICTIONARY, "SET dictionary entry with name '%s'.", name);
 
-    uint32_t hash = simple_hash(name);
+    uint32_t hash = dictionary_name_hash(dict, name);
 
     dictionary_write_lock(dict);
 
@@ -216,9 +317,14 @@ void *dictionary_set(DICTIONARY *dict, const char *name, void *value, size_t val
 void *dictionary_get(DICTIONARY *dict, const char *name) {
     debug(D_DICTIONARY, "GET dictionary entry with name '%s'.", name);
 
-    dictionary_read_lock(dict);
-    NAME_VALUE *nv = dictionary_name_value_index_find_nolock(dict, name, 0);
-    dictionary_unlock(dict);
+    NAME_VALUE *nv;
+    if(dict->hash_index)
+        nv = dictionary_name_value_index_find_nolock(dict, name, 0);
+    else {
+        dictionary_read_lock(dict);
+        nv = dictionary_name_value_index_find_nolock(dict, name, 0);
+        dictionary_unlock(dict);
+    }
 
     if(unlikely(!nv)) {
         debug(D_DICTIONARY, "Not found dictionary entry with name '%s'.", name);
@@ -285,7 +391,11 @@ int dictionary_get_all(DICTIONARY *dict, int (*callback)(void *entry, void *data
 
     dictionary_read_lock(dict);
 
-    if(likely(dict->values_index.root))
+    if(dict->hash_index) {
+        struct dictionary_walk w = { .callback = callback, .callback_name_value = NULL, .data = data };
+        ret = hash_index_traverse(dict->hash_index, dictionary_walk_callback, &w);
+    }
+    else if(likely(dict->values_index.root))
         ret = dictionary_walker(dict->values_index.root, callback, data);
 
     dictionary_unlock(dict);
@@ -320,7 +430,11 @@ int dictionary_get_all_name_value(DICTIONARY *dict, int (*callback)(char *name,
 
     dictionary_read_lock(dict);
 
-    if(likely(dict->values_index.root))
+    if(dict->hash_index) {
+        struct dictionary_walk w = { .callback = NULL, .callback_name_value = callback, .data = data };
+        ret = hash_index_traverse(dict->hash_index, dictionary_walk_callback, &w);
+    }
+    else if(likely(dict->values_index.root))
         ret = dictionary_walker_name_value(dict->values_index.root, callback, data);
 
     dictionary_unlock(dict);
@@ -24,6 +24,7 @@ typedef struct name_value {
 
 typedef struct dictionary {
     avl_tree values_index;
+    HASH_INDEX *hash_index;             // replaces values_index, with DICTIONARY_FLAG_HASH_INDEX
 
     uint8_t flags;
 
@@ -36,6 +37,7 @@ typedef struct dictionary {
 #define DICTIONARY_FLAG_VALUE_LINK_DONT_CLONE   0x00000002
 #define DICTIONARY_FLAG_NAME_LINK_DONT_CLONE    0x00000004
 #define DICTIONARY_FLAG_WITH_STATISTICS         0x00000008
+#define DICTIONARY_FLAG_HASH_INDEX              0x00000010  // index with a hash table, dictionary_get() does not lock
 
 extern DICTIONARY *dictionary_create(uint8_t flags);
 extern void dictionary_destroy(DICTIONARY *dict);
@@ -54,304 +54,44 @@ typedef struct eval_node {
 static inline void eval_node_free(EVAL_NODE *op);
 static inline EVAL_NODE *parse_full_expression(const char **string, int *error);
 static inline EVAL_NODE *parse_one_full_operand(const char **string, int *error);
-static inline calculated_number eval_node(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error);
 static inline void print_parsed_as_node(BUFFER *out, EVAL_NODE *op, int *error);
 static inline void print_parsed_as_constant(BUFFER *out, calculated_number n);
 
-// ----------------------------------------------------------------------------
-// evaluation of expressions
-
-static inline calculated_number eval_variable(EVAL_EXPRESSION *exp, EVAL_VARIABLE *v, int *error) {
-    static uint32_t this_hash = 0, now_hash = 0, after_hash = 0, before_hash = 0, status_hash = 0, removed_hash = 0, uninitialized_hash = 0, undefined_hash = 0, clear_hash = 0, warning_hash = 0, critical_hash = 0;
-    calculated_number n;
-
-    if(unlikely(this_hash == 0)) {
-        this_hash = simple_hash("this");
-        now_hash = simple_hash("now");
-        after_hash = simple_hash("after");
-        before_hash = simple_hash("before");
-        status_hash = simple_hash("status");
-        removed_hash = simple_hash("REMOVED");
-        uninitialized_hash = simple_hash("UNINITIALIZED");
-        undefined_hash = simple_hash("UNDEFINED");
-        clear_hash = simple_hash("CLEAR");
-        warning_hash = simple_hash("WARNING");
-        critical_hash = simple_hash("CRITICAL");
-    }
-
-    if(unlikely(v->hash == this_hash && !strcmp(v->name, "this"))) {
-        n = (exp->this)?*exp->this:NAN;
-        buffer_strcat(exp->error_msg, "[ $this = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == after_hash && !strcmp(v->name, "after"))) {
-        n = (exp->after && *exp->after)?*exp->after:NAN;
-        buffer_strcat(exp->error_msg, "[ $after = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == before_hash && !strcmp(v->name, "before"))) {
-        n = (exp->before && *exp->before)?*exp->before:NAN;
-        buffer_strcat(exp->error_msg, "[ $before = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == now_hash && !strcmp(v->name, "now"))) {
-        n = now_realtime_sec();
-        buffer_strcat(exp->error_msg, "[ $now = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == status_hash && !strcmp(v->name, "status"))) {
-        n = (exp->status)?*exp->status:RRDCALC_STATUS_UNINITIALIZED;
-        buffer_strcat(exp->error_msg, "[ $status = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == removed_hash && !strcmp(v->name, "REMOVED"))) {
-        n = RRDCALC_STATUS_REMOVED;
-        buffer_strcat(exp->error_msg, "[ $REMOVED = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == uninitialized_hash && !strcmp(v->name, "UNINITIALIZED"))) {
-        n = RRDCALC_STATUS_UNINITIALIZED;
-        buffer_strcat(exp->error_msg, "[ $UNINITIALIZED = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == undefined_hash && !strcmp(v->name, "UNDEFINED"))) {
-        n = RRDCALC_STATUS_UNDEFINED;
-        buffer_strcat(exp->error_msg, "[ $UNDEFINED = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == clear_hash && !strcmp(v->name, "CLEAR"))) {
-        n = RRDCALC_STATUS_CLEAR;
-        buffer_strcat(exp->error_msg, "[ $CLEAR = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == warning_hash && !strcmp(v->name, "WARNING"))) {
-        n = RRDCALC_STATUS_WARNING;
-        buffer_strcat(exp->error_msg, "[ $WARNING = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(unlikely(v->hash == critical_hash && !strcmp(v->name, "CRITICAL"))) {
-        n = RRDCALC_STATUS_CRITICAL;
-        buffer_strcat(exp->error_msg, "[ $CRITICAL = ");
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    if(exp->rrdcalc && health_variable_lookup(v->name, v->hash, exp->rrdcalc, &n)) {
-        buffer_sprintf(exp->error_msg, "[ ${%s} = ", v->name);
-        print_parsed_as_constant(exp->error_msg, n);
-        buffer_strcat(exp->error_msg, " ] ");
-        return n;
-    }
-
-    *error = EVAL_ERROR_UNKNOWN_VARIABLE;
-    buffer_sprintf(exp->error_msg, "[ undefined variable '%s' ] ", v->name);
-    return 0;
-}
-
-static inline calculated_number eval_value(EVAL_EXPRESSION *exp, EVAL_VALUE *v, int *error) {
-    calculated_number n;
-
-    switch(v->type) {
-        case EVAL_VALUE_EXPRESSION:
-            n = eval_node(exp, v->expression, error);
-            break;
-
-        case EVAL_VALUE_NUMBER:
-            n = v->number;
-            break;
-
-        case EVAL_VALUE_VARIABLE:
-            n = eval_variable(exp, v->variable, error);
-            break;
-
-        default:
-            *error = EVAL_ERROR_INVALID_VALUE;
-            n = 0;
-            break;
-    }
-
-    return n;
-}
-
-static inline int is_true(calculated_number n) {
-    if(isnan(n)) return 0;
-    if(isinf(n)) return 1;
-    if(n == 0) return 0;
-    return 1;
-}
-
-calculated_number eval_and(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    return is_true(eval_value(exp, &op->ops[0], error)) && is_true(eval_value(exp, &op->ops[1], error));
-}
-calculated_number eval_or(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    return is_true(eval_value(exp, &op->ops[0], error)) || is_true(eval_value(exp, &op->ops[1], error));
-}
-calculated_number eval_greater_than_or_equal(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    return isgreaterequal(n1, n2);
-}
-calculated_number eval_less_than_or_equal(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    return islessequal(n1, n2);
-}
-calculated_number eval_equal(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    if(isnan(n1) && isnan(n2)) return 1;
-    if(isinf(n1) && isinf(n2)) return 1;
-    if(isnan(n1) || isnan(n2)) return 0;
-    if(isinf(n1) || isinf(n2)) return 0;
-    return calculated_number_equal(n1, n2);
-}
-calculated_number eval_not_equal(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    return !eval_equal(exp, op, error);
-}
-calculated_number eval_less(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    return isless(n1, n2);
-}
-calculated_number eval_greater(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    return isgreater(n1, n2);
-}
-calculated_number eval_plus(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    if(isnan(n1) || isnan(n2)) return NAN;
-    if(isinf(n1) || isinf(n2)) return INFINITY;
-    return n1 + n2;
-}
-calculated_number eval_minus(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    if(isnan(n1) || isnan(n2)) return NAN;
-    if(isinf(n1) || isinf(n2)) return INFINITY;
-    return n1 - n2;
-}
-calculated_number eval_multiply(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    if(isnan(n1) || isnan(n2)) return NAN;
-    if(isinf(n1) || isinf(n2)) return INFINITY;
-    return n1 * n2;
-}
-calculated_number eval_divide(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    calculated_number n2 = eval_value(exp, &op->ops[1], error);
-    if(isnan(n1) || isnan(n2)) return NAN;
-    if(isinf(n1) || isinf(n2)) return INFINITY;
-    return n1 / n2;
-}
-calculated_number eval_nop(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    return eval_value(exp, &op->ops[0], error);
-}
-calculated_number eval_not(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    return !is_true(eval_value(exp, &op->ops[0], error));
-}
-calculated_number eval_sign_plus(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    return eval_value(exp, &op->ops[0], error);
-}
-calculated_number eval_sign_minus(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    if(isnan(n1)) return NAN;
-    if(isinf(n1)) return INFINITY;
-    return -n1;
-}
-calculated_number eval_abs(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    calculated_number n1 = eval_value(exp, &op->ops[0], error);
-    if(isnan(n1)) return NAN;
-    if(isinf(n1)) return INFINITY;
-    return abs(n1);
-}
-calculated_number eval_if_then_else(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    if(is_true(eval_value(exp, &op->ops[0], error)))
-        return eval_value(exp, &op->ops[1], error);
-    else
-        return eval_value(exp, &op->ops[2], error);
-}
-
 static struct operator {
     const char *print_as;
     char precedence;
     char parameters;
     char isfunction;
-    calculated_number (*eval)(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error);
 } operators[256] = {
         // this is a random access array
         // we always access it with a known EVAL_OPERATOR_X
 
-        [EVAL_OPERATOR_AND]                   = { "&&", 2, 2, 0, eval_and },
-        [EVAL_OPERATOR_OR]                    = { "||", 2, 2, 0, eval_or },
-        [EVAL_OPERATOR_GREATER_THAN_OR_EQUAL] = { ">=", 3, 2, 0, eval_greater_than_or_equal },
-        [EVAL_OPERATOR_LESS_THAN_OR_EQUAL]    = { "<=", 3, 2, 0, eval_less_than_or_equal },
-        [EVAL_OPERATOR_NOT_EQUAL]             = { "!=", 3, 2, 0, eval_not_equal },
-        [EVAL_OPERATOR_EQUAL]                 = { "==", 3, 2, 0, eval_equal },
-        [EVAL_OPERATOR_LESS]                  = { "<",  3, 2, 0, eval_less },
-        [EVAL_OPERATOR_GREATER]               = { ">",  3, 2, 0, eval_greater },
-        [EVAL_OPERATOR_PLUS]                  = { "+",  4, 2, 0, eval_plus },
-        [EVAL_OPERATOR_MINUS]                 = { "-",  4, 2, 0, eval_minus },
-        [EVAL_OPERATOR_MULTIPLY]              = { "*",  5, 2, 0, eval_multiply },
-        [EVAL_OPERATOR_DIVIDE]                = { "/",  5, 2, 0, eval_divide },
-        [EVAL_OPERATOR_NOT]                   = { "!",  6, 1, 0, eval_not },
-        [EVAL_OPERATOR_SIGN_PLUS]             = { "+",  6, 1, 0, eval_sign_plus },
-        [EVAL_OPERATOR_SIGN_MINUS]            = { "-",  6, 1, 0, eval_sign_minus },
-        [EVAL_OPERATOR_ABS]                   = { "abs(",6,1, 1, eval_abs },
-        [EVAL_OPERATOR_IF_THEN_ELSE]          = { "?",  7, 3, 0, eval_if_then_else },
-        [EVAL_OPERATOR_NOP]                   = { NULL, 8, 1, 0, eval_nop },
-        [EVAL_OPERATOR_EXPRESSION_OPEN]       = { NULL, 8, 1, 0, eval_nop },
+        [EVAL_OPERATOR_AND]                   = { "&&", 2, 2, 0 },
+        [EVAL_OPERATOR_OR]                    = { "||", 2, 2, 0 },
+        [EVAL_OPERATOR_GREATER_THAN_OR_EQUAL] = { ">=", 3, 2, 0 },
+        [EVAL_OPERATOR_LESS_THAN_OR_EQUAL]    = { "<=", 3, 2, 0 },
+        [EVAL_OPERATOR_NOT_EQUAL]             = { "!=", 3, 2, 0 },
+        [EVAL_OPERATOR_EQUAL]                 = { "==", 3, 2, 0 },
+        [EVAL_OPERATOR_LESS]                  = { "<",  3, 2, 0 },
+        [EVAL_OPERATOR_GREATER]               = { ">",  3, 2, 0 },
+        [EVAL_OPERATOR_PLUS]                  = { "+",  4, 2, 0 },
+        [EVAL_OPERATOR_MINUS]                 = { "-",  4, 2, 0 },
+        [EVAL_OPERATOR_MULTIPLY]              = { "*",  5, 2, 0 },
+        [EVAL_OPERATOR_DIVIDE]                = { "/",  5, 2, 0 },
+        [EVAL_OPERATOR_NOT]                   = { "!",  6, 1, 0 },
+        [EVAL_OPERATOR_SIGN_PLUS]             = { "+",  6, 1, 0 },
+        [EVAL_OPERATOR_SIGN_MINUS]            = { "-",  6, 1, 0 },
+        [EVAL_OPERATOR_ABS]                   = { "abs(",6,1, 1 },
+        [EVAL_OPERATOR_IF_THEN_ELSE]          = { "?",  7, 3, 0 },
+        [EVAL_OPERATOR_NOP]                   = { NULL, 8, 1, 0 },
+        [EVAL_OPERATOR_EXPRESSION_OPEN]       = { NULL, 8, 1, 0 },
 
         // this should exist in our evaluation list
-        [EVAL_OPERATOR_EXPRESSION_CLOSE]      = { NULL, 99, 1, 0, eval_nop }
+        [EVAL_OPERATOR_EXPRESSION_CLOSE]      = { NULL, 99, 1, 0 }
 };
 
 #define eval_precedence(operator) (operators[(unsigned char)(operator)].precedence)
 
-static inline calculated_number eval_node(EVAL_EXPRESSION *exp, EVAL_NODE *op, int *error) {
-    if(unlikely(op->count != operators[op->operator].parameters)) {
-        *error = EVAL_ERROR_INVALID_NUMBER_OF_OPERANDS;
-        return 0;
-    }
-
-    calculated_number n = operators[op->operator].eval(exp, op, error);
-
-    return n;
-}
-
 // ----------------------------------------------------------------------------
 // parsed-as generation
 
@@ -1056,14 +796,529 @@ static inline EVAL_NODE *parse_full_expression(const char **string, int *error)
     return parse_rest_of_expression(string, error, op1);
 }
 
+// ----------------------------------------------------------------------------
+// compiling expressions
+//
+// the parsed tree is compiled to a flat program for a stack machine,
+// so that the evaluation is a single loop over the instructions.
+// built-in variables are resolved at compile time and the rest of the
+// variables are numbered, so that the caller can bind them once
+// (see EVAL_EXPRESSION.variables).
+//
+// the program is read-only once compiled, so it is shared by all the
+// copies of an expression (see expression_copy()) - e.g. all the alarms
+// instantiated from the same template run the same instructions.
+
+// the operators that pop their operands and push their result
+// use their EVAL_OPERATOR_X as opcode - these are the rest of them
+#define EVAL_OPCODE_CONSTANT                'c' // push a number
+#define EVAL_OPCODE_BUILTIN                 'k' // push a built-in constant, like $CLEAR
+#define EVAL_OPCODE_THIS                    't' // push $this
+#define EVAL_OPCODE_AFTER                   'a' // push $after
+#define EVAL_OPCODE_BEFORE                  'b' // push $before
+#define EVAL_OPCODE_NOW                     'n' // push $now
+#define EVAL_OPCODE_STATUS                  's' // push $status
+#define EVAL_OPCODE_VARIABLE                'v' // push the value of a variable
+#define EVAL_OPCODE_AND_THEN                'x' // pop, if false push 0 and jump
+#define EVAL_OPCODE_OR_ELSE                 'y' // pop, if true push 1 and jump
+#define EVAL_OPCODE_BOOLEAN                 'z' // convert the top of the stack to 0 or 1
+#define EVAL_OPCODE_JUMP_IF_FALSE           'f' // pop, if false jump
+#define EVAL_OPCODE_JUMP                    'j' // jump
+
+typedef struct eval_instruction {
+    unsigned char opcode;
+    size_t jump;                // the instruction to jump to
+    calculated_number number;   // the value of constants
+    const char *name;           // the name of variables, for the error message
+    size_t variable;            // the index of the variable to push
+} EVAL_INSTRUCTION;
+
+typedef struct eval_trace {
+    EVAL_INSTRUCTION *instruction;
+    calculated_number value;
+    int undefined;
+} EVAL_TRACE;
+
+typedef struct eval_program {
+    const char *source;
+    const char *parsed_as;
+
+    EVAL_INSTRUCTION *instructions;
+    size_t used;
+    size_t size;
+
+    ssize_t depth;              // the depth of the stack, while compiling
+    ssize_t max_depth;
+
+    size_t loads;               // the number of instructions pushing variables
+
+    EVAL_VARIABLE *variables;   // the names of the variables
+    size_t variables_count;
+
+    int refcount;               // the number of expressions using it
+} EVAL_PROGRAM;
+
+// the state of each expression
+typedef struct eval_state {
+    calculated_number *stack;
+
+    // the values of the variables, as read by the last evaluation
+    // they are converted to text only when they are needed
+    EVAL_TRACE *trace;
+    size_t traced;
+    int trace_formatted;
+} EVAL_STATE;
+
+static struct eval_builtin {
+    const char *name;
+    unsigned char opcode;
+    calculated_number value;
+} eval_builtins[] = {
+        { "this",          EVAL_OPCODE_THIS,    0 },
+        { "after",         EVAL_OPCODE_AFTER,   0 },
+        { "before",        EVAL_OPCODE_BEFORE,  0 },
+        { "now",           EVAL_OPCODE_NOW,     0 },
+        { "status",        EVAL_OPCODE_STATUS,  0 },
+        { "REMOVED",       EVAL_OPCODE_BUILTIN, RRDCALC_STATUS_REMOVED },
+        { "UNINITIALIZED", EVAL_OPCODE_BUILTIN, RRDCALC_STATUS_UNINITIALIZED },
+        { "UNDEFINED",     EVAL_OPCODE_BUILTIN, RRDCALC_STATUS_UNDEFINED },
+        { "CLEAR",         EVAL_OPCODE_BUILTIN, RRDCALC_STATUS_CLEAR },
+        { "WARNING",       EVAL_OPCODE_BUILTIN, RRDCALC_STATUS_WARNING },
+        { "CRITICAL",      EVAL_OPCODE_BUILTIN, RRDCALC_STATUS_CRITICAL },
+
+        // termination
+        { NULL,            0,                   0 }
+};
+
+static inline size_t eval_program_emit(EVAL_PROGRAM *p, unsigned char opcode, ssize_t stack_change) {
+    if(unlikely(p->used == p->size)) {
+        p->size = (p->size)?p->size * 2:16;
+        p->instructions = reallocz(p->instructions, p->size * sizeof(EVAL_INSTRUCTION));
+    }
+
+    EVAL_INSTRUCTION *ins = &p->instructions[p->used];
+    memset(ins, 0, sizeof(EVAL_INSTRUCTION));
+    ins->opcode = opcode;
+
+    p->depth += stack_change;
+    if(p->depth > p->max_depth)
+        p->max_depth = p->depth;
+
+    return p->used++;
+}
+
+static inline size_t eval_program_variable(EVAL_PROGRAM *p, EVAL_VARIABLE *v) {
+    size_t i;
+    for(i = 0; i < p->variables_count ; i++)
+        if(p->variables[i].hash == v->hash && !strcmp(p->variables[i].name, v->name))
+            return i;
+
+    p->variables = reallocz(p->variables, (p->variables_count + 1) * sizeof(EVAL_VARIABLE));
+    memset(&p->variables[i], 0, sizeof(EVAL_VARIABLE));
+    p->variables[i].name = strdupz(v->name);
+    p->variables[i].hash = v->hash;
+    return p->variables_count++;
+}
+
+static inline void eval_compile_variable(EVAL_PROGRAM *p, EVAL_VARIABLE *v) {
+    size_t i;
+    int b;
+
+    for(b = 0; eval_builtins[b].name ; b++) {
+        if(!strcmp(v->name, eval_builtins[b].name)) {
+            i = eval_program_emit(p, eval_builtins[b].opcode, 1);
+            p->instructions[i].number = eval_builtins[b].value;
+            p->instructions[i].name = eval_builtins[b].name;
+            p->loads++;
+            return;
+        }
+    }
+
+    size_t variable = eval_program_variable(p, v);
+    i = eval_program_emit(p, EVAL_OPCODE_VARIABLE, 1);
+    p->instructions[i].variable = variable;
+    p->loads++;
+}
+
+static inline void eval_compile_node(EVAL_PROGRAM *p, EVAL_NODE *op, int *error);
+
+static inline void eval_compile_value(EVAL_PROGRAM *p, EVAL_VALUE *v, int *error) {
+    switch(v->type) {
+        case EVAL_VALUE_EXPRESSION:
+            eval_compile_node(p, v->expression, error);
+            break;
+
+        case EVAL_VALUE_NUMBER: {
+            // emitting may move the instructions, so index them afterwards
+            size_t i = eval_program_emit(p, EVAL_OPCODE_CONSTANT, 1);
+            p->instructions[i].number = v->number;
+            break;
+        }
+
+        case EVAL_VALUE_VARIABLE:
+            eval_compile_variable(p, v->variable);
+            break;
+
+        default:
+            *error = EVAL_ERROR_INVALID_VALUE;
+            break;
+    }
+}
+
+static inline void eval_compile_node(EVAL_PROGRAM *p, EVAL_NODE *op, int *error) {
+    size_t jump1, jump2;
+
+    if(unlikely(op->count != operators[op->operator].parameters)) {
+        *error = EVAL_ERROR_INVALID_NUMBER_OF_OPERANDS;
+        return;
+    }
+
+    switch(op->operator) {
+        case EVAL_OPERATOR_NOP:
+        case EVAL_OPERATOR_EXPRESSION_OPEN:
+        case EVAL_OPERATOR_EXPRESSION_CLOSE:
+        case EVAL_OPERATOR_SIGN_PLUS:
+            eval_compile_value(p, &op->ops[0], error);
+            break;
+
+        case EVAL_OPERATOR_NOT:
+        case EVAL_OPERATOR_SIGN_MINUS:
+        case EVAL_OPERATOR_ABS:
+            eval_compile_value(p, &op->ops[0], error);
+            eval_program_emit(p, op->operator, 0);
+            break;
+
+        case EVAL_OPERATOR_AND:
+        case EVAL_OPERATOR_OR:
+            // the second operand is not evaluated when the first decides the result
+            eval_compile_value(p, &op->ops[0], error);
+            jump1 = eval_program_emit(p, (op->operator == EVAL_OPERATOR_AND)?EVAL_OPCODE_AND_THEN:EVAL_OPCODE_OR_ELSE, -1);
+            eval_compile_value(p, &op->ops[1], error);
+            eval_program_emit(p, EVAL_OPCODE_BOOLEAN, 0);
+            p->instructions[jump1].jump = p->used;
+            break;
+
+        case EVAL_OPERATOR_IF_THEN_ELSE:
+            eval_compile_value(p, &op->ops[0], error);
+            jump1 = eval_program_emit(p, EVAL_OPCODE_JUMP_IF_FALSE, -1);
+            eval_compile_value(p, &op->ops[1], error);
+            // only one of the branches will push its value
+            jump2 = eval_program_emit(p, EVAL_OPCODE_JUMP, -1);
+            p->instructions[jump1].jump = p->used;
+            eval_compile_value(p, &op->ops[2], error);
+            p->instructions[jump2].jump = p->used;
+            break;
+
+        case EVAL_OPERATOR_GREATER_THAN_OR_EQUAL:
+        case EVAL_OPERATOR_LESS_THAN_OR_EQUAL:
+        case EVAL_OPERATOR_NOT_EQUAL:
+        case EVAL_OPERATOR_EQUAL:
+        case EVAL_OPERATOR_LESS:
+        case EVAL_OPERATOR_GREATER:
+        case EVAL_OPERATOR_PLUS:
+        case EVAL_OPERATOR_MINUS:
+        case EVAL_OPERATOR_MULTIPLY:
+        case EVAL_OPERATOR_DIVIDE:
+            eval_compile_value(p, &op->ops[0], error);
+            eval_compile_value(p, &op->ops[1], error);
+            eval_program_emit(p, op->operator, -1);
+            break;
+
+        default:
+            *error = EVAL_ERROR_INVALID_VALUE;
+            break;
+    }
+}
+
+static inline void eval_program_free(EVAL_PROGRAM *p) {
+    if(!p) return;
+
+    size_t i;
+    for(i = 0; i < p->variables_count ; i++)
+        freez(p->variables[i].name);
+
+    freez(p->variables);
+    freez(p->instructions);
+    freez((void *)p->source);
+    freez((void *)p->parsed_as);
+    freez(p);
+}
+
+static inline EVAL_PROGRAM *eval_compile(EVAL_NODE *op, int *error) {
+    EVAL_PROGRAM *p = callocz(1, sizeof(EVAL_PROGRAM));
+
+    eval_compile_node(p, op, error);
+
+    if(*error != EVAL_ERROR_OK || p->depth != 1) {
+        if(*error == EVAL_ERROR_OK)
+            *error = EVAL_ERROR_INVALID_NUMBER_OF_OPERANDS;
+
+        eval_program_free(p);
+        return NULL;
+    }
+
+    // the names are final now
+    for(size_t i = 0; i < p->used ; i++)
+        if(p->instructions[i].opcode == EVAL_OPCODE_VARIABLE)
+            p->instructions[i].name = p->variables[p->instructions[i].variable].name;
+
+    return p;
+}
+
+// create an expression running the given program
+static inline EVAL_EXPRESSION *eval_expression_create(EVAL_PROGRAM *p) {
+    EVAL_EXPRESSION *exp = callocz(1, sizeof(EVAL_EXPRESSION));
+
+    __atomic_add_fetch(&p->refcount, 1, __ATOMIC_RELAXED);
+    exp->program = (void *)p;
+    exp->source = p->source;
+    exp->parsed_as = p->parsed_as;
+
+    if(p->variables_count) {
+        // an array, linked for the callers
+        exp->variables = callocz(p->variables_count, sizeof(EVAL_VARIABLE));
+
+        size_t i;
+        for(i = 0; i < p->variables_count ; i++) {
+            exp->variables[i].name = p->variables[i].name;
+            exp->variables[i].hash = p->variables[i].hash;
+            exp->variables[i].next = (i + 1 < p->variables_count)?&exp->variables[i + 1]:NULL;
+        }
+    }
+
+    EVAL_STATE *state = callocz(1, sizeof(EVAL_STATE));
+    state->stack = mallocz(p->max_depth * sizeof(calculated_number));
+    if(p->loads)
+        state->trace = mallocz(p->loads * sizeof(EVAL_TRACE));
+    exp->state = (void *)state;
+
+    exp->error_msg = buffer_create(100);
+
+    return exp;
+}
+
+// ----------------------------------------------------------------------------
+// evaluation of compiled expressions
+
+static inline int is_true(calculated_number n) {
+    if(isnan(n)) return 0;
+    if(isinf(n)) return 1;
+    if(n == 0) return 0;
+    return 1;
+}
+
+static inline calculated_number eval_equal(calculated_number n1, calculated_number n2) {
+    if(isnan(n1) && isnan(n2)) return 1;
+    if(isinf(n1) && isinf(n2)) return 1;
+    if(isnan(n1) || isnan(n2)) return 0;
+    if(isinf(n1) || isinf(n2)) return 0;
+    return calculated_number_equal(n1, n2);
+}
+
+static inline void eval_trace(EVAL_STATE *state, EVAL_INSTRUCTION *ins, calculated_number n, int undefined) {
+    // every instruction runs at most once, so this cannot overflow
+    EVAL_TRACE *t = &state->trace[state->traced++];
+    t->instruction = ins;
+    t->value = n;
+    t->undefined = undefined;
+}
+
+static inline calculated_number eval_variable(EVAL_EXPRESSION *exp, EVAL_VARIABLE *v, int *error, int *undefined) {
+    calculated_number n;
+
+    if(likely(exp->bound_value)) {
+        if(likely(v->bound))
+            return exp->bound_value(v->bound);
+    }
+    else if(exp->rrdcalc && health_variable_lookup(v->name, v->hash, exp->rrdcalc, &n))
+        return n;
+
+    *error = EVAL_ERROR_UNKNOWN_VARIABLE;
+    *undefined = 1;
+    return 0;
+}
+
+static inline calculated_number eval_program_run(EVAL_EXPRESSION *exp, EVAL_PROGRAM *p, EVAL_STATE *state, int *error) {
+    EVAL_INSTRUCTION *ins = p->instructions, *end = &p->instructions[p->used];
+    calculated_number *stack = state->stack, n1, n2;
+    size_t sp = 0;
+    int undefined;
+
+    state->traced = 0;
+    state->trace_formatted = 0;
+
+    while(ins < end) {
+        switch(ins->opcode) {
+            case EVAL_OPCODE_CONSTANT:
+                stack[sp++] = ins->number;
+                break;
+
+            case EVAL_OPCODE_BUILTIN:
+                n1 = ins->number;
+                eval_trace(state, ins, n1, 0);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_THIS:
+                n1 = (exp->this)?*exp->this:NAN;
+                eval_trace(state, ins, n1, 0);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_AFTER:
+                n1 = (exp->after && *exp->after)?*exp->after:NAN;
+                eval_trace(state, ins, n1, 0);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_BEFORE:
+                n1 = (exp->before && *exp->before)?*exp->before:NAN;
+                eval_trace(state, ins, n1, 0);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_NOW:
+                n1 = now_realtime_coarse_sec();
+                eval_trace(state, ins, n1, 0);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_STATUS:
+                n1 = (exp->status)?*exp->status:RRDCALC_STATUS_UNINITIALIZED;
+                eval_trace(state, ins, n1, 0);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_VARIABLE:
+                undefined = 0;
+                n1 = eval_variable(exp, &exp->variables[ins->variable], error, &undefined);
+                eval_trace(state, ins, n1, undefined);
+                stack[sp++] = n1;
+                break;
+
+            case EVAL_OPCODE_AND_THEN:
+                if(!is_true(stack[--sp])) {
+                    stack[sp++] = 0;
+                    ins = &p->instructions[ins->jump];
+                    continue;
+                }
+                break;
+
+            case EVAL_OPCODE_OR_ELSE:
+                if(is_true(stack[--sp])) {
+                    stack[sp++] = 1;
+                    ins = &p->instructions[ins->jump];
+                    continue;
+                }
+                break;
+
+            case EVAL_OPCODE_BOOLEAN:
+                stack[sp - 1] = is_true(stack[sp - 1]);
+                break;
+
+            case EVAL_OPCODE_JUMP_IF_FALSE:
+                if(!is_true(stack[--sp])) {
+                    ins = &p->instructions[ins->jump];
+                    continue;
+                }
+                break;
+
+            case EVAL_OPCODE_JUMP:
+                ins = &p->instructions[ins->jump];
+                continue;
+
+            case EVAL_OPERATOR_NOT:
+                stack[sp - 1] = !is_true(stack[sp - 1]);
+                break;
+
+            case EVAL_OPERATOR_SIGN_MINUS:
+                n1 = stack[sp - 1];
+                stack[sp - 1] = (isnan(n1))?NAN:(isinf(n1))?INFINITY:-n1;
+                break;
+
+            case EVAL_OPERATOR_ABS:
+                n1 = stack[sp - 1];
+                stack[sp - 1] = (isnan(n1))?NAN:(isinf(n1))?INFINITY:abs(n1);
+                break;
+
+            default:
+                // binary operators
+                n2 = stack[--sp];
+                n1 = stack[sp - 1];
+
+                switch(ins->opcode) {
+                    case EVAL_OPERATOR_GREATER_THAN_OR_EQUAL:
+                        n1 = isgreaterequal(n1, n2);
+                        break;
+
+                    case EVAL_OPERATOR_LESS_THAN_OR_EQUAL:
+                        n1 = islessequal(n1, n2);
+                        break;
+
+                    case EVAL_OPERATOR_EQUAL:
+                        n1 = eval_equal(n1, n2);
+                        break;
+
+                    case EVAL_OPERATOR_NOT_EQUAL:
+                        n1 = !eval_equal(n1, n2);
+                        break;
+
+                    case EVAL_OPERATOR_LESS:
+                        n1 = isless(n1, n2);
+                        break;
+
+                    case EVAL_OPERATOR_GREATER:
+                        n1 = isgreater(n1, n2);
+                        break;
+
+                    default:
+                        // arithmetic
+                        if(isnan(n1) || isnan(n2)) n1 = NAN;
+                        else if(isinf(n1) || isinf(n2)) n1 = INFINITY;
+                        else if(ins->opcode == EVAL_OPERATOR_PLUS) n1 = n1 + n2;
+                        else if(ins->opcode == EVAL_OPERATOR_MINUS) n1 = n1 - n2;
+                        else if(ins->opcode == EVAL_OPERATOR_MULTIPLY) n1 = n1 * n2;
+                        else n1 = n1 / n2;
+                        break;
+                }
+
+                stack[sp - 1] = n1;
+                break;
+        }
+
+        ins++;
+    }
+
+    return stack[0];
+}
+
+static inline void eval_state_trace_to_buffer(EVAL_STATE *state, BUFFER *out) {
+    size_t i;
+    for(i = 0; i < state->traced ; i++) {
+        EVAL_TRACE *t = &state->trace[i];
+
+        if(unlikely(t->undefined)) {
+            buffer_sprintf(out, "[ undefined variable '%s' ] ", t->instruction->name);
+            continue;
+        }
+
+        if(t->instruction->opcode == EVAL_OPCODE_VARIABLE)
+            buffer_sprintf(out, "[ ${%s} = ", t->instruction->name);
+        else
+            buffer_sprintf(out, "[ $%s = ", t->instruction->name);
+
+        print_parsed_as_constant(out, t->value);
+        buffer_strcat(out, " ] ");
+    }
+}
+
 // ----------------------------------------------------------------------------
 // public API
 
 int expression_evaluate(EVAL_EXPRESSION *expression) {
     expression->error = EVAL_ERROR_OK;
 
-    buffer_reset(expression->error_msg);
-    expression->result = eval_node(expression, (EVAL_NODE *)expression->nodes, &expression->error);
+    expression->result = eval_program_run(expression, (EVAL_PROGRAM *)expression->program, (EVAL_STATE *)expression->state, &expression->error);
 
     if(unlikely(isnan(expression->result))) {
         if(expression->error == EVAL_ERROR_OK)
@@ -1082,6 +1337,8 @@ int expression_evaluate(EVAL_EXPRESSION *expression) {
     if(expression->error != EVAL_ERROR_OK) {
         expression->result = NAN;
 
+        expression_error_msg(expression);
+
         if(buffer_strlen(expression->error_msg))
             buffer_strcat(expression->error_msg, "; ");
 
@@ -1092,6 +1349,18 @@ int expression_evaluate(EVAL_EXPRESSION *expression) {
     return 1;
 }
 
+const char *expression_error_msg(EVAL_EXPRESSION *expression) {
+    EVAL_STATE *state = (EVAL_STATE *)expression->state;
+
+    if(!state->trace_formatted) {
+        buffer_reset(expression->error_msg);
+        eval_state_trace_to_buffer(state, expression->error_msg);
+        state->trace_formatted = 1;
+    }
+
+    return buffer_tostring(expression->error_msg);
+}
+
 EVAL_EXPRESSION *expression_parse(const char *string, const char **failed_at, int *error) {
     const char *s = string;
     int err = EVAL_ERROR_OK;
@@ -1124,24 +1393,41 @@ EVAL_EXPRESSION *expression_parse(const char *string, const char **failed_at, in
         return NULL;
     }
 
-    EVAL_EXPRESSION *exp = callocz(1, sizeof(EVAL_EXPRESSION));
+    EVAL_PROGRAM *p = eval_compile(op, &err);
+    eval_node_free(op);
 
-    exp->source = strdupz(string);
-    exp->parsed_as = strdupz(buffer_tostring(out));
+    if(!p) {
+        error("failed to compile expression '%s' with reason: %s", string, expression_strerror(err));
+        if (error) *error = err;
+        buffer_free(out);
+        return NULL;
+    }
+
+    p->source = strdupz(string);
+    p->parsed_as = strdupz(buffer_tostring(out));
     buffer_free(out);
 
-    exp->error_msg = buffer_create(100);
-    exp->nodes = (void *)op;
+    return eval_expression_create(p);
+}
 
-    return exp;
+EVAL_EXPRESSION *expression_copy(EVAL_EXPRESSION *expression) {
+    if(!expression) return NULL;
+    return eval_expression_create((EVAL_PROGRAM *)expression->program);
 }
 
 void expression_free(EVAL_EXPRESSION *expression) {
     if(!expression) return;
 
-    if(expression->nodes) eval_node_free((EVAL_NODE *)expression->nodes);
-    freez((void *)expression->source);
-    freez((void *)expression->parsed_as);
+    EVAL_PROGRAM *p = (EVAL_PROGRAM *)expression->program;
+    if(!__atomic_sub_fetch(&p->refcount, 1, __ATOMIC_ACQ_REL))
+        eval_program_free(p);
+
+    EVAL_STATE *state = (EVAL_STATE *)expression->state;
+    freez(state->stack);
+    freez(state->trace);
+    freez(state);
+
+    freez(expression->variables);
     buffer_free(expression->error_msg);
     freez(expression);
 }
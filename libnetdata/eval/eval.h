@@ -20,6 +20,11 @@ typedef enum rrdcalc_status {
 typedef struct eval_variable {
     char *name;
     uint32_t hash;
+
+    // the object the variable is bound to (e.g. an RRDVAR)
+    // NULL when the variable is not found
+    void *bound;
+
     struct eval_variable *next;
 } EVAL_VARIABLE;
 
@@ -35,10 +40,25 @@ typedef struct eval_expression {
     calculated_number result;
 
     int error;
+
+    // built only when the evaluation fails
+    // use expression_error_msg() to get the values of the variables
+    // of a successful evaluation
     BUFFER *error_msg;
 
-    // hidden EVAL_NODE *
-    void *nodes;
+    // hidden EVAL_PROGRAM *, shared by all the copies of the expression
+    void *program;
+
+    // hidden EVAL_STATE *, the evaluation state of this expression
+    void *state;
+
+    // the variables of the expression (excluding the built-in ones)
+    // when bound_value is set, the caller has bound them and their values
+    // are read with bound_value(variable->bound), otherwise they are
+    // looked up with health_variable_lookup() on every evaluation
+    EVAL_VARIABLE *variables;
+    calculated_number (*bound_value)(void *bound);
+    uint32_t bound_version;
 
     // custom data to be used for looking up variables
     struct rrdcalc *rrdcalc;
@@ -72,6 +92,10 @@ typedef struct eval_expression {
 //   NULL in which case the pointer to error has the error code
 extern EVAL_EXPRESSION *expression_parse(const char *string, const char **failed_at, int *error);
 
+// create an expression that shares the compiled program of another one
+// it has its own variables, bindings and state
+extern EVAL_EXPRESSION *expression_copy(EVAL_EXPRESSION *expression);
+
 // free all resources allocated for an expression
 extern void expression_free(EVAL_EXPRESSION *expression);
 
@@ -83,6 +107,10 @@ extern const char *expression_strerror(int error);
 // 2 = FAILED, the error message is in: buffer_tostring(expression->error_msg)
 extern int expression_evaluate(EVAL_EXPRESSION *expression);
 
+// the values of the variables used by the last evaluation
+// followed by the error, if the evaluation failed
+extern const char *expression_error_msg(EVAL_EXPRESSION *expression);
+
 extern int health_variable_lookup(const char *variable, uint32_t hash, struct rrdcalc *rc, calculated_number *result);
 
 #endif //NETDATA_EVAL_H
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "../libnetdata.h"
+
+// the item of the deleted slots, the probing goes on after them
+static char hash_index_deleted_item;
+#define HASH_INDEX_DELETED ((void *)&hash_index_deleted_item)
+
+// ----------------------------------------------------------------------------
+// readers
+//
+// The readers do not take locks, they are counted in the epoch of the index
+// while they are looking at its table and its items. A writer that deleted an
+// item or replaced the table waits for all the readers that could have seen
+// the old state to finish, before it returns.
+
+#define hash_index_read_lock(index) netdata_epoch_read_lock(&(index)->readers)
+#define hash_index_read_unlock(index, reader) netdata_epoch_read_unlock(&(index)->readers, reader)
+#define hash_index_synchronize(index) netdata_epoch_synchronize(&(index)->readers)
+
+// ----------------------------------------------------------------------------
+// tables
+
+static struct hash_index_table *hash_index_table_create(size_t size) {
+    struct hash_index_table *t = callocz(1, sizeof(struct hash_index_table) + size * sizeof(HASH_INDEX_SLOT));
+    t->size = size;
+    return t;
+}
+
+// the caller must hold the mutex of the index
+// copies the items of the index to a new table, big enough for entries items
+static void hash_index_resize(HASH_INDEX *index, size_t entries) {
+    struct hash_index_table *old = index->table, *t;
+    size_t size = HASH_INDEX_MIN_SIZE, i, slot;
+
+    // half full after the resize
+    while(size < entries * 2)
+        size <<= 1;
+
+    t = hash_index_table_create(size);
+    if(old) {
+        for(i = 0; i < old->size ; i++) {
+            void *item = old->slots[i].item;
+            if(!item || item == HASH_INDEX_DELETED)
+                continue;
+
+            for(slot = old->slots[i].hash & (size - 1); t->slots[slot].item ; slot = (slot + 1) & (size - 1)) ;
+            t->slots[slot] = old->slots[i];
+        }
+    }
+
+    __atomic_store_n(&index->table, t, __ATOMIC_RELEASE);
+    index->deleted = 0;
+
+    if(old) {
+        hash_index_synchronize(index);
+        freez(old);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// public API
+
+void hash_index_init(HASH_INDEX *index, int (*equal)(void *item, const void *key)) {
+    index->table = NULL;
+    index->equal = equal;
+    netdata_epoch_init(&index->readers);
+    index->entries = 0;
+    index->deleted = 0;
+
+    int lock = netdata_mutex_init(&index->mutex);
+    if(lock != 0)
+        fatal("Failed to initialize hash index mutex, error: %d", lock);
+}
+
+// the index must not be used any more
+void hash_index_destroy(HASH_INDEX *index) {
+    freez(index->table);
+    index->table = NULL;
+    index->entries = 0;
+    index->deleted = 0;
+}
+
+void *hash_index_get(HASH_INDEX *index, uint32_t hash, const void *key) {
+    void *ret = NULL;
+    unsigned reader = hash_index_read_lock(index);
+
+    struct hash_index_table *t = __atomic_load_n(&index->table, __ATOMIC_ACQUIRE);
+    if(likely(t)) {
+        size_t mask = t->size - 1, slot, probes;
+
+        for(slot = hash & mask, probes = 0; probes < t->size ; slot = (slot + 1) & mask, probes++) {
+            void *item = __atomic_load_n(&t->slots[slot].item, __ATOMIC_ACQUIRE);
+
+            if(!item) break;
+
+            if(item != HASH_INDEX_DELETED && __atomic_load_n(&t->slots[slot].hash, __ATOMIC_RELAXED) == hash && index->equal(item, key)) {
+                ret = item;
+                break;
+            }
+        }
+    }
+
+    hash_index_read_unlock(index, reader);
+    return ret;
+}
+
+void *hash_index_set(HASH_INDEX *index, uint32_t hash, const void *key, void *item) {
+    netdata_mutex_lock(&index->mutex);
+
+    // at most 3/4 of the slots are used or deleted, so that there are always empty slots
+    if(unlikely(!index->table || (index->entries + index->deleted + 1) * 4 > index->table->size * 3))
+        hash_index_resize(index, index->entries + 1);
+
+    struct hash_index_table *t = index->table;
+    size_t mask = t->size - 1, slot, target = t->size;
+
+    for(slot = hash & mask; t->slots[slot].item ; slot = (slot + 1) & mask) {
+        void *existing = t->slots[slot].item;
+
+        if(existing == HASH_INDEX_DELETED) {
+            if(target == t->size) target = slot;
+            continue;
+        }
+
+        if(t->slots[slot].hash == hash && index->equal(existing, key)) {
+            netdata_mutex_unlock(&index->mutex);
+            return existing;
+        }
+    }
+
+    if(target == t->size)
+        target = slot;
+    else
+        index->deleted--;
+
+    // the readers check the hash after they see the item
+    __atomic_store_n(&t->slots[target].hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->slots[target].item, item, __ATOMIC_RELEASE);
+    index->entries++;
+
+    netdata_mutex_unlock(&index->mutex);
+    return item;
+}
+
+void *hash_index_del(HASH_INDEX *index, uint32_t hash, const void *key) {
+    void *ret = NULL;
+
+    netdata_mutex_lock(&index->mutex);
+
+    struct hash_index_table *t = index->table;
+    if(likely(t)) {
+        size_t mask = t->size - 1, slot;
+
+        for(slot = hash & mask; t->slots[slot].item ; slot = (slot + 1) & mask) {
+            void *item = t->slots[slot].item;
+
+            if(item != HASH_INDEX_DELETED && t->slots[slot].hash == hash && index->equal(item, key)) {
+                __atomic_store_n(&t->slots[slot].item, HASH_INDEX_DELETED, __ATOMIC_RELEASE);
+                index->entries--;
+                index->deleted++;
+                ret = item;
+                break;
+            }
+        }
+    }
+
+    // the caller may free the item when we return
+    if(ret)
+        hash_index_synchronize(index);
+
+    netdata_mutex_unlock(&index->mutex);
+    return ret;
+}
+
+int hash_index_traverse(HASH_INDEX *index, int (*callback)(void *item, void *data), void *data) {
+    int ret, total = 0;
+    size_t slot;
+    unsigned reader = hash_index_read_lock(index);
+
+    struct hash_index_table *t = __atomic_load_n(&index->table, __ATOMIC_ACQUIRE);
+    if(likely(t)) {
+        for(slot = 0; slot < t->size ; slot++) {
+            void *item = __atomic_load_n(&t->slots[slot].item, __ATOMIC_ACQUIRE);
+            if(!item || item == HASH_INDEX_DELETED)
+                continue;
+
+            ret = callback(item, data);
+            if(ret < 0) {
+                total = ret;
+                break;
+            }
+            total += ret;
+        }
+    }
+
+    hash_index_read_unlock(index, reader);
+    return total;
+}
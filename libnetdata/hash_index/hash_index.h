@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_HASH_INDEX_H
+#define NETDATA_HASH_INDEX_H 1
+
+#include "../libnetdata.h"
+
+// an open addressing hash table of pointers to items that are indexed by
+// a hash and a key, for read-mostly indexes: the readers do not lock, the
+// writers are serialized and wait for the readers that may still see what
+// they deleted or replaced, before they return
+
+#define HASH_INDEX_MIN_SIZE 16
+
+typedef struct hash_index_slot {
+    uint32_t hash;
+    void *item;                             // NULL when the slot is empty, HASH_INDEX_DELETED when deleted
+} HASH_INDEX_SLOT;
+
+struct hash_index_table {
+    size_t size;                            // a power of 2
+    HASH_INDEX_SLOT slots[];
+};
+
+typedef struct hash_index {
+    struct hash_index_table *table;         // the readers load it atomically, the writers replace it
+    int (*equal)(void *item, const void *key);
+
+    netdata_mutex_t mutex;                  // serializes the writers
+    netdata_epoch_t readers;                // the readers do not lock
+
+    size_t entries;                         // the items in the table
+    size_t deleted;                         // the deleted slots in the table
+} HASH_INDEX;
+
+extern void hash_index_init(HASH_INDEX *index, int (*equal)(void *item, const void *key));
+extern void hash_index_destroy(HASH_INDEX *index);
+
+// returns the item of key, or NULL
+extern void *hash_index_get(HASH_INDEX *index, uint32_t hash, const void *key);
+
+// adds item with key and returns it, or returns the item already indexed with key
+extern void *hash_index_set(HASH_INDEX *index, uint32_t hash, const void *key, void *item) NEVERNULL WARNUNUSED;
+
+// removes and returns the item of key, or returns NULL
+extern void *hash_index_del(HASH_INDEX *index, uint32_t hash, const void *key);
+
+// calls callback for all the items, like avl_traverse_lock() does
+// the callback must not change the index
+extern int hash_index_traverse(HASH_INDEX *index, int (*callback)(void *item, void *data), void *data);
+
+#endif /* NETDATA_HASH_INDEX_H */
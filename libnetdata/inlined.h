@@ -281,6 +281,21 @@ static inline int read_single_number_file(const char *filename, unsigned long lo
     return 0;
 }
 
+// like read_single_number_file(), for a file kept open
+static inline int read_single_number_fd(int fd, unsigned long long *result) {
+    char buffer[30 + 1];
+
+    ssize_t r = pread(fd, buffer, 30, 0);
+    if(unlikely(r <= 0)) {
+        *result = 0;
+        return 1;
+    }
+
+    buffer[r] = '\0';
+    *result = str2ull(buffer);
+    return 0;
+}
+
 static inline int read_single_signed_number_file(const char *filename, long long *result) {
     char buffer[30 + 1];
 
@@ -499,6 +499,435 @@ size_t json_walk_tree(char *js, jsmntok_t *t, void *callback_data, int (*callbac
 }
 #endif
 
+#ifndef ENABLE_JSONC
+// ----------------------------------------------------------------------------
+// in place parser
+//
+// It does not allocate memory. The input is validated in a single pass, keeping
+// its nesting in a fixed size stack, and then it is walked giving the callbacks
+// the same JSON_ENTRY the jsmn walker gives them, without an array of tokens.
+// The strings and the primitives are terminated in place while their callbacks
+// run, and they are restored afterwards.
+
+#define JSON_MAX_NESTING 128
+
+static inline char *json_skip_whitespace(char *s) {
+    while(*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') s++;
+    return s;
+}
+
+static inline int json_is_delimiter(char c) {
+    switch(c) {
+        case '\0': case ' ': case '\t': case '\n': case '\r':
+        case ',': case ':': case ']': case '}':
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * String End
+ *
+ * Find the closing quote of a string, checking its escapes.
+ *
+ * @param s the opening quote of the string
+ *
+ * @return the closing quote of the string, or NULL when the string is invalid or truncated
+ */
+static inline char *json_string_end(char *s) {
+    for(s++; *s ; s++) {
+        if(*s == '"')
+            return s;
+
+        if((unsigned char)*s < 0x20)
+            return NULL;
+
+        if(*s == '\\') {
+            s++;
+            switch(*s) {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    break;
+
+                case 'u':
+                    if(!isxdigit(s[1]) || !isxdigit(s[2]) || !isxdigit(s[3]) || !isxdigit(s[4]))
+                        return NULL;
+                    s += 4;
+                    break;
+
+                default:
+                    return NULL;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Primitive End
+ *
+ * Find the end of a number, true, false or null.
+ *
+ * @param s the first character of the primitive
+ *
+ * @return the character after the primitive, or NULL when it is not a valid primitive
+ */
+static inline char *json_primitive_end(char *s) {
+    char *e = s;
+
+    switch(*s) {
+        case 't':
+            e = (strncmp(s, "true", 4)) ? NULL : s + 4;
+            break;
+
+        case 'f':
+            e = (strncmp(s, "false", 5)) ? NULL : s + 5;
+            break;
+
+        case 'n':
+            e = (strncmp(s, "null", 4)) ? NULL : s + 4;
+            break;
+
+        default:
+            if(*e == '-') e++;
+            if(!isdigit(*e)) return NULL;
+            while(isdigit(*e)) e++;
+
+            if(*e == '.') {
+                e++;
+                if(!isdigit(*e)) return NULL;
+                while(isdigit(*e)) e++;
+            }
+
+            if(*e == 'e' || *e == 'E') {
+                e++;
+                if(*e == '+' || *e == '-') e++;
+                if(!isdigit(*e)) return NULL;
+                while(isdigit(*e)) e++;
+            }
+            break;
+    }
+
+    return (e && json_is_delimiter(*e)) ? e : NULL;
+}
+
+/**
+ * Validate
+ *
+ * Check that the string is a single, complete json value.
+ *
+ * @param js the string to check
+ *
+ * @return JSON_OK when the string is valid, JSON_CANNOT_PARSE otherwise.
+ */
+int json_validate(char *js) {
+    enum {
+        JSON_EXPECT_VALUE,
+        JSON_EXPECT_VALUE_OR_END,
+        JSON_EXPECT_KEY,
+        JSON_EXPECT_KEY_OR_END,
+        JSON_EXPECT_COLON,
+        JSON_EXPECT_COMMA_OR_END
+    } expect = JSON_EXPECT_VALUE;
+
+    char stack[JSON_MAX_NESTING];
+    size_t depth = 0;
+    char *s = js;
+
+    if(!s) return JSON_CANNOT_PARSE;
+
+    for(;;) {
+        s = json_skip_whitespace(s);
+
+        if(expect == JSON_EXPECT_COMMA_OR_END && !depth)
+            break;
+
+        switch(expect) {
+            case JSON_EXPECT_KEY_OR_END:
+                if(*s == '}') {
+                    depth--;
+                    s++;
+                    expect = JSON_EXPECT_COMMA_OR_END;
+                    break;
+                }
+                // fall through
+
+            case JSON_EXPECT_KEY:
+                if(*s != '"' || !(s = json_string_end(s)))
+                    return JSON_CANNOT_PARSE;
+                s++;
+                expect = JSON_EXPECT_COLON;
+                break;
+
+            case JSON_EXPECT_COLON:
+                if(*s != ':')
+                    return JSON_CANNOT_PARSE;
+                s++;
+                expect = JSON_EXPECT_VALUE;
+                break;
+
+            case JSON_EXPECT_VALUE_OR_END:
+                if(*s == ']') {
+                    depth--;
+                    s++;
+                    expect = JSON_EXPECT_COMMA_OR_END;
+                    break;
+                }
+                // fall through
+
+            case JSON_EXPECT_VALUE:
+                if(*s == '{' || *s == '[') {
+                    if(depth == JSON_MAX_NESTING)
+                        return JSON_CANNOT_PARSE;
+                    stack[depth++] = *s;
+                    expect = (*s == '{') ? JSON_EXPECT_KEY_OR_END : JSON_EXPECT_VALUE_OR_END;
+                    s++;
+                }
+                else if(*s == '"') {
+                    if(!(s = json_string_end(s)))
+                        return JSON_CANNOT_PARSE;
+                    s++;
+                    expect = JSON_EXPECT_COMMA_OR_END;
+                }
+                else {
+                    if(!(s = json_primitive_end(s)))
+                        return JSON_CANNOT_PARSE;
+                    expect = JSON_EXPECT_COMMA_OR_END;
+                }
+                break;
+
+            case JSON_EXPECT_COMMA_OR_END:
+                if(*s == ',')
+                    expect = (stack[depth - 1] == '{') ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+                else if((*s == '}' && stack[depth - 1] == '{') || (*s == ']' && stack[depth - 1] == '['))
+                    depth--;
+                else
+                    return JSON_CANNOT_PARSE;
+                s++;
+                break;
+        }
+    }
+
+    return (*s) ? JSON_CANNOT_PARSE : JSON_OK;
+}
+
+/**
+ * Skip
+ *
+ * Find the end of a valid object or array, counting its items.
+ *
+ * @param s the opening bracket of the object or array
+ * @param items where to store the number of its items
+ *
+ * @return the character after its closing bracket
+ */
+static char *json_skip_container(char *s, size_t *items) {
+    size_t depth = 0, commas = 0;
+    int empty = 1;
+
+    for(;; s++) {
+        switch(*s) {
+            case '"':
+                if(depth == 1) empty = 0;
+                s = json_string_end(s);
+                break;
+
+            case '{': case '[':
+                if(++depth == 2) empty = 0;
+                break;
+
+            case '}': case ']':
+                if(!--depth) {
+                    *items = (empty) ? 0 : commas + 1;
+                    return s + 1;
+                }
+                break;
+
+            case ',':
+                if(depth == 1) commas++;
+                break;
+
+            case ' ': case '\t': case '\n': case '\r':
+                break;
+
+            default:
+                if(depth == 1) empty = 0;
+                break;
+        }
+    }
+}
+
+static char *json_walk_inplace_value(char *s, size_t nest, JSON_ENTRY *e);
+
+static char *json_walk_inplace_object(char *s, size_t nest, JSON_ENTRY *e) {
+    JSON_ENTRY ne;
+    size_t items;
+    char *end = json_skip_container(s, &items);
+
+    memcpy(&ne, e, sizeof(JSON_ENTRY));
+    ne.type = JSON_OBJECT;
+    ne.callback_function = NULL;
+    ne.original_string = s;
+
+    char old = *end;
+    *end = '\0';
+    if(e->callback_function) e->callback_function(&ne);
+    *end = old;
+
+    s = json_skip_whitespace(s + 1);
+    while(*s == '"') {
+        char *ke = json_string_end(s);
+        size_t len = (size_t)(ke - s - 1);
+        if(unlikely(len > JSON_NAME_LEN)) len = JSON_NAME_LEN;
+        memcpy(ne.name, s + 1, len);
+        ne.name[len] = '\0';
+        snprintfz(ne.fullname, JSON_FULLNAME_LEN, "%s%s%s", e->fullname, e->fullname[0]?".":"", ne.name);
+
+        s = json_skip_whitespace(ke + 1);   // the colon
+        s = json_skip_whitespace(s + 1);
+        s = json_skip_whitespace(json_walk_inplace_value(s, nest + 1, &ne));
+        if(*s == ',') s = json_skip_whitespace(s + 1);
+    }
+
+    return end;
+}
+
+static char *json_walk_inplace_array(char *s, size_t nest, JSON_ENTRY *e) {
+    JSON_ENTRY ne;
+    size_t i, items;
+    char *end = json_skip_container(s, &items);
+
+    memcpy(&ne, e, sizeof(JSON_ENTRY));
+    ne.type = JSON_ARRAY;
+    ne.data.items = items;
+    ne.callback_function = NULL;
+    ne.name[0] = '\0';
+    ne.fullname[0] = '\0';
+    ne.original_string = s;
+
+    char old = *end;
+    *end = '\0';
+    if(e->callback_function) e->callback_function(&ne);
+    *end = old;
+
+    int named = (strlen(e->name) <= JSON_NAME_LEN - 24 && strlen(e->fullname) <= JSON_FULLNAME_LEN - 24);
+    if(!named)
+        info("JSON: JSON walk_array ignoring the elements of name:%s fullname:%s", e->name, e->fullname);
+
+    s = json_skip_whitespace(s + 1);
+    for(i = 0; i < items ; i++) {
+        if(named) {
+            ne.pos = i;
+            sprintf(ne.name, "%s[%zu]", e->name, i);
+            sprintf(ne.fullname, "%s[%zu]", e->fullname, i);
+            s = json_walk_inplace_value(s, nest + 1, &ne);
+        }
+        else if(*s == '{' || *s == '[') {
+            size_t ignored;
+            s = json_skip_container(s, &ignored);
+        }
+        else if(*s == '"')
+            s = json_string_end(s) + 1;
+        else
+            s = json_primitive_end(s);
+
+        s = json_skip_whitespace(s);
+        if(*s == ',') s = json_skip_whitespace(s + 1);
+    }
+
+    return end;
+}
+
+static char *json_walk_inplace_value(char *s, size_t nest, JSON_ENTRY *e) {
+    char *end, old;
+
+    switch(*s) {
+        case '{':
+            return json_walk_inplace_object(s, nest, e);
+
+        case '[':
+            return json_walk_inplace_array(s, nest, e);
+
+        case '"':
+            end = json_string_end(s);
+            *end = '\0';
+            e->original_string = s + 1;
+            e->type = JSON_STRING;
+            e->data.string = e->original_string;
+            if(e->callback_function) e->callback_function(e);
+            *end = '"';
+            return end + 1;
+
+        default:
+            end = json_primitive_end(s);
+            old = *end;
+            *end = '\0';
+            e->original_string = s;
+
+            switch(*s) {
+                case 't':
+                    e->type = JSON_BOOLEAN;
+                    e->data.boolean = 1;
+                    break;
+
+                case 'f':
+                    e->type = JSON_BOOLEAN;
+                    e->data.boolean = 0;
+                    break;
+
+                case 'n':
+                    e->type = JSON_NULL;
+                    break;
+
+                default:
+                    e->type = JSON_NUMBER;
+                    e->data.number = strtold(s, NULL);
+                    break;
+            }
+
+            if(e->callback_function) e->callback_function(e);
+            *end = old;
+            return end;
+    }
+}
+
+/**
+ * Walk In Place
+ *
+ * Call the callback function for the objects and the arrays of a valid json string.
+ *
+ * @param js the string, validated with json_validate()
+ * @param callback_data additional data to be used together the callback function
+ * @param callback_function the function called for each item
+ */
+static void json_walk_inplace(char *js, void *callback_data, int (*callback_function)(struct json_entry *)) {
+    JSON_ENTRY e = {
+            .name = "",
+            .fullname = "",
+            .callback_data = callback_data,
+            .callback_function = callback_function
+    };
+
+    char *s = json_skip_whitespace(js);
+    switch(*s) {
+        case '{':
+            e.type = JSON_OBJECT;
+            json_walk_inplace_object(s, 0, &e);
+            break;
+
+        case '[':
+            e.type = JSON_ARRAY;
+            json_walk_inplace_array(s, 0, &e);
+            break;
+
+        default:
+            break;
+    }
+}
+#endif
+
 /**
  * JSON Parse
  *
@@ -516,22 +945,21 @@ int json_parse(char *js, void *callback_data, int (*callback_function)(JSON_ENTR
     if(js) {
 #ifdef ENABLE_JSONC
         json_object *tokens = json_tokenise(js);
-#else
-        size_t count;
-        jsmntok_t *tokens = json_tokenise(js, strlen(js), &count);
-#endif
 
         if(tokens) {
-#ifdef ENABLE_JSONC
             json_walk(tokens, callback_data, callback_function);
             json_object_put(tokens);
+            return JSON_OK;
+        }
 #else
-            json_walk_tree(js, tokens, callback_data, callback_function);
-            freez(tokens);
-#endif
+        if(json_validate(js) == JSON_OK) {
+            json_walk_inplace(js, callback_data, callback_function);
             return JSON_OK;
         }
 
+        error("JSON: Invalid json string.");
+#endif
+
         return JSON_CANNOT_PARSE;
     }
 
@@ -48,6 +48,10 @@ typedef struct json_entry {
 
 int json_parse(char *js, void *callback_data, int (*callback_function)(JSON_ENTRY *));
 
+#ifndef ENABLE_JSONC
+int json_validate(char *js);
+#endif
+
 
 // ----------------------------------------------------------------------------
 // private functions
@@ -26,6 +26,9 @@ const char *program_version = VERSION;
 // its lifetime), these can be used to override the default system allocation
 // routines.
 
+// the allocations (not the frees) made by the calling thread - -W perftest reports them per operation
+__thread size_t memory_thread_allocations = 0;
+
 #ifdef NETDATA_LOG_ALLOCATIONS
 static __thread struct memory_statistics {
     volatile ssize_t malloc_calls_made;
@@ -75,6 +78,8 @@ static inline void mmap_accounting(size_t size) {
 }
 
 void *mallocz_int(const char *file, const char *function, const unsigned long line, size_t size) {
+    memory_thread_allocations++;
+
     if(log_thread_memory_allocations) {
         memory_statistics.memory_calls_made++;
         memory_statistics.malloc_calls_made++;
@@ -89,6 +94,8 @@ void *mallocz_int(const char *file, const char *function, const unsigned long li
 }
 
 void *callocz_int(const char *file, const char *function, const unsigned long line, size_t nmemb, size_t size) {
+    memory_thread_allocations++;
+
     size = nmemb * size;
 
     if(log_thread_memory_allocations) {
@@ -107,6 +114,8 @@ void *callocz_int(const char *file, const char *function, const unsigned long li
 void *reallocz_int(const char *file, const char *function, const unsigned long line, void *ptr, size_t size) {
     if(!ptr) return mallocz_int(file, function, line, size);
 
+    memory_thread_allocations++;
+
     size_t *n = (size_t *)ptr;
     n--;
     size_t old_size = *n;
@@ -126,6 +135,8 @@ void *reallocz_int(const char *file, const char *function, const unsigned long l
 }
 
 char *strdupz_int(const char *file, const char *function, const unsigned long line, const char *s) {
+    memory_thread_allocations++;
+
     size_t size = strlen(s) + 1;
 
     if(log_thread_memory_allocations) {
@@ -163,6 +174,7 @@ void freez_int(const char *file, const char *function, const unsigned long line,
 #else
 
 char *strdupz(const char *s) {
+    memory_thread_allocations++;
     char *t = strdup(s);
     if (unlikely(!t)) fatal("Cannot strdup() string '%s'", s);
     return t;
@@ -173,18 +185,21 @@ void freez(void *ptr) {
 }
 
 void *mallocz(size_t size) {
+    memory_thread_allocations++;
     void *p = malloc(size);
     if (unlikely(!p)) fatal("Cannot allocate %zu bytes of memory.", size);
     return p;
 }
 
 void *callocz(size_t nmemb, size_t size) {
+    memory_thread_allocations++;
     void *p = calloc(nmemb, size);
     if (unlikely(!p)) fatal("Cannot allocate %zu bytes of memory.", nmemb * size);
     return p;
 }
 
 void *reallocz(void *ptr, size_t size) {
+    memory_thread_allocations++;
     void *p = realloc(ptr, size);
     if (unlikely(!p)) fatal("Cannot re-allocate memory to %zu bytes.", size);
     return p;
@@ -118,6 +118,16 @@
 #include <sys/statvfs.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#elif defined(HAVE_SYS_EVENT_H)
+#include <sys/event.h>
+#endif
+
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
 // #1408
 #ifdef MAJOR_IN_MKDEV
 #include <sys/mkdev.h>
@@ -219,6 +229,8 @@ extern int  vsnprintfz(char *dst, size_t n, const char *fmt, va_list args);
 extern int  snprintfz(char *dst, size_t n, const char *fmt, ...) PRINTFLIKE(3, 4);
 
 // memory allocation functions that handle failures
+extern __thread size_t memory_thread_allocations;
+
 #ifdef NETDATA_LOG_ALLOCATIONS
 extern __thread size_t log_thread_memory_allocations;
 #define strdupz(s) strdupz_int(__FILE__, __FUNCTION__, __LINE__, s)
@@ -305,7 +317,10 @@ extern char *netdata_configured_host_prefix;
 #include "config/appconfig.h"
 #include "log/log.h"
 #include "procfile/procfile.h"
+#include "hash_index/hash_index.h"
+#include "btree/btree.h"
 #include "dictionary/dictionary.h"
+#include "string_pool/string_pool.h"
 #include "eval/eval.h"
 #include "statistical/statistical.h"
 #include "adaptive_resortable_list/adaptive_resortable_list.h"
@@ -2,6 +2,10 @@
 
 #include "../libnetdata.h"
 
+#ifdef __linux__
+#include <linux/futex.h>
+#endif
+
 // ----------------------------------------------------------------------------
 // automatic thread cancelability management, based on locks
 
@@ -41,6 +45,258 @@ inline void netdata_thread_enable_cancelability(void) {
         netdata_thread_lock_cancelability--;
 }
 
+// ----------------------------------------------------------------------------
+// epochs
+
+void netdata_epoch_init(netdata_epoch_t *e) {
+    e->epoch = 0;
+    e->readers[0] = e->readers[1] = 0;
+}
+
+// The epoch is flipped twice, each time waiting for the reader counter of the previous one to drop to zero.
+// A reader that is counted late in the counter we have already waited for, has started after we flipped the
+// epoch, so it sees what has been changed before we were called. The readers that start while we wait, are
+// counted in the other counter, so that they do not delay us.
+void netdata_epoch_synchronize(netdata_epoch_t *e) {
+    int i;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for(i = 0; i < 2 ; i++) {
+        unsigned reader = __atomic_fetch_add(&e->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+        while(__atomic_load_n(&e->readers[reader], __ATOMIC_SEQ_CST))
+            sched_yield();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// lock profiling
+
+int netdata_locks_profiling = 0;
+
+const char *netdata_locks_profile_buckets[NETDATA_LOCKS_PROFILE_BUCKETS] = {
+        "1us", "2us", "4us", "8us", "16us", "32us", "64us", "128us",
+        "256us", "512us", "1ms", "2ms", "4ms", "8ms", "16ms", "more"
+};
+
+#define LOCKS_PROFILE_SITES 4096    // has to be a power of 2
+#define LOCKS_PROFILE_HELD 32       // the locks a thread can hold at the same time, to measure their hold time
+
+// the call sites are never removed, so they are found without locks
+// a site is claimed by one thread, and it can be used when its file is set
+struct locks_profile_site {
+    const char *file;
+    const char *function;
+    unsigned long line;
+    const char *type;
+    uint32_t claimed;
+    NETDATA_LOCKS_PROFILE profile;
+};
+
+static struct locks_profile_site locks_profile_sites[LOCKS_PROFILE_SITES];
+
+static __thread struct locks_profile_held {
+    void *lock;
+    struct locks_profile_site *site;
+    uint64_t acquired_nsec;
+} locks_profile_held[LOCKS_PROFILE_HELD];
+
+static __thread int locks_profile_held_count = 0;
+
+static inline uint64_t locks_profile_now_nsec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline int locks_profile_bucket(uint64_t nsec) {
+    uint64_t usec = nsec / 1000;
+    int bucket = 0;
+
+    while(usec && bucket < NETDATA_LOCKS_PROFILE_BUCKETS - 1) {
+        usec >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static struct locks_profile_site *locks_profile_site(const char *file, const char *function, unsigned long line, const char *type) {
+    // file and type are literals, so their pointers identify them
+    uint32_t hash = (uint32_t)(((uintptr_t)file >> 3) * 2654435761U) ^ (uint32_t)(line * 40503U) ^ (uint32_t)((uintptr_t)type >> 3);
+    size_t i, probes;
+
+    for(i = hash & (LOCKS_PROFILE_SITES - 1), probes = 0; probes < LOCKS_PROFILE_SITES ; i = (i + 1) & (LOCKS_PROFILE_SITES - 1), probes++) {
+        struct locks_profile_site *site = &locks_profile_sites[i];
+        const char *f = __atomic_load_n(&site->file, __ATOMIC_ACQUIRE);
+
+        if(unlikely(!f)) {
+            uint32_t expected = 0;
+            if(__atomic_compare_exchange_n(&site->claimed, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                site->function = function;
+                site->line = line;
+                site->type = type;
+                __atomic_store_n(&site->file, file, __ATOMIC_RELEASE);
+                return site;
+            }
+
+            // another thread is claiming it
+            while(!(f = __atomic_load_n(&site->file, __ATOMIC_ACQUIRE)))
+                sched_yield();
+        }
+
+        if(f == file && site->line == line && site->type == type)
+            return site;
+    }
+
+    // all the sites are used
+    return NULL;
+}
+
+static inline uint64_t locks_profile_start(void) {
+    return (unlikely(netdata_locks_profiling)) ? locks_profile_now_nsec() : 0;
+}
+
+static void locks_profile_acquired(const char *file, const char *function, unsigned long line, const char *type, void *lock, uint64_t started_nsec) {
+    if(likely(!started_nsec)) return;
+
+    uint64_t now = locks_profile_now_nsec();
+    uint64_t wait = now - started_nsec;
+
+    struct locks_profile_site *site = locks_profile_site(file, function, line, type);
+    if(unlikely(!site)) return;
+
+    __atomic_fetch_add(&site->profile.acquisitions, 1, __ATOMIC_RELAXED);
+    if(wait >= 1000) __atomic_fetch_add(&site->profile.contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->profile.wait_nsec, wait, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&site->profile.wait_histogram[locks_profile_bucket(wait)], 1, __ATOMIC_RELAXED);
+
+    if(likely(locks_profile_held_count < LOCKS_PROFILE_HELD)) {
+        struct locks_profile_held *h = &locks_profile_held[locks_profile_held_count++];
+        h->lock = lock;
+        h->site = site;
+        h->acquired_nsec = now;
+    }
+}
+
+static inline void locks_profile_released(void *lock) {
+    if(likely(!locks_profile_held_count)) return;
+
+    int i;
+    for(i = locks_profile_held_count - 1; i >= 0 ; i--) {
+        struct locks_profile_held *h = &locks_profile_held[i];
+        if(h->lock != lock) continue;
+
+        // the hold time is accounted to the site that acquired the lock
+        uint64_t hold = locks_profile_now_nsec() - h->acquired_nsec;
+        __atomic_fetch_add(&h->site->profile.hold_nsec, hold, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&h->site->profile.hold_histogram[locks_profile_bucket(hold)], 1, __ATOMIC_RELAXED);
+
+        *h = locks_profile_held[--locks_profile_held_count];
+        return;
+    }
+}
+
+static inline void locks_profile_copy(NETDATA_LOCKS_PROFILE *dst, NETDATA_LOCKS_PROFILE *src, int add) {
+    int i;
+
+    if(!add) memset(dst, 0, sizeof(NETDATA_LOCKS_PROFILE));
+
+    dst->acquisitions += __atomic_load_n(&src->acquisitions, __ATOMIC_RELAXED);
+    dst->contended    += __atomic_load_n(&src->contended, __ATOMIC_RELAXED);
+    dst->wait_nsec    += __atomic_load_n(&src->wait_nsec, __ATOMIC_RELAXED);
+    dst->hold_nsec    += __atomic_load_n(&src->hold_nsec, __ATOMIC_RELAXED);
+
+    for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++) {
+        dst->wait_histogram[i] += __atomic_load_n(&src->wait_histogram[i], __ATOMIC_RELAXED);
+        dst->hold_histogram[i] += __atomic_load_n(&src->hold_histogram[i], __ATOMIC_RELAXED);
+    }
+}
+
+void netdata_locks_profile_totals(NETDATA_LOCKS_PROFILE *totals) {
+    size_t i;
+
+    memset(totals, 0, sizeof(NETDATA_LOCKS_PROFILE));
+
+    for(i = 0; i < LOCKS_PROFILE_SITES ; i++)
+        if(__atomic_load_n(&locks_profile_sites[i].file, __ATOMIC_ACQUIRE))
+            locks_profile_copy(totals, &locks_profile_sites[i].profile, 1);
+}
+
+struct locks_profile_sorted {
+    struct locks_profile_site *site;
+    NETDATA_LOCKS_PROFILE profile;
+};
+
+static int locks_profile_compare(const void *a, const void *b) {
+    uint64_t wa = ((struct locks_profile_sorted *)a)->profile.wait_nsec;
+    uint64_t wb = ((struct locks_profile_sorted *)b)->profile.wait_nsec;
+
+    if(wa > wb) return -1;
+    else if(wa < wb) return 1;
+    else return 0;
+}
+
+static inline void locks_profile_histogram2json(BUFFER *wb, const char *name, uint64_t *histogram) {
+    int i;
+
+    buffer_sprintf(wb, "\t\t\t\"%s\": [ ", name);
+    for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++) {
+        if(i) buffer_strcat(wb, ", ");
+        buffer_print_uint64(wb, histogram[i]);
+    }
+    buffer_strcat(wb, " ]");
+}
+
+void netdata_locks_profile2json(BUFFER *wb) {
+    struct locks_profile_sorted *sorted = mallocz(LOCKS_PROFILE_SITES * sizeof(struct locks_profile_sorted));
+    size_t i, used = 0;
+
+    for(i = 0; i < LOCKS_PROFILE_SITES ; i++) {
+        if(__atomic_load_n(&locks_profile_sites[i].file, __ATOMIC_ACQUIRE)) {
+            sorted[used].site = &locks_profile_sites[i];
+            locks_profile_copy(&sorted[used].profile, &locks_profile_sites[i].profile, 0);
+            used++;
+        }
+    }
+
+    qsort(sorted, used, sizeof(struct locks_profile_sorted), locks_profile_compare);
+
+    buffer_sprintf(wb, "{\n\t\"available\": %s,\n\t\"profiling\": %s,\n\t\"buckets\": [ ",
+#ifdef NETDATA_LOCKS_DEBUG
+            "true",
+#else
+            "false",
+#endif
+            (netdata_locks_profiling) ? "true" : "false");
+
+    for(i = 0; i < NETDATA_LOCKS_PROFILE_BUCKETS ; i++)
+        buffer_sprintf(wb, "%s\"%s\"", (i) ? ", " : "", netdata_locks_profile_buckets[i]);
+
+    buffer_strcat(wb, " ],\n\t\"sites\": [");
+
+    for(i = 0; i < used ; i++) {
+        struct locks_profile_site *site = sorted[i].site;
+        NETDATA_LOCKS_PROFILE *p = &sorted[i].profile;
+
+        buffer_sprintf(wb, "%s\n\t\t{\n\t\t\t\"file\": \"", (i) ? "," : "");
+        buffer_strcat_json_escaped(wb, site->file);
+        buffer_strcat(wb, "\",\n\t\t\t\"function\": \"");
+        buffer_strcat_json_escaped(wb, site->function);
+        buffer_sprintf(wb, "\",\n\t\t\t\"line\": %lu,\n\t\t\t\"type\": \"%s\",\n", site->line, site->type);
+        buffer_sprintf(wb, "\t\t\t\"acquisitions\": %llu,\n\t\t\t\"contended\": %llu,\n\t\t\t\"wait_usec\": %llu,\n\t\t\t\"hold_usec\": %llu,\n",
+                (unsigned long long)p->acquisitions, (unsigned long long)p->contended,
+                (unsigned long long)(p->wait_nsec / 1000), (unsigned long long)(p->hold_nsec / 1000));
+        locks_profile_histogram2json(wb, "wait_histogram", p->wait_histogram);
+        buffer_strcat(wb, ",\n");
+        locks_profile_histogram2json(wb, "hold_histogram", p->hold_histogram);
+        buffer_strcat(wb, "\n\t\t}");
+    }
+
+    buffer_strcat(wb, "\n\t]\n}");
+
+    freez(sorted);
+}
+
 // ----------------------------------------------------------------------------
 // mutex
 
@@ -107,8 +363,12 @@ int netdata_mutex_lock_debug( const char *file, const char *function, const unsi
         debug(D_LOCKS, "MUTEX_LOCK: netdata_mutex_lock(0x%p) from %lu@%s, %s()", mutex, line, file, function);
     }
 
+    uint64_t profile_started = locks_profile_start();
+
     int ret = __netdata_mutex_lock(mutex);
 
+    if(!ret) locks_profile_acquired(file, function, line, "mutex", mutex, profile_started);
+
     debug(D_LOCKS, "MUTEX_LOCK: netdata_mutex_lock(0x%p) = %d in %llu usec, from %lu@%s, %s()", mutex, ret, now_boottime_usec() - start, line, file, function);
 
     return ret;
@@ -123,8 +383,12 @@ int netdata_mutex_trylock_debug( const char *file, const char *function, const u
         debug(D_LOCKS, "MUTEX_LOCK: netdata_mutex_trylock(0x%p) from %lu@%s, %s()", mutex, line, file, function);
     }
 
+    uint64_t profile_started = locks_profile_start();
+
     int ret = __netdata_mutex_trylock(mutex);
 
+    if(!ret) locks_profile_acquired(file, function, line, "mutex", mutex, profile_started);
+
     debug(D_LOCKS, "MUTEX_LOCK: netdata_mutex_trylock(0x%p) = %d in %llu usec, from %lu@%s, %s()", mutex, ret, now_boottime_usec() - start, line, file, function);
 
     return ret;
@@ -139,6 +403,8 @@ int netdata_mutex_unlock_debug( const char *file, const char *function, const un
         debug(D_LOCKS, "MUTEX_LOCK: netdata_mutex_unlock(0x%p) from %lu@%s, %s()", mutex, line, file, function);
     }
 
+    locks_profile_released(mutex);
+
     int ret = __netdata_mutex_unlock(mutex);
 
     debug(D_LOCKS, "MUTEX_LOCK: netdata_mutex_unlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", mutex, ret, now_boottime_usec() - start, line, file, function);
@@ -260,8 +526,12 @@ int netdata_rwlock_rdlock_debug( const char *file, const char *function, const u
         debug(D_LOCKS, "RW_LOCK: netdata_rwlock_rdlock(0x%p) from %lu@%s, %s()", rwlock, line, file, function);
     }
 
+    uint64_t profile_started = locks_profile_start();
+
     int ret = __netdata_rwlock_rdlock(rwlock);
 
+    if(!ret) locks_profile_acquired(file, function, line, "rdlock", rwlock, profile_started);
+
     debug(D_LOCKS, "RW_LOCK: netdata_rwlock_rdlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", rwlock, ret, now_boottime_usec() - start, line, file, function);
 
     return ret;
@@ -276,8 +546,12 @@ int netdata_rwlock_wrlock_debug( const char *file, const char *function, const u
         debug(D_LOCKS, "RW_LOCK: netdata_rwlock_wrlock(0x%p) from %lu@%s, %s()", rwlock, line, file, function);
     }
 
+    uint64_t profile_started = locks_profile_start();
+
     int ret = __netdata_rwlock_wrlock(rwlock);
 
+    if(!ret) locks_profile_acquired(file, function, line, "wrlock", rwlock, profile_started);
+
     debug(D_LOCKS, "RW_LOCK: netdata_rwlock_wrlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", rwlock, ret, now_boottime_usec() - start, line, file, function);
 
     return ret;
@@ -292,6 +566,8 @@ int netdata_rwlock_unlock_debug( const char *file, const char *function, const u
         debug(D_LOCKS, "RW_LOCK: netdata_rwlock_unlock(0x%p) from %lu@%s, %s()", rwlock, line, file, function);
     }
 
+    locks_profile_released(rwlock);
+
     int ret = __netdata_rwlock_unlock(rwlock);
 
     debug(D_LOCKS, "RW_LOCK: netdata_rwlock_unlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", rwlock, ret, now_boottime_usec() - start, line, file, function);
@@ -308,8 +584,12 @@ int netdata_rwlock_tryrdlock_debug( const char *file, const char *function, cons
         debug(D_LOCKS, "RW_LOCK: netdata_rwlock_tryrdlock(0x%p) from %lu@%s, %s()", rwlock, line, file, function);
     }
 
+    uint64_t profile_started = locks_profile_start();
+
     int ret = __netdata_rwlock_tryrdlock(rwlock);
 
+    if(!ret) locks_profile_acquired(file, function, line, "rdlock", rwlock, profile_started);
+
     debug(D_LOCKS, "RW_LOCK: netdata_rwlock_tryrdlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", rwlock, ret, now_boottime_usec() - start, line, file, function);
 
     return ret;
@@ -324,9 +604,145 @@ int netdata_rwlock_trywrlock_debug( const char *file, const char *function, cons
         debug(D_LOCKS, "RW_LOCK: netdata_rwlock_trywrlock(0x%p) from %lu@%s, %s()", rwlock, line, file, function);
     }
 
+    uint64_t profile_started = locks_profile_start();
+
     int ret = __netdata_rwlock_trywrlock(rwlock);
 
+    if(!ret) locks_profile_acquired(file, function, line, "wrlock", rwlock, profile_started);
+
     debug(D_LOCKS, "RW_LOCK: netdata_rwlock_trywrlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", rwlock, ret, now_boottime_usec() - start, line, file, function);
 
     return ret;
 }
+
+
+// ----------------------------------------------------------------------------
+// adaptive lock
+
+static inline void adaptive_lock_cpu_relax(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline void adaptive_lock_sleep(netdata_adaptive_lock_t *lock) {
+#ifdef __linux__
+    // returns immediately if the state is not 2 anymore
+    syscall(SYS_futex, &lock->state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+#else
+    (void)lock;
+    sched_yield();
+#endif
+}
+
+static inline void adaptive_lock_wake(netdata_adaptive_lock_t *lock) {
+#ifdef __linux__
+    syscall(SYS_futex, &lock->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    (void)lock;
+#endif
+}
+
+static inline int adaptive_lock_try(netdata_adaptive_lock_t *lock) {
+    uint32_t expected = 0;
+    return __atomic_compare_exchange_n(&lock->state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// the futex mutex of "Futexes Are Tricky" (Ulrich Drepper), spinning before it sleeps
+int __netdata_adaptive_lock(netdata_adaptive_lock_t *lock) {
+    netdata_thread_disable_cancelability();
+
+    if(likely(adaptive_lock_try(lock)))
+        return 0;
+
+    int i;
+    for(i = 0; i < NETDATA_ADAPTIVE_LOCK_SPINS ; i++) {
+        adaptive_lock_cpu_relax();
+        if(!__atomic_load_n(&lock->state, __ATOMIC_RELAXED) && adaptive_lock_try(lock))
+            return 0;
+    }
+
+    // mark it as having sleeping waiters, so that the unlocking thread wakes one of us
+    while(__atomic_exchange_n(&lock->state, 2, __ATOMIC_ACQUIRE) != 0)
+        adaptive_lock_sleep(lock);
+
+    return 0;
+}
+
+int __netdata_adaptive_trylock(netdata_adaptive_lock_t *lock) {
+    netdata_thread_disable_cancelability();
+
+    if(adaptive_lock_try(lock))
+        return 0;
+
+    netdata_thread_enable_cancelability();
+    return EBUSY;
+}
+
+int __netdata_adaptive_unlock(netdata_adaptive_lock_t *lock) {
+    if(unlikely(__atomic_exchange_n(&lock->state, 0, __ATOMIC_RELEASE) == 2))
+        adaptive_lock_wake(lock);
+
+    netdata_thread_enable_cancelability();
+    return 0;
+}
+
+int netdata_adaptive_lock_debug( const char *file, const char *function, const unsigned long line, netdata_adaptive_lock_t *lock) {
+    usec_t start = 0;
+    (void)start;
+
+    if(unlikely(debug_flags & D_LOCKS)) {
+        start = now_boottime_usec();
+        debug(D_LOCKS, "ADAPTIVE_LOCK: netdata_adaptive_lock(0x%p) from %lu@%s, %s()", lock, line, file, function);
+    }
+
+    uint64_t profile_started = locks_profile_start();
+
+    int ret = __netdata_adaptive_lock(lock);
+
+    if(!ret) locks_profile_acquired(file, function, line, "adaptive", lock, profile_started);
+
+    debug(D_LOCKS, "ADAPTIVE_LOCK: netdata_adaptive_lock(0x%p) = %d in %llu usec, from %lu@%s, %s()", lock, ret, now_boottime_usec() - start, line, file, function);
+
+    return ret;
+}
+
+int netdata_adaptive_trylock_debug( const char *file, const char *function, const unsigned long line, netdata_adaptive_lock_t *lock) {
+    usec_t start = 0;
+    (void)start;
+
+    if(unlikely(debug_flags & D_LOCKS)) {
+        start = now_boottime_usec();
+        debug(D_LOCKS, "ADAPTIVE_LOCK: netdata_adaptive_trylock(0x%p) from %lu@%s, %s()", lock, line, file, function);
+    }
+
+    uint64_t profile_started = locks_profile_start();
+
+    int ret = __netdata_adaptive_trylock(lock);
+
+    if(!ret) locks_profile_acquired(file, function, line, "adaptive", lock, profile_started);
+
+    debug(D_LOCKS, "ADAPTIVE_LOCK: netdata_adaptive_trylock(0x%p) = %d in %llu usec, from %lu@%s, %s()", lock, ret, now_boottime_usec() - start, line, file, function);
+
+    return ret;
+}
+
+int netdata_adaptive_unlock_debug( const char *file, const char *function, const unsigned long line, netdata_adaptive_lock_t *lock) {
+    usec_t start = 0;
+    (void)start;
+
+    if(unlikely(debug_flags & D_LOCKS)) {
+        start = now_boottime_usec();
+        debug(D_LOCKS, "ADAPTIVE_LOCK: netdata_adaptive_unlock(0x%p) from %lu@%s, %s()", lock, line, file, function);
+    }
+
+    locks_profile_released(lock);
+
+    int ret = __netdata_adaptive_unlock(lock);
+
+    debug(D_LOCKS, "ADAPTIVE_LOCK: netdata_adaptive_unlock(0x%p) = %d in %llu usec, from %lu@%s, %s()", lock, ret, now_boottime_usec() - start, line, file, function);
+
+    return ret;
+}
@@ -37,10 +37,89 @@ extern int netdata_rwlock_unlock_debug( const char *file, const char *function,
 extern int netdata_rwlock_tryrdlock_debug( const char *file, const char *function, const unsigned long line, netdata_rwlock_t *rwlock);
 extern int netdata_rwlock_trywrlock_debug( const char *file, const char *function, const unsigned long line, netdata_rwlock_t *rwlock);
 
+// ----------------------------------------------------------------------------
+// adaptive locks
+// a mutex for short critical sections: a thread that finds it locked spins for
+// a while, expecting it to be released soon, before it sleeps on a futex
+// (on other systems than linux, it yields the cpu instead)
+
+typedef struct netdata_adaptive_lock {
+    uint32_t state;     // 0 = unlocked, 1 = locked, 2 = locked with sleeping waiters
+} netdata_adaptive_lock_t;
+
+#define NETDATA_ADAPTIVE_LOCK_INITIALIZER { .state = 0 }
+#define NETDATA_ADAPTIVE_LOCK_SPINS 200
+
+extern int __netdata_adaptive_lock(netdata_adaptive_lock_t *lock);
+extern int __netdata_adaptive_trylock(netdata_adaptive_lock_t *lock);
+extern int __netdata_adaptive_unlock(netdata_adaptive_lock_t *lock);
+
+extern int netdata_adaptive_lock_debug( const char *file, const char *function, const unsigned long line, netdata_adaptive_lock_t *lock);
+extern int netdata_adaptive_trylock_debug( const char *file, const char *function, const unsigned long line, netdata_adaptive_lock_t *lock);
+extern int netdata_adaptive_unlock_debug( const char *file, const char *function, const unsigned long line, netdata_adaptive_lock_t *lock);
+
+// ----------------------------------------------------------------------------
+// lock profiling
+// when netdata is built with NETDATA_INTERNAL_CHECKS or NETDATA_LOCK_PROFILING
+// (./configure --enable-lock-profiling), all the locks go through the _debug()
+// functions, that - while netdata_locks_profiling is set - also record how long
+// each call site waited for its locks and how long it held them
+
+#if defined(NETDATA_INTERNAL_CHECKS) || defined(NETDATA_LOCK_PROFILING)
+#define NETDATA_LOCKS_DEBUG 1
+#endif
+
+#define NETDATA_LOCKS_PROFILE_BUCKETS 16    // the histograms: < 1us, < 2us, < 4us, ... < 16ms, more
+
+typedef struct netdata_locks_profile {
+    uint64_t acquisitions;
+    uint64_t contended;                     // the acquisitions that waited at least 1us
+    uint64_t wait_nsec;
+    uint64_t hold_nsec;
+    uint64_t wait_histogram[NETDATA_LOCKS_PROFILE_BUCKETS];
+    uint64_t hold_histogram[NETDATA_LOCKS_PROFILE_BUCKETS];
+} NETDATA_LOCKS_PROFILE;
+
+extern int netdata_locks_profiling;
+extern const char *netdata_locks_profile_buckets[NETDATA_LOCKS_PROFILE_BUCKETS];
+
+// the sum of all the call sites
+extern void netdata_locks_profile_totals(NETDATA_LOCKS_PROFILE *totals);
+
+// all the call sites, the ones that waited longer first
+extern void netdata_locks_profile2json(BUFFER *wb);
+
 extern void netdata_thread_disable_cancelability(void);
 extern void netdata_thread_enable_cancelability(void);
 
-#ifdef NETDATA_INTERNAL_CHECKS
+// ----------------------------------------------------------------------------
+// epochs
+// the readers of a structure protected by an epoch do not lock; they count
+// themselves in the reader counter of the current epoch, while the writers
+// (that have to be serialized by another lock) wait in netdata_epoch_synchronize()
+// until all the readers that could see what they removed are gone
+
+typedef struct netdata_epoch {
+    uint32_t epoch;
+    uint32_t readers[2];
+} netdata_epoch_t;
+
+#define NETDATA_EPOCH_INITIALIZER { .epoch = 0, .readers = { 0, 0 } }
+
+static inline unsigned netdata_epoch_read_lock(netdata_epoch_t *e) {
+    unsigned reader = __atomic_load_n(&e->epoch, __ATOMIC_SEQ_CST) & 1;
+    __atomic_add_fetch(&e->readers[reader], 1, __ATOMIC_SEQ_CST);
+    return reader;
+}
+
+static inline void netdata_epoch_read_unlock(netdata_epoch_t *e, unsigned reader) {
+    __atomic_sub_fetch(&e->readers[reader], 1, __ATOMIC_RELEASE);
+}
+
+extern void netdata_epoch_init(netdata_epoch_t *e);
+extern void netdata_epoch_synchronize(netdata_epoch_t *e);
+
+#ifdef NETDATA_LOCKS_DEBUG
 
 #define netdata_mutex_init(mutex)    netdata_mutex_init_debug(__FILE__, __FUNCTION__, __LINE__, mutex)
 #define netdata_mutex_lock(mutex)    netdata_mutex_lock_debug(__FILE__, __FUNCTION__, __LINE__, mutex)
@@ -55,7 +134,11 @@ extern void netdata_thread_enable_cancelability(void);
 #define netdata_rwlock_tryrdlock(rwlock) netdata_rwlock_tryrdlock_debug(__FILE__, __FUNCTION__, __LINE__, rwlock)
 #define netdata_rwlock_trywrlock(rwlock) netdata_rwlock_trywrlock_debug(__FILE__, __FUNCTION__, __LINE__, rwlock)
 
-#else // !NETDATA_INTERNAL_CHECKS
+#define netdata_adaptive_lock(lock)      netdata_adaptive_lock_debug(__FILE__, __FUNCTION__, __LINE__, lock)
+#define netdata_adaptive_trylock(lock)   netdata_adaptive_trylock_debug(__FILE__, __FUNCTION__, __LINE__, lock)
+#define netdata_adaptive_unlock(lock)    netdata_adaptive_unlock_debug(__FILE__, __FUNCTION__, __LINE__, lock)
+
+#else // !NETDATA_LOCKS_DEBUG
 
 #define netdata_mutex_init(mutex)    __netdata_mutex_init(mutex)
 #define netdata_mutex_lock(mutex)    __netdata_mutex_lock(mutex)
@@ -70,6 +153,10 @@ extern void netdata_thread_enable_cancelability(void);
 #define netdata_rwlock_tryrdlock(rwlock)  __netdata_rwlock_tryrdlock(rwlock)
 #define netdata_rwlock_trywrlock(rwlock)  __netdata_rwlock_trywrlock(rwlock)
 
-#endif // NETDATA_INTERNAL_CHECKS
+#define netdata_adaptive_lock(lock)       __netdata_adaptive_lock(lock)
+#define netdata_adaptive_trylock(lock)    __netdata_adaptive_trylock(lock)
+#define netdata_adaptive_unlock(lock)     __netdata_adaptive_unlock(lock)
+
+#endif // NETDATA_LOCKS_DEBUG
 
 #endif //NETDATA_LOCKS_H
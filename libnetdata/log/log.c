@@ -445,14 +445,11 @@ void syslog_init() {
 
 #define LOG_DATE_LENGTH 26
 
-static inline void log_date(char *buffer, size_t len) {
+static inline void log_date_at(char *buffer, size_t len, time_t t) {
     if(unlikely(!buffer || !len))
         return;
 
-    time_t t;
     struct tm *tmp, tmbuf;
-
-    t = now_realtime_sec();
     tmp = localtime_r(&t, &tmbuf);
 
     if (tmp == NULL) {
@@ -466,6 +463,10 @@ static inline void log_date(char *buffer, size_t len) {
     buffer[len - 1] = '\0';
 }
 
+static inline void log_date(char *buffer, size_t len) {
+    log_date_at(buffer, len, now_realtime_coarse_sec());
+}
+
 static netdata_mutex_t log_mutex = NETDATA_MUTEX_INITIALIZER;
 static inline void log_lock() {
     netdata_mutex_lock(&log_mutex);
@@ -575,6 +576,223 @@ void open_all_log_files() {
     stdaccess = open_log_file(stdaccess_fd, stdaccess, stdaccess_filename, &access_log_syslog, 1, &stdaccess_fd);
 }
 
+// ----------------------------------------------------------------------------
+// asynchronous log
+//
+// When the log writer thread runs, info_int(), error_int() and log_access()
+// format their line on the caller's thread without the date, and queue it to
+// a ring of slots shared by all threads. The writer thread adds the date
+// (formatted once per second) and writes the lines to their files.
+//
+// The ring is a bounded multi-producer single-consumer queue: a producer
+// claims a slot by advancing the tail with a CAS, and publishes it by
+// updating the sequence of the slot. When the ring is full, the line is
+// dropped and counted, so that logging never blocks. The writer reports the
+// dropped lines in the log.
+//
+// Lines that do not fit in a slot, and all lines when the writer thread does
+// not run (the plugins, the startup and the shutdown of netdata), are written
+// synchronously by the caller, like before.
+
+#define LOG_ASYNC_SLOTS 1024                // must be a power of 2
+#define LOG_ASYNC_LINE_MAX 1024
+#define LOG_ASYNC_IDLE_USEC (20 * USEC_PER_MS)
+
+typedef enum log_async_target {
+    LOG_ASYNC_STDERR,
+    LOG_ASYNC_STDACCESS
+} LOG_ASYNC_TARGET;
+
+struct log_async_slot {
+    uint64_t sequence;          // the position it can be written (== position) or read (== position + 1) at
+    time_t when;
+    LOG_ASYNC_TARGET target;
+    size_t len;
+    char line[LOG_ASYNC_LINE_MAX];
+};
+
+static struct log_async {
+    int enabled;
+    int exit;
+
+    uint64_t tail;              // the next position to be claimed by the producers
+    uint64_t head;              // the next position to be written by the writer
+
+    unsigned long long dropped;
+    unsigned long long dropped_reported;
+
+    netdata_thread_t thread;
+    struct log_async_slot *slots;
+} log_async = {
+        .enabled = 0,
+        .exit = 0,
+        .tail = 0,
+        .head = 0,
+        .dropped = 0,
+        .dropped_reported = 0,
+        .slots = NULL
+};
+
+static inline int log_async_enabled(void) {
+    return __atomic_load_n(&log_async.enabled, __ATOMIC_ACQUIRE);
+}
+
+// appends to a line, keeping its length even when it does not fit
+static inline void log_async_vappend(char *line, size_t *len, const char *fmt, va_list args) {
+    size_t size = (*len < LOG_ASYNC_LINE_MAX) ? LOG_ASYNC_LINE_MAX - *len : 0;
+    int ret = vsnprintf(size ? &line[*len] : NULL, size, fmt, args);
+    if(ret > 0) *len += (size_t)ret;
+}
+
+static inline void log_async_append(char *line, size_t *len, const char *fmt, ...) PRINTFLIKE(3, 4);
+static inline void log_async_append(char *line, size_t *len, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_async_vappend(line, len, fmt, args);
+    va_end(args);
+}
+
+// queues a line to the writer thread
+// returns 0 when the line has to be written synchronously
+static int log_async_queue(LOG_ASYNC_TARGET target, const char *line, size_t len) {
+    if(unlikely(len >= LOG_ASYNC_LINE_MAX || !log_async_enabled()))
+        return 0;
+
+    struct log_async_slot *slot;
+    uint64_t pos = __atomic_load_n(&log_async.tail, __ATOMIC_RELAXED);
+
+    for(;;) {
+        slot = &log_async.slots[pos & (LOG_ASYNC_SLOTS - 1)];
+        int64_t diff = (int64_t)__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - (int64_t)pos;
+
+        if(likely(diff == 0)) {
+            if(__atomic_compare_exchange_n(&log_async.tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if(diff < 0) {
+            // the ring is full
+            __atomic_add_fetch(&log_async.dropped, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+        else
+            pos = __atomic_load_n(&log_async.tail, __ATOMIC_RELAXED);
+    }
+
+    slot->when = now_realtime_coarse_sec();
+    slot->target = target;
+    slot->len = len;
+    memcpy(slot->line, line, len + 1);
+
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// writes the queued lines, returns the number of lines written
+static size_t log_async_write(void) {
+    static time_t last = 0;
+    static char date[LOG_DATE_LENGTH] = "";
+    size_t lines = 0;
+
+    // the long lines are still written synchronously by their callers
+    log_lock();
+
+    for(;; lines++) {
+        struct log_async_slot *slot = &log_async.slots[log_async.head & (LOG_ASYNC_SLOTS - 1)];
+        if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != log_async.head + 1)
+            break;
+
+        if(unlikely(slot->when != last)) {
+            log_date_at(date, LOG_DATE_LENGTH, slot->when);
+            last = slot->when;
+        }
+
+        FILE *fp = (slot->target == LOG_ASYNC_STDACCESS) ? stdaccess : stderr;
+        if(likely(fp)) {
+            fputs(date, fp);
+            fputs(": ", fp);
+            fwrite(slot->line, 1, slot->len, fp);
+            fputc('\n', fp);
+        }
+
+        __atomic_store_n(&slot->sequence, log_async.head + LOG_ASYNC_SLOTS, __ATOMIC_RELEASE);
+        log_async.head++;
+    }
+
+    unsigned long long dropped = __atomic_load_n(&log_async.dropped, __ATOMIC_RELAXED);
+    if(unlikely(dropped != log_async.dropped_reported)) {
+        log_date(date, LOG_DATE_LENGTH);
+        last = 0;
+        fprintf(stderr, "%s: %s LOG   : the log writer could not keep up, %llu log lines have been dropped.\n"
+                , date
+                , program_name
+                , dropped - log_async.dropped_reported
+        );
+        log_async.dropped_reported = dropped;
+    }
+
+    if(lines) {
+        fflush(stderr);
+        if(stdaccess) fflush(stdaccess);
+    }
+
+    log_unlock();
+
+    return lines;
+}
+
+static void *log_async_thread(void *ptr) {
+    (void)ptr;
+
+    for(;;) {
+        if(!log_async_write()) {
+            // exit when all the claimed slots have been written
+            if(__atomic_load_n(&log_async.exit, __ATOMIC_ACQUIRE)
+               && __atomic_load_n(&log_async.tail, __ATOMIC_ACQUIRE) == log_async.head)
+                break;
+
+            sleep_usec(LOG_ASYNC_IDLE_USEC);
+        }
+    }
+
+    return NULL;
+}
+
+void log_async_start(void) {
+    if(log_async.slots)
+        return;
+
+    log_async.slots = callocz(LOG_ASYNC_SLOTS, sizeof(struct log_async_slot));
+
+    size_t i;
+    for(i = 0; i < LOG_ASYNC_SLOTS ; i++)
+        log_async.slots[i].sequence = i;
+
+    log_async.tail = log_async.head = 0;
+    log_async.exit = 0;
+
+    if(netdata_thread_create(&log_async.thread, "LOG_WRITER", NETDATA_THREAD_OPTION_JOINABLE | NETDATA_THREAD_OPTION_DONT_LOG, log_async_thread, NULL) != 0) {
+        error("Cannot create the log writer thread. Logging synchronously.");
+        freez(log_async.slots);
+        log_async.slots = NULL;
+        return;
+    }
+
+    __atomic_store_n(&log_async.enabled, 1, __ATOMIC_RELEASE);
+}
+
+// writes all the queued lines and stops the writer thread
+// the lines logged after it are written synchronously
+void log_async_stop(void) {
+    if(!__atomic_exchange_n(&log_async.enabled, 0, __ATOMIC_ACQ_REL))
+        return;
+
+    // the writer exits after writing the lines already queued
+    __atomic_store_n(&log_async.exit, 1, __ATOMIC_RELEASE);
+    netdata_thread_join(log_async.thread, NULL);
+
+    // the slots are not freed, a thread may still be queueing a line
+}
+
 // ----------------------------------------------------------------------------
 // error log throttling
 
@@ -600,7 +818,7 @@ int error_log_limit(int reset) {
         return 1;
 #endif
 
-    time_t now = now_monotonic_sec();
+    time_t now = now_monotonic_coarse_sec();
     if(!start) start = now;
 
     if(reset) {
@@ -714,6 +932,21 @@ void info_int( const char *file, const char *function, const unsigned long line,
         va_end( args );
     }
 
+    if(log_async_enabled()) {
+        char buffer[LOG_ASYNC_LINE_MAX];
+        size_t len = 0;
+
+        if(debug_flags) log_async_append(buffer, &len, "%s INFO  : %s : (%04lu@%-10.10s:%-15.15s): ", program_name, netdata_thread_tag(), line, file, function);
+        else            log_async_append(buffer, &len, "%s INFO  : %s : ", program_name, netdata_thread_tag());
+
+        va_start( args, fmt );
+        log_async_vappend(buffer, &len, fmt, args);
+        va_end( args );
+
+        if(log_async_queue(LOG_ASYNC_STDERR, buffer, len))
+            return;
+    }
+
     char date[LOG_DATE_LENGTH];
     log_date(date, LOG_DATE_LENGTH);
 
@@ -770,6 +1003,28 @@ void error_int( const char *prefix, const char *file, const char *function, cons
         va_end( args );
     }
 
+    if(log_async_enabled()) {
+        char buffer[LOG_ASYNC_LINE_MAX];
+        size_t len = 0;
+
+        if(debug_flags) log_async_append(buffer, &len, "%s %-5.5s : %s : (%04lu@%-10.10s:%-15.15s): ", program_name, prefix, netdata_thread_tag(), line, file, function);
+        else            log_async_append(buffer, &len, "%s %-5.5s : %s : ", program_name, prefix, netdata_thread_tag());
+
+        va_start( args, fmt );
+        log_async_vappend(buffer, &len, fmt, args);
+        va_end( args );
+
+        if(__errno) {
+            char buf[1024];
+            log_async_append(buffer, &len, " (errno %d, %s)", __errno, strerror_result(strerror_r(__errno, buf, 1023), buf));
+        }
+
+        if(log_async_queue(LOG_ASYNC_STDERR, buffer, len)) {
+            if(__errno) errno = 0;
+            return;
+        }
+    }
+
     char date[LOG_DATE_LENGTH];
     log_date(date, LOG_DATE_LENGTH);
 
@@ -803,6 +1058,9 @@ void fatal_int( const char *file, const char *function, const unsigned long line
         va_end( args );
     }
 
+    // write everything logged before it, and log synchronously from now on
+    log_async_stop();
+
     char date[LOG_DATE_LENGTH];
     log_date(date, LOG_DATE_LENGTH);
 
@@ -840,6 +1098,18 @@ void log_access( const char *fmt, ... ) {
         va_end( args );
     }
 
+    if(stdaccess && log_async_enabled()) {
+        char buffer[LOG_ASYNC_LINE_MAX];
+        size_t len = 0;
+
+        va_start( args, fmt );
+        log_async_vappend(buffer, &len, fmt, args);
+        va_end( args );
+
+        if(log_async_queue(LOG_ASYNC_STDACCESS, buffer, len))
+            return;
+    }
+
     if(stdaccess) {
         static netdata_mutex_t access_mutex = NETDATA_MUTEX_INITIALIZER;
 
@@ -68,6 +68,9 @@ extern int error_log_limit(int reset);
 extern void open_all_log_files();
 extern void reopen_all_log_files();
 
+extern void log_async_start(void);
+extern void log_async_stop(void);
+
 static inline void debug_dummy(void) {}
 
 #define error_log_limit_reset() do { error_log_errors_per_period = error_log_errors_per_period_backup; error_log_limit(1); } while(0)
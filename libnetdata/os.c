@@ -148,6 +148,8 @@ int getsysctl_simple(const char *name, int *mib, size_t miblen, void *ptr, size_
 
     if (unlikely(sysctl(mib, miblen, ptr, &nlen, NULL, 0) == -1)) {
         error("FREEBSD: sysctl(%s...) failed: %s", name, strerror(errno));
+        // the MIB may have changed (e.g. a kernel module was reloaded) - resolve it again next time
+        mib[0] = 0;
         return 1;
     }
     if (unlikely(nlen != len)) {
@@ -167,6 +169,7 @@ int getsysctl(const char *name, int *mib, size_t miblen, void *ptr, size_t *len)
 
     if (unlikely(sysctl(mib, miblen, ptr, len, NULL, 0) == -1)) {
         error("FREEBSD: sysctl(%s...) failed: %s", name, strerror(errno));
+        mib[0] = 0;
         return 1;
     }
     if (unlikely(ptr != NULL && nlen != *len)) {
@@ -182,10 +185,12 @@ int getsysctl_mib(const char *name, int *mib, size_t len) {
 
     if (unlikely(sysctlnametomib(name, mib, &nlen) == -1)) {
         error("FREEBSD: sysctl(%s...) failed: %s", name, strerror(errno));
+        mib[0] = 0;
         return 1;
     }
     if (unlikely(nlen != len)) {
         error("FREEBSD: sysctl(%s...) expected %lu, got %lu", name, (unsigned long)len, (unsigned long)nlen);
+        mib[0] = 0;
         return 1;
     }
     return 0;
@@ -45,7 +45,136 @@ static void mypopen_del(FILE *fp) {
 #define PIPE_READ 0
 #define PIPE_WRITE 1
 
-FILE *mypopen(const char *command, volatile pid_t *pidptr)
+#if defined(HAVE_POSIX_SPAWN) && defined(HAVE_SPAWN_H) && !defined(DETACH_PLUGINS_FROM_NETDATA)
+#define MYPOPEN_POSIX_SPAWN 1
+#endif
+
+// ----------------------------------------------------------------------------
+// posix_spawn() based popen
+//
+// fork() copies the page tables of netdata, which may be huge (the page cache of
+// dbengine, the mmapped files of the database), so every plugin, notification or
+// cgroup name lookup would stall netdata for a while. posix_spawn() creates the
+// child with vfork() semantics (clone(CLONE_VM|CLONE_VFORK) on linux), so the
+// memory of netdata is not copied. The child cannot run our code between fork()
+// and exec(), so whatever it did is prepared as spawn file actions and attributes.
+
+#ifdef MYPOPEN_POSIX_SPAWN
+#include <spawn.h>
+
+extern char **environ;
+
+// the child keeps only stdin, stdout (the pipe) and stderr open
+static int mypopen_close_files(posix_spawn_file_actions_t *fa) {
+#if defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP)
+    return posix_spawn_file_actions_addclosefrom_np(fa, STDERR_FILENO + 1);
+#else
+    int fd, ret = 0;
+
+#ifdef __linux__
+    // only the files that are open, instead of all the possible file descriptors
+    DIR *dir = opendir("/proc/self/fd");
+    if(dir) {
+        int dfd = dirfd(dir);
+        struct dirent *de;
+
+        while((de = readdir(dir)) && !ret) {
+            if(de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+
+            fd = str2i(de->d_name);
+            if(fd > STDERR_FILENO && fd != dfd)
+                ret = posix_spawn_file_actions_addclose(fa, fd);
+        }
+
+        closedir(dir);
+        return ret;
+    }
+#endif
+
+    int max = (int)sysconf(_SC_OPEN_MAX);
+    for(fd = STDERR_FILENO + 1; fd < max && !ret; fd++)
+        if(fcntl(fd, F_GETFD) != -1)
+            ret = posix_spawn_file_actions_addclose(fa, fd);
+
+    return ret;
+#endif
+}
+
+static FILE *mypopene_spawn(const char *command, volatile pid_t *pidptr, char **env) {
+    int pipefd[2];
+    FILE *fp = NULL;
+    pid_t pid;
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+
+    if(pipe(pipefd) == -1)
+        return NULL;
+
+    if(posix_spawn_file_actions_init(&fa)) {
+        error("POPEN: Cannot initialize the spawn file actions for command '%s'.", command);
+        goto cleanup_pipe;
+    }
+
+    if(posix_spawnattr_init(&attr)) {
+        error("POPEN: Cannot initialize the spawn attributes for command '%s'.", command);
+        goto cleanup_actions;
+    }
+
+    // move the pipe to stdout and close all files
+    if(posix_spawn_file_actions_adddup2(&fa, pipefd[PIPE_WRITE], STDOUT_FILENO) || mypopen_close_files(&fa)) {
+        error("POPEN: Cannot prepare the files of command '%s'.", command);
+        goto cleanup_attr;
+    }
+
+    // reset all signals - like signals_unblock() and signals_reset() do
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigfillset(&mask);
+    sigdelset(&mask, SIGKILL);
+    sigdelset(&mask, SIGSTOP);
+    posix_spawnattr_setsigdefault(&attr, &mask);
+
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    debug(D_CHILDS, "executing command: '%s'.", command);
+
+    char *argv[] = { "sh", "-c", (char *)command, NULL };
+    int ret = posix_spawn(&pid, "/bin/sh", &fa, &attr, argv, env ? env : environ);
+    if(ret) {
+        errno = ret;
+        error("POPEN: Cannot spawn command '%s'.", command);
+        goto cleanup_attr;
+    }
+
+    *pidptr = pid;
+    debug(D_CHILDS, "command '%s' runs on pid %d.", command, (int)pid);
+
+    close(pipefd[PIPE_WRITE]);
+    pipefd[PIPE_WRITE] = -1;
+    fp = fdopen(pipefd[PIPE_READ], "r");
+
+cleanup_attr:
+    posix_spawnattr_destroy(&attr);
+cleanup_actions:
+    posix_spawn_file_actions_destroy(&fa);
+cleanup_pipe:
+    if(!fp) {
+        close(pipefd[PIPE_READ]);
+        if(pipefd[PIPE_WRITE] != -1) close(pipefd[PIPE_WRITE]);
+    }
+    return fp;
+}
+#endif // MYPOPEN_POSIX_SPAWN
+
+// ----------------------------------------------------------------------------
+// fork() based popen
+
+static FILE *mypopen_fork(const char *command, volatile pid_t *pidptr)
 {
     int pipefd[2];
 
@@ -115,7 +244,7 @@ FILE *mypopen(const char *command, volatile pid_t *pidptr)
     exit(1);
 }
 
-FILE *mypopene(const char *command, volatile pid_t *pidptr, char **env) {
+static FILE *mypopene_fork(const char *command, volatile pid_t *pidptr, char **env) {
     int pipefd[2];
 
     if(pipe(pipefd) == -1)
@@ -151,6 +280,26 @@ FILE *mypopene(const char *command, volatile pid_t *pidptr, char **env) {
     exit(1);
 }
 
+// ----------------------------------------------------------------------------
+
+FILE *mypopen(const char *command, volatile pid_t *pidptr) {
+#ifdef MYPOPEN_POSIX_SPAWN
+    FILE *fp = mypopene_spawn(command, pidptr, NULL);
+    if(likely(fp)) return fp;
+    error("POPEN: falling back to fork() for command '%s'.", command);
+#endif
+    return mypopen_fork(command, pidptr);
+}
+
+FILE *mypopene(const char *command, volatile pid_t *pidptr, char **env) {
+#ifdef MYPOPEN_POSIX_SPAWN
+    FILE *fp = mypopene_spawn(command, pidptr, env);
+    if(likely(fp)) return fp;
+    error("POPEN: falling back to fork() for command '%s'.", command);
+#endif
+    return mypopene_fork(command, pidptr, env);
+}
+
 int mypclose(FILE *fp, pid_t pid) {
     debug(D_EXIT, "Request to mypclose() on pid %d", pid);
 
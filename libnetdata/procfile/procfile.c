@@ -2,6 +2,14 @@
 
 #include "../libnetdata.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PROCFILE_SIMD_SCAN 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PROCFILE_SIMD_SCAN 1
+#endif
+
 #define PF_PREFIX "PROCFILE"
 
 #define PFWORDS_INCREASE_STEP 200
@@ -138,10 +146,163 @@ void procfile_close(procfile *ff) {
     if(likely(ff->lines)) pflines_free(ff->lines);
     if(likely(ff->words)) pfwords_free(ff->words);
 
-    if(likely(ff->fd != -1)) close(ff->fd);
+    if(likely(ff->fd != -1 && !(ff->flags & PROCFILE_FLAG_BORROWED_FD))) close(ff->fd);
     freez(ff);
 }
 
+// ----------------------------------------------------------------------------
+// Parsing with SIMD
+//
+// Most of the characters of the files are words, and the parser only has
+// something to do at the characters that are not. With the default character
+// types, these are the control characters, the space, the bytes above 0x7e and
+// the few printable separators given. So, for the files that have no quotes
+// and no open / close characters (all the files of proc.plugin), the data are
+// classified 64 characters at a time with SIMD, into a bitmap of the
+// characters that are not words, and the parser jumps from one of them to the
+// next, instead of checking the type of every character.
+
+static void procfile_update_word_stops(procfile *ff) {
+    PF_CHAR_TYPE *ffs = ff->separators;
+    ff->word_stops_len = 0;
+
+    int i;
+    for(i = 0; i < 256 ; i++) {
+        int special = (i < 0x21 || i > 0x7e);
+
+        if(unlikely((special && ffs[i] == PF_CHAR_IS_WORD) || ffs[i] == PF_CHAR_IS_QUOTE || ffs[i] == PF_CHAR_IS_OPEN || ffs[i] == PF_CHAR_IS_CLOSE)) {
+            // parse it byte by byte
+            ff->word_stops_len = PROCFILE_WORD_STOPS_MAX + 1;
+            return;
+        }
+
+        if(!special && ffs[i] != PF_CHAR_IS_WORD) {
+            if(unlikely(ff->word_stops_len == PROCFILE_WORD_STOPS_MAX)) {
+                ff->word_stops_len = PROCFILE_WORD_STOPS_MAX + 1;
+                return;
+            }
+
+            ff->word_stops[ff->word_stops_len++] = (char)i;
+        }
+    }
+}
+
+#ifdef PROCFILE_SIMD_SCAN
+// the bitmap of the characters that are not words, of the 64 characters at s
+static inline uint64_t procfile_word_stops_bitmap(procfile *ff, const char *s) {
+    uint64_t bitmap = 0;
+    size_t i, stops = ff->word_stops_len;
+    int part;
+
+    for(part = 0; part < 4 ; part++, s += 16) {
+#if defined(__SSE2__)
+        // the bytes below 0x21 or above 0x7f are less than 0x21 as signed
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        __m128i m = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x21)), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+
+        for(i = 0; i < stops ; i++)
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(ff->word_stops[i])));
+
+        bitmap |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << (part * 16);
+#else
+        static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+
+        int8x16_t v = vld1q_s8((const int8_t *)s);
+        uint8x16_t m = vorrq_u8(vcltq_s8(v, vdupq_n_s8(0x21)), vceqq_s8(v, vdupq_n_s8(0x7f)));
+
+        for(i = 0; i < stops ; i++)
+            m = vorrq_u8(m, vceqq_s8(v, vdupq_n_s8(ff->word_stops[i])));
+
+        // one bit per byte, like _mm_movemask_epi8()
+        uint8x16_t b = vandq_u8(m, vld1q_u8(bits));
+        uint64_t lo = vaddv_u8(vget_low_u8(b)), hi = vaddv_u8(vget_high_u8(b));
+        bitmap |= (lo | (hi << 8)) << (part * 16);
+#endif
+    }
+
+    return bitmap;
+}
+
+// procfile_parser() for files that have only words, separators and newlines
+NOINLINE
+static void procfile_parser_simd(procfile *ff) {
+    char  *s = ff->data                 // the block we classify
+        , *e = &ff->data[ff->len]       // the terminating null
+        , *t = ff->data                 // the first character of a word
+        , *p;                           // a character that is not a word
+
+    PF_CHAR_TYPE *separators = ff->separators;
+
+    size_t *line_words = pflines_add(ff);
+
+    for(; s + 64 <= e ; s += 64) {
+        uint64_t bitmap = procfile_word_stops_bitmap(ff, s);
+
+        while(bitmap) {
+            p = s + __builtin_ctzll(bitmap);
+            bitmap &= bitmap - 1;
+
+            if(unlikely(separators[(unsigned char)(*p)] == PF_CHAR_IS_NEWLINE)) {
+                // end of line
+                *p = '\0';
+                pfwords_add(ff, t);
+                (*line_words)++;
+                t = p + 1;
+
+                line_words = pflines_add(ff);
+            }
+            else {
+                if(p != t) {
+                    // separator, but we have word before it
+                    *p = '\0';
+                    pfwords_add(ff, t);
+                    (*line_words)++;
+                }
+                t = p + 1;
+            }
+        }
+    }
+
+    // the last characters, less than a block
+    for(p = s; p < e ; p++) {
+        PF_CHAR_TYPE ct = separators[(unsigned char)(*p)];
+
+        if(likely(ct == PF_CHAR_IS_WORD))
+            continue;
+
+        if(unlikely(ct == PF_CHAR_IS_NEWLINE)) {
+            *p = '\0';
+            pfwords_add(ff, t);
+            (*line_words)++;
+            t = p + 1;
+
+            line_words = pflines_add(ff);
+        }
+        else {
+            if(p != t) {
+                *p = '\0';
+                pfwords_add(ff, t);
+                (*line_words)++;
+            }
+            t = p + 1;
+        }
+    }
+
+    if(likely(e > t)) {
+        // the last word
+        p = e;
+        if(unlikely(ff->len >= ff->size)) {
+            // we are going to loose the last byte
+            p = &ff->data[ff->size - 1];
+        }
+
+        *p = '\0';
+        pfwords_add(ff, t);
+        (*line_words)++;
+    }
+}
+#endif
+
 NOINLINE
 static void procfile_parser(procfile *ff) {
     // debug(D_PROCFILE, PF_PREFIX ": Parsing file '%s'", ff->filename);
@@ -262,23 +423,115 @@ static void procfile_parser(procfile *ff) {
     }
 }
 
+// ----------------------------------------------------------------------------
+// Lazy lines
+
+// find the lines, to be split into words by procfile_split_line()
+NOINLINE
+static void procfile_parser_lazy(procfile *ff) {
+    char *s = ff->data, *e = &ff->data[ff->len], *n;
+
+    while(1) {
+        n = memchr(s, '\n', (size_t)(e - s));
+
+        *pflines_add(ff) = PROCFILE_LINE_NOT_SPLIT;
+
+        ffline *ffl = &ff->lines->lines[ff->lines->len - 1];
+        ffl->start = (size_t)(s - ff->data);
+        ffl->end = (size_t)(((n) ? n : e) - ff->data);
+
+        if(!n) break;
+
+        *n = '\0';
+        s = n + 1;
+    }
+}
+
+void procfile_split_line(procfile *ff, size_t line) {
+    ffline *ffl = &ff->lines->lines[line];
+
+    char  *s = &ff->data[ffl->start]    // our current position
+        , *e = &ff->data[ffl->end]      // the end of the line
+        , *t = s;                       // the first character of a word
+
+    PF_CHAR_TYPE *separators = ff->separators;
+
+    ffl->words = 0;
+    ffl->first = ff->words->len;
+
+    // quotes and parenthesis are not supported - they are separators here
+    for(; s < e ; s++) {
+        if(likely(separators[(unsigned char)(*s)] == PF_CHAR_IS_WORD))
+            continue;
+
+        if(s != t) {
+            *s = '\0';
+            pfwords_add(ff, t);
+            ffl->words++;
+        }
+        t = s + 1;
+    }
+
+    // the last word - the parser adds it, even when empty, if the line ends with a newline
+    if(s > t || ffl->end < ff->len) {
+        if(unlikely(ffl->end >= ff->size)) {
+            // we are going to loose the last byte
+            s = &ff->data[ff->size - 1];
+        }
+
+        *s = '\0';
+        pfwords_add(ff, t);
+        ffl->words++;
+    }
+}
+
+// split the data read into lines and words
+static void procfile_parse(procfile *ff) {
+    pflines_reset(ff->lines);
+    pfwords_reset(ff->words);
+
+    if(unlikely(ff->flags & PROCFILE_FLAG_LAZY_LINES))
+        procfile_parser_lazy(ff);
+    else
+#ifdef PROCFILE_SIMD_SCAN
+    if(likely(ff->word_stops_len <= PROCFILE_WORD_STOPS_MAX))
+        procfile_parser_simd(ff);
+    else
+#endif
+        procfile_parser(ff);
+
+    if(unlikely(procfile_adaptive_initial_allocation)) {
+        if(unlikely(ff->len > procfile_max_allocation)) procfile_max_allocation = ff->len;
+        if(unlikely(ff->lines->len > procfile_max_lines)) procfile_max_lines = ff->lines->len;
+        if(unlikely(ff->words->len > procfile_max_words)) procfile_max_words = ff->words->len;
+    }
+}
+
+// make room for more data, when the buffer is full
+static inline procfile *procfile_expand(procfile *ff) {
+    if(unlikely(ff->len == ff->size)) {
+        debug(D_PROCFILE, PF_PREFIX ": Expanding data buffer for file '%s'.", procfile_filename(ff));
+        ff = reallocz(ff, sizeof(procfile) + ff->size + PROCFILE_INCREMENT_BUFFER);
+        ff->size += PROCFILE_INCREMENT_BUFFER;
+    }
+
+    return ff;
+}
+
 procfile *procfile_readall(procfile *ff) {
     // debug(D_PROCFILE, PF_PREFIX ": Reading file '%s'.", ff->filename);
 
     ff->len = 0;    // zero the used size
     ssize_t r = 1;  // read at least once
     while(r > 0) {
+        ff = procfile_expand(ff);
         ssize_t s = ff->len;
-        ssize_t x = ff->size - s;
-
-        if(unlikely(!x)) {
-            debug(D_PROCFILE, PF_PREFIX ": Expanding data buffer for file '%s'.", procfile_filename(ff));
-            ff = reallocz(ff, sizeof(procfile) + ff->size + PROCFILE_INCREMENT_BUFFER);
-            ff->size += PROCFILE_INCREMENT_BUFFER;
-        }
 
         debug(D_PROCFILE, "Reading file '%s', from position %zd with length %zd", procfile_filename(ff), s, (ssize_t)(ff->size - s));
-        r = read(ff->fd, &ff->data[s], ff->size - s);
+        if(unlikely(ff->flags & PROCFILE_FLAG_BORROWED_FD))
+            r = pread(ff->fd, &ff->data[s], ff->size - s, (off_t)s);
+        else
+            r = read(ff->fd, &ff->data[s], ff->size - s);
         if(unlikely(r == -1)) {
             if(unlikely(!(ff->flags & PROCFILE_FLAG_NO_ERROR_ON_FILE_IO))) error(PF_PREFIX ": Cannot read from file '%s' on fd %d", procfile_filename(ff), ff->fd);
             procfile_close(ff);
@@ -289,21 +542,14 @@ procfile *procfile_readall(procfile *ff) {
     }
 
     // debug(D_PROCFILE, "Rewinding file '%s'", ff->filename);
-    if(unlikely(lseek(ff->fd, 0, SEEK_SET) == -1)) {
+    // pread() does not move the position of borrowed files
+    if(unlikely(!(ff->flags & PROCFILE_FLAG_BORROWED_FD) && lseek(ff->fd, 0, SEEK_SET) == -1)) {
         if(unlikely(!(ff->flags & PROCFILE_FLAG_NO_ERROR_ON_FILE_IO))) error(PF_PREFIX ": Cannot rewind on file '%s'.", procfile_filename(ff));
         procfile_close(ff);
         return NULL;
     }
 
-    pflines_reset(ff->lines);
-    pfwords_reset(ff->words);
-    procfile_parser(ff);
-
-    if(unlikely(procfile_adaptive_initial_allocation)) {
-        if(unlikely(ff->len > procfile_max_allocation)) procfile_max_allocation = ff->len;
-        if(unlikely(ff->lines->len > procfile_max_lines)) procfile_max_lines = ff->lines->len;
-        if(unlikely(ff->words->len > procfile_max_words)) procfile_max_words = ff->words->len;
-    }
+    procfile_parse(ff);
 
     // debug(D_PROCFILE, "File '%s' updated.", ff->filename);
     return ff;
@@ -346,6 +592,8 @@ static void procfile_set_separators(procfile *ff, const char *separators) {
     const char *s = separators;
     while(*s)
         ffs[(int)*s++] = PF_CHAR_IS_SEPARATOR;
+
+    procfile_update_word_stops(ff);
 }
 
 void procfile_set_quotes(procfile *ff, const char *quotes) {
@@ -357,14 +605,12 @@ void procfile_set_quotes(procfile *ff, const char *quotes) {
         if(unlikely(ffs[i] == PF_CHAR_IS_QUOTE))
             ffs[i] = PF_CHAR_IS_WORD;
 
-    // if nothing given, return
-    if(unlikely(!quotes || !*quotes))
-        return;
-
-    // set the quotes
-    const char *s = quotes;
+    // set the quotes, if given
+    const char *s = (quotes) ? quotes : "";
     while(*s)
         ffs[(int)*s++] = PF_CHAR_IS_QUOTE;
+
+    procfile_update_word_stops(ff);
 }
 
 void procfile_set_open_close(procfile *ff, const char *open, const char *close) {
@@ -376,32 +622,21 @@ void procfile_set_open_close(procfile *ff, const char *open, const char *close)
         if(unlikely(ffs[i] == PF_CHAR_IS_OPEN || ffs[i] == PF_CHAR_IS_CLOSE))
             ffs[i] = PF_CHAR_IS_WORD;
 
-    // if nothing given, return
-    if(unlikely(!open || !*open || !close || !*close))
-        return;
-
-    // set the openings
-    const char *s = open;
-    while(*s)
-        ffs[(int)*s++] = PF_CHAR_IS_OPEN;
-
-    // set the closings
-    s = close;
-    while(*s)
-        ffs[(int)*s++] = PF_CHAR_IS_CLOSE;
-}
-
-procfile *procfile_open(const char *filename, const char *separators, uint32_t flags) {
-    debug(D_PROCFILE, PF_PREFIX ": Opening file '%s'", filename);
+    // if something given, set the openings and the closings
+    if(likely(open && *open && close && *close)) {
+        const char *s = open;
+        while(*s)
+            ffs[(int)*s++] = PF_CHAR_IS_OPEN;
 
-    int fd = open(filename, procfile_open_flags, 0666);
-    if(unlikely(fd == -1)) {
-        if(unlikely(!(flags & PROCFILE_FLAG_NO_ERROR_ON_FILE_IO))) error(PF_PREFIX ": Cannot open file '%s'", filename);
-        return NULL;
+        s = close;
+        while(*s)
+            ffs[(int)*s++] = PF_CHAR_IS_CLOSE;
     }
 
-    // info("PROCFILE: opened '%s' on fd %d", filename, fd);
+    procfile_update_word_stops(ff);
+}
 
+static procfile *procfile_alloc(int fd, const char *separators, uint32_t flags) {
     size_t size = (unlikely(procfile_adaptive_initial_allocation)) ? procfile_max_allocation : PROCFILE_INCREMENT_BUFFER;
     procfile *ff = mallocz(sizeof(procfile) + size);
 
@@ -417,6 +652,21 @@ procfile *procfile_open(const char *filename, const char *separators, uint32_t f
     ff->words = pfwords_new();
 
     procfile_set_separators(ff, separators);
+    return ff;
+}
+
+procfile *procfile_open(const char *filename, const char *separators, uint32_t flags) {
+    debug(D_PROCFILE, PF_PREFIX ": Opening file '%s'", filename);
+
+    int fd = open(filename, procfile_open_flags, 0666);
+    if(unlikely(fd == -1)) {
+        if(unlikely(!(flags & PROCFILE_FLAG_NO_ERROR_ON_FILE_IO))) error(PF_PREFIX ": Cannot open file '%s'", filename);
+        return NULL;
+    }
+
+    // info("PROCFILE: opened '%s' on fd %d", filename, fd);
+
+    procfile *ff = procfile_alloc(fd, separators, flags);
 
     debug(D_PROCFILE, "File '%s' opened.", filename);
     return ff;
@@ -425,7 +675,7 @@ procfile *procfile_open(const char *filename, const char *separators, uint32_t f
 procfile *procfile_reopen(procfile *ff, const char *filename, const char *separators, uint32_t flags) {
     if(unlikely(!ff)) return procfile_open(filename, separators, flags);
 
-    if(likely(ff->fd != -1)) {
+    if(likely(ff->fd != -1 && !(ff->flags & PROCFILE_FLAG_BORROWED_FD))) {
         // info("PROCFILE: closing fd %d", ff->fd);
         close(ff->fd);
     }
@@ -448,6 +698,314 @@ procfile *procfile_reopen(procfile *ff, const char *filename, const char *separa
     return ff;
 }
 
+procfile *procfile_reopen_fd(procfile *ff, int fd, const char *separators, uint32_t flags) {
+    flags |= PROCFILE_FLAG_BORROWED_FD;
+
+    if(unlikely(!ff)) return procfile_alloc(fd, separators, flags);
+
+    if(likely(ff->fd != -1 && !(ff->flags & PROCFILE_FLAG_BORROWED_FD)))
+        close(ff->fd);
+
+    ff->fd = fd;
+    ff->filename[0] = '\0';
+    ff->flags = flags;
+
+    // do not do the separators again if NULL is given
+    if(likely(separators)) procfile_set_separators(ff, separators);
+
+    return ff;
+}
+
+// ----------------------------------------------------------------------------
+// Reading many files together
+//
+// procfile_readall() reads a file until read() returns 0, so each small file
+// costs 2 system calls (and a 3rd to rewind it). A batch reads all its files
+// with pread() at the offsets they have reached, in rounds: each round queues
+// one read for every file that has not reached its end yet, and submits them
+// to io_uring with a single io_uring_enter(), so a batch of small files is
+// usually read with 2 system calls in total. The files are not rewound, since
+// pread() does not move their position. Without io_uring (or when the kernel
+// does not support it) the files are read one by one, with procfile_readall().
+
+int procfile_batch_io_uring = 1;
+
+struct procfile_batch_file {
+    procfile **ff;
+    int done;
+};
+
+struct procfile_uring;
+
+struct procfile_batch {
+    struct procfile_batch_file *files;
+    size_t used;
+    size_t size;
+
+    struct procfile_uring *ring;    // created on the first read, NULL if io_uring cannot be used
+    int ring_checked;
+};
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <linux/io_uring.h>
+
+#define PROCFILE_URING_ENTRIES 64
+
+struct procfile_uring {
+    int fd;
+
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+};
+
+// it is logged once, for all the batches of all threads
+static int procfile_uring_unavailable = 0;
+
+static void procfile_uring_disable(const char *reason) {
+    if(!__atomic_exchange_n(&procfile_uring_unavailable, 1, __ATOMIC_RELAXED))
+        info(PF_PREFIX ": cannot read files with io_uring (%s), they will be read one by one.", reason);
+}
+
+static void procfile_uring_free(struct procfile_uring *r) {
+    if(!r) return;
+
+    if(r->sqes != MAP_FAILED) munmap(r->sqes, r->sq_entries * sizeof(struct io_uring_sqe));
+    if(r->cq_ring != MAP_FAILED && r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_size);
+    if(r->sq_ring != MAP_FAILED) munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+    freez(r);
+}
+
+static struct procfile_uring *procfile_uring_create(void) {
+    if(__atomic_load_n(&procfile_uring_unavailable, __ATOMIC_RELAXED))
+        return NULL;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, PROCFILE_URING_ENTRIES, &params);
+    if(fd < 0) {
+        procfile_uring_disable(strerror(errno));
+        return NULL;
+    }
+
+    // IORING_OP_READ needs Linux 5.6, fast poll is the closest feature flag (5.7)
+    if(!(params.features & IORING_FEAT_FAST_POLL)) {
+        close(fd);
+        procfile_uring_disable("the kernel is too old");
+        return NULL;
+    }
+
+    struct procfile_uring *r = callocz(1, sizeof(struct procfile_uring));
+    r->fd = fd;
+    r->sq_entries = params.sq_entries;
+    r->sq_ring = r->cq_ring = r->sqes = MAP_FAILED;
+
+    r->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        r->sq_ring_size = r->cq_ring_size = MAX(r->sq_ring_size, r->cq_ring_size);
+
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(r->sq_ring == MAP_FAILED) goto failed;
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_ring = r->sq_ring;
+    else {
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(r->cq_ring == MAP_FAILED) goto failed;
+    }
+
+    r->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(r->sqes == MAP_FAILED) goto failed;
+
+    r->sq_tail  = (unsigned *)((char *)r->sq_ring + params.sq_off.tail);
+    r->sq_mask  = (unsigned *)((char *)r->sq_ring + params.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((char *)r->sq_ring + params.sq_off.array);
+    r->cq_head  = (unsigned *)((char *)r->cq_ring + params.cq_off.head);
+    r->cq_tail  = (unsigned *)((char *)r->cq_ring + params.cq_off.tail);
+    r->cq_mask  = (unsigned *)((char *)r->cq_ring + params.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)((char *)r->cq_ring + params.cq_off.cqes);
+
+    return r;
+
+failed:
+    procfile_uring_disable("cannot map its queues");
+    procfile_uring_free(r);
+    return NULL;
+}
+
+// one round: a read for each of the files not done yet (up to the size of the ring)
+// returns 0 when all the files are done, -1 when the ring cannot be used
+static int procfile_uring_round(struct procfile_uring *r, struct procfile_batch_file *files, size_t used) {
+    unsigned queued = 0, tail = *r->sq_tail;
+    size_t i;
+
+    for(i = 0; i < used && queued < r->sq_entries ; i++) {
+        struct procfile_batch_file *f = &files[i];
+        if(f->done) continue;
+
+        procfile *ff = *f->ff = procfile_expand(*f->ff);
+
+        unsigned index = tail & *r->sq_mask;
+        struct io_uring_sqe *sqe = &r->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = ff->fd;
+        sqe->addr = (uint64_t)(uintptr_t)&ff->data[ff->len];
+        sqe->len = (uint32_t)(ff->size - ff->len);
+        sqe->off = (uint64_t)ff->len;
+        sqe->user_data = (uint64_t)i;
+        r->sq_array[index] = index;
+
+        tail++;
+        queued++;
+    }
+
+    if(!queued) return 0;
+
+    __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+    // the reads not submitted by a call are submitted by the next one,
+    // after the ones submitted have completed
+    unsigned submitted = 0, completed = 0;
+    int failed = 0;
+    while(completed < submitted || (!failed && submitted < queued)) {
+        unsigned to_submit = (failed) ? 0 : queued - submitted;
+        unsigned to_complete = (failed) ? submitted - completed : queued - completed;
+
+        int ret = (int)syscall(__NR_io_uring_enter, r->fd, to_submit, to_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(unlikely(ret < 0)) {
+            if(errno == EINTR) continue;
+            if(failed) fatal(PF_PREFIX ": io_uring_enter() failed while waiting for the reads submitted");
+
+            error(PF_PREFIX ": io_uring_enter() failed, the files will be read one by one.");
+            failed = 1;
+            continue;
+        }
+        if(!failed) submitted += (unsigned)ret;
+
+        unsigned head = *r->cq_head;
+        while(head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            struct procfile_batch_file *f = &files[cqe->user_data];
+            procfile *ff = *f->ff;
+
+            if(likely(cqe->res > 0))
+                ff->len += (size_t)cqe->res;
+
+            else {
+                f->done = 1;
+
+                if(unlikely(cqe->res < 0)) {
+                    errno = -cqe->res;
+                    if(unlikely(!(ff->flags & PROCFILE_FLAG_NO_ERROR_ON_FILE_IO))) error(PF_PREFIX ": Cannot read from file '%s' on fd %d", procfile_filename(ff), ff->fd);
+                    procfile_close(ff);
+                    *f->ff = NULL;
+                }
+            }
+
+            head++;
+            completed++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return (failed) ? -1 : 1;
+}
+
+#else // !HAVE_LINUX_IO_URING_H
+
+static inline struct procfile_uring *procfile_uring_create(void) { return NULL; }
+static inline void procfile_uring_free(struct procfile_uring *r) { (void)r; }
+static inline int procfile_uring_round(struct procfile_uring *r, struct procfile_batch_file *files, size_t used) {
+    (void)r; (void)files; (void)used;
+    return -1;
+}
+
+#endif // HAVE_LINUX_IO_URING_H
+
+PROCFILE_BATCH *procfile_batch_create(void) {
+    return callocz(1, sizeof(PROCFILE_BATCH));
+}
+
+void procfile_batch_free(PROCFILE_BATCH *b) {
+    if(unlikely(!b)) return;
+
+    procfile_uring_free(b->ring);
+    freez(b->files);
+    freez(b);
+}
+
+void procfile_batch_add(PROCFILE_BATCH *b, procfile **ff) {
+    if(unlikely(!*ff)) return;
+
+    if(unlikely(b->used == b->size)) {
+        b->size = (b->size) ? b->size * 2 : 16;
+        b->files = reallocz(b->files, b->size * sizeof(struct procfile_batch_file));
+    }
+
+    b->files[b->used].ff = ff;
+    b->files[b->used].done = 0;
+    b->used++;
+}
+
+size_t procfile_batch_readall(PROCFILE_BATCH *b) {
+    size_t i, used = b->used, count = 0;
+    b->used = 0;
+
+    if(unlikely(!used)) return 0;
+
+    if(unlikely(!b->ring_checked)) {
+        b->ring_checked = 1;
+        if(procfile_batch_io_uring) b->ring = procfile_uring_create();
+    }
+
+    int ret = -1;
+    if(likely(b->ring)) {
+        for(i = 0; i < used ; i++)
+            (*b->files[i].ff)->len = 0;
+
+        while((ret = procfile_uring_round(b->ring, b->files, used)) == 1) ;
+
+        if(unlikely(ret == -1)) {
+            procfile_uring_free(b->ring);
+            b->ring = NULL;
+        }
+    }
+
+    for(i = 0; i < used ; i++) {
+        procfile **ff = b->files[i].ff;
+
+        // the data read with io_uring are parsed here, the rest are read now
+        if(unlikely(!*ff))
+            continue;
+
+        if(unlikely(ret == -1))
+            *ff = procfile_readall(*ff);
+        else
+            procfile_parse(*ff);
+
+        if(likely(*ff)) count++;
+    }
+
+    return count;
+}
+
 // ----------------------------------------------------------------------------
 // example parsing of procfile data
 
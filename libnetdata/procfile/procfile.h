@@ -22,8 +22,13 @@ typedef struct {
     size_t words;   // how many words this line has
     size_t first;   // the id of the first word of this line
                     // in the words array
+    size_t start;   // with PROCFILE_FLAG_LAZY_LINES, the offsets in data
+    size_t end;     // of the line, until it is split into words
 } ffline;
 
+// the words of a line not split yet, with PROCFILE_FLAG_LAZY_LINES
+#define PROCFILE_LINE_NOT_SPLIT ((size_t)-1)
+
 typedef struct {
     size_t len;     // used entries
     size_t size;    // capacity
@@ -36,6 +41,8 @@ typedef struct {
 
 #define PROCFILE_FLAG_DEFAULT             0x00000000
 #define PROCFILE_FLAG_NO_ERROR_ON_FILE_IO 0x00000001
+#define PROCFILE_FLAG_BORROWED_FD         0x00000002 // set by procfile_reopen_fd()
+#define PROCFILE_FLAG_LAZY_LINES          0x00000004 // split the lines into words when they are accessed
 
 typedef enum procfile_separator {
     PF_CHAR_IS_SEPARATOR,
@@ -46,6 +53,9 @@ typedef enum procfile_separator {
     PF_CHAR_IS_CLOSE
 } PF_CHAR_TYPE;
 
+// the max number of printable non-word characters for which words are scanned with SIMD
+#define PROCFILE_WORD_STOPS_MAX 8
+
 typedef struct {
     char filename[FILENAME_MAX + 1]; // not populated until profile_filename() is called
 
@@ -56,6 +66,8 @@ typedef struct {
     pflines *lines;
     pfwords *words;
     PF_CHAR_TYPE separators[256];
+    char word_stops[PROCFILE_WORD_STOPS_MAX]; // the printable characters that are not words in separators[]
+    size_t word_stops_len;                    // > PROCFILE_WORD_STOPS_MAX when they do not fit in word_stops[]
     char data[];          // allocated buffer to keep file contents
 } procfile;
 
@@ -72,6 +84,14 @@ extern procfile *procfile_open(const char *filename, const char *separators, uin
 // if separators == NULL, the last separators are used
 extern procfile *procfile_reopen(procfile *ff, const char *filename, const char *separators, uint32_t flags);
 
+// re-use ff for the file open at fd, which the caller keeps open - procfile does not close it
+// and reads it with pread(), so that it can be read again without re-opening it
+// if separators == NULL, the last separators are used
+extern procfile *procfile_reopen_fd(procfile *ff, int fd, const char *separators, uint32_t flags);
+
+// split a line of a PROCFILE_FLAG_LAZY_LINES file into words
+extern void procfile_split_line(procfile *ff, size_t line);
+
 // example walk-through a procfile parsed file
 extern void procfile_print(procfile *ff);
 
@@ -80,27 +100,65 @@ extern void procfile_set_open_close(procfile *ff, const char *open, const char *
 
 extern char *procfile_filename(procfile *ff);
 
+// ----------------------------------------------------------------------------
+// read many files together, with io_uring when it is available
+// a batch is used by one thread at a time
+
+typedef struct procfile_batch PROCFILE_BATCH;
+
+extern PROCFILE_BATCH *procfile_batch_create(void);
+extern void procfile_batch_free(PROCFILE_BATCH *b);
+
+// add a file to be read by the next procfile_batch_readall()
+// ff points to the caller's procfile, which may be reallocated by the read
+extern void procfile_batch_add(PROCFILE_BATCH *b, procfile **ff);
+
+// (re)read and parse all the files added, like procfile_readall() does for each of them
+// the files that cannot be read are closed and their procfile is set to NULL
+// returns the number of files read
+extern size_t procfile_batch_readall(PROCFILE_BATCH *b);
+
 // ----------------------------------------------------------------------------
 
 // set to the O_XXXX flags, to have procfile_open and procfile_reopen use them when opening proc files
 extern int procfile_open_flags;
 
+// set to 0, to have the batches read their files one by one, without io_uring
+extern int procfile_batch_io_uring;
+
 // set this to 1, to have procfile adapt its initial buffer allocation to the max allocation used so far
 extern int procfile_adaptive_initial_allocation;
 
 // return the number of lines present
 #define procfile_lines(ff) ((ff)->lines->len)
 
+// with PROCFILE_FLAG_LAZY_LINES, procfile_readall() only finds the lines (at '\n'),
+// and each line is split into words the first time its words are accessed - so the
+// files of which only a few lines are used (i.e. with ARL) are not split entirely.
+// The words are added to the words array in the order the lines are split, so
+// procfile_word() should not be used with it.
+
+static inline size_t procfile_line_split(procfile *ff, size_t line) {
+    if(unlikely(ff->lines->lines[line].words == PROCFILE_LINE_NOT_SPLIT))
+        procfile_split_line(ff, line);
+
+    return ff->lines->lines[line].words;
+}
+
 // return the number of words of the Nth line
-#define procfile_linewords(ff, line) (((line) < procfile_lines(ff)) ? (ff)->lines->lines[(line)].words : 0)
+#define procfile_linewords(ff, line) (((line) < procfile_lines(ff)) ? procfile_line_split((ff), (line)) : 0)
 
 // return the Nth word of the file, or empty string
 #define procfile_word(ff, word) (((word) < (ff)->words->len) ? (ff)->words->words[(word)] : "")
 
 // return the first word of the Nth line, or empty string
-#define procfile_line(ff, line) (((line) < procfile_lines(ff)) ? procfile_word((ff), (ff)->lines->lines[(line)].first) : "")
+#define procfile_line(ff, line) (((line) < procfile_lines(ff)) ? (procfile_line_split((ff), (line)), procfile_word((ff), (ff)->lines->lines[(line)].first)) : "")
 
 // return the Nth word of the current line
 #define procfile_lineword(ff, line, word) (((line) < procfile_lines(ff) && (word) < procfile_linewords((ff), (line))) ? procfile_word((ff), (ff)->lines->lines[(line)].first + (word)) : "")
 
+// return the array of the words of the Nth line (line < procfile_lines(ff)) - for lines
+// with many words, i.e. /proc/interrupts, it saves the checks procfile_lineword() does per word
+#define procfile_linewords_array(ff, line) (procfile_line_split((ff), (line)), &(ff)->words->words[(ff)->lines->lines[(line)].first])
+
 #endif /* NETDATA_PROCFILE_H */
@@ -9,11 +9,171 @@ struct simple_pattern {
     SIMPLE_PREFIX_MODE mode;
     char negative;
 
+    uint32_t order;                     // the position of the pattern in the list
+
     struct simple_pattern *child;
 
     struct simple_pattern *next;
 };
 
+// ----------------------------------------------------------------------------
+// compiled patterns
+//
+// The patterns without asterisks in the middle that match exactly, a prefix or
+// a suffix, are indexed in two tries: one of their strings and one of their
+// strings reversed. Walking the tries with the string matched gives the first
+// of them (in the order of the list) that matches it, in one pass. Only the rest
+// of the patterns (substrings and patterns with asterisks in the middle) are
+// tested one by one, and only the ones before the first indexed pattern that
+// matches, since netdata stops at the first match.
+
+#define SIMPLE_PATTERN_NONE UINT32_MAX
+
+struct simple_pattern_trie {
+    uint32_t exact;                     // the first pattern that matches a string ending here
+    uint32_t prefix;                    // the first pattern that matches a string starting with this
+
+    uint32_t count;                     // the children of this node
+    unsigned char *keys;
+    struct simple_pattern_trie **children;
+};
+
+struct simple_pattern_index {
+    struct simple_pattern *root;        // all the patterns, in order
+    struct simple_pattern **patterns;   // all the patterns, by their order
+
+    struct simple_pattern_trie *prefixes;
+    struct simple_pattern_trie *suffixes;
+
+    size_t others_count;                // the patterns that are not in the tries, in order
+    struct simple_pattern **others;
+};
+
+static struct simple_pattern_trie *simple_pattern_trie_create(void) {
+    struct simple_pattern_trie *t = callocz(1, sizeof(struct simple_pattern_trie));
+    t->exact = t->prefix = SIMPLE_PATTERN_NONE;
+    return t;
+}
+
+static inline struct simple_pattern_trie *simple_pattern_trie_child(struct simple_pattern_trie *t, unsigned char c) {
+    uint32_t i;
+    for(i = 0; i < t->count ; i++)
+        if(t->keys[i] == c) return t->children[i];
+
+    return NULL;
+}
+
+// returns the node of the trie for the len characters of s,
+// read backwards when reverse is set, creating the missing nodes
+static struct simple_pattern_trie *simple_pattern_trie_add(struct simple_pattern_trie *t, const char *s, size_t len, int reverse) {
+    size_t i;
+    for(i = 0; i < len ; i++) {
+        unsigned char c = (unsigned char)(reverse ? s[len - 1 - i] : s[i]);
+        struct simple_pattern_trie *child = simple_pattern_trie_child(t, c);
+
+        if(!child) {
+            child = simple_pattern_trie_create();
+            t->keys = reallocz(t->keys, (t->count + 1) * sizeof(unsigned char));
+            t->children = reallocz(t->children, (t->count + 1) * sizeof(struct simple_pattern_trie *));
+            t->keys[t->count] = c;
+            t->children[t->count] = child;
+            t->count++;
+        }
+
+        t = child;
+    }
+
+    return t;
+}
+
+static void simple_pattern_trie_free(struct simple_pattern_trie *t) {
+    if(!t) return;
+
+    uint32_t i;
+    for(i = 0; i < t->count ; i++)
+        simple_pattern_trie_free(t->children[i]);
+
+    freez(t->keys);
+    freez(t->children);
+    freez(t);
+}
+
+static inline void simple_pattern_first(uint32_t *first, uint32_t order) {
+    if(order < *first) *first = order;
+}
+
+static struct simple_pattern_index *simple_pattern_index_create(struct simple_pattern *root) {
+    struct simple_pattern_index *idx = callocz(1, sizeof(struct simple_pattern_index));
+    struct simple_pattern *m;
+    size_t count = 0;
+
+    for(m = root; m ; m = m->next) count++;
+
+    idx->root = root;
+    idx->patterns = mallocz(count * sizeof(struct simple_pattern *));
+    idx->others = mallocz(count * sizeof(struct simple_pattern *));
+    idx->prefixes = simple_pattern_trie_create();
+    idx->suffixes = simple_pattern_trie_create();
+
+    for(m = root, count = 0; m ; m = m->next, count++) {
+        m->order = (uint32_t)count;
+        idx->patterns[count] = m;
+
+        if(m->child || !m->match) {
+            idx->others[idx->others_count++] = m;
+            continue;
+        }
+
+        switch(m->mode) {
+            case SIMPLE_PATTERN_EXACT:
+                simple_pattern_first(&simple_pattern_trie_add(idx->prefixes, m->match, m->len, 0)->exact, m->order);
+                break;
+
+            case SIMPLE_PATTERN_PREFIX:
+                simple_pattern_first(&simple_pattern_trie_add(idx->prefixes, m->match, m->len, 0)->prefix, m->order);
+                break;
+
+            case SIMPLE_PATTERN_SUFFIX:
+                simple_pattern_first(&simple_pattern_trie_add(idx->suffixes, m->match, m->len, 1)->prefix, m->order);
+                break;
+
+            default:
+                idx->others[idx->others_count++] = m;
+                break;
+        }
+    }
+
+    return idx;
+}
+
+// returns the order of the first pattern of the tries that matches str
+static inline uint32_t simple_pattern_index_first(struct simple_pattern_index *idx, const char *str, size_t len) {
+    uint32_t first = SIMPLE_PATTERN_NONE;
+    struct simple_pattern_trie *t;
+    size_t i;
+
+    for(t = idx->prefixes, i = 0; t ; i++) {
+        simple_pattern_first(&first, t->prefix);
+
+        if(i == len) {
+            simple_pattern_first(&first, t->exact);
+            break;
+        }
+
+        t = t->count ? simple_pattern_trie_child(t, (unsigned char)str[i]) : NULL;
+    }
+
+    for(t = idx->suffixes, i = 0; t ; i++) {
+        simple_pattern_first(&first, t->prefix);
+
+        if(i == len) break;
+
+        t = t->count ? simple_pattern_trie_child(t, (unsigned char)str[len - 1 - i]) : NULL;
+    }
+
+    return first;
+}
+
 static inline struct simple_pattern *parse_pattern(char *str, SIMPLE_PREFIX_MODE default_mode) {
     // fprintf(stderr, "PARSING PATTERN: '%s'\n", str);
 
@@ -150,7 +310,11 @@ SIMPLE_PATTERN *simple_pattern_create(const char *list, const char *separators,
     }
 
     freez(buf);
-    return (SIMPLE_PATTERN *)root;
+
+    if(unlikely(!root))
+        return NULL;
+
+    return (SIMPLE_PATTERN *)simple_pattern_index_create(root);
 }
 
 static inline char *add_wildcarded(const char *matched, size_t matched_size, char *wildcarded, size_t *wildcarded_size) {
@@ -223,27 +387,48 @@ static inline int match_pattern(struct simple_pattern *m, const char *str, size_
 }
 
 int simple_pattern_matches_extract(SIMPLE_PATTERN *list, const char *str, char *wildcarded, size_t wildcarded_size) {
-    struct simple_pattern *m, *root = (struct simple_pattern *)list;
+    struct simple_pattern_index *idx = (struct simple_pattern_index *)list;
+    struct simple_pattern *m;
+
+    if(unlikely(wildcarded && wildcarded_size)) *wildcarded = '\0';
 
-    if(unlikely(!root || !str || !*str)) return 0;
+    if(unlikely(!idx || !str || !*str)) return 0;
 
-    size_t len = strlen(str);
-    for(m = root; m ; m = m->next) {
+    size_t len = strlen(str), i;
+    uint32_t first = simple_pattern_index_first(idx, str, len);
+    int extracted = 0;
+
+    // test the patterns that are not indexed, up to the first indexed one that matches
+    for(i = 0; i < idx->others_count && idx->others[i]->order < first ; i++) {
         char *ws = wildcarded;
         size_t wss = wildcarded_size;
         if(unlikely(ws)) *ws = '\0';
 
-        if (match_pattern(m, str, len, ws, &wss)) {
+        if(match_pattern(idx->others[i], str, len, ws, &wss)) {
+            first = idx->others[i]->order;
+            extracted = 1;
+            break;
+        }
+    }
+
+    if(first == SIMPLE_PATTERN_NONE)
+        return 0;
 
-            //if(ws && wss)
-            //    fprintf(stderr, "FINAL WILDCARDED '%s' of length %zu\n", ws, strlen(ws));
+    m = idx->patterns[first];
 
-            if (m->negative) return 0;
-            return 1;
-        }
+    if(unlikely(wildcarded && wildcarded_size && !extracted)) {
+        // the pattern was matched by the tries, match it again to extract the wildcarded part
+        char *ws = wildcarded;
+        size_t wss = wildcarded_size;
+        *ws = '\0';
+        match_pattern(m, str, len, ws, &wss);
     }
 
-    return 0;
+    //if(wildcarded && wildcarded_size)
+    //    fprintf(stderr, "FINAL WILDCARDED '%s' of length %zu\n", wildcarded, strlen(wildcarded));
+
+    if(m->negative) return 0;
+    return 1;
 }
 
 static inline void free_pattern(struct simple_pattern *m) {
@@ -258,5 +443,12 @@ static inline void free_pattern(struct simple_pattern *m) {
 void simple_pattern_free(SIMPLE_PATTERN *list) {
     if(!list) return;
 
-    free_pattern(((struct simple_pattern *)list));
+    struct simple_pattern_index *idx = (struct simple_pattern_index *)list;
+
+    free_pattern(idx->root);
+    simple_pattern_trie_free(idx->prefixes);
+    simple_pattern_trie_free(idx->suffixes);
+    freez(idx->patterns);
+    freez(idx->others);
+    freez(idx);
 }
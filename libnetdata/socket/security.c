@@ -10,6 +10,8 @@ const char *security_cert=NULL;
 int netdata_use_ssl_on_stream = NETDATA_SSL_OPTIONAL;
 int netdata_use_ssl_on_http = NETDATA_SSL_FORCE; //We force SSL due safety reasons
 int netdata_validate_server =  NETDATA_SSL_VALID_CERTIFICATE;
+long netdata_ssl_session_cache_size = NETDATA_SSL_SESSION_CACHE_SIZE;
+long netdata_ssl_session_timeout = NETDATA_SSL_SESSION_TIMEOUT;
 
 /**
  * Info Callback
@@ -144,6 +146,19 @@ static SSL_CTX * security_initialize_openssl_server() {
 	SSL_CTX_set_session_id_context(ctx,(void*)&netdata_id_context,(unsigned int)sizeof(netdata_id_context));
     SSL_CTX_set_info_callback(ctx,security_info_callback);
 
+    //Reconnecting clients resume their sessions, either from the session cache
+    //(shared by all the web server threads) or from a session ticket, instead of
+    //doing a full handshake.
+    if (netdata_ssl_session_cache_size > 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, netdata_ssl_session_cache_size);
+    }
+    else
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+
+    SSL_CTX_set_timeout(ctx, netdata_ssl_session_timeout);
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+
 #if (OPENSSL_VERSION_NUMBER < 0x00905100L)
 	SSL_CTX_set_verify_depth(ctx,1);
 #endif
@@ -220,12 +235,12 @@ int security_process_accept(SSL *ssl,int msg) {
          switch(sslerrno) {
              case SSL_ERROR_WANT_READ:
              {
-                 error("SSL handshake did not finish and it wanna read on socket %d!", sock);
+                 debug(D_WEB_CLIENT, "SSL handshake did not finish and it wanna read on socket %d!", sock);
                  return NETDATA_SSL_WANT_READ;
              }
              case SSL_ERROR_WANT_WRITE:
              {
-                 error("SSL handshake did not finish and it wanna read on socket %d!", sock);
+                 debug(D_WEB_CLIENT, "SSL handshake did not finish and it wanna write on socket %d!", sock);
                  return NETDATA_SSL_WANT_WRITE;
              }
              case SSL_ERROR_NONE:
@@ -247,7 +262,7 @@ int security_process_accept(SSL *ssl,int msg) {
 
     if (SSL_is_init_finished(ssl))
     {
-        debug(D_WEB_CLIENT_ACCESS,"SSL Handshake finished %s errno %d on socket fd %d", ERR_error_string((long)SSL_get_error(ssl, test), NULL), errno, sock);
+        debug(D_WEB_CLIENT_ACCESS,"SSL Handshake finished %s errno %d on socket fd %d (session %s)", ERR_error_string((long)SSL_get_error(ssl, test), NULL), errno, sock, SSL_session_reused(ssl)?"resumed":"new");
     }
 
     return 0;
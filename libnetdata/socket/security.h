@@ -15,6 +15,9 @@
 #define NETDATA_SSL_CONTEXT_STREAMING 1
 #define NETDATA_SSL_CONTEXT_OPENTSDB 2
 
+#define NETDATA_SSL_SESSION_CACHE_SIZE 20480 //Sessions the server keeps for resumption
+#define NETDATA_SSL_SESSION_TIMEOUT 300      //Seconds a session can be resumed
+
 # ifdef ENABLE_HTTPS
 
 #  include <openssl/ssl.h>
@@ -36,6 +39,8 @@ extern const char *security_cert;
 extern int netdata_use_ssl_on_stream;
 extern int netdata_use_ssl_on_http;
 extern int netdata_validate_server;
+extern long netdata_ssl_session_cache_size;
+extern long netdata_ssl_session_timeout;
 
 void security_openssl_library();
 void security_clean_openssl();
@@ -547,6 +547,101 @@ int listen_sockets_setup(LISTEN_SOCKETS *sockets) {
     return (int)sockets->opened;
 }
 
+// binds a new TCP or UDP socket to the address the listening socket fd is bound to, with SO_REUSEPORT
+// returns the new socket, or -1 when the address cannot be shared
+static inline int listen_socket_reuseport(int fd, int socktype, int family, int listen_backlog) {
+#if defined(SO_REUSEPORT) && defined(__linux__)
+    // only linux distributes the connections (and the datagrams) among the
+    // sockets of a port, the other systems give all of them to one of the sockets
+    struct sockaddr_storage name;
+    socklen_t name_length = sizeof(name);
+    int reuse = 1, ipv6only = 1;
+
+    if(getsockname(fd, (struct sockaddr *)&name, &name_length) != 0) {
+        error("LISTENER: Cannot get the address of listening socket %d.", fd);
+        return -1;
+    }
+
+    int sock = socket(family, socktype, 0);
+    if(sock < 0) {
+        error("LISTENER: socket() for sharing the address of listening socket %d failed.", fd);
+        return -1;
+    }
+
+    if(setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) != 0) {
+        close(sock);
+        return -1;
+    }
+
+    sock_setreuse(sock, 1);
+    sock_setnonblock(sock);
+    sock_enlarge_in(sock);
+
+    if(family == AF_INET6 && setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, (void*)&ipv6only, sizeof(ipv6only)) != 0)
+        error("LISTENER: Cannot set IPV6_V6ONLY on the socket sharing the address of listening socket %d.", fd);
+
+    if(bind(sock, (struct sockaddr *)&name, name_length) != 0 || (socktype == SOCK_STREAM && listen(sock, listen_backlog) != 0)) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+#else
+    (void)fd;
+    (void)socktype;
+    (void)family;
+    (void)listen_backlog;
+    return -1;
+#endif
+}
+
+// copies the listening sockets of src to dst, to be polled by another thread
+// every TCP and UDP socket of dst is bound to the same address as in src with SO_REUSEPORT,
+// so that the kernel distributes the connections and the datagrams among them, all the
+// others (and the sockets that cannot be bound again) are duplicates of the ones of src
+// returns the number of TCP and UDP sockets of dst that are not shared with src
+int listen_sockets_reuseport(LISTEN_SOCKETS *dst, LISTEN_SOCKETS *src) {
+    size_t i;
+    int reused = 0;
+
+    listen_sockets_init(dst);
+    dst->config          = src->config;
+    dst->config_section  = src->config_section;
+    dst->default_bind_to = src->default_bind_to;
+    dst->default_port    = src->default_port;
+    dst->backlog         = src->backlog;
+
+    for(i = 0; i < src->opened ;i++) {
+        int fd = -1;
+
+        if((src->fds_types[i] == SOCK_STREAM || src->fds_types[i] == SOCK_DGRAM) && (src->fds_families[i] == AF_INET || src->fds_families[i] == AF_INET6)) {
+            fd = listen_socket_reuseport(src->fds[i], src->fds_types[i], src->fds_families[i], src->backlog);
+            if(fd == -1)
+                info("LISTENER: Cannot open another listening socket on %s, sharing it.", src->fds_names[i]);
+            else
+                reused++;
+        }
+
+        if(fd == -1)
+            fd = dup(src->fds[i]);
+
+        if(fd == -1) {
+            error("LISTENER: Cannot duplicate listening socket %s.", src->fds_names[i]);
+            dst->failed++;
+            continue;
+        }
+
+        dst->fds[dst->opened] = fd;
+        dst->fds_types[dst->opened] = src->fds_types[i];
+        dst->fds_families[dst->opened] = src->fds_families[i];
+        dst->fds_names[dst->opened] = strdupz(src->fds_names[i]);
+        dst->fds_acl_flags[dst->opened] = src->fds_acl_flags[i];
+        dst->opened++;
+    }
+
+    return reused;
+}
+
 
 // --------------------------------------------------------------------------------------------------------------------
 // connect to another host/port
@@ -1031,7 +1126,8 @@ int accept_socket(int fd, int flags, char *client_ip, size_t ipsize, char *clien
                 break;
         }
 
-        if(access_list) {
+        // the clients of unix sockets have no IP, they are checked by their credentials
+        if(access_list && ((struct sockaddr *)&sadr)->sa_family != AF_UNIX) {
             if(!strcmp(client_ip, "127.0.0.1") || !strcmp(client_ip, "::1")) {
                 strncpy(client_ip, "localhost", ipsize);
                 client_ip[ipsize - 1] = '\0';
@@ -1059,10 +1155,225 @@ int accept_socket(int fd, int flags, char *client_ip, size_t ipsize, char *clien
 // --------------------------------------------------------------------------------------------------------------------
 // poll() based listener
 // this should be the fastest possible listener for up to 100 sockets
-// above 100, an epoll() interface is needed on Linux
+// above 100, the kernel is asked to keep the events of the sockets (epoll() on Linux, kqueue() on BSD and macOS),
+// so that waiting does not scan all of them. p->fds keeps the events every slot waits for in both cases.
 
 #define POLL_FDS_INCREASE_STEP 10
 
+#if defined(HAVE_SYS_EPOLL_H) || defined(HAVE_SYS_EVENT_H)
+
+#ifdef HAVE_SYS_EPOLL_H
+#define POLL_KERNEL_NAME "epoll()"
+typedef struct epoll_event POLL_KERNEL_EVENT;
+#else
+#define POLL_KERNEL_NAME "kqueue()"
+typedef struct kevent POLL_KERNEL_EVENT;
+#endif
+
+static void poll_kernel_init(POLLJOB *p) {
+#ifdef HAVE_SYS_EPOLL_H
+    p->kfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    p->kfd = kqueue();
+    if(p->kfd != -1) fcntl(p->kfd, F_SETFD, FD_CLOEXEC);
+#endif
+
+    if(p->kfd == -1)
+        error("POLLFD: cannot create an " POLL_KERNEL_NAME " fd, falling back to poll()");
+    else
+        debug(D_POLLFD, "POLLFD: using " POLL_KERNEL_NAME " fd %d", p->kfd);
+}
+
+static void poll_kernel_free(POLLJOB *p) {
+    if(p->kfd != -1) close(p->kfd);
+    p->kfd = -1;
+
+    freez(p->kevents);
+    freez(p->kready);
+    freez(p->kready_slots);
+    freez(p->always_ready);
+    p->kevents = NULL;
+    p->kready = NULL;
+    p->kready_slots = NULL;
+    p->always_ready = NULL;
+    p->always_ready_used = 0;
+}
+
+static void poll_kernel_resize(POLLJOB *p, size_t old_slots, size_t new_slots) {
+    if(p->kfd == -1) return;
+
+    size_t i;
+    p->kevents = reallocz(p->kevents, sizeof(short int) * new_slots);
+    for(i = old_slots; i < new_slots ; i++)
+        p->kevents[i] = -1;
+
+    // kqueue() returns the read and the write events of an fd separately
+    p->kready = reallocz(p->kready, sizeof(POLL_KERNEL_EVENT) * new_slots * 2);
+    p->kready_slots = reallocz(p->kready_slots, sizeof(size_t) * new_slots);
+    p->always_ready = reallocz(p->always_ready, sizeof(size_t) * new_slots);
+}
+
+static void poll_kernel_always_ready(POLLJOB *p, POLLINFO *pi) {
+    debug(D_POLLFD, "POLLFD: " POLL_KERNEL_NAME " cannot poll fd %d of slot %zu, it will always be ready", pi->fd, pi->slot);
+
+    pi->flags |= POLLINFO_FLAG_ALWAYS_READY;
+    p->always_ready[p->always_ready_used++] = pi->slot;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static inline uint32_t poll_kernel_events(short int events) {
+    return ((events & POLLIN)?EPOLLIN:0) | ((events & POLLPRI)?EPOLLPRI:0) | ((events & POLLOUT)?EPOLLOUT:0);
+}
+#else
+static inline int poll_kernel_filter(POLLJOB *p, int fd, size_t slot, short int filter, int enable) {
+    struct kevent ke;
+    EV_SET(&ke, fd, filter, EV_ADD | ((enable)?EV_ENABLE:EV_DISABLE), 0, 0, (void *)(uintptr_t)slot);
+    return kevent(p->kfd, &ke, 1, NULL, 0, NULL);
+}
+#endif
+
+// tells the kernel the events slot of pi waits for, when they have changed
+static void poll_kernel_sync(POLLJOB *p, POLLINFO *pi) {
+    if(p->kfd == -1 || pi->fd == -1 || pi->flags & POLLINFO_FLAG_ALWAYS_READY) return;
+
+    size_t slot = pi->slot;
+    short int events = (short int)(p->fds[slot].events & (POLLIN | POLLPRI | POLLOUT));
+    short int old = p->kevents[slot];
+    if(likely(events == old)) return;
+
+#ifdef HAVE_SYS_EPOLL_H
+    // slots without events are kept registered, epoll() reports their errors, like poll()
+    struct epoll_event ev = { .events = poll_kernel_events(events), .data.u64 = slot };
+    if(epoll_ctl(p->kfd, (old == -1)?EPOLL_CTL_ADD:EPOLL_CTL_MOD, pi->fd, &ev) == -1) {
+        if(old == -1 && errno == EPERM) {
+            poll_kernel_always_ready(p, pi);
+            return;
+        }
+        error("POLLFD: epoll_ctl() failed for fd %d of slot %zu", pi->fd, slot);
+        return;
+    }
+#else
+    // the read and the write filters of an fd are enabled and disabled separately
+    int added = (old != -1), rr = 0, rw = 0;
+    if(!added) old = 0;
+
+    if(!added || (events ^ old) & (POLLIN | POLLPRI))
+        rr = poll_kernel_filter(p, pi->fd, slot, EVFILT_READ, events & (POLLIN | POLLPRI));
+
+    if(rr != -1 && (!added || (events ^ old) & POLLOUT))
+        rw = poll_kernel_filter(p, pi->fd, slot, EVFILT_WRITE, events & POLLOUT);
+
+    if(rr == -1 || rw == -1) {
+        if(!added) {
+            struct kevent ke[2];
+            EV_SET(&ke[0], pi->fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+            EV_SET(&ke[1], pi->fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+            (void)kevent(p->kfd, ke, 2, NULL, 0, NULL);
+            poll_kernel_always_ready(p, pi);
+            return;
+        }
+        error("POLLFD: kevent() failed for fd %d of slot %zu", pi->fd, slot);
+        return;
+    }
+#endif
+
+    p->kevents[slot] = events;
+}
+
+// the slot of pi is going to be closed
+static void poll_kernel_del(POLLJOB *p, POLLINFO *pi) {
+    if(p->kfd == -1) return;
+
+    size_t slot = pi->slot;
+
+    if(pi->flags & POLLINFO_FLAG_ALWAYS_READY) {
+        size_t i;
+        for(i = 0; i < p->always_ready_used ; i++) {
+            if(p->always_ready[i] == slot) {
+                p->always_ready[i] = p->always_ready[--p->always_ready_used];
+                break;
+            }
+        }
+        pi->flags &= ~POLLINFO_FLAG_ALWAYS_READY;
+    }
+    else if(p->kevents[slot] != -1) {
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event ev = { .events = 0, .data.u64 = slot };
+        if(epoll_ctl(p->kfd, EPOLL_CTL_DEL, pi->fd, &ev) == -1)
+            error("POLLFD: epoll_ctl() cannot delete fd %d of slot %zu", pi->fd, slot);
+#else
+        struct kevent ke[2];
+        EV_SET(&ke[0], pi->fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        EV_SET(&ke[1], pi->fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+        (void)kevent(p->kfd, ke, 2, NULL, 0, NULL);
+#endif
+    }
+
+    p->kevents[slot] = -1;
+}
+
+// waits for events, like poll(), setting the revents of the slots that got events
+// the slots are returned in p->kready_slots, it returns their number, or -1 on failure
+static int poll_kernel_wait(POLLJOB *p, int timeout_ms) {
+    size_t i, *ready = p->kready_slots;
+    int n, r = 0;
+
+    // the fds the kernel cannot poll are ready for whatever they wait for
+    for(i = 0; i < p->always_ready_used ; i++) {
+        size_t slot = p->always_ready[i];
+        short int revents = (short int)(p->fds[slot].events & (POLLIN | POLLOUT));
+        if(revents) {
+            p->fds[slot].revents = revents;
+            ready[r++] = slot;
+        }
+    }
+    if(r) timeout_ms = 0;
+
+    POLL_KERNEL_EVENT *ev = p->kready;
+#ifdef HAVE_SYS_EPOLL_H
+    n = epoll_wait(p->kfd, ev, (int)p->slots, timeout_ms);
+#else
+    struct timespec ts = { .tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000L };
+    n = kevent(p->kfd, NULL, 0, ev, (int)p->slots * 2, &ts);
+#endif
+    if(unlikely(n == -1)) {
+        if(errno != EINTR) return -1;
+        n = 0;
+    }
+
+    for(i = 0; i < (size_t)n ; i++) {
+#ifdef HAVE_SYS_EPOLL_H
+        size_t slot = (size_t)ev[i].data.u64;
+        short int revents = (short int)(((ev[i].events & EPOLLIN)?POLLIN:0) | ((ev[i].events & EPOLLPRI)?POLLPRI:0)
+                | ((ev[i].events & EPOLLOUT)?POLLOUT:0) | ((ev[i].events & EPOLLERR)?POLLERR:0)
+                | ((ev[i].events & EPOLLHUP)?POLLHUP:0));
+#else
+        size_t slot = (size_t)(uintptr_t)ev[i].udata;
+        if(unlikely(slot >= p->slots || p->fds[slot].fd != (int)ev[i].ident)) continue;
+
+        short int revents = (short int)((ev[i].flags & EV_ERROR)?POLLERR:(ev[i].filter == EVFILT_WRITE)?POLLOUT:POLLIN);
+#endif
+        if(unlikely(slot >= p->slots || p->fds[slot].fd == -1)) continue;
+
+        if(!p->fds[slot].revents)
+            ready[r++] = slot;
+        p->fds[slot].revents |= revents;
+    }
+
+    return r;
+}
+
+#else // no epoll() or kqueue()
+
+#define poll_kernel_init(p) debug(D_POLLFD, "POLLFD: using poll()")
+#define poll_kernel_free(p) do {} while(0)
+#define poll_kernel_resize(p, old_slots, new_slots) do {} while(0)
+#define poll_kernel_sync(p, pi) do {} while(0)
+#define poll_kernel_del(p, pi) do {} while(0)
+#define poll_kernel_wait(p, timeout_ms) (-1)
+
+#endif // epoll() or kqueue()
+
 inline POLLINFO *poll_add_fd(POLLJOB *p
                              , int fd
                              , int socktype
@@ -1092,6 +1403,7 @@ inline POLLINFO *poll_add_fd(POLLJOB *p
 
         p->fds = reallocz(p->fds, sizeof(struct pollfd) * new_slots);
         p->inf = reallocz(p->inf, sizeof(POLLINFO) * new_slots);
+        poll_kernel_resize(p, p->slots, new_slots);
 
         // reset all the newly added slots
         ssize_t i;
@@ -1165,6 +1477,8 @@ inline POLLINFO *poll_add_fd(POLLJOB *p
     if(pi->flags & POLLINFO_FLAG_SERVER_SOCKET) {
         p->min = pi->slot;
     }
+
+    poll_kernel_sync(p, pi);
     netdata_thread_enable_cancelability();
 
     debug(D_POLLFD, "POLLFD: ADD: completed, slots = %zu, used = %zu, min = %zu, max = %zu, next free = %zd", p->slots, p->used, p->min, p->max, p->first_free?(ssize_t)p->first_free->slot:(ssize_t)-1);
@@ -1182,6 +1496,9 @@ inline void poll_close_fd(POLLINFO *pi) {
 
     netdata_thread_disable_cancelability();
 
+    // before the fd is closed, by us or by the del_callback
+    poll_kernel_del(p, pi);
+
     if(pi->flags & POLLINFO_FLAG_CLIENT_SOCKET) {
         pi->del_callback(pi);
 
@@ -1229,6 +1546,14 @@ inline void poll_close_fd(POLLINFO *pi) {
     debug(D_POLLFD, "POLLFD: DEL: completed, slots = %zu, used = %zu, min = %zu, max = %zu, next free = %zd", p->slots, p->used, p->min, p->max, p->first_free?(ssize_t)p->first_free->slot:(ssize_t)-1);
 }
 
+// sets the events the fd of pi waits for, outside the callbacks of pi
+void poll_set_events(POLLINFO *pi, short int events) {
+    POLLJOB *p = pi->p;
+
+    p->fds[pi->slot].events = events;
+    poll_kernel_sync(p, pi);
+}
+
 void *poll_default_add_callback(POLLINFO *pi, short int *events, void *data) {
     (void)pi;
     (void)events;
@@ -1287,6 +1612,7 @@ static void poll_events_cleanup(void *data) {
         poll_close_fd(pi);
     }
 
+    poll_kernel_free(p);
     freez(p->fds);
     freez(p->inf);
 }
@@ -1458,6 +1784,68 @@ static void poll_events_process(POLLJOB *p, POLLINFO *pi, struct pollfd *pf, sho
     }
 }
 
+// waits up to timeout_ms for events on the sockets of p and calls their callbacks
+// returns the number of sockets that had events, 0 on timeout, -1 when waiting failed
+int poll_events_wait(POLLJOB *p, int timeout_ms) {
+    size_t i;
+    int retval;
+
+    debug(D_POLLFD, "POLLFD: LISTENER: Waiting on %zu sockets for %zu ms...", p->max + 1, (size_t)timeout_ms);
+    if(p->kfd != -1)
+        retval = poll_kernel_wait(p, timeout_ms);
+    else
+        retval = poll(p->fds, p->max + 1, timeout_ms);
+    time_t now = now_boottime_sec();
+
+    if(unlikely(retval == -1)) {
+        if(errno != EINTR)
+            error("POLLFD: LISTENER: poll() failed while waiting on %zu sockets.", p->max + 1);
+        else
+            retval = 0;
+    }
+    else if(unlikely(!retval)) {
+        debug(D_POLLFD, "POLLFD: LISTENER: poll() timeout.");
+    }
+    else if(p->kfd != -1) {
+        // new slots may be added while processing, p->kready_slots is re-read every time
+        int r;
+        for (r = 0; r < retval; r++) {
+            i = p->kready_slots[r];
+            struct pollfd *pf     = &p->fds[i];
+            short int     revents = pf->revents;
+            if (likely(revents)) {
+                poll_events_process(p, &p->inf[i], pf, revents, now);
+                poll_kernel_sync(p, &p->inf[i]);
+            }
+        }
+    }
+    else {
+        for (i = 0; i <= p->max; i++) {
+            struct pollfd *pf     = &p->fds[i];
+            short int     revents = pf->revents;
+            if (unlikely(revents))
+                poll_events_process(p, &p->inf[i], pf, revents, now);
+        }
+    }
+
+    return retval;
+}
+
+// initializes p for a thread that adds its own sockets to it with poll_add_fd()
+// and waits for them with poll_events_wait(), instead of calling poll_events()
+void poll_job_init(POLLJOB *p) {
+    memset(p, 0, sizeof(POLLJOB));
+    p->kfd = -1;
+
+    p->add_callback = poll_default_add_callback;
+    p->del_callback = poll_default_del_callback;
+    p->rcv_callback = poll_default_rcv_callback;
+    p->snd_callback = poll_default_snd_callback;
+    p->tmr_callback = poll_default_tmr_callback;
+
+    poll_kernel_init(p);
+}
+
 void poll_events(LISTEN_SOCKETS *sockets
         , void *(*add_callback)(POLLINFO * /*pi*/, short int * /*events*/, void * /*data*/)
         , void  (*del_callback)(POLLINFO * /*pi*/)
@@ -1490,6 +1878,13 @@ void poll_events(LISTEN_SOCKETS *sockets
             .inf = NULL,
             .first_free = NULL,
 
+            .kfd = -1,
+            .kevents = NULL,
+            .kready = NULL,
+            .kready_slots = NULL,
+            .always_ready = NULL,
+            .always_ready_used = 0,
+
             .complete_request_timeout = tcp_request_timeout_seconds,
             .idle_timeout = tcp_idle_timeout_seconds,
             .checks_every = (tcp_idle_timeout_seconds / 3) + 1,
@@ -1506,6 +1901,8 @@ void poll_events(LISTEN_SOCKETS *sockets
             .tmr_callback = tmr_callback?tmr_callback:poll_default_tmr_callback
     };
 
+    poll_kernel_init(&p);
+
     size_t i;
     for(i = 0; i < sockets->opened ;i++) {
 
@@ -1568,30 +1965,16 @@ void poll_events(LISTEN_SOCKETS *sockets
             info("%s listening sockets (used TCP sockets %zu, max allowed for this worker %zu)", (listen_sockets_active)?"ENABLING":"DISABLING", p.used, p.limit);
             for (i = 0; i <= p.max; i++) {
                 if(p.inf[i].flags & POLLINFO_FLAG_SERVER_SOCKET && p.inf[i].socktype == SOCK_STREAM) {
-                    p.fds[i].events = (short int) ((listen_sockets_active) ? POLLIN : 0);
+                    poll_set_events(&p.inf[i], (short int) ((listen_sockets_active) ? POLLIN : 0));
                 }
             }
         }
 
-        debug(D_POLLFD, "POLLFD: LISTENER: Waiting on %zu sockets for %zu ms...", p.max + 1, (size_t)timeout_ms);
-        retval = poll(p.fds, p.max + 1, timeout_ms);
+        retval = poll_events_wait(&p, timeout_ms);
         time_t now = now_boottime_sec();
 
-        if(unlikely(retval == -1)) {
-            error("POLLFD: LISTENER: poll() failed while waiting on %zu sockets.", p.max + 1);
+        if(unlikely(retval == -1))
             break;
-        }
-        else if(unlikely(!retval)) {
-            debug(D_POLLFD, "POLLFD: LISTENER: poll() timeout.");
-        }
-        else {
-            for (i = 0; i <= p.max; i++) {
-                struct pollfd *pf     = &p.fds[i];
-                short int     revents = pf->revents;
-                if (unlikely(revents))
-                    poll_events_process(&p, &p.inf[i], pf, revents, now);
-            }
-        }
 
         if(unlikely(p.checks_every > 0 && now - last_check > p.checks_every)) {
             last_check = now;
@@ -47,6 +47,7 @@ extern char *strdup_client_description(int family, const char *protocol, const c
 
 extern int listen_sockets_setup(LISTEN_SOCKETS *sockets);
 extern void listen_sockets_close(LISTEN_SOCKETS *sockets);
+extern int listen_sockets_reuseport(LISTEN_SOCKETS *dst, LISTEN_SOCKETS *src);
 
 extern int connect_to_this(const char *definition, int default_port, struct timeval *timeout);
 extern int connect_to_one_of(const char *destination, int default_port, struct timeval *timeout, size_t *reconnects_counter, char *connected_to, size_t connected_to_size);
@@ -84,10 +85,12 @@ extern int accept4(int sock, struct sockaddr *addr, socklen_t *addrlen, int flag
 
 // ----------------------------------------------------------------------------
 // poll() based listener
+// on Linux it waits with epoll(), on BSD and macOS with kqueue(), when available
 
 #define POLLINFO_FLAG_SERVER_SOCKET 0x00000001
 #define POLLINFO_FLAG_CLIENT_SOCKET 0x00000002
 #define POLLINFO_FLAG_DONT_CLOSE    0x00000004
+#define POLLINFO_FLAG_ALWAYS_READY  0x00000008 // internal, the kernel cannot poll the fd (e.g. a file), it is always ready
 
 typedef struct poll POLLJOB;
 
@@ -144,6 +147,13 @@ struct poll {
     struct pollinfo *inf;
     struct pollinfo *first_free;
 
+    int kfd;                    // the epoll() or kqueue() fd, -1 when poll() is used
+    short int *kevents;         // the events of each slot registered with the kernel, -1 when not registered
+    void *kready;               // the events returned by the kernel
+    size_t *kready_slots;       // the slots that got events
+    size_t *always_ready;       // the slots with POLLINFO_FLAG_ALWAYS_READY
+    size_t always_ready_used;
+
     SIMPLE_PATTERN *access_list;
 
     void *(*add_callback)(POLLINFO *pi, short int *events, void *data);
@@ -174,6 +184,10 @@ extern POLLINFO *poll_add_fd(POLLJOB *p
                              , void *data
 );
 extern void poll_close_fd(POLLINFO *pi);
+extern void poll_set_events(POLLINFO *pi, short int events);
+
+extern void poll_job_init(POLLJOB *p);
+extern int poll_events_wait(POLLJOB *p, int timeout_ms);
 
 extern void poll_events(LISTEN_SOCKETS *sockets
         , void *(*add_callback)(POLLINFO *pi, short int *events, void *data)
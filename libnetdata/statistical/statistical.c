@@ -120,7 +120,7 @@ LONG_DOUBLE median_on_sorted_series(const LONG_DOUBLE *series, size_t entries) {
     LONG_DOUBLE average;
     if(entries % 2 == 0) {
         size_t m = entries / 2;
-        average = (series[m] + series[m + 1]) / 2;
+        average = (series[m - 1] + series[m]) / 2;
     }
     else {
         average = series[entries / 2];
@@ -129,6 +129,80 @@ LONG_DOUBLE median_on_sorted_series(const LONG_DOUBLE *series, size_t entries) {
     return average;
 }
 
+// moves the k-th smallest value of series to series[k], with no bigger values before it
+// and no smaller values after it - the values must not be NaN
+// this is a quickselect with a median of 3 pivot; when the partitions do not shrink
+// fast enough, the rest of the series is sorted, so that it never gets quadratic
+static void select_series(LONG_DOUBLE *series, size_t entries, size_t k) {
+    ssize_t left = 0, right = (ssize_t)entries - 1, i, j;
+    size_t depth = 0, max_depth = 0;
+    LONG_DOUBLE pivot, t;
+
+    for(i = (ssize_t)entries; i ; i >>= 1) max_depth += 2;
+
+    while(right > left) {
+        if(right - left < 16 || ++depth > max_depth) {
+            // insertion sort the few values that are left
+            if(unlikely(right - left >= 16)) {
+                sort_series(&series[left], (size_t)(right - left + 1));
+                return;
+            }
+
+            for(i = left + 1; i <= right ; i++) {
+                t = series[i];
+                for(j = i; j > left && series[j - 1] > t ; j--)
+                    series[j] = series[j - 1];
+                series[j] = t;
+            }
+            return;
+        }
+
+        // the median of the first, the middle and the last value is the pivot
+        i = left + (right - left) / 2;
+        if(series[i] < series[left])  { t = series[i]; series[i] = series[left]; series[left] = t; }
+        if(series[right] < series[left]) { t = series[right]; series[right] = series[left]; series[left] = t; }
+        if(series[right] < series[i]) { t = series[right]; series[right] = series[i]; series[i] = t; }
+        pivot = series[i];
+
+        for(i = left, j = right; i <= j ;) {
+            while(series[i] < pivot) i++;
+            while(series[j] > pivot) j--;
+            if(i <= j) {
+                t = series[i]; series[i] = series[j]; series[j] = t;
+                i++;
+                j--;
+            }
+        }
+
+        // series[left..j] <= pivot <= series[i..right], and the values in between are equal to pivot
+        if((ssize_t)k <= j) right = j;
+        else if((ssize_t)k >= i) left = i;
+        else return;
+    }
+}
+
+// the median of series, like median_on_sorted_series() gives for the sorted series, without sorting it
+// the order of the values in series is changed - they must not be NaN
+LONG_DOUBLE median_on_unsorted_series(LONG_DOUBLE *series, size_t entries) {
+    if(unlikely(entries == 0)) return NAN;
+    if(unlikely(entries == 1)) return series[0];
+    if(unlikely(entries == 2)) return (series[0] + series[1]) / 2;
+
+    size_t i, m = entries / 2;
+    select_series(series, entries, m);
+
+    if(entries % 2 == 0) {
+        // the other middle value is the biggest of the values before series[m]
+        LONG_DOUBLE below = series[0];
+        for(i = 1; i < m ; i++)
+            if(series[i] > below) below = series[i];
+
+        return (below + series[m]) / 2;
+    }
+
+    return series[m];
+}
+
 LONG_DOUBLE median(const LONG_DOUBLE *series, size_t entries) {
     if(unlikely(entries == 0)) return NAN;
     if(unlikely(entries == 1)) return series[0];
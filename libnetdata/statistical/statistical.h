@@ -20,6 +20,7 @@ extern LONG_DOUBLE holtwinters(const LONG_DOUBLE *series, size_t entries, LONG_D
 extern LONG_DOUBLE sum_and_count(const LONG_DOUBLE *series, size_t entries, size_t *count);
 extern LONG_DOUBLE sum(const LONG_DOUBLE *series, size_t entries);
 extern LONG_DOUBLE median_on_sorted_series(const LONG_DOUBLE *series, size_t entries);
+extern LONG_DOUBLE median_on_unsorted_series(LONG_DOUBLE *series, size_t entries);
 extern LONG_DOUBLE *copy_series(const LONG_DOUBLE *series, size_t entries);
 extern void sort_series(LONG_DOUBLE *series, size_t entries);
 
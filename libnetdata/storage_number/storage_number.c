@@ -2,6 +2,43 @@
 
 #include "../libnetdata.h"
 
+// the values above which a value is divided by 10 or 100 one more time to fit in 24 bits
+static const double pack_divide_above_10[7] = {
+        16777215.0, 167772150.0, 1677721500.0, 16777215000.0, 167772150000.0, 1677721500000.0, 16777215000000.0
+};
+static const double pack_divide_above_100[7] = {
+        16777215.0, 1677721500.0, 167772150000.0, 16777215000000.0, 1677721500000000.0, 167772150000000000.0,
+        16777215000000000000.0
+};
+static const double power_10[8]  = { 1.0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7 };
+static const double power_100[8] = { 1.0, 1e2, 1e4, 1e6, 1e8, 1e10, 1e12, 1e14 };
+
+// the bits 27 to 31 of a storage number (SN_EXISTS_100, the multiplier or divider and
+// multiply or divide) index these, to unpack it with one multiplication and one division
+#define UNPACK_MULTIPLIER { \
+        1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, \
+        1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, \
+        1.0, 1.0, 1e1, 1e2, 1e2, 1e4, 1e3, 1e6, \
+        1e4, 1e8, 1e5, 1e10, 1e6, 1e12, 1e7, 1e14 \
+}
+
+// the divider is always a power of 10, even with SN_EXISTS_100
+#define UNPACK_DIVIDER { \
+        1.0, 1.0, 1e1, 1e1, 1e2, 1e2, 1e3, 1e3, \
+        1e4, 1e4, 1e5, 1e5, 1e6, 1e6, 1e7, 1e7, \
+        1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, \
+        1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 \
+}
+
+static const calculated_number unpack_multiplier[32] = UNPACK_MULTIPLIER;
+static const calculated_number unpack_divider[32] = UNPACK_DIVIDER;
+
+// the same for unpack_storage_number_double(), so that the queries do not touch long doubles
+static const double unpack_multiplier_double[32] = UNPACK_MULTIPLIER;
+static const double unpack_divider_double[32] = UNPACK_DIVIDER;
+
+#define sn_unpack_index(value) (((value) >> 26) & 0x1f)
+
 storage_number pack_storage_number(calculated_number value, uint32_t flags) {
     // bit 32 = sign 0:positive, 1:negative
     // bit 31 = 0:divide, 1:multiply
@@ -14,30 +51,30 @@ storage_number pack_storage_number(calculated_number value, uint32_t flags) {
     storage_number r = get_storage_number_flags(flags);
     if(!value) return r;
 
-    int m = 0;
-    calculated_number n = value, factor = 10;
+    int k, m = 0;
+    calculated_number n = value;
 
     // if the value is negative
     // add the sign bit and make it positive
-    if(n < 0) {
-        r += (1 << 31); // the sign bit 32
-        n = -n;
-    }
+    r += (storage_number)(n < 0) << 31; // the sign bit 32
+    n = calculated_number_fabs(n);
+
+    if(n > (calculated_number)0x00ffffff) {
+        // make its integer part fit in 0x00ffffff
+        // by dividing it by 10 (or 100 for very large values) up to 7 times
+        // the number of times is found by comparing it to the tables, not by a loop
+        const double *divide_above = pack_divide_above_10, *power = power_10;
+        if(n / 10000000.0 > 0x00ffffff) {
+            divide_above = pack_divide_above_100;
+            power = power_100;
+            r |= SN_EXISTS_100;
+        }
 
-    if(n / 10000000.0 > 0x00ffffff) {
-        factor = 100;
-        r |= SN_EXISTS_100;
-    }
+        for(k = 0; k < 7 ; k++)
+            m += (n > (calculated_number)divide_above[k]);
 
-    // make its integer part fit in 0x00ffffff
-    // by dividing it by 10 up to 7 times
-    // and increasing the multiplier
-    while(m < 7 && n > (calculated_number)0x00ffffff) {
-        n /= factor;
-        m++;
-    }
+        n /= (calculated_number)power[m];
 
-    if(m) {
         // the value was too big and we divided it
         // so we add a multiplier to unpack it
         r += (1 << 30) + (m << 27); // the multiplier m
@@ -56,10 +93,10 @@ storage_number pack_storage_number(calculated_number value, uint32_t flags) {
         // while the value is below 0x0019999e we can
         // multiply it by 10, up to 7 times, increasing
         // the multiplier
-        while(m < 7 && n < (calculated_number)0x0019999e) {
-            n *= 10;
-            m++;
-        }
+        for(k = 0; k < 7 ; k++)
+            m += (n * (calculated_number)power_10[k] < (calculated_number)0x0019999e);
+
+        n *= (calculated_number)power_10[m];
 
         // the value was small enough and we multiplied it
         // so we add a divider to unpack it
@@ -77,48 +114,126 @@ storage_number pack_storage_number(calculated_number value, uint32_t flags) {
     return r;
 }
 
-calculated_number unpack_storage_number(storage_number value) {
-    if(!value) return 0;
+// packs entries values at once, like pack_storage_number() does for each one of them
+// the kernel works on doubles and has no data dependent loops, so that the compiler
+// can vectorize it; doubles are way more precise than the 24 bits of a storage_number
+void pack_storage_numbers(const double *values, const uint32_t *flags, storage_number *numbers, size_t entries) {
+    size_t i;
+    for(i = 0; i < entries ; i++) {
+        double n = values[i];
+        storage_number r = get_storage_number_flags(flags[i]);
+        int k, m = 0;
+
+        if(!n) {
+            numbers[i] = r;
+            continue;
+        }
 
-    int sign = 0, exp = 0;
-    int factor = 10;
+        r += (storage_number)(n < 0) << 31; // the sign bit 32
+        n = fabs(n);
 
-    // bit 32 = 0:positive, 1:negative
-    if(unlikely(value & (1 << 31)))
-        sign = 1;
+        int very_large = (n > (double)0x00ffffff * 10000000.0);
+        const double *divide_above = very_large ? pack_divide_above_100 : pack_divide_above_10;
+        r |= very_large ? SN_EXISTS_100 : 0;
 
-    // bit 31 = 0:divide, 1:multiply
-    if(unlikely(value & (1 << 30)))
-        exp = 1;
+        if(n > (double)0x00ffffff) {
+            for(k = 0; k < 7 ; k++)
+                m += (n > divide_above[k]);
 
-    // bit 27 SN_EXISTS_100
-    if(unlikely(value & (1 << 26)))
-        factor = 100;
+            n /= very_large ? power_100[m] : power_10[m];
+            r += (1 << 30) + (m << 27); // the multiplier m
+
+            if(unlikely(n > (double)0x00ffffff)) {
+                numbers[i] = r + 0x00ffffff;
+                continue;
+            }
+        }
+        else {
+            for(k = 0; k < 7 ; k++)
+                m += (n * power_10[k] < (double)0x0019999e);
+
+            n *= power_10[m];
+            r += (0 << 30) + (m << 27); // the divider m
+        }
 
+#ifdef STORAGE_WITH_MATH
+        r += lrint(n);
+#else
+        r += (storage_number)n;
+#endif
+        numbers[i] = r;
+    }
+}
+
+calculated_number unpack_storage_number(storage_number value) {
+    // bit 32 = 0:positive, 1:negative
+    // bit 31 = 0:divide, 1:multiply
+    // bit 30, 29, 28 = (multiplier or divider) 0-7 (8 total)
+    // bit 27 SN_EXISTS_100
     // bit 26 SN_EXISTS_RESET
     // bit 25 SN_EXISTS
+    // bit 24 to bit 1 = the value
+    // an empty slot has all these bits zero and unpacks to zero
 
-    // bit 30, 29, 28 = (multiplier or divider) 0-7 (8 total)
-    int mul = (value & ((1<<29)|(1<<28)|(1<<27))) >> 27;
+    unsigned index = sn_unpack_index(value);
+    calculated_number n = (calculated_number)(value & 0x00ffffff) * unpack_multiplier[index] / unpack_divider[index];
 
-    // bit 24 to bit 1 = the value, so remove all other bits
-    value ^= value & ((1<<31)|(1<<30)|(1<<29)|(1<<28)|(1<<27)|(1<<26)|(1<<25)|(1<<24));
+    return (value & (1U << 31)) ? -n : n;
+}
 
-    calculated_number n = value;
+// the same, in double precision, for the queries
+double unpack_storage_number_double(storage_number value) {
+    unsigned index = sn_unpack_index(value);
+    double n = (double)(value & 0x00ffffff) * unpack_multiplier_double[index] / unpack_divider_double[index];
 
-    // fprintf(stderr, "UNPACK: %08X, sign = %d, exp = %d, mul = %d, factor = %d, n = " CALCULATED_NUMBER_FORMAT "\n", value, sign, exp, mul, factor, n);
+    return (value & (1U << 31)) ? -n : n;
+}
 
-    if(exp) {
-        for(; mul; mul--)
-            n *= factor;
+// unpacks entries storage numbers at once, like unpack_storage_number() does for each one of them
+// the multiplier and the divider are composed from the bits of the storage number with arithmetic
+// instead of table lookups and branches, so that the compiler can vectorize the loop; all of them
+// are integers that doubles represent exactly, so only the final division rounds
+void unpack_storage_number_array(const storage_number *numbers, double *values, size_t entries) {
+    size_t i;
+    for(i = 0; i < entries ; i++) {
+        int32_t value   = (int32_t)(numbers[i] & 0x00ffffff);
+        int32_t sign    = (int32_t)(numbers[i] >> 31);
+        int32_t mul     = (int32_t)((numbers[i] >> 30) & 1);
+        int32_t exp_100 = (int32_t)((numbers[i] >> 26) & 1) & mul;    // SN_EXISTS_100 is only used to multiply
+        int32_t bit0    = (int32_t)((numbers[i] >> 27) & 1);
+        int32_t bit1    = (int32_t)((numbers[i] >> 28) & 1);
+        int32_t bit2    = (int32_t)((numbers[i] >> 29) & 1);
+
+        // 10^m or 100^m, from the 3 bits of m
+        double p = (1.0 + (double)bit0 * (9.0 + 90.0 * (double)exp_100))
+                 * (1.0 + (double)bit1 * (99.0 + 9900.0 * (double)exp_100))
+                 * (1.0 + (double)bit2 * (9999.0 + 99990000.0 * (double)exp_100));
+
+        double multiplier = 1.0 + (double)mul * (p - 1.0);
+        double divider    = 1.0 + (double)(1 - mul) * (p - 1.0);
+
+        values[i] = (double)value * multiplier / divider * (double)(1 - 2 * sign);
     }
-    else {
-        for( ; mul ; mul--)
-            n /= 10;
+}
+
+// unpacks entries storage numbers at once for a query: the ones that do not exist become NAN,
+// *reset is set when any of them has been overflown, and the number of the existing non-zero
+// values is returned - the flags are checked with arithmetic too, to keep the loop vectorizable
+size_t unpack_storage_number_query_array(const storage_number *numbers, double *values, size_t entries, int *reset) {
+    size_t i, non_zero = 0, resets = 0;
+
+    unpack_storage_number_array(numbers, values, entries);
+
+    for(i = 0; i < entries ; i++) {
+        storage_number flags = get_storage_number_flags(numbers[i]);
+
+        values[i] = flags ? values[i] : NAN;
+        non_zero += (size_t)(flags != 0 && values[i] != 0.0);
+        resets += (size_t)(flags == SN_EXISTS_RESET);
     }
 
-    if(sign) n = -n;
-    return n;
+    *reset = resets ? 1 : 0;
+    return non_zero;
 }
 
 /*
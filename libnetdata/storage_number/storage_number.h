@@ -57,6 +57,36 @@ typedef long double collected_number;
 
 #define calculated_number_isnumber(a) (!(fpclassify(a) & (FP_NAN|FP_INFINITE)))
 
+// the numbers of the queries (the values of RRDR, the grouping methods and the formatters)
+//
+// the values read from the database have at most 7 significant digits, which double keeps,
+// so the queries use double - long double is x87 arithmetic the compiler cannot vectorize.
+// Build with NETDATA_LONG_DOUBLE_QUERIES to have them use calculated_number again.
+#if defined(NETDATA_LONG_DOUBLE_QUERIES) && !defined(NETDATA_WITHOUT_LONG_DOUBLE)
+
+typedef long double query_number;
+#define QUERY_NUMBER_FORMAT "%0.7Lf"
+#define QUERY_NUMBER_MODIFIER "Lf"
+
+#define query_number_fabs(x) fabsl(x)
+#define query_number_sqrt(x) sqrtl(x)
+#define unpack_storage_number_query(value) unpack_storage_number(value)
+
+#else // NETDATA_LONG_DOUBLE_QUERIES
+
+typedef double query_number;
+#define QUERY_NUMBER_IS_DOUBLE 1
+#define QUERY_NUMBER_FORMAT "%0.7f"
+#define QUERY_NUMBER_MODIFIER "f"
+
+#define query_number_fabs(x) fabs(x)
+#define query_number_sqrt(x) sqrt(x)
+#define unpack_storage_number_query(value) unpack_storage_number_double(value)
+
+#endif // NETDATA_LONG_DOUBLE_QUERIES
+
+#define query_number_isnumber(a) calculated_number_isnumber(a)
+
 typedef uint32_t storage_number;
 #define STORAGE_NUMBER_FORMAT "%u"
 
@@ -73,7 +103,11 @@ typedef uint32_t storage_number;
 #define did_storage_number_reset(value)  ((get_storage_number_flags(value) == SN_EXISTS_RESET)?1:0)
 
 storage_number pack_storage_number(calculated_number value, uint32_t flags);
+void pack_storage_numbers(const double *values, const uint32_t *flags, storage_number *numbers, size_t entries);
 calculated_number unpack_storage_number(storage_number value);
+double unpack_storage_number_double(storage_number value);
+void unpack_storage_number_array(const storage_number *numbers, double *values, size_t entries);
+size_t unpack_storage_number_query_array(const storage_number *numbers, double *values, size_t entries, int *reset);
 
 int print_calculated_number(char *str, calculated_number value);
 
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "../libnetdata.h"
+
+struct string_pool_entry {
+    uint32_t hash;
+    uint32_t references;
+    size_t length;
+    char str[];
+};
+
+#define string_pool_entry(s) ((struct string_pool_entry *)((s) - offsetof(struct string_pool_entry, str)))
+
+// the strings are added and released while charts, dimensions and variables are created
+// and freed, not while data are collected, so one lock for all of them is good enough
+// it is held only for a hash table lookup, so the threads waiting for it spin for a while before they sleep
+static netdata_adaptive_lock_t string_pool_lock = NETDATA_ADAPTIVE_LOCK_INITIALIZER;
+static HASH_INDEX string_pool_index;
+static int string_pool_initialized = 0;
+
+static size_t string_pool_total_entries = 0;
+static size_t string_pool_total_references = 0;
+static size_t string_pool_total_memory = 0;
+
+static int string_pool_entry_equal(void *item, const void *key) {
+    return !strcmp(((struct string_pool_entry *)item)->str, (const char *)key);
+}
+
+const char *string_pool_get(const char *s) {
+    uint32_t hash = simple_hash(s);
+    struct string_pool_entry *e;
+
+    netdata_adaptive_lock(&string_pool_lock);
+
+    if(unlikely(!string_pool_initialized)) {
+        hash_index_init(&string_pool_index, string_pool_entry_equal);
+        string_pool_initialized = 1;
+    }
+
+    e = hash_index_get(&string_pool_index, hash, s);
+    if(unlikely(!e)) {
+        size_t length = strlen(s);
+
+        e = mallocz(sizeof(struct string_pool_entry) + length + 1);
+        e->hash = hash;
+        e->references = 0;
+        e->length = length;
+        memcpy(e->str, s, length + 1);
+
+        if(unlikely(hash_index_set(&string_pool_index, hash, e->str, e) != e))
+            fatal("STRING POOL: INTERNAL ERROR: string '%s' is already in the pool.", s);
+
+        string_pool_total_entries++;
+        string_pool_total_memory += sizeof(struct string_pool_entry) + length + 1;
+    }
+
+    e->references++;
+    string_pool_total_references++;
+
+    netdata_adaptive_unlock(&string_pool_lock);
+
+    return e->str;
+}
+
+const char *string_pool_dup(const char *s) {
+    struct string_pool_entry *e = string_pool_entry(s);
+
+    netdata_adaptive_lock(&string_pool_lock);
+    e->references++;
+    string_pool_total_references++;
+    netdata_adaptive_unlock(&string_pool_lock);
+
+    return s;
+}
+
+void string_pool_release(const char *s) {
+    if(unlikely(!s)) return;
+
+    struct string_pool_entry *e = string_pool_entry(s);
+
+    netdata_adaptive_lock(&string_pool_lock);
+
+#ifdef NETDATA_INTERNAL_CHECKS
+    if(unlikely(!string_pool_initialized || hash_index_get(&string_pool_index, e->hash, s) != e))
+        fatal("STRING POOL: INTERNAL ERROR: string '%s' is released, but it is not in the pool.", s);
+#endif
+
+    string_pool_total_references--;
+    if(!--e->references) {
+        if(unlikely(hash_index_del(&string_pool_index, e->hash, s) != e))
+            error("STRING POOL: INTERNAL ERROR: string '%s' cannot be deleted from the pool.", s);
+
+        string_pool_total_entries--;
+        string_pool_total_memory -= sizeof(struct string_pool_entry) + e->length + 1;
+        freez(e);
+    }
+
+    netdata_adaptive_unlock(&string_pool_lock);
+}
+
+size_t string_pool_entries(void) {
+    return __atomic_load_n(&string_pool_total_entries, __ATOMIC_RELAXED);
+}
+
+size_t string_pool_references(void) {
+    return __atomic_load_n(&string_pool_total_references, __ATOMIC_RELAXED);
+}
+
+size_t string_pool_memory(void) {
+    return __atomic_load_n(&string_pool_total_memory, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_STRING_POOL_H
+#define NETDATA_STRING_POOL_H 1
+
+#include "../libnetdata.h"
+
+// a pool of reference counted, read-only strings
+// there is only one copy of every string in the pool, so all the users of a string
+// share it and two strings of the pool are equal when their pointers are equal
+
+// returns the string of the pool that is equal to s, adding it when it is not there
+// every call has to be matched with a string_pool_release()
+extern const char *string_pool_get(const char *s) NEVERNULL WARNUNUSED;
+
+// returns s (a string of the pool), with one more reference
+extern const char *string_pool_dup(const char *s) NEVERNULL WARNUNUSED;
+
+// drops a reference to s (a string of the pool), it is freed with the last one
+extern void string_pool_release(const char *s);
+
+// two strings of the pool are equal only when they are the same string
+#define string_pool_equal(a, b) ((a) == (b))
+
+extern size_t string_pool_entries(void);
+extern size_t string_pool_references(void);
+extern size_t string_pool_memory(void);
+
+#endif /* NETDATA_STRING_POOL_H */
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
 
 #include "../libnetdata.h"
+#include <sched.h>
 
 static size_t default_stacksize = 0, wanted_stacksize = 0;
 static pthread_attr_t *attr = NULL;
@@ -8,12 +9,19 @@ static pthread_attr_t *attr = NULL;
 // ----------------------------------------------------------------------------
 // per thread data
 
-typedef struct {
+typedef struct netdata_thread {
     void *arg;
     pthread_t *thread;
     const char *tag;
     void *(*start_routine) (void *);
     NETDATA_THREAD_OPTIONS options;
+
+    struct netdata_thread_pool *pool;
+#ifdef _POSIX_THREAD_CPUTIME
+    clockid_t cpu_clock;        // to read its cpu time from other threads
+    int has_cpu_clock;
+#endif
+    struct netdata_thread *prev, *next; // the running threads of its pool
 } NETDATA_THREAD;
 
 static __thread NETDATA_THREAD *netdata_thread = NULL;
@@ -90,6 +98,264 @@ void netdata_threads_init_after_fork(size_t stacksize) {
 }
 
 
+// ----------------------------------------------------------------------------
+// thread pools
+
+#define THREAD_POOL_FLAG_KEEP_AS_IS  0x01   // do not change the scheduling policy
+#define THREAD_POOL_FLAG_USE_NICE    0x02   // the policy uses the nice level
+#define THREAD_POOL_FLAG_PRIORITY    0x04   // the policy uses the priority
+
+static struct thread_pool_policy {
+    const char *name;
+    int policy;
+    uint8_t flags;
+} thread_pool_policies[] = {
+        { "keep",  0,           THREAD_POOL_FLAG_KEEP_AS_IS },
+        { "none",  0,           THREAD_POOL_FLAG_KEEP_AS_IS },
+#ifdef SCHED_OTHER
+        { "other", SCHED_OTHER, THREAD_POOL_FLAG_USE_NICE },
+        { "nice",  SCHED_OTHER, THREAD_POOL_FLAG_USE_NICE },
+#endif
+#ifdef SCHED_BATCH
+        { "batch", SCHED_BATCH, THREAD_POOL_FLAG_USE_NICE },
+#endif
+#ifdef SCHED_IDLE
+        { "idle",  SCHED_IDLE,  0 },
+#endif
+#ifdef SCHED_RR
+        { "rr",    SCHED_RR,    THREAD_POOL_FLAG_PRIORITY },
+#endif
+#ifdef SCHED_FIFO
+        { "fifo",  SCHED_FIFO,  THREAD_POOL_FLAG_PRIORITY },
+#endif
+        { NULL, 0, 0 }
+};
+
+struct netdata_thread_pool {
+    const char *name;
+    SIMPLE_PATTERN *pattern;    // the tags of its threads
+
+#ifdef __linux__
+    cpu_set_t cpus;
+    int has_cpus;
+#endif
+
+    int policy;
+    int priority;
+    int nice;
+    uint8_t flags;
+
+    netdata_mutex_t mutex;      // protects the members below
+    NETDATA_THREAD *running;
+    size_t threads;
+    size_t started;
+    uint64_t exited_cpu_usec;
+};
+
+// the pools are added at startup, before the threads are created, and they are never removed
+static struct netdata_thread_pool thread_pools[NETDATA_THREAD_POOLS_MAX] = {
+        [0] = {
+                .name = "other",
+                .flags = THREAD_POOL_FLAG_KEEP_AS_IS,
+                .mutex = NETDATA_MUTEX_INITIALIZER,
+        },
+};
+static size_t thread_pools_count = 1;
+
+#ifdef __linux__
+static int thread_pool_parse_cpus(const char *name, const char *cpus, cpu_set_t *set) {
+    CPU_ZERO(set);
+
+    const char *s = cpus;
+    while(*s) {
+        char *end;
+
+        while(*s == ',' || isspace(*s)) s++;
+        if(!*s) break;
+
+        long first = strtol(s, &end, 10), last;
+        if(end == s || first < 0) goto invalid;
+        s = end;
+
+        if(*s == '-') {
+            s++;
+            last = strtol(s, &end, 10);
+            if(end == s || last < first) goto invalid;
+            s = end;
+        }
+        else
+            last = first;
+
+        for(; first <= last && first < CPU_SETSIZE ; first++)
+            CPU_SET(first, set);
+    }
+
+    if(!CPU_COUNT(set)) goto invalid;
+    return 0;
+
+invalid:
+    error("THREAD POOL '%s': invalid cpu affinity '%s' - expected a list of cpus, like '0-3,6'.", name, cpus);
+    return -1;
+}
+#endif
+
+int netdata_thread_pool_add(const char *name, const char *threads, const char *cpus, const char *policy, int priority, int nice) {
+    if(thread_pools_count >= NETDATA_THREAD_POOLS_MAX) {
+        error("THREAD POOL '%s': too many thread pools - the maximum is %d.", name, NETDATA_THREAD_POOLS_MAX);
+        return -1;
+    }
+
+    struct netdata_thread_pool *pool = &thread_pools[thread_pools_count];
+    memset(pool, 0, sizeof(struct netdata_thread_pool));
+
+    if(!policy || !*policy) policy = "keep";
+
+    int i;
+    for(i = 0; thread_pool_policies[i].name ; i++)
+        if(!strcmp(policy, thread_pool_policies[i].name)) break;
+
+    if(!thread_pool_policies[i].name) {
+        error("THREAD POOL '%s': unknown scheduling policy '%s' - keeping the scheduling policy of netdata.", name, policy);
+        i = 0;
+    }
+
+    pool->policy = thread_pool_policies[i].policy;
+    pool->flags = thread_pool_policies[i].flags;
+    pool->nice = nice;
+    pool->priority = priority;
+
+#if defined(HAVE_SCHED_GET_PRIORITY_MIN) && defined(HAVE_SCHED_GET_PRIORITY_MAX)
+    if(pool->flags & THREAD_POOL_FLAG_PRIORITY) {
+        if(pool->priority < sched_get_priority_min(pool->policy)) pool->priority = sched_get_priority_min(pool->policy);
+        if(pool->priority > sched_get_priority_max(pool->policy)) pool->priority = sched_get_priority_max(pool->policy);
+    }
+#endif
+
+    if(cpus && *cpus) {
+#ifdef __linux__
+        pool->has_cpus = (thread_pool_parse_cpus(name, cpus, &pool->cpus) == 0);
+#else
+        error("THREAD POOL '%s': cpu affinity is not supported on this system.", name);
+#endif
+    }
+
+    pool->name = strdupz(name);
+    pool->pattern = simple_pattern_create(threads, NULL, SIMPLE_PATTERN_EXACT);
+    netdata_mutex_init(&pool->mutex);
+
+    __atomic_store_n(&thread_pools_count, thread_pools_count + 1, __ATOMIC_RELEASE);
+
+    info("THREAD POOL '%s': threads '%s', cpu affinity '%s', scheduling policy '%s', priority %d, nice %d", name, threads, (cpus && *cpus)?cpus:"all", thread_pool_policies[i].name, pool->priority, pool->nice);
+    return 0;
+}
+
+// the thread applies the settings of its pool to itself
+static void thread_pool_apply(struct netdata_thread_pool *pool) {
+#ifdef __linux__
+    if(pool->has_cpus) {
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &pool->cpus);
+        if(ret != 0)
+            error("THREAD POOL '%s': cannot set the cpu affinity of thread '%s' (code %d).", pool->name, netdata_thread_tag(), ret);
+    }
+#endif
+
+    if(!(pool->flags & THREAD_POOL_FLAG_KEEP_AS_IS)) {
+        struct sched_param param = { .sched_priority = (pool->flags & THREAD_POOL_FLAG_PRIORITY) ? pool->priority : 0 };
+
+        int ret = pthread_setschedparam(pthread_self(), pool->policy, &param);
+        if(ret != 0)
+            error("THREAD POOL '%s': cannot set the scheduling policy of thread '%s' (code %d).", pool->name, netdata_thread_tag(), ret);
+
+#if defined(__linux__) && defined(HAVE_SETPRIORITY)
+        // on linux the nice level is per thread
+        if(pool->flags & THREAD_POOL_FLAG_USE_NICE && setpriority(PRIO_PROCESS, (id_t)gettid(), pool->nice) != 0)
+            error("THREAD POOL '%s': cannot set the nice level of thread '%s' to %d.", pool->name, netdata_thread_tag(), pool->nice);
+#endif
+    }
+}
+
+static void thread_pool_join(NETDATA_THREAD *nt) {
+    size_t i, count = __atomic_load_n(&thread_pools_count, __ATOMIC_ACQUIRE);
+    struct netdata_thread_pool *pool = &thread_pools[0];
+
+    for(i = 1; i < count ; i++) {
+        if(simple_pattern_matches(thread_pools[i].pattern, nt->tag)) {
+            pool = &thread_pools[i];
+            thread_pool_apply(pool);
+            break;
+        }
+    }
+
+#ifdef _POSIX_THREAD_CPUTIME
+    nt->has_cpu_clock = (pthread_getcpuclockid(pthread_self(), &nt->cpu_clock) == 0);
+#endif
+
+    nt->pool = pool;
+
+    netdata_mutex_lock(&pool->mutex);
+    nt->prev = NULL;
+    nt->next = pool->running;
+    if(pool->running) pool->running->prev = nt;
+    pool->running = nt;
+    pool->threads++;
+    pool->started++;
+    netdata_mutex_unlock(&pool->mutex);
+}
+
+static inline uint64_t thread_cpu_usec(clockid_t clk) {
+    struct timespec ts;
+    if(clock_gettime(clk, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * USEC_PER_SEC + (uint64_t)ts.tv_nsec / NSEC_PER_USEC;
+}
+
+static void thread_pool_leave(NETDATA_THREAD *nt) {
+    struct netdata_thread_pool *pool = nt->pool;
+    if(!pool) return;
+
+    netdata_mutex_lock(&pool->mutex);
+
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    pool->exited_cpu_usec += thread_cpu_usec(CLOCK_THREAD_CPUTIME_ID);
+#endif
+
+    if(nt->next) nt->next->prev = nt->prev;
+    if(nt->prev) nt->prev->next = nt->next;
+    else pool->running = nt->next;
+    pool->threads--;
+
+    netdata_mutex_unlock(&pool->mutex);
+
+    nt->pool = NULL;
+}
+
+size_t netdata_thread_pools_stats(NETDATA_THREAD_POOL_STATS *stats, size_t max) {
+    size_t i, count = __atomic_load_n(&thread_pools_count, __ATOMIC_ACQUIRE);
+
+    for(i = 0; i < count && i < max ; i++) {
+        struct netdata_thread_pool *pool = &thread_pools[i];
+
+        netdata_mutex_lock(&pool->mutex);
+
+        stats[i].name = pool->name;
+        stats[i].threads = pool->threads;
+        stats[i].started = pool->started;
+        stats[i].cpu_usec = pool->exited_cpu_usec;
+
+#ifdef _POSIX_THREAD_CPUTIME
+        // the running threads unlink themselves under this lock, before they exit
+        NETDATA_THREAD *nt;
+        for(nt = pool->running; nt ; nt = nt->next)
+            if(nt->has_cpu_clock)
+                stats[i].cpu_usec += thread_cpu_usec(nt->cpu_clock);
+#endif
+
+        netdata_mutex_unlock(&pool->mutex);
+    }
+
+    return count;
+}
+
+
 // ----------------------------------------------------------------------------
 // netdata_thread_create
 
@@ -102,6 +368,8 @@ static void thread_cleanup(void *ptr) {
     if(!(netdata_thread->options & NETDATA_THREAD_OPTION_DONT_LOG_CLEANUP))
         info("thread with task id %d finished", gettid());
 
+    thread_pool_leave(netdata_thread);
+
     freez((void *)netdata_thread->tag);
     netdata_thread->tag = NULL;
 
@@ -115,6 +383,8 @@ static void *thread_start(void *ptr) {
     if(!(netdata_thread->options & NETDATA_THREAD_OPTION_DONT_LOG_STARTUP))
         info("thread created with task id %d", gettid());
 
+    thread_pool_join(netdata_thread);
+
     if(pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL) != 0)
         error("cannot set pthread cancel type to DEFERRED.");
 
@@ -130,7 +400,7 @@ static void *thread_start(void *ptr) {
 }
 
 int netdata_thread_create(netdata_thread_t *thread, const char *tag, NETDATA_THREAD_OPTIONS options, void *(*start_routine) (void *), void *arg) {
-    NETDATA_THREAD *info = mallocz(sizeof(NETDATA_THREAD));
+    NETDATA_THREAD *info = callocz(1, sizeof(NETDATA_THREAD));
     info->arg = arg;
     info->thread = thread;
     info->tag = strdupz(tag);
@@ -31,6 +31,33 @@ extern int netdata_thread_cancel(netdata_thread_t thread);
 extern int netdata_thread_join(netdata_thread_t thread, void **retval);
 extern int netdata_thread_detach(pthread_t thread);
 
+// ----------------------------------------------------------------------------
+// thread pools
+// the threads are grouped in named pools by their tags - each pool can pin its
+// threads to a set of cpus and run them with its own scheduling policy and nice
+// level, and the cpu time of its threads is accounted
+// the threads that do not match any pool are in the "other" pool
+
+#define NETDATA_THREAD_POOLS_MAX 16
+
+// add a pool for the threads with tags matching the simple pattern threads
+// cpus is a list of cpus, like "0-3,6" (NULL or empty for all), policy is a
+// scheduling policy name (keep, other, nice, batch, idle, rr, fifo), priority is
+// used by rr and fifo, nice by other, nice and batch
+// call it before the threads of the pool are created
+// returns 0 on success
+extern int netdata_thread_pool_add(const char *name, const char *threads, const char *cpus, const char *policy, int priority, int nice);
+
+typedef struct netdata_thread_pool_stats {
+    const char *name;
+    size_t threads;             // the running threads
+    size_t started;             // the threads started so far
+    uint64_t cpu_usec;          // the cpu time of all its threads, the exited ones included
+} NETDATA_THREAD_POOL_STATS;
+
+// fills stats for up to max pools, returns the number of pools
+extern size_t netdata_thread_pools_stats(NETDATA_THREAD_POOL_STATS *stats, size_t max);
+
 #define netdata_thread_self pthread_self
 #define netdata_thread_testcancel pthread_testcancel
 
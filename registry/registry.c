@@ -9,13 +9,20 @@
 
 // ----------------------------------------------------------------------------
 // REGISTRY concurrency locking
+//
+// the requests that only look up the registry (search, switch) run in parallel,
+// the requests that change it (access, delete) run one at a time
 
-static inline void registry_lock(void) {
-    netdata_mutex_lock(&registry.lock);
+static inline void registry_rdlock(void) {
+    netdata_rwlock_rdlock(&registry.lock);
+}
+
+static inline void registry_wrlock(void) {
+    netdata_rwlock_wrlock(&registry.lock);
 }
 
 static inline void registry_unlock(void) {
-    netdata_mutex_unlock(&registry.lock);
+    netdata_rwlock_unlock(&registry.lock);
 }
 
 
@@ -170,7 +177,7 @@ int registry_request_access_json(RRDHOST *host, struct web_client *w, char *pers
 
     // ------------------------------------------------------------------------
 
-    registry_lock();
+    registry_wrlock();
 
     REGISTRY_PERSON *p = registry_request_access(person_guid, machine_guid, url, name, when);
     if(!p) {
@@ -188,7 +195,7 @@ int registry_request_access_json(RRDHOST *host, struct web_client *w, char *pers
 
     buffer_sprintf(w->response.data, ",\n\t\"person_guid\": \"%s\",\n\t\"urls\": [", p->guid);
     struct registry_json_walk_person_urls_callback c = { p, NULL, w, 0 };
-    avl_traverse(&p->person_urls, registry_json_person_url_callback, &c);
+    registry_person_urls_traverse(p, registry_json_person_url_callback, &c);
     buffer_strcat(w->response.data, "\n\t]\n");
 
     registry_json_footer(w);
@@ -204,7 +211,7 @@ int registry_request_delete_json(RRDHOST *host, struct web_client *w, char *pers
     if(!registry.enabled)
         return registry_json_disabled(host, w, "delete");
 
-    registry_lock();
+    registry_wrlock();
 
     REGISTRY_PERSON *p = registry_request_delete(person_guid, machine_guid, url, delete_url, when);
     if(!p) {
@@ -229,7 +236,7 @@ int registry_request_search_json(RRDHOST *host, struct web_client *w, char *pers
     if(!registry.enabled)
         return registry_json_disabled(host, w, "search");
 
-    registry_lock();
+    registry_rdlock();
 
     REGISTRY_MACHINE *m = registry_request_machine(person_guid, machine_guid, url, request_machine, when);
     if(!m) {
@@ -243,7 +250,7 @@ int registry_request_search_json(RRDHOST *host, struct web_client *w, char *pers
 
     buffer_strcat(w->response.data, ",\n\t\"urls\": [");
     struct registry_json_walk_person_urls_callback c = { NULL, m, w, 0 };
-    dictionary_get_all(m->machine_urls, registry_json_machine_url_callback, &c);
+    registry_machine_urls_traverse(m, registry_json_machine_url_callback, &c);
     buffer_strcat(w->response.data, "\n\t]\n");
 
     registry_json_footer(w);
@@ -262,7 +269,7 @@ int registry_request_switch_json(RRDHOST *host, struct web_client *w, char *pers
     (void)url;
     (void)when;
 
-    registry_lock();
+    registry_rdlock();
 
     REGISTRY_PERSON *op = registry_person_find(person_guid);
     if(!op) {
@@ -291,7 +298,7 @@ int registry_request_switch_json(RRDHOST *host, struct web_client *w, char *pers
     struct registry_person_url_callback_verify_machine_exists_data data = { m, 0 };
 
     // verify the old person has access to this machine
-    avl_traverse(&op->person_urls, registry_person_url_callback_verify_machine_exists, &data);
+    registry_person_urls_traverse(op, registry_person_url_callback_verify_machine_exists, &data);
     if(!data.count) {
         registry_json_header(host, w, "switch", REGISTRY_STATUS_FAILED);
         registry_json_footer(w);
@@ -301,7 +308,7 @@ int registry_request_switch_json(RRDHOST *host, struct web_client *w, char *pers
 
     // verify the new person has access to this machine
     data.count = 0;
-    avl_traverse(&np->person_urls, registry_person_url_callback_verify_machine_exists, &data);
+    registry_person_urls_traverse(np, registry_person_url_callback_verify_machine_exists, &data);
     if(!data.count) {
         registry_json_header(host, w, "switch", REGISTRY_STATUS_FAILED);
         registry_json_footer(w);
@@ -328,6 +335,12 @@ int registry_request_switch_json(RRDHOST *host, struct web_client *w, char *pers
 void registry_statistics(void) {
     if(!registry.enabled) return;
 
+    // write the log of the requests, and collect the process saving the database
+    registry_wrlock();
+    registry_log_flush();
+    registry_db_save_check(0);
+    registry_unlock();
+
     static RRDSET *sts = NULL, *stc = NULL, *stm = NULL;
 
     if(unlikely(!sts)) {
@@ -412,10 +425,10 @@ void registry_statistics(void) {
     }
     else rrdset_next(stm);
 
-    rrddim_set(stm, "persons",       registry.persons_memory + registry.persons_count * sizeof(NAME_VALUE) + sizeof(DICTIONARY));
-    rrddim_set(stm, "machines",      registry.machines_memory + registry.machines_count * sizeof(NAME_VALUE) + sizeof(DICTIONARY));
-    rrddim_set(stm, "urls",          registry.urls_memory);
-    rrddim_set(stm, "persons_urls",  registry.persons_urls_memory);
-    rrddim_set(stm, "machines_urls", registry.machines_urls_memory + registry.machines_count * sizeof(DICTIONARY) + registry.machines_urls_count * sizeof(NAME_VALUE));
+    rrddim_set(stm, "persons",       registry_arena_memory(&registry.persons_arena) + registry_index_memory(&registry.persons));
+    rrddim_set(stm, "machines",      registry_arena_memory(&registry.machines_arena) + registry_index_memory(&registry.machines));
+    rrddim_set(stm, "urls",          registry.urls_memory + registry_index_memory(&registry.urls));
+    rrddim_set(stm, "persons_urls",  registry_arena_memory(&registry.persons_urls_arena) + registry_index_memory(&registry.persons_urls));
+    rrddim_set(stm, "machines_urls", registry_arena_memory(&registry.machines_urls_arena) + registry_index_memory(&registry.machines_urls));
     rrdset_done(stm);
 }
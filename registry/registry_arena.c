@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "../daemon/common.h"
+#include "registry_internals.h"
+
+struct registry_arena_record {
+    struct registry_arena_record *next;         // in the free list of the page
+};
+
+struct registry_arena_page {
+    REGISTRY_ARENA *arena;
+
+    struct registry_arena_page *prev_free, *next_free;  // the pages of the arena with free records
+
+    struct registry_arena_record *free;         // the records freed
+    size_t unused;                              // the records never used, at the end of the page
+    size_t used;                                // the records in use
+
+    char *records;
+};
+
+// the records start after the header of the page
+static inline size_t registry_arena_page_header_size(void) {
+    return (sizeof(struct registry_arena_page) + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+static inline struct registry_arena_page *registry_arena_record_page(void *record) {
+    return (struct registry_arena_page *)((uintptr_t)record & ~((uintptr_t)REGISTRY_ARENA_PAGE_SIZE - 1));
+}
+
+static inline void registry_arena_free_list_add(REGISTRY_ARENA *arena, struct registry_arena_page *page) {
+    page->prev_free = NULL;
+    page->next_free = arena->pages_with_free;
+    if(page->next_free) page->next_free->prev_free = page;
+    arena->pages_with_free = page;
+}
+
+static inline void registry_arena_free_list_del(REGISTRY_ARENA *arena, struct registry_arena_page *page) {
+    if(page->prev_free) page->prev_free->next_free = page->next_free;
+    else arena->pages_with_free = page->next_free;
+    if(page->next_free) page->next_free->prev_free = page->prev_free;
+    page->prev_free = page->next_free = NULL;
+}
+
+static struct registry_arena_page *registry_arena_page_create(REGISTRY_ARENA *arena) {
+    void *mem = NULL;
+    int ret = posix_memalign(&mem, REGISTRY_ARENA_PAGE_SIZE, REGISTRY_ARENA_PAGE_SIZE);
+    if(unlikely(ret != 0 || !mem))
+        fatal("Registry: cannot allocate %d bytes for the arena of %s", REGISTRY_ARENA_PAGE_SIZE, arena->name);
+
+    struct registry_arena_page *page = mem;
+    memset(page, 0, sizeof(struct registry_arena_page));
+    page->arena = arena;
+    page->records = (char *)mem + registry_arena_page_header_size();
+    page->unused = arena->records_per_page;
+
+    registry_arena_free_list_add(arena, page);
+    arena->pages++;
+
+    return page;
+}
+
+static void registry_arena_page_free(REGISTRY_ARENA *arena, struct registry_arena_page *page) {
+    registry_arena_free_list_del(arena, page);
+    arena->pages--;
+    free(page);
+}
+
+void registry_arena_init(REGISTRY_ARENA *arena, const char *name, size_t record_size) {
+    // the freed records keep the free list in them
+    if(record_size < sizeof(struct registry_arena_record))
+        record_size = sizeof(struct registry_arena_record);
+
+    record_size = (record_size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    arena->name = name;
+    arena->record_size = record_size;
+    arena->records_per_page = (REGISTRY_ARENA_PAGE_SIZE - registry_arena_page_header_size()) / record_size;
+    arena->pages_with_free = NULL;
+    arena->pages = 0;
+    arena->records = 0;
+}
+
+// frees the pages that are not full - the full ones have to be emptied by the caller
+void registry_arena_destroy(REGISTRY_ARENA *arena) {
+    while(arena->pages_with_free)
+        registry_arena_page_free(arena, arena->pages_with_free);
+
+    if(arena->pages)
+        error("Registry: the arena of %s is destroyed with %zu pages in use", arena->name, arena->pages);
+}
+
+void *registry_arena_alloc(REGISTRY_ARENA *arena) {
+    struct registry_arena_page *page = arena->pages_with_free;
+    if(unlikely(!page))
+        page = registry_arena_page_create(arena);
+
+    void *record;
+    if(page->free) {
+        record = page->free;
+        page->free = page->free->next;
+    }
+    else {
+        record = &page->records[(arena->records_per_page - page->unused) * arena->record_size];
+        page->unused--;
+    }
+
+    page->used++;
+    arena->records++;
+
+    // a full page is not given any more records
+    if(unlikely(!page->free && !page->unused))
+        registry_arena_free_list_del(arena, page);
+
+    memset(record, 0, arena->record_size);
+    return record;
+}
+
+void registry_arena_free(REGISTRY_ARENA *arena, void *record) {
+    struct registry_arena_page *page = registry_arena_record_page(record);
+
+    if(unlikely(page->arena != arena)) {
+        error("INTERNAL ERROR: Registry: record %p does not belong to the arena of %s", record, arena->name);
+        return;
+    }
+
+    int was_full = (!page->free && !page->unused);
+
+    struct registry_arena_record *r = record;
+    r->next = page->free;
+    page->free = r;
+
+    page->used--;
+    arena->records--;
+
+    if(unlikely(was_full))
+        registry_arena_free_list_add(arena, page);
+
+    // give the memory of empty pages back to the system,
+    // unless it is the only page with free records
+    if(unlikely(!page->used && (page->prev_free || page->next_free)))
+        registry_arena_page_free(arena, page);
+}
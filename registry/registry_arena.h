@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_REGISTRY_ARENA_H
+#define NETDATA_REGISTRY_ARENA_H 1
+
+#include "registry.h"
+
+// ----------------------------------------------------------------------------
+// ARENA of fixed size records
+// The registry has millions of small records of a few types. Instead of
+// allocating each one with malloc(), they are carved out of big pages of
+// their type, so that they do not pay the overhead of the allocator.
+// The pages are aligned to their size, so the page of a record is found
+// from its address, and a page is given back to the system when its last
+// record is freed.
+
+#define REGISTRY_ARENA_PAGE_SIZE (64 * 1024)
+
+struct registry_arena_page;
+
+typedef struct registry_arena {
+    const char *name;
+    size_t record_size;                         // the size of each record, aligned to pointers
+    size_t records_per_page;
+
+    struct registry_arena_page *pages_with_free;  // the pages with free records
+
+    size_t pages;                               // the pages allocated
+    size_t records;                             // the records in use
+} REGISTRY_ARENA;
+
+extern void registry_arena_init(REGISTRY_ARENA *arena, const char *name, size_t record_size);
+extern void registry_arena_destroy(REGISTRY_ARENA *arena);
+
+extern void *registry_arena_alloc(REGISTRY_ARENA *arena) NEVERNULL MALLOCLIKE WARNUNUSED;
+extern void registry_arena_free(REGISTRY_ARENA *arena, void *record);
+
+#define registry_arena_memory(arena) ((arena)->pages * REGISTRY_ARENA_PAGE_SIZE)
+
+#endif //NETDATA_REGISTRY_ARENA_H
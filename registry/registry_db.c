@@ -9,100 +9,357 @@ int registry_db_should_be_saved(void) {
 }
 
 // ----------------------------------------------------------------------------
-// INTERNAL FUNCTIONS FOR SAVING REGISTRY OBJECTS
+// THE BINARY REGISTRY DATABASE
+//
+// The database is a snapshot of the registry in native byte order:
+//
+// 1. a header with the number of records of each type and the totals
+// 2. the URLs, each one a uint32_t length and the URL with its terminating NUL
+// 3. the machines, each one followed by its MACHINE_URLs
+// 4. the persons, each one followed by its PERSON_URLs, with their names like the URLs
+// 5. a trailer with the size of the file, to detect truncated files
+//
+// All records are padded to 4 bytes. The URLs and the machines are referenced
+// by their position in the file. The file is loaded with mmap(), so loading
+// it does not parse anything.
+//
+// The snapshot is saved by a forked child, on its copy-on-write copy of the
+// registry, so the registry requests are not blocked while it is written.
+// The parent rotates the registry log at the time of the fork, so the
+// rotated log has the requests after the last saved snapshot, until the
+// child replaces the database and deletes it.
+
+#define REGISTRY_DB_MAGIC "NDREGDB\0"
+#define REGISTRY_DB_TRAILER_MAGIC "NDREGEND"
+#define REGISTRY_DB_VERSION 1
+#define REGISTRY_DB_BYTE_ORDER 0x01020304
+
+#define REGISTRY_DB_ALIGN(x) (((x) + 3) & ~((size_t)3))
+
+struct registry_db_header {
+    char magic[8];                  // REGISTRY_DB_MAGIC
+    uint32_t version;               // REGISTRY_DB_VERSION
+    uint32_t byte_order;            // REGISTRY_DB_BYTE_ORDER, to detect files of other architectures
+
+    // the records in the file
+    uint64_t urls;
+    uint64_t machines;
+    uint64_t machines_urls;
+    uint64_t persons;
+    uint64_t persons_urls;
+
+    // the totals of the registry
+    uint64_t persons_count;
+    uint64_t machines_count;
+    uint64_t usages_count;
+    uint64_t urls_count;
+    uint64_t persons_urls_count;
+    uint64_t machines_urls_count;
+};
+
+struct registry_db_machine {
+    char guid[REGISTRY_DB_ALIGN(GUID_LEN + 1)];
+    uint32_t first_t;
+    uint32_t last_t;
+    uint32_t usages;
+    uint32_t urls;                  // the MACHINE_URLs following it
+};
+
+struct registry_db_machine_url {
+    uint32_t url;                   // the position of the URL in the file
+    uint32_t first_t;
+    uint32_t last_t;
+    uint32_t usages;
+    uint32_t flags;
+};
+
+struct registry_db_person {
+    char guid[REGISTRY_DB_ALIGN(GUID_LEN + 1)];
+    uint32_t first_t;
+    uint32_t last_t;
+    uint32_t usages;
+    uint32_t urls;                  // the PERSON_URLs following it
+};
+
+struct registry_db_person_url {
+    uint32_t url;                   // the position of the URL in the file
+    uint32_t machine;               // the position of the machine in the file
+    uint32_t first_t;
+    uint32_t last_t;
+    uint32_t usages;
+    uint32_t flags;                 // followed by the name, like the URLs
+};
+
+struct registry_db_trailer {
+    char magic[8];                  // REGISTRY_DB_TRAILER_MAGIC
+    uint64_t size;                  // the size of the file
+};
 
-static int registry_machine_save_url(void *entry, void *file) {
-    REGISTRY_MACHINE_URL *mu = entry;
-    FILE *fp = file;
-
-    debug(D_REGISTRY, "Registry: registry_machine_save_url('%s')", mu->url->url);
-
-    int ret = fprintf(fp, "V\t%08x\t%08x\t%08x\t%02x\t%s\n",
-            mu->first_t,
-            mu->last_t,
-            mu->usages,
-            mu->flags,
-            mu->url->url
-    );
+// ----------------------------------------------------------------------------
+// SAVE THE REGISTRY DATABASE
+//
+// Everything here runs in the forked child, which has only the thread that
+// forked it. It must not allocate memory, log, or take locks that other
+// threads could have held at the time of the fork.
+
+#define REGISTRY_DB_SAVE_OK             0
+#define REGISTRY_DB_SAVE_CANNOT_CREATE  1
+#define REGISTRY_DB_SAVE_CANNOT_WRITE   2
+#define REGISTRY_DB_SAVE_CANNOT_RENAME  3
+
+#define REGISTRY_DB_WRITER_BUFFER_SIZE (256 * 1024)
+
+static struct registry_db_writer {
+    int fd;
+    int error;
+    size_t len;
+    uint64_t written;
+    uint32_t urls;                  // the URLs written so far
+    uint32_t machines;              // the machines written so far
+    char buffer[REGISTRY_DB_WRITER_BUFFER_SIZE];
+} registry_db_writer;
+
+static void registry_db_flush(struct registry_db_writer *w) {
+    char *s = w->buffer;
+    size_t len = w->len;
+
+    while(len && !w->error) {
+        ssize_t ret = write(w->fd, s, len);
+        if(ret == -1) {
+            if(errno == EINTR) continue;
+            w->error = 1;
+            break;
+        }
 
-    // error handling is done at registry_db_save()
+        s += ret;
+        len -= (size_t)ret;
+    }
 
-    return ret;
+    w->len = 0;
 }
 
-static int registry_machine_save(void *entry, void *file) {
-    REGISTRY_MACHINE *m = entry;
-    FILE *fp = file;
+static void registry_db_write(struct registry_db_writer *w, const void *data, size_t len) {
+    const char *s = data;
 
-    debug(D_REGISTRY, "Registry: registry_machine_save('%s')", m->guid);
+    while(len) {
+        size_t n = REGISTRY_DB_WRITER_BUFFER_SIZE - w->len;
+        if(n > len) n = len;
 
-    int ret = fprintf(fp, "M\t%08x\t%08x\t%08x\t%s\n",
-            m->first_t,
-            m->last_t,
-            m->usages,
-            m->guid
-    );
+        memcpy(&w->buffer[w->len], s, n);
+        w->len += n;
+        w->written += n;
+        s += n;
+        len -= n;
 
-    if(ret >= 0) {
-        int ret2 = dictionary_get_all(m->machine_urls, registry_machine_save_url, fp);
-        if(ret2 < 0) return ret2;
-        ret += ret2;
+        if(w->len == REGISTRY_DB_WRITER_BUFFER_SIZE)
+            registry_db_flush(w);
     }
+}
 
-    // error handling is done at registry_db_save()
+// writes a string with its length before it, padded to 4 bytes
+static void registry_db_write_string(struct registry_db_writer *w, const char *s, uint32_t len) {
+    static const char zeros[4] = { 0, 0, 0, 0 };
 
-    return ret;
+    registry_db_write(w, &len, sizeof(len));
+    registry_db_write(w, s, len);
+    registry_db_write(w, zeros, REGISTRY_DB_ALIGN(len + 1) - len);
 }
 
-static inline int registry_person_save_url(void *entry, void *file) {
-    REGISTRY_PERSON_URL *pu = entry;
-    FILE *fp = file;
+// the child has its own copy of the registry, so the positions of the URLs
+// and the machines in the file are kept in their links, which are not saved
 
-    debug(D_REGISTRY, "Registry: registry_person_save_url('%s')", pu->url->url);
+static int registry_db_save_url(void *entry, void *data) {
+    REGISTRY_URL *u = entry;
+    struct registry_db_writer *w = data;
 
-    int ret = fprintf(fp, "U\t%08x\t%08x\t%08x\t%02x\t%s\t%s\t%s\n",
-            pu->first_t,
-            pu->last_t,
-            pu->usages,
-            pu->flags,
-            pu->machine->guid,
-            pu->machine_name,
-            pu->url->url
-    );
+    registry_db_write_string(w, u->url, u->len);
+    u->links = w->urls++;
 
-    // error handling is done at registry_db_save()
+    return 0;
+}
 
-    return ret;
+static int registry_db_save_machine(void *entry, void *data) {
+    REGISTRY_MACHINE *m = entry;
+    struct registry_db_writer *w = data;
+
+    struct registry_db_machine dm;
+    memset(&dm, 0, sizeof(dm));
+    strncpyz(dm.guid, m->guid, GUID_LEN);
+    dm.first_t = m->first_t;
+    dm.last_t = m->last_t;
+    dm.usages = m->usages;
+
+    REGISTRY_MACHINE_URL *mu;
+    for(mu = m->machine_urls; mu ; mu = mu->next)
+        dm.urls++;
+
+    registry_db_write(w, &dm, sizeof(dm));
+
+    for(mu = m->machine_urls; mu ; mu = mu->next) {
+        struct registry_db_machine_url dmu = {
+                .url = mu->url->links,
+                .first_t = mu->first_t,
+                .last_t = mu->last_t,
+                .usages = mu->usages,
+                .flags = mu->flags
+        };
+        registry_db_write(w, &dmu, sizeof(dmu));
+    }
+
+    m->links = w->machines++;
+
+    return 0;
 }
 
-static inline int registry_person_save(void *entry, void *file) {
+static int registry_db_save_person(void *entry, void *data) {
     REGISTRY_PERSON *p = entry;
-    FILE *fp = file;
-
-    debug(D_REGISTRY, "Registry: registry_person_save('%s')", p->guid);
-
-    int ret = fprintf(fp, "P\t%08x\t%08x\t%08x\t%s\n",
-            p->first_t,
-            p->last_t,
-            p->usages,
-            p->guid
-    );
-
-    if(ret >= 0) {
-        //int ret2 = dictionary_get_all(p->person_urls, registry_person_save_url, fp);
-        int ret2 = avl_traverse(&p->person_urls, registry_person_save_url, fp);
-        if (ret2 < 0) return ret2;
-        ret += ret2;
+    struct registry_db_writer *w = data;
+
+    struct registry_db_person dp;
+    memset(&dp, 0, sizeof(dp));
+    strncpyz(dp.guid, p->guid, GUID_LEN);
+    dp.first_t = p->first_t;
+    dp.last_t = p->last_t;
+    dp.usages = p->usages;
+
+    REGISTRY_PERSON_URL *pu;
+    for(pu = p->person_urls; pu ; pu = pu->next)
+        dp.urls++;
+
+    registry_db_write(w, &dp, sizeof(dp));
+
+    for(pu = p->person_urls; pu ; pu = pu->next) {
+        struct registry_db_person_url dpu = {
+                .url = pu->url->links,
+                .machine = pu->machine->links,
+                .first_t = pu->first_t,
+                .last_t = pu->last_t,
+                .usages = pu->usages,
+                .flags = pu->flags
+        };
+        registry_db_write(w, &dpu, sizeof(dpu));
+        registry_db_write_string(w, pu->machine_name, (uint32_t)strlen(pu->machine_name));
     }
 
-    // error handling is done at registry_db_save()
+    return 0;
+}
 
-    return ret;
+// writes the snapshot and replaces the database with it
+// it runs in the forked child - it returns one of REGISTRY_DB_SAVE_*
+static int registry_db_save_snapshot(const char *tmp_filename, const char *old_filename, const char *rotated_log_filename) {
+    struct registry_db_writer *w = &registry_db_writer;
+    w->fd = open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    w->error = 0;
+    w->len = 0;
+    w->written = 0;
+    w->urls = 0;
+    w->machines = 0;
+
+    if(w->fd == -1)
+        return REGISTRY_DB_SAVE_CANNOT_CREATE;
+
+    struct registry_db_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, REGISTRY_DB_MAGIC, sizeof(h.magic));
+    h.version = REGISTRY_DB_VERSION;
+    h.byte_order = REGISTRY_DB_BYTE_ORDER;
+    h.urls = registry.urls.entries;
+    h.machines = registry.machines.entries;
+    h.machines_urls = registry.machines_urls.entries;
+    h.persons = registry.persons.entries;
+    h.persons_urls = registry.persons_urls.entries;
+    h.persons_count = registry.persons_count;
+    h.machines_count = registry.machines_count;
+    h.usages_count = registry.usages_count + 1; // this is required - it is lost on db rotation
+    h.urls_count = registry.urls_count;
+    h.persons_urls_count = registry.persons_urls_count;
+    h.machines_urls_count = registry.machines_urls_count;
+    registry_db_write(w, &h, sizeof(h));
+
+    // the URLs and the machines first, since the records after them refer to their positions
+    hash_index_traverse(&registry.urls, registry_db_save_url, w);
+    hash_index_traverse(&registry.machines, registry_db_save_machine, w);
+    hash_index_traverse(&registry.persons, registry_db_save_person, w);
+
+    struct registry_db_trailer t;
+    memcpy(t.magic, REGISTRY_DB_TRAILER_MAGIC, sizeof(t.magic));
+    t.size = w->written + sizeof(t);
+    registry_db_write(w, &t, sizeof(t));
+    registry_db_flush(w);
+
+    if(!w->error && fsync(w->fd) == -1)
+        w->error = 1;
+
+    if(close(w->fd) == -1)
+        w->error = 1;
+
+    if(w->error) {
+        unlink(tmp_filename);
+        return REGISTRY_DB_SAVE_CANNOT_WRITE;
+    }
+
+    // keep the current database as .old
+    if(unlink(old_filename) == -1 && errno != ENOENT)
+        return REGISTRY_DB_SAVE_CANNOT_RENAME;
+
+    if(link(registry.db_filename, old_filename) == -1 && errno != ENOENT)
+        return REGISTRY_DB_SAVE_CANNOT_RENAME;
+
+    // and make the snapshot active
+    if(rename(tmp_filename, registry.db_filename) == -1)
+        return REGISTRY_DB_SAVE_CANNOT_RENAME;
+
+    // the requests of the rotated log are in the database now
+    unlink(rotated_log_filename);
+
+    return REGISTRY_DB_SAVE_OK;
 }
 
-// ----------------------------------------------------------------------------
-// SAVE THE REGISTRY DATABASE
+static void registry_db_save_log_result(int ret) {
+    switch(ret) {
+        case REGISTRY_DB_SAVE_OK:
+            info("Registry: database saved to '%s'", registry.db_filename);
+            break;
+
+        case REGISTRY_DB_SAVE_CANNOT_CREATE:
+            error("Registry: cannot create the temporary file of '%s'. Saving registry DB failed!", registry.db_filename);
+            break;
+
+        case REGISTRY_DB_SAVE_CANNOT_WRITE:
+            error("Registry: cannot write the temporary file of '%s'. Saving registry DB failed!", registry.db_filename);
+            break;
+
+        case REGISTRY_DB_SAVE_CANNOT_RENAME:
+        default:
+            error("Registry: cannot replace '%s' with the new database (code %d). Saving registry DB failed!", registry.db_filename, ret);
+            break;
+    }
+}
+
+// reaps the child saving the database, if it has finished
+// when wait is set, it waits for it to finish
+// it returns 1 if the child is still running
+int registry_db_save_check(int wait) {
+    if(!registry.save_pid)
+        return 0;
+
+    int status = 0;
+    pid_t ret = waitpid(registry.save_pid, &status, wait ? 0 : WNOHANG);
+    if(ret == 0)
+        return 1;
+
+    if(ret == -1)
+        error("Registry: cannot get the status of the process saving the database, pid %d", (int)registry.save_pid);
+    else if(WIFEXITED(status))
+        registry_db_save_log_result(WEXITSTATUS(status));
+    else
+        error("Registry: the process saving the database, pid %d, was killed. Saving registry DB failed!", (int)registry.save_pid);
+
+    registry.save_pid = 0;
+    return 0;
+}
 
+// it has to be called with the registry write locked
 int registry_db_save(void) {
     if(unlikely(!registry.enabled))
         return -1;
@@ -110,114 +367,182 @@ int registry_db_save(void) {
     if(unlikely(!registry_db_should_be_saved()))
         return -2;
 
-    error_log_limit_unlimited();
+    // one save at a time
+    if(unlikely(registry_db_save_check(0)))
+        return -2;
 
     char tmp_filename[FILENAME_MAX + 1];
     char old_filename[FILENAME_MAX + 1];
+    char rotated_log_filename[FILENAME_MAX + 1];
 
     snprintfz(old_filename, FILENAME_MAX, "%s.old", registry.db_filename);
     snprintfz(tmp_filename, FILENAME_MAX, "%s.tmp", registry.db_filename);
+    snprintfz(rotated_log_filename, FILENAME_MAX, "%s.rotated", registry.log_filename);
 
-    debug(D_REGISTRY, "Registry: Creating file '%s'", tmp_filename);
-    FILE *fp = fopen(tmp_filename, "w");
-    if(!fp) {
-        error("Registry: Cannot create file: %s", tmp_filename);
-        error_log_limit_reset();
+    // the requests from now on go to a new log
+    registry_log_rotate(rotated_log_filename);
+    registry.log_count = 0;
+
+    debug(D_REGISTRY, "Registry: forking to save the database to '%s'", registry.db_filename);
+    pid_t pid = fork();
+    if(pid == 0) {
+        // the child
+        _exit(registry_db_save_snapshot(tmp_filename, old_filename, rotated_log_filename));
+    }
+
+    if(pid == -1) {
+        // the snapshot overwrites the links of the URLs and the machines, so it cannot
+        // be saved in this process - the rotated log keeps the requests until the next save
+        error("Registry: cannot fork to save the database. Saving registry DB failed!");
         return -1;
     }
 
-    // dictionary_get_all() has its own locking, so this is safe to do
+    registry.save_pid = pid;
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// LOAD THE REGISTRY DATABASE
+
+struct registry_db_reader {
+    const char *data;
+    size_t pos;
+    size_t size;
+};
+
+static inline const void *registry_db_read(struct registry_db_reader *r, size_t len) {
+    if(unlikely(r->size - r->pos < len))
+        return NULL;
 
-    debug(D_REGISTRY, "Saving all machines");
-    int bytes1 = dictionary_get_all(registry.machines, registry_machine_save, fp);
-    if(bytes1 < 0) {
-        error("Registry: Cannot save registry machines - return value %d", bytes1);
-        fclose(fp);
-        error_log_limit_reset();
-        return bytes1;
+    const void *ret = &r->data[r->pos];
+    r->pos += REGISTRY_DB_ALIGN(len);
+    if(r->pos > r->size) r->pos = r->size;
+    return ret;
+}
+
+static inline const char *registry_db_read_string(struct registry_db_reader *r, uint32_t *len) {
+    const uint32_t *l = registry_db_read(r, sizeof(uint32_t));
+    if(unlikely(!l)) return NULL;
+
+    const char *s = registry_db_read(r, (size_t)*l + 1);
+    if(unlikely(!s || s[*l] != '\0')) return NULL;
+
+    *len = *l;
+    return s;
+}
+
+static size_t registry_db_load_binary(const char *data, size_t size) {
+    struct registry_db_reader r = { .data = data, .pos = 0, .size = size };
+    REGISTRY_URL **urls = NULL;
+    REGISTRY_MACHINE **machines = NULL;
+    size_t i, j, records = 0;
+
+    const struct registry_db_header *h = registry_db_read(&r, sizeof(struct registry_db_header));
+    const struct registry_db_trailer *t = (size >= sizeof(struct registry_db_header) + sizeof(struct registry_db_trailer))
+            ? (const struct registry_db_trailer *)&data[size - sizeof(struct registry_db_trailer)] : NULL;
+
+    if(!h || h->version != REGISTRY_DB_VERSION || h->byte_order != REGISTRY_DB_BYTE_ORDER) {
+        error("Registry: '%s' is of an unsupported version or architecture.", registry.db_filename);
+        return 0;
     }
-    debug(D_REGISTRY, "Registry: saving machines took %d bytes", bytes1);
-
-    debug(D_REGISTRY, "Saving all persons");
-    int bytes2 = dictionary_get_all(registry.persons, registry_person_save, fp);
-    if(bytes2 < 0) {
-        error("Registry: Cannot save registry persons - return value %d", bytes2);
-        fclose(fp);
-        error_log_limit_reset();
-        return bytes2;
+
+    if(!t || memcmp(t->magic, REGISTRY_DB_TRAILER_MAGIC, sizeof(t->magic)) != 0 || t->size != size) {
+        error("Registry: '%s' is truncated.", registry.db_filename);
+        return 0;
     }
-    debug(D_REGISTRY, "Registry: saving persons took %d bytes", bytes2);
-
-    // save the totals
-    fprintf(fp, "T\t%016llx\t%016llx\t%016llx\t%016llx\t%016llx\t%016llx\n",
-            registry.persons_count,
-            registry.machines_count,
-            registry.usages_count + 1, // this is required - it is lost on db rotation
-            registry.urls_count,
-            registry.persons_urls_count,
-            registry.machines_urls_count
-    );
+    r.size -= sizeof(struct registry_db_trailer);
 
-    fclose(fp);
+    if(h->urls > r.size || h->machines > r.size || h->persons > r.size) {
+        error("Registry: '%s' is corrupted.", registry.db_filename);
+        return 0;
+    }
 
-    errno = 0;
+    urls = mallocz((h->urls + 1) * sizeof(REGISTRY_URL *));
+    machines = mallocz((h->machines + 1) * sizeof(REGISTRY_MACHINE *));
 
-    // remove the .old db
-    debug(D_REGISTRY, "Registry: Removing old db '%s'", old_filename);
-    if(unlink(old_filename) == -1 && errno != ENOENT)
-        error("Registry: cannot remove old registry file '%s'", old_filename);
+    for(i = 0; i < h->urls ; i++) {
+        uint32_t len;
+        const char *url = registry_db_read_string(&r, &len);
+        if(unlikely(!url)) goto corrupted;
 
-    // rename the db to .old
-    debug(D_REGISTRY, "Registry: Link current db '%s' to .old: '%s'", registry.db_filename, old_filename);
-    if(link(registry.db_filename, old_filename) == -1 && errno != ENOENT)
-        error("Registry: cannot move file '%s' to '%s'. Saving registry DB failed!", registry.db_filename, old_filename);
+        urls[i] = registry_url_get(url, len);
+        records++;
+    }
 
-    else {
-        // remove the database (it is saved in .old)
-        debug(D_REGISTRY, "Registry: removing db '%s'", registry.db_filename);
-        if (unlink(registry.db_filename) == -1 && errno != ENOENT)
-            error("Registry: cannot remove old registry file '%s'", registry.db_filename);
-
-        // move the .tmp to make it active
-        debug(D_REGISTRY, "Registry: linking tmp db '%s' to active db '%s'", tmp_filename, registry.db_filename);
-        if (link(tmp_filename, registry.db_filename) == -1) {
-            error("Registry: cannot move file '%s' to '%s'. Saving registry DB failed!", tmp_filename,
-                    registry.db_filename);
-
-            // move the .old back
-            debug(D_REGISTRY, "Registry: linking old db '%s' to active db '%s'", old_filename, registry.db_filename);
-            if(link(old_filename, registry.db_filename) == -1)
-                error("Registry: cannot move file '%s' to '%s'. Recovering the old registry DB failed!", old_filename, registry.db_filename);
-        }
-        else {
-            debug(D_REGISTRY, "Registry: removing tmp db '%s'", tmp_filename);
-            if(unlink(tmp_filename) == -1)
-                error("Registry: cannot remove tmp registry file '%s'", tmp_filename);
-
-            // it has been moved successfully
-            // discard the current registry log
-            registry_log_recreate();
-            registry.log_count = 0;
+    for(i = 0; i < h->machines ; i++) {
+        const struct registry_db_machine *dm = registry_db_read(&r, sizeof(struct registry_db_machine));
+        if(unlikely(!dm || dm->guid[GUID_LEN] != '\0')) goto corrupted;
+
+        REGISTRY_MACHINE *m = registry_machine_find(dm->guid);
+        if(!m) m = registry_machine_allocate(dm->guid, dm->first_t);
+        m->last_t = dm->last_t;
+        m->usages = dm->usages;
+        machines[i] = m;
+        records++;
+
+        for(j = 0; j < dm->urls ; j++) {
+            const struct registry_db_machine_url *dmu = registry_db_read(&r, sizeof(struct registry_db_machine_url));
+            if(unlikely(!dmu || dmu->url >= h->urls)) goto corrupted;
+
+            REGISTRY_MACHINE_URL *mu = registry_machine_url_allocate(m, urls[dmu->url], dmu->first_t);
+            mu->last_t = dmu->last_t;
+            mu->usages = dmu->usages;
+            mu->flags = (uint8_t)dmu->flags;
+            records++;
         }
     }
 
-    // continue operations
-    error_log_limit_reset();
+    for(i = 0; i < h->persons ; i++) {
+        const struct registry_db_person *dp = registry_db_read(&r, sizeof(struct registry_db_person));
+        if(unlikely(!dp || dp->guid[GUID_LEN] != '\0')) goto corrupted;
 
-    return -1;
-}
+        REGISTRY_PERSON *p = registry_person_allocate(dp->guid, dp->first_t);
+        p->last_t = dp->last_t;
+        p->usages = dp->usages;
+        records++;
 
-// ----------------------------------------------------------------------------
-// LOAD THE REGISTRY DATABASE
+        for(j = 0; j < dp->urls ; j++) {
+            const struct registry_db_person_url *dpu = registry_db_read(&r, sizeof(struct registry_db_person_url));
+            if(unlikely(!dpu || dpu->url >= h->urls || dpu->machine >= h->machines)) goto corrupted;
 
-size_t registry_db_load(void) {
+            uint32_t len;
+            const char *name = registry_db_read_string(&r, &len);
+            if(unlikely(!name)) goto corrupted;
+
+            REGISTRY_PERSON_URL *pu = registry_person_url_allocate(p, machines[dpu->machine], urls[dpu->url], (char *)name, len, dpu->first_t);
+            pu->last_t = dpu->last_t;
+            pu->usages = dpu->usages;
+            pu->flags = (uint8_t)dpu->flags;
+            records++;
+        }
+    }
+
+    registry.persons_count = h->persons_count;
+    registry.machines_count = h->machines_count;
+    registry.usages_count = h->usages_count;
+    registry.urls_count = h->urls_count;
+    registry.persons_urls_count = h->persons_urls_count;
+    registry.machines_urls_count = h->machines_urls_count;
+
+    freez(urls);
+    freez(machines);
+    return records;
+
+corrupted:
+    error("Registry: '%s' is corrupted at offset %zu. Loaded %zu records from it.", registry.db_filename, r.pos, records);
+    freez(urls);
+    freez(machines);
+    return records;
+}
+
+// the text database of older netdata versions
+static size_t registry_db_load_text(void) {
     char *s, buf[4096 + 1];
     REGISTRY_PERSON *p = NULL;
     REGISTRY_MACHINE *m = NULL;
     REGISTRY_URL *u = NULL;
     size_t line = 0;
 
-    debug(D_REGISTRY, "Registry: loading active db from: '%s'", registry.db_filename);
     FILE *fp = fopen(registry.db_filename, "r");
     if(!fp) {
         error("Registry: cannot open registry file: '%s'", registry.db_filename);
@@ -344,3 +669,42 @@ size_t registry_db_load(void) {
 
     return line;
 }
+
+size_t registry_db_load(void) {
+    debug(D_REGISTRY, "Registry: loading active db from: '%s'", registry.db_filename);
+
+    int fd = open(registry.db_filename, O_RDONLY);
+    if(fd == -1) {
+        error("Registry: cannot open registry file: '%s'", registry.db_filename);
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(struct registry_db_header)) {
+        close(fd);
+        return registry_db_load_text();
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED) {
+        error("Registry: cannot mmap() registry file: '%s'", registry.db_filename);
+        return 0;
+    }
+
+    size_t ret;
+    if(memcmp(data, REGISTRY_DB_MAGIC, sizeof(((struct registry_db_header *)0)->magic)) == 0) {
+        // the whole file is read once, from start to end
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        ret = registry_db_load_binary(data, (size_t)st.st_size);
+        munmap(data, (size_t)st.st_size);
+    }
+    else {
+        munmap(data, (size_t)st.st_size);
+        info("Registry: '%s' is a text database, it will be saved in the binary format.", registry.db_filename);
+        ret = registry_db_load_text();
+    }
+
+    return ret;
+}
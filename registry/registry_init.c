@@ -67,19 +67,23 @@ int registry_init(void) {
     registry.machines_urls_count = 0;
 
     // initialize memory counters
-    registry.persons_memory = 0;
-    registry.machines_memory = 0;
     registry.urls_memory = 0;
-    registry.persons_urls_memory = 0;
-    registry.machines_urls_memory = 0;
 
     // initialize locks
-    netdata_mutex_init(&registry.lock);
+    netdata_rwlock_init(&registry.lock);
 
-    // create dictionaries
-    registry.persons = dictionary_create(DICTIONARY_FLAGS);
-    registry.machines = dictionary_create(DICTIONARY_FLAGS);
-    avl_init(&registry.registry_urls_root_index, registry_url_compare);
+    // create the indexes
+    hash_index_init(&registry.persons, registry_person_equal);
+    hash_index_init(&registry.machines, registry_machine_equal);
+    hash_index_init(&registry.urls, registry_url_equal);
+    hash_index_init(&registry.persons_urls, registry_person_url_equal);
+    hash_index_init(&registry.machines_urls, registry_machine_url_equal);
+
+    // create the arenas
+    registry_arena_init(&registry.persons_arena, "persons", sizeof(REGISTRY_PERSON));
+    registry_arena_init(&registry.machines_arena, "machines", sizeof(REGISTRY_MACHINE));
+    registry_arena_init(&registry.persons_urls_arena, "persons urls", sizeof(REGISTRY_PERSON_URL));
+    registry_arena_init(&registry.machines_urls_arena, "machines urls", sizeof(REGISTRY_MACHINE_URL));
 
     // load the registry database
     if(registry.enabled) {
@@ -94,56 +98,74 @@ int registry_init(void) {
     return 0;
 }
 
-void registry_free(void) {
-    if(!registry.enabled) return;
+struct registry_free_items {
+    void **items;
+    size_t used;
+    size_t size;
+};
 
-    // we need to destroy the dictionaries ourselves
-    // since the dictionaries use memory we allocated
+static int registry_free_collect(void *entry, void *data) {
+    struct registry_free_items *f = data;
 
-    while(registry.persons->values_index.root) {
-        REGISTRY_PERSON *p = ((NAME_VALUE *)registry.persons->values_index.root)->value;
-        registry_person_del(p);
-    }
+    if(f->used < f->size)
+        f->items[f->used++] = entry;
+
+    return 0;
+}
 
-    while(registry.machines->values_index.root) {
-        REGISTRY_MACHINE *m = ((NAME_VALUE *)registry.machines->values_index.root)->value;
+// the items cannot be deleted while hash_index_traverse() runs,
+// so they are collected first, and then deleted one by one
+static void registry_free_index(HASH_INDEX *index, void (*del)(void *item)) {
+    struct registry_free_items f = {
+            .items = mallocz((index->entries + 1) * sizeof(void *)),
+            .used = 0,
+            .size = index->entries
+    };
 
-        // fprintf(stderr, "\nMACHINE: '%s', first: %u, last: %u, usages: %u\n", m->guid, m->first_t, m->last_t, m->usages);
+    hash_index_traverse(index, registry_free_collect, &f);
 
-        while(m->machine_urls->values_index.root) {
-            REGISTRY_MACHINE_URL *mu = ((NAME_VALUE *)m->machine_urls->values_index.root)->value;
+    size_t i;
+    for(i = 0; i < f.used ; i++)
+        del(f.items[i]);
 
-            // fprintf(stderr, "\tURL: '%s', first: %u, last: %u, usages: %u, flags: 0x%02x\n", mu->url->url, mu->first_t, mu->last_t, mu->usages, mu->flags);
+    freez(f.items);
+}
 
-            //debug(D_REGISTRY, "Registry: destroying persons dictionary from url '%s'", mu->url->url);
-            //dictionary_destroy(mu->persons);
+static void registry_free_person(void *item) {
+    registry_person_del((REGISTRY_PERSON *)item);
+}
 
-            debug(D_REGISTRY, "Registry: deleting url '%s' from person '%s'", mu->url->url, m->guid);
-            dictionary_del(m->machine_urls, mu->url->url);
+static void registry_free_machine(void *item) {
+    // REGISTRY_MACHINE *m = item;
+    // fprintf(stderr, "\nMACHINE: '%s', first: %u, last: %u, usages: %u\n", m->guid, m->first_t, m->last_t, m->usages);
 
-            debug(D_REGISTRY, "Registry: unlinking url '%s' from machine", mu->url->url);
-            registry_url_unlink(mu->url);
+    registry_machine_del((REGISTRY_MACHINE *)item);
+}
 
-            debug(D_REGISTRY, "Registry: freeing machine url");
-            freez(mu);
-        }
+void registry_free(void) {
+    if(!registry.enabled) return;
 
-        debug(D_REGISTRY, "Registry: deleting machine '%s' from machines registry", m->guid);
-        dictionary_del(registry.machines, m->guid);
+    debug(D_REGISTRY, "Registry: waiting for the database to be saved");
+    registry_db_save_check(1);
 
-        debug(D_REGISTRY, "Registry: destroying URL dictionary of machine '%s'", m->guid);
-        dictionary_destroy(m->machine_urls);
+    // the persons first, since their URLs link to the machines
 
-        debug(D_REGISTRY, "Registry: freeing machine '%s'", m->guid);
-        freez(m);
-    }
+    debug(D_REGISTRY, "Registry: freeing the persons");
+    registry_free_index(&registry.persons, registry_free_person);
 
-    // and free the memory of remaining dictionary structures
+    debug(D_REGISTRY, "Registry: freeing the machines");
+    registry_free_index(&registry.machines, registry_free_machine);
 
-    debug(D_REGISTRY, "Registry: destroying persons dictionary");
-    dictionary_destroy(registry.persons);
+    debug(D_REGISTRY, "Registry: destroying the indexes");
+    hash_index_destroy(&registry.persons);
+    hash_index_destroy(&registry.machines);
+    hash_index_destroy(&registry.urls);
+    hash_index_destroy(&registry.persons_urls);
+    hash_index_destroy(&registry.machines_urls);
 
-    debug(D_REGISTRY, "Registry: destroying machines dictionary");
-    dictionary_destroy(registry.machines);
+    debug(D_REGISTRY, "Registry: destroying the arenas");
+    registry_arena_destroy(&registry.persons_arena);
+    registry_arena_destroy(&registry.machines_arena);
+    registry_arena_destroy(&registry.persons_urls_arena);
+    registry_arena_destroy(&registry.machines_urls_arena);
 }
-
@@ -8,7 +8,7 @@
 #define REGISTRY_URL_FLAGS_DEFAULT 0x00
 #define REGISTRY_URL_FLAGS_EXPIRED 0x01
 
-#define DICTIONARY_FLAGS (DICTIONARY_FLAG_VALUE_LINK_DONT_CLONE | DICTIONARY_FLAG_NAME_LINK_DONT_CLONE | DICTIONARY_FLAG_SINGLE_THREADED)
+#include "registry_arena.h"
 
 // ----------------------------------------------------------------------------
 // COMMON structures
@@ -26,11 +26,7 @@ struct registry {
     unsigned long long log_count;
 
     // memory counters / statistics
-    unsigned long long persons_memory;
-    unsigned long long machines_memory;
-    unsigned long long urls_memory;
-    unsigned long long persons_urls_memory;
-    unsigned long long machines_urls_memory;
+    unsigned long long urls_memory;         // the rest of the registry is in the arenas
 
     // configuration
     unsigned long long save_registry_every_entries;
@@ -53,13 +49,23 @@ struct registry {
     // open files
     FILE *log_fp;
 
-    // the database
-    DICTIONARY *persons;    // dictionary of REGISTRY_PERSON *,  with key the REGISTRY_PERSON.guid
-    DICTIONARY *machines;   // dictionary of REGISTRY_MACHINE *, with key the REGISTRY_MACHINE.guid
-
-    avl_tree registry_urls_root_index;
+    // the process saving the database
+    pid_t save_pid;
 
-    netdata_mutex_t lock;
+    // the database
+    HASH_INDEX persons;         // index of REGISTRY_PERSON *,  with key the REGISTRY_PERSON.guid
+    HASH_INDEX machines;        // index of REGISTRY_MACHINE *, with key the REGISTRY_MACHINE.guid
+    HASH_INDEX urls;            // index of REGISTRY_URL *, with key the REGISTRY_URL.url
+    HASH_INDEX persons_urls;    // index of REGISTRY_PERSON_URL *, with key their person and URL
+    HASH_INDEX machines_urls;   // index of REGISTRY_MACHINE_URL *, with key their machine and URL
+
+    // the memory of the fixed size records
+    REGISTRY_ARENA persons_arena;
+    REGISTRY_ARENA machines_arena;
+    REGISTRY_ARENA persons_urls_arena;
+    REGISTRY_ARENA machines_urls_arena;
+
+    netdata_rwlock_t lock;
 };
 
 #include "registry_url.h"
@@ -69,6 +75,15 @@ struct registry {
 
 extern struct registry registry;
 
+// the memory of the table of an index
+#define registry_index_memory(index) ((index)->table ? sizeof(struct hash_index_table) + (index)->table->size * sizeof(HASH_INDEX_SLOT) : 0)
+
+// the hash of a pair of records, for the indexes of the PERSON_URLs and the MACHINE_URLs
+static inline uint32_t registry_pair_hash(void *a, uint32_t b) {
+    uint64_t h = ((uint64_t)(uintptr_t)a >> 3) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32) ^ b;
+}
+
 // REGISTRY LOW-LEVEL REQUESTS (in registry-internals.c)
 extern REGISTRY_PERSON *registry_request_access(char *person_guid, char *machine_guid, char *url, char *name, time_t when);
 extern REGISTRY_PERSON *registry_request_delete(char *person_guid, char *machine_guid, char *url, char *delete_url, time_t when);
@@ -78,11 +93,13 @@ extern REGISTRY_MACHINE *registry_request_machine(char *person_guid, char *machi
 extern void registry_log(char action, REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name);
 extern int registry_log_open(void);
 extern void registry_log_close(void);
-extern void registry_log_recreate(void);
+extern void registry_log_flush(void);
+extern void registry_log_rotate(const char *rotated_filename);
 extern ssize_t registry_log_load(void);
 
 // REGISTRY DB (in registry_db.c)
 extern int registry_db_save(void);
+extern int registry_db_save_check(int wait);
 extern size_t registry_db_load(void);
 extern int registry_db_should_be_saved(void);
 
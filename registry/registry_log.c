@@ -3,6 +3,8 @@
 #include "../daemon/common.h"
 #include "registry_internals.h"
 
+#define REGISTRY_LOG_BUFFER_SIZE (64 * 1024)
+
 void registry_log(char action, REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name) {
     if(likely(registry.log_fp)) {
         if(unlikely(fprintf(registry.log_fp, "%c\t%08x\t%s\t%s\t%s\t%s\n",
@@ -32,8 +34,10 @@ int registry_log_open(void) {
 
     registry.log_fp = fopen(registry.log_filename, "a");
     if(registry.log_fp) {
-        if (setvbuf(registry.log_fp, NULL, _IOLBF, 0) != 0)
-            error("Cannot set line buffering on registry log file.");
+        // the requests do not write to the file themselves,
+        // registry_statistics() flushes their log on every iteration
+        if (setvbuf(registry.log_fp, NULL, _IOFBF, REGISTRY_LOG_BUFFER_SIZE) != 0)
+            error("Cannot set buffering on registry log file.");
         return 0;
     }
 
@@ -41,6 +45,11 @@ int registry_log_open(void) {
     return -1;
 }
 
+void registry_log_flush(void) {
+    if(registry.log_fp && fflush(registry.log_fp) != 0)
+        error("Registry: failed to save log. Registry data may be lost in case of abnormal restart.");
+}
+
 void registry_log_close(void) {
     if(registry.log_fp) {
         fclose(registry.log_fp);
@@ -48,31 +57,50 @@ void registry_log_close(void) {
     }
 }
 
-void registry_log_recreate(void) {
-    if(registry.log_fp != NULL) {
-        registry_log_close();
+// moves the log to rotated_filename and opens a new one
+// if rotated_filename exists (the last save of the database failed), the log is appended to it
+void registry_log_rotate(const char *rotated_filename) {
+    registry_log_close();
+
+    if(access(rotated_filename, F_OK) == 0) {
+        FILE *in = fopen(registry.log_filename, "r");
+        FILE *out = fopen(rotated_filename, "a");
 
-        // open it with truncate
-        registry.log_fp = fopen(registry.log_filename, "w");
-        if(registry.log_fp) fclose(registry.log_fp);
-        else error("Cannot truncate registry log '%s'", registry.log_filename);
+        if(in && out) {
+            char buf[4096];
+            size_t len;
 
-        registry.log_fp = NULL;
-        registry_log_open();
+            while((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+                if(fwrite(buf, 1, len, out) != len) {
+                    error("Registry: cannot append the log '%s' to '%s'", registry.log_filename, rotated_filename);
+                    break;
+                }
+            }
+        }
+        else if(out)
+            error("Registry: cannot open the log '%s' to append it to '%s'", registry.log_filename, rotated_filename);
+        else
+            error("Registry: cannot open the rotated log '%s'", rotated_filename);
+
+        if(in) fclose(in);
+        if(out) fclose(out);
+
+        if(unlink(registry.log_filename) == -1 && errno != ENOENT)
+            error("Registry: cannot delete the log '%s'", registry.log_filename);
     }
+    else if(rename(registry.log_filename, rotated_filename) == -1 && errno != ENOENT)
+        error("Registry: cannot rename the log '%s' to '%s'", registry.log_filename, rotated_filename);
+
+    registry_log_open();
 }
 
-ssize_t registry_log_load(void) {
+static ssize_t registry_log_load_file(const char *filename) {
     ssize_t line = -1;
 
-    // closing the log is required here
-    // otherwise we will append to it the values we read
-    registry_log_close();
-
-    debug(D_REGISTRY, "Registry: loading active db from: %s", registry.log_filename);
-    FILE *fp = fopen(registry.log_filename, "r");
+    debug(D_REGISTRY, "Registry: loading active db from: %s", filename);
+    FILE *fp = fopen(filename, "r");
     if(!fp)
-        error("Registry: cannot open registry file: %s", registry.log_filename);
+        error("Registry: cannot open registry file: %s", filename);
     else {
         char *s, buf[4096 + 1];
         line = 0;
@@ -121,7 +149,7 @@ ssize_t registry_log_load(void) {
                     break;
 
                 default:
-                    error("Registry: ignoring line %zd of filename '%s': %s.", line, registry.log_filename, s);
+                    error("Registry: ignoring line %zd of filename '%s': %s.", line, filename, s);
                     break;
             }
         }
@@ -129,6 +157,27 @@ ssize_t registry_log_load(void) {
         fclose(fp);
     }
 
+    return line;
+}
+
+ssize_t registry_log_load(void) {
+    char rotated_filename[FILENAME_MAX + 1];
+    snprintfz(rotated_filename, FILENAME_MAX, "%s.rotated", registry.log_filename);
+
+    // closing the log is required here
+    // otherwise we will append to it the values we read
+    registry_log_close();
+
+    // the log rotated by a save of the database that did not complete
+    // has the requests before the ones of the current log
+    ssize_t line = -1;
+    if(access(rotated_filename, F_OK) == 0)
+        line = registry_log_load_file(rotated_filename);
+
+    ssize_t ret = registry_log_load_file(registry.log_filename);
+    if(ret > 0) line = (line > 0) ? line + ret : ret;
+    else if(line == -1) line = ret;
+
     // open the log again
     registry_log_open();
 
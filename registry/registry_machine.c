@@ -3,28 +3,74 @@
 #include "../daemon/common.h"
 #include "registry_internals.h"
 
+// ----------------------------------------------------------------------------
+// MACHINE and MACHINE_URL INDEXES
+
+// the key of the index of the MACHINE_URLs
+struct registry_machine_url_key {
+    REGISTRY_MACHINE *machine;
+    REGISTRY_URL *url;
+};
+
+int registry_machine_equal(void *item, const void *key) {
+    return !strcmp(((REGISTRY_MACHINE *)item)->guid, (const char *)key);
+}
+
+int registry_machine_url_equal(void *item, const void *key) {
+    REGISTRY_MACHINE_URL *mu = item;
+    const struct registry_machine_url_key *k = key;
+    return mu->machine == k->machine && mu->url == k->url;
+}
+
+REGISTRY_MACHINE_URL *registry_machine_url_find(REGISTRY_MACHINE *m, REGISTRY_URL *u) {
+    struct registry_machine_url_key key = { .machine = m, .url = u };
+    return hash_index_get(&registry.machines_urls, registry_pair_hash(m, u->hash), &key);
+}
+
+// calls callback for all the MACHINE_URLs of a machine, like dictionary_get_all() does
+int registry_machine_urls_traverse(REGISTRY_MACHINE *m, int (*callback)(void *entry, void *data), void *data) {
+    int ret = 0;
+
+    REGISTRY_MACHINE_URL *mu;
+    for(mu = m->machine_urls; mu ; mu = mu->next) {
+        int r = callback(mu, data);
+        if(r < 0) return r;
+        ret += r;
+    }
+
+    return ret;
+}
+
 // ----------------------------------------------------------------------------
 // MACHINE
 
 REGISTRY_MACHINE *registry_machine_find(const char *machine_guid) {
     debug(D_REGISTRY, "Registry: registry_machine_find('%s')", machine_guid);
-    return dictionary_get(registry.machines, machine_guid);
+    return hash_index_get(&registry.machines, simple_hash(machine_guid), machine_guid);
 }
 
 REGISTRY_MACHINE_URL *registry_machine_url_allocate(REGISTRY_MACHINE *m, REGISTRY_URL *u, time_t when) {
     debug(D_REGISTRY, "registry_machine_url_allocate('%s', '%s'): allocating %zu bytes", m->guid, u->url, sizeof(REGISTRY_MACHINE_URL));
 
-    REGISTRY_MACHINE_URL *mu = mallocz(sizeof(REGISTRY_MACHINE_URL));
+    REGISTRY_MACHINE_URL *mu = registry_arena_alloc(&registry.machines_urls_arena);
 
     mu->first_t = mu->last_t = (uint32_t)when;
     mu->usages = 1;
+    mu->machine = m;
     mu->url = u;
     mu->flags = REGISTRY_URL_FLAGS_DEFAULT;
 
-    registry.machines_urls_memory += sizeof(REGISTRY_MACHINE_URL);
-
     debug(D_REGISTRY, "registry_machine_url_allocate('%s', '%s'): indexing URL in machine", m->guid, u->url);
-    dictionary_set(m->machine_urls, u->url, mu, sizeof(REGISTRY_MACHINE_URL));
+    struct registry_machine_url_key key = { .machine = m, .url = u };
+    REGISTRY_MACHINE_URL *tmu = hash_index_set(&registry.machines_urls, registry_pair_hash(m, u->hash), &key, mu);
+    if(tmu != mu) {
+        error("Registry: Attempted to add duplicate machine url '%s' to machine '%s'", u->url, m->guid);
+        registry_arena_free(&registry.machines_urls_arena, mu);
+        return tmu;
+    }
+
+    mu->next = m->machine_urls;
+    m->machine_urls = mu;
 
     registry_url_link(u);
 
@@ -34,24 +80,47 @@ REGISTRY_MACHINE_URL *registry_machine_url_allocate(REGISTRY_MACHINE *m, REGISTR
 REGISTRY_MACHINE *registry_machine_allocate(const char *machine_guid, time_t when) {
     debug(D_REGISTRY, "Registry: registry_machine_allocate('%s'): creating new machine, sizeof(MACHINE)=%zu", machine_guid, sizeof(REGISTRY_MACHINE));
 
-    REGISTRY_MACHINE *m = mallocz(sizeof(REGISTRY_MACHINE));
+    REGISTRY_MACHINE *m = registry_arena_alloc(&registry.machines_arena);
 
     strncpyz(m->guid, machine_guid, GUID_LEN);
 
-    debug(D_REGISTRY, "Registry: registry_machine_allocate('%s'): creating dictionary of urls", machine_guid);
-    m->machine_urls = dictionary_create(DICTIONARY_FLAGS);
+    m->machine_urls = NULL;
 
     m->first_t = m->last_t = (uint32_t)when;
     m->usages = 0;
 
-    registry.machines_memory += sizeof(REGISTRY_MACHINE);
-
     registry.machines_count++;
-    dictionary_set(registry.machines, m->guid, m, sizeof(REGISTRY_MACHINE));
+    REGISTRY_MACHINE *tm = hash_index_set(&registry.machines, simple_hash(m->guid), m->guid, m);
+    if(tm != m) {
+        error("Registry: Attempted to add duplicate machine '%s'", m->guid);
+        registry_arena_free(&registry.machines_arena, m);
+        m = tm;
+    }
 
     return m;
 }
 
+void registry_machine_del(REGISTRY_MACHINE *m) {
+    debug(D_REGISTRY, "Registry: registry_machine_del('%s')", m->guid);
+
+    while(m->machine_urls) {
+        REGISTRY_MACHINE_URL *mu = m->machine_urls;
+        m->machine_urls = mu->next;
+
+        struct registry_machine_url_key key = { .machine = m, .url = mu->url };
+        if(!hash_index_del(&registry.machines_urls, registry_pair_hash(m, mu->url->hash), &key))
+            error("INTERNAL ERROR: Registry: url '%s' of machine '%s' is not indexed", mu->url->url, m->guid);
+
+        registry_url_unlink(mu->url);
+        registry_arena_free(&registry.machines_urls_arena, mu);
+    }
+
+    if(!hash_index_del(&registry.machines, simple_hash(m->guid), m->guid))
+        error("INTERNAL ERROR: Registry: machine '%s' is not indexed", m->guid);
+
+    registry_arena_free(&registry.machines_arena, m);
+}
+
 // 1. validate machine GUID
 // 2. if it is valid, find it or create it and return it
 // 3. if it is not valid, return NULL
@@ -80,7 +149,7 @@ REGISTRY_MACHINE *registry_machine_get(const char *machine_guid, time_t when) {
 REGISTRY_MACHINE_URL *registry_machine_link_to_url(REGISTRY_MACHINE *m, REGISTRY_URL *u, time_t when) {
     debug(D_REGISTRY, "registry_machine_link_to_url('%s', '%s'): searching for URL in machine", m->guid, u->url);
 
-    REGISTRY_MACHINE_URL *mu = dictionary_get(m->machine_urls, u->url);
+    REGISTRY_MACHINE_URL *mu = registry_machine_url_find(m, u);
     if(!mu) {
         debug(D_REGISTRY, "registry_machine_link_to_url('%s', '%s'): not found", m->guid, u->url);
         mu = registry_machine_url_allocate(m, u, when);
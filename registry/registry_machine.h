@@ -10,7 +10,9 @@
 
 // For each MACHINE-URL pair we keep this
 struct registry_machine_url {
+    struct registry_machine *machine;   // the MACHINE of this URL
     REGISTRY_URL *url;          // de-duplicated URL
+    struct registry_machine_url *next;  // the next URL of the same MACHINE
 
     uint8_t flags;
 
@@ -26,7 +28,7 @@ struct registry_machine {
 
     uint32_t links;             // the number of REGISTRY_PERSON_URL linked to this machine
 
-    DICTIONARY *machine_urls;   // MACHINE_URL *
+    REGISTRY_MACHINE_URL *machine_urls; // the MACHINE_URLs of this machine, indexed in registry.machines_urls
 
     uint32_t first_t;           // the first time we saw this
     uint32_t last_t;            // the last time we saw this
@@ -34,7 +36,13 @@ struct registry_machine {
 };
 typedef struct registry_machine REGISTRY_MACHINE;
 
+extern int registry_machine_equal(void *item, const void *key);
+extern int registry_machine_url_equal(void *item, const void *key);
+
 extern REGISTRY_MACHINE *registry_machine_find(const char *machine_guid);
+extern REGISTRY_MACHINE_URL *registry_machine_url_find(REGISTRY_MACHINE *m, REGISTRY_URL *u);
+extern int registry_machine_urls_traverse(REGISTRY_MACHINE *m, int (*callback)(void *entry, void *data), void *data);
+extern void registry_machine_del(REGISTRY_MACHINE *m);
 extern REGISTRY_MACHINE_URL *registry_machine_url_allocate(REGISTRY_MACHINE *m, REGISTRY_URL *u, time_t when);
 extern REGISTRY_MACHINE *registry_machine_allocate(const char *machine_guid, time_t when);
 extern REGISTRY_MACHINE *registry_machine_get(const char *machine_guid, time_t when);
@@ -6,84 +6,124 @@
 // ----------------------------------------------------------------------------
 // PERSON_URL INDEX
 
-int person_url_compare(void *a, void *b) {
-    register uint32_t hash1 = ((REGISTRY_PERSON_URL *)a)->url->hash;
-    register uint32_t hash2 = ((REGISTRY_PERSON_URL *)b)->url->hash;
+// the key of the index of the PERSON_URLs
+struct registry_person_url_key {
+    REGISTRY_PERSON *person;
+    REGISTRY_URL *url;
+};
+
+int registry_person_url_equal(void *item, const void *key) {
+    REGISTRY_PERSON_URL *pu = item;
+    const struct registry_person_url_key *k = key;
+    return pu->person == k->person && pu->url == k->url;
+}
 
-    if(hash1 < hash2) return -1;
-    else if(hash1 > hash2) return 1;
-    else return strcmp(((REGISTRY_PERSON_URL *)a)->url->url, ((REGISTRY_PERSON_URL *)b)->url->url);
+static inline REGISTRY_PERSON_URL *registry_person_url_index_get(REGISTRY_PERSON *p, REGISTRY_URL *u) {
+    struct registry_person_url_key key = { .person = p, .url = u };
+    return hash_index_get(&registry.persons_urls, registry_pair_hash(p, u->hash), &key);
 }
 
 inline REGISTRY_PERSON_URL *registry_person_url_index_find(REGISTRY_PERSON *p, const char *url) {
     debug(D_REGISTRY, "Registry: registry_person_url_index_find('%s', '%s')", p->guid, url);
 
-    char buf[sizeof(REGISTRY_URL) + strlen(url)];
-
-    REGISTRY_URL *u = (REGISTRY_URL *)&buf;
-    strcpy(u->url, url);
-    u->hash = simple_hash(u->url);
-
-    REGISTRY_PERSON_URL tpu = { .url = u };
+    // a URL that is not in the registry is not linked to any person
+    REGISTRY_URL *u = registry_url_find(url);
+    if(!u) return NULL;
 
-    REGISTRY_PERSON_URL *pu = (REGISTRY_PERSON_URL *)avl_search(&p->person_urls, (void *)&tpu);
-    return pu;
+    return registry_person_url_index_get(p, u);
 }
 
 inline REGISTRY_PERSON_URL *registry_person_url_index_add(REGISTRY_PERSON *p, REGISTRY_PERSON_URL *pu) {
     debug(D_REGISTRY, "Registry: registry_person_url_index_add('%s', '%s')", p->guid, pu->url->url);
-    REGISTRY_PERSON_URL *tpu = (REGISTRY_PERSON_URL *)avl_insert(&(p->person_urls), (avl *)(pu));
+
+    struct registry_person_url_key key = { .person = p, .url = pu->url };
+    REGISTRY_PERSON_URL *tpu = hash_index_set(&registry.persons_urls, registry_pair_hash(p, pu->url->hash), &key, pu);
     if(tpu != pu)
         error("Registry: registry_person_url_index_add('%s', '%s') already exists as '%s'", p->guid, pu->url->url, tpu->url->url);
+    else {
+        pu->next = p->person_urls;
+        p->person_urls = pu;
+    }
 
     return tpu;
 }
 
 inline REGISTRY_PERSON_URL *registry_person_url_index_del(REGISTRY_PERSON *p, REGISTRY_PERSON_URL *pu) {
     debug(D_REGISTRY, "Registry: registry_person_url_index_del('%s', '%s')", p->guid, pu->url->url);
-    REGISTRY_PERSON_URL *tpu = (REGISTRY_PERSON_URL *)avl_remove(&(p->person_urls), (avl *)(pu));
+
+    struct registry_person_url_key key = { .person = p, .url = pu->url };
+    REGISTRY_PERSON_URL *tpu = hash_index_del(&registry.persons_urls, registry_pair_hash(p, pu->url->hash), &key);
     if(!tpu)
         error("Registry: registry_person_url_index_del('%s', '%s') deleted nothing", p->guid, pu->url->url);
     else if(tpu != pu)
         error("Registry: registry_person_url_index_del('%s', '%s') deleted wrong URL '%s'", p->guid, pu->url->url, tpu->url->url);
 
+    if(tpu) {
+        REGISTRY_PERSON_URL *t, *last = NULL;
+        for(t = p->person_urls; t && t != tpu ; last = t, t = t->next) ;
+        if(t) {
+            if(last) last->next = t->next;
+            else p->person_urls = t->next;
+        }
+    }
+
     return tpu;
 }
 
+// calls callback for all the PERSON_URLs of a person, like avl_traverse() does
+int registry_person_urls_traverse(REGISTRY_PERSON *p, int (*callback)(void *entry, void *data), void *data) {
+    int ret = 0;
+
+    REGISTRY_PERSON_URL *pu, *next;
+    for(pu = p->person_urls; pu ; pu = next) {
+        next = pu->next;
+
+        int r = callback(pu, data);
+        if(r < 0) return r;
+        ret += r;
+    }
+
+    return ret;
+}
+
 // ----------------------------------------------------------------------------
 // PERSON_URL
 
-REGISTRY_PERSON_URL *registry_person_url_allocate(REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name, size_t namelen, time_t when) {
-    debug(D_REGISTRY, "registry_person_url_allocate('%s', '%s', '%s'): allocating %zu bytes", p->guid, m->guid, u->url, sizeof(REGISTRY_PERSON_URL) + namelen);
-
+// the names of the machines are in the string pool, since many persons give the same names to their machines
+static const char *registry_person_url_name(char *name, size_t namelen) {
     // protection from too big names
     if(namelen > registry.max_name_length)
         namelen = registry.max_name_length;
 
-    REGISTRY_PERSON_URL *pu = mallocz(sizeof(REGISTRY_PERSON_URL) + namelen);
+    char buf[namelen + 1];
+    strncpyz(buf, name, namelen);
+    return string_pool_get(buf);
+}
 
-    // a simple strcpy() should do the job
-    // but I prefer to be safe, since the caller specified urllen
-    strncpyz(pu->machine_name, name, namelen);
+REGISTRY_PERSON_URL *registry_person_url_allocate(REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name, size_t namelen, time_t when) {
+    debug(D_REGISTRY, "registry_person_url_allocate('%s', '%s', '%s'): allocating %zu bytes", p->guid, m->guid, u->url, sizeof(REGISTRY_PERSON_URL));
 
+    REGISTRY_PERSON_URL *pu = registry_arena_alloc(&registry.persons_urls_arena);
+
+    pu->person = p;
     pu->machine = m;
     pu->first_t = pu->last_t = (uint32_t)when;
     pu->usages = 1;
     pu->url = u;
     pu->flags = REGISTRY_URL_FLAGS_DEFAULT;
-    m->links++;
-
-    registry.persons_urls_memory += sizeof(REGISTRY_PERSON_URL) + namelen;
 
     debug(D_REGISTRY, "registry_person_url_allocate('%s', '%s', '%s'): indexing URL in person", p->guid, m->guid, u->url);
     REGISTRY_PERSON_URL *tpu = registry_person_url_index_add(p, pu);
     if(tpu != pu) {
         error("Registry: Attempted to add duplicate person url '%s' with name '%s' to person '%s'", u->url, name, p->guid);
-        freez(pu);
+        registry_arena_free(&registry.persons_urls_arena, pu);
         pu = tpu;
     }
-    else
+    else {
+        pu->machine_name = registry_person_url_name(name, namelen);
+        m->links++;
         registry_url_link(u);
+    }
 
     return pu;
 }
@@ -95,37 +135,18 @@ void registry_person_url_free(REGISTRY_PERSON *p, REGISTRY_PERSON_URL *pu) {
     if(tpu) {
         registry_url_unlink(tpu->url);
         tpu->machine->links--;
-        registry.persons_urls_memory -= sizeof(REGISTRY_PERSON_URL) + strlen(tpu->machine_name);
-        freez(tpu);
+        string_pool_release(tpu->machine_name);
+        registry_arena_free(&registry.persons_urls_arena, tpu);
     }
 }
 
 // this function is needed to change the name of a PERSON_URL
-REGISTRY_PERSON_URL *registry_person_url_reallocate(REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name, size_t namelen, time_t when, REGISTRY_PERSON_URL *pu) {
-    debug(D_REGISTRY, "registry_person_url_reallocate('%s', '%s', '%s'): allocating %zu bytes", p->guid, m->guid, u->url, sizeof(REGISTRY_PERSON_URL) + namelen);
-
-    // keep a backup
-    REGISTRY_PERSON_URL pu2 = {
-            .first_t = pu->first_t,
-            .last_t = pu->last_t,
-            .usages = pu->usages,
-            .flags = pu->flags,
-            .machine = pu->machine,
-            .machine_name = ""
-    };
-
-    // remove the existing one from the index
-    registry_person_url_free(p, pu);
-    pu = &pu2;
+static void registry_person_url_rename(REGISTRY_PERSON_URL *pu, char *name, size_t namelen) {
+    debug(D_REGISTRY, "registry_person_url_rename('%s', '%s'): renaming '%s' to '%s'", pu->person->guid, pu->url->url, pu->machine_name, name);
 
-    // allocate a new one
-    REGISTRY_PERSON_URL *tpu = registry_person_url_allocate(p, m, u, name, namelen, when);
-    tpu->first_t = pu->first_t;
-    tpu->last_t = pu->last_t;
-    tpu->usages = pu->usages;
-    tpu->flags = pu->flags;
-
-    return tpu;
+    const char *old = pu->machine_name;
+    pu->machine_name = registry_person_url_name(name, namelen);
+    string_pool_release(old);
 }
 
 
@@ -134,13 +155,17 @@ REGISTRY_PERSON_URL *registry_person_url_reallocate(REGISTRY_PERSON *p, REGISTRY
 
 REGISTRY_PERSON *registry_person_find(const char *person_guid) {
     debug(D_REGISTRY, "Registry: registry_person_find('%s')", person_guid);
-    return dictionary_get(registry.persons, person_guid);
+    return hash_index_get(&registry.persons, simple_hash(person_guid), person_guid);
+}
+
+int registry_person_equal(void *item, const void *key) {
+    return !strcmp(((REGISTRY_PERSON *)item)->guid, (const char *)key);
 }
 
 REGISTRY_PERSON *registry_person_allocate(const char *person_guid, time_t when) {
     debug(D_REGISTRY, "Registry: registry_person_allocate('%s'): allocating new person, sizeof(PERSON)=%zu", (person_guid)?person_guid:"", sizeof(REGISTRY_PERSON));
 
-    REGISTRY_PERSON *p = mallocz(sizeof(REGISTRY_PERSON));
+    REGISTRY_PERSON *p = registry_arena_alloc(&registry.persons_arena);
     if(!person_guid) {
         for(;;) {
             uuid_t uuid;
@@ -148,7 +173,7 @@ REGISTRY_PERSON *registry_person_allocate(const char *person_guid, time_t when)
             uuid_unparse_lower(uuid, p->guid);
 
             debug(D_REGISTRY, "Registry: Checking if the generated person guid '%s' is unique", p->guid);
-            if (!dictionary_get(registry.persons, p->guid)) {
+            if (!registry_person_find(p->guid)) {
                 debug(D_REGISTRY, "Registry: generated person guid '%s' is unique", p->guid);
                 break;
             }
@@ -159,16 +184,18 @@ REGISTRY_PERSON *registry_person_allocate(const char *person_guid, time_t when)
     else
         strncpyz(p->guid, person_guid, GUID_LEN);
 
-    debug(D_REGISTRY, "Registry: registry_person_allocate('%s'): creating dictionary of urls", p->guid);
-    avl_init(&p->person_urls, person_url_compare);
+    p->person_urls = NULL;
 
     p->first_t = p->last_t = (uint32_t)when;
     p->usages = 0;
 
-    registry.persons_memory += sizeof(REGISTRY_PERSON);
-
     registry.persons_count++;
-    dictionary_set(registry.persons, p->guid, p, sizeof(REGISTRY_PERSON));
+    REGISTRY_PERSON *tp = hash_index_set(&registry.persons, simple_hash(p->guid), p->guid, p);
+    if(tp != p) {
+        error("Registry: Attempted to add duplicate person '%s'", p->guid);
+        registry_arena_free(&registry.persons_arena, p);
+        p = tp;
+    }
 
     return p;
 }
@@ -202,14 +229,15 @@ REGISTRY_PERSON *registry_person_get(const char *person_guid, time_t when) {
 void registry_person_del(REGISTRY_PERSON *p) {
     debug(D_REGISTRY, "Registry: registry_person_del('%s'): creating dictionary of urls", p->guid);
 
-    while(p->person_urls.root)
-        registry_person_unlink_from_url(p, (REGISTRY_PERSON_URL *)p->person_urls.root);
+    while(p->person_urls)
+        registry_person_unlink_from_url(p, p->person_urls);
 
     debug(D_REGISTRY, "Registry: deleting person '%s' from persons registry", p->guid);
-    dictionary_del(registry.persons, p->guid);
+    if(!hash_index_del(&registry.persons, simple_hash(p->guid), p->guid))
+        error("INTERNAL ERROR: Registry: person '%s' is not indexed", p->guid);
 
     debug(D_REGISTRY, "Registry: freeing person '%s'", p->guid);
-    freez(p);
+    registry_arena_free(&registry.persons_arena, p);
 }
 
 // ----------------------------------------------------------------------------
@@ -218,7 +246,7 @@ void registry_person_del(REGISTRY_PERSON *p) {
 REGISTRY_PERSON_URL *registry_person_link_to_url(REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name, size_t namelen, time_t when) {
     debug(D_REGISTRY, "registry_person_link_to_url('%s', '%s', '%s'): searching for URL in person", p->guid, m->guid, u->url);
 
-    REGISTRY_PERSON_URL *pu = registry_person_url_index_find(p, u->url);
+    REGISTRY_PERSON_URL *pu = registry_person_url_index_get(p, u);
     if(!pu) {
         debug(D_REGISTRY, "registry_person_link_to_url('%s', '%s', '%s'): not found", p->guid, m->guid, u->url);
         pu = registry_person_url_allocate(p, m, u, name, namelen, when);
@@ -230,7 +258,7 @@ REGISTRY_PERSON_URL *registry_person_link_to_url(REGISTRY_PERSON *p, REGISTRY_MA
         if(likely(pu->last_t < (uint32_t)when)) pu->last_t = (uint32_t)when;
 
         if(pu->machine != m) {
-            REGISTRY_MACHINE_URL *mu = dictionary_get(pu->machine->machine_urls, u->url);
+            REGISTRY_MACHINE_URL *mu = registry_machine_url_find(pu->machine, u);
             if(mu) {
                 debug(D_REGISTRY, "registry_person_link_to_url('%s', '%s', '%s'): URL switched machines (old was '%s') - expiring it from previous machine.",
                      p->guid, m->guid, u->url, pu->machine->guid);
@@ -243,11 +271,13 @@ REGISTRY_PERSON_URL *registry_person_link_to_url(REGISTRY_PERSON *p, REGISTRY_MA
 
             pu->machine->links--;
             pu->machine = m;
+            m->links++;
         }
 
-        if(strcmp(pu->machine_name, name) != 0) {
+        size_t len = (namelen > registry.max_name_length) ? registry.max_name_length : namelen;
+        if(strncmp(pu->machine_name, name, len) != 0 || pu->machine_name[len] != '\0') {
             // the name of the PERSON_URL has changed !
-            pu = registry_person_url_reallocate(p, m, u, name, namelen, when, pu);
+            registry_person_url_rename(pu, name, namelen);
         }
     }
 
@@ -10,19 +10,18 @@
 
 // for each PERSON-URL pair we keep this
 struct registry_person_url {
-    avl avl;                    // binary tree node
-
+    struct registry_person *person;     // the PERSON of this URL
     REGISTRY_URL *url;          // de-duplicated URL
     REGISTRY_MACHINE *machine;  // link the MACHINE of this URL
+    struct registry_person_url *next;   // the next URL of the same PERSON
+
+    const char *machine_name;   // the name of the machine, as known by the user (in the string pool)
 
     uint8_t flags;
 
     uint32_t first_t;           // the first time we saw this
     uint32_t last_t;            // the last time we saw this
     uint32_t usages;            // how many times this has been accessed
-
-    char machine_name[1];       // the name of the machine, as known by the user
-    // dynamically allocated to fit properly
 };
 typedef struct registry_person_url REGISTRY_PERSON_URL;
 
@@ -30,7 +29,7 @@ typedef struct registry_person_url REGISTRY_PERSON_URL;
 struct registry_person {
     char guid[GUID_LEN + 1];    // the person GUID
 
-    avl_tree person_urls;       // dictionary of PERSON_URLs
+    REGISTRY_PERSON_URL *person_urls;   // the PERSON_URLs of this person, indexed in registry.persons_urls
 
     uint32_t first_t;           // the first time we saw this
     uint32_t last_t;            // the last time we saw this
@@ -42,14 +41,16 @@ struct registry_person {
 typedef struct registry_person REGISTRY_PERSON;
 
 // PERSON_URL
+extern int registry_person_url_equal(void *item, const void *key);
 extern REGISTRY_PERSON_URL *registry_person_url_index_find(REGISTRY_PERSON *p, const char *url);
 extern REGISTRY_PERSON_URL *registry_person_url_index_add(REGISTRY_PERSON *p, REGISTRY_PERSON_URL *pu) NEVERNULL WARNUNUSED;
 extern REGISTRY_PERSON_URL *registry_person_url_index_del(REGISTRY_PERSON *p, REGISTRY_PERSON_URL *pu) WARNUNUSED;
+extern int registry_person_urls_traverse(REGISTRY_PERSON *p, int (*callback)(void *entry, void *data), void *data);
 
 extern REGISTRY_PERSON_URL *registry_person_url_allocate(REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name, size_t namelen, time_t when);
-extern REGISTRY_PERSON_URL *registry_person_url_reallocate(REGISTRY_PERSON *p, REGISTRY_MACHINE *m, REGISTRY_URL *u, char *name, size_t namelen, time_t when, REGISTRY_PERSON_URL *pu);
 
 // PERSON
+extern int registry_person_equal(void *item, const void *key);
 extern REGISTRY_PERSON *registry_person_find(const char *person_guid);
 extern REGISTRY_PERSON *registry_person_allocate(const char *person_guid, time_t when);
 extern REGISTRY_PERSON *registry_person_get(const char *person_guid, time_t when);
@@ -6,18 +6,21 @@
 // ----------------------------------------------------------------------------
 // REGISTRY_URL
 
-int registry_url_compare(void *a, void *b) {
-    if(((REGISTRY_URL *)a)->hash < ((REGISTRY_URL *)b)->hash) return -1;
-    else if(((REGISTRY_URL *)a)->hash > ((REGISTRY_URL *)b)->hash) return 1;
-    else return strcmp(((REGISTRY_URL *)a)->url, ((REGISTRY_URL *)b)->url);
+int registry_url_equal(void *item, const void *key) {
+    return !strcmp(((REGISTRY_URL *)item)->url, (const char *)key);
 }
 
 inline REGISTRY_URL *registry_url_index_add(REGISTRY_URL *u) {
-    return (REGISTRY_URL *)avl_insert(&(registry.registry_urls_root_index), (avl *)(u));
+    return (REGISTRY_URL *)hash_index_set(&registry.urls, u->hash, u->url, u);
 }
 
 inline REGISTRY_URL *registry_url_index_del(REGISTRY_URL *u) {
-    return (REGISTRY_URL *)avl_remove(&(registry.registry_urls_root_index), (avl *)(u));
+    return (REGISTRY_URL *)hash_index_del(&registry.urls, u->hash, u->url);
+}
+
+// returns the URL, if it is in the registry
+REGISTRY_URL *registry_url_find(const char *url) {
+    return (REGISTRY_URL *)hash_index_get(&registry.urls, simple_hash(url), url);
 }
 
 REGISTRY_URL *registry_url_get(const char *url, size_t urllen) {
@@ -27,13 +30,11 @@ REGISTRY_URL *registry_url_get(const char *url, size_t urllen) {
 
     debug(D_REGISTRY, "Registry: registry_url_get('%s', %zu)", url, urllen);
 
-    char buf[sizeof(REGISTRY_URL) + urllen]; // no need for +1, 1 is already in REGISTRY_URL
-    REGISTRY_URL *n = (REGISTRY_URL *)&buf[0];
-    n->len = (uint16_t)urllen;
-    strncpyz(n->url, url, n->len);
-    n->hash = simple_hash(n->url);
+    char buf[urllen + 1];
+    strncpyz(buf, url, urllen);
+    uint32_t hash = simple_hash(buf);
 
-    REGISTRY_URL *u = (REGISTRY_URL *)avl_search(&(registry.registry_urls_root_index), (avl *)n);
+    REGISTRY_URL *n, *u = (REGISTRY_URL *)hash_index_get(&registry.urls, hash, buf);
     if(!u) {
         debug(D_REGISTRY, "Registry: registry_url_get('%s', %zu): allocating %zu bytes", url, urllen, sizeof(REGISTRY_URL) + urllen);
         u = callocz(1, sizeof(REGISTRY_URL) + urllen); // no need for +1, 1 is already in REGISTRY_URL
@@ -43,7 +44,7 @@ REGISTRY_URL *registry_url_get(const char *url, size_t urllen) {
         u->len = (uint16_t)urllen;
         strncpyz(u->url, url, u->len);
         u->links = 0;
-        u->hash = simple_hash(u->url);
+        u->hash = hash;
 
         registry.urls_memory += sizeof(REGISTRY_URL) + urllen; // no need for +1, 1 is already in REGISTRY_URL
 
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "rrdpush.h"
+
+#ifdef ENABLE_COMPRESSION
+#include <lz4.h>
+
+/*
+ * rrdpush compression
+ *
+ * When the sender and the receiver agree on it, everything the sender
+ * sends after the receiver has replied to the STREAM request is compressed
+ * with LZ4, in blocks of up to RRDPUSH_COMPRESSION_MAX_BLOCK bytes.
+ *
+ * Every block starts with a 4 byte header: RRDPUSH_COMPRESSION_SIGNATURE
+ * and the size of its compressed data, 3 bytes, the least significant first.
+ *
+ * The blocks are compressed as a stream: every block refers to the data of
+ * the previous ones, so that small blocks, like the ones of the charts of a
+ * single collection, are compressed well too.
+ */
+
+#define RRDPUSH_COMPRESSION_SIGNATURE 0xac
+#define RRDPUSH_COMPRESSION_HEADER_SIZE 4
+#define RRDPUSH_COMPRESSION_MAX_BLOCK (16 * 1024)
+#define RRDPUSH_COMPRESSION_DICTIONARY (64 * 1024)
+
+#ifndef LZ4_DECODER_RING_BUFFER_SIZE
+#define LZ4_DECODER_RING_BUFFER_SIZE(maxBlockSize) (65536 + 14 + (maxBlockSize))
+#endif
+
+#define RRDPUSH_DECOMPRESSION_RING_SIZE LZ4_DECODER_RING_BUFFER_SIZE(RRDPUSH_COMPRESSION_MAX_BLOCK)
+
+// ----------------------------------------------------------------------------
+// compression, at the sender
+
+struct rrdpush_compressor {
+    LZ4_stream_t *stream;
+    char *dictionary;                   // the last data compressed, the next blocks refer to them
+};
+
+struct rrdpush_compressor *rrdpush_compressor_create(void) {
+    struct rrdpush_compressor *c = callocz(1, sizeof(struct rrdpush_compressor));
+    c->dictionary = mallocz(RRDPUSH_COMPRESSION_DICTIONARY);
+    c->stream = LZ4_createStream();
+    if(unlikely(!c->stream))
+        fatal("STREAM: cannot allocate an LZ4 stream.");
+    return c;
+}
+
+// the blocks compressed after a reset do not refer to the ones before it
+void rrdpush_compressor_reset(struct rrdpush_compressor *c) {
+    LZ4_freeStream(c->stream);
+    c->stream = LZ4_createStream();
+    if(unlikely(!c->stream))
+        fatal("STREAM: cannot allocate an LZ4 stream.");
+}
+
+void rrdpush_compressor_free(struct rrdpush_compressor *c) {
+    if(!c) return;
+
+    LZ4_freeStream(c->stream);
+    freez(c->dictionary);
+    freez(c);
+}
+
+// appends the len bytes of data to out, compressed in blocks
+// returns the bytes appended, 0 on failure
+size_t rrdpush_compress(struct rrdpush_compressor *c, const char *data, size_t len, BUFFER *out) {
+    size_t appended = 0;
+
+    while(len) {
+        int size = (int)((len > RRDPUSH_COMPRESSION_MAX_BLOCK) ? RRDPUSH_COMPRESSION_MAX_BLOCK : len);
+        int bound = LZ4_compressBound(size);
+
+        buffer_need_bytes(out, RRDPUSH_COMPRESSION_HEADER_SIZE + bound + 1);
+        unsigned char *header = (unsigned char *)&out->buffer[out->len];
+
+        int compressed = LZ4_compress_fast_continue(c->stream, data, (char *)&header[RRDPUSH_COMPRESSION_HEADER_SIZE], size, bound, 1);
+        if(unlikely(compressed <= 0)) {
+            error("STREAM: LZ4 failed to compress %d bytes.", size);
+            return 0;
+        }
+
+        // the data of the block are in the buffer of the caller, keep what
+        // the next blocks may refer to
+        LZ4_saveDict(c->stream, c->dictionary, RRDPUSH_COMPRESSION_DICTIONARY);
+
+        header[0] = RRDPUSH_COMPRESSION_SIGNATURE;
+        header[1] = (unsigned char)(compressed & 0xff);
+        header[2] = (unsigned char)((compressed >> 8) & 0xff);
+        header[3] = (unsigned char)((compressed >> 16) & 0xff);
+
+        out->len += RRDPUSH_COMPRESSION_HEADER_SIZE + compressed;
+        appended += RRDPUSH_COMPRESSION_HEADER_SIZE + compressed;
+
+        data += size;
+        len -= size;
+    }
+
+    out->buffer[out->len] = '\0';
+    return appended;
+}
+
+// ----------------------------------------------------------------------------
+// decompression, at the receiver
+
+struct rrdpush_decompressor {
+    LZ4_streamDecode_t *stream;
+    char *ring;                         // the decompressed data, the next blocks refer to them
+    size_t end;                         // where the next block will be decompressed in the ring
+};
+
+struct rrdpush_decompressor *rrdpush_decompressor_create(void) {
+    struct rrdpush_decompressor *d = callocz(1, sizeof(struct rrdpush_decompressor));
+    d->ring = mallocz(RRDPUSH_DECOMPRESSION_RING_SIZE);
+    d->stream = LZ4_createStreamDecode();
+    if(unlikely(!d->stream))
+        fatal("STREAM: cannot allocate an LZ4 decompression stream.");
+    return d;
+}
+
+void rrdpush_decompressor_free(struct rrdpush_decompressor *d) {
+    if(!d) return;
+
+    LZ4_freeStreamDecode(d->stream);
+    freez(d->ring);
+    freez(d);
+}
+
+// appends to out the decompressed data of the complete blocks in the len bytes of data
+// returns the bytes of data used - the rest have to be given again, with the data that
+// follow them - or -1 when the data are not valid
+ssize_t rrdpush_decompress(struct rrdpush_decompressor *d, const char *data, size_t len, BUFFER *out) {
+    size_t pos = 0;
+
+    while(len - pos >= RRDPUSH_COMPRESSION_HEADER_SIZE) {
+        const unsigned char *header = (const unsigned char *)&data[pos];
+
+        size_t size = (size_t)header[1] | ((size_t)header[2] << 8) | ((size_t)header[3] << 16);
+        if(unlikely(header[0] != RRDPUSH_COMPRESSION_SIGNATURE || !size || size > LZ4_COMPRESSBOUND(RRDPUSH_COMPRESSION_MAX_BLOCK))) {
+            error("STREAM: received an invalid compressed block header.");
+            return -1;
+        }
+
+        if(len - pos < RRDPUSH_COMPRESSION_HEADER_SIZE + size)
+            break;
+
+        // the blocks are decompressed one after the other in the ring,
+        // starting over from its beginning when the next one may not fit
+        if(d->end + RRDPUSH_COMPRESSION_MAX_BLOCK > RRDPUSH_DECOMPRESSION_RING_SIZE)
+            d->end = 0;
+
+        int bytes = LZ4_decompress_safe_continue(d->stream, &data[pos + RRDPUSH_COMPRESSION_HEADER_SIZE], &d->ring[d->end], (int)size, RRDPUSH_COMPRESSION_MAX_BLOCK);
+        if(unlikely(bytes <= 0)) {
+            error("STREAM: LZ4 failed to decompress a block of %zu bytes.", size);
+            return -1;
+        }
+
+        buffer_need_bytes(out, (size_t)bytes + 1);
+        memcpy(&out->buffer[out->len], &d->ring[d->end], (size_t)bytes);
+        out->len += (size_t)bytes;
+        out->buffer[out->len] = '\0';
+
+        d->end += (size_t)bytes;
+        pos += RRDPUSH_COMPRESSION_HEADER_SIZE + size;
+    }
+
+    return (ssize_t)pos;
+}
+
+#endif // ENABLE_COMPRESSION
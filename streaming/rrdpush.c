@@ -10,8 +10,8 @@
  * 1. a random data collection thread, calling rrdset_done_push()
  *    this is called for each chart.
  *
- *    the output of this work is kept in a BUFFER in RRDHOST
- *    the sender thread is signalled via a pipe (also in RRDHOST)
+ *    the output of this work is appended to a queue of the thread
+ *    for the host, the sender thread is signalled via a pipe in RRDHOST
  *
  * 2. a sender thread running at the sending netdata
  *    this is spawned automatically on the first chart to be pushed
@@ -21,11 +21,14 @@
  *
  * 3. a receiver thread, running at the receiving netdata
  *    this is spawned automatically when the sender connects to
- *    the receiver.
+ *    the receiver. Once the connection is set up, it is given to
+ *    one of a few receiver threads, which poll all the connections
+ *    and process the metrics of each one as they arrive.
  *
  */
 
 #define START_STREAMING_PROMPT "Hit me baby, push them over..."
+#define START_STREAMING_PROMPT_VERSION "Hit me baby, push them over with the version="
 
 typedef enum {
     RRDPUSH_MULTIPLE_CONNECTIONS_ALLOW,
@@ -48,6 +51,24 @@ unsigned int default_rrdpush_enabled = 0;
 char *default_rrdpush_destination = NULL;
 char *default_rrdpush_api_key = NULL;
 char *default_rrdpush_send_charts_matching = NULL;
+static int default_rrdpush_binary = CONFIG_BOOLEAN_YES;
+static size_t default_rrdpush_buffer_size = 1024 * 1024;
+static int default_rrdpush_receiver_threads = 1;
+static int default_rrdpush_replication = CONFIG_BOOLEAN_YES;
+static size_t default_rrdpush_replication_bytes_per_second = 1024 * 1024;
+#ifdef ENABLE_COMPRESSION
+static int default_rrdpush_compression = CONFIG_BOOLEAN_YES;
+#endif
+
+typedef enum rrdpush_downsample_method {
+    RRDPUSH_DOWNSAMPLE_AVERAGE,
+    RRDPUSH_DOWNSAMPLE_MAX,
+    RRDPUSH_DOWNSAMPLE_LAST
+} RRDPUSH_DOWNSAMPLE_METHOD;
+
+static SIMPLE_PATTERN *default_rrdpush_downsample_charts = NULL;
+static int default_rrdpush_downsample_every = 10;
+static RRDPUSH_DOWNSAMPLE_METHOD default_rrdpush_downsample_method = RRDPUSH_DOWNSAMPLE_AVERAGE;
 
 static void load_stream_conf() {
     errno = 0;
@@ -72,6 +93,32 @@ int rrdpush_init() {
     default_rrdpush_destination = appconfig_get(&stream_config, CONFIG_SECTION_STREAM, "destination", "");
     default_rrdpush_api_key     = appconfig_get(&stream_config, CONFIG_SECTION_STREAM, "api key", "");
     default_rrdpush_send_charts_matching      = appconfig_get(&stream_config, CONFIG_SECTION_STREAM, "send charts matching", "*");
+    default_rrdpush_binary      = appconfig_get_boolean(&stream_config, CONFIG_SECTION_STREAM, "binary protocol", default_rrdpush_binary);
+    default_rrdpush_buffer_size = (size_t)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "buffer size bytes", (long long)default_rrdpush_buffer_size);
+
+    default_rrdpush_receiver_threads = (processors < 4) ? processors : 4;
+    default_rrdpush_receiver_threads = (int)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "receiver threads", default_rrdpush_receiver_threads);
+    if(default_rrdpush_receiver_threads < 1) default_rrdpush_receiver_threads = 1;
+    default_rrdpush_replication = appconfig_get_boolean(&stream_config, CONFIG_SECTION_STREAM, "enable replication", default_rrdpush_replication);
+    default_rrdpush_replication_bytes_per_second = (size_t)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "replication bytes per second", (long long)default_rrdpush_replication_bytes_per_second);
+    if(default_rrdpush_replication_bytes_per_second < 1024) default_rrdpush_replication_bytes_per_second = 1024;
+#ifdef ENABLE_COMPRESSION
+    default_rrdpush_compression = appconfig_get_boolean(&stream_config, CONFIG_SECTION_STREAM, "enable compression", default_rrdpush_compression);
+#endif
+
+    default_rrdpush_downsample_charts = simple_pattern_create(appconfig_get(&stream_config, CONFIG_SECTION_STREAM, "downsample charts matching", ""), NULL, SIMPLE_PATTERN_EXACT);
+    default_rrdpush_downsample_every = (int)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "downsample every seconds", default_rrdpush_downsample_every);
+    const char *downsample_method = appconfig_get(&stream_config, CONFIG_SECTION_STREAM, "downsample method", "average");
+    if(!strcmp(downsample_method, "max"))
+        default_rrdpush_downsample_method = RRDPUSH_DOWNSAMPLE_MAX;
+    else if(!strcmp(downsample_method, "last"))
+        default_rrdpush_downsample_method = RRDPUSH_DOWNSAMPLE_LAST;
+    else {
+        if(strcmp(downsample_method, "average"))
+            error("STREAM [send]: unknown downsample method '%s', using 'average'.", downsample_method);
+        default_rrdpush_downsample_method = RRDPUSH_DOWNSAMPLE_AVERAGE;
+    }
+
     rrdhost_free_orphan_time    = config_get_number(CONFIG_SECTION_GLOBAL, "cleanup orphan hosts after seconds", rrdhost_free_orphan_time);
 
     if(default_rrdpush_enabled && (!default_rrdpush_destination || !*default_rrdpush_destination || !default_rrdpush_api_key || !*default_rrdpush_api_key)) {
@@ -98,6 +145,9 @@ int rrdpush_init() {
     }
 #endif
 
+    // the receivers look up the sections of their api keys and machine guids on every connection
+    appconfig_freeze(&stream_config);
+
     return default_rrdpush_enabled;
 }
 
@@ -120,6 +170,100 @@ unsigned int remote_clock_resync_iterations = 60;
 #define rrdpush_buffer_lock(host) netdata_mutex_lock(&((host)->rrdpush_sender_buffer_mutex))
 #define rrdpush_buffer_unlock(host) netdata_mutex_unlock(&((host)->rrdpush_sender_buffer_mutex))
 
+// the metrics of the charts of the host are sent in binary frames
+#define host_binary(host) ((host)->rrdpush_sender_version >= STREAMING_PROTOCOL_VERSION_BINARY)
+
+// ----------------------------------------------------------------------------
+// downsampled streaming
+//
+// The charts matching "downsample charts matching" are defined upstream with
+// "downsample every seconds" as their update frequency, when it is lower than
+// theirs. Their collected values are aggregated here, and sent once per period,
+// at the first collection of the next one. Incremental dimensions always send
+// their last collected value, so that the master gets their average rate.
+
+// the update frequency a chart is streamed at, a multiple of its own
+static inline int rrdpush_chart_update_every(RRDSET *st) {
+    if(likely(!default_rrdpush_downsample_charts || default_rrdpush_downsample_every <= st->update_every))
+        return st->update_every;
+
+    if(!simple_pattern_matches(default_rrdpush_downsample_charts, st->id) &&
+       !simple_pattern_matches(default_rrdpush_downsample_charts, st->name))
+        return st->update_every;
+
+    return default_rrdpush_downsample_every - default_rrdpush_downsample_every % st->update_every;
+}
+
+#define rrdpush_chart_downsampled(st) ((st)->upstream_update_every > (st)->update_every)
+
+// adds the values just collected to the ones of the period
+// returns 1 when the chart has to send its metrics now
+static inline int rrdpush_downsample_collect(RRDSET *st) {
+    if(likely(!rrdpush_chart_downsampled(st)))
+        return 1;
+
+    RRDDIM *rd;
+    rrddim_foreach_read(rd, st) {
+        if(likely(rd->updated)) {
+            struct rrddim_volatile *state = rd->state;
+
+            if(!state->rrdpush_count || rd->collected_value > state->rrdpush_max)
+                state->rrdpush_max = rd->collected_value;
+
+            state->rrdpush_sum += (calculated_number)rd->collected_value;
+            state->rrdpush_count++;
+        }
+    }
+    st->upstream_usec += st->usec_since_last_update;
+
+    time_t now = st->last_collected_time.tv_sec, update_every = st->upstream_update_every;
+
+    if(unlikely(!st->upstream_next_time))
+        st->upstream_next_time = (now / update_every + 1) * update_every;
+
+    if(now < st->upstream_next_time)
+        return 0;
+
+    st->upstream_next_time = (now / update_every + 1) * update_every;
+    return 1;
+}
+
+// 1 when the dimension has a value to send
+static inline int rrdpush_dimension_updated(RRDSET *st, RRDDIM *rd) {
+    if(likely(!rrdpush_chart_downsampled(st)))
+        return rd->updated;
+
+    return rd->state->rrdpush_count != 0;
+}
+
+// the value of the dimension to send, the aggregate of the period for downsampled charts
+static inline collected_number rrdpush_dimension_value(RRDSET *st, RRDDIM *rd) {
+    if(likely(!rrdpush_chart_downsampled(st)))
+        return rd->collected_value;
+
+    struct rrddim_volatile *state = rd->state;
+    collected_number value = rd->collected_value;
+
+    if(rd->algorithm != RRD_ALGORITHM_INCREMENTAL && rd->algorithm != RRD_ALGORITHM_PCENT_OVER_DIFF_TOTAL) {
+        if(default_rrdpush_downsample_method == RRDPUSH_DOWNSAMPLE_AVERAGE)
+            value = (collected_number)calculated_number_llrint(state->rrdpush_sum / (calculated_number)state->rrdpush_count);
+        else if(default_rrdpush_downsample_method == RRDPUSH_DOWNSAMPLE_MAX)
+            value = state->rrdpush_max;
+    }
+
+    state->rrdpush_sum = 0.0;
+    state->rrdpush_count = 0;
+    return value;
+}
+
+// the microseconds of the point to send, 0 while the remote clock resyncs
+static inline usec_t rrdpush_chart_usec(RRDSET *st) {
+    usec_t usec = (rrdpush_chart_downsampled(st)) ? st->upstream_usec : st->usec_since_last_update;
+    st->upstream_usec = 0;
+
+    return (st->last_collected_time.tv_sec > st->upstream_resync_time) ? usec : 0;
+}
+
 static inline int should_send_chart_matching(RRDSET *st) {
     if(unlikely(!rrdset_flag_check(st, RRDSET_FLAG_ENABLED))) {
         rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_SEND);
@@ -162,12 +306,8 @@ static inline int need_to_send_chart_definition(RRDSET *st) {
     return 0;
 }
 
-// sends the current chart definition
-static inline void rrdpush_send_chart_definition_nolock(RRDSET *st) {
-    RRDHOST *host = st->rrdhost;
-
-    rrdset_flag_set(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
-
+// writes the CHART and DIMENSION lines of the current chart definition to wb
+static inline void rrdpush_chart_definition_lines_nolock(RRDSET *st, BUFFER *wb) {
     // properly set the name for the remote end to parse it
     char *name = "";
     if(likely(st->name)) {
@@ -183,9 +323,16 @@ static inline void rrdpush_send_chart_definition_nolock(RRDSET *st) {
 
     // info("CHART '%s' '%s'", st->id, name);
 
+    int update_every = rrdpush_chart_update_every(st);
+    if(unlikely(update_every != st->upstream_update_every)) {
+        st->upstream_update_every = update_every;
+        st->upstream_next_time = 0;
+        st->upstream_usec = 0;
+    }
+
     // send the chart
     buffer_sprintf(
-            host->rrdpush_sender_buffer
+            wb
             , "CHART \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" %ld %d \"%s %s %s %s\" \"%s\" \"%s\"\n"
             , st->id
             , name
@@ -195,7 +342,7 @@ static inline void rrdpush_send_chart_definition_nolock(RRDSET *st) {
             , st->context
             , rrdset_type_name(st->chart_type)
             , st->priority
-            , st->update_every
+            , update_every
             , rrdset_flag_check(st, RRDSET_FLAG_OBSOLETE)?"obsolete":""
             , rrdset_flag_check(st, RRDSET_FLAG_DETAIL)?"detail":""
             , rrdset_flag_check(st, RRDSET_FLAG_STORE_FIRST)?"store_first":""
@@ -208,7 +355,7 @@ static inline void rrdpush_send_chart_definition_nolock(RRDSET *st) {
     RRDDIM *rd;
     rrddim_foreach_read(rd, st) {
         buffer_sprintf(
-                host->rrdpush_sender_buffer
+                wb
                 , "DIMENSION \"%s\" \"%s\" \"%s\" " COLLECTED_NUMBER_FORMAT " " COLLECTED_NUMBER_FORMAT " \"%s %s %s\"\n"
                 , rd->id
                 , rd->name
@@ -219,78 +366,260 @@ static inline void rrdpush_send_chart_definition_nolock(RRDSET *st) {
                 , rrddim_flag_check(rd, RRDDIM_FLAG_HIDDEN)?"hidden":""
                 , rrddim_flag_check(rd, RRDDIM_FLAG_DONT_DETECT_RESETS_OR_OVERFLOWS)?"noreset":""
         );
-        rd->exposed = 1;
     }
+}
 
-    // send the chart local custom variables
+// the hash of the lines of a chart definition, never 0
+static inline uint32_t rrdpush_definition_hash(const char *lines) {
+    uint32_t hash = simple_hash(lines);
+    return (hash) ? hash : 1;
+}
+
+// writes the chart local custom variables to wb
+static inline void rrdpush_chart_variables_nolock(RRDSET *st, BUFFER *wb) {
     RRDSETVAR *rs;
     for(rs = st->variables; rs ;rs = rs->next) {
         if(unlikely(rs->type == RRDVAR_TYPE_CALCULATED && rs->options & RRDVAR_OPTION_CUSTOM_CHART_VAR)) {
             calculated_number *value = (calculated_number *) rs->value;
 
             buffer_sprintf(
-                    host->rrdpush_sender_buffer
+                    wb
                     , "VARIABLE CHART %s = " CALCULATED_NUMBER_FORMAT "\n"
                     , rs->variable
                     , *value
             );
         }
     }
+}
+
+// sends the current chart definition to wb - only a reference to it when the
+// remote netdata has told us it has the same definition
+static inline void rrdpush_send_chart_definition_nolock(RRDSET *st, BUFFER *wb) {
+    rrdset_flag_set(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
+
+    size_t len = buffer_strlen(wb);
+    rrdpush_chart_definition_lines_nolock(st, wb);
+
+    if(unlikely(st->upstream_definition_hash)) {
+        if(rrdpush_definition_hash(&wb->buffer[len]) == st->upstream_definition_hash) {
+            wb->len = len;
+            buffer_sprintf(wb, PLUGINSD_KEYWORD_CHART_DEFINED " \"%s\"\n", st->id);
+        }
+
+        // the definitions may change after they have been sent
+        st->upstream_definition_hash = 0;
+    }
+
+    RRDDIM *rd;
+    rrddim_foreach_read(rd, st)
+        rd->exposed = 1;
+
+    // number the chart and its dimensions, for the metrics frames
+    if(host_binary(st->rrdhost)) {
+        size_t position = 0;
+
+        if(unlikely(!st->upstream_id))
+            st->upstream_id = __atomic_add_fetch(&st->rrdhost->rrdpush_sender_chart_ids, 1, __ATOMIC_RELAXED);
+
+        rrddim_foreach_read(rd, st)
+            rd->state->rrdpush_index = ++position;
+
+        buffer_sprintf(wb, PLUGINSD_KEYWORD_BIND " %zu\n", st->upstream_id);
+    }
+
+    // send the chart local custom variables
+    rrdpush_chart_variables_nolock(st, wb);
+
+    st->upstream_resync_time = st->last_collected_time.tv_sec + (remote_clock_resync_iterations * st->upstream_update_every);
+}
+
+// sends the current chart dimensions to wb, as a binary metrics frame
+static inline void rrdpush_send_chart_metrics_binary_nolock(RRDSET *st, BUFFER *wb) {
+    char *s;
+
+    buffer_need_bytes(wb, 1 + 2 * PLUGINSD_BINARY_VARINT_MAX);
+    s = pluginsd_binary_begin(&wb->buffer[wb->len], st->upstream_id, rrdpush_chart_usec(st));
+    wb->len = s - wb->buffer;
+
+    RRDDIM *rd;
+    rrddim_foreach_read(rd, st) {
+        if(rrdpush_dimension_updated(st, rd) && rd->exposed) {
+            buffer_need_bytes(wb, 2 * PLUGINSD_BINARY_VARINT_MAX);
+            s = pluginsd_binary_set(&wb->buffer[wb->len], rd->state->rrdpush_index - 1, rrdpush_dimension_value(st, rd));
+            wb->len = s - wb->buffer;
+        }
+    }
 
-    st->upstream_resync_time = st->last_collected_time.tv_sec + (remote_clock_resync_iterations * st->update_every);
+    buffer_need_bytes(wb, 2);
+    wb->buffer[wb->len++] = 0;
+    wb->buffer[wb->len] = '\0';
 }
 
-// sends the current chart dimensions
-static inline void rrdpush_send_chart_metrics_nolock(RRDSET *st) {
-    RRDHOST *host = st->rrdhost;
-    buffer_sprintf(host->rrdpush_sender_buffer, "BEGIN \"%s\" %llu\n", st->id, (st->last_collected_time.tv_sec > st->upstream_resync_time)?st->usec_since_last_update:0);
+// sends the current chart dimensions to wb
+static inline void rrdpush_send_chart_metrics_nolock(RRDSET *st, BUFFER *wb) {
+    if(host_binary(st->rrdhost)) {
+        rrdpush_send_chart_metrics_binary_nolock(st, wb);
+        return;
+    }
+
+    buffer_fast_strcat(wb, "BEGIN \"", 7);
+    buffer_strcat(wb, st->id);
+    buffer_fast_strcat(wb, "\" ", 2);
+    buffer_print_uint64(wb, rrdpush_chart_usec(st));
+    buffer_fast_strcat(wb, "\n", 1);
 
     RRDDIM *rd;
     rrddim_foreach_read(rd, st) {
-        if(rd->updated && rd->exposed)
-            buffer_sprintf(host->rrdpush_sender_buffer
-                           , "SET \"%s\" = " COLLECTED_NUMBER_FORMAT "\n"
-                           , rd->id
-                           , rd->collected_value
-        );
+        if(rrdpush_dimension_updated(st, rd) && rd->exposed) {
+            buffer_fast_strcat(wb, "SET \"", 5);
+            buffer_strcat(wb, rd->id);
+            buffer_fast_strcat(wb, "\" = ", 4);
+            buffer_print_int64(wb, rrdpush_dimension_value(st, rd));
+            buffer_fast_strcat(wb, "\n", 1);
+        }
     }
 
-    buffer_strcat(host->rrdpush_sender_buffer, "END\n");
+    buffer_strcat(wb, "END\n");
 }
 
 static void rrdpush_sender_thread_spawn(RRDHOST *host);
+static inline void rrdpush_mirrors_append(RRDHOST *host, const char *data, size_t len);
 
-void rrdset_push_chart_definition_now(RRDSET *st) {
-    RRDHOST *host = st->rrdhost;
+// ----------------------------------------------------------------------------
+// rrdpush queues
+//
+// Every thread that sends metrics for a host has a queue of its own, so that
+// the data collection threads do not wait for each other, or for the sender,
+// to append their data. A queue is a list of chunks; its thread appends
+// records to its last chunk, the sender reads and frees the chunks from its
+// first one. Neither of them locks anything: the thread publishes the length
+// of the chunk after it has written a record and the next chunk after it has
+// finished with the current one.
+//
+// The sender takes the records of all the queues in its pending buffer. What
+// it has not sent when the connection is lost is sent again, after the
+// definitions of the charts, when it connects again.
+
+#define RRDPUSH_QUEUE_CHUNK_SIZE (16 * 1024)
+#define RRDPUSH_QUEUE_IDLE_SECONDS 600      // queues without records for that long are freed by the sender
+#define RRDPUSH_THREAD_QUEUES 4             // the queues of the hosts a thread sends metrics for, it reuses
+
+#define RRDPUSH_QUEUE_IDLE 0                // its thread is not using it
+#define RRDPUSH_QUEUE_BUSY 1                // its thread is appending a record
+#define RRDPUSH_QUEUE_DEAD 2                // the sender has freed its chunks, it is not used again
+
+struct rrdpush_queue_record {
+    uint32_t len;
+    uint32_t version;                       // the streaming protocol version the record was formatted for
+    uint32_t stream;                        // the connection of the slave it was received from, 0 for the metrics of the host
+};
 
-    if(unlikely(!host->rrdpush_send_enabled || !should_send_chart_matching(st)))
-        return;
+struct rrdpush_queue_chunk {
+    struct rrdpush_queue_chunk *next;       // set by the thread of the queue, when it does not write to this any more
+    size_t size;
+    size_t len;                             // the bytes of data[] the thread of the queue has written
+    char data[];
+};
+
+struct rrdpush_queue {
+    int state;
+
+    struct rrdpush_queue_chunk *head;       // the sender reads from here
+    size_t head_offset;
+    time_t last_data;                       // the last time the sender found records in the queue
+
+    struct rrdpush_queue_chunk *tail;       // the thread of the queue appends here
+
+    struct rrdpush_queue *next;
+};
+
+static __thread struct rrdpush_thread_queue {
+    RRDHOST *host;
+    size_t host_id;                         // the host may have been freed and another allocated at the same address
+    struct rrdpush_queue *queue;
+} rrdpush_thread_queues[RRDPUSH_THREAD_QUEUES];
+
+static size_t rrdpush_queues_host_ids = 0;
+
+static inline struct rrdpush_queue_chunk *rrdpush_queue_chunk_create(size_t size) {
+    if(size < RRDPUSH_QUEUE_CHUNK_SIZE) size = RRDPUSH_QUEUE_CHUNK_SIZE;
+
+    struct rrdpush_queue_chunk *c = mallocz(sizeof(struct rrdpush_queue_chunk) + size);
+    c->next = NULL;
+    c->size = size;
+    c->len = 0;
+    return c;
+}
+
+// returns the queue of the calling thread for host, marked busy
+static inline struct rrdpush_queue *rrdpush_queue_get(RRDHOST *host) {
+    struct rrdpush_thread_queue *tq, *slot = &rrdpush_thread_queues[0];
+    int i;
+
+    for(i = 0; i < RRDPUSH_THREAD_QUEUES ; i++) {
+        tq = &rrdpush_thread_queues[i];
+
+        if(tq->host == host && tq->host_id == host->rrdpush_sender_queues_id) {
+            int idle = RRDPUSH_QUEUE_IDLE;
+            if(likely(__atomic_compare_exchange_n(&tq->queue->state, &idle, RRDPUSH_QUEUE_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)))
+                return tq->queue;
+
+            // the sender has freed it, we need a new one
+            slot = tq;
+            break;
+        }
+
+        if(!tq->host) slot = tq;
+    }
+
+    struct rrdpush_queue *q = callocz(1, sizeof(struct rrdpush_queue));
+    q->state = RRDPUSH_QUEUE_BUSY;
+    q->head = q->tail = rrdpush_queue_chunk_create(0);
+    q->last_data = now_monotonic_sec();
 
-    rrdset_rdlock(st);
     rrdpush_buffer_lock(host);
-    rrdpush_send_chart_definition_nolock(st);
+    if(unlikely(!host->rrdpush_sender_queues_id))
+        host->rrdpush_sender_queues_id = __atomic_add_fetch(&rrdpush_queues_host_ids, 1, __ATOMIC_RELAXED);
+    q->next = host->rrdpush_sender_queues;
+    __atomic_store_n(&host->rrdpush_sender_queues, q, __ATOMIC_RELEASE);
     rrdpush_buffer_unlock(host);
-    rrdset_unlock(st);
+
+    slot->host = host;
+    slot->host_id = host->rrdpush_sender_queues_id;
+    slot->queue = q;
+    return q;
 }
 
-void rrdset_done_push(RRDSET *st) {
-    if(unlikely(!should_send_chart_matching(st)))
+// wakes up the sender, once until it runs again
+static inline void rrdpush_sender_signal(RRDHOST *host) {
+    if(__atomic_exchange_n(&host->rrdpush_sender_signaled, 1, __ATOMIC_ACQ_REL))
         return;
 
-    RRDHOST *host = st->rrdhost;
+    if(host->rrdpush_sender_pipe[PIPE_WRITE] != -1 && write(host->rrdpush_sender_pipe[PIPE_WRITE], " ", 1) == -1)
+        error("STREAM %s [send]: cannot write to internal pipe", host->hostname);
+}
 
-    rrdpush_buffer_lock(host);
+// appends the len bytes of data to the queue of the calling thread for host, formatted for the
+// streaming protocol version, and wakes up the sender - the data are discarded when the queues
+// of the host have more than the configured buffer size
+// stream is the connection of the slave the data have been received from, on pass through
+static void rrdpush_queue_append(RRDHOST *host, const char *data, size_t len, int version, uint32_t stream) {
+    if(unlikely(!len)) return;
 
     if(unlikely(host->rrdpush_send_enabled && !host->rrdpush_sender_spawn))
         rrdpush_sender_thread_spawn(host);
 
-    if(unlikely(!host->rrdpush_sender_buffer || !host->rrdpush_sender_connected)) {
+    size_t need = sizeof(struct rrdpush_queue_record) + len;
+
+    if(unlikely(__atomic_load_n(&host->rrdpush_sender_queued_bytes, __ATOMIC_RELAXED) + need > default_rrdpush_buffer_size)) {
         if(unlikely(!host->rrdpush_sender_error_shown))
-            error("STREAM %s [send]: not ready - discarding collected metrics.", host->hostname);
+            error("STREAM %s [send]: the sender is not keeping up - discarding collected metrics.", host->hostname);
 
         host->rrdpush_sender_error_shown = 1;
 
-        rrdpush_buffer_unlock(host);
+        // the master would get the metrics of the slave without some of its definitions
+        if(stream)
+            __atomic_store_n(&host->rrdpush_pass_through_reset, 1, __ATOMIC_RELEASE);
         return;
     }
     else if(unlikely(host->rrdpush_sender_error_shown)) {
@@ -298,26 +627,309 @@ void rrdset_done_push(RRDSET *st) {
         host->rrdpush_sender_error_shown = 0;
     }
 
+    struct rrdpush_queue *q = rrdpush_queue_get(host);
+    struct rrdpush_queue_chunk *c = q->tail;
+    size_t offset = c->len;
+
+    if(unlikely(offset + need > c->size)) {
+        struct rrdpush_queue_chunk *n = rrdpush_queue_chunk_create(need);
+        __atomic_store_n(&c->next, n, __ATOMIC_RELEASE);
+        q->tail = c = n;
+        offset = 0;
+    }
+
+    struct rrdpush_queue_record r = { .len = (uint32_t)len, .version = (uint32_t)version, .stream = stream };
+    memcpy(&c->data[offset], &r, sizeof(r));
+    memcpy(&c->data[offset + sizeof(r)], data, len);
+    __atomic_store_n(&c->len, offset + need, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&host->rrdpush_sender_queued_bytes, need, __ATOMIC_RELAXED);
+    __atomic_store_n(&q->state, RRDPUSH_QUEUE_IDLE, __ATOMIC_RELEASE);
+
+    rrdpush_sender_signal(host);
+}
+
+// a thread local buffer, to format the records before they are appended to a queue
+static inline BUFFER *rrdpush_thread_buffer(void) {
+    static __thread BUFFER *wb = NULL;
+
+    if(unlikely(!wb))
+        wb = buffer_create(4096);
+
+    buffer_flush(wb);
+    return wb;
+}
+
+void rrdset_push_chart_definition_now(RRDSET *st) {
+    RRDHOST *host = st->rrdhost;
+
+    if(unlikely(!host->rrdpush_send_enabled || host->rrdpush_pass_through || !should_send_chart_matching(st)))
+        return;
+
+    int version = host->rrdpush_sender_version;
+    BUFFER *wb = rrdpush_thread_buffer();
+
+    rrdset_rdlock(st);
+    rrdpush_send_chart_definition_nolock(st, wb);
+    rrdset_unlock(st);
+
+    rrdpush_queue_append(host, buffer_tostring(wb), buffer_strlen(wb), version, 0);
+}
+
+void rrdset_done_push(RRDSET *st) {
+    RRDHOST *host = st->rrdhost;
+
+    // the receiver sends the metrics as it has received them
+    if(unlikely(host->rrdpush_pass_through || !should_send_chart_matching(st)))
+        return;
+    int version = host->rrdpush_sender_version;
+    BUFFER *wb = rrdpush_thread_buffer();
+
     if(need_to_send_chart_definition(st))
-        rrdpush_send_chart_definition_nolock(st);
+        rrdpush_send_chart_definition_nolock(st, wb);
 
-    rrdpush_send_chart_metrics_nolock(st);
+    if(likely(rrdpush_downsample_collect(st)))
+        rrdpush_send_chart_metrics_nolock(st, wb);
+    else if(likely(!buffer_strlen(wb)))
+        return;
 
-    // signal the sender there are more data
-    if(host->rrdpush_sender_pipe[PIPE_WRITE] != -1 && write(host->rrdpush_sender_pipe[PIPE_WRITE], " ", 1) == -1)
-        error("STREAM %s [send]: cannot write to internal pipe", host->hostname);
+    __atomic_store_n(&st->cost.pushed_bytes, st->cost.pushed_bytes + buffer_strlen(wb), __ATOMIC_RELAXED);
+    rrdpush_queue_append(host, buffer_tostring(wb), buffer_strlen(wb), version, 0);
+}
 
-    rrdpush_buffer_unlock(host);
+// like rrdset_done_push(), but the metrics of st are appended to batch
+// rrdpush_send_batch() queues them with the rest of the batch
+void rrdset_done_push_batch(RRDSET *st, BUFFER *batch) {
+    if(unlikely(st->rrdhost->rrdpush_pass_through || !should_send_chart_matching(st)))
+        return;
+
+    size_t len = buffer_strlen(batch);
+
+    if(need_to_send_chart_definition(st))
+        rrdpush_send_chart_definition_nolock(st, batch);
+
+    if(likely(rrdpush_downsample_collect(st)))
+        rrdpush_send_chart_metrics_nolock(st, batch);
+
+    __atomic_store_n(&st->cost.pushed_bytes, st->cost.pushed_bytes + buffer_strlen(batch) - len, __ATOMIC_RELAXED);
+}
+
+// queues the metrics rrdset_done_push_batch() appended to batch for the charts of host,
+// signaling the sender once for all of them
+void rrdpush_send_batch(RRDHOST *host, BUFFER *batch) {
+    rrdpush_queue_append(host, buffer_tostring(batch), buffer_strlen(batch), host->rrdpush_sender_version, 0);
+    buffer_flush(batch);
 }
 
 // ----------------------------------------------------------------------------
 // rrdpush sender thread
 
-static inline void rrdpush_sender_add_host_variable_to_buffer_nolock(RRDHOST *host, RRDVAR *rv) {
+// 1 when there are data to be sent, begin is the position of the next byte to
+// send in rrdpush_sender_compressed when the stream is compressed, in rrdpush_sender_buffer otherwise
+static inline int rrdpush_sender_pending(RRDHOST *host, size_t begin) {
+    if(host->rrdpush_sender_compressor)
+        return begin < buffer_strlen(host->rrdpush_sender_compressed) || buffer_strlen(host->rrdpush_sender_buffer);
+
+    return begin < buffer_strlen(host->rrdpush_sender_buffer);
+}
+
+// makes room for one more record in the pending buffer of the sender
+static inline void rrdpush_sender_records_need(RRDHOST *host) {
+    if(unlikely(host->rrdpush_sender_records == host->rrdpush_sender_records_size)) {
+        host->rrdpush_sender_records_size = (host->rrdpush_sender_records_size) ? host->rrdpush_sender_records_size * 2 : 1024;
+        host->rrdpush_sender_record_ends = reallocz(host->rrdpush_sender_record_ends, host->rrdpush_sender_records_size * sizeof(size_t));
+    }
+}
+
+// appends a record to the pending buffer of the sender
+static inline void rrdpush_sender_add_record(RRDHOST *host, const char *data, size_t len) {
+    BUFFER *wb = host->rrdpush_sender_buffer;
+
+    buffer_need_bytes(wb, len + 1);
+    memcpy(&wb->buffer[wb->len], data, len);
+    wb->len += len;
+    wb->buffer[wb->len] = '\0';
+
+    rrdpush_sender_records_need(host);
+    host->rrdpush_sender_record_ends[host->rrdpush_sender_records++] = wb->len;
+}
+
+// removes from the pending buffer of the sender its first bytes,
+// with all the records that start in them
+static void rrdpush_sender_remove_records(RRDHOST *host, size_t bytes) {
+    BUFFER *wb = host->rrdpush_sender_buffer;
+    size_t i, records = host->rrdpush_sender_records, *ends = host->rrdpush_sender_record_ends;
+
+    if(!bytes || !records) return;
+
+    for(i = 0; i < records - 1 && ends[i] < bytes ; i++) ;
+    size_t cut = ends[i++];
+
+    memmove(wb->buffer, &wb->buffer[cut], wb->len - cut);
+    wb->len -= cut;
+    wb->buffer[wb->len] = '\0';
+
+    memmove(ends, &ends[i], (records - i) * sizeof(size_t));
+    host->rrdpush_sender_records = records - i;
+    for(i = 0; i < host->rrdpush_sender_records ; i++)
+        ends[i] -= cut;
+
+    if(host->rrdpush_sender_stream_complete) {
+        if(cut > host->rrdpush_sender_stream_start)
+            host->rrdpush_sender_stream_complete = 0;
+        else
+            host->rrdpush_sender_stream_start -= cut;
+    }
+}
+
+static inline void rrdpush_sender_flush_records(RRDHOST *host) {
+    buffer_flush(host->rrdpush_sender_buffer);
+    host->rrdpush_sender_records = 0;
+    host->rrdpush_sender_stream_complete = 0;
+}
+
+// reads all the records of q, returns 1 when it had any
+static int rrdpush_queue_read(RRDHOST *host, struct rrdpush_queue *q) {
+    struct rrdpush_queue_chunk *c = q->head;
+    size_t offset = q->head_offset, bytes = 0;
+
+    for(;;) {
+        size_t len = __atomic_load_n(&c->len, __ATOMIC_ACQUIRE);
+
+        while(offset < len) {
+            struct rrdpush_queue_record r;
+            memcpy(&r, &c->data[offset], sizeof(r));
+
+            int keep;
+            if(unlikely(r.stream)) {
+                if(r.stream > host->rrdpush_sender_stream) {
+                    host->rrdpush_sender_stream = r.stream;
+                    host->rrdpush_sender_stream_version = (int)r.version;
+                    host->rrdpush_sender_stream_start = buffer_strlen(host->rrdpush_sender_buffer);
+                    host->rrdpush_sender_stream_complete = 1;
+                }
+
+                // the records of a connection of the slave that has been replaced by a new one
+                // refer to definitions the master does not need any more
+                keep = (r.stream == host->rrdpush_sender_stream);
+            }
+            else {
+                // a master of an older protocol version would not understand it
+                keep = ((int)r.version <= host->rrdpush_sender_version);
+            }
+
+            if(likely(keep)) {
+                rrdpush_sender_add_record(host, &c->data[offset + sizeof(r)], r.len);
+                rrdpush_mirrors_append(host, &c->data[offset + sizeof(r)], r.len);
+            }
+
+            offset += sizeof(r) + r.len;
+            bytes += sizeof(r) + r.len;
+        }
+
+        struct rrdpush_queue_chunk *next = __atomic_load_n(&c->next, __ATOMIC_ACQUIRE);
+        if(!next) break;
+
+        // the thread may have appended more records before moving to the next chunk
+        if(__atomic_load_n(&c->len, __ATOMIC_ACQUIRE) != offset)
+            continue;
+
+        freez(c);
+        c = next;
+        offset = 0;
+    }
+
+    q->head = c;
+    q->head_offset = offset;
+
+    if(bytes)
+        __atomic_sub_fetch(&host->rrdpush_sender_queued_bytes, bytes, __ATOMIC_RELAXED);
+
+    return (bytes) ? 1 : 0;
+}
+
+// takes the records of all the queues of host in the pending buffer of the sender
+// and frees the queues of the threads that have stopped sending metrics
+static void rrdpush_sender_read_queues(RRDHOST *host, size_t max_size) {
+    struct rrdpush_queue *q, *last = NULL, *next;
+    time_t now = now_monotonic_sec();
+
+    __atomic_store_n(&host->rrdpush_sender_signaled, 0, __ATOMIC_RELEASE);
+
+    for(q = __atomic_load_n(&host->rrdpush_sender_queues, __ATOMIC_ACQUIRE); q ; q = next) {
+        next = q->next;
+
+        if(rrdpush_queue_read(host, q))
+            q->last_data = now;
+
+        else if(now - q->last_data > RRDPUSH_QUEUE_IDLE_SECONDS) {
+            int idle = RRDPUSH_QUEUE_IDLE;
+            if(__atomic_compare_exchange_n(&q->state, &idle, RRDPUSH_QUEUE_DEAD, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                // its thread may have used it since we read it
+                rrdpush_queue_read(host, q);
+                freez(q->head);
+                q->head = q->tail = NULL;
+
+                // the threads may still have it, so it is freed with the host
+                rrdpush_buffer_lock(host);
+                if(last) last->next = next;
+                else host->rrdpush_sender_queues = next;
+                q->next = host->rrdpush_sender_dead_queues;
+                host->rrdpush_sender_dead_queues = q;
+                rrdpush_buffer_unlock(host);
+                continue;
+            }
+        }
+
+        last = q;
+    }
+
+    // without a connection, we keep the latest metrics
+    if(unlikely(host->rrdpush_sender_socket == -1 && buffer_strlen(host->rrdpush_sender_buffer) > max_size)) {
+        size_t bytes = buffer_strlen(host->rrdpush_sender_buffer) - max_size;
+        error("STREAM %s [send]: not connected - discarding the oldest %zu bytes of metrics.", host->hostname, bytes);
+        rrdpush_sender_remove_records(host, bytes);
+    }
+}
+
+// frees the queues and the pipe of host, after its sender has stopped
+void rrdpush_sender_free_queues(RRDHOST *host) {
+    struct rrdpush_queue *lists[2] = { host->rrdpush_sender_queues, host->rrdpush_sender_dead_queues }, *q;
+    int i;
+
+    for(i = 0; i < 2 ; i++) {
+        while((q = lists[i])) {
+            lists[i] = q->next;
+
+            struct rrdpush_queue_chunk *c = q->head;
+            while(c) {
+                struct rrdpush_queue_chunk *next = c->next;
+                freez(c);
+                c = next;
+            }
+            freez(q);
+        }
+    }
+
+    host->rrdpush_sender_queues = host->rrdpush_sender_dead_queues = NULL;
+    host->rrdpush_sender_queued_bytes = 0;
+
+    if(host->rrdpush_sender_pipe[PIPE_READ] != -1) {
+        close(host->rrdpush_sender_pipe[PIPE_READ]);
+        host->rrdpush_sender_pipe[PIPE_READ] = -1;
+    }
+
+    if(host->rrdpush_sender_pipe[PIPE_WRITE] != -1) {
+        close(host->rrdpush_sender_pipe[PIPE_WRITE]);
+        host->rrdpush_sender_pipe[PIPE_WRITE] = -1;
+    }
+}
+
+static inline void rrdpush_sender_add_host_variable_to_buffer_nolock(BUFFER *wb, RRDVAR *rv) {
     calculated_number *value = (calculated_number *)rv->value;
 
     buffer_sprintf(
-            host->rrdpush_sender_buffer
+            wb
             , "VARIABLE HOST %s = " CALCULATED_NUMBER_FORMAT "\n"
             , rv->name
             , *value
@@ -327,19 +939,19 @@ static inline void rrdpush_sender_add_host_variable_to_buffer_nolock(RRDHOST *ho
 }
 
 void rrdpush_sender_send_this_host_variable_now(RRDHOST *host, RRDVAR *rv) {
-    if(host->rrdpush_send_enabled && host->rrdpush_sender_spawn && host->rrdpush_sender_connected) {
-        rrdpush_buffer_lock(host);
-        rrdpush_sender_add_host_variable_to_buffer_nolock(host, rv);
-        rrdpush_buffer_unlock(host);
+    if(host->rrdpush_send_enabled && host->rrdpush_sender_spawn) {
+        BUFFER *wb = rrdpush_thread_buffer();
+        rrdpush_sender_add_host_variable_to_buffer_nolock(wb, rv);
+        rrdpush_queue_append(host, buffer_tostring(wb), buffer_strlen(wb), STREAMING_PROTOCOL_VERSION_TEXT, 0);
     }
 }
 
-static int rrdpush_sender_thread_custom_host_variables_callback(void *rrdvar_ptr, void *host_ptr) {
+static int rrdpush_sender_thread_custom_host_variables_callback(void *rrdvar_ptr, void *wb_ptr) {
     RRDVAR *rv = (RRDVAR *)rrdvar_ptr;
-    RRDHOST *host = (RRDHOST *)host_ptr;
+    BUFFER *wb = (BUFFER *)wb_ptr;
 
     if(unlikely(rv->options & RRDVAR_OPTION_CUSTOM_HOST_VAR && rv->type == RRDVAR_TYPE_CALCULATED)) {
-        rrdpush_sender_add_host_variable_to_buffer_nolock(host, rv);
+        rrdpush_sender_add_host_variable_to_buffer_nolock(wb, rv);
 
         // return 1, so that the traversal will return the number of variables sent
         return 1;
@@ -349,29 +961,34 @@ static int rrdpush_sender_thread_custom_host_variables_callback(void *rrdvar_ptr
     return 0;
 }
 
-static void rrdpush_sender_thread_send_custom_host_variables(RRDHOST *host) {
-    int ret = rrdvar_callback_for_all_host_variables(host, rrdpush_sender_thread_custom_host_variables_callback, host);
+static void rrdpush_sender_thread_send_custom_host_variables(RRDHOST *host, BUFFER *wb) {
+    int ret = rrdvar_callback_for_all_host_variables(host, rrdpush_sender_thread_custom_host_variables_callback, wb);
     (void)ret;
 
     debug(D_STREAM, "RRDVAR sent %d VARIABLES", ret);
 }
 
-// resets all the chart, so that their definitions
-// will be resent to the central netdata
-static void rrdpush_sender_thread_reset_all_charts(RRDHOST *host) {
+// writes the definitions of all the charts that are sent to wb,
+// and resets the rest, so that their definitions will be sent when they are collected
+static void rrdpush_sender_thread_send_all_charts(RRDHOST *host, BUFFER *wb) {
     rrdhost_rdlock(host);
 
     RRDSET *st;
     rrdset_foreach_read(st, host) {
-        rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
-
-        st->upstream_resync_time = 0;
-
         rrdset_rdlock(st);
 
-        RRDDIM *rd;
-        rrddim_foreach_read(rd, st)
-            rd->exposed = 0;
+        if(rrdset_flag_check(st, RRDSET_FLAG_UPSTREAM_SEND) && rrdset_flag_check(st, RRDSET_FLAG_ENABLED)) {
+            st->upstream_resync_time = 0;
+            rrdpush_send_chart_definition_nolock(st, wb);
+        }
+        else {
+            rrdset_flag_clear(st, RRDSET_FLAG_UPSTREAM_EXPOSED);
+            st->upstream_resync_time = 0;
+
+            RRDDIM *rd;
+            rrddim_foreach_read(rd, st)
+                rd->exposed = 0;
+        }
 
         rrdset_unlock(st);
     }
@@ -379,33 +996,344 @@ static void rrdpush_sender_thread_reset_all_charts(RRDHOST *host) {
     rrdhost_unlock(host);
 }
 
-static inline void rrdpush_sender_thread_data_flush(RRDHOST *host) {
-    rrdpush_buffer_lock(host);
+// the bytes that were in flight when the connection was lost cannot be sent again,
+// begin is the position of the next byte that would have been sent
+static inline void rrdpush_sender_thread_discard_in_flight(RRDHOST *host, size_t begin) {
+    if(buffer_strlen(host->rrdpush_sender_compressed))
+        buffer_flush(host->rrdpush_sender_compressed);
+    else
+        rrdpush_sender_remove_records(host, begin);
+}
 
-    if(buffer_strlen(host->rrdpush_sender_buffer))
-        error("STREAM %s [send]: discarding %zu bytes of metrics already in the buffer.", host->hostname, buffer_strlen(host->rrdpush_sender_buffer));
+// on a new connection, the remote netdata gets first the custom host variables and
+// the definitions of all charts, then the records collected while we were not connected
+static inline void rrdpush_sender_thread_data_replay(RRDHOST *host, int previous_version) {
+    BUFFER *pending = host->rrdpush_sender_buffer;
 
-    buffer_flush(host->rrdpush_sender_buffer);
+    if(unlikely(host->rrdpush_sender_version < previous_version && buffer_strlen(pending))) {
+        error("STREAM %s [send]: the remote netdata has an older protocol version - discarding %zu bytes of metrics already in the buffer.", host->hostname, buffer_strlen(pending));
+        rrdpush_sender_flush_records(host);
+    }
 
-    rrdpush_sender_thread_reset_all_charts(host);
-    rrdpush_sender_thread_send_custom_host_variables(host);
+    // the metrics of the slave refer to the definitions it has sent, so they are sent
+    // only when nothing the slave has sent since it connected has been sent or discarded,
+    // and the remote netdata understands its protocol version - otherwise the slave has
+    // to connect again, to send its charts again
+    if(host->rrdpush_pass_through) {
+        if(host->rrdpush_sender_stream_complete && host->rrdpush_sender_stream_version <= host->rrdpush_sender_version) {
+            rrdpush_sender_remove_records(host, host->rrdpush_sender_stream_start);
+            if(buffer_strlen(pending))
+                info("STREAM %s [send]: sending %zu bytes of metrics received from the slave while not connected.", host->hostname, buffer_strlen(pending));
+            return;
+        }
 
-    rrdpush_buffer_unlock(host);
-}
+        if(buffer_strlen(pending))
+            info("STREAM %s [send]: discarding %zu bytes of metrics received while not connected, the slave will send its charts again.", host->hostname, buffer_strlen(pending));
 
-void rrdpush_sender_thread_stop(RRDHOST *host) {
-    rrdpush_buffer_lock(host);
-    rrdhost_wrlock(host);
+        rrdpush_sender_flush_records(host);
+        __atomic_store_n(&host->rrdpush_pass_through_reset, 1, __ATOMIC_RELEASE);
+        return;
+    }
 
-    netdata_thread_t thr = 0;
+    // the remote netdata will ask for all the values stored while we were not connected
+    if(host->rrdpush_sender_replication && buffer_strlen(pending)) {
+        info("STREAM %s [send]: discarding %zu bytes of metrics collected while not connected, they will be replicated.", host->hostname, buffer_strlen(pending));
+        rrdpush_sender_flush_records(host);
+    }
 
-    if(host->rrdpush_sender_spawn) {
-        info("STREAM %s [send]: signaling sending thread to stop...", host->hostname);
+    if(buffer_strlen(pending))
+        info("STREAM %s [send]: sending again %zu bytes of metrics collected while not connected.", host->hostname, buffer_strlen(pending));
 
-        // signal the thread that we want to join it
-        host->rrdpush_sender_join = 1;
+    BUFFER *wb = buffer_create(4096);
+    rrdpush_sender_thread_send_custom_host_variables(host, wb);
+    rrdpush_sender_thread_send_all_charts(host, wb);
 
-        // copy the thread id, so that we will be waiting for the right one
+    // the charts defined for the first time here are defined on the mirrors too
+    rrdpush_mirrors_append(host, buffer_tostring(wb), buffer_strlen(wb));
+
+    // the definitions become the first record of the pending buffer
+    size_t i, definitions = buffer_strlen(wb);
+    if(likely(definitions)) {
+        buffer_need_bytes(pending, definitions + 1);
+        memmove(&pending->buffer[definitions], pending->buffer, pending->len);
+        memcpy(pending->buffer, wb->buffer, definitions);
+        pending->len += definitions;
+        pending->buffer[pending->len] = '\0';
+
+        rrdpush_sender_records_need(host);
+        memmove(&host->rrdpush_sender_record_ends[1], host->rrdpush_sender_record_ends, host->rrdpush_sender_records * sizeof(size_t));
+        host->rrdpush_sender_record_ends[0] = 0;
+        host->rrdpush_sender_records++;
+
+        for(i = 0; i < host->rrdpush_sender_records ; i++)
+            host->rrdpush_sender_record_ends[i] += definitions;
+    }
+
+    buffer_free(wb);
+}
+
+// ----------------------------------------------------------------------------
+// rrdpush replication, at the sender
+//
+// The remote netdata asks for the values of every chart it has stored after a timestamp,
+// with a REPLICATE line. The charts are replicated one after the other, in slices of up
+// to RRDPUSH_REPLICATION_POINTS values per dimension, read from the database of the chart.
+// A slice is generated only when everything before it has been sent and the sender has
+// not sent more than "replication bytes per second" of slices in the current second,
+// so that replication does not delay the metrics being collected.
+
+#define RRDPUSH_REPLICATION_POINTS 300
+
+struct rrdpush_replication {
+    char *chart_id;
+    time_t after;                       // the last value the remote netdata has
+    struct rrdpush_replication *next;
+};
+
+static void rrdpush_replication_add(RRDHOST *host, const char *chart_id, time_t after) {
+    struct rrdpush_replication *job = callocz(1, sizeof(struct rrdpush_replication)), **last;
+
+    job->chart_id = strdupz(chart_id);
+    job->after = after;
+
+    // the charts are replicated in the order they are asked for
+    for(last = &host->rrdpush_sender_replications; *last ; last = &(*last)->next) ;
+    *last = job;
+}
+
+static void rrdpush_replication_del(RRDHOST *host) {
+    struct rrdpush_replication *job = host->rrdpush_sender_replications;
+
+    host->rrdpush_sender_replications = job->next;
+    freez(job->chart_id);
+    freez(job);
+}
+
+static void rrdpush_replication_free_all(RRDHOST *host) {
+    while(host->rrdpush_sender_replications)
+        rrdpush_replication_del(host);
+
+    if(host->rrdpush_sender_requests)
+        buffer_flush(host->rrdpush_sender_requests);
+}
+
+// processes the complete lines the remote netdata has sent, keeping the last incomplete one
+static void rrdpush_sender_process_requests(RRDHOST *host) {
+    BUFFER *wb = host->rrdpush_sender_requests;
+    char *s = wb->buffer, *end = &wb->buffer[wb->len], *eol;
+    char *words[PLUGINSD_MAX_WORDS] = { NULL };
+
+    while(s < end && (eol = memchr(s, '\n', (size_t)(end - s)))) {
+        *eol = '\0';
+
+        int w = pluginsd_split_words(s, words, PLUGINSD_MAX_WORDS);
+        if(likely(w >= 3 && !strcmp(words[0], PLUGINSD_KEYWORD_REPLICATE)))
+            rrdpush_replication_add(host, words[1], (time_t)str2ull(words[2]));
+        else if(w)
+            error("STREAM %s [send]: the remote netdata sent an unknown request '%s'.", host->hostname, words[0]);
+
+        s = eol + 1;
+    }
+
+    wb->len = (size_t)(end - s);
+    memmove(wb->buffer, s, wb->len);
+    wb->buffer[wb->len] = '\0';
+}
+
+// reads what the remote netdata has sent, returns -1 when the connection has to be closed
+static int rrdpush_sender_read_requests(RRDHOST *host) {
+    BUFFER *wb = host->rrdpush_sender_requests;
+    ssize_t bytes;
+
+    buffer_need_bytes(wb, PLUGINSD_LINE_MAX + 1);
+
+#ifdef ENABLE_HTTPS
+    if(host->ssl.conn && !host->ssl.flags) {
+        int ret = SSL_read(host->ssl.conn, &wb->buffer[wb->len], PLUGINSD_LINE_MAX);
+        if(ret <= 0) {
+            int err = SSL_get_error(host->ssl.conn, ret);
+            return (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ? 0 : -1;
+        }
+        bytes = ret;
+    }
+    else
+#endif
+    bytes = recv(host->rrdpush_sender_socket, &wb->buffer[wb->len], PLUGINSD_LINE_MAX, MSG_DONTWAIT);
+
+    if(bytes == 0)
+        return -1;
+
+    if(bytes < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+
+    wb->len += (size_t)bytes;
+    wb->buffer[wb->len] = '\0';
+
+    rrdpush_sender_process_requests(host);
+
+    // a line cannot be that long, this is not netdata
+    if(unlikely(wb->len > PLUGINSD_LINE_MAX)) {
+        error("STREAM %s [send]: the remote netdata sent %zu bytes without a newline.", host->hostname, wb->len);
+        return -1;
+    }
+
+    return 0;
+}
+
+// receives the definitions of the charts the remote netdata has, right after its reply
+// data are the len bytes of them received with the reply, returns -1 on failure
+static int rrdpush_sender_read_definitions(RRDHOST *host, const char *data, size_t len, int timeout) {
+    BUFFER *wb = host->rrdpush_sender_requests;
+    char *words[PLUGINSD_MAX_WORDS] = { NULL };
+    size_t definitions = 0;
+    RRDSET *st;
+
+    rrdhost_rdlock(host);
+    rrdset_foreach_read(st, host)
+        st->upstream_definition_hash = 0;
+    rrdhost_unlock(host);
+
+    buffer_flush(wb);
+    buffer_need_bytes(wb, len + 1);
+    memcpy(wb->buffer, data, len);
+    wb->len = len;
+    wb->buffer[wb->len] = '\0';
+
+    for(;;) {
+        char *s = wb->buffer, *end = &wb->buffer[wb->len], *eol;
+
+        while(s < end && (eol = memchr(s, '\n', (size_t)(end - s)))) {
+            *eol = '\0';
+
+            int w = pluginsd_split_words(s, words, PLUGINSD_MAX_WORDS);
+            s = eol + 1;
+
+            if(w >= 3 && !strcmp(words[0], PLUGINSD_KEYWORD_DEFINITION)) {
+                st = rrdset_find(host, words[1]);
+                if(st) st->upstream_definition_hash = (uint32_t)str2ul(words[2]);
+                definitions++;
+            }
+            else if(w >= 1 && !strcmp(words[0], PLUGINSD_KEYWORD_DEFINITIONS_END)) {
+                // anything after them are requests
+                wb->len = (size_t)(end - s);
+                memmove(wb->buffer, s, wb->len);
+                wb->buffer[wb->len] = '\0';
+                rrdpush_sender_process_requests(host);
+
+                info("STREAM %s [send]: the remote netdata has the definitions of %zu charts.", host->hostname, definitions);
+                return 0;
+            }
+            else if(w) {
+                error("STREAM %s [send]: the remote netdata sent '%s' instead of the definitions of its charts.", host->hostname, words[0]);
+                return -1;
+            }
+        }
+
+        wb->len = (size_t)(end - s);
+        memmove(wb->buffer, s, wb->len);
+        wb->buffer[wb->len] = '\0';
+
+        if(unlikely(wb->len > PLUGINSD_LINE_MAX))
+            return -1;
+
+        buffer_need_bytes(wb, PLUGINSD_LINE_MAX + 1);
+#ifdef ENABLE_HTTPS
+        ssize_t bytes = recv_timeout(&host->ssl, host->rrdpush_sender_socket, &wb->buffer[wb->len], PLUGINSD_LINE_MAX, 0, timeout);
+#else
+        ssize_t bytes = recv_timeout(host->rrdpush_sender_socket, &wb->buffer[wb->len], PLUGINSD_LINE_MAX, 0, timeout);
+#endif
+        if(bytes <= 0)
+            return -1;
+
+        wb->len += (size_t)bytes;
+        wb->buffer[wb->len] = '\0';
+    }
+}
+
+// appends the next slice of the first chart that is replicated to the pending buffer
+// returns its size
+static size_t rrdpush_replication_slice(RRDHOST *host) {
+    struct rrdpush_replication *job = host->rrdpush_sender_replications;
+    BUFFER *wb = rrdpush_thread_buffer();
+    int done = 1;
+
+    // the master has the downsampled charts at another update frequency than their database
+    RRDSET *st = rrdset_find(host, job->chart_id);
+    if(likely(st && st->rrd_memory_mode != RRD_MEMORY_MODE_NONE && !rrdpush_chart_downsampled(st))) {
+        time_t update_every = st->update_every;
+
+        // the oldest slot of the round robin database is one step after its first entry time
+        time_t first_t = rrdset_first_entry_t(st) + ((st->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE) ? 0 : update_every);
+        time_t last_t = rrdset_last_entry_t(st);
+
+        time_t start_t = job->after + update_every;
+        if(start_t < first_t) start_t = first_t;
+
+        if(likely(last_t && start_t <= last_t)) {
+            // on the time grid of the values of the chart
+            start_t = last_t - ((last_t - start_t) / update_every) * update_every;
+
+            time_t end_t = start_t + (RRDPUSH_REPLICATION_POINTS - 1) * update_every;
+            if(end_t < last_t) done = 0;
+            else end_t = last_t;
+
+            size_t points = (size_t)((end_t - start_t) / update_every) + 1;
+
+            buffer_sprintf(wb, PLUGINSD_KEYWORD_REPLAY_BEGIN " \"%s\" %ld %ld\n", st->id, (long)start_t, (long)end_t);
+
+            RRDDIM *rd;
+            rrdset_rdlock(st);
+            rrddim_foreach_read(rd, st) {
+                struct rrddim_query_handle handle;
+                size_t i;
+
+                rd->state->query_ops->init(rd, &handle, start_t, end_t);
+                for(i = 0; i < points && !rd->state->query_ops->is_finished(&handle) ; i++) {
+                    storage_number n = rd->state->query_ops->next_metric(&handle);
+
+                    if(!(i % PLUGINSD_REPLAY_MAX_VALUES)) {
+                        if(i) buffer_strcat(wb, "\n");
+                        buffer_sprintf(wb, PLUGINSD_KEYWORD_REPLAY_SET " \"%s\" %ld", rd->id, (long)(start_t + (time_t)i * update_every));
+                    }
+                    buffer_sprintf(wb, " %x", (unsigned int)n);
+                }
+                if(i) buffer_strcat(wb, "\n");
+                rd->state->query_ops->finalize(&handle);
+            }
+            rrdset_unlock(st);
+
+            job->after = end_t;
+        }
+    }
+
+    if(done) {
+        buffer_sprintf(wb, PLUGINSD_KEYWORD_REPLAY_END " \"%s\"\n", job->chart_id);
+        rrdpush_replication_del(host);
+    }
+
+    rrdpush_sender_add_record(host, wb->buffer, buffer_strlen(wb));
+    return buffer_strlen(wb);
+}
+
+void rrdpush_sender_thread_stop(RRDHOST *host) {
+    rrdpush_buffer_lock(host);
+    rrdhost_wrlock(host);
+
+    netdata_thread_t thr = 0;
+    int joining = 0;
+
+    if(host->rrdpush_sender_spawn && host->rrdpush_sender_join) {
+        // another thread is stopping it, e.g. the receiver of the host while we are freeing it
+        joining = 1;
+        thr = host->rrdpush_sender_thread;
+    }
+    else if(host->rrdpush_sender_spawn) {
+        info("STREAM %s [send]: signaling sending thread to stop...", host->hostname);
+
+        // signal the thread that we want to join it
+        host->rrdpush_sender_join = 1;
+
+        // copy the thread id, so that we will be waiting for the right one
         // even if a new one has been spawn
         thr = host->rrdpush_sender_thread;
 
@@ -416,6 +1344,20 @@ void rrdpush_sender_thread_stop(RRDHOST *host) {
     rrdhost_unlock(host);
     rrdpush_buffer_unlock(host);
 
+    // a thread cannot be joined twice, wait for the other one to join it
+    if(joining) {
+        info("STREAM %s [send]: waiting for the sending thread to be stopped...", host->hostname);
+
+        while(joining) {
+            sleep_usec(10 * USEC_PER_MS);
+
+            rrdpush_buffer_lock(host);
+            joining = (host->rrdpush_sender_spawn && host->rrdpush_sender_thread == thr);
+            rrdpush_buffer_unlock(host);
+        }
+        return;
+    }
+
     if(thr != 0) {
         info("STREAM %s [send]: waiting for the sending thread to stop...", host->hostname);
         void *result;
@@ -433,6 +1375,60 @@ static inline void rrdpush_sender_thread_close_socket(RRDHOST *host) {
     }
 }
 
+#define HTTP_HEADER_SIZE 8192
+
+// writes to http the STREAM request for the metrics of host, asking for the streaming
+// protocol version, with the options (the "&name=value" parameters) of the connection
+static int rrdpush_sender_stream_request(RRDHOST *host, char *http, size_t size, int version, const char *options) {
+    int eol = snprintfz(http, size,
+            "STREAM key=%s&hostname=%s&registry_hostname=%s&machine_guid=%s&update_every=%d&os=%s&timezone=%s&tags=%s&ver=%d%s"
+                    "&NETDATA_SYSTEM_OS_NAME=%s"
+                    "&NETDATA_SYSTEM_OS_ID=%s"
+                    "&NETDATA_SYSTEM_OS_ID_LIKE=%s"
+                    "&NETDATA_SYSTEM_OS_VERSION=%s"
+                    "&NETDATA_SYSTEM_OS_VERSION_ID=%s"
+                    "&NETDATA_SYSTEM_OS_DETECTION=%s"
+                    "&NETDATA_SYSTEM_KERNEL_NAME=%s"
+                    "&NETDATA_SYSTEM_KERNEL_VERSION=%s"
+                    "&NETDATA_SYSTEM_ARCHITECTURE=%s"
+                    "&NETDATA_SYSTEM_VIRTUALIZATION=%s"
+                    "&NETDATA_SYSTEM_VIRT_DETECTION=%s"
+                    "&NETDATA_SYSTEM_CONTAINER=%s"
+                    "&NETDATA_SYSTEM_CONTAINER_DETECTION=%s"
+                    " HTTP/1.1\r\n"
+                    "User-Agent: %s/%s\r\n"
+                    "Accept: */*\r\n\r\n"
+              , host->rrdpush_send_api_key
+              , host->hostname
+              , host->registry_hostname
+              , host->machine_guid
+              , default_rrd_update_every
+              , host->os
+              , host->timezone
+              , (host->tags) ? host->tags : ""
+              , version
+              , options
+              , (host->system_info->os_name) ? host->system_info->os_name : ""
+              , (host->system_info->os_id) ? host->system_info->os_id : ""
+              , (host->system_info->os_id_like) ? host->system_info->os_id_like : ""
+              , (host->system_info->os_version) ? host->system_info->os_version : ""
+              , (host->system_info->os_version_id) ? host->system_info->os_version_id : ""
+              , (host->system_info->os_detection) ? host->system_info->os_detection : ""
+              , (host->system_info->kernel_name) ? host->system_info->kernel_name : ""
+              , (host->system_info->kernel_version) ? host->system_info->kernel_version : ""
+              , (host->system_info->architecture) ? host->system_info->architecture : ""
+              , (host->system_info->virtualization) ? host->system_info->virtualization : ""
+              , (host->system_info->virt_detection) ? host->system_info->virt_detection : ""
+              , (host->system_info->container) ? host->system_info->container : ""
+              , (host->system_info->container_detection) ? host->system_info->container_detection : ""
+              , host->program_name
+              , host->program_version
+    );
+    http[eol] = 0x00;
+
+    return eol;
+}
+
 //called from client side
 static int rrdpush_sender_thread_connect_to_master(RRDHOST *host, int default_port, int timeout, size_t *reconnects_counter, char *connected_to, size_t connected_to_size) {
     struct timeval tv = {
@@ -491,51 +1487,22 @@ static int rrdpush_sender_thread_connect_to_master(RRDHOST *host, int default_po
     }
 #endif
 
-    #define HTTP_HEADER_SIZE 8192
-    char http[HTTP_HEADER_SIZE + 1];
-    int eol = snprintfz(http, HTTP_HEADER_SIZE,
-            "STREAM key=%s&hostname=%s&registry_hostname=%s&machine_guid=%s&update_every=%d&os=%s&timezone=%s&tags=%s"
-                    "&NETDATA_SYSTEM_OS_NAME=%s"
-                    "&NETDATA_SYSTEM_OS_ID=%s"
-                    "&NETDATA_SYSTEM_OS_ID_LIKE=%s"
-                    "&NETDATA_SYSTEM_OS_VERSION=%s"
-                    "&NETDATA_SYSTEM_OS_VERSION_ID=%s"
-                    "&NETDATA_SYSTEM_OS_DETECTION=%s"
-                    "&NETDATA_SYSTEM_KERNEL_NAME=%s"
-                    "&NETDATA_SYSTEM_KERNEL_VERSION=%s"
-                    "&NETDATA_SYSTEM_ARCHITECTURE=%s"
-                    "&NETDATA_SYSTEM_VIRTUALIZATION=%s"
-                    "&NETDATA_SYSTEM_VIRT_DETECTION=%s"
-                    "&NETDATA_SYSTEM_CONTAINER=%s"
-                    "&NETDATA_SYSTEM_CONTAINER_DETECTION=%s"
-                    " HTTP/1.1\r\n"
-                    "User-Agent: %s/%s\r\n"
-                    "Accept: */*\r\n\r\n"
-              , host->rrdpush_send_api_key
-              , host->hostname
-              , host->registry_hostname
-              , host->machine_guid
-              , default_rrd_update_every
-              , host->os
-              , host->timezone
-              , (host->tags) ? host->tags : ""
-              , (host->system_info->os_name) ? host->system_info->os_name : ""
-              , (host->system_info->os_id) ? host->system_info->os_id : ""
-              , (host->system_info->os_id_like) ? host->system_info->os_id_like : ""
-              , (host->system_info->os_version) ? host->system_info->os_version : ""
-              , (host->system_info->os_version_id) ? host->system_info->os_version_id : ""
-              , (host->system_info->os_detection) ? host->system_info->os_detection : ""
-              , (host->system_info->kernel_name) ? host->system_info->kernel_name : ""
-              , (host->system_info->kernel_version) ? host->system_info->kernel_version : ""
-              , (host->system_info->architecture) ? host->system_info->architecture : ""
-              , (host->system_info->virtualization) ? host->system_info->virtualization : ""
-              , (host->system_info->virt_detection) ? host->system_info->virt_detection : ""
-              , (host->system_info->container) ? host->system_info->container : ""
-              , (host->system_info->container_detection) ? host->system_info->container_detection : ""
-              , host->program_name
-              , host->program_version
+    char options[100 + 1];
+    snprintfz(options, 100, "%s%s%s"
+#ifdef ENABLE_COMPRESSION
+              , (default_rrdpush_compression) ? "&compression=" STREAMING_COMPRESSION_NAME : ""
+#else
+              , ""
+#endif
+              , (default_rrdpush_replication && host->rrd_memory_mode != RRD_MEMORY_MODE_NONE) ? "&replication=yes" : ""
+              // the references to the definitions the remote netdata has would reach the mirrors too
+              , (host->rrdpush_sender_mirrors) ? "" : "&definitions=yes"
     );
-    http[eol] = 0x00;
+
+    char http[HTTP_HEADER_SIZE + 1];
+    rrdpush_sender_stream_request(host, http, HTTP_HEADER_SIZE
+                                  , (default_rrdpush_binary) ? STREAMING_PROTOCOL_CURRENT_VERSION : STREAMING_PROTOCOL_VERSION_TEXT
+                                  , options);
 
 #ifdef ENABLE_HTTPS
     if (!host->ssl.flags) {
@@ -576,22 +1543,60 @@ static int rrdpush_sender_thread_connect_to_master(RRDHOST *host, int default_po
     info("STREAM %s [send to %s]: waiting response from remote netdata...", host->hostname, connected_to);
 
 #ifdef ENABLE_HTTPS
-    if(recv_timeout(&host->ssl,host->rrdpush_sender_socket, http, HTTP_HEADER_SIZE, 0, timeout) == -1) {
+    ssize_t received = recv_timeout(&host->ssl,host->rrdpush_sender_socket, http, HTTP_HEADER_SIZE, 0, timeout);
 #else
-    if(recv_timeout(host->rrdpush_sender_socket, http, HTTP_HEADER_SIZE, 0, timeout) == -1) {
+    ssize_t received = recv_timeout(host->rrdpush_sender_socket, http, HTTP_HEADER_SIZE, 0, timeout);
 #endif
+    if(received == -1) {
         error("STREAM %s [send to %s]: remote netdata does not respond.", host->hostname, connected_to);
         rrdpush_sender_thread_close_socket(host);
         return 0;
     }
-
-    if(strncmp(http, START_STREAMING_PROMPT, strlen(START_STREAMING_PROMPT)) != 0) {
+    http[received] = '\0';
+
+    if(strncmp(http, START_STREAMING_PROMPT_VERSION, strlen(START_STREAMING_PROMPT_VERSION)) == 0) {
+        host->rrdpush_sender_version = str2i(&http[strlen(START_STREAMING_PROMPT_VERSION)]);
+        if(host->rrdpush_sender_version < STREAMING_PROTOCOL_VERSION_TEXT || host->rrdpush_sender_version > STREAMING_PROTOCOL_CURRENT_VERSION) {
+            error("STREAM %s [send to %s]: remote netdata replied with unknown protocol version %d.", host->hostname, connected_to, host->rrdpush_sender_version);
+            rrdpush_sender_thread_close_socket(host);
+            return 0;
+        }
+    }
+    else if(strncmp(http, START_STREAMING_PROMPT, strlen(START_STREAMING_PROMPT)) == 0)
+        host->rrdpush_sender_version = STREAMING_PROTOCOL_VERSION_TEXT;
+    else {
         error("STREAM %s [send to %s]: server is not replying properly (is it a netdata?).", host->hostname, connected_to);
         rrdpush_sender_thread_close_socket(host);
         return 0;
     }
 
-    info("STREAM %s [send to %s]: established communication - ready to send metrics...", host->hostname, connected_to);
+#ifdef ENABLE_COMPRESSION
+    // a new stream of compressed blocks starts with every connection
+    if(default_rrdpush_compression && strstr(http, START_STREAMING_COMPRESSION)) {
+        if(!host->rrdpush_sender_compressor)
+            host->rrdpush_sender_compressor = rrdpush_compressor_create();
+        else
+            rrdpush_compressor_reset(host->rrdpush_sender_compressor);
+    }
+    else {
+        rrdpush_compressor_free(host->rrdpush_sender_compressor);
+        host->rrdpush_sender_compressor = NULL;
+    }
+#endif
+
+    // the charts the remote netdata asked for on the previous connection are asked for again
+    rrdpush_replication_free_all(host);
+    host->rrdpush_sender_replication = (default_rrdpush_replication && host->rrd_memory_mode != RRD_MEMORY_MODE_NONE && strstr(http, START_STREAMING_REPLICATION)) ? 1 : 0;
+
+    // the definitions follow the reply
+    char *definitions = (strstr(http, START_STREAMING_DEFINITIONS)) ? strchr(http, '\n') : NULL;
+    if(definitions && rrdpush_sender_read_definitions(host, definitions + 1, (size_t)(&http[received] - (definitions + 1)), timeout) == -1) {
+        error("STREAM %s [send to %s]: failed to receive the definitions of the charts of the remote netdata.", host->hostname, connected_to);
+        rrdpush_sender_thread_close_socket(host);
+        return 0;
+    }
+
+    info("STREAM %s [send to %s]: established communication with protocol version %d%s%s - ready to send metrics...", host->hostname, connected_to, host->rrdpush_sender_version, (host->rrdpush_sender_compressor)?", compressed":"", (host->rrdpush_sender_replication)?", replicated":"");
 
     if(sock_setnonblock(host->rrdpush_sender_socket) < 0)
         error("STREAM %s [send to %s]: cannot set non-blocking mode for socket.", host->hostname, connected_to);
@@ -604,6 +1609,414 @@ static int rrdpush_sender_thread_connect_to_master(RRDHOST *host, int default_po
     return 1;
 }
 
+// ----------------------------------------------------------------------------
+// rrdpush mirrors, at the sender
+//
+// Besides the netdata of "destination", the metrics can be streamed at the same time to
+// the netdata of "mirror destinations", so that they all have them when any of them fails.
+// Every mirror has a connection of its own, connected again on its own when it fails. The
+// records the sender takes from the queues are serialized once, by the data collection
+// threads, and appended once to a buffer shared by all the connected mirrors, where every
+// mirror has the position of the next byte it has to send. The buffer is trimmed to the
+// position of the slowest mirror, and a mirror that is more than "buffer size bytes" behind
+// is disconnected.
+//
+// A mirror speaks the protocol version of the other connections, without compression and
+// replication. When it connects, it is sent the definitions of the charts that have been
+// sent, followed by the records the sender takes from the queues from then on.
+
+// the mirrors are connected by the sender thread, so they may block it for up to this many seconds
+#define RRDPUSH_MIRROR_CONNECT_TIMEOUT 5
+
+struct rrdpush_mirror {
+    char *destination;
+    int socket;                         // -1 when not connected
+    int version;                        // the streaming protocol version of the connection
+    BUFFER *definitions;                // sent first, on connection
+    size_t definitions_begin;           // the next byte of the definitions to send
+    size_t begin;                       // the next byte of the shared buffer to send
+    time_t last_sent_t;
+    time_t connect_t;                   // when to connect again
+    size_t sent_bytes_on_this_connection;
+    struct rrdpush_mirror *next;
+};
+
+struct rrdpush_mirrors {
+    struct rrdpush_mirror *list;
+    size_t count;
+    size_t connected;
+    BUFFER *shared;                     // the records not sent yet by all the connected mirrors
+    int timeout;
+    unsigned int reconnect_delay;
+    struct pollfd *fds;                 // for poll(), the pipe, the connection to the destination and the mirrors
+};
+
+static void rrdpush_mirrors_create(RRDHOST *host, const char *destinations, int timeout, unsigned int reconnect_delay) {
+    struct rrdpush_mirrors *mirrors = NULL;
+    struct rrdpush_mirror **last = NULL;
+    const char *s = destinations, *e;
+
+    for(;;) {
+        while(isspace(*s)) s++;
+        for(e = s; *e && !isspace(*e) ; e++) ;
+        if(e == s) break;
+
+        if(unlikely(!mirrors)) {
+            mirrors = callocz(1, sizeof(struct rrdpush_mirrors));
+            mirrors->shared = buffer_create(1);
+            mirrors->timeout = timeout;
+            mirrors->reconnect_delay = reconnect_delay;
+            last = &mirrors->list;
+        }
+
+        struct rrdpush_mirror *m = callocz(1, sizeof(struct rrdpush_mirror));
+        m->destination = mallocz((size_t)(e - s) + 1);
+        memcpy(m->destination, s, (size_t)(e - s));
+        m->destination[e - s] = '\0';
+        m->socket = -1;
+        m->definitions = buffer_create(1);
+
+        *last = m;
+        last = &m->next;
+        mirrors->count++;
+        s = e;
+    }
+
+    if(mirrors)
+        mirrors->fds = callocz(2 + mirrors->count, sizeof(struct pollfd));
+
+    host->rrdpush_sender_mirrors = mirrors;
+}
+
+static void rrdpush_mirror_close(RRDHOST *host, struct rrdpush_mirror *m) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+
+    if(m->socket == -1) return;
+
+    close(m->socket);
+    m->socket = -1;
+    m->connect_t = now_monotonic_coarse_sec() + mirrors->reconnect_delay;
+
+    buffer_flush(m->definitions);
+    m->definitions_begin = m->begin = 0;
+
+    mirrors->connected--;
+}
+
+static void rrdpush_mirrors_free(RRDHOST *host) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    if(!mirrors) return;
+
+    while(mirrors->list) {
+        struct rrdpush_mirror *m = mirrors->list;
+
+        rrdpush_mirror_close(host, m);
+        mirrors->list = m->next;
+
+        buffer_free(m->definitions);
+        freez(m->destination);
+        freez(m);
+    }
+
+    buffer_free(mirrors->shared);
+    freez(mirrors->fds);
+    freez(mirrors);
+    host->rrdpush_sender_mirrors = NULL;
+}
+
+// appends data taken from the queues to the buffer of the connected mirrors
+static inline void rrdpush_mirrors_append(RRDHOST *host, const char *data, size_t len) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+
+    if(likely(!mirrors || !mirrors->connected || !len))
+        return;
+
+    BUFFER *wb = mirrors->shared;
+    buffer_need_bytes(wb, len + 1);
+    memcpy(&wb->buffer[wb->len], data, len);
+    wb->len += len;
+    wb->buffer[wb->len] = '\0';
+}
+
+static inline int rrdpush_mirror_pending(struct rrdpush_mirrors *mirrors, struct rrdpush_mirror *m) {
+    return m->definitions_begin < buffer_strlen(m->definitions) || m->begin < buffer_strlen(mirrors->shared);
+}
+
+// writes to wb the custom host variables and the definitions of the charts that have been sent,
+// for a mirror that has just connected - the charts the data collection threads will define
+// again are skipped, the mirror will get their definitions with their next metrics
+static void rrdpush_mirror_definitions(RRDHOST *host, BUFFER *wb) {
+    rrdpush_sender_thread_send_custom_host_variables(host, wb);
+
+    rrdhost_rdlock(host);
+
+    RRDSET *st;
+    rrdset_foreach_read(st, host) {
+        rrdset_rdlock(st);
+
+        if(rrdset_flag_check(st, RRDSET_FLAG_UPSTREAM_SEND) && !need_to_send_chart_definition(st)) {
+            rrdpush_chart_definition_lines_nolock(st, wb);
+
+            if(host_binary(host)) {
+                // the chart has been defined with the text protocol, before any connection
+                if(unlikely(!st->upstream_id)) {
+                    size_t position = 0;
+                    RRDDIM *rd;
+
+                    st->upstream_id = __atomic_add_fetch(&host->rrdpush_sender_chart_ids, 1, __ATOMIC_RELAXED);
+                    rrddim_foreach_read(rd, st)
+                        rd->state->rrdpush_index = ++position;
+                }
+
+                buffer_sprintf(wb, PLUGINSD_KEYWORD_BIND " %zu\n", st->upstream_id);
+            }
+
+            rrdpush_chart_variables_nolock(st, wb);
+        }
+
+        rrdset_unlock(st);
+    }
+
+    rrdhost_unlock(host);
+}
+
+static int rrdpush_mirror_connect(RRDHOST *host, struct rrdpush_mirror *m, int default_port) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    struct timeval tv = {
+            .tv_sec = RRDPUSH_MIRROR_CONNECT_TIMEOUT,
+            .tv_usec = 0
+    };
+
+    m->connect_t = now_monotonic_coarse_sec() + mirrors->reconnect_delay;
+
+    info("STREAM %s [mirror to %s]: connecting...", host->hostname, m->destination);
+
+    int fd = connect_to_this(m->destination, default_port, &tv);
+    if(unlikely(fd == -1)) {
+        error("STREAM %s [mirror to %s]: failed to connect", host->hostname, m->destination);
+        return 0;
+    }
+
+    // before the first connection to any of them, the mirror agrees the protocol version
+    int version = host->rrdpush_sender_version;
+    if(!version)
+        version = (default_rrdpush_binary) ? STREAMING_PROTOCOL_CURRENT_VERSION : STREAMING_PROTOCOL_VERSION_TEXT;
+
+    char http[HTTP_HEADER_SIZE + 1];
+    int len = rrdpush_sender_stream_request(host, http, HTTP_HEADER_SIZE, version, "");
+
+    ssize_t received = -1;
+#ifdef ENABLE_HTTPS
+    struct netdata_ssl plain = { .conn = NULL, .flags = NETDATA_SSL_NO_HANDSHAKE };
+    if(send_timeout(&plain, fd, http, (size_t)len, 0, RRDPUSH_MIRROR_CONNECT_TIMEOUT) != -1)
+        received = recv_timeout(&plain, fd, http, HTTP_HEADER_SIZE, 0, RRDPUSH_MIRROR_CONNECT_TIMEOUT);
+#else
+    if(send_timeout(fd, http, (size_t)len, 0, RRDPUSH_MIRROR_CONNECT_TIMEOUT) != -1)
+        received = recv_timeout(fd, http, HTTP_HEADER_SIZE, 0, RRDPUSH_MIRROR_CONNECT_TIMEOUT);
+#endif
+
+    int accepted = 0;
+    if(received > 0) {
+        http[received] = '\0';
+
+        if(strncmp(http, START_STREAMING_PROMPT_VERSION, strlen(START_STREAMING_PROMPT_VERSION)) == 0)
+            accepted = str2i(&http[strlen(START_STREAMING_PROMPT_VERSION)]);
+        else if(strncmp(http, START_STREAMING_PROMPT, strlen(START_STREAMING_PROMPT)) == 0)
+            accepted = STREAMING_PROTOCOL_VERSION_TEXT;
+    }
+
+    if(accepted < STREAMING_PROTOCOL_VERSION_TEXT || accepted > version || (host->rrdpush_sender_version && accepted != host->rrdpush_sender_version)) {
+        error("STREAM %s [mirror to %s]: the remote netdata did not accept to stream with protocol version %d.", host->hostname, m->destination, version);
+        close(fd);
+        return 0;
+    }
+
+    if(!host->rrdpush_sender_version)
+        host->rrdpush_sender_version = accepted;
+
+    if(sock_setnonblock(fd) < 0)
+        error("STREAM %s [mirror to %s]: cannot set non-blocking mode for socket.", host->hostname, m->destination);
+
+    if(sock_enlarge_out(fd) < 0)
+        error("STREAM %s [mirror to %s]: cannot enlarge the socket buffer.", host->hostname, m->destination);
+
+    m->socket = fd;
+    m->version = accepted;
+    m->last_sent_t = now_monotonic_coarse_sec();
+    m->sent_bytes_on_this_connection = 0;
+
+    // the definitions, followed by the records taken from the queues from now on
+    buffer_flush(m->definitions);
+    m->definitions_begin = 0;
+    rrdpush_mirror_definitions(host, m->definitions);
+    m->begin = buffer_strlen(mirrors->shared);
+    mirrors->connected++;
+
+    // the metrics of the slave refer to the definitions it has sent, it has to send them again
+    if(host->rrdpush_pass_through)
+        __atomic_store_n(&host->rrdpush_pass_through_reset, 1, __ATOMIC_RELEASE);
+
+    info("STREAM %s [mirror to %s]: established communication with protocol version %d - ready to send metrics...", host->hostname, m->destination, accepted);
+    return 1;
+}
+
+// connects the mirrors that are not connected, when it is time to
+static void rrdpush_mirrors_connect(RRDHOST *host, int default_port) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    struct rrdpush_mirror *m;
+
+    if(likely(!mirrors || mirrors->connected == mirrors->count))
+        return;
+
+    netdata_thread_disable_cancelability();
+
+    for(m = mirrors->list; m ; m = m->next)
+        if(m->socket == -1 && now_monotonic_coarse_sec() >= m->connect_t)
+            rrdpush_mirror_connect(host, m, default_port);
+
+    netdata_thread_enable_cancelability();
+}
+
+// the mirrors have to speak the protocol version of the connection to the destination
+static void rrdpush_mirrors_check_version(RRDHOST *host) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    struct rrdpush_mirror *m;
+
+    if(likely(!mirrors)) return;
+
+    for(m = mirrors->list; m ; m = m->next) {
+        if(m->socket != -1 && m->version != host->rrdpush_sender_version) {
+            info("STREAM %s [mirror to %s]: reconnecting, to stream with protocol version %d.", host->hostname, m->destination, host->rrdpush_sender_version);
+            rrdpush_mirror_close(host, m);
+            m->connect_t = 0;
+        }
+    }
+}
+
+// closes the mirrors that are too far behind or have not been able to send for timeout seconds,
+// and removes from the shared buffer what all the connected mirrors have sent
+static void rrdpush_mirrors_trim(RRDHOST *host, size_t max_size) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    struct rrdpush_mirror *m;
+
+    if(likely(!mirrors)) return;
+
+    BUFFER *shared = mirrors->shared;
+    size_t sent = buffer_strlen(shared);
+    time_t now = now_monotonic_coarse_sec();
+
+    for(m = mirrors->list; m ; m = m->next) {
+        if(m->socket == -1) continue;
+
+        if(unlikely(buffer_strlen(shared) - m->begin > max_size)) {
+            error("STREAM %s [mirror to %s]: too many data pending - %zu bytes - we have sent %zu bytes on this connection. Closing connection.", host->hostname, m->destination, buffer_strlen(shared) - m->begin, m->sent_bytes_on_this_connection);
+            rrdpush_mirror_close(host, m);
+            continue;
+        }
+
+        if(!rrdpush_mirror_pending(mirrors, m))
+            m->last_sent_t = now;
+
+        else if(unlikely(now - m->last_sent_t > mirrors->timeout)) {
+            error("STREAM %s [mirror to %s]: could not send metrics for %d seconds - closing connection - we have sent %zu bytes on this connection.", host->hostname, m->destination, mirrors->timeout, m->sent_bytes_on_this_connection);
+            rrdpush_mirror_close(host, m);
+            continue;
+        }
+
+        if(m->begin < sent)
+            sent = m->begin;
+    }
+
+    if(!mirrors->connected) {
+        buffer_flush(shared);
+        return;
+    }
+
+    // the bytes are moved only when they are most of the buffer
+    if(sent && (sent == buffer_strlen(shared) || sent > buffer_strlen(shared) / 2)) {
+        memmove(shared->buffer, &shared->buffer[sent], shared->len - sent);
+        shared->len -= sent;
+        shared->buffer[shared->len] = '\0';
+
+        for(m = mirrors->list; m ; m = m->next)
+            if(m->socket != -1)
+                m->begin -= sent;
+    }
+}
+
+// fills fds with the sockets of the mirrors, for poll(), returns their number
+static nfds_t rrdpush_mirrors_poll_fds(RRDHOST *host, struct pollfd *fds) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    struct rrdpush_mirror *m;
+    nfds_t i = 0;
+
+    for(m = mirrors->list; m ; m = m->next, i++) {
+        fds[i].fd = m->socket;
+        fds[i].events = (m->socket != -1 && rrdpush_mirror_pending(mirrors, m)) ? POLLOUT : 0;
+        fds[i].revents = 0;
+    }
+
+    return i;
+}
+
+static void rrdpush_mirror_send(RRDHOST *host, struct rrdpush_mirror *m) {
+    struct rrdpush_mirrors *mirrors = host->rrdpush_sender_mirrors;
+    int definitions = (m->definitions_begin < buffer_strlen(m->definitions));
+    const char *data;
+    size_t len;
+
+    if(definitions) {
+        data = &m->definitions->buffer[m->definitions_begin];
+        len = buffer_strlen(m->definitions) - m->definitions_begin;
+    }
+    else {
+        data = &mirrors->shared->buffer[m->begin];
+        len = buffer_strlen(mirrors->shared) - m->begin;
+    }
+
+    if(!len) return;
+
+    ssize_t ret = send(m->socket, data, len, MSG_DONTWAIT);
+    if(likely(ret > 0)) {
+        if(definitions) {
+            m->definitions_begin += ret;
+            if(m->definitions_begin == buffer_strlen(m->definitions)) {
+                buffer_flush(m->definitions);
+                m->definitions_begin = 0;
+            }
+        }
+        else
+            m->begin += ret;
+
+        m->sent_bytes_on_this_connection += ret;
+        m->last_sent_t = now_monotonic_coarse_sec();
+    }
+    else if(ret == -1 && (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK))
+        debug(D_STREAM, "STREAM: Send to mirror %s failed - will retry...", m->destination);
+    else {
+        error("STREAM %s [mirror to %s]: failed to send metrics - closing connection - we have sent %zu bytes on this connection.", host->hostname, m->destination, m->sent_bytes_on_this_connection);
+        rrdpush_mirror_close(host, m);
+    }
+}
+
+// sends to the mirrors poll() has found ready, and closes the ones that have failed
+static void rrdpush_mirrors_process_fds(RRDHOST *host, struct pollfd *fds) {
+    struct rrdpush_mirror *m;
+    nfds_t i = 0;
+
+    for(m = host->rrdpush_sender_mirrors->list; m ; m = m->next, i++) {
+        if(m->socket == -1 || fds[i].fd != m->socket) continue;
+
+        if(fds[i].revents & POLLOUT)
+            rrdpush_mirror_send(host, m);
+
+        if(m->socket != -1 && fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            error("STREAM %s [mirror to %s]: connection failed or closed by remote end - we have sent %zu bytes on this connection.", host->hostname, m->destination, m->sent_bytes_on_this_connection);
+            rrdpush_mirror_close(host, m);
+        }
+    }
+}
+
 static void rrdpush_sender_thread_cleanup_callback(void *ptr) {
     RRDHOST *host = (RRDHOST *)ptr;
 
@@ -614,20 +2027,28 @@ static void rrdpush_sender_thread_cleanup_callback(void *ptr) {
 
     rrdpush_sender_thread_close_socket(host);
 
-    // close the pipe
-    if(host->rrdpush_sender_pipe[PIPE_READ] != -1) {
-        close(host->rrdpush_sender_pipe[PIPE_READ]);
-        host->rrdpush_sender_pipe[PIPE_READ] = -1;
-    }
-
-    if(host->rrdpush_sender_pipe[PIPE_WRITE] != -1) {
-        close(host->rrdpush_sender_pipe[PIPE_WRITE]);
-        host->rrdpush_sender_pipe[PIPE_WRITE] = -1;
-    }
-
     buffer_free(host->rrdpush_sender_buffer);
     host->rrdpush_sender_buffer = NULL;
 
+    freez(host->rrdpush_sender_record_ends);
+    host->rrdpush_sender_record_ends = NULL;
+    host->rrdpush_sender_records = host->rrdpush_sender_records_size = 0;
+
+    buffer_free(host->rrdpush_sender_compressed);
+    host->rrdpush_sender_compressed = NULL;
+
+    rrdpush_replication_free_all(host);
+    buffer_free(host->rrdpush_sender_requests);
+    host->rrdpush_sender_requests = NULL;
+    host->rrdpush_sender_replication = 0;
+
+    rrdpush_mirrors_free(host);
+
+#ifdef ENABLE_COMPRESSION
+    rrdpush_compressor_free(host->rrdpush_sender_compressor);
+    host->rrdpush_sender_compressor = NULL;
+#endif
+
     if(!host->rrdpush_sender_join) {
         info("STREAM %s [send]: sending thread detaches itself.", host->hostname);
         netdata_thread_detach(netdata_thread_self());
@@ -659,15 +2080,22 @@ void *rrdpush_sender_thread(void *ptr) {
 
     int timeout = (int)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "timeout seconds", 60);
     int default_port = (int)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "default port", 19999);
-    size_t max_size = (size_t)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "buffer size bytes", 1024 * 1024);
+    size_t max_size = default_rrdpush_buffer_size;
     unsigned int reconnect_delay = (unsigned int)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "reconnect delay seconds", 5);
     remote_clock_resync_iterations = (unsigned int)appconfig_get_number(&stream_config, CONFIG_SECTION_STREAM, "initial clock resync iterations", remote_clock_resync_iterations);
     char connected_to[CONNECTED_TO_SIZE + 1] = "";
 
     // initialize rrdpush globals
     host->rrdpush_sender_buffer = buffer_create(1);
+    host->rrdpush_sender_records = 0;
+    host->rrdpush_sender_compressed = buffer_create(1);
+    host->rrdpush_sender_requests = buffer_create(PLUGINSD_LINE_MAX + 1);
     host->rrdpush_sender_connected = 0;
-    if(pipe(host->rrdpush_sender_pipe) == -1) fatal("STREAM %s [send]: cannot create required pipe.", host->hostname);
+    rrdpush_mirrors_create(host, appconfig_get(&stream_config, CONFIG_SECTION_STREAM, "mirror destinations", ""), timeout, reconnect_delay);
+
+    // the pipe is kept until the host is freed, the data collection threads may write to it any time
+    if(host->rrdpush_sender_pipe[PIPE_READ] == -1 && pipe(host->rrdpush_sender_pipe) == -1)
+        fatal("STREAM %s [send]: cannot create required pipe.", host->hostname);
 
     // initialize local variables
     size_t begin = 0;
@@ -675,12 +2103,16 @@ void *rrdpush_sender_thread(void *ptr) {
     size_t sent_bytes = 0;
     size_t sent_bytes_on_this_connection = 0;
     size_t send_attempts = 0;
-
+    time_t replication_t = 0;
+    size_t replication_bytes = 0;
 
     time_t last_sent_t = 0;
-    struct pollfd fds[2], *ifd, *ofd;
+    usec_t connect_ut = 0;
+    struct pollfd local_fds[2], *fds, *ifd, *ofd;
     nfds_t fdmax;
 
+    fds = (host->rrdpush_sender_mirrors) ? host->rrdpush_sender_mirrors->fds : local_fds;
+
     ifd = &fds[0];
     ofd = &fds[1];
 
@@ -696,70 +2128,120 @@ void *rrdpush_sender_thread(void *ptr) {
             if(unlikely(host->rrdpush_sender_socket == -1)) {
                 send_attempts = 0;
 
-                if(not_connected_loops == 0 && sent_bytes_on_this_connection > 0) {
-                    // fast re-connection on first disconnect
-                    sleep_usec(USEC_PER_MS * 500); // milliseconds
-                }
-                else {
-                    // slow re-connection on repeating errors
-                    sleep_usec(USEC_PER_SEC * reconnect_delay); // seconds
+                rrdpush_sender_thread_discard_in_flight(host, begin);
+                begin = 0;
+
+                if(!connect_ut) {
+                    if(not_connected_loops == 0 && sent_bytes_on_this_connection > 0) {
+                        // fast re-connection on first disconnect
+                        connect_ut = now_monotonic_usec() + USEC_PER_MS * 500; // milliseconds
+                    }
+                    else {
+                        // slow re-connection on repeating errors
+                        connect_ut = now_monotonic_usec() + USEC_PER_SEC * reconnect_delay; // seconds
+                    }
                 }
 
-                if(rrdpush_sender_thread_connect_to_master(host, default_port, timeout, &reconnects_counter, connected_to, CONNECTED_TO_SIZE)) {
-                    last_sent_t = now_monotonic_sec();
+                // the mirrors keep sending metrics, until it is time to connect again
+                usec_t now_ut = now_monotonic_usec();
+                if(now_ut >= connect_ut || !host->rrdpush_sender_mirrors) {
+                    if(now_ut < connect_ut)
+                        sleep_usec(connect_ut - now_ut);
 
-                    // reset the buffer, to properly send charts and metrics
-                    rrdpush_sender_thread_data_flush(host);
+                    connect_ut = 0;
 
-                    // send from the beginning
-                    begin = 0;
+                    // keep the latest metrics, while we are not connected
+                    rrdpush_sender_read_queues(host, max_size);
 
-                    // make sure the next reconnection will be immediate
-                    not_connected_loops = 0;
+                    int previous_version = host->rrdpush_sender_version;
+                    if(rrdpush_sender_thread_connect_to_master(host, default_port, timeout, &reconnects_counter, connected_to, CONNECTED_TO_SIZE)) {
+                        last_sent_t = now_monotonic_coarse_sec();
 
-                    // reset the bytes we have sent for this session
-                    sent_bytes_on_this_connection = 0;
+                        // the mirrors connected before may speak another protocol version
+                        rrdpush_mirrors_check_version(host);
 
-                    // let the data collection threads know we are ready
-                    host->rrdpush_sender_connected = 1;
-                }
-                else {
-                    // increase the failed connections counter
-                    not_connected_loops++;
+                        // send the charts again, followed by the metrics we have not sent yet
+                        netdata_thread_disable_cancelability();
+                        rrdpush_sender_thread_data_replay(host, previous_version);
+                        netdata_thread_enable_cancelability();
 
-                    // reset the number of bytes sent
-                    sent_bytes_on_this_connection = 0;
-                }
+                        // send from the beginning
+                        begin = 0;
 
-                // loop through
-                continue;
+                        // make sure the next reconnection will be immediate
+                        not_connected_loops = 0;
+
+                        // reset the bytes we have sent for this session
+                        sent_bytes_on_this_connection = 0;
+
+                        // let the data collection threads know we are ready
+                        host->rrdpush_sender_connected = 1;
+                    }
+                    else {
+                        // increase the failed connections counter
+                        not_connected_loops++;
+
+                        // reset the number of bytes sent
+                        sent_bytes_on_this_connection = 0;
+                    }
+
+                    // loop through
+                    continue;
+                }
             }
-            else if(unlikely(now_monotonic_sec() - last_sent_t > timeout)) {
+            else if(unlikely(now_monotonic_coarse_sec() - last_sent_t > timeout)) {
                 error("STREAM %s [send to %s]: could not send metrics for %d seconds - closing connection - we have sent %zu bytes on this connection via %zu send attempts.", host->hostname, connected_to, timeout, sent_bytes_on_this_connection, send_attempts);
                 rrdpush_sender_thread_close_socket(host);
             }
 
+            rrdpush_mirrors_connect(host, default_port);
+            rrdpush_sender_read_queues(host, max_size);
+            rrdpush_mirrors_trim(host, max_size);
+
+            // the next slice of replication, once everything before it has been sent
+            if(host->rrdpush_sender_replications && host->rrdpush_sender_socket != -1 && !rrdpush_sender_pending(host, begin)) {
+                time_t now = now_monotonic_coarse_sec();
+                if(now != replication_t) {
+                    replication_t = now;
+                    replication_bytes = 0;
+                }
+
+                if(replication_bytes < default_rrdpush_replication_bytes_per_second)
+                    replication_bytes += rrdpush_replication_slice(host);
+            }
+
             ifd->fd = host->rrdpush_sender_pipe[PIPE_READ];
             ifd->events = POLLIN;
             ifd->revents = 0;
 
             ofd->fd = host->rrdpush_sender_socket;
             ofd->revents = 0;
-            if(ofd->fd != -1 && begin < buffer_strlen(host->rrdpush_sender_buffer)) {
+            ofd->events = (host->rrdpush_sender_replication) ? POLLIN : 0;
+            if(ofd->fd != -1 && rrdpush_sender_pending(host, begin)) {
                 debug(D_STREAM, "STREAM: Requesting data output on streaming socket %d...", ofd->fd);
-                ofd->events = POLLOUT;
-                fdmax = 2;
+                ofd->events |= POLLOUT;
                 send_attempts++;
             }
-            else {
+            else
                 debug(D_STREAM, "STREAM: Not requesting data output on streaming socket %d (nothing to send now)...", ofd->fd);
-                ofd->events = 0;
-                fdmax = 1;
+            fdmax = (ofd->fd != -1 && ofd->events) ? 2 : 1;
+
+            int poll_timeout = (host->rrdpush_sender_replications) ? 100 : 1000;
+            if(host->rrdpush_sender_mirrors) {
+                if(fdmax == 1) ofd->fd = -1;
+                fdmax = 2 + rrdpush_mirrors_poll_fds(host, &fds[2]);
+
+                // not connected, we have to wake up to connect again
+                if(connect_ut) {
+                    usec_t now_ut = now_monotonic_usec();
+                    if(connect_ut <= now_ut) poll_timeout = 0;
+                    else if(connect_ut - now_ut < (usec_t)poll_timeout * USEC_PER_MS) poll_timeout = (int)((connect_ut - now_ut) / USEC_PER_MS) + 1;
+                }
             }
 
             debug(D_STREAM, "STREAM: Waiting for poll() events (current buffer length %zu bytes)...", buffer_strlen(host->rrdpush_sender_buffer));
             if(unlikely(netdata_exit)) break;
-            int retval = poll(fds, fdmax, 1000);
+            int retval = poll(fds, fdmax, poll_timeout);
             if(unlikely(netdata_exit)) break;
 
             if(unlikely(retval == -1)) {
@@ -784,25 +2266,48 @@ void *rrdpush_sender_thread(void *ptr) {
                         error("STREAM %s [send to %s]: cannot read from internal pipe.", host->hostname, connected_to);
                 }
 
-                if (ofd->revents & POLLOUT) {
-                    if (begin < buffer_strlen(host->rrdpush_sender_buffer)) {
+                if (ofd->revents & POLLIN) {
+                    if(unlikely(rrdpush_sender_read_requests(host) == -1)) {
+                        error("STREAM %s [send to %s]: the remote netdata closed the connection or sent invalid requests - closing connection - we have sent %zu bytes on this connection.", host->hostname, connected_to, sent_bytes_on_this_connection);
+                        rrdpush_sender_thread_close_socket(host);
+                    }
+                }
+
+                if (ofd->revents & POLLOUT && host->rrdpush_sender_socket != -1) {
+                    if (rrdpush_sender_pending(host, begin)) {
                         debug(D_STREAM, "STREAM: Sending data (current buffer length %zu bytes, begin = %zu)...", buffer_strlen(host->rrdpush_sender_buffer), begin);
 
-                        // BEGIN RRDPUSH LOCKED SESSION
+                        // only this thread uses the pending buffer
+                        // the socket is in non-blocking mode, so we will not block at send()
+
+                        netdata_thread_disable_cancelability();
+
+                        BUFFER *out = host->rrdpush_sender_buffer;
+#ifdef ENABLE_COMPRESSION
+                        if(host->rrdpush_sender_compressor) {
+                            out = host->rrdpush_sender_compressed;
 
-                        // during this session, data collectors
-                        // will not be able to append data to our buffer
-                        // but the socket is in non-blocking mode
-                        // so, we will not block at send()
+                            // once the previous blocks have been sent, compress all the data collected since then
+                            if(begin == buffer_strlen(out) && buffer_strlen(host->rrdpush_sender_buffer)) {
+                                buffer_flush(out);
+                                begin = 0;
 
-                        netdata_thread_disable_cancelability();
+                                if(unlikely(!rrdpush_compress(host->rrdpush_sender_compressor, host->rrdpush_sender_buffer->buffer, buffer_strlen(host->rrdpush_sender_buffer), out))) {
+                                    error("STREAM %s [send to %s]: failed to compress metrics - closing connection - we have sent %zu bytes on this connection.", host->hostname, connected_to, sent_bytes_on_this_connection);
+                                    rrdpush_sender_thread_close_socket(host);
+                                }
 
-                        debug(D_STREAM, "STREAM: Getting exclusive lock on host...");
-                        rrdpush_buffer_lock(host);
+                                rrdpush_sender_flush_records(host);
+                            }
+                        }
+#endif
 
-                        debug(D_STREAM, "STREAM: Sending data, starting from %zu, size %zu...", begin, buffer_strlen(host->rrdpush_sender_buffer));
-                        ssize_t ret = send(host->rrdpush_sender_socket, &host->rrdpush_sender_buffer->buffer[begin], buffer_strlen(host->rrdpush_sender_buffer) - begin, MSG_DONTWAIT);
-                        if (unlikely(ret == -1)) {
+                        debug(D_STREAM, "STREAM: Sending data, starting from %zu, size %zu...", begin, buffer_strlen(out));
+                        ssize_t ret = (host->rrdpush_sender_socket != -1) ? send(host->rrdpush_sender_socket, &out->buffer[begin], buffer_strlen(out) - begin, MSG_DONTWAIT) : 0;
+                        if (unlikely(host->rrdpush_sender_socket == -1)) {
+                            debug(D_STREAM, "STREAM: The socket has been closed...");
+                        }
+                        else if (unlikely(ret == -1)) {
                             if (errno != EAGAIN && errno != EINTR && errno != EWOULDBLOCK) {
                                 debug(D_STREAM, "STREAM: Send failed - closing socket...");
                                 error("STREAM %s [send to %s]: failed to send metrics - closing connection - we have sent %zu bytes on this connection.", host->hostname, connected_to, sent_bytes_on_this_connection);
@@ -823,18 +2328,21 @@ void *rrdpush_sender_thread(void *ptr) {
                             sent_bytes += ret;
                             begin += ret;
 
-                            if (begin == buffer_strlen(host->rrdpush_sender_buffer)) {
+                            if (begin == buffer_strlen(out)) {
                                 // we send it all
 
                                 debug(D_STREAM, "STREAM: Sent %zd bytes (the whole buffer)...", ret);
-                                buffer_flush(host->rrdpush_sender_buffer);
+                                if(out == host->rrdpush_sender_buffer)
+                                    rrdpush_sender_flush_records(host);
+                                else
+                                    buffer_flush(out);
                                 begin = 0;
                             }
                             else {
                                 debug(D_STREAM, "STREAM: Sent %zd bytes (part of the data buffer)...", ret);
                             }
 
-                            last_sent_t = now_monotonic_sec();
+                            last_sent_t = now_monotonic_coarse_sec();
                         }
                         else {
                             debug(D_STREAM, "STREAM: send() returned %zd - closing the socket...", ret);
@@ -843,12 +2351,7 @@ void *rrdpush_sender_thread(void *ptr) {
                             rrdpush_sender_thread_close_socket(host);
                         }
 
-                        debug(D_STREAM, "STREAM: Releasing exclusive lock on host...");
-                        rrdpush_buffer_unlock(host);
-
                         netdata_thread_enable_cancelability();
-
-                        // END RRDPUSH LOCKED SESSION
                     }
                     else {
                         debug(D_STREAM, "STREAM: we have sent the entire buffer, but we received POLLOUT...");
@@ -873,16 +2376,19 @@ void *rrdpush_sender_thread(void *ptr) {
                         rrdpush_sender_thread_close_socket(host);
                     }
                 }
+
+                if(host->rrdpush_sender_mirrors)
+                    rrdpush_mirrors_process_fds(host, &fds[2]);
             }
             else {
                 debug(D_STREAM, "STREAM: poll() timed out.");
             }
 
-            // protection from overflow
-            if(buffer_strlen(host->rrdpush_sender_buffer) > max_size) {
-                debug(D_STREAM, "STREAM: Buffer is too big (%zu bytes), bigger than the max (%zu) - flushing it...", buffer_strlen(host->rrdpush_sender_buffer), max_size);
+            // protection from overflow - without a connection, the oldest metrics are discarded
+            if(host->rrdpush_sender_socket != -1 && buffer_strlen(host->rrdpush_sender_buffer) > max_size) {
+                debug(D_STREAM, "STREAM: Buffer is too big (%zu bytes), bigger than the max (%zu) - reconnecting...", buffer_strlen(host->rrdpush_sender_buffer), max_size);
                 errno = 0;
-                error("STREAM %s [send to %s]: too many data pending - buffer is %zu bytes long, %zu unsent - we have sent %zu bytes in total, %zu on this connection. Closing connection to flush the data.", host->hostname, connected_to, host->rrdpush_sender_buffer->len, host->rrdpush_sender_buffer->len - begin, sent_bytes, sent_bytes_on_this_connection);
+                error("STREAM %s [send to %s]: too many data pending - buffer is %zu bytes long - we have sent %zu bytes in total, %zu on this connection. Closing connection.", host->hostname, connected_to, host->rrdpush_sender_buffer->len, sent_bytes, sent_bytes_on_this_connection);
                 rrdpush_sender_thread_close_socket(host);
             }
         }
@@ -928,6 +2434,561 @@ static RRDPUSH_MULTIPLE_CONNECTIONS_STRATEGY get_multiple_connections_strategy(s
     return ret;
 }
 
+// ----------------------------------------------------------------------------
+// rrdpush receivers
+//
+// The connections of the slaves are given to a few receiver threads, each one
+// polling all its connections and processing what it receives as it arrives.
+// A connection is always processed by the same thread, so the metrics of a
+// host are processed in the order they are sent.
+
+#define RRDPUSH_RECEIVER_READ_SIZE (64 * 1024)
+#define RRDPUSH_RECEIVER_MAX_READS 16   // per wake up, so that a busy slave does not delay the others
+#define RRDPUSH_RECEIVER_THROTTLED_CHECK_MS 100 // how often the slaves over their points per second are checked
+
+struct rrdpush_receiver_worker;
+
+struct rrdpush_receiver {
+    int fd;
+    RRDHOST *host;
+    struct plugind cd;
+    struct pluginsd_parser *parser;
+    BUFFER *data;                       // received, not processed yet
+    BUFFER *replies;                    // to be sent, when the charts are replicated
+    int version;                        // the streaming protocol version of the slave
+    int pass_through;                   // 1 when what is received is sent to the master of the host as it is
+    uint32_t stream;                    // the number of this connection among the pass through ones of the host
+#ifdef ENABLE_COMPRESSION
+    struct rrdpush_decompressor *decompressor;
+    BUFFER *compressed;                 // received, not decompressed yet
+#endif
+    int health_enabled;
+    char *key;
+    char *client_ip;
+    char *client_port;
+#ifdef ENABLE_HTTPS
+    struct netdata_ssl ssl;
+#endif
+    struct pluginsd_limits limits;      // the charts and dimensions it may create, the points it has collected
+    size_t shed;                        // the charts and dimensions shed it has added to the host
+    size_t max_points;                  // per second, 0 without a limit
+    long long points_allowed;           // the points it may collect before it stops reading
+    size_t points_counted;              // limits.points when points_allowed was charged
+    usec_t points_refilled_ut;          // when points_allowed was refilled
+    usec_t throttled_ut;                // when it stopped reading, 0 while it reads
+    POLLJOB *poll;                      // its poll slot, to read again
+    size_t slot;
+    struct rrdpush_receiver_worker *worker;
+    struct rrdpush_receiver *next;      // in the list of the new connections of the worker
+    struct rrdpush_receiver *throttled_next; // in the list of the throttled connections of the worker
+};
+
+struct rrdpush_receiver_worker {
+    netdata_thread_t thread;
+    netdata_mutex_t mutex;
+    struct rrdpush_receiver *incoming;  // the connections it does not poll yet
+    int pipe[2];                        // to wake it up, when it is given connections
+    size_t connections;
+    struct rrdpush_receiver *throttled; // the connections it does not read, until their points are allowed again
+};
+
+static netdata_mutex_t rrdpush_receiver_workers_mutex = NETDATA_MUTEX_INITIALIZER;
+static struct rrdpush_receiver_worker *rrdpush_receiver_workers = NULL;
+static int rrdpush_receiver_workers_count = 0;
+
+// the host is disconnected - this is what the receiver thread did, when it stopped receiving
+static void rrdpush_receiver_disconnected(struct rrdpush_receiver *r) {
+    RRDHOST *host = r->host;
+    size_t count = pluginsd_parser_free(r->parser, 0);
+
+    log_stream_connection(r->client_ip, r->client_port, r->key, host->machine_guid, host->hostname, "DISCONNECTED");
+    error("STREAM %s [receive from [%s]:%s]: disconnected (completed %zu updates).", host->hostname, r->client_ip, r->client_port, count);
+
+    rrdhost_wrlock(host);
+    host->senders_disconnected_time = now_realtime_sec();
+    host->connected_senders--;
+    if(!host->connected_senders) {
+        rrdhost_flag_set(host, RRDHOST_FLAG_ORPHAN);
+        if(r->health_enabled == CONFIG_BOOLEAN_AUTO)
+            host->health_enabled = 0;
+    }
+    rrdhost_unlock(host);
+
+    if(host->connected_senders == 0)
+        rrdpush_sender_thread_stop(host);
+
+    netdata_mutex_lock(&r->worker->mutex);
+    r->worker->connections--;
+    netdata_mutex_unlock(&r->worker->mutex);
+
+    if(r->pass_through)
+        host->rrdpush_pass_through = 0;
+
+    if(r->throttled_ut) {
+        struct rrdpush_receiver **rp;
+        for(rp = &r->worker->throttled; *rp ; rp = &(*rp)->throttled_next) {
+            if(*rp == r) {
+                *rp = r->throttled_next;
+                break;
+            }
+        }
+        __atomic_add_fetch(&host->rrdpush_receiver_throttled_ut, now_monotonic_usec() - r->throttled_ut, __ATOMIC_RELAXED);
+    }
+    __atomic_sub_fetch(&host->rrdpush_receiver_shed, r->shed, __ATOMIC_RELAXED);
+
+    // the next connection replicates the charts again
+    if(r->replies) {
+        RRDSET *st;
+        rrdhost_rdlock(host);
+        rrdset_foreach_read(st, host) {
+            rrdset_flag_clear(st, RRDSET_FLAG_REPLICATING);
+            rrdset_flag_clear(st, RRDSET_FLAG_REPLICATED);
+        }
+        rrdhost_unlock(host);
+    }
+
+    // cleanup
+#ifdef ENABLE_HTTPS
+    if(r->ssl.conn)
+        SSL_free(r->ssl.conn);
+#endif
+#ifdef ENABLE_COMPRESSION
+    rrdpush_decompressor_free(r->decompressor);
+    buffer_free(r->compressed);
+#endif
+    buffer_free(r->data);
+    buffer_free(r->replies);
+    freez(r->key);
+    freez(r->client_ip);
+    freez(r->client_port);
+    freez(r);
+}
+
+static inline ssize_t rrdpush_receiver_read(struct rrdpush_receiver *r, char *buf, size_t size) {
+#ifdef ENABLE_HTTPS
+    if(r->ssl.conn && !r->ssl.flags) {
+        int bytes = SSL_read(r->ssl.conn, buf, (int)size);
+        if(bytes <= 0) {
+            int err = SSL_get_error(r->ssl.conn, bytes);
+            if(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                errno = EAGAIN;
+                return -1;
+            }
+            if(err == SSL_ERROR_ZERO_RETURN)
+                return 0;
+
+            errno = EIO;
+            return -1;
+        }
+        return bytes;
+    }
+#endif
+    return recv(r->fd, buf, size, MSG_DONTWAIT);
+}
+
+static inline ssize_t rrdpush_receiver_write(struct rrdpush_receiver *r, const char *buf, size_t size) {
+#ifdef ENABLE_HTTPS
+    if(r->ssl.conn && !r->ssl.flags) {
+        int bytes = SSL_write(r->ssl.conn, buf, (int)size);
+        if(bytes <= 0) {
+            int err = SSL_get_error(r->ssl.conn, bytes);
+            errno = (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ? EAGAIN : EIO;
+            return -1;
+        }
+        return bytes;
+    }
+#endif
+    return send(r->fd, buf, size, MSG_DONTWAIT);
+}
+
+// sends the replies of the parser, keeping what the socket does not accept now
+// returns -1 when the connection has to be closed
+static int rrdpush_receiver_send_replies(struct rrdpush_receiver *r, short int *events) {
+    BUFFER *wb = r->replies;
+
+    if(likely(!wb || !wb->len))
+        return 0;
+
+    ssize_t bytes = rrdpush_receiver_write(r, wb->buffer, wb->len);
+    if(bytes < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            error("STREAM %s [receive from [%s]:%s]: failed to send to socket %d.", r->host->hostname, r->client_ip, r->client_port, r->fd);
+            return -1;
+        }
+        bytes = 0;
+    }
+
+    wb->len -= (size_t)bytes;
+    memmove(wb->buffer, &wb->buffer[bytes], wb->len);
+    wb->buffer[wb->len] = '\0';
+
+    if(wb->len) *events |= POLLOUT;
+    return 0;
+}
+
+// charges the points collected since the last call and refills the ones allowed since then, up to a second of them
+// returns 1 when the receiver has to stop reading, until more points are allowed
+static inline int rrdpush_receiver_over_budget(struct rrdpush_receiver *r, usec_t now) {
+    if(likely(!r->max_points))
+        return 0;
+
+    r->points_allowed -= (long long)(r->limits.points - r->points_counted);
+    r->points_counted = r->limits.points;
+
+    long long refill = (long long)((now - r->points_refilled_ut) * r->max_points / USEC_PER_SEC);
+    if(refill > 0) {
+        r->points_allowed += refill;
+        r->points_refilled_ut = now;
+
+        if(r->points_allowed > (long long)r->max_points)
+            r->points_allowed = (long long)r->max_points;
+    }
+
+    return r->points_allowed <= 0;
+}
+
+// stops reading from the slave - the socket buffers fill up and TCP slows the slave down
+static void rrdpush_receiver_throttle(struct rrdpush_receiver *r, usec_t now) {
+    if(r->throttled_ut)
+        return;
+
+    r->throttled_ut = now;
+    r->throttled_next = r->worker->throttled;
+    r->worker->throttled = r;
+}
+
+// reads again from the throttled slaves that are allowed points again
+static void rrdpush_receiver_resume_throttled(struct rrdpush_receiver_worker *wk, usec_t now) {
+    struct rrdpush_receiver **rp = &wk->throttled;
+
+    while(*rp) {
+        struct rrdpush_receiver *r = *rp;
+
+        if(rrdpush_receiver_over_budget(r, now)) {
+            rp = &r->throttled_next;
+            continue;
+        }
+
+        *rp = r->throttled_next;
+        r->throttled_next = NULL;
+
+        __atomic_add_fetch(&r->host->rrdpush_receiver_throttled_ut, now - r->throttled_ut, __ATOMIC_RELAXED);
+        r->throttled_ut = 0;
+
+        poll_set_events(pollinfo_from_slot(r->poll, r->slot), (short int)(r->poll->fds[r->slot].events | POLLIN));
+    }
+}
+
+// processes what has been received, keeping the incomplete data for the next time
+// returns -1 when the connection has to be closed
+static int rrdpush_receiver_process(struct rrdpush_receiver *r, BUFFER *received) {
+    BUFFER *data = r->data;
+
+#ifdef ENABLE_COMPRESSION
+    if(r->decompressor) {
+        ssize_t used = rrdpush_decompress(r->decompressor, received->buffer, received->len, data);
+        if(unlikely(used < 0))
+            return -1;
+
+        if(used) {
+            received->len -= (size_t)used;
+            memmove(received->buffer, &received->buffer[used], received->len);
+            received->buffer[received->len] = '\0';
+        }
+    }
+#else
+    (void)received;
+#endif
+
+    // the parser splits the lines in place, the master gets them as they have been received
+    BUFFER *copy = NULL;
+    if(r->pass_through) {
+        copy = rrdpush_thread_buffer();
+        buffer_need_bytes(copy, data->len + 1);
+        memcpy(copy->buffer, data->buffer, data->len);
+    }
+
+    ssize_t used = pluginsd_parse_buffer(r->parser, data->buffer, data->len);
+    if(unlikely(used < 0))
+        return -1;
+
+    if(copy && used)
+        rrdpush_queue_append(r->host, copy->buffer, (size_t)used, r->version, r->stream);
+
+    if(used) {
+        data->len -= (size_t)used;
+        memmove(data->buffer, &data->buffer[used], data->len);
+        data->buffer[data->len] = '\0';
+    }
+
+    size_t shed = r->limits.shed_charts + r->limits.shed_dimensions;
+    if(unlikely(shed != r->shed)) {
+        __atomic_add_fetch(&r->host->rrdpush_receiver_shed, shed - r->shed, __ATOMIC_RELAXED);
+        r->shed = shed;
+    }
+
+    return 0;
+}
+
+static void *rrdpush_receiver_add_callback(POLLINFO *pi, short int *events, void *data) {
+    struct rrdpush_receiver *r = data;
+    r->poll = pi->p;
+    r->slot = pi->slot;
+
+    *events = POLLIN;
+    return data;
+}
+
+static void rrdpush_receiver_del_callback(POLLINFO *pi) {
+    struct rrdpush_receiver *r = pi->data;
+    pi->data = NULL;
+
+    if(r)
+        rrdpush_receiver_disconnected(r);
+}
+
+static int rrdpush_receiver_rcv_callback(POLLINFO *pi, short int *events) {
+    struct rrdpush_receiver *r = pi->data;
+
+    if(unlikely(r->pass_through && __atomic_exchange_n(&r->host->rrdpush_pass_through_reset, 0, __ATOMIC_ACQ_REL))) {
+        info("STREAM %s [receive from [%s]:%s]: the master of the host has connected, the slave has to send its charts again.", r->host->hostname, r->client_ip, r->client_port);
+        return -1;
+    }
+
+#ifdef ENABLE_COMPRESSION
+    BUFFER *received = (r->decompressor) ? r->compressed : r->data;
+#else
+    BUFFER *received = r->data;
+#endif
+
+    // SSL may have buffered data the socket will not wake us up for, so it is read to the end
+    // and the slave is throttled only before reading, when what is not read is in the socket
+    int reads, max_reads = RRDPUSH_RECEIVER_MAX_READS, throttle_reads = 1;
+#ifdef ENABLE_HTTPS
+    if(r->ssl.conn && !r->ssl.flags) {
+        max_reads = INT_MAX;
+        throttle_reads = 0;
+    }
+#endif
+
+    for(reads = 0; reads < max_reads ; reads++) {
+        if(unlikely(r->max_points && (!reads || throttle_reads))) {
+            usec_t now = now_monotonic_usec();
+            if(rrdpush_receiver_over_budget(r, now)) {
+                rrdpush_receiver_throttle(r, now);
+                break;
+            }
+        }
+
+        buffer_need_bytes(received, RRDPUSH_RECEIVER_READ_SIZE + 1);
+
+        ssize_t bytes = rrdpush_receiver_read(r, &received->buffer[received->len], RRDPUSH_RECEIVER_READ_SIZE);
+        if(bytes == 0)
+            return -1;
+
+        if(bytes < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+
+            error("STREAM %s [receive from [%s]:%s]: failed to read from socket %d.", r->host->hostname, r->client_ip, r->client_port, r->fd);
+            return -1;
+        }
+
+        received->len += (size_t)bytes;
+        received->buffer[received->len] = '\0';
+
+        if(unlikely(rrdpush_receiver_process(r, received) == -1))
+            return -1;
+    }
+
+    if(likely(!r->throttled_ut))
+        *events |= POLLIN;
+
+    return rrdpush_receiver_send_replies(r, events);
+}
+
+static int rrdpush_receiver_snd_callback(POLLINFO *pi, short int *events) {
+    struct rrdpush_receiver *r = pi->data;
+    if(likely(!r->throttled_ut))
+        *events |= POLLIN;
+
+    return rrdpush_receiver_send_replies(r, events);
+}
+
+static void *rrdpush_receiver_worker_add_callback(POLLINFO *pi, short int *events, void *data) {
+    (void)pi;
+    *events = POLLIN;
+    return data;
+}
+
+static void rrdpush_receiver_worker_del_callback(POLLINFO *pi) {
+    pi->data = NULL;
+}
+
+// the pipe of the worker - it has been given connections
+static int rrdpush_receiver_worker_rcv_callback(POLLINFO *pi, short int *events) {
+    struct rrdpush_receiver_worker *wk = pi->data;
+    POLLJOB *p = pi->p;
+    char buffer[100 + 1];
+
+    // set before adding the connections, pi may not be valid after it
+    *events |= POLLIN;
+
+    if(read(wk->pipe[PIPE_READ], buffer, 100) == -1 && errno != EAGAIN && errno != EINTR)
+        error("STREAM: cannot read from the pipe of a receiver thread.");
+
+    netdata_mutex_lock(&wk->mutex);
+    struct rrdpush_receiver *r = wk->incoming;
+    wk->incoming = NULL;
+    netdata_mutex_unlock(&wk->mutex);
+
+    while(r) {
+        struct rrdpush_receiver *next = r->next;
+        r->next = NULL;
+
+        if(!poll_add_fd(p, r->fd, SOCK_STREAM, WEB_CLIENT_ACL_NONE, POLLINFO_FLAG_CLIENT_SOCKET, r->client_ip, r->client_port
+                        , rrdpush_receiver_add_callback
+                        , rrdpush_receiver_del_callback
+                        , rrdpush_receiver_rcv_callback
+                        , rrdpush_receiver_snd_callback
+                        , r)) {
+            error("STREAM %s [receive from [%s]:%s]: cannot poll socket %d.", r->host->hostname, r->client_ip, r->client_port, r->fd);
+            close(r->fd);
+            rrdpush_receiver_disconnected(r);
+        }
+
+        r = next;
+    }
+
+    return 0;
+}
+
+static void *rrdpush_receiver_worker_thread(void *ptr) {
+    struct rrdpush_receiver_worker *wk = ptr;
+    POLLJOB p;
+
+    info("STREAM: receiver thread created (task id %d)", gettid());
+
+    poll_job_init(&p);
+
+    if(!poll_add_fd(&p, wk->pipe[PIPE_READ], SOCK_STREAM, WEB_CLIENT_ACL_NONE, POLLINFO_FLAG_CLIENT_SOCKET | POLLINFO_FLAG_DONT_CLOSE, "pipe", ""
+                    , rrdpush_receiver_worker_add_callback
+                    , rrdpush_receiver_worker_del_callback
+                    , rrdpush_receiver_worker_rcv_callback
+                    , poll_default_snd_callback
+                    , wk))
+        fatal("STREAM: cannot poll the pipe of a receiver thread.");
+
+    while(!netdata_exit) {
+        if(unlikely(poll_events_wait(&p, (wk->throttled)?RRDPUSH_RECEIVER_THROTTLED_CHECK_MS:1000) == -1)) {
+            error("STREAM: receiver thread failed to poll its connections.");
+            sleep_usec(USEC_PER_SEC);
+        }
+
+        if(unlikely(wk->throttled))
+            rrdpush_receiver_resume_throttled(wk, now_monotonic_usec());
+    }
+
+    // netdata is exiting, the hosts of the connections may be freed already
+    info("STREAM: receiver thread exits (task id %d)", gettid());
+    return NULL;
+}
+
+static void rrdpush_receiver_add(struct rrdpush_receiver *r) {
+    struct rrdpush_receiver_worker *wk;
+    int i;
+
+    netdata_mutex_lock(&rrdpush_receiver_workers_mutex);
+
+    if(unlikely(!rrdpush_receiver_workers)) {
+        rrdpush_receiver_workers = callocz((size_t)default_rrdpush_receiver_threads, sizeof(struct rrdpush_receiver_worker));
+
+        for(i = 0; i < default_rrdpush_receiver_threads ; i++) {
+            char tag[NETDATA_THREAD_TAG_MAX + 1];
+            wk = &rrdpush_receiver_workers[i];
+
+            netdata_mutex_init(&wk->mutex);
+            if(pipe(wk->pipe) == -1)
+                fatal("STREAM: cannot create the pipe of a receiver thread.");
+            fcntl(wk->pipe[PIPE_READ], F_SETFL, O_NONBLOCK);
+
+            snprintfz(tag, NETDATA_THREAD_TAG_MAX, "STREAM_RECEIVER[%d]", i);
+            if(netdata_thread_create(&wk->thread, tag, NETDATA_THREAD_OPTION_DEFAULT, rrdpush_receiver_worker_thread, wk)) {
+                error("STREAM: failed to create receiver thread %d.", i);
+                close(wk->pipe[PIPE_READ]);
+                close(wk->pipe[PIPE_WRITE]);
+                break;
+            }
+        }
+        rrdpush_receiver_workers_count = i;
+
+        if(!rrdpush_receiver_workers_count)
+            fatal("STREAM: cannot create any receiver thread.");
+    }
+
+    // the worker with the fewest connections gets it
+    wk = &rrdpush_receiver_workers[0];
+    for(i = 1; i < rrdpush_receiver_workers_count ; i++)
+        if(rrdpush_receiver_workers[i].connections < wk->connections)
+            wk = &rrdpush_receiver_workers[i];
+
+    netdata_mutex_lock(&wk->mutex);
+    wk->connections++;
+    r->worker = wk;
+    r->next = wk->incoming;
+    wk->incoming = r;
+    netdata_mutex_unlock(&wk->mutex);
+
+    netdata_mutex_unlock(&rrdpush_receiver_workers_mutex);
+
+    if(write(wk->pipe[PIPE_WRITE], " ", 1) == -1)
+        error("STREAM: cannot write to the pipe of a receiver thread.");
+}
+
+// sends the hashes of the definitions of all the charts of host, so that the sender
+// sends only the definitions that have changed
+#ifdef ENABLE_HTTPS
+static int rrdpush_receiver_send_definitions(RRDHOST *host, int fd, struct netdata_ssl *ssl) {
+#else
+static int rrdpush_receiver_send_definitions(RRDHOST *host, int fd) {
+#endif
+    BUFFER *wb = buffer_create(4096), *lines = buffer_create(4096);
+    size_t charts = 0, sent = 0;
+    RRDSET *st;
+
+    rrdhost_rdlock(host);
+    rrdset_foreach_read(st, host) {
+        rrdset_rdlock(st);
+        buffer_flush(lines);
+        rrdpush_chart_definition_lines_nolock(st, lines);
+        buffer_sprintf(wb, PLUGINSD_KEYWORD_DEFINITION " \"%s\" %u\n", st->id, rrdpush_definition_hash(buffer_tostring(lines)));
+        rrdset_unlock(st);
+        charts++;
+    }
+    rrdhost_unlock(host);
+
+    buffer_strcat(wb, PLUGINSD_KEYWORD_DEFINITIONS_END "\n");
+
+    while(sent < buffer_strlen(wb)) {
+#ifdef ENABLE_HTTPS
+        ssize_t bytes = send_timeout(ssl, fd, &wb->buffer[sent], buffer_strlen(wb) - sent, 0, 60);
+#else
+        ssize_t bytes = send_timeout(fd, &wb->buffer[sent], buffer_strlen(wb) - sent, 0, 60);
+#endif
+        if(bytes <= 0 && !(bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)))
+            break;
+
+        if(bytes > 0) sent += (size_t)bytes;
+    }
+
+    int ret = (sent == buffer_strlen(wb)) ? 0 : -1;
+    if(!ret) debug(D_STREAM, "STREAM %s: sent the definitions of %zu charts.", host->hostname, charts);
+
+    buffer_free(lines);
+    buffer_free(wb);
+    return ret;
+}
+
 static int rrdpush_receive(int fd
                            , const char *key
                            , const char *hostname
@@ -940,6 +3001,10 @@ static int rrdpush_receive(int fd
                            , const char *program_version
                            , struct rrdhost_system_info *system_info
                            , int update_every
+                           , int stream_version
+                           , int stream_compression
+                           , int stream_replication
+                           , int stream_definitions
                            , char *client_ip
                            , char *client_port
 #ifdef ENABLE_HTTPS
@@ -954,8 +3019,10 @@ static int rrdpush_receive(int fd
     char *rrdpush_destination = default_rrdpush_destination;
     char *rrdpush_api_key = default_rrdpush_api_key;
     char *rrdpush_send_charts_matching = default_rrdpush_send_charts_matching;
+    int rrdpush_pass_through = CONFIG_BOOLEAN_NO;
     time_t alarms_delay = 60;
     RRDPUSH_MULTIPLE_CONNECTIONS_STRATEGY rrdpush_multiple_connections_strategy = RRDPUSH_MULTIPLE_CONNECTIONS_ALLOW;
+    long long max_charts = 0, max_dimensions = 0, max_points = 0;
 
     update_every = (int)appconfig_get_number(&stream_config, machine_guid, "update every", update_every);
     if(update_every < 0) update_every = 1;
@@ -988,6 +3055,21 @@ static int rrdpush_receive(int fd
     rrdpush_send_charts_matching = appconfig_get(&stream_config, key, "default proxy send charts matching", rrdpush_send_charts_matching);
     rrdpush_send_charts_matching = appconfig_get(&stream_config, machine_guid, "proxy send charts matching", rrdpush_send_charts_matching);
 
+    rrdpush_pass_through = appconfig_get_boolean(&stream_config, key, "default proxy pass through", rrdpush_pass_through);
+    rrdpush_pass_through = appconfig_get_boolean(&stream_config, machine_guid, "proxy pass through", rrdpush_pass_through);
+
+    max_charts = appconfig_get_number(&stream_config, key, "default max charts", max_charts);
+    max_charts = appconfig_get_number(&stream_config, machine_guid, "max charts", max_charts);
+    if(max_charts < 0) max_charts = 0;
+
+    max_dimensions = appconfig_get_number(&stream_config, key, "default max dimensions", max_dimensions);
+    max_dimensions = appconfig_get_number(&stream_config, machine_guid, "max dimensions", max_dimensions);
+    if(max_dimensions < 0) max_dimensions = 0;
+
+    max_points = appconfig_get_number(&stream_config, key, "default max points per second", max_points);
+    max_points = appconfig_get_number(&stream_config, machine_guid, "max points per second", max_points);
+    if(max_points < 0) max_points = 0;
+
     tags = appconfig_set_default(&stream_config, machine_guid, "host tags", (tags)?tags:"");
     if(tags && !*tags) tags = NULL;
 
@@ -1057,11 +3139,49 @@ static int rrdpush_receive(int fd
     snprintfz(cd.fullfilename, FILENAME_MAX,     "%s:%s", client_ip, client_port);
     snprintfz(cd.cmd,          PLUGINSD_CMD_MAX, "%s:%s", client_ip, client_port);
 
-    info("STREAM %s [receive from [%s]:%s]: initializing communication...", host->hostname, client_ip, client_port);
+    // the metrics of the slave are sent to the master of the host as they are received,
+    // so the slave cannot use what the master may not understand, or what is only for us
+    if(rrdpush_pass_through && host->rrdpush_send_enabled) {
+        if(host->rrdpush_sender_connected && stream_version > host->rrdpush_sender_version)
+            stream_version = host->rrdpush_sender_version;
+
+        stream_replication = 0;
+        stream_definitions = 0;
+    }
+    else
+        rrdpush_pass_through = 0;
+
+    // senders that do not ask for a version expect the prompt without it
+    char prompt[sizeof(START_STREAMING_PROMPT_VERSION) + 100];
+    if(stream_version > STREAMING_PROTOCOL_CURRENT_VERSION)
+        stream_version = STREAMING_PROTOCOL_CURRENT_VERSION;
+    if(stream_version > STREAMING_PROTOCOL_VERSION_TEXT)
+        snprintfz(prompt, sizeof(prompt) - 1, START_STREAMING_PROMPT_VERSION "%d", stream_version);
+    else {
+        stream_version = STREAMING_PROTOCOL_VERSION_TEXT;
+        strcpy(prompt, START_STREAMING_PROMPT);
+    }
+#ifdef ENABLE_COMPRESSION
+    if(stream_compression)
+        strcat(prompt, START_STREAMING_COMPRESSION);
+#else
+    stream_compression = 0;
+#endif
+    // without a database there is nothing to replicate to
+    if(stream_replication && host->rrd_memory_mode != RRD_MEMORY_MODE_NONE)
+        strcat(prompt, START_STREAMING_REPLICATION);
+    else
+        stream_replication = 0;
+
+    // the definitions of the charts follow the reply, after a newline
+    if(stream_definitions)
+        strcat(prompt, START_STREAMING_DEFINITIONS "\n");
+
+    info("STREAM %s [receive from [%s]:%s]: initializing communication with protocol version %d%s%s...", host->hostname, client_ip, client_port, stream_version, (stream_compression)?", compressed":"", (stream_replication)?", replicated":"");
 #ifdef ENABLE_HTTPS
-    if(send_timeout(ssl,fd, START_STREAMING_PROMPT, strlen(START_STREAMING_PROMPT), 0, 60) != strlen(START_STREAMING_PROMPT)) {
+    if(send_timeout(ssl,fd, prompt, strlen(prompt), 0, 60) != (ssize_t)strlen(prompt)) {
 #else
-    if(send_timeout(fd, START_STREAMING_PROMPT, strlen(START_STREAMING_PROMPT), 0, 60) != strlen(START_STREAMING_PROMPT)) {
+    if(send_timeout(fd, prompt, strlen(prompt), 0, 60) != (ssize_t)strlen(prompt)) {
 #endif
         log_stream_connection(client_ip, client_port, key, host->machine_guid, host->hostname, "FAILED - CANNOT REPLY");
         error("STREAM %s [receive from [%s]:%s]: cannot send ready command.", host->hostname, client_ip, client_port);
@@ -1069,15 +3189,13 @@ static int rrdpush_receive(int fd
         return 0;
     }
 
-    // remove the non-blocking flag from the socket
-    if(sock_delnonblock(fd) < 0)
-        error("STREAM %s [receive from [%s]:%s]: cannot remove the non-blocking flag from socket %d", host->hostname, client_ip, client_port, fd);
-
-    // convert the socket to a FILE *
-    FILE *fp = fdopen(fd, "r");
-    if(!fp) {
-        log_stream_connection(client_ip, client_port, key, host->machine_guid, host->hostname, "FAILED - SOCKET ERROR");
-        error("STREAM %s [receive from [%s]:%s]: failed to get a FILE for FD %d.", host->hostname, client_ip, client_port, fd);
+#ifdef ENABLE_HTTPS
+    if(stream_definitions && rrdpush_receiver_send_definitions(host, fd, ssl) == -1) {
+#else
+    if(stream_definitions && rrdpush_receiver_send_definitions(host, fd) == -1) {
+#endif
+        log_stream_connection(client_ip, client_port, key, host->machine_guid, host->hostname, "FAILED - CANNOT SEND DEFINITIONS");
+        error("STREAM %s [receive from [%s]:%s]: cannot send the definitions of the charts.", host->hostname, client_ip, client_port);
         close(fd);
         return 0;
     }
@@ -1093,7 +3211,7 @@ static int rrdpush_receive(int fd
                 rrdhost_unlock(host);
                 log_stream_connection(client_ip, client_port, key, host->machine_guid, host->hostname, "REJECTED - ALREADY CONNECTED");
                 info("STREAM %s [receive from [%s]:%s]: multiple streaming connections for the same host detected. Rejecting new connection.", host->hostname, client_ip, client_port);
-                fclose(fp);
+                close(fd);
                 return 0;
         }
     }
@@ -1112,32 +3230,52 @@ static int rrdpush_receive(int fd
     }
     rrdhost_unlock(host);
 
-    // call the plugins.d processor to receive the metrics
+    // give the connection to the receiver threads, the socket remains non-blocking
     info("STREAM %s [receive from [%s]:%s]: receiving metrics...", host->hostname, client_ip, client_port);
     log_stream_connection(client_ip, client_port, key, host->machine_guid, host->hostname, "CONNECTED");
 
-    size_t count = pluginsd_process(host, &cd, fp, 1);
-
-    log_stream_connection(client_ip, client_port, key, host->machine_guid, host->hostname, "DISCONNECTED");
-    error("STREAM %s [receive from [%s]:%s]: disconnected (completed %zu updates).", host->hostname, client_ip, client_port, count);
-
-    rrdhost_wrlock(host);
-    host->senders_disconnected_time = now_realtime_sec();
-    host->connected_senders--;
-    if(!host->connected_senders) {
-        rrdhost_flag_set(host, RRDHOST_FLAG_ORPHAN);
-        if(health_enabled == CONFIG_BOOLEAN_AUTO)
-            host->health_enabled = 0;
+    struct rrdpush_receiver *r = callocz(1, sizeof(struct rrdpush_receiver));
+    r->fd = fd;
+    r->host = host;
+    r->cd = cd;
+    r->replies = (stream_replication) ? buffer_create(PLUGINSD_LINE_MAX) : NULL;
+    r->version = stream_version;
+    r->pass_through = rrdpush_pass_through;
+    if(rrdpush_pass_through) {
+        r->stream = __atomic_add_fetch(&host->rrdpush_pass_through_streams, 1, __ATOMIC_RELAXED);
+        host->rrdpush_pass_through_reset = 0;
+        host->rrdpush_pass_through = 1;
     }
-    rrdhost_unlock(host);
-
-    if(host->connected_senders == 0)
-        rrdpush_sender_thread_stop(host);
-
-    // cleanup
-    fclose(fp);
+    r->parser = pluginsd_parser_create(host, &r->cd, 1, stream_version >= STREAMING_PROTOCOL_VERSION_BINARY, r->replies);
+    if(max_charts || max_dimensions || max_points) {
+        r->limits.max_charts = (size_t)max_charts;
+        r->limits.max_dimensions = (size_t)max_dimensions;
+        pluginsd_parser_limits(r->parser, &r->limits);
+
+        r->max_points = (size_t)max_points;
+        r->points_allowed = max_points;
+        r->points_refilled_ut = now_monotonic_usec();
+        host->rrdpush_receiver_limited = 1;
+    }
+    r->data = buffer_create(RRDPUSH_RECEIVER_READ_SIZE);
+#ifdef ENABLE_COMPRESSION
+    if(stream_compression) {
+        r->decompressor = rrdpush_decompressor_create();
+        r->compressed = buffer_create(RRDPUSH_RECEIVER_READ_SIZE);
+    }
+#endif
+    r->health_enabled = health_enabled;
+    r->key = strdupz(key);
+    r->client_ip = strdupz(client_ip);
+    r->client_port = strdupz(client_port);
+#ifdef ENABLE_HTTPS
+    // the receiver frees the SSL connection, when it is disconnected
+    r->ssl = *ssl;
+    ssl->conn = NULL;
+#endif
 
-    return (int)count;
+    rrdpush_receiver_add(r);
+    return 0;
 }
 
 struct rrdpush_thread {
@@ -1155,6 +3293,10 @@ struct rrdpush_thread {
     char *program_version;
     struct rrdhost_system_info *system_info;
     int update_every;
+    int stream_version;
+    int stream_compression;
+    int stream_replication;
+    int stream_definitions;
 #ifdef ENABLE_HTTPS
     struct netdata_ssl ssl;
 #endif
@@ -1208,6 +3350,10 @@ static void *rrdpush_receiver_thread(void *ptr) {
 	    , rpt->program_version
         , rpt->system_info
 	    , rpt->update_every
+	    , rpt->stream_version
+	    , rpt->stream_compression
+	    , rpt->stream_replication
+	    , rpt->stream_definitions
 	    , rpt->client_ip
 	    , rpt->client_port
 #ifdef ENABLE_HTTPS
@@ -1226,6 +3372,8 @@ static void rrdpush_sender_thread_spawn(RRDHOST *host) {
         char tag[NETDATA_THREAD_TAG_MAX + 1];
         snprintfz(tag, NETDATA_THREAD_TAG_MAX, "STREAM_SENDER[%s]", host->hostname);
 
+        host->rrdpush_sender_join = 0;
+
         if(netdata_thread_create(&host->rrdpush_sender_thread, tag, NETDATA_THREAD_OPTION_JOINABLE, rrdpush_sender_thread, (void *) host))
             error("STREAM %s [send]: failed to create new thread for client.", host->hostname);
         else
@@ -1258,6 +3406,10 @@ int rrdpush_receiver_thread_spawn(RRDHOST *host, struct web_client *w, char *url
 
     char *key = NULL, *hostname = NULL, *registry_hostname = NULL, *machine_guid = NULL, *os = "unknown", *timezone = "unknown", *tags = NULL;
     int update_every = default_rrd_update_every;
+    int stream_version = STREAMING_PROTOCOL_VERSION_TEXT;
+    int stream_compression = 0;
+    int stream_replication = 0;
+    int stream_definitions = 0;
     char buf[GUID_LEN + 1];
 
     struct rrdhost_system_info *system_info = callocz(1, sizeof(struct rrdhost_system_info));
@@ -1286,6 +3438,17 @@ int rrdpush_receiver_thread_spawn(RRDHOST *host, struct web_client *w, char *url
             timezone = value;
         else if(!strcmp(name, "tags"))
             tags = value;
+        else if(!strcmp(name, "ver"))
+            stream_version = str2i(value);
+        else if(!strcmp(name, "compression")) {
+#ifdef ENABLE_COMPRESSION
+            stream_compression = !strcmp(value, STREAMING_COMPRESSION_NAME);
+#endif
+        }
+        else if(!strcmp(name, "replication"))
+            stream_replication = !strcmp(value, "yes");
+        else if(!strcmp(name, "definitions"))
+            stream_definitions = !strcmp(value, "yes");
         else
             if(unlikely(rrdhost_set_system_info_variable(system_info, name, value))) {
                 info("STREAM [receive from [%s]:%s]: request has parameter '%s' = '%s', which is not used.", w->client_ip, w->client_port, key, value);
@@ -1402,6 +3565,10 @@ int rrdpush_receiver_thread_spawn(RRDHOST *host, struct web_client *w, char *url
     rpt->client_ip         = strdupz(w->client_ip);
     rpt->client_port       = strdupz(w->client_port);
     rpt->update_every      = update_every;
+    rpt->stream_version    = stream_version;
+    rpt->stream_compression = stream_compression;
+    rpt->stream_replication = stream_replication;
+    rpt->stream_definitions = stream_definitions;
     rpt->system_info       = system_info;
 #ifdef ENABLE_HTTPS
     rpt->ssl.conn          = w->ssl.conn;
@@ -12,14 +12,50 @@ extern char *default_rrdpush_api_key;
 extern char *default_rrdpush_send_charts_matching;
 extern unsigned int remote_clock_resync_iterations;
 
+// the versions of the streaming protocol, the sender asks for the one it wants
+// with ver= and the receiver replies with START_STREAMING_PROMPT_VERSION and the
+// one it accepts. A receiver that does not reply with a version speaks STREAMING_PROTOCOL_VERSION_TEXT
+#define STREAMING_PROTOCOL_VERSION_TEXT 1
+#define STREAMING_PROTOCOL_VERSION_BINARY 2    // BIND and binary metrics frames, see plugins_d.h
+#define STREAMING_PROTOCOL_CURRENT_VERSION STREAMING_PROTOCOL_VERSION_BINARY
+
+// the sender asks for the values it has stored while not connected to be replicated
+// with replication=yes and the receiver accepts it by appending START_STREAMING_REPLICATION
+// to its reply - see the REPLICATE and REPLAY_* keywords in plugins_d.h
+#define START_STREAMING_REPLICATION " replication=yes"
+
+// the sender asks for the definitions of the charts the receiver has with definitions=yes,
+// and the receiver sends them after its reply, which ends with START_STREAMING_DEFINITIONS
+// and a newline - see the DEFINITION keyword in plugins_d.h
+#define START_STREAMING_DEFINITIONS " definitions=yes"
+
 extern int rrdpush_init();
 extern void rrdset_done_push(RRDSET *st);
+extern void rrdset_done_push_batch(RRDSET *st, BUFFER *batch);
+extern void rrdpush_send_batch(RRDHOST *host, BUFFER *batch);
 extern void rrdset_push_chart_definition_now(RRDSET *st);
 extern void *rrdpush_sender_thread(void *ptr);
 
 extern int rrdpush_receiver_thread_spawn(RRDHOST *host, struct web_client *w, char *url);
 extern void rrdpush_sender_thread_stop(RRDHOST *host);
+extern void rrdpush_sender_free_queues(RRDHOST *host);
 
 extern void rrdpush_sender_send_this_host_variable_now(RRDHOST *host, RRDVAR *rv);
 
+#ifdef ENABLE_COMPRESSION
+// the sender asks for compression with compression=lz4 and the receiver
+// accepts it by appending START_STREAMING_COMPRESSION to its reply
+#define STREAMING_COMPRESSION_NAME "lz4"
+#define START_STREAMING_COMPRESSION " compression=" STREAMING_COMPRESSION_NAME
+
+extern struct rrdpush_compressor *rrdpush_compressor_create(void);
+extern void rrdpush_compressor_reset(struct rrdpush_compressor *c);
+extern void rrdpush_compressor_free(struct rrdpush_compressor *c);
+extern size_t rrdpush_compress(struct rrdpush_compressor *c, const char *data, size_t len, BUFFER *out);
+
+extern struct rrdpush_decompressor *rrdpush_decompressor_create(void);
+extern void rrdpush_decompressor_free(struct rrdpush_decompressor *d);
+extern ssize_t rrdpush_decompress(struct rrdpush_decompressor *d, const char *data, size_t len, BUFFER *out);
+#endif
+
 #endif //NETDATA_RRDPUSH_H
@@ -0,0 +1,212 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * 1. build netdata (as normally)
+ * 2. cd tests/profile/
+ * 3. make benchmark-btree
+ * 4. ./benchmark-btree [entries]
+ *
+ * It indexes the same items, ordered by hash and name like the charts and
+ * the dimensions are, with an avl tree and with a btree, and compares the
+ * rate of the searches, the inserts and the removals. The btree is also
+ * checked against the avl tree, with random inserts and removals.
+ *
+ */
+
+#include "config.h"
+#include "libnetdata/libnetdata.h"
+
+void netdata_cleanup_and_exit(int ret) { exit(ret); }
+
+struct item {
+	avl avl;		// has to be first
+	uint32_t hash;
+	char name[28];
+};
+
+static int item_compare(void *a, void *b) {
+	if(((struct item *)a)->hash < ((struct item *)b)->hash) return -1;
+	else if(((struct item *)a)->hash > ((struct item *)b)->hash) return 1;
+	else return strcmp(((struct item *)a)->name, ((struct item *)b)->name);
+}
+
+static uint32_t item_prefix(void *a) {
+	return ((struct item *)a)->hash;
+}
+
+struct walk {
+	void *last;
+	size_t count;
+	int errors;
+};
+
+static int walk_callback(void *entry, void *data) {
+	struct walk *w = data;
+
+	if(w->last && item_compare(w->last, entry) >= 0)
+		w->errors++;
+
+	w->last = entry;
+	w->count++;
+	return 1;
+}
+
+static void print_stats(const char *what, size_t count, usec_t start, usec_t end) {
+	if(end == start) end++;
+	fprintf(stderr, " > %-30s %llu per second\n", what, (unsigned long long)count * USEC_PER_SEC / (end - start));
+}
+
+// ----------------------------------------------------------------------------
+
+static int check(size_t entries) {
+	struct item *items = callocz(entries, sizeof(struct item));
+	avl_tree avl_index;
+	BTREE btree_index;
+	size_t i, operations = entries * 10;
+	int errors = 0;
+
+	avl_init(&avl_index, item_compare);
+	btree_init(&btree_index, item_compare, item_prefix);
+
+	for(i = 0; i < entries ; i++) {
+		snprintfz(items[i].name, sizeof(items[i].name) - 1, "item%zu", i);
+		// few hashes, so that many items have the same prefix
+		items[i].hash = simple_hash(items[i].name) & 0xff;
+	}
+
+	for(i = 0; i < operations ; i++) {
+		struct item *it = &items[(size_t)random() % entries];
+
+		if(random() % 2) {
+			void *a = avl_insert(&avl_index, (avl *)it);
+			void *b = btree_insert(&btree_index, it);
+			if(a != b) errors++;
+		}
+		else {
+			void *a = avl_remove(&avl_index, (avl *)it);
+			void *b = btree_remove(&btree_index, it);
+			if(a != b) errors++;
+		}
+
+		if(btree_search(&btree_index, it) != avl_search(&avl_index, (avl *)it))
+			errors++;
+	}
+
+	struct walk wa = { NULL, 0, 0 }, wb = { NULL, 0, 0 };
+	avl_traverse(&avl_index, walk_callback, &wa);
+	btree_traverse(&btree_index, walk_callback, &wb);
+	if(wa.count != wb.count || wb.count != btree_index.entries || wb.errors)
+		errors++;
+
+	for(i = 0; i < entries ; i++)
+		if(btree_remove(&btree_index, &items[i]) != avl_remove(&avl_index, (avl *)&items[i]))
+			errors++;
+
+	if(btree_index.root || btree_index.entries || btree_index.nodes)
+		errors++;
+
+	fprintf(stderr, "Checked %zu random inserts and removals of %zu items: %d errors\n", operations, entries, errors);
+
+	btree_destroy(&btree_index);
+	freez(items);
+	return errors;
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+	size_t entries = 1000000, i;
+	usec_t start;
+
+	if(argc > 1) entries = strtoul(argv[1], NULL, 0);
+	if(entries < 10) entries = 10;
+
+	if(check(10000))
+		return 1;
+
+	struct item *items = callocz(entries, sizeof(struct item));
+	struct item **order = mallocz(entries * sizeof(struct item *));
+	for(i = 0; i < entries ; i++) {
+		snprintfz(items[i].name, sizeof(items[i].name) - 1, "chart.dimension%zu", i);
+		items[i].hash = simple_hash(items[i].name);
+		order[i] = &items[i];
+	}
+
+	// search in random order
+	for(i = entries - 1; i > 0 ; i--) {
+		size_t j = (size_t)random() % (i + 1);
+		struct item *t = order[i]; order[i] = order[j]; order[j] = t;
+	}
+
+	avl_tree avl_index;
+	BTREE btree_index, btree_noprefix_index;
+	avl_init(&avl_index, item_compare);
+	btree_init(&btree_index, item_compare, item_prefix);
+	btree_init(&btree_noprefix_index, item_compare, NULL);
+
+	fprintf(stderr, "\n%zu items\n", entries);
+
+	// ------------------------------------------------------------------------
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(avl_insert(&avl_index, (avl *)&items[i]) != (avl *)&items[i]) fatal("avl insert failed");
+	print_stats("avl inserts", entries, start, now_monotonic_usec());
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(btree_insert(&btree_index, &items[i]) != &items[i]) fatal("btree insert failed");
+	print_stats("btree inserts", entries, start, now_monotonic_usec());
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(btree_insert(&btree_noprefix_index, &items[i]) != &items[i]) fatal("btree insert failed");
+	print_stats("btree (no prefix) inserts", entries, start, now_monotonic_usec());
+
+	// ------------------------------------------------------------------------
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(avl_search(&avl_index, (avl *)order[i]) != (avl *)order[i]) fatal("avl search failed");
+	print_stats("avl searches", entries, start, now_monotonic_usec());
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(btree_search(&btree_index, order[i]) != order[i]) fatal("btree search failed");
+	print_stats("btree searches", entries, start, now_monotonic_usec());
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(btree_search(&btree_noprefix_index, order[i]) != order[i]) fatal("btree search failed");
+	print_stats("btree (no prefix) searches", entries, start, now_monotonic_usec());
+
+	// ------------------------------------------------------------------------
+
+	struct walk w = { NULL, 0, 0 };
+	start = now_monotonic_usec();
+	avl_traverse(&avl_index, walk_callback, &w);
+	print_stats("avl traversal", w.count, start, now_monotonic_usec());
+
+	w.last = NULL; w.count = 0;
+	start = now_monotonic_usec();
+	btree_traverse(&btree_index, walk_callback, &w);
+	print_stats("btree traversal", w.count, start, now_monotonic_usec());
+
+	// ------------------------------------------------------------------------
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(avl_remove(&avl_index, (avl *)order[i]) != (avl *)order[i]) fatal("avl remove failed");
+	print_stats("avl removals", entries, start, now_monotonic_usec());
+
+	start = now_monotonic_usec();
+	for(i = 0; i < entries ; i++)
+		if(btree_remove(&btree_index, order[i]) != order[i]) fatal("btree remove failed");
+	print_stats("btree removals", entries, start, now_monotonic_usec());
+
+	fprintf(stderr, "\nbtree index memory: %zu nodes of up to %d items\n", btree_noprefix_index.nodes, BTREE_MAX_ITEMS);
+
+	btree_destroy(&btree_noprefix_index);
+	freez(order);
+	freez(items);
+	return w.errors ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * 1. build netdata (as normally)
+ * 2. cd tests/profile/
+ * 3. make benchmark-clocks
+ * 4. ./benchmark-clocks [calls]
+ *
+ * It measures the cost of reading the precise and the coarse clocks.
+ * rrdset_done() reads the realtime clock in seconds once per chart (to
+ * check for obsolete dimensions), the log reads it for every line and the
+ * health expressions for every "now" - these use the coarse clock now.
+ *
+ */
+
+#include "config.h"
+#include "libnetdata/libnetdata.h"
+
+void netdata_cleanup_and_exit(int ret) { exit(ret); }
+
+static volatile unsigned long long sink = 0;
+
+static double measure(const char *what, size_t calls, unsigned long long (*f)(void)) {
+	size_t i;
+	unsigned long long sum = 0;
+
+	usec_t start = now_monotonic_usec();
+	for(i = 0; i < calls ; i++)
+		sum += f();
+	usec_t end = now_monotonic_usec();
+
+	sink += sum;
+
+	double ns = (double)(end - start) * 1000.0 / (double)calls;
+	fprintf(stderr, " > %-30s %6.2f nanoseconds per call\n", what, ns);
+	return ns;
+}
+
+static unsigned long long realtime_sec(void) { return (unsigned long long)now_realtime_sec(); }
+static unsigned long long realtime_coarse_sec(void) { return (unsigned long long)now_realtime_coarse_sec(); }
+static unsigned long long monotonic_usec(void) { return now_monotonic_usec(); }
+static unsigned long long monotonic_coarse_usec(void) { return now_monotonic_coarse_usec(); }
+static unsigned long long libc_time(void) { return (unsigned long long)time(NULL); }
+
+int main(int argc, char **argv) {
+	size_t calls = 10000000;
+
+	if(argc > 1) calls = strtoul(argv[1], NULL, 0);
+	if(calls < 1) calls = 1;
+
+	test_clock_coarse();
+
+	struct timespec res;
+	if(clock_getres(NETDATA_CLOCK_REALTIME_COARSE, &res) == 0)
+		fprintf(stderr, "coarse clock resolution: %ld nanoseconds\n", (long)res.tv_nsec);
+
+	fprintf(stderr, "%zu calls\n", calls);
+
+	double precise = measure("now_realtime_sec()", calls, realtime_sec);
+	double coarse = measure("now_realtime_coarse_sec()", calls, realtime_coarse_sec);
+	measure("time(NULL)", calls, libc_time);
+	measure("now_monotonic_usec()", calls, monotonic_usec);
+	measure("now_monotonic_coarse_usec()", calls, monotonic_coarse_usec);
+
+	fprintf(stderr, "\nsaved per rrdset_done(): %0.2f nanoseconds\n", precise - coarse);
+
+	// the coarse clock has to follow the precise one
+	time_t a = now_realtime_sec(), b = now_realtime_coarse_sec();
+	if(b < a - 1 || b > a + 1) {
+		fprintf(stderr, "ERROR: the coarse clock is at %ld, the precise one at %ld\n", (long)b, (long)a);
+		return 1;
+	}
+
+	return 0;
+}
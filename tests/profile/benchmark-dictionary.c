@@ -2,8 +2,13 @@
 /*
  * 1. build netdata (as normally)
  * 2. cd tests/profile/
- * 3. compile with:
- *    gcc -O3 -Wall -Wextra -I ../../src/ -I ../../ -o benchmark-dictionary benchmark-dictionary.c ../../src/dictionary.o ../../src/log.o ../../src/avl.o ../../src/common.o -pthread
+ * 3. make benchmark-dictionary
+ * 4. ./benchmark-dictionary [entries] [reader threads]
+ *
+ * It runs the same operations on a dictionary indexed by an avl tree (the
+ * default) and on one indexed by a hash table (DICTIONARY_FLAG_HASH_INDEX),
+ * and then it has a few threads reading the dictionary concurrently, while
+ * the main thread keeps updating it.
  *
  */
 
@@ -16,24 +21,26 @@ struct myvalue {
 
 void netdata_cleanup_and_exit(int ret) { exit(ret); }
 
-int main(int argc, char **argv) {
-	if(argc || argv) {;}
+static unsigned long long elapsed_usec(struct rusage *start, struct rusage *end) {
+	unsigned long long dt = (end->ru_utime.tv_sec * 1000000ULL + end->ru_utime.tv_usec) - (start->ru_utime.tv_sec * 1000000ULL + start->ru_utime.tv_usec);
+	return dt?dt:1;
+}
 
-//	DICTIONARY *dict = dictionary_create(DICTIONARY_FLAG_SINGLE_THREADED|DICTIONARY_FLAG_WITH_STATISTICS);
-	DICTIONARY *dict = dictionary_create(DICTIONARY_FLAG_WITH_STATISTICS);
+static void benchmark_dictionary(const char *engine, uint8_t flags, int max) {
+	DICTIONARY *dict = dictionary_create(flags|DICTIONARY_FLAG_WITH_STATISTICS);
 	if(!dict) fatal("Cannot create dictionary.");
 
 	struct rusage start, end;
 	unsigned long long dt;
 	char buf[100 + 1];
 	struct myvalue value, *v;
-	int i, max = 30000000, max2;
+	int i, max2;
+
+	fprintf(stderr, "\n%s\n", engine);
 
 	// ------------------------------------------------------------------------
 
 	getrusage(RUSAGE_SELF, &start);
-	dict->stats->inserts = dict->stats->deletes = dict->stats->searches = 0ULL;
-	fprintf(stderr, "Inserting %d entries in the dictionary\n", max);
 	for(i = 0; i < max; i++) {
 		value.i = i;
 		snprintf(buf, 100, "%d", i);
@@ -41,17 +48,13 @@ int main(int argc, char **argv) {
 		dictionary_set(dict, buf, &value, sizeof(struct myvalue));
 	}
 	getrusage(RUSAGE_SELF, &end);
-	dt = (end.ru_utime.tv_sec * 1000000ULL + end.ru_utime.tv_usec) - (start.ru_utime.tv_sec * 1000000ULL + start.ru_utime.tv_usec);
-	fprintf(stderr, "Added %d entries in %llu nanoseconds: %llu inserts per second\n", max, dt, max * 1000000ULL / dt);
-	fprintf(stderr, " > Dictionary: %llu inserts, %llu deletes, %llu searches\n\n", dict->stats->inserts, dict->stats->deletes, dict->stats->searches);
+	dt = elapsed_usec(&start, &end);
+	fprintf(stderr, " > inserts:            %llu per second\n", max * 1000000ULL / dt);
 
 	// ------------------------------------------------------------------------
 
 	getrusage(RUSAGE_SELF, &start);
-	dict->stats->inserts = dict->stats->deletes = dict->stats->searches = 0ULL;
-	fprintf(stderr, "Retrieving %d entries from the dictionary\n", max);
 	for(i = 0; i < max; i++) {
-		value.i = i;
 		snprintf(buf, 100, "%d", i);
 
 		v = dictionary_get(dict, buf);
@@ -61,15 +64,12 @@ int main(int argc, char **argv) {
 			fprintf(stderr, "ERROR: expected %d but got %d\n", i, v->i);
 	}
 	getrusage(RUSAGE_SELF, &end);
-	dt = (end.ru_utime.tv_sec * 1000000ULL + end.ru_utime.tv_usec) - (start.ru_utime.tv_sec * 1000000ULL + start.ru_utime.tv_usec);
-	fprintf(stderr, "Read %d entries in %llu nanoseconds: %llu searches per second\n", max, dt, max * 1000000ULL / dt);
-	fprintf(stderr, " > Dictionary: %llu inserts, %llu deletes, %llu searches\n\n", dict->stats->inserts, dict->stats->deletes, dict->stats->searches);
+	dt = elapsed_usec(&start, &end);
+	fprintf(stderr, " > searches:           %llu per second\n", max * 1000000ULL / dt);
 
 	// ------------------------------------------------------------------------
 
 	getrusage(RUSAGE_SELF, &start);
-	dict->stats->inserts = dict->stats->deletes = dict->stats->searches = 0ULL;
-	fprintf(stderr, "Resetting %d entries in the dictionary\n", max);
 	for(i = 0; i < max; i++) {
 		value.i = i;
 		snprintf(buf, 100, "%d", i);
@@ -77,18 +77,14 @@ int main(int argc, char **argv) {
 		dictionary_set(dict, buf, &value, sizeof(struct myvalue));
 	}
 	getrusage(RUSAGE_SELF, &end);
-	dt = (end.ru_utime.tv_sec * 1000000ULL + end.ru_utime.tv_usec) - (start.ru_utime.tv_sec * 1000000ULL + start.ru_utime.tv_usec);
-	fprintf(stderr, "Reset %d entries in %llu nanoseconds: %llu resets per second\n", max, dt, max * 1000000ULL / dt);
-	fprintf(stderr, " > Dictionary: %llu inserts, %llu deletes, %llu searches\n\n", dict->stats->inserts, dict->stats->deletes, dict->stats->searches);
+	dt = elapsed_usec(&start, &end);
+	fprintf(stderr, " > resets:             %llu per second\n", max * 1000000ULL / dt);
 
 	// ------------------------------------------------------------------------
 
 	getrusage(RUSAGE_SELF, &start);
-	dict->stats->inserts = dict->stats->deletes = dict->stats->searches = 0ULL;
-	fprintf(stderr, "Searching  %d non-existing entries in the dictionary\n", max);
 	max2 = max * 2;
 	for(i = max; i < max2; i++) {
-		value.i = i;
 		snprintf(buf, 100, "%d", i);
 
 		v = dictionary_get(dict, buf);
@@ -96,35 +92,121 @@ int main(int argc, char **argv) {
 			fprintf(stderr, "ERROR: cannot got non-existing value %d from the dictionary\n", i);
 	}
 	getrusage(RUSAGE_SELF, &end);
-	dt = (end.ru_utime.tv_sec * 1000000ULL + end.ru_utime.tv_usec) - (start.ru_utime.tv_sec * 1000000ULL + start.ru_utime.tv_usec);
-	fprintf(stderr, "Searched %d non-existing entries in %llu nanoseconds: %llu not found searches per second\n", max, dt, max * 1000000ULL / dt);
-	fprintf(stderr, " > Dictionary: %llu inserts, %llu deletes, %llu searches\n\n", dict->stats->inserts, dict->stats->deletes, dict->stats->searches);
+	dt = elapsed_usec(&start, &end);
+	fprintf(stderr, " > not found searches: %llu per second\n", max * 1000000ULL / dt);
 
 	// ------------------------------------------------------------------------
 
 	getrusage(RUSAGE_SELF, &start);
-	dict->stats->inserts = dict->stats->deletes = dict->stats->searches = 0ULL;
-	fprintf(stderr, "Deleting %d entries from the dictionary\n", max);
 	for(i = 0; i < max; i++) {
-		value.i = i;
 		snprintf(buf, 100, "%d", i);
 
 		dictionary_del(dict, buf);
 	}
 	getrusage(RUSAGE_SELF, &end);
-	dt = (end.ru_utime.tv_sec * 1000000ULL + end.ru_utime.tv_usec) - (start.ru_utime.tv_sec * 1000000ULL + start.ru_utime.tv_usec);
-	fprintf(stderr, "Deleted %d entries in %llu nanoseconds: %llu deletes per second\n", max, dt, max * 1000000ULL / dt);
-	fprintf(stderr, " > Dictionary: %llu inserts, %llu deletes, %llu searches\n\n", dict->stats->inserts, dict->stats->deletes, dict->stats->searches);
+	dt = elapsed_usec(&start, &end);
+	fprintf(stderr, " > deletes:            %llu per second\n", max * 1000000ULL / dt);
 
-	// ------------------------------------------------------------------------
+	if(dict->stats->entries)
+		fprintf(stderr, "ERROR: %llu entries left in the dictionary\n", dict->stats->entries);
 
-	getrusage(RUSAGE_SELF, &start);
-	dict->stats->inserts = dict->stats->deletes = dict->stats->searches = 0ULL;
-	fprintf(stderr, "Destroying dictionary\n");
 	dictionary_destroy(dict);
-	getrusage(RUSAGE_SELF, &end);
-	dt = (end.ru_utime.tv_sec * 1000000ULL + end.ru_utime.tv_usec) - (start.ru_utime.tv_sec * 1000000ULL + start.ru_utime.tv_usec);
-	fprintf(stderr, "Destroyed in %llu nanoseconds\n", dt);
+}
+
+// ----------------------------------------------------------------------------
+// concurrent readers
+
+struct reader {
+	netdata_thread_t thread;
+	DICTIONARY *dict;
+	int max;
+	volatile int *stop;
+	unsigned long long searches;
+};
+
+static void *reader_thread(void *ptr) {
+	struct reader *r = ptr;
+	char buf[100 + 1];
+	int i = 0;
+
+	while(!*r->stop) {
+		snprintf(buf, 100, "%d", i);
+
+		struct myvalue *v = dictionary_get(r->dict, buf);
+		if(!v)
+			fprintf(stderr, "ERROR: cannot get value %d from the dictionary\n", i);
+
+		r->searches++;
+		if(++i == r->max) i = 0;
+	}
+
+	return NULL;
+}
+
+static void benchmark_dictionary_concurrent(const char *engine, uint8_t flags, int max, int threads) {
+	DICTIONARY *dict = dictionary_create(flags);
+	struct myvalue value = { 0 };
+	char buf[100 + 1];
+	volatile int stop = 0;
+	int i;
+
+	for(i = 0; i < max; i++) {
+		value.i = i;
+		snprintf(buf, 100, "%d", i);
+		dictionary_set(dict, buf, &value, sizeof(struct myvalue));
+	}
+
+	struct reader *readers = callocz(threads, sizeof(struct reader));
+	for(i = 0; i < threads; i++) {
+		readers[i].dict = dict;
+		readers[i].max = max;
+		readers[i].stop = &stop;
+		netdata_thread_create(&readers[i].thread, "READER", NETDATA_THREAD_OPTION_JOINABLE|NETDATA_THREAD_OPTION_DONT_LOG, reader_thread, &readers[i]);
+	}
+
+	// keep adding and deleting entries the readers do not look for
+	usec_t started = now_monotonic_usec();
+	unsigned long long writes = 0;
+	while(now_monotonic_usec() - started < 2 * USEC_PER_SEC) {
+		snprintf(buf, 100, "w%llu", writes % 1000);
+		if((writes / 1000) % 2) dictionary_del(dict, buf);
+		else dictionary_set(dict, buf, &value, sizeof(struct myvalue));
+		writes++;
+	}
+	stop = 1;
+	usec_t ended = now_monotonic_usec();
+
+	unsigned long long searches = 0;
+	for(i = 0; i < threads; i++) {
+		netdata_thread_join(readers[i].thread, NULL);
+		searches += readers[i].searches;
+	}
+
+	fprintf(stderr, " > %s, %d readers and 1 writer: %llu searches per second, %llu writes per second\n",
+			engine, threads, searches * USEC_PER_SEC / (ended - started), writes * USEC_PER_SEC / (ended - started));
+
+	freez(readers);
+	dictionary_destroy(dict);
+}
+
+int main(int argc, char **argv) {
+	int max = 1000000, threads = 4;
+
+	if(argc > 1) max = atoi(argv[1]);
+	if(argc > 2) threads = atoi(argv[2]);
+	if(max < 1) max = 1;
+	if(threads < 1) threads = 1;
+
+	netdata_threads_init_after_fork(0);
+
+	fprintf(stderr, "Benchmarking dictionaries with %d entries\n", max);
+	benchmark_dictionary("AVL", DICTIONARY_FLAG_DEFAULT, max);
+	benchmark_dictionary("AVL, single threaded", DICTIONARY_FLAG_SINGLE_THREADED, max);
+	benchmark_dictionary("HASH INDEX", DICTIONARY_FLAG_HASH_INDEX, max);
+
+	fprintf(stderr, "\nConcurrent access for 2 seconds\n");
+	benchmark_dictionary_concurrent("AVL", DICTIONARY_FLAG_DEFAULT, max, threads);
+	benchmark_dictionary_concurrent("HASH INDEX", DICTIONARY_FLAG_HASH_INDEX, max, threads);
 
 	return 0;
 }
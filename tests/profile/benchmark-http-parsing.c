@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+// a request of a browser, as it is received by the web server
+static const char *request =
+        "GET /api/v1/data?chart=system.cpu&format=json&points=300&group=average&gtime=0&options=ms%7Cflip%7Cjsonwrap%7Cnonzero&after=-300&dimensions=user%7Csystem HTTP/1.1\r\n"
+        "Host: 10.11.12.13:19999\r\n"
+        "Connection: keep-alive\r\n"
+        "Accept: application/json, text/javascript, */*; q=0.01\r\n"
+        "X-Requested-With: XMLHttpRequest\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/76.0.3809.100 Safari/537.36\r\n"
+        "Referer: http://10.11.12.13:19999/\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: en-US,en;q=0.9,el;q=0.8\r\n"
+        "Cookie: netdata_registry_id=f5e4aa6c-1042-4a1f-9a7d-0e1a5a8e1b0a\r\n"
+        "Origin: http://10.11.12.13:19999\r\n"
+        "\r\n";
+
+static char buffer[4096];
+
+// ----------------------------------------------------------------------------
+// the way the headers end was searched before: every byte of the received data
+// on the first attempt, strstr() from the end of the previous data afterwards
+
+static inline char *test1_find(char *s, size_t len, size_t *last_size, size_t *tries) {
+    size_t last_pos = *last_size;
+    if(last_pos > 4) last_pos -= 4;
+    else last_pos = 0;
+
+    (*tries)++;
+    *last_size = len;
+
+    if(*tries > 1)
+        return strstr(&s[last_pos], "\r\n\r\n");
+
+    while(*s) {
+        while(*s && *s++ != '\r');
+        if(unlikely(!*s)) break;
+        if(likely(*s++ == '\n') && unlikely(*s == '\r' && s[1] == '\n'))
+            return &s[-2];
+    }
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// the way web_client.c searches it now: memchr() from the end of the previous data
+
+static inline char *test2_find(char *s, size_t len, size_t *last_size, size_t *tries) {
+    size_t pos = *last_size;
+    pos = (pos > 3 && pos <= len) ? pos - 3 : 0;
+
+    (*tries)++;
+    *last_size = len;
+
+    char *end = &s[len], *r = &s[pos];
+    while(r < end && (r = memchr(r, '\r', (size_t)(end - r)))) {
+        if(unlikely(end - r < 4)) break;
+        if(r[1] == '\n' && r[2] == '\r' && r[3] == '\n') return r;
+        r++;
+    }
+    return NULL;
+}
+
+// receives the request in chunks of step bytes, searching for its end every time
+static unsigned long test(char *(*find)(char *, size_t, size_t *, size_t *), size_t step) {
+    size_t len = strlen(request), received = 0, last_size = 0, tries = 0;
+    char *found = NULL;
+
+    while(!found && received < len) {
+        size_t bytes = (len - received < step) ? len - received : step;
+        memcpy(&buffer[received], &request[received], bytes);
+        received += bytes;
+        buffer[received] = '\0';
+        found = find(buffer, received, &last_size, &tries);
+    }
+
+    if(unlikely(!found || found != &buffer[len - 4])) {
+        fprintf(stderr, "ERROR: the end of the request was not found\n");
+        exit(1);
+    }
+
+    return (unsigned long)tries;
+}
+
+// ===============
+
+static unsigned long long clk;
+
+static void begin_clock() {
+    struct timeval tv;
+    if(unlikely(gettimeofday(&tv, NULL) == -1))
+        return;
+    clk = tv.tv_sec  * 1000000 + tv.tv_usec;
+}
+
+static unsigned long long end_clock() {
+    struct timeval tv;
+    if(unlikely(gettimeofday(&tv, NULL) == -1))
+        return -1;
+    return clk = tv.tv_sec  * 1000000 + tv.tv_usec - clk;
+}
+
+int main(void)
+{
+    size_t steps[] = { 4096, 100, 10, 1, 0 };
+    unsigned long i, max = 200000, c1, c2, t = 0;
+    int s;
+
+    printf("request of %zu bytes\n", strlen(request));
+
+    // let the processor get up to speed
+    for(i = 0; i <= max ;i++) t += test(test1_find, 4096);
+
+    for(s = 0; steps[s] ; s++) {
+        unsigned long loops = (steps[s] > 10) ? max : max / 10;
+
+        begin_clock();
+        for(i = 0; i <= loops ;i++) t += test(test1_find, steps[s]);
+        c1 = end_clock();
+
+        begin_clock();
+        for(i = 0; i <= loops ;i++) t += test(test2_find, steps[s]);
+        c2 = end_clock();
+
+        printf("received in chunks of %4zu bytes, %lu requests: test1() in %llu usecs (byte loop / strstr()), test2() in %llu usecs (incremental memchr())\n"
+               , steps[s]
+               , loops
+               , (unsigned long long)c1
+               , (unsigned long long)c2
+        );
+    }
+
+    return (t)?0:1;
+}
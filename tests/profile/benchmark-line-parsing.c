@@ -569,6 +569,74 @@ void test7() {
     }
 }
 
+// ----------------------------------------------------------------------------
+// the dimensions of a chart, SET by the plugins.d parser in the order of their definition
+
+#define DIMENSIONS 33
+
+struct dimension {
+    const char *id;
+    unsigned long long value;
+    struct dimension *next;             // in the order of their definition
+};
+
+static struct dimension dimensions[DIMENSIONS];
+static struct dimension *sorted[DIMENSIONS]; // by id, like the AVL index of rrddim_find()
+
+static int dimension_compare(const void *a, const void *b) {
+    return strcmp((*(struct dimension **)a)->id, (*(struct dimension **)b)->id);
+}
+
+static void dimensions_init(void) {
+    int i;
+    for(i = 0; i < DIMENSIONS ; i++) {
+        dimensions[i].id = strings[i];
+        dimensions[i].next = (i + 1 < DIMENSIONS)?&dimensions[i + 1]:NULL;
+        sorted[i] = &dimensions[i];
+    }
+    qsort(sorted, DIMENSIONS, sizeof(struct dimension *), dimension_compare);
+}
+
+static inline struct dimension *dimension_find(const char *id) {
+    int low = 0, high = DIMENSIONS - 1;
+
+    while(low <= high) {
+        int mid = (low + high) / 2;
+        int r = strcmp(id, sorted[mid]->id);
+        if(!r) return sorted[mid];
+        if(r < 0) high = mid - 1;
+        else low = mid + 1;
+    }
+
+    return NULL;
+}
+
+// every SET searches for its dimension (netdata default prior to the SET cursor)
+void test8() {
+    int i;
+    for(i = 0; i < DIMENSIONS ; i++) {
+        struct dimension *d = dimension_find(strings[i]);
+        if(likely(d)) d->value = fast_strtoull(NUMBER1);
+    }
+}
+
+// every SET tries the dimension after the one of the previous SET, before searching
+void test9() {
+    struct dimension *next = &dimensions[0];
+
+    int i;
+    for(i = 0; i < DIMENSIONS ; i++) {
+        struct dimension *d = next;
+        if(unlikely(!d || strcmp(d->id, strings[i])))
+            d = dimension_find(strings[i]);
+
+        if(likely(d)) {
+            d->value = fast_strtoull(NUMBER1);
+            next = d->next;
+        }
+    }
+}
+
 // ----------------------------------------------------------------------------
 
 
@@ -648,7 +716,9 @@ void main(void)
     (void)strcmp("1", "2");
     (void)strtoull("123", NULL, 0);
 
-  unsigned long i, c1 = 0, c2 = 0, c3 = 0, c4 = 0, c5 = 0, c6 = 0, c7;
+    dimensions_init();
+
+  unsigned long i, c1 = 0, c2 = 0, c3 = 0, c4 = 0, c5 = 0, c6 = 0, c7, c8, c9;
   unsigned long max = 1000000;
 
   // let the processor get up to speed
@@ -684,6 +754,14 @@ void main(void)
     for(i = 0; i <= max ;i++) test7();
     c7 = end_clock();
 
+    begin_clock();
+    for(i = 0; i <= max ;i++) test8();
+    c8 = end_clock();
+
+    begin_clock();
+    for(i = 0; i <= max ;i++) test9();
+    c9 = end_clock();
+
     for(i = 0; i < 11 ; i++)
     printf("value %lu: %llu %llu %llu %llu %llu %llu\n", i, values1[i], values2[i], values3[i], values4[i], values5[i], values6[i]);
   
@@ -695,6 +773,8 @@ void main(void)
          "test5() in %lu usecs: inline simple_hash(), if-else-if-else-if, custom strtoull() (netdata default prior to ARL).\n"
          "test6() in %lu usecs: adaptive re-sortable list, system strtoull() (wow!)\n"
          "test7() in %lu usecs: adaptive re-sortable list, custom strtoull() (wow!)\n"
+         "test8() in %lu usecs: plugins.d SET, searching every dimension, custom strtoull().\n"
+         "test9() in %lu usecs: plugins.d SET, trying the next dimension first, custom strtoull().\n"
          , c1
          , c2
          , c3
@@ -702,6 +782,8 @@ void main(void)
          , c5
          , c6
          , c7
+         , c8
+         , c9
          );
 
 }
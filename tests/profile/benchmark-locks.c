@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * 1. build netdata (as normally)
+ * 2. cd tests/profile/
+ * 3. make benchmark-locks
+ * 4. ./benchmark-locks [threads] [iterations]
+ *
+ * It has a few threads incrementing a counter in a short critical section,
+ * protected by a netdata mutex and by an adaptive lock, and checks that no
+ * increment is lost. Then it profiles the same critical section and prints
+ * the /api/v1/locks output for it.
+ *
+ */
+
+#include "config.h"
+#include "libnetdata/libnetdata.h"
+
+void netdata_cleanup_and_exit(int ret) { exit(ret); }
+
+static netdata_mutex_t mutex = NETDATA_MUTEX_INITIALIZER;
+static netdata_adaptive_lock_t adaptive = NETDATA_ADAPTIVE_LOCK_INITIALIZER;
+static size_t iterations = 1000000;
+static volatile uint64_t counter = 0;
+
+static void *mutex_thread(void *ptr) {
+	(void)ptr;
+	size_t i;
+
+	for(i = 0; i < iterations ; i++) {
+		__netdata_mutex_lock(&mutex);
+		counter++;
+		__netdata_mutex_unlock(&mutex);
+	}
+
+	return NULL;
+}
+
+static void *adaptive_thread(void *ptr) {
+	(void)ptr;
+	size_t i;
+
+	for(i = 0; i < iterations ; i++) {
+		__netdata_adaptive_lock(&adaptive);
+		counter++;
+		__netdata_adaptive_unlock(&adaptive);
+	}
+
+	return NULL;
+}
+
+static void *profiled_thread(void *ptr) {
+	(void)ptr;
+	size_t i;
+
+	for(i = 0; i < iterations ; i++) {
+		netdata_adaptive_lock_debug(__FILE__, __FUNCTION__, __LINE__, &adaptive);
+		counter++;
+		netdata_adaptive_unlock_debug(__FILE__, __FUNCTION__, __LINE__, &adaptive);
+	}
+
+	return NULL;
+}
+
+static int run(const char *what, int threads, void *(*start_routine)(void *)) {
+	netdata_thread_t *t = callocz(threads, sizeof(netdata_thread_t));
+	int i;
+
+	counter = 0;
+
+	usec_t start = now_monotonic_usec();
+	for(i = 0; i < threads ; i++)
+		netdata_thread_create(&t[i], "LOCKER", NETDATA_THREAD_OPTION_JOINABLE|NETDATA_THREAD_OPTION_DONT_LOG, start_routine, NULL);
+
+	for(i = 0; i < threads ; i++)
+		netdata_thread_join(t[i], NULL);
+	usec_t end = now_monotonic_usec();
+
+	uint64_t expected = (uint64_t)threads * iterations;
+	fprintf(stderr, " > %-30s %llu locks per second%s\n", what,
+			(unsigned long long)expected * USEC_PER_SEC / ((end > start) ? end - start : 1),
+			(counter != expected) ? " - ERROR: lost increments" : "");
+
+	freez(t);
+	return counter != expected;
+}
+
+int main(int argc, char **argv) {
+	int threads = 4, errors = 0;
+
+	if(argc > 1) threads = atoi(argv[1]);
+	if(argc > 2) iterations = strtoul(argv[2], NULL, 0);
+	if(threads < 1) threads = 1;
+	if(iterations < 1) iterations = 1;
+
+	netdata_threads_init_after_fork(0);
+
+	fprintf(stderr, "%d threads, %zu locks each\n", threads, iterations);
+
+	errors += run("mutex", threads, mutex_thread);
+	errors += run("adaptive lock", threads, adaptive_thread);
+
+	netdata_locks_profiling = 1;
+	errors += run("adaptive lock, profiled", threads, profiled_thread);
+	netdata_locks_profiling = 0;
+
+	BUFFER *wb = buffer_create(1024);
+	netdata_locks_profile2json(wb);
+	fprintf(stderr, "\n%s\n", buffer_tostring(wb));
+	buffer_free(wb);
+
+	return errors ? 1 : 0;
+}
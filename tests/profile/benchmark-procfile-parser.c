@@ -263,15 +263,38 @@ unsigned long end_tsc(void)
 // ==============
 
 
-unsigned long test_netdata_internal(void) {
-	static procfile *ff = NULL;
-
-	ff = procfile_reopen(ff, "/proc/self/status", " \t:,-()/", PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
+// the files proc.plugin parses, with the separators it uses
+static struct {
+	const char *filename;
+	const char *separators;
+} files[] = {
+	{ "/proc/self/status", " \t:,-()/" },
+	{ "/proc/stat",        " \t:"      },
+	{ "/proc/net/dev",     " \t,:|"    },
+	{ "/proc/diskstats",   " \t"       },
+	{ "/proc/interrupts",  " \t:"      },
+	{ NULL, NULL }
+};
+
+// byte_by_byte: make procfile_readall() check the type of every character, instead of using SIMD
+static procfile *open_file(procfile *ff, int f, int byte_by_byte) {
+	ff = procfile_reopen(ff, files[f].filename, files[f].separators, PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
 	if(!ff) {
-		fprintf(stderr, "Failed to open filename\n");
+		fprintf(stderr, "Failed to open filename '%s'\n", files[f].filename);
 		exit(1);
 	}
 
+	if(byte_by_byte)
+		ff->word_stops_len = PROCFILE_WORD_STOPS_MAX + 1;
+
+	return ff;
+}
+
+unsigned long test_netdata_internal(int f) {
+	static procfile *ff = NULL;
+
+	ff = open_file(ff, f, 0);
+
 	begin_tsc();
 	ff = procfile_readall(ff);
 	unsigned long c = end_tsc();
@@ -284,15 +307,28 @@ unsigned long test_netdata_internal(void) {
 	return c;
 }
 
-unsigned long test_method1(void) {
+unsigned long test_netdata_byte_by_byte(int f) {
 	static procfile *ff = NULL;
 
-	ff = procfile_reopen(ff, "/proc/self/status", " \t:,-()/", PROCFILE_FLAG_NO_ERROR_ON_FILE_IO);
+	ff = open_file(ff, f, 1);
+
+	begin_tsc();
+	ff = procfile_readall(ff);
+	unsigned long c = end_tsc();
+
 	if(!ff) {
-		fprintf(stderr, "Failed to open filename\n");
+		fprintf(stderr, "Failed to read filename\n");
 		exit(1);
 	}
 
+	return c;
+}
+
+unsigned long test_method1(int f) {
+	static procfile *ff = NULL;
+
+	ff = open_file(ff, f, 1);
+
 	begin_tsc();
 	ff = procfile_readall1(ff);
 	unsigned long c = end_tsc();
@@ -305,25 +341,61 @@ unsigned long test_method1(void) {
 	return c;
 }
 
+// all methods should find the same lines and words
+void check_file(int f) {
+	procfile *ff1 = open_file(NULL, f, 0);
+	procfile *ff2 = open_file(NULL, f, 1);
+
+	ff1 = procfile_readall(ff1);
+	ff2 = procfile_readall1(ff2);
+	if(!ff1 || !ff2) {
+		fprintf(stderr, "Failed to read filename '%s'\n", files[f].filename);
+		exit(1);
+	}
+
+	size_t w, words = ff1->words->len;
+	int ok = (procfile_lines(ff1) == procfile_lines(ff2) && words == ff2->words->len);
+	for(w = 0; ok && w < words ; w++)
+		ok = !strcmp(procfile_word(ff1, w), procfile_word(ff2, w));
+
+	if(!ok)
+		fprintf(stderr, "WARNING: '%s' was parsed differently, or changed between the reads (%zu lines, %zu words vs %zu lines, %zu words)\n"
+				, files[f].filename, procfile_lines(ff1), ff1->words->len, procfile_lines(ff2), ff2->words->len);
+
+	procfile_close(ff1);
+	procfile_close(ff2);
+}
+
 //--- Test
 int main(int argc, char **argv)
 {
 	(void)argc; (void)argv;
 
-	int i, max = 1000000;
+	int f, i, max = 100000;
 
-	unsigned long c1 = 0;
-	test_netdata_internal();
-	for(i = 0; i < max ; i++)
-		c1 += test_netdata_internal();
+	for(f = 0; files[f].filename ; f++) {
+		check_file(f);
 
-	unsigned long c2 = 0;
-	test_method1();
-	for(i = 0; i < max ; i++)
-		c2 += test_method1();
+		unsigned long c1 = 0;
+		test_netdata_internal(f);
+		for(i = 0; i < max ; i++)
+			c1 += test_netdata_internal(f);
 
-	printf("netdata internal: completed in %lu cycles, %lu cycles per read, %0.2f %%.\n", c1, c1 / max, (float)c1 * 100.0 / (float)c1);
-	printf("method1         : completed in %lu cycles, %lu cycles per read, %0.2f %%.\n", c2, c2 / max, (float)c2 * 100.0 / (float)c1);
+		unsigned long c2 = 0;
+		test_netdata_byte_by_byte(f);
+		for(i = 0; i < max ; i++)
+			c2 += test_netdata_byte_by_byte(f);
+
+		unsigned long c3 = 0;
+		test_method1(f);
+		for(i = 0; i < max ; i++)
+			c3 += test_method1(f);
+
+		printf("%s:\n", files[f].filename);
+		printf("netdata internal: completed in %lu cycles, %lu cycles per read, %0.2f %%.\n", c1, c1 / max, (float)c1 * 100.0 / (float)c1);
+		printf("byte by byte    : completed in %lu cycles, %lu cycles per read, %0.2f %%.\n", c2, c2 / max, (float)c2 * 100.0 / (float)c1);
+		printf("method1         : completed in %lu cycles, %lu cycles per read, %0.2f %%.\n", c3, c3 / max, (float)c3 * 100.0 / (float)c1);
+	}
 
 	return 0;
 }
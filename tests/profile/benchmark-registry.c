@@ -1,227 +1,183 @@
 /* SPDX-License-Identifier: GPL-3.0-or-later */
 
 /*
- * compile with
- *  gcc -O1 -ggdb -Wall -Wextra -I ../src/ -I ../ -o benchmark-registry benchmark-registry.c ../src/dictionary.o ../src/log.o ../src/avl.o ../src/common.o ../src/appconfig.o ../src/web_buffer.o ../src/storage_number.o ../src/rrd.o ../src/health.o -pthread -luuid -lm -DHAVE_CONFIG_H -DVARLIB_DIR="\"/tmp\""
+ * 1. build netdata (as normally)
+ * 2. cd tests/profile/
+ * 3. make benchmark-registry
+ * 4. ./benchmark-registry [persons] [min lookups per second] [max bytes per person]
+ *
+ * It fills a registry with persons accessing machines, like a central
+ * registry does, and reports the rate of the lookups, the memory used per
+ * person and the time to save and load the database. When the limits are
+ * given, it exits with 1 if the registry is slower or bigger than them,
+ * so that it can be used to catch regressions.
  */
 
-char *hostname = "me";
-
-#include "../src/registry.c"
+#include "config.h"
+#include "../../registry/registry_internals.c"
+#include "../../registry/registry_arena.c"
+#include "../../registry/registry_url.c"
+#include "../../registry/registry_machine.c"
+#include "../../registry/registry_person.c"
+#include "../../registry/registry_log.c"
+#include "../../registry/registry_db.c"
 
 void netdata_cleanup_and_exit(int ret) { exit(ret); }
 
-// ----------------------------------------------------------------------------
-// TESTS
-
-int test1(int argc, char **argv) {
-
-	void print_stats(uint32_t requests, unsigned long long start, unsigned long long end) {
-		fprintf(stderr, " > SPEED: %u requests served in %0.2f seconds ( >>> %llu per second <<< )\n",
-				requests, (end-start) / 1000000.0, (unsigned long long)requests * 1000000ULL / (end-start));
-
-		fprintf(stderr, " > DB   : persons %llu, machines %llu, unique URLs %llu, accesses %llu, URLs: for persons %llu, for machines %llu\n",
-				registry.persons_count, registry.machines_count, registry.urls_count, registry.usages_count,
-				registry.persons_urls_count, registry.machines_urls_count);
-	}
-
-	(void) argc;
-	(void) argv;
+static unsigned long long benchmark_registry_memory(void) {
+	return registry_arena_memory(&registry.persons_arena) + registry_index_memory(&registry.persons)
+	       + registry_arena_memory(&registry.machines_arena) + registry_index_memory(&registry.machines)
+	       + registry.urls_memory + registry_index_memory(&registry.urls)
+	       + registry_arena_memory(&registry.persons_urls_arena) + registry_index_memory(&registry.persons_urls)
+	       + registry_arena_memory(&registry.machines_urls_arena) + registry_index_memory(&registry.machines_urls)
+	       + string_pool_memory();
+}
 
-	uint32_t u, users = 1000000;
-	uint32_t m, machines = 200000;
-	uint32_t machines2 = machines * 2;
+static void benchmark_registry_init(const char *db_filename, const char *log_filename) {
+	memset(&registry, 0, sizeof(registry));
+
+	registry.enabled = 1;
+	registry.max_url_length = 1024;
+	registry.max_name_length = 50;
+	registry.save_registry_every_entries = 1000000000ULL;
+	registry.db_filename = strdupz(db_filename);
+	registry.log_filename = strdupz(log_filename);
+
+	hash_index_init(&registry.persons, registry_person_equal);
+	hash_index_init(&registry.machines, registry_machine_equal);
+	hash_index_init(&registry.urls, registry_url_equal);
+	hash_index_init(&registry.persons_urls, registry_person_url_equal);
+	hash_index_init(&registry.machines_urls, registry_machine_url_equal);
+
+	registry_arena_init(&registry.persons_arena, "persons", sizeof(REGISTRY_PERSON));
+	registry_arena_init(&registry.machines_arena, "machines", sizeof(REGISTRY_MACHINE));
+	registry_arena_init(&registry.persons_urls_arena, "persons urls", sizeof(REGISTRY_PERSON_URL));
+	registry_arena_init(&registry.machines_urls_arena, "machines urls", sizeof(REGISTRY_MACHINE_URL));
+}
 
-	char **users_guids = malloc(users * sizeof(char *));
-	char **machines_guids = malloc(machines2 * sizeof(char *));
-	char **machines_urls = malloc(machines2 * sizeof(char *));
-	unsigned long long start;
+static void print_stats(const char *what, size_t requests, usec_t start, usec_t end) {
+	if(end == start) end++;
 
-	registry_init();
+	fprintf(stderr, " > %s: %zu in %0.2f seconds ( >>> %llu per second <<< )\n",
+			what, requests, (end - start) / 1000000.0, (unsigned long long)requests * 1000000ULL / (end - start));
+}
 
-	fprintf(stderr, "Generating %u machine guids\n", machines2);
-	for(m = 0; m < machines2 ;m++) {
+int main(int argc, char **argv) {
+	size_t persons = 200000, machines, urls_per_person = 5, i, j;
+	unsigned long long min_lookups = 0, max_bytes_per_person = 0;
+	char db_filename[FILENAME_MAX + 1], log_filename[FILENAME_MAX + 1], old_filename[FILENAME_MAX + 1];
+	int ret = 0;
+
+	if(argc > 1) persons = strtoul(argv[1], NULL, 0);
+	if(argc > 2) min_lookups = strtoull(argv[2], NULL, 0);
+	if(argc > 3) max_bytes_per_person = strtoull(argv[3], NULL, 0);
+	if(persons < 10) persons = 10;
+	machines = persons / 10;
+
+	snprintfz(db_filename, FILENAME_MAX, "/tmp/benchmark-registry-%d.db", getpid());
+	snprintfz(old_filename, FILENAME_MAX, "%s.old", db_filename);
+	snprintfz(log_filename, FILENAME_MAX, "/tmp/benchmark-registry-%d.log", getpid());
+	benchmark_registry_init(db_filename, log_filename);
+
+	// ------------------------------------------------------------------------
+
+	fprintf(stderr, "Generating %zu machine guids and urls\n", machines);
+	char **machines_guids = mallocz(machines * sizeof(char *));
+	char **machines_urls = mallocz(machines * sizeof(char *));
+	for(i = 0; i < machines ; i++) {
 		uuid_t uuid;
-		machines_guids[m] = malloc(36+1);
+		machines_guids[i] = mallocz(GUID_LEN + 1);
 		uuid_generate(uuid);
-		uuid_unparse(uuid, machines_guids[m]);
+		uuid_unparse_lower(uuid, machines_guids[i]);
 
 		char buf[FILENAME_MAX + 1];
-		snprintfz(buf, FILENAME_MAX, "http://%u.netdata.rocks/", m+1);
-		machines_urls[m] = strdup(buf);
-
-		// fprintf(stderr, "\tmachine %u: '%s', url: '%s'\n", m + 1, machines_guids[m], machines_urls[m]);
+		snprintfz(buf, FILENAME_MAX, "http://%zu.netdata.rocks:19999/", i + 1);
+		machines_urls[i] = strdupz(buf);
 	}
 
-	start = timems();
-	fprintf(stderr, "\nGenerating %u users accessing %u machines\n", users, machines);
-	m = 0;
-	time_t now = time(NULL);
-	for(u = 0; u < users ; u++) {
-		if(++m == machines) m = 0;
+	char **persons_guids = mallocz(persons * sizeof(char *));
+	time_t now = now_realtime_sec();
 
-		PERSON *p = registry_request_access(NULL, machines_guids[m], machines_urls[m], "test", now);
-		users_guids[u] = p->guid;
-	}
-	print_stats(u, start, timems());
+	fprintf(stderr, "\n%zu new persons accessing %zu machines each\n", persons, urls_per_person);
+	usec_t start = now_monotonic_usec();
+	for(i = 0; i < persons ; i++) {
+		REGISTRY_PERSON *p = NULL;
 
-	start = timems();
-	fprintf(stderr, "\nAll %u users accessing again the same %u servers\n", users, machines);
-	m = 0;
-	now = time(NULL);
-	for(u = 0; u < users ; u++) {
-		if(++m == machines) m = 0;
+		for(j = 0; j < urls_per_person ; j++) {
+			size_t m = (size_t)random() % machines;
+			char name[100 + 1];
+			snprintfz(name, 100, "machine %zu", m % 1000);
 
-		PERSON *p = registry_request_access(users_guids[u], machines_guids[m], machines_urls[m], "test", now);
+			p = registry_request_access(p?p->guid:NULL, machines_guids[m], machines_urls[m], name, now);
+		}
 
-		if(p->guid != users_guids[u])
-			fprintf(stderr, "ERROR: expected to get user guid '%s' but git '%s'", users_guids[u], p->guid);
+		persons_guids[i] = p->guid;
 	}
-	print_stats(u, start, timems());
-
-	start = timems();
-	fprintf(stderr, "\nAll %u users accessing a new server, out of the %u servers\n", users, machines);
-	m = 1;
-	now = time(NULL);
-	for(u = 0; u < users ; u++) {
-		if(++m == machines) m = 0;
-
-		PERSON *p = registry_request_access(users_guids[u], machines_guids[m], machines_urls[m], "test", now);
-
-		if(p->guid != users_guids[u])
-			fprintf(stderr, "ERROR: expected to get user guid '%s' but git '%s'", users_guids[u], p->guid);
+	print_stats("accesses", persons * urls_per_person, start, now_monotonic_usec());
+
+	// ------------------------------------------------------------------------
+
+	fprintf(stderr, "\nLooking up random persons and their urls\n");
+	size_t lookups = persons * 10, found = 0;
+	start = now_monotonic_usec();
+	for(i = 0; i < lookups ; i++) {
+		size_t m = (size_t)random() % machines;
+		REGISTRY_PERSON *p = registry_person_find(persons_guids[(size_t)random() % persons]);
+		if(p && registry_person_url_index_find(p, machines_urls[m]))
+			found++;
 	}
-	print_stats(u, start, timems());
-
-	start = timems();
-	fprintf(stderr, "\n%u random users accessing a random server, out of the %u servers\n", users, machines);
-	now = time(NULL);
-	for(u = 0; u < users ; u++) {
-		uint32_t tu = random() * users / RAND_MAX;
-		uint32_t tm = random() * machines / RAND_MAX;
-
-		PERSON *p = registry_request_access(users_guids[tu], machines_guids[tm], machines_urls[tm], "test", now);
-
-		if(p->guid != users_guids[tu])
-			fprintf(stderr, "ERROR: expected to get user guid '%s' but git '%s'", users_guids[tu], p->guid);
+	usec_t end = now_monotonic_usec();
+	print_stats("lookups", lookups, start, end);
+	fprintf(stderr, " > %zu of them have accessed the url\n", found);
+
+	unsigned long long lookups_per_second = (unsigned long long)lookups * 1000000ULL / ((end > start)?(end - start):1);
+
+	// ------------------------------------------------------------------------
+
+	unsigned long long memory = benchmark_registry_memory();
+	unsigned long long bytes_per_person = memory / persons;
+	fprintf(stderr, "\nMEMORY: %llu bytes, %llu bytes per person"
+					"\n > persons %llu, machines %llu, unique URLs %llu, accesses %llu, URLs: for persons %llu, for machines %llu\n",
+			memory, bytes_per_person,
+			registry.persons_count, registry.machines_count, registry.urls_count, registry.usages_count,
+			registry.persons_urls_count, registry.machines_urls_count);
+
+	// ------------------------------------------------------------------------
+
+	fprintf(stderr, "\nSAVE\n");
+	registry.log_count = registry.save_registry_every_entries + 1;
+	start = now_monotonic_usec();
+	registry_db_save();
+	print_stats("persons saved (blocking the registry)", persons, start, now_monotonic_usec());
+	registry_db_save_check(1);
+	print_stats("persons saved (in the background)", persons, start, now_monotonic_usec());
+
+	fprintf(stderr, "\nLOAD\n");
+	benchmark_registry_init(db_filename, log_filename);
+	start = now_monotonic_usec();
+	size_t records = registry_db_load();
+	print_stats("records loaded", records, start, now_monotonic_usec());
+
+	if(registry.persons.entries != persons) {
+		fprintf(stderr, "ERROR: loaded %zu persons, expected %zu\n", registry.persons.entries, persons);
+		ret = 1;
 	}
-	print_stats(u, start, timems());
 
-	start = timems();
-	fprintf(stderr, "\n%u random users accessing a random server, out of %u servers\n", users, machines2);
-	now = time(NULL);
-	for(u = 0; u < users ; u++) {
-		uint32_t tu = random() * users / RAND_MAX;
-		uint32_t tm = random() * machines2 / RAND_MAX;
+	unlink(db_filename);
+	unlink(old_filename);
+	unlink(log_filename);
 
-		PERSON *p = registry_request_access(users_guids[tu], machines_guids[tm], machines_urls[tm], "test", now);
+	// ------------------------------------------------------------------------
 
-		if(p->guid != users_guids[tu])
-			fprintf(stderr, "ERROR: expected to get user guid '%s' but git '%s'", users_guids[tu], p->guid);
-	}
-	print_stats(u, start, timems());
-
-	for(m = 0; m < 10; m++) {
-		start = timems();
-		fprintf(stderr,
-				"\n%u random user accesses to a random server, out of %u servers,\n > using 1/10000 with a random url, 1/1000 with a mismatched url\n",
-				users * 2, machines2);
-		now = time(NULL);
-		for (u = 0; u < users * 2; u++) {
-			uint32_t tu = random() * users / RAND_MAX;
-			uint32_t tm = random() * machines2 / RAND_MAX;
-
-			char *url = machines_urls[tm];
-			char buf[FILENAME_MAX + 1];
-			if (random() % 10000 == 1234) {
-				snprintfz(buf, FILENAME_MAX, "http://random.%ld.netdata.rocks/", random());
-				url = buf;
-			}
-			else if (random() % 1000 == 123)
-				url = machines_urls[random() * machines2 / RAND_MAX];
-
-			PERSON *p = registry_request_access(users_guids[tu], machines_guids[tm], url, "test", now);
-
-			if (p->guid != users_guids[tu])
-				fprintf(stderr, "ERROR: expected to get user guid '%s' but git '%s'", users_guids[tu], p->guid);
-		}
-		print_stats(u, start, timems());
+	if(min_lookups && lookups_per_second < min_lookups) {
+		fprintf(stderr, "\nFAILED: %llu lookups per second, expected at least %llu\n", lookups_per_second, min_lookups);
+		ret = 1;
 	}
 
-	fprintf(stderr, "\n\nSAVE\n");
-	start = timems();
-	registry_save();
-	print_stats(registry.persons_count, start, timems());
-
-	fprintf(stderr, "\n\nCLEANUP\n");
-	start = timems();
-	registry_free();
-	print_stats(registry.persons_count, start, timems());
-	return 0;
-}
-
-// ----------------------------------------------------------------------------
-// TESTING
-
-int main(int argc, char **argv) {
-	config_set_boolean("registry", "enabled", 1);
-
-	//debug_flags = 0xFFFFFFFF;
-	test1(argc, argv);
-	exit(0);
-
-	(void)argc;
-	(void)argv;
-
-
-	PERSON *p1, *p2;
-
-	fprintf(stderr, "\n\nINITIALIZATION\n");
-
-	registry_init();
-
-	int i = 2;
-
-	fprintf(stderr, "\n\nADDING ENTRY\n");
-	p1 = registry_request_access("2c95abd0-1542-11e6-8c66-00508db7e9c9", "7c173980-145c-11e6-b86f-00508db7e9c1", "http://localhost:19999/", "test", time(NULL));
-
-	if(0)
-	while(i--) {
-#ifdef REGISTRY_STDOUT_DUMP
-		fprintf(stderr, "\n\nADDING ENTRY\n");
-#endif /* REGISTRY_STDOUT_DUMP */
-		p1 = registry_request_access(NULL, "7c173980-145c-11e6-b86f-00508db7e9c1", "http://localhost:19999/", "test", time(NULL));
-
-#ifdef REGISTRY_STDOUT_DUMP
-		fprintf(stderr, "\n\nADDING ANOTHER URL\n");
-#endif /* REGISTRY_STDOUT_DUMP */
-		p1 = registry_request_access(p1->guid, "7c173980-145c-11e6-b86f-00508db7e9c1", "http://127.0.0.1:19999/", "test", time(NULL));
-
-#ifdef REGISTRY_STDOUT_DUMP
-		fprintf(stderr, "\n\nADDING ANOTHER URL\n");
-#endif /* REGISTRY_STDOUT_DUMP */
-		p1 = registry_request_access(p1->guid, "7c173980-145c-11e6-b86f-00508db7e9c1", "http://my.server:19999/", "test", time(NULL));
-
-#ifdef REGISTRY_STDOUT_DUMP
-		fprintf(stderr, "\n\nADDING ANOTHER MACHINE\n");
-#endif /* REGISTRY_STDOUT_DUMP */
-		p1 = registry_request_access(p1->guid, "7c173980-145c-11e6-b86f-00508db7e9c1", "http://my.server:19999/", "test", time(NULL));
-
-#ifdef REGISTRY_STDOUT_DUMP
-		fprintf(stderr, "\n\nADDING ANOTHER PERSON\n");
-#endif /* REGISTRY_STDOUT_DUMP */
-		p2 = registry_request_access(NULL, "7c173980-145c-11e6-b86f-00508db7e9c3", "http://localhost:19999/", "test", time(NULL));
-
-#ifdef REGISTRY_STDOUT_DUMP
-		fprintf(stderr, "\n\nADDING ANOTHER MACHINE\n");
-#endif /* REGISTRY_STDOUT_DUMP */
-		p2 = registry_request_access(p2->guid, "7c173980-145c-11e6-b86f-00508db7e9c3", "http://localhost:19999/", "test", time(NULL));
+	if(max_bytes_per_person && bytes_per_person > max_bytes_per_person) {
+		fprintf(stderr, "\nFAILED: %llu bytes per person, expected at most %llu\n", bytes_per_person, max_bytes_per_person);
+		ret = 1;
 	}
 
-	fprintf(stderr, "\n\nSAVE\n");
-	registry_save();
-
-	fprintf(stderr, "\n\nCLEANUP\n");
-	registry_free();
-	return 0;
+	return ret;
 }
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * 1. build netdata (as normally)
+ * 2. cd tests/profile/
+ * 3. make benchmark-simple-pattern
+ * 4. ./benchmark-simple-pattern [patterns] [strings]
+ *
+ * It matches chart ids against a list of simple patterns, like the ones of
+ * the backends and streaming configuration, once with the compiled list and
+ * once testing its patterns one by one, left to right (the way netdata
+ * matched them before they were compiled), and checks that both agree.
+ *
+ */
+
+#include "config.h"
+#include "libnetdata/libnetdata.h"
+
+void netdata_cleanup_and_exit(int ret) { exit(ret); }
+
+static const char *words[] = {
+		"apps", "users", "groups", "system", "disk", "net", "cpu", "mem", "eth0", "sda", "nginx",
+		"web_log", "cgroup", "docker", "ipv4", "ipv6", "io", "ops", "bad", "util", "tcp", "udp"
+};
+#define WORDS (sizeof(words) / sizeof(words[0]))
+
+static void random_name(char *buf, size_t size) {
+	size_t i, parts = 1 + (size_t)random() % 3;
+	buf[0] = '\0';
+
+	for(i = 0; i < parts ; i++) {
+		if(i) strncat(buf, (random() % 2) ? "." : "_", size - strlen(buf) - 1);
+		strncat(buf, words[(size_t)random() % WORDS], size - strlen(buf) - 1);
+	}
+}
+
+static void random_pattern(char *buf, size_t size) {
+	char name[100 + 1];
+	random_name(name, 100);
+
+	switch(random() % 6) {
+		case 0: snprintfz(buf, size - 1, "%s", name); break;
+		case 1: snprintfz(buf, size - 1, "%s*", name); break;
+		case 2: snprintfz(buf, size - 1, "*%s", name); break;
+		case 3: snprintfz(buf, size - 1, "*%s*", name); break;
+		case 4: snprintfz(buf, size - 1, "%s*%s", name, words[(size_t)random() % WORDS]); break;
+		default: snprintfz(buf, size - 1, "!%s*", name); break;
+	}
+}
+
+static void print_stats(const char *what, size_t count, usec_t start, usec_t end) {
+	if(end == start) end++;
+	fprintf(stderr, " > %-30s %llu per second\n", what, (unsigned long long)count * USEC_PER_SEC / (end - start));
+}
+
+int main(int argc, char **argv) {
+	size_t patterns = 50, strings = 100000, i, j;
+
+	if(argc > 1) patterns = strtoul(argv[1], NULL, 0);
+	if(argc > 2) strings = strtoul(argv[2], NULL, 0);
+	if(patterns < 1) patterns = 1;
+	if(strings < 1) strings = 1;
+
+	// the list, and each of its patterns alone
+	BUFFER *list = buffer_create(patterns * 30);
+	SIMPLE_PATTERN **single = mallocz(patterns * sizeof(SIMPLE_PATTERN *));
+	int *negative = mallocz(patterns * sizeof(int));
+	for(i = 0; i < patterns ; i++) {
+		char pattern[200 + 1];
+		random_pattern(pattern, 200);
+
+		if(i) buffer_strcat(list, " ");
+		buffer_strcat(list, pattern);
+
+		negative[i] = (pattern[0] == '!');
+		single[i] = simple_pattern_create(negative[i] ? &pattern[1] : pattern, NULL, SIMPLE_PATTERN_EXACT);
+	}
+	SIMPLE_PATTERN *compiled = simple_pattern_create(buffer_tostring(list), NULL, SIMPLE_PATTERN_EXACT);
+
+	char **names = mallocz(strings * sizeof(char *));
+	for(i = 0; i < strings ; i++) {
+		char name[100 + 1];
+		random_name(name, 100);
+		names[i] = strdupz(name);
+	}
+
+	fprintf(stderr, "%zu patterns, %zu strings\n", patterns, strings);
+
+	// ------------------------------------------------------------------------
+
+	size_t matched_single = 0, matched_compiled = 0, errors = 0;
+	int *results = mallocz(strings * sizeof(int));
+
+	usec_t start = now_monotonic_usec();
+	for(i = 0; i < strings ; i++) {
+		results[i] = 0;
+		for(j = 0; j < patterns ; j++) {
+			if(simple_pattern_matches(single[j], names[i])) {
+				results[i] = !negative[j];
+				break;
+			}
+		}
+		matched_single += results[i];
+	}
+	print_stats("one by one", strings, start, now_monotonic_usec());
+
+	start = now_monotonic_usec();
+	for(i = 0; i < strings ; i++) {
+		int r = simple_pattern_matches(compiled, names[i]);
+		if(r != results[i]) errors++;
+		matched_compiled += r;
+	}
+	print_stats("compiled", strings, start, now_monotonic_usec());
+
+	// the parts matched by the asterisks have to be the same too
+	for(i = 0; i < strings ; i++) {
+		char ws[100 + 1], wc[100 + 1];
+
+		for(j = 0; j < patterns ; j++)
+			if(simple_pattern_matches_extract(single[j], names[i], ws, 100)) break;
+
+		if(simple_pattern_matches_extract(compiled, names[i], wc, 100) && j < patterns && strcmp(ws, wc))
+			errors++;
+	}
+
+	fprintf(stderr, "\nmatched %zu one by one, %zu compiled, %zu errors\n", matched_single, matched_compiled, errors);
+
+	// ------------------------------------------------------------------------
+
+	for(i = 0; i < strings ; i++) freez(names[i]);
+	for(i = 0; i < patterns ; i++) simple_pattern_free(single[i]);
+	simple_pattern_free(compiled);
+	buffer_free(list);
+	freez(results);
+	freez(negative);
+	freez(single);
+	freez(names);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * Measures the nanoseconds per value of packing and unpacking storage numbers,
+ * the table driven and the bulk functions of libnetdata against the loops they replaced.
+ *
+ * 1. build netdata (as normally)
+ * 2. cd tests/profile/
+ * 3. make benchmark-storage-number
+ *
+ */
+
+#include "config.h"
+#include "libnetdata/libnetdata.h"
+
+void netdata_cleanup_and_exit(int ret) {
+    exit(ret);
+}
+
+#define ENTRIES (1024 * 1024)
+#define ROUNDS 20
+
+// ----------------------------------------------------------------------------
+// the loops of pack_storage_number() and unpack_storage_number() before they were table driven
+
+static storage_number loop_pack_storage_number(calculated_number value, uint32_t flags) {
+    // bit 32 = sign 0:positive, 1:negative
+    // bit 31 = 0:divide, 1:multiply
+    // bit 30, 29, 28 = (multiplier or divider) 0-7 (8 total)
+    // bit 27 SN_EXISTS_100
+    // bit 26 SN_EXISTS_RESET
+    // bit 25 SN_EXISTS
+    // bit 24 to bit 1 = the value
+
+    storage_number r = get_storage_number_flags(flags);
+    if(!value) return r;
+
+    int m = 0;
+    calculated_number n = value, factor = 10;
+
+    // if the value is negative
+    // add the sign bit and make it positive
+    if(n < 0) {
+        r += (1 << 31); // the sign bit 32
+        n = -n;
+    }
+
+    if(n / 10000000.0 > 0x00ffffff) {
+        factor = 100;
+        r |= SN_EXISTS_100;
+    }
+
+    // make its integer part fit in 0x00ffffff
+    // by dividing it by 10 up to 7 times
+    // and increasing the multiplier
+    while(m < 7 && n > (calculated_number)0x00ffffff) {
+        n /= factor;
+        m++;
+    }
+
+    if(m) {
+        // the value was too big and we divided it
+        // so we add a multiplier to unpack it
+        r += (1 << 30) + (m << 27); // the multiplier m
+
+        if(n > (calculated_number)0x00ffffff) {
+            #ifdef NETDATA_INTERNAL_CHECKS
+            error("Number " CALCULATED_NUMBER_FORMAT " is too big.", value);
+            #endif
+            r += 0x00ffffff;
+            return r;
+        }
+    }
+    else {
+        // 0x0019999e is the number that can be multiplied
+        // by 10 to give 0x00ffffff
+        // while the value is below 0x0019999e we can
+        // multiply it by 10, up to 7 times, increasing
+        // the multiplier
+        while(m < 7 && n < (calculated_number)0x0019999e) {
+            n *= 10;
+            m++;
+        }
+
+        // the value was small enough and we multiplied it
+        // so we add a divider to unpack it
+        r += (0 << 30) + (m << 27); // the divider m
+    }
+
+#ifdef STORAGE_WITH_MATH
+    // without this there are rounding problems
+    // example: 0.9 becomes 0.89
+    r += lrint((double) n);
+#else
+    r += (storage_number)n;
+#endif
+
+    return r;
+}
+
+static calculated_number loop_unpack_storage_number(storage_number value) {
+    if(!value) return 0;
+
+    int sign = 0, exp = 0;
+    int factor = 10;
+
+    // bit 32 = 0:positive, 1:negative
+    if(unlikely(value & (1 << 31)))
+        sign = 1;
+
+    // bit 31 = 0:divide, 1:multiply
+    if(unlikely(value & (1 << 30)))
+        exp = 1;
+
+    // bit 27 SN_EXISTS_100
+    if(unlikely(value & (1 << 26)))
+        factor = 100;
+
+    // bit 26 SN_EXISTS_RESET
+    // bit 25 SN_EXISTS
+
+    // bit 30, 29, 28 = (multiplier or divider) 0-7 (8 total)
+    int mul = (value & ((1<<29)|(1<<28)|(1<<27))) >> 27;
+
+    // bit 24 to bit 1 = the value, so remove all other bits
+    value ^= value & ((1<<31)|(1<<30)|(1<<29)|(1<<28)|(1<<27)|(1<<26)|(1<<25)|(1<<24));
+
+    calculated_number n = value;
+
+
+    if(exp) {
+        for(; mul; mul--)
+            n *= factor;
+    }
+    else {
+        for( ; mul ; mul--)
+            n /= 10;
+    }
+
+    if(sign) n = -n;
+    return n;
+}
+
+// ----------------------------------------------------------------------------
+
+static double values[ENTRIES];
+static uint32_t flags[ENTRIES];
+static storage_number numbers[ENTRIES];
+static double unpacked[ENTRIES];
+
+static usec_t now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (usec_t)ts.tv_sec * USEC_PER_SEC + (usec_t)ts.tv_nsec / 1000;
+}
+
+static void report(const char *what, usec_t started, double checksum) {
+    usec_t dt = now_usec() - started;
+    fprintf(stderr, "%-40s %8.2f ns/value (checksum %0.3e)\n", what, (double)dt * 1000.0 / ((double)ENTRIES * ROUNDS), checksum);
+}
+
+int main(int argc, char **argv) {
+    if(argc || argv) {;}
+
+    size_t i, round;
+    usec_t started;
+    double checksum;
+    storage_number s;
+
+    srandom(1);
+    for(i = 0; i < ENTRIES ; i++) {
+        // values from 1e-7 to 1e20, like the ones collected
+        double magnitude = pow(10.0, (double)(random() % 28) - 7.0);
+        values[i] = (double)(random() % 100000000) / 10000000.0 * magnitude;
+        if(i % 3 == 0) values[i] = -values[i];
+        flags[i] = SN_EXISTS;
+    }
+
+    started = now_usec();
+    for(round = 0, s = 0; round < ROUNDS ; round++)
+        for(i = 0; i < ENTRIES ; i++)
+            s += numbers[i] = loop_pack_storage_number(values[i], flags[i]);
+    report("pack, loops", started, (double)s);
+
+    started = now_usec();
+    for(round = 0, s = 0; round < ROUNDS ; round++)
+        for(i = 0; i < ENTRIES ; i++)
+            s += numbers[i] = pack_storage_number(values[i], flags[i]);
+    report("pack_storage_number()", started, (double)s);
+
+    started = now_usec();
+    for(round = 0, s = 0; round < ROUNDS ; round++) {
+        pack_storage_numbers(values, flags, numbers, ENTRIES);
+        s += numbers[round];
+    }
+    report("pack_storage_numbers()", started, (double)s);
+
+    started = now_usec();
+    for(round = 0, checksum = 0; round < ROUNDS ; round++)
+        for(i = 0; i < ENTRIES ; i++)
+            checksum += (double)loop_unpack_storage_number(numbers[i]);
+    report("unpack, loops", started, checksum);
+
+    started = now_usec();
+    for(round = 0, checksum = 0; round < ROUNDS ; round++)
+        for(i = 0; i < ENTRIES ; i++)
+            checksum += (double)unpack_storage_number(numbers[i]);
+    report("unpack_storage_number()", started, checksum);
+
+    started = now_usec();
+    for(round = 0, checksum = 0; round < ROUNDS ; round++) {
+        // page sized batches, like the DB engine
+        for(i = 0; i < ENTRIES ; i += 1024)
+            unpack_storage_number_array(&numbers[i], &unpacked[i], 1024);
+        checksum += unpacked[round];
+    }
+    report("unpack_storage_number_array()", started, checksum);
+
+    started = now_usec();
+    for(round = 0, checksum = 0; round < ROUNDS ; round++) {
+        // query sized blocks, with the flags
+        int reset;
+        for(i = 0; i < ENTRIES ; i += 128)
+            checksum += (double)unpack_storage_number_query_array(&numbers[i], &unpacked[i], 128, &reset);
+    }
+    report("unpack_storage_number_query_array()", started, checksum);
+
+    for(i = 0, s = 0; i < ENTRIES ; i++)
+        if(loop_unpack_storage_number(numbers[i]) != unpack_storage_number(numbers[i])) s++;
+    fprintf(stderr, "%u of %d values unpack differently than the loops\n", s, ENTRIES);
+
+    return 0;
+}
@@ -85,6 +85,9 @@ unsigned long long values6[50] = { 0 };
 unsigned long long values7[50] = { 0 };
 unsigned long long values8[50] = { 0 };
 unsigned long long values9[50] = { 0 };
+unsigned long long values10[50] = { 0 };
+unsigned long long values11[50] = { 0 };
+unsigned long long values12[50] = { 0 };
 
 struct pair {
     const char *name;
@@ -440,6 +443,93 @@ void test7() {
         if(arl_check(base, pairs[i].name, pairs[i].value)) break;
 }
 
+void test10() {
+    static ARL_BASE *base = NULL;
+
+    if(unlikely(!base)) {
+        base = arl_create_perfect_hash("test10", arl_str2ull, 60);
+        arl_expect_custom(base, "cache",       NULL, &values10[0]);
+        arl_expect_custom(base, "rss",         NULL, &values10[1]);
+        arl_expect_custom(base, "rss_huge",    NULL, &values10[2]);
+        arl_expect_custom(base, "mapped_file", NULL, &values10[3]);
+        arl_expect_custom(base, "writeback",   NULL, &values10[4]);
+        arl_expect_custom(base, "dirty",       NULL, &values10[5]);
+        arl_expect_custom(base, "swap",        NULL, &values10[6]);
+        arl_expect_custom(base, "pgpgin",      NULL, &values10[7]);
+        arl_expect_custom(base, "pgpgout",     NULL, &values10[8]);
+        arl_expect_custom(base, "pgfault",     NULL, &values10[9]);
+        arl_expect_custom(base, "pgmajfault",  NULL, &values10[10]);
+    }
+
+    arl_begin(base);
+
+    int i;
+    for(i = 0; pairs[i].name ; i++)
+        if(arl_check(base, pairs[i].name, pairs[i].value)) break;
+}
+
+// the source data in the reverse order, every other iteration
+static size_t pairs_count = 0;
+
+static inline void check_alternating(ARL_BASE *base, size_t iteration) {
+    size_t i;
+
+    if(iteration % 2) {
+        for(i = 0; i < pairs_count ; i++)
+            if(arl_check(base, pairs[i].name, pairs[i].value)) break;
+    }
+    else {
+        for(i = pairs_count; i > 0 ; i--)
+            if(arl_check(base, pairs[i - 1].name, pairs[i - 1].value)) break;
+    }
+}
+
+void test11() {
+    static ARL_BASE *base = NULL;
+    static size_t iteration = 0;
+
+    if(unlikely(!base)) {
+        base = arl_create("test11", arl_str2ull, 60);
+        arl_expect_custom(base, "cache",       NULL, &values11[0]);
+        arl_expect_custom(base, "rss",         NULL, &values11[1]);
+        arl_expect_custom(base, "rss_huge",    NULL, &values11[2]);
+        arl_expect_custom(base, "mapped_file", NULL, &values11[3]);
+        arl_expect_custom(base, "writeback",   NULL, &values11[4]);
+        arl_expect_custom(base, "dirty",       NULL, &values11[5]);
+        arl_expect_custom(base, "swap",        NULL, &values11[6]);
+        arl_expect_custom(base, "pgpgin",      NULL, &values11[7]);
+        arl_expect_custom(base, "pgpgout",     NULL, &values11[8]);
+        arl_expect_custom(base, "pgfault",     NULL, &values11[9]);
+        arl_expect_custom(base, "pgmajfault",  NULL, &values11[10]);
+    }
+
+    arl_begin(base);
+    check_alternating(base, iteration++);
+}
+
+void test12() {
+    static ARL_BASE *base = NULL;
+    static size_t iteration = 0;
+
+    if(unlikely(!base)) {
+        base = arl_create_perfect_hash("test12", arl_str2ull, 60);
+        arl_expect_custom(base, "cache",       NULL, &values12[0]);
+        arl_expect_custom(base, "rss",         NULL, &values12[1]);
+        arl_expect_custom(base, "rss_huge",    NULL, &values12[2]);
+        arl_expect_custom(base, "mapped_file", NULL, &values12[3]);
+        arl_expect_custom(base, "writeback",   NULL, &values12[4]);
+        arl_expect_custom(base, "dirty",       NULL, &values12[5]);
+        arl_expect_custom(base, "swap",        NULL, &values12[6]);
+        arl_expect_custom(base, "pgpgin",      NULL, &values12[7]);
+        arl_expect_custom(base, "pgpgout",     NULL, &values12[8]);
+        arl_expect_custom(base, "pgfault",     NULL, &values12[9]);
+        arl_expect_custom(base, "pgmajfault",  NULL, &values12[10]);
+    }
+
+    arl_begin(base);
+    check_alternating(base, iteration++);
+}
+
 void test8() {
     int i;
     for(i = 0; pairs[i].name; i++) {
@@ -515,6 +605,7 @@ int main(void)
         int i;
         for(i = 0; pairs[i].name; i++)
             pairs[i].hash = simple_hash(pairs[i].name);
+        pairs_count = (size_t)i;
     }
 
     cache_hash = simple_hash("cache");
@@ -556,7 +647,7 @@ int main(void)
     (void)strcmp("1", "2");
     (void)strtoull("123", NULL, 0);
 
-  unsigned long i, c1 = 0, c2 = 0, c3 = 0, c4 = 0, c5 = 0, c6 = 0, c7 = 0, c8 = 0, c9 = 0;
+  unsigned long i, c1 = 0, c2 = 0, c3 = 0, c4 = 0, c5 = 0, c6 = 0, c7 = 0, c8 = 0, c9 = 0, c10 = 0, c11 = 0, c12 = 0;
   unsigned long max = 1000000;
 
   begin_clock();
@@ -595,8 +686,20 @@ int main(void)
     for(i = 0; i <= max ;i++) test9();
     c9 = end_clock();
 
+    begin_clock();
+    for(i = 0; i <= max ;i++) test10();
+    c10 = end_clock();
+
+    begin_clock();
+    for(i = 0; i <= max ;i++) test11();
+    c11 = end_clock();
+
+    begin_clock();
+    for(i = 0; i <= max ;i++) test12();
+    c12 = end_clock();
+
     for(i = 0; i < 11 ; i++)
-        printf("value %lu: %llu %llu %llu %llu %llu %llu %llu %llu %llu\n", i, values1[i], values2[i], values3[i], values4[i], values5[i], values6[i], values7[i], values8[i], values9[i]);
+        printf("value %lu: %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n", i, values1[i], values2[i], values3[i], values4[i], values5[i], values6[i], values7[i], values8[i], values9[i], values10[i], values11[i], values12[i]);
   
   printf("\n\nRESULTS\n");
   printf("test1() [1] in %lu usecs: simple system strcmp().\n"
@@ -608,6 +711,9 @@ int main(void)
          "test7() [9] in %lu usecs: adaptive re-sortable array with str2ull() (wow!)\n"
          "test8() [2] in %lu usecs: nested loop with strtoull()\n"
          "test9() [3] in %lu usecs: nested loop with str2ull()\n"
+         "test10() in %lu usecs: perfect hash ARL with str2ull()\n"
+         "test11() in %lu usecs: adaptive re-sortable array with str2ull(), source order changing on every iteration\n"
+         "test12() in %lu usecs: perfect hash ARL with str2ull(), source order changing on every iteration\n"
          , c1
          , c2
          , c3
@@ -617,6 +723,9 @@ int main(void)
          , c7
          , c8
          , c9
+         , c10
+         , c11
+         , c12
          );
 
   return 0;
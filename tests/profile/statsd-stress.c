@@ -18,6 +18,7 @@ void diep(char *s)
 
 size_t run_threads = 1;
 size_t metrics = 1024;
+size_t lines_per_packet = 1;
 
 #define SERVER_IP "127.0.0.1"
 #define PORT 8125
@@ -38,20 +39,24 @@ struct thread_data {
 	struct sockaddr_in *si_other;
 	int slen;
 	size_t counter;
+	size_t packets;
 };
 
 static void *report_thread(void *__data) {
 	struct thread_data *data = (struct thread_data *)__data;
 
-	size_t last = 0;
+	size_t last = 0, last_packets = 0;
 	for (;;) {
 		size_t i;
-		size_t total = 0;
-		for(i = 0; i < run_threads ;i++)
+		size_t total = 0, packets = 0;
+		for(i = 0; i < run_threads ;i++) {
 			total += data[i].counter;
+			packets += data[i].packets;
+		}
 
-		printf("%zu metrics/s\n", total-last);
+		printf("%zu lines/s, %zu packets/s\n", total-last, packets-last_packets);
 		last = total;
+		last_packets = packets;
 
 		sleep(1);
 		printf("\033[F\033[J");
@@ -67,45 +72,61 @@ static void *spam_thread(void *__data) {
 	struct thread_data *data = (struct thread_data *)__data;
 
 	int s;
-	char packet[1024];
+	char packet[1400];
 
 	if ((s = socket(AF_INET, SOCK_DGRAM, 0))==-1)
 		diep("socket");
 
+	// every packet has up to lines_per_packet lines, as many as fit in it
 	char **packets = malloc(sizeof(char *) * metrics);
-	size_t i, *lengths = malloc(sizeof(size_t) * metrics);
-	size_t t;
+	size_t i, *lengths = malloc(sizeof(size_t) * metrics), *lines = malloc(sizeof(size_t) * metrics);
+	size_t t, p;
+
+	for(i = 0, t = 0, p = 0; i < metrics ;p++) {
+		size_t len = 0, l;
+
+		for(l = 0; l < lines_per_packet && i < metrics ;l++, i++, t++) {
+			if(!types[t]) t = 0;
+			char *type = types[t];
 
-	for(i = 0, t = 0; i < metrics ;i++, t++) {
-		if(!types[t]) t = 0;
-		char *type = types[t];
+			char line[256];
+			int n = snprintf(line, sizeof(line), "%sstress.%s.t%zu.m%zu:%zu|%s", l ? "\n" : "", type, data->id, i, myrand(metrics), type);
+			if(l && len + n >= sizeof(packet)) break;
+
+			memcpy(&packet[len], line, n + 1);
+			len += n;
+		}
 
-		lengths[i] = sprintf(packet, "stress.%s.t%zu.m%zu:%zu|%s", type, data->id, i, myrand(metrics), type);
-		packets[i] = strdup(packet);
-		// printf("packet %zu, of length %zu: '%s'\n", i, lengths[i], packets[i]);
+		lengths[p] = len;
+		lines[p] = l;
+		packets[p] = strdup(packet);
+		// printf("packet %zu, of length %zu: '%s'\n", p, lengths[p], packets[p]);
 	}
 	//printf("\n");
 
+	size_t count = p;
 	for (;;) {
-		for(i = 0; i < metrics ;i++) {
-			if (sendto(s, packets[i], lengths[i], 0, (void *)data->si_other, data->slen) < 0) {
+		for(p = 0; p < count ;p++) {
+			if (sendto(s, packets[p], lengths[p], 0, (void *)data->si_other, data->slen) < 0) {
 				printf("C ==> DROPPED\n");
 				return NULL;
 			}
-			data->counter++;
+			data->counter += lines[p];
+			data->packets++;
 		}
 	}
 
 	free(packets);
 	free(lengths);
+	free(lines);
 	close(s);
 	return NULL;
 }
 
 int main(int argc, char *argv[])
 {
-	if (argc != 5) {
-		fprintf(stderr, "Usage: '%s THREADS METRICS IP PORT'\n", argv[0]);
+	if (argc != 5 && argc != 6) {
+		fprintf(stderr, "Usage: '%s THREADS METRICS IP PORT [LINES_PER_PACKET]'\n", argv[0]);
 		exit(-1);
 	}
 
@@ -113,6 +134,8 @@ int main(int argc, char *argv[])
 	metrics = atoi(argv[2]);
 	char *ip = argv[3];
 	int port = atoi(argv[4]);
+	if (argc == 6 && atoi(argv[5]) > 0)
+		lines_per_packet = atoi(argv[5]);
 
 	struct thread_data data[run_threads];
 	struct sockaddr_in si_other;
@@ -134,12 +157,14 @@ int main(int argc, char *argv[])
 		data[i].si_other = &si_other;
 		data[i].slen     = sizeof(si_other);
 		data[i].counter  = 0;
+		data[i].packets  = 0;
 		pthread_create(&threads[i], NULL, spam_thread, &data[i]);
 	}
 
 	printf("\n");
 	printf("THREADS     : %zu\n", run_threads);
 	printf("METRICS     : %zu\n", metrics);
+	printf("LINES/PACKET: %zu\n", lines_per_packet);
 	printf("DESTINATION : %s:%d\n", ip, port);
 	printf("\n");
 	pthread_create(&report, NULL, report_thread, &data);
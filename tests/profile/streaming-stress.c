@@ -0,0 +1,404 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * 1. configure the API_KEY in the stream.conf of the parent netdata
+ * 2. cd tests/profile/
+ * 3. make streaming-stress
+ * 4. ./streaming-stress API_KEY CHILDREN CHARTS DIMENSIONS IP PORT [THREADS] [RECONNECTS_PER_SECOND] [PARENT_PID]
+ *
+ * It connects CHILDREN netdata children to the parent, each streaming CHARTS charts of
+ * DIMENSIONS dimensions every second, with the text streaming protocol, the way the
+ * sender thread of a netdata does. Every second, RECONNECTS_PER_SECOND random children
+ * disconnect and connect again, and define all their charts again.
+ *
+ * Every second it prints the children connected, the connections and the metrics sent,
+ * and the lag of the parent: the seconds since the last value the parent has stored for
+ * the first chart of a random child. With the PARENT_PID of a parent running on the same
+ * machine, it prints also the CPU the parent spends per 1000 metrics and its memory per child.
+ *
+ */
+
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+void diep(char *s)
+{
+	perror(s);
+	exit(1);
+}
+
+char *api_key;
+size_t children = 1000;
+size_t charts = 10;
+size_t dimensions = 10;
+size_t run_threads = 4;
+size_t reconnects_per_second = 0;
+int parent_pid = 0;
+struct sockaddr_in server;
+
+struct child {
+	int fd;
+	size_t id;
+	char hostname[50];
+	char guid[37];
+	unsigned long long last_sent_ut;
+};
+
+struct thread_data {
+	size_t id;
+	struct child *children;          // every thread sends the metrics of every run_threads child
+	size_t connects;
+	size_t failures;
+	size_t metrics;
+};
+
+struct child *all_children;
+struct thread_data *threads_data;
+size_t connected;
+
+static unsigned long long now_usec(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (unsigned long long)tv.tv_sec * 1000000ULL + (unsigned long long)tv.tv_usec;
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+	while(len) {
+		ssize_t ret = send(fd, data, len, MSG_NOSIGNAL);
+		if(ret <= 0) {
+			if(ret == -1 && errno == EINTR) continue;
+			return -1;
+		}
+
+		data += ret;
+		len -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+static int connect_to_parent(void) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd == -1) return -1;
+
+	// a parent that does not read, does not block the thread for ever
+	struct timeval tv = { .tv_sec = 10, .tv_usec = 0 };
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	if(connect(fd, (struct sockaddr *)&server, sizeof(server)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// connects the child to the parent and defines its charts
+static int child_connect(struct child *c, char *buffer, size_t size) {
+	c->fd = connect_to_parent();
+	if(c->fd == -1) return -1;
+
+	int len = snprintf(buffer, size,
+			"STREAM key=%s&hostname=%s&registry_hostname=%s&machine_guid=%s&update_every=1&os=linux&timezone=UTC&tags=&ver=1 HTTP/1.1\r\n"
+			"User-Agent: streaming-stress/1.0\r\n"
+			"Accept: */*\r\n\r\n"
+			, api_key, c->hostname, c->hostname, c->guid);
+
+	ssize_t received = -1;
+	if(send_all(c->fd, buffer, (size_t)len) == 0)
+		received = recv(c->fd, buffer, size - 1, 0);
+
+	if(received <= 0 || strncmp(buffer, "Hit me baby, push them over", 27) != 0) {
+		if(received > 0) {
+			buffer[received] = '\0';
+			fprintf(stderr, "child %s: the parent replied '%s'\n", c->hostname, buffer);
+		}
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+
+	size_t ch, d;
+	len = 0;
+	for(ch = 0; ch < charts ; ch++) {
+		len += snprintf(&buffer[len], size - len,
+				"CHART \"stress.chart%zu\" \"\" \"Streaming Stress %zu\" \"value\" \"stress\" \"stress.chart\" \"line\" %zu 1 \"   \" \"streaming-stress\" \"\"\n"
+				, ch, ch, 1000 + ch);
+
+		for(d = 0; d < dimensions ; d++)
+			len += snprintf(&buffer[len], size - len, "DIMENSION \"dim%zu\" \"dim%zu\" \"absolute\" 1 1 \"  \"\n", d, d);
+
+		if(size - len < 1000 || ch == charts - 1) {
+			if(send_all(c->fd, buffer, (size_t)len) == -1) {
+				close(c->fd);
+				c->fd = -1;
+				return -1;
+			}
+			len = 0;
+		}
+	}
+
+	c->last_sent_ut = 0;
+	return 0;
+}
+
+static void child_disconnect(struct child *c) {
+	if(c->fd == -1) return;
+
+	close(c->fd);
+	c->fd = -1;
+	__atomic_sub_fetch(&connected, 1, __ATOMIC_RELAXED);
+}
+
+// sends the values of all the charts of the child
+static int child_send(struct child *c, char *buffer, size_t size, unsigned long long now_ut, size_t *metrics) {
+	unsigned long long usec = (c->last_sent_ut) ? now_ut - c->last_sent_ut : 0;
+	size_t ch, d;
+	int len = 0;
+
+	for(ch = 0; ch < charts ; ch++) {
+		len += snprintf(&buffer[len], size - len, "BEGIN \"stress.chart%zu\" %llu\n", ch, usec);
+
+		for(d = 0; d < dimensions ; d++)
+			len += snprintf(&buffer[len], size - len, "SET \"dim%zu\" = %llu\n", d, (now_ut / 1000000ULL + c->id + d) % 1000);
+
+		len += snprintf(&buffer[len], size - len, "END\n");
+
+		if(size - len < 1000 || ch == charts - 1) {
+			if(send_all(c->fd, buffer, (size_t)len) == -1)
+				return -1;
+			len = 0;
+		}
+	}
+
+	*metrics += charts * dimensions;
+	c->last_sent_ut = now_ut;
+	return 0;
+}
+
+static void *child_thread(void *__data) {
+	struct thread_data *data = (struct thread_data *)__data;
+	// a chart, with all its dimensions, fits in it
+	size_t size = 65536 + dimensions * 100, i;
+	char *buffer = malloc(size);
+
+	for(;;) {
+		unsigned long long now_ut = now_usec();
+
+		// the churn, this thread's share of it
+		size_t r = reconnects_per_second / run_threads + ((data->id < reconnects_per_second % run_threads) ? 1 : 0);
+		while(r--) {
+			i = data->id + ((size_t)rand() % children) / run_threads * run_threads;
+			if(i < children) child_disconnect(&all_children[i]);
+		}
+
+		for(i = data->id; i < children ; i += run_threads) {
+			struct child *c = &all_children[i];
+
+			if(c->fd == -1) {
+				if(child_connect(c, buffer, size) == -1) {
+					data->failures++;
+					continue;
+				}
+
+				data->connects++;
+				__atomic_add_fetch(&connected, 1, __ATOMIC_RELAXED);
+			}
+
+			if(child_send(c, buffer, size, now_usec(), &data->metrics) == -1) {
+				data->failures++;
+				child_disconnect(c);
+			}
+		}
+
+		// once per second
+		unsigned long long elapsed = now_usec() - now_ut;
+		if(elapsed < 1000000ULL)
+			usleep((useconds_t)(1000000ULL - elapsed));
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// the parent
+
+// the last time the parent has stored a value of the first chart of the child, or 0
+static long parent_last_entry(struct child *c) {
+	char buffer[65536 + 1];
+	int fd = connect_to_parent();
+	if(fd == -1) return 0;
+
+	int len = snprintf(buffer, sizeof(buffer), "GET /host/%s/api/v1/chart?chart=stress.chart0 HTTP/1.1\r\nHost: parent\r\nConnection: close\r\n\r\n", c->hostname);
+	size_t received = 0;
+
+	if(send_all(fd, buffer, (size_t)len) == 0) {
+		ssize_t ret;
+		while(received < sizeof(buffer) - 1 && (ret = recv(fd, &buffer[received], sizeof(buffer) - 1 - received, 0)) > 0)
+			received += (size_t)ret;
+	}
+	close(fd);
+	buffer[received] = '\0';
+
+	char *s = strstr(buffer, "\"last_entry\":");
+	return (s) ? strtol(&s[13], NULL, 10) : 0;
+}
+
+// the user and system CPU of the parent, in clock ticks
+static unsigned long long parent_cpu(void) {
+	char filename[100], buffer[4096 + 1];
+	snprintf(filename, sizeof(filename), "/proc/%d/stat", parent_pid);
+
+	FILE *fp = fopen(filename, "r");
+	if(!fp) return 0;
+	size_t len = fread(buffer, 1, sizeof(buffer) - 1, fp);
+	fclose(fp);
+	buffer[len] = '\0';
+
+	// the fields after the name, that may have spaces, utime and stime are the 12th and the 13th
+	char *s = strrchr(buffer, ')');
+	unsigned long long utime = 0, stime = 0;
+	if(s) sscanf(s + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime);
+	return utime + stime;
+}
+
+// the resident memory of the parent, in KiB
+static unsigned long long parent_rss(void) {
+	char filename[100], line[1024];
+	unsigned long long rss = 0;
+	snprintf(filename, sizeof(filename), "/proc/%d/status", parent_pid);
+
+	FILE *fp = fopen(filename, "r");
+	if(!fp) return 0;
+	while(fgets(line, sizeof(line), fp))
+		if(!strncmp(line, "VmRSS:", 6))
+			rss = strtoull(&line[6], NULL, 10);
+	fclose(fp);
+
+	return rss;
+}
+
+static void *report_thread(void *__data) {
+	(void)__data;
+
+	size_t last_metrics = 0, last_connects = 0;
+	unsigned long long last_cpu = parent_pid ? parent_cpu() : 0, rss_before = parent_pid ? parent_rss() : 0;
+	long ticks = sysconf(_SC_CLK_TCK);
+
+	for (;;) {
+		sleep(1);
+
+		size_t i, metrics = 0, connects = 0, failures = 0;
+		for(i = 0; i < run_threads ;i++) {
+			metrics += threads_data[i].metrics;
+			connects += threads_data[i].connects;
+			failures += threads_data[i].failures;
+		}
+
+		struct child *c = &all_children[(size_t)rand() % children];
+		long last_entry = (c->fd != -1) ? parent_last_entry(c) : 0;
+
+		printf("%zu children connected, %zu connections/s, %zu failures, %zu metrics/s", connected, connects - last_connects, failures, metrics - last_metrics);
+		if(last_entry)
+			printf(", parent lag %ld s", (long)time(NULL) - last_entry);
+
+		if(parent_pid) {
+			unsigned long long cpu = parent_cpu(), rss = parent_rss();
+
+			if(metrics > last_metrics)
+				printf(", parent CPU %0.2f ms per 1000 metrics", (double)(cpu - last_cpu) * 1000.0 / (double)ticks * 1000.0 / (double)(metrics - last_metrics));
+			if(connected && rss > rss_before)
+				printf(", parent memory %llu KiB per child", (rss - rss_before) / connected);
+
+			last_cpu = cpu;
+		}
+		printf("\n");
+
+		last_metrics = metrics;
+		last_connects = connects;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 7 || argc > 10) {
+		fprintf(stderr, "Usage: '%s API_KEY CHILDREN CHARTS DIMENSIONS IP PORT [THREADS] [RECONNECTS_PER_SECOND] [PARENT_PID]'\n", argv[0]);
+		exit(-1);
+	}
+
+	api_key = argv[1];
+	children = strtoul(argv[2], NULL, 0);
+	charts = strtoul(argv[3], NULL, 0);
+	dimensions = strtoul(argv[4], NULL, 0);
+	char *ip = argv[5];
+	int port = atoi(argv[6]);
+	if (argc > 7 && atoi(argv[7]) > 0)
+		run_threads = strtoul(argv[7], NULL, 0);
+	if (argc > 8)
+		reconnects_per_second = strtoul(argv[8], NULL, 0);
+	if (argc > 9)
+		parent_pid = atoi(argv[9]);
+
+	if(children < 1 || charts < 1 || dimensions < 1) {
+		fprintf(stderr, "CHILDREN, CHARTS and DIMENSIONS have to be positive numbers\n");
+		exit(1);
+	}
+	if(run_threads > children)
+		run_threads = children;
+
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	if (inet_aton(ip, &server.sin_addr)==0) {
+		fprintf(stderr, "inet_aton() of ip '%s' failed\n", ip);
+		exit(1);
+	}
+
+	srand(time(NULL));
+
+	// the same children every time, so that the parent has their databases
+	size_t i;
+	all_children = calloc(children, sizeof(struct child));
+	for (i = 0; i < children; ++i) {
+		all_children[i].fd = -1;
+		all_children[i].id = i;
+		snprintf(all_children[i].hostname, sizeof(all_children[i].hostname), "streaming-stress-%zu", i);
+		snprintf(all_children[i].guid, sizeof(all_children[i].guid), "57e55000-0000-4000-8000-%012llx", (unsigned long long)i & 0xffffffffffffULL);
+	}
+
+	pthread_t threads[run_threads], report;
+	threads_data = calloc(run_threads, sizeof(struct thread_data));
+	for (i = 0; i < run_threads; ++i) {
+		threads_data[i].id = i;
+		threads_data[i].children = all_children;
+		pthread_create(&threads[i], NULL, child_thread, &threads_data[i]);
+	}
+
+	printf("\n");
+	printf("CHILDREN    : %zu\n", children);
+	printf("CHARTS      : %zu\n", charts);
+	printf("DIMENSIONS  : %zu\n", dimensions);
+	printf("THREADS     : %zu\n", run_threads);
+	printf("RECONNECTS/s: %zu\n", reconnects_per_second);
+	printf("DESTINATION : %s:%d\n", ip, port);
+	printf("\n");
+	pthread_create(&report, NULL, report_thread, NULL);
+
+	for (i =0; i < run_threads; ++i)
+		pthread_join(threads[i], NULL);
+
+	return 0;
+}
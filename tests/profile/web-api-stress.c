@@ -0,0 +1,515 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ * 1. cd tests/profile/
+ * 2. make web-api-stress
+ * 3. ./web-api-stress IP PORT THREADS SECONDS [URLS_FILE]
+ *
+ * It sends the requests of dashboards to a running netdata, from THREADS threads with a
+ * keep-alive connection each, for SECONDS seconds, asking for gzip compression like the
+ * browsers do.
+ *
+ * URLS_FILE has the URLs to request, one per line, like the ones of a recorded dashboard
+ * session (e.g. the URLs of access.log). The threads go through them in order, each one
+ * starting from a different line. Without it, the URLs are a mix of the requests of a
+ * dashboard that is refreshed: /api/v1/charts, /api/v1/data of random charts with various
+ * points, groupings and formats, badge.svg and allmetrics.
+ *
+ * At the end, it prints for every endpoint the requests per second, the errors and the
+ * latency percentiles, and the averages of the statistics of the web server of netdata
+ * (the netdata.* charts) while it was running.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define MAX_ENDPOINTS 32
+#define CONN_BUFFER_SIZE (1024 * 1024)
+
+struct sockaddr_in server;
+size_t run_threads = 4;
+time_t seconds = 60;
+volatile int stop = 0;
+
+char **urls = NULL;
+size_t urls_count = 0, urls_size = 0;
+
+struct endpoint {
+	char name[100];
+	size_t requests;
+	size_t errors;
+	size_t bytes;
+	double *latencies;          // ms
+	size_t latencies_size;
+};
+
+struct thread_data {
+	size_t id;
+	struct endpoint endpoints[MAX_ENDPOINTS];
+	size_t count;
+	size_t requests;
+};
+
+struct conn {
+	int fd;
+	char *buf;
+	size_t start, end;
+};
+
+static double now_ms(void) {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec * 1000.0 + (double)tv.tv_usec / 1000.0;
+}
+
+static void add_url(const char *url) {
+	if(urls_count == urls_size) {
+		urls_size = (urls_size) ? urls_size * 2 : 1024;
+		urls = realloc(urls, urls_size * sizeof(char *));
+	}
+	urls[urls_count++] = strdup(url);
+}
+
+// ----------------------------------------------------------------------------
+// a minimal HTTP/1.1 client
+
+static void conn_close(struct conn *c) {
+	if(c->fd != -1) close(c->fd);
+	c->fd = -1;
+	c->start = c->end = 0;
+}
+
+static int conn_open(struct conn *c) {
+	c->fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(c->fd == -1) return -1;
+
+	struct timeval tv = { .tv_sec = 30, .tv_usec = 0 };
+	setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	if(connect(c->fd, (struct sockaddr *)&server, sizeof(server)) == -1) {
+		conn_close(c);
+		return -1;
+	}
+
+	c->start = c->end = 0;
+	return 0;
+}
+
+// reads more data in the buffer of the connection
+static int conn_fill(struct conn *c) {
+	if(c->start == c->end)
+		c->start = c->end = 0;
+
+	else if(c->end == CONN_BUFFER_SIZE) {
+		memmove(c->buf, &c->buf[c->start], c->end - c->start);
+		c->end -= c->start;
+		c->start = 0;
+
+		if(c->end == CONN_BUFFER_SIZE) return -1;
+	}
+
+	ssize_t ret = recv(c->fd, &c->buf[c->end], CONN_BUFFER_SIZE - c->end, 0);
+	if(ret <= 0) return -1;
+
+	c->end += (size_t)ret;
+	return 0;
+}
+
+// consumes bytes of the body, copying them to out, as much as it fits
+static int conn_body(struct conn *c, size_t bytes, char *out, size_t out_size, size_t *out_len) {
+	while(bytes) {
+		if(c->start == c->end && conn_fill(c) == -1) return -1;
+
+		size_t n = c->end - c->start;
+		if(n > bytes) n = bytes;
+
+		if(out && *out_len + 1 < out_size) {
+			size_t copy = (n < out_size - 1 - *out_len) ? n : out_size - 1 - *out_len;
+			memcpy(&out[*out_len], &c->buf[c->start], copy);
+			*out_len += copy;
+			out[*out_len] = '\0';
+		}
+
+		c->start += n;
+		bytes -= n;
+	}
+
+	return 0;
+}
+
+// finds the end of the text, reading more data as needed, returns its position after it
+static ssize_t conn_find(struct conn *c, const char *text) {
+	size_t len = strlen(text);
+
+	for(;;) {
+		char *s = memmem(&c->buf[c->start], c->end - c->start, text, len);
+		if(s) return (s - c->buf) + (ssize_t)len;
+		if(conn_fill(c) == -1) return -1;
+	}
+}
+
+// sends the request and reads the response, returns the bytes of the body or -1
+static ssize_t http_get(struct conn *c, const char *url, int gzip, int *status, char *out, size_t out_size) {
+	char request[8192 + 1];
+	int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: netdata\r\nUser-Agent: web-api-stress/1.0\r\n%s\r\n"
+			, url, (gzip) ? "Accept-Encoding: gzip\r\n" : "");
+
+	if(c->fd == -1 && conn_open(c) == -1) return -1;
+	if(send(c->fd, request, (size_t)len, MSG_NOSIGNAL) != len) goto failed;
+
+	ssize_t headers_end = conn_find(c, "\r\n\r\n");
+	if(headers_end == -1) goto failed;
+
+	char headers[16384 + 1];
+	size_t headers_len = (size_t)headers_end - c->start;
+	if(headers_len > 16384) headers_len = 16384;
+	memcpy(headers, &c->buf[c->start], headers_len);
+	headers[headers_len] = '\0';
+	c->start = (size_t)headers_end;
+
+	*status = (strncmp(headers, "HTTP/1.", 7) == 0) ? atoi(&headers[9]) : 0;
+
+	size_t body = 0, out_len = 0;
+	char *s;
+	if((s = strcasestr(headers, "\r\ncontent-length:"))) {
+		body = strtoull(&s[17], NULL, 10);
+		if(conn_body(c, body, out, out_size, &out_len) == -1) goto failed;
+	}
+	else if(strcasestr(headers, "\r\ntransfer-encoding: chunked")) {
+		for(;;) {
+			ssize_t eol = conn_find(c, "\r\n");
+			if(eol == -1) goto failed;
+
+			size_t chunk = strtoull(&c->buf[c->start], NULL, 16);
+			c->start = (size_t)eol;
+
+			// the data of the chunk and its CRLF
+			if(conn_body(c, chunk, out, out_size, &out_len) == -1 || conn_body(c, 2, NULL, 0, NULL) == -1) goto failed;
+			body += chunk;
+
+			if(!chunk) break;
+		}
+	}
+	else {
+		// the body ends when the connection is closed
+		while(conn_fill(c) != -1) ;
+		body = c->end - c->start;
+		conn_close(c);
+		return (ssize_t)body;
+	}
+
+	if(strcasestr(headers, "\r\nconnection: close"))
+		conn_close(c);
+
+	return (ssize_t)body;
+
+failed:
+	conn_close(c);
+	return -1;
+}
+
+// ----------------------------------------------------------------------------
+// the dashboard
+
+// a mix of the requests of a dashboard, for the charts of the netdata
+static void generate_urls(void) {
+	struct conn c = { .fd = -1, .buf = malloc(CONN_BUFFER_SIZE) };
+	size_t size = 32 * 1024 * 1024, charts_count = 0, i;
+	char *json = malloc(size), **charts = NULL, *s;
+	int status = 0;
+
+	if(http_get(&c, "/api/v1/charts", 0, &status, json, size) == -1 || status != 200) {
+		fprintf(stderr, "cannot get the charts of the netdata (HTTP status %d)\n", status);
+		exit(1);
+	}
+	conn_close(&c);
+	free(c.buf);
+
+	// the ids of the charts, in the order of the dashboard
+	for(s = json; (s = strstr(s, "\"id\": \"")) ;) {
+		s += 7;
+		char *e = strchr(s, '"');
+		if(!e) break;
+		*e = '\0';
+
+		charts = realloc(charts, (charts_count + 1) * sizeof(char *));
+		charts[charts_count++] = strdup(s);
+		s = e + 1;
+	}
+
+	if(!charts_count) {
+		fprintf(stderr, "the netdata has no charts\n");
+		exit(1);
+	}
+
+	const char *groups[] = { "average", "average", "average", "max", "sum" };
+	const char *formats[] = { "json", "json", "array", "csv", "ssv" };
+	long points[] = { 60, 300, 600, 1200 };
+	long after[] = { -600, -600, -3600, -86400 };
+	char url[4096];
+
+	srand(1);
+	for(i = 0; i < 1000 ; i++) {
+		char *chart = charts[(size_t)rand() % charts_count];
+
+		// a dashboard loads the charts once, every few refreshes of all its visible charts
+		if(i % 100 == 0)
+			add_url("/api/v1/charts");
+		else if(i % 50 == 25)
+			add_url("/api/v1/allmetrics?format=prometheus");
+		else if(i % 10 == 5) {
+			snprintf(url, sizeof(url), "/api/v1/badge.svg?chart=%s&after=-60&group=average", chart);
+			add_url(url);
+		}
+		else {
+			snprintf(url, sizeof(url), "/api/v1/data?chart=%s&format=%s&points=%ld&group=%s&gtime=0&options=ms%%7Cflip%%7Cjsonwrap%%7Cnonzero&after=%ld",
+					chart, formats[(size_t)rand() % 5], points[(size_t)rand() % 4], groups[(size_t)rand() % 5], after[(size_t)rand() % 4]);
+			add_url(url);
+		}
+	}
+
+	for(i = 0; i < charts_count ; i++) free(charts[i]);
+	free(charts);
+	free(json);
+}
+
+static void load_urls(const char *filename) {
+	FILE *fp = fopen(filename, "r");
+	if(!fp) {
+		perror(filename);
+		exit(1);
+	}
+
+	char line[8192];
+	while(fgets(line, sizeof(line), fp)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if(line[0] == '/') add_url(line);
+	}
+	fclose(fp);
+
+	if(!urls_count) {
+		fprintf(stderr, "%s has no URLs (they have to start with /)\n", filename);
+		exit(1);
+	}
+}
+
+// ----------------------------------------------------------------------------
+// the threads
+
+static struct endpoint *endpoint_get(struct thread_data *data, const char *url) {
+	char name[100];
+	size_t len = strcspn(url, "?"), i;
+	if(len > sizeof(name) - 1) len = sizeof(name) - 1;
+	memcpy(name, url, len);
+	name[len] = '\0';
+
+	for(i = 0; i < data->count ; i++)
+		if(!strcmp(data->endpoints[i].name, name))
+			return &data->endpoints[i];
+
+	// the rest are counted together
+	if(data->count == MAX_ENDPOINTS)
+		return &data->endpoints[MAX_ENDPOINTS - 1];
+
+	struct endpoint *e = &data->endpoints[data->count++];
+	strcpy(e->name, name);
+	return e;
+}
+
+static void *request_thread(void *__data) {
+	struct thread_data *data = (struct thread_data *)__data;
+	struct conn c = { .fd = -1, .buf = malloc(CONN_BUFFER_SIZE) };
+	size_t u = data->id * urls_count / run_threads;
+
+	while(!stop) {
+		const char *url = urls[u];
+		if(++u == urls_count) u = 0;
+
+		int status = 0;
+		double started = now_ms();
+		ssize_t bytes = http_get(&c, url, 1, &status, NULL, 0);
+		double latency = now_ms() - started;
+
+		struct endpoint *e = endpoint_get(data, url);
+		if(e->requests == e->latencies_size) {
+			e->latencies_size = (e->latencies_size) ? e->latencies_size * 2 : 1024;
+			e->latencies = realloc(e->latencies, e->latencies_size * sizeof(double));
+		}
+		e->latencies[e->requests++] = latency;
+
+		if(bytes == -1) {
+			// do not spin while the netdata is not there
+			e->errors++;
+			usleep(10000);
+		}
+		else if(status != 200)
+			e->errors++;
+		else
+			e->bytes += (size_t)bytes;
+
+		__atomic_add_fetch(&data->requests, 1, __ATOMIC_RELAXED);
+	}
+
+	conn_close(&c);
+	free(c.buf);
+	return NULL;
+}
+
+static void *report_thread(void *__data) {
+	struct thread_data *data = (struct thread_data *)__data;
+	size_t last = 0;
+
+	while(!stop) {
+		sleep(1);
+
+		size_t i, total = 0;
+		for(i = 0; i < run_threads ;i++)
+			total += __atomic_load_n(&data[i].requests, __ATOMIC_RELAXED);
+
+		printf("%zu requests/s\n", total - last);
+		last = total;
+		printf("\033[F\033[J");
+	}
+
+	return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// the results
+
+static int compare_latencies(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static void print_endpoints(struct thread_data *data) {
+	struct thread_data all;
+	size_t i, j, k;
+
+	memset(&all, 0, sizeof(all));
+	for(i = 0; i < run_threads ; i++) {
+		for(j = 0; j < data[i].count ; j++) {
+			struct endpoint *from = &data[i].endpoints[j];
+			struct endpoint *to = endpoint_get(&all, from->name);
+
+			to->latencies = realloc(to->latencies, (to->requests + from->requests + 1) * sizeof(double));
+			memcpy(&to->latencies[to->requests], from->latencies, from->requests * sizeof(double));
+			to->requests += from->requests;
+			to->errors += from->errors;
+			to->bytes += from->bytes;
+			free(from->latencies);
+		}
+	}
+
+	printf("\n%-30s %10s %10s %8s %12s %9s %9s %9s %9s\n", "ENDPOINT", "REQUESTS", "REQ/s", "ERRORS", "KiB/s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+	for(k = 0; k < all.count ; k++) {
+		struct endpoint *e = &all.endpoints[k];
+		if(!e->requests) continue;
+
+		qsort(e->latencies, e->requests, sizeof(double), compare_latencies);
+		printf("%-30s %10zu %10.1f %8zu %12.1f %9.2f %9.2f %9.2f %9.2f\n", e->name, e->requests,
+				(double)e->requests / (double)seconds, e->errors, (double)e->bytes / 1024.0 / (double)seconds,
+				e->latencies[e->requests / 2], e->latencies[e->requests * 90 / 100],
+				e->latencies[e->requests * 99 / 100], e->latencies[e->requests - 1]);
+		free(e->latencies);
+	}
+}
+
+// the averages of the statistics of the web server, while the requests were sent
+static void print_server_statistics(void) {
+	const char *charts[] = { "netdata.requests", "netdata.clients", "netdata.net", "netdata.response_time",
+			"netdata.compression_ratio", "netdata.api_in_flight", "netdata.api_rejected", "netdata.server_cpu",
+			"netdata.queries", "netdata.db_points", NULL };
+	struct conn c = { .fd = -1, .buf = malloc(CONN_BUFFER_SIZE) };
+	char url[1024], out[4096];
+	size_t i;
+
+	printf("\nnetdata statistics, average of the last %ld seconds:\n", (long)seconds);
+	for(i = 0; charts[i] ; i++) {
+		int status = 0;
+		snprintf(url, sizeof(url), "/api/v1/data?chart=%s&after=-%ld&points=1&group=average&format=csv&options=nonzero", charts[i], (long)seconds);
+		if(http_get(&c, url, 0, &status, out, sizeof(out)) == -1 || status != 200)
+			continue;
+
+		// the header line has the names of the dimensions, the next one their values
+		char *values = strchr(out, '\n');
+		if(!values) continue;
+		*values++ = '\0';
+		values[strcspn(values, "\r\n")] = '\0';
+		printf("  %-28s %s\n  %-28s %s\n", charts[i], out, "", values);
+	}
+
+	conn_close(&c);
+	free(c.buf);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 5 && argc != 6) {
+		fprintf(stderr, "Usage: '%s IP PORT THREADS SECONDS [URLS_FILE]'\n", argv[0]);
+		exit(-1);
+	}
+
+	char *ip = argv[1];
+	int port = atoi(argv[2]);
+	run_threads = strtoul(argv[3], NULL, 0);
+	seconds = (time_t)strtol(argv[4], NULL, 0);
+	if(run_threads < 1) run_threads = 1;
+	if(seconds < 1) seconds = 1;
+
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	if (inet_aton(ip, &server.sin_addr)==0) {
+		fprintf(stderr, "inet_aton() of ip '%s' failed\n", ip);
+		exit(1);
+	}
+
+	if(argc == 6)
+		load_urls(argv[5]);
+	else
+		generate_urls();
+
+	struct thread_data *data = calloc(run_threads, sizeof(struct thread_data));
+	pthread_t threads[run_threads], report;
+	size_t i;
+
+	printf("\n");
+	printf("THREADS     : %zu\n", run_threads);
+	printf("SECONDS     : %ld\n", (long)seconds);
+	printf("URLS        : %zu\n", urls_count);
+	printf("DESTINATION : %s:%d\n", ip, port);
+	printf("\n");
+
+	for (i = 0; i < run_threads; ++i) {
+		data[i].id = i;
+		pthread_create(&threads[i], NULL, request_thread, &data[i]);
+	}
+	pthread_create(&report, NULL, report_thread, data);
+
+	sleep((unsigned int)seconds);
+	stop = 1;
+
+	for (i =0; i < run_threads; ++i)
+		pthread_join(threads[i], NULL);
+	pthread_join(report, NULL);
+
+	print_endpoints(data);
+	print_server_statistics();
+
+	free(data);
+	return 0;
+}
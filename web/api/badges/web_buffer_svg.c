@@ -809,11 +809,25 @@ static inline void calc_colorz(const char *color, char *final, size_t len, calcu
 // colors
 #define COLOR_STRING_SIZE 100
 
-void buffer_svg(BUFFER *wb, const char *label, calculated_number value, const char *units, const char *label_color, const char *value_color, int precision, int scale, uint32_t options) {
-    char      label_buffer[LABEL_STRING_SIZE + 1]
-            , value_color_buffer[COLOR_STRING_SIZE + 1]
+// the label of a badge, measured and escaped once
+struct badge_label {
+    double width;
+    char escaped[LABEL_STRING_SIZE + 1];
+};
+
+static inline void badge_label_prepare(struct badge_label *bl, const char *label) {
+    char label_buffer[LABEL_STRING_SIZE + 1];
+
+    // we need to copy the label, since verdana11_width may write to it
+    strncpyz(label_buffer, label, LABEL_STRING_SIZE);
+
+    bl->width = verdana11_width(label_buffer) + (BADGE_HORIZONTAL_PADDING * 2);
+    escape_xmlz(bl->escaped, label_buffer, LABEL_STRING_SIZE);
+}
+
+static void buffer_svg_with_label(BUFFER *wb, struct badge_label *bl, calculated_number value, const char *units, const char *label_color, const char *value_color, int precision, int scale, uint32_t options) {
+    char      value_color_buffer[COLOR_STRING_SIZE + 1]
             , value_string[VALUE_STRING_SIZE + 1]
-            , label_escaped[LABEL_STRING_SIZE + 1]
             , value_escaped[VALUE_STRING_SIZE + 1]
             , label_color_escaped[COLOR_STRING_SIZE + 1]
             , value_color_escaped[COLOR_STRING_SIZE + 1];
@@ -831,14 +845,10 @@ void buffer_svg(BUFFER *wb, const char *label, calculated_number value, const ch
     calc_colorz(value_color, value_color_buffer, COLOR_STRING_SIZE, value);
     format_value_and_unit(value_string, VALUE_STRING_SIZE, (options & RRDR_OPTION_DISPLAY_ABS)?calculated_number_fabs(value):value, units, precision);
 
-    // we need to copy the label, since verdana11_width may write to it
-    strncpyz(label_buffer, label, LABEL_STRING_SIZE);
-
-    label_width = verdana11_width(label_buffer) + (BADGE_HORIZONTAL_PADDING * 2);
+    label_width = bl->width;
     value_width = verdana11_width(value_string) + (BADGE_HORIZONTAL_PADDING * 2);
     total_width = label_width + value_width;
 
-    escape_xmlz(label_escaped, label_buffer, LABEL_STRING_SIZE);
     escape_xmlz(value_escaped, value_string, VALUE_STRING_SIZE);
     escape_xmlz(label_color_escaped, color_map(label_color), COLOR_STRING_SIZE);
     escape_xmlz(value_color_escaped, color_map(value_color_buffer), COLOR_STRING_SIZE);
@@ -882,12 +892,134 @@ void buffer_svg(BUFFER *wb, const char *label, calculated_number value, const ch
         label_width, value_width, height, value_color_escaped,
         total_width, height,
         font_size,
-        label_width / 2, ceil(height - text_offset), label_escaped,
-        label_width / 2, ceil(height - text_offset - 1.0), label_escaped,
+        label_width / 2, ceil(height - text_offset), bl->escaped,
+        label_width / 2, ceil(height - text_offset - 1.0), bl->escaped,
         label_width + value_width / 2 -1, ceil(height - text_offset), value_escaped,
         label_width + value_width / 2 -1, ceil(height - text_offset - 1.0), value_escaped);
 }
 
+void buffer_svg(BUFFER *wb, const char *label, calculated_number value, const char *units, const char *label_color, const char *value_color, int precision, int scale, uint32_t options) {
+    struct badge_label bl;
+    badge_label_prepare(&bl, label);
+    buffer_svg_with_label(wb, &bl, value, units, label_color, value_color, precision, scale, options);
+}
+
+// ----------------------------------------------------------------------------
+// the cache of the rendered badges
+//
+// Status pages embed many badges, refreshed by many viewers, but a badge can only
+// change when its chart collects data or its alarm is evaluated. So the rendered
+// badges are kept by their query (and host), until then, or for update_every
+// seconds at most. The cache is direct mapped: a badge replaces the one that had
+// the same slot. Replaced and stale badges keep their label, so rendering them
+// again only measures and escapes their value.
+
+#define BADGE_CACHE_ENTRIES 1024
+
+struct badge_cache_entry {
+    uint32_t hash;
+    char *key;                      // the host and the query of the badge
+    char *label;                    // the label bl was prepared for
+
+    struct badge_label bl;
+
+    RRDSET *st;                     // the badge is valid while these do not change
+    size_t counter_done;
+    RRDCALC *rc;
+    RRDCALC_STATUS rc_status;
+    calculated_number rc_value;
+    time_t expires;
+
+    uint8_t wb_options;             // the cacheable flags of the response
+    int refreshed;                  // the response had a Refresh header
+
+    char *svg;
+    size_t svg_len;
+};
+
+static struct badge_cache_entry badge_cache[BADGE_CACHE_ENTRIES];
+static netdata_mutex_t badge_cache_mutex = NETDATA_MUTEX_INITIALIZER;
+
+// what the badge of the chart or the alarm depends on
+struct badge_cache_state {
+    size_t counter_done;
+    RRDCALC_STATUS rc_status;
+    calculated_number rc_value;
+};
+
+static inline void badge_cache_state_get(struct badge_cache_state *bs, RRDSET *st, RRDCALC *rc) {
+    bs->counter_done = st->counter_done;
+    bs->rc_status = (rc) ? rc->status : RRDCALC_STATUS_UNINITIALIZED;
+    bs->rc_value = (rc) ? rc->value : 0;
+}
+
+// copies the badge of key to wb
+// returns 1 when it is valid, otherwise 0 and bl has its label, when it is known
+static int badge_cache_get(BUFFER *wb, const char *key, uint32_t hash, RRDSET *st, RRDCALC *rc, struct badge_cache_state *bs, const char *label, struct badge_label *bl, int *label_ok, int *refreshed) {
+    struct badge_cache_entry *e = &badge_cache[hash % BADGE_CACHE_ENTRIES];
+    int ret = 0;
+
+    *label_ok = 0;
+
+    netdata_mutex_lock(&badge_cache_mutex);
+
+    if(e->key && e->hash == hash && !strcmp(e->key, key)) {
+        if(e->label && !strcmp(e->label, label)) {
+            memcpy(bl, &e->bl, sizeof(struct badge_label));
+            *label_ok = 1;
+        }
+
+        if(e->svg && e->st == st && e->counter_done == bs->counter_done && e->rc == rc
+           && (!rc || (e->rc_status == bs->rc_status && !memcmp(&e->rc_value, &bs->rc_value, sizeof(calculated_number))))
+           && now_realtime_sec() < e->expires) {
+            buffer_fast_strcat(wb, e->svg, e->svg_len);
+            wb->contenttype = CT_IMAGE_SVG_XML;
+            wb->options = (uint8_t)((wb->options & ~(WB_CONTENT_CACHEABLE | WB_CONTENT_NO_CACHEABLE)) | e->wb_options);
+            *refreshed = e->refreshed;
+            ret = 1;
+        }
+    }
+
+    netdata_mutex_unlock(&badge_cache_mutex);
+    return ret;
+}
+
+// keeps the badge just rendered in wb
+static void badge_cache_set(BUFFER *wb, const char *key, uint32_t hash, RRDSET *st, RRDCALC *rc, struct badge_cache_state *bs, const char *label, struct badge_label *bl, int refreshed, int update_every) {
+    struct badge_cache_entry *e = &badge_cache[hash % BADGE_CACHE_ENTRIES];
+
+    netdata_mutex_lock(&badge_cache_mutex);
+
+    if(!e->key || e->hash != hash || strcmp(e->key, key) != 0) {
+        freez(e->key);
+        e->key = strdupz(key);
+        e->hash = hash;
+        freez(e->label);
+        e->label = NULL;
+    }
+
+    if(!e->label || strcmp(e->label, label) != 0) {
+        freez(e->label);
+        e->label = strdupz(label);
+        memcpy(&e->bl, bl, sizeof(struct badge_label));
+    }
+
+    e->st = st;
+    e->counter_done = bs->counter_done;
+    e->rc = rc;
+    e->rc_status = bs->rc_status;
+    e->rc_value = bs->rc_value;
+    e->expires = now_realtime_sec() + ((update_every > 0) ? update_every : 1);
+    e->wb_options = (uint8_t)(wb->options & (WB_CONTENT_CACHEABLE | WB_CONTENT_NO_CACHEABLE));
+    e->refreshed = refreshed;
+
+    e->svg_len = buffer_strlen(wb);
+    e->svg = reallocz(e->svg, e->svg_len + 1);
+    memcpy(e->svg, buffer_tostring(wb), e->svg_len + 1);
+
+    netdata_mutex_unlock(&badge_cache_mutex);
+}
+
 int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *url) {
     int ret = 400;
     buffer_flush(w->response.data);
@@ -912,6 +1044,14 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
     int group = RRDR_GROUPING_AVERAGE;
     uint32_t options = 0x00000000;
 
+    // the query identifies the badge in the cache, it is modified while it is parsed
+    char *badge_key = mallocz(GUID_LEN + 1 + ((url) ? strlen(url) : 0) + 1);
+    sprintf(badge_key, "%s/%s", host->machine_guid, (url) ? url : "");
+    uint32_t badge_hash = simple_hash(badge_key);
+    struct badge_cache_state bs;
+    struct badge_label bl;
+    int label_ok, refreshed = 0;
+
     while(url) {
         char *value = mystrsep(&url, "&");
         if(!value || !*value) continue;
@@ -970,7 +1110,7 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
         ret = 200;
         goto cleanup;
     }
-    st->last_accessed_time = now_realtime_sec();
+    st->last_accessed_time = now_realtime_coarse_sec();
 
     RRDCALC *rc = NULL;
     if(alarm) {
@@ -1052,15 +1192,30 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
           , options
     );
 
+    badge_cache_state_get(&bs, st, rc);
+    if(badge_cache_get(w->response.data, badge_key, badge_hash, st, rc, &bs, label, &bl, &label_ok, &refreshed)) {
+        if(refreshed && refresh > 0) {
+            buffer_sprintf(w->response.header, "Refresh: %d\r\n", refresh);
+            w->response.data->expires = now_realtime_sec() + refresh;
+        }
+
+        ret = 200;
+        goto cleanup;
+    }
+
+    if(!label_ok)
+        badge_label_prepare(&bl, label);
+
     if(rc) {
         if (refresh > 0) {
             buffer_sprintf(w->response.header, "Refresh: %d\r\n", refresh);
             w->response.data->expires = now_realtime_sec() + refresh;
+            refreshed = 1;
         }
         else buffer_no_cacheable(w->response.data);
 
         if(!value_color) {
-            switch(rc->status) {
+            switch(bs.rc_status) {
                 case RRDCALC_STATUS_CRITICAL:
                     value_color = "red";
                     break;
@@ -1087,9 +1242,9 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
             }
         }
 
-        buffer_svg(w->response.data,
-                label,
-                (isnan(rc->value)||isinf(rc->value)) ? rc->value : rc->value * multiply / divide,
+        buffer_svg_with_label(w->response.data,
+                &bl,
+                (isnan(bs.rc_value)||isinf(bs.rc_value)) ? bs.rc_value : bs.rc_value * multiply / divide,
                 units,
                 label_color,
                 value_color,
@@ -1098,6 +1253,8 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
                 options
         );
         ret = 200;
+
+        badge_cache_set(w->response.data, badge_key, badge_hash, st, rc, &bs, label, &bl, refreshed, rc->update_every);
     }
     else {
         time_t latest_timestamp = 0;
@@ -1120,12 +1277,13 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
         else if (refresh > 0) {
             buffer_sprintf(w->response.header, "Refresh: %d\r\n", refresh);
             w->response.data->expires = now_realtime_sec() + refresh;
+            refreshed = 1;
         }
         else buffer_no_cacheable(w->response.data);
 
         // render the badge
-        buffer_svg(w->response.data,
-                label,
+        buffer_svg_with_label(w->response.data,
+                &bl,
                 (value_is_null)?NAN:(n * multiply / divide),
                 units,
                 label_color,
@@ -1134,9 +1292,12 @@ int web_client_api_request_v1_badge(RRDHOST *host, struct web_client *w, char *u
                 scale,
                 options
         );
+
+        badge_cache_set(w->response.data, badge_key, badge_hash, st, rc, &bs, label, &bl, refreshed, st->update_every);
     }
 
     cleanup:
     buffer_free(dimensions);
+    freez(badge_key);
     return ret;
 }
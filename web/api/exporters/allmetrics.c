@@ -17,6 +17,162 @@ struct prometheus_output_options {
         { NULL, PROMETHEUS_OUTPUT_NONE },
 };
 
+// ----------------------------------------------------------------------------
+// the shell and json responses do not depend on the client, so they are generated
+// at most once per update_every of the host, and all the clients get the same
+// snapshot, with an ETag that lets them skip the responses they already have
+
+static int allmetrics_snapshot_send(RRDHOST *host, struct web_client *w, int format) {
+    struct rrdhost_allmetrics_snapshot *snapshot = (format == ALLMETRICS_JSON) ? &host->allmetrics_json : &host->allmetrics_shell;
+    time_t now = now_realtime_sec();
+    char etag[30 + 1];
+    int code = 200;
+
+    netdata_mutex_lock(&host->allmetrics_mutex);
+
+    if(unlikely(!snapshot->wb || now - snapshot->time >= host->rrd_update_every)) {
+        if(!snapshot->wb)
+            snapshot->wb = buffer_create(NETDATA_WEB_RESPONSE_PRODUCE_SIZE);
+        else
+            buffer_flush(snapshot->wb);
+
+        if(format == ALLMETRICS_JSON)
+            rrd_stats_api_v1_charts_allmetrics_json(host, snapshot->wb);
+        else
+            rrd_stats_api_v1_charts_allmetrics_shell(host, snapshot->wb);
+
+        snapshot->time = now;
+        snapshot->etag = simple_hash(buffer_tostring(snapshot->wb));
+    }
+
+    snprintfz(etag, 30, "\"%08x-%zx\"", snapshot->etag, buffer_strlen(snapshot->wb));
+
+    if(w->if_none_match[0] && (!strcmp(w->if_none_match, "*") || strstr(w->if_none_match, etag)))
+        code = 304;
+    else
+        buffer_fast_strcat(w->response.data, buffer_tostring(snapshot->wb), buffer_strlen(snapshot->wb));
+
+    netdata_mutex_unlock(&host->allmetrics_mutex);
+
+    buffer_sprintf(w->response.header, "ETag: %s\r\n", etag);
+    return code;
+}
+
+// ----------------------------------------------------------------------------
+// prometheus responses depend on the last scrape of each server, so they are generated
+// while they are sent to the client, a few charts at a time, so that they are never
+// kept in memory all together
+
+typedef enum allmetrics_stage {
+    ALLMETRICS_STAGE_HOST,      // the header of the host
+    ALLMETRICS_STAGE_CHARTS,    // the charts of the host
+    ALLMETRICS_STAGE_END        // what follows the charts of the host
+} ALLMETRICS_STAGE;
+
+struct allmetrics_stream {
+    int format;
+    ALLMETRICS_STAGE stage;
+
+    char machine_guid[GUID_LEN + 1];    // the host we are sending, which may be gone by the next call
+    char *chart;                        // the id of the last chart sent, NULL before the first chart of the host
+
+    char *prefix;
+    BACKEND_OPTIONS backend_options;
+    PROMETHEUS_OUTPUT_OPTIONS output_options;
+    time_t after;
+    time_t before;
+    char labels[PROMETHEUS_LABELS_MAX + 1];
+};
+
+static void allmetrics_stream_free(void *data) {
+    struct allmetrics_stream *s = data;
+
+    freez(s->chart);
+    freez(s->prefix);
+    freez(s);
+}
+
+// adds the charts of host after the last one sent, until wb is at least size bytes long
+// returns 1 when all the charts of the host have been added
+static int allmetrics_stream_charts(struct allmetrics_stream *s, RRDHOST *host, BUFFER *wb, size_t size) {
+    unsigned reader = rrdhost_charts_read_lock(host);
+
+    RRDSET *st = __atomic_load_n(&host->rrdset_root, __ATOMIC_ACQUIRE);
+    if(s->chart) {
+        // continue after the last chart sent - when it has been deleted in the meantime,
+        // we cannot know which charts follow it, so we skip the rest of the charts of the host
+        st = rrdset_find(host, s->chart);
+        if(st) st = __atomic_load_n(&st->next, __ATOMIC_ACQUIRE);
+    }
+
+    for( ; st && wb->len < size ; st = __atomic_load_n(&st->next, __ATOMIC_ACQUIRE)) {
+        rrd_stats_api_v1_chart_allmetrics_prometheus(st, wb, s->prefix, s->backend_options, s->after, s->before, s->labels, s->output_options);
+
+        freez(s->chart);
+        s->chart = strdupz(st->id);
+    }
+
+    rrdhost_charts_read_unlock(host, reader);
+    return (st == NULL);
+}
+
+static int allmetrics_stream_produce(struct web_client *w, void *data) {
+    struct allmetrics_stream *s = data;
+    BUFFER *wb = w->response.data;
+    size_t size = wb->len + NETDATA_WEB_RESPONSE_PRODUCE_SIZE;
+
+    rrd_rdlock();
+
+    RRDHOST *host = rrdhost_find_by_guid(s->machine_guid, 0);
+    while(host && wb->len < size) {
+        switch(s->stage) {
+            case ALLMETRICS_STAGE_HOST:
+                rrd_stats_api_v1_host_allmetrics_prometheus(host, wb, s->prefix, s->backend_options, s->format == ALLMETRICS_PROMETHEUS_ALL_HOSTS, s->output_options, s->labels);
+
+                s->stage = ALLMETRICS_STAGE_CHARTS;
+                break;
+
+            case ALLMETRICS_STAGE_CHARTS:
+                if(allmetrics_stream_charts(s, host, wb, size))
+                    s->stage = ALLMETRICS_STAGE_END;
+                break;
+
+            case ALLMETRICS_STAGE_END:
+                if(s->format == ALLMETRICS_PROMETHEUS_ALL_HOSTS && host->next) {
+                    host = host->next;
+                    strncpyz(s->machine_guid, host->machine_guid, GUID_LEN);
+                    freez(s->chart);
+                    s->chart = NULL;
+                    s->stage = ALLMETRICS_STAGE_HOST;
+                }
+                else
+                    host = NULL;
+                break;
+        }
+    }
+
+    rrd_unlock();
+    return (host != NULL);
+}
+
+static void allmetrics_stream_start(RRDHOST *host, struct web_client *w, int format, const char *prefix, BACKEND_OPTIONS backend_options, PROMETHEUS_OUTPUT_OPTIONS output_options, time_t after, time_t before) {
+    struct allmetrics_stream *s = callocz(1, sizeof(struct allmetrics_stream));
+    s->format = format;
+    s->stage = ALLMETRICS_STAGE_HOST;
+    s->prefix = strdupz(prefix?prefix:"");
+    s->backend_options = backend_options;
+    s->output_options = output_options;
+    s->after = after;
+    s->before = before;
+
+    // all the hosts are sent starting from localhost, the first in the list of hosts
+    if(format == ALLMETRICS_PROMETHEUS_ALL_HOSTS)
+        host = localhost;
+    strncpyz(s->machine_guid, host->machine_guid, GUID_LEN);
+
+    web_client_set_producer(w, allmetrics_stream_produce, allmetrics_stream_free, s);
+}
+
 inline int web_client_api_request_v1_allmetrics(RRDHOST *host, struct web_client *w, char *url) {
     int format = ALLMETRICS_SHELL;
     const char *prometheus_server = w->client_ip;
@@ -74,37 +230,30 @@ inline int web_client_api_request_v1_allmetrics(RRDHOST *host, struct web_client
     switch(format) {
         case ALLMETRICS_JSON:
             w->response.data->contenttype = CT_APPLICATION_JSON;
-            rrd_stats_api_v1_charts_allmetrics_json(host, w->response.data);
-            return 200;
+            return allmetrics_snapshot_send(host, w, format);
 
         case ALLMETRICS_SHELL:
             w->response.data->contenttype = CT_TEXT_PLAIN;
-            rrd_stats_api_v1_charts_allmetrics_shell(host, w->response.data);
-            return 200;
+            return allmetrics_snapshot_send(host, w, format);
 
         case ALLMETRICS_PROMETHEUS:
+        case ALLMETRICS_PROMETHEUS_ALL_HOSTS: {
             w->response.data->contenttype = CT_PROMETHEUS;
-            rrd_stats_api_v1_charts_allmetrics_prometheus_single_host(
-                    host
-                    , w->response.data
-                    , prometheus_server
-                    , prometheus_prefix
-                    , prometheus_backend_options
-                    , prometheus_output_options
-            );
-            return 200;
 
-        case ALLMETRICS_PROMETHEUS_ALL_HOSTS:
-            w->response.data->contenttype = CT_PROMETHEUS;
-            rrd_stats_api_v1_charts_allmetrics_prometheus_all_hosts(
+            // we start at the point we had stopped before
+            time_t before = now_realtime_sec();
+            time_t after = rrd_stats_api_v1_allmetrics_prometheus_preparation(
                     host
                     , w->response.data
-                    , prometheus_server
-                    , prometheus_prefix
                     , prometheus_backend_options
+                    , prometheus_server
+                    , before
                     , prometheus_output_options
             );
+
+            allmetrics_stream_start(host, w, format, prometheus_prefix, prometheus_backend_options, prometheus_output_options, after, before);
             return 200;
+        }
 
         default:
             w->response.data->contenttype = CT_TEXT_PLAIN;
@@ -22,48 +22,67 @@ static inline size_t shell_name_copy(char *d, const char *s, size_t usable) {
 
 #define SHELL_ELEMENT_MAX 100
 
+// the caller must hold the charts read lock of the host of st
+void rrd_stats_api_v1_chart_allmetrics_shell(RRDSET *st, BUFFER *wb) {
+    calculated_number total = 0.0;
+    char chart[SHELL_ELEMENT_MAX + 1];
+    shell_name_copy(chart, st->name?st->name:st->id, SHELL_ELEMENT_MAX);
+
+    buffer_sprintf(wb, "\n# chart: %s (name: %s)\n", st->id, st->name);
+    if(rrdset_is_available_for_viewers(st)) {
+        rrdset_rdlock(st);
+
+        // for each dimension
+        RRDDIM *rd;
+        rrddim_foreach_read(rd, st) {
+            if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
+                char dimension[SHELL_ELEMENT_MAX + 1];
+                shell_name_copy(dimension, rd->name?rd->name:rd->id, SHELL_ELEMENT_MAX);
+
+                calculated_number n = rd->last_stored_value;
+
+                if(isnan(n) || isinf(n))
+                    buffer_sprintf(wb, "NETDATA_%s_%s=\"\"      # %s\n", chart, dimension, st->units);
+                else {
+                    if(rd->multiplier < 0 || rd->divisor < 0) n = -n;
+                    n = calculated_number_round(n);
+                    if(!rrddim_flag_check(rd, RRDDIM_FLAG_HIDDEN)) total += n;
+                    buffer_fast_strcat(wb, "NETDATA_", 8);
+                    buffer_strcat(wb, chart);
+                    buffer_fast_strcat(wb, "_", 1);
+                    buffer_strcat(wb, dimension);
+                    buffer_fast_strcat(wb, "=\"", 2);
+                    buffer_print_double_fixed(wb, n, 0);
+                    buffer_fast_strcat(wb, "\"      # ", 9);
+                    buffer_strcat(wb, st->units);
+                    buffer_fast_strcat(wb, "\n", 1);
+                }
+            }
+        }
+
+        total = calculated_number_round(total);
+        buffer_sprintf(wb, "NETDATA_%s_VISIBLETOTAL=\"" CALCULATED_NUMBER_FORMAT_ZERO "\"      # %s\n", chart, total, st->units);
+        rrdset_unlock(st);
+    }
+}
+
 void rrd_stats_api_v1_charts_allmetrics_shell(RRDHOST *host, BUFFER *wb) {
-    rrdhost_rdlock(host);
+    unsigned reader = rrdhost_charts_read_lock(host);
 
     // for each chart
     RRDSET *st;
-    rrdset_foreach_read(st, host) {
-        calculated_number total = 0.0;
-        char chart[SHELL_ELEMENT_MAX + 1];
-        shell_name_copy(chart, st->name?st->name:st->id, SHELL_ELEMENT_MAX);
-
-        buffer_sprintf(wb, "\n# chart: %s (name: %s)\n", st->id, st->name);
-        if(rrdset_is_available_for_viewers(st)) {
-            rrdset_rdlock(st);
-
-            // for each dimension
-            RRDDIM *rd;
-            rrddim_foreach_read(rd, st) {
-                if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
-                    char dimension[SHELL_ELEMENT_MAX + 1];
-                    shell_name_copy(dimension, rd->name?rd->name:rd->id, SHELL_ELEMENT_MAX);
-
-                    calculated_number n = rd->last_stored_value;
-
-                    if(isnan(n) || isinf(n))
-                        buffer_sprintf(wb, "NETDATA_%s_%s=\"\"      # %s\n", chart, dimension, st->units);
-                    else {
-                        if(rd->multiplier < 0 || rd->divisor < 0) n = -n;
-                        n = calculated_number_round(n);
-                        if(!rrddim_flag_check(rd, RRDDIM_FLAG_HIDDEN)) total += n;
-                        buffer_sprintf(wb, "NETDATA_%s_%s=\"" CALCULATED_NUMBER_FORMAT_ZERO "\"      # %s\n", chart, dimension, n, st->units);
-                    }
-                }
-            }
+    rrdset_foreach_lockless(st, host)
+        rrd_stats_api_v1_chart_allmetrics_shell(st, wb);
 
-            total = calculated_number_round(total);
-            buffer_sprintf(wb, "NETDATA_%s_VISIBLETOTAL=\"" CALCULATED_NUMBER_FORMAT_ZERO "\"      # %s\n", chart, total, st->units);
-            rrdset_unlock(st);
-        }
-    }
+    rrdhost_charts_read_unlock(host, reader);
+
+    rrd_stats_api_v1_alarms_allmetrics_shell(host, wb);
+}
 
+void rrd_stats_api_v1_alarms_allmetrics_shell(RRDHOST *host, BUFFER *wb) {
     buffer_strcat(wb, "\n# NETDATA ALARMS RUNNING\n");
 
+    rrdhost_rdlock(host);
     RRDCALC *rc;
     for(rc = host->alarms; rc ;rc = rc->next) {
         if(!rc->rrdset) continue;
@@ -91,69 +110,70 @@ void rrd_stats_api_v1_charts_allmetrics_shell(RRDHOST *host, BUFFER *wb) {
 
 // ----------------------------------------------------------------------------
 
+// returns 1 when st has been added to the output, 0 when it is not available
+// the caller must hold the charts read lock of the host of st
+int rrd_stats_api_v1_chart_allmetrics_json(RRDSET *st, BUFFER *wb, size_t chart_counter) {
+    size_t dimension_counter = 0;
+
+    if(!rrdset_is_available_for_viewers(st))
+        return 0;
+
+    rrdset_rdlock(st);
+
+    buffer_sprintf(wb, "%s\n"
+                       "\t\"%s\": {\n"
+                       "\t\t\"name\":\"%s\",\n"
+                       "\t\t\"context\":\"%s\",\n"
+                       "\t\t\"units\":\"%s\",\n"
+                       "\t\t\"last_updated\": %ld,\n"
+                       "\t\t\"dimensions\": {"
+                   , chart_counter?",":""
+                   , st->id
+                   , st->name
+                   , st->context
+                   , st->units
+                   , rrdset_last_entry_t(st)
+    );
+
+    // for each dimension
+    RRDDIM *rd;
+    rrddim_foreach_read(rd, st) {
+        if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
+
+            if(dimension_counter) buffer_fast_strcat(wb, ",", 1);
+            buffer_fast_strcat(wb, "\n\t\t\t\"", 5);
+            buffer_strcat_json_escaped(wb, rd->id);
+            buffer_fast_strcat(wb, "\": {\n\t\t\t\t\"name\": \"", 18);
+            buffer_strcat_json_escaped(wb, rd->name);
+            buffer_fast_strcat(wb, "\",\n\t\t\t\t\"value\": ", 16);
+
+            buffer_print_double_fixed(wb, rd->last_stored_value, 7);
+
+            buffer_strcat(wb, "\n\t\t\t}");
+
+            dimension_counter++;
+        }
+    }
+
+    buffer_strcat(wb, "\n\t\t}\n\t}");
+    rrdset_unlock(st);
+
+    return 1;
+}
+
 void rrd_stats_api_v1_charts_allmetrics_json(RRDHOST *host, BUFFER *wb) {
-    rrdhost_rdlock(host);
+    unsigned reader = rrdhost_charts_read_lock(host);
 
     buffer_strcat(wb, "{");
 
     size_t chart_counter = 0;
-    size_t dimension_counter = 0;
 
     // for each chart
     RRDSET *st;
-    rrdset_foreach_read(st, host) {
-        if(rrdset_is_available_for_viewers(st)) {
-            rrdset_rdlock(st);
-
-            buffer_sprintf(wb, "%s\n"
-                               "\t\"%s\": {\n"
-                               "\t\t\"name\":\"%s\",\n"
-                               "\t\t\"context\":\"%s\",\n"
-                               "\t\t\"units\":\"%s\",\n"
-                               "\t\t\"last_updated\": %ld,\n"
-                               "\t\t\"dimensions\": {"
-                           , chart_counter?",":""
-                           , st->id
-                           , st->name
-                           , st->context
-                           , st->units
-                           , rrdset_last_entry_t(st)
-            );
-
-            chart_counter++;
-            dimension_counter = 0;
-
-            // for each dimension
-            RRDDIM *rd;
-            rrddim_foreach_read(rd, st) {
-                if(rd->collections_counter && !rrddim_flag_check(rd, RRDDIM_FLAG_OBSOLETE)) {
-
-                    buffer_sprintf(wb, "%s\n"
-                                       "\t\t\t\"%s\": {\n"
-                                       "\t\t\t\t\"name\": \"%s\",\n"
-                                       "\t\t\t\t\"value\": "
-                                   , dimension_counter?",":""
-                                   , rd->id
-                                   , rd->name
-                    );
-
-                    if(isnan(rd->last_stored_value))
-                        buffer_strcat(wb, "null");
-                    else
-                        buffer_sprintf(wb, CALCULATED_NUMBER_FORMAT, rd->last_stored_value);
-
-                    buffer_strcat(wb, "\n\t\t\t}");
-
-                    dimension_counter++;
-                }
-            }
-
-            buffer_strcat(wb, "\n\t\t}\n\t}");
-            rrdset_unlock(st);
-        }
-    }
+    rrdset_foreach_lockless(st, host)
+        chart_counter += rrd_stats_api_v1_chart_allmetrics_json(st, wb, chart_counter);
 
     buffer_strcat(wb, "\n}");
-    rrdhost_unlock(host);
+    rrdhost_charts_read_unlock(host, reader);
 }
 
@@ -18,4 +18,8 @@
 extern void rrd_stats_api_v1_charts_allmetrics_json(RRDHOST *host, BUFFER *wb);
 extern void rrd_stats_api_v1_charts_allmetrics_shell(RRDHOST *host, BUFFER *wb);
 
+extern int rrd_stats_api_v1_chart_allmetrics_json(RRDSET *st, BUFFER *wb, size_t chart_counter);
+extern void rrd_stats_api_v1_chart_allmetrics_shell(RRDSET *st, BUFFER *wb);
+extern void rrd_stats_api_v1_alarms_allmetrics_shell(RRDHOST *host, BUFFER *wb);
+
 #endif //NETDATA_API_ALLMETRICS_SHELL_H
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "libnetdata/libnetdata.h"
+#include "binary.h"
+
+// the numbers are written little-endian on every architecture
+// the compilers turn these into plain stores on little-endian ones
+
+static inline char *binary_put_uint32(char *s, uint32_t v) {
+    s[0] = (char)v;
+    s[1] = (char)(v >> 8);
+    s[2] = (char)(v >> 16);
+    s[3] = (char)(v >> 24);
+    return s + 4;
+}
+
+static inline char *binary_put_uint64(char *s, uint64_t v) {
+    s = binary_put_uint32(s, (uint32_t)v);
+    return binary_put_uint32(s, (uint32_t)(v >> 32));
+}
+
+static inline char *binary_put_double(char *s, double d) {
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    return binary_put_uint64(s, v);
+}
+
+static inline char *binary_put_float(char *s, float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    return binary_put_uint32(s, v);
+}
+
+// the header, with the names of the dimensions, is followed by the timestamps of all the
+// rows and then by the values of all the rows of every dimension, one dimension after the other
+void rrdr2binary(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int float32) {
+    rrdset_check_rdlock(r->st);
+
+    long c, i, dims = 0, rows = rrdr_rows(r);
+    size_t header_size = RRDR_BINARY_HEADER_SIZE, value_size = float32 ? sizeof(float) : sizeof(double), size;
+    RRDDIM *rd;
+
+    long *dim = mallocz(sizeof(long) * (r->d ? r->d : 1));
+    for(c = 0, rd = r->st->dimensions; rd && c < r->d ;c++, rd = rd->next) {
+        if(unlikely(r->od[c] & RRDR_DIMENSION_HIDDEN)) continue;
+        if(unlikely((options & RRDR_OPTION_NONZERO) && !(r->od[c] & RRDR_DIMENSION_NONZERO))) continue;
+
+        header_size += sizeof(uint32_t) + strlen(rd->name);
+        dim[dims++] = c;
+    }
+    header_size = (header_size + 7) & ~((size_t)7);
+
+    size = header_size + (size_t)rows * sizeof(uint64_t) + (size_t)rows * (size_t)dims * value_size;
+    buffer_need_bytes(wb, size + 1);
+
+    char *start = &wb->buffer[wb->len], *s = start;
+    memset(start, 0, header_size);
+
+    memcpy(s, RRDR_BINARY_MAGIC, sizeof(RRDR_BINARY_MAGIC));
+    s += 8;
+    s = binary_put_uint32(s, (uint32_t)header_size);
+    s = binary_put_uint32(s, (uint32_t)rows);
+    s = binary_put_uint32(s, (uint32_t)dims);
+    s = binary_put_uint32(s, (uint32_t)value_size);
+    s = binary_put_uint64(s, (uint64_t)r->after);
+    s = binary_put_uint64(s, (uint64_t)r->before);
+    for(i = 0, c = 0, rd = r->st->dimensions; rd && i < dims ;c++, rd = rd->next) {
+        if(c != dim[i]) continue;
+
+        size_t len = strlen(rd->name);
+        s = binary_put_uint32(s, (uint32_t)len);
+        memcpy(s, rd->name, len);
+        s += len;
+        i++;
+    }
+    s = start + header_size;
+
+    long first = 0, step = 1;
+    if(!(options & RRDR_OPTION_REVERSED)) {
+        first = rows - 1;
+        step = -1;
+    }
+
+    long row;
+    for(row = 0, i = first; row < rows ; row++, i += step)
+        s = binary_put_uint64(s, (uint64_t)r->t[i] * ((options & RRDR_OPTION_MILLISECONDS) ? 1000 : 1));
+
+    // the totals of the rows, for the percentages
+    query_number *total = NULL;
+    if(unlikely(options & RRDR_OPTION_PERCENTAGE)) {
+        total = mallocz(sizeof(query_number) * (rows ? rows : 1));
+        for(i = 0; i < rows ; i++) {
+            query_number t = 0;
+            for(c = 0; c < r->d ; c++) {
+                query_number n = r->v[i * r->d + c];
+
+                if(likely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
+                    n = -n;
+
+                t += n;
+            }
+            // prevent a division by zero
+            total[i] = (t == 0) ? 1 : t;
+        }
+    }
+
+    long d;
+    for(d = 0; d < dims ; d++) {
+        c = dim[d];
+
+        for(row = 0, i = first; row < rows ; row++, i += step) {
+            query_number n = r->v[i * r->d + c];
+
+            if(unlikely(r->o[i * r->d + c] & RRDR_VALUE_EMPTY))
+                n = (options & RRDR_OPTION_NULL2ZERO) ? 0 : NAN;
+            else {
+                if(unlikely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
+                    n = -n;
+
+                if(unlikely(total)) {
+                    n = n * 100 / total[i];
+
+                    if(unlikely(!d && !row)) r->min = r->max = n;
+                    if(n < r->min) r->min = n;
+                    if(n > r->max) r->max = n;
+                }
+            }
+
+            if(float32)
+                s = binary_put_float(s, (float)n);
+            else
+                s = binary_put_double(s, (double)n);
+        }
+    }
+
+    wb->len += size;
+    wb->buffer[wb->len] = '\0';
+
+    freez(total);
+    freez(dim);
+}
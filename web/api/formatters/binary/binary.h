@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_API_FORMATTER_BINARY_H
+#define NETDATA_API_FORMATTER_BINARY_H
+
+#include "web/api/queries/rrdr.h"
+
+#define RRDR_BINARY_MAGIC "NDCOLS1"
+#define RRDR_BINARY_HEADER_SIZE 40             // without the names of the dimensions
+
+extern void rrdr2binary(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int float32);
+
+#include "../rrd2json.h"
+
+#endif //NETDATA_API_FORMATTER_BINARY_H
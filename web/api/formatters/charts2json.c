@@ -36,13 +36,12 @@ static inline const char* get_release_channel() {
     return (use_stable)?"stable":"nightly";
 }
 
-void charts2json(RRDHOST *host, BUFFER *wb) {
+// the caller has to hold the charts_json_mutex of the host
+static void charts2json_generate(RRDHOST *host, BUFFER *wb, time_t now) {
     static char *custom_dashboard_info_js_filename = NULL;
     size_t c, dimensions = 0, memory = 0, alarms = 0;
     RRDSET *st;
 
-    time_t now = now_realtime_sec();
-
     if(unlikely(!custom_dashboard_info_js_filename))
         custom_dashboard_info_js_filename = config_get(CONFIG_SECTION_WEB, "custom dashboard_info.js", "");
 
@@ -67,21 +66,27 @@ void charts2json(RRDHOST *host, BUFFER *wb) {
     );
 
     c = 0;
-    rrdhost_rdlock(host);
-    rrdset_foreach_read(st, host) {
+    unsigned reader = rrdhost_charts_read_lock(host);
+    unsigned json_reader = rrdhost_json_read_lock(host);
+    rrdset_foreach_lockless(st, host) {
         if(rrdset_is_available_for_viewers(st)) {
             if(c) buffer_strcat(wb, ",");
             buffer_strcat(wb, "\n\t\t\"");
             buffer_strcat(wb, st->id);
             buffer_strcat(wb, "\": ");
-            rrdset2json(st, wb, &dimensions, &memory);
+            rrdset2json_nolock(st, wb, &dimensions, &memory);
 
             c++;
             st->last_accessed_time = now;
         }
     }
+    rrdhost_json_read_unlock(host, json_reader);
+    rrdhost_charts_read_unlock(host, reader);
+
+    rrdset2json_free_replaced_nolock(host);
 
     RRDCALC *rc;
+    rrdhost_rdlock(host);
     for(rc = host->alarms; rc ; rc = rc->next) {
         if(rc->rrdset)
             alarms++;
@@ -136,6 +141,37 @@ void charts2json(RRDHOST *host, BUFFER *wb) {
     buffer_sprintf(wb, "\n\t]\n}\n");
 }
 
+// The response is generated again when the charts of the host change, or a second later,
+// since the first and last entries of the charts and the status of their alarms change
+// with their data. The charts whose definition did not change reuse most of their JSON.
+void charts2json(RRDHOST *host, BUFFER *wb) {
+    time_t now = now_realtime_sec();
+    size_t generation = __atomic_load_n(&host->charts_generation, __ATOMIC_ACQUIRE);
+
+    netdata_mutex_lock(&host->charts_json_mutex);
+
+    if(unlikely(!host->charts_json
+                || host->charts_json_generation != generation
+                || host->charts_json_time != now
+                || host->charts_json_hosts != rrd_hosts_available)) {
+
+        if(!host->charts_json)
+            host->charts_json = buffer_create(65536);
+        else
+            buffer_flush(host->charts_json);
+
+        charts2json_generate(host, host->charts_json, now);
+
+        host->charts_json_generation = generation;
+        host->charts_json_time = now;
+        host->charts_json_hosts = rrd_hosts_available;
+    }
+
+    buffer_fast_strcat(wb, buffer_tostring(host->charts_json), buffer_strlen(host->charts_json));
+
+    netdata_mutex_unlock(&host->charts_json_mutex);
+}
+
 // generate collectors list for the api/v1/info call
 
 struct collector {
@@ -168,8 +204,8 @@ void chartcollectors2json(RRDHOST *host, BUFFER *wb) {
     char name[500];
 
     time_t now = now_realtime_sec();
-    rrdhost_rdlock(host);
-    rrdset_foreach_read(st, host) {
+    unsigned reader = rrdhost_charts_read_lock(host);
+    rrdset_foreach_lockless(st, host) {
         if (rrdset_is_available_for_viewers(st)) {
             struct collector col = {
                     .plugin = st->plugin_name ? st->plugin_name : "",
@@ -180,7 +216,7 @@ void chartcollectors2json(RRDHOST *host, BUFFER *wb) {
             st->last_accessed_time = now;
         }
     }
-    rrdhost_unlock(host);
+    rrdhost_charts_read_unlock(host, reader);
     struct array_printer ap = {
             .c = 0,
             .wb = wb
@@ -188,3 +224,94 @@ void chartcollectors2json(RRDHOST *host, BUFFER *wb) {
     dictionary_get_all(dict, print_collector, &ap);
     dictionary_destroy(dict);
 }
+
+// generate the charts that cost the most to collect, for the /api/v1/costly_charts call
+
+struct costly_chart {
+    char id[RRD_ID_LENGTH_MAX + 1];
+    char plugin[RRD_ID_LENGTH_MAX + 1];
+    char module[RRD_ID_LENGTH_MAX + 1];
+    int update_every;
+    size_t dimensions;
+    struct rrdset_cost cost;
+    size_t sort_by;
+};
+
+static int costly_chart_compare(const void *a, const void *b) {
+    const struct costly_chart *x = (const struct costly_chart *)a, *y = (const struct costly_chart *)b;
+
+    if(x->sort_by > y->sort_by) return -1;
+    if(x->sort_by < y->sort_by) return 1;
+    return strcmp(x->id, y->id);
+}
+
+void costly_charts2json(RRDHOST *host, BUFFER *wb, size_t top, COSTLY_CHARTS_SORT sort) {
+    struct costly_chart *charts = NULL;
+    size_t used = 0, size = 0, i;
+    RRDSET *st;
+
+    unsigned reader = rrdhost_charts_read_lock(host);
+    rrdset_foreach_lockless(st, host) {
+        if(unlikely(used == size)) {
+            size = (size) ? size * 2 : 256;
+            charts = reallocz(charts, size * sizeof(struct costly_chart));
+        }
+
+        struct costly_chart *c = &charts[used++];
+        strncpyz(c->id, st->id, RRD_ID_LENGTH_MAX);
+        strncpyz(c->plugin, st->plugin_name ? st->plugin_name : "", RRD_ID_LENGTH_MAX);
+        strncpyz(c->module, st->module_name ? st->module_name : "", RRD_ID_LENGTH_MAX);
+        c->update_every = st->update_every;
+
+        c->dimensions = 0;
+        RRDDIM *rd;
+        rrdset_rdlock(st);
+        rrddim_foreach_read(rd, st) c->dimensions++;
+        rrdset_unlock(st);
+
+        c->cost.collections     = __atomic_load_n(&st->cost.collections, __ATOMIC_RELAXED);
+        c->cost.done_usec       = __atomic_load_n(&st->cost.done_usec, __ATOMIC_RELAXED);
+        c->cost.pushed_bytes    = __atomic_load_n(&st->cost.pushed_bytes, __ATOMIC_RELAXED);
+        c->cost.backend_metrics = __atomic_load_n(&st->cost.backend_metrics, __ATOMIC_RELAXED);
+
+        switch(sort) {
+            case COSTLY_CHARTS_SORT_PUSHED:  c->sort_by = c->cost.pushed_bytes; break;
+            case COSTLY_CHARTS_SORT_BACKEND: c->sort_by = c->cost.backend_metrics; break;
+            default:                         c->sort_by = (size_t)c->cost.done_usec; break;
+        }
+    }
+    rrdhost_charts_read_unlock(host, reader);
+
+    if(used) qsort(charts, used, sizeof(struct costly_chart), costly_chart_compare);
+    if(top > used) top = used;
+
+    buffer_sprintf(wb, "{\n\t\"hostname\": \"%s\",\n\t\"charts_count\": %zu,\n\t\"sort\": \"%s\",\n\t\"charts\": ["
+                   , host->hostname
+                   , used
+                   , (sort == COSTLY_CHARTS_SORT_PUSHED) ? "pushed" : (sort == COSTLY_CHARTS_SORT_BACKEND) ? "backend" : "time"
+    );
+
+    for(i = 0; i < top ; i++) {
+        struct costly_chart *c = &charts[i];
+
+        buffer_sprintf(wb, "%s\n\t\t{\n\t\t\t\"id\": \"%s\",\n\t\t\t\"plugin\": \"%s\",\n\t\t\t\"module\": \"%s\""
+                           ",\n\t\t\t\"update_every\": %d,\n\t\t\t\"dimensions\": %zu,\n\t\t\t\"collections\": %zu"
+                           ",\n\t\t\t\"time_usec\": %llu,\n\t\t\t\"time_usec_per_collection\": %llu"
+                           ",\n\t\t\t\"pushed_bytes\": %zu,\n\t\t\t\"backend_metrics\": %zu\n\t\t}"
+                       , (i) ? "," : ""
+                       , c->id
+                       , c->plugin
+                       , c->module
+                       , c->update_every
+                       , c->dimensions
+                       , c->cost.collections
+                       , c->cost.done_usec
+                       , (c->cost.collections) ? c->cost.done_usec / c->cost.collections : 0ULL
+                       , c->cost.pushed_bytes
+                       , c->cost.backend_metrics
+        );
+    }
+
+    buffer_strcat(wb, "\n\t]\n}\n");
+    freez(charts);
+}
@@ -8,4 +8,12 @@
 extern void charts2json(RRDHOST *host, BUFFER *wb);
 extern void chartcollectors2json(RRDHOST *host, BUFFER *wb);
 
+typedef enum costly_charts_sort {
+    COSTLY_CHARTS_SORT_TIME,        // the time spent in rrdset_done()
+    COSTLY_CHARTS_SORT_PUSHED,      // the bytes queued for streaming
+    COSTLY_CHARTS_SORT_BACKEND      // the metrics copied for the backends
+} COSTLY_CHARTS_SORT;
+
+extern void costly_charts2json(RRDHOST *host, BUFFER *wb, size_t top, COSTLY_CHARTS_SORT sort);
+
 #endif //NETDATA_API_FORMATTER_CHARTS2JSON_H
@@ -5,6 +5,39 @@
 #define JSON_DATES_JS 1
 #define JSON_DATES_TIMESTAMP 2
 
+// the bytes reserved for every value, with its number, of every row for its date
+#define JSON_VALUE_SIZE 20
+#define JSON_DATE_SIZE 50
+
+// a dimension that is printed, with what is printed before each of its values
+struct rrdr2json_dimension {
+    long c;                 // the dimension in the RRDR
+    size_t prefix;          // the offset of its prefix in the prefixes buffer
+    size_t prefix_len;
+};
+
+// appends txt, escaping the quote it is enclosed in and backslashes
+static void rrdr2json_strcat_escaped(BUFFER *wb, const char *txt, char quote) {
+    for(; *txt ; txt++) {
+        buffer_need_bytes(wb, 3);
+        if(unlikely(*txt == quote || *txt == '\\'))
+            wb->buffer[wb->len++] = '\\';
+        wb->buffer[wb->len++] = *txt;
+    }
+    buffer_need_bytes(wb, 1);
+    wb->buffer[wb->len] = '\0';
+}
+
+static inline void rrdr2json_value(BUFFER *wb, query_number value) {
+    if(unlikely(isnan(value) || isinf(value))) {
+        buffer_fast_strcat(wb, "null", 4);
+        return;
+    }
+
+    buffer_need_bytes(wb, 50);
+    wb->len += print_calculated_number(&wb->buffer[wb->len], value);
+}
+
 void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
     rrdset_check_rdlock(r->st);
 
@@ -90,20 +123,36 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
     // -------------------------------------------------------------------------
     // print the JSON header
 
-    long c, i;
+    long c, i, dims = 0;
     RRDDIM *rd;
 
+    // the dimensions to print and the prefixes of their values, with their names escaped, are prepared once
+    struct rrdr2json_dimension *dim = mallocz(sizeof(struct rrdr2json_dimension) * (r->d ? r->d : 1));
+    BUFFER *prefixes = buffer_create(1024);
+    size_t pre_value_len = strlen(pre_value), post_value_len = strlen(post_value), row_size;
+
     // print the header lines
-    for(c = 0, i = 0, rd = r->st->dimensions; rd && c < r->d ;c++, rd = rd->next) {
+    for(c = 0, rd = r->st->dimensions; rd && c < r->d ;c++, rd = rd->next) {
         if(unlikely(r->od[c] & RRDR_DIMENSION_HIDDEN)) continue;
         if(unlikely((options & RRDR_OPTION_NONZERO) && !(r->od[c] & RRDR_DIMENSION_NONZERO))) continue;
 
         buffer_strcat(wb, pre_label);
-        buffer_strcat(wb, rd->name);
+        rrdr2json_strcat_escaped(wb, rd->name, sq[0]);
         buffer_strcat(wb, post_label);
-        i++;
+
+        dim[dims].c = c;
+        dim[dims].prefix = buffer_strlen(prefixes);
+        buffer_fast_strcat(prefixes, pre_value, pre_value_len);
+        if(options & RRDR_OPTION_OBJECTSROWS) {
+            buffer_strcat(prefixes, kq);
+            rrdr2json_strcat_escaped(prefixes, rd->name, kq[0]);
+            buffer_strcat(prefixes, kq);
+            buffer_fast_strcat(prefixes, ": ", 2);
+        }
+        dim[dims].prefix_len = buffer_strlen(prefixes) - dim[dims].prefix;
+        dims++;
     }
-    if(!i) {
+    if(!dims) {
         buffer_strcat(wb, pre_label);
         buffer_strcat(wb, "no data");
         buffer_strcat(wb, post_label);
@@ -113,11 +162,22 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
     buffer_strcat(wb, data_begin);
 
     // if all dimensions are hidden, print a null
-    if(!i) {
+    if(!dims) {
         buffer_strcat(wb, finish);
+        buffer_free(prefixes);
+        freez(dim);
         return;
     }
 
+    size_t pre_date_len = strlen(pre_date), post_date_len = strlen(post_date), post_line_len = strlen(post_line),
+           normal_annotation_len = strlen(normal_annotation), overflow_annotation_len = strlen(overflow_annotation);
+
+    // reserve all the rows at once, the values that do not fit grow the buffer as usual
+    row_size = pre_date_len + post_date_len + post_line_len + JSON_DATE_SIZE + (row_annotations ? overflow_annotation_len : 0);
+    for(i = 0; i < dims ; i++)
+        row_size += dim[i].prefix_len + JSON_VALUE_SIZE + post_value_len;
+    buffer_need_bytes(wb, row_size * (size_t)rrdr_rows(r) + strlen(finish) + 1);
+
     long start = 0, end = rrdr_rows(r), step = 1;
     if(!(options & RRDR_OPTION_REVERSED)) {
         start = rrdr_rows(r) - 1;
@@ -126,9 +186,9 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
     }
 
     // for each line in the array
-    calculated_number total = 1;
+    query_number total = 1;
     for(i = start; i != end ;i += step) {
-        calculated_number *cn = &r->v[ i * r->d ];
+        query_number *cn = &r->v[ i * r->d ];
         RRDR_VALUE_FLAGS *co = &r->o[ i * r->d ];
 
         time_t now = r->t[i];
@@ -138,18 +198,18 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
             struct tm tmbuf, *tm = localtime_r(&now, &tmbuf);
             if(!tm) { error("localtime_r() failed."); continue; }
 
-            if(likely(i != start)) buffer_strcat(wb, ",\n");
-            buffer_strcat(wb, pre_date);
+            if(likely(i != start)) buffer_fast_strcat(wb, ",\n", 2);
+            buffer_fast_strcat(wb, pre_date, pre_date_len);
 
             if( options & RRDR_OPTION_OBJECTSROWS )
                 buffer_sprintf(wb, "%stime%s: ", kq, kq);
 
             if(dates_with_new)
-                buffer_strcat(wb, "new ");
+                buffer_fast_strcat(wb, "new ", 4);
 
             buffer_jsdate(wb, tm->tm_year + 1900, tm->tm_mon, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
 
-            buffer_strcat(wb, post_date);
+            buffer_fast_strcat(wb, post_date, post_date_len);
 
             if(row_annotations) {
                 // google supports one annotation per row
@@ -158,35 +218,35 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
                     if(unlikely(!(r->od[c] & RRDR_DIMENSION_SELECTED))) continue;
 
                     if(co[c] & RRDR_VALUE_RESET) {
-                        buffer_strcat(wb, overflow_annotation);
+                        buffer_fast_strcat(wb, overflow_annotation, overflow_annotation_len);
                         annotation_found = 1;
                         break;
                     }
                 }
                 if(!annotation_found)
-                    buffer_strcat(wb, normal_annotation);
+                    buffer_fast_strcat(wb, normal_annotation, normal_annotation_len);
             }
         }
         else {
             // print the timestamp of the line
-            if(likely(i != start)) buffer_strcat(wb, ",\n");
-            buffer_strcat(wb, pre_date);
+            if(likely(i != start)) buffer_fast_strcat(wb, ",\n", 2);
+            buffer_fast_strcat(wb, pre_date, pre_date_len);
 
             if( options & RRDR_OPTION_OBJECTSROWS )
                 buffer_sprintf(wb, "%stime%s: ", kq, kq);
 
-            buffer_rrd_value(wb, (calculated_number)r->t[i]);
+            buffer_print_llu(wb, (unsigned long long)r->t[i]);
             // in ms
-            if(options & RRDR_OPTION_MILLISECONDS) buffer_strcat(wb, "000");
+            if(options & RRDR_OPTION_MILLISECONDS) buffer_fast_strcat(wb, "000", 3);
 
-            buffer_strcat(wb, post_date);
+            buffer_fast_strcat(wb, post_date, post_date_len);
         }
 
         int set_min_max = 0;
         if(unlikely(options & RRDR_OPTION_PERCENTAGE)) {
             total = 0;
             for(c = 0, rd = r->st->dimensions; rd && c < r->d ;c++, rd = rd->next) {
-                calculated_number n = cn[c];
+                query_number n = cn[c];
 
                 if(likely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
                     n = -n;
@@ -199,22 +259,18 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
         }
 
         // for each dimension
-        for(c = 0, rd = r->st->dimensions; rd && c < r->d ;c++, rd = rd->next) {
-            if(unlikely(r->od[c] & RRDR_DIMENSION_HIDDEN)) continue;
-            if(unlikely((options & RRDR_OPTION_NONZERO) && !(r->od[c] & RRDR_DIMENSION_NONZERO))) continue;
-
-            calculated_number n = cn[c];
+        long d;
+        for(d = 0; d < dims ; d++) {
+            c = dim[d].c;
+            query_number n = cn[c];
 
-            buffer_strcat(wb, pre_value);
-
-            if( options & RRDR_OPTION_OBJECTSROWS )
-                buffer_sprintf(wb, "%s%s%s: ", kq, rd->name, kq);
+            buffer_fast_strcat(wb, &prefixes->buffer[dim[d].prefix], dim[d].prefix_len);
 
             if(co[c] & RRDR_VALUE_EMPTY) {
                 if(options & RRDR_OPTION_NULL2ZERO)
-                    buffer_strcat(wb, "0");
+                    buffer_fast_strcat(wb, "0", 1);
                 else
-                    buffer_strcat(wb, "null");
+                    buffer_fast_strcat(wb, "null", 4);
             }
             else {
                 if(unlikely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
@@ -232,15 +288,17 @@ void rrdr2json(RRDR *r, BUFFER *wb, RRDR_OPTIONS options, int datatable) {
                     if(n > r->max) r->max = n;
                 }
 
-                buffer_rrd_value(wb, n);
+                rrdr2json_value(wb, n);
             }
 
-            buffer_strcat(wb, post_value);
+            buffer_fast_strcat(wb, post_value, post_value_len);
         }
 
-        buffer_strcat(wb, post_line);
+        buffer_fast_strcat(wb, post_line, post_line_len);
     }
 
     buffer_strcat(wb, finish);
+    buffer_free(prefixes);
+    freez(dim);
     //info("RRD2JSON(): %s: END", r->st->id);
 }
@@ -24,7 +24,13 @@ void rrdr_json_wrapper_begin(RRDR *r, BUFFER *wb, uint32_t format, RRDR_OPTIONS
 
     buffer_sprintf(wb, "{\n"
                        "   %sapi%s: 1,\n"
-                       "   %sid%s: %s%s%s,\n"
+                   , kq, kq);
+
+    // the query was interrupted by its deadline or by the client
+    if(r->result_options & RRDR_RESULT_OPTION_PARTIAL)
+        buffer_sprintf(wb, "   %spartial%s: true,\n", kq, kq);
+
+    buffer_sprintf(wb, "   %sid%s: %s%s%s,\n"
                        "   %sname%s: %s%s%s,\n"
                        "   %sview_update_every%s: %d,\n"
                        "   %supdate_every%s: %d,\n"
@@ -33,7 +39,6 @@ void rrdr_json_wrapper_begin(RRDR *r, BUFFER *wb, uint32_t format, RRDR_OPTIONS
                        "   %sbefore%s: %u,\n"
                        "   %safter%s: %u,\n"
                        "   %sdimension_names%s: ["
-                   , kq, kq
                    , kq, kq, sq, r->st->id, sq
                    , kq, kq, sq, r->st->name, sq
                    , kq, kq, r->update_every
@@ -121,13 +126,13 @@ void rrdr_json_wrapper_begin(RRDR *r, BUFFER *wb, uint32_t format, RRDR_OPTIONS
 
     i = 0;
     if(rows) {
-        calculated_number total = 1;
+        query_number total = 1;
 
         if(unlikely(options & RRDR_OPTION_PERCENTAGE)) {
             total = 0;
             for(c = 0, rd = r->st->dimensions; rd && c < r->d ;c++, rd = rd->next) {
-                calculated_number *cn = &r->v[ (rrdr_rows(r) - 1) * r->d ];
-                calculated_number n = cn[c];
+                query_number *cn = &r->v[ (rrdr_rows(r) - 1) * r->d ];
+                query_number n = cn[c];
 
                 if(likely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
                     n = -n;
@@ -145,9 +150,9 @@ void rrdr_json_wrapper_begin(RRDR *r, BUFFER *wb, uint32_t format, RRDR_OPTIONS
             if(i) buffer_strcat(wb, ", ");
             i++;
 
-            calculated_number *cn = &r->v[ (rrdr_rows(r) - 1) * r->d ];
+            query_number *cn = &r->v[ (rrdr_rows(r) - 1) * r->d ];
             RRDR_VALUE_FLAGS *co = &r->o[ (rrdr_rows(r) - 1) * r->d ];
-            calculated_number n = cn[c];
+            query_number n = cn[c];
 
             if(co[c] & RRDR_VALUE_EMPTY) {
                 if(options & RRDR_OPTION_NULL2ZERO)
@@ -48,6 +48,14 @@ void rrdr_buffer_print_format(BUFFER *wb, uint32_t format)  {
             buffer_strcat(wb, DATASOURCE_FORMAT_SSV_COMMA);
             break;
 
+        case DATASOURCE_BINARY:
+            buffer_strcat(wb, DATASOURCE_FORMAT_BINARY);
+            break;
+
+        case DATASOURCE_BINARY_FLOAT32:
+            buffer_strcat(wb, DATASOURCE_FORMAT_BINARY_FLOAT32);
+            break;
+
         default:
             buffer_strcat(wb, "unknown");
             break;
@@ -102,27 +110,8 @@ int rrdset2value_api_v1(
     return 200;
 }
 
-int rrdset2anything_api_v1(
-          RRDSET *st
-        , BUFFER *wb
-        , BUFFER *dimensions
-        , uint32_t format
-        , long points
-        , long long after
-        , long long before
-        , int group_method
-        , long group_time
-        , uint32_t options
-        , time_t *latest_timestamp
-) {
-    st->last_accessed_time = now_realtime_sec();
-
-    RRDR *r = rrd2rrdr(st, points, after, before, group_method, group_time, options, dimensions?buffer_tostring(dimensions):NULL);
-    if(!r) {
-        buffer_strcat(wb, "Cannot generate output with these parameters on this chart.");
-        return 500;
-    }
-
+// formats r to wb and frees it
+static int rrdr2anything(RRDR *r, BUFFER *wb, uint32_t format, uint32_t options, time_t *latest_timestamp) {
     if(r->result_options & RRDR_RESULT_OPTION_RELATIVE)
         buffer_no_cacheable(wb);
     else if(r->result_options & RRDR_RESULT_OPTION_ABSOLUTE)
@@ -244,6 +233,13 @@ int rrdset2anything_api_v1(
         }
         break;
 
+    case DATASOURCE_BINARY:
+    case DATASOURCE_BINARY_FLOAT32:
+        // there is no JSON wrapper for binary data, the header has the metadata
+        wb->contenttype = CT_APPLICATION_OCTET_STREAM;
+        rrdr2binary(r, wb, options, format == DATASOURCE_BINARY_FLOAT32);
+        break;
+
     case DATASOURCE_DATATABLE_JSONP:
         wb->contenttype = CT_APPLICATION_X_JAVASCRIPT;
 
@@ -296,3 +292,280 @@ int rrdset2anything_api_v1(
     rrdr_free(r);
     return 200;
 }
+
+static int rrdset2anything_api_v1_query(
+          RRDSET *st
+        , BUFFER *wb
+        , BUFFER *dimensions
+        , uint32_t format
+        , long points
+        , long long after
+        , long long before
+        , int group_method
+        , long group_time
+        , uint32_t options
+        , time_t *latest_timestamp
+) {
+    st->last_accessed_time = now_realtime_coarse_sec();
+
+    RRDR *r = rrd2rrdr(st, points, after, before, group_method, group_time, options, dimensions?buffer_tostring(dimensions):NULL);
+    if(!r) {
+        buffer_strcat(wb, "Cannot generate output with these parameters on this chart.");
+        return 500;
+    }
+
+    return rrdr2anything(r, wb, format, options, latest_timestamp);
+}
+
+// ----------------------------------------------------------------------------
+// context queries
+//
+// All the charts of a context (optionally only those matching a pattern) are
+// queried with the same parameters and their values are aggregated into the
+// result of the first one, so that a dashboard gets e.g. the total disk.io of
+// all its disks with one request. The dimensions of each chart are queried in
+// parallel by the query threads, like in any other query.
+
+int rrdcontext2anything_api_v1(
+          RRDHOST *host
+        , const char *context
+        , SIMPLE_PATTERN *charts
+        , RRDR_CHARTS_AGGREGATION aggregation
+        , BUFFER *wb
+        , BUFFER *dimensions
+        , uint32_t format
+        , long points
+        , long long after
+        , long long before
+        , int group_method
+        , long group_time
+        , uint32_t options
+        , time_t *latest_timestamp
+) {
+    uint32_t hash = simple_hash(context);
+    time_t now = now_realtime_coarse_sec();
+    RRDR *r = NULL;
+    uint32_t *counts = NULL;
+    int ret;
+
+    // the charts are not freed while the host is read locked
+    rrdhost_rdlock(host);
+
+    RRDSET *st;
+    rrdset_foreach_read(st, host) {
+        if(st->hash_context != hash || strcmp(st->context, context) || !rrdset_is_available_for_viewers(st))
+            continue;
+
+        if(charts && !simple_pattern_matches(charts, st->id) && !simple_pattern_matches(charts, st->name))
+            continue;
+
+        st->last_accessed_time = now;
+
+        RRDR *m = rrd2rrdr(st, points, after, before, group_method, group_time, options, dimensions?buffer_tostring(dimensions):NULL);
+        if(!m) continue;
+
+        if(!r || (!rrdr_rows(r) && rrdr_rows(m))) {
+            // the first chart with values collects the values of the others
+            if(r) {
+                freez(counts);
+                rrdr_free(r);
+            }
+            r = m;
+            counts = rrdr_aggregation_start(r);
+        }
+        else {
+            rrdr_aggregate(r, m, aggregation, counts);
+            rrdr_free(m);
+        }
+    }
+
+    if(!r) {
+        rrdhost_unlock(host);
+        buffer_strcat(wb, "No charts found for context: ");
+        buffer_strcat_htmlescape(wb, context);
+        return 404;
+    }
+
+    rrdr_aggregation_done(r, aggregation, counts);
+    ret = rrdr2anything(r, wb, format, options, latest_timestamp);
+
+    rrdhost_unlock(host);
+    return ret;
+}
+
+// ----------------------------------------------------------------------------
+// query cache
+//
+// Dashboards with many viewers send the same queries for the same charts, every
+// time the charts are updated. The output of a query is kept until its chart is
+// updated again, so that all the viewers get it from the cache, except the first.
+// Queries with relative timeframes give the same output between updates too.
+
+#define QUERY_CACHE_MAX_OUTPUT (1024 * 1024)        // bigger outputs are not cached
+
+struct query_cache_entry {
+    uint32_t hash;
+    char *key;                      // the normalized parameters of the query
+
+    RRDSET *st;                     // it is only compared, the chart may not exist any more
+    size_t counter_done;            // the update of the chart the output was generated from
+    struct timeval last_updated;
+
+    usec_t last_used;
+    int ret;
+    uint8_t contenttype;
+    uint8_t options;
+    time_t latest_timestamp;
+    BUFFER *output;
+};
+
+static struct query_cache {
+    size_t entries;                 // 0 when the cache is disabled
+    struct query_cache_entry *entry;
+    netdata_rwlock_t rwlock;
+
+    size_t hits;                    // atomic
+    size_t misses;                  // atomic
+} query_cache = {
+        .entries = 0,
+        .entry = NULL,
+        .rwlock = NETDATA_RWLOCK_INITIALIZER,
+        .hits = 0,
+        .misses = 0
+};
+
+void rrdset2anything_cache_init(void) {
+    long entries = config_get_number(CONFIG_SECTION_WEB, "query cache entries", 64);
+    if(entries < 0) entries = 0;
+
+    netdata_rwlock_wrlock(&query_cache.rwlock);
+    if(!query_cache.entry && entries) {
+        query_cache.entry = callocz((size_t)entries, sizeof(struct query_cache_entry));
+        query_cache.entries = (size_t)entries;
+    }
+    netdata_rwlock_unlock(&query_cache.rwlock);
+}
+
+void rrdset2anything_cache_statistics(size_t *hits, size_t *misses) {
+    *hits = __atomic_load_n(&query_cache.hits, __ATOMIC_RELAXED);
+    *misses = __atomic_load_n(&query_cache.misses, __ATOMIC_RELAXED);
+}
+
+static inline int query_cache_entry_is_valid(struct query_cache_entry *e, RRDSET *st, uint32_t hash, const char *key, size_t counter_done, struct timeval *last_updated) {
+    return e->key && e->hash == hash && e->st == st && e->counter_done == counter_done
+           && e->last_updated.tv_sec == last_updated->tv_sec && e->last_updated.tv_usec == last_updated->tv_usec
+           && !strcmp(e->key, key);
+}
+
+int rrdset2anything_api_v1(
+          RRDSET *st
+        , BUFFER *wb
+        , BUFFER *dimensions
+        , uint32_t format
+        , long points
+        , long long after
+        , long long before
+        , int group_method
+        , long group_time
+        , uint32_t options
+        , time_t *latest_timestamp
+) {
+    char key[1024 + 1];
+    uint32_t hash;
+    size_t i, len, counter_done;
+    struct timeval last_updated;
+    int ret;
+
+    if(!query_cache.entries)
+        return rrdset2anything_api_v1_query(st, wb, dimensions, format, points, after, before, group_method, group_time, options, latest_timestamp);
+
+    // a collection that completes while the query runs makes the output stale at once, never old
+    counter_done = __atomic_load_n(&st->counter_done, __ATOMIC_ACQUIRE);
+    last_updated = st->last_updated;
+
+    len = (size_t)snprintfz(key, 1024, "%u|%ld|%lld|%lld|%d|%ld|%u|%s",
+                            format, points, after, before, group_method, group_time, options,
+                            dimensions ? buffer_tostring(dimensions) : "");
+    if(unlikely(len >= 1024))
+        return rrdset2anything_api_v1_query(st, wb, dimensions, format, points, after, before, group_method, group_time, options, latest_timestamp);
+
+    hash = simple_hash(key);
+
+    netdata_rwlock_rdlock(&query_cache.rwlock);
+    for(i = 0; i < query_cache.entries ; i++) {
+        struct query_cache_entry *e = &query_cache.entry[i];
+
+        if(query_cache_entry_is_valid(e, st, hash, key, counter_done, &last_updated)) {
+            buffer_need_bytes(wb, buffer_strlen(e->output) + 1);
+            memcpy(&wb->buffer[wb->len], e->output->buffer, buffer_strlen(e->output) + 1);
+            wb->len += buffer_strlen(e->output);
+            wb->contenttype = e->contenttype;
+            if(e->options & WB_CONTENT_CACHEABLE) buffer_cacheable(wb);
+            else if(e->options & WB_CONTENT_NO_CACHEABLE) buffer_no_cacheable(wb);
+            if(latest_timestamp && e->latest_timestamp) *latest_timestamp = e->latest_timestamp;
+            ret = e->ret;
+
+            __atomic_store_n(&e->last_used, now_monotonic_usec(), __ATOMIC_RELAXED);
+            netdata_rwlock_unlock(&query_cache.rwlock);
+
+            __atomic_add_fetch(&query_cache.hits, 1, __ATOMIC_RELAXED);
+            return ret;
+        }
+    }
+    netdata_rwlock_unlock(&query_cache.rwlock);
+
+    __atomic_add_fetch(&query_cache.misses, 1, __ATOMIC_RELAXED);
+
+    size_t start = buffer_strlen(wb);
+    time_t timestamp = 0;
+
+    ret = rrdset2anything_api_v1_query(st, wb, dimensions, format, points, after, before, group_method, group_time, options, &timestamp);
+    if(latest_timestamp && timestamp) *latest_timestamp = timestamp;
+
+    // the output of an interrupted query is partial
+    if(ret != 200 || buffer_strlen(wb) - start > QUERY_CACHE_MAX_OUTPUT || rrd2rrdr_interrupted())
+        return ret;
+
+    // replace the least recently used entry
+    netdata_rwlock_wrlock(&query_cache.rwlock);
+    struct query_cache_entry *e = &query_cache.entry[0];
+    for(i = 0; i < query_cache.entries ; i++) {
+        struct query_cache_entry *t = &query_cache.entry[i];
+
+        if(query_cache_entry_is_valid(t, st, hash, key, counter_done, &last_updated)) {
+            // another thread cached the same output in the meantime
+            e = NULL;
+            break;
+        }
+
+        if(!t->key || t->last_used < e->last_used)
+            e = t;
+
+        if(!t->key)
+            break;
+    }
+
+    if(e) {
+        freez(e->key);
+        if(!e->output) e->output = buffer_create(buffer_strlen(wb) - start + 1);
+        buffer_flush(e->output);
+        buffer_need_bytes(e->output, buffer_strlen(wb) - start + 1);
+        memcpy(e->output->buffer, &wb->buffer[start], buffer_strlen(wb) - start);
+        e->output->len = buffer_strlen(wb) - start;
+        e->output->buffer[e->output->len] = '\0';
+
+        e->key = strdupz(key);
+        e->hash = hash;
+        e->st = st;
+        e->counter_done = counter_done;
+        e->last_updated = last_updated;
+        e->last_used = now_monotonic_usec();
+        e->ret = ret;
+        e->contenttype = wb->contenttype;
+        e->options = wb->options & (WB_CONTENT_CACHEABLE | WB_CONTENT_NO_CACHEABLE);
+        e->latest_timestamp = timestamp;
+    }
+    netdata_rwlock_unlock(&query_cache.rwlock);
+
+    return ret;
+}
@@ -8,6 +8,7 @@
 #include "web/api/queries/rrdr.h"
 
 #include "web/api/formatters/csv/csv.h"
+#include "web/api/formatters/binary/binary.h"
 #include "web/api/formatters/ssv/ssv.h"
 #include "web/api/formatters/json/json.h"
 #include "web/api/formatters/value/value.h"
@@ -34,6 +35,8 @@
 #define DATASOURCE_SSV_COMMA 9
 #define DATASOURCE_CSV_JSON_ARRAY 10
 #define DATASOURCE_CSV_MARKDOWN 11
+#define DATASOURCE_BINARY 12
+#define DATASOURCE_BINARY_FLOAT32 13
 
 #define DATASOURCE_FORMAT_JSON "json"
 #define DATASOURCE_FORMAT_DATATABLE_JSON "datatable"
@@ -47,6 +50,8 @@
 #define DATASOURCE_FORMAT_SSV_COMMA "ssvcomma"
 #define DATASOURCE_FORMAT_CSV_JSON_ARRAY "csvjsonarray"
 #define DATASOURCE_FORMAT_CSV_MARKDOWN "markdown"
+#define DATASOURCE_FORMAT_BINARY "binary"
+#define DATASOURCE_FORMAT_BINARY_FLOAT32 "binary32"
 
 extern void rrd_stats_api_v1_chart(RRDSET *st, BUFFER *wb);
 extern void rrdr_buffer_print_format(BUFFER *wb, uint32_t format);
@@ -65,6 +70,26 @@ extern int rrdset2anything_api_v1(
         , time_t *latest_timestamp
 );
 
+extern int rrdcontext2anything_api_v1(
+          RRDHOST *host
+        , const char *context
+        , SIMPLE_PATTERN *charts
+        , RRDR_CHARTS_AGGREGATION aggregation
+        , BUFFER *wb
+        , BUFFER *dimensions
+        , uint32_t format
+        , long points
+        , long long after
+        , long long before
+        , int group_method
+        , long group_time
+        , uint32_t options
+        , time_t *latest_timestamp
+);
+
+extern void rrdset2anything_cache_init(void);
+extern void rrdset2anything_cache_statistics(size_t *hits, size_t *misses);
+
 extern int rrdset2value_api_v1(
           RRDSET *st
         , BUFFER *wb
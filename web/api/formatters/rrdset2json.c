@@ -4,12 +4,10 @@
 
 // generate JSON for the /api/v1/chart API call
 
-void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memory_used) {
-    rrdset_rdlock(st);
-
-    time_t first_entry_t = rrdset_first_entry_t(st);
-    time_t last_entry_t  = rrdset_last_entry_t(st);
-
+// generates the parts of the JSON of the chart that change only when its definition changes:
+// the part before the first and last entries of the database and, after split,
+// the part after them, up to the green threshold
+static void rrdset2json_definition(RRDSET *st, BUFFER *wb, size_t *split, size_t *dimensions_count, unsigned long *memory_used) {
     buffer_sprintf(wb,
             "\t\t{\n"
             "\t\t\t\"id\": \"%s\",\n"
@@ -25,11 +23,6 @@ void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memor
             "\t\t\t\"units\": \"%s\",\n"
             "\t\t\t\"data_url\": \"/api/v1/data?chart=%s\",\n"
             "\t\t\t\"chart_type\": \"%s\",\n"
-            "\t\t\t\"duration\": %ld,\n"
-            "\t\t\t\"first_entry\": %ld,\n"
-            "\t\t\t\"last_entry\": %ld,\n"
-            "\t\t\t\"update_every\": %d,\n"
-            "\t\t\t\"dimensions\": {\n"
                    , st->id
                    , st->name
                    , st->type
@@ -43,9 +36,13 @@ void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memor
                    , st->units
                    , st->name
                    , rrdset_type_name(st->chart_type)
-                   , last_entry_t - first_entry_t + st->update_every//st->entries * st->update_every
-                   , first_entry_t//rrdset_first_entry_t(st)
-                   , last_entry_t//rrdset_last_entry_t(st)
+    );
+
+    *split = buffer_strlen(wb);
+
+    buffer_sprintf(wb,
+            "\t\t\t\"update_every\": %d,\n"
+            "\t\t\t\"dimensions\": {\n"
                    , st->update_every
     );
 
@@ -70,10 +67,89 @@ void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memor
         dimensions++;
     }
 
-    if(dimensions_count) *dimensions_count += dimensions;
-    if(memory_used) *memory_used += memory;
+    *dimensions_count = dimensions;
+    *memory_used = memory;
 
     buffer_strcat(wb, "\n\t\t\t},\n\t\t\t\"green\": ");
+}
+
+// the json snapshot of the chart, generated again when its definition has changed
+// the caller has to be between rrdhost_json_read_lock() and rrdhost_json_read_unlock()
+static RRDSET_JSON_SNAPSHOT *rrdset2json_snapshot(RRDSET *st) {
+    // read before the chart, so that a change while it is generated is not missed
+    size_t generation = __atomic_load_n(&st->json_generation, __ATOMIC_ACQUIRE);
+
+    RRDSET_JSON_SNAPSHOT *old = __atomic_load_n(&st->json_snapshot, __ATOMIC_ACQUIRE);
+    if(likely(old && old->generation == generation))
+        return old;
+
+    size_t split, dimensions;
+    unsigned long memory;
+    BUFFER *wb = buffer_create(1024);
+
+    rrdset_rdlock(st);
+    rrdset2json_definition(st, wb, &split, &dimensions, &memory);
+    rrdset_unlock(st);
+
+    RRDSET_JSON_SNAPSHOT *s = mallocz(sizeof(RRDSET_JSON_SNAPSHOT) + buffer_strlen(wb) + 1);
+    s->generation = generation;
+    s->split = split;
+    s->dimensions = dimensions;
+    s->memory = memory;
+    s->next = NULL;
+    s->len = buffer_strlen(wb);
+    memcpy(s->json, buffer_tostring(wb), s->len + 1);
+    buffer_free(wb);
+
+    if(likely(__atomic_compare_exchange_n(&st->json_snapshot, &old, s, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))) {
+        if(old) rrdhost_json_snapshot_replaced(st->rrdhost, old);
+        return s;
+    }
+
+    // another reader replaced it at the same time, old is its snapshot
+    freez(s);
+    return old;
+}
+
+// frees the json snapshots replaced, after their readers are gone
+// the caller has to hold the charts_json_mutex of the host and not be a reader of the snapshots
+void rrdset2json_free_replaced_nolock(RRDHOST *host) {
+    if(likely(!__atomic_load_n(&host->json_snapshots_replaced, __ATOMIC_ACQUIRE)))
+        return;
+
+    RRDSET_JSON_SNAPSHOT *s = __atomic_exchange_n(&host->json_snapshots_replaced, NULL, __ATOMIC_ACQ_REL);
+    netdata_epoch_synchronize(&host->json_snapshots_epoch);
+
+    while(s) {
+        RRDSET_JSON_SNAPSHOT *next = s->next;
+        freez(s);
+        s = next;
+    }
+}
+
+// the chart definition is copied from its snapshot, without the locks of the collectors
+// the caller has to be between rrdhost_json_read_lock() and rrdhost_json_read_unlock()
+void rrdset2json_nolock(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memory_used) {
+    RRDSET_JSON_SNAPSHOT *s = rrdset2json_snapshot(st);
+
+    time_t first_entry_t = rrdset_first_entry_t(st);
+    time_t last_entry_t  = rrdset_last_entry_t(st);
+
+    buffer_fast_strcat(wb, s->json, s->split);
+
+    buffer_sprintf(wb,
+            "\t\t\t\"duration\": %ld,\n"
+            "\t\t\t\"first_entry\": %ld,\n"
+            "\t\t\t\"last_entry\": %ld,\n"
+                   , last_entry_t - first_entry_t + st->update_every//st->entries * st->update_every
+                   , first_entry_t//rrdset_first_entry_t(st)
+                   , last_entry_t//rrdset_last_entry_t(st)
+    );
+
+    buffer_fast_strcat(wb, &s->json[s->split], s->len - s->split);
+
+    if(dimensions_count) *dimensions_count += s->dimensions;
+    if(memory_used) *memory_used += s->memory;
     buffer_rrd_value(wb, st->green);
     buffer_strcat(wb, ",\n\t\t\t\"red\": ");
     buffer_rrd_value(wb, st->red);
@@ -106,6 +182,18 @@ void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memor
     buffer_sprintf(wb,
             "\n\t\t\t}\n\t\t}"
     );
+}
 
-    rrdset_unlock(st);
+void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memory_used) {
+    RRDHOST *host = st->rrdhost;
+
+    unsigned reader = rrdhost_json_read_lock(host);
+    rrdset2json_nolock(st, wb, dimensions_count, memory_used);
+    rrdhost_json_read_unlock(host, reader);
+
+    if(unlikely(__atomic_load_n(&host->json_snapshots_replaced, __ATOMIC_ACQUIRE))) {
+        netdata_mutex_lock(&host->charts_json_mutex);
+        rrdset2json_free_replaced_nolock(host);
+        netdata_mutex_unlock(&host->charts_json_mutex);
+    }
 }
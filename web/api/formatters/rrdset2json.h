@@ -6,5 +6,7 @@
 #include "rrd2json.h"
 
 extern void rrdset2json(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memory_used);
+extern void rrdset2json_nolock(RRDSET *st, BUFFER *wb, size_t *dimensions_count, size_t *memory_used);
+extern void rrdset2json_free_replaced_nolock(RRDHOST *host);
 
 #endif //NETDATA_API_FORMATTER_RRDSET2JSON_H
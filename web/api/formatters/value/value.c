@@ -3,24 +3,24 @@
 #include "value.h"
 
 
-inline calculated_number rrdr2value(RRDR *r, long i, RRDR_OPTIONS options, int *all_values_are_null) {
+inline query_number rrdr2value(RRDR *r, long i, RRDR_OPTIONS options, int *all_values_are_null) {
     rrdset_check_rdlock(r->st);
 
     long c;
     RRDDIM *d;
 
-    calculated_number *cn = &r->v[ i * r->d ];
+    query_number *cn = &r->v[ i * r->d ];
     RRDR_VALUE_FLAGS *co = &r->o[ i * r->d ];
 
-    calculated_number sum = 0, min = 0, max = 0, v;
+    query_number sum = 0, min = 0, max = 0, v;
     int all_null = 1, init = 1;
 
-    calculated_number total = 1;
+    query_number total = 1;
     int set_min_max = 0;
     if(unlikely(options & RRDR_OPTION_PERCENTAGE)) {
         total = 0;
         for(c = 0, d = r->st->dimensions; d && c < r->d ;c++, d = d->next) {
-            calculated_number n = cn[c];
+            query_number n = cn[c];
 
             if(likely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
                 n = -n;
@@ -37,7 +37,7 @@ inline calculated_number rrdr2value(RRDR *r, long i, RRDR_OPTIONS options, int *
         if(unlikely(r->od[c] & RRDR_DIMENSION_HIDDEN)) continue;
         if(unlikely((options & RRDR_OPTION_NONZERO) && !(r->od[c] & RRDR_DIMENSION_NONZERO))) continue;
 
-        calculated_number n = cn[c];
+        query_number n = cn[c];
 
         if(likely((options & RRDR_OPTION_ABSOLUTE) && n < 0))
             n = -n;
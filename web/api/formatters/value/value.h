@@ -5,6 +5,6 @@
 
 #include "../rrd2json.h"
 
-extern calculated_number rrdr2value(RRDR *r, long i, RRDR_OPTIONS options, int *all_values_are_null);
+extern query_number rrdr2value(RRDR *r, long i, RRDR_OPTIONS options, int *all_values_are_null);
 
 #endif //NETDATA_API_FORMATTER_VALUE_H
@@ -0,0 +1,364 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "web/api/formatters/rrd2json.h"
+#include "correlations.h"
+
+// ----------------------------------------------------------------------------
+// metric correlations
+//
+// Finds the dimensions of a host that changed the most between a baseline
+// timeframe and a highlighted one. Each dimension is queried for both, and
+// the distributions of its values are compared with the two-sample
+// Kolmogorov-Smirnov statistic (the largest distance of their cumulative
+// distributions, 0 when they are the same, 1 when they do not overlap).
+//
+// The charts are shared by a few threads and the query stops at a time budget,
+// so the result is the top of the dimensions checked until then.
+
+static struct {
+    int threads;
+} correlations = {
+        .threads = 1
+};
+
+void metric_correlations_init(void) {
+    long threads = config_get_number(CONFIG_SECTION_WEB, "metric correlations threads", (processors > 1) ? processors / 2 : 1);
+    if(threads < 1) threads = 1;
+    if(threads > 64) threads = 64;
+    correlations.threads = (int)threads;
+}
+
+struct correlation {
+    char *chart;
+    char *dimension;
+    query_number score;
+};
+
+struct correlations_job {
+    RRDSET **charts;
+    size_t charts_count;
+    size_t next_chart;                  // atomic
+
+    long long after;
+    long long before;
+    long long baseline_after;
+    long long baseline_before;
+    long points;
+    long baseline_points;               // at the same resolution as the highlighted timeframe
+    usec_t stop_ut;                     // the monotonic time to stop at
+    size_t max_items;
+
+    size_t charts_checked;              // atomic
+    size_t dimensions_checked;          // atomic
+    int timed_out;
+};
+
+struct correlations_worker {
+    netdata_thread_t thread;
+    struct correlations_job *job;
+
+    // the best of the dimensions this worker checked, ordered by score, highest first
+    struct correlation *top;
+    size_t used;
+};
+
+static int query_number_compare(const void *a, const void *b) {
+    query_number x = *(const query_number *)a, y = *(const query_number *)b;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+// the two-sample Kolmogorov-Smirnov statistic - it sorts the samples
+static query_number ks_2samp(query_number *a, size_t na, query_number *b, size_t nb) {
+    qsort(a, na, sizeof(query_number), query_number_compare);
+    qsort(b, nb, sizeof(query_number), query_number_compare);
+
+    query_number d = 0;
+    size_t i = 0, j = 0;
+    while(i < na && j < nb) {
+        query_number x = (a[i] < b[j]) ? a[i] : b[j];
+        while(i < na && a[i] <= x) i++;
+        while(j < nb && b[j] <= x) j++;
+
+        query_number diff = (query_number)i / (query_number)na - (query_number)j / (query_number)nb;
+        if(diff < 0) diff = -diff;
+        if(diff > d) d = diff;
+    }
+
+    return d;
+}
+
+static void correlations_worker_add(struct correlations_worker *wk, RRDSET *st, RRDDIM *rd, query_number score) {
+    size_t max = wk->job->max_items;
+
+    if(wk->used == max) {
+        if(score <= wk->top[max - 1].score)
+            return;
+
+        // drop the last one
+        wk->used--;
+        freez(wk->top[wk->used].chart);
+        freez(wk->top[wk->used].dimension);
+    }
+
+    size_t i = wk->used++;
+    for(; i > 0 && wk->top[i - 1].score < score ; i--)
+        wk->top[i] = wk->top[i - 1];
+
+    wk->top[i].chart = strdupz(st->id);
+    wk->top[i].dimension = strdupz(rd->name);
+    wk->top[i].score = score;
+}
+
+// copies the values of dimension c of r, without the empty ones
+static size_t rrdr_dimension_values(RRDR *r, int c, query_number *values) {
+    long i;
+    size_t count = 0;
+
+    for(i = 0; i < rrdr_rows(r) ; i++) {
+        if(r->o[i * r->d + c] & RRDR_VALUE_EMPTY) continue;
+        values[count++] = r->v[i * r->d + c];
+    }
+
+    return count;
+}
+
+static void correlations_chart(struct correlations_worker *wk, RRDSET *st) {
+    struct correlations_job *job = wk->job;
+
+    // the baseline is copied and freed before the highlighted timeframe is queried,
+    // to have one query at a time on the chart
+    RRDR *r = rrd2rrdr(st, job->baseline_points, job->baseline_after, job->baseline_before, RRDR_GROUPING_AVERAGE, 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+    if(!r) return;
+
+    int c, dimensions = r->d;
+    long baseline_rows = rrdr_rows(r);
+    if(!dimensions || baseline_rows < 2) {
+        rrdr_free(r);
+        return;
+    }
+
+    query_number *baseline = mallocz(dimensions * baseline_rows * sizeof(query_number));
+    size_t *baseline_count = mallocz(dimensions * sizeof(size_t));
+    for(c = 0; c < dimensions ; c++)
+        baseline_count[c] = rrdr_dimension_values(r, c, &baseline[c * baseline_rows]);
+
+    rrdr_free(r);
+
+    r = rrd2rrdr(st, job->points, job->after, job->before, RRDR_GROUPING_AVERAGE, 0, RRDR_OPTION_NOT_ALIGNED, NULL);
+    if(r && rrdr_rows(r) >= 2) {
+        query_number *highlight = mallocz(rrdr_rows(r) * sizeof(query_number));
+        RRDDIM *rd;
+
+        for(c = 0, rd = st->dimensions; rd && c < dimensions && c < r->d ; c++, rd = rd->next) {
+            if(r->od[c] & RRDR_DIMENSION_HIDDEN || baseline_count[c] < 2)
+                continue;
+
+            size_t highlight_count = rrdr_dimension_values(r, c, highlight);
+            if(highlight_count < 2)
+                continue;
+
+            query_number score = ks_2samp(&baseline[c * baseline_rows], baseline_count[c], highlight, highlight_count);
+            correlations_worker_add(wk, st, rd, score);
+            __atomic_add_fetch(&job->dimensions_checked, 1, __ATOMIC_RELAXED);
+        }
+
+        freez(highlight);
+    }
+
+    if(r) rrdr_free(r);
+    freez(baseline_count);
+    freez(baseline);
+}
+
+static void *correlations_worker_main(void *ptr) {
+    struct correlations_worker *wk = ptr;
+    struct correlations_job *job = wk->job;
+    size_t i;
+
+    while((i = __atomic_fetch_add(&job->next_chart, 1, __ATOMIC_RELAXED)) < job->charts_count) {
+        if(now_monotonic_usec() > job->stop_ut) {
+            job->timed_out = 1;
+            break;
+        }
+
+        correlations_chart(wk, job->charts[i]);
+        __atomic_add_fetch(&job->charts_checked, 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static int correlation_compare(const void *a, const void *b) {
+    query_number x = ((const struct correlation *)a)->score, y = ((const struct correlation *)b)->score;
+    return (x > y) ? -1 : (x < y) ? 1 : 0;
+}
+
+static inline long long correlations_absolute_time(long long t, long long relative_to) {
+    if(((t < 0) ? -t : t) <= API_RELATIVE_TIME_MAX)
+        return relative_to + t;
+
+    return t;
+}
+
+int metric_correlations(
+          RRDHOST *host
+        , BUFFER *wb
+        , long long after
+        , long long before
+        , long long baseline_after
+        , long long baseline_before
+        , long points
+        , size_t max_items
+        , usec_t timeout_ut
+) {
+    usec_t started_ut = now_monotonic_usec();
+
+    // make the timeframes absolute, so that all the charts are compared at the same time
+    before = correlations_absolute_time(before, now_realtime_sec());
+    if(!after) after = -300;
+    after = correlations_absolute_time(after, before);
+
+    if(after >= before) {
+        buffer_strcat(wb, "The highlighted timeframe is empty.");
+        return 400;
+    }
+
+    // by default, the baseline is the 4 times longer timeframe before the highlighted one
+    baseline_before = (baseline_before) ? correlations_absolute_time(baseline_before, after) : after;
+    baseline_after = (baseline_after) ? correlations_absolute_time(baseline_after, baseline_before) : baseline_before - 4 * (before - after);
+
+    if(baseline_after >= baseline_before) {
+        buffer_strcat(wb, "The baseline timeframe is empty.");
+        return 400;
+    }
+
+    if(points < 2) points = 100;
+    if(!max_items) max_items = 50;
+
+    // compare the values at the same resolution, up to 10 times the points for the baseline
+    long long baseline_points = points * (baseline_before - baseline_after) / (before - after);
+    if(baseline_points > 10 * points) baseline_points = 10 * points;
+    if(baseline_points < 2) baseline_points = 2;
+
+    struct correlations_job job = {
+            .charts = NULL,
+            .charts_count = 0,
+            .next_chart = 0,
+            .after = after,
+            .before = before,
+            .baseline_after = baseline_after,
+            .baseline_before = baseline_before,
+            .points = points,
+            .baseline_points = (long)baseline_points,
+            .stop_ut = started_ut + timeout_ut,
+            .max_items = max_items,
+            .charts_checked = 0,
+            .dimensions_checked = 0,
+            .timed_out = 0
+    };
+
+    // the charts are not freed while the host is read locked
+    rrdhost_rdlock(host);
+
+    size_t size = 0;
+    RRDSET *st;
+    rrdset_foreach_read(st, host) {
+        if(!rrdset_is_available_for_viewers(st))
+            continue;
+
+        if(job.charts_count == size) {
+            size = (size) ? size * 2 : 256;
+            job.charts = reallocz(job.charts, size * sizeof(RRDSET *));
+        }
+        job.charts[job.charts_count++] = st;
+    }
+
+    int threads = correlations.threads, t;
+    if((size_t)threads > job.charts_count) threads = (job.charts_count) ? (int)job.charts_count : 1;
+
+    struct correlations_worker *workers = callocz(threads, sizeof(struct correlations_worker));
+    for(t = 0; t < threads ; t++) {
+        workers[t].job = &job;
+        workers[t].top = mallocz(max_items * sizeof(struct correlation));
+    }
+
+    // this thread is the first worker
+    int started = 1;
+    for(t = 1; t < threads ; t++, started++) {
+        if(netdata_thread_create(&workers[t].thread, "CORRELATIONS", NETDATA_THREAD_OPTION_JOINABLE|NETDATA_THREAD_OPTION_DONT_LOG, correlations_worker_main, &workers[t]))
+            break;
+    }
+
+    correlations_worker_main(&workers[0]);
+
+    // the workers are on our stack, wait for them even when cancelled
+    netdata_thread_disable_cancelability();
+    for(t = 1; t < started ; t++)
+        netdata_thread_join(workers[t].thread, NULL);
+    netdata_thread_enable_cancelability();
+
+    rrdhost_unlock(host);
+
+    // merge the best of all the workers
+    size_t i, all = 0;
+    for(t = 0; t < started ; t++) all += workers[t].used;
+
+    struct correlation *top = mallocz((all ? all : 1) * sizeof(struct correlation));
+    for(t = 0, all = 0; t < started ; t++) {
+        memcpy(&top[all], workers[t].top, workers[t].used * sizeof(struct correlation));
+        all += workers[t].used;
+    }
+    qsort(top, all, sizeof(struct correlation), correlation_compare);
+
+    wb->contenttype = CT_APPLICATION_JSON;
+    buffer_sprintf(wb,
+                   "{\n"
+                   "\t\"after\": %lld,\n"
+                   "\t\"before\": %lld,\n"
+                   "\t\"baseline_after\": %lld,\n"
+                   "\t\"baseline_before\": %lld,\n"
+                   "\t\"points\": %ld,\n"
+                   "\t\"charts\": %zu,\n"
+                   "\t\"charts_checked\": %zu,\n"
+                   "\t\"dimensions_checked\": %zu,\n"
+                   "\t\"threads\": %d,\n"
+                   "\t\"timed_out\": %s,\n"
+                   "\t\"duration_ms\": %llu,\n"
+                   "\t\"correlated_dimensions\": ["
+                   , after
+                   , before
+                   , baseline_after
+                   , baseline_before
+                   , points
+                   , job.charts_count
+                   , job.charts_checked
+                   , job.dimensions_checked
+                   , started
+                   , (job.timed_out) ? "true" : "false"
+                   , (now_monotonic_usec() - started_ut) / USEC_PER_MS
+    );
+
+    for(i = 0; i < all ; i++) {
+        if(i < max_items) {
+            buffer_sprintf(wb, "%s\n\t\t{ \"chart\": \"", (i) ? "," : "");
+            buffer_strcat_json_escaped(wb, top[i].chart);
+            buffer_strcat(wb, "\", \"dimension\": \"");
+            buffer_strcat_json_escaped(wb, top[i].dimension);
+            buffer_sprintf(wb, "\", \"score\": %0.5" LONG_DOUBLE_MODIFIER " }", (LONG_DOUBLE)top[i].score);
+        }
+
+        freez(top[i].chart);
+        freez(top[i].dimension);
+    }
+
+    buffer_strcat(wb, "\n\t]\n}\n");
+
+    for(t = 0; t < threads ; t++)
+        freez(workers[t].top);
+    freez(workers);
+    freez(top);
+    freez(job.charts);
+
+    buffer_no_cacheable(wb);
+    return 200;
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_API_QUERIES_CORRELATIONS_H
+#define NETDATA_API_QUERIES_CORRELATIONS_H 1
+
+#include "libnetdata/libnetdata.h"
+
+extern void metric_correlations_init(void);
+
+extern int metric_correlations(
+          struct rrdhost *host
+        , BUFFER *wb
+        , long long after
+        , long long before
+        , long long baseline_after
+        , long long baseline_before
+        , long points
+        , size_t max_items
+        , usec_t timeout_ut
+);
+
+#endif //NETDATA_API_QUERIES_CORRELATIONS_H
@@ -8,13 +8,13 @@
 // single exponential smoothing
 
 struct grouping_des {
-    calculated_number alpha;
-    calculated_number alpha_other;
-    calculated_number beta;
-    calculated_number beta_other;
+    query_number alpha;
+    query_number alpha_other;
+    query_number beta;
+    query_number beta_other;
 
-    calculated_number level;
-    calculated_number trend;
+    query_number level;
+    query_number trend;
 
     size_t count;
 };
@@ -31,10 +31,10 @@ void grouping_init_des(void) {
     }
 }
 
-static inline calculated_number window(RRDR *r, struct grouping_des *g) {
+static inline query_number window(RRDR *r, struct grouping_des *g) {
     (void)g;
 
-    calculated_number points;
+    query_number points;
     if(r->group == 1) {
         // provide a running DES
         points = r->internal.points_wanted;
@@ -56,7 +56,7 @@ static inline void set_alpha(RRDR *r, struct grouping_des *g) {
     g->alpha = 2.0 / (window(r, g) + 1.0);
     g->alpha_other = 1.0 - g->alpha;
 
-    //info("alpha for chart '%s' is " CALCULATED_NUMBER_FORMAT, r->st->name, g->alpha);
+    //info("alpha for chart '%s' is " QUERY_NUMBER_FORMAT, r->st->name, g->alpha);
 }
 
 static inline void set_beta(RRDR *r, struct grouping_des *g) {
@@ -66,7 +66,7 @@ static inline void set_beta(RRDR *r, struct grouping_des *g) {
     g->beta = 2.0 / (window(r, g) + 1.0);
     g->beta_other = 1.0 - g->beta;
 
-    //info("beta for chart '%s' is " CALCULATED_NUMBER_FORMAT, r->st->name, g->beta);
+    //info("beta for chart '%s' is " QUERY_NUMBER_FORMAT, r->st->name, g->beta);
 }
 
 void *grouping_create_des(RRDR *r) {
@@ -96,10 +96,10 @@ void grouping_free_des(RRDR *r) {
     r->internal.grouping_data = NULL;
 }
 
-void grouping_add_des(RRDR *r, calculated_number value) {
+void grouping_add_des(RRDR *r, query_number value) {
     struct grouping_des *g = (struct grouping_des *)r->internal.grouping_data;
 
-    if(calculated_number_isnumber(value)) {
+    if(query_number_isnumber(value)) {
         if(likely(g->count > 0)) {
             // we have at least a number so far
 
@@ -110,7 +110,7 @@ void grouping_add_des(RRDR *r, calculated_number value) {
             }
 
             // for the values, except the first
-            calculated_number last_level = g->level;
+            query_number last_level = g->level;
             g->level = (g->alpha * value) + (g->alpha_other * (g->level + g->trend));
             g->trend = (g->beta * (g->level - last_level)) + (g->beta_other * g->trend);
         }
@@ -122,18 +122,18 @@ void grouping_add_des(RRDR *r, calculated_number value) {
         g->count++;
     }
 
-    //fprintf(stderr, "value: " CALCULATED_NUMBER_FORMAT ", level: " CALCULATED_NUMBER_FORMAT ", trend: " CALCULATED_NUMBER_FORMAT "\n", value, g->level, g->trend);
+    //fprintf(stderr, "value: " QUERY_NUMBER_FORMAT ", level: " QUERY_NUMBER_FORMAT ", trend: " QUERY_NUMBER_FORMAT "\n", value, g->level, g->trend);
 }
 
-calculated_number grouping_flush_des(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+query_number grouping_flush_des(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
     struct grouping_des *g = (struct grouping_des *)r->internal.grouping_data;
 
-    if(unlikely(!g->count || !calculated_number_isnumber(g->level))) {
+    if(unlikely(!g->count || !query_number_isnumber(g->level))) {
         *rrdr_value_options_ptr |= RRDR_VALUE_EMPTY;
         return 0.0;
     }
 
-    //fprintf(stderr, " RESULT for %zu values = " CALCULATED_NUMBER_FORMAT " \n", g->count, g->level);
+    //fprintf(stderr, " RESULT for %zu values = " QUERY_NUMBER_FORMAT " \n", g->count, g->level);
 
     return g->level;
 }
@@ -6,8 +6,8 @@
 // incremental sum
 
 struct grouping_incremental_sum {
-    calculated_number first;
-    calculated_number last;
+    query_number first;
+    query_number last;
     size_t count;
 };
 
@@ -30,7 +30,7 @@ void grouping_free_incremental_sum(RRDR *r) {
     r->internal.grouping_data = NULL;
 }
 
-void grouping_add_incremental_sum(RRDR *r, calculated_number value) {
+void grouping_add_incremental_sum(RRDR *r, query_number value) {
     if(!isnan(value)) {
         struct grouping_incremental_sum *g = (struct grouping_incremental_sum *)r->internal.grouping_data;
 
@@ -45,10 +45,31 @@ void grouping_add_incremental_sum(RRDR *r, calculated_number value) {
     }
 }
 
-calculated_number grouping_flush_incremental_sum(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+// adds count values at once, empty values are skipped
+// only the first and the last of them matter, so the values in between are not visited
+void grouping_add_many_incremental_sum(RRDR *r, const query_number *values, size_t count) {
     struct grouping_incremental_sum *g = (struct grouping_incremental_sum *)r->internal.grouping_data;
+    size_t first = 0, last = count;
 
-    calculated_number value;
+    if(unlikely(!g->count)) {
+        while(first < count && isnan(values[first])) first++;
+        if(unlikely(first == count)) return;
+
+        g->first = values[first++];
+        g->count++;
+    }
+
+    while(last > first && isnan(values[last - 1])) last--;
+    if(likely(last > first)) {
+        g->last = values[last - 1];
+        g->count++;
+    }
+}
+
+query_number grouping_flush_incremental_sum(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+    struct grouping_incremental_sum *g = (struct grouping_incremental_sum *)r->internal.grouping_data;
+
+    query_number value;
 
     if(unlikely(!g->count)) {
         value = 0.0;
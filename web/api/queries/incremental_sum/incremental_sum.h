@@ -9,7 +9,8 @@
 extern void *grouping_create_incremental_sum(RRDR *r);
 extern void grouping_reset_incremental_sum(RRDR *r);
 extern void grouping_free_incremental_sum(RRDR *r);
-extern void grouping_add_incremental_sum(RRDR *r, calculated_number value);
-extern calculated_number grouping_flush_incremental_sum(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+extern void grouping_add_incremental_sum(RRDR *r, query_number value);
+extern void grouping_add_many_incremental_sum(RRDR *r, const query_number *values, size_t count);
+extern query_number grouping_flush_incremental_sum(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
 
 #endif //NETDATA_API_QUERY_INCREMENTAL_SUM_H
@@ -6,7 +6,7 @@
 // max
 
 struct grouping_max {
-    calculated_number max;
+    query_number max;
     size_t count;
 };
 
@@ -28,21 +28,51 @@ void grouping_free_max(RRDR *r) {
     r->internal.grouping_data = NULL;
 }
 
-void grouping_add_max(RRDR *r, calculated_number value) {
+void grouping_add_max(RRDR *r, query_number value) {
     if(!isnan(value)) {
         struct grouping_max *g = (struct grouping_max *)r->internal.grouping_data;
 
-        if(!g->count || calculated_number_fabs(value) > calculated_number_fabs(g->max)) {
+        if(!g->count || query_number_fabs(value) > query_number_fabs(g->max)) {
             g->max = value;
             g->count++;
         }
     }
 }
 
-calculated_number grouping_flush_max(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+// adds count values at once, empty values are skipped
+void grouping_add_many_max(RRDR *r, const query_number *values, size_t count) {
     struct grouping_max *g = (struct grouping_max *)r->internal.grouping_data;
+    query_number max = g->max, max_abs = query_number_fabs(g->max);
+    size_t i, found = g->count;
 
-    calculated_number value;
+    for(i = 0; i < count ; i++) {
+        query_number value = values[i];
+
+        if(!isnan(value) && (!found || query_number_fabs(value) > max_abs)) {
+            max = value;
+            max_abs = query_number_fabs(value);
+            found++;
+        }
+    }
+
+    g->max = max;
+    g->count = found;
+}
+
+// adds points that were aggregated in advance, e.g. the points of a database page
+// the biggest absolute value is either the smallest or the biggest of them
+void grouping_add_summary_max(RRDR *r, query_number min, query_number max, query_number sum, size_t count) {
+    (void)sum;
+    (void)count;
+
+    grouping_add_max(r, min);
+    grouping_add_max(r, max);
+}
+
+query_number grouping_flush_max(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+    struct grouping_max *g = (struct grouping_max *)r->internal.grouping_data;
+
+    query_number value;
 
     if(unlikely(!g->count)) {
         value = 0.0;
@@ -35,36 +35,34 @@ void grouping_free_median(RRDR *r) {
     r->internal.grouping_data = NULL;
 }
 
-void grouping_add_median(RRDR *r, calculated_number value) {
+void grouping_add_median(RRDR *r, query_number value) {
     struct grouping_median *g = (struct grouping_median *)r->internal.grouping_data;
 
     if(unlikely(g->next_pos >= g->series_size)) {
         error("INTERNAL ERROR: median buffer overflow on chart '%s' - next_pos = %zu, series_size = %zu, r->group = %ld.", r->st->name, g->next_pos, g->series_size, r->group);
     }
     else {
-        if(calculated_number_isnumber(value))
+        if(query_number_isnumber(value))
             g->series[g->next_pos++] = (LONG_DOUBLE)value;
     }
 }
 
-calculated_number grouping_flush_median(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+query_number grouping_flush_median(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
     struct grouping_median *g = (struct grouping_median *)r->internal.grouping_data;
 
-    calculated_number value;
+    query_number value;
 
     if(unlikely(!g->next_pos)) {
         value = 0.0;
         *rrdr_value_options_ptr |= RRDR_VALUE_EMPTY;
     }
     else {
-        if(g->next_pos > 1) {
-            sort_series(g->series, g->next_pos);
-            value = (calculated_number)median_on_sorted_series(g->series, g->next_pos);
-        }
+        if(g->next_pos > 1)
+            value = (query_number)median_on_unsorted_series(g->series, g->next_pos);
         else
-            value = (calculated_number)g->series[0];
+            value = (query_number)g->series[0];
 
-        if(!calculated_number_isnumber(value)) {
+        if(!query_number_isnumber(value)) {
             value = 0.0;
             *rrdr_value_options_ptr |= RRDR_VALUE_EMPTY;
         }
@@ -9,7 +9,7 @@
 extern void *grouping_create_median(RRDR *r);
 extern void grouping_reset_median(RRDR *r);
 extern void grouping_free_median(RRDR *r);
-extern void grouping_add_median(RRDR *r, calculated_number value);
-extern calculated_number grouping_flush_median(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+extern void grouping_add_median(RRDR *r, query_number value);
+extern query_number grouping_flush_median(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
 
 #endif //NETDATA_API_QUERIES_MEDIAN_H
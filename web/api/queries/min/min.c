@@ -6,7 +6,7 @@
 // min
 
 struct grouping_min {
-    calculated_number min;
+    query_number min;
     size_t count;
 };
 
@@ -28,21 +28,51 @@ void grouping_free_min(RRDR *r) {
     r->internal.grouping_data = NULL;
 }
 
-void grouping_add_min(RRDR *r, calculated_number value) {
+void grouping_add_min(RRDR *r, query_number value) {
     if(!isnan(value)) {
         struct grouping_min *g = (struct grouping_min *)r->internal.grouping_data;
 
-        if(!g->count || calculated_number_fabs(value) < calculated_number_fabs(g->min)) {
+        if(!g->count || query_number_fabs(value) < query_number_fabs(g->min)) {
             g->min = value;
             g->count++;
         }
     }
 }
 
-calculated_number grouping_flush_min(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+// adds count values at once, empty values are skipped
+void grouping_add_many_min(RRDR *r, const query_number *values, size_t count) {
     struct grouping_min *g = (struct grouping_min *)r->internal.grouping_data;
+    query_number min = g->min, min_abs = query_number_fabs(g->min);
+    size_t i, found = g->count;
 
-    calculated_number value;
+    for(i = 0; i < count ; i++) {
+        query_number value = values[i];
+
+        if(!isnan(value) && (!found || query_number_fabs(value) < min_abs)) {
+            min = value;
+            min_abs = query_number_fabs(value);
+            found++;
+        }
+    }
+
+    g->min = min;
+    g->count = found;
+}
+
+// adds points that were aggregated in advance, e.g. the points of a database page
+// the smallest absolute value is either the smallest or the biggest of them
+void grouping_add_summary_min(RRDR *r, query_number min, query_number max, query_number sum, size_t count) {
+    (void)sum;
+    (void)count;
+
+    grouping_add_min(r, min);
+    grouping_add_min(r, max);
+}
+
+query_number grouping_flush_min(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+    struct grouping_min *g = (struct grouping_min *)r->internal.grouping_data;
+
+    query_number value;
 
     if(unlikely(!g->count)) {
         value = 0.0;
@@ -9,7 +9,9 @@
 extern void *grouping_create_min(RRDR *r);
 extern void grouping_reset_min(RRDR *r);
 extern void grouping_free_min(RRDR *r);
-extern void grouping_add_min(RRDR *r, calculated_number value);
-extern calculated_number grouping_flush_min(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+extern void grouping_add_min(RRDR *r, query_number value);
+extern void grouping_add_many_min(RRDR *r, const query_number *values, size_t count);
+extern void grouping_add_summary_min(RRDR *r, query_number min, query_number max, query_number sum, size_t count);
+extern query_number grouping_flush_min(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
 
 #endif //NETDATA_API_QUERY_MIN_H
@@ -39,7 +39,17 @@ static struct {
 
     // Add a single value into the calculation.
     // The module may decide to cache it, or use it in the fly.
-    void (*add)(struct rrdresult *r, calculated_number value);
+    void (*add)(struct rrdresult *r, query_number value);
+
+    // Add count values at once, in the order they were read.
+    // Optional, the query engine stages the values it reads from the database
+    // and hands them over in blocks, instead of calling add() for every one of them.
+    void (*add_many)(struct rrdresult *r, const query_number *values, size_t count);
+
+    // Add many values at once, given only their min, max, sum and count.
+    // Optional, the query engine uses it to skip values that were aggregated
+    // in advance (e.g. whole dbengine pages), otherwise they are added one by one.
+    void (*add_summary)(struct rrdresult *r, query_number min, query_number max, query_number sum, size_t count);
 
     // Generate a single result for the values added so far.
     // More values and points may be requested later.
@@ -47,7 +57,7 @@ static struct {
     // when flushing it (so for a few modules it may be better to
     // continue after a flush as if nothing changed, for others a
     // cleanup of the internal structures may be required).
-    calculated_number (*flush)(struct rrdresult *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+    query_number (*flush)(struct rrdresult *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
 } api_v1_data_groups[] = {
         {.name = "average",
                 .hash  = 0,
@@ -57,6 +67,8 @@ static struct {
                 .reset = grouping_reset_average,
                 .free  = grouping_free_average,
                 .add   = grouping_add_average,
+                .add_many = grouping_add_many_average,
+                .add_summary = grouping_add_summary_average,
                 .flush = grouping_flush_average
         },
         {.name = "mean",                           // alias on 'average'
@@ -67,6 +79,8 @@ static struct {
                 .reset = grouping_reset_average,
                 .free  = grouping_free_average,
                 .add   = grouping_add_average,
+                .add_many = grouping_add_many_average,
+                .add_summary = grouping_add_summary_average,
                 .flush = grouping_flush_average
         },
         {.name  = "incremental_sum",
@@ -77,6 +91,7 @@ static struct {
                 .reset = grouping_reset_incremental_sum,
                 .free  = grouping_free_incremental_sum,
                 .add   = grouping_add_incremental_sum,
+                .add_many = grouping_add_many_incremental_sum,
                 .flush = grouping_flush_incremental_sum
         },
         {.name = "incremental-sum",
@@ -87,6 +102,7 @@ static struct {
                 .reset = grouping_reset_incremental_sum,
                 .free  = grouping_free_incremental_sum,
                 .add   = grouping_add_incremental_sum,
+                .add_many = grouping_add_many_incremental_sum,
                 .flush = grouping_flush_incremental_sum
         },
         {.name = "median",
@@ -107,6 +123,8 @@ static struct {
                 .reset = grouping_reset_min,
                 .free  = grouping_free_min,
                 .add   = grouping_add_min,
+                .add_many = grouping_add_many_min,
+                .add_summary = grouping_add_summary_min,
                 .flush = grouping_flush_min
         },
         {.name = "max",
@@ -117,6 +135,8 @@ static struct {
                 .reset = grouping_reset_max,
                 .free  = grouping_free_max,
                 .add   = grouping_add_max,
+                .add_many = grouping_add_many_max,
+                .add_summary = grouping_add_summary_max,
                 .flush = grouping_flush_max
         },
         {.name = "sum",
@@ -127,6 +147,8 @@ static struct {
                 .reset = grouping_reset_sum,
                 .free  = grouping_free_sum,
                 .add   = grouping_add_sum,
+                .add_many = grouping_add_many_sum,
+                .add_summary = grouping_add_summary_sum,
                 .flush = grouping_flush_sum
         },
 
@@ -241,6 +263,8 @@ static struct {
                 .reset = grouping_reset_average,
                 .free  = grouping_free_average,
                 .add   = grouping_add_average,
+                .add_many = grouping_add_many_average,
+                .add_summary = grouping_add_summary_average,
                 .flush = grouping_flush_average
         }
 };
@@ -345,7 +369,7 @@ static inline RRDR_VALUE_FLAGS *rrdr_line_options(RRDR *r, long rrdr_line) {
     return &r->o[ rrdr_line * r->d ];
 }
 
-static inline calculated_number *rrdr_line_values(RRDR *r, long rrdr_line) {
+static inline query_number *rrdr_line_values(RRDR *r, long rrdr_line) {
     return &r->v[ rrdr_line * r->d ];
 }
 
@@ -373,6 +397,131 @@ static inline void rrdr_done(RRDR *r, long rrdr_line) {
 }
 
 
+// ----------------------------------------------------------------------------
+// query deadlines
+
+// the deadline of the queries of the calling thread, see rrd2rrdr_set_deadline()
+static __thread RRDR_QUERY_DEADLINE *rrdr_thread_deadline = NULL;
+
+// the database points read between two checks of the deadline of a query
+#define QUERY_DEADLINE_CHECK_POINTS 4096
+
+// the queries run by this thread after this call are stopped by deadline,
+// until it is called again with NULL - the deadline has to outlive them
+void rrd2rrdr_set_deadline(RRDR_QUERY_DEADLINE *deadline) {
+    rrdr_thread_deadline = deadline;
+}
+
+// returns non-zero when a query of this thread has been interrupted since its deadline was set
+int rrd2rrdr_interrupted(void) {
+    return rrdr_thread_deadline && __atomic_load_n(&rrdr_thread_deadline->interrupted, __ATOMIC_RELAXED);
+}
+
+// all the threads working on a query see it interrupted once one of them does
+static inline int rrdr_query_interrupted(RRDR *r) {
+    RRDR_QUERY_DEADLINE *d = r->internal.deadline;
+
+    if(likely(!d))
+        return 0;
+
+    if(__atomic_load_n(&d->interrupted, __ATOMIC_RELAXED))
+        return 1;
+
+    if((d->deadline_ut && now_monotonic_usec() >= d->deadline_ut)
+       || (d->interrupt_callback && d->interrupt_callback(d->interrupt_callback_data))) {
+        __atomic_store_n(&d->interrupted, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    return 0;
+}
+
+// the values read from the database are handed to the grouping method in blocks of this size
+#define QUERY_STAGED_VALUES 128
+
+static inline void do_dimension_add_staged(RRDR *r, query_number *staged, size_t *staged_count) {
+    if(likely(*staged_count)) {
+        r->internal.grouping_add_many(r, staged, *staged_count);
+        *staged_count = 0;
+    }
+}
+
+// adds count values that were summarized in advance to the group, after the staged ones
+static inline void do_dimension_add_summary(
+          RRDR *r
+        , storage_number min_n
+        , storage_number max_n
+        , double sum
+        , size_t count
+        , int reset
+        , query_number *staged
+        , size_t *staged_count
+        , long *values_in_group_non_zero
+        , RRDR_VALUE_FLAGS *group_value_flags
+){
+    if(unlikely(!count))
+        return;
+
+    if(r->internal.grouping_add_many)
+        do_dimension_add_staged(r, staged, staged_count);
+
+    query_number min = unpack_storage_number_query(min_n), max = unpack_storage_number_query(max_n);
+
+    r->internal.grouping_add_summary(r, min, max, sum, count);
+
+    if(likely(min != 0.0 || max != 0.0))
+        (*values_in_group_non_zero)++;
+
+    if(unlikely(reset))
+        *group_value_flags |= RRDR_VALUE_RESET;
+}
+
+// adds the next slots of the dimension to the group from their summary, when there is
+// one that starts at the next point of the query and covers at most points slots
+// returns the slots of the summary, or 0 when they have to be read one by one
+static inline long do_dimension_slot_summary(
+          RRDR *r
+        , struct rrddim_query_handle *handle
+        , long points
+        , query_number *staged
+        , size_t *staged_count
+        , long *values_in_group_non_zero
+        , RRDR_VALUE_FLAGS *group_value_flags
+){
+    struct rrddim_summary summary;
+    unsigned slots = rrddim_query_next_summary(handle, points, &summary);
+
+    if(likely(slots))
+        do_dimension_add_summary(r, summary.min, summary.max, summary.sum, summary.count,
+                                 summary.flags & RRDDIM_SUMMARY_RESET, staged, staged_count, values_in_group_non_zero, group_value_flags);
+
+    return (long)slots;
+}
+
+#ifdef ENABLE_DBENGINE
+// adds the next dbengine page to the group from its summary, when the page starts
+// at the next point of the query and ends by group_end
+// returns the points of the page, or 0 when they have to be read one by one
+static inline long do_dimension_page_summary(
+          RRDR *r
+        , struct rrddim_query_handle *handle
+        , time_t group_end
+        , query_number *staged
+        , size_t *staged_count
+        , long *values_in_group_non_zero
+        , RRDR_VALUE_FLAGS *group_value_flags
+){
+    struct rrdeng_page_summary summary;
+    unsigned points = rrdeng_load_metric_next_summary(handle, group_end, &summary);
+
+    if(likely(points))
+        do_dimension_add_summary(r, summary.min, summary.max, summary.sum, summary.count,
+                                 summary.flags & PAGE_SUMMARY_RESET, staged, staged_count, values_in_group_non_zero, group_value_flags);
+
+    return (long)points;
+}
+#endif // ENABLE_DBENGINE
+
 // ----------------------------------------------------------------------------
 // fill RRDR for a single dimension
 
@@ -403,10 +552,13 @@ static inline void do_dimension(
         group_value_flags = RRDR_VALUE_NOTHING;
 
     struct rrddim_query_handle handle;
-    uint8_t initialized_query;
+    uint8_t initialized_query, interrupted = 0;
 
-    calculated_number min = r->min, max = r->max;
-    size_t db_points_read = 0;
+    query_number min = r->min, max = r->max;
+    size_t db_points_read = 0, points_to_check = 0;
+
+    query_number staged[QUERY_STAGED_VALUES];
+    size_t staged_count = 0;
 
     for(initialized_query = 0 ; points_added < points_wanted ; now += dt) {
 
@@ -424,8 +576,24 @@ static inline void do_dimension(
             continue;
         }
 
+        // the deadline is checked before the first point too, so that nothing is
+        // read from the database for the dimensions of an interrupted query
+        if(unlikely(!points_to_check--)) {
+            if(unlikely(rrdr_query_interrupted(r))) {
+                interrupted = 1;
+                break;
+            }
+            points_to_check = QUERY_DEADLINE_CHECK_POINTS - 1;
+        }
+
         if (unlikely(!initialized_query)) {
-            rd->state->query_ops.init(rd, &handle, now, before_wanted);
+#ifdef ENABLE_DBENGINE
+            // the pages of the dimension have been preloaded with the rest of the chart
+            if(r->internal.chart_query && r->internal.chart_query->dims[dim_id_in_rrdr].rd == rd)
+                rrdeng_load_chart_metric_init(r->internal.chart_query, (unsigned)dim_id_in_rrdr, &handle, now, before_wanted);
+            else
+#endif
+            rd->state->query_ops->init(rd, &handle, now, before_wanted);
             initialized_query = 1;
         }
         // read the value from the database
@@ -440,22 +608,87 @@ static inline void do_dimension(
             error("INTERNAL CHECK: Unaligned query for %s, database slot: %lu, expected slot: %lu", rd->id, (long unsigned)handle.slotted.slot, rrdset_time2slot(st, now));
         }
 #endif
-        storage_number n = rd->state->query_ops.next_metric(&handle);
-        calculated_number value = NAN;
-        if(likely(does_storage_number_exist(n))) {
+        long points_summarized = 0;
+#ifdef ENABLE_DBENGINE
+        // whole pages that fit in the group are added without reading them
+        if(rd->rrd_memory_mode == RRD_MEMORY_MODE_DBENGINE && r->internal.grouping_add_summary)
+            points_summarized = do_dimension_page_summary(r, &handle, now + (group_size - values_in_group - 1) * dt,
+                                                          staged, &staged_count, &values_in_group_non_zero, &group_value_flags);
+        else
+#endif
+        // and so are the slots with a summary, of the dimensions that have them
+        if(rd->state->summaries && r->internal.grouping_add_summary)
+            points_summarized = do_dimension_slot_summary(r, &handle, group_size - values_in_group,
+                                                          staged, &staged_count, &values_in_group_non_zero, &group_value_flags);
+        if(unlikely(points_summarized)) {
+            values_in_group += points_summarized;
+            now += (points_summarized - 1) * dt;
+        }
+#ifdef QUERY_NUMBER_IS_DOUBLE
+        else if(likely(r->internal.grouping_add_many && rd->state->query_ops->next_metrics)) {
+            // the points are read and unpacked in blocks, straight into the staged values
+            // a block ends with the group, the query and the deadline check, and at the next
+            // point a summary may start at, so that summaries are still used after it
+            storage_number numbers[QUERY_STAGED_VALUES];
+            size_t wanted = QUERY_STAGED_VALUES - staged_count, count;
+            long remaining = group_size - values_in_group;
+            if((size_t)remaining < wanted) wanted = (size_t)remaining;
+            remaining = (long)((before_wanted - now) / dt + 1);
+            if((size_t)remaining < wanted) wanted = (size_t)remaining;
+            if(points_to_check + 1 < wanted) wanted = points_to_check + 1;
+
+            if(rd->state->summaries && r->internal.grouping_add_summary && rd->rrd_memory_mode != RRD_MEMORY_MODE_DBENGINE) {
+                long span = 1L << RRDDIM_SUMMARY_SHIFT;
+                remaining = span - (handle.slotted.slot & (span - 1));
+                if((size_t)remaining < wanted) wanted = (size_t)remaining;
+            }
 
-            value = unpack_storage_number(n);
-            if(likely(value != 0.0))
-                values_in_group_non_zero++;
+            count = rd->state->query_ops->next_metrics(&handle, numbers, wanted);
+            if(unlikely(!count)) {
+                // the database has nothing more, like next_metric() this is an empty point
+                numbers[0] = SN_EMPTY_SLOT;
+                count = 1;
+            }
 
-            if(unlikely(did_storage_number_reset(n)))
+            int reset;
+            values_in_group_non_zero += (long)unpack_storage_number_query_array(numbers, &staged[staged_count], count, &reset);
+            if(unlikely(reset))
                 group_value_flags |= RRDR_VALUE_RESET;
 
+            staged_count += count;
+            if(unlikely(staged_count == QUERY_STAGED_VALUES))
+                do_dimension_add_staged(r, staged, &staged_count);
+
+            values_in_group += (long)count;
+            now += (time_t)(count - 1) * dt;
+            db_points_read += count - 1;
+            points_to_check -= count - 1;
         }
+#endif
+        else {
+            storage_number n = rd->state->query_ops->next_metric(&handle);
+            query_number value = NAN;
+            if(likely(does_storage_number_exist(n))) {
 
-        // add this value for grouping
-        r->internal.grouping_add(r, value);
-        values_in_group++;
+                value = unpack_storage_number_query(n);
+                if(likely(value != 0.0))
+                    values_in_group_non_zero++;
+
+                if(unlikely(did_storage_number_reset(n)))
+                    group_value_flags |= RRDR_VALUE_RESET;
+
+            }
+
+            // add this value for grouping
+            if(likely(r->internal.grouping_add_many)) {
+                staged[staged_count++] = value;
+                if(unlikely(staged_count == QUERY_STAGED_VALUES))
+                    do_dimension_add_staged(r, staged, &staged_count);
+            }
+            else
+                r->internal.grouping_add(r, value);
+            values_in_group++;
+        }
         db_points_read++;
 
         if(unlikely(values_in_group == group_size)) {
@@ -468,14 +701,19 @@ static inline void do_dimension(
             RRDR_VALUE_FLAGS *rrdr_value_options_ptr = &r->o[rrdr_line * r->d + dim_id_in_rrdr];
 
             // update the dimension options
-            if(likely(values_in_group_non_zero))
+            if(likely(values_in_group_non_zero)) {
                 r->od[dim_id_in_rrdr] |= RRDR_DIMENSION_NONZERO;
+                group_value_flags |= RRDR_VALUE_NONZERO;
+            }
 
             // store the specific point options
             *rrdr_value_options_ptr = group_value_flags;
 
             // store the value
-            calculated_number value = r->internal.grouping_flush(r, rrdr_value_options_ptr);
+            if(likely(r->internal.grouping_add_many))
+                do_dimension_add_staged(r, staged, &staged_count);
+
+            query_number value = r->internal.grouping_flush(r, rrdr_value_options_ptr);
             r->v[rrdr_line * r->d + dim_id_in_rrdr] = value;
 
             if(likely(points_added || dim_id_in_rrdr)) {
@@ -498,7 +736,21 @@ static inline void do_dimension(
         }
     }
     if (likely(initialized_query))
-        rd->state->query_ops.finalize(&handle);
+        rd->state->query_ops->finalize(&handle);
+
+    if(unlikely(interrupted)) {
+        // the groups the query did not get to are empty, starting from the one in progress
+        for(now += (group_size - values_in_group - 1) * dt; points_added < points_wanted && now <= before_wanted; now += group_size * dt) {
+            rrdr_line = rrdr_line_init(r, now, rrdr_line);
+
+            if(unlikely(!min_date)) min_date = now;
+            max_date = now;
+
+            r->o[rrdr_line * r->d + dim_id_in_rrdr] = RRDR_VALUE_EMPTY;
+            r->v[rrdr_line * r->d + dim_id_in_rrdr] = 0.0;
+            points_added++;
+        }
+    }
 
     r->internal.db_points_read += db_points_read;
     r->internal.result_points_generated += points_added;
@@ -515,6 +767,622 @@ static inline void do_dimension(
     #endif
 }
 
+#ifdef ENABLE_DBENGINE
+// ----------------------------------------------------------------------------
+// fill RRDR for a single dimension from the rollups of a dbengine storage tier
+
+struct rollup_query {
+    RRDR *r;
+    long dim_id_in_rrdr;
+    long points_wanted;
+    time_t after_wanted;
+    time_t group_duration;
+
+    long rrdr_line;
+    long points_added;
+    long values_in_group_non_zero;
+    time_t min_date, max_date;
+    query_number min, max;
+};
+
+static inline void rollup_query_flush_group(struct rollup_query *q) {
+    RRDR *r = q->r;
+    time_t now = q->after_wanted + (q->points_added + 1) * q->group_duration - r->st->update_every;
+
+    q->rrdr_line = rrdr_line_init(r, now, q->rrdr_line);
+
+    if(unlikely(!q->min_date)) q->min_date = now;
+    q->max_date = now;
+
+    RRDR_VALUE_FLAGS *rrdr_value_options_ptr = &r->o[q->rrdr_line * r->d + q->dim_id_in_rrdr];
+
+    if(likely(q->values_in_group_non_zero))
+        r->od[q->dim_id_in_rrdr] |= RRDR_DIMENSION_NONZERO;
+
+    *rrdr_value_options_ptr = (q->values_in_group_non_zero) ? RRDR_VALUE_NONZERO : RRDR_VALUE_NOTHING;
+
+    query_number value = r->internal.grouping_flush(r, rrdr_value_options_ptr);
+    r->v[q->rrdr_line * r->d + q->dim_id_in_rrdr] = value;
+
+    if(likely(q->points_added || q->dim_id_in_rrdr)) {
+        if(unlikely(value < q->min)) q->min = value;
+        if(unlikely(value > q->max)) q->max = value;
+    }
+    else
+        q->min = q->max = value;
+
+    q->points_added++;
+    q->values_in_group_non_zero = 0;
+}
+
+// adds the value of the db point at time now to the group the point falls in
+static inline void rollup_query_add(struct rollup_query *q, time_t now, query_number value) {
+    long group = (long)((now - q->after_wanted) / q->group_duration);
+
+    if(unlikely(now < q->after_wanted || group >= q->points_wanted))
+        return;
+
+    while(q->points_added < group)
+        rollup_query_flush_group(q);
+
+    if(likely(!isnan(value) && value != 0.0))
+        q->values_in_group_non_zero++;
+
+    q->r->internal.grouping_add(q->r, value);
+}
+
+// finds the rollup series a grouping can be calculated from
+// returns 0 when the grouping needs the points at full resolution
+static inline int rollup_series(RRDR_GROUPING group_method, unsigned *series) {
+    switch(group_method) {
+        case RRDR_GROUPING_MIN:
+            *series = RRDENG_ROLLUP_MIN;
+            return 1;
+
+        case RRDR_GROUPING_MAX:
+            *series = RRDENG_ROLLUP_MAX;
+            return 1;
+
+        case RRDR_GROUPING_AVERAGE:
+        case RRDR_GROUPING_SUM:
+            *series = RRDENG_ROLLUP_SUM;
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+// preloads together the pages of all the dimensions that will be queried at full resolution
+// returns NULL when there are none
+static struct rrdeng_chart_query *rrdr_chart_query_init(
+          RRDR *r
+        , long dimensions_count
+        , RRDR_OPTIONS options
+        , time_t after_wanted
+        , time_t before_wanted
+        , RRDR_GROUPING group_method
+){
+    RRDSET *st = r->st;
+    RRDDIM *rd, **rds;
+    struct rrdeng_chart_query *chart_query = NULL;
+    long c, dimensions_loaded = 0;
+    unsigned series;
+    time_t interval;
+
+    if(st->rrd_memory_mode != RRD_MEMORY_MODE_DBENGINE || dimensions_count <= 0 || rrdr_query_interrupted(r))
+        return NULL;
+
+    rds = callocz((size_t)dimensions_count, sizeof(RRDDIM *));
+    for(rd = st->dimensions, c = 0 ; rd && c < dimensions_count ; rd = rd->next, c++) {
+        if(unlikely(!(options & RRDR_OPTION_PERCENTAGE) && (r->od[c] & RRDR_DIMENSION_HIDDEN)))
+            continue;
+
+        if(rd->rrd_memory_mode != RRD_MEMORY_MODE_DBENGINE)
+            continue;
+
+        // these are queried from the rollups of a higher storage tier
+        if(rollup_series(group_method, &series) && rrdeng_pick_rollup_tier(rd, r->group * st->update_every, &interval))
+            continue;
+
+        rds[c] = rd;
+        dimensions_loaded++;
+    }
+
+    if(dimensions_loaded)
+        chart_query = rrdeng_load_chart_init(rds, (unsigned)dimensions_count, after_wanted, before_wanted);
+
+    freez(rds);
+    return chart_query;
+}
+
+// returns 0 when the dimension has to be queried at full resolution
+static inline int do_dimension_rollup(
+          RRDR *r
+        , long points_wanted
+        , RRDDIM *rd
+        , long dim_id_in_rrdr
+        , time_t after_wanted
+        , time_t before_wanted
+        , RRDR_GROUPING group_method
+){
+    RRDSET *st = r->st;
+    time_t dt = st->update_every, interval = 0, now, rollup_before;
+    struct rrddim_query_handle handle, count_handle;
+    unsigned tier, series;
+    size_t db_points_read = 0;
+    storage_number n, count;
+
+    if(rd->rrd_memory_mode != RRD_MEMORY_MODE_DBENGINE)
+        return 0;
+
+    if(!rollup_series(group_method, &series))
+        return 0;
+
+    tier = rrdeng_pick_rollup_tier(rd, r->group * dt, &interval);
+    if(!tier)
+        return 0;
+
+    // the first rollup point that ends inside the query
+    now = after_wanted + (interval - after_wanted % interval) % interval;
+    rollup_before = rrdeng_rollup_latest_time(rd, tier);
+    if(rollup_before > before_wanted) rollup_before = before_wanted;
+    if(rollup_before < now)
+        return 0;
+
+    struct rollup_query q = {
+            .r = r,
+            .dim_id_in_rrdr = dim_id_in_rrdr,
+            .points_wanted = points_wanted,
+            .after_wanted = after_wanted,
+            .group_duration = r->group * dt,
+            .rrdr_line = -1,
+            .min = r->min,
+            .max = r->max
+    };
+
+    rrdeng_load_rollup_init(rd, &handle, tier, series, now, rollup_before);
+    if(group_method == RRDR_GROUPING_AVERAGE)
+        rrdeng_load_rollup_init(rd, &count_handle, tier, RRDENG_ROLLUP_COUNT, now, rollup_before);
+
+    for( ; now <= rollup_before ; now += interval) {
+        query_number value = NAN;
+
+        // the groups the query does not get to are flushed empty below
+        if(unlikely(!(db_points_read % QUERY_DEADLINE_CHECK_POINTS) && rrdr_query_interrupted(r)))
+            break;
+
+        n = rrdeng_load_metric_next(&handle);
+        if(group_method == RRDR_GROUPING_AVERAGE) {
+            count = rrdeng_load_metric_next(&count_handle);
+            if(likely(does_storage_number_exist(n) && does_storage_number_exist(count) && unpack_storage_number_query(count) > 0))
+                value = unpack_storage_number_query(n) / unpack_storage_number_query(count);
+        }
+        else if(likely(does_storage_number_exist(n)))
+            value = unpack_storage_number_query(n);
+
+        rollup_query_add(&q, now, value);
+        db_points_read++;
+    }
+
+    rrdeng_load_metric_finalize(&handle);
+    if(group_method == RRDR_GROUPING_AVERAGE)
+        rrdeng_load_metric_finalize(&count_handle);
+
+    // the points collected after the latest rollup come from the full resolution metric
+    now = after_wanted + ((rollup_before - after_wanted) / dt + 1) * dt;
+    if(now <= before_wanted && !rrdr_query_interrupted(r)) {
+        rd->state->query_ops->init(rd, &handle, now, before_wanted);
+        for( ; now <= before_wanted ; now += dt) {
+            query_number value = NAN;
+
+            if(unlikely(!(db_points_read % QUERY_DEADLINE_CHECK_POINTS) && rrdr_query_interrupted(r)))
+                break;
+
+            n = rd->state->query_ops->next_metric(&handle);
+            if(likely(does_storage_number_exist(n)))
+                value = unpack_storage_number_query(n);
+
+            rollup_query_add(&q, now, value);
+            db_points_read++;
+        }
+        rd->state->query_ops->finalize(&handle);
+    }
+
+    while(q.points_added < points_wanted)
+        rollup_query_flush_group(&q);
+
+    r->internal.db_points_read += db_points_read;
+    r->internal.result_points_generated += q.points_added;
+
+    r->min = q.min;
+    r->max = q.max;
+    r->before = q.max_date;
+    r->after = q.min_date - (r->group - 1) * dt;
+    rrdr_done(r, q.rrdr_line);
+
+    return 1;
+}
+#endif // ENABLE_DBENGINE
+
+// ----------------------------------------------------------------------------
+// query the dimensions of a chart, in parallel for big charts
+//
+// The thread that runs the query and the query threads that are idle claim the
+// dimensions of the chart one by one, until there are no more. Each of them works
+// on a copy of the RRDR, with its own grouping data, that writes the values of the
+// dimensions it claims to their own columns of the RRDR. The outcome of each
+// dimension is merged to the RRDR in the order of the dimensions, after all of
+// them have been queried.
+
+struct rrdr_dimension_result {
+    time_t after;
+    time_t before;
+    long rows;
+    query_number min;
+    query_number max;
+};
+
+struct rrdr_dimensions_job {
+    RRDR *r;
+    RRDDIM **dims;                      // NULL for the dimensions that are not queried
+    struct rrdr_dimension_result *results;
+    long dimensions_count;
+    long first_row;                     // the rows before it are already in the RRDR
+    long points_wanted;
+    time_t after_wanted;
+    time_t before_wanted;
+    RRDR_GROUPING group_method;
+
+    long next_dimension;                // the next dimension to be claimed, atomic
+    size_t db_points_read;              // atomic
+    size_t result_points_generated;     // atomic
+    const char *log;
+
+    size_t helpers;                     // the query threads working on the job, under the mutex
+    int queued;                         // under the mutex
+    struct rrdr_dimensions_job *next;
+};
+
+static struct rrdr_query_threads {
+    size_t threads;
+    long min_dimensions;                // the charts with fewer dimensions are queried by a single thread
+
+    netdata_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+    struct rrdr_dimensions_job *jobs;   // the queries the query threads can help with
+} rrdr_query_threads = {
+        .threads = 0,
+        .min_dimensions = 50,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .cond_work = PTHREAD_COND_INITIALIZER,
+        .cond_done = PTHREAD_COND_INITIALIZER,
+        .jobs = NULL
+};
+
+// the job gets no more helpers - the caller must hold the mutex
+static inline void rrdr_dimensions_job_unqueue(struct rrdr_dimensions_job *job) {
+    struct rrdr_dimensions_job **j;
+
+    if(!job->queued) return;
+
+    for(j = &rrdr_query_threads.jobs; *j ; j = &(*j)->next) {
+        if(*j == job) {
+            *j = job->next;
+            break;
+        }
+    }
+    job->queued = 0;
+}
+
+static void rrdr_dimensions_job_run(struct rrdr_dimensions_job *job) {
+    RRDR r = *job->r;   // the values, the options and the timestamps are shared with the job
+    long c;
+
+    r.t += job->first_row;
+    r.v += job->first_row * r.d;
+    r.o += job->first_row * r.d;
+    r.n -= job->first_row;
+
+    r.internal.grouping_data = r.internal.grouping_create(&r);
+    r.internal.db_points_read = 0;
+    r.internal.result_points_generated = 0;
+
+    while((c = __atomic_fetch_add(&job->next_dimension, 1, __ATOMIC_RELAXED)) < job->dimensions_count) {
+        RRDDIM *rd = job->dims[c];
+        if(unlikely(!rd)) continue;
+
+        // the values of the other dimensions are added when merging their results
+        r.min = INFINITY;
+        r.max = -INFINITY;
+
+        // reset the grouping for the new dimension
+        r.internal.grouping_reset(&r);
+
+#ifdef ENABLE_DBENGINE
+        if(!do_dimension_rollup(&r, job->points_wanted, rd, c, job->after_wanted, job->before_wanted, job->group_method))
+#endif
+        do_dimension(&r, job->points_wanted, rd, c, job->after_wanted, job->before_wanted);
+
+        job->results[c].after = r.after;
+        job->results[c].before = r.before;
+        job->results[c].rows = r.rows;
+        job->results[c].min = r.min;
+        job->results[c].max = r.max;
+    }
+
+    r.internal.grouping_free(&r);
+
+    __atomic_add_fetch(&job->db_points_read, r.internal.db_points_read, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&job->result_points_generated, r.internal.result_points_generated, __ATOMIC_RELAXED);
+
+#ifdef NETDATA_INTERNAL_CHECKS
+    if(r.internal.log)
+        job->log = r.internal.log;
+#endif
+}
+
+static void *rrdr_query_thread(void *ptr) {
+    (void)ptr;
+
+    netdata_mutex_lock(&rrdr_query_threads.mutex);
+    while(!netdata_exit) {
+        struct rrdr_dimensions_job *job = rrdr_query_threads.jobs;
+
+        if(!job) {
+            pthread_cond_wait(&rrdr_query_threads.cond_work, &rrdr_query_threads.mutex);
+            continue;
+        }
+
+        job->helpers++;
+        netdata_mutex_unlock(&rrdr_query_threads.mutex);
+
+        rrdr_dimensions_job_run(job);
+
+        netdata_mutex_lock(&rrdr_query_threads.mutex);
+        rrdr_dimensions_job_unqueue(job);
+        if(!--job->helpers)
+            pthread_cond_broadcast(&rrdr_query_threads.cond_done);
+    }
+    netdata_mutex_unlock(&rrdr_query_threads.mutex);
+
+    return NULL;
+}
+
+// queries the dimensions of job, with the help of the query threads that are idle
+static void rrdr_dimensions_job_execute(struct rrdr_dimensions_job *job, long dimensions_queried) {
+    int parallel = rrdr_query_threads.threads && dimensions_queried >= rrdr_query_threads.min_dimensions;
+
+    if(parallel) {
+        netdata_mutex_lock(&rrdr_query_threads.mutex);
+        job->queued = 1;
+        job->next = rrdr_query_threads.jobs;
+        rrdr_query_threads.jobs = job;
+        pthread_cond_broadcast(&rrdr_query_threads.cond_work);
+        netdata_mutex_unlock(&rrdr_query_threads.mutex);
+    }
+
+    rrdr_dimensions_job_run(job);
+
+    if(parallel) {
+        // the job is on our stack, wait for the threads that are still on it, even when cancelled
+        netdata_thread_disable_cancelability();
+        netdata_mutex_lock(&rrdr_query_threads.mutex);
+        rrdr_dimensions_job_unqueue(job);
+        while(job->helpers)
+            pthread_cond_wait(&rrdr_query_threads.cond_done, &rrdr_query_threads.mutex);
+        netdata_mutex_unlock(&rrdr_query_threads.mutex);
+        netdata_thread_enable_cancelability();
+    }
+}
+
+void rrd2rrdr_init_query_threads(void) {
+    long threads = config_get_number(CONFIG_SECTION_WEB, "query threads", 0);
+    rrdr_query_threads.min_dimensions = config_get_number(CONFIG_SECTION_WEB, "query parallel dimensions", rrdr_query_threads.min_dimensions);
+
+    if(threads < 0) threads = 0;
+    if(threads > processors) threads = processors;
+    if(rrdr_query_threads.min_dimensions < 2) rrdr_query_threads.min_dimensions = 2;
+
+    for(rrdr_query_threads.threads = 0; rrdr_query_threads.threads < (size_t)threads ; rrdr_query_threads.threads++) {
+        char tag[NETDATA_THREAD_TAG_MAX + 1];
+        netdata_thread_t thread;
+
+        snprintfz(tag, NETDATA_THREAD_TAG_MAX, "QUERY[%zu]", rrdr_query_threads.threads);
+        if(netdata_thread_create(&thread, tag, NETDATA_THREAD_OPTION_DONT_LOG, rrdr_query_thread, NULL)) {
+            error("Cannot create query thread %zu.", rrdr_query_threads.threads);
+            break;
+        }
+    }
+
+    if(rrdr_query_threads.threads)
+        info("Queries of charts with %ld dimensions or more are run by %zu query threads.", rrdr_query_threads.min_dimensions, rrdr_query_threads.threads);
+}
+
+// ----------------------------------------------------------------------------
+// the rows of previous queries
+//
+// Dashboards query the same timeframe relative to the latest data of a chart
+// again and again. When the groups of a query are the groups of a previous query
+// moved by a few whole groups, only the new groups at its end are queried, the rest
+// of its rows are copied from the previous query. This is exact for the grouping
+// methods that calculate the value of each group from its own points only.
+
+#define RRDR_PREVIOUS_MAX_VALUES (64 * 1024)        // the bigger queries are not kept
+
+struct rrdr_previous {
+    uint32_t hash;
+    char *key;                      // the query as requested
+
+    RRDSET *st;                     // these are only compared, they may not exist any more
+    RRDDIM **dims;
+
+    long d;
+    long group;
+    int update_every;
+    query_number resampling_divisor;
+    time_t after_wanted;            // the start of the first group
+    long rows;
+
+    time_t *t;
+    query_number *v;
+    RRDR_VALUE_FLAGS *o;
+
+    usec_t last_used;
+};
+
+static struct rrdr_previous_results {
+    size_t entries;                 // 0 when disabled
+    struct rrdr_previous *entry;
+    netdata_mutex_t mutex;
+
+    size_t hits;                    // atomic
+    size_t rows_reused;             // atomic
+} rrdr_previous_results = {
+        .entries = 0,
+        .entry = NULL,
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .hits = 0,
+        .rows_reused = 0
+};
+
+void rrd2rrdr_init_previous_results(void) {
+    long entries = config_get_number(CONFIG_SECTION_WEB, "incremental query entries", 16);
+    if(entries < 0) entries = 0;
+
+    netdata_mutex_lock(&rrdr_previous_results.mutex);
+    if(!rrdr_previous_results.entry && entries) {
+        rrdr_previous_results.entry = callocz((size_t)entries, sizeof(struct rrdr_previous));
+        rrdr_previous_results.entries = (size_t)entries;
+    }
+    netdata_mutex_unlock(&rrdr_previous_results.mutex);
+}
+
+void rrd2rrdr_previous_results_statistics(size_t *hits, size_t *rows_reused) {
+    *hits = __atomic_load_n(&rrdr_previous_results.hits, __ATOMIC_RELAXED);
+    *rows_reused = __atomic_load_n(&rrdr_previous_results.rows_reused, __ATOMIC_RELAXED);
+}
+
+// the value of each group depends on the groups before it for these
+static inline int rrdr_groups_are_independent(RRDR_GROUPING group_method) {
+    return group_method != RRDR_GROUPING_SES && group_method != RRDR_GROUPING_DES;
+}
+
+static inline int rrdr_previous_matches(struct rrdr_previous *e, RRDR *r, RRDDIM **dims, uint32_t hash, const char *key) {
+    long c;
+
+    if(!e->key || e->hash != hash || e->st != r->st || e->d != r->d || e->group != r->group
+       || e->update_every != r->st->update_every || e->resampling_divisor != r->internal.resampling_divisor
+       || strcmp(e->key, key) != 0)
+        return 0;
+
+    for(c = 0; c < r->d ; c++)
+        if(e->dims[c] != dims[c]) return 0;
+
+    return 1;
+}
+
+// copies to r the rows of a previous query that are also rows of this query
+// returns the number of rows copied, the query should continue after them
+static long rrdr_previous_copy(RRDR *r, RRDDIM **dims, uint32_t hash, const char *key, time_t after_wanted, long points_wanted) {
+    time_t group_duration = r->group * r->st->update_every;
+    long rows = 0;
+    size_t i;
+
+    netdata_mutex_lock(&rrdr_previous_results.mutex);
+    for(i = 0; i < rrdr_previous_results.entries ; i++) {
+        struct rrdr_previous *e = &rrdr_previous_results.entry[i];
+
+        if(!rrdr_previous_matches(e, r, dims, hash, key))
+            continue;
+
+        if(after_wanted < e->after_wanted || (after_wanted - e->after_wanted) % group_duration)
+            break;
+
+        long shift = (long)((after_wanted - e->after_wanted) / group_duration);
+        if(shift >= e->rows)
+            break;
+
+        rows = e->rows - shift;
+        if(rows > points_wanted) rows = points_wanted;
+
+        memcpy(r->t, &e->t[shift], rows * sizeof(time_t));
+        memcpy(r->v, &e->v[shift * r->d], rows * r->d * sizeof(query_number));
+        memcpy(r->o, &e->o[shift * r->d], rows * r->d * sizeof(RRDR_VALUE_FLAGS));
+        e->last_used = now_monotonic_usec();
+        break;
+    }
+    netdata_mutex_unlock(&rrdr_previous_results.mutex);
+
+    if(rows) {
+        __atomic_add_fetch(&rrdr_previous_results.hits, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&rrdr_previous_results.rows_reused, (size_t)rows, __ATOMIC_RELAXED);
+    }
+
+    return rows;
+}
+
+// keeps the rows of r, for the next query with the same key
+static void rrdr_previous_save(RRDR *r, RRDDIM **dims, uint32_t hash, const char *key, time_t after_wanted) {
+    struct rrdr_previous *e = NULL;
+    size_t i;
+
+    if(!r->rows || r->rows * r->d > RRDR_PREVIOUS_MAX_VALUES)
+        return;
+
+    netdata_mutex_lock(&rrdr_previous_results.mutex);
+    for(i = 0; i < rrdr_previous_results.entries ; i++) {
+        struct rrdr_previous *t = &rrdr_previous_results.entry[i];
+
+        if(rrdr_previous_matches(t, r, dims, hash, key)) {
+            e = t;
+            break;
+        }
+
+        // the least recently used one is replaced
+        if(!e || !t->key || t->last_used < e->last_used)
+            e = t;
+
+        if(!t->key)
+            break;
+    }
+
+    if(e) {
+        if(e->d != r->d || !e->dims) {
+            freez(e->dims);
+            e->dims = mallocz(r->d * sizeof(RRDDIM *));
+        }
+        if(e->rows * e->d < r->rows * r->d || !e->t) {
+            e->t = reallocz(e->t, r->rows * sizeof(time_t));
+            e->v = reallocz(e->v, r->rows * r->d * sizeof(query_number));
+            e->o = reallocz(e->o, r->rows * r->d * sizeof(RRDR_VALUE_FLAGS));
+        }
+        else if(e->rows < r->rows)
+            e->t = reallocz(e->t, r->rows * sizeof(time_t));
+
+        if(!e->key || strcmp(e->key, key) != 0) {
+            freez(e->key);
+            e->key = strdupz(key);
+        }
+
+        e->hash = hash;
+        e->st = r->st;
+        memcpy(e->dims, dims, r->d * sizeof(RRDDIM *));
+        e->d = r->d;
+        e->group = r->group;
+        e->update_every = r->st->update_every;
+        e->resampling_divisor = r->internal.resampling_divisor;
+        e->after_wanted = after_wanted;
+        e->rows = r->rows;
+        memcpy(e->t, r->t, r->rows * sizeof(time_t));
+        memcpy(e->v, r->v, r->rows * r->d * sizeof(query_number));
+        memcpy(e->o, r->o, r->rows * r->d * sizeof(RRDR_VALUE_FLAGS));
+        e->last_used = now_monotonic_usec();
+    }
+    netdata_mutex_unlock(&rrdr_previous_results.mutex);
+}
+
 // ----------------------------------------------------------------------------
 // fill RRDR for the whole chart
 
@@ -599,10 +1467,19 @@ RRDR *rrd2rrdr(
         , RRDR_OPTIONS options
         , const char *dimensions
 ) {
+    usec_t started_ut = now_monotonic_usec();
     int aligned = !(options & RRDR_OPTION_NOT_ALIGNED);
 
     int absolute_period_requested = -1;
 
+    // the query as requested, to find the previous queries it can continue
+    char previous_key[1024 + 1] = "";
+    if(rrdr_previous_results.entries && rrdr_groups_are_independent(group_method)) {
+        if(snprintfz(previous_key, 1024, "%ld|%lld|%lld|%d|%ld|%u|%s", points_requested, after_requested, before_requested,
+                     (int)group_method, resampling_time_requested, (unsigned)options, dimensions ? dimensions : "") >= 1024)
+            previous_key[0] = '\0';
+    }
+
     time_t first_entry_t = rrdset_first_entry_t(st);
     time_t last_entry_t  = rrdset_last_entry_t(st);
 
@@ -672,7 +1549,7 @@ RRDR *rrd2rrdr(
     if(unlikely(available_points % points_requested > points_requested / 2)) group++; // rounding to the closest integer
 
     // resampling_time_requested enforces a certain grouping multiple
-    calculated_number resampling_divisor = 1.0;
+    query_number resampling_divisor = 1.0;
     long resampling_group = 1;
     if(unlikely(resampling_time_requested > st->update_every)) {
         if (unlikely(resampling_time_requested > duration)) {
@@ -716,7 +1593,7 @@ RRDR *rrd2rrdr(
         if(unlikely(group % resampling_group)) group += resampling_group - (group % resampling_group); // make sure group is multiple of resampling_group
 
         //resampling_divisor = group / resampling_group;
-        resampling_divisor = (calculated_number)(group * st->update_every) / (calculated_number)resampling_time_requested;
+        resampling_divisor = (query_number)(group * st->update_every) / (query_number)resampling_time_requested;
     }
 
     // now that we have group,
@@ -825,6 +1702,8 @@ RRDR *rrd2rrdr(
         return NULL;
     }
 
+    r->internal.deadline = rrdr_thread_deadline;
+
     if(unlikely(!r->d || !points_wanted)) {
         #ifdef NETDATA_INTERNAL_CHECKS
         error("INTERNAL CHECK: Returning empty RRDR (no dimensions in RRDSET) for %s, after=%u, before=%u, duration=%zu, points=%ld", st->id, (uint32_t)after_wanted, (uint32_t)before_wanted, (size_t)duration, points_wanted);
@@ -863,6 +1742,8 @@ RRDR *rrd2rrdr(
                 r->internal.grouping_reset = api_v1_data_groups[i].reset;
                 r->internal.grouping_free  = api_v1_data_groups[i].free;
                 r->internal.grouping_add   = api_v1_data_groups[i].add;
+                r->internal.grouping_add_many = api_v1_data_groups[i].add_many;
+                r->internal.grouping_add_summary = api_v1_data_groups[i].add_summary;
                 r->internal.grouping_flush = api_v1_data_groups[i].flush;
                 found = 1;
             }
@@ -876,13 +1757,12 @@ RRDR *rrd2rrdr(
             r->internal.grouping_reset = grouping_reset_average;
             r->internal.grouping_free  = grouping_free_average;
             r->internal.grouping_add   = grouping_add_average;
+            r->internal.grouping_add_many = grouping_add_many_average;
+            r->internal.grouping_add_summary = grouping_add_summary_average;
             r->internal.grouping_flush = grouping_flush_average;
         }
     }
 
-    // allocate any memory required by the grouping method
-    r->internal.grouping_data = r->internal.grouping_create(r);
-
 
     // -------------------------------------------------------------------------
     // disable the not-wanted dimensions
@@ -900,7 +1780,19 @@ RRDR *rrd2rrdr(
     long max_rows = 0;
 
     RRDDIM *rd;
-    long c, dimensions_used = 0, dimensions_nonzero = 0;
+    long c, dimensions_used = 0, dimensions_nonzero = 0, dimensions_queried = 0;
+
+    struct rrdr_dimensions_job job = {
+            .r = r,
+            .dims = callocz((size_t)(dimensions_count ? dimensions_count : 1), sizeof(RRDDIM *)),
+            .results = callocz((size_t)(dimensions_count ? dimensions_count : 1), sizeof(struct rrdr_dimension_result)),
+            .dimensions_count = dimensions_count,
+            .points_wanted = points_wanted,
+            .after_wanted = after_wanted,
+            .before_wanted = before_wanted,
+            .group_method = group_method
+    };
+
     for(rd = st->dimensions, c = 0 ; rd && c < dimensions_count ; rd = rd->next, c++) {
 
         // if we need a percentage, we need to calculate all dimensions
@@ -910,21 +1802,83 @@ RRDR *rrd2rrdr(
         }
         r->od[c] |= RRDR_DIMENSION_SELECTED;
 
-        // reset the grouping for the new dimension
-        r->internal.grouping_reset(r);
+        job.dims[c] = rd;
+        dimensions_queried++;
+    }
+
+    // the rows we have from a previous query are not queried again
+    uint32_t previous_hash = 0;
+    if(*previous_key) {
+        previous_hash = simple_hash(previous_key);
+        job.first_row = rrdr_previous_copy(r, job.dims, previous_hash, previous_key, after_wanted, points_wanted);
+        job.points_wanted -= job.first_row;
+        job.after_wanted += job.first_row * group * st->update_every;
+    }
+
+    if(job.points_wanted > 0) {
+#ifdef ENABLE_DBENGINE
+        r->internal.chart_query = rrdr_chart_query_init(r, dimensions_count, options, job.after_wanted, before_wanted, group_method);
+#endif
+        rrdr_dimensions_job_execute(&job, dimensions_queried);
+    }
+
+    r->internal.db_points_read += job.db_points_read;
+    r->internal.result_points_generated += job.result_points_generated;
+#ifdef NETDATA_INTERNAL_CHECKS
+    if(job.log)
+        r->internal.log = job.log;
+#endif
+
+    for(c = 0 ; c < dimensions_count ; c++) {
+        struct rrdr_dimension_result *result = &job.results[c];
+
+        rd = job.dims[c];
+        if(!rd) continue;
+
+        if(job.first_row) {
+            // add the rows copied from a previous query to the outcome of the dimension
+            query_number min = r->v[c], max = r->v[c];
+            long row;
+
+            for(row = 0; row < job.first_row ; row++) {
+                query_number value = r->v[row * r->d + c];
 
-        do_dimension(
-                r
-                , points_wanted
-                , rd
-                , c
-                , after_wanted
-                , before_wanted
-                );
+                if(unlikely(value < min)) min = value;
+                if(unlikely(value > max)) max = value;
+                if(r->o[row * r->d + c] & RRDR_VALUE_NONZERO)
+                    r->od[c] |= RRDR_DIMENSION_NONZERO;
+            }
+
+            if(result->rows) {
+                if(result->min < min) min = result->min;
+                if(result->max > max) max = result->max;
+            }
+            else
+                result->before = r->t[job.first_row - 1];
+
+            result->min = min;
+            result->max = max;
+            result->rows += job.first_row;
+            result->after = r->t[0] - (group - 1) * st->update_every;
+        }
 
         if(r->od[c] & RRDR_DIMENSION_NONZERO)
             dimensions_nonzero++;
 
+        // the first point of the first dimension restarts the min and the max
+        if(likely(c || !result->rows)) {
+            if(unlikely(result->min < r->min)) r->min = result->min;
+            if(unlikely(result->max > r->max)) r->max = result->max;
+        }
+        else {
+            r->min = result->min;
+            r->max = result->max;
+        }
+
+        r->after = result->after;
+        r->before = result->before;
+        r->rows = result->rows;
+
         // verify all dimensions are aligned
         if(unlikely(!dimensions_used)) {
             min_before = r->before;
@@ -960,6 +1914,22 @@ RRDR *rrd2rrdr(
         dimensions_used++;
     }
 
+    // the rows of an interrupted query are not reused, some of them are empty
+    if(r->internal.deadline && __atomic_load_n(&r->internal.deadline->interrupted, __ATOMIC_RELAXED))
+        r->result_options |= RRDR_RESULT_OPTION_PARTIAL;
+    else if(*previous_key)
+        rrdr_previous_save(r, job.dims, previous_hash, previous_key, after_wanted);
+
+    freez(job.dims);
+    freez(job.results);
+
+#ifdef ENABLE_DBENGINE
+    if(r->internal.chart_query) {
+        rrdeng_load_chart_finalize(r->internal.chart_query);
+        r->internal.chart_query = NULL;
+    }
+#endif
+
     #ifdef NETDATA_INTERNAL_CHECKS
 
     if(r->internal.log)
@@ -987,9 +1957,6 @@ RRDR *rrd2rrdr(
 
     #endif
 
-    // free all resources used by the grouping method
-    r->internal.grouping_free(r);
-
     // when all the dimensions are zero, we should return all of them
     if(unlikely(options & RRDR_OPTION_NONZERO && !dimensions_nonzero)) {
         // all the dimensions are zero
@@ -1000,6 +1967,6 @@ RRDR *rrd2rrdr(
         }
     }
 
-    rrdr_query_completed(r->internal.db_points_read, r->internal.result_points_generated);
+    rrdr_query_completed(r->internal.db_points_read, r->internal.result_points_generated, now_monotonic_usec() - started_ut);
     return r;
 }
@@ -19,6 +19,7 @@ typedef enum rrdr_grouping {
 
 extern const char *group_method2string(RRDR_GROUPING group);
 extern void web_client_api_v1_init_grouping(void);
+extern void rrd2rrdr_init_query_threads(void);
 extern RRDR_GROUPING web_client_api_request_v1_data_group(const char *name, RRDR_GROUPING def);
 
 #endif //NETDATA_API_DATA_QUERY_H
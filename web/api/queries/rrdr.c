@@ -30,7 +30,7 @@ static void rrdr_dump(RRDR *r)
 
     // for each line in the array
     for(i = 0; i < r->rows ;i++) {
-        calculated_number *cn = &r->v[ i * r->d ];
+        query_number *cn = &r->v[ i * r->d ];
         RRDR_DIMENSION_FLAGS *co = &r->o[ i * r->d ];
 
         // print the id and the timestamp of the line
@@ -44,7 +44,7 @@ static void rrdr_dump(RRDR *r)
             if(co[c] & RRDR_EMPTY)
                 fprintf(stderr, "null ");
             else
-                fprintf(stderr, CALCULATED_NUMBER_FORMAT " %s%s%s%s "
+                fprintf(stderr, QUERY_NUMBER_FORMAT " %s%s%s%s "
                     , cn[c]
                     , (co[c] & RRDR_EMPTY)?"E":" "
                     , (co[c] & RRDR_RESET)?"R":" "
@@ -61,16 +61,6 @@ static void rrdr_dump(RRDR *r)
 
 
 
-inline static void rrdr_lock_rrdset(RRDR *r) {
-    if(unlikely(!r)) {
-        error("NULL value given!");
-        return;
-    }
-
-    rrdset_rdlock(r->st);
-    r->has_st_lock = 1;
-}
-
 inline static void rrdr_unlock_rrdset(RRDR *r) {
     if(unlikely(!r)) {
         error("NULL value given!");
@@ -83,6 +73,98 @@ inline static void rrdr_unlock_rrdset(RRDR *r) {
     }
 }
 
+// ----------------------------------------------------------------------------
+// the memory of the RRDRs
+//
+// An RRDR and its arrays are allocated in one block. The blocks of the RRDRs a
+// thread frees are kept, one per power of 2 size, for the next RRDRs the thread
+// creates, so that the web server threads, which create and free one RRDR per
+// query, do not go through malloc() and page faults for the arrays of every one
+// of them. Bigger blocks are freed, so that a thread keeps up to about twice the
+// biggest size class.
+
+#define RRDR_POOL_MIN_SHIFT 12          // 4 KiB
+#define RRDR_POOL_MAX_SHIFT 22          // 4 MiB
+#define RRDR_POOL_CLASSES (RRDR_POOL_MAX_SHIFT - RRDR_POOL_MIN_SHIFT + 1)
+
+// the arrays of the block follow the RRDR, the widest first, so that all are aligned
+#define RRDR_BLOCK_ALIGN(x) (((x) + 15) & ~((size_t)15))
+
+struct rrdr_pool {
+    void *blocks[RRDR_POOL_CLASSES];
+};
+
+static pthread_key_t rrdr_pool_key;
+static pthread_once_t rrdr_pool_key_once = PTHREAD_ONCE_INIT;
+static __thread struct rrdr_pool *rrdr_thread_pool = NULL;
+
+static void rrdr_pool_free(void *ptr) {
+    struct rrdr_pool *pool = (struct rrdr_pool *)ptr;
+    int i;
+
+    for(i = 0; i < RRDR_POOL_CLASSES ; i++)
+        freez(pool->blocks[i]);
+
+    freez(pool);
+}
+
+static void rrdr_pool_key_create(void) {
+    // the blocks kept by a thread are freed when it exits
+    if(pthread_key_create(&rrdr_pool_key, rrdr_pool_free) != 0)
+        error("Cannot create the key of the RRDR pools.");
+}
+
+static inline struct rrdr_pool *rrdr_pool_get(void) {
+    if(unlikely(!rrdr_thread_pool)) {
+        pthread_once(&rrdr_pool_key_once, rrdr_pool_key_create);
+        rrdr_thread_pool = callocz(1, sizeof(struct rrdr_pool));
+        pthread_setspecific(rrdr_pool_key, rrdr_thread_pool);
+    }
+
+    return rrdr_thread_pool;
+}
+
+// returns the size class of a block of size bytes, or -1 when it is too big to be kept
+static inline int rrdr_pool_class(size_t size, size_t *class_size) {
+    int shift = RRDR_POOL_MIN_SHIFT;
+
+    while(((size_t)1 << shift) < size)
+        if(++shift > RRDR_POOL_MAX_SHIFT)
+            return -1;
+
+    *class_size = (size_t)1 << shift;
+    return shift - RRDR_POOL_MIN_SHIFT;
+}
+
+static inline void *rrdr_block_alloc(size_t size, int *class) {
+    size_t class_size;
+
+    *class = rrdr_pool_class(size, &class_size);
+    if(unlikely(*class < 0))
+        return mallocz(size);
+
+    struct rrdr_pool *pool = rrdr_pool_get();
+    void *block = pool->blocks[*class];
+    if(likely(block)) {
+        pool->blocks[*class] = NULL;
+        return block;
+    }
+
+    return mallocz(class_size);
+}
+
+static inline void rrdr_block_free(void *block, int class) {
+    if(likely(class >= 0)) {
+        struct rrdr_pool *pool = rrdr_pool_get();
+        if(likely(!pool->blocks[class])) {
+            pool->blocks[class] = block;
+            return;
+        }
+    }
+
+    freez(block);
+}
+
 inline void rrdr_free(RRDR *r)
 {
     if(unlikely(!r)) {
@@ -91,11 +173,7 @@ inline void rrdr_free(RRDR *r)
     }
 
     rrdr_unlock_rrdset(r);
-    freez(r->t);
-    freez(r->v);
-    freez(r->o);
-    freez(r->od);
-    freez(r);
+    rrdr_block_free(r, r->pool_class);
 }
 
 RRDR *rrdr_create(RRDSET *st, long n)
@@ -105,20 +183,35 @@ RRDR *rrdr_create(RRDSET *st, long n)
         return NULL;
     }
 
-    RRDR *r = callocz(1, sizeof(RRDR));
-    r->st = st;
-
-    rrdr_lock_rrdset(r);
+    // the dimensions are counted with the chart locked, like the RRDR keeps it
+    rrdset_rdlock(st);
 
     RRDDIM *rd;
-    rrddim_foreach_read(rd, st) r->d++;
+    int d = 0, class;
+    rrddim_foreach_read(rd, st) d++;
+
+    size_t size_r = RRDR_BLOCK_ALIGN(sizeof(RRDR));
+    size_t size_v = RRDR_BLOCK_ALIGN(n * d * sizeof(query_number));
+    size_t size_ts = RRDR_BLOCK_ALIGN(n * sizeof(time_t));
+    size_t size_o = RRDR_BLOCK_ALIGN(n * d * sizeof(RRDR_VALUE_FLAGS));
+    size_t size_od = d * sizeof(RRDR_DIMENSION_FLAGS);
 
+    char *block = rrdr_block_alloc(size_r + size_v + size_ts + size_o + size_od, &class);
+
+    RRDR *r = (RRDR *)block;
+    memset(r, 0, sizeof(RRDR));
+    r->st = st;
+    r->has_st_lock = 1;
+    r->pool_class = class;
+    r->d = d;
     r->n = n;
 
-    r->t = callocz((size_t)n, sizeof(time_t));
-    r->v = mallocz(n * r->d * sizeof(calculated_number));
-    r->o = mallocz(n * r->d * sizeof(RRDR_VALUE_FLAGS));
-    r->od = mallocz(r->d * sizeof(RRDR_DIMENSION_FLAGS));
+    r->v = (query_number *)(block + size_r);
+    r->t = (time_t *)(block + size_r + size_v);
+    r->o = (RRDR_VALUE_FLAGS *)(block + size_r + size_v + size_ts);
+    r->od = (RRDR_DIMENSION_FLAGS *)(block + size_r + size_v + size_ts + size_o);
+
+    memset(r->t, 0, n * sizeof(time_t));
 
     // set the hidden flag on hidden dimensions
     int c;
@@ -134,3 +227,124 @@ RRDR *rrdr_create(RRDSET *st, long n)
 
     return r;
 }
+
+// ----------------------------------------------------------------------------
+// aggregation of the RRDRs of many charts
+//
+// The RRDR of the first chart collects the values of the others: the values of
+// each dimension of the other charts are aggregated into the dimension of the
+// first chart with the same id, at the row with the same timestamp.
+
+RRDR_CHARTS_AGGREGATION rrdr_charts_aggregation_id(const char *name) {
+    if(!strcmp(name, "average") || !strcmp(name, "avg") || !strcmp(name, "mean"))
+        return RRDR_CHARTS_AGGREGATION_AVERAGE;
+    else if(!strcmp(name, "min"))
+        return RRDR_CHARTS_AGGREGATION_MIN;
+    else if(!strcmp(name, "max"))
+        return RRDR_CHARTS_AGGREGATION_MAX;
+
+    return RRDR_CHARTS_AGGREGATION_SUM;
+}
+
+// returns the number of values aggregated into each value of r
+uint32_t *rrdr_aggregation_start(RRDR *r) {
+    long i, total = rrdr_rows(r) * r->d;
+    uint32_t *counts = mallocz((total ? total : 1) * sizeof(uint32_t));
+
+    for(i = 0; i < total ; i++)
+        counts[i] = (r->o[i] & RRDR_VALUE_EMPTY) ? 0 : 1;
+
+    return counts;
+}
+
+void rrdr_aggregate(RRDR *r, RRDR *m, RRDR_CHARTS_AGGREGATION aggregation, uint32_t *counts) {
+    RRDDIM *rd, *td;
+    int c, tc;
+
+    r->result_options |= m->result_options & RRDR_RESULT_OPTION_PARTIAL;
+
+    if(unlikely(!rrdr_rows(r) || !rrdr_rows(m)))
+        return;
+
+    for(c = 0, rd = m->st->dimensions; rd && c < m->d ; c++, rd = rd->next) {
+        if(unlikely(m->od[c] & RRDR_DIMENSION_HIDDEN))
+            continue;
+
+        // find the dimension of r with the same id
+        for(tc = 0, td = r->st->dimensions; td && tc < r->d ; tc++, td = td->next)
+            if(td->hash == rd->hash && !strcmp(td->id, rd->id))
+                break;
+
+        if(unlikely(!td || tc >= r->d || (r->od[tc] & RRDR_DIMENSION_HIDDEN)))
+            continue;
+
+        if(m->od[c] & RRDR_DIMENSION_NONZERO)
+            r->od[tc] |= RRDR_DIMENSION_NONZERO;
+
+        // the rows of both are ordered by time, oldest first
+        long i = 0, j;
+        for(j = 0; j < rrdr_rows(m) ; j++) {
+            while(i < rrdr_rows(r) && r->t[i] < m->t[j]) i++;
+            if(unlikely(i >= rrdr_rows(r))) break;
+            if(r->t[i] != m->t[j]) continue;
+
+            RRDR_VALUE_FLAGS mo = m->o[j * m->d + c];
+            if(mo & RRDR_VALUE_EMPTY) continue;
+
+            query_number value = m->v[j * m->d + c];
+            long slot = i * r->d + tc;
+
+            if(!counts[slot]) {
+                r->v[slot] = value;
+                r->o[slot] = mo;
+            }
+            else {
+                switch(aggregation) {
+                    case RRDR_CHARTS_AGGREGATION_MIN:
+                        if(value < r->v[slot]) r->v[slot] = value;
+                        break;
+
+                    case RRDR_CHARTS_AGGREGATION_MAX:
+                        if(value > r->v[slot]) r->v[slot] = value;
+                        break;
+
+                    case RRDR_CHARTS_AGGREGATION_SUM:
+                    case RRDR_CHARTS_AGGREGATION_AVERAGE:
+                    default:
+                        r->v[slot] += value;
+                        break;
+                }
+
+                r->o[slot] |= mo;
+            }
+
+            counts[slot]++;
+        }
+    }
+}
+
+void rrdr_aggregation_done(RRDR *r, RRDR_CHARTS_AGGREGATION aggregation, uint32_t *counts) {
+    long i, total = rrdr_rows(r) * r->d;
+    int set = 0;
+
+    for(i = 0; i < total ; i++) {
+        if(!counts[i]) continue;
+
+        if(aggregation == RRDR_CHARTS_AGGREGATION_AVERAGE && counts[i] > 1)
+            r->v[i] /= (query_number)counts[i];
+
+        if(r->od[i % r->d] & RRDR_DIMENSION_HIDDEN)
+            continue;
+
+        if(unlikely(!set)) {
+            r->min = r->max = r->v[i];
+            set = 1;
+        }
+        else if(r->v[i] < r->min)
+            r->min = r->v[i];
+        else if(r->v[i] > r->max)
+            r->max = r->v[i];
+    }
+
+    freez(counts);
+}
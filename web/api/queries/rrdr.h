@@ -28,6 +28,7 @@ typedef enum rrdr_value_flag {
     RRDR_VALUE_NOTHING      = 0x00, // no flag set (a good default)
     RRDR_VALUE_EMPTY        = 0x01, // the database value is empty
     RRDR_VALUE_RESET        = 0x02, // the database value is marked as reset (overflown)
+    RRDR_VALUE_NONZERO      = 0x20, // internal, the database values grouped were not all zero
 } RRDR_VALUE_FLAGS;
 
 typedef enum rrdr_dimension_flag {
@@ -41,8 +42,19 @@ typedef enum rrdr_dimension_flag {
 typedef enum rrdr_result_flags {
     RRDR_RESULT_OPTION_ABSOLUTE = 0x00000001, // the query uses absolute time-frames (can be cached by browsers and proxies)
     RRDR_RESULT_OPTION_RELATIVE = 0x00000002, // the query uses relative time-frames (should not to be cached by browsers and proxies)
+    RRDR_RESULT_OPTION_PARTIAL  = 0x00000004, // the query was interrupted, the values it did not get to are empty
 } RRDR_RESULT_FLAGS;
 
+// The queries of a thread stop early, with empty values for the points they did
+// not get to, when their deadline passes or their interrupt callback finds they
+// are not wanted any more, e.g. because the web client closed its connection.
+typedef struct rrdr_query_deadline {
+    usec_t deadline_ut;                     // monotonic time, 0 for no deadline
+    int (*interrupt_callback)(void *data);  // returns non-zero to stop the query, NULL for none
+    void *interrupt_callback_data;
+    int interrupted;                        // atomic, set once for good
+} RRDR_QUERY_DEADLINE;
+
 typedef struct rrdresult {
     struct rrdset *st;         // the chart this result refers to
 
@@ -55,33 +67,42 @@ typedef struct rrdresult {
     RRDR_DIMENSION_FLAGS *od; // the options for the dimensions
 
     time_t *t;                // array of n timestamps
-    calculated_number *v;     // array n x d values
+    query_number *v;          // array n x d values
     RRDR_VALUE_FLAGS *o;      // array n x d options for each value returned
 
     long group;               // how many collected values were grouped for each row
     int update_every;         // what is the suggested update frequency in seconds
 
-    calculated_number min;
-    calculated_number max;
+    query_number min;
+    query_number max;
 
     time_t before;
     time_t after;
 
     int has_st_lock;        // if st is read locked by us
+    int pool_class;         // the size class of the block of the RRDR and its arrays, -1 for none
 
     // internal rrd2rrdr() members below this point
     struct {
         long points_wanted;
         long resampling_group;
-        calculated_number resampling_divisor;
+        query_number resampling_divisor;
 
         void *(*grouping_create)(struct rrdresult *r);
         void (*grouping_reset)(struct rrdresult *r);
         void (*grouping_free)(struct rrdresult *r);
-        void (*grouping_add)(struct rrdresult *r, calculated_number value);
-        calculated_number (*grouping_flush)(struct rrdresult *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
+        void (*grouping_add)(struct rrdresult *r, query_number value);
+        void (*grouping_add_many)(struct rrdresult *r, const query_number *values, size_t count);
+        void (*grouping_add_summary)(struct rrdresult *r, query_number min, query_number max, query_number sum, size_t count);
+        query_number (*grouping_flush)(struct rrdresult *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
         void *grouping_data;
 
+        RRDR_QUERY_DEADLINE *deadline; // of the thread that runs the query, NULL when it has none
+
+        #ifdef ENABLE_DBENGINE
+        struct rrdeng_chart_query *chart_query; // the dimensions whose dbengine pages were preloaded together
+        #endif
+
         #ifdef NETDATA_INTERNAL_CHECKS
         const char *log;
         #endif
@@ -96,10 +117,27 @@ typedef struct rrdresult {
 extern void rrdr_free(RRDR *r);
 extern RRDR *rrdr_create(struct rrdset *st, long n);
 
+// how the values of many charts of the same context are aggregated into one RRDR
+typedef enum rrdr_charts_aggregation {
+    RRDR_CHARTS_AGGREGATION_SUM = 0,
+    RRDR_CHARTS_AGGREGATION_AVERAGE,
+    RRDR_CHARTS_AGGREGATION_MIN,
+    RRDR_CHARTS_AGGREGATION_MAX,
+} RRDR_CHARTS_AGGREGATION;
+
+extern RRDR_CHARTS_AGGREGATION rrdr_charts_aggregation_id(const char *name);
+extern uint32_t *rrdr_aggregation_start(RRDR *r);
+extern void rrdr_aggregate(RRDR *r, RRDR *m, RRDR_CHARTS_AGGREGATION aggregation, uint32_t *counts);
+extern void rrdr_aggregation_done(RRDR *r, RRDR_CHARTS_AGGREGATION aggregation, uint32_t *counts);
+
 #include "../web_api_v1.h"
 #include "web/api/queries/query.h"
 
 extern RRDR *rrd2rrdr(RRDSET *st, long points_requested, long long after_requested, long long before_requested, RRDR_GROUPING group_method, long resampling_time_requested, RRDR_OPTIONS options, const char *dimensions);
+extern void rrd2rrdr_set_deadline(RRDR_QUERY_DEADLINE *deadline);
+extern int rrd2rrdr_interrupted(void);
+extern void rrd2rrdr_init_previous_results(void);
+extern void rrd2rrdr_previous_results_statistics(size_t *hits, size_t *rows_reused);
 
 #include "query.h"
 
@@ -6,7 +6,7 @@
 // sum
 
 struct grouping_sum {
-    calculated_number sum;
+    query_number sum;
     size_t count;
 };
 
@@ -28,7 +28,7 @@ void grouping_free_sum(RRDR *r) {
     r->internal.grouping_data = NULL;
 }
 
-void grouping_add_sum(RRDR *r, calculated_number value) {
+void grouping_add_sum(RRDR *r, query_number value) {
     if(!isnan(value)) {
         struct grouping_sum *g = (struct grouping_sum *)r->internal.grouping_data;
         g->sum += value;
@@ -36,10 +36,50 @@ void grouping_add_sum(RRDR *r, calculated_number value) {
     }
 }
 
-calculated_number grouping_flush_sum(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+// adds count values at once, empty values are skipped
+// the 4 partial sums do not depend on each other, so consecutive additions can overlap
+void grouping_add_many_sum(RRDR *r, const query_number *values, size_t count) {
     struct grouping_sum *g = (struct grouping_sum *)r->internal.grouping_data;
+    query_number s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i, nans = 0;
 
-    calculated_number value;
+    for(i = 0; i + 4 <= count ; i += 4) {
+        query_number v0 = values[i], v1 = values[i + 1], v2 = values[i + 2], v3 = values[i + 3];
+
+        if(unlikely(isnan(v0))) { v0 = 0.0; nans++; }
+        if(unlikely(isnan(v1))) { v1 = 0.0; nans++; }
+        if(unlikely(isnan(v2))) { v2 = 0.0; nans++; }
+        if(unlikely(isnan(v3))) { v3 = 0.0; nans++; }
+
+        s0 += v0;
+        s1 += v1;
+        s2 += v2;
+        s3 += v3;
+    }
+
+    for(; i < count ; i++) {
+        if(unlikely(isnan(values[i]))) nans++;
+        else s0 += values[i];
+    }
+
+    g->sum += (s0 + s1) + (s2 + s3);
+    g->count += count - nans;
+}
+
+// adds points that were aggregated in advance, e.g. the points of a database page
+void grouping_add_summary_sum(RRDR *r, query_number min, query_number max, query_number sum, size_t count) {
+    (void)min;
+    (void)max;
+
+    struct grouping_sum *g = (struct grouping_sum *)r->internal.grouping_data;
+    g->sum += sum;
+    g->count += count;
+}
+
+query_number grouping_flush_sum(RRDR *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr) {
+    struct grouping_sum *g = (struct grouping_sum *)r->internal.grouping_data;
+
+    query_number value;
 
     if(unlikely(!g->count)) {
         value = 0.0;
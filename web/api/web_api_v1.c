@@ -53,6 +53,8 @@ static struct {
         , {DATASOURCE_FORMAT_SSV_COMMA      , 0 , DATASOURCE_SSV_COMMA}
         , {DATASOURCE_FORMAT_CSV_JSON_ARRAY , 0 , DATASOURCE_CSV_JSON_ARRAY}
         , {DATASOURCE_FORMAT_CSV_MARKDOWN   , 0 , DATASOURCE_CSV_MARKDOWN}
+        , {DATASOURCE_FORMAT_BINARY         , 0 , DATASOURCE_BINARY}
+        , {DATASOURCE_FORMAT_BINARY_FLOAT32 , 0 , DATASOURCE_BINARY_FLOAT32}
         , {                                 NULL, 0, 0}
 };
 
@@ -70,6 +72,19 @@ static struct {
         , {           NULL, 0, 0}
 };
 
+// the requests of each endpoint that may run at the same time, 0 for no limit, see web_request_admitted()
+static uint32_t api_max_in_flight[GLOBAL_STATS_API_ENDPOINTS] = { 0 };
+
+static void web_client_api_v1_init_admission(void) {
+    // the default web server threads, but one, are left to the expensive endpoints
+    long def = (processors > 6) ? 5 : processors - 1;
+    if(def < 1) def = 1;
+
+    api_max_in_flight[GLOBAL_STATS_API_DATA] = (uint32_t)config_get_number(CONFIG_SECTION_WEB, "max concurrent data requests", def);
+    api_max_in_flight[GLOBAL_STATS_API_CHARTS] = (uint32_t)config_get_number(CONFIG_SECTION_WEB, "max concurrent charts requests", def);
+    api_max_in_flight[GLOBAL_STATS_API_ALLMETRICS] = (uint32_t)config_get_number(CONFIG_SECTION_WEB, "max concurrent allmetrics requests", def);
+}
+
 void web_client_api_v1_init(void) {
     int i;
 
@@ -83,6 +98,11 @@ void web_client_api_v1_init(void) {
         api_v1_data_google_formats[i].hash = simple_hash(api_v1_data_google_formats[i].name);
 
     web_client_api_v1_init_grouping();
+    web_client_api_v1_init_admission();
+    rrd2rrdr_init_query_threads();
+    rrd2rrdr_init_previous_results();
+    rrdset2anything_cache_init();
+    metric_correlations_init();
 
 	uuid_t uuid;
 
@@ -196,20 +216,25 @@ inline uint32_t web_client_api_request_v1_data_google_format(char *name) {
 
 inline int web_client_api_request_v1_alarms(RRDHOST *host, struct web_client *w, char *url) {
     int all = 0;
+    uint32_t if_modified_since = 0;
 
     while(url) {
         char *value = mystrsep(&url, "&");
         if (!value || !*value) continue;
 
-        if(!strcmp(value, "all")) all = 1;
-        else if(!strcmp(value, "active")) all = 0;
+        char *name = mystrsep(&value, "=");
+        if(!name || !*name) continue;
+
+        if(!strcmp(name, "all")) all = 1;
+        else if(!strcmp(name, "active")) all = 0;
+        else if(!strcmp(name, "if_modified_since") && value && *value) if_modified_since = (uint32_t)strtoul(value, NULL, 0);
     }
 
     buffer_flush(w->response.data);
     w->response.data->contenttype = CT_APPLICATION_JSON;
-    health_alarms2json(host, w->response.data, all);
+    int not_modified = health_alarms2json(host, w->response.data, all, if_modified_since);
     buffer_no_cacheable(w->response.data);
-    return 200;
+    return (not_modified)?304:200;
 }
 
 inline int web_client_api_request_v1_alarm_log(RRDHOST *host, struct web_client *w, char *url) {
@@ -271,7 +296,7 @@ inline int web_client_api_request_single_chart(RRDHOST *host, struct web_client
     }
 
     w->response.data->contenttype = CT_APPLICATION_JSON;
-    st->last_accessed_time = now_realtime_sec();
+    st->last_accessed_time = now_realtime_coarse_sec();
     callback(st, w->response.data);
     return 200;
 
@@ -324,12 +349,16 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
     time_t last_timestamp_in_data = 0, google_timestamp = 0;
 
     char *chart = NULL
+    , *context = NULL
+    , *charts_str = NULL
     , *before_str = NULL
     , *after_str = NULL
     , *group_time_str = NULL
-    , *points_str = NULL;
+    , *points_str = NULL
+    , *timeout_str = NULL;
 
     int group = RRDR_GROUPING_AVERAGE;
+    RRDR_CHARTS_AGGREGATION aggregation = RRDR_CHARTS_AGGREGATION_SUM;
     uint32_t format = DATASOURCE_JSON;
     uint32_t options = 0x00000000;
 
@@ -347,6 +376,9 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
         // they are not null and not empty
 
         if(!strcmp(name, "chart")) chart = value;
+        else if(!strcmp(name, "context")) context = value;
+        else if(!strcmp(name, "charts")) charts_str = value;
+        else if(!strcmp(name, "aggregation")) aggregation = rrdr_charts_aggregation_id(value);
         else if(!strcmp(name, "dimension") || !strcmp(name, "dim") || !strcmp(name, "dimensions") || !strcmp(name, "dims")) {
             if(!dimensions) dimensions = buffer_create(100);
             buffer_strcat(dimensions, "|");
@@ -356,6 +388,7 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
         else if(!strcmp(name, "before")) before_str = value;
         else if(!strcmp(name, "points")) points_str = value;
         else if(!strcmp(name, "gtime")) group_time_str = value;
+        else if(!strcmp(name, "timeout")) timeout_str = value;
         else if(!strcmp(name, "group")) {
             group = web_client_api_request_v1_data_group(value, RRDR_GROUPING_AVERAGE);
         }
@@ -412,29 +445,32 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
     fix_google_param(responseHandler);
     fix_google_param(outFileName);
 
-    if(!chart || !*chart) {
-        buffer_sprintf(w->response.data, "No chart id is given at the request.");
-        goto cleanup;
+    RRDSET *st = NULL;
+    if(chart && *chart) {
+        st = rrdset_find(host, chart);
+        if(!st) st = rrdset_find_byname(host, chart);
+        if(!st) {
+            buffer_strcat(w->response.data, "Chart is not found: ");
+            buffer_strcat_htmlescape(w->response.data, chart);
+            ret = 404;
+            goto cleanup;
+        }
+        st->last_accessed_time = now_realtime_coarse_sec();
     }
-
-    RRDSET *st = rrdset_find(host, chart);
-    if(!st) st = rrdset_find_byname(host, chart);
-    if(!st) {
-        buffer_strcat(w->response.data, "Chart is not found: ");
-        buffer_strcat_htmlescape(w->response.data, chart);
-        ret = 404;
+    else if(!context || !*context) {
+        buffer_sprintf(w->response.data, "No chart id or context is given at the request.");
         goto cleanup;
     }
-    st->last_accessed_time = now_realtime_sec();
 
     long long before = (before_str && *before_str)?str2l(before_str):0;
     long long after  = (after_str  && *after_str) ?str2l(after_str):0;
     int       points = (points_str && *points_str)?str2i(points_str):0;
     long      group_time = (group_time_str && *group_time_str)?str2l(group_time_str):0;
+    long      timeout_ms = (timeout_str && *timeout_str)?str2l(timeout_str):0;
 
     debug(D_WEB_CLIENT, "%llu: API command 'data' for chart '%s', dimensions '%s', after '%lld', before '%lld', points '%d', group '%d', format '%u', options '0x%08x'"
           , w->id
-          , chart
+          , (st)?chart:context
           , (dimensions)?buffer_tostring(dimensions):""
           , after
           , before
@@ -459,7 +495,7 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
 
         buffer_sprintf(w->response.data,
                 "%s({version:'%s',reqId:'%s',status:'ok',sig:'%ld',table:",
-                responseHandler, google_version, google_reqId, st->last_updated.tv_sec);
+                responseHandler, google_version, google_reqId, (st)?st->last_updated.tv_sec:now_realtime_sec());
     }
     else if(format == DATASOURCE_JSONP) {
         if(responseHandler == NULL)
@@ -469,8 +505,29 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
         buffer_strcat(w->response.data, "(");
     }
 
-    ret = rrdset2anything_api_v1(st, w->response.data, dimensions, format, points, after, before, group, group_time
-                                 , options, &last_timestamp_in_data);
+    // the query stops when the client goes away, or after timeout milliseconds
+    RRDR_QUERY_DEADLINE deadline = {
+            .deadline_ut = (timeout_ms > 0) ? now_monotonic_usec() + (usec_t)timeout_ms * USEC_PER_MS : 0,
+            .interrupt_callback = web_client_interrupt_callback,
+            .interrupt_callback_data = w,
+            .interrupted = 0
+    };
+    rrd2rrdr_set_deadline(&deadline);
+
+    if(st)
+        ret = rrdset2anything_api_v1(st, w->response.data, dimensions, format, points, after, before, group, group_time
+                                     , options, &last_timestamp_in_data);
+    else {
+        // all the charts of the context, aggregated
+        SIMPLE_PATTERN *charts = (charts_str && *charts_str)?simple_pattern_create(charts_str, NULL, SIMPLE_PATTERN_EXACT):NULL;
+        ret = rrdcontext2anything_api_v1(host, context, charts, aggregation, w->response.data, dimensions, format, points, after
+                                         , before, group, group_time, options, &last_timestamp_in_data);
+        simple_pattern_free(charts);
+    }
+
+    rrd2rrdr_set_deadline(NULL);
+    if(__atomic_load_n(&deadline.interrupted, __ATOMIC_RELAXED))
+        buffer_strcat(w->response.header, "X-Netdata-Partial: true\r\n");
 
     if(format == DATASOURCE_DATATABLE_JSONP) {
         if(google_timestamp < last_timestamp_in_data)
@@ -492,6 +549,200 @@ inline int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, c
     return ret;
 }
 
+// ----------------------------------------------------------------------------
+// live chart updates, with server-sent events
+//
+// the client subscribes once to a set of charts, and the connection stays open:
+// every time the web server timer ticks, the rows collected since the previous
+// event of each chart are queried and sent, as an event named after the chart
+
+struct subscription_chart {
+    char *id;
+    time_t last_t;                      // the timestamp of the last row sent
+};
+
+struct subscription {
+    char machine_guid[GUID_LEN + 1];    // the host of the charts, which may be gone by the next call
+    BUFFER *dimensions;
+    uint32_t format;
+    uint32_t options;
+
+    size_t used;
+    struct subscription_chart *charts;
+
+    time_t last_sent_t;                 // the last time anything has been sent, for the keep-alives
+    BUFFER *event;                      // the output of each query, before it is sent as an event
+};
+
+static void subscription_free(void *data) {
+    struct subscription *s = data;
+    size_t i;
+
+    for(i = 0; i < s->used ; i++)
+        freez(s->charts[i].id);
+
+    freez(s->charts);
+    buffer_free(s->dimensions);
+    buffer_free(s->event);
+    freez(s);
+}
+
+// each line of the output becomes a data line of the event
+static void subscription_send_event(BUFFER *wb, const char *name, time_t t, BUFFER *event) {
+    char *s = (char *)buffer_tostring(event);
+
+    buffer_sprintf(wb, "event: %s\nid: %ld\n", name, (long)t);
+
+    while(s) {
+        char *line = mystrsep(&s, "\r\n");
+        if(!line || !*line) continue;
+
+        buffer_strcat(wb, "data: ");
+        buffer_strcat(wb, line);
+        buffer_strcat(wb, "\n");
+    }
+
+    buffer_strcat(wb, "\n");
+}
+
+static int subscription_produce(struct web_client *w, void *data) {
+    struct subscription *s = data;
+    BUFFER *wb = w->response.data;
+    size_t i, len = wb->len;
+
+    rrd_rdlock();
+
+    RRDHOST *host = rrdhost_find_by_guid(s->machine_guid, 0);
+    if(unlikely(!host)) {
+        rrd_unlock();
+        return 0;
+    }
+
+    for(i = 0; i < s->used ; i++) {
+        struct subscription_chart *c = &s->charts[i];
+
+        RRDSET *st = rrdset_find(host, c->id);
+        if(unlikely(!st)) continue;
+
+        time_t last_t = rrdset_last_entry_t(st);
+        if(last_t <= c->last_t) continue;
+
+        // a client that is far behind, gets the rows the chart still has
+        time_t first_t = rrdset_first_entry_t(st);
+        if(c->last_t < first_t) c->last_t = first_t;
+
+        time_t latest_timestamp = 0;
+        buffer_flush(s->event);
+        if(rrdset2anything_api_v1(st, s->event, s->dimensions, s->format, 0, c->last_t, last_t
+                                  , RRDR_GROUPING_AVERAGE, 0, s->options, &latest_timestamp) == 200)
+            subscription_send_event(wb, st->id, last_t, s->event);
+
+        c->last_t = last_t;
+    }
+
+    rrd_unlock();
+
+    time_t now = now_boottime_sec();
+    if(wb->len != len)
+        s->last_sent_t = now;
+
+    else if(now - s->last_sent_t >= ((web_client_timeout > 2) ? web_client_timeout / 2 : 1)) {
+        // a comment, so that the connection is not closed as idle
+        buffer_strcat(wb, ": keep-alive\n\n");
+        s->last_sent_t = now;
+    }
+
+    return WEB_CLIENT_PRODUCER_WAIT;
+}
+
+// returns the HTTP code
+inline int web_client_api_request_v1_subscribe(RRDHOST *host, struct web_client *w, char *url) {
+    debug(D_WEB_CLIENT, "%llu: API v1 subscribe with URL '%s'", w->id, url);
+
+    struct subscription *s = callocz(1, sizeof(struct subscription));
+    char *charts = NULL;
+    long long after = 0;
+    size_t size = 0;
+
+    s->format = DATASOURCE_JSON;
+
+    buffer_flush(w->response.data);
+
+    while(url) {
+        char *value = mystrsep(&url, "&");
+        if(!value || !*value) continue;
+
+        char *name = mystrsep(&value, "=");
+        if(!name || !*name) continue;
+        if(!value || !*value) continue;
+
+        if(!strcmp(name, "charts") || !strcmp(name, "chart")) charts = value;
+        else if(!strcmp(name, "dimension") || !strcmp(name, "dim") || !strcmp(name, "dimensions") || !strcmp(name, "dims")) {
+            if(!s->dimensions) s->dimensions = buffer_create(100);
+            buffer_strcat(s->dimensions, "|");
+            buffer_strcat(s->dimensions, value);
+        }
+        else if(!strcmp(name, "after")) after = str2l(value);
+        else if(!strcmp(name, "format")) s->format = web_client_api_request_v1_data_format(value);
+        else if(!strcmp(name, "options")) s->options |= web_client_api_request_v1_data_options(value);
+    }
+
+    // the rows are sent as they are collected, never grouped, aligned or wrapped
+    s->options &= ~RRDR_OPTION_JSON_WRAP;
+    s->options |= RRDR_OPTION_NOT_ALIGNED;
+
+    if(s->format == DATASOURCE_JSONP || s->format == DATASOURCE_DATATABLE_JSONP) {
+        buffer_strcat(w->response.data, "JSONP formats cannot be subscribed to.");
+        subscription_free(s);
+        return 400;
+    }
+
+    while(charts) {
+        char *id = mystrsep(&charts, ",|");
+        if(!id || !*id) continue;
+
+        RRDSET *st = rrdset_find(host, id);
+        if(!st) st = rrdset_find_byname(host, id);
+        if(!st) {
+            buffer_strcat(w->response.data, "Chart is not found: ");
+            buffer_strcat_htmlescape(w->response.data, id);
+            subscription_free(s);
+            return 404;
+        }
+
+        if(s->used == size) {
+            size = (size) ? size * 2 : 16;
+            s->charts = reallocz(s->charts, size * sizeof(struct subscription_chart));
+        }
+
+        // without after, the client gets the rows collected from now on
+        time_t last_t = rrdset_last_entry_t(st);
+        s->charts[s->used].id = strdupz(st->id);
+        s->charts[s->used].last_t = (after > 0 && after < last_t) ? (time_t)after : last_t;
+        s->used++;
+    }
+
+    if(!s->used) {
+        buffer_strcat(w->response.data, "No charts are given at the request.");
+        subscription_free(s);
+        return 400;
+    }
+
+    strncpyz(s->machine_guid, host->machine_guid, GUID_LEN);
+    s->event = buffer_create(1024);
+    s->last_sent_t = now_boottime_sec();
+
+    // the events have to reach the client as soon as they are sent
+    w->response.zoutput = 0;
+
+    w->response.data->contenttype = CT_TEXT_EVENT_STREAM;
+    buffer_no_cacheable(w->response.data);
+    buffer_sprintf(w->response.data, "retry: %d\n\n", default_rrd_update_every * 1000);
+
+    web_client_set_producer(w, subscription_produce, subscription_free, s);
+    return 200;
+}
+
 // Pings a netdata server:
 // /api/v1/registry?action=hello
 //
@@ -759,30 +1010,113 @@ inline int web_client_api_request_v1_info(RRDHOST *host, struct web_client *w, c
     return 200;
 }
 
+// Finds the dimensions that changed the most between two timeframes:
+// /api/v1/metric_correlations?after=-300&before=0&baseline_after=-1500&baseline_before=-300&points=100&max_items=50&timeout=10000
+inline int web_client_api_request_v1_metric_correlations(RRDHOST *host, struct web_client *w, char *url) {
+    long long after = 0, before = 0, baseline_after = 0, baseline_before = 0;
+    long points = 0;
+    size_t max_items = 0;
+    long timeout_ms = 10000;
+
+    buffer_flush(w->response.data);
+
+    while(url) {
+        char *value = mystrsep(&url, "&");
+        if(!value || !*value) continue;
+
+        char *name = mystrsep(&value, "=");
+        if(!name || !*name) continue;
+        if(!value || !*value) continue;
+
+        if(!strcmp(name, "after")) after = str2l(value);
+        else if(!strcmp(name, "before")) before = str2l(value);
+        else if(!strcmp(name, "baseline_after")) baseline_after = str2l(value);
+        else if(!strcmp(name, "baseline_before")) baseline_before = str2l(value);
+        else if(!strcmp(name, "points")) points = str2l(value);
+        else if(!strcmp(name, "max_items")) max_items = str2ul(value);
+        else if(!strcmp(name, "timeout")) timeout_ms = str2l(value);
+    }
+
+    if(timeout_ms <= 0) timeout_ms = 10000;
+
+    return metric_correlations(host, w->response.data, after, before, baseline_after, baseline_before, points, max_items, (usec_t)timeout_ms * USEC_PER_MS);
+}
+
+inline int web_client_api_request_v1_locks(RRDHOST *host, struct web_client *w, char *url) {
+    (void)host;
+    (void)url;
+
+    BUFFER *wb = w->response.data;
+    buffer_flush(wb);
+    wb->contenttype = CT_APPLICATION_JSON;
+
+    netdata_locks_profile2json(wb);
+
+    buffer_no_cacheable(wb);
+    return 200;
+}
+
+// The charts that cost the most to collect, since they were created:
+// /api/v1/costly_charts?top=20&sort=time|pushed|backend
+inline int web_client_api_request_v1_costly_charts(RRDHOST *host, struct web_client *w, char *url) {
+    size_t top = 20;
+    COSTLY_CHARTS_SORT sort = COSTLY_CHARTS_SORT_TIME;
+
+    while(url) {
+        char *value = mystrsep(&url, "&");
+        if(!value || !*value) continue;
+
+        char *name = mystrsep(&value, "=");
+        if(!name || !*name) continue;
+        if(!value || !*value) continue;
+
+        if(!strcmp(name, "top")) top = str2ul(value);
+        else if(!strcmp(name, "sort")) {
+            if(!strcmp(value, "pushed")) sort = COSTLY_CHARTS_SORT_PUSHED;
+            else if(!strcmp(value, "backend")) sort = COSTLY_CHARTS_SORT_BACKEND;
+            else sort = COSTLY_CHARTS_SORT_TIME;
+        }
+    }
+
+    BUFFER *wb = w->response.data;
+    buffer_flush(wb);
+    wb->contenttype = CT_APPLICATION_JSON;
+
+    costly_charts2json(host, wb, top, sort);
+
+    buffer_no_cacheable(wb);
+    return 200;
+}
+
 static struct api_command {
     const char *command;
     uint32_t hash;
     WEB_CLIENT_ACL acl;
     int (*callback)(RRDHOST *host, struct web_client *w, char *url);
+    GLOBAL_STATS_API_ENDPOINT endpoint;     // the latency histogram of the command
 } api_commands[] = {
-        { "info",            0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_info            },
-        { "data",            0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_data            },
-        { "chart",           0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_chart           },
-        { "charts",          0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_charts          },
+        { "info",            0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_info,            GLOBAL_STATS_API_OTHER },
+        { "data",            0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_data,            GLOBAL_STATS_API_DATA },
+        { "subscribe",       0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_subscribe,       GLOBAL_STATS_API_OTHER },
+        { "chart",           0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_chart,           GLOBAL_STATS_API_OTHER },
+        { "charts",          0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_charts,          GLOBAL_STATS_API_CHARTS },
 
         // registry checks the ACL by itself, so we allow everything
-        { "registry",        0, WEB_CLIENT_ACL_NOCHECK,   web_client_api_request_v1_registry        },
+        { "registry",        0, WEB_CLIENT_ACL_NOCHECK,   web_client_api_request_v1_registry,        GLOBAL_STATS_API_OTHER },
 
         // badges can be fetched with both dashboard and badge permissions
-        { "badge.svg",       0, WEB_CLIENT_ACL_DASHBOARD|WEB_CLIENT_ACL_BADGE, web_client_api_request_v1_badge },
-
-        { "alarms",          0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_alarms          },
-        { "alarm_log",       0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_alarm_log       },
-        { "alarm_variables", 0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_alarm_variables },
-        { "allmetrics",      0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_allmetrics      },
-        { "manage/health",   0, WEB_CLIENT_ACL_MGMT,      web_client_api_request_v1_mgmt_health     },
+        { "badge.svg",       0, WEB_CLIENT_ACL_DASHBOARD|WEB_CLIENT_ACL_BADGE, web_client_api_request_v1_badge, GLOBAL_STATS_API_BADGE },
+
+        { "alarms",          0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_alarms,          GLOBAL_STATS_API_OTHER },
+        { "alarm_log",       0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_alarm_log,       GLOBAL_STATS_API_OTHER },
+        { "alarm_variables", 0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_alarm_variables, GLOBAL_STATS_API_OTHER },
+        { "allmetrics",      0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_allmetrics,      GLOBAL_STATS_API_ALLMETRICS },
+        { "manage/health",   0, WEB_CLIENT_ACL_MGMT,      web_client_api_request_v1_mgmt_health,     GLOBAL_STATS_API_OTHER },
+        { "locks",           0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_locks,           GLOBAL_STATS_API_OTHER },
+        { "metric_correlations", 0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_metric_correlations, GLOBAL_STATS_API_OTHER },
+        { "costly_charts",   0, WEB_CLIENT_ACL_DASHBOARD, web_client_api_request_v1_costly_charts,   GLOBAL_STATS_API_OTHER },
         // terminator
-        { NULL,              0, WEB_CLIENT_ACL_NONE,      NULL                                      },
+        { NULL,              0, WEB_CLIENT_ACL_NONE,      NULL,                                      GLOBAL_STATS_API_NONE },
 };
 
 inline int web_client_api_request_v1(RRDHOST *host, struct web_client *w, char *url) {
@@ -807,7 +1141,21 @@ inline int web_client_api_request_v1(RRDHOST *host, struct web_client *w, char *
                 if(unlikely(api_commands[i].acl != WEB_CLIENT_ACL_NOCHECK) &&  !(w->acl & api_commands[i].acl))
                     return web_client_permission_denied(w);
 
-                return api_commands[i].callback(host, w, url);
+                GLOBAL_STATS_API_ENDPOINT endpoint = api_commands[i].endpoint;
+                w->api_endpoint = (uint8_t)endpoint;
+
+                // shed the load of the expensive endpoints, instead of queueing it
+                if(unlikely(!web_request_admitted(endpoint, api_max_in_flight[endpoint]))) {
+                    buffer_flush(w->response.data);
+                    buffer_sprintf(w->response.data, "Too many concurrent %s requests, please retry.", tok);
+                    buffer_strcat(w->response.header, "Retry-After: 1\r\n");
+                    buffer_no_cacheable(w->response.data);
+                    return 503;
+                }
+
+                int ret = api_commands[i].callback(host, w, url);
+                web_request_completed(endpoint);
+                return ret;
             }
         }
 
@@ -7,6 +7,7 @@
 #include "web/api/badges/web_buffer_svg.h"
 #include "web/api/formatters/rrd2json.h"
 #include "web/api/health/health_cmdapi.h"
+#include "web/api/queries/correlations.h"
 
 extern uint32_t web_client_api_request_v1_data_options(char *o);
 extern uint32_t web_client_api_request_v1_data_format(char *name);
@@ -19,8 +20,12 @@ extern int web_client_api_request_v1_alarm_variables(RRDHOST *host, struct web_c
 extern int web_client_api_request_v1_charts(RRDHOST *host, struct web_client *w, char *url);
 extern int web_client_api_request_v1_chart(RRDHOST *host, struct web_client *w, char *url);
 extern int web_client_api_request_v1_data(RRDHOST *host, struct web_client *w, char *url);
+extern int web_client_api_request_v1_subscribe(RRDHOST *host, struct web_client *w, char *url);
 extern int web_client_api_request_v1_registry(RRDHOST *host, struct web_client *w, char *url);
 extern int web_client_api_request_v1_info(RRDHOST *host, struct web_client *w, char *url);
+extern int web_client_api_request_v1_locks(RRDHOST *host, struct web_client *w, char *url);
+extern int web_client_api_request_v1_metric_correlations(RRDHOST *host, struct web_client *w, char *url);
+extern int web_client_api_request_v1_costly_charts(RRDHOST *host, struct web_client *w, char *url);
 extern int web_client_api_request_v1(RRDHOST *host, struct web_client *w, char *url);
 
 extern void web_client_api_v1_init(void);
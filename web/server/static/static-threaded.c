@@ -23,6 +23,11 @@ static struct web_client *web_client_create_on_fd(int fd, const char *client_ip,
     if(unlikely(!*w->client_port)) strcpy(w->client_port, "-");
 	w->port_acl = port_acl;
 
+    if(!strncmp(client_port, "UNIX", 4))
+        web_client_set_unix(w);
+    else
+        web_client_set_tcp(w);
+
     web_client_initialize_connection(w);
     return(w);
 }
@@ -37,6 +42,7 @@ struct web_server_static_threaded_worker {
     int running;
 
     size_t max_sockets;
+    LISTEN_SOCKETS *sockets;            // the listening sockets this worker accepts connections from
 
     volatile size_t connected;
     volatile size_t disconnected;
@@ -46,6 +52,8 @@ struct web_server_static_threaded_worker {
 
     volatile size_t files_read;
     volatile size_t file_reads;
+
+    POLLJOB *poll_job;                  // the sockets of the worker, set at its first connection
 };
 
 static long long static_threaded_workers_count = 1;
@@ -53,6 +61,20 @@ static long long static_threaded_workers_count = 1;
 static struct web_server_static_threaded_worker *static_workers_private_data = NULL;
 static __thread struct web_server_static_threaded_worker *worker_private = NULL;
 
+// copies to connections the number of connections each of the first max workers has accepted
+// returns the number of workers, 0 when the static-threaded web server is not running
+size_t web_server_threads_connections(size_t *connections, size_t max) {
+    size_t i;
+
+    if(unlikely(!static_workers_private_data))
+        return 0;
+
+    for(i = 0; i < (size_t)static_threaded_workers_count && i < max ; i++)
+        connections[i] = static_workers_private_data[i].connected;
+
+    return (size_t)static_threaded_workers_count;
+}
+
 // ----------------------------------------------------------------------------
 
 static inline int web_server_check_client_status(struct web_client *w) {
@@ -86,6 +108,14 @@ static void web_werver_file_del_callback(POLLINFO *pi) {
         debug(D_WEB_CLIENT, "%llu: CROSS WEB CLIENT CLEANUP (iFD %d, oFD %d)", w->id, pi->fd, w->ofd);
         web_client_release(w);
     }
+    else if(unlikely(web_client_has_pipelined_request(w))) {
+        // the next requests of the client were waiting for this file to be closed
+        POLLJOB *p = pi->p;
+        POLLINFO *wpi = pollinfo_from_slot(p, w->pollinfo_slot);
+
+        debug(D_WEB_CLIENT, "%llu: SIGNALING W TO PROCESS PIPELINED REQUESTS (iFD %d, oFD %d)", w->id, pi->fd, wpi->fd);
+        poll_set_events(wpi, (short int)(p->fds[wpi->slot].events | POLLOUT));
+    }
 }
 
 static int web_server_file_read_callback(POLLINFO *pi, short int *events) {
@@ -113,7 +143,7 @@ static int web_server_file_read_callback(POLLINFO *pi, short int *events) {
         POLLINFO *wpi = pollinfo_from_slot(p, w->pollinfo_slot);  // POLLINFO of the client socket
 
         debug(D_WEB_CLIENT, "%llu: SIGNALING W TO SEND (iFD %d, oFD %d)", w->id, pi->fd, wpi->fd);
-        p->fds[wpi->slot].events |= POLLOUT;
+        poll_set_events(wpi, (short int)(p->fds[wpi->slot].events | POLLOUT));
     }
 
     if(unlikely(ret <= 0 || w->ifd == w->ofd)) {
@@ -137,10 +167,85 @@ static int web_server_file_write_callback(POLLINFO *pi, short int *events) {
 // ----------------------------------------------------------------------------
 // web server clients
 
+#ifdef ENABLE_HTTPS
+
+#define web_server_ssl_handshake_pending(w) ((w)->ssl.flags & (NETDATA_SSL_START | NETDATA_SSL_WANT_READ | NETDATA_SSL_WANT_WRITE))
+
+// Detects if the client speaks TLS and runs its handshake without blocking, a
+// step every time the socket is ready, so that a slow or a big number of
+// handshakes do not delay the other clients of the thread.
+// Returns -1 to disconnect the client, or 0 with the events to wait for.
+static int web_server_ssl_handshake(struct web_client *w, short int *events) {
+    if(w->ssl.flags & NETDATA_SSL_START) {
+        //Read the first 7 bytes from the message, but the message
+        //is not removed from the queue, because we are using MSG_PEEK
+        char test[8];
+        ssize_t bytes = recv(w->ifd, test, 7, MSG_PEEK | MSG_DONTWAIT);
+        if(bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            debug(D_WEB_CLIENT, "%llu: the client closed the connection before sending a request.", w->id);
+            WEB_CLIENT_IS_DEAD(w);
+            return -1;
+        }
+
+        if(bytes < 7 && !(bytes > 0 && test[0] >= 0x18)) {
+            //The message was not completely received, so
+            //it cannot be identified yet.
+            *events = POLLIN;
+            return 0;
+        }
+
+        //The SSL structure is reused, when the client had one.
+        //It is needed for plain HTTP too, to redirect it when SSL is forced.
+        if (!w->ssl.conn) {
+            w->ssl.conn = SSL_new(netdata_srv_ctx);
+            if (w->ssl.conn)
+                SSL_set_accept_state(w->ssl.conn);
+            else
+                error("Failed to create SSL context on socket fd %d.", w->ifd);
+        }
+
+        if(test[0] >= 0x18) {
+            //A normal HTTP request instead of a Client Hello (HTTPS).
+            w->ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
+            *events = POLLIN;
+            return 0;
+        }
+
+        if (!w->ssl.conn) {
+            WEB_CLIENT_IS_DEAD(w);
+            return -1;
+        }
+
+        if (SSL_set_fd(w->ssl.conn, w->ifd) != 1) {
+            error("Failed to set the socket to the SSL on socket fd %d.", w->ifd);
+            WEB_CLIENT_IS_DEAD(w);
+            return -1;
+        }
+    }
+
+    w->ssl.flags = security_process_accept(w->ssl.conn, 0);
+    switch(w->ssl.flags) {
+        case NETDATA_SSL_HANDSHAKE_COMPLETE:
+        case NETDATA_SSL_WANT_READ:
+            *events = POLLIN;
+            return 0;
+
+        case NETDATA_SSL_WANT_WRITE:
+            *events = POLLOUT;
+            return 0;
+
+        default:
+            WEB_CLIENT_IS_DEAD(w);
+            return -1;
+    }
+}
+#endif
+
 static void *web_server_add_callback(POLLINFO *pi, short int *events, void *data) {
     (void)data;
 
     worker_private->connected++;
+    worker_private->poll_job = pi->p;
 
     size_t concurrent = worker_private->connected - worker_private->disconnected;
     if(unlikely(concurrent > worker_private->max_concurrent))
@@ -152,66 +257,12 @@ static void *web_server_add_callback(POLLINFO *pi, short int *events, void *data
     struct web_client *w = web_client_create_on_fd(pi->fd, pi->client_ip, pi->client_port, pi->port_acl);
     w->pollinfo_slot = pi->slot;
 
-    if ( !strncmp(pi->client_port,"UNIX",4)){
-        web_client_set_unix(w);
-    } else {
-        web_client_set_tcp(w);
-    }
-
 #ifdef ENABLE_HTTPS
-    if ((!web_client_check_unix(w)) && ( netdata_srv_ctx )) {
-        if( sock_delnonblock(w->ifd) < 0 ){
-            error("Web server cannot remove the non-blocking flag from socket %d",w->ifd);
-        }
-
-        //Read the first 7 bytes from the message, but the message
-        //is not removed from the queue, because we are using MSG_PEEK
-        char test[8];
-        if ( recv(w->ifd,test, 7,MSG_PEEK) == 7 ) {
-            test[7] = 0x00;
-        }
-        else {
-            //Case I do not have success to read 7 bytes,
-            //this means that the mensage was not completely read, so
-            //I cannot identify it yet.
-            sock_setnonblock(w->ifd);
-            return w;
-        }
-
-        //The next two ifs are not together because I am reusing SSL structure
-        if (!w->ssl.conn)
-        {
-            w->ssl.conn = SSL_new(netdata_srv_ctx);
-            if ( w->ssl.conn ) {
-                SSL_set_accept_state(w->ssl.conn);
-            } else {
-                error("Failed to create SSL context on socket fd %d.", w->ifd);
-                if (test[0] < 0x18){
-                    WEB_CLIENT_IS_DEAD(w);
-                    sock_setnonblock(w->ifd);
-                    return w;
-                }
-            }
-        }
-
-        if (w->ssl.conn) {
-            if (SSL_set_fd(w->ssl.conn, w->ifd) != 1) {
-                error("Failed to set the socket to the SSL on socket fd %d.", w->ifd);
-                //The client is not set dead, because I received a normal HTTP request
-                //instead a Client Hello(HTTPS).
-                if ( test[0] < 0x18 ){
-                    WEB_CLIENT_IS_DEAD(w);
-                }
-            }
-            else{
-                w->ssl.flags = security_process_accept(w->ssl.conn, (int)test[0]);
-            }
-        }
-
-        sock_setnonblock(w->ifd);
-    } else{
+    // the handshake is done by web_server_ssl_handshake(), when the client sends data
+    if ((!web_client_check_unix(w)) && ( netdata_srv_ctx ))
+        w->ssl.flags = NETDATA_SSL_START;
+    else
         w->ssl.flags = NETDATA_SSL_NO_HANDSHAKE;
-    }
 #endif
 
     debug(D_WEB_CLIENT, "%llu: ADDED CLIENT FD %d", w->id, pi->fd);
@@ -240,21 +291,14 @@ static void web_server_del_callback(POLLINFO *pi) {
     }
 }
 
-static int web_server_rcv_callback(POLLINFO *pi, short int *events) {
-    worker_private->receptions++;
-
+static int web_server_process_received(POLLINFO *pi, short int *events) {
     struct web_client *w = (struct web_client *)pi->data;
     int fd = pi->fd;
 
-    //BRING IT TO HERE
-
-    if(unlikely(web_client_receive(w) < 0))
-        return -1;
-
     debug(D_WEB_CLIENT, "%llu: processing received data on fd %d.", w->id, fd);
     web_client_process_request(w);
 
-    if(unlikely(w->mode == WEB_CLIENT_MODE_FILECOPY)) {
+    if(unlikely(w->mode == WEB_CLIENT_MODE_FILECOPY && !w->response.sendfile)) {
         if(w->pollinfo_filecopy_slot == 0) {
             debug(D_WEB_CLIENT, "%llu: FILECOPY DETECTED ON FD %d", w->id, pi->fd);
 
@@ -297,17 +341,56 @@ static int web_server_rcv_callback(POLLINFO *pi, short int *events) {
     return web_server_check_client_status(w);
 }
 
+static int web_server_rcv_callback(POLLINFO *pi, short int *events) {
+    worker_private->receptions++;
+
+    struct web_client *w = (struct web_client *)pi->data;
+
+#ifdef ENABLE_HTTPS
+    if(unlikely(web_server_ssl_handshake_pending(w)))
+        return web_server_ssl_handshake(w, events);
+#endif
+
+    ssize_t bytes = web_client_receive(w);
+    if(unlikely(bytes < 0))
+        return -1;
+
+#ifdef ENABLE_HTTPS
+    // the data received are not a complete TLS record yet
+    if(unlikely(!bytes && !web_client_check_dead(w) && w->mode != WEB_CLIENT_MODE_FILECOPY)) {
+        *events = POLLIN;
+        return 0;
+    }
+#endif
+
+    return web_server_process_received(pi, events);
+}
+
 static int web_server_snd_callback(POLLINFO *pi, short int *events) {
     worker_private->sends++;
 
     struct web_client *w = (struct web_client *)pi->data;
     int fd = pi->fd;
 
+#ifdef ENABLE_HTTPS
+    if(unlikely(web_server_ssl_handshake_pending(w)))
+        return web_server_ssl_handshake(w, events);
+#endif
+
+    // the client sent more requests with the one just served, there may be
+    // nothing more to receive, so they are processed as soon as it is done,
+    // and the file it copied (if any) has been closed
+    if(unlikely(web_client_has_pipelined_request(w)))
+        return (w->pollinfo_filecopy_slot) ? 0 : web_server_process_received(pi, events);
+
     debug(D_WEB_CLIENT, "%llu: sending data on fd %d.", w->id, fd);
 
     if(unlikely(web_client_send(w) < 0))
         return -1;
 
+    if(unlikely(web_client_has_pipelined_request(w)))
+        return (w->pollinfo_filecopy_slot) ? 0 : web_server_process_received(pi, events);
+
     if(unlikely(w->ifd == fd && web_client_has_wait_receive(w)))
         *events |= POLLIN;
 
@@ -317,9 +400,33 @@ static int web_server_snd_callback(POLLINFO *pi, short int *events) {
     return web_server_check_client_status(w);
 }
 
+// the clients with responses waiting for their producer, are given a chance to
+// send more at every tick of the timer
+static void web_server_wake_producers(POLLJOB *p) {
+    size_t i;
+
+    for(i = 0; i <= p->max ; i++) {
+        POLLINFO *pi = pollinfo_from_slot(p, i);
+        if(pi->fd == -1 || pi->snd_callback != web_server_snd_callback)
+            continue;
+
+        struct web_client *w = (struct web_client *)pi->data;
+        if(likely(!web_client_has_wait_producer(w)))
+            continue;
+
+        debug(D_WEB_CLIENT, "%llu: WAKING UP THE PRODUCER ON FD %d", w->id, pi->fd);
+        web_client_disable_wait_producer(w);
+        web_client_enable_wait_send(w);
+        poll_set_events(pi, (short int)(p->fds[i].events | POLLOUT));
+    }
+}
+
 static void web_server_tmr_callback(void *timer_data) {
     worker_private = (struct web_server_static_threaded_worker *)timer_data;
 
+    if(likely(worker_private->poll_job))
+        web_server_wake_producers(worker_private->poll_job);
+
     static __thread RRDSET *st = NULL;
     static __thread RRDDIM *rd_user = NULL, *rd_system = NULL;
 
@@ -386,7 +493,7 @@ void *socket_listen_main_static_threaded_worker(void *ptr) {
 
     netdata_thread_cleanup_push(socket_listen_main_static_threaded_worker_cleanup, ptr);
 
-            poll_events(&api_sockets
+            poll_events(worker_private->sockets
                         , web_server_add_callback
                         , web_server_del_callback
                         , web_server_rcv_callback
@@ -444,6 +551,14 @@ static void socket_listen_main_static_threaded_cleanup(void *ptr) {
         error("%d static web threads are taking too long to finish. Giving up.", found);
 
     info("closing all web server sockets...");
+    for(i = 1; static_workers_private_data && i < static_threaded_workers_count; i++) {
+        LISTEN_SOCKETS *sockets = static_workers_private_data[i].sockets;
+        if(sockets && sockets != &api_sockets) {
+            listen_sockets_close(sockets);
+            freez(sockets);
+        }
+        static_workers_private_data[i].sockets = NULL;
+    }
     listen_sockets_close(&api_sockets);
 
     info("all static web threads stopped.");
@@ -480,10 +595,32 @@ void *socket_listen_main_static_threaded(void *ptr) {
 
             web_server_is_multithreaded = (static_threaded_workers_count > 1);
 
+            // with a listening socket per worker for every TCP port, the kernel
+            // distributes the connections among the workers, instead of waking
+            // all of them up to race for every new connection
+            int listen_per_thread = config_get_boolean(CONFIG_SECTION_WEB, "listen sockets per thread",
+#ifdef __linux__
+                                                       CONFIG_BOOLEAN_YES
+#else
+                                                       CONFIG_BOOLEAN_NO
+#endif
+            );
+
             int i;
             for(i = 1; i < static_threaded_workers_count; i++) {
                 static_workers_private_data[i].id = i;
                 static_workers_private_data[i].max_sockets = max_sockets / static_threaded_workers_count;
+                static_workers_private_data[i].sockets = &api_sockets;
+
+                if(listen_per_thread) {
+                    LISTEN_SOCKETS *sockets = callocz(1, sizeof(LISTEN_SOCKETS));
+                    if(listen_sockets_reuseport(sockets, &api_sockets) > 0)
+                        static_workers_private_data[i].sockets = sockets;
+                    else {
+                        listen_sockets_close(sockets);
+                        freez(sockets);
+                    }
+                }
 
                 char tag[50 + 1];
                 snprintfz(tag, 50, "WEB_SERVER[static%d]", i+1);
@@ -494,6 +631,7 @@ void *socket_listen_main_static_threaded(void *ptr) {
 
             // and the main one
             static_workers_private_data[0].max_sockets = max_sockets / static_threaded_workers_count;
+            static_workers_private_data[0].sockets = &api_sockets;
             socket_listen_main_static_threaded_worker((void *)&static_workers_private_data[0]);
 
     netdata_thread_cleanup_pop(1);
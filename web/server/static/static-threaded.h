@@ -6,5 +6,6 @@
 #include "web/server/web_server.h"
 
 extern void *socket_listen_main_static_threaded(void *ptr);
+extern size_t web_server_threads_connections(size_t *connections, size_t max);
 
 #endif //NETDATA_WEB_SERVER_STATIC_THREADED_H
@@ -7,9 +7,29 @@
 
 int respect_web_browser_do_not_track_policy = 0;
 char *web_x_frame_options = NULL;
+int web_client_access_log_timings = 0;
+
+const char *web_client_phase_names[WEB_CLIENT_PHASES] = {
+        [WEB_CLIENT_PHASE_RECEIVE]  = "receive",
+        [WEB_CLIENT_PHASE_PARSE]    = "parse",
+        [WEB_CLIENT_PHASE_QUERY]    = "query",
+        [WEB_CLIENT_PHASE_FORMAT]   = "format",
+        [WEB_CLIENT_PHASE_COMPRESS] = "compress",
+        [WEB_CLIENT_PHASE_SEND]     = "send",
+};
+
+const char *web_client_phase_titles[WEB_CLIENT_PHASES] = {
+        [WEB_CLIENT_PHASE_RECEIVE]  = "Receive the Request",
+        [WEB_CLIENT_PHASE_PARSE]    = "Parse the Request",
+        [WEB_CLIENT_PHASE_QUERY]    = "Query the Database",
+        [WEB_CLIENT_PHASE_FORMAT]   = "Format the Response",
+        [WEB_CLIENT_PHASE_COMPRESS] = "Compress the Response",
+        [WEB_CLIENT_PHASE_SEND]     = "Send the Response",
+};
 
 #ifdef NETDATA_WITH_ZLIB
 int web_enable_gzip = 1, web_gzip_level = 3, web_gzip_strategy = Z_DEFAULT_STRATEGY;
+size_t web_gzip_min_size = 1024;
 #endif /* NETDATA_WITH_ZLIB */
 
 inline int web_client_permission_denied(struct web_client *w) {
@@ -67,6 +87,70 @@ static inline char *strip_control_characters(char *url) {
     return url;
 }
 
+static void web_client_free_producer(struct web_client *w) {
+    if(w->response.producer_free)
+        w->response.producer_free(w->response.producer_data);
+
+    w->response.producer = NULL;
+    w->response.producer_free = NULL;
+    w->response.producer_data = NULL;
+    web_client_disable_wait_producer(w);
+}
+
+// lets the producer add more to the response, when less than NETDATA_WEB_RESPONSE_PRODUCE_SIZE bytes
+// are waiting to be sent - so that large responses are sent while they are generated, without
+// keeping all of them in memory
+static void web_client_produce(struct web_client *w) {
+    BUFFER *wb = w->response.data;
+
+    if(likely(!w->response.producer) || web_client_has_wait_producer(w) || wb->len - w->response.sent >= NETDATA_WEB_RESPONSE_PRODUCE_SIZE)
+        return;
+
+    // everything produced so far has been sent, start over
+    if(wb->len && wb->len == w->response.sent
+#ifdef NETDATA_WITH_ZLIB
+       && !w->response.zstream.avail_in
+#endif
+    ) {
+        w->response.produced += wb->len;
+        w->response.sent = 0;
+        buffer_flush(wb);
+    }
+
+    usec_t started_ut = now_monotonic_usec();
+
+    while(w->response.producer && wb->len - w->response.sent < NETDATA_WEB_RESPONSE_PRODUCE_SIZE) {
+        int ret = w->response.producer(w, w->response.producer_data);
+
+        if(ret == WEB_CLIENT_PRODUCER_WAIT) {
+            web_client_enable_wait_producer(w);
+            break;
+        }
+
+        if(!ret)
+            web_client_free_producer(w);
+    }
+
+    // while the response is sent, producing it is still formatting it
+    if(w->sending_ut) {
+        usec_t dt = now_monotonic_usec() - started_ut;
+        w->phase_ut[WEB_CLIENT_PHASE_FORMAT] += dt;
+        w->sending_ut += dt;
+    }
+}
+
+// the response of w will be generated by producer while it is sent
+// the first part of it is generated now, the producer is freed when the response is complete
+void web_client_set_producer(struct web_client *w, web_client_producer_t producer, void (*producer_free)(void *data), void *data) {
+    web_client_free_producer(w);
+
+    w->response.producer = producer;
+    w->response.producer_free = producer_free;
+    w->response.producer_data = data;
+
+    web_client_produce(w);
+}
+
 void web_client_request_done(struct web_client *w) {
     web_client_uncrock_socket(w);
 
@@ -76,7 +160,7 @@ void web_client_request_done(struct web_client *w) {
         struct timeval tv;
         now_realtime_timeval(&tv);
 
-        size_t size = (w->mode == WEB_CLIENT_MODE_FILECOPY)?w->response.rlen:w->response.data->len;
+        size_t size = (w->mode == WEB_CLIENT_MODE_FILECOPY)?w->response.rlen:w->response.produced + w->response.data->len;
         size_t sent = size;
 #ifdef NETDATA_WITH_ZLIB
         if(likely(w->response.zoutput)) sent = (size_t)w->response.zstream.total_out;
@@ -85,14 +169,22 @@ void web_client_request_done(struct web_client *w) {
         // --------------------------------------------------------------------
         // global statistics
 
-        finished_web_request_statistics(dt_usec(&tv, &w->tv_in),
+        if(likely(w->sending_ut)) {
+            usec_t now_ut = now_monotonic_usec();
+            w->phase_ut[WEB_CLIENT_PHASE_SEND] = (now_ut > w->sending_ut) ? now_ut - w->sending_ut : 0;
+        }
+
+        finished_web_request_statistics((GLOBAL_STATS_API_ENDPOINT)w->api_endpoint,
+                                        dt_usec(&tv, &w->tv_in),
                                         w->stats_received_bytes,
                                         w->stats_sent_bytes,
                                         size,
-                                        sent);
+                                        sent,
+                                        w->phase_ut);
 
         w->stats_received_bytes = 0;
         w->stats_sent_bytes = 0;
+        w->api_endpoint = GLOBAL_STATS_API_NONE;
 
 
         // --------------------------------------------------------------------
@@ -121,28 +213,55 @@ void web_client_request_done(struct web_client *w) {
         }
 
         // access log
-        log_access("%llu: %d '[%s]:%s' '%s' (sent/all = %zu/%zu bytes %0.0f%%, prep/sent/total = %0.2f/%0.2f/%0.2f ms) %d '%s'",
-                   w->id
-                   , gettid()
-                   , w->client_ip
-                   , w->client_port
-                   , mode
-                   , sent
-                   , size
-                   , -((size > 0) ? ((size - sent) / (double) size * 100.0) : 0.0)
-                   , dt_usec(&w->tv_ready, &w->tv_in) / 1000.0
-                   , dt_usec(&tv, &w->tv_ready) / 1000.0
-                   , dt_usec(&tv, &w->tv_in) / 1000.0
-                   , w->response.code
-                   , strip_control_characters(w->last_url)
-        );
+        if(unlikely(web_client_access_log_timings))
+            log_access("%llu: %d '[%s]:%s' '%s' (sent/all = %zu/%zu bytes %0.0f%%, prep/sent/total = %0.2f/%0.2f/%0.2f ms, receive/parse/query/format/compress/send = %0.2f/%0.2f/%0.2f/%0.2f/%0.2f/%0.2f ms) %d '%s'",
+                       w->id
+                       , gettid()
+                       , w->client_ip
+                       , w->client_port
+                       , mode
+                       , sent
+                       , size
+                       , -((size > 0) ? ((size - sent) / (double) size * 100.0) : 0.0)
+                       , dt_usec(&w->tv_ready, &w->tv_in) / 1000.0
+                       , dt_usec(&tv, &w->tv_ready) / 1000.0
+                       , dt_usec(&tv, &w->tv_in) / 1000.0
+                       , w->phase_ut[WEB_CLIENT_PHASE_RECEIVE] / 1000.0
+                       , w->phase_ut[WEB_CLIENT_PHASE_PARSE] / 1000.0
+                       , w->phase_ut[WEB_CLIENT_PHASE_QUERY] / 1000.0
+                       , w->phase_ut[WEB_CLIENT_PHASE_FORMAT] / 1000.0
+                       , w->phase_ut[WEB_CLIENT_PHASE_COMPRESS] / 1000.0
+                       , w->phase_ut[WEB_CLIENT_PHASE_SEND] / 1000.0
+                       , w->response.code
+                       , strip_control_characters(w->last_url)
+            );
+        else
+            log_access("%llu: %d '[%s]:%s' '%s' (sent/all = %zu/%zu bytes %0.0f%%, prep/sent/total = %0.2f/%0.2f/%0.2f ms) %d '%s'",
+                       w->id
+                       , gettid()
+                       , w->client_ip
+                       , w->client_port
+                       , mode
+                       , sent
+                       , size
+                       , -((size > 0) ? ((size - sent) / (double) size * 100.0) : 0.0)
+                       , dt_usec(&w->tv_ready, &w->tv_in) / 1000.0
+                       , dt_usec(&tv, &w->tv_ready) / 1000.0
+                       , dt_usec(&tv, &w->tv_in) / 1000.0
+                       , w->response.code
+                       , strip_control_characters(w->last_url)
+            );
     }
 
+    w->received_ut = 0;
+    w->sending_ut = 0;
+
     if(unlikely(w->mode == WEB_CLIENT_MODE_FILECOPY)) {
         if(w->ifd != w->ofd) {
             debug(D_WEB_CLIENT, "%llu: Closing filecopy input file descriptor %d.", w->id, w->ifd);
 
-            if(web_server_mode != WEB_SERVER_MODE_STATIC_THREADED) {
+            // the static-threaded web server closes the files it reads, but not the ones of sendfile()
+            if(web_server_mode != WEB_SERVER_MODE_STATIC_THREADED || w->response.sendfile) {
                 if (w->ifd != -1){
                     close(w->ifd);
                 }
@@ -157,6 +276,7 @@ void web_client_request_done(struct web_client *w) {
     w->cookie2[0] = '\0';
     w->origin[0] = '*';
     w->origin[1] = '\0';
+    w->if_none_match[0] = '\0';
 
     freez(w->user_agent); w->user_agent = NULL;
     if (w->auth_bearer_token) {
@@ -172,11 +292,31 @@ void web_client_request_done(struct web_client *w) {
     web_client_disable_keepalive(w);
     w->decoded_url[0] = '\0';
 
+    // keep the buffers for the next request of the connection,
+    // unless they grew a lot bigger than the last response needed
+    if(unlikely(w->response.data->size > NETDATA_WEB_RESPONSE_MAX_KEEP_SIZE && w->response.data->len < w->response.data->size / 4)) {
+        debug(D_WEB_CLIENT, "%llu: Shrinking the response buffer of %zu bytes.", w->id, w->response.data->size);
+        buffer_flush(w->response.data);
+        buffer_shrink(w->response.data, NETDATA_WEB_RESPONSE_INITIAL_SIZE);
+    }
+
     buffer_reset(w->response.header_output);
     buffer_reset(w->response.header);
     buffer_reset(w->response.data);
+
+    // the requests received with this one are processed next
+    if(unlikely(w->pipelined && w->pipelined->len)) {
+        debug(D_WEB_CLIENT, "%llu: Keeping %zu bytes of pipelined requests.", w->id, w->pipelined->len);
+        buffer_fast_strcat(w->response.data, w->pipelined->buffer, w->pipelined->len);
+        buffer_flush(w->pipelined);
+        web_client_enable_pipelined_request(w);
+        w->received_ut = now_monotonic_usec();
+    }
+    web_client_free_producer(w);
     w->response.rlen = 0;
+    w->response.sendfile = 0;
     w->response.sent = 0;
+    w->response.produced = 0;
     w->response.code = 0;
 
     w->header_parse_tries = 0;
@@ -187,22 +327,31 @@ void web_client_request_done(struct web_client *w) {
 
     w->response.zoutput = 0;
 
-    // if we had enabled compression, release it
+    // if we had enabled compression, keep it for the next request
+    // it is reset when it is enabled again and released with the client
 #ifdef NETDATA_WITH_ZLIB
     if(w->response.zinitialized) {
-        debug(D_DEFLATE, "%llu: Freeing compression resources.", w->id);
-        deflateEnd(&w->response.zstream);
         w->response.zsent = 0;
         w->response.zhave = 0;
         w->response.zstream.avail_in = 0;
         w->response.zstream.avail_out = 0;
         w->response.zstream.total_in = 0;
         w->response.zstream.total_out = 0;
-        w->response.zinitialized = 0;
     }
+    w->response.zfinished = 0;
 #endif // NETDATA_WITH_ZLIB
 }
 
+#ifdef NETDATA_WITH_ZLIB
+void web_client_free_deflate(struct web_client *w) {
+    if(w->response.zinitialized) {
+        debug(D_DEFLATE, "%llu: Freeing compression resources.", w->id);
+        deflateEnd(&w->response.zstream);
+        w->response.zinitialized = 0;
+    }
+}
+#endif // NETDATA_WITH_ZLIB
+
 uid_t web_files_uid(void) {
     static char *web_owner = NULL;
     static uid_t owner_uid = 0;
@@ -340,6 +489,18 @@ static inline int access_to_file_is_not_permitted(struct web_client *w, const ch
     return 403;
 }
 
+#ifdef HAVE_SYS_SENDFILE_H
+// the kernel can copy the file to the socket, when the file is sent as-is
+static inline int web_client_can_sendfile(struct web_client *w) {
+#ifdef ENABLE_HTTPS
+    if(!web_client_check_unix(w) && netdata_srv_ctx && w->ssl.conn && !w->ssl.flags)
+        return 0;
+#endif
+
+    return !w->response.zoutput;
+}
+#endif
+
 int mysendfile(struct web_client *w, char *filename) {
     debug(D_WEB_CLIENT, "%llu: Looking for file '%s/%s'", w->id, netdata_configured_web_dir, filename);
 
@@ -436,14 +597,7 @@ int mysendfile(struct web_client *w, char *filename) {
     sock_setnonblock(w->ifd);
 
     w->response.data->contenttype = contenttype_for_filename(webfilename);
-    debug(D_WEB_CLIENT_ACCESS, "%llu: Sending file '%s' (%ld bytes, ifd %d, ofd %d).", w->id, webfilename, statbuf.st_size, w->ifd, w->ofd);
-
-    w->mode = WEB_CLIENT_MODE_FILECOPY;
-    web_client_enable_wait_receive(w);
-    web_client_disable_wait_send(w);
     buffer_flush(w->response.data);
-    buffer_need_bytes(w->response.data, (size_t)statbuf.st_size);
-    w->response.rlen = (size_t)statbuf.st_size;
 #ifdef __APPLE__
     w->response.data->date = statbuf.st_mtimespec.tv_sec;
 #else
@@ -451,13 +605,46 @@ int mysendfile(struct web_client *w, char *filename) {
 #endif /* __APPLE__ */
     buffer_cacheable(w->response.data);
 
+#ifdef NETDATA_WITH_ZLIB
+    // the clients accepting gzip get the file compressed once, from memory
+    if(w->response.zoutput && web_files_cache_gzip(w->response.data, webfilename, w->ifd, &statbuf) == 0) {
+        debug(D_WEB_CLIENT_ACCESS, "%llu: Sending compressed file '%s' (%zu bytes of %ld).", w->id, webfilename, w->response.data->len, statbuf.st_size);
+
+        close(w->ifd);
+        w->ifd = w->ofd;
+
+        w->response.zoutput = 0;
+        buffer_strcat(w->response.header, "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n");
+        return 200;
+    }
+#endif
+
+    debug(D_WEB_CLIENT_ACCESS, "%llu: Sending file '%s' (%ld bytes, ifd %d, ofd %d).", w->id, webfilename, statbuf.st_size, w->ifd, w->ofd);
+
+    w->mode = WEB_CLIENT_MODE_FILECOPY;
+    w->response.rlen = (size_t)statbuf.st_size;
+
+#ifdef HAVE_SYS_SENDFILE_H
+    if(web_client_can_sendfile(w)) {
+        // the file does not pass through the response buffer
+        w->response.sendfile = 1;
+        web_client_disable_wait_receive(w);
+        web_client_enable_wait_send(w);
+        return 200;
+    }
+#endif
+
+    web_client_enable_wait_receive(w);
+    web_client_disable_wait_send(w);
+    buffer_need_bytes(w->response.data, (size_t)statbuf.st_size);
+
     return 200;
 }
 
 
 #ifdef NETDATA_WITH_ZLIB
 void web_client_enable_deflate(struct web_client *w, int gzip) {
-    if(unlikely(w->response.zinitialized)) {
+    if(unlikely(w->response.zoutput)) {
         debug(D_DEFLATE, "%llu: Compression has already be initialized for this client.", w->id);
         return;
     }
@@ -467,6 +654,24 @@ void web_client_enable_deflate(struct web_client *w, int gzip) {
         return;
     }
 
+    if(w->response.zinitialized) {
+        // a previous request of the connection has been compressed the same way,
+        // resetting the compressor is a lot cheaper than allocating a new one
+        if(likely(w->response.zgzip == (gzip ? 1 : 0) && deflateReset(&w->response.zstream) == Z_OK)) {
+            w->response.zstream.next_in = (Bytef *)w->response.data->buffer;
+            w->response.zstream.avail_in = 0;
+            w->response.zstream.next_out = w->response.zbuffer;
+            w->response.zstream.avail_out = 0;
+            w->response.zsent = 0;
+            w->response.zoutput = 1;
+
+            debug(D_DEFLATE, "%llu: Reset compression.", w->id);
+            return;
+        }
+
+        web_client_free_deflate(w);
+    }
+
     w->response.zstream.zalloc = Z_NULL;
     w->response.zstream.zfree = Z_NULL;
     w->response.zstream.opaque = Z_NULL;
@@ -497,9 +702,46 @@ void web_client_enable_deflate(struct web_client *w, int gzip) {
     w->response.zsent = 0;
     w->response.zoutput = 1;
     w->response.zinitialized = 1;
+    w->response.zgzip = (gzip ? 1 : 0);
+    w->response.zlevel = (unsigned int)web_gzip_level;
 
     debug(D_DEFLATE, "%llu: Initialized compression.", w->id);
 }
+
+// the compression of a response is decided when it is ready to be sent, and its size is known:
+// small responses are not compressed, since they would not be smaller but they would be chunked,
+// while large ones and the ones of a busy web server are compressed at the fastest level
+static void web_client_adapt_deflate(struct web_client *w) {
+    int streaming = (w->response.producer != NULL);
+    size_t size = w->response.data->len;
+
+    if(w->mode == WEB_CLIENT_MODE_FILECOPY) {
+        size = w->response.rlen;
+        if(!size) streaming = 1;
+    }
+
+    if(!streaming && size < web_gzip_min_size) {
+        debug(D_DEFLATE, "%llu: Not compressing a response of %zu bytes.", w->id, size);
+        w->response.zoutput = 0;
+        return;
+    }
+
+    // all the web server threads are running API requests
+    size_t threads = web_server_threads_connections(NULL, 0);
+    int busy = (threads && web_requests_in_flight() >= threads);
+
+    int level = web_gzip_level;
+    if(streaming || busy || size >= NETDATA_WEB_GZIP_FASTEST_SIZE)
+        level = 1;
+
+    if((unsigned int)level != w->response.zlevel) {
+        // nothing has been compressed yet, so this only changes the parameters of the stream
+        if(deflateParams(&w->response.zstream, level, web_gzip_strategy) == Z_OK) {
+            debug(D_DEFLATE, "%llu: Compressing a response of %zu bytes at level %d.", w->id, size, level);
+            w->response.zlevel = (unsigned int)level;
+        }
+    }
+}
 #endif // NETDATA_WITH_ZLIB
 
 void buffer_data_options2string(BUFFER *wb, uint32_t options) {
@@ -678,6 +920,9 @@ const char *web_content_type_to_string(uint8_t contenttype) {
         case CT_PROMETHEUS:
             return "text/plain; version=0.0.4";
 
+        case CT_TEXT_EVENT_STREAM:
+            return "text/event-stream; charset=utf-8";
+
         default:
         case CT_TEXT_PLAIN:
             return "text/plain; charset=utf-8";
@@ -693,6 +938,9 @@ const char *web_response_code_to_string(int code) {
         case 301:
             return "Moved Permanently";
 
+        case 304:
+            return "Not Modified";
+
         case 307:
             return "Temporary Redirect";
 
@@ -708,6 +956,9 @@ const char *web_response_code_to_string(int code) {
         case 412:
             return "Preconditions Failed";
 
+        case 503:
+            return "Service Unavailable";
+
         default:
             if(code >= 100 && code < 200)
                 return "Informational";
@@ -728,8 +979,10 @@ const char *web_response_code_to_string(int code) {
     }
 }
 
-static inline char *http_header_parse(struct web_client *w, char *s, int parse_useragent) {
+// parses the header line from s to le, the \r of its \r\n
+static inline void http_header_parse(struct web_client *w, char *s, char *le, int parse_useragent) {
     static uint32_t hash_origin = 0, hash_connection = 0, hash_donottrack = 0, hash_useragent = 0, hash_authorization = 0, hash_host = 0;
+    static uint32_t hash_if_none_match = 0;
 #ifdef NETDATA_WITH_ZLIB
     static uint32_t hash_accept_encoding = 0;
 #endif
@@ -744,30 +997,21 @@ static inline char *http_header_parse(struct web_client *w, char *s, int parse_u
         hash_useragent = simple_uhash("User-Agent");
         hash_authorization = simple_uhash("X-Auth-Token");
         hash_host = simple_uhash("Host");
+        hash_if_none_match = simple_uhash("If-None-Match");
     }
 
-    char *e = s;
-
     // find the :
-    while(*e && *e != ':') e++;
-    if(!*e) return e;
+    char *e = memchr(s, ':', (size_t)(le - s));
+    if(!e) return;
 
     // get the name
     *e = '\0';
 
     // find the value
-    char *v = e + 1, *ve;
+    char *v = e + 1, *ve = le;
 
     // skip leading spaces from value
     while(*v == ' ') v++;
-    ve = v;
-
-    // find the \r
-    while(*ve && *ve != '\r') ve++;
-    if(!*ve || ve[1] != '\n') {
-        *e = ':';
-        return ve;
-    }
 
     // terminate the value
     *ve = '\0';
@@ -792,7 +1036,10 @@ static inline char *http_header_parse(struct web_client *w, char *s, int parse_u
         w->auth_bearer_token = strdupz(v);
     }
     else if(hash == hash_host && !strcasecmp(s, "Host")){
-        strncpyz(w->host, v, (ve - v));
+        strncpyz(w->host, v, sizeof(w->host) - 1);
+    }
+    else if(hash == hash_if_none_match && !strcasecmp(s, "If-None-Match")) {
+        strncpyz(w->if_none_match, v, NETDATA_WEB_REQUEST_IF_NONE_MATCH_SIZE);
     }
 #ifdef NETDATA_WITH_ZLIB
     else if(hash == hash_accept_encoding && !strcasecmp(s, "Accept-Encoding")) {
@@ -809,7 +1056,6 @@ static inline char *http_header_parse(struct web_client *w, char *s, int parse_u
 
     *e = ':';
     *ve = '\r';
-    return ve;
 }
 
 // http_request_validate()
@@ -829,33 +1075,85 @@ typedef enum {
 #endif
 } HTTP_VALIDATION;
 
+// keeps the data received after the end of the request being served,
+// the next requests of the client, to process them when it is done
+static inline void web_client_keep_pipelined(struct web_client *w, const char *rest) {
+    size_t len = w->response.data->len - (size_t)(rest - w->response.data->buffer);
+    if(likely(!len)) return;
+
+    if(unlikely(!w->pipelined))
+        w->pipelined = buffer_create(len);
+
+    buffer_flush(w->pipelined);
+    buffer_fast_strcat(w->pipelined, rest, len);
+}
+
+// returns the \r of the first \r\n of s, up to end (that has to be a \r\n)
+static inline char *http_line_end(char *s, char *end) {
+    for(;;) {
+        s = memchr(s, '\r', (size_t)(end - s + 1));
+        if(likely(s[1] == '\n')) return s;
+        s++;
+    }
+}
+
+// returns the \r of the \r\n\r\n at the end of the headers, in the len bytes of s,
+// or NULL when they have not been received yet.
+// The bytes before pos have already been searched the previous time data were
+// received, so every byte of a slowly sent request is searched only once.
+// memchr() is vectorized by the C library, it skips the bytes of the header lines
+// instead of comparing them one by one.
+static inline char *http_headers_end(char *s, size_t len, size_t pos) {
+    char *end = &s[len], *r = &s[pos];
+
+    while(r < end && (r = memchr(r, '\r', (size_t)(end - r)))) {
+        if(unlikely(end - r < 4)) break;
+        if(r[1] == '\n' && r[2] == '\r' && r[3] == '\n') return r;
+        r++;
+    }
+
+    return NULL;
+}
+
+static inline int http_request_method_supported(const char *s) {
+    return !strncmp(s, "GET ", 4) || !strncmp(s, "OPTIONS ", 8) || !strncmp(s, "STREAM ", 7);
+}
+
 static inline HTTP_VALIDATION http_request_validate(struct web_client *w) {
     char *s = (char *)buffer_tostring(w->response.data), *encoded_url = NULL;
+    size_t len = buffer_strlen(w->response.data);
 
-    size_t last_pos = w->header_parse_last_size;
-    if(last_pos > 4) last_pos -= 4; // allow searching for \r\n\r\n
-    else last_pos = 0;
+    // continue searching from where the previous attempt stopped
+    size_t pos = w->header_parse_last_size;
+    pos = (pos > 3 && pos <= len) ? pos - 3 : 0;
 
     w->header_parse_tries++;
-    w->header_parse_last_size = buffer_strlen(w->response.data);
-
-    if(w->header_parse_tries > 1) {
-        if(w->header_parse_last_size < last_pos)
-            last_pos = 0;
-
-        if(strstr(&s[last_pos], "\r\n\r\n") == NULL) {
-            if(w->header_parse_tries > 10) {
-                info("Disabling slow client after %zu attempts to read the request (%zu bytes received)", w->header_parse_tries, buffer_strlen(w->response.data));
-                w->header_parse_tries = 0;
-                w->header_parse_last_size = 0;
-                web_client_disable_wait_receive(w);
-                return HTTP_VALIDATION_NOT_SUPPORTED;
-            }
+    w->header_parse_last_size = len;
 
-            return HTTP_VALIDATION_INCOMPLETE;
+    char *he = http_headers_end(s, len, pos);
+    if(!he) {
+        if(len >= 8 && !http_request_method_supported(s)) {
+            w->header_parse_tries = 0;
+            w->header_parse_last_size = 0;
+            web_client_disable_wait_receive(w);
+            return HTTP_VALIDATION_NOT_SUPPORTED;
+        }
+
+        if(w->header_parse_tries > 10) {
+            info("Disabling slow client after %zu attempts to read the request (%zu bytes received)", w->header_parse_tries, len);
+            w->header_parse_tries = 0;
+            w->header_parse_last_size = 0;
+            web_client_disable_wait_receive(w);
+            return HTTP_VALIDATION_NOT_SUPPORTED;
         }
+
+        web_client_enable_wait_receive(w);
+        return HTTP_VALIDATION_INCOMPLETE;
     }
 
+    // the complete request has been received,
+    // the request line and the headers are parsed in one pass
+
     // is is a valid request?
     if(!strncmp(s, "GET ", 4)) {
         encoded_url = s = &s[4];
@@ -905,75 +1203,61 @@ static inline HTTP_VALIDATION http_request_validate(struct web_client *w) {
         return HTTP_VALIDATION_NOT_SUPPORTED;
     }
 
+    // the end of the request line
+    char *le = http_line_end(s, he);
+
     // find the SPACE + "HTTP/"
-    while(*s) {
-        // find the next space
-        while (*s && *s != ' ') s++;
+    char *ue = NULL;
+    while(s < le && (s = memchr(s, ' ', (size_t)(le - s)))) {
+        if(le - s >= 6 && !strncmp(s, " HTTP/", 6)) {
+            ue = s;
+            break;
+        }
+        s++;
+    }
 
-        // is it SPACE + "HTTP/" ?
-        if(*s && !strncmp(s, " HTTP/", 6)) break;
-        else s++;
+    if(unlikely(!ue)) {
+        w->header_parse_tries = 0;
+        w->header_parse_last_size = 0;
+        web_client_disable_wait_receive(w);
+        return HTTP_VALIDATION_NOT_SUPPORTED;
     }
 
-    // incomplete requests
-    if(unlikely(!*s)) {
-        web_client_enable_wait_receive(w);
-        return HTTP_VALIDATION_INCOMPLETE;
+    // the header lines
+    for(s = le + 2; s < he ; s = le + 2) {
+        le = http_line_end(s, he);
+        http_header_parse(w, s, le,
+                (w->mode == WEB_CLIENT_MODE_STREAM) // parse user agent
+        );
     }
 
-    // we have the end of encoded_url - remember it
-    char *ue = s;
+    // we have the end of encoded_url
+    *ue = '\0';
+    url_decode_r(w->decoded_url, encoded_url, NETDATA_WEB_REQUEST_URL_SIZE + 1);
+    *ue = ' ';
 
-    // make sure we have complete request
-    // complete requests contain: \r\n\r\n
-    while(*s) {
-        // find a line feed
-        while(*s && *s++ != '\r');
-
-        // did we reach the end?
-        if(unlikely(!*s)) break;
-
-        // is it \r\n ?
-        if(likely(*s++ == '\n')) {
-
-            // is it again \r\n ? (header end)
-            if(unlikely(*s == '\r' && s[1] == '\n')) {
-                // a valid complete HTTP request found
-
-                *ue = '\0';
-                url_decode_r(w->decoded_url, encoded_url, NETDATA_WEB_REQUEST_URL_SIZE + 1);
-                *ue = ' ';
-                
-                // copy the URL - we are going to overwrite parts of it
-                // TODO -- ideally we we should avoid copying buffers around
-                strncpyz(w->last_url, w->decoded_url, NETDATA_WEB_REQUEST_URL_SIZE);
+    // copy the URL - we are going to overwrite parts of it
+    // TODO -- ideally we we should avoid copying buffers around
+    strncpyz(w->last_url, w->decoded_url, NETDATA_WEB_REQUEST_URL_SIZE);
 #ifdef ENABLE_HTTPS
-                if ( (!web_client_check_unix(w)) && (netdata_srv_ctx) ) {
-                    if ((w->ssl.conn) && ((w->ssl.flags & NETDATA_SSL_NO_HANDSHAKE) && (netdata_use_ssl_on_http & NETDATA_SSL_FORCE) && (w->mode != WEB_CLIENT_MODE_STREAM))  ) {
-                        w->header_parse_tries = 0;
-                        w->header_parse_last_size = 0;
-                        web_client_disable_wait_receive(w);
-                        return HTTP_VALIDATION_REDIRECT;
-                    }
-                }
+    if ( (!web_client_check_unix(w)) && (netdata_srv_ctx) ) {
+        if ((w->ssl.conn) && ((w->ssl.flags & NETDATA_SSL_NO_HANDSHAKE) && (netdata_use_ssl_on_http & NETDATA_SSL_FORCE) && (w->mode != WEB_CLIENT_MODE_STREAM))  ) {
+            w->header_parse_tries = 0;
+            w->header_parse_last_size = 0;
+            web_client_disable_wait_receive(w);
+            return HTTP_VALIDATION_REDIRECT;
+        }
+    }
 #endif
 
-                w->header_parse_tries = 0;
-                w->header_parse_last_size = 0;
-                web_client_disable_wait_receive(w);
-                return HTTP_VALIDATION_OK;
-            }
+    w->header_parse_tries = 0;
+    w->header_parse_last_size = 0;
+    web_client_disable_wait_receive(w);
 
-            // another header line
-            s = http_header_parse(w, s,
-                    (w->mode == WEB_CLIENT_MODE_STREAM) // parse user agent
-            );
-        }
-    }
+    if(w->mode != WEB_CLIENT_MODE_STREAM)
+        web_client_keep_pipelined(w, &he[4]);
 
-    // incomplete request
-    web_client_enable_wait_receive(w);
-    return HTTP_VALIDATION_INCOMPLETE;
+    return HTTP_VALIDATION_OK;
 }
 
 static inline ssize_t web_client_send_data(struct web_client *w,const void *buf,size_t len, int flags)
@@ -1110,6 +1394,11 @@ static inline void web_client_send_http_header(struct web_client *w) {
     if(unlikely(buffer_strlen(w->response.header)))
         buffer_strcat(w->response.header_output, buffer_tostring(w->response.header));
 
+#ifdef NETDATA_WITH_ZLIB
+    if(w->response.zoutput)
+        web_client_adapt_deflate(w);
+#endif // NETDATA_WITH_ZLIB
+
     // headers related to the transfer method
     if(likely(w->response.zoutput)) {
         buffer_strcat(w->response.header_output,
@@ -1118,7 +1407,11 @@ static inline void web_client_send_http_header(struct web_client *w) {
         );
     }
     else {
-        if(likely((w->response.data->len || w->response.rlen))) {
+        if(unlikely(w->response.producer)) {
+            // the response is still being generated, the connection will be closed at its end
+            web_client_disable_keepalive(w);
+        }
+        else if(likely((w->response.data->len || w->response.rlen))) {
             // we know the content length, put it
             buffer_sprintf(w->response.header_output, "Content-Length: %zu\r\n", w->response.data->len? w->response.data->len: w->response.rlen);
         }
@@ -1368,7 +1661,22 @@ void web_client_process_request(struct web_client *w) {
     // start timing us
     now_realtime_timeval(&w->tv_in);
 
-    switch(http_request_validate(w)) {
+    usec_t started_ut = now_monotonic_usec();
+    uint64_t query_started_ut = rrdr_query_usec_of_this_thread();
+
+    memset(w->phase_ut, 0, sizeof(w->phase_ut));
+    w->sending_ut = 0;
+    if(likely(w->received_ut && started_ut > w->received_ut))
+        w->phase_ut[WEB_CLIENT_PHASE_RECEIVE] = started_ut - w->received_ut;
+
+    web_client_disable_pipelined_request(w);
+
+    HTTP_VALIDATION validation = http_request_validate(w);
+
+    usec_t parsed_ut = now_monotonic_usec();
+    w->phase_ut[WEB_CLIENT_PHASE_PARSE] = parsed_ut - started_ut;
+
+    switch(validation) {
         case HTTP_VALIDATION_OK:
             switch(w->mode) {
                 case WEB_CLIENT_MODE_STREAM:
@@ -1453,6 +1761,11 @@ void web_client_process_request(struct web_client *w) {
     // keep track of the time we done processing
     now_realtime_timeval(&w->tv_ready);
 
+    w->sending_ut = now_monotonic_usec();
+    w->phase_ut[WEB_CLIENT_PHASE_QUERY] = rrdr_query_usec_of_this_thread() - query_started_ut;
+    if(likely(w->sending_ut - parsed_ut > w->phase_ut[WEB_CLIENT_PHASE_QUERY]))
+        w->phase_ut[WEB_CLIENT_PHASE_FORMAT] = w->sending_ut - parsed_ut - w->phase_ut[WEB_CLIENT_PHASE_QUERY];
+
     w->response.sent = 0;
 
     // set a proper last modified date
@@ -1462,7 +1775,7 @@ void web_client_process_request(struct web_client *w) {
     web_client_send_http_header(w);
 
     // enable sending immediately if we have data
-    if(w->response.data->len) web_client_enable_wait_send(w);
+    if(w->response.data->len || w->response.sendfile) web_client_enable_wait_send(w);
     else web_client_disable_wait_send(w);
 
     switch(w->mode) {
@@ -1481,7 +1794,8 @@ void web_client_process_request(struct web_client *w) {
         case WEB_CLIENT_MODE_FILECOPY:
             if(w->response.rlen) {
                 debug(D_WEB_CLIENT, "%llu: Done preparing the response. Will be sending data file of %zu bytes to client.", w->id, w->response.rlen);
-                web_client_enable_wait_receive(w);
+                if(!w->response.sendfile)
+                    web_client_enable_wait_receive(w);
 
                 /*
                 // utilize the kernel sendfile() for copying the file to the socket.
@@ -1586,16 +1900,25 @@ ssize_t web_client_send_deflate(struct web_client *w)
     // when using compression,
     // w->response.sent is the amount of bytes passed through compression
 
+    web_client_produce(w);
+
     debug(D_DEFLATE, "%llu: web_client_send_deflate(): w->response.data->len = %zu, w->response.sent = %zu, w->response.zhave = %zu, w->response.zsent = %zu, w->response.zstream.avail_in = %u, w->response.zstream.avail_out = %u, w->response.zstream.total_in = %lu, w->response.zstream.total_out = %lu.",
         w->id, w->response.data->len, w->response.sent, w->response.zhave, w->response.zsent, w->response.zstream.avail_in, w->response.zstream.avail_out, w->response.zstream.total_in, w->response.zstream.total_out);
 
-    if(w->response.data->len - w->response.sent == 0 && w->response.zstream.avail_in == 0 && w->response.zhave == w->response.zsent && w->response.zstream.avail_out != 0) {
+    if(unlikely(web_client_has_wait_producer(w)) && w->response.data->len - w->response.sent == 0 && w->response.zhave == w->response.zsent) {
+        debug(D_WEB_CLIENT, "%llu: Waiting for the producer to add more data.", w->id);
+        web_client_disable_wait_send(w);
+        return 0;
+    }
+
+    if(w->response.data->len - w->response.sent == 0 && w->response.zstream.avail_in == 0 && w->response.zhave == w->response.zsent && w->response.zstream.avail_out != 0
+        && (w->response.zfinished || w->mode != WEB_CLIENT_MODE_NORMAL)) {
         // there is nothing to send
 
         debug(D_WEB_CLIENT, "%llu: Out of output data.", w->id);
 
         // finalize the chunk
-        if(w->response.sent != 0) {
+        if(w->response.sent != 0 || w->response.produced != 0) {
             t = web_client_send_chunk_finalize(w);
             if(t < 0) return t;
         }
@@ -1623,7 +1946,7 @@ ssize_t web_client_send_deflate(struct web_client *w)
         // compress more input data
 
         // close the previous open chunk
-        if(w->response.sent != 0) {
+        if(w->response.sent != 0 || w->response.produced != 0) {
             t = web_client_send_chunk_close(w);
             if(t < 0) return t;
         }
@@ -1642,7 +1965,7 @@ ssize_t web_client_send_deflate(struct web_client *w)
 
         // ask for FINISH if we have all the input
         int flush = Z_SYNC_FLUSH;
-        if(w->mode == WEB_CLIENT_MODE_NORMAL
+        if((w->mode == WEB_CLIENT_MODE_NORMAL && !w->response.producer)
             || (w->mode == WEB_CLIENT_MODE_FILECOPY && !web_client_has_wait_receive(w) && w->response.data->len == w->response.rlen)) {
             flush = Z_FINISH;
             debug(D_DEFLATE, "%llu: Requesting Z_FINISH, if possible.", w->id);
@@ -1652,11 +1975,20 @@ ssize_t web_client_send_deflate(struct web_client *w)
         }
 
         // compress
-        if(deflate(&w->response.zstream, flush) == Z_STREAM_ERROR) {
+        usec_t compress_started_ut = now_monotonic_usec();
+        int ret = deflate(&w->response.zstream, flush);
+
+        usec_t compress_dt = now_monotonic_usec() - compress_started_ut;
+        w->phase_ut[WEB_CLIENT_PHASE_COMPRESS] += compress_dt;
+        if(likely(w->sending_ut)) w->sending_ut += compress_dt;
+
+        if(ret == Z_STREAM_ERROR) {
             error("%llu: Compression failed. Closing down client.", w->id);
             web_client_request_done(w);
             return(-1);
         }
+        if(ret == Z_STREAM_END)
+            w->response.zfinished = 1;
 
         w->response.zhave = NETDATA_WEB_RESPONSE_ZLIB_CHUNK_SIZE - w->response.zstream.avail_out;
         w->response.zsent = 0;
@@ -1696,21 +2028,71 @@ ssize_t web_client_send_deflate(struct web_client *w)
 }
 #endif // NETDATA_WITH_ZLIB
 
+#ifdef HAVE_SYS_SENDFILE_H
+static ssize_t web_client_sendfile(struct web_client *w) {
+    if(unlikely(w->response.sent >= w->response.rlen)) {
+        debug(D_WEB_CLIENT, "%llu: Out of file data.", w->id);
+
+        if(unlikely(!web_client_has_keepalive(w))) {
+            debug(D_WEB_CLIENT, "%llu: Closing (keep-alive is not enabled). %zu bytes sent.", w->id, w->response.sent);
+            WEB_CLIENT_IS_DEAD(w);
+            return 0;
+        }
+
+        web_client_request_done(w);
+        debug(D_WEB_CLIENT, "%llu: Done sending the file on socket. Waiting for next request on the same socket.", w->id);
+        return 0;
+    }
+
+    off_t offset = (off_t)w->response.sent;
+    ssize_t bytes = sendfile(w->ofd, w->ifd, &offset, w->response.rlen - w->response.sent);
+    if(likely(bytes > 0)) {
+        w->stats_sent_bytes += bytes;
+        w->response.sent += bytes;
+        debug(D_WEB_CLIENT, "%llu: Sent %zd bytes of the file.", w->id, bytes);
+    }
+    else if(bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        debug(D_WEB_CLIENT, "%llu: The socket is not ready to send more of the file.", w->id);
+        return 0;
+    }
+    else {
+        // the file got shorter, or the client is gone
+        debug(D_WEB_CLIENT, "%llu: Failed to send the file to client.", w->id);
+        WEB_CLIENT_IS_DEAD(w);
+    }
+
+    return(bytes);
+}
+#endif
+
 ssize_t web_client_send(struct web_client *w) {
 #ifdef NETDATA_WITH_ZLIB
     if(likely(w->response.zoutput)) return web_client_send_deflate(w);
 #endif // NETDATA_WITH_ZLIB
 
+#ifdef HAVE_SYS_SENDFILE_H
+    if(unlikely(w->response.sendfile)) return web_client_sendfile(w);
+#endif
+
     ssize_t bytes;
 
+    web_client_produce(w);
+
     if(unlikely(w->response.data->len - w->response.sent == 0)) {
         // there is nothing to send
 
         debug(D_WEB_CLIENT, "%llu: Out of output data.", w->id);
 
-        // there can be two cases for this
+        // there can be three cases for this
         // A. we have done everything
         // B. we temporarily have nothing to send, waiting for the buffer to be filled by ifd
+        // C. we temporarily have nothing to send, waiting for the producer to be woken up
+
+        if(unlikely(web_client_has_wait_producer(w))) {
+            debug(D_WEB_CLIENT, "%llu: Waiting for the producer to add more data.", w->id);
+            web_client_disable_wait_send(w);
+            return 0;
+        }
 
         if(w->mode == WEB_CLIENT_MODE_FILECOPY && web_client_has_wait_receive(w) && w->response.rlen && w->response.rlen > w->response.data->len) {
             // we have to wait, more data will come
@@ -1800,21 +2182,69 @@ ssize_t web_client_read_file(struct web_client *w)
     return(bytes);
 }
 
+// returns non-zero when the client has closed its connection, so that the
+// queries running for it are interrupted, see RRDR_QUERY_DEADLINE
+// it may run on the query threads too, so it only looks at the socket
+int web_client_interrupt_callback(void *data) {
+    struct web_client *w = (struct web_client *)data;
+    struct pollfd pfd;
+    char c;
+
+    if(unlikely(web_client_check_dead(w)))
+        return 1;
+
+    if(unlikely(w->ofd == -1))
+        return 0;
+
+    pfd.fd = w->ofd;
+    pfd.revents = 0;
+    pfd.events = POLLIN;
+#ifdef POLLRDHUP
+    pfd.events |= POLLRDHUP;
+#endif
+
+    if(poll(&pfd, 1, 0) <= 0)
+        return 0;
+
+#ifdef POLLRDHUP
+    if(pfd.revents & POLLRDHUP)
+        return 1;
+#endif
+
+    if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+        return 1;
+
+    // a pipelined request can be waiting, only the end of the stream means the client is gone
+    if(pfd.revents & POLLIN)
+        return recv(w->ofd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+
+    return 0;
+}
+
 ssize_t web_client_receive(struct web_client *w)
 {
     if(unlikely(w->mode == WEB_CLIENT_MODE_FILECOPY))
         return web_client_read_file(w);
 
     ssize_t bytes;
-    ssize_t left = w->response.data->size - w->response.data->len;
 
     // do we have any space for more data?
     buffer_need_bytes(w->response.data, NETDATA_WEB_REQUEST_RECEIVE_SIZE);
 
+    ssize_t left = w->response.data->size - w->response.data->len;
+
 #ifdef ENABLE_HTTPS
     if ( (!web_client_check_unix(w)) && (netdata_srv_ctx) ) {
         if ( ( w->ssl.conn ) && (!w->ssl.flags)) {
             bytes = SSL_read(w->ssl.conn, &w->response.data->buffer[w->response.data->len], (size_t) (left - 1));
+            if(bytes < 0) {
+                int sslerrno = SSL_get_error(w->ssl.conn, (int)bytes);
+                if(sslerrno == SSL_ERROR_WANT_READ || sslerrno == SSL_ERROR_WANT_WRITE) {
+                    // only a part of a TLS record has been received
+                    debug(D_WEB_CLIENT, "%llu: SSL_read() needs more data.", w->id);
+                    return 0;
+                }
+            }
         }else {
             bytes = recv(w->ifd, &w->response.data->buffer[w->response.data->len], (size_t) (left - 1), MSG_DONTWAIT);
         }
@@ -1832,6 +2262,10 @@ ssize_t web_client_receive(struct web_client *w)
         size_t old = w->response.data->len;
         (void)old;
 
+        // the first bytes of a request
+        if(!old)
+            w->received_ut = now_monotonic_usec();
+
         w->response.data->len += bytes;
         w->response.data->buffer[w->response.data->len] = '\0';
 
@@ -9,10 +9,31 @@
 extern int web_enable_gzip,
         web_gzip_level,
         web_gzip_strategy;
+extern size_t web_gzip_min_size;
+
+// responses at least this large, or generated while they are sent, are compressed at the fastest level
+#define NETDATA_WEB_GZIP_FASTEST_SIZE (1024 * 1024)
 #endif /* NETDATA_WITH_ZLIB */
 
 extern int respect_web_browser_do_not_track_policy;
 extern char *web_x_frame_options;
+extern int web_client_access_log_timings;
+
+// the phases of a request, timed for the access log and the netdata.web_phase_* charts
+typedef enum web_client_phase {
+    WEB_CLIENT_PHASE_RECEIVE = 0,   // from the first bytes of the request to the last ones
+    WEB_CLIENT_PHASE_PARSE,         // the validation and the parsing of the request
+    WEB_CLIENT_PHASE_QUERY,         // the database queries (rrd2rrdr)
+    WEB_CLIENT_PHASE_FORMAT,        // the generation of the response, without its queries
+    WEB_CLIENT_PHASE_COMPRESS,      // the compression of the response
+    WEB_CLIENT_PHASE_SEND,          // the sending of the response, without its compression
+
+    // terminator
+    WEB_CLIENT_PHASES
+} WEB_CLIENT_PHASE;
+
+extern const char *web_client_phase_names[WEB_CLIENT_PHASES];
+extern const char *web_client_phase_titles[WEB_CLIENT_PHASES];
 
 typedef enum web_client_mode {
     WEB_CLIENT_MODE_NORMAL      = 0,
@@ -36,6 +57,10 @@ typedef enum web_client_flags {
     WEB_CLIENT_FLAG_UNIX_CLIENT       = 1 << 8, // if set, the client is using a UNIX socket
 
     WEB_CLIENT_FLAG_DONT_CLOSE_SOCKET = 1 << 9,  // don't close the socket when cleaning up (static-threaded web server)
+
+    WEB_CLIENT_FLAG_PIPELINED         = 1 << 10, // if set, the client has sent more requests, before the last one was served
+
+    WEB_CLIENT_FLAG_WAIT_PRODUCER     = 1 << 11, // if set, the producer of the response has nothing to add, until the web server wakes it up
 } WEB_CLIENT_FLAGS;
 
 //#ifdef HAVE_C___ATOMIC
@@ -71,6 +96,14 @@ typedef enum web_client_flags {
 #define web_client_enable_wait_send(w) web_client_flag_set(w, WEB_CLIENT_FLAG_WAIT_SEND)
 #define web_client_disable_wait_send(w) web_client_flag_clear(w, WEB_CLIENT_FLAG_WAIT_SEND)
 
+#define web_client_has_pipelined_request(w) web_client_flag_check(w, WEB_CLIENT_FLAG_PIPELINED)
+#define web_client_enable_pipelined_request(w) web_client_flag_set(w, WEB_CLIENT_FLAG_PIPELINED)
+#define web_client_disable_pipelined_request(w) web_client_flag_clear(w, WEB_CLIENT_FLAG_PIPELINED)
+
+#define web_client_has_wait_producer(w) web_client_flag_check(w, WEB_CLIENT_FLAG_WAIT_PRODUCER)
+#define web_client_enable_wait_producer(w) web_client_flag_set(w, WEB_CLIENT_FLAG_WAIT_PRODUCER)
+#define web_client_disable_wait_producer(w) web_client_flag_clear(w, WEB_CLIENT_FLAG_WAIT_PRODUCER)
+
 #define web_client_set_tcp(w) web_client_flag_set(w, WEB_CLIENT_FLAG_TCP_CLIENT)
 #define web_client_set_unix(w) web_client_flag_set(w, WEB_CLIENT_FLAG_UNIX_CLIENT)
 #define web_client_check_unix(w) web_client_flag_check(w, WEB_CLIENT_FLAG_UNIX_CLIENT)
@@ -83,9 +116,21 @@ typedef enum web_client_flags {
 #define NETDATA_WEB_RESPONSE_HEADER_SIZE 4096
 #define NETDATA_WEB_REQUEST_COOKIE_SIZE 1024
 #define NETDATA_WEB_REQUEST_ORIGIN_HEADER_SIZE 1024
+#define NETDATA_WEB_REQUEST_IF_NONE_MATCH_SIZE 256
 #define NETDATA_WEB_RESPONSE_INITIAL_SIZE 16384
 #define NETDATA_WEB_REQUEST_RECEIVE_SIZE 16384
 #define NETDATA_WEB_REQUEST_MAX_SIZE 16384
+#define NETDATA_WEB_RESPONSE_PRODUCE_SIZE 65536
+#define NETDATA_WEB_RESPONSE_MAX_KEEP_SIZE (1024 * 1024)
+
+struct web_client;
+
+// a response producer appends the next part of the response to w->response.data
+// it returns 0 when the response is complete, 1 when it has more to add, or
+// WEB_CLIENT_PRODUCER_WAIT when it has nothing to add now - the connection is then kept
+// idle, and the web server calls the producer again every time its timer ticks
+#define WEB_CLIENT_PRODUCER_WAIT (-1)
+typedef int (*web_client_producer_t)(struct web_client *w, void *data);
 
 struct response {
     BUFFER *header;                 // our response header
@@ -95,8 +140,14 @@ struct response {
     int code;                       // the HTTP response code
 
     size_t rlen;                    // if non-zero, the excepted size of ifd (input of firecopy)
+    int sendfile;                   // if set, the file ifd is copied to ofd by the kernel, with sendfile()
     size_t sent;                    // current data length sent to output
 
+    web_client_producer_t producer; // if set, the response is generated while it is sent
+    void (*producer_free)(void *data);
+    void *producer_data;
+    size_t produced;                // the bytes of the response sent and no longer in data
+
     int zoutput;                    // if set to 1, web_client_send() will send compressed data
 #ifdef NETDATA_WITH_ZLIB
     z_stream zstream;               // zlib stream for sending compressed output to client
@@ -104,6 +155,9 @@ struct response {
     size_t zsent;                   // the compressed bytes we have sent to the client
     size_t zhave;                   // the compressed bytes that we have received from zlib
     unsigned int zinitialized:1;
+    unsigned int zfinished:1;       // the compressed stream has been finished
+    unsigned int zgzip:1;           // the compressed stream has gzip headers
+    unsigned int zlevel:4;          // the compression level of the stream
 #endif /* NETDATA_WITH_ZLIB */
 
 };
@@ -133,15 +187,22 @@ struct web_client {
 
     struct timeval tv_in, tv_ready;
 
+    usec_t received_ut;             // monotonic, when the first bytes of the request were received
+    usec_t sending_ut;              // monotonic, when the response started to be sent, without compressing and producing it
+    usec_t phase_ut[WEB_CLIENT_PHASES]; // the time the request spent in each phase
+
     char cookie1[NETDATA_WEB_REQUEST_COOKIE_SIZE+1];
     char cookie2[NETDATA_WEB_REQUEST_COOKIE_SIZE+1];
     char origin[NETDATA_WEB_REQUEST_ORIGIN_HEADER_SIZE+1];
+    char if_none_match[NETDATA_WEB_REQUEST_IF_NONE_MATCH_SIZE+1];   // the ETags the client has, if any
     char *user_agent;
 
     struct response response;
+    BUFFER *pipelined;              // the data received after the request being served, allocated on demand
 
     size_t stats_received_bytes;
     size_t stats_sent_bytes;
+    uint8_t api_endpoint;           // the GLOBAL_STATS_API_ENDPOINT of the API request being served
 
     // cache of web_client allocations
     struct web_client *prev;        // maintain a linked list of web clients
@@ -166,10 +227,15 @@ extern int web_client_permission_denied(struct web_client *w);
 
 extern ssize_t web_client_send(struct web_client *w);
 extern ssize_t web_client_receive(struct web_client *w);
+extern int web_client_interrupt_callback(void *data);
 extern ssize_t web_client_read_file(struct web_client *w);
 
 extern void web_client_process_request(struct web_client *w);
 extern void web_client_request_done(struct web_client *w);
+extern void web_client_set_producer(struct web_client *w, web_client_producer_t producer, void (*producer_free)(void *data), void *data);
+#ifdef NETDATA_WITH_ZLIB
+extern void web_client_free_deflate(struct web_client *w);
+#endif
 
 extern void buffer_data_options2string(BUFFER *wb, uint32_t options);
 
@@ -8,6 +8,16 @@
 
 #ifdef ENABLE_HTTPS
 
+// a session that is not shut down is removed from the session cache,
+// so the client could not resume it when it reconnects
+static void web_client_shutdown_ssl(struct web_client *w) {
+    if (netdata_srv_ctx && w->ssl.conn && w->ssl.flags == NETDATA_SSL_HANDSHAKE_COMPLETE) {
+        ERR_clear_error();
+        if (SSL_shutdown(w->ssl.conn) < 0)
+            ERR_clear_error();
+    }
+}
+
 static void web_client_reuse_ssl(struct web_client *w) {
     if (netdata_srv_ctx) {
         if (w->ssl.conn) {
@@ -25,13 +35,18 @@ static void web_client_zero(struct web_client *w) {
     BUFFER *b1 = w->response.data;
     BUFFER *b2 = w->response.header;
     BUFFER *b3 = w->response.header_output;
+    BUFFER *b4 = w->pipelined;
 
     // empty the buffers
     buffer_flush(b1);
     buffer_flush(b2);
     buffer_flush(b3);
+    if(b4) buffer_flush(b4);
 
     freez(w->user_agent);
+#ifdef NETDATA_WITH_ZLIB
+    web_client_free_deflate(w);
+#endif
 
     // zero everything
     memset(w, 0, sizeof(struct web_client));
@@ -40,13 +55,18 @@ static void web_client_zero(struct web_client *w) {
     w->response.data = b1;
     w->response.header = b2;
     w->response.header_output = b3;
+    w->pipelined = b4;
 }
 
 static void web_client_free(struct web_client *w) {
     buffer_free(w->response.header_output);
     buffer_free(w->response.header);
     buffer_free(w->response.data);
+    buffer_free(w->pipelined);
     freez(w->user_agent);
+#ifdef NETDATA_WITH_ZLIB
+    web_client_free_deflate(w);
+#endif
 #ifdef ENABLE_HTTPS
     if ((!web_client_check_unix(w)) && ( netdata_srv_ctx )) {
         if (w->ssl.conn) {
@@ -232,6 +252,10 @@ void web_client_release(struct web_client *w) {
     web_client_request_done(w);
     web_client_disconnected();
 
+#ifdef ENABLE_HTTPS
+    web_client_shutdown_ssl(w);
+#endif
+
     netdata_thread_disable_cancelability();
 
     if(web_server_mode != WEB_SERVER_MODE_STATIC_THREADED) {
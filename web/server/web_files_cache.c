@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define WEB_SERVER_INTERNALS 1
+#include "web_files_cache.h"
+
+// ----------------------------------------------------------------------------
+// gzip compressed static files
+
+// The static files of the dashboard are sent compressed to the clients that
+// accept gzip. Instead of compressing them again for every request, their
+// compressed content is kept in memory, identified by their filename, inode,
+// size and modification time, so that a file is compressed again only after it
+// changes. All the web server threads share the cache, which keeps up to
+// web_files_cache_max_size bytes, evicting the least recently used files.
+
+size_t web_files_cache_max_size = WEB_FILES_CACHE_DEFAULT_SIZE_MB * 1024 * 1024;
+
+#ifdef NETDATA_WITH_ZLIB
+
+struct web_file_gzip {
+    char *filename;
+    uint32_t hash;
+
+    ino_t inode;
+    off_t size;
+    time_t mtime;
+
+    char *data;                     // the compressed content of the file
+    size_t len;
+
+    struct web_file_gzip *next;     // the most recently used first
+};
+
+static struct web_files_cache {
+    netdata_mutex_t mutex;
+    struct web_file_gzip *first;
+    size_t size;                    // the compressed bytes of all the files
+} web_files_cache = {
+        .mutex = NETDATA_MUTEX_INITIALIZER,
+        .first = NULL,
+        .size = 0
+};
+
+static void web_file_gzip_free(struct web_file_gzip *f) {
+    freez(f->filename);
+    freez(f->data);
+    freez(f);
+}
+
+// unlinks the file of the cache *ptr points to
+// the caller must hold the lock of the cache
+static struct web_file_gzip *web_files_cache_unlink(struct web_file_gzip **ptr) {
+    struct web_file_gzip *f = *ptr;
+    *ptr = f->next;
+    web_files_cache.size -= f->len;
+    return f;
+}
+
+// compresses the content of fd, st->st_size bytes long
+static struct web_file_gzip *web_file_gzip_create(const char *filename, int fd, struct stat *st) {
+    size_t size = (size_t)st->st_size, bytes = 0;
+    char *content = mallocz(size + 1);
+
+    while(bytes < size) {
+        ssize_t r = pread(fd, &content[bytes], size - bytes, (off_t)bytes);
+        if(r <= 0) {
+            if(r == -1 && (errno == EINTR || errno == EAGAIN)) continue;
+            error("Cannot read file '%s' to compress it.", filename);
+            freez(content);
+            return NULL;
+        }
+        bytes += (size_t)r;
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    // windowbits = 15 + 16 = 31, for gzip headers
+    if(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        error("Failed to initialize zlib to compress file '%s'.", filename);
+        freez(content);
+        return NULL;
+    }
+
+    // deflateBound() does not account for the gzip header and trailer
+    size_t max = deflateBound(&zs, (uLong)size) + 32;
+    char *data = mallocz(max);
+
+    zs.next_in = (Bytef *)content;
+    zs.avail_in = (uInt)size;
+    zs.next_out = (Bytef *)data;
+    zs.avail_out = (uInt)max;
+
+    int ret = deflate(&zs, Z_FINISH);
+    size_t len = max - zs.avail_out;
+    deflateEnd(&zs);
+    freez(content);
+
+    if(ret != Z_STREAM_END) {
+        error("Failed to compress file '%s'.", filename);
+        freez(data);
+        return NULL;
+    }
+
+    struct web_file_gzip *f = callocz(1, sizeof(struct web_file_gzip));
+    f->filename = strdupz(filename);
+    f->hash = simple_hash(filename);
+    f->inode = st->st_ino;
+    f->size = st->st_size;
+    f->mtime = st->st_mtime;
+    f->data = reallocz(data, len);
+    f->len = len;
+
+    debug(D_WEB_CLIENT, "Compressed file '%s' from %zu to %zu bytes.", filename, size, len);
+    return f;
+}
+
+static inline void web_file_gzip_copy(BUFFER *wb, struct web_file_gzip *f) {
+    buffer_need_bytes(wb, f->len + 1);
+    memcpy(&wb->buffer[wb->len], f->data, f->len);
+    wb->len += f->len;
+    wb->buffer[wb->len] = '\0';
+}
+
+// appends to wb the gzip compressed content of the regular file filename, opened at fd
+// returns 0 on success, -1 when the file has to be compressed while it is sent
+int web_files_cache_gzip(BUFFER *wb, const char *filename, int fd, struct stat *st) {
+    struct web_file_gzip *f, **ptr;
+    uint32_t hash = simple_hash(filename);
+    int found = 0;
+
+    if(!web_files_cache_max_size || (size_t)st->st_size > web_files_cache_max_size)
+        return -1;
+
+    netdata_mutex_lock(&web_files_cache.mutex);
+    for(ptr = &web_files_cache.first; *ptr ; ptr = &(*ptr)->next) {
+        f = *ptr;
+        if(f->hash != hash || strcmp(f->filename, filename) != 0) continue;
+
+        f = web_files_cache_unlink(ptr);
+        if(likely(f->inode == st->st_ino && f->size == st->st_size && f->mtime == st->st_mtime)) {
+            f->next = web_files_cache.first;
+            web_files_cache.first = f;
+            web_files_cache.size += f->len;
+            web_file_gzip_copy(wb, f);
+            found = 1;
+        }
+        else
+            web_file_gzip_free(f);
+
+        break;
+    }
+    netdata_mutex_unlock(&web_files_cache.mutex);
+
+    if(found) return 0;
+
+    // compress it without holding the lock, the other threads may serve other files meanwhile
+    f = web_file_gzip_create(filename, fd, st);
+    if(!f) return -1;
+
+    web_file_gzip_copy(wb, f);
+
+    if(f->len > web_files_cache_max_size / 4) {
+        // it would evict too many others
+        web_file_gzip_free(f);
+        return 0;
+    }
+
+    netdata_mutex_lock(&web_files_cache.mutex);
+
+    // another thread may have compressed it too
+    for(ptr = &web_files_cache.first; *ptr ; ptr = &(*ptr)->next) {
+        if((*ptr)->hash == hash && !strcmp((*ptr)->filename, filename)) {
+            web_file_gzip_free(web_files_cache_unlink(ptr));
+            break;
+        }
+    }
+
+    f->next = web_files_cache.first;
+    web_files_cache.first = f;
+    web_files_cache.size += f->len;
+
+    // evict the least recently used files, the last ones
+    while(web_files_cache.size > web_files_cache_max_size) {
+        for(ptr = &web_files_cache.first; (*ptr)->next ; ptr = &(*ptr)->next) ;
+        debug(D_WEB_CLIENT, "Evicting compressed file '%s' from the cache.", (*ptr)->filename);
+        web_file_gzip_free(web_files_cache_unlink(ptr));
+    }
+
+    netdata_mutex_unlock(&web_files_cache.mutex);
+    return 0;
+}
+
+#endif // NETDATA_WITH_ZLIB
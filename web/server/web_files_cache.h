@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_WEB_FILES_CACHE_H
+#define NETDATA_WEB_FILES_CACHE_H
+
+#include "libnetdata/libnetdata.h"
+
+#define WEB_FILES_CACHE_DEFAULT_SIZE_MB 16
+
+extern size_t web_files_cache_max_size;
+
+#ifdef NETDATA_WITH_ZLIB
+extern int web_files_cache_gzip(BUFFER *wb, const char *filename, int fd, struct stat *st);
+#endif
+
+#endif //NETDATA_WEB_FILES_CACHE_H
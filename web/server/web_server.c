@@ -82,10 +82,60 @@ SIMPLE_PATTERN *web_allow_badges_from = NULL;
 SIMPLE_PATTERN *web_allow_mgmt_from = NULL;
 SIMPLE_PATTERN *web_allow_streaming_from = NULL;
 SIMPLE_PATTERN *web_allow_netdataconf_from = NULL;
+SIMPLE_PATTERN *web_allow_unix_users = NULL;
+
+// the clients of unix sockets are checked by the user the process at the other end runs as,
+// against the user names and the uids of the pattern - they have no IP to check
+static int web_client_unix_user_allowed(struct web_client *w) {
+    uid_t uid;
+
+#if defined(SO_PEERCRED)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if(getsockopt(w->ifd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+        error("%llu: cannot get the credentials of the unix socket client on fd %d.", w->id, w->ifd);
+        return 0;
+    }
+    uid = cred.uid;
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+    gid_t gid;
+
+    if(getpeereid(w->ifd, &uid, &gid) == -1) {
+        error("%llu: cannot get the credentials of the unix socket client on fd %d.", w->id, w->ifd);
+        return 0;
+    }
+#else
+    // the credentials cannot be checked, only the permissions of the socket protect it
+    return (!web_allow_unix_users || simple_pattern_matches(web_allow_unix_users, "*"));
+#endif
+
+    if(!web_allow_unix_users)
+        return 1;
+
+    char buf[1024 + 1], id[20 + 1];
+    snprintfz(id, 20, "%u", (unsigned int)uid);
+    if(simple_pattern_matches(web_allow_unix_users, id))
+        return 1;
+
+    struct passwd pw, *result = NULL;
+    if(getpwuid_r(uid, &pw, buf, sizeof(buf), &result) == 0 && result && simple_pattern_matches(web_allow_unix_users, result->pw_name))
+        return 1;
+
+    info("%llu: DENIED ACCESS to unix socket client with uid %u.", w->id, (unsigned int)uid);
+    return 0;
+}
 
 void web_client_update_acl_matches(struct web_client *w) {
     w->acl = WEB_CLIENT_ACL_NONE;
 
+    // once its user is allowed, a client of a unix socket gets all the access of the socket
+    if(web_client_check_unix(w)) {
+        if(web_client_unix_user_allowed(w))
+            w->acl = w->port_acl;
+        return;
+    }
+
     if(!web_allow_dashboard_from || simple_pattern_matches(web_allow_dashboard_from, w->client_ip))
         w->acl |= WEB_CLIENT_ACL_DASHBOARD;
 
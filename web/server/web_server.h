@@ -26,6 +26,7 @@ extern SIMPLE_PATTERN *web_allow_badges_from;
 extern SIMPLE_PATTERN *web_allow_streaming_from;
 extern SIMPLE_PATTERN *web_allow_netdataconf_from;
 extern SIMPLE_PATTERN *web_allow_mgmt_from;
+extern SIMPLE_PATTERN *web_allow_unix_users;
 
 extern WEB_SERVER_MODE web_server_mode;
 
@@ -50,6 +51,8 @@ extern struct web_client *web_client_create_on_listenfd(int listener);
 #include "web_client_cache.h"
 #endif // WEB_SERVER_INTERNALS
 
+#include "web_files_cache.h"
+
 #include "static/static-threaded.h"
 
 #include "daemon/common.h"